@@ -230,7 +230,9 @@ public:
 /* List supported protocols. */
 void list_protocols() {
     // I'll just cheat here.
-    printf("rethinkdb");
+#ifdef USE_RETHINKDB
+    printf("rethinkdb,");
+#endif
     printf("sockmemcached,");
 #ifdef USE_MYSQL
     printf("mysql,");
@@ -316,7 +318,12 @@ void usage(const char *name) {
     _d_server.print_protocol();
     printf("].\n\n");
 
-    printf("\t\tFor memcached and rethinkdb protocols the host argument should be in the form host:port.\n");
+    printf("\t\tFor memcached protocols the host argument should be in the form host:port.\n");
+#ifdef USE_RETHINKDB
+    printf("\t\tFor rethinkdb protocol the host argument should be in the form\n" \
+           "\t\thost:port/db/table[?durability=hard|soft&batch=N&index=NAME&auth=KEY]\n" \
+           "\t\t(see protocols/rethinkdb_protocol.hpp).\n");
+#endif
 #ifdef USE_MYSQL
     printf("\t\tFor mysql protocol the host argument should be in the following\n" \
            "\t\tformat: username/password@host:port+database.\n\n");
@@ -9,6 +9,9 @@
 #  include "protocols/mysql_protocol.hpp"
 #endif
 #include "protocols/sqlite_protocol.hpp"
+#ifdef USE_RETHINKDB
+#  include "protocols/rethinkdb_protocol.hpp"
+#endif
 
 protocol_t *server_t::connect() {
     switch (protocol) {
@@ -24,6 +27,10 @@ protocol_t *server_t::connect() {
 #endif
     case protocol_sqlite:
         return new sqlite_protocol_t(host);
+#ifdef USE_RETHINKDB
+    case protocol_rethinkdb:
+        return new rethinkdb_protocol_t(host);
+#endif
     default:
         fprintf(stderr, "Unknown protocol\n");
         exit(-1);
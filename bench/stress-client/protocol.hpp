@@ -66,6 +66,9 @@ enum protocol_enum_t {
     protocol_libmemcached,
 #endif
     protocol_sqlite,
+#ifdef USE_RETHINKDB
+    protocol_rethinkdb,
+#endif
 };
 
 struct server_t {
@@ -86,6 +89,10 @@ struct server_t {
 #endif
         } else if(strcmp(name, "sqlite") == 0) {
             return protocol_sqlite;
+#ifdef USE_RETHINKDB
+        } else if (strcmp(name, "rethinkdb") == 0) {
+            return protocol_rethinkdb;
+#endif
         } else {
             fprintf(stderr, "Unknown protocol\n");
             exit(-1);
@@ -120,6 +127,10 @@ struct server_t {
 #endif
         } else if (protocol == protocol_sqlite) {
             printf("sqlite");
+#ifdef USE_RETHINKDB
+        } else if (protocol == protocol_rethinkdb) {
+            printf("rethinkdb");
+#endif
         } else {
             printf("unknown");
         }
@@ -0,0 +1,511 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#ifndef __STRESS_CLIENT_PROTOCOLS_RETHINKDB_PROTOCOL_HPP__
+#define __STRESS_CLIENT_PROTOCOLS_RETHINKDB_PROTOCOL_HPP__
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include <map>
+#include "protocol.hpp"
+#include "protocols/ql2.pb.h"
+
+/* Talks ReQL to the document engine: every document is
+ * `{"id": key, "value": value}` in one table, and every operation is one query
+ * with one round trip, apart from the `CONTINUE`s of reads that come back in
+ * several batches.
+ *
+ * The host string is `host:port/db/table`, optionally followed by options in
+ * the form `?name=value&name=value`:
+ *   durability=hard|soft  The durability of the writes, the table's by default.
+ *   batch=N               The most documents the server puts in one batch of a
+ *                         read, the server's default if it's not given.
+ *   index=NAME            Do the reads with `get_all` and `between` on the
+ *                         secondary index NAME rather than on the primary key.
+ *                         The documents then also get a NAME field with their key,
+ *                         so an index on that field (`index_create(NAME)`) finds
+ *                         them.
+ *   auth=KEY              The authorization key, none by default.
+ * The table has to exist, with `id` as its primary key. */
+
+class rethinkdb_query_error_t : public protocol_error_t {
+public:
+    rethinkdb_query_error_t(const std::string& message) : protocol_error_t("Query error: " + message) { }
+    virtual ~rethinkdb_query_error_t() throw () { }
+};
+
+struct rethinkdb_protocol_t : public protocol_t {
+    rethinkdb_protocol_t(const char *conn_str)
+        : sockfd(-1), port(0), batch_size(0), next_token(1)
+    {
+        parse_conn_str(conn_str);
+
+        // init the socket
+        sockfd = socket(AF_INET, SOCK_STREAM, 0);
+        if (sockfd < 0) {
+            fprintf(stderr, "Could not create socket\n");
+            exit(-1);
+        }
+
+        // Setup the host/port data structures
+        struct sockaddr_in sin;
+        struct hostent *host = gethostbyname(hostname.c_str());
+        if (!host) {
+            herror("Could not gethostbyname()");
+            exit(-1);
+        }
+        memcpy(&sin.sin_addr.s_addr, host->h_addr, host->h_length);
+        sin.sin_family = AF_INET;
+        sin.sin_port = htons(port);
+
+        // Connect to server
+        int res = ::connect(sockfd, (struct sockaddr *)&sin, sizeof(sin));
+        if (res < 0) {
+            int err = errno;
+            fprintf(stderr, "Could not connect to server (%d)\n", err);
+            exit(-1);
+        }
+
+        // Every query is a small write followed by a read, so don't let Nagle
+        // hold it back.
+        int flag = 1;
+        setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+
+        handshake();
+    }
+
+    virtual ~rethinkdb_protocol_t() {
+        if (sockfd != -1) {
+            int res = close(sockfd);
+            if (res != 0) {
+                fprintf(stderr, "Could not close socket\n");
+                exit(-1);
+            }
+        }
+    }
+
+    virtual void remove(const char *key, size_t key_size) {
+        Term *term = start_query();
+        Term *del = make(term, Term::DELETE);
+        get(add_arg(del), key, key_size);
+        add_durability(del);
+        run_write();
+    }
+
+    virtual void update(const char *key, size_t key_size,
+                        const char *value, size_t value_size) {
+        Term *term = start_query();
+        Term *upd = make(term, Term::UPDATE);
+        get(add_arg(upd), key, key_size);
+        Term *obj = make(add_arg(upd), Term::MAKE_OBJ);
+        make_str(add_optarg(obj, "value"), value, value_size);
+        add_durability(upd);
+        run_write();
+    }
+
+    virtual void insert(const char *key, size_t key_size,
+                        const char *value, size_t value_size) {
+        Term *term = start_query();
+        Term *ins = make(term, Term::INSERT);
+        table(add_arg(ins));
+        Term *obj = make(add_arg(ins), Term::MAKE_OBJ);
+        make_str(add_optarg(obj, "id"), key, key_size);
+        make_str(add_optarg(obj, "value"), value, value_size);
+        if (!index.empty()) {
+            make_str(add_optarg(obj, index), key, key_size);
+        }
+        // Let the workloads insert over the keys they have already, like
+        // memcached's `set` does.
+        make_bool(add_optarg(ins, "upsert"), true);
+        add_durability(ins);
+        run_write();
+    }
+
+    virtual void read(payload_t *keys, int count, payload_t *values = NULL) {
+        Term *term = start_query();
+        Term *get_all = make(term, Term::GET_ALL);
+        table(add_arg(get_all));
+        for (int i = 0; i < count; i++) {
+            make_str(add_arg(get_all), keys[i].first, keys[i].second);
+        }
+        add_index(get_all);
+
+        std::vector<const Datum *> docs;
+        run_read(&docs);
+
+        if (values) {
+            std::map<std::string, std::string> found;
+            for (size_t i = 0; i < docs.size(); i++) {
+                found[get_str_field(*docs[i], "id")] = get_str_field(*docs[i], "value");
+            }
+            for (int i = 0; i < count; i++) {
+                const std::string key(keys[i].first, keys[i].second);
+                const std::string expected(values[i].first, values[i].second);
+                if (found[key] != expected) {
+                    fprintf(stderr, "Got unexpected value: %s instead of %s\n", found[key].c_str(), expected.c_str());
+                }
+            }
+        }
+    }
+
+    virtual void range_read(char* lkey, size_t lkey_size, char* rkey, size_t rkey_size, int count_limit, payload_t *values = NULL) {
+        Term *term = start_query();
+        Term *limit = make(term, Term::LIMIT);
+        Term *between = make(add_arg(limit), Term::BETWEEN);
+        table(add_arg(between));
+        make_str(add_arg(between), lkey, lkey_size);
+        make_str(add_arg(between), rkey, rkey_size);
+        add_index(between);
+        // `rget` includes both of its keys.
+        make_str(add_optarg(between, "right_bound"), "closed", strlen("closed"));
+        make_num(add_arg(limit), count_limit);
+
+        std::vector<const Datum *> docs;
+        run_read(&docs);
+
+        if (values) {
+            fprintf(stderr, "Value verification not implemented for range reads\n");
+        }
+    }
+
+    // There's no append or prepend in ReQL, so these update the value with the
+    // string concatenation of `ADD`, the way a client would do it.
+    virtual void append(const char *key, size_t key_size,
+                        const char *value, size_t value_size) {
+        concatenate(key, key_size, value, value_size, false);
+    }
+
+    virtual void prepend(const char *key, size_t key_size,
+                          const char *value, size_t value_size) {
+        concatenate(key, key_size, value, value_size, true);
+    }
+
+private:
+    void parse_conn_str(const char *conn_str) {
+        std::string str(conn_str);
+
+        std::string options;
+        size_t question_mark = str.find('?');
+        if (question_mark != std::string::npos) {
+            options = str.substr(question_mark + 1);
+            str.resize(question_mark);
+        }
+
+        size_t colon = str.find(':');
+        size_t first_slash = str.find('/');
+        size_t second_slash = first_slash == std::string::npos ? std::string::npos : str.find('/', first_slash + 1);
+        if (colon == std::string::npos || first_slash == std::string::npos
+            || second_slash == std::string::npos || colon > first_slash) {
+            fprintf(stderr, "Please use host string of the form host:port/db/table[?options].\n");
+            exit(-1);
+        }
+        hostname = str.substr(0, colon);
+        port = atoi(str.substr(colon + 1, first_slash - colon - 1).c_str());
+        if (port == 0) {
+            fprintf(stderr, "Cannot parse port string: \"%s\".\n", str.substr(colon + 1, first_slash - colon - 1).c_str());
+            exit(-1);
+        }
+        db = str.substr(first_slash + 1, second_slash - first_slash - 1);
+        table_name = str.substr(second_slash + 1);
+        if (db.empty() || table_name.empty()) {
+            fprintf(stderr, "Please use host string of the form host:port/db/table[?options].\n");
+            exit(-1);
+        }
+
+        while (!options.empty()) {
+            size_t amp = options.find('&');
+            std::string option = options.substr(0, amp);
+            options = amp == std::string::npos ? "" : options.substr(amp + 1);
+
+            size_t eq = option.find('=');
+            if (eq == std::string::npos) {
+                fprintf(stderr, "Option \"%s\" has no value.\n", option.c_str());
+                exit(-1);
+            }
+            std::string name = option.substr(0, eq);
+            std::string value = option.substr(eq + 1);
+            if (name == "durability") {
+                if (value != "hard" && value != "soft") {
+                    fprintf(stderr, "Durability must be \"hard\" or \"soft\", not \"%s\".\n", value.c_str());
+                    exit(-1);
+                }
+                durability = value;
+            } else if (name == "batch") {
+                batch_size = atoi(value.c_str());
+                if (batch_size <= 0) {
+                    fprintf(stderr, "Cannot parse batch size: \"%s\".\n", value.c_str());
+                    exit(-1);
+                }
+            } else if (name == "index") {
+                index = value;
+            } else if (name == "auth") {
+                auth_key = value;
+            } else {
+                fprintf(stderr, "Unknown option \"%s\".\n", name.c_str());
+                exit(-1);
+            }
+        }
+    }
+
+    void handshake() {
+        char header[8];
+        write_uint32(header, VersionDummy::V0_2);
+        write_uint32(header + 4, auth_key.size());
+        send_bytes(header, sizeof(header));
+        send_bytes(auth_key.data(), auth_key.size());
+
+        std::string reply;
+        char c;
+        do {
+            recv_bytes(&c, 1);
+            reply.push_back(c);
+        } while (c != '\0');
+        reply.resize(reply.size() - 1);
+        if (reply != "SUCCESS") {
+            fprintf(stderr, "The server refused the connection: %s\n", reply.c_str());
+            exit(-1);
+        }
+    }
+
+    /* Building the queries */
+
+    Term *start_query() {
+        query.Clear();
+        query.set_type(Query::START);
+        query.set_token(next_token++);
+        if (batch_size > 0) {
+            Query::AssocPair *batch_conf = query.add_global_optargs();
+            batch_conf->set_key("batch_conf");
+            Term *conf = make(batch_conf->mutable_val(), Term::MAKE_OBJ);
+            make_num(add_optarg(conf, "max_els"), batch_size);
+        }
+        return query.mutable_query();
+    }
+
+    static Term *make(Term *term, Term::TermType type) {
+        term->set_type(type);
+        return term;
+    }
+
+    static Term *add_arg(Term *term) {
+        return term->add_args();
+    }
+
+    static Term *add_optarg(Term *term, const std::string &key) {
+        Term::AssocPair *optarg = term->add_optargs();
+        optarg->set_key(key);
+        return optarg->mutable_val();
+    }
+
+    static void make_str(Term *term, const char *str, size_t size) {
+        make(term, Term::DATUM);
+        Datum *datum = term->mutable_datum();
+        datum->set_type(Datum::R_STR);
+        datum->set_r_str(str, size);
+    }
+
+    static void make_num(Term *term, double num) {
+        make(term, Term::DATUM);
+        Datum *datum = term->mutable_datum();
+        datum->set_type(Datum::R_NUM);
+        datum->set_r_num(num);
+    }
+
+    static void make_bool(Term *term, bool b) {
+        make(term, Term::DATUM);
+        Datum *datum = term->mutable_datum();
+        datum->set_type(Datum::R_BOOL);
+        datum->set_r_bool(b);
+    }
+
+    void table(Term *term) {
+        make(term, Term::TABLE);
+        make_str(add_arg(make(add_arg(term), Term::DB)), db.data(), db.size());
+        make_str(add_arg(term), table_name.data(), table_name.size());
+    }
+
+    void get(Term *term, const char *key, size_t key_size) {
+        make(term, Term::GET);
+        table(add_arg(term));
+        make_str(add_arg(term), key, key_size);
+    }
+
+    void add_durability(Term *term) {
+        if (!durability.empty()) {
+            make_str(add_optarg(term, "durability"), durability.data(), durability.size());
+        }
+    }
+
+    void add_index(Term *term) {
+        if (!index.empty()) {
+            make_str(add_optarg(term, "index"), index.data(), index.size());
+        }
+    }
+
+    // `update(func(doc) { return {"value": doc("value") + value}; })`, or with the
+    // sum the other way around to prepend.
+    void concatenate(const char *key, size_t key_size,
+                     const char *value, size_t value_size, bool prepend) {
+        Term *term = start_query();
+        Term *upd = make(term, Term::UPDATE);
+        get(add_arg(upd), key, key_size);
+        Term *func = make(add_arg(upd), Term::FUNC);
+        make_num(add_arg(make(add_arg(func), Term::MAKE_ARRAY)), 1);
+        Term *obj = make(add_arg(func), Term::MAKE_OBJ);
+        Term *sum = make(add_optarg(obj, "value"), Term::ADD);
+        Term *first = add_arg(sum);
+        Term *second = add_arg(sum);
+        Term *old_value = prepend ? second : first;
+        make_str(prepend ? first : second, value, value_size);
+        make(old_value, Term::GET_FIELD);
+        make_num(add_arg(make(add_arg(old_value), Term::VAR)), 1);
+        make_str(add_arg(old_value), "value", strlen("value"));
+        add_durability(upd);
+        run_write();
+    }
+
+    /* Running the queries */
+
+    void run_write() {
+        send_query();
+        recv_response(&response);
+        check_response(response);
+    }
+
+    // Reads all the batches of the result, into `responses` that `docs` points
+    // into.
+    void run_read(std::vector<const Datum *> *docs) {
+        send_query();
+        responses.resize(1);
+        recv_response(&responses[0]);
+        check_response(responses[0]);
+        while (responses.back().type() == Response::SUCCESS_PARTIAL) {
+            query.Clear();
+            query.set_type(Query::CONTINUE);
+            query.set_token(responses.back().token());
+            send_query();
+            responses.resize(responses.size() + 1);
+            recv_response(&responses.back());
+            check_response(responses.back());
+        }
+
+        for (size_t i = 0; i < responses.size(); i++) {
+            for (int j = 0; j < responses[i].response_size(); j++) {
+                docs->push_back(&responses[i].response(j));
+            }
+        }
+    }
+
+    void check_response(const Response &res) {
+        if (res.type() == Response::SUCCESS_ATOM
+            || res.type() == Response::SUCCESS_SEQUENCE
+            || res.type() == Response::SUCCESS_PARTIAL) {
+            return;
+        }
+        if (res.response_size() == 1 && res.response(0).type() == Datum::R_STR) {
+            throw rethinkdb_query_error_t(res.response(0).r_str());
+        }
+        throw protocol_error_t("Unexpected response to a query.");
+    }
+
+    static std::string get_str_field(const Datum &doc, const char *key) {
+        for (int i = 0; i < doc.r_object_size(); i++) {
+            if (doc.r_object(i).key() == key && doc.r_object(i).val().type() == Datum::R_STR) {
+                return doc.r_object(i).val().r_str();
+            }
+        }
+        return std::string();
+    }
+
+    /* The wire */
+
+    void send_query() {
+        const int size = query.ByteSize();
+        send_buffer.resize(size + 4);
+        write_uint32(send_buffer.data(), size);
+        if (!query.SerializeToArray(send_buffer.data() + 4, size)) {
+            fprintf(stderr, "Could not serialize the query\n");
+            exit(-1);
+        }
+        send_bytes(send_buffer.data(), send_buffer.size());
+    }
+
+    void recv_response(Response *res) {
+        char header[4];
+        recv_bytes(header, sizeof(header));
+        const uint32_t size = read_uint32(header);
+        recv_buffer.resize(size);
+        recv_bytes(recv_buffer.data(), size);
+        if (!res->ParseFromArray(recv_buffer.data(), size)) {
+            throw protocol_error_t("Could not parse the response.");
+        }
+    }
+
+    // The sizes on the wire are little-endian whatever the host is.
+    static void write_uint32(char *buf, uint32_t n) {
+        for (int i = 0; i < 4; i++) {
+            buf[i] = static_cast<char>((n >> (8 * i)) & 0xff);
+        }
+    }
+
+    static uint32_t read_uint32(const char *buf) {
+        uint32_t n = 0;
+        for (int i = 0; i < 4; i++) {
+            n |= static_cast<uint32_t>(static_cast<unsigned char>(buf[i])) << (8 * i);
+        }
+        return n;
+    }
+
+    void send_bytes(const char *buf, size_t total) {
+        size_t count = 0;
+        while (count < total) {
+            ssize_t res = write(sockfd, buf + count, total - count);
+            if (res < 0) {
+                fprintf(stderr, "Could not send command (%d)\n", errno);
+                exit(-1);
+            }
+            count += res;
+        }
+    }
+
+    void recv_bytes(char *buf, size_t total) {
+        size_t count = 0;
+        while (count < total) {
+            ssize_t res = recv(sockfd, buf + count, total - count, 0);
+            if (res == 0) {
+                fprintf(stderr, "rethinkdb_protocol: error: server closed the connection\n");
+                exit(-1);
+            } else if (res < 0) {
+                perror("Unable to read from socket");
+                exit(-1);
+            }
+            count += res;
+        }
+    }
+
+private:
+    int sockfd;
+    std::string hostname;
+    int port;
+    std::string db, table_name;
+
+    std::string durability;
+    int batch_size;
+    std::string index;
+    std::string auth_key;
+
+    int64_t next_token;
+    Query query;
+    Response response;
+    std::vector<Response> responses;
+    std::vector<char> send_buffer, recv_buffer;
+};
+
+#endif  // __STRESS_CLIENT_PROTOCOLS_RETHINKDB_PROTOCOL_HPP__
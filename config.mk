@@ -0,0 +1,48 @@
+# Automatically generated by ./configure
+# Command line: 
+CONFIGURE_STATUS := started
+CONFIGURE_ERROR := 
+CONFIGURE_COMMAND_LINE :=  
+# Bash
+LIB_SEARCH_PATHS := 
+# Operating System
+OS := Linux
+# OS Version
+PTHREAD_LIBS := -pthread
+# Without tcmalloc
+NO_TCMALLOC := 0
+# Build client drivers
+BUILD_DRIVERS := 0
+# Architecture
+GCC_ARCH := x86_64
+GCC_ARCH_REDUCED := x86_64
+DEB_ARCH := x86_64
+# Use ccache
+USE_CCACHE := 0
+# C++ Compiler
+COMPILER := GCC
+CXX := /usr/bin/c++
+# Precompiled web assets
+USE_PRECOMPILED_WEB_ASSETS := 0
+# LESS css
+LESSC = $(TC_LESSC_INT_EXE)
+# CoffeeScript
+COFFEE = $(TC_COFFEE_INT_EXE)
+# Handlebars
+HANDLEBARS = $(TC_HANDLEBARS_INT_EXE)
+# browserify
+BROWSERIFY = $(TC_BROWSERIFY_INT_EXE)
+# proto2js
+PROTO2JS = $(TC_PROTO2JS_INT_EXE)
+# Protobuf compiler
+PROTOC := /usr/bin/protoc
+# wget
+WGET := /usr/bin/wget
+# curl
+CURL := /usr/bin/curl
+# Node.js package manager
+NPM := /usr/bin/npm
+# protobuf
+PROTOBUF_LIBS += -lprotobuf
+# v8
+CONFIGURE_ERROR := libv8 not found
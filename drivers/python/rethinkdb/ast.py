@@ -370,6 +370,15 @@ class RqlQuery(object):
         else:
             return Count(self, func_wrap(filter))
 
+    def approx_count_distinct(self):
+        return ApproxCountDistinct(self)
+
+    def approx_quantile(self, quantile):
+        return ApproxQuantile(self, quantile)
+
+    def changes(self):
+        return Changes(self)
+
     def union(self, *others):
         return Union(self, *others)
 
@@ -797,8 +806,8 @@ class DB(RqlTopLevelQuery):
     def table_list(self):
         return TableList(self)
 
-    def table_create(self, table_name, primary_key=(), datacenter=(), cache_size=(), durability=()):
-        return TableCreate(self, table_name, primary_key=primary_key, datacenter=datacenter, cache_size=cache_size, durability=durability)
+    def table_create(self, table_name, primary_key=(), datacenter=(), cache_size=(), block_size=(), durability=()):
+        return TableCreate(self, table_name, primary_key=primary_key, datacenter=datacenter, cache_size=cache_size, block_size=block_size, durability=durability)
 
     def table_drop(self, table_name):
         return TableDrop(self, table_name)
@@ -832,11 +841,23 @@ class Table(RqlQuery):
     def get_all(self, *keys, **kwargs):
         return GetAll(self, *keys, **kwargs)
 
-    def index_create(self, name, fundef=(), multi=()):
+    def index_create(self, name, fundef=(), multi=(), text=(), projection=(),
+                     aggregate=(), sum=()):
         args = [self, name] + ([func_wrap(fundef)] if fundef else [])
         kwargs = {"multi" : multi} if multi else {}
+        if text:
+            kwargs["text"] = text
+        if projection:
+            kwargs["projection"] = projection
+        if aggregate:
+            kwargs["aggregate"] = aggregate
+        if sum:
+            kwargs["sum"] = sum
         return IndexCreate(*args, **kwargs)
 
+    def search(self, query, index=(), phrase=(), limit=()):
+        return Search(self, query, index=index, phrase=phrase, limit=limit)
+
     def index_drop(self, name):
         return IndexDrop(self, name)
 
@@ -852,6 +873,9 @@ class Table(RqlQuery):
     def sync(self):
         return Sync(self)
 
+    def shard(self, shard):
+        return Shard(self, shard)
+
     def compose(self, args, optargs):
         if isinstance(self.args[0], DB):
             return T(args[0], '.table(', args[1], ')')
@@ -866,6 +890,10 @@ class GetAll(RqlMethodQuery):
     tt = p.Term.GET_ALL
     st = 'get_all'
 
+class Search(RqlMethodQuery):
+    tt = p.Term.SEARCH
+    st = 'search'
+
 class Reduce(RqlMethodQuery):
     tt = p.Term.REDUCE
     st = 'reduce'
@@ -916,6 +944,18 @@ class IsEmpty(RqlMethodQuery):
     tt = p.Term.IS_EMPTY
     st = 'is_empty'
 
+class ApproxCountDistinct(RqlMethodQuery):
+    tt = p.Term.APPROX_COUNT_DISTINCT
+    st = 'approx_count_distinct'
+
+class ApproxQuantile(RqlMethodQuery):
+    tt = p.Term.APPROX_QUANTILE
+    st = 'approx_quantile'
+
+class Changes(RqlMethodQuery):
+    tt = p.Term.CHANGES
+    st = 'changes'
+
 class GroupedMapReduce(RqlMethodQuery):
     tt = p.Term.GROUPED_MAP_REDUCE
     st = 'grouped_map_reduce'
@@ -1024,6 +1064,10 @@ class Sync(RqlMethodQuery):
     tt = p.Term.SYNC
     st = 'sync'
 
+class Shard(RqlMethodQuery):
+    tt = p.Term.SHARD
+    st = 'shard'
+
 class Branch(RqlTopLevelQuery):
     tt = p.Term.BRANCH
     st = "branch"
@@ -133,7 +133,9 @@ SERIALIZER_DEBUG ?= 0
 MEMCACHED_STRICT ?= 0
 NO_EVENTFD ?= 0
 NO_EPOLL ?= 0
+NO_IO_URING ?= 0
 LEGACY_PROC_STAT ?= 0
 UNIT_TEST_FILTER ?= *
+MICROBENCH_FILTER ?=
 PACKAGE_FOR_SUSE_10 ?= 0
 NO_COMPILE_JS ?= 0
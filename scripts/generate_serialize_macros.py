@@ -70,6 +70,25 @@ def generate_impl_me_serializable_macro(nfields):
     print "        return res; \\"
     print "    }"
 
+def generate_make_me_serializable_raw_macro(nfields):
+    fields = ["field%d" % (i+1) for i in xrange(nfields)]
+    print "#define RDB_MAKE_ME_SERIALIZABLE_RAW_%d(%s) \\" % (nfields, ", ".join(fields))
+    print "    template <class, class> friend struct archive_raw_t; \\"
+    print "    template <class, class> friend struct serialized_size_t; \\"
+    print "    static const size_t rdb_archive_raw_size = %s; \\" % " + ".join("sizeof(%s)" % f for f in fields)
+    print "    friend class write_message_t; \\"
+    print "    void rdb_serialize(write_message_t &msg /* NOLINT */) const { \\"
+    print "        static_assert(%s, \\" % " && ".join("archive_raw_t<decltype(%s)>::value" % f for f in fields)
+    print "                      \"every field must be raw-serializable\"); \\"
+    print "        static_assert(rdb_archive_raw_size == sizeof(*this), \\"
+    print "                      \"there must be no padding between the fields\"); \\"
+    print "        serialize_raw_array(&msg, this, 1); \\"
+    print "    } \\"
+    print "    friend class archive_deserializer_t; \\"
+    print "    archive_result_t rdb_deserialize(read_stream_t *s) { \\"
+    print "        return deserialize_raw_array(s, this, 1); \\"
+    print "    }"
+
 if __name__ == "__main__":
 
     print "// Copyright 2010-2012 RethinkDB, all rights reserved."
@@ -102,7 +121,13 @@ invoke it at global scope after the class declaration, or use
 RDB_MAKE_ME_SERIALIZABLE_*() instead. In order to force the compiler to catch
 this error, we declare a dummy "extern int" in RDB_MAKE_ME_SERIALIZABLE_*().
 This is a noop at the global scope, but produces a (somewhat weird) error in
-the class scope. */
+the class scope.
+
+RDB_MAKE_ME_SERIALIZABLE_RAW_*(field1, ...) is for classes whose fields are all
+raw-serializable (see `archive_raw_t`) and have no padding between them, such as
+timestamps and versions. It writes the same bytes as RDB_MAKE_ME_SERIALIZABLE_*(),
+but with a single copy, and makes vectors of the class be copied as one block
+too. */
     """.strip()
     print
     print "#define RDB_DECLARE_SERIALIZABLE(type_t) \\"
@@ -124,4 +149,8 @@ the class scope. */
         generate_impl_me_serializable_macro(nfields)
         print
 
+    for nfields in xrange(1, 5):
+        generate_make_me_serializable_raw_macro(nfields)
+        print
+
     print "#endif // RPC_SERIALIZE_MACROS_HPP_"
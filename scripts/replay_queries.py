@@ -0,0 +1,301 @@
+#!/usr/bin/env python
+# Copyright 2010-2013 RethinkDB, all rights reserved.
+
+"""Replays the queries a server captured with `--capture-queries FILE` against
+another server, and prints how long they took by the shape of the query.
+
+Every connection of the capture gets a connection of its own, which sends its
+queries with the time between them of the capture divided by `--speed`, or as
+fast as the server answers them with `--speed 0`.  The queries of a shape have
+the same fingerprint as in the slow query log: their terms, with every datum as
+`?`.  The CONTINUEs of a cursor count for the shape of the query that opened it,
+as `CONTINUE <fingerprint>`.  See src/rdb_protocol/query_capture.hpp for the
+format of the file."""
+
+import optparse
+import os
+import socket
+import struct
+import sys
+import threading
+import time
+
+sys.path.append(os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                             "..", "drivers", "python"))
+from rethinkdb import ql2_pb2 as p
+
+CAPTURE_MAGIC = "RQLCAP01".encode("ascii")
+RECORD_HEADER = struct.Struct("<QQqL")
+MAX_FINGERPRINT_SIZE = 1024
+
+class CapturedQuery(object):
+    def __init__(self, microtime, connection_id, token, serialized):
+        self.microtime = microtime
+        self.connection_id = connection_id
+        self.token = token
+        self.serialized = serialized
+
+def read_capture(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    if data[:len(CAPTURE_MAGIC)] != CAPTURE_MAGIC:
+        raise ValueError("%s is not a query capture" % path)
+    queries = []
+    offset = len(CAPTURE_MAGIC)
+    while offset + RECORD_HEADER.size <= len(data):
+        microtime, connection_id, token, size = RECORD_HEADER.unpack_from(data, offset)
+        offset += RECORD_HEADER.size
+        if offset + size > len(data):
+            # The server stopped in the middle of a buffer.
+            break
+        queries.append(CapturedQuery(microtime, connection_id, token,
+                                     data[offset:offset + size]))
+        offset += size
+    # Every thread of the server wrote its own buffers, so the file is only in
+    # order within them.
+    queries.sort(key=lambda q: q.microtime)
+    return queries
+
+def append_fingerprint(term, out):
+    if sum(len(s) for s in out) >= MAX_FINGERPRINT_SIZE:
+        return False
+    if term.type == p.Term.DATUM:
+        out.append("?")
+        return True
+    out.append(p.Term.TermType.Name(term.type))
+    out.append("(")
+    first = True
+    for arg in term.args:
+        if not first:
+            out.append(", ")
+        first = False
+        if not append_fingerprint(arg, out):
+            return False
+    for optarg in term.optargs:
+        if not first:
+            out.append(", ")
+        first = False
+        out.append(optarg.key)
+        out.append(": ")
+        if not append_fingerprint(optarg.val, out):
+            return False
+    out.append(")")
+    return True
+
+def query_fingerprint(term):
+    out = []
+    if not append_fingerprint(term, out):
+        return "".join(out)[:MAX_FINGERPRINT_SIZE] + "..."
+    return "".join(out)
+
+def is_noreply(query):
+    for optarg in query.global_optargs:
+        if optarg.key == "noreply":
+            val = optarg.val
+            return (val.type == p.Term.DATUM and
+                    val.datum.type == p.Datum.R_BOOL and
+                    val.datum.r_bool)
+    return False
+
+class LatencyStats(object):
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.latencies = {}
+        self.errors = {}
+
+    def record(self, fingerprint, seconds, error):
+        with self.lock:
+            self.latencies.setdefault(fingerprint, []).append(seconds)
+            if error:
+                self.errors[fingerprint] = self.errors.get(fingerprint, 0) + 1
+
+    def report(self, out):
+        def percentile(values, fraction):
+            return values[min(len(values) - 1, int(fraction * len(values)))]
+        rows = []
+        for fingerprint, values in self.latencies.items():
+            values.sort()
+            rows.append((len(values), fingerprint, values))
+        rows.sort(reverse=True)
+        out.write("%8s %8s %9s %9s %9s %9s %9s  %s\n" %
+                  ("count", "errors", "mean ms", "p50 ms", "p90 ms", "p99 ms",
+                   "max ms", "query"))
+        for count, fingerprint, values in rows:
+            out.write("%8d %8d %9.3f %9.3f %9.3f %9.3f %9.3f  %s\n" %
+                      (count, self.errors.get(fingerprint, 0),
+                       1000 * sum(values) / count,
+                       1000 * percentile(values, 0.5),
+                       1000 * percentile(values, 0.9),
+                       1000 * percentile(values, 0.99),
+                       1000 * values[-1],
+                       fingerprint))
+
+class ReplayConnection(object):
+    """Sends the queries of one captured connection over a connection of its own
+    and times the responses on a thread that reads them."""
+
+    def __init__(self, host, port, auth_key, stats):
+        self.stats = stats
+        self.sock = socket.create_connection((host, port))
+        self.sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        auth_key = auth_key.encode("ascii")
+        self.sock.sendall(struct.pack("<L", p.VersionDummy.V0_2) +
+                          struct.pack("<L", len(auth_key)) + auth_key)
+        reply = b""
+        while not reply.endswith(b"\0"):
+            chunk = self.sock.recv(1024)
+            if not chunk:
+                raise RuntimeError("the server closed the connection")
+            reply += chunk
+        if reply != b"SUCCESS\0":
+            raise RuntimeError("the server refused the connection: %r" % reply)
+
+        self.cond = threading.Condition()
+        # The tokens that wait for their response; the fingerprint of the query
+        # that opened them, what to time them as and when they were sent.
+        self.in_flight = {}
+        # The fingerprints of the queries whose cursors are still open.
+        self.open_cursors = {}
+        self.closed = False
+        self.reader = threading.Thread(target=self.read_responses)
+        self.reader.daemon = True
+        self.reader.start()
+
+    def recv_exactly(self, size):
+        data = b""
+        while len(data) < size:
+            chunk = self.sock.recv(size - len(data))
+            if not chunk:
+                raise EOFError()
+            data += chunk
+        return data
+
+    def read_responses(self):
+        try:
+            while True:
+                size, = struct.unpack("<L", self.recv_exactly(4))
+                response = p.Response()
+                response.ParseFromString(self.recv_exactly(size))
+                now = time.time()
+                with self.cond:
+                    sent = self.in_flight.pop(response.token, None)
+                    if sent is None:
+                        continue
+                    fingerprint, label, start_time = sent
+                    if response.type == p.Response.SUCCESS_PARTIAL:
+                        self.open_cursors[response.token] = fingerprint
+                    else:
+                        self.open_cursors.pop(response.token, None)
+                    self.cond.notify_all()
+                error = response.type in (p.Response.CLIENT_ERROR,
+                                          p.Response.COMPILE_ERROR,
+                                          p.Response.RUNTIME_ERROR)
+                self.stats.record(label, now - start_time, error)
+        except (EOFError, socket.error):
+            pass
+        finally:
+            with self.cond:
+                self.closed = True
+                self.cond.notify_all()
+
+    def send(self, captured):
+        query = p.Query()
+        query.ParseFromString(captured.serialized)
+        token = captured.token
+        with self.cond:
+            # A CONTINUE or STOP goes after the response to the query before it,
+            # if the cursor is still open in the replay.
+            while token in self.in_flight and not self.closed:
+                self.cond.wait()
+            if self.closed:
+                return False
+            if query.type == p.Query.START:
+                fingerprint = query_fingerprint(query.query)
+                label = fingerprint
+                expects_response = not is_noreply(query)
+            elif token in self.open_cursors:
+                fingerprint = self.open_cursors[token]
+                label = "%s %s" % (p.Query.QueryType.Name(query.type), fingerprint)
+                expects_response = True
+            else:
+                return True
+            if expects_response:
+                self.in_flight[token] = (fingerprint, label, time.time())
+        self.sock.sendall(struct.pack("<L", len(captured.serialized)) +
+                          captured.serialized)
+        return True
+
+    def finish(self):
+        with self.cond:
+            while self.in_flight and not self.closed:
+                self.cond.wait()
+        self.sock.close()
+        self.reader.join()
+
+def replay_connection(queries, start_time, speed, connection):
+    first_microtime = queries[0].microtime
+    try:
+        for captured in queries:
+            if speed > 0:
+                due = start_time + (captured.microtime - first_microtime) / (speed * 1e6)
+                delay = due - time.time()
+                if delay > 0:
+                    time.sleep(delay)
+            if not connection.send(captured):
+                break
+    finally:
+        connection.finish()
+
+def main():
+    parser = optparse.OptionParser(usage="%prog [options] CAPTURE_FILE")
+    parser.add_option("--host", default="localhost:28015",
+                      help="the server to replay the queries on, as host:port")
+    parser.add_option("--auth-key", default="", help="the auth key of the server")
+    parser.add_option("--speed", type="float", default=1.0,
+                      help="how many times faster than the capture to send the "
+                           "queries, 0 to send them as fast as they're answered")
+    options, args = parser.parse_args()
+    if len(args) != 1:
+        parser.error("expected the capture file")
+    if options.speed < 0:
+        parser.error("--speed can't be negative")
+    host, _, port = options.host.rpartition(":")
+    if not host:
+        host, port = options.host, "28015"
+
+    queries = read_capture(args[0])
+    if not queries:
+        sys.stderr.write("%s has no queries\n" % args[0])
+        return 1
+    by_connection = {}
+    for captured in queries:
+        by_connection.setdefault(captured.connection_id, []).append(captured)
+
+    stats = LatencyStats()
+    connections = [ReplayConnection(host, int(port), options.auth_key, stats)
+                   for _ in by_connection]
+
+    start_time = time.time()
+    # Every connection is as late as its first query was in the capture.
+    first_microtime = queries[0].microtime
+    threads = []
+    for connection, connection_queries in zip(connections, by_connection.values()):
+        offset = 0.0
+        if options.speed > 0:
+            offset = (connection_queries[0].microtime - first_microtime) / (options.speed * 1e6)
+        thread = threading.Thread(target=replay_connection,
+                                  args=(connection_queries, start_time + offset,
+                                        options.speed, connection))
+        thread.daemon = True
+        thread.start()
+        threads.append(thread)
+    for thread in threads:
+        thread.join()
+
+    sys.stdout.write("Replayed %d queries of %d connections in %.3f s.\n" %
+                     (len(queries), len(by_connection), time.time() - start_time))
+    stats.report(sys.stdout)
+    return 0
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -25,85 +25,139 @@ void* blocker_pool_t::event_loop(void *arg) {
         guarantee_xerr(res == 0, res, "Could not block signal");
     }
 
+    // spawn_thread() counted us as idle already, so that jobs that come in before
+    // we start don't spawn more threads.
+    bool counted_as_idle = true;
     while (true) {
-        // Wait for an IO command or shutdown command. The while-loop guards against spurious
-        // wakeups.
-        system_mutex_t::lock_t or_lock(&parent->or_mutex);
-        while (parent->outstanding_requests.empty() && !parent->shutting_down) {
-            parent->or_cond.wait(&parent->or_mutex);
-        }
-
-        if (parent->shutting_down) {
-            // or_lock's destructor gets called, so everything is OK.
-            return NULL;
-
-        } else {
+        job_t *request;
+        {
+            system_mutex_t::lock_t or_lock(&parent->or_mutex);
+
+            // Wait for an IO command or shutdown command. The while-loop guards
+            // against spurious wakeups.  A thread the pool could do without gives up
+            // after a while of waiting.
+            if (!counted_as_idle) {
+                ++parent->num_idle_threads;
+            }
+            counted_as_idle = false;
+            while (parent->outstanding_requests.empty() && !parent->shutting_down) {
+                if (parent->num_threads > parent->min_threads) {
+                    const bool woken = parent->or_cond.timed_wait(
+                        &parent->or_mutex, BLOCKER_POOL_IDLE_THREAD_NANOS);
+                    if (!woken && parent->outstanding_requests.empty()
+                        && parent->num_threads > parent->min_threads) {
+                        break;
+                    }
+                } else {
+                    parent->or_cond.wait(&parent->or_mutex);
+                }
+            }
+            --parent->num_idle_threads;
+
+            if (parent->outstanding_requests.empty()) {
+                // We're shutting down, or idle beyond `min_threads`.  The destructor
+                // can't go on before or_lock's destructor releases the mutex, which is
+                // the last time we touch `parent`.
+                --parent->num_threads;
+                parent->exit_cond.signal();
+                return NULL;
+            }
 
             // Grab a request
-            job_t *request = parent->outstanding_requests.front();
-            parent->outstanding_requests.erase(parent->outstanding_requests.begin(),
-                                               parent->outstanding_requests.begin() + 1);
+            request = parent->outstanding_requests.front();
+            parent->outstanding_requests.pop_front();
 
-            // Unlock the mutex manually instead of waiting for its destructor so that other jobs
-            // will get to proceed
-            or_lock.unlock();
+            // or_lock's destructor releases the mutex here, so that other jobs will
+            // get to proceed
+        }
 
-            // Perform the request. It may block. This is the raison d'etre for blocker_pool_t.
-            request->run();
+        // Perform the request. It may block. This is the raison d'etre for blocker_pool_t.
+        request->run();
 
-            // Notify that the request is done
-            {
-                system_mutex_t::lock_t ce_lock(&parent->ce_mutex);
-                parent->completed_events.push_back(request);
-            }
-            // It seems critical for performance that we release ce_lock *before* we write to the signal!
-            // This is probably because the kernel thinks "hey, somebody is blocking on the signal.
-            // Now that it has been written to, that thread will want to handle it, so let's wake it up."
-            // If we don't have ce_lock released at that point, the following happens:
-            // The signalled thread immediately has to acquire ce_lock, so the kernel has to yield control
-            // again. Only after an additional scheduler roundtrip, we get control again and can release the ce_lock.
-            parent->ce_signal.wakey_wakey();
+        // Notify that the request is done
+        {
+            system_mutex_t::lock_t ce_lock(&parent->ce_mutex);
+            parent->completed_events.push_back(request);
         }
+        // It seems critical for performance that we release ce_lock *before* we write to the signal!
+        // This is probably because the kernel thinks "hey, somebody is blocking on the signal.
+        // Now that it has been written to, that thread will want to handle it, so let's wake it up."
+        // If we don't have ce_lock released at that point, the following happens:
+        // The signalled thread immediately has to acquire ce_lock, so the kernel has to yield control
+        // again. Only after an additional scheduler roundtrip, we get control again and can release the ce_lock.
+        parent->ce_signal.wakey_wakey();
     }
 }
 
 blocker_pool_t::blocker_pool_t(int nthreads, linux_event_queue_t *_queue)
-    : threads(nthreads), shutting_down(false), queue(_queue)
-{
-    // Start the worker threads
-    for (size_t i = 0; i < threads.size(); ++i) {
-        pthread_attr_t attr;
-        int res = pthread_attr_init(&attr);
-        guarantee_xerr(res == 0, res, "pthread_attr_init failed.");
-
-        // The coroutine stack size should be enough for blocker pool stacks.  Right
-        // now that's 128 KB.
-        static_assert(COROUTINE_STACK_SIZE == 131072,
-                      "Expecting COROUTINE_STACK_SIZE to be 131072.  If you changed "
-                      "it, please double-check whether the value is appropriate for "
-                      "blocker pool threads.");
-        // Disregard failure -- we'll just use the default stack size if this somehow
-        // fails.
-        UNUSED int ignored_res = pthread_attr_setstacksize(&attr, COROUTINE_STACK_SIZE);
-
-        res = pthread_create(&threads[i], &attr,
-            &blocker_pool_t::event_loop, reinterpret_cast<void*>(this));
-        guarantee_xerr(res == 0, res, "Could not create blocker-pool thread.");
-
-        res = pthread_attr_destroy(&attr);
-        guarantee_xerr(res == 0, res, "pthread_attr_destroy failed.");
+    : min_threads(nthreads), max_threads(nthreads),
+      num_threads(0), num_idle_threads(0),
+      shutting_down(false), queue(_queue) {
+    guarantee(nthreads > 0);
+    {
+        system_mutex_t::lock_t or_lock(&or_mutex);
+        for (int i = 0; i < min_threads; ++i) {
+            spawn_thread();
+        }
     }
 
     // Register with event queue so we get the completion events
     queue->watch_resource(ce_signal.get_notify_fd(), poll_event_in, this);
 }
 
+blocker_pool_t::blocker_pool_t(int _min_threads, int _max_threads,
+                               linux_event_queue_t *_queue)
+    : min_threads(_min_threads), max_threads(_max_threads),
+      num_threads(0), num_idle_threads(0),
+      shutting_down(false), queue(_queue) {
+    guarantee(min_threads > 0 && min_threads <= max_threads);
+    {
+        system_mutex_t::lock_t or_lock(&or_mutex);
+        for (int i = 0; i < min_threads; ++i) {
+            spawn_thread();
+        }
+    }
+
+    // Register with event queue so we get the completion events
+    queue->watch_resource(ce_signal.get_notify_fd(), poll_event_in, this);
+}
+
+void blocker_pool_t::spawn_thread() {
+    pthread_attr_t attr;
+    int res = pthread_attr_init(&attr);
+    guarantee_xerr(res == 0, res, "pthread_attr_init failed.");
+
+    // The coroutine stack size should be enough for blocker pool stacks.  Right
+    // now that's 128 KB.
+    static_assert(COROUTINE_STACK_SIZE == 131072,
+                  "Expecting COROUTINE_STACK_SIZE to be 131072.  If you changed "
+                  "it, please double-check whether the value is appropriate for "
+                  "blocker pool threads.");
+    // Disregard failure -- we'll just use the default stack size if this somehow
+    // fails.
+    UNUSED int ignored_res = pthread_attr_setstacksize(&attr, COROUTINE_STACK_SIZE);
+
+    // Threads come and go as the load does, so nobody joins them.
+    res = pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    guarantee_xerr(res == 0, res, "pthread_attr_setdetachstate failed.");
+
+    pthread_t thread;
+    res = pthread_create(&thread, &attr,
+        &blocker_pool_t::event_loop, reinterpret_cast<void*>(this));
+    guarantee_xerr(res == 0, res, "Could not create blocker-pool thread.");
+    ++num_threads;
+    ++num_idle_threads;
+
+    res = pthread_attr_destroy(&attr);
+    guarantee_xerr(res == 0, res, "pthread_attr_destroy failed.");
+}
+
 blocker_pool_t::~blocker_pool_t() {
 
     // Deregister with the event queue
     queue->forget_resource(ce_signal.get_notify_fd(), this);
 
-    /* Send out the order to shut down */
+    /* Send out the order to shut down, and wait for stuff to actually shut down */
     {
         system_mutex_t::lock_t or_lock(&or_mutex);
 
@@ -113,12 +167,10 @@ blocker_pool_t::~blocker_pool_t() {
         rassert(outstanding_requests.size() == 0);
 
         or_cond.broadcast();
-    }
 
-    /* Wait for stuff to actually shut down */
-    for (size_t i = 0; i < threads.size(); ++i) {
-        int res = pthread_join(threads[i], NULL);
-        guarantee_xerr(res == 0, res, "Could not join blocker-pool thread.");
+        while (num_threads > 0) {
+            exit_cond.wait(&or_mutex);
+        }
     }
 }
 
@@ -126,6 +178,11 @@ void blocker_pool_t::do_job(job_t *job) {
 
     system_mutex_t::lock_t or_lock(&or_mutex);
     outstanding_requests.push_back(job);
+    // The job would have to wait for a thread, so start another one if we may.
+    if (static_cast<int>(outstanding_requests.size()) > num_idle_threads
+        && num_threads < max_threads) {
+        spawn_thread();
+    }
     or_cond.signal();
 }
 
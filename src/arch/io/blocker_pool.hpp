@@ -4,15 +4,21 @@
 
 #include <pthread.h>
 
+#include <deque>
 #include <vector>
 
 #include "arch/runtime/event_queue.hpp"
 #include "arch/io/concurrency.hpp"
 #include "arch/runtime/system_event.hpp"
 
+/* A blocker pool runs jobs that block on threads outside of the main thread pool.
+It starts with `min_threads` threads, and adds threads up to `max_threads` while
+jobs wait for one.  A thread beyond the first `min_threads` goes away once it has
+been idle for BLOCKER_POOL_IDLE_THREAD_NANOS. */
 class blocker_pool_t : public linux_event_callback_t {
 public:
     blocker_pool_t(int nthreads, linux_event_queue_t *queue);
+    blocker_pool_t(int min_threads, int max_threads, linux_event_queue_t *queue);
     ~blocker_pool_t();
 
     struct job_t {
@@ -31,9 +37,20 @@ public:
 private:
     static void *event_loop(void*);
 
-    std::vector<pthread_t> threads;
+    // Starts another thread.  Must be called with `or_mutex` held.
+    void spawn_thread();
+
+    const int min_threads;
+    const int max_threads;
+    // The threads are detached.  These count the ones that are running, and how
+    // many of those are waiting for a job, under `or_mutex`.  The destructor waits
+    // on `exit_cond` for `num_threads` to drop to 0.
+    int num_threads;
+    int num_idle_threads;
+    system_cond_t exit_cond;
+
     bool shutting_down;
-    std::vector<job_t*> outstanding_requests;
+    std::deque<job_t*> outstanding_requests;
     system_mutex_t or_mutex;
     system_cond_t or_cond;
 
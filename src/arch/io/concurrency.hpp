@@ -2,7 +2,10 @@
 #ifndef ARCH_IO_CONCURRENCY_HPP_
 #define ARCH_IO_CONCURRENCY_HPP_
 
+#include <errno.h>
 #include <pthread.h>
+#include <stdint.h>
+#include <time.h>
 
 // Class that wraps a pthread mutex
 class system_mutex_t {
@@ -53,6 +56,21 @@ public:
         int res = pthread_cond_wait(&c, &mutex->m);
         guarantee_xerr(res == 0, res, "Could not wait on pthread cond.");
     }
+    // Like wait(), but gives up after `nanos`.  Returns false if it timed out.
+    bool timed_wait(system_mutex_t *mutex, int64_t nanos) {
+        timespec deadline;
+        int res = clock_gettime(CLOCK_REALTIME, &deadline);
+        guarantee_err(res == 0, "clock_gettime(CLOCK_REALTIME) failed");
+        const int64_t total = deadline.tv_nsec + nanos;
+        deadline.tv_sec += total / 1000000000;
+        deadline.tv_nsec = total % 1000000000;
+        res = pthread_cond_timedwait(&c, &mutex->m, &deadline);
+        if (res == ETIMEDOUT) {
+            return false;
+        }
+        guarantee_xerr(res == 0, res, "Could not wait on pthread cond.");
+        return true;
+    }
     void signal() {
         int res = pthread_cond_signal(&c);
         guarantee_xerr(res == 0, res, "Could not signal pthread cond.");
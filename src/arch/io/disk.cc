@@ -18,7 +18,9 @@
 #include "arch/runtime/runtime.hpp"
 #include "arch/io/disk/filestat.hpp"
 #include "arch/io/disk/pool.hpp"
+#include "arch/io/disk/uring.hpp"
 #include "arch/io/disk/conflict_resolving.hpp"
+#include "arch/io/disk/merging.hpp"
 #include "arch/io/disk/stats.hpp"
 #include "arch/io/disk/accounting.hpp"
 #include "do_on_thread.hpp"
@@ -45,27 +47,47 @@ public:
     linux_disk_manager_t(linux_event_queue_t *queue,
                          int batch_factor,
                          int max_concurrent_io_requests,
+                         io_backend_t backend,
+                         ticks_t target_read_latency,
                          perfmon_collection_t *stats) :
         stack_stats(stats, "stack"),
         conflict_resolver(stats),
-        accounter(batch_factor),
+        merger(stats),
+        accounter(batch_factor, target_read_latency, stats),
         backend_stats(stats, "backend", accounter.producer),
-        backend(queue, backend_stats.producer, max_concurrent_io_requests),
         outstanding_txn(0)
     {
+        if (backend == io_backend_t::io_uring_desired) {
+            if (uring_diskmgr_t::is_supported()) {
+                uring_backend.init(new uring_diskmgr_t(queue, backend_stats.producer,
+                                                       max_concurrent_io_requests));
+                uring_backend->done_fun = std::bind(&stats_diskmgr_2_t::done,
+                                                    &backend_stats, _1);
+            } else {
+                logWRN("io_uring is not available, falling back to the thread pool "
+                       "I/O backend.");
+            }
+        }
+        if (!uring_backend.has()) {
+            pool_backend.init(new pool_diskmgr_t(queue, backend_stats.producer,
+                                                 max_concurrent_io_requests, stats));
+            pool_backend->done_fun = std::bind(&stats_diskmgr_2_t::done, &backend_stats, _1);
+        }
+
         /* Hook up the `submit_fun`s of the parts of the IO stack that are above the
         queue. (The parts below the queue use the `passive_producer_t` interface instead
         of a callback function.) */
         stack_stats.submit_fun = std::bind(&conflict_resolving_diskmgr_t::submit,
                                            &conflict_resolver, _1);
-        conflict_resolver.submit_fun = std::bind(&accounting_diskmgr_t::submit,
-                                                 &accounter, _1);
+        conflict_resolver.submit_fun = std::bind(&merging_diskmgr_t::submit,
+                                                 &merger, _1);
+        merger.submit_fun = std::bind(&accounting_diskmgr_t::submit, &accounter, _1);
 
-        /* Hook up everything's `done_fun`. */
-        backend.done_fun = std::bind(&stats_diskmgr_2_t::done, &backend_stats, _1);
+        /* Hook up everything's `done_fun`. (The backend's is hooked up above.) */
         backend_stats.done_fun = std::bind(&accounting_diskmgr_t::done, &accounter, _1);
-        accounter.done_fun = std::bind(&conflict_resolving_diskmgr_t::done,
-                                       &conflict_resolver, _1);
+        accounter.done_fun = std::bind(&merging_diskmgr_t::done, &merger, _1);
+        merger.done_fun = std::bind(&conflict_resolving_diskmgr_t::done,
+                                    &conflict_resolver, _1);
         conflict_resolver.done_fun = std::bind(&stats_diskmgr_t::done, &stack_stats, _1);
         stack_stats.done_fun = std::bind(&linux_disk_manager_t::done, this, _1);
     }
@@ -74,8 +96,10 @@ public:
         rassert(outstanding_txn == 0, "Closing a file with outstanding txns\n");
     }
 
-    void *create_account(int pri, int outstanding_requests_limit) {
-        return new accounting_diskmgr_t::account_t(&accounter, pri, outstanding_requests_limit);
+    void *create_account(int pri, int outstanding_requests_limit, io_class_t io_class,
+                         io_activity_stats_t *activity_stats) {
+        return new accounting_diskmgr_t::account_t(&accounter, pri, outstanding_requests_limit,
+                                                   io_class, activity_stats);
     }
 
     void delayed_destroy(void *_account) {
@@ -94,13 +118,14 @@ public:
         stack_stats.submit(a);
     }
 
-    void submit_write(fd_t fd, const void *buf, size_t count, int64_t offset,
-                      void *account, linux_iocallback_t *cb,
+    void submit_write(fd_t fd, uint64_t device, const void *buf, size_t count,
+                      int64_t offset, void *account, linux_iocallback_t *cb,
                       bool wrap_in_datasyncs) {
         threadnum_t calling_thread = get_thread_id();
 
         action_t *a = new action_t(calling_thread, cb);
         a->make_write(fd, buf, count, offset, wrap_in_datasyncs);
+        a->set_device(device);
         a->account = static_cast<accounting_diskmgr_t::account_t *>(account);
 
         do_on_thread(home_thread(),
@@ -111,12 +136,14 @@ public:
 #ifndef USE_WRITEV
 #error "USE_WRITEV not defined.  Did you include pool.hpp?"
 #elif USE_WRITEV
-    void submit_writev(fd_t fd, scoped_array_t<iovec> &&bufs, size_t count,
-                       int64_t offset, void *account, linux_iocallback_t *cb) {
+    void submit_writev(fd_t fd, uint64_t device, scoped_array_t<iovec> &&bufs,
+                       size_t count, int64_t offset, void *account,
+                       linux_iocallback_t *cb) {
         threadnum_t calling_thread = get_thread_id();
 
         action_t *a = new action_t(calling_thread, cb);
         a->make_writev(fd, std::move(bufs), count, offset);
+        a->set_device(device);
         a->account = static_cast<accounting_diskmgr_t::account_t *>(account);
 
         do_on_thread(home_thread(),
@@ -125,11 +152,13 @@ public:
     }
 #endif  // USE_WRITEV
 
-    void submit_read(fd_t fd, void *buf, size_t count, int64_t offset, void *account, linux_iocallback_t *cb) {
+    void submit_read(fd_t fd, uint64_t device, void *buf, size_t count, int64_t offset,
+                     void *account, linux_iocallback_t *cb) {
         threadnum_t calling_thread = get_thread_id();
 
         action_t *a = new action_t(calling_thread, cb);
         a->make_read(fd, buf, count, offset);
+        a->set_device(device);
         a->account = static_cast<accounting_diskmgr_t::account_t*>(account);
 
         do_on_thread(home_thread(),
@@ -160,9 +189,12 @@ private:
     action_t object for each operation and record its callback. Then it passes through
     the conflict resolver, which enforces ordering constraints between IO operations by
     holding back operations that must be run after other, currently-running, operations.
+    The merger then runs operations that are next to each other in the file as one.
     Then it goes to the account manager, which queues up running IO operations according
     to which account they are part of. Finally the "backend" pops the IO operations
-    from the queue.
+    from the queue. The backend is either a pool_diskmgr_t, which runs blocking
+    calls on a thread pool, or a uring_diskmgr_t, which submits them to the kernel
+    through io_uring; exactly one of `pool_backend` and `uring_backend` is set.
 
     At two points in the process--once as soon as it is submitted, and again right
     as the backend pops it off the queue--its statistics are recorded. The "stack stats"
@@ -173,9 +205,11 @@ private:
 
     stats_diskmgr_t stack_stats;
     conflict_resolving_diskmgr_t conflict_resolver;
+    merging_diskmgr_t merger;
     accounting_diskmgr_t accounter;
     stats_diskmgr_2_t backend_stats;
-    pool_diskmgr_t backend;
+    scoped_ptr_t<pool_diskmgr_t> pool_backend;
+    scoped_ptr_t<uring_diskmgr_t> uring_backend;
 
 
     int outstanding_txn;
@@ -184,11 +218,15 @@ private:
 };
 
 io_backender_t::io_backender_t(file_direct_io_mode_t _direct_io_mode,
-                               int max_concurrent_io_requests)
+                               int max_concurrent_io_requests,
+                               io_backend_t backend,
+                               int64_t target_read_latency_nanos)
     : direct_io_mode(_direct_io_mode),
       diskmgr(new linux_disk_manager_t(&linux_thread_pool_t::thread->queue,
                                        DEFAULT_IO_BATCH_FACTOR,
                                        max_concurrent_io_requests,
+                                       backend,
+                                       target_read_latency_nanos,
                                        &stats)) { }
 
 io_backender_t::~io_backender_t() { }
@@ -199,7 +237,12 @@ file_direct_io_mode_t io_backender_t::get_direct_io_mode() const { return direct
 /* Disk file object */
 
 linux_file_t::linux_file_t(scoped_fd_t &&_fd, int64_t _file_size, linux_disk_manager_t *_diskmgr)
-    : fd(std::move(_fd)), file_size(_file_size), diskmgr(_diskmgr) {
+    : fd(std::move(_fd)), file_size(_file_size), device(0), diskmgr(_diskmgr) {
+    struct stat st;
+    const int stat_res = fstat(fd.get(), &st);
+    guarantee_err(stat_res == 0, "fstat failed");
+    device = st.st_dev;
+
     // TODO: Why do we care whether we're in a thread pool?  (Maybe it's that you can't create a
     // file_account_t outside of the thread pool?  But they're associated with the diskmgr,
     // aren't they?)
@@ -233,10 +276,29 @@ void linux_file_t::set_size_at_least(int64_t size) {
     }
 }
 
+bool linux_file_t::discard(int64_t offset, int64_t length) {
+    rassert(offset >= 0 && length >= 0 && offset + length <= file_size);
+#if defined(__linux__) && defined(FALLOC_FL_PUNCH_HOLE)
+    int res;
+    do {
+        res = fallocate(fd.get(), FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, offset, length);
+    } while (res == -1 && errno == EINTR);
+    if (res == -1) {
+        guarantee_err(errno == EOPNOTSUPP || errno == ENOSYS, "Could not fallocate()");
+        return false;
+    }
+    return true;
+#else
+    (void)offset;
+    (void)length;
+    return false;
+#endif
+}
+
 void linux_file_t::read_async(int64_t offset, size_t length, void *buf, file_account_t *account, linux_iocallback_t *callback) {
     rassert(diskmgr, "No diskmgr has been constructed (are we running without an event queue?)");
     verify_aligned_file_access(file_size, offset, length, buf);
-    diskmgr->submit_read(fd.get(), buf, length, offset,
+    diskmgr->submit_read(fd.get(), device, buf, length, offset,
         account == DEFAULT_DISK_ACCOUNT ? default_account->get_account() : account->get_account(),
         callback);
 }
@@ -246,7 +308,7 @@ void linux_file_t::write_async(int64_t offset, size_t length, const void *buf,
                                wrap_in_datasyncs_t wrap_in_datasyncs) {
     rassert(diskmgr, "No diskmgr has been constructed (are we running without an event queue?)");
     verify_aligned_file_access(file_size, offset, length, buf);
-    diskmgr->submit_write(fd.get(), buf, length, offset,
+    diskmgr->submit_write(fd.get(), device, buf, length, offset,
                           account == DEFAULT_DISK_ACCOUNT ? default_account->get_account() : account->get_account(),
                           callback,
                           wrap_in_datasyncs == WRAP_IN_DATASYNCS);
@@ -262,7 +324,7 @@ void linux_file_t::writev_async(int64_t offset, size_t length,
 #ifndef USE_WRITEV
 #error "USE_WRITEV not defined.  Did you include pool.hpp?"
 #elif USE_WRITEV
-    diskmgr->submit_writev(fd.get(), std::move(bufs), length, offset,
+    diskmgr->submit_writev(fd.get(), device, std::move(bufs), length, offset,
                            account == DEFAULT_DISK_ACCOUNT
                            ? default_account->get_account()
                            : account->get_account(),
@@ -295,7 +357,7 @@ void linux_file_t::writev_async(int64_t offset, size_t length,
     int64_t partial_offset = offset;
     for (size_t i = 0; i < bufs.size(); ++i) {
         ++intermediate_cb->refcount;
-        diskmgr->submit_write(fd.get(), bufs[i].iov_base, bufs[i].iov_len,
+        diskmgr->submit_write(fd.get(), device, bufs[i].iov_base, bufs[i].iov_len,
                               partial_offset, account == DEFAULT_DISK_ACCOUNT
                               ? default_account->get_account()
                               : account->get_account(),
@@ -319,8 +381,11 @@ bool linux_file_t::coop_lock_and_check() {
     return true;
 }
 
-void *linux_file_t::create_account(int priority, int outstanding_requests_limit) {
-    return diskmgr->create_account(priority, outstanding_requests_limit);
+void *linux_file_t::create_account(int priority, int outstanding_requests_limit,
+                                   io_class_t io_class,
+                                   io_activity_stats_t *activity_stats) {
+    return diskmgr->create_account(priority, outstanding_requests_limit, io_class,
+                                   activity_stats);
 }
 
 void linux_file_t::destroy_account(void *account) {
@@ -27,8 +27,12 @@ public:
     // This takes what is effectively a global flag whether to use O_DIRECT here.  Nothing technical
     // stops us from specifying this on a file-by-file basis, but right now there's no desire for
     // that.  See https://github.com/rethinkdb/rethinkdb/issues/97#issuecomment-19778177 .
+    // With a target_read_latency_nanos, the disk manager holds back background I/O
+    // while foreground reads take longer than that, see accounting_diskmgr_t.
     io_backender_t(file_direct_io_mode_t direct_io_mode,
-                   int max_concurrent_io_requests = DEFAULT_MAX_CONCURRENT_IO_REQUESTS);
+                   int max_concurrent_io_requests = DEFAULT_MAX_CONCURRENT_IO_REQUESTS,
+                   io_backend_t backend = io_backend_t::pool,
+                   int64_t target_read_latency_nanos = 0);
     ~io_backender_t();
     linux_disk_manager_t *get_diskmgr_ptr() { return diskmgr.get(); }
     file_direct_io_mode_t get_direct_io_mode() const;
@@ -71,6 +75,7 @@ public:
     int64_t get_size();
     void set_size(int64_t size);
     void set_size_at_least(int64_t size);
+    MUST_USE bool discard(int64_t offset, int64_t length);
 
     void read_async(int64_t offset, size_t length, void *buf, file_account_t *account, linux_iocallback_t *cb);
     void write_async(int64_t offset, size_t length, const void *buf, file_account_t *account, linux_iocallback_t *cb,
@@ -82,7 +87,8 @@ public:
 
     bool coop_lock_and_check();
 
-    void *create_account(int priority, int outstanding_requests_limit);
+    void *create_account(int priority, int outstanding_requests_limit,
+                         io_class_t io_class, io_activity_stats_t *activity_stats);
     void destroy_account(void *account);
 
     ~linux_file_t();
@@ -95,6 +101,8 @@ private:
 
     scoped_fd_t fd;
     int64_t file_size;
+    // The device the file is on, for the disk manager to tell devices apart.
+    uint64_t device;
 
     linux_disk_manager_t *diskmgr;
 
@@ -1,15 +1,25 @@
 #include "arch/io/disk/accounting.hpp"
 
+#include <algorithm>
+
+#include "config/args.hpp"
+
 /* Each account on the `accounting_diskmgr_t` has its own
    `unlimited_fifo_queue_t` associated with it. Operations for that account
    queue up on that queue while they wait for the `accounting_queue_t` on the
-   `accounting_diskmgr_t` to draw from that account. */
+   `accounting_diskmgr_t` to draw from that account. The operations of a
+   background account first wait for the `accounting_diskmgr_t`'s
+   `background_limiter` if it holds back background requests. */
 struct accounting_diskmgr_eager_account_t : public semaphore_available_callback_t {
     typedef accounting_diskmgr_action_t action_t;
 
-    accounting_diskmgr_eager_account_t(accounting_diskmgr_t *par,
+    accounting_diskmgr_eager_account_t(accounting_diskmgr_t *_par,
                                        int pri,
-                                       int outstanding_requests_limit) :
+                                       int outstanding_requests_limit,
+                                       io_class_t io_class) :
+        par(_par),
+        held_back(io_class == io_class_t::background && par->holds_back_background()),
+        background_admitter(this),
         outstanding_requests_limiter(outstanding_requests_limit == UNLIMITED_OUTSTANDING_REQUESTS ? SEMAPHORE_NO_LIMIT : outstanding_requests_limit),
         account(&par->queue, &queue, pri),
         accounter_lock(par->get_auto_drainer()) {
@@ -23,13 +33,33 @@ struct accounting_diskmgr_eager_account_t : public semaphore_available_callback_
     void on_semaphore_available() {
         action_t *action = throttled_queue.head();
         throttled_queue.pop_front();
-        queue.push(action);
+        if (held_back) {
+            held_back_queue.push_back(action);
+            par->background_limiter.lock(&background_admitter, 1);
+        } else {
+            queue.push(action);
+        }
     }
     semaphore_t *get_outstanding_requests_limiter() {
         return &outstanding_requests_limiter;
     }
 
 private:
+    struct background_admitter_t : public semaphore_available_callback_t {
+        explicit background_admitter_t(accounting_diskmgr_eager_account_t *_parent)
+            : parent(_parent) { }
+        void on_semaphore_available() {
+            action_t *action = parent->held_back_queue.head();
+            parent->held_back_queue.pop_front();
+            parent->queue.push(action);
+        }
+        accounting_diskmgr_eager_account_t *parent;
+    };
+
+    accounting_diskmgr_t *par;
+    const bool held_back;
+    background_admitter_t background_admitter;
+
     // It would be nice if we could just use a limited_fifo_queue to
     // implement the limitation of outstanding requests.
     // However this part of the code must not rely on coroutines, therefore
@@ -37,6 +67,8 @@ private:
     // throttled_queue contains requests which can not be put on queue right now,
     // because the number of outstanding requests has been exceeded
     intrusive_list_t<action_t> throttled_queue;
+    // held_back_queue contains requests which wait for the background_limiter
+    intrusive_list_t<action_t> held_back_queue;
     unlimited_fifo_queue_t<action_t *, intrusive_list_t<action_t> > queue;
     static_semaphore_t outstanding_requests_limiter;
     accounting_queue_t<action_t *>::account_t account;
@@ -45,11 +77,27 @@ private:
     DISABLE_COPYING(accounting_diskmgr_eager_account_t);
 };
 
+accounting_diskmgr_account_stats_t::accounting_diskmgr_account_stats_t(
+        perfmon_collection_t *stats, const std::string &name) :
+    collection_membership(stats, &collection, name),
+    wait_time(IO_LATENCY_HISTOGRAM_FIRST_BOUND_SECS),
+    latency(IO_LATENCY_HISTOGRAM_FIRST_BOUND_SECS),
+    latency_percentiles(secs_to_ticks(LATENCY_PERCENTILES_INTERVAL_SECS),
+                        LATENCY_PERCENTILES_RESOLUTION_SECS),
+    stats_membership(&collection,
+                     &wait_time, "wait_time",
+                     &latency, "latency",
+                     &latency_percentiles, "latency_percentiles",
+                     NULLPTR) { }
+
 accounting_diskmgr_account_t::accounting_diskmgr_account_t(accounting_diskmgr_t *_par,
                                                            int _pri,
-                                                           int _outstanding_requests_limit)
+                                                           int _outstanding_requests_limit,
+                                                           io_class_t _io_class,
+                                                           io_activity_stats_t *_activity_stats)
         : par(_par), pri(_pri),
-          outstanding_requests_limit(_outstanding_requests_limit) { }
+          outstanding_requests_limit(_outstanding_requests_limit),
+          io_class(_io_class), activity_stats(_activity_stats), stats(NULL) { }
 
 accounting_diskmgr_account_t::~accounting_diskmgr_account_t() {
     par->assert_thread();
@@ -70,10 +118,17 @@ semaphore_t *accounting_diskmgr_account_t::get_outstanding_requests_limiter() {
     return eager_account->get_outstanding_requests_limiter();
 }
 
+accounting_diskmgr_account_stats_t *accounting_diskmgr_account_t::get_stats() {
+    maybe_init();
+    return stats;
+}
+
 void accounting_diskmgr_account_t::maybe_init(){
     if (!eager_account.has()) {
         par->assert_thread();
-        eager_account.init(new eager_account_t(par, pri, outstanding_requests_limit));
+        eager_account.init(new eager_account_t(par, pri, outstanding_requests_limit,
+                                               io_class));
+        stats = par->get_account_stats(pri, io_class);
     }
 }
 
@@ -88,19 +143,122 @@ void debug_print(printf_buffer_t *buf,
     debug_print(buf, parent_action);
 }
 
+accounting_payload_t *accounting_dispatcher_t::produce_next_value() {
+    accounting_diskmgr_action_t *a = source->pop();
+    a->dispatch_time = get_ticks();
+    return a;
+}
+
+
+accounting_diskmgr_t::accounting_diskmgr_t(int batch_factor,
+                                           ticks_t _target_read_latency,
+                                           perfmon_collection_t *_stats)
+    : producer(&dispatcher),
+      queue(batch_factor),
+      dispatcher(&queue),
+      target_read_latency(_target_read_latency),
+      background_limiter(holds_back_background()
+                         ? IO_SCHEDULER_MAX_BACKGROUND_REQUESTS
+                         : SEMAPHORE_NO_LIMIT),
+      background_window(IO_SCHEDULER_MAX_BACKGROUND_REQUESTS),
+      foreground_read_latency(0),
+      last_foreground_read(0),
+      last_background_cut(0),
+      stats(_stats),
+      scheduler_membership(stats, &scheduler_collection, "io_scheduler"),
+      scheduler_stats_membership(&scheduler_collection,
+                                 &background_limit, "background_limit",
+                                 &background_cuts, "background_cuts",
+                                 NULLPTR),
+      auto_drainer(new auto_drainer_t()) {
+    if (holds_back_background()) {
+        background_limit += IO_SCHEDULER_MAX_BACKGROUND_REQUESTS;
+    }
+}
 
 accounting_diskmgr_t::~accounting_diskmgr_t() {
     auto_drainer.reset();  // Make absolutely sure this happens first.
 }
 
 void accounting_diskmgr_t::submit(action_t *a) {
+    a->submit_time = get_ticks();
     a->account->push(a);
 }
 
 void accounting_diskmgr_t::done(accounting_payload_t *p) {
     // p really is an action_t...
     action_t *a = static_cast<action_t *>(p);
+    const ticks_t now = get_ticks();
+    accounting_diskmgr_account_stats_t *s = a->account->get_stats();
+    s->wait_time.record(ticks_to_secs(a->dispatch_time - a->submit_time));
+    s->latency.record(ticks_to_secs(now - a->dispatch_time));
+    s->latency_percentiles.record(ticks_to_secs(now - a->dispatch_time));
+    if (a->account->get_activity_stats() != NULL) {
+        a->account->get_activity_stats()->record(a->get_is_read(), a->get_count(),
+                                                 now - a->submit_time);
+    }
+
     a->account->get_outstanding_requests_limiter()->unlock(1);
+    if (holds_back_background()) {
+        if (a->account->get_io_class() == io_class_t::background) {
+            on_background_done(now);
+        } else if (a->get_is_read()) {
+            on_foreground_read_done(now - a->submit_time, now);
+        }
+    }
     done_fun(static_cast<action_t *>(p));
 }
 
+accounting_diskmgr_account_stats_t *accounting_diskmgr_t::get_account_stats(
+        int pri, io_class_t io_class) {
+    assert_thread();
+    scoped_ptr_t<accounting_diskmgr_account_stats_t> *s =
+        &account_stats[std::make_pair(pri, io_class)];
+    if (!s->has()) {
+        s->init(new accounting_diskmgr_account_stats_t(
+            stats,
+            strprintf(io_class == io_class_t::background
+                      ? "background_account_%d" : "account_%d", pri)));
+    }
+    return s->get();
+}
+
+void accounting_diskmgr_t::on_foreground_read_done(ticks_t latency, ticks_t now) {
+    if (now - last_foreground_read > IO_SCHEDULER_FOREGROUND_IDLE_NANOS) {
+        foreground_read_latency = latency;
+    } else {
+        foreground_read_latency +=
+            (latency - foreground_read_latency) / IO_SCHEDULER_LATENCY_SMOOTHING;
+    }
+    last_foreground_read = now;
+
+    // Reads that are already queued still see the old number of background
+    // requests, so we wait for them before we cut again.
+    if (foreground_read_latency > target_read_latency
+        && now - last_background_cut >= target_read_latency) {
+        last_background_cut = now;
+        ++background_cuts;
+        set_background_window(std::max<double>(IO_SCHEDULER_MIN_BACKGROUND_REQUESTS,
+                                               background_window / 2));
+    }
+}
+
+void accounting_diskmgr_t::on_background_done(ticks_t now) {
+    background_limiter.unlock(1);
+    if (now - last_foreground_read > IO_SCHEDULER_FOREGROUND_IDLE_NANOS
+        || foreground_read_latency <= target_read_latency) {
+        // That's about one more per window's worth of finished requests.
+        set_background_window(std::min<double>(IO_SCHEDULER_MAX_BACKGROUND_REQUESTS,
+                                               background_window + 1 / background_window));
+    }
+}
+
+void accounting_diskmgr_t::set_background_window(double window) {
+    const int old_limit = static_cast<int>(background_window);
+    const int new_limit = static_cast<int>(window);
+    background_window = window;
+    if (new_limit != old_limit) {
+        background_limit += new_limit - old_limit;
+        background_limiter.set_capacity(new_limit);
+    }
+}
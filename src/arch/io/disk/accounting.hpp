@@ -2,6 +2,10 @@
 #ifndef ARCH_IO_DISK_ACCOUNTING_HPP_
 #define ARCH_IO_DISK_ACCOUNTING_HPP_
 
+#include <map>
+#include <string>
+#include <utility>
+
 #include "errors.hpp"
 #include <boost/function.hpp>
 
@@ -12,28 +16,18 @@
 #include "concurrency/queue/unlimited_fifo.hpp"
 #include "concurrency/semaphore.hpp"
 #include "arch/io/disk.hpp"
+#include "arch/io/disk/activity_stats.hpp"
 #include "arch/io/disk/stats_2.hpp"
-
-/* `casting_passive_producer_t` is useful when you have a
-`passive_producer_t<X>` but you need a `passive_producer_t<Y>`, where `X` can
-be cast to `Y`. */
-
-template <class input_t, class output_t>
-struct casting_passive_producer_t : public passive_producer_t<output_t> {
-    explicit casting_passive_producer_t(passive_producer_t<input_t> *_source) :
-        passive_producer_t<output_t>(_source->available), source(_source) { }
-
-    output_t produce_next_value() {
-        /* Implicit cast from `input_t` to `output_t` in return */
-        return source->pop();
-    }
-
-private:
-    passive_producer_t<input_t> *source;
-};
+#include "perfmon/perfmon.hpp"
 
 /* `accounting_diskmgr_t` shares disk throughput proportionally between a
-number of different "accounts". */
+number of different "accounts".
+
+It can also be given a target latency for foreground reads. Then it holds back
+the requests of background accounts (see `io_class_t`) while foreground reads
+take longer than that: only a limited number of background requests may be
+queued or running at once, and the limit shrinks while reads are too slow and
+grows back while they aren't. See IO_SCHEDULER_LATENCY_SMOOTHING. */
 
 typedef stats_diskmgr_2_t::action_t accounting_payload_t;
 
@@ -43,18 +37,39 @@ struct accounting_diskmgr_action_t;
 
 struct accounting_diskmgr_eager_account_t;
 
+/* The statistics of the accounts with a given priority and `io_class_t`: how long
+(in seconds) their requests waited in `accounting_diskmgr_t`'s queues, and how long
+the backend then took to run them, also as recent percentiles. */
+struct accounting_diskmgr_account_stats_t {
+    accounting_diskmgr_account_stats_t(perfmon_collection_t *stats,
+                                       const std::string &name);
+
+    perfmon_collection_t collection;
+    perfmon_membership_t collection_membership;
+
+    perfmon_histogram_t wait_time, latency;
+    perfmon_hdr_histogram_t latency_percentiles;
+    perfmon_multi_membership_t stats_membership;
+};
+
 struct accounting_diskmgr_account_t {
     typedef accounting_diskmgr_action_t action_t;
 
     accounting_diskmgr_account_t(accounting_diskmgr_t *_par,
                                  int _pri,
-                                 int _outstanding_requests_limit);
+                                 int _outstanding_requests_limit,
+                                 io_class_t _io_class,
+                                 io_activity_stats_t *_activity_stats);
 
     ~accounting_diskmgr_account_t();
 
     void push(action_t *action);
     void on_semaphore_available();
     semaphore_t *get_outstanding_requests_limiter();
+    accounting_diskmgr_account_stats_t *get_stats();
+    io_class_t get_io_class() const { return io_class; }
+    // May be NULL.
+    io_activity_stats_t *get_activity_stats() { return activity_stats; }
 
 private:
     typedef accounting_diskmgr_eager_account_t eager_account_t;
@@ -64,7 +79,10 @@ private:
     accounting_diskmgr_t *par;
     int pri;
     int outstanding_requests_limit;
+    io_class_t io_class;
+    io_activity_stats_t *activity_stats;
     scoped_ptr_t<eager_account_t> eager_account;
+    accounting_diskmgr_account_stats_t *stats;
 
     DISABLE_COPYING(accounting_diskmgr_account_t);
 };
@@ -73,18 +91,32 @@ struct accounting_diskmgr_action_t
     : public intrusive_list_node_t<accounting_diskmgr_action_t>,
       public accounting_payload_t {
     accounting_diskmgr_account_t *account;
+    // When the action came to the `accounting_diskmgr_t`, and when it left for the
+    // backend.
+    ticks_t submit_time, dispatch_time;
 };
 
 void debug_print(printf_buffer_t *buf,
                  const accounting_diskmgr_action_t &action);
 
+/* `accounting_dispatcher_t` passes on the actions that the `accounting_queue_t`
+picks as `accounting_payload_t`s, and notes when it does. */
+struct accounting_dispatcher_t : public passive_producer_t<accounting_payload_t *> {
+    explicit accounting_dispatcher_t(passive_producer_t<accounting_diskmgr_action_t *> *_source) :
+        passive_producer_t<accounting_payload_t *>(_source->available), source(_source) { }
+
+    accounting_payload_t *produce_next_value();
+
+private:
+    passive_producer_t<accounting_diskmgr_action_t *> *source;
+};
+
 class accounting_diskmgr_t : public home_thread_mixin_t {
 public:
-    explicit accounting_diskmgr_t(int batch_factor)
-        : producer(&caster),
-          queue(batch_factor),
-          caster(&queue),
-          auto_drainer(new auto_drainer_t()) { }
+    // A `target_read_latency` of 0 means that background accounts are never held
+    // back.
+    accounting_diskmgr_t(int batch_factor, ticks_t target_read_latency,
+                         perfmon_collection_t *stats);
 
     ~accounting_diskmgr_t();
 
@@ -104,10 +136,35 @@ public:
     }
 
 private:
+    friend struct accounting_diskmgr_account_t;
     friend struct accounting_diskmgr_eager_account_t;
 
+    bool holds_back_background() const { return target_read_latency > 0; }
+    accounting_diskmgr_account_stats_t *get_account_stats(int pri, io_class_t io_class);
+    void on_foreground_read_done(ticks_t latency, ticks_t now);
+    void on_background_done(ticks_t now);
+    void set_background_window(double window);
+
     accounting_queue_t<action_t *> queue;
-    casting_passive_producer_t<action_t *, accounting_payload_t *> caster;
+    accounting_dispatcher_t dispatcher;
+
+    const ticks_t target_read_latency;
+    // Limits the background requests that are queued or running.  Its capacity is
+    // `background_window`, rounded down.
+    adjustable_semaphore_t background_limiter;
+    double background_window;
+    // The moving average of the foreground reads' latency, in ticks.
+    double foreground_read_latency;
+    ticks_t last_foreground_read, last_background_cut;
+
+    perfmon_collection_t *stats;
+    perfmon_collection_t scheduler_collection;
+    perfmon_membership_t scheduler_membership;
+    perfmon_counter_t background_limit, background_cuts;
+    perfmon_multi_membership_t scheduler_stats_membership;
+    std::map<std::pair<int, io_class_t>, scoped_ptr_t<accounting_diskmgr_account_stats_t> >
+        account_stats;
+
     scoped_ptr_t<auto_drainer_t> auto_drainer;
 
     DISABLE_COPYING(accounting_diskmgr_t);
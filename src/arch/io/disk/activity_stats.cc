@@ -0,0 +1,58 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "arch/io/disk/activity_stats.hpp"
+
+#include "config/args.hpp"
+
+const char *io_activity_name(io_activity_t activity) {
+    switch (activity) {
+    case io_activity_t::query_reads: return "query_reads";
+    case io_activity_t::writeback: return "writeback";
+    case io_activity_t::gc: return "gc";
+    case io_activity_t::lba_gc: return "lba_gc";
+    case io_activity_t::backfill: return "backfill";
+    case io_activity_t::sindex_build: return "sindex_build";
+    case io_activity_t::warmup: return "warmup";
+    case io_activity_t::scrub: return "scrub";
+    case io_activity_t::backup: return "backup";
+    case io_activity_t::other: return "other";
+    default: unreachable();
+    }
+}
+
+io_activity_stats_t::io_activity_stats_t(perfmon_collection_t *parent,
+                                         io_activity_t activity) :
+    collection_membership(parent, &collection, io_activity_name(activity)),
+    latency_percentiles(secs_to_ticks(LATENCY_PERCENTILES_INTERVAL_SECS),
+                        LATENCY_PERCENTILES_RESOLUTION_SECS),
+    stats_membership(&collection,
+                     &reads, "reads",
+                     &writes, "writes",
+                     &bytes_read, "bytes_read",
+                     &bytes_written, "bytes_written",
+                     &latency_percentiles, "latency_percentiles",
+                     NULLPTR) { }
+
+void io_activity_stats_t::record(bool is_read, int64_t bytes, ticks_t latency) {
+    if (is_read) {
+        ++reads;
+        bytes_read += bytes;
+    } else {
+        ++writes;
+        bytes_written += bytes;
+    }
+    latency_percentiles.record(ticks_to_secs(latency));
+}
+
+io_activities_stats_t::io_activities_stats_t(perfmon_collection_t *parent) :
+    collection_membership(parent, &collection, "io") {
+    for (int i = 0; i < NUM_IO_ACTIVITIES; ++i) {
+        activities[i].init(new io_activity_stats_t(&collection,
+                                                   static_cast<io_activity_t>(i)));
+    }
+}
+
+io_activity_stats_t *io_activities_stats_t::get(io_activity_t activity) {
+    const int i = static_cast<int>(activity);
+    rassert(i >= 0 && i < NUM_IO_ACTIVITIES);
+    return activities[i].get();
+}
@@ -0,0 +1,49 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#ifndef ARCH_IO_DISK_ACTIVITY_STATS_HPP_
+#define ARCH_IO_DISK_ACTIVITY_STATS_HPP_
+
+#include <string>
+
+#include "arch/types.hpp"
+#include "containers/scoped.hpp"
+#include "perfmon/perfmon.hpp"
+
+const char *io_activity_name(io_activity_t activity);
+
+/* The I/O of the file accounts of one `io_activity_t` on one file: how many reads
+and writes there were, of how many bytes, and how long (in seconds) they took from
+when they came to the disk manager to when they were done.  `accounting_diskmgr_t`
+records them on its thread. */
+struct io_activity_stats_t {
+    io_activity_stats_t(perfmon_collection_t *parent, io_activity_t activity);
+
+    void record(bool is_read, int64_t bytes, ticks_t latency);
+
+    perfmon_collection_t collection;
+    perfmon_membership_t collection_membership;
+
+    perfmon_counter_t reads, writes, bytes_read, bytes_written;
+    perfmon_hdr_histogram_t latency_percentiles;
+    perfmon_multi_membership_t stats_membership;
+
+private:
+    DISABLE_COPYING(io_activity_stats_t);
+};
+
+/* The `io_activity_stats_t` of every activity on a file, in a collection called
+"io". */
+class io_activities_stats_t {
+public:
+    explicit io_activities_stats_t(perfmon_collection_t *parent);
+
+    io_activity_stats_t *get(io_activity_t activity);
+
+private:
+    perfmon_collection_t collection;
+    perfmon_membership_t collection_membership;
+    scoped_ptr_t<io_activity_stats_t> activities[NUM_IO_ACTIVITIES];
+
+    DISABLE_COPYING(io_activities_stats_t);
+};
+
+#endif  // ARCH_IO_DISK_ACTIVITY_STATS_HPP_
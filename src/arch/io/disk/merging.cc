@@ -0,0 +1,142 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "arch/io/disk/merging.hpp"
+
+#include <algorithm>
+
+#include "arch/runtime/runtime.hpp"
+#include "config/args.hpp"
+
+// Orders the pending operations so that the ones that can be merged are next to
+// each other.
+struct merge_order_t {
+    bool operator()(const accounting_diskmgr_action_t *a,
+                    const accounting_diskmgr_action_t *b) const {
+        if (a->get_fd() != b->get_fd()) {
+            return a->get_fd() < b->get_fd();
+        }
+        if (a->get_is_read() != b->get_is_read()) {
+            return a->get_is_read();
+        }
+        if (a->account != b->account) {
+            return a->account < b->account;
+        }
+        return a->get_offset() < b->get_offset();
+    }
+};
+
+merging_diskmgr_t::merging_diskmgr_t(perfmon_collection_t *stats) :
+    merge_sampler(secs_to_ticks(1), true),
+    merge_sampler_membership(stats, &merge_sampler, "merged")
+{ }
+
+merging_diskmgr_t::~merging_diskmgr_t() {
+    rassert(pending.empty());
+    rassert(running.empty());
+}
+
+void merging_diskmgr_t::submit(action_t *action) {
+#if USE_WRITEV
+    if (IO_MERGE_MAX_REQUESTS > 1 && !action->get_wrap_in_datasyncs()) {
+        if (pending.empty()) {
+            call_later_on_this_thread(this);
+        }
+        pending.push_back(action);
+        return;
+    }
+#endif
+    submit_fun(action);
+}
+
+void merging_diskmgr_t::on_thread_switch() {
+    std::vector<action_t *> batch;
+    batch.swap(pending);
+    std::stable_sort(batch.begin(), batch.end(), merge_order_t());
+
+    std::vector<action_t *>::const_iterator begin = batch.begin();
+    while (begin != batch.end()) {
+        std::vector<action_t *>::const_iterator end = begin + 1;
+        int parts = 1;
+        size_t bytes = (*begin)->get_count();
+        while (end != batch.end() && can_merge(*(end - 1), *end, parts, bytes)) {
+            ++parts;
+            bytes += (*end)->get_count();
+            ++end;
+        }
+        submit_run(begin, end);
+        begin = end;
+    }
+}
+
+bool merging_diskmgr_t::can_merge(const action_t *prev, const action_t *next,
+                                  int parts, size_t bytes) {
+    return prev->get_fd() == next->get_fd()
+        && prev->get_is_read() == next->get_is_read()
+        && prev->account == next->account
+        && prev->get_offset() + static_cast<int64_t>(prev->get_count()) == next->get_offset()
+        && parts < IO_MERGE_MAX_REQUESTS
+        && bytes + next->get_count() <= static_cast<size_t>(IO_MERGE_MAX_BYTES);
+}
+
+void merging_diskmgr_t::submit_run(std::vector<action_t *>::const_iterator begin,
+                                   std::vector<action_t *>::const_iterator end) {
+    if (end - begin == 1) {
+        submit_fun(*begin);
+        return;
+    }
+
+#if USE_WRITEV
+    size_t n_bufs = 0;
+    size_t count = 0;
+    for (std::vector<action_t *>::const_iterator it = begin; it != end; ++it) {
+        iovec *vecs;
+        size_t vecs_len;
+        (*it)->get_bufs(&vecs, &vecs_len);
+        n_bufs += vecs_len;
+        count += (*it)->get_count();
+    }
+
+    scoped_array_t<iovec> bufs(n_bufs);
+    size_t i = 0;
+    merging_diskmgr_merged_action_t *merged = new merging_diskmgr_merged_action_t;
+    for (std::vector<action_t *>::const_iterator it = begin; it != end; ++it) {
+        iovec *vecs;
+        size_t vecs_len;
+        (*it)->get_bufs(&vecs, &vecs_len);
+        std::copy(vecs, vecs + vecs_len, bufs.data() + i);
+        i += vecs_len;
+        merged->parts.push_back(*it);
+    }
+
+    const action_t *first = *begin;
+    if (first->get_is_read()) {
+        merged->make_readv(first->get_fd(), std::move(bufs), count, first->get_offset());
+    } else {
+        merged->make_writev(first->get_fd(), std::move(bufs), count, first->get_offset());
+    }
+    merged->set_device(first->get_device());
+    merged->account = first->account;
+
+    merge_sampler.record(end - begin);
+    running.insert(merged);
+    submit_fun(merged);
+#else
+    unreachable();
+#endif
+}
+
+void merging_diskmgr_t::done(action_t *action) {
+    if (running.erase(action) == 0) {
+        done_fun(action);
+        return;
+    }
+
+    merging_diskmgr_merged_action_t *merged =
+        static_cast<merging_diskmgr_merged_action_t *>(action);
+    for (std::vector<action_t *>::const_iterator it = merged->parts.begin();
+         it != merged->parts.end();
+         ++it) {
+        (*it)->set_result_from_whole(*merged, (*it)->get_offset() - merged->get_offset());
+        done_fun(*it);
+    }
+    delete merged;
+}
@@ -0,0 +1,64 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#ifndef ARCH_IO_DISK_MERGING_HPP_
+#define ARCH_IO_DISK_MERGING_HPP_
+
+#include <set>
+#include <vector>
+
+#include "errors.hpp"
+#include <boost/function.hpp>
+
+#include "arch/io/disk/accounting.hpp"
+#include "arch/runtime/runtime_utils.hpp"
+#include "perfmon/perfmon.hpp"
+
+/* The merging disk manager sits between the conflict-resolving disk manager and the
+accounting disk manager. It collects the operations that are submitted to it during
+one pass of the event loop, and runs the reads, and the writes, of an account that
+are next to each other in the same file as one vectored operation. When that is
+done, it passes each of the original operations on to `done_fun` with its share of
+the result.
+
+Every operation that reaches it has already been cleared by the
+conflict-resolving disk manager, so the operations it merges never overlap, and
+their order doesn't matter. It doesn't merge writes that are wrapped in datasyncs.
+See IO_MERGE_MAX_REQUESTS. */
+
+struct merging_diskmgr_merged_action_t : public accounting_diskmgr_action_t {
+    // The operations that this one runs, in the order of their offsets.
+    std::vector<accounting_diskmgr_action_t *> parts;
+};
+
+class merging_diskmgr_t : private linux_thread_message_t {
+public:
+    explicit merging_diskmgr_t(perfmon_collection_t *stats);
+    ~merging_diskmgr_t();
+
+    typedef accounting_diskmgr_action_t action_t;
+
+    void submit(action_t *action);
+    boost::function<void(action_t *)> done_fun;
+
+    boost::function<void(action_t *)> submit_fun;
+    void done(action_t *action);
+
+private:
+    // Called from the event loop after `submit()` put the first of `pending` there.
+    void on_thread_switch();
+
+    static bool can_merge(const action_t *prev, const action_t *next,
+                          int parts, size_t bytes);
+    void submit_run(std::vector<action_t *>::const_iterator begin,
+                    std::vector<action_t *>::const_iterator end);
+
+    std::vector<action_t *> pending;
+    // The merged operations that have been submitted and aren't done yet.
+    std::set<action_t *> running;
+
+    perfmon_sampler_t merge_sampler;
+    perfmon_membership_t merge_sampler_membership;
+
+    DISABLE_COPYING(merging_diskmgr_t);
+};
+
+#endif /* ARCH_IO_DISK_MERGING_HPP_ */
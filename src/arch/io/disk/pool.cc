@@ -2,11 +2,17 @@
 #include "arch/io/disk/pool.hpp"
 
 #include <fcntl.h>
+#ifdef __linux
+#include <sys/sysmacros.h>
+#endif
 #include <sys/types.h>
 #include <sys/uio.h>
 #include <unistd.h>
 
+#include <deque>
+
 #include "arch/io/disk.hpp"
+#include "arch/io/disk/stats.hpp"
 #include "config/args.hpp"
 
 int blocker_pool_queue_depth(int max_concurrent_io_requests) {
@@ -28,13 +34,34 @@ void debug_print(printf_buffer_t *buf,
                  action.get_succeeded() ? 0 : action.get_errno());
 }
 
-pool_diskmgr_t::pool_diskmgr_t(linux_event_queue_t *queue,
+/* The threads and the requests of one device.  A group starts with one thread and
+grows up to `max_concurrent_io_requests` of them while its requests queue up. */
+struct pool_device_group_t {
+    pool_device_group_t(linux_event_queue_t *queue, int max_concurrent_io_requests,
+                        perfmon_collection_t *stats, uint64_t device)
+        : blocker_pool(1, max_concurrent_io_requests, queue),
+          n_running(0),
+          pm(stats, strprintf("device_%u_%u", major(device), minor(device))) { }
+
+    blocker_pool_t blocker_pool;
+    // The requests on `blocker_pool`, and the ones waiting for it to have fewer
+    // than `queue_depth`.
+    int n_running;
+    std::deque<pool_diskmgr_action_t *> waiting;
+
+    pool_device_group_stats_t pm;
+};
+
+pool_diskmgr_t::pool_diskmgr_t(linux_event_queue_t *_queue,
                                passive_producer_t<action_t *> *_source,
-                               int max_concurrent_io_requests)
-    : queue_depth(blocker_pool_queue_depth(max_concurrent_io_requests)),
+                               int _max_concurrent_io_requests,
+                               perfmon_collection_t *_stats)
+    : queue(_queue),
+      max_concurrent_io_requests(_max_concurrent_io_requests),
+      stats(_stats),
+      queue_depth(blocker_pool_queue_depth(_max_concurrent_io_requests)),
       source(_source),
-      blocker_pool(max_concurrent_io_requests, queue),
-      n_pending(0) {
+      n_waiting(0) {
     if (source->available->get()) { pump(); }
     source->available->set_callback(this);
 }
@@ -45,6 +72,12 @@ pool_diskmgr_t::~pool_diskmgr_t() {
 }
 
 void pool_diskmgr_t::action_t::run() {
+    const ticks_t start_ticks = get_ticks();
+    perform_io();
+    service_ticks = get_ticks() - start_ticks;
+}
+
+void pool_diskmgr_t::action_t::perform_io() {
     if (wrap_in_datasyncs) {
         int errcode = perform_datasync(fd);
         if (errcode != 0) {
@@ -122,7 +155,16 @@ void pool_diskmgr_t::action_t::run() {
 
 void pool_diskmgr_action_t::done() {
     parent->assert_thread();
-    parent->n_pending--;
+    pool_device_group_t *g = group;
+    --g->n_running;
+    --g->pm.queue_depth;
+    g->pm.service_time.record(ticks_to_secs(service_ticks));
+    if (!g->waiting.empty()) {
+        pool_diskmgr_action_t *next = g->waiting.front();
+        g->waiting.pop_front();
+        --parent->n_waiting;
+        parent->start(next);
+    }
     parent->pump();
     parent->done_fun(this);
 }
@@ -134,13 +176,37 @@ void pool_diskmgr_t::on_source_availability_changed() {
     if (source->available->get()) pump();
 }
 
+pool_device_group_t *pool_diskmgr_t::get_group(uint64_t device) {
+    scoped_ptr_t<pool_device_group_t> *g = &groups[device];
+    if (!g->has()) {
+        g->init(new pool_device_group_t(queue, max_concurrent_io_requests, stats,
+                                        device));
+    }
+    return g->get();
+}
+
+void pool_diskmgr_t::start_or_queue(action_t *a) {
+    pool_device_group_t *g = get_group(a->get_device());
+    a->group = g;
+    ++g->pm.queue_depth;
+    if (g->n_running < queue_depth) {
+        start(a);
+    } else {
+        g->waiting.push_back(a);
+        ++n_waiting;
+    }
+}
+
+void pool_diskmgr_t::start(action_t *a) {
+    ++a->group->n_running;
+    a->group->blocker_pool.do_job(a);
+}
+
 void pool_diskmgr_t::pump() {
     assert_thread();
-    while (source->available->get() && n_pending < queue_depth) {
+    while (source->available->get() && n_waiting < queue_depth) {
         action_t *a = source->pop();
         a->parent = this;
-        n_pending++;
-        blocker_pool.do_job(a);
+        start_or_queue(a);
     }
 }
-
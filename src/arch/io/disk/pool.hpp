@@ -4,6 +4,8 @@
 
 #include <sys/uio.h>
 
+#include <algorithm>
+#include <map>
 #include <string>
 
 #include "errors.hpp"
@@ -13,6 +15,7 @@
 #include "arch/io/blocker_pool.hpp"
 #include "concurrency/queue/passive_producer.hpp"
 #include "containers/scoped.hpp"
+#include "utils.hpp"
 
 #ifdef __MACH__
 #define USE_WRITEV 0
@@ -21,10 +24,15 @@
 #endif
 
 struct iovec;
+class perfmon_collection_t;
 class pool_diskmgr_t;
+struct pool_device_group_t;
+class uring_diskmgr_t;
 
-/* The pool disk manager uses a thread pool in conjunction with synchronous
-(blocking) IO calls to asynchronously run IO requests. */
+/* The pool disk manager uses thread pools in conjunction with synchronous
+(blocking) IO calls to asynchronously run IO requests.  Each device that the files
+are on gets its own group of threads, so that a slow disk's requests don't hold up
+a fast one's, and each group grows and shrinks with its load. */
 
 struct pool_diskmgr_action_t
     : private blocker_pool_t::job_t {
@@ -52,6 +60,16 @@ struct pool_diskmgr_action_t
         buf_and_count.iov_len = _count;
         offset = _offset;
     }
+
+    void make_readv(fd_t _fd, scoped_array_t<iovec> &&_bufs, size_t _count, int64_t _offset) {
+        is_read = true;
+        wrap_in_datasyncs = false;
+        fd = _fd;
+        iovecs = std::move(_bufs);
+        buf_and_count.iov_base = NULL;
+        buf_and_count.iov_len = _count;
+        offset = _offset;
+    }
 #endif
 
     void make_read(fd_t _fd, void *_buf, size_t _count, int64_t _offset) {
@@ -63,8 +81,14 @@ struct pool_diskmgr_action_t
         offset = _offset;
     }
 
+    // The device that the file is on, so that pool_diskmgr_t can give each device
+    // its own threads.
+    void set_device(uint64_t _device) { device = _device; }
+    uint64_t get_device() const { return device; }
+
     bool get_is_write() const { return !is_read; }
     bool get_is_read() const { return is_read; }
+    bool get_wrap_in_datasyncs() const { return wrap_in_datasyncs; }
     fd_t get_fd() const { return fd; }
     void get_bufs(iovec **iovecs_out, size_t *iovecs_len_out) {
         if (buf_and_count.iov_base != NULL) {
@@ -79,6 +103,16 @@ struct pool_diskmgr_action_t
     int64_t get_offset() const { return offset; }
 
     void set_successful_due_to_conflict() { io_result = get_count(); }
+    // For an action that ran as the part of `whole` that starts `offset_into_whole`
+    // bytes into it: takes the part of whole's result that covers this action.
+    void set_result_from_whole(const pool_diskmgr_action_t &whole, int64_t offset_into_whole) {
+        if (whole.io_result < 0) {
+            io_result = whole.io_result;
+        } else {
+            io_result = std::min<int64_t>(std::max<int64_t>(whole.io_result - offset_into_whole, 0),
+                                          get_count());
+        }
+    }
     bool get_succeeded() const { return io_result == static_cast<int64_t>(get_count()); }
     int get_errno() const {
         rassert(io_result < 0);
@@ -87,23 +121,34 @@ struct pool_diskmgr_action_t
 
 private:
     friend class pool_diskmgr_t;
+    friend class uring_diskmgr_t;
     pool_diskmgr_t *parent;
+    pool_device_group_t *group;
 
     bool is_read;
     bool wrap_in_datasyncs;
     fd_t fd;
+    uint64_t device;
 
-    // Either buf_and_count.iov_base is used, or iovecs is used (for writev).  If
-    // iovecs is used, then buf_and_count.iov_len is the sum of the iovecs' iov_len
-    // fields.  Currently readv is not supported, but if you need it, it should be
-    // easy to add.
+    // Either buf_and_count.iov_base is used, or iovecs is used (for writev and
+    // readv).  If iovecs is used, then buf_and_count.iov_len is the sum of the
+    // iovecs' iov_len fields.
     scoped_array_t<iovec> iovecs;
     iovec buf_and_count;
     int64_t offset;
 
     int64_t io_result;
+    // How long the blocker pool thread took to run() it.
+    ticks_t service_ticks;
+
+    // Used by uring_diskmgr_t, which may need several submission queue entries
+    // for one action: the number of them that haven't completed yet, and the
+    // number of bytes transferred so far.
+    int uring_entries_pending;
+    int64_t uring_bytes_done;
 
     void run();
+    void perform_io();
     void done();
 
     DISABLE_COPYING(pool_diskmgr_action_t);
@@ -120,17 +165,32 @@ public:
     /* The `pool_diskmgr_t` will draw actions to run from `source`. It will call `done_fun`
     on each one when it's done. */
     pool_diskmgr_t(linux_event_queue_t *queue, passive_producer_t<action_t *> *source,
-                   int max_concurrent_io_requests);
+                   int max_concurrent_io_requests, perfmon_collection_t *stats);
     boost::function<void(action_t *)> done_fun;
     ~pool_diskmgr_t();
 
 private:
+    // Makes the group for `device` the first time it's needed.
+    pool_device_group_t *get_group(uint64_t device);
+    // Hands `a` to its group's threads, or queues it in the group if the group has
+    // `queue_depth` requests running already.
+    void start_or_queue(action_t *a);
+    void start(action_t *a);
+
+    linux_event_queue_t *const queue;
+    const int max_concurrent_io_requests;
+    perfmon_collection_t *const stats;
+
+    // Every group may have up to `queue_depth` requests on its threads.  We take
+    // requests from `source` as long as fewer than `queue_depth` of all of them wait
+    // for their group, so a slow device only keeps the others' requests in the
+    // source once it has a full queue of its own.
     const int queue_depth;
     passive_producer_t<action_t *> *source;
-    blocker_pool_t blocker_pool;
+    std::map<uint64_t, scoped_ptr_t<pool_device_group_t> > groups;
 
     void on_source_availability_changed();
-    int n_pending;
+    int n_waiting;
     void pump();
 
     DISABLE_COPYING(pool_diskmgr_t);
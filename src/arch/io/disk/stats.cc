@@ -27,3 +27,12 @@ void stats_diskmgr_t::done(conflict_resolving_diskmgr_action_t *p) {
     }
     done_fun(a);
 }
+
+pool_device_group_stats_t::pool_device_group_stats_t(perfmon_collection_t *stats,
+                                                     const std::string &name) :
+    collection_membership(stats, &collection, name),
+    service_time(secs_to_ticks(1), false),
+    stats_membership(&collection,
+                     &queue_depth, "queue_depth",
+                     &service_time, "service_time",
+                     NULLPTR) { }
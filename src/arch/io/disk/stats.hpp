@@ -9,7 +9,7 @@
 
 #include "arch/io/disk/pool.hpp"
 #include "arch/io/disk/conflict_resolving.hpp"
-#include "perfmon/types.hpp"
+#include "perfmon/perfmon.hpp"
 
 /* There are two types of stat-collectors in the disk stack. One type is a passive
 consumer and active producer of disk operations. The other type is an active consumer
@@ -35,4 +35,18 @@ private:
     perfmon_multi_membership_t stats_membership;
 };
 
+/* The statistics of one of pool_diskmgr_t's groups of threads, which it has one of
+for each device: how many requests are queued for or running on the group, and how
+long (in seconds) its threads take to run a request. */
+struct pool_device_group_stats_t {
+    pool_device_group_stats_t(perfmon_collection_t *stats, const std::string &name);
+
+    perfmon_collection_t collection;
+    perfmon_membership_t collection_membership;
+
+    perfmon_counter_t queue_depth;
+    perfmon_sampler_t service_time;
+    perfmon_multi_membership_t stats_membership;
+};
+
 #endif /* ARCH_IO_DISK_STATS_HPP_ */
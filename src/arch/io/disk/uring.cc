@@ -0,0 +1,371 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "arch/io/disk/uring.hpp"
+
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "arch/io/disk.hpp"
+#include "config/args.hpp"
+
+#if URING_DISKMGR_SUPPORTED && defined(__NR_io_uring_setup)
+#define USE_IO_URING 1
+#include <linux/io_uring.h>
+#else
+#define USE_IO_URING 0
+#endif
+
+#if USE_IO_URING
+
+namespace {
+
+int sys_io_uring_setup(uint32_t entries, io_uring_params *params) {
+    return syscall(__NR_io_uring_setup, entries, params);
+}
+
+int sys_io_uring_enter(int fd, uint32_t to_submit) {
+    return syscall(__NR_io_uring_enter, fd, to_submit, 0, 0, NULL, 0);
+}
+
+int sys_io_uring_register(int fd, unsigned int opcode, void *arg, unsigned int nr_args) {
+    return syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+// io_uring_setup() fails for larger rings on older kernels.
+const uint32_t URING_MAX_ENTRIES = 4096;
+
+uint32_t uring_entries(int max_concurrent_io_requests) {
+    guarantee(max_concurrent_io_requests > 0);
+    guarantee(max_concurrent_io_requests < MAXIMUM_MAX_CONCURRENT_IO_REQUESTS);
+    // Like blocker_pool_queue_depth(), allow twice as many requests as threads the
+    // pool disk manager would use, within what the kernel allows.
+    uint32_t entries = 8;
+    while (entries < static_cast<uint32_t>(max_concurrent_io_requests) * 2
+           && entries < URING_MAX_ENTRIES) {
+        entries *= 2;
+    }
+    return entries;
+}
+
+void *map_ring(int fd, size_t size, off_t offset) {
+    void *res = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     fd, offset);
+    guarantee_err(res != MAP_FAILED, "Could not map io_uring ring");
+    return res;
+}
+
+template <class T>
+T *ring_field(void *ring, uint32_t offset) {
+    return reinterpret_cast<T *>(static_cast<char *>(ring) + offset);
+}
+
+bool uring_disabled_for_testing = false;
+
+}  // namespace
+
+void uring_diskmgr_t::set_disabled_for_testing(bool disabled) {
+    uring_disabled_for_testing = disabled;
+}
+
+bool uring_diskmgr_t::is_supported() {
+    if (uring_disabled_for_testing) {
+        return false;
+    }
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    const int fd = sys_io_uring_setup(1, &params);
+    if (fd < 0) {
+        return false;
+    }
+    // Registering an eventfd is the newest feature we rely on.
+    system_event_t event;
+    int event_fd = event.get_notify_fd();
+    const bool supported
+        = sys_io_uring_register(fd, IORING_REGISTER_EVENTFD, &event_fd, 1) == 0;
+    UNUSED int res = close(fd);
+    return supported;
+}
+
+uring_diskmgr_t::uring_diskmgr_t(linux_event_queue_t *_queue,
+                                 passive_producer_t<action_t *> *_source,
+                                 int max_concurrent_io_requests)
+    : queue(_queue), source(_source),
+      n_unsubmitted(0), n_in_flight(0), deferred(NULL),
+      retry_timer(NULL), retry_delay_ms(URING_SUBMIT_RETRY_MIN_MS) {
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ring_fd = sys_io_uring_setup(uring_entries(max_concurrent_io_requests), &params);
+    guarantee_err(ring_fd >= 0, "Could not set up io_uring");
+
+    sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap) {
+        sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+    }
+    sq_ring = map_ring(ring_fd, sq_ring_size, IORING_OFF_SQ_RING);
+    cq_ring = single_mmap ? sq_ring : map_ring(ring_fd, cq_ring_size, IORING_OFF_CQ_RING);
+    sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    sqes = static_cast<io_uring_sqe *>(map_ring(ring_fd, sqes_size, IORING_OFF_SQES));
+
+    sq_head = ring_field<uint32_t>(sq_ring, params.sq_off.head);
+    sq_tail = ring_field<uint32_t>(sq_ring, params.sq_off.tail);
+    sq_mask = *ring_field<uint32_t>(sq_ring, params.sq_off.ring_mask);
+    sq_entries = params.sq_entries;
+    sq_array = ring_field<uint32_t>(sq_ring, params.sq_off.array);
+    cq_head = ring_field<uint32_t>(cq_ring, params.cq_off.head);
+    cq_tail = ring_field<uint32_t>(cq_ring, params.cq_off.tail);
+    cq_mask = *ring_field<uint32_t>(cq_ring, params.cq_off.ring_mask);
+    cqes = ring_field<io_uring_cqe>(cq_ring, params.cq_off.cqes);
+
+    int event_fd = completion_event.get_notify_fd();
+    int res = sys_io_uring_register(ring_fd, IORING_REGISTER_EVENTFD, &event_fd, 1);
+    guarantee_err(res == 0, "Could not register eventfd with io_uring");
+    queue->watch_resource(event_fd, poll_event_in, this);
+
+    if (source->available->get()) { pump(); }
+    source->available->set_callback(this);
+}
+
+uring_diskmgr_t::~uring_diskmgr_t() {
+    assert_thread();
+    rassert(n_in_flight == 0);
+    rassert(deferred == NULL);
+    if (retry_timer != NULL) {
+        cancel_timer(retry_timer);
+        retry_timer = NULL;
+    }
+    source->available->unset_callback();
+    queue->forget_resource(completion_event.get_notify_fd(), this);
+
+    UNUSED int res = munmap(sqes, sqes_size);
+    if (cq_ring != sq_ring) {
+        res = munmap(cq_ring, cq_ring_size);
+    }
+    res = munmap(sq_ring, sq_ring_size);
+    res = close(ring_fd);
+}
+
+void uring_diskmgr_t::on_source_availability_changed() {
+    assert_thread();
+    if (source->available->get()) pump();
+}
+
+void uring_diskmgr_t::on_event(DEBUG_VAR int events) {
+    assert_thread();
+    rassert(events == poll_event_in);
+    completion_event.consume_wakey_wakeys();
+    reap();
+    pump();
+}
+
+void uring_diskmgr_t::on_timer() {
+    assert_thread();
+    retry_timer = NULL;
+    submit();
+}
+
+int uring_diskmgr_t::entries_needed(action_t *a) {
+    iovec *vecs;
+    size_t vecs_len;
+    a->get_bufs(&vecs, &vecs_len);
+    // A single readv or writev entry can't take more than IOV_MAX iovecs.
+    const int chunks = std::max<size_t>(1, (vecs_len + IOV_MAX - 1) / IOV_MAX);
+    return chunks + (a->wrap_in_datasyncs ? 2 : 0);
+}
+
+io_uring_sqe *uring_diskmgr_t::next_sqe(action_t *a) {
+    // We are the only writer of sq_tail, so we don't need an atomic load. The
+    // kernel only looks at the submission queue in io_uring_enter(), so it's fine
+    // to publish an entry before it's filled in.
+    const uint32_t tail = *sq_tail;
+    const uint32_t index = tail & sq_mask;
+    io_uring_sqe *sqe = &sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->user_data = reinterpret_cast<uint64_t>(a);
+    sq_array[index] = index;
+    __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+    ++n_unsubmitted;
+    ++n_in_flight;
+    return sqe;
+}
+
+void uring_diskmgr_t::prepare_entries(action_t *a) {
+    a->uring_entries_pending = entries_needed(a);
+    a->uring_bytes_done = 0;
+    a->io_result = 0;
+
+    iovec *vecs;
+    size_t vecs_len;
+    a->get_bufs(&vecs, &vecs_len);
+
+    // When the write is wrapped in datasyncs, each entry is linked to the next
+    // one, so that they run in order and a failure cancels the rest.
+    const uint8_t link_flags = a->wrap_in_datasyncs ? IOSQE_IO_LINK : 0;
+
+    if (a->wrap_in_datasyncs) {
+        io_uring_sqe *sqe = next_sqe(a);
+        sqe->opcode = IORING_OP_FSYNC;
+        sqe->fd = a->fd;
+        sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+        sqe->flags = link_flags;
+    }
+
+    int64_t offset = a->offset;
+    size_t i = 0;
+    do {
+        const size_t len = std::min<size_t>(IOV_MAX, vecs_len - i);
+        io_uring_sqe *sqe = next_sqe(a);
+        sqe->opcode = a->is_read ? IORING_OP_READV : IORING_OP_WRITEV;
+        sqe->fd = a->fd;
+        sqe->addr = reinterpret_cast<uint64_t>(vecs + i);
+        sqe->len = len;
+        sqe->off = offset;
+        sqe->flags = link_flags;
+
+        for (size_t j = i; j < i + len; ++j) {
+            offset += vecs[j].iov_len;
+        }
+        i += len;
+    } while (i < vecs_len);
+
+    if (a->wrap_in_datasyncs) {
+        // The last entry of the chain, so it isn't linked to anything.
+        io_uring_sqe *sqe = next_sqe(a);
+        sqe->opcode = IORING_OP_FSYNC;
+        sqe->fd = a->fd;
+        sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+    }
+}
+
+void uring_diskmgr_t::pump() {
+    assert_thread();
+    for (;;) {
+        action_t *a = deferred;
+        if (a == NULL) {
+            if (!source->available->get()) {
+                break;
+            }
+            a = source->pop();
+        }
+        const uint32_t needed = entries_needed(a);
+        guarantee(needed <= sq_entries, "I/O request has too many iovecs for io_uring");
+        if (n_in_flight + needed > sq_entries) {
+            // Wait for some of the requests in flight to complete.
+            deferred = a;
+            break;
+        }
+        deferred = NULL;
+        prepare_entries(a);
+    }
+    submit();
+}
+
+void uring_diskmgr_t::submit() {
+    // While a retry is due, nothing is in flight but the unsubmitted entries, so
+    // the new entries wait for the retry too.
+    while (n_unsubmitted > 0 && retry_timer == NULL) {
+        const int res = sys_io_uring_enter(ring_fd, n_unsubmitted);
+        if (res < 0) {
+            guarantee_err(errno == EINTR || errno == EAGAIN || errno == EBUSY,
+                          "io_uring_enter failed");
+            if (errno == EINTR) {
+                continue;
+            }
+            // The kernel is out of resources for now. The entries stay on the
+            // submission queue, and we will try again when the next request
+            // completes. If nothing is in flight, no completion will come, so
+            // we try again on a timer instead of spinning on io_uring_enter().
+            if (n_in_flight == n_unsubmitted) {
+                retry_timer = fire_timer_once(retry_delay_ms, this);
+                retry_delay_ms = std::min<int64_t>(retry_delay_ms * 2,
+                                                   URING_SUBMIT_RETRY_MAX_MS);
+            }
+            break;
+        }
+        retry_delay_ms = URING_SUBMIT_RETRY_MIN_MS;
+        n_unsubmitted -= res;
+    }
+
+    // Requests often complete quickly on fast devices; picking up their
+    // completions now saves a round trip through the event queue.
+    reap();
+}
+
+void uring_diskmgr_t::reap() {
+    assert_thread();
+    // Copy the completions out before handling them, because done_fun can
+    // submit new requests and end up in reap() again.
+    std::vector<std::pair<action_t *, int32_t> > completions;
+    uint32_t head = *cq_head;
+    const uint32_t tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+    while (head != tail) {
+        const io_uring_cqe *cqe = &cqes[head & cq_mask];
+        completions.push_back(std::make_pair(reinterpret_cast<action_t *>(cqe->user_data),
+                                             cqe->res));
+        ++head;
+    }
+    __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+    n_in_flight -= completions.size();
+
+    for (auto it = completions.begin(); it != completions.end(); ++it) {
+        complete_entry(it->first, it->second);
+    }
+}
+
+void uring_diskmgr_t::complete_entry(action_t *a, int32_t res) {
+    rassert(a->uring_entries_pending > 0);
+    if (res < 0) {
+        // Keep the first real error, not the -ECANCELED of entries linked to it.
+        if (a->io_result == 0 || a->io_result == -ECANCELED) {
+            a->io_result = res;
+        }
+    } else {
+        // fsync entries complete with 0.
+        a->uring_bytes_done += res;
+    }
+
+    --a->uring_entries_pending;
+    if (a->uring_entries_pending == 0) {
+        if (a->io_result == 0) {
+            // A short read or write is an error too.
+            a->io_result = a->uring_bytes_done == static_cast<int64_t>(a->get_count())
+                ? a->uring_bytes_done
+                : -EIO;
+        }
+        done_fun(a);
+    }
+}
+
+#else  // USE_IO_URING
+
+void uring_diskmgr_t::set_disabled_for_testing(UNUSED bool disabled) { }
+
+bool uring_diskmgr_t::is_supported() {
+    return false;
+}
+
+uring_diskmgr_t::uring_diskmgr_t(linux_event_queue_t *_queue,
+                                 passive_producer_t<action_t *> *_source,
+                                 UNUSED int max_concurrent_io_requests)
+    : queue(_queue), source(_source) {
+    crash("This build does not support io_uring.");
+}
+
+uring_diskmgr_t::~uring_diskmgr_t() { }
+
+void uring_diskmgr_t::on_source_availability_changed() { unreachable(); }
+
+void uring_diskmgr_t::on_event(UNUSED int events) { unreachable(); }
+
+void uring_diskmgr_t::on_timer() { unreachable(); }
+
+#endif  // USE_IO_URING
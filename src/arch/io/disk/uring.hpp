@@ -0,0 +1,120 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#ifndef ARCH_IO_DISK_URING_HPP_
+#define ARCH_IO_DISK_URING_HPP_
+
+#include <stdint.h>
+
+#include "errors.hpp"
+#include <boost/function.hpp>
+
+#include "arch/runtime/event_queue.hpp"
+#include "arch/runtime/system_event.hpp"
+#include "arch/io/disk/pool.hpp"
+#include "arch/timer.hpp"
+#include "concurrency/queue/passive_producer.hpp"
+
+#if defined(__linux) && !defined(NO_IO_URING) && !defined(NO_EVENTFD)
+#define URING_DISKMGR_SUPPORTED 1
+#else
+#define URING_DISKMGR_SUPPORTED 0
+#endif
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+/* The io_uring disk manager hands I/O requests straight to the kernel through an
+io_uring submission queue, instead of running blocking calls on a thread pool
+like pool_diskmgr_t does. It takes the same actions as pool_diskmgr_t, so it can
+replace it at the bottom of the disk manager stack.
+
+Every call to pump() puts as many actions as fit onto the submission queue and
+submits all of them with one io_uring_enter() call. Completions are reaped
+straight from the completion queue, which is memory shared with the kernel,
+after every submission; an eventfd registered with the ring only wakes us up
+through the event queue when nothing else does. Writes that have to be
+wrapped in datasyncs become a chain of linked fdatasync, write and fdatasync
+entries. If the kernel is out of resources when nothing is in flight, so that no
+completion will come to try again, submitting backs off on a timer.
+
+Use `is_supported()` to check whether the kernel supports io_uring (and whether
+we were built with it, see NO_IO_URING) before constructing one. */
+
+class uring_diskmgr_t : private availability_callback_t,
+                        private linux_event_callback_t,
+                        private timer_callback_t,
+                        public home_thread_mixin_debug_only_t {
+public:
+    typedef pool_diskmgr_action_t action_t;
+
+    static bool is_supported();
+    // Makes is_supported() return false, so that the unit tests can check what
+    // happens without io_uring on kernels that have it.
+    static void set_disabled_for_testing(bool disabled);
+
+    /* The `uring_diskmgr_t` will draw actions to run from `source`. It will call
+    `done_fun` on each one when it's done. */
+    uring_diskmgr_t(linux_event_queue_t *queue, passive_producer_t<action_t *> *source,
+                    int max_concurrent_io_requests);
+    boost::function<void(action_t *)> done_fun;
+    ~uring_diskmgr_t();
+
+private:
+    void on_source_availability_changed();
+    void on_event(int events);
+    void on_timer();
+
+    // The number of submission queue entries `a` needs.
+    static int entries_needed(action_t *a);
+    void prepare_entries(action_t *a);
+    // Puts a new, zeroed entry for `a` onto the submission queue.
+    io_uring_sqe *next_sqe(action_t *a);
+
+    void pump();
+    void submit();
+    void reap();
+    void complete_entry(action_t *a, int32_t res);
+
+    linux_event_queue_t *const queue;
+    passive_producer_t<action_t *> *const source;
+
+    int ring_fd;
+
+    // The submission queue ring, its entries, and the completion queue ring, all
+    // mapped from ring_fd.
+    void *sq_ring;
+    size_t sq_ring_size;
+    void *cq_ring;
+    size_t cq_ring_size;
+    io_uring_sqe *sqes;
+    size_t sqes_size;
+
+    uint32_t *sq_head;
+    uint32_t *sq_tail;
+    uint32_t sq_mask;
+    uint32_t sq_entries;
+    uint32_t *sq_array;
+    uint32_t *cq_head;
+    uint32_t *cq_tail;
+    uint32_t cq_mask;
+    io_uring_cqe *cqes;
+
+    // Entries that have been put onto the submission queue but not submitted.
+    uint32_t n_unsubmitted;
+    // Entries that have been put onto the submission queue and haven't completed.
+    // This never exceeds sq_entries, so the completion queue can't overflow.
+    uint32_t n_in_flight;
+
+    // An action we took from `source` but couldn't fit on the submission queue.
+    action_t *deferred;
+
+    // Set while we wait to retry io_uring_enter() after the kernel was out of
+    // resources, and how long we'll wait the next time it is.
+    timer_token_t *retry_timer;
+    int64_t retry_delay_ms;
+
+    system_event_t completion_event;
+
+    DISABLE_COPYING(uring_diskmgr_t);
+};
+
+#endif /* ARCH_IO_DISK_URING_HPP_ */
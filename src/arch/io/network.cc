@@ -310,20 +310,50 @@ linux_tcp_conn_t::write_handler_t::write_handler_t(linux_tcp_conn_t *_parent) :
 { }
 
 void linux_tcp_conn_t::write_handler_t::coro_pool_callback(write_queue_op_t *operation, UNUSED signal_t *interruptor) {
-    if (operation->buffer != NULL) {
-        parent->perform_write(operation->buffer, operation->size);
-        if (operation->dealloc != NULL) {
-            parent->release_write_buffer(operation->dealloc);
-            parent->write_queue_limiter.unlock(operation->size);
+    /* Take the operations queued up behind this one too, so that they all go out
+    with one writev(). We stop after one that somebody waits for, so that they
+    don't wait for what comes after it. */
+    rassert(ops.empty() && iovecs.empty());
+    for (;;) {
+        ops.push_back(operation);
+        if (operation->buffer != NULL) {
+            struct iovec iov;
+            iov.iov_base = const_cast<void *>(operation->buffer);
+            iov.iov_len = operation->size;
+            iovecs.push_back(iov);
+        } else if (operation->iov != NULL) {
+            iovecs.insert(iovecs.end(),
+                          operation->iov, operation->iov + operation->iovcnt);
         }
+
+        if (operation->cond != NULL
+            || iovecs.size() >= WRITEV_MAX_BUFFERS
+            || parent->write_queue.size() == 0) {
+            break;
+        }
+        operation = parent->write_queue.pop();
     }
 
-    if (operation->cond != NULL) {
-        operation->cond->pulse();
+    if (!iovecs.empty()) {
+        parent->perform_writev(iovecs.data(), iovecs.size());
+        iovecs.clear();
     }
-    if (operation->dealloc != NULL) {
-        parent->release_write_queue_op(operation);
+
+    for (auto it = ops.begin(); it != ops.end(); ++it) {
+        write_queue_op_t *op = *it;
+        if (op->dealloc != NULL) {
+            parent->release_write_buffer(op->dealloc);
+            parent->write_queue_limiter.unlock(op->size);
+        }
+
+        if (op->cond != NULL) {
+            op->cond->pulse();
+        }
+        if (op->dealloc != NULL) {
+            parent->release_write_queue_op(op);
+        }
     }
+    ops.clear();
 }
 
 void linux_tcp_conn_t::internal_flush_write_buffer() {
@@ -335,6 +365,8 @@ void linux_tcp_conn_t::internal_flush_write_buffer() {
     released once the write is over. */
     op->buffer = current_write_buffer->buffer;
     op->size = current_write_buffer->size;
+    op->iov = NULL;
+    op->iovcnt = 0;
     op->dealloc = current_write_buffer.release();
     op->cond = NULL;
     op->keepalive = auto_drainer_t::lock_t(drainer.get());
@@ -349,7 +381,7 @@ void linux_tcp_conn_t::internal_flush_write_buffer() {
     write_queue.push(op);
 }
 
-void linux_tcp_conn_t::perform_write(const void *buf, size_t size) {
+void linux_tcp_conn_t::perform_writev(struct iovec *iov, size_t iovcnt) {
     assert_thread();
 
     if (write_closed.is_pulsed()) {
@@ -359,8 +391,19 @@ void linux_tcp_conn_t::perform_write(const void *buf, size_t size) {
         return;
     }
 
+    size_t size = 0;
+    for (size_t i = 0; i < iovcnt; ++i) {
+        size += iov[i].iov_len;
+    }
+
     while (size > 0) {
-        ssize_t res = ::write(sock.get(), buf, size);
+        /* Skip the buffers that are done, which includes any empty ones */
+        while (iov->iov_len == 0) {
+            ++iov;
+            --iovcnt;
+        }
+
+        ssize_t res = ::writev(sock.get(), iov, std::min<size_t>(iovcnt, WRITEV_MAX_BUFFERS));
 
         if (res == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
             /* Wait for a notification from the event queue, or for an order to
@@ -393,15 +436,27 @@ void linux_tcp_conn_t::perform_write(const void *buf, size_t size) {
         } else if (res == 0) {
             /* This should never happen either, but it's better to write an error message than to
                crash completely. */
-            logERR("Didn't expect write() to return 0.");
+            logERR("Didn't expect writev() to return 0.");
             on_shutdown_write();
             break;
 
         } else {
             rassert(res <= static_cast<ssize_t>(size));
-            buf = reinterpret_cast<const void *>(reinterpret_cast<const char *>(buf) + res);
             size -= res;
             if (write_perfmon) write_perfmon->record(res);
+
+            /* Move past what got written */
+            size_t written = res;
+            while (written > 0) {
+                size_t chunk = std::min(written, iov->iov_len);
+                iov->iov_base = reinterpret_cast<char *>(iov->iov_base) + chunk;
+                iov->iov_len -= chunk;
+                written -= chunk;
+                if (iov->iov_len == 0) {
+                    ++iov;
+                    --iovcnt;
+                }
+            }
         }
     }
 }
@@ -421,18 +476,44 @@ void linux_tcp_conn_t::write(const void *buf, size_t size, signal_t *closer) THR
     /* Enqueue the write so it will happen eventually */
     op.buffer = buf;
     op.size = size;
+    op.iov = NULL;
+    op.iovcnt = 0;
     op.dealloc = NULL;
     op.cond = &to_signal_when_done;
     write_queue.push(&op);
 
     /* Wait for the write to be done. If the write half of the network connection
-    is closed before or during our write, then `perform_write()` will turn into a
+    is closed before or during our write, then `perform_writev()` will turn into a
     no-op, so the cond will still get pulsed. */
     to_signal_when_done.wait();
 
     if (write_closed.is_pulsed()) throw tcp_conn_write_closed_exc_t();
 }
 
+void linux_tcp_conn_t::writev(const struct iovec *iov, int iovcnt, signal_t *closer) THROWS_ONLY(tcp_conn_write_closed_exc_t) {
+    write_op_wrapper_t sentry(this, closer);
+
+    write_queue_op_t op;
+    cond_t to_signal_when_done;
+
+    /* Flush out any data that's been buffered, so that things don't get out of order */
+    if (current_write_buffer->size > 0) internal_flush_write_buffer();
+
+    /* Like `write()`, we block until the write is done, so the caller's buffers
+    outlive it and we don't need to copy them or acquire the write semaphore. */
+    op.buffer = NULL;
+    op.size = 0;
+    op.iov = iov;
+    op.iovcnt = iovcnt;
+    op.dealloc = NULL;
+    op.cond = &to_signal_when_done;
+    write_queue.push(&op);
+
+    to_signal_when_done.wait();
+
+    if (write_closed.is_pulsed()) throw tcp_conn_write_closed_exc_t();
+}
+
 void linux_tcp_conn_t::write_buffered(const void *vbuf, size_t size, signal_t *closer) THROWS_ONLY(tcp_conn_write_closed_exc_t) {
     write_op_wrapper_t sentry(this, closer);
 
@@ -474,12 +555,13 @@ void linux_tcp_conn_t::flush_buffer(signal_t *closer) THROWS_ONLY(tcp_conn_write
 
     /* Wait until we know that the write buffer has gone out over the network.
     If the write half of the connection is closed, then the call to
-    `perform_write()` that `internal_flush_write_buffer()` will turn into a no-op,
+    `perform_writev()` that `internal_flush_write_buffer()` will turn into a no-op,
     but the queue will continue to be pumped and so our cond will still get
     pulsed. */
     write_queue_op_t op;
     cond_t to_signal_when_done;
     op.buffer = NULL;
+    op.iov = NULL;
     op.dealloc = NULL;
     op.cond = &to_signal_when_done;
     write_queue.push(&op);
@@ -514,7 +596,7 @@ void linux_tcp_conn_t::on_shutdown_write() {
     write_closed.pulse();
 
     /* We don't flush out the write queue or stop the write coro pool explicitly.
-    But by pulsing `write_closed`, we turn all `perform_write()` operations into
+    But by pulsing `write_closed`, we turn all `perform_writev()` operations into
     no-ops, so in practice the write queue empties. */
 }
 
@@ -618,10 +700,12 @@ void linux_tcp_conn_descriptor_t::make_overcomplicated(linux_tcp_conn_t **tcp_co
 /* Network listener object */
 linux_nonthrowing_tcp_listener_t::linux_nonthrowing_tcp_listener_t(
         const std::set<ip_address_t> &bind_addresses, int _port,
-        const boost::function<void(scoped_ptr_t<linux_tcp_conn_descriptor_t>&)> &cb) :
+        const boost::function<void(scoped_ptr_t<linux_tcp_conn_descriptor_t>&)> &cb,
+        bool _reuse_port) :
     callback(cb),
     local_addresses(bind_addresses),
     port(_port),
+    reuse_port(_reuse_port),
     bound(false),
     socks(std::max<size_t>(bind_addresses.size(), 1)), // Without a bind address, we still want a socket
     last_used_socket_index(0),
@@ -685,6 +769,15 @@ void linux_nonthrowing_tcp_listener_t::init_sockets() {
         int res = setsockopt(sock_fd, SOL_SOCKET, SO_REUSEADDR, &sockoptval, sizeof(sockoptval));
         guarantee_err(res != -1, "Could not set REUSEADDR option");
 
+        if (reuse_port) {
+#ifdef SO_REUSEPORT
+            res = setsockopt(sock_fd, SOL_SOCKET, SO_REUSEPORT, &sockoptval, sizeof(sockoptval));
+            guarantee_err(res != -1, "Could not set REUSEPORT option");
+#else
+            crash("SO_REUSEPORT is not supported on this platform");
+#endif
+        }
+
         /* XXX Making our socket NODELAY prevents the problem where responses to
          * pipelined requests are delayed, since the TCP Nagle algorithm will
          * notice when we send multiple small packets and try to coalesce them. But
@@ -901,8 +994,10 @@ int linux_tcp_bound_socket_t::get_port() const {
 }
 
 linux_tcp_listener_t::linux_tcp_listener_t(const std::set<ip_address_t> &bind_addresses, int port,
-    const boost::function<void(scoped_ptr_t<linux_tcp_conn_descriptor_t>&)> &callback) :
-        listener(new linux_nonthrowing_tcp_listener_t(bind_addresses, port, callback))
+    const boost::function<void(scoped_ptr_t<linux_tcp_conn_descriptor_t>&)> &callback,
+    bool reuse_port) :
+        listener(new linux_nonthrowing_tcp_listener_t(bind_addresses, port, callback,
+                                                      reuse_port))
 {
     if (!listener->begin_listening()) {
         throw address_in_use_exc_t("localhost", listener->get_port());
@@ -5,6 +5,7 @@
 #include <stdarg.h>
 #include <unistd.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <ifaddrs.h>
 #include <arpa/inet.h>
 #include <netinet/in.h>
@@ -104,6 +105,11 @@ public:
     pipe and throws `tcp_conn_write_closed_exc_t`. */
     void write(const void *buf, size_t size, signal_t *closer) THROWS_ONLY(tcp_conn_write_closed_exc_t);
 
+    /* writev() is like write(), but writes the `iovcnt` buffers of `iov` one after
+    another. They aren't copied, so they and `iov` must stay valid until it
+    returns. */
+    void writev(const struct iovec *iov, int iovcnt, signal_t *closer) THROWS_ONLY(tcp_conn_write_closed_exc_t);
+
     /* write_buffered() is like write(), but it might not send the data until
     flush_buffer*() or write() is called. Internally, it bundles together the
     buffered writes; this may improve performance. */
@@ -232,6 +238,9 @@ private:
 
     static const size_t WRITE_QUEUE_MAX_SIZE = 128 * KILOBYTE;
     static const size_t WRITE_CHUNK_SIZE = 8 * KILOBYTE;
+    /* The write handler writes the operations that are queued up at once with a
+    single writev() of up to this many buffers. */
+    static const size_t WRITEV_MAX_BUFFERS = 1024;
 
     /* Structs to avoid over-using dynamic allocation */
     struct write_buffer_t : public intrusive_list_node_t<write_buffer_t> {
@@ -241,8 +250,12 @@ private:
 
     struct write_queue_op_t : public intrusive_list_node_t<write_queue_op_t> {
         write_buffer_t *dealloc;
+        // What to write: `buffer`, or else the `iovcnt` buffers of `iov`, or else
+        // nothing if both are NULL.
         const void *buffer;
         size_t size;
+        const struct iovec *iov;
+        int iovcnt;
         cond_t *cond;
         auto_drainer_t::lock_t keepalive;
     };
@@ -253,6 +266,10 @@ private:
     private:
         linux_tcp_conn_t *parent;
         void coro_pool_callback(write_queue_op_t *operation, signal_t *interruptor);
+        // The operations being written together, and their buffers.  They're
+        // members so that their memory gets reused.
+        std::vector<write_queue_op_t *> ops;
+        std::vector<struct iovec> iovecs;
     } write_handler;
 
     template <class T>
@@ -282,8 +299,8 @@ private:
     data to be completely written. */
     void internal_flush_write_buffer();
 
-    /* Used to queue up buffers to write. The functions in `write_queue` will all be
-    `boost::bind()`s of the `perform_write()` function below. */
+    /* Used to queue up buffers to write. The write handler takes them off in order
+    and writes them with `perform_writev()` below. */
     unlimited_fifo_queue_t<write_queue_op_t*, intrusive_list_t<write_queue_op_t> > write_queue;
 
     /* This semaphore prevents the write queue from getting arbitrarily big. */
@@ -298,8 +315,8 @@ private:
     scoped_ptr_t<write_buffer_t> current_write_buffer;
 
     /* Used to actually perform a write. If the write end of the connection is open, then writes
-    `size` bytes from `buffer` to the socket. */
-    void perform_write(const void *buffer, size_t size);
+    the `iovcnt` buffers of `iov` to the socket. It changes `iov` as it goes. */
+    void perform_writev(struct iovec *iov, size_t iovcnt);
 
     scoped_ptr_t<auto_drainer_t> drainer;
 };
@@ -327,12 +344,15 @@ private:
 
 /* The linux_nonthrowing_tcp_listener_t is used to listen on a network port for incoming
 connections. Create a linux_nonthrowing_tcp_listener_t with some port and then call set_callback();
-the provided callback will be called in a new coroutine every time something connects. */
+the provided callback will be called in a new coroutine every time something connects.
+With `reuse_port`, its sockets are SO_REUSEPORT and other listeners that are too can
+bind to the same port, and the kernel spreads the connections over them. */
 
 class linux_nonthrowing_tcp_listener_t : private linux_event_callback_t {
 public:
     linux_nonthrowing_tcp_listener_t(const std::set<ip_address_t> &bind_addresses, int _port,
-        const boost::function<void(scoped_ptr_t<linux_tcp_conn_descriptor_t>&)> &callback);
+        const boost::function<void(scoped_ptr_t<linux_tcp_conn_descriptor_t>&)> &callback,
+        bool _reuse_port = false);
 
     ~linux_nonthrowing_tcp_listener_t();
 
@@ -372,6 +392,9 @@ private:
     // The port we're asked to bind to
     int port;
 
+    // Whether the sockets are SO_REUSEPORT
+    bool reuse_port;
+
     // Inidicates successful binding to a port
     bool bound;
 
@@ -404,7 +427,8 @@ public:
     linux_tcp_listener_t(linux_tcp_bound_socket_t *bound_socket,
         const boost::function<void(scoped_ptr_t<linux_tcp_conn_descriptor_t>&)> &callback);
     linux_tcp_listener_t(const std::set<ip_address_t> &bind_addresses, int port,
-        const boost::function<void(scoped_ptr_t<linux_tcp_conn_descriptor_t>&)> &callback);
+        const boost::function<void(scoped_ptr_t<linux_tcp_conn_descriptor_t>&)> &callback,
+        bool reuse_port = false);
 
     int get_port() const;
 
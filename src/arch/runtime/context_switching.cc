@@ -141,6 +141,20 @@ bool artificial_stack_t::address_is_stack_overflow(void *addr) {
     return stack == base;
 }
 
+void artificial_stack_t::release_unused_pages() {
+    rassert(!context.is_nil());
+    rassert(address_in_stack(context.pointer));
+
+    /* The stack grows down to the protection page, so what's unused is from just
+    above that page up to the page that the saved registers are on. */
+    const uintptr_t begin = uintptr_t(stack) + getpagesize();
+    const uintptr_t end = floor_aligned(uintptr_t(context.pointer), getpagesize());
+    if (end > begin) {
+        int res = madvise(reinterpret_cast<void *>(begin), end - begin, MADV_DONTNEED);
+        guarantee_err(res == 0, "madvise() failed on a coroutine stack");
+    }
+}
+
 extern "C" {
 // `lightweight_swapcontext` is defined in assembly further down.  If we didn't add the
 // asm("_lightweight_swapcontext") here, we'd have to conditionally compile the symbol name in the
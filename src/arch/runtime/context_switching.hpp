@@ -52,6 +52,11 @@ public:
     /* Returns `true` if the given address is in the stack's protection page. */
     bool address_is_stack_overflow(void *);
 
+    /* Gives the pages of the stack below the saved context back to the OS, which
+    hands them back zeroed once they get used again.  Nothing lives there while the
+    context is swapped out, so it must be, i.e. `context` must be non-nil. */
+    void release_unused_pages();
+
     /* Returns the base of the stack */
     void* get_stack_base() { return static_cast<char*>(stack) + stack_size; }
 
@@ -0,0 +1,323 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "arch/runtime/coro_sampler.hpp"
+
+#include <signal.h>
+#include <stdint.h>
+#include <string.h>
+#include <ucontext.h>
+
+#include <atomic>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "errors.hpp"
+#include <boost/bind.hpp>
+
+#include "arch/io/io_utils.hpp"
+#include "arch/runtime/context_switching.hpp"
+#include "arch/runtime/coroutines.hpp"
+#include "arch/runtime/runtime.hpp"
+#include "arch/runtime/runtime_utils.hpp"
+#include "backtrace.hpp"
+#include "concurrency/pmap.hpp"
+#include "utils.hpp"
+
+#ifndef __MACH__
+// See timer_signal_provider.cc.
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+
+/* A slot of a thread's table of samples.  The signal handler fills in the key of
+an empty slot before it sets `used`, so code that reads the table on the same
+thread sees either an empty slot or a whole key, even if the handler cuts in. */
+struct coro_sample_slot_t {
+    volatile bool used;
+    const char *spawn_function;
+    void *frames[CORO_SAMPLER_BACKTRACE_DEPTH];
+    volatile uint64_t count;
+};
+
+struct coro_sample_table_t {
+    coro_sample_slot_t slots[CORO_SAMPLER_TABLE_SIZE];
+    volatile uint64_t dropped;
+};
+
+// Allocated by the thread's first start(), never freed, so the signal handler can
+// always look at its thread's table.
+static coro_sample_table_t *sample_tables[MAX_THREADS];
+
+#if defined(__linux__) && defined(__x86_64__)
+/* Fills `frames` with the interrupted instruction and the return addresses of the
+frames of the interrupted coroutine, following the frame pointers as long as they
+stay on its stack and go up it.  Outside of a coroutine, only the instruction. */
+static void walk_frames(const ucontext_t *context, coro_t *coro,
+                        void *frames[CORO_SAMPLER_BACKTRACE_DEPTH]) {
+    frames[0] = reinterpret_cast<void *>(context->uc_mcontext.gregs[REG_RIP]);
+    if (coro == NULL) {
+        return;
+    }
+    artificial_stack_t *stack = coro->get_stack();
+    uintptr_t fp = context->uc_mcontext.gregs[REG_RBP];
+    for (size_t i = 1; i < CORO_SAMPLER_BACKTRACE_DEPTH; ++i) {
+        void *frame_begin = reinterpret_cast<void *>(fp);
+        void *frame_end = reinterpret_cast<void *>(fp + 2 * sizeof(void *) - 1);
+        if (fp % sizeof(void *) != 0
+            || !stack->address_in_stack(frame_begin)
+            || !stack->address_in_stack(frame_end)
+            || stack->address_is_stack_overflow(frame_begin)) {
+            return;
+        }
+        void **frame = reinterpret_cast<void **>(fp);
+        if (frame[1] == NULL) {
+            return;
+        }
+        frames[i] = frame[1];
+        const uintptr_t next = reinterpret_cast<uintptr_t>(frame[0]);
+        if (next <= fp) {
+            return;
+        }
+        fp = next;
+    }
+}
+#else
+static void walk_frames(UNUSED const ucontext_t *context, UNUSED coro_t *coro,
+                        UNUSED void *frames[CORO_SAMPLER_BACKTRACE_DEPTH]) { }
+#endif
+
+static void coro_sampler_signal_handler(UNUSED int signum, UNUSED siginfo_t *siginfo,
+                                        void *uctx) {
+    const int thread = get_thread_id().threadnum;
+    if (thread < 0 || thread >= MAX_THREADS || sample_tables[thread] == NULL) {
+        return;
+    }
+    coro_sample_table_t *table = sample_tables[thread];
+
+    coro_t *coro = coro_t::self();
+    const char *spawn_function = coro == NULL ? NULL : coro->get_spawn_function();
+    void *frames[CORO_SAMPLER_BACKTRACE_DEPTH];
+    memset(frames, 0, sizeof(frames));
+    walk_frames(static_cast<const ucontext_t *>(uctx), coro, frames);
+
+    uint64_t hash = reinterpret_cast<uintptr_t>(spawn_function);
+    for (size_t i = 0; i < CORO_SAMPLER_BACKTRACE_DEPTH; ++i) {
+        hash = hash * 1099511628211ULL + reinterpret_cast<uintptr_t>(frames[i]);
+    }
+    for (size_t probe = 0; probe < CORO_SAMPLER_MAX_PROBES; ++probe) {
+        coro_sample_slot_t *slot = &table->slots[(hash + probe) % CORO_SAMPLER_TABLE_SIZE];
+        if (!slot->used) {
+            slot->spawn_function = spawn_function;
+            memcpy(slot->frames, frames, sizeof(frames));
+            slot->count = 1;
+            std::atomic_signal_fence(std::memory_order_release);
+            slot->used = true;
+            return;
+        }
+        if (slot->spawn_function == spawn_function
+            && memcmp(slot->frames, frames, sizeof(frames)) == 0) {
+            slot->count = slot->count + 1;
+            return;
+        }
+    }
+    table->dropped = table->dropped + 1;
+}
+
+// A sample as folded_stacks() adds them up over the threads.
+typedef std::pair<const char *, std::vector<void *> > coro_sample_key_t;
+
+coro_sampler_t &coro_sampler_t::get_global_sampler() {
+    // See coro_profiler_t::get_global_profiler().
+    static coro_sampler_t sampler;
+    return sampler;
+}
+
+coro_sampler_t::coro_sampler_t() : running(false) {
+    struct sigaction sa = make_sa_sigaction(SA_SIGINFO | SA_RESTART,
+                                            &coro_sampler_signal_handler);
+    int res = sigaction(SIGPROF, &sa, NULL);
+    guarantee_err(res == 0, "Could not install the coro sampler's SIGPROF handler");
+}
+
+void coro_sampler_t::start() {
+    if (running) {
+        return;
+    }
+    pmap(get_num_threads(), boost::bind(&coro_sampler_t::start_on_thread, this, _1));
+    running = true;
+}
+
+void coro_sampler_t::stop() {
+    if (!running) {
+        return;
+    }
+    pmap(get_num_threads(), boost::bind(&coro_sampler_t::stop_on_thread, this, _1));
+    running = false;
+}
+
+void coro_sampler_t::clear() {
+    pmap(get_num_threads(), boost::bind(&coro_sampler_t::clear_on_thread, this, _1));
+}
+
+void coro_sampler_t::start_on_thread(int thread) {
+    on_thread_t thread_switcher((threadnum_t(thread)));
+    if (sample_tables[thread] == NULL) {
+        sample_tables[thread] = new coro_sample_table_t();
+    }
+
+    // The thread pool blocks every signal but `SIGSEGV`.
+    sigset_t sigmask;
+    int res = sigemptyset(&sigmask);
+    guarantee_err(res == 0, "Could not get an empty sigmask");
+    res = sigaddset(&sigmask, SIGPROF);
+    guarantee_err(res == 0, "Could not add SIGPROF to sigmask");
+    res = pthread_sigmask(SIG_UNBLOCK, &sigmask, NULL);
+    guarantee_xerr(res == 0, res, "Could not unblock SIGPROF");
+
+#ifndef __MACH__
+    // The timer counts the CPU time of this very thread and signals only it.
+    struct sigevent evp;
+    memset(&evp, 0, sizeof(evp));
+    evp.sigev_signo = SIGPROF;
+    evp.sigev_notify = SIGEV_THREAD_ID;
+    evp.sigev_notify_thread_id = _gettid();
+    res = timer_create(CLOCK_THREAD_CPUTIME_ID, &evp, &timers[thread]);
+    guarantee_err(res == 0, "Could not create the coro sampler's timer");
+
+    itimerspec spec;
+    spec.it_value.tv_sec = 0;
+    spec.it_value.tv_nsec = BILLION / CORO_SAMPLER_FREQUENCY;
+    spec.it_interval = spec.it_value;
+    res = timer_settime(timers[thread], 0, &spec, NULL);
+    guarantee_err(res == 0, "Could not arm the coro sampler's timer");
+#endif  // __MACH__
+}
+
+void coro_sampler_t::stop_on_thread(int thread) {
+    on_thread_t thread_switcher((threadnum_t(thread)));
+#ifndef __MACH__
+    int res = timer_delete(timers[thread]);
+    guarantee_err(res == 0, "Could not delete the coro sampler's timer");
+#endif  // __MACH__
+}
+
+void coro_sampler_t::clear_on_thread(int thread) {
+    on_thread_t thread_switcher((threadnum_t(thread)));
+    if (sample_tables[thread] == NULL) {
+        return;
+    }
+    // The handler mustn't cut in while the table is half cleared.  A signal that
+    // comes in the meantime waits.
+    sigset_t sigmask, old_sigmask;
+    int res = sigemptyset(&sigmask);
+    guarantee_err(res == 0, "Could not get an empty sigmask");
+    res = sigaddset(&sigmask, SIGPROF);
+    guarantee_err(res == 0, "Could not add SIGPROF to sigmask");
+    res = pthread_sigmask(SIG_BLOCK, &sigmask, &old_sigmask);
+    guarantee_xerr(res == 0, res, "Could not block SIGPROF");
+    memset(sample_tables[thread], 0, sizeof(coro_sample_table_t));
+    res = pthread_sigmask(SIG_SETMASK, &old_sigmask, NULL);
+    guarantee_xerr(res == 0, res, "Could not restore the sigmask");
+}
+
+static void collect_samples_on_thread(
+        int thread, std::vector<std::map<coro_sample_key_t, uint64_t> > *samples_out,
+        std::vector<uint64_t> *dropped_out) {
+    on_thread_t thread_switcher((threadnum_t(thread)));
+    const coro_sample_table_t *table = sample_tables[thread];
+    if (table == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < CORO_SAMPLER_TABLE_SIZE; ++i) {
+        const coro_sample_slot_t &slot = table->slots[i];
+        if (!slot.used) {
+            continue;
+        }
+        std::atomic_signal_fence(std::memory_order_acquire);
+        std::vector<void *> frames(slot.frames, slot.frames + CORO_SAMPLER_BACKTRACE_DEPTH);
+        while (!frames.empty() && frames.back() == NULL) {
+            frames.pop_back();
+        }
+        (*samples_out)[thread][std::make_pair(slot.spawn_function, frames)] += slot.count;
+    }
+    (*dropped_out)[thread] = table->dropped;
+}
+
+// Turns the `__PRETTY_FUNCTION__` of a `get_and_init_coro()` into the type of the
+// coroutine's action, see the debug mode's coro_t::parse_coroutine_type().
+static std::string coro_type_of(const char *spawn_function) {
+    if (spawn_function == NULL) {
+        return "[scheduler]";
+    }
+    std::string type(spawn_function);
+    const std::string marker = "Callable = ";
+    size_t begin = type.find(marker);
+    if (begin != std::string::npos) {
+        begin += marker.size();
+        size_t end = type.find_first_of(";]", begin);
+        type = type.substr(begin, end == std::string::npos ? std::string::npos : end - begin);
+    }
+    return type;
+}
+
+// Flamegraphs split the frames at semicolons and the count off at the last space.
+static std::string folded_name(std::string name) {
+    for (size_t i = 0; i < name.size(); ++i) {
+        if (name[i] == ';' || name[i] == '\n') {
+            name[i] = ':';
+        }
+    }
+    return name;
+}
+
+static const std::string &frame_name(void *addr, std::map<void *, std::string> *cache) {
+    auto it = cache->find(addr);
+    if (it != cache->end()) {
+        return it->second;
+    }
+    backtrace_frame_t frame(addr);
+    frame.initialize_symbols();
+    std::string name;
+    try {
+        name = frame.get_demangled_name();
+    } catch (const demangle_failed_exc_t &) {
+        name = frame.get_name();
+    }
+    if (name.empty()) {
+        name = strprintf("%p", addr);
+    }
+    return cache->insert(std::make_pair(addr, folded_name(name))).first->second;
+}
+
+std::string coro_sampler_t::folded_stacks() {
+    std::vector<std::map<coro_sample_key_t, uint64_t> > per_thread_samples(get_num_threads());
+    std::vector<uint64_t> per_thread_dropped(get_num_threads(), 0);
+    pmap(get_num_threads(), boost::bind(&collect_samples_on_thread, _1,
+                                        &per_thread_samples, &per_thread_dropped));
+
+    std::map<coro_sample_key_t, uint64_t> samples;
+    uint64_t dropped = 0;
+    for (int i = 0; i < get_num_threads(); ++i) {
+        for (auto it = per_thread_samples[i].begin(); it != per_thread_samples[i].end(); ++it) {
+            samples[it->first] += it->second;
+        }
+        dropped += per_thread_dropped[i];
+    }
+
+    std::map<void *, std::string> frame_names;
+    std::string out;
+    for (auto it = samples.begin(); it != samples.end(); ++it) {
+        out += folded_name(coro_type_of(it->first.first));
+        // The backtrace goes from the innermost frame out, the folded stack the
+        // other way.
+        const std::vector<void *> &frames = it->first.second;
+        for (auto jt = frames.rbegin(); jt != frames.rend(); ++jt) {
+            out += ";";
+            out += frame_name(*jt, &frame_names);
+        }
+        out += strprintf(" %" PRIu64 "\n", it->second);
+    }
+    if (dropped != 0) {
+        out += strprintf("[dropped] %" PRIu64 "\n", dropped);
+    }
+    return out;
+}
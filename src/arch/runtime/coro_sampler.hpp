@@ -0,0 +1,67 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#ifndef ARCH_RUNTIME_CORO_SAMPLER_HPP_
+#define ARCH_RUNTIME_CORO_SAMPLER_HPP_
+
+#include <time.h>
+
+#include <string>
+
+#include "errors.hpp"
+#include "config/args.hpp"
+
+/*
+ * The `coro_sampler_t` is a sampling profiler for coroutines.  Unlike the
+ * `coro_profiler_t`, it is in every build and does nothing until it is started at
+ * run time, through the `/ajax/coro_samples` page of the web UI, so it can be
+ * turned on in production.
+ *
+ * Once started, every thread of the thread pool gets a timer that interrupts it
+ * with `SIGPROF` every 1/`CORO_SAMPLER_FREQUENCY` seconds of CPU time the thread
+ * uses.  The signal handler counts a sample of what the thread was doing: the
+ * function that spawned the running coroutine and a backtrace of up to
+ * `CORO_SAMPLER_BACKTRACE_DEPTH` frames.  The backtrace follows frame pointers
+ * on the coroutine's stack, so past its first frame it's only good in builds
+ * with frame pointers (`NO_OMIT_FRAME_POINTER=1`), but it's checked against the
+ * bounds of the stack and never faults.  OS X has no per-thread CPU timers,
+ * so there the sampler never takes a sample.
+ *
+ * The samples of a thread are counted in a hash table of
+ * `CORO_SAMPLER_TABLE_SIZE` slots that is allocated when the sampler starts, so
+ * the signal handler never allocates or locks.  Samples that find no room are
+ * counted as dropped.
+ *
+ * `folded_stacks()` renders the samples in the "folded" format that
+ * flamegraph.pl takes: a line of `;`-separated frames, from the coroutine's type
+ * down, and a count for every distinct sample.
+ *
+ * The functions must be called from a coroutine, and not concurrently with each
+ * other.
+ */
+class coro_sampler_t {
+public:
+    static coro_sampler_t &get_global_sampler();
+
+    // Starting keeps the samples taken so far, stopping keeps the ones taken.
+    void start();
+    void stop();
+    bool is_running() const { return running; }
+    void clear();
+
+    std::string folded_stacks();
+
+private:
+    coro_sampler_t();
+
+    void start_on_thread(int thread);
+    void stop_on_thread(int thread);
+    void clear_on_thread(int thread);
+
+    bool running;
+#ifndef __MACH__
+    timer_t timers[MAX_THREADS];
+#endif
+
+    DISABLE_COPYING(coro_sampler_t);
+};
+
+#endif /* ARCH_RUNTIME_CORO_SAMPLER_HPP_ */
@@ -22,10 +22,12 @@
 #include "rethinkdb_backtrace.hpp"
 #include "arch/runtime/coro_profiler.hpp"
 
-static perfmon_counter_t pm_active_coroutines, pm_allocated_coroutines;
+static perfmon_counter_t pm_active_coroutines, pm_allocated_coroutines,
+    pm_released_coroutine_stacks;
 static perfmon_multi_membership_t pm_coroutines_membership(&get_global_perfmon_collection(),
     &pm_active_coroutines, "active_coroutines",
     &pm_allocated_coroutines, "allocated_coroutines",
+    &pm_released_coroutine_stacks, "released_coroutine_stacks",
     NULLPTR);
 
 size_t coro_stack_size = COROUTINE_STACK_SIZE; //Default, setable by command-line parameter
@@ -46,8 +48,12 @@ struct coro_globals_t {
     /* The previous context. */
     coro_t *prev_coro;
 
-    /* A list of coro_t objects that are not in use. */
+    /* Lists of coro_t objects that are not in use, the most recently used last.
+    `free_coros` has up to COROUTINE_HOT_FREE_STACKS of them, and the ones that fall
+    out of it go on `cold_free_coros` with their stacks released to the OS. We
+    reuse them in that order. */
     intrusive_list_t<coro_t> free_coros;
+    intrusive_list_t<coro_t> cold_free_coros;
 
 #ifndef NDEBUG
 
@@ -90,6 +96,11 @@ struct coro_globals_t {
             free_coros.remove(s);
             delete s;
         }
+        while (coro_t *s = cold_free_coros.head()) {
+            cold_free_coros.remove(s);
+            --pm_released_coroutine_stacks;
+            delete s;
+        }
     }
 
 };
@@ -124,7 +135,11 @@ coro_t::coro_t() :
     stack(&coro_t::run, coro_stack_size),
     current_thread_(linux_thread_pool_t::thread_id),
     notified_(false),
-    waiting_(false)
+    waiting_(false),
+    times_running_(false),
+    running_ticks_(0),
+    resumed_at_(0),
+    spawn_function_(NULL)
 #ifndef NDEBUG
     , selfname_number(get_thread_id().threadnum + MAX_THREADS * ++coro_selfname_counter)
 #endif
@@ -143,7 +158,18 @@ coro_t::coro_t() :
 }
 
 void coro_t::return_coro_to_free_list(coro_t *coro) {
+    /* `coro` itself is still running until it swaps out, but the one that went
+    unused the longest (which isn't `coro`, since there are at least two) has its
+    context saved. */
     cglobals->free_coros.push_back(coro);
+    if (cglobals->free_coros.size() > COROUTINE_HOT_FREE_STACKS) {
+        coro_t *coldest = cglobals->free_coros.head();
+        rassert(coldest != coro);
+        cglobals->free_coros.remove(coldest);
+        coldest->stack.release_unused_pages();
+        cglobals->cold_free_coros.push_back(coldest);
+        ++pm_released_coroutine_stacks;
+    }
 }
 
 coro_t::~coro_t() {
@@ -180,6 +206,8 @@ void coro_t::run() {
         PROFILER_CORO_RESUME;
         coro->action_wrapper.run();
         PROFILER_CORO_YIELD(0);
+        coro->times_running_ = false;
+        coro->running_ticks_ = 0;
 #ifndef NDEBUG
         cglobals->running_coroutine_counts[coro->coroutine_type.c_str()]--;
         cglobals->active_coroutines.erase(coro);
@@ -232,11 +260,13 @@ void coro_t::wait() {   /* class method */
     self()->waiting_ = true;
 
     PROFILER_CORO_YIELD(1);
+    self()->on_yield();
     if (cglobals->prev_coro) {
         context_switch(&self()->stack.context, &cglobals->prev_coro->stack.context);
     } else {
         context_switch(&self()->stack.context, &cglobals->scheduler);
     }
+    self()->on_resume();
     PROFILER_CORO_RESUME;
 
     rassert(self());
@@ -244,6 +274,21 @@ void coro_t::wait() {   /* class method */
     self()->waiting_ = false;
 }
 
+void coro_t::time_running() {   /* class method */
+    rassert(self(), "Not in a coroutine context");
+    if (!self()->times_running_) {
+        self()->times_running_ = true;
+        self()->resumed_at_ = get_ticks();
+    }
+}
+
+ticks_t coro_t::get_running_ticks() const {
+    if (times_running_ && this == self()) {
+        return running_ticks_ + (get_ticks() - resumed_at_);
+    }
+    return running_ticks_;
+}
+
 void coro_t::yield() {  /* class method */
     rassert(self(), "Not in a coroutine context");
     self()->notify_later_ordered();
@@ -268,6 +313,7 @@ void coro_t::notify_now_deprecated() {
 
     if (coro_t::self() != NULL) {
         PROFILER_CORO_YIELD(1);
+        coro_t::self()->on_yield();
     }
     coro_t *prev_prev_coro = cglobals->prev_coro;
     cglobals->prev_coro = cglobals->current_coro;
@@ -283,6 +329,7 @@ void coro_t::notify_now_deprecated() {
     cglobals->current_coro = cglobals->prev_coro;
     cglobals->prev_coro = prev_prev_coro;
     if (coro_t::self() != NULL) {
+        coro_t::self()->on_resume();
         PROFILER_CORO_RESUME;
     }
 
@@ -359,11 +406,15 @@ coro_t * coro_t::get_coro() {
     rassert(coroutines_have_been_initialized());
     coro_t *coro;
 
-    if (cglobals->free_coros.size() == 0) {
-        coro = new coro_t();
-    } else {
+    if (cglobals->free_coros.size() != 0) {
         coro = cglobals->free_coros.tail();
         cglobals->free_coros.remove(coro);
+    } else if (cglobals->cold_free_coros.size() != 0) {
+        coro = cglobals->cold_free_coros.tail();
+        cglobals->cold_free_coros.remove(coro);
+        --pm_released_coroutine_stacks;
+    } else {
+        coro = new coro_t();
     }
 
     rassert(!coro->intrusive_list_node_t<coro_t>::in_a_list());
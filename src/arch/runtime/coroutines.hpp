@@ -113,6 +113,13 @@ public:
     `notify_later_ordered()` in. */
     void notify_later_ordered();
 
+    /* Makes the current coroutine keep track of how long it runs, until its action
+    returns.  The other coroutines don't pay for the timing. */
+    static void time_running();
+    // How long the coroutine ran since it called time_running(), without the time
+    // it spent waiting.
+    ticks_t get_running_ticks() const;
+
 #ifndef NDEBUG
     // A unique identifier for this particular instance of coro_t over
     // the lifetime of the process.
@@ -124,6 +131,11 @@ public:
     const std::string& get_coroutine_type() { return coroutine_type; }
 #endif
 
+    // The `__PRETTY_FUNCTION__` of the `get_and_init_coro()` that spawned the
+    // coroutine, which names the type of its action, in every build.  Nothing
+    // parses it until it's needed (see coro_sampler_t).
+    const char *get_spawn_function() const { return spawn_function_; }
+
     static void set_coroutine_stack_size(size_t size);
 
     artificial_stack_t * get_stack();
@@ -162,6 +174,7 @@ private:
 #ifndef NDEBUG
         coro->parse_coroutine_type(__PRETTY_FUNCTION__);
 #endif
+        coro->spawn_function_ = __PRETTY_FUNCTION__;
         coro->grab_spawn_backtrace();
         coro->action_wrapper.reset(action);
 
@@ -197,8 +210,24 @@ private:
     bool notified_;
     bool waiting_;
 
+    void on_resume() {
+        if (times_running_) {
+            resumed_at_ = get_ticks();
+        }
+    }
+    void on_yield() {
+        if (times_running_) {
+            running_ticks_ += get_ticks() - resumed_at_;
+        }
+    }
+    bool times_running_;
+    ticks_t running_ticks_;
+    ticks_t resumed_at_;
+
     callable_action_wrapper_t action_wrapper;
 
+    const char *spawn_function_;
+
 #ifndef NDEBUG
     int64_t selfname_number;
     std::string coroutine_type;
@@ -16,6 +16,7 @@
 #include "config/args.hpp"
 #include "utils.hpp"
 #include "arch/runtime/event_queue.hpp"
+#include "arch/runtime/scheduler_stats.hpp"
 #include "arch/runtime/thread_pool.hpp"
 #include "perfmon/perfmon.hpp"
 
@@ -45,38 +46,87 @@ int epoll_to_user(int mode) {
     return out_mode;
 }
 
-epoll_event_queue_t::epoll_event_queue_t(linux_queue_parent_t *_parent)
-    : parent(_parent) {
+static perfmon_counter_t pm_eventloop_spin_hits, pm_eventloop_spin_misses;
+static perfmon_multi_membership_t pm_eventloop_spin_membership(
+    &get_global_perfmon_collection(),
+    &pm_eventloop_spin_hits, "eventloop_spin_hits",
+    &pm_eventloop_spin_misses, "eventloop_spin_misses",
+    NULLPTR);
+
+epoll_event_queue_t::epoll_event_queue_t(linux_queue_parent_t *_parent,
+                                         int64_t _max_spin_nanos)
+    : parent(_parent), max_spin_nanos(_max_spin_nanos),
+      spin_nanos(_max_spin_nanos) {
+    rassert(max_spin_nanos >= 0);
+
     // Create a poll fd
 
     epoll_fd = epoll_create1(0);
     guarantee_err(epoll_fd >= 0, "Could not create epoll fd");
 }
 
-void epoll_event_queue_t::run() {
-    int res;
+int epoll_event_queue_t::wait(int timeout_ms) {
+    // Grab the events from the kernel!
+    int res = epoll_wait(epoll_fd, events, MAX_IO_EVENT_PROCESSING_BATCH_SIZE, timeout_ms);
 
-    // Now, start the loop
-    while (!parent->should_shut_down()) {
-        // Grab the events from the kernel!
-        res = epoll_wait(epoll_fd, events, MAX_IO_EVENT_PROCESSING_BATCH_SIZE, -1);
-
-        // epoll_wait might return with EINTR in some cases (in
-        // particular under GDB), we just need to retry.
-        if (res == -1 && errno == EINTR) {
-            // If the thread has been signalled, we already handled
-            // the signal in our signal action.
-            res = 0;
+    // epoll_wait might return with EINTR in some cases (in
+    // particular under GDB), we just need to retry.
+    if (res == -1 && errno == EINTR) {
+        // If the thread has been signalled, we already handled
+        // the signal in our signal action.
+        res = 0;
+    }
+
+    // When epoll_wait returns with EBADF, EFAULT, and EINVAL,
+    // it probably means that epoll_fd is no longer valid. There's
+    // no reason to try epoll_wait again, unless we can create a
+    // new descriptor (which we probably can't at this point).
+    guarantee_err(res != -1, "Waiting for epoll events failed");
+
+    return res;
+}
+
+int epoll_event_queue_t::spin_then_wait() {
+    int res = wait(0);
+    if (res != 0) {
+        return res;
+    }
+
+    // While we spin, other threads put their messages on our message hub without
+    // writing to its eventfd, and we pick them up here instead of sleeping in the
+    // kernel until that write wakes us.
+    parent->begin_spinning();
+    const ticks_t deadline = get_ticks() + spin_nanos;
+    for (;;) {
+        if (parent->spin()) {
+            break;
+        }
+        res = wait(0);
+        if (res != 0) {
+            parent->end_spinning();
+            break;
+        }
+        if (get_ticks() >= deadline) {
+            if (parent->end_spinning()) {
+                break;
+            }
+            ++pm_eventloop_spin_misses;
+            spin_nanos = std::max(spin_nanos / 2,
+                                  max_spin_nanos / EVENT_LOOP_SPIN_MIN_FRACTION);
+            return wait(-1);
         }
+    }
 
-        // When epoll_wait returns with EBADF, EFAULT, and EINVAL,
-        // it probably means that epoll_fd is no longer valid. There's
-        // no reason to try epoll_wait again, unless we can create a
-        // new descriptor (which we probably can't at this point).
-        guarantee_err(res != -1, "Waiting for epoll events failed");
+    ++pm_eventloop_spin_hits;
+    spin_nanos = std::min(spin_nanos * 2, max_spin_nanos);
+    return res;
+}
 
+void epoll_event_queue_t::run() {
+    // Now, start the loop
+    while (!parent->should_shut_down()) {
         // nevents might be used by forget_resource during the loop
-        nevents = res;
+        nevents = max_spin_nanos == 0 ? wait(-1) : spin_then_wait();
 
 #ifndef NDEBUG
         /* Sanity check: Make sure epoll() didn't give us any events we didn't ask for */
@@ -97,6 +147,7 @@ void epoll_event_queue_t::run() {
         // Caches by Goetz Graege and Pre-Ake Larson).
 
         block_pm_duration event_loop_timer(&pm_eventloop);
+        const ticks_t pass_start = global_scheduler_profiling ? get_ticks() : 0;
 
         for (int i = 0; i < nevents; i++) {
             if (events[i].data.ptr == NULL) {
@@ -119,6 +170,10 @@ void epoll_event_queue_t::run() {
         nevents = 0;
 
         parent->pump();
+
+        if (pass_start != 0) {
+            record_event_loop_pass_time(get_ticks() - pass_start);
+        }
     }
 }
 
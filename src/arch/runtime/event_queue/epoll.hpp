@@ -15,7 +15,9 @@
 // Event queue structure
 struct epoll_event_queue_t {
 public:
-    explicit epoll_event_queue_t(linux_queue_parent_t *parent);
+    // An idle queue spins for up to `max_spin_nanos` before it blocks; see
+    // `spin_then_wait()`.
+    epoll_event_queue_t(linux_queue_parent_t *parent, int64_t max_spin_nanos);
     void run();
     ~epoll_event_queue_t();
 
@@ -26,10 +28,23 @@ public:
     void forget_resource(fd_t resource, linux_event_callback_t *cb);
 
 private:
+    // Gets the events that are ready into `events`, waiting up to `timeout_ms`
+    // for some, or forever if it's -1.
+    int wait(int timeout_ms);
+    // Waits for events, spinning on the parent's messages and on zero-timeout
+    // epoll_wait() for up to `spin_nanos` before it blocks.
+    int spin_then_wait();
+
     linux_queue_parent_t *parent;
 
     fd_t epoll_fd;
 
+    const int64_t max_spin_nanos;
+    // How long the next spin lasts.  It doubles up to `max_spin_nanos` whenever a
+    // spin finds something to do, and halves down to a fraction of it whenever it
+    // doesn't, so that a thread that's idle for long stretches mostly blocks.
+    int64_t spin_nanos;
+
     // We store this as a class member because forget_resource needs
     // to go through the events and remove queued messages for
     // resources that are being destroyed.
@@ -16,6 +16,7 @@
 #include "config/args.hpp"
 #include "utils.hpp"
 #include "arch/runtime/event_queue.hpp"
+#include "arch/runtime/scheduler_stats.hpp"
 #include "arch/runtime/thread_pool.hpp"
 #include "arch/io/timer_provider.hpp"
 #include "perfmon/perfmon.hpp"
@@ -68,7 +69,8 @@ DEBUG_VAR
     return out_mode;
 }
 
-poll_event_queue_t::poll_event_queue_t(linux_queue_parent_t *_parent)
+poll_event_queue_t::poll_event_queue_t(linux_queue_parent_t *_parent,
+                                       UNUSED int64_t max_spin_nanos)
     : parent(_parent) {
 }
 
@@ -118,6 +120,7 @@ void poll_event_queue_t::run() {
         guarantee_err(res != -1, "Waiting for poll events failed");
 
         block_pm_duration event_loop_timer(&pm_eventloop);
+        const ticks_t pass_start = global_scheduler_profiling ? get_ticks() : 0;
 
         int count = 0;
         for (unsigned int i = 0; i < watched_fds.size(); i++) {
@@ -144,6 +147,10 @@ void poll_event_queue_t::run() {
 #endif  // RDB_TIMER_PROVIDER
 
         parent->pump();
+
+        if (pass_start != 0) {
+            record_event_loop_pass_time(get_ticks() - pass_start);
+        }
     }
 }
 
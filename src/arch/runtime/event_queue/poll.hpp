@@ -14,7 +14,9 @@
 // Event queue structure
 class poll_event_queue_t {
 public:
-    explicit poll_event_queue_t(linux_queue_parent_t *parent);
+    // The poll-based queue always blocks right away; it only takes
+    // `max_spin_nanos` to match epoll_event_queue_t.
+    poll_event_queue_t(linux_queue_parent_t *parent, int64_t max_spin_nanos);
     void run();
     ~poll_event_queue_t();
 
@@ -15,6 +15,13 @@ struct linux_event_callback_t {
 struct linux_queue_parent_t {
     virtual void pump() = 0;
     virtual bool should_shut_down() = 0;
+    // The event queue may spin instead of blocking right away.  Then it calls
+    // begin_spinning() and spin() in a loop, until spin() returns true, or until it
+    // gives up and calls end_spinning(), which returns true if it shouldn't block
+    // after all.  See linux_message_hub_t.
+    virtual void begin_spinning() = 0;
+    virtual bool spin() = 0;
+    virtual bool end_spinning() = 0;
     virtual ~linux_queue_parent_t() {}
 };
 
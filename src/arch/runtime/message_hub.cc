@@ -6,6 +6,7 @@
 
 #include "config/args.hpp"
 #include "arch/runtime/event_queue.hpp"
+#include "arch/runtime/scheduler_stats.hpp"
 #include "arch/runtime/thread_pool.hpp"
 #include "logger.hpp"
 
@@ -19,7 +20,8 @@ linux_message_hub_t::linux_message_hub_t(linux_event_queue_t *queue,
                                          threadnum_t current_thread)
     : queue_(queue),
       thread_pool_(thread_pool),
-      is_woken_up_(false),
+      incoming_messages_(NULL),
+      is_woken_up_(0),
       current_thread_(current_thread) {
 
 #ifndef NDEBUG
@@ -43,11 +45,14 @@ linux_message_hub_t::~linux_message_hub_t() {
         guarantee(get_priority_msg_list(p).empty());
     }
 
-    guarantee(incoming_messages_.empty());
+    guarantee(incoming_messages_ == NULL);
 }
 
 void linux_message_hub_t::do_store_message(threadnum_t nthread, linux_thread_message_t *msg) {
     rassert(0 <= nthread.threadnum && nthread.threadnum < thread_pool_->n_threads);
+    if (global_scheduler_profiling) {
+        msg->enqueue_ticks = get_ticks();
+    }
     queues_[nthread.threadnum].msg_local_list.push_back(msg);
 }
 
@@ -90,15 +95,44 @@ void linux_message_hub_t::store_message_sometime(threadnum_t nthread, linux_thre
 
 
 void linux_message_hub_t::insert_external_message(linux_thread_message_t *msg) {
-    bool do_wake_up;
-    {
-        spinlock_acq_t acq(&incoming_messages_lock_);
-        do_wake_up = !check_and_set_is_woken_up();
-        incoming_messages_.push_back(msg);
+    if (global_scheduler_profiling) {
+        msg->enqueue_ticks = get_ticks();
+    }
+    msg_list_t msgs;
+    msgs.push_back(msg);
+    push_incoming_messages(&msgs);
+}
+
+void linux_message_hub_t::push_incoming_messages(msg_list_t *msgs) {
+    // Link them up newest first, like incoming_messages_ is.
+    linux_thread_message_t *newest = NULL;
+    linux_thread_message_t *oldest = NULL;
+    while (linux_thread_message_t *m = msgs->head()) {
+        msgs->remove(m);
+        m->next_incoming = newest;
+        newest = m;
+        if (oldest == NULL) {
+            oldest = m;
+        }
+    }
+    if (newest == NULL) {
+        return;
+    }
+
+    linux_thread_message_t *old_head = incoming_messages_;
+    for (;;) {
+        oldest->next_incoming = old_head;
+        linux_thread_message_t *seen
+            = __sync_val_compare_and_swap(&incoming_messages_, old_head, newest);
+        if (seen == old_head) {
+            break;
+        }
+        old_head = seen;
     }
 
-    // Wakey wakey eggs and bakey
-    if (do_wake_up) {
+    // We only need to do a wake up if we're the first people to do a wake up since
+    // the messages were last taken.  Wakey wakey eggs and bakey.
+    if (__sync_lock_test_and_set(&is_woken_up_, 1) == 0) {
         event_.wakey_wakey();
     }
 }
@@ -118,6 +152,32 @@ void linux_message_hub_t::on_event(int events) {
     // up and so that poll-based event triggering doesn't infinite-loop.
     event_.consume_wakey_wakeys();
 
+    process_incoming_messages();
+}
+
+void linux_message_hub_t::begin_spinning() {
+    // With `is_woken_up_` set, senders act as if they've woken us up already.
+    __sync_lock_test_and_set(&is_woken_up_, 1);
+}
+
+bool linux_message_hub_t::spin() {
+    if (*static_cast<linux_thread_message_t *volatile *>(&incoming_messages_) == NULL) {
+        return false;
+    }
+    // This clears `is_woken_up_`, so begin_spinning() again if you keep spinning.
+    process_incoming_messages();
+    return true;
+}
+
+bool linux_message_hub_t::end_spinning() {
+    // A sender that pushed before this saw `is_woken_up_` set, and didn't wake us
+    // up, so we look for its messages ourselves.  One that pushes after it wakes us
+    // up as usual.
+    __sync_fetch_and_and(&is_woken_up_, 0);
+    return spin();
+}
+
+void linux_message_hub_t::process_incoming_messages() {
     // Loop until we have processed at least the initial batch of messages.
     size_t num_initial_msgs_left_to_process[NUM_SCHEDULER_PRIORITIES];
     bool initial_batch_has_been_processed = false;
@@ -199,7 +259,14 @@ void linux_message_hub_t::on_event(int events) {
                 }
 #endif
 
-                m->on_thread_switch();
+                if (global_scheduler_profiling) {
+                    const ticks_t start = get_ticks();
+                    record_message_queue_time(current_priority, start - m->enqueue_ticks);
+                    m->on_thread_switch();
+                    record_message_run_time(get_ticks() - start);
+                } else {
+                    m->on_thread_switch();
+                }
             }
         }
 
@@ -216,19 +283,21 @@ void linux_message_hub_t::on_event(int events) {
 }
 
 void linux_message_hub_t::sort_incoming_messages_by_priority(bool reset_is_woken_up) {
-    // We do this in two steps to release the spinlock faster.
-    // append_and_clear is a very cheap operation, while
-    // assigning each message to a different priority queue
-    // is more expensive.
+    // 1. Pull the messages.  We clear `is_woken_up_` first (with a full barrier),
+    // so that whoever pushes a message we don't take here wakes us up for it.
+    if (reset_is_woken_up) {
+        __sync_fetch_and_and(&is_woken_up_, 0);
+    }
+    linux_thread_message_t *newest = __sync_lock_test_and_set(
+        &incoming_messages_, static_cast<linux_thread_message_t *>(NULL));
 
-    // 1. Pull the messages
+    // They're newest first, so this puts them back in the order they were sent.
     msg_list_t new_messages;
-    {
-        spinlock_acq_t acq(&incoming_messages_lock_);
-        new_messages.append_and_clear(&incoming_messages_);
-        if (reset_is_woken_up) {
-            is_woken_up_ = false;
-        }
+    while (newest != NULL) {
+        linux_thread_message_t *m = newest;
+        newest = m->next_incoming;
+        m->next_incoming = NULL;
+        new_messages.push_front(m);
     }
 
     // 2. Sort the messages into their respective priority queues
@@ -250,27 +319,11 @@ void linux_message_hub_t::sort_incoming_messages_by_priority(bool reset_is_woken
 void linux_message_hub_t::deliver_local_messages() {
     const int local_thread = thread_pool_->thread_id;
 
-    if (!queues_[local_thread].msg_local_list.empty()) {
-        bool do_wake_up;
-        {
-            spinlock_acq_t acq(&incoming_messages_lock_);
-            incoming_messages_.append_and_clear(&queues_[local_thread].msg_local_list);
-            do_wake_up = !check_and_set_is_woken_up();
-        }
-        if (do_wake_up) {
-            // Wake ourselves up for another round.
-            // While this might seem risky w.r.t. dead-locks when the event pipe
-            // is full, it is actually ok because the is_woken_up() flag guarantees
-            // that we only ever write one event onto this.
-            event_.wakey_wakey();
-        }
-    }
-}
-
-bool linux_message_hub_t::check_and_set_is_woken_up() {
-    const bool was_woken_up = is_woken_up_;
-    is_woken_up_ = true;
-    return was_woken_up;
+    // This wakes ourselves up for another round.
+    // While this might seem risky w.r.t. dead-locks when the event pipe
+    // is full, it is actually ok because the `is_woken_up_` flag guarantees
+    // that we only ever write one event onto this.
+    push_incoming_messages(&queues_[local_thread].msg_local_list);
 }
 
 // Pushes messages collected locally global lists available to all
@@ -282,23 +335,7 @@ void linux_message_hub_t::push_messages() {
         thread_queue_t *queue = &queues_[i];
         if (!queue->msg_local_list.empty()) {
             // Transfer messages to the other core
-
-            bool do_wake_up;
-            {
-                spinlock_acq_t acq(&thread_pool_->threads[i]->message_hub.incoming_messages_lock_);
-
-                // We only need to do a wake up if we're the first people to do a
-                // wake up.
-                do_wake_up =
-                    !thread_pool_->threads[i]->message_hub.check_and_set_is_woken_up();
-
-                thread_pool_->threads[i]->message_hub.incoming_messages_.append_and_clear(&queue->msg_local_list);
-            }
-
-            // Wakey wakey, perhaps eggs and bakey
-            if (do_wake_up) {
-                thread_pool_->threads[i]->message_hub.event_.wakey_wakey();
-            }
+            thread_pool_->threads[i]->message_hub.push_incoming_messages(&queue->msg_local_list);
         }
     }
 }
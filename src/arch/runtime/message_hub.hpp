@@ -8,7 +8,6 @@
 #include "arch/runtime/event_queue.hpp"
 #include "arch/runtime/runtime_utils.hpp"
 #include "arch/runtime/system_event.hpp"
-#include "arch/spinlock.hpp"
 #include "config/args.hpp"
 #include "containers/intrusive_list.hpp"
 #include "utils.hpp"
@@ -49,6 +48,15 @@ public:
     // (which does not have an event queue)
     void insert_external_message(linux_thread_message_t *msg);
 
+    /* For an event queue that spins for a while before it blocks.  Between
+    `begin_spinning()` and `end_spinning()`, other threads don't wake us up for their
+    messages, and `spin()` handles them instead, returning whether there were any.
+    `end_spinning()` has the others wake us up again, and handles and returns
+    whether there are messages that came in without a wake-up. */
+    void begin_spinning();
+    bool spin();
+    bool end_spinning();
+
     ~linux_message_hub_t();
 
 private:
@@ -59,12 +67,19 @@ private:
     // Moves messages from our own entry in queues_ onto incoming_messages_
     void deliver_local_messages();
 
-    // Moves messages from incoming_messages_ into the respective entries of
+    // Moves the messages of `msgs` onto incoming_messages_, in order, and wakes up
+    // our thread unless it's woken up already.  Any thread may call it.
+    void push_incoming_messages(msg_list_t *msgs);
+
+    // Takes the messages off incoming_messages_ into the respective entries of
     // priority_msg_lists, depending on the messages' priorities.
     void sort_incoming_messages_by_priority(bool reset_is_woken_up);
 
     msg_list_t &get_priority_msg_list(int priority);
 
+    // Handles the incoming messages, at least the ones that are there already.
+    void process_incoming_messages();
+
     linux_event_queue_t *const queue_;
     linux_thread_pool_t *const thread_pool_;
 
@@ -72,16 +87,20 @@ private:
     struct thread_queue_t {
         //TODO this doesn't need to be a class anymore
 
-        /* Messages are cached here before being pushed to the global list so that we don't
-        have to acquire the spinlock as often */
+        /* Messages are cached here before being pushed onto the other thread's incoming
+        stack, so that we don't have to compare-and-swap and wake it up as often */
         msg_list_t msg_local_list;
     } queues_[MAX_THREADS];
 
-    // Must only be used with acquired incoming_messages_lock_
-    bool check_and_set_is_woken_up();
-    bool is_woken_up_;
-    msg_list_t incoming_messages_;
-    spinlock_t incoming_messages_lock_;
+    /* The messages that other threads (and our own deliver_local_messages()) send
+    us, without a lock: it's a stack of them, newest first, linked by their
+    `next_incoming`.  Senders push their messages on with a compare-and-swap, and
+    we take all of them at once with an atomic exchange, so there's no ABA
+    problem.  `is_woken_up_` is 1 once a sender has woken us up for messages we
+    haven't taken yet, so that a burst of them only wakes us up once; we clear it
+    before we take them. */
+    linux_thread_message_t *incoming_messages_;
+    int is_woken_up_;
 
     // Use `sort_incoming_messages_by_priority()` to sort incoming_messages_ into
     // these lists.
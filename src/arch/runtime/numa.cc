@@ -0,0 +1,104 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "arch/runtime/numa.hpp"
+
+#include <ctype.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <string>
+
+#include "arch/runtime/runtime_utils.hpp"
+#include "errors.hpp"
+#include "utils.hpp"
+
+bool parse_cpu_list(const char *list, std::vector<int> *cpus_out) {
+    cpus_out->clear();
+    const char *p = list;
+    while (*p != '\0' && *p != '\n') {
+        char *end;
+        const long first = strtol(p, &end, 10);
+        if (end == p || first < 0) {
+            return false;
+        }
+        long last = first;
+        p = end;
+        if (*p == '-') {
+            ++p;
+            last = strtol(p, &end, 10);
+            if (end == p || last < first) {
+                return false;
+            }
+            p = end;
+        }
+        for (long cpu = first; cpu <= last; ++cpu) {
+            cpus_out->push_back(cpu);
+        }
+        if (*p == ',') {
+            ++p;
+        } else if (*p != '\0' && !isspace(*p)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Reads the CPUs of NUMA node `node`.  Returns false if there's no such node.
+static bool read_node_cpus(int node, std::vector<int> *cpus_out) {
+    const std::string path = strprintf("/sys/devices/system/node/node%d/cpulist", node);
+    FILE *file = fopen(path.c_str(), "r");
+    if (file == NULL) {
+        return false;
+    }
+    char buf[4096];
+    const bool ok = fgets(buf, sizeof(buf), file) != NULL
+        && parse_cpu_list(buf, cpus_out);
+    fclose(file);
+    return ok;
+}
+
+numa_topology_t::numa_topology_t() {
+    const int ncpus = get_cpu_count();
+    // Node numbers can have holes in them when nodes are offline, so this looks at
+    // a few past the last one it found.
+    const int MAX_NODE_GAP = 8;
+    for (int node = 0, gap = 0; gap < MAX_NODE_GAP; ++node) {
+        std::vector<int> cpus;
+        if (!read_node_cpus(node, &cpus)) {
+            ++gap;
+            continue;
+        }
+        gap = 0;
+        // Leave out the CPUs we couldn't pin a thread to anyway.
+        std::vector<int> usable;
+        for (size_t i = 0; i < cpus.size(); ++i) {
+            if (cpus[i] < CPU_SETSIZE) {
+                usable.push_back(cpus[i]);
+            }
+        }
+        // Nodes with memory but no CPUs don't get threads.
+        if (!usable.empty()) {
+            node_cpus.push_back(usable);
+        }
+    }
+
+    if (node_cpus.empty()) {
+        node_cpus.push_back(std::vector<int>());
+        for (int cpu = 0; cpu < ncpus; ++cpu) {
+            node_cpus[0].push_back(cpu);
+        }
+    }
+}
+
+const std::vector<int> &numa_topology_t::cpus_of_node(int node) const {
+    guarantee(0 <= node && node < num_nodes());
+    return node_cpus[node];
+}
+
+std::vector<int> numa_topology_t::cpus_by_node() const {
+    std::vector<int> cpus;
+    for (size_t i = 0; i < node_cpus.size(); ++i) {
+        cpus.insert(cpus.end(), node_cpus[i].begin(), node_cpus[i].end());
+    }
+    return cpus;
+}
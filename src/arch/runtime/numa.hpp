@@ -0,0 +1,27 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#ifndef ARCH_RUNTIME_NUMA_HPP_
+#define ARCH_RUNTIME_NUMA_HPP_
+
+#include <vector>
+
+/* The NUMA nodes of the machine and the CPUs on each of them, as Linux lists them
+in /sys/devices/system/node.  A machine without NUMA, or a kernel that doesn't
+say, has a single node with all of the online CPUs on it. */
+class numa_topology_t {
+public:
+    numa_topology_t();
+
+    int num_nodes() const { return node_cpus.size(); }
+    const std::vector<int> &cpus_of_node(int node) const;
+
+    // All of the CPUs, node by node, so that neighbouring entries share a socket.
+    std::vector<int> cpus_by_node() const;
+
+private:
+    std::vector<std::vector<int> > node_cpus;
+};
+
+// Parses a CPU list like "0-3,8,10-11".  Returns false if it's malformed.
+bool parse_cpu_list(const char *list, std::vector<int> *cpus_out);
+
+#endif  // ARCH_RUNTIME_NUMA_HPP_
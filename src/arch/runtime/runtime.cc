@@ -19,6 +19,15 @@ int get_num_threads() {
     return linux_thread_pool_t::thread_pool->n_threads;
 }
 
+int get_num_numa_nodes() {
+    return linux_thread_pool_t::thread_pool->n_numa_nodes;
+}
+
+int get_thread_numa_node(threadnum_t thread) {
+    assert_good_thread_id(thread);
+    return linux_thread_pool_t::thread_pool->thread_numa_nodes[thread.threadnum];
+}
+
 #ifndef NDEBUG
 void assert_good_thread_id(threadnum_t thread) {
     rassert(thread.threadnum >= 0, "(thread = %" PRIi32 ")", thread.threadnum);
@@ -61,8 +70,10 @@ private:
 };
 
 // Runs the action 'fun()' on thread zero.
-void run_in_thread_pool(const boost::function<void()>& fun, int worker_threads) {
-    linux_thread_pool_t thread_pool(worker_threads, false);
+void run_in_thread_pool(const boost::function<void()>& fun, int worker_threads,
+                        bool do_set_affinity, int64_t event_loop_spin_nanos) {
+    linux_thread_pool_t thread_pool(worker_threads, do_set_affinity,
+                                    event_loop_spin_nanos);
     starter_t starter(&thread_pool, fun);
     thread_pool.run_thread_pool(&starter);
 }
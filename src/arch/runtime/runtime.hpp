@@ -11,6 +11,11 @@ threadnum_t get_thread_id();
 
 int get_num_threads();
 
+// The NUMA nodes the threads are pinned to.  Without pinning, there's one node and
+// every thread is on it.
+int get_num_numa_nodes();
+int get_thread_numa_node(threadnum_t thread);
+
 #ifndef NDEBUG
 void assert_good_thread_id(threadnum_t thread);
 #else
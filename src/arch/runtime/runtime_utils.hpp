@@ -17,14 +17,18 @@ class linux_thread_message_t : public intrusive_list_node_t<linux_thread_message
 public:
     linux_thread_message_t(int _priority)
         : priority(_priority),
-        is_ordered(false)
+        is_ordered(false),
+        next_incoming(NULL),
+        enqueue_ticks(0)
 #ifndef NDEBUG
         , reloop_count_(0)
 #endif
         { }
     linux_thread_message_t()
         : priority(MESSAGE_SCHEDULER_DEFAULT_PRIORITY),
-        is_ordered(false)
+        is_ordered(false),
+        next_incoming(NULL),
+        enqueue_ticks(0)
 #ifndef NDEBUG
         , reloop_count_(0)
 #endif
@@ -39,6 +43,10 @@ private:
     friend class linux_message_hub_t;
     int priority;
     bool is_ordered; // Used internally by the message hub
+    // The next older message on the incoming stack of a message hub
+    linux_thread_message_t *next_incoming;
+    // When the message was stored on a message hub, if the scheduler is profiled.
+    uint64_t enqueue_ticks;
 #ifndef NDEBUG
     int reloop_count_;
 #endif
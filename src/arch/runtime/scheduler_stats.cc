@@ -0,0 +1,85 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "arch/runtime/scheduler_stats.hpp"
+
+#include "arch/runtime/message_hub.hpp"
+#include "containers/scoped.hpp"
+#include "perfmon/perfmon.hpp"
+
+bool global_scheduler_profiling = false;
+
+namespace {
+
+class scheduler_stats_t {
+public:
+    scheduler_stats_t()
+        : event_loop_pass(secs_to_ticks(LATENCY_PERCENTILES_INTERVAL_SECS),
+                          LATENCY_PERCENTILES_RESOLUTION_SECS, true),
+          long_slices(secs_to_ticks(LATENCY_PERCENTILES_INTERVAL_SECS),
+                      LATENCY_PERCENTILES_RESOLUTION_SECS, true),
+          long_slice_ticks(SCHEDULER_LONG_SLICE_THRESHOLD_SECS * BILLION),
+          scheduler_membership(&get_global_perfmon_collection(), &scheduler_collection,
+                               "scheduler"),
+          message_queue_membership(&scheduler_collection, &message_queue_collection,
+                                   "message_queue_secs"),
+          stats_membership(&scheduler_collection,
+                           &event_loop_pass, "event_loop_pass_secs",
+                           &long_slices, "long_slice_secs",
+                           &long_slice_count, "long_slices",
+                           NULLPTR) {
+        for (int i = 0; i < NUM_SCHEDULER_PRIORITIES; ++i) {
+            message_queue[i].init(new perfmon_hdr_histogram_t(
+                secs_to_ticks(LATENCY_PERCENTILES_INTERVAL_SECS),
+                LATENCY_PERCENTILES_RESOLUTION_SECS, true));
+            message_queue_memberships[i].init(new perfmon_membership_t(
+                &message_queue_collection, message_queue[i].get(),
+                strprintf("priority_%d", MESSAGE_SCHEDULER_MIN_PRIORITY + i)));
+        }
+    }
+
+    void record_message_queue_time(int priority, ticks_t ticks) {
+        message_queue[priority - MESSAGE_SCHEDULER_MIN_PRIORITY]->record(ticks_to_secs(ticks));
+    }
+
+    void record_message_run_time(ticks_t ticks) {
+        if (ticks >= long_slice_ticks) {
+            long_slices.record(ticks_to_secs(ticks));
+            ++long_slice_count;
+        }
+    }
+
+    void record_event_loop_pass_time(ticks_t ticks) {
+        event_loop_pass.record(ticks_to_secs(ticks));
+    }
+
+private:
+    perfmon_collection_t scheduler_collection;
+    perfmon_collection_t message_queue_collection;
+    scoped_ptr_t<perfmon_hdr_histogram_t> message_queue[NUM_SCHEDULER_PRIORITIES];
+    perfmon_hdr_histogram_t event_loop_pass;
+    perfmon_hdr_histogram_t long_slices;
+    perfmon_counter_t long_slice_count;
+    const ticks_t long_slice_ticks;
+
+    perfmon_membership_t scheduler_membership;
+    perfmon_membership_t message_queue_membership;
+    scoped_ptr_t<perfmon_membership_t> message_queue_memberships[NUM_SCHEDULER_PRIORITIES];
+    perfmon_multi_membership_t stats_membership;
+
+    DISABLE_COPYING(scheduler_stats_t);
+};
+
+scheduler_stats_t scheduler_stats;
+
+}  // namespace
+
+void record_message_queue_time(int priority, ticks_t ticks) {
+    scheduler_stats.record_message_queue_time(priority, ticks);
+}
+
+void record_message_run_time(ticks_t ticks) {
+    scheduler_stats.record_message_run_time(ticks);
+}
+
+void record_event_loop_pass_time(ticks_t ticks) {
+    scheduler_stats.record_event_loop_pass_time(ticks);
+}
@@ -0,0 +1,28 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#ifndef ARCH_RUNTIME_SCHEDULER_STATS_HPP_
+#define ARCH_RUNTIME_SCHEDULER_STATS_HPP_
+
+#include "utils.hpp"
+
+/* With `--profile-scheduler`, the message hubs and event loops time how long the
+messages between threads wait in the queues of their priority, how long every
+pass of the event loop takes, and which messages ran for more than
+`SCHEDULER_LONG_SLICE_THRESHOLD_SECS` before they gave the event loop back.
+Nearly all messages are coroutines being resumed, so those are the coroutines
+that ran that long without yielding.  The `scheduler` stat has histograms of all
+of it, for every thread on its own.
+
+It's set before the thread pool starts and never changes after. */
+extern bool global_scheduler_profiling;
+
+// How long a message waited in the queue of `priority` of the thread it went to.
+void record_message_queue_time(int priority, ticks_t ticks);
+
+// How long a message ran, once its thread took it off the queue.
+void record_message_run_time(ticks_t ticks);
+
+// How long a pass of the event loop took, from when it got its events back to
+// when it finished handling them and the messages.
+void record_event_loop_pass_time(ticks_t ticks);
+
+#endif  // ARCH_RUNTIME_SCHEDULER_STATS_HPP_
@@ -4,13 +4,20 @@
 
 // Implementation in runtime.cc.
 
+#include <stdint.h>
+
 #include "errors.hpp"
 #include <boost/function.hpp>
 
 /* `run_in_thread_pool()` starts a RethinkDB thread pool, runs the given
 function in a coroutine inside of it, waits for the function to return, and then
-shuts down the thread pool. */
+shuts down the thread pool.  With `do_set_affinity`, each thread is pinned to a
+CPU, and the threads are grouped by NUMA node (see `get_thread_numa_node()`).  An
+idle thread spins for up to `event_loop_spin_nanos` before its event queue blocks,
+which cuts the latency of waking it up at the cost of CPU time. */
 
-void run_in_thread_pool(const boost::function<void()>& fun, int worker_threads);
+void run_in_thread_pool(const boost::function<void()>& fun, int worker_threads,
+                        bool do_set_affinity = false,
+                        int64_t event_loop_spin_nanos = 0);
 
 #endif  // ARCH_RUNTIME_STARTER_HPP_
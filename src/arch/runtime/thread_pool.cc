@@ -11,6 +11,7 @@
 #include "arch/os_signal.hpp"
 #include "arch/io/timer_provider.hpp"
 #include "arch/runtime/event_queue.hpp"
+#include "arch/runtime/numa.hpp"
 #include "arch/runtime/runtime.hpp"
 #include "errors.hpp"
 #include "logger.hpp"
@@ -21,18 +22,43 @@ __thread linux_thread_pool_t *linux_thread_pool_t::thread_pool;
 __thread int linux_thread_pool_t::thread_id;
 __thread linux_thread_t *linux_thread_pool_t::thread;
 
-linux_thread_pool_t::linux_thread_pool_t(int worker_threads, bool _do_set_affinity) :
+linux_thread_pool_t::linux_thread_pool_t(int worker_threads, bool _do_set_affinity,
+                                         int64_t _event_loop_spin_nanos) :
 #ifndef NDEBUG
       coroutine_summary(false),
 #endif
       interrupt_message(NULL),
       generic_blocker_pool(NULL),
       n_threads(worker_threads + 1),    // we create an extra utility thread
-      do_set_affinity(_do_set_affinity)
+      do_set_affinity(_do_set_affinity),
+      event_loop_spin_nanos(_event_loop_spin_nanos),
+      n_numa_nodes(1)
 {
     rassert(n_threads > 1);             // we want at least one non-utility thread
     rassert(n_threads <= MAX_THREADS);
 
+    for (int i = 0; i < n_threads; ++i) {
+        thread_cpus[i] = -1;
+        thread_numa_nodes[i] = 0;
+    }
+    // On Apple, the thread affinity API has awful documentation, so we don't even bother.
+#ifdef _GNU_SOURCE
+    if (do_set_affinity) {
+        // Thread i goes on node i * num_nodes / n_threads, so each node gets a run
+        // of neighbouring threads, and then on the CPUs of that node in turn.
+        numa_topology_t topology;
+        n_numa_nodes = topology.num_nodes();
+        for (int i = 0; i < n_threads; ++i) {
+            const int node = static_cast<int64_t>(i) * n_numa_nodes / n_threads;
+            const int first_on_node = (static_cast<int64_t>(node) * n_threads
+                                       + n_numa_nodes - 1) / n_numa_nodes;
+            const std::vector<int> &cpus = topology.cpus_of_node(node);
+            thread_cpus[i] = cpus[(i - first_on_node) % cpus.size()];
+            thread_numa_nodes[i] = node;
+        }
+    }
+#endif
+
     int res;
 
     res = pthread_cond_init(&shutdown_cond, NULL);
@@ -78,6 +104,19 @@ void *linux_thread_pool_t::start_thread(void *arg) {
 
     thread_data_t *tdata = reinterpret_cast<thread_data_t *>(arg);
 
+#ifdef _GNU_SOURCE
+    // The thread pins itself before it allocates anything, so that its event queue
+    // and everything it allocates later come from its own NUMA node's memory.
+    const int cpu = tdata->thread_pool->thread_cpus[tdata->current_thread];
+    if (cpu != -1) {
+        cpu_set_t mask;
+        CPU_ZERO(&mask);
+        CPU_SET(cpu, &mask);
+        int res = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &mask);
+        guarantee_xerr(res == 0, res, "Could not set thread affinity");
+    }
+#endif
+
     // Set thread-local variables
     linux_thread_pool_t::thread_pool = tdata->thread_pool;
     linux_thread_pool_t::thread_id = tdata->current_thread;
@@ -178,19 +217,6 @@ void linux_thread_pool_t::run_thread_pool(linux_thread_message_t *initial_messag
 
         int res = pthread_create(&pthreads[i], NULL, &start_thread, tdata);
         guarantee_xerr(res == 0, res, "Could not create thread");
-
-        if (do_set_affinity) {
-            // On Apple, the thread affinity API has awful documentation, so we don't even bother.
-#ifdef _GNU_SOURCE
-            // Distribute threads evenly among CPUs
-            int ncpus = get_cpu_count();
-            cpu_set_t mask;
-            CPU_ZERO(&mask);
-            CPU_SET(i % ncpus, &mask);
-            res = pthread_setaffinity_np(pthreads[i], sizeof(cpu_set_t), &mask);
-            guarantee_xerr(res == 0, res, "Could not set thread affinity");
-#endif
-        }
     }
 
     // Mark the main thread (for use in assertions etc.)
@@ -356,7 +382,7 @@ linux_thread_pool_t::~linux_thread_pool_t() {
 }
 
 linux_thread_t::linux_thread_t(linux_thread_pool_t *parent_pool, int thread_id)
-    : queue(this),
+    : queue(this, parent_pool->event_loop_spin_nanos),
       message_hub(&queue, parent_pool, threadnum_t(thread_id)),
       timer_handler(&queue),
       do_shutdown(false)
@@ -389,6 +415,18 @@ void linux_thread_t::pump() {
     message_hub.push_messages();
 }
 
+void linux_thread_t::begin_spinning() {
+    message_hub.begin_spinning();
+}
+
+bool linux_thread_t::spin() {
+    return message_hub.spin();
+}
+
+bool linux_thread_t::end_spinning() {
+    return message_hub.end_spinning();
+}
+
 void linux_thread_t::on_event(int events) {
     // No-op. This is just to make sure that the event queue wakes up
     // so it can shut down.
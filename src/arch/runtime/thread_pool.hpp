@@ -14,6 +14,7 @@
 #include "arch/runtime/coroutines.hpp"
 #include "arch/io/blocker_pool.hpp"
 #include "arch/io/timer_provider.hpp"
+#include "arch/spinlock.hpp"
 #include "arch/timer.hpp"
 
 class linux_thread_t;
@@ -39,7 +40,8 @@ and shutting down the threads and event queues. */
 
 class linux_thread_pool_t {
 public:
-    linux_thread_pool_t(int worker_threads, bool do_set_affinity);
+    linux_thread_pool_t(int worker_threads, bool do_set_affinity,
+                        int64_t event_loop_spin_nanos);
 
     // When the process receives a SIGINT or SIGTERM, interrupt_message will be delivered to the
     // same thread that initial_message was delivered to, and interrupt_message will be set to
@@ -91,6 +93,15 @@ public:
 
     int n_threads;
     bool do_set_affinity;
+    // How long an idle thread's event queue may spin, checking for messages and
+    // events, before it blocks.  0 means it blocks right away.
+    int64_t event_loop_spin_nanos;
+    // With do_set_affinity, the CPU each thread is pinned to and its NUMA node.
+    // The threads are spread over the nodes in contiguous runs, so that neighbouring
+    // threads share a socket.  Every thread is on node 0 without do_set_affinity.
+    int thread_cpus[MAX_THREADS];
+    int thread_numa_nodes[MAX_THREADS];
+    int n_numa_nodes;
     // The thread_pool that started the thread we are currently in
     static __thread linux_thread_pool_t *thread_pool;
     // The ID of the thread we are currently in
@@ -159,6 +170,9 @@ public:
 
     void pump();   // Called by the event queue
     bool should_shut_down();   // Called by the event queue
+    void begin_spinning();   // Called by the event queue
+    bool spin();   // Called by the event queue
+    bool end_spinning();   // Called by the event queue
 #ifndef NDEBUG
     void initiate_shut_down(std::map<std::string, size_t> *coroutine_counts); // Can be called from any thread
 #else
@@ -3,11 +3,18 @@
 #include "arch/runtime/thread_pool.hpp"
 #include "utils.hpp"
 
-class timer_token_t : public intrusive_priority_queue_node_t<timer_token_t> {
+// The bits of a tick that pick the slot of a level.
+#define TIMER_WHEEL_SLOT_BITS 6
+static_assert(TIMER_WHEEL_SLOTS == (1 << TIMER_WHEEL_SLOT_BITS),
+              "The occupied slots of a level are the bits of a uint64_t.");
+
+class timer_token_t : public intrusive_priority_queue_node_t<timer_token_t>,
+                      public intrusive_list_node_t<timer_token_t> {
     friend class timer_handler_t;
 
 private:
-    timer_token_t() : interval_nanos(-1), next_time_in_nanos(-1), callback(NULL) { }
+    timer_token_t() : interval_nanos(-1), next_time_in_nanos(-1), callback(NULL),
+                      level(-1), slot(-1) { }
 
     friend bool left_is_higher_priority(const timer_token_t *left, const timer_token_t *right);
 
@@ -20,6 +27,10 @@ private:
     // The callback we call upon each 'ring'.
     timer_callback_t *callback;
 
+    // Where on the wheel the token is, or -1 if it's on the near queue.
+    int level;
+    int slot;
+
     DISABLE_COPYING(timer_token_t);
 };
 
@@ -27,73 +38,244 @@ bool left_is_higher_priority(const timer_token_t *left, const timer_token_t *rig
     return left->next_time_in_nanos < right->next_time_in_nanos;
 }
 
+// The first tick that starts at or after `nanos`, which is when a timer due then rings.
+int64_t timer_wheel_tick_of(int64_t nanos) {
+    return ceil_divide(nanos, static_cast<int64_t>(TIMER_WHEEL_TICK_NANOS));
+}
+
 timer_handler_t::timer_handler_t(linux_event_queue_t *queue)
     : timer_provider(queue),
-      expected_oneshot_time_in_nanos(0) {
+      expected_oneshot_time_in_nanos(-1),
+      current_tick(get_ticks() / TIMER_WHEEL_TICK_NANOS),
+      wheel_size(0) {
     // Right now, we have no tokens.  So we don't ask the timer provider to do anything for us.
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; ++level) {
+        occupied_slots[level] = 0;
+    }
 }
 
 timer_handler_t::~timer_handler_t() {
-    guarantee(token_queue.empty());
+    guarantee(near_queue.empty());
+    guarantee(wheel_size == 0);
+}
+
+int64_t timer_handler_t::insert(timer_token_t *token) {
+    const int64_t tick = timer_wheel_tick_of(token->next_time_in_nanos);
+    if (tick <= current_tick) {
+        near_queue.push(token);
+        token->level = -1;
+        return token->next_time_in_nanos;
+    } else {
+        insert_on_wheel(token);
+        // Going through the ticks up to then takes care of any cascading on the way.
+        return tick * TIMER_WHEEL_TICK_NANOS;
+    }
+}
+
+void timer_handler_t::insert_on_wheel(timer_token_t *token) {
+    // The lowest level on which the token's slot is less than a full turn of the
+    // level ahead of the current one.  Tokens beyond the top level go on its last
+    // slot, and get put back on when they cascade from it.
+    const int64_t tick = std::max(timer_wheel_tick_of(token->next_time_in_nanos),
+                                  current_tick);
+    int level = 0;
+    int64_t slot_index = tick;
+    for (; level < TIMER_WHEEL_LEVELS; ++level) {
+        const int shift = level * TIMER_WHEEL_SLOT_BITS;
+        if ((tick >> shift) - (current_tick >> shift) < TIMER_WHEEL_SLOTS) {
+            slot_index = tick >> shift;
+            break;
+        }
+    }
+    if (level == TIMER_WHEEL_LEVELS) {
+        level = TIMER_WHEEL_LEVELS - 1;
+        slot_index = (current_tick >> (level * TIMER_WHEEL_SLOT_BITS)) + TIMER_WHEEL_SLOTS - 1;
+    }
+
+    token->level = level;
+    token->slot = slot_index & (TIMER_WHEEL_SLOTS - 1);
+    wheel[level][token->slot].push_back(token);
+    occupied_slots[level] |= uint64_t(1) << token->slot;
+    ++wheel_size;
+}
+
+void timer_handler_t::remove_from_wheel(timer_token_t *token) {
+    intrusive_list_t<timer_token_t> *list = &wheel[token->level][token->slot];
+    list->remove(token);
+    if (list->empty()) {
+        occupied_slots[token->level] &= ~(uint64_t(1) << token->slot);
+    }
+    --wheel_size;
+}
+
+void timer_handler_t::cascade() {
+    // From the top down, so that tokens can cascade through several levels at once.
+    for (int level = TIMER_WHEEL_LEVELS - 1; level >= 1; --level) {
+        const int shift = level * TIMER_WHEEL_SLOT_BITS;
+        if ((current_tick & ((int64_t(1) << shift) - 1)) != 0) {
+            continue;
+        }
+        intrusive_list_t<timer_token_t> *list
+            = &wheel[level][(current_tick >> shift) & (TIMER_WHEEL_SLOTS - 1)];
+        while (timer_token_t *token = list->head()) {
+            remove_from_wheel(token);
+            insert_on_wheel(token);
+        }
+    }
+}
+
+void timer_handler_t::ring_current_tick(int64_t real_ticks) {
+    intrusive_list_t<timer_token_t> *list
+        = &wheel[0][current_tick & (TIMER_WHEEL_SLOTS - 1)];
+    // Callbacks may add and cancel timers, including ones on this list, so we
+    // take them off one at a time.
+    while (timer_token_t *token = list->head()) {
+        remove_from_wheel(token);
+
+        // Put the repeating timer back on the wheel before the callback can be called (so that it
+        // may be canceled).  It's due at least a tick from now, so it doesn't go back on this
+        // list.
+        if (token->interval_nanos != 0) {
+            token->next_time_in_nanos = real_ticks + token->interval_nanos;
+            insert(token);
+        }
+
+        token->callback->on_timer();
+
+        // Delete nonrepeating timer tokens.
+        if (token->interval_nanos == 0) {
+            delete token;
+        }
+    }
+}
+
+int64_t timer_handler_t::next_wheel_tick() const {
+    if (wheel_size == 0) {
+        return -1;
+    }
+    int64_t next = -1;
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; ++level) {
+        if (occupied_slots[level] == 0) {
+            continue;
+        }
+        // The first occupied slot at or after the current one, by rotating the
+        // current one to bit 0.
+        const int shift = level * TIMER_WHEEL_SLOT_BITS;
+        const int current_slot = (current_tick >> shift) & (TIMER_WHEEL_SLOTS - 1);
+        const uint64_t rotated = current_slot == 0
+            ? occupied_slots[level]
+            : (occupied_slots[level] >> current_slot)
+              | (occupied_slots[level] << (TIMER_WHEEL_SLOTS - current_slot));
+        const int64_t slots_ahead = __builtin_ctzll(rotated);
+        // The slot of a higher level is taken care of at its start, when it
+        // cascades.
+        const int64_t tick = std::max(((current_tick >> shift) + slots_ahead) << shift,
+                                      current_tick);
+        if (next == -1 || tick < next) {
+            next = tick;
+        }
+    }
+    return next;
+}
+
+void timer_handler_t::schedule_next_oneshot() {
+    int64_t next_time = -1;
+    const int64_t tick = next_wheel_tick();
+    if (tick != -1) {
+        next_time = tick * TIMER_WHEEL_TICK_NANOS;
+    }
+    if (!near_queue.empty()
+        && (next_time == -1 || near_queue.peek()->next_time_in_nanos < next_time)) {
+        next_time = near_queue.peek()->next_time_in_nanos;
+    }
+
+    expected_oneshot_time_in_nanos = next_time;
+    if (next_time == -1) {
+        timer_provider.unschedule_oneshot();
+    } else {
+        timer_provider.schedule_oneshot(next_time, this);
+    }
 }
 
 void timer_handler_t::on_oneshot() {
     // If the timer_provider tends to return its callback a touch early, we don't want to make a
     // bunch of calls to it, returning a tad early over and over again, leading up to a ticks
-    // threshold.  So we bump the real time up to the threshold when processing the priority queue.
+    // threshold.  So we bump the real time up to the threshold when processing the timers.
     int64_t real_ticks = get_ticks();
     int64_t ticks = std::max(real_ticks, expected_oneshot_time_in_nanos);
+    expected_oneshot_time_in_nanos = -1;
 
-    while (!token_queue.empty() && token_queue.peek()->next_time_in_nanos <= ticks) {
-        timer_token_t *token = token_queue.pop();
+    while (!near_queue.empty() && near_queue.peek()->next_time_in_nanos <= ticks) {
+        timer_token_t *token = near_queue.pop();
 
-        // Put the repeating timer back on the queue before the callback can be called (so that it
-        // may be canceled).
         if (token->interval_nanos != 0) {
             token->next_time_in_nanos = real_ticks + token->interval_nanos;
-            token_queue.push(token);
+            insert(token);
         }
 
         token->callback->on_timer();
 
-        // Delete nonrepeating timer tokens.
         if (token->interval_nanos == 0) {
             delete token;
         }
     }
 
-    // We've processed young tokens.  Now schedule a new one-shot (if necessary).
-    if (!token_queue.empty()) {
-        timer_provider.schedule_oneshot(token_queue.peek()->next_time_in_nanos, this);
+    // Go through the ticks up to now, skipping the ones that have nothing to do.
+    const int64_t now_tick = ticks / TIMER_WHEEL_TICK_NANOS;
+    while (current_tick <= now_tick) {
+        cascade();
+        ring_current_tick(real_ticks);
+        ++current_tick;
+
+        const int64_t next = next_wheel_tick();
+        if (next == -1 || next > now_tick) {
+            current_tick = now_tick + 1;
+        } else {
+            current_tick = next;
+        }
     }
+
+    // We've processed young tokens.  Now schedule a new one-shot (if necessary).
+    schedule_next_oneshot();
 }
 
-timer_token_t *timer_handler_t::add_timer_internal(const int64_t ms, timer_callback_t *callback, const bool once) {
-    const int64_t nanos = ms * MILLION;
+timer_token_t *timer_handler_t::add_timer_internal(const int64_t nanos, timer_callback_t *callback, const bool once) {
     rassert(nanos > 0);
 
-    const int64_t next_time_in_nanos = get_ticks() + nanos;
+    const int64_t now = get_ticks();
+    const int64_t next_time_in_nanos = now + nanos;
+
+    // With nothing on the wheel, it doesn't matter where it is, so we catch it up with
+    // the time instead of making the next oneshot go through all of the ticks it
+    // missed.
+    if (wheel_size == 0) {
+        current_tick = std::max(current_tick, now / TIMER_WHEEL_TICK_NANOS);
+    }
 
     timer_token_t *const token = new timer_token_t;
     token->interval_nanos = once ? 0 : nanos;
     token->next_time_in_nanos = next_time_in_nanos;
     token->callback = callback;
 
-    const timer_token_t *top_entry = token_queue.peek();
-    token_queue.push(token);
-
-    if (top_entry == NULL || next_time_in_nanos < top_entry->next_time_in_nanos) {
-        timer_provider.schedule_oneshot(next_time_in_nanos, this);
+    const int64_t ring_time = insert(token);
+    if (expected_oneshot_time_in_nanos == -1 || ring_time < expected_oneshot_time_in_nanos) {
+        expected_oneshot_time_in_nanos = ring_time;
+        timer_provider.schedule_oneshot(ring_time, this);
     }
 
     return token;
 }
 
 void timer_handler_t::cancel_timer(timer_token_t *token) {
-    token_queue.remove(token);
+    if (token->level == -1) {
+        near_queue.remove(token);
+    } else {
+        remove_from_wheel(token);
+    }
     delete token;
 
-    if (token_queue.empty()) {
+    if (near_queue.empty() && wheel_size == 0) {
+        expected_oneshot_time_in_nanos = -1;
         timer_provider.unschedule_oneshot();
     }
 }
@@ -101,11 +283,15 @@ void timer_handler_t::cancel_timer(timer_token_t *token) {
 
 
 timer_token_t *add_timer(int64_t ms, timer_callback_t *callback) {
-    return linux_thread_pool_t::thread->timer_handler.add_timer_internal(ms, callback, false);
+    return linux_thread_pool_t::thread->timer_handler.add_timer_internal(ms * MILLION, callback, false);
 }
 
 timer_token_t *fire_timer_once(int64_t ms, timer_callback_t *callback) {
-    return linux_thread_pool_t::thread->timer_handler.add_timer_internal(ms, callback, true);
+    return linux_thread_pool_t::thread->timer_handler.add_timer_internal(ms * MILLION, callback, true);
+}
+
+timer_token_t *fire_timer_once_nanos(int64_t nanos, timer_callback_t *callback) {
+    return linux_thread_pool_t::thread->timer_handler.add_timer_internal(nanos, callback, true);
 }
 
 void cancel_timer(timer_token_t *timer) {
@@ -2,6 +2,10 @@
 #ifndef ARCH_TIMER_HPP_
 #define ARCH_TIMER_HPP_
 
+#include <stdint.h>
+
+#include "config/args.hpp"
+#include "containers/intrusive_list.hpp"
 #include "containers/intrusive_priority_queue.hpp"
 #include "arch/io/timer_provider.hpp"
 
@@ -14,27 +18,57 @@ struct timer_callback_t {
 
 /* This timer class uses the underlying OS timer provider to get one-shot timing events. It then
  * manages a list of application timers based on that lower level interface. Everyone who needs a
- * timer should use this class (through the thread pool). */
+ * timer should use this class (through the thread pool).
+ *
+ * The timers go on a hierarchical timing wheel, so adding and canceling one takes constant
+ * time however many there are: there are TIMER_WHEEL_LEVELS levels of TIMER_WHEEL_SLOTS
+ * slots each, a slot of level 0 is a tick of TIMER_WHEEL_TICK_NANOS, and a slot of every
+ * other level spans all of the level below it.  A timer rings on the first tick after it's
+ * due.  When the wheel gets to the start of a slot of a higher level, that slot's timers move
+ * down to the lower levels.  Timers that are due in less than a tick don't fit on the wheel,
+ * so they go on a priority queue and ring right when they're due. */
 class timer_handler_t : private timer_provider_callback_t {
 public:
     explicit timer_handler_t(linux_event_queue_t *queue);
     ~timer_handler_t();
 
-    timer_token_t *add_timer_internal(int64_t ms, timer_callback_t *callback, bool once);
+    timer_token_t *add_timer_internal(int64_t nanos, timer_callback_t *callback, bool once);
     void cancel_timer(timer_token_t *timer);
 
 private:
     void on_oneshot();
 
+    // Puts `token` on the wheel or on `near_queue`, by the time it's due, and returns
+    // when it rings.
+    int64_t insert(timer_token_t *token);
+    void insert_on_wheel(timer_token_t *token);
+    void remove_from_wheel(timer_token_t *token);
+    // Moves the timers of the slots of the higher levels that start at `current_tick`
+    // down to the lower levels.
+    void cascade();
+    // Rings the timers on the level 0 slot of `current_tick`.
+    void ring_current_tick(int64_t real_ticks);
+    // The first tick after `current_tick` that we have to do something on, or -1 if
+    // the wheel is empty.
+    int64_t next_wheel_tick() const;
+    void schedule_next_oneshot();
+
     // The timer provider, a platform-dependent typedef for interfacing with the OS.
     timer_provider_t timer_provider;
 
-    // The expected time of the next on_oneshot call.  If the oneshot arrived earlier than this
-    // time, we pretend that it had arrived on time.
+    // The expected time of the next on_oneshot call, or -1 if none is scheduled.  If the
+    // oneshot arrived earlier than this time, we pretend that it had arrived on time.
     int64_t expected_oneshot_time_in_nanos;
 
-    // A priority queue of timer tokens, ordered by the soonest.
-    intrusive_priority_queue_t<timer_token_t> token_queue;
+    // The timers that are due before the next tick, ordered by the soonest.
+    intrusive_priority_queue_t<timer_token_t> near_queue;
+
+    // The tick we haven't rung the timers of yet; everything before it is done.
+    int64_t current_tick;
+    // The slots of the wheel, and for every level, which of its slots are non-empty.
+    intrusive_list_t<timer_token_t> wheel[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+    uint64_t occupied_slots[TIMER_WHEEL_LEVELS];
+    size_t wheel_size;
 
     DISABLE_COPYING(timer_handler_t);
 };
@@ -46,6 +80,9 @@ private:
  */
 timer_token_t *add_timer(int64_t ms, timer_callback_t *callback);
 timer_token_t *fire_timer_once(int64_t ms, timer_callback_t *callback);
+// Like fire_timer_once(), but in nanoseconds.  Timers that are due in less than a
+// TIMER_WHEEL_TICK_NANOS ring right when they're due rather than on the next tick.
+timer_token_t *fire_timer_once_nanos(int64_t nanos, timer_callback_t *callback);
 void cancel_timer(timer_token_t *timer);
 
 
@@ -1,8 +1,11 @@
 #include "arch/types.hpp"
 
-file_account_t::file_account_t(file_t *par, int pri, int outstanding_requests_limit) :
+file_account_t::file_account_t(file_t *par, int pri, int outstanding_requests_limit,
+                               io_class_t io_class,
+                               io_activity_stats_t *activity_stats) :
     parent(par),
-    account(parent->create_account(pri, outstanding_requests_limit)) { }
+    account(parent->create_account(pri, outstanding_requests_limit, io_class,
+                                   activity_stats)) { }
 
 file_account_t::~file_account_t() {
     parent->destroy_account(account);
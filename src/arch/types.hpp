@@ -94,6 +94,40 @@ enum class file_direct_io_mode_t {
     buffered_desired
 };
 
+// Which disk manager backend actually runs the I/O requests of an
+// io_backender_t.  If io_uring is not available, io_uring_desired falls back to
+// the thread pool.
+enum class io_backend_t {
+    pool,
+    io_uring_desired
+};
+
+// Whether someone waits for the I/O of a file account (foreground), or whether it
+// may be held back while foreground reads are slow (background), see
+// accounting_diskmgr_t.
+enum class io_class_t {
+    foreground,
+    background
+};
+
+// What the I/O of a file account is for.  The serializers count the I/O of every
+// activity apart, see io_activity_stats_t.
+enum class io_activity_t {
+    query_reads,
+    writeback,
+    gc,
+    lba_gc,
+    backfill,
+    sindex_build,
+    warmup,
+    scrub,
+    backup,
+    other
+};
+const int NUM_IO_ACTIVITIES = static_cast<int>(io_activity_t::other) + 1;
+
+struct io_activity_stats_t;
+
 
 
 class semantic_checking_file_t {
@@ -121,6 +155,10 @@ public:
     virtual int64_t get_size() = 0;
     virtual void set_size(int64_t size) = 0;
     virtual void set_size_at_least(int64_t size) = 0;
+    // Tells the file system that the data in the given range isn't needed any more,
+    // so that it can free the space (and the device can learn about it). The range
+    // reads back as zeros afterwards. Returns false if the file doesn't support it.
+    virtual MUST_USE bool discard(int64_t offset, int64_t length) = 0;
 
     virtual void read_async(int64_t offset, size_t length, void *buf,
                             file_account_t *account, linux_iocallback_t *cb) = 0;
@@ -131,7 +169,10 @@ public:
     virtual void writev_async(int64_t offset, size_t length, scoped_array_t<iovec> &&bufs,
                               file_account_t *account, linux_iocallback_t *cb) = 0;
 
-    virtual void *create_account(int priority, int outstanding_requests_limit) = 0;
+    // The I/O of the account gets recorded in `activity_stats` if it isn't NULL.
+    virtual void *create_account(int priority, int outstanding_requests_limit,
+                                 io_class_t io_class,
+                                 io_activity_stats_t *activity_stats) = 0;
     virtual void destroy_account(void *account) = 0;
 
     virtual bool coop_lock_and_check() = 0;
@@ -142,7 +183,9 @@ private:
 
 class file_account_t {
 public:
-    file_account_t(file_t *f, int p, int outstanding_requests_limit = UNLIMITED_OUTSTANDING_REQUESTS);
+    file_account_t(file_t *f, int p, int outstanding_requests_limit = UNLIMITED_OUTSTANDING_REQUESTS,
+                   io_class_t io_class = io_class_t::foreground,
+                   io_activity_stats_t *activity_stats = NULL);
     ~file_account_t();
     void *get_account() { return account; }
 
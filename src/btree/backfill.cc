@@ -2,6 +2,7 @@
 #include "btree/backfill.hpp"
 
 #include <algorithm>
+#include <vector>
 
 #include "errors.hpp"
 #include <boost/bind.hpp>
@@ -13,7 +14,10 @@
 #include "btree/parallel_traversal.hpp"
 #include "btree/secondary_operations.hpp"
 #include "btree/slice.hpp"
+#include "btree/superblock.hpp"
 #include "buffer_cache/buffer_cache.hpp"
+#include "concurrency/pmap.hpp"
+#include "config/args.hpp"
 #include "protocol_api.hpp"
 
 struct backfill_traversal_helper_t : public btree_traversal_helper_t, public home_thread_mixin_debug_only_t {
@@ -159,10 +163,39 @@ struct backfill_traversal_helper_t : public btree_traversal_helper_t, public hom
         : callback_(callback), since_when_(since_when), sizer_(sizer), key_range_(key_range) { }
 };
 
+// The sub-ranges of a backfill, and what it takes to traverse each of them.
+struct backfill_streams_t {
+    void traverse(int i) {
+        parallel_traversal_progress_t *p = new parallel_traversal_progress_t;
+        scoped_ptr_t<traversal_progress_t> p_owned(p);
+        progress->add_constituent(&p_owned);
+
+        backfill_traversal_helper_t helper(callback, since_when, sizer, ranges[i]);
+        helper.progress = p;
+        try {
+            btree_parallel_traversal(txn, superblock, slice, &helper, interruptor);
+            callback->on_range_done(ranges[i], interruptor);
+        } catch (const interrupted_exc_t &) {
+            /* do nothing; `do_agnostic_btree_backfill()` will notice that
+            interruptor has been pulsed */
+        }
+    }
+
+    std::vector<key_range_t> ranges;
+    value_sizer_t<void> *sizer;
+    btree_slice_t *slice;
+    repli_timestamp_t since_when;
+    agnostic_backfill_callback_t *callback;
+    transaction_t *txn;
+    superblock_t *superblock;
+    traversal_progress_combiner_t *progress;
+    signal_t *interruptor;
+};
+
 void do_agnostic_btree_backfill(value_sizer_t<void> *sizer,
         btree_slice_t *slice, const key_range_t& key_range, repli_timestamp_t since_when,
         agnostic_backfill_callback_t *callback, transaction_t *txn,
-        superblock_t *superblock, buf_lock_t *sindex_block, parallel_traversal_progress_t *p,
+        superblock_t *superblock, buf_lock_t *sindex_block, traversal_progress_combiner_t *progress,
         signal_t *interruptor)
 THROWS_ONLY(interrupted_exc_t) {
     //Start things off easy with a coro assertion.
@@ -172,7 +205,27 @@ THROWS_ONLY(interrupted_exc_t) {
     get_secondary_indexes(txn, sindex_block, &sindexes);
     callback->on_sindexes(sindexes, interruptor);
 
-    backfill_traversal_helper_t helper(callback, since_when, sizer, key_range);
-    helper.progress = p;
-    btree_parallel_traversal(txn, superblock, slice, &helper, interruptor);
+    // A backfill visits every block in the range once, don't let it push the
+    // working set out of the cache.
+    txn->set_access_hint(CACHE_ACCESS_HINT_ONCE);
+
+    backfill_streams_t streams;
+    split_key_range_at_root(txn, superblock, key_range, BACKFILL_STREAMS_PER_RANGE,
+                            &streams.ranges);
+
+    // Every stream releases the superblock once it has the root.
+    refcount_superblock_t refcount_wrapper(superblock, streams.ranges.size());
+    streams.sizer = sizer;
+    streams.slice = slice;
+    streams.since_when = since_when;
+    streams.callback = callback;
+    streams.txn = txn;
+    streams.superblock = &refcount_wrapper;
+    streams.progress = progress;
+    streams.interruptor = interruptor;
+    pmap(streams.ranges.size(), boost::bind(&backfill_streams_t::traverse, &streams, _1));
+
+    if (interruptor->is_pulsed()) {
+        throw interrupted_exc_t();
+    }
 }
@@ -12,7 +12,7 @@
 class btree_slice_t;
 struct btree_key_t;
 struct key_range_t;
-class parallel_traversal_progress_t;
+class traversal_progress_combiner_t;
 class superblock_t;
 template <class> class value_sizer_t;
 class repli_timestamp_t;
@@ -26,18 +26,27 @@ public:
     virtual void on_deletion(const btree_key_t *key, repli_timestamp_t recency, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) = 0;
     virtual void on_pair(transaction_t *txn, repli_timestamp_t recency, const btree_key_t *key, const void *value, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) = 0;
     virtual void on_sindexes(const std::map<std::string, secondary_index_t> &sindexes, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) = 0;
+    /* Called once everything in `range` has been passed to the other methods. */
+    virtual void on_range_done(const key_range_t &range, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) = 0;
     virtual ~agnostic_backfill_callback_t() { }
 };
 
 /* `do_agnostic_btree_backfill()` is guaranteed to find all changes whose
 timestamps are greater than or equal than `since_when` but which reached the
 tree before `btree_backfill()` was called. It may also find changes that
-happened before `since_when`. */
+happened before `since_when`.
+
+The range is split at keys of the root node into up to
+BACKFILL_STREAMS_PER_RANGE sub-ranges, which get traversed concurrently.  Each
+of them skips the subtrees whose recency is before `since_when`, and adds its
+own progress to `progress`, so that a slow stream shows up there.  The callback
+gets called from all of them at once, though never for overlapping ranges, and
+hears `on_range_done()` for each sub-range as soon as its stream has finished. */
 
 void do_agnostic_btree_backfill(value_sizer_t<void> *sizer,
         btree_slice_t *slice, const key_range_t& key_range, repli_timestamp_t since_when,
         agnostic_backfill_callback_t *callback, transaction_t *txn,
-        superblock_t *superblock, buf_lock_t *sindex_block, parallel_traversal_progress_t *p,
+        superblock_t *superblock, buf_lock_t *sindex_block, traversal_progress_combiner_t *progress,
         signal_t *interruptor)
 THROWS_ONLY(interrupted_exc_t);
 
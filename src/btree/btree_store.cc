@@ -3,7 +3,9 @@
 
 #include "btree/operations.hpp"
 #include "btree/secondary_operations.hpp"
+#include "concurrency/lock_contention.hpp"
 #include "concurrency/wait_any.hpp"
+#include "config/args.hpp"
 #include "containers/archive/vector_stream.hpp"
 #include "serializer/config.hpp"
 #include "stl_utils.hpp"
@@ -32,7 +34,8 @@ btree_store_t<protocol_t>::btree_store_t(serializer_t *serializer,
     : store_view_t<protocol_t>(protocol_t::region_t::universe()),
       perfmon_collection(),
       io_backender_(io_backender), base_path_(base_path),
-      perfmon_collection_membership(parent_perfmon_collection, &perfmon_collection, perfmon_name)
+      perfmon_collection_membership(parent_perfmon_collection, &perfmon_collection, perfmon_name),
+      sindex_post_construction_streams_(SINDEX_POST_CONSTRUCTION_STREAMS)
 {
     if (create) {
         cache_t::create(serializer);
@@ -41,6 +44,12 @@ btree_store_t<protocol_t>::btree_store_t(serializer_t *serializer,
     // TODO: Don't specify cache dynamic config here.
     cache_dynamic_config.max_size = cache_target;
     cache_dynamic_config.max_dirty_size = cache_target / 2;
+    cache_dynamic_config.page_repl_policy = TABLE_PAGE_REPL_POLICY;
+    cache_dynamic_config.compressed_tier_size
+        = cache_target * TABLE_CACHE_COMPRESSED_TIER_FRACTION;
+    cache_dynamic_config.use_memory_broker = true;
+    cache_dynamic_config.use_dirty_budget = true;
+    cache_dynamic_config.adaptive_flush = true;
     cache.init(new cache_t(serializer, cache_dynamic_config, &perfmon_collection));
 
     if (create) {
@@ -305,18 +314,22 @@ void btree_store_t<protocol_t>::sindex_queue_push(const write_message_t &value,
 
 template <class protocol_t>
 void btree_store_t<protocol_t>::add_progress_tracker(
-        map_insertion_sentry_t<uuid_u, const parallel_traversal_progress_t *> *sentry,
-        uuid_u id, const parallel_traversal_progress_t *p) {
+        map_insertion_sentry_t<uuid_u, const sindex_construction_progress_t *> *sentry,
+        uuid_u id, const sindex_construction_progress_t *p) {
     assert_thread();
     sentry->reset(&progress_trackers, id, p);
 }
 
 template <class protocol_t>
-progress_completion_fraction_t btree_store_t<protocol_t>::get_progress(uuid_u id) {
+progress_completion_fraction_t btree_store_t<protocol_t>::get_progress(
+        uuid_u id, double *elapsed_secs_out) {
+    *elapsed_secs_out = 0;
     if (!std_contains(progress_trackers, id)) {
         return progress_completion_fraction_t();
     } else {
-        return progress_trackers[id]->guess_completion();
+        const sindex_construction_progress_t *p = progress_trackers[id];
+        *elapsed_secs_out = (current_microtime() - p->start_time) / 1e6;
+        return p->streams.guess_completion();
     }
 }
 
@@ -1077,26 +1090,72 @@ void btree_store_t<protocol_t>::acquire_superblock_for_write(
     get_btree_superblock_and_txn(btree.get(), txn_access, superblock_access, expected_change_count, timestamp, order_token, durability, sb_out, txn_out);
 }
 
+template <class protocol_t>
+void btree_store_t<protocol_t>::enable_cache_warmup_manifest(const std::string &path) {
+    assert_thread();
+    cache->enable_warmup_manifest(path);
+}
+
+template <class protocol_t>
+void btree_store_t<protocol_t>::set_leaf_history(leaf_history_t leaf_history,
+                                                 signal_t *interruptor)
+    THROWS_ONLY(interrupted_exc_t) {
+    assert_thread();
+
+    write_token_pair_t token_pair;
+    new_write_token_pair(&token_pair);
+
+    object_buffer_t<fifo_enforcer_sink_t::exit_write_t>::destruction_sentinel_t
+        token_destroyer(&token_pair.sindex_write_token);
+
+    scoped_ptr_t<transaction_t> txn;
+    scoped_ptr_t<real_superblock_t> superblock;
+    acquire_superblock_for_write(repli_timestamp_t::invalid, 1, WRITE_DURABILITY_HARD,
+                                 &token_pair, &txn, &superblock, interruptor);
+    superblock->set_leaf_history(leaf_history);
+}
+
+template <class protocol_t>
+void btree_store_t<protocol_t>::set_sindex_post_construction_streams(int streams) {
+    assert_thread();
+    guarantee(streams >= 1);
+    sindex_post_construction_streams_ = streams;
+}
+
+template <class protocol_t>
+int btree_store_t<protocol_t>::sindex_post_construction_streams() const {
+    assert_thread();
+    return sindex_post_construction_streams_;
+}
+
+// The reads and writes of the store wait for the ones that came in before them
+// through these.
+static lock_site_t read_token_lock_site("btree_store.read_token");
+static lock_site_t write_token_lock_site("btree_store.write_token");
+static lock_site_t sindex_read_token_lock_site("btree_store.sindex_read_token");
+static lock_site_t sindex_write_token_lock_site("btree_store.sindex_write_token");
+
 /* store_view_t interface */
 template <class protocol_t>
 void btree_store_t<protocol_t>::new_read_token(object_buffer_t<fifo_enforcer_sink_t::exit_read_t> *token_out) {
     assert_thread();
     fifo_enforcer_read_token_t token = main_token_source.enter_read();
-    token_out->create(&main_token_sink, token);
+    token_out->create(&main_token_sink, token, &read_token_lock_site);
 }
 
 template <class protocol_t>
 void btree_store_t<protocol_t>::new_write_token(object_buffer_t<fifo_enforcer_sink_t::exit_write_t> *token_out) {
     assert_thread();
     fifo_enforcer_write_token_t token = main_token_source.enter_write();
-    token_out->create(&main_token_sink, token);
+    token_out->create(&main_token_sink, token, &write_token_lock_site);
 }
 
 template <class protocol_t>
 void btree_store_t<protocol_t>::new_read_token_pair(read_token_pair_t *token_pair_out) {
     assert_thread();
     fifo_enforcer_read_token_t token = sindex_token_source.enter_read();
-    token_pair_out->sindex_read_token.create(&sindex_token_sink, token);
+    token_pair_out->sindex_read_token.create(&sindex_token_sink, token,
+                                             &sindex_read_token_lock_site);
 
     new_read_token(&(token_pair_out->main_read_token));
 }
@@ -1105,7 +1164,8 @@ template <class protocol_t>
 void btree_store_t<protocol_t>::new_write_token_pair(write_token_pair_t *token_pair_out) {
     assert_thread();
     fifo_enforcer_write_token_t token = sindex_token_source.enter_write();
-    token_pair_out->sindex_write_token.create(&sindex_token_sink, token);
+    token_pair_out->sindex_write_token.create(&sindex_token_sink, token,
+                                              &sindex_write_token_lock_site);
 
     new_write_token(&(token_pair_out->main_write_token));
 }
@@ -40,6 +40,19 @@ private:
     std::string info;
 };
 
+// How far the post construction of a secondary index has got, see
+// btree_store_t::add_progress_tracker().  Every stream of the construction
+// adds its own traversal progress to `streams`.
+struct sindex_construction_progress_t {
+    sindex_construction_progress_t() : start_time(current_microtime()) { }
+
+    traversal_progress_combiner_t streams;
+    const microtime_t start_time;
+
+private:
+    DISABLE_COPYING(sindex_construction_progress_t);
+};
+
 template <class protocol_t>
 class btree_store_t : public store_view_t<protocol_t> {
 public:
@@ -55,6 +68,24 @@ public:
                   const base_path_t &base_path);
     virtual ~btree_store_t();
 
+    // See mc_cache_t::enable_warmup_manifest().
+    void enable_cache_warmup_manifest(const std::string &path);
+
+    // Sets how much history for backfilling the leaves of the primary btree keep,
+    // see leaf_history_t.  It's stored in the superblock, so it stays set across
+    // restarts.  With leaf_history_t::NONE, backfills from this store resend
+    // every leaf that changed since the backfill's timestamp in full.
+    void set_leaf_history(leaf_history_t leaf_history, signal_t *interruptor)
+        THROWS_ONLY(interrupted_exc_t);
+
+    // How many sub-ranges of the primary btree the post construction of
+    // secondary indexes traverses concurrently, from 1 (which trickles along in
+    // the background, yielding after every document) up.  Defaults to
+    // SINDEX_POST_CONSTRUCTION_STREAMS.  Only affects constructions started
+    // afterwards.
+    void set_sindex_post_construction_streams(int streams);
+    int sindex_post_construction_streams() const;
+
     /* store_view_t interface */
     void new_read_token(object_buffer_t<fifo_enforcer_sink_t::exit_read_t> *token_out);
     void new_write_token(object_buffer_t<fifo_enforcer_sink_t::exit_write_t> *token_out);
@@ -141,10 +172,12 @@ public:
             const mutex_t::acq_t *acq);
 
     void add_progress_tracker(
-        map_insertion_sentry_t<uuid_u, const parallel_traversal_progress_t *> *sentry,
-        uuid_u id, const parallel_traversal_progress_t *p);
+        map_insertion_sentry_t<uuid_u, const sindex_construction_progress_t *> *sentry,
+        uuid_u id, const sindex_construction_progress_t *p);
 
-    progress_completion_fraction_t get_progress(uuid_u id);
+    // Sets `*elapsed_secs_out` to how long the construction of the index has
+    // been going on for, if it is under way.
+    progress_completion_fraction_t get_progress(uuid_u id, double *elapsed_secs_out);
 
     void acquire_sindex_block_for_read(
             read_token_pair_t *token_pair,
@@ -445,7 +478,8 @@ public:
 
     std::vector<internal_disk_backed_queue_t *> sindex_queues;
     mutex_t sindex_queue_mutex;
-    std::map<uuid_u, const parallel_traversal_progress_t *> progress_trackers;
+    std::map<uuid_u, const sindex_construction_progress_t *> progress_trackers;
+    int sindex_post_construction_streams_;
 
     // Mind the constructor ordering. We must destruct drainer before destructing
     // many of the other structures.
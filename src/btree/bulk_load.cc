@@ -0,0 +1,178 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "btree/bulk_load.hpp"
+
+#include "btree/internal_node.hpp"
+#include "btree/leaf_node.hpp"
+#include "btree/node.hpp"
+#include "btree/operations.hpp"
+#include "btree/slice.hpp"
+#include "buffer_cache/buffer_cache.hpp"
+
+bool btree_is_empty(value_sizer_t<void> *sizer, transaction_t *txn, superblock_t *superblock) {
+    block_id_t root_id = superblock->get_root_block_id();
+    if (root_id == NULL_BLOCK_ID) {
+        return true;
+    }
+
+    buf_lock_t root(txn, root_id, rwi_read);
+    const node_t *node = static_cast<const node_t *>(root.get_data_read());
+#ifndef NDEBUG
+    node::validate(sizer, node);
+#else
+    (void)sizer;
+#endif
+    return node::is_leaf(node) && leaf::is_empty(reinterpret_cast<const leaf_node_t *>(node));
+}
+
+btree_bulk_loader_t::btree_bulk_loader_t(value_sizer_t<void> *sizer, btree_slice_t *slice,
+                                         transaction_t *txn, superblock_t *superblock,
+                                         repli_timestamp_t timestamp, double fill_factor)
+    : sizer_(sizer), slice_(slice), txn_(txn), superblock_(superblock),
+      timestamp_(timestamp), fill_factor_(fill_factor),
+      has_last_key_(false), has_left_bound_(false),
+      population_(0), finished_(false) {
+    // Below one half, the leaves would be underfull and get merged by the next
+    // write that touches them.
+    guarantee(0.5 <= fill_factor_ && fill_factor_ <= 1.0,
+              "bulk load fill factor %f is out of range", fill_factor_);
+    guarantee(btree_is_empty(sizer_, txn_, superblock_),
+              "bulk loading into a btree that isn't empty");
+    sizer_->set_leaf_history(superblock_->get_leaf_history());
+}
+
+btree_bulk_loader_t::~btree_bulk_loader_t() {
+    guarantee(finished_ || population_ == 0, "btree_bulk_loader_t destroyed before finish()");
+}
+
+void btree_bulk_loader_t::add(const btree_key_t *key, const void *value) {
+    rassert(!finished_);
+    rassert(!has_last_key_ || btree_key_cmp(last_key_.btree_key(), key) < 0,
+            "bulk loaded keys must be in ascending order");
+
+    if (!leaf_.has()) {
+        leaf_.init(new buf_lock_t(txn_));
+        leaf::init(sizer_, static_cast<leaf_node_t *>(leaf_->get_data_write()));
+    } else if (leaf::is_full(sizer_, static_cast<const leaf_node_t *>(leaf_->get_data_read()),
+                             key, value, fill_factor_)) {
+        // The leaf's key range is known now, so it can elide the prefix of it.
+        leaf::narrow_key_range(sizer_, static_cast<leaf_node_t *>(leaf_->get_data_write()),
+                               has_left_bound_ ? left_bound_.btree_key() : NULL,
+                               last_key_.btree_key());
+        has_left_bound_ = true;
+        left_bound_ = last_key_;
+
+        scoped_ptr_t<buf_lock_t> next(new buf_lock_t(txn_));
+        leaf::init(sizer_, static_cast<leaf_node_t *>(next->get_data_write()));
+        push(1, last_key_.btree_key(), leaf_->get_block_id(), next->get_block_id());
+        leaf_.swap(next);
+    }
+
+    leaf::insert(sizer_, static_cast<leaf_node_t *>(leaf_->get_data_write()),
+                 key, value, timestamp_, key_modification_proof_t::real_proof());
+    slice_->stats.pm_keys_set.record();
+
+    has_last_key_ = true;
+    last_key_.assign(key);
+    ++population_;
+}
+
+void btree_bulk_loader_t::new_internal_node(const btree_key_t *key,
+                                            block_id_t left, block_id_t right,
+                                            scoped_ptr_t<buf_lock_t> *node_out) {
+    node_out->init(new buf_lock_t(txn_));
+    internal_node_t *node = static_cast<internal_node_t *>((*node_out)->get_data_write());
+    internal_node::init(txn_->get_cache()->get_block_size(), node);
+    DEBUG_VAR bool success = internal_node::insert(txn_->get_cache()->get_block_size(),
+                                                   node, key, left, right);
+    rassert(success);
+}
+
+void btree_bulk_loader_t::push(size_t height, const btree_key_t *key,
+                               block_id_t left, block_id_t right) {
+    rassert(height >= 1);
+    if (height > levels_.size()) {
+        rassert(height == levels_.size() + 1);
+        levels_.push_back(new level_t);
+    }
+    level_t *level = &levels_[height - 1];
+
+    if (!level->node.has()) {
+        new_internal_node(key, left, right, &level->node);
+    } else if (level->has_pending) {
+        rassert(left == level->pending_child);
+        scoped_ptr_t<buf_lock_t> next;
+        new_internal_node(key, left, right, &next);
+        level->has_pending = false;
+        push(height + 1, level->pending_key.btree_key(),
+             level->node->get_block_id(), next->get_block_id());
+        level->node.swap(next);
+    } else {
+        internal_node_t *node = static_cast<internal_node_t *>(level->node->get_data_write());
+        if (!internal_node::is_full(node)) {
+            DEBUG_VAR bool success = internal_node::insert(txn_->get_cache()->get_block_size(),
+                                                           node, key, left, right);
+            rassert(success);
+        } else {
+            level->has_pending = true;
+            level->pending_key.assign(key);
+            level->pending_child = right;
+        }
+    }
+}
+
+void btree_bulk_loader_t::finish() {
+    rassert(!finished_);
+    finished_ = true;
+
+    if (!leaf_.has()) {
+        // Nothing was added, leave the btree as it is.
+        return;
+    }
+
+    // A level's pending child can't get a node of its own, so move the last
+    // child of the full node over to keep it company.  This can push a new
+    // child into the level above, so levels_ can grow as we go.
+    const block_size_t block_size = txn_->get_cache()->get_block_size();
+    for (size_t height = 1; height <= levels_.size(); ++height) {
+        level_t *level = &levels_[height - 1];
+        if (!level->has_pending) {
+            continue;
+        }
+
+        internal_node_t *node = static_cast<internal_node_t *>(level->node->get_data_write());
+        rassert(node->npairs >= 3);
+        btree_internal_pair *last_pair = internal_node::get_pair_by_index(node, node->npairs - 1);
+        const btree_internal_pair *prev_pair = internal_node::get_pair_by_index(node, node->npairs - 2);
+        const block_id_t moved_child = last_pair->lnode;
+        store_key_t new_bound(&prev_pair->key);
+
+        // Make the child before the moved one the last child.
+        last_pair->lnode = prev_pair->lnode;
+        internal_node::remove(block_size, node, new_bound.btree_key());
+
+        scoped_ptr_t<buf_lock_t> next;
+        new_internal_node(level->pending_key.btree_key(), moved_child, level->pending_child, &next);
+        level->has_pending = false;
+        push(height + 1, new_bound.btree_key(), level->node->get_block_id(), next->get_block_id());
+        level->node.swap(next);
+    }
+
+    buf_lock_t *root = levels_.empty() ? leaf_.get() : levels_.back().node.get();
+    root->set_eviction_priority(slice_->root_eviction_priority);
+
+    // An empty root leaf is all there can be of the old tree.
+    const block_id_t old_root_id = superblock_->get_root_block_id();
+    if (old_root_id != NULL_BLOCK_ID) {
+        buf_lock_t old_root(txn_, old_root_id, rwi_write);
+        old_root.mark_deleted();
+    }
+    insert_root(root->get_block_id(), superblock_);
+
+    ensure_stat_block(txn_, superblock_, incr_priority(ZERO_EVICTION_PRIORITY));
+    buf_lock_t stat_block(txn_, superblock_->get_stat_block_id(), rwi_write,
+                          buffer_cache_order_mode_ignore);
+    static_cast<btree_statblock_t *>(stat_block.get_data_write())->population += population_;
+
+    leaf_.reset();
+    levels_.clear();
+}
@@ -0,0 +1,97 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#ifndef BTREE_BULK_LOAD_HPP_
+#define BTREE_BULK_LOAD_HPP_
+
+#include <stdint.h>
+
+#include "errors.hpp"
+#include <boost/ptr_container/ptr_vector.hpp>
+
+#include "btree/keys.hpp"
+#include "buffer_cache/types.hpp"
+#include "containers/scoped.hpp"
+#include "repli_timestamp.hpp"
+
+class btree_slice_t;
+class superblock_t;
+template <class> class value_sizer_t;
+
+// Returns true if the btree has no entries at all, not even deletion entries.
+bool btree_is_empty(value_sizer_t<void> *sizer, transaction_t *txn, superblock_t *superblock);
+
+/* Builds a btree bottom-up out of key/value pairs that come in ascending key
+order, instead of inserting them one by one (which walks down from the root for
+every key and leaves split nodes half full).  The btree must be empty, see
+btree_is_empty().
+
+Leaves get filled up to `fill_factor` of their space and are then left alone,
+so leave some room if more keys are going to be inserted in between later.
+Internal nodes are filled completely.  Every entry gets `timestamp`, and every
+node the transaction's recency, just like regular inserts in the same
+transaction would, so backfilling works on the result as usual.  (Unless the
+superblock says the btree keeps no history, see leaf_history_t, then the entries
+get no timestamps at all.)
+
+Nothing is visible through the superblock until finish() is called. */
+class btree_bulk_loader_t {
+public:
+    btree_bulk_loader_t(value_sizer_t<void> *sizer, btree_slice_t *slice,
+                        transaction_t *txn, superblock_t *superblock,
+                        repli_timestamp_t timestamp, double fill_factor);
+    ~btree_bulk_loader_t();
+
+    // `key` must be greater than the key of the previous call.
+    void add(const btree_key_t *key, const void *value);
+
+    // Makes the tree the superblock's btree and updates the population count.
+    void finish();
+
+    int64_t population() const { return population_; }
+
+private:
+    struct level_t {
+        level_t() : has_pending(false), pending_child(NULL_BLOCK_ID) { }
+
+        // The rightmost node at this level.
+        scoped_ptr_t<buf_lock_t> node;
+
+        // `node` is full and `pending_child` is the child after it, separated
+        // from it by `pending_key`.  The child goes in the next node at this
+        // level, once another child comes along, so that no node ends up with
+        // a single child.
+        bool has_pending;
+        store_key_t pending_key;
+        block_id_t pending_child;
+    };
+
+    // Makes `right` the child after `left`, at `height` (where leaves are at
+    // height 0), with `key` as the greatest key that goes in `left`.
+    void push(size_t height, const btree_key_t *key, block_id_t left, block_id_t right);
+
+    void new_internal_node(const btree_key_t *key, block_id_t left, block_id_t right,
+                           scoped_ptr_t<buf_lock_t> *node_out);
+
+    value_sizer_t<void> *const sizer_;
+    btree_slice_t *const slice_;
+    transaction_t *const txn_;
+    superblock_t *const superblock_;
+    const repli_timestamp_t timestamp_;
+    const double fill_factor_;
+
+    scoped_ptr_t<buf_lock_t> leaf_;
+    bool has_last_key_;
+    store_key_t last_key_;
+    // The greatest key of the leaf before leaf_, if there is one.
+    bool has_left_bound_;
+    store_key_t left_bound_;
+
+    // Levels 1 and up.
+    boost::ptr_vector<level_t> levels_;
+
+    int64_t population_;
+    bool finished_;
+
+    DISABLE_COPYING(btree_bulk_loader_t);
+};
+
+#endif  // BTREE_BULK_LOAD_HPP_
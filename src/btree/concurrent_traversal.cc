@@ -83,6 +83,10 @@ public:
         return cb_->get_trace();
     }
 
+    virtual bool leaves_accessed_once() THROWS_NOTHING {
+        return cb_->leaves_accessed_once();
+    }
+
 private:
     friend class concurrent_traversal_fifo_enforcer_signal_t;
 
@@ -135,13 +139,15 @@ void concurrent_traversal_fifo_enforcer_signal_t::wait_interruptible() THROWS_ON
 bool btree_concurrent_traversal(btree_slice_t *slice, transaction_t *transaction,
                                 superblock_t *superblock, const key_range_t &range,
                                 concurrent_traversal_callback_t *cb,
-                                direction_t direction) {
+                                direction_t direction,
+                                bool release_superblock) {
     cond_t failure_cond;
     bool failure_seen;
     {
         concurrent_traversal_adapter_t adapter(cb, &failure_cond);
         failure_seen = !btree_depth_first_traversal(slice, transaction, superblock,
-                                                    range, &adapter, direction);
+                                                    range, &adapter, direction,
+                                                    release_superblock);
     }
     // Now that adapter is destroyed, the operations that might have failed have all
     // drained.  (If we fail, we try to report it to btree_depth_first_traversal (to
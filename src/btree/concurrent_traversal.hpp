@@ -36,6 +36,9 @@ public:
 
     virtual profile::trace_t *get_trace() THROWS_NOTHING { return NULL; }
 
+    // See depth_first_traversal_callback_t::leaves_accessed_once().
+    virtual bool leaves_accessed_once() THROWS_NOTHING { return false; }
+
 protected:
     virtual ~concurrent_traversal_callback_t() { }
 private:
@@ -45,7 +48,8 @@ private:
 bool btree_concurrent_traversal(btree_slice_t *slice, transaction_t *transaction,
                                 superblock_t *superblock, const key_range_t &range,
                                 concurrent_traversal_callback_t *cb,
-                                direction_t direction);
+                                direction_t direction,
+                                bool release_superblock = true);
 
 
 
@@ -5,17 +5,32 @@
 #include "rdb_protocol/profile.hpp"
 
 /* Returns `true` if we reached the end of the subtree or range, and `false` if
-`cb->handle_value()` returned `false`. */
+`cb->handle_value()` returned `false`. `block` is `depth` levels below the root.
+`*leaf_depth` is the depth of the leaves, or -1 until we got to the first one. */
 bool btree_depth_first_traversal(btree_slice_t *slice, transaction_t *transaction,
                                  counted_t<counted_buf_lock_t> block,
                                  const key_range_t &range,
                                  depth_first_traversal_callback_t *cb,
-                                 direction_t direction);
+                                 direction_t direction,
+                                 int depth, int *leaf_depth);
 
-bool btree_depth_first_traversal(btree_slice_t *slice, transaction_t *transaction, superblock_t *superblock, const key_range_t &range, depth_first_traversal_callback_t *cb, direction_t direction) {
+/* Called right before acquiring or prefetching a child at `depth`. All the leaves
+of a btree are at the same depth, so once we found one we know which children are
+leaves. */
+void set_child_access_hint(transaction_t *transaction,
+                           depth_first_traversal_callback_t *cb,
+                           int depth, int leaf_depth) {
+    if (depth == leaf_depth && cb->leaves_accessed_once()) {
+        transaction->set_next_access_hint(CACHE_ACCESS_HINT_ONCE);
+    }
+}
+
+bool btree_depth_first_traversal(btree_slice_t *slice, transaction_t *transaction, superblock_t *superblock, const key_range_t &range, depth_first_traversal_callback_t *cb, direction_t direction, bool release_superblock) {
     block_id_t root_block_id = superblock->get_root_block_id();
     if (root_block_id == NULL_BLOCK_ID) {
-        superblock->release();
+        if (release_superblock) {
+            superblock->release();
+        }
         return true;
     } else {
         counted_t<counted_buf_lock_t> root_block;
@@ -24,8 +39,12 @@ bool btree_depth_first_traversal(btree_slice_t *slice, transaction_t *transactio
             root_block = make_counted<counted_buf_lock_t>(transaction, root_block_id,
                                                            rwi_read);
         }
-        superblock->release();
-        return btree_depth_first_traversal(slice, transaction, std::move(root_block), range, cb, direction);
+        if (release_superblock) {
+            superblock->release();
+        }
+        int leaf_depth = -1;
+        return btree_depth_first_traversal(slice, transaction, std::move(root_block), range, cb, direction,
+                                           0, &leaf_depth);
     }
 }
 
@@ -33,7 +52,8 @@ bool btree_depth_first_traversal(btree_slice_t *slice, transaction_t *transactio
                                  counted_t<counted_buf_lock_t> block,
                                  const key_range_t &range,
                                  depth_first_traversal_callback_t *cb,
-                                 direction_t direction) {
+                                 direction_t direction,
+                                 int depth, int *leaf_depth) {
     const node_t *node = reinterpret_cast<const node_t *>(block->get_data_read());
     if (node::is_internal(node)) {
         const internal_node_t *inode = reinterpret_cast<const internal_node_t *>(node);
@@ -46,22 +66,40 @@ bool btree_depth_first_traversal(btree_slice_t *slice, transaction_t *transactio
             r.decrement();
             end_index = internal_node::get_offset_index(inode, r.btree_key()) + 1;
         }
+        // We prefetch the next few children, so that the reads for them are in
+        // flight while we traverse the current one. We hold the lock on `block`
+        // all along, so the children can't get deleted.
+        int next_prefetch = 1;
         for (int i = 0; i < end_index - start_index; ++i) {
+            for (; next_prefetch < end_index - start_index
+                     && next_prefetch <= i + BTREE_TRAVERSAL_PREFETCH_CHILDREN;
+                 ++next_prefetch) {
+                int prefetch_index = (direction == FORWARD
+                                      ? start_index + next_prefetch
+                                      : (end_index - 1) - next_prefetch);
+                set_child_access_hint(transaction, cb, depth + 1, *leaf_depth);
+                transaction->prefetch(
+                    internal_node::get_pair_by_index(inode, prefetch_index)->lnode);
+            }
+
             int true_index = (direction == FORWARD ? start_index + i : (end_index - 1) - i);
             const btree_internal_pair *pair = internal_node::get_pair_by_index(inode, true_index);
             counted_t<counted_buf_lock_t> lock;
             {
                 profile::starter_t starter("Acquire block for read.", cb->get_trace());
+                set_child_access_hint(transaction, cb, depth + 1, *leaf_depth);
                 lock = make_counted<counted_buf_lock_t>(transaction, pair->lnode,
                                                              rwi_read);
             }
             if (!btree_depth_first_traversal(slice, transaction, std::move(lock),
-                                             range, cb, direction)) {
+                                             range, cb, direction,
+                                             depth + 1, leaf_depth)) {
                 return false;
             }
         }
         return true;
     } else {
+        *leaf_depth = depth;
         const leaf_node_t *lnode = reinterpret_cast<const leaf_node_t *>(node);
         const btree_key_t *key;
 
@@ -98,6 +136,9 @@ bool btree_depth_first_traversal(btree_slice_t *slice, transaction_t *transactio
                 }
             }
         }
+        // A traversal doesn't come back to a leaf, so a single-pass snapshot no
+        // longer needs writers to keep its version.
+        transaction->pass_block(block->get_block_id());
         return true;
     }
 }
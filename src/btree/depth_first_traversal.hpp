@@ -19,7 +19,8 @@ public:
 };
 
 // A btree leaf key/value pair that also owns a reference to the buf_lock_t that
-// contains said key/value pair.
+// contains said key/value pair.  The key is a copy, since leaf nodes that elide
+// a common key prefix don't store it in one piece.
 class scoped_key_value_t {
 public:
     scoped_key_value_t(const btree_key_t *key,
@@ -33,13 +34,12 @@ public:
         : key_(movee.key_),
           value_(movee.value_),
           buf_(std::move(movee.buf_)) {
-        movee.key_ = NULL;
         movee.value_ = NULL;
     }
 
     const btree_key_t *key() const {
         guarantee(buf_.has());
-        return key_;
+        return key_.btree_key();
     }
     const void *value() const {
         guarantee(buf_.has());
@@ -51,7 +51,7 @@ public:
     void reset() { buf_.reset(); }
 
 private:
-    const btree_key_t *key_;
+    store_key_t key_;
     const void *value_;
     movable_t<counted_buf_lock_t> buf_;
 };
@@ -62,6 +62,11 @@ public:
     traversing the tree. */
     virtual bool handle_pair(scoped_key_value_t &&keyvalue) = 0;
     virtual profile::trace_t *get_trace() THROWS_NOTHING { return NULL; }
+    /* If `true`, the leaves we get to from now on are acquired with
+    CACHE_ACCESS_HINT_ONCE, so that a large scan doesn't push the rest of the
+    cache out. The superblock and the internal nodes keep the transaction's
+    hint. */
+    virtual bool leaves_accessed_once() THROWS_NOTHING { return false; }
 protected:
     virtual ~depth_first_traversal_callback_t() { }
 };
@@ -74,9 +79,12 @@ enum direction_t {
 ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(direction_t, int8_t, FORWARD, BACKWARD);
 
 /* Returns `true` if we reached the end of the btree or range, and `false` if
-`cb->handle_value()` returned `false`. */
+`cb->handle_value()` returned `false`.  Releases `superblock` once it has the root
+block, unless `release_superblock` is false, for callers that go on to write with
+it. */
 bool btree_depth_first_traversal(btree_slice_t *slice, transaction_t *transaction,
         superblock_t *superblock, const key_range_t &range,
-        depth_first_traversal_callback_t *cb, direction_t direction);
+        depth_first_traversal_callback_t *cb, direction_t direction,
+        bool release_superblock = true);
 
 #endif /* BTREE_DEPTH_FIRST_TRAVERSAL_HPP_ */
@@ -6,6 +6,7 @@
 
 // TODO: Uhm, refactor the sizer definitions to a central place, so we don't have to include
 // files from non-btree directories here
+#include "btree/leaf_node.hpp"
 #include "memcached/memcached_btree/value.hpp"
 #include "rdb_protocol/btree.hpp"
 
@@ -19,10 +20,10 @@
  */
 #define DETEMPLATIZE_LEAF_NODE_OP(op_name, leaf_node, sizer_argument, ...) \
     do {                                                                \
-        if (leaf_node->magic == value_sizer_t<memcached_value_t>::leaf_magic()) { \
+        if (leaf::value_magic(leaf_node) == value_sizer_t<memcached_value_t>::leaf_magic()) { \
             value_sizer_t<memcached_value_t> sizer(sizer_argument);     \
             op_name(&sizer, __VA_ARGS__);            \
-        } else if (leaf_node->magic == value_sizer_t<rdb_value_t>::leaf_magic()) { \
+        } else if (leaf::value_magic(leaf_node) == value_sizer_t<rdb_value_t>::leaf_magic()) { \
             value_sizer_t<rdb_value_t> sizer(sizer_argument);     \
             op_name(&sizer, __VA_ARGS__);            \
         } else {                                                        \
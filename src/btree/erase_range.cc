@@ -1,7 +1,12 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "btree/erase_range.hpp"
+
+#include <vector>
+
+#include "btree/internal_node.hpp"
 #include "btree/leaf_node.hpp"
 #include "btree/node.hpp"
+#include "btree/operations.hpp"
 #include "btree/parallel_traversal.hpp"
 #include "btree/slice.hpp"
 #include "buffer_cache/buffer_cache.hpp"
@@ -23,6 +28,19 @@ public:
                         const btree_key_t *r_incl,
                         signal_t *,
                         int *population_change_out) THROWS_ONLY(interrupted_exc_t) {
+        *population_change_out = -erase_keys_in_leaf(sizer_, tester_, deleter_,
+                                                     left_exclusive_or_null_,
+                                                     right_inclusive_or_null_,
+                                                     txn, leaf_node_buf, l_excl, r_incl);
+    }
+
+    // Erases the keys in (left_excl, right_incl] from the leaf, whose own keys are
+    // in (l_excl, r_incl], and returns how many there were.
+    static int erase_keys_in_leaf(value_sizer_t<void> *sizer, key_tester_t *tester,
+                                  value_deleter_t *deleter,
+                                  const btree_key_t *left_excl, const btree_key_t *right_incl,
+                                  transaction_t *txn, buf_lock_t *leaf_node_buf,
+                                  const btree_key_t *l_excl, const btree_key_t *r_incl) {
         leaf_node_t *node = reinterpret_cast<leaf_node_t *>(leaf_node_buf->get_data_write());
 
         std::vector<store_key_t> keys_to_delete;
@@ -37,22 +55,22 @@ public:
             // keys allowed for the leaf node.
             assert_key_in_range(k, l_excl, r_incl);
 
-            if (key_in_range(k, left_exclusive_or_null_, right_inclusive_or_null_) && tester_->key_should_be_erased(k)) {
+            if (key_in_range(k, left_excl, right_incl) && tester->key_should_be_erased(k)) {
                 keys_to_delete.push_back(store_key_t(k));
             }
         }
 
-        scoped_malloc_t<char> value(sizer_->max_possible_size());
+        scoped_malloc_t<char> value(sizer->max_possible_size());
 
         for (size_t i = 0; i < keys_to_delete.size(); ++i) {
-            bool found = leaf::lookup(sizer_, node, keys_to_delete[i].btree_key(), value.get());
+            bool found = leaf::lookup(sizer, node, keys_to_delete[i].btree_key(), value.get());
             guarantee(found);
-            deleter_->delete_value(txn, value.get());
-            leaf::erase_presence(sizer_, node, keys_to_delete[i].btree_key(),
+            deleter->delete_value(txn, value.get());
+            leaf::erase_presence(sizer, node, keys_to_delete[i].btree_key(),
                                  key_modification_proof_t::real_proof());
         }
 
-        *population_change_out = -static_cast<int>(keys_to_delete.size());
+        return keys_to_delete.size();
     }
 
     void postprocess_internal_node(UNUSED buf_lock_t *internal_node_buf) {
@@ -109,6 +127,222 @@ private:
     DISABLE_COPYING(erase_range_helper_t);
 };
 
+/* Erases a range when every key in it goes, see key_tester_t::erases_every_key().
+The children of an internal node that lie entirely in the range get removed from
+it and deleted along with everything below them, so only the nodes on the paths
+to the two ends of the range have their keys erased one by one.  The leaves in
+the dropped subtrees still get read to delete their values (and count them), but
+they don't get rewritten.
+
+Nodes on the two paths can end up underfull, the writes that come through later
+merge them as usual.  An internal node still keeps at least two children, so this
+walks into some of the covered children instead of dropping them if it has to. */
+class subtree_eraser_t {
+public:
+    subtree_eraser_t(value_sizer_t<void> *sizer, value_deleter_t *deleter,
+                     const btree_key_t *left_exclusive_or_null,
+                     const btree_key_t *right_inclusive_or_null,
+                     transaction_t *txn, signal_t *interruptor)
+        : sizer_(sizer), deleter_(deleter),
+          left_exclusive_or_null_(left_exclusive_or_null),
+          right_inclusive_or_null_(right_inclusive_or_null),
+          txn_(txn), interruptor_(interruptor), erased_(0)
+    { }
+
+    // The number of keys erased so far.
+    int64_t erased() const { return erased_; }
+
+    // Erases the range from the subtree under `buf`, whose keys are in
+    // (l_excl, r_incl].  The node never loses so many children that it has
+    // fewer than two, even if this gets interrupted half way.
+    void erase_in_subtree(buf_lock_t *buf, const btree_key_t *l_excl, const btree_key_t *r_incl)
+        THROWS_ONLY(interrupted_exc_t) {
+        if (interruptor_->is_pulsed()) {
+            throw interrupted_exc_t();
+        }
+
+        const node_t *node = static_cast<const node_t *>(buf->get_data_read());
+        if (node::is_leaf(node)) {
+            always_true_key_tester_t tester;
+            erased_ += erase_range_helper_t::erase_keys_in_leaf(
+                sizer_, &tester, deleter_, left_exclusive_or_null_, right_inclusive_or_null_,
+                txn_, buf, l_excl, r_incl);
+            return;
+        }
+
+        const internal_node_t *inode = reinterpret_cast<const internal_node_t *>(node);
+        std::vector<child_t> children;
+        int num_dropped = 0;
+        for (int i = 0; i < inode->npairs; ++i) {
+            const btree_key_t *child_l_excl
+                = i == 0 ? l_excl : &internal_node::get_pair_by_index(inode, i - 1)->key;
+            const btree_key_t *child_r_incl
+                = i == inode->npairs - 1 ? r_incl : &internal_node::get_pair_by_index(inode, i)->key;
+            if (!erase_range_helper_t::overlaps(child_l_excl, child_r_incl,
+                                                left_exclusive_or_null_,
+                                                right_inclusive_or_null_)) {
+                continue;
+            }
+
+            child_t child;
+            child.index = i;
+            child.block_id = internal_node::get_pair_by_index(inode, i)->lnode;
+            child.left_unbounded = child_l_excl == NULL;
+            if (child_l_excl != NULL) {
+                child.left_exclusive.assign(child_l_excl);
+            }
+            child.right_unbounded = child_r_incl == NULL;
+            if (child_r_incl != NULL) {
+                child.right_inclusive.assign(child_r_incl);
+            }
+            child.drop = covers(child_l_excl, child_r_incl);
+            num_dropped += child.drop ? 1 : 0;
+            children.push_back(child);
+        }
+
+        for (auto it = children.begin();
+             it != children.end() && inode->npairs - num_dropped < 2; ++it) {
+            if (it->drop) {
+                it->drop = false;
+                --num_dropped;
+            }
+        }
+
+        // Go from right to left, so that removing a child doesn't move the ones
+        // we haven't gotten to yet.
+        for (auto it = children.rbegin(); it != children.rend(); ++it) {
+            if (it->drop) {
+                drop_child(buf, it->index);
+            } else {
+                buf_lock_t child_buf(txn_, it->block_id, rwi_write);
+                erase_in_subtree(&child_buf,
+                                 it->left_unbounded ? NULL : it->left_exclusive.btree_key(),
+                                 it->right_unbounded ? NULL : it->right_inclusive.btree_key());
+            }
+        }
+    }
+
+    // Deletes the subtree under `block_id` and its values.  The subtree must
+    // already be unreachable.
+    void drop_subtree(block_id_t block_id) {
+        buf_lock_t buf(txn_, block_id, rwi_write);
+        const node_t *node = static_cast<const node_t *>(buf.get_data_read());
+        if (node::is_leaf(node)) {
+            const leaf_node_t *leaf = reinterpret_cast<const leaf_node_t *>(node);
+            scoped_malloc_t<char> value(sizer_->max_possible_size());
+            for (auto it = leaf::begin(*leaf); it != leaf::end(*leaf); ++it) {
+                const btree_key_t *k = (*it).first;
+                if (!k) {
+                    break;
+                }
+                DEBUG_VAR bool found = leaf::lookup(sizer_, leaf, k, value.get());
+                rassert(found);
+                deleter_->delete_value(txn_, value.get());
+                ++erased_;
+            }
+        } else {
+            const internal_node_t *inode = reinterpret_cast<const internal_node_t *>(node);
+            std::vector<block_id_t> child_ids;
+            for (int i = 0; i < inode->npairs; ++i) {
+                child_ids.push_back(internal_node::get_pair_by_index(inode, i)->lnode);
+            }
+            for (size_t i = 0; i < child_ids.size(); ++i) {
+                drop_subtree(child_ids[i]);
+            }
+        }
+        buf.mark_deleted();
+    }
+
+private:
+    struct child_t {
+        int index;
+        block_id_t block_id;
+        bool left_unbounded;
+        store_key_t left_exclusive;
+        bool right_unbounded;
+        store_key_t right_inclusive;
+        bool drop;
+    };
+
+    // True if (l_excl, r_incl] is inside the range we erase.
+    bool covers(const btree_key_t *l_excl, const btree_key_t *r_incl) const {
+        return (left_exclusive_or_null_ == NULL
+                || (l_excl != NULL && btree_key_cmp(left_exclusive_or_null_, l_excl) <= 0))
+            && (right_inclusive_or_null_ == NULL
+                || (r_incl != NULL && btree_key_cmp(r_incl, right_inclusive_or_null_) <= 0));
+    }
+
+    void drop_child(buf_lock_t *buf, int index) {
+        const block_size_t block_size = txn_->get_cache()->get_block_size();
+        internal_node_t *node = static_cast<internal_node_t *>(buf->get_data_write());
+        rassert(node->npairs > 2);
+        btree_internal_pair *pair = internal_node::get_pair_by_index(node, index);
+        const block_id_t child_id = pair->lnode;
+        if (index == node->npairs - 1) {
+            // The last pair has no key, so make the child before it the last one.
+            const btree_internal_pair *prev_pair = internal_node::get_pair_by_index(node, index - 1);
+            store_key_t prev_key(&prev_pair->key);
+            pair->lnode = prev_pair->lnode;
+            internal_node::remove(block_size, node, prev_key.btree_key());
+        } else {
+            store_key_t key(&pair->key);
+            internal_node::remove(block_size, node, key.btree_key());
+        }
+        drop_subtree(child_id);
+    }
+
+    value_sizer_t<void> *sizer_;
+    value_deleter_t *deleter_;
+    const btree_key_t *left_exclusive_or_null_;
+    const btree_key_t *right_inclusive_or_null_;
+    transaction_t *txn_;
+    signal_t *interruptor_;
+    int64_t erased_;
+
+    DISABLE_COPYING(subtree_eraser_t);
+};
+
+void erase_range_by_subtrees(value_sizer_t<void> *sizer,
+                             value_deleter_t *deleter,
+                             const btree_key_t *left_exclusive_or_null,
+                             const btree_key_t *right_inclusive_or_null,
+                             transaction_t *txn, superblock_t *superblock,
+                             signal_t *interruptor,
+                             bool release_superblock) THROWS_ONLY(interrupted_exc_t) {
+    ensure_stat_block(txn, superblock, incr_priority(ZERO_EVICTION_PRIORITY));
+
+    subtree_eraser_t eraser(sizer, deleter, left_exclusive_or_null, right_inclusive_or_null,
+                            txn, interruptor);
+    bool interrupted = false;
+    const block_id_t root_id = superblock->get_root_block_id();
+    if (root_id != NULL_BLOCK_ID) {
+        if (left_exclusive_or_null == NULL && right_inclusive_or_null == NULL) {
+            // Everything goes, so detach the whole tree.
+            insert_root(NULL_BLOCK_ID, superblock);
+            eraser.drop_subtree(root_id);
+        } else {
+            try {
+                buf_lock_t root(txn, root_id, rwi_write);
+                eraser.erase_in_subtree(&root, NULL, NULL);
+            } catch (const interrupted_exc_t &) {
+                interrupted = true;
+            }
+        }
+    }
+
+    if (eraser.erased() != 0) {
+        buf_lock_t stat_block(txn, superblock->get_stat_block_id(), rwi_write,
+                              buffer_cache_order_mode_ignore);
+        static_cast<btree_statblock_t *>(stat_block.get_data_write())->population -= eraser.erased();
+    }
+    if (release_superblock) {
+        superblock->release();
+    }
+    if (interrupted) {
+        throw interrupted_exc_t();
+    }
+}
+
 void btree_erase_range_generic(value_sizer_t<void> *sizer, btree_slice_t *slice,
                                key_tester_t *tester,
                                value_deleter_t *deleter,
@@ -117,6 +351,12 @@ void btree_erase_range_generic(value_sizer_t<void> *sizer, btree_slice_t *slice,
                                transaction_t *txn, superblock_t *superblock,
                                signal_t *interruptor,
                                bool release_superblock) {
+    if (tester->erases_every_key()) {
+        erase_range_by_subtrees(sizer, deleter, left_exclusive_or_null, right_inclusive_or_null,
+                                txn, superblock, interruptor, release_superblock);
+        return;
+    }
+
     erase_range_helper_t helper(sizer, tester, deleter, left_exclusive_or_null, right_inclusive_or_null);
     btree_parallel_traversal(txn, superblock, slice, &helper, interruptor, release_superblock);
 }
@@ -126,10 +366,7 @@ void erase_all(value_sizer_t<void> *sizer, btree_slice_t *slice,
                superblock_t *superblock,
                signal_t *interruptor,
                bool release_superblock) {
-    struct always_true_tester_t : public key_tester_t {
-        bool key_should_be_erased(const btree_key_t *) { return true; }
-    } always_true_tester;
-
+    always_true_key_tester_t always_true_tester;
     btree_erase_range_generic(sizer, slice, &always_true_tester,
                               deleter, NULL, NULL, txn, superblock,
                               interruptor, release_superblock);
@@ -18,6 +18,11 @@ public:
     key_tester_t() { }
     virtual bool key_should_be_erased(const btree_key_t *key) = 0;
 
+    // True if key_should_be_erased() is true for every key.  The erase then
+    // drops the subtrees that lie entirely in its range without looking at
+    // their keys, other than to delete their values.
+    virtual bool erases_every_key() { return false; }
+
 protected:
     virtual ~key_tester_t() { }
 private:
@@ -28,6 +33,7 @@ struct always_true_key_tester_t : public key_tester_t {
     bool key_should_be_erased(UNUSED const btree_key_t *key) {
         return true;
     }
+    bool erases_every_key() { return true; }
 };
 
 class value_deleter_t {
@@ -1,5 +1,9 @@
 // Copyright 2010-2012 RethinkDB, all rights reserved.
 #include "btree/get_distribution.hpp"
+
+#include <map>
+
+#include "btree/operations.hpp"
 #include "btree/parallel_traversal.hpp"
 #include "btree/node.hpp"
 #include "btree/leaf_node.hpp"
@@ -87,3 +91,109 @@ void get_btree_key_distribution(btree_slice_t *slice, transaction_t *txn, superb
     btree_parallel_traversal(txn, superblock, slice, &helper, &non_interruptor);
     *key_count_out = helper.key_count;
 }
+
+namespace {
+
+struct sampled_leaf_t {
+    sampled_leaf_t() : hits(0), weight(0), keys(0), bytes(0) { }
+
+    store_key_t left_key;
+    int hits;
+    // The inverse of the probability that a walk ends up in the leaf.
+    double weight;
+    int keys;
+    int bytes;
+};
+
+// Walks from `root` down to a random leaf, picking each child with the same
+// probability.
+void sample_leaf(transaction_t *txn, rng_t *rng, buf_lock_t *root,
+                 std::map<block_id_t, sampled_leaf_t> *leaves) {
+    buf_lock_t child;
+    buf_lock_t *buf = root;
+    double weight = 1;
+    for (;;) {
+        const node_t *node = static_cast<const node_t *>(buf->get_data_read());
+        if (node::is_leaf(node)) {
+            break;
+        }
+        const internal_node_t *internal = reinterpret_cast<const internal_node_t *>(node);
+        rassert(internal->npairs > 0);
+        const int index = rng->randint(internal->npairs);
+        weight *= internal->npairs;
+        const block_id_t child_id = internal_node::get_pair_by_index(internal, index)->lnode;
+
+        buf_lock_t tmp(txn, child_id, rwi_read);
+        child.swap(tmp);
+        buf = &child;
+    }
+
+    sampled_leaf_t *sample = &(*leaves)[buf->get_block_id()];
+    if (sample->hits == 0) {
+        const leaf_node_t *leaf = static_cast<const leaf_node_t *>(buf->get_data_read());
+        for (auto it = leaf::begin(*leaf); it != leaf::end(*leaf); ++it) {
+            if (sample->keys == 0) {
+                sample->left_key.assign((*it).first);
+            }
+            ++sample->keys;
+        }
+        sample->bytes = leaf->live_size;
+        sample->weight = weight;
+    }
+    ++sample->hits;
+}
+
+}  // namespace
+
+void sample_btree_key_distribution(transaction_t *txn, superblock_t *superblock, int num_descents, int64_t *key_count_out, std::vector<key_distribution_bucket_t> *buckets_out) {
+    rassert(buckets_out->empty());
+    rassert(num_descents > 0);
+
+    int64_t population = 0;
+    if (superblock->get_stat_block_id() != NULL_BLOCK_ID) {
+        buf_lock_t stat_block(txn, superblock->get_stat_block_id(), rwi_read);
+        population = static_cast<const btree_statblock_t *>(stat_block.get_data_read())->population;
+    }
+    *key_count_out = population;
+
+    const block_id_t root_id = superblock->get_root_block_id();
+    if (root_id == NULL_BLOCK_ID) {
+        superblock->release();
+        return;
+    }
+    buf_lock_t root(txn, root_id, rwi_read);
+    superblock->release();
+
+    std::map<block_id_t, sampled_leaf_t> leaves;
+    rng_t rng;
+    for (int i = 0; i < num_descents; ++i) {
+        sample_leaf(txn, &rng, &root, &leaves);
+    }
+
+    // The Hansen-Hurwitz estimates of the keys and bytes in each sampled leaf's
+    // bucket.
+    std::map<store_key_t, std::pair<double, double> > estimates;
+    double total_keys = 0;
+    for (auto it = leaves.begin(); it != leaves.end(); ++it) {
+        const sampled_leaf_t &sample = it->second;
+        if (sample.keys == 0) {
+            // Only an empty root leaf has no keys.
+            continue;
+        }
+        const double share = sample.hits * sample.weight / num_descents;
+        estimates[sample.left_key] = std::make_pair(share * sample.keys, share * sample.bytes);
+        total_keys += share * sample.keys;
+    }
+    if (total_keys == 0) {
+        return;
+    }
+
+    const double scale = population / total_keys;
+    for (auto it = estimates.begin(); it != estimates.end(); ++it) {
+        key_distribution_bucket_t bucket;
+        bucket.left_key = it->first;
+        bucket.key_count = static_cast<int64_t>(it->second.first * scale);
+        bucket.byte_count = static_cast<int64_t>(it->second.second * scale);
+        buckets_out->push_back(bucket);
+    }
+}
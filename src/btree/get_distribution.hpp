@@ -12,4 +12,26 @@ class superblock_t;
 
 void get_btree_key_distribution(btree_slice_t *slice, transaction_t *txn, superblock_t *superblock, int depth_limit, int64_t *key_count_out, std::vector<store_key_t> *keys_out);
 
+struct key_distribution_bucket_t {
+    // The bucket covers the keys from `left_key` up to the `left_key` of the
+    // next bucket.
+    store_key_t left_key;
+    int64_t key_count;
+    // The bytes the keys and their values take up in the leaves.
+    int64_t byte_count;
+};
+
+/* Estimates the distribution of the keys from `num_descents` random walks from
+the root to a leaf, instead of reading every node down to some depth.  A walk
+reaches a leaf with probability 1 / (the product of the fan-outs on its path), so
+each sampled leaf is weighted by that product, and the estimates are scaled so
+that the key counts add up to the population in the stat block.
+
+There is a bucket for every distinct leaf that gets sampled, sorted by
+`left_key`, so there are at most `num_descents` of them.  The estimates for a range
+of keys get better with the number of walks that end up in it, their relative
+error shrinks with the square root of it.  The cost doesn't depend on the size of
+the btree beyond its height.  Releases the superblock. */
+void sample_btree_key_distribution(transaction_t *txn, superblock_t *superblock, int num_descents, int64_t *key_count_out, std::vector<key_distribution_bucket_t> *buckets_out);
+
 #endif /* BTREE_GET_DISTRIBUTION_HPP_ */
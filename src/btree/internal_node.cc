@@ -4,6 +4,8 @@
 #include <algorithm>
 
 #include "btree/node.hpp"
+#include "buffer_cache/buffer_cache.hpp"
+#include "containers/scoped.hpp"
 
 //In this tree, less than or equal takes the left-hand branch and greater than takes the right hand branch
 
@@ -47,6 +49,87 @@ block_id_t lookup(const internal_node_t *node, const btree_key_t *key) {
     return get_pair_by_index(node, index)->lnode;
 }
 
+// How many lookups an unchanged node has to get before we build a search index
+// for it.  Nodes on the path of every write (like the root) change all the time,
+// and building the index costs about as much as a few dozen plain lookups.
+const int SEARCH_INDEX_BUILD_LOOKUPS = 8;
+
+// Nodes with fewer pairs than this are searched fast enough as they are.
+const int SEARCH_INDEX_MIN_PAIRS = 16;
+
+class search_index_t : public buf_derived_data_t {
+public:
+    search_index_t() : lookups_(0) { }
+
+    int get_offset_index(const internal_node_t *node, const btree_key_t *key) {
+        if (!prefixes_.has()) {
+            ++lookups_;
+            if (lookups_ < SEARCH_INDEX_BUILD_LOOKUPS || node->npairs < SEARCH_INDEX_MIN_PAIRS) {
+                return internal_node::get_offset_index(node, key);
+            }
+            build(node);
+        }
+        rassert(prefixes_.size() == static_cast<size_t>(node->npairs - 1));
+
+        // Keys with a smaller prefix are smaller than `key` and ones with a greater
+        // prefix are greater, so we only have to compare the full keys of the ones
+        // whose prefix ties with the prefix of `key`.
+        const uint64_t key_prefix = prefix(key);
+        const uint64_t *begin = prefixes_.data();
+        const uint64_t *end = begin + prefixes_.size();
+        const uint64_t *lo = std::lower_bound(begin, end, key_prefix);
+        if (lo == end || *lo != key_prefix) {
+            return lo - begin;
+        }
+        const uint64_t *hi = std::upper_bound(lo, end, key_prefix);
+        return std::lower_bound(node->pair_offsets + (lo - begin),
+                                node->pair_offsets + (hi - begin),
+                                static_cast<uint16_t>(internal_key_comp::faux_offset),
+                                internal_key_comp(node, key)) - node->pair_offsets;
+    }
+
+private:
+    // The first eight bytes of the key, zero padded, as a big-endian number.
+    // Prefixes are in the same order as the keys they come from, except that
+    // different keys can have the same prefix.
+    static uint64_t prefix(const btree_key_t *key) {
+        uint64_t ret = 0;
+        for (int i = 0; i < static_cast<int>(sizeof(ret)); ++i) {
+            ret = (ret << 8) | (i < key->size ? key->contents[i] : 0);
+        }
+        return ret;
+    }
+
+    void build(const internal_node_t *node) {
+        // The last pair's key is empty and greater than any other.
+        prefixes_.init(node->npairs - 1);
+        for (int i = 0; i < node->npairs - 1; ++i) {
+            prefixes_[i] = prefix(&get_pair_by_index(node, i)->key);
+        }
+    }
+
+    int lookups_;
+    scoped_array_t<uint64_t> prefixes_;
+
+    DISABLE_COPYING(search_index_t);
+};
+
+block_id_t lookup(buf_lock_t *buf, const btree_key_t *key) {
+    const internal_node_t *node = static_cast<const internal_node_t *>(buf->get_data_read());
+    if (!buf->can_use_derived_data()) {
+        return lookup(node, key);
+    }
+
+    buf_derived_data_t *derived = buf->get_derived_data();
+    if (derived == NULL) {
+        derived = new search_index_t;
+        buf->set_derived_data(derived);
+    }
+    rassert(dynamic_cast<search_index_t *>(derived) != NULL);
+    search_index_t *index = static_cast<search_index_t *>(derived);
+    return get_pair_by_index(node, index->get_offset_index(node, key))->lnode;
+}
+
 // TODO: If it's unused, let's get rid of it.
 bool insert(UNUSED block_size_t block_size, internal_node_t *node, const btree_key_t *key, block_id_t lnode, block_id_t rnode) {
     //TODO: write a unit test for this
@@ -3,6 +3,7 @@
 #define BTREE_INTERNAL_NODE_HPP_
 
 #include "btree/keys.hpp"
+#include "buffer_cache/types.hpp"
 #include "serializer/types.hpp"
 #include "utils.hpp"
 
@@ -29,6 +30,11 @@ void init(block_size_t block_size, internal_node_t *node);
 void init(block_size_t block_size, internal_node_t *node, const internal_node_t *lnode, const uint16_t *offsets, int numpairs);
 
 block_id_t lookup(const internal_node_t *node, const btree_key_t *key);
+// Like the above, for the internal node in `buf`.  Once the node has been looked up
+// in a few times without changing, this keeps a dense array of key prefixes for it
+// alongside the buf in the cache and searches that instead of following the pair
+// offsets into the node for every comparison.
+block_id_t lookup(buf_lock_t *buf, const btree_key_t *key);
 bool insert(block_size_t block_size, internal_node_t *node, const btree_key_t *key, block_id_t lnode, block_id_t rnode);
 bool remove(block_size_t block_size, internal_node_t *node, const btree_key_t *key);
 void split(block_size_t block_size, internal_node_t *node, internal_node_t *rnode, btree_key_t *median);
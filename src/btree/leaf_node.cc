@@ -79,6 +79,25 @@ const int SKIP_ENTRY_RESERVED = 251;
 // itself three bytes, so it can't fit in a slot of size one or two. We don't
 // expect to actually see many entries of size one or two, but it pays to be
 // thorough.
+//
+// A leaf node can also be in the prefix format, which elides a common prefix
+// from every key in the node.  Such a node has `PREFIX_FORMAT_MAGIC_BIT` set in
+// the last byte of its magic, and stores the prefix right after pair_offsets:
+//
+// [magic]...[tstamp_cutpoint][off0][off1]...[offN-1][prefix size][prefix]........[tstamp][entry]...
+//
+// The [btree key] of each entry then only holds what comes after the prefix.
+// The prefix is never empty; a node without one is in the plain format.
+//
+// The prefix is shared by every key that could ever go into the node, not just
+// by the keys it has right now, because it gets derived from the bounds of the
+// node's key range (see `narrow_key_range()`).  So inserting a key never makes
+// us shorten the prefix, which would make every entry in the node grow.  Only
+// merging and leveling extend a node's key range, and they take the growth
+// into account.
+
+// The value types' leaf magics are plain ASCII, so they never have this bit set.
+const uint8_t PREFIX_FORMAT_MAGIC_BIT = 0x80;
 
 
 struct entry_t;
@@ -150,6 +169,130 @@ repli_timestamp_t get_timestamp(const leaf_node_t *node, int offset) {
     return *reinterpret_cast<const repli_timestamp_t *>(reinterpret_cast<const char *>(node) + offset);
 }
 
+block_magic_t value_magic(const leaf_node_t *node) {
+    block_magic_t magic = node->magic;
+    magic.bytes[sizeof(magic.bytes) - 1] &= ~PREFIX_FORMAT_MAGIC_BIT;
+    return magic;
+}
+
+bool has_prefix(const leaf_node_t *node) {
+    uint8_t last_magic_byte = node->magic.bytes[sizeof(node->magic.bytes) - 1];
+    return (last_magic_byte & PREFIX_FORMAT_MAGIC_BIT) != 0;
+}
+
+const uint8_t *get_prefix_record(const leaf_node_t *node) {
+    return reinterpret_cast<const uint8_t *>(node->pair_offsets + node->num_pairs);
+}
+
+uint8_t *get_prefix_record(leaf_node_t *node) {
+    return reinterpret_cast<uint8_t *>(node->pair_offsets + node->num_pairs);
+}
+
+int prefix_size(const leaf_node_t *node) {
+    return has_prefix(node) ? *get_prefix_record(node) : 0;
+}
+
+const uint8_t *prefix_contents(const leaf_node_t *node) {
+    return get_prefix_record(node) + 1;
+}
+
+// The number of bytes the prefix takes up after pair_offsets.
+int prefix_record_size(const leaf_node_t *node) {
+    return has_prefix(node) ? 1 + prefix_size(node) : 0;
+}
+
+// The size of everything in front of the entries.
+int header_size(const leaf_node_t *node) {
+    return offsetof(leaf_node_t, pair_offsets) + sizeof(uint16_t) * node->num_pairs + prefix_record_size(node);
+}
+
+// Sets num_pairs to `num_pairs`, which is no larger than it was, and moves the
+// prefix to the new end of pair_offsets.
+void shrink_pair_offsets(leaf_node_t *node, int num_pairs) {
+    rassert(num_pairs <= node->num_pairs);
+    int record_size = prefix_record_size(node);
+    memmove(node->pair_offsets + num_pairs, node->pair_offsets + node->num_pairs, record_size);
+    node->num_pairs = num_pairs;
+}
+
+bool key_has_prefix(const leaf_node_t *node, const btree_key_t *key) {
+    int psize = prefix_size(node);
+    return key->size >= psize && memcmp(key->contents, prefix_contents(node), psize) == 0;
+}
+
+// The length of the longest common prefix of the prefixes of `a` and `b`.
+int common_prefix_size(const leaf_node_t *a, const leaf_node_t *b) {
+    int n = std::min(prefix_size(a), prefix_size(b));
+    const uint8_t *a_prefix = prefix_contents(a);
+    const uint8_t *b_prefix = prefix_contents(b);
+    int i = 0;
+    while (i < n && a_prefix[i] == b_prefix[i]) {
+        ++i;
+    }
+    return i;
+}
+
+// Copies the full key of `ent`, including the prefix, to `key_out`.
+void entry_full_key(const leaf_node_t *node, const entry_t *ent, btree_key_t *key_out) {
+    const btree_key_t *suffix = entry_key(ent);
+    int psize = prefix_size(node);
+    key_out->size = psize + suffix->size;
+    memcpy(key_out->contents, prefix_contents(node), psize);
+    memcpy(key_out->contents + psize, suffix->contents, suffix->size);
+}
+
+// Returns the full key of `ent`, which is either the key in the node or, if the
+// node has a prefix, a copy in `buf`.
+const btree_key_t *full_entry_key(const leaf_node_t *node, const entry_t *ent, store_key_t *buf) {
+    if (!has_prefix(node)) {
+        return entry_key(ent);
+    }
+    entry_full_key(node, ent, buf->btree_key());
+    return buf->btree_key();
+}
+
+// Writes `key`, with the node's prefix elided, to `dest` and returns the number
+// of bytes written.
+int write_key_suffix(const leaf_node_t *node, const btree_key_t *key, char *dest) {
+    rassert(key_has_prefix(node, key));
+    int psize = prefix_size(node);
+    btree_key_t *suffix = reinterpret_cast<btree_key_t *>(dest);
+    suffix->size = key->size - psize;
+    memcpy(suffix->contents, key->contents + psize, suffix->size);
+    return suffix->full_size();
+}
+
+// Writes a copy of `ent`, an entry of `fro`, to `dest`, eliding the first
+// `new_prefix_size` bytes of its full key, and returns the size of the copy.
+int copy_entry(value_sizer_t<void> *sizer, const leaf_node_t *fro, const entry_t *ent, int new_prefix_size, char *dest) {
+    rassert(!entry_is_skip(ent));
+    if (new_prefix_size == prefix_size(fro)) {
+        int sz = entry_size(sizer, ent);
+        memmove(dest, ent, sz);
+        return sz;
+    }
+
+    store_key_t key;
+    entry_full_key(fro, ent, key.btree_key());
+    rassert(key.size() >= new_prefix_size);
+
+    char *p = dest;
+    if (entry_is_deletion(ent)) {
+        *p = static_cast<char>(DELETE_ENTRY_CODE);
+        ++p;
+    }
+    btree_key_t *suffix = reinterpret_cast<btree_key_t *>(p);
+    suffix->size = key.size() - new_prefix_size;
+    memcpy(suffix->contents, key.contents() + new_prefix_size, suffix->size);
+    p += suffix->full_size();
+    if (entry_is_live(ent)) {
+        const void *value = entry_value(ent);
+        memmove(p, value, sizer->size(value));
+        p += sizer->size(value);
+    }
+    return p - dest;
+}
+
 struct entry_iter_t {
     int offset;
 
@@ -172,14 +315,15 @@ struct entry_iter_t {
     }
 };
 
-void strprint_entry(std::string *out, value_sizer_t<void> *sizer, const entry_t *entry) {
+void strprint_entry(std::string *out, value_sizer_t<void> *sizer, const leaf_node_t *node, const entry_t *entry) {
+    store_key_t buf;
     if (entry_is_live(entry)) {
-        const btree_key_t *key = entry_key(entry);
+        const btree_key_t *key = full_entry_key(node, entry, &buf);
         *out += strprintf("%.*s:", static_cast<int>(key->size), key->contents);
         *out += strprintf("[entry size=%d]", entry_size(sizer, entry));
         *out += strprintf("[value size=%d]", sizer->size(entry_value(entry)));
     } else if (entry_is_deletion(entry)) {
-        const btree_key_t *key = entry_key(entry);
+        const btree_key_t *key = full_entry_key(node, entry, &buf);
         *out += strprintf("%.*s:[deletion]", static_cast<int>(key->size), key->contents);
     } else if (entry_is_skip(entry)) {
         *out += strprintf("[skip %d]", entry_size(sizer, entry));
@@ -191,8 +335,9 @@ void strprint_entry(std::string *out, value_sizer_t<void> *sizer, const entry_t
 
 std::string strprint_leaf(value_sizer_t<void> *sizer, const leaf_node_t *node) {
     std::string out;
-    out += strprintf("Leaf(magic='%4.4s', num_pairs=%u, live_size=%u, frontmost=%u, tstamp_cutpoint=%u)\n",
-            node->magic.bytes, node->num_pairs, node->live_size, node->frontmost, node->tstamp_cutpoint);
+    out += strprintf("Leaf(magic='%4.4s', num_pairs=%u, live_size=%u, frontmost=%u, tstamp_cutpoint=%u, prefix='%.*s')\n",
+            value_magic(node).bytes, node->num_pairs, node->live_size, node->frontmost, node->tstamp_cutpoint,
+            prefix_size(node), reinterpret_cast<const char *>(prefix_contents(node)));
 
     out += strprintf("  Offsets:");
     for (int i = 0; i < node->num_pairs; ++i) {
@@ -203,7 +348,7 @@ std::string strprint_leaf(value_sizer_t<void> *sizer, const leaf_node_t *node) {
     out += strprintf("  By Key:");
     for (int i = 0; i < node->num_pairs; ++i) {
         out += strprintf(" %d:", node->pair_offsets[i]);
-        strprint_entry(&out, sizer, get_entry(node, node->pair_offsets[i]));
+        strprint_entry(&out, sizer, node, get_entry(node, node->pair_offsets[i]));
     }
     out += strprintf("\n");
 
@@ -216,7 +361,7 @@ std::string strprint_leaf(value_sizer_t<void> *sizer, const leaf_node_t *node) {
             repli_timestamp_t tstamp = get_timestamp(node, iter.offset);
             out += strprintf("[t=%" PRIu64 "]", tstamp.longtime);
         }
-        strprint_entry(&out, sizer, get_entry(node, iter.offset));
+        strprint_entry(&out, sizer, node, get_entry(node, iter.offset));
         iter.step(sizer, node);
     }
     out += strprintf("\n");
@@ -225,14 +370,15 @@ std::string strprint_leaf(value_sizer_t<void> *sizer, const leaf_node_t *node) {
 }
 
 
-void print_entry(FILE *fp, value_sizer_t<void> *sizer, const entry_t *entry) {
+void print_entry(FILE *fp, value_sizer_t<void> *sizer, const leaf_node_t *node, const entry_t *entry) {
+    store_key_t buf;
     if (entry_is_live(entry)) {
-        const btree_key_t *key = entry_key(entry);
+        const btree_key_t *key = full_entry_key(node, entry, &buf);
         fprintf(fp, "%.*s:", static_cast<int>(key->size), key->contents);
         fprintf(fp, "[entry size=%d]", entry_size(sizer, entry));
         fprintf(fp, "[value size=%d]", sizer->size(entry_value(entry)));
     } else if (entry_is_deletion(entry)) {
-        const btree_key_t *key = entry_key(entry);
+        const btree_key_t *key = full_entry_key(node, entry, &buf);
         fprintf(fp, "%.*s:[deletion]", static_cast<int>(key->size), key->contents);
     } else if (entry_is_skip(entry)) {
         fprintf(fp, "[skip %d]", entry_size(sizer, entry));
@@ -244,8 +390,9 @@ void print_entry(FILE *fp, value_sizer_t<void> *sizer, const entry_t *entry) {
 
 
 void print(FILE *fp, value_sizer_t<void> *sizer, const leaf_node_t *node) {
-    fprintf(fp, "Leaf(magic='%4.4s', num_pairs=%u, live_size=%u, frontmost=%u, tstamp_cutpoint=%u)\n",
-            node->magic.bytes, node->num_pairs, node->live_size, node->frontmost, node->tstamp_cutpoint);
+    fprintf(fp, "Leaf(magic='%4.4s', num_pairs=%u, live_size=%u, frontmost=%u, tstamp_cutpoint=%u, prefix='%.*s')\n",
+            value_magic(node).bytes, node->num_pairs, node->live_size, node->frontmost, node->tstamp_cutpoint,
+            prefix_size(node), reinterpret_cast<const char *>(prefix_contents(node)));
 
     fprintf(fp, "  Offsets:");
     for (int i = 0; i < node->num_pairs; ++i) {
@@ -257,7 +404,7 @@ void print(FILE *fp, value_sizer_t<void> *sizer, const leaf_node_t *node) {
     fprintf(fp, "  By Key:");
     for (int i = 0; i < node->num_pairs; ++i) {
         fprintf(fp, " %d:", node->pair_offsets[i]);
-        print_entry(fp, sizer, get_entry(node, node->pair_offsets[i]));
+        print_entry(fp, sizer, node, get_entry(node, node->pair_offsets[i]));
     }
     fprintf(fp, "\n");
 
@@ -273,7 +420,7 @@ void print(FILE *fp, value_sizer_t<void> *sizer, const leaf_node_t *node) {
             fprintf(fp, "[t=%" PRIu64 "]", tstamp.longtime);
             fflush(fp);
         }
-        print_entry(fp, sizer, get_entry(node, iter.offset));
+        print_entry(fp, sizer, node, get_entry(node, iter.offset));
         iter.step(sizer, node);
     }
     fprintf(fp, "\n");
@@ -309,10 +456,14 @@ bool fsck(value_sizer_t<void> *sizer, const btree_key_t *left_exclusive_or_null,
     // is not before the end of pair_offsets
 
     // Basic sanity checks on fields' values.
-    if (failed(node->magic == sizer->btree_leaf_magic(),
+    if (failed(value_magic(node) == sizer->btree_leaf_magic(),
                "bad leaf magic")
-        || failed(node->frontmost >= offsetof(leaf_node_t, pair_offsets) + node->num_pairs * sizeof(uint16_t),
+        || failed(node->frontmost >= offsetof(leaf_node_t, pair_offsets) + node->num_pairs * sizeof(uint16_t) + (has_prefix(node) ? 1 : 0),
                   "frontmost offset is before the end of pair_offsets")
+        || failed(!has_prefix(node) || prefix_size(node) > 0,
+                  "prefix format without a prefix")
+        || failed(node->frontmost >= header_size(node),
+                  "frontmost offset is before the end of the prefix")
         || failed(node->live_size <= (sizer->block_size().value() - node->frontmost) + sizeof(uint16_t) * node->num_pairs,
                   "live_size is impossibly large")
         || failed(node->tstamp_cutpoint >= node->frontmost,
@@ -371,16 +522,18 @@ bool fsck(value_sizer_t<void> *sizer, const btree_key_t *left_exclusive_or_null,
 
         const entry_t *ent = get_entry(node, offset);
         if (entry_is_live(ent)) {
+            store_key_t key_buf;
+            const btree_key_t *key = full_entry_key(node, ent, &key_buf);
             const void *value = entry_value(ent);
             int space = sizer->block_size().value() - (reinterpret_cast<const char *>(value) - reinterpret_cast<const char *>(node));
             if (!sizer->fits(value, space)) {
-                *msg_out = strprintf("problem with key %.*s: value does not fit\n", entry_key(ent)->size, entry_key(ent)->contents);
+                *msg_out = strprintf("problem with key %.*s: value does not fit\n", key->size, key->contents);
                 return false;
             }
 
             std::string fscker_msg;
-            if (!fscker->fsck(sizer, entry_key(ent), value, &fscker_msg)) {
-                *msg_out = strprintf("Problem with key %.*s: %s\n", entry_key(ent)->size, entry_key(ent)->contents, fscker_msg.c_str());
+            if (!fscker->fsck(sizer, key, value, &fscker_msg)) {
+                *msg_out = strprintf("Problem with key %.*s: %s\n", key->size, key->contents, fscker_msg.c_str());
                 return false;
             }
 
@@ -412,9 +565,11 @@ bool fsck(value_sizer_t<void> *sizer, const btree_key_t *left_exclusive_or_null,
 
     // Entries look valid, check key ordering.
 
+    // The keys we compare take turns using the two buffers.
+    store_key_t key_bufs[2];
     const btree_key_t *last = left_exclusive_or_null;
     for (int k = 0; k < node->num_pairs; ++k) {
-        const btree_key_t *key = entry_key(get_entry(node, node->pair_offsets[k]));
+        const btree_key_t *key = full_entry_key(node, get_entry(node, node->pair_offsets[k]), &key_bufs[k % 2]);
         if (failed(last == NULL || sized_strcmp(last->contents, last->size, key->contents, key->size) < 0,
                    "keys out of order")) {
             return false;
@@ -425,7 +580,9 @@ bool fsck(value_sizer_t<void> *sizer, const btree_key_t *left_exclusive_or_null,
     if (failed(last == NULL || right_inclusive_or_null == NULL
                || sized_strcmp(last->contents, last->size,
                                right_inclusive_or_null->contents, right_inclusive_or_null->size) <= 0,
-               "keys out of order (with right_inclusive key)")) {
+               "keys out of order (with right_inclusive key)")
+        || failed(right_inclusive_or_null == NULL || key_has_prefix(node, right_inclusive_or_null),
+                  "right_inclusive key does not begin with the prefix")) {
         return false;
     }
 
@@ -454,11 +611,16 @@ int free_space(value_sizer_t<void> *sizer) {
     return sizer->block_size().value() - offsetof(leaf_node_t, pair_offsets);
 }
 
+// How many of the most recent timestamps we have to keep.
+int mandatory_timestamps(value_sizer_t<void> *sizer) {
+    return sizer->leaf_history() == leaf_history_t::FULL ? MANDATORY_TIMESTAMPS : 0;
+}
+
 // Returns the mandatory storage cost of the node, returning a value
 // in the closed interval [0, free_space(sizer)].  Outputs the offset
 // of the first entry for which storing a timestamp is not mandatory.
 int mandatory_cost(value_sizer_t<void> *sizer, const leaf_node_t *node, int required_timestamps, int *tstamp_back_offset_out) {
-    int size = node->live_size;
+    int size = node->live_size + prefix_record_size(node);
 
     // node->live_size does not include deletion entries, deletion
     // entries' timestamps, and live entries' timestamps.  We add that
@@ -515,7 +677,8 @@ bool is_empty(const leaf_node_t *node) {
     return node->num_pairs == 0;
 }
 
-bool is_full(value_sizer_t<void> *sizer, const leaf_node_t *node, const btree_key_t *key, const void *value) {
+// The mandatory cost the node would have after inserting key/value.
+int cost_after_insert(value_sizer_t<void> *sizer, const leaf_node_t *node, const btree_key_t *key, const void *value) {
 
     // Upon an insertion, we preserve `MANDATORY_TIMESTAMPS - 1`
     // timestamps and add our own (accounted for below)
@@ -528,16 +691,26 @@ bool is_full(value_sizer_t<void> *sizer, const leaf_node_t *node, const btree_ke
     // be which allows us to get into a situation where is_full returns false
     // but when we call prepare_space_for_new_entry we fail with an insertion
     // because it doesn't actually fit.
-    int size = mandatory_cost(sizer, node, MANDATORY_TIMESTAMPS);
+    int size = mandatory_cost(sizer, node, mandatory_timestamps(sizer));
 
     // Add the space we'll need for the new key/value pair we would
     // insert.  We conservatively assume the key is not already
     // contained in the node.
 
-    size += sizeof(uint16_t) + sizeof(repli_timestamp_t) + key->full_size() + sizer->size(value);
+    rassert(key_has_prefix(node, key));
+    size += sizeof(uint16_t) + sizeof(repli_timestamp_t) + key->full_size() - prefix_size(node) + sizer->size(value);
+
+    return size;
+}
 
+bool is_full(value_sizer_t<void> *sizer, const leaf_node_t *node, const btree_key_t *key, const void *value) {
     // The node is full if we can't fit all that data within the free space.
-    return size > free_space(sizer);
+    return cost_after_insert(sizer, node, key, value) > free_space(sizer);
+}
+
+bool is_full(value_sizer_t<void> *sizer, const leaf_node_t *node, const btree_key_t *key, const void *value, double fill_factor) {
+    rassert(0 < fill_factor && fill_factor <= 1);
+    return cost_after_insert(sizer, node, key, value) > free_space(sizer) * fill_factor;
 }
 
 bool is_underfull(value_sizer_t<void> *sizer, const leaf_node_t *node) {
@@ -556,7 +729,7 @@ bool is_underfull(value_sizer_t<void> *sizer, const leaf_node_t *node) {
     // free_space / 2 - leaf_epsilon.  We don't want an immediately
     // split node to be underfull, hence the threshold used below.
 
-    return mandatory_cost(sizer, node, MANDATORY_TIMESTAMPS) < free_space(sizer) / 2 - leaf_epsilon(sizer);
+    return mandatory_cost(sizer, node, mandatory_timestamps(sizer)) < free_space(sizer) / 2 - leaf_epsilon(sizer);
 }
 
 
@@ -641,7 +814,7 @@ void garbage_collect(value_sizer_t<void> *sizer, leaf_node_t *node, int num_tsta
         *preserved_index = j;
     }
 
-    node->num_pairs = j;
+    shrink_pair_offsets(node, j);
 
     validate(sizer, node);
 }
@@ -653,6 +826,106 @@ void garbage_collect(value_sizer_t<void> *sizer, leaf_node_t *node, int num_tsta
     rassert(ignore == 0);
 }
 
+// Returns the mandatory cost the node would have after
+// set_prefix(sizer, node, ..., new_prefix_size), which can be larger
+// than free_space(sizer).
+int mandatory_cost_with_prefix(value_sizer_t<void> *sizer, const leaf_node_t *node, int new_prefix_size) {
+    int tstamp_back_offset;
+    int cost = mandatory_cost(sizer, node, mandatory_timestamps(sizer), &tstamp_back_offset);
+
+    // Count the entries that garbage_collect() would keep.
+    int num_entries = 0;
+    for (int i = 0; i < node->num_pairs; ++i) {
+        int offset = node->pair_offsets[i];
+        if (offset < tstamp_back_offset || entry_is_live(get_entry(node, offset))) {
+            ++num_entries;
+        }
+    }
+
+    int new_record_size = new_prefix_size == 0 ? 0 : 1 + new_prefix_size;
+    return cost + (prefix_size(node) - new_prefix_size) * num_entries
+        + new_record_size - prefix_record_size(node);
+}
+
+// Garbage collects the node and re-encodes its keys so that their first
+// `new_prefix_size` bytes, which must be the same for all of them, are the
+// node's prefix.  The caller must make sure that the result fits, see
+// mandatory_cost_with_prefix().
+void set_prefix(value_sizer_t<void> *sizer, leaf_node_t *node, const uint8_t *new_prefix, int new_prefix_size) {
+    rassert(new_prefix_size <= MAX_KEY_SIZE);
+
+    // `new_prefix` may point into the node, so copy it before we move things
+    // around.
+    uint8_t prefix_buf[MAX_KEY_SIZE];
+    memcpy(prefix_buf, new_prefix, new_prefix_size);
+
+    // Afterwards there are no skip entries and every entry is referred to by
+    // pair_offsets.
+    garbage_collect(sizer, node, mandatory_timestamps(sizer));
+
+    // Write the re-encoded entries to a scratch buffer, in the same order, and
+    // remember where each one went.
+    const int bs = sizer->block_size().value();
+    scoped_array_t<char> entries(bs);
+    scoped_array_t<uint16_t> new_offsets(bs);
+    int size = 0;
+    int new_tstamp_cutpoint = -1;
+    int live_size = 0;
+
+    entry_iter_t iter = entry_iter_t::make(node);
+    while (!iter.done(sizer)) {
+        int offset = iter.offset;
+        if (offset == node->tstamp_cutpoint) {
+            new_tstamp_cutpoint = size;
+        }
+        new_offsets[offset] = size;
+
+        if (offset < node->tstamp_cutpoint) {
+            memcpy(entries.data() + size, get_at_offset(node, offset), sizeof(repli_timestamp_t));
+            size += sizeof(repli_timestamp_t);
+        }
+
+        const entry_t *ent = get_entry(node, offset);
+        int sz = copy_entry(sizer, node, ent, new_prefix_size, entries.data() + size);
+        if (entry_is_live(ent)) {
+            live_size += sizeof(uint16_t) + sz;
+        }
+        size += sz;
+
+        iter.step(sizer, node);
+    }
+    if (new_tstamp_cutpoint == -1) {
+        new_tstamp_cutpoint = size;
+    }
+
+    const int new_frontmost = bs - size;
+    for (int i = 0; i < node->num_pairs; ++i) {
+        node->pair_offsets[i] = new_frontmost + new_offsets[node->pair_offsets[i]];
+    }
+
+    const int new_record_size = new_prefix_size == 0 ? 0 : 1 + new_prefix_size;
+    guarantee(offsetof(leaf_node_t, pair_offsets) + sizeof(uint16_t) * node->num_pairs
+              + new_record_size <= static_cast<size_t>(new_frontmost),
+              "the re-encoded leaf node does not fit");
+
+    char *last_magic_byte = &node->magic.bytes[sizeof(node->magic.bytes) - 1];
+    if (new_prefix_size == 0) {
+        *last_magic_byte &= ~PREFIX_FORMAT_MAGIC_BIT;
+    } else {
+        *last_magic_byte |= PREFIX_FORMAT_MAGIC_BIT;
+        uint8_t *record = get_prefix_record(node);
+        record[0] = new_prefix_size;
+        memcpy(record + 1, prefix_buf, new_prefix_size);
+    }
+
+    memcpy(get_at_offset(node, new_frontmost), entries.data(), size);
+    node->frontmost = new_frontmost;
+    node->tstamp_cutpoint = new_frontmost + new_tstamp_cutpoint;
+    node->live_size = live_size;
+
+    validate(sizer, node);
+}
+
 void clean_entry(void *p, int sz) {
     rassert(sz > 0);
 
@@ -677,17 +950,19 @@ void clean_entry(void *p, int sz) {
 // Moves entries with pair_offsets indices in the clopen range [beg,
 // end) from fro to tow.
 void move_elements(value_sizer_t<void> *sizer, leaf_node_t *fro, int beg, int end, int wpoint, leaf_node_t *tow, int fro_copysize, int fro_mand_offset) {
-    rassert(is_underfull(sizer, tow));
+    // The entries of fro get re-encoded for tow's prefix, which must be a
+    // prefix of fro's.  fro_copysize has to account for that.
+    rassert(prefix_size(tow) <= prefix_size(fro));
 
     // This assertion is a bit loose.
-    rassert(fro_copysize + mandatory_cost(sizer, tow, MANDATORY_TIMESTAMPS) <= free_space(sizer));
+    rassert(fro_copysize + mandatory_cost(sizer, tow, mandatory_timestamps(sizer)) <= free_space(sizer));
 
     // Make tow have a nice big region we can copy entries to.  Also,
     // this means we have no "skip" entries in tow.
-    garbage_collect(sizer, tow, MANDATORY_TIMESTAMPS, &wpoint);
+    garbage_collect(sizer, tow, mandatory_timestamps(sizer), &wpoint);
 
-    // Now resize and move tow's pair_offsets.
-    memmove(tow->pair_offsets + wpoint + (end - beg), tow->pair_offsets + wpoint, sizeof(uint16_t) * (tow->num_pairs - wpoint));
+    // Now resize and move tow's pair_offsets, along with its prefix.
+    memmove(tow->pair_offsets + wpoint + (end - beg), tow->pair_offsets + wpoint, sizeof(uint16_t) * (tow->num_pairs - wpoint) + prefix_record_size(tow));
 
     tow->num_pairs += end - beg;
 
@@ -760,11 +1035,12 @@ void move_elements(value_sizer_t<void> *sizer, leaf_node_t *fro, int beg, int en
         if (tow_tstamp < fro_tstamp) {
             entry_t *ent = get_entry(fro, fro_offset);
             int entsz = entry_size(sizer, ent);
-            int sz = sizeof(repli_timestamp_t) + entsz;
-            memmove(get_at_offset(tow, wri_offset), get_at_offset(fro, fro_offset), sz);
+            memmove(get_at_offset(tow, wri_offset), get_at_offset(fro, fro_offset), sizeof(repli_timestamp_t));
+            int copysz = copy_entry(sizer, fro, ent, prefix_size(tow), get_at_offset(tow, wri_offset + sizeof(repli_timestamp_t)));
+            int sz = sizeof(repli_timestamp_t) + copysz;
 
             if (entry_is_live(ent)) {
-                livesize += entsz + sizeof(uint16_t);
+                livesize += copysz + sizeof(uint16_t);
                 fro_live_size_adjustment -= entsz + sizeof(uint16_t);
             }
 
@@ -808,13 +1084,13 @@ void move_elements(value_sizer_t<void> *sizer, leaf_node_t *fro, int beg, int en
         entry_t *ent = get_entry(fro, fro_offset);
         if (entry_is_live(ent)) {
             int sz = entry_size(sizer, ent);
-            memmove(get_at_offset(tow, wri_offset), ent, sz);
+            int copysz = copy_entry(sizer, fro, ent, prefix_size(tow), get_at_offset(tow, wri_offset));
             clean_entry(ent, sz);
             fro_live_size_adjustment -= sz + sizeof(uint16_t);
 
             fro->pair_offsets[beg + tow->pair_offsets[fro_index]] = wri_offset;
-            wri_offset += sz;
-            livesize += sz + sizeof(uint16_t);
+            wri_offset += copysz;
+            livesize += copysz + sizeof(uint16_t);
         } else {
             rassert(entry_is_deletion(ent));
 
@@ -884,7 +1160,7 @@ void move_elements(value_sizer_t<void> *sizer, leaf_node_t *fro, int beg, int en
     // in tow, and move fro entries.
     memcpy(tow->pair_offsets + wpoint, fro->pair_offsets + beg,
            sizeof(uint16_t) * (end - beg));
-    memmove(fro->pair_offsets + beg, fro->pair_offsets + end, sizeof(uint16_t) * (fro->num_pairs - end));
+    memmove(fro->pair_offsets + beg, fro->pair_offsets + end, sizeof(uint16_t) * (fro->num_pairs - end) + prefix_record_size(fro));
     fro->num_pairs -= end - beg;
 
     tow->frontmost = new_frontmost;
@@ -906,16 +1182,18 @@ void move_elements(value_sizer_t<void> *sizer, leaf_node_t *fro, int beg, int en
                 j += 1;
             }
         }
-        tow->num_pairs = j;
+        shrink_pair_offsets(tow, j);
     }
 
+    rassert(header_size(tow) <= tow->frontmost);
+
     validate(sizer, fro);
     validate(sizer, tow);
 }
 
 void split(value_sizer_t<void> *sizer, leaf_node_t *node, leaf_node_t *rnode, btree_key_t *median_out) {
     int tstamp_back_offset;
-    int mandatory = mandatory_cost(sizer, node, MANDATORY_TIMESTAMPS, &tstamp_back_offset);
+    int mandatory = mandatory_cost(sizer, node, mandatory_timestamps(sizer), &tstamp_back_offset);
 
     rassert(mandatory >= free_space(sizer) - leaf_epsilon(sizer));
 
@@ -982,10 +1260,36 @@ void split(value_sizer_t<void> *sizer, leaf_node_t *node, leaf_node_t *rnode, bt
 
     init(sizer, rnode);
 
+    // Both halves lie within node's key range, so rnode can use node's prefix.
+    if (prefix_size(node) > 0) {
+        rnode->magic.bytes[sizeof(rnode->magic.bytes) - 1] |= PREFIX_FORMAT_MAGIC_BIT;
+        memcpy(get_prefix_record(rnode), get_prefix_record(node), prefix_record_size(node));
+    }
+
     int node_copysize = end_rcost - num_mandatories * sizeof(uint16_t);
     move_elements(sizer, node, s, node->num_pairs, 0, rnode, node_copysize, tstamp_back_offset);
 
-    keycpy(median_out, entry_key(get_entry(node, node->pair_offsets[s - 1])));
+    entry_full_key(node, get_entry(node, node->pair_offsets[s - 1]), median_out);
+}
+
+bool is_past_last_key(const leaf_node_t *node, const btree_key_t *key) {
+    if (node->num_pairs == 0) {
+        return true;
+    }
+    store_key_t last_key;
+    entry_full_key(node, get_entry(node, node->pair_offsets[node->num_pairs - 1]),
+                   last_key.btree_key());
+    return btree_key_cmp(key, last_key.btree_key()) > 0;
+}
+
+void split_for_append(value_sizer_t<void> *sizer, leaf_node_t *node, leaf_node_t *rnode, btree_key_t *median_out) {
+    rassert(node->num_pairs > 0);
+
+    // rnode has nothing to say about the deletions that were forgotten before
+    // its range got split off, but an empty history makes backfills fall back
+    // to sending the whole range, same as when node's is incomplete.
+    init(sizer, rnode);
+    entry_full_key(node, get_entry(node, node->pair_offsets[node->num_pairs - 1]), median_out);
 }
 
 void merge(value_sizer_t<void> *sizer, leaf_node_t *left, leaf_node_t *right) {
@@ -994,10 +1298,20 @@ void merge(value_sizer_t<void> *sizer, leaf_node_t *left, leaf_node_t *right) {
     rassert(is_underfull(sizer, left));
     rassert(is_underfull(sizer, right));
 
+    // The merged node covers both key ranges, so it can only keep the part of
+    // the prefixes they have in common.
+    int common = common_prefix_size(left, right);
+    if (prefix_size(left) > common) {
+        set_prefix(sizer, left, prefix_contents(left), common);
+    }
+    if (prefix_size(right) > common) {
+        set_prefix(sizer, right, prefix_contents(right), common);
+    }
+
     int tstamp_back_offset;
-    int mandatory = mandatory_cost(sizer, left, MANDATORY_TIMESTAMPS, &tstamp_back_offset);
+    int mandatory = mandatory_cost(sizer, left, mandatory_timestamps(sizer), &tstamp_back_offset);
 
-    int left_copysize = mandatory;
+    int left_copysize = mandatory - prefix_record_size(left);
     // Uncount the uint16_t cost of mandatory  entries.  Sigh.
     for (int i = 0; i < left->num_pairs; ++i) {
         if (left->pair_offsets[i] < tstamp_back_offset || entry_is_deletion(get_entry(left, left->pair_offsets[i]))) {
@@ -1012,18 +1326,27 @@ void merge(value_sizer_t<void> *sizer, leaf_node_t *left, leaf_node_t *right) {
 bool level(value_sizer_t<void> *sizer, int nodecmp_node_with_sib, leaf_node_t *node, leaf_node_t *sibling, btree_key_t *replacement_key_out) {
     rassert(node != sibling);
 
-    // If sibling were underfull, we'd just merge the nodes.
+    // If the nodes were mergable, we'd just merge them.  sibling can still be
+    // underfull if the entries wouldn't fit with a shorter prefix.
     rassert(is_underfull(sizer, node));
-    rassert(!is_underfull(sizer, sibling));
+    rassert(!is_mergable(sizer, node, sibling));
 
     // First figure out the inclusive range [beg, end] of elements we want to move from sibling.
     int beg, end, *w, wstep;
 
-    int node_weight = mandatory_cost(sizer, node, MANDATORY_TIMESTAMPS);
+    // node gets the part of the prefixes the two nodes have in common, and
+    // every entry we move grows by what sibling's prefix has beyond that.
+    const int new_prefix_size = common_prefix_size(node, sibling);
+    const int growth = prefix_size(sibling) - new_prefix_size;
+
+    int node_weight = mandatory_cost_with_prefix(sizer, node, new_prefix_size);
     int tstamp_back_offset;
-    int sibling_weight = mandatory_cost(sizer, sibling, MANDATORY_TIMESTAMPS, &tstamp_back_offset);
+    int sibling_weight = mandatory_cost(sizer, sibling, mandatory_timestamps(sizer), &tstamp_back_offset);
 
-    rassert(node_weight < sibling_weight);
+    if (node_weight >= sibling_weight) {
+        // Shortening node's prefix made it as heavy as sibling.
+        return false;
+    }
 
     if (nodecmp_node_with_sib < 0) {
         // node is to the left of sibling, so we want to move elements
@@ -1058,8 +1381,8 @@ bool level(value_sizer_t<void> *sizer, int nodecmp_node_with_sib, leaf_node_t *n
             int sz = entry_size(sizer, ent) + sizeof(uint16_t) + (offset < tstamp_back_offset ? sizeof(repli_timestamp_t) : 0);
             prev_diff = sibling_weight - node_weight;
             prev_weight_movement = weight_movement;
-            weight_movement += sz;
-            node_weight += sz;
+            weight_movement += sz + growth;
+            node_weight += sz + growth;
             sibling_weight -= sz;
 
             ++num_mandatories;
@@ -1070,8 +1393,8 @@ bool level(value_sizer_t<void> *sizer, int nodecmp_node_with_sib, leaf_node_t *n
                 int sz = entry_size(sizer, ent) + sizeof(uint16_t) + sizeof(repli_timestamp_t);
                 prev_diff = sibling_weight - node_weight;
                 prev_weight_movement = weight_movement;
-                weight_movement += sz;
-                node_weight += sz;
+                weight_movement += sz + growth;
+                node_weight += sz + growth;
                 sibling_weight -= sz;
 
                 ++num_mandatories;
@@ -1099,6 +1422,10 @@ bool level(value_sizer_t<void> *sizer, int nodecmp_node_with_sib, leaf_node_t *n
         return false;
     }
 
+    if (prefix_size(node) != new_prefix_size) {
+        set_prefix(sizer, node, prefix_contents(node), new_prefix_size);
+    }
+
     int sib_copysize = weight_movement - num_mandatories * sizeof(uint16_t);
     move_elements(sizer, sibling, beg, end + 1, nodecmp_node_with_sib < 0 ? node->num_pairs : 0, node, sib_copysize, tstamp_back_offset);
 
@@ -1106,22 +1433,50 @@ bool level(value_sizer_t<void> *sizer, int nodecmp_node_with_sib, leaf_node_t *n
     guarantee(sibling->num_pairs > 0);
 
     if (nodecmp_node_with_sib < 0) {
-        keycpy(replacement_key_out, entry_key(get_entry(node, node->pair_offsets[node->num_pairs - 1])));
+        entry_full_key(node, get_entry(node, node->pair_offsets[node->num_pairs - 1]), replacement_key_out);
     } else {
-        keycpy(replacement_key_out, entry_key(get_entry(sibling, sibling->pair_offsets[sibling->num_pairs - 1])));
+        entry_full_key(sibling, get_entry(sibling, sibling->pair_offsets[sibling->num_pairs - 1]), replacement_key_out);
     }
 
     return true;
 }
 
 bool is_mergable(value_sizer_t<void> *sizer, const leaf_node_t *node, const leaf_node_t *sibling) {
-    return is_underfull(sizer, node) && is_underfull(sizer, sibling);
+    if (!(is_underfull(sizer, node) && is_underfull(sizer, sibling))) {
+        return false;
+    }
+
+    // Merging nodes with different prefixes makes their entries grow.
+    const int common = common_prefix_size(node, sibling);
+    if (common == prefix_size(node) && common == prefix_size(sibling)) {
+        return true;
+    }
+    return mandatory_cost_with_prefix(sizer, node, common)
+        + mandatory_cost_with_prefix(sizer, sibling, common) <= free_space(sizer);
 }
 
 // Sets *index_out to the index for the live entry or deletion entry
 // for the key, or to the index the key would have if it were
 // inserted.  Returns true if the key at said index is actually equal.
 bool find_key(const leaf_node_t *node, const btree_key_t *key, int *index_out) {
+    // The entries only store what comes after the prefix, so compare the key
+    // against the prefix first.
+    const int psize = prefix_size(node);
+    const uint8_t *key_contents = key->contents;
+    int key_size = key->size;
+    if (psize > 0) {
+        int res = memcmp(key_contents, prefix_contents(node), std::min<int>(key_size, psize));
+        if (res < 0 || (res == 0 && key_size < psize)) {
+            *index_out = 0;
+            return false;
+        } else if (res > 0) {
+            *index_out = node->num_pairs;
+            return false;
+        }
+        key_contents += psize;
+        key_size -= psize;
+    }
+
     int beg = 0;
     int end = node->num_pairs;
 
@@ -1134,7 +1489,7 @@ bool find_key(const leaf_node_t *node, const btree_key_t *key, int *index_out) {
 
         const btree_key_t *ek = entry_key(get_entry(node, node->pair_offsets[test_point]));
 
-        int res = sized_strcmp(key->contents, key->size, ek->contents, ek->size);
+        int res = sized_strcmp(key_contents, key_size, ek->contents, ek->size);
 
         if (res < 0) {
             // key < *test_point.
@@ -1229,11 +1584,17 @@ MUST_USE bool prepare_space_for_new_entry(value_sizer_t<void> *sizer, leaf_node_
     /* Garbage collect if appropriate. We do it after cleaning up any existing
     entry so that deletion always works no matter how full the node is. */
 
+    /* Without history, the timestamps a leaf kept from before have to go
+    before we can put untimestamped entries in front of them. */
+    const bool keep_history = sizer->leaf_history() == leaf_history_t::FULL;
+
     if (offsetof(leaf_node_t, pair_offsets) +
             sizeof(uint16_t) * (node->num_pairs + (found ? 0 : 1)) +
+            prefix_record_size(node) +
             sizeof(repli_timestamp_t) +
             new_entry_size >
-            node->frontmost) {
+            node->frontmost
+        || (!keep_history && node->frontmost < node->tstamp_cutpoint)) {
 
         if (found) {
             /* We can't re-use an existing index if we're garbage collecting. */
@@ -1241,14 +1602,14 @@ MUST_USE bool prepare_space_for_new_entry(value_sizer_t<void> *sizer, leaf_node_
             memmove(
                 node->pair_offsets + index,
                 node->pair_offsets + index + 1,
-                sizeof(uint16_t) * (node->num_pairs - index - 1));
+                sizeof(uint16_t) * (node->num_pairs - index - 1) + prefix_record_size(node));
             --node->num_pairs;
         }
 
         /* Passing `&index` as the last parameter to `garbage_collect()`
         guarantees that it will remain valid even as `pair_offsets` entries are
         moved around. */
-        garbage_collect(sizer, node, MANDATORY_TIMESTAMPS - 1, &index);
+        garbage_collect(sizer, node, std::max(mandatory_timestamps(sizer) - 1, 0), &index);
 
         /* Make sure that `index` still refers to where the new key should be
         inserted. */
@@ -1262,7 +1623,14 @@ MUST_USE bool prepare_space_for_new_entry(value_sizer_t<void> *sizer, leaf_node_
     uint16_t end_of_where_new_entry_should_go;
     bool new_entry_should_have_timestamp;
 
-    if (node->frontmost == sizer->block_size().value() ||
+    if (!keep_history) {
+        /* The node has no timestamps left, so the new entry goes in front
+        without one, right at `tstamp_cutpoint`. */
+        rassert(node->frontmost == node->tstamp_cutpoint);
+        end_of_where_new_entry_should_go = node->frontmost;
+        new_entry_should_have_timestamp = false;
+
+    } else if (node->frontmost == sizer->block_size().value() ||
             (node->frontmost < node->tstamp_cutpoint && get_timestamp(node, node->frontmost) <= tstamp)) {
         /* In the most common case, the new value will go right at
         `node->frontmost` and will get a timestamp. For performance reasons, we
@@ -1304,7 +1672,7 @@ MUST_USE bool prepare_space_for_new_entry(value_sizer_t<void> *sizer, leaf_node_
             memmove(
                 node->pair_offsets + index,
                 node->pair_offsets + index + 1,
-                sizeof(uint16_t) * (node->num_pairs - index - 1));
+                sizeof(uint16_t) * (node->num_pairs - index - 1) + prefix_record_size(node));
             --node->num_pairs;
         }
 
@@ -1320,7 +1688,7 @@ MUST_USE bool prepare_space_for_new_entry(value_sizer_t<void> *sizer, leaf_node_
         memmove(
             node->pair_offsets + index + 1,
             node->pair_offsets + index,
-            sizeof(uint16_t) * (node->num_pairs - index));
+            sizeof(uint16_t) * (node->num_pairs - index) + prefix_record_size(node));
         ++node->num_pairs;
     }
 
@@ -1351,7 +1719,7 @@ MUST_USE bool prepare_space_for_new_entry(value_sizer_t<void> *sizer, leaf_node_
     }
 
     node->frontmost -= total_space_for_new_entry;
-    rassert(offsetof(leaf_node_t, pair_offsets) + sizeof(uint16_t) * node->num_pairs <= node->frontmost);
+    rassert(header_size(node) <= node->frontmost);
 
     /* Write the timestamp if we need one, and update `node->tstamp_cutpoint` if
     we don't. */
@@ -1386,20 +1754,21 @@ void insert(value_sizer_t<void> *sizer, leaf_node_t *node, const btree_key_t *ke
 
     /* Make space for the entry itself */
 
+    const int suffix_size = key->full_size() - prefix_size(node);
+
     char *location_to_write_data;
     DEBUG_VAR bool should_write = prepare_space_for_new_entry(sizer, node,
-        key, key->full_size() + sizer->size(value), tstamp,
+        key, suffix_size + sizer->size(value), tstamp,
         true,
         &location_to_write_data);
     rassert(should_write);
 
     /* Now copy the data into the node itself */
 
-    memcpy(location_to_write_data, key, key->full_size());
-    location_to_write_data += key->full_size();
+    location_to_write_data += write_key_suffix(node, key, location_to_write_data);
     memcpy(location_to_write_data, value, sizer->size(value));
 
-    node->live_size += sizeof(uint16_t) + key->full_size() + sizer->size(value);
+    node->live_size += sizeof(uint16_t) + suffix_size + sizer->size(value);
 
     validate(sizer, node);
 }
@@ -1421,13 +1790,13 @@ void remove(value_sizer_t<void> *sizer, leaf_node_t *node, const btree_key_t *ke
     char *location_to_write_data;
     if (prepare_space_for_new_entry(sizer, node,
             key,
-            1 + key->full_size(),   /* 1 for `DELETE_ENTRY_CODE` */
+            1 + key->full_size() - prefix_size(node),   /* 1 for `DELETE_ENTRY_CODE` */
             tstamp,
             false,
             &location_to_write_data)) {
         *location_to_write_data = static_cast<char>(DELETE_ENTRY_CODE);
         ++location_to_write_data;
-        memcpy(location_to_write_data, key, key->full_size());
+        write_key_suffix(node, key, location_to_write_data);
     }
 
     validate(sizer, node);
@@ -1450,7 +1819,7 @@ void erase_presence(value_sizer_t<void> *sizer, leaf_node_t *node, const btree_k
 
         clean_entry(ent, sz);
 
-        memmove(node->pair_offsets + index, node->pair_offsets + index + 1, (node->num_pairs - (index + 1)) * sizeof(uint16_t));
+        memmove(node->pair_offsets + index, node->pair_offsets + index + 1, (node->num_pairs - (index + 1)) * sizeof(uint16_t) + prefix_record_size(node));
         node->num_pairs -= 1;
     }
 
@@ -1506,10 +1875,11 @@ void dump_entries_since_time(value_sizer_t<void> *sizer, const leaf_node_t *node
 
             const entry_t *ent = get_entry(node, iter.offset);
 
+            store_key_t buf;
             if (entry_is_live(ent)) {
-                cb->key_value(entry_key(ent), entry_value(ent), tstamp);
+                cb->key_value(full_entry_key(node, ent, &buf), entry_value(ent), tstamp);
             } else if (entry_is_deletion(ent) && include_deletions) {
-                cb->deletion(entry_key(ent), tstamp);
+                cb->deletion(full_entry_key(node, ent, &buf), tstamp);
             }
 
             iter.step(sizer, node);
@@ -1527,7 +1897,7 @@ std::pair<const btree_key_t *, const void *> iterator::operator*() const {
     guarantee(index_ < static_cast<int>(node_->num_pairs));
     guarantee(index_ >= 0);
     const entry_t *entree = get_entry(node_, node_->pair_offsets[index_]);
-    return std::make_pair(entry_key(entree), entry_value(entree));
+    return std::make_pair(full_entry_key(node_, entree, &key_), entry_value(entree));
 }
 
 iterator &iterator::operator++() {
@@ -1615,17 +1985,40 @@ leaf::iterator inclusive_lower_bound(const btree_key_t *key, const leaf_node_t &
 
 leaf::reverse_iterator inclusive_upper_bound(const btree_key_t *key, const leaf_node_t &leaf_node) {
     int index;
-    leaf::find_key(&leaf_node, key, &index);
-    if (index < leaf_node.num_pairs) {
-        const leaf::entry_t *entry = leaf::get_entry(&leaf_node, leaf_node.pair_offsets[index]);
-        const btree_key_t *ekey = leaf::entry_key(entry);
-        if (entry_is_live(entry) &&
-            sized_strcmp(ekey->contents, ekey->size, key->contents, key->size) == 0) {
-            return leaf_node_t::reverse_iterator(&leaf_node, index);
-        }
+    bool found = leaf::find_key(&leaf_node, key, &index);
+    if (found && entry_is_live(leaf::get_entry(&leaf_node, leaf_node.pair_offsets[index]))) {
+        return leaf_node_t::reverse_iterator(&leaf_node, index);
     }
 
     return ++leaf_node_t::reverse_iterator(&leaf_node, index);
 }
 
+void narrow_key_range(value_sizer_t<void> *sizer, leaf_node_t *node,
+                      const btree_key_t *left_exclusive_or_null,
+                      const btree_key_t *right_inclusive_or_null) {
+    if (left_exclusive_or_null == NULL || right_inclusive_or_null == NULL) {
+        return;
+    }
+
+    // Every key in (left, right] begins with the bytes left and right have in
+    // common.
+    int n = 0;
+    const int max_n = std::min(left_exclusive_or_null->size, right_inclusive_or_null->size);
+    while (n < max_n && left_exclusive_or_null->contents[n] == right_inclusive_or_null->contents[n]) {
+        ++n;
+    }
+    if (n <= prefix_size(node)) {
+        return;
+    }
+    rassert(key_has_prefix(node, right_inclusive_or_null));
+
+    // The prefix record itself costs space, so a node with few entries can get
+    // bigger.
+    if (mandatory_cost_with_prefix(sizer, node, n) > free_space(sizer)) {
+        return;
+    }
+
+    set_prefix(sizer, node, right_inclusive_or_null->contents, n);
+}
+
 }  // namespace leaf
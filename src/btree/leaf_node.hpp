@@ -5,11 +5,11 @@
 #include <string>
 #include <utility>
 
+#include "btree/keys.hpp"
 #include "buffer_cache/types.hpp"
 #include "errors.hpp"
 
 template <class> class value_sizer_t;
-struct btree_key_t;
 class repli_timestamp_t;
 
 // TODO: Could key_modification_proof_t not go in this file?
@@ -85,6 +85,9 @@ leaf_node_t::reverse_iterator inclusive_upper_bound(const btree_key_t *key, cons
 // deletions of 250-byte keys, we would only be required to store the
 // 2 most recent deletions and the 2 most recent timestamps.
 //
+// A sizer whose leaf_history() is leaf_history_t::NONE drops all of
+// that instead, the next time the leaf is changed.
+//
 // These parameters are in the header because some unit tests are
 // based on them.
 const int MANDATORY_TIMESTAMPS = 5;
@@ -117,16 +120,31 @@ bool fsck(value_sizer_t<void> *sizer, const btree_key_t *left_exclusive_or_null,
 
 void validate(value_sizer_t<void> *sizer, const leaf_node_t *node);
 
+// The node's magic, without the bit that marks nodes which elide a common key
+// prefix.  This is what gets compared against the value sizer's leaf magic.
+block_magic_t value_magic(const leaf_node_t *node);
+
 void init(value_sizer_t<void> *sizer, leaf_node_t *node);
 
 bool is_empty(const leaf_node_t *node);
 
 bool is_full(value_sizer_t<void> *sizer, const leaf_node_t *node, const btree_key_t *key, const void *value);
 
+// Like the above, but only lets the node take up `fill_factor` of its space.
+bool is_full(value_sizer_t<void> *sizer, const leaf_node_t *node, const btree_key_t *key, const void *value, double fill_factor);
+
 bool is_underfull(value_sizer_t<void> *sizer, const leaf_node_t *node);
 
 void split(value_sizer_t<void> *sizer, leaf_node_t *node, leaf_node_t *rnode, btree_key_t *median_out);
 
+// True if `key` sorts after every entry in the node, deletion entries included.
+bool is_past_last_key(const leaf_node_t *node, const btree_key_t *key);
+
+// Splits a node that keys are being appended to: everything stays in `node`,
+// which is left full, and `rnode` starts out empty, so that the appends don't
+// leave a trail of half full nodes behind.  The node must not be empty.
+void split_for_append(value_sizer_t<void> *sizer, leaf_node_t *node, leaf_node_t *rnode, btree_key_t *median_out);
+
 void merge(value_sizer_t<void> *sizer, leaf_node_t *left, leaf_node_t *right);
 
 bool level(value_sizer_t<void> *sizer, int nodecmp_node_with_sib, leaf_node_t *node, leaf_node_t *sibling, btree_key_t *replacement_key_out);
@@ -143,6 +161,14 @@ void remove(value_sizer_t<void> *sizer, leaf_node_t *node, const btree_key_t *ke
 
 void erase_presence(value_sizer_t<void> *sizer, leaf_node_t *node, const btree_key_t *key, key_modification_proof_t km_proof);
 
+// Tells the node that its keys are within (left_exclusive_or_null,
+// right_inclusive_or_null], so the node can stop storing the prefix all such
+// keys have in common.  Callers must not later put keys outside of that range
+// into the node, except by merging or leveling with a neighbor.
+void narrow_key_range(value_sizer_t<void> *sizer, leaf_node_t *node,
+                      const btree_key_t *left_exclusive_or_null,
+                      const btree_key_t *right_inclusive_or_null);
+
 class entry_reception_callback_t {
 public:
     /* Note: If any of these callbacks throw exceptions, then
@@ -182,6 +208,8 @@ private:
     int cmp(const iterator &other) const;
     const leaf_node_t *node_;
     int index_;
+    // Holds the key operator*() returns if the node elides a prefix.
+    mutable store_key_t key_;
 };
 
 class reverse_iterator {
@@ -12,7 +12,7 @@ const block_magic_t btree_sindex_block_t::expected_magic = { { 's', 'i', 'n', 'd
 namespace node {
 
 bool is_underfull(value_sizer_t<void> *sizer, const node_t *node) {
-    if (node->magic == sizer->btree_leaf_magic()) {
+    if (leaf::value_magic(reinterpret_cast<const leaf_node_t *>(node)) == sizer->btree_leaf_magic()) {
         return leaf::is_underfull(sizer, reinterpret_cast<const leaf_node_t *>(node));
     } else {
         rassert(is_internal(node));
@@ -21,7 +21,7 @@ bool is_underfull(value_sizer_t<void> *sizer, const node_t *node) {
 }
 
 bool is_mergable(value_sizer_t<void> *sizer, const node_t *node, const node_t *sibling, const internal_node_t *parent) {
-    if (sizer->btree_leaf_magic() == node->magic) {
+    if (sizer->btree_leaf_magic() == leaf::value_magic(reinterpret_cast<const leaf_node_t *>(node))) {
         return leaf::is_mergable(sizer, reinterpret_cast<const leaf_node_t *>(node), reinterpret_cast<const leaf_node_t *>(sibling));
     } else {
         rassert(is_internal(node));
@@ -64,7 +64,7 @@ bool level(value_sizer_t<void> *sizer, int nodecmp_node_with_sib, node_t *node,
 
 void validate(DEBUG_VAR value_sizer_t<void> *sizer, DEBUG_VAR const node_t *node) {
 #ifndef NDEBUG
-    if (node->magic == sizer->btree_leaf_magic()) {
+    if (leaf::value_magic(reinterpret_cast<const leaf_node_t *>(node)) == sizer->btree_leaf_magic()) {
         leaf::validate(sizer, reinterpret_cast<const leaf_node_t *>(node));
     } else if (node->magic == internal_node_t::expected_magic) {
         internal_node::validate(sizer->block_size(), reinterpret_cast<const internal_node_t *>(node));
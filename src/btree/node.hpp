@@ -17,12 +17,21 @@
 template <class Value>
 class value_sizer_t;
 
+// How much history for backfilling the leaves keep.  FULL keeps the timestamps
+// of the most recent entries and the most recent deletions, see
+// leaf::MANDATORY_TIMESTAMPS.  NONE keeps neither, so every touched leaf gets
+// backfilled in full, but the leaves fit more entries.  Both kinds of leaves
+// have the same format, so a btree can switch between them at any time.
+enum class leaf_history_t {
+    FULL = 0,
+    NONE = 1
+};
 
 // Class to hold common use case.
 template <>
 class value_sizer_t<void> {
 public:
-    value_sizer_t() { }
+    value_sizer_t() : leaf_history_(leaf_history_t::FULL) { }
     virtual ~value_sizer_t() { }
 
     virtual int size(const void *value) const = 0;
@@ -31,7 +40,13 @@ public:
     virtual block_magic_t btree_leaf_magic() const = 0;
     virtual block_size_t block_size() const = 0;
 
+    // The history that leaves modified through this sizer keep.
+    leaf_history_t leaf_history() const { return leaf_history_; }
+    void set_leaf_history(leaf_history_t leaf_history) { leaf_history_ = leaf_history; }
+
 private:
+    leaf_history_t leaf_history_;
+
     DISABLE_COPYING(value_sizer_t);
 };
 
@@ -49,6 +64,10 @@ struct btree_superblock_t {
 
     char metainfo_blob[METAINFO_BLOB_MAXREFLEN];
 
+    // A leaf_history_t.  Superblocks from before it existed have a zero here,
+    // which is leaf_history_t::FULL.
+    uint8_t leaf_history;
+
     static const block_magic_t expected_magic;
 } __attribute__((packed));
 
@@ -62,6 +62,20 @@ eviction_priority_t real_superblock_t::get_eviction_priority() {
     return sb_buf_.get_eviction_priority();
 }
 
+leaf_history_t real_superblock_t::get_leaf_history() const {
+    rassert(sb_buf_.is_acquired());
+    const uint8_t leaf_history = static_cast<const btree_superblock_t *>(sb_buf_.get_data_read())->leaf_history;
+    guarantee(leaf_history <= static_cast<uint8_t>(leaf_history_t::NONE),
+              "bad leaf history %u in the superblock", leaf_history);
+    return static_cast<leaf_history_t>(leaf_history);
+}
+
+void real_superblock_t::set_leaf_history(leaf_history_t leaf_history) {
+    rassert(sb_buf_.is_acquired());
+    btree_superblock_t *sb_data = static_cast<btree_superblock_t *>(sb_buf_.get_data_write());
+    sb_data->leaf_history = static_cast<uint8_t>(leaf_history);
+}
+
 
 bool find_superblock_metainfo_entry(char *beg, char *end, const std::vector<char> &key, char **verybeg_ptr_out,  uint32_t **size_ptr_out, char **beg_ptr_out, char **end_ptr_out) {
     superblock_metainfo_iterator_t::sz_t len = static_cast<superblock_metainfo_iterator_t::sz_t>(key.size());
@@ -353,11 +367,30 @@ void get_root(value_sizer_t<void> *sizer, transaction_t *txn, superblock_t* sb,
     }
 }
 
+void note_node_acquired(buf_lock_t *buf, bool loaded, btree_stats_t *stats) {
+    if (node::is_internal(static_cast<const node_t *>(buf->get_data_read()))) {
+        buf->pin_in_cache();
+        ++stats->pm_internal_node_reads;
+        if (!loaded) {
+            ++stats->pm_internal_node_hits;
+        }
+    }
+}
+
 // Split the node if necessary. If the node is a leaf_node, provide the new
 // value that will be inserted; if it's an internal node, provide NULL (we
 // split internal nodes proactively).
+bool is_last_child(const buf_lock_t *buf, const buf_lock_t *last_buf) {
+    if (!last_buf->is_acquired()) {
+        return true;
+    }
+    const internal_node_t *parent = static_cast<const internal_node_t *>(last_buf->get_data_read());
+    return internal_node::get_pair_by_index(parent, parent->npairs - 1)->lnode == buf->get_block_id();
+}
+
 void check_and_handle_split(value_sizer_t<void> *sizer, transaction_t *txn, buf_lock_t *buf, buf_lock_t *last_buf, superblock_t *sb,
-                            const btree_key_t *key, void *new_value, eviction_priority_t *root_eviction_priority) {
+                            const btree_key_t *key, void *new_value, eviction_priority_t *root_eviction_priority,
+                            bool on_right_edge) {
     txn->assert_thread();
 
     const node_t *node = static_cast<const node_t *>(buf->get_data_read());
@@ -381,10 +414,18 @@ void check_and_handle_split(value_sizer_t<void> *sizer, transaction_t *txn, buf_
     store_key_t median_buffer;
     btree_key_t *median = median_buffer.btree_key();
 
-    node::split(sizer,
-                static_cast<node_t *>(buf->get_data_write()),
-                static_cast<node_t *>(rbuf.get_data_write()),
-                median);
+    if (on_right_edge && node::is_leaf(node)
+        && leaf::is_past_last_key(reinterpret_cast<const leaf_node_t *>(node), key)) {
+        leaf::split_for_append(sizer,
+                               static_cast<leaf_node_t *>(buf->get_data_write()),
+                               static_cast<leaf_node_t *>(rbuf.get_data_write()),
+                               median);
+    } else {
+        node::split(sizer,
+                    static_cast<node_t *>(buf->get_data_write()),
+                    static_cast<node_t *>(rbuf.get_data_write()),
+                    median);
+    }
     rbuf.set_eviction_priority(buf->get_eviction_priority());
 
     // Insert the key that sets the two nodes apart into the parent.
@@ -405,6 +446,21 @@ void check_and_handle_split(value_sizer_t<void> *sizer, transaction_t *txn, buf_
                                                    buf->get_block_id(), rbuf.get_block_id());
     rassert(success, "could not insert internal btree node");
 
+    if (node::is_leaf(node)) {
+        // Now that the parent bounds both halves on each side, let them elide
+        // the key prefix their ranges have in common.
+        const internal_node_t *parent = static_cast<const internal_node_t *>(last_buf->get_data_read());
+        int index = internal_node::get_offset_index(parent, median);
+        const btree_key_t *left_bound = index > 0
+            ? &internal_node::get_pair_by_index(parent, index - 1)->key : NULL;
+        const btree_key_t *right_bound = index + 1 < parent->npairs - 1
+            ? &internal_node::get_pair_by_index(parent, index + 1)->key : NULL;
+        leaf::narrow_key_range(sizer, static_cast<leaf_node_t *>(buf->get_data_write()),
+                               left_bound, median);
+        leaf::narrow_key_range(sizer, static_cast<leaf_node_t *>(rbuf.get_data_write()),
+                               median, right_bound);
+    }
+
     // We've split the node; now figure out where the key goes and release the other buf (since we're done with it).
     if (0 >= sized_strcmp(key->contents, key->size, median->contents, median->size)) {
         // The key goes in the old buf (the left one).
@@ -420,9 +476,12 @@ void check_and_handle_split(value_sizer_t<void> *sizer, transaction_t *txn, buf_
 // Merge or level the node if necessary.
 void check_and_handle_underfull(value_sizer_t<void> *sizer, transaction_t *txn,
                                 buf_lock_t *buf, buf_lock_t *last_buf, superblock_t *sb,
-                                const btree_key_t *key) {
+                                const btree_key_t *key, bool on_right_edge) {
     const node_t *node = static_cast<const node_t *>(buf->get_data_read());
-    if (last_buf->is_acquired() && node::is_underfull(sizer, node)) { // The root node is never underfull.
+    // The root node is never underfull, and neither is the last leaf, which
+    // appends leave nearly empty on purpose (see leaf::split_for_append()).
+    if (last_buf->is_acquired() && !(on_right_edge && node::is_leaf(node))
+        && node::is_underfull(sizer, node)) {
 
         const internal_node_t *parent_node = static_cast<const internal_node_t *>(last_buf->get_data_read());
 
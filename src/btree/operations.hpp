@@ -42,6 +42,9 @@ public:
     virtual void set_eviction_priority(eviction_priority_t eviction_priority) = 0;
     virtual eviction_priority_t get_eviction_priority() = 0;
 
+    virtual leaf_history_t get_leaf_history() const = 0;
+    virtual void set_leaf_history(leaf_history_t leaf_history) = 0;
+
 private:
     DISABLE_COPYING(superblock_t);
 };
@@ -67,6 +70,9 @@ public:
     void set_eviction_priority(eviction_priority_t eviction_priority);
     eviction_priority_t get_eviction_priority();
 
+    leaf_history_t get_leaf_history() const;
+    void set_leaf_history(leaf_history_t leaf_history);
+
 private:
     buf_lock_t sb_buf_;
 };
@@ -81,6 +87,7 @@ class keyvalue_location_t {
 public:
     keyvalue_location_t()
         : superblock(NULL), pass_back_superblock(NULL),
+          leaf_history(leaf_history_t::FULL), last_buf_on_right_edge(false),
           there_originally_was_value(false), stat_block(NULL_BLOCK_ID),
           stats(NULL) { }
 
@@ -94,8 +101,14 @@ public:
 
     promise_t<superblock_t *> *pass_back_superblock;
 
+    // The superblock's leaf history, which stays known after the superblock is
+    // released.
+    leaf_history_t leaf_history;
+
     // The parent buf of buf, if buf is not the root node.  This is hacky.
     buf_lock_t last_buf;
+    // True if last_buf's node is the last one at its level, or if buf is the root.
+    bool last_buf_on_right_edge;
 
     // The buf owning the leaf node which contains the value.
     buf_lock_t buf;
@@ -107,8 +120,10 @@ public:
 
     void swap(keyvalue_location_t& other) {
         std::swap(superblock, other.superblock);
+        std::swap(leaf_history, other.leaf_history);
         std::swap(stat_block, other.stat_block);
         last_buf.swap(other.last_buf);
+        std::swap(last_buf_on_right_edge, other.last_buf_on_right_edge);
         buf.swap(other.buf);
         std::swap(there_originally_was_value, other.there_originally_was_value);
         std::swap(stats, other.stats);
@@ -203,12 +218,24 @@ private:
 
 void get_root(value_sizer_t<void> *sizer, transaction_t *txn, superblock_t* sb, buf_lock_t *buf_out, eviction_priority_t root_eviction_priority);
 
+/* Called for every node a lookup acquires on its way down to a key, with whether
+the cache had to load it.  Pins the internal nodes in the cache and counts how
+many of them were in it. */
+void note_node_acquired(buf_lock_t *buf, bool loaded, btree_stats_t *stats);
+
+// True if buf's node is the root or the last child of last_buf's node.
+bool is_last_child(const buf_lock_t *buf, const buf_lock_t *last_buf);
+
+// `on_right_edge` says whether buf's node is the last one at its level of the
+// tree.  A leaf there that gets a key past its last one appended is split with
+// leaf::split_for_append(), and is never considered underfull.
 void check_and_handle_split(value_sizer_t<void> *sizer, transaction_t *txn, buf_lock_t *buf, buf_lock_t *last_buf, superblock_t *sb,
-                            const btree_key_t *key, void *new_value, eviction_priority_t *root_eviction_priority);
+                            const btree_key_t *key, void *new_value, eviction_priority_t *root_eviction_priority,
+                            bool on_right_edge);
 
 void check_and_handle_underfull(value_sizer_t<void> *sizer, transaction_t *txn,
                                 buf_lock_t *buf, buf_lock_t *last_buf, superblock_t *sb,
-                                const btree_key_t *key);
+                                const btree_key_t *key, bool on_right_edge);
 
 // Metainfo functions
 bool get_superblock_metainfo(transaction_t *txn, buf_lock_t *superblock, const std::vector<char> &key, std::vector<char> *value_out);
@@ -34,9 +34,11 @@ void find_keyvalue_location_for_write(
         profile::trace_t *trace,
         promise_t<superblock_t *> *pass_back_superblock = NULL) {
     value_sizer_t<Value> sizer(txn->get_cache()->get_block_size());
+    sizer.set_leaf_history(superblock->get_leaf_history());
 
     keyvalue_location_out->superblock = superblock;
     keyvalue_location_out->pass_back_superblock = pass_back_superblock;
+    keyvalue_location_out->leaf_history = sizer.leaf_history();
 
     ensure_stat_block(txn, superblock, incr_priority(ZERO_EVICTION_PRIORITY));
     keyvalue_location_out->stat_block = keyvalue_location_out->superblock->get_stat_block_id();
@@ -47,28 +49,41 @@ void find_keyvalue_location_for_write(
     buf_lock_t buf;
     {
         profile::starter_t starter("Acquiring block for write.\n", trace);
+        const int64_t block_loads = txn->get_block_loads();
         get_root(&sizer, txn, superblock, &buf, *root_eviction_priority);
+        note_node_acquired(&buf, txn->get_block_loads() != block_loads, stats);
     }
+    // Whether last_buf's node is the last one at its level (or there's none).
+    bool last_buf_on_right_edge = true;
 
     // Walk down the tree to the leaf.
     while (node::is_internal(reinterpret_cast<const node_t *>(buf.get_data_read()))) {
         // Check if the node is overfull and proactively split it if it is (since this is an internal node).
         {
             profile::starter_t starter("Perhaps split node.", trace);
-            check_and_handle_split(&sizer, txn, &buf, &last_buf, superblock, key, reinterpret_cast<Value *>(NULL), root_eviction_priority);
+            check_and_handle_split(&sizer, txn, &buf, &last_buf, superblock, key, reinterpret_cast<Value *>(NULL), root_eviction_priority,
+                                   last_buf_on_right_edge && is_last_child(&buf, &last_buf));
         }
 
         // Check if the node is underfull, and merge/level if it is.
         {
             profile::starter_t starter("Perhaps merge nodes.", trace);
-            check_and_handle_underfull(&sizer, txn, &buf, &last_buf, superblock, key);
+            check_and_handle_underfull(&sizer, txn, &buf, &last_buf, superblock, key,
+                                       last_buf_on_right_edge && is_last_child(&buf, &last_buf));
         }
+        const bool buf_on_right_edge = last_buf_on_right_edge && is_last_child(&buf, &last_buf);
 
         // Release the superblock, if we've gone past the root (and haven't
         // already released it). If we're still at the root or at one of
         // its direct children, we might still want to replace the root, so
-        // we can't release the superblock yet.
-        if (last_buf.is_acquired() && keyvalue_location_out->superblock) {
+        // we can't release the superblock yet -- unless the root has more
+        // than two children.  We've split it above if it was full, and a merge
+        // of two of its children still leaves it with at least two, so then
+        // this write can't replace it and the next one can have the superblock
+        // while we acquire the root's child.
+        const bool root_is_settled = last_buf.is_acquired()
+            || !internal_node::is_singleton(reinterpret_cast<const internal_node_t *>(buf.get_data_read()));
+        if (root_is_settled && keyvalue_location_out->superblock) {
             if (pass_back_superblock) {
                 pass_back_superblock->pulse(superblock);
                 keyvalue_location_out->superblock = NULL;
@@ -87,10 +102,13 @@ void find_keyvalue_location_for_write(
 
         {
             profile::starter_t starter("Acquiring block for write.\n", trace);
+            const int64_t block_loads = txn->get_block_loads();
             buf_lock_t tmp(txn, node_id, rwi_write);
             tmp.set_eviction_priority(incr_priority(buf.get_eviction_priority()));
+            note_node_acquired(&tmp, txn->get_block_loads() != block_loads, stats);
             last_buf.swap(tmp);
             buf.swap(last_buf);
+            last_buf_on_right_edge = buf_on_right_edge;
         }
     }
 
@@ -107,6 +125,7 @@ void find_keyvalue_location_for_write(
     }
 
     keyvalue_location_out->last_buf.swap(last_buf);
+    keyvalue_location_out->last_buf_on_right_edge = last_buf_on_right_edge;
     keyvalue_location_out->buf.swap(buf);
 }
 
@@ -128,11 +147,35 @@ void find_keyvalue_location_for_read(
         return;
     }
 
+    // Go down the internal nodes that are in the cache and aren't being written
+    // without locking them, and only lock the node we stop at.  Nothing yields in
+    // between, so the nodes can't change under us, and a writer that's waiting for
+    // the node we stop at holds its parent for write, so it can't get ahead of us.
+    block_id_t root_id = node_id;
+    for (;;) {
+        const node_t *node = static_cast<const node_t *>(txn->peek(node_id));
+        if (node == NULL || !node::is_internal(node)) {
+            break;
+        }
+        block_id_t child_id = internal_node::lookup(reinterpret_cast<const internal_node_t *>(node), key);
+        rassert(child_id != NULL_BLOCK_ID && child_id != SUPERBLOCK_ID);
+        if (txn->peek(child_id) == NULL) {
+            break;
+        }
+        ++stats->pm_internal_node_reads;
+        ++stats->pm_internal_node_hits;
+        node_id = child_id;
+    }
+
     buf_lock_t buf;
     {
         profile::starter_t starter("Acquire a block for read.", trace);
+        const int64_t block_loads = txn->get_block_loads();
         buf_lock_t tmp(txn, node_id, rwi_read);
-        tmp.set_eviction_priority(root_eviction_priority);
+        if (node_id == root_id) {
+            tmp.set_eviction_priority(root_eviction_priority);
+        }
+        note_node_acquired(&tmp, txn->get_block_loads() != block_loads, stats);
         buf.swap(tmp);
     }
 
@@ -143,13 +186,15 @@ void find_keyvalue_location_for_read(
 #endif  // NDEBUG
 
     while (node::is_internal(reinterpret_cast<const node_t *>(buf.get_data_read()))) {
-        node_id = internal_node::lookup(reinterpret_cast<const internal_node_t *>(buf.get_data_read()), key);
+        node_id = internal_node::lookup(&buf, key);
         rassert(node_id != NULL_BLOCK_ID && node_id != SUPERBLOCK_ID);
 
         {
             profile::starter_t starter("Acquire a block for read.", trace);
+            const int64_t block_loads = txn->get_block_loads();
             buf_lock_t tmp(txn, node_id, rwi_read);
             tmp.set_eviction_priority(incr_priority(buf.get_eviction_priority()));
+            note_node_acquired(&tmp, txn->get_block_loads() != block_loads, stats);
             buf.swap(tmp);
         }
 
@@ -171,6 +216,7 @@ void find_keyvalue_location_for_read(
 template <class Value>
 void apply_keyvalue_change(transaction_t *txn, keyvalue_location_t<Value> *kv_loc, const btree_key_t *key, repli_timestamp_t tstamp, bool expired, key_modification_callback_t<Value> *km_callback, eviction_priority_t *root_eviction_priority) {
     value_sizer_t<Value> sizer(txn->get_cache()->get_block_size());
+    sizer.set_leaf_history(kv_loc->leaf_history);
 
     key_modification_proof_t km_proof = km_callback->value_modification(txn, kv_loc, key);
 
@@ -185,7 +231,8 @@ void apply_keyvalue_change(transaction_t *txn, keyvalue_location_t<Value> *kv_lo
         // for the value.  Not necessary when deleting, because the
         // node won't grow.
 
-        check_and_handle_split(&sizer, txn, &kv_loc->buf, &kv_loc->last_buf, kv_loc->superblock, key, kv_loc->value.get(), root_eviction_priority);
+        check_and_handle_split(&sizer, txn, &kv_loc->buf, &kv_loc->last_buf, kv_loc->superblock, key, kv_loc->value.get(), root_eviction_priority,
+                               kv_loc->last_buf_on_right_edge && is_last_child(&kv_loc->buf, &kv_loc->last_buf));
 
         rassert(!leaf::is_full(&sizer, reinterpret_cast<const leaf_node_t *>(kv_loc->buf.get_data_read()),
                 key, kv_loc->value.get()));
@@ -233,7 +280,8 @@ void apply_keyvalue_change(transaction_t *txn, keyvalue_location_t<Value> *kv_lo
 
     // Check to see if the leaf is underfull (following a change in
     // size or a deletion, and merge/level if it is.
-    check_and_handle_underfull(&sizer, txn, &kv_loc->buf, &kv_loc->last_buf, kv_loc->superblock, key);
+    check_and_handle_underfull(&sizer, txn, &kv_loc->buf, &kv_loc->last_buf, kv_loc->superblock, key,
+                               kv_loc->last_buf_on_right_edge && is_last_child(&kv_loc->buf, &kv_loc->last_buf));
 
     //Modify the stats block
     buf_lock_t stat_block(txn, kv_loc->stat_block, rwi_write, buffer_cache_order_mode_ignore);
@@ -1,6 +1,8 @@
 // Copyright 2010-2012 RethinkDB, all rights reserved.
 #include "btree/parallel_traversal.hpp"
 
+#include <algorithm>
+
 #include "errors.hpp"
 #include <boost/bind.hpp>
 
@@ -84,6 +86,7 @@ public:
           helper(_helper),
           interruptor(_interruptor),
           interrupted(false),
+          leaf_level(-1),
           coro_pool(4, &pending_acquires, this)
     {
         interruptor_watcher.parent = this;
@@ -116,6 +119,10 @@ public:
     bool interrupted;
     cond_t finished_cond;
 
+    // The level of the leaves, or -1 until we got to the first one.  All the
+    // leaves of a btree are on the same level.
+    int leaf_level;
+
     // The number of pending + acquired blocks, by level.
     std::vector<int64_t> level_counts;
 
@@ -263,6 +270,9 @@ struct acquire_a_node_fsm_t : public acquisition_waiter_callback_t {
 
     void you_may_acquire() {
 
+        if (level == state->leaf_level && state->helper->leaves_accessed_once()) {
+            state->transaction_ptr->set_next_access_hint(CACHE_ACCESS_HINT_ONCE);
+        }
         scoped_ptr_t<buf_lock_t> block(new buf_lock_t(state->transaction_ptr,
                                                       block_id, state->helper->btree_node_mode(),
                                                       buffer_cache_order_mode_check,
@@ -464,6 +474,7 @@ void process_a_leaf_node(traversal_state_t *state, scoped_ptr_t<buf_lock_t> *buf
     //
     //
     int population_change = 0;
+    state->leaf_level = level;
 
     try {
         state->helper->process_a_leaf(state->transaction_ptr, buf->get(), left_exclusive_or_null, right_inclusive_or_null, state->interruptor, &population_change);
@@ -635,3 +646,36 @@ progress_completion_fraction_t parallel_traversal_progress_t::guess_completion()
     return progress_completion_fraction_t(total_released_nodes, estimate_of_total_nodes);
 }
 
+void split_key_range_at_root(transaction_t *txn, superblock_t *superblock,
+                             const key_range_t &key_range, int max_parts,
+                             std::vector<key_range_t> *ranges_out) {
+    std::vector<store_key_t> splits;
+    const block_id_t root_id = superblock->get_root_block_id();
+    if (max_parts > 1 && root_id != NULL_BLOCK_ID) {
+        buf_lock_t root(txn, root_id, rwi_read);
+        const node_t *node = static_cast<const node_t *>(root.get_data_read());
+        if (node::is_internal(node)) {
+            const internal_node_t *internal = reinterpret_cast<const internal_node_t *>(node);
+            // The last pair has no key.
+            std::vector<store_key_t> keys;
+            for (int i = 0; i < internal->npairs - 1; ++i) {
+                store_key_t key(&internal_node::get_pair_by_index(internal, i)->key);
+                if (key_range.contains_key(key)) {
+                    keys.push_back(key);
+                }
+            }
+            const size_t num_parts = std::min<size_t>(max_parts, keys.size() + 1);
+            for (size_t i = 1; i < num_parts; ++i) {
+                splits.push_back(keys[i * keys.size() / num_parts]);
+            }
+        }
+    }
+
+    for (size_t i = 0; i <= splits.size(); ++i) {
+        key_range_t part(i == 0 ? key_range_t::none : key_range_t::open,
+                         i == 0 ? store_key_t() : splits[i - 1],
+                         i == splits.size() ? key_range_t::none : key_range_t::closed,
+                         i == splits.size() ? store_key_t() : splits[i]);
+        ranges_out->push_back(part.intersection(key_range));
+    }
+}
@@ -20,6 +20,7 @@ class traversal_state_t;
 class parent_releaser_t;
 class btree_slice_t;
 struct btree_key_t;
+struct key_range_t;
 struct internal_node_t;
 class superblock_t;
 
@@ -120,6 +121,10 @@ struct btree_traversal_helper_t {
     virtual access_t btree_superblock_mode() = 0;
     virtual access_t btree_node_mode() = 0;
 
+    // If true, the leaves are acquired with CACHE_ACCESS_HINT_ONCE once we know
+    // which level they're on.  The superblock and the internal nodes keep the
+    // transaction's hint.
+    virtual bool leaves_accessed_once() { return false; }
 
     virtual ~btree_traversal_helper_t() { }
 
@@ -134,6 +139,13 @@ void btree_parallel_traversal(transaction_t *txn,
         bool release_superblock = true)
         THROWS_ONLY(interrupted_exc_t);
 
+// Splits `key_range` at up to `max_parts - 1` of the keys in the root node, so that
+// concurrent traversals of the parts each get about as many of the root's
+// subtrees.  Gives just `key_range` if the root is a leaf.
+void split_key_range_at_root(transaction_t *txn, superblock_t *superblock,
+                             const key_range_t &key_range, int max_parts,
+                             std::vector<key_range_t> *ranges_out);
+
 
 class parallel_traversal_progress_t : public traversal_progress_t {
 public:
@@ -27,6 +27,12 @@ public:
               &pm_keys_read, "keys_read",
               &pm_keys_set, "keys_set",
               &pm_keys_expired, "keys_expired",
+              NULLPTR),
+          pm_internal_node_hit_ratio(&pm_internal_node_hits, &pm_internal_node_reads),
+          pm_internal_nodes_membership(&btree_collection,
+              &pm_internal_node_reads, "internal_node_reads",
+              &pm_internal_node_hits, "internal_node_hits",
+              &pm_internal_node_hit_ratio, "internal_node_hit_ratio",
               NULLPTR)
     { }
 
@@ -37,6 +43,13 @@ public:
         pm_keys_set,
         pm_keys_expired;
     perfmon_multi_membership_t pm_keys_membership;
+
+    // How many of the internal nodes that lookups went through were in the cache.
+    perfmon_counter_t
+        pm_internal_node_reads,
+        pm_internal_node_hits;
+    perfmon_counter_ratio_t pm_internal_node_hit_ratio;
+    perfmon_multi_membership_t pm_internal_nodes_membership;
 };
 
 /* btree_slice_t is a thin wrapper around cache_t that handles initializing the buffer
@@ -50,6 +50,14 @@ public:
         return sub_superblock->get_eviction_priority();
     }
 
+    leaf_history_t get_leaf_history() const {
+        return sub_superblock->get_leaf_history();
+    }
+
+    void set_leaf_history(leaf_history_t leaf_history) {
+        sub_superblock->set_leaf_history(leaf_history);
+    }
+
 private:
     superblock_t *sub_superblock;
     int refcount;
@@ -2,6 +2,8 @@
 #include "buffer_cache/blob.hpp"
 
 #include <limits>
+#include <utility>
+#include <vector>
 
 #include "buffer_cache/buffer_cache.hpp"
 #include "serializer/types.hpp"
@@ -336,7 +338,24 @@ temporary_acq_tree_node_t *make_tree_from_block_ids(transaction_t *txn, access_t
 
     filler.nodes = new temporary_acq_tree_node_t[filler.hi - filler.lo];
 
-    pmap(filler.hi - filler.lo, filler);
+    // Blocks of the same blob usually get written together and sit next to each
+    // other on disk, so we ask for all of them at once and let the serializer
+    // merge the reads, instead of reading them one by one.
+    if (filler.hi - filler.lo > 1) {
+        std::vector<block_id_t> ids(block_ids + filler.lo, block_ids + filler.hi);
+        txn->prefetch(ids);
+    }
+
+    if (levels == 1) {
+        // The prefetch has all the leaves loading at once already, so acquiring
+        // them one after another takes no longer than the slowest read, and it
+        // doesn't cost a coroutine for every leaf of a large value.
+        for (int i = 0; i < filler.hi - filler.lo; ++i) {
+            filler(i);
+        }
+    } else {
+        pmap(filler.hi - filler.lo, filler);
+    }
 
     return filler.nodes;
 }
@@ -513,6 +532,53 @@ void blob_t::write_from_string(const std::string &val, transaction_t *txn, int64
     buffer_group_copy_data(&dest, const_view(&src));
 }
 
+int64_t blob_t::overwrite_changed_bytes(const std::string &val, transaction_t *txn) {
+    guarantee(static_cast<int64_t>(val.size()) == valuesize());
+
+    // The buffers of a large blob each lie in one leaf, so we collect the span of
+    // changed bytes of each of them.  We have to release the read locks before
+    // we can acquire the leaves for write.
+    std::vector<std::pair<int64_t, int64_t> > spans;
+    {
+        buffer_group_t group;
+        blob_acq_t acq;
+        expose_all(txn, rwi_read, &group, &acq);
+        int64_t offset = 0;
+        for (size_t i = 0; i < group.num_buffers(); ++i) {
+            buffer_group_t::buffer_t buffer = group.get_buffer(i);
+            const char *data = static_cast<const char *>(buffer.data);
+            const char *expected = val.data() + offset;
+            int64_t first = 0;
+            while (first < buffer.size && data[first] == expected[first]) {
+                ++first;
+            }
+            if (first < buffer.size) {
+                int64_t last = buffer.size;
+                while (data[last - 1] == expected[last - 1]) {
+                    --last;
+                }
+                spans.push_back(std::make_pair(offset + first, last - first));
+            }
+            offset += buffer.size;
+        }
+        rassert(offset == static_cast<int64_t>(val.size()));
+    }
+
+    // All the changed leaves are held until they are all written, so that
+    // nobody sees some of the changes without the others.
+    buffer_group_t dest;
+    buffer_group_t src;
+    blob_acq_t acq;
+    int64_t rewritten = 0;
+    for (auto it = spans.begin(); it != spans.end(); ++it) {
+        expose_region(txn, rwi_write, it->first, it->second, &dest, &acq);
+        src.add_buffer(it->second, val.data() + it->first);
+        rewritten += it->second;
+    }
+    buffer_group_copy_data(&dest, const_view(&src));
+    return rewritten;
+}
+
 namespace blob {
 
 struct traverse_helper_t {
@@ -185,6 +185,12 @@ public:
     // sure this portion of the blob exists
     void write_from_string(const std::string &val, transaction_t *txn, int64_t offset);
 
+    // Makes the contents of the blob be val, which must be exactly as long as the
+    // blob already is.  Only the leaves whose bytes differ get acquired for write
+    // (so only they get written back), which makes small changes to a large value
+    // cheap.  Returns the number of bytes it rewrote.
+    int64_t overwrite_changed_bytes(const std::string &val, transaction_t *txn);
+
 private:
     bool traverse_to_dimensions(transaction_t *txn, int levels, int64_t old_offset, int64_t old_size, int64_t new_offset, int64_t new_size, blob::traverse_helper_t *helper);
     bool allocate_to_dimensions(transaction_t *txn, int levels, int64_t new_offset, int64_t new_size);
@@ -0,0 +1,106 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#define __STDC_FORMAT_MACROS
+#include "buffer_cache/mirrored/compressed_tier.hpp"
+
+#include <inttypes.h>
+
+#include "buffer_cache/mirrored/stats.hpp"
+#include "compression.hpp"
+#include "config/args.hpp"
+
+class compressed_tier_t::entry_t : public intrusive_list_node_t<entry_t> {
+public:
+    entry_t(block_id_t _block_id, block_size_t _block_size,
+            const counted_t<standard_block_token_t> &_token,
+            repli_timestamp_t _recency, const char *compressed, size_t compressed_size)
+        : block_id(_block_id), block_size(_block_size), token(_token), recency(_recency),
+          data(compressed_size) {
+        memcpy(data.data(), compressed, compressed_size);
+    }
+
+    const block_id_t block_id;
+    const block_size_t block_size;
+    const counted_t<standard_block_token_t> token;
+    const repli_timestamp_t recency;
+    scoped_array_t<char> data;
+
+private:
+    DISABLE_COPYING(entry_t);
+};
+
+compressed_tier_t::compressed_tier_t(int64_t _max_bytes, mc_cache_stats_t *_stats)
+    : max_bytes(_max_bytes), used_bytes(0), stats(_stats) { }
+
+compressed_tier_t::~compressed_tier_t() {
+    while (entry_t *entry = insertion_order.head()) {
+        remove_entry(entry);
+    }
+}
+
+void compressed_tier_t::insert(block_id_t block_id, const ser_buffer_t *buf,
+                               block_size_t block_size,
+                               const counted_t<standard_block_token_t> &token,
+                               repli_timestamp_t recency) {
+    discard(block_id);
+
+    const size_t size = block_size.ser_value();
+    // Only keep blocks that save a worthwhile amount of memory.
+    const size_t max_compressed_size = size * COMPRESSED_TIER_MAX_COMPRESSION_RATIO;
+    if (compression_buffer.size() < max_compressed_size) {
+        compression_buffer.reset();
+        compression_buffer.init(max_compressed_size);
+    }
+    const size_t compressed_size = lz_compress(reinterpret_cast<const char *>(buf), size,
+                                               compression_buffer.data(), max_compressed_size);
+    if (compressed_size == 0 || static_cast<int64_t>(compressed_size) > max_bytes) {
+        ++stats->pm_compressed_tier_rejected;
+        return;
+    }
+
+    while (used_bytes + static_cast<int64_t>(compressed_size) > max_bytes) {
+        remove_entry(insertion_order.head());
+    }
+
+    entry_t *entry = new entry_t(block_id, block_size, token, recency,
+                                 compression_buffer.data(), compressed_size);
+    entries.set(block_id, entry);
+    insertion_order.push_back(entry);
+    used_bytes += compressed_size;
+    ++stats->pm_compressed_tier_blocks;
+    stats->pm_compressed_tier_bytes += compressed_size;
+}
+
+bool compressed_tier_t::take(block_id_t block_id, ser_buffer_t *buf_out,
+                             counted_t<standard_block_token_t> *token_out,
+                             repli_timestamp_t *recency_out) {
+    entry_t *entry = entries.get(block_id);
+    if (entry == NULL) {
+        return false;
+    }
+
+    const bool res = lz_decompress(entry->data.data(), entry->data.size(),
+                                   reinterpret_cast<char *>(buf_out),
+                                   entry->block_size.ser_value());
+    guarantee(res, "Corrupted block %" PRIu64 " in the compressed tier", block_id);
+    *token_out = entry->token;
+    *recency_out = entry->recency;
+    remove_entry(entry);
+    ++stats->pm_compressed_tier_hits;
+    return true;
+}
+
+void compressed_tier_t::discard(block_id_t block_id) {
+    entry_t *entry = entries.get(block_id);
+    if (entry != NULL) {
+        remove_entry(entry);
+    }
+}
+
+void compressed_tier_t::remove_entry(entry_t *entry) {
+    entries.set(entry->block_id, NULL);
+    insertion_order.remove(entry);
+    used_bytes -= entry->data.size();
+    --stats->pm_compressed_tier_blocks;
+    stats->pm_compressed_tier_bytes -= entry->data.size();
+    delete entry;
+}
@@ -0,0 +1,65 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#ifndef BUFFER_CACHE_MIRRORED_COMPRESSED_TIER_HPP_
+#define BUFFER_CACHE_MIRRORED_COMPRESSED_TIER_HPP_
+
+#include "containers/counted.hpp"
+#include "containers/intrusive_list.hpp"
+#include "containers/scoped.hpp"
+#include "containers/two_level_array.hpp"
+#include "repli_timestamp.hpp"
+#include "serializer/types.hpp"
+
+struct mc_cache_stats_t;
+
+/* The compressed tier sits between the buffer cache and the serializer. When a
+clean mc_inner_buf_t gets evicted, its block is compressed and kept here. If the
+cache needs the block again, it gets decompressed from here instead of being read
+back from disk.
+
+A block is in the compressed tier only as long as there is no mc_inner_buf_t for
+it in the cache, so the two can never disagree about a block's contents. Once
+`max_bytes` of compressed data are used up, the blocks that went into the tier
+first get dropped first. */
+
+class compressed_tier_t {
+public:
+    compressed_tier_t(int64_t max_bytes, mc_cache_stats_t *stats);
+    ~compressed_tier_t();
+
+    // Stores a compressed copy of the first `block_size.ser_value()` bytes of
+    // `buf`. Blocks that don't compress well enough are not stored.
+    void insert(block_id_t block_id, const ser_buffer_t *buf, block_size_t block_size,
+                const counted_t<standard_block_token_t> &token,
+                repli_timestamp_t recency);
+
+    // If the tier has the block, decompresses it into `buf_out`, removes it from
+    // the tier and returns true.
+    bool take(block_id_t block_id, ser_buffer_t *buf_out,
+              counted_t<standard_block_token_t> *token_out,
+              repli_timestamp_t *recency_out);
+
+    // Drops the block from the tier if it is there.
+    void discard(block_id_t block_id);
+
+private:
+    class entry_t;
+
+    void remove_entry(entry_t *entry);
+
+    const int64_t max_bytes;
+    int64_t used_bytes;
+
+    mc_cache_stats_t *stats;
+
+    two_level_array_t<entry_t *> entries;
+
+    // Oldest entries are at the front.
+    intrusive_list_t<entry_t> insertion_order;
+
+    // A scratch buffer for the compressor.
+    scoped_array_t<char> compression_buffer;
+
+    DISABLE_COPYING(compressed_tier_t);
+};
+
+#endif  // BUFFER_CACHE_MIRRORED_COMPRESSED_TIER_HPP_
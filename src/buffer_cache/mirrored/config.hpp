@@ -8,6 +8,14 @@
 
 #define NEVER_FLUSH (-1)
 
+// Which page replacement policy a cache uses to pick bufs for eviction.
+enum page_repl_policy_t {
+    // Evicts random bufs, see page_repl_random.hpp.
+    PAGE_REPL_POLICY_RANDOM,
+    // Recency and frequency aware, scan-resistant, see page_repl_clock.hpp.
+    PAGE_REPL_POLICY_CLOCK
+};
+
 /* Configuration for the cache (it can all change from run to run) */
 
 struct mirrored_cache_config_t {
@@ -20,6 +28,12 @@ struct mirrored_cache_config_t {
         max_concurrent_flushes = DEFAULT_MAX_CONCURRENT_FLUSHES;
         io_priority_reads = CACHE_READS_IO_PRIORITY;
         io_priority_writes = CACHE_WRITES_IO_PRIORITY;
+        page_repl_policy = DEFAULT_PAGE_REPL_POLICY;
+        pinned_fraction = DEFAULT_CACHE_PINNED_FRACTION;
+        compressed_tier_size = 0;
+        use_memory_broker = false;
+        use_dirty_budget = false;
+        adaptive_flush = false;
     }
 
     // Max amount of memory that will be used for the cache, in bytes.
@@ -49,6 +63,33 @@ struct mirrored_cache_config_t {
     int io_priority_reads;
     int io_priority_writes;
 
+    // The policy used for choosing which bufs to evict when the cache is full.
+    // Like the fields below it, it's picked by whoever creates the cache, and isn't
+    // serialized, so that the format stays the same.
+    page_repl_policy_t page_repl_policy;
+
+    // The fraction of the cache that can be taken up by the internal nodes the
+    // btrees pin, which are never evicted.  0 disables pinning.
+    double pinned_fraction;
+
+    // How much of max_size (in bytes) is used for keeping compressed copies of
+    // evicted blocks in memory. 0 disables the compressed tier.
+    int64_t compressed_tier_size;
+
+    // If true, the cache registers with the global memory broker, which moves
+    // memory between the caches of the process depending on their miss rates.
+    // max_size (minus compressed_tier_size) is then only the cache's starting size.
+    bool use_memory_broker;
+
+    // If true, the cache's dirty data counts against the node-wide dirty budget,
+    // which slows down the writers of caches that use more than their share of it.
+    bool use_dirty_budget;
+
+    // If true, hard durability commits are grouped into flushes depending on how
+    // long flushes take, and flush_timer_ms gets stretched when the disk is
+    // saturated. Otherwise every hard durability commit starts a flush right away.
+    bool adaptive_flush;
+
     void rdb_serialize(write_message_t &msg /* NOLINT */) const {
         msg << max_size;
         msg << flush_timer_ms;
@@ -0,0 +1,67 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "buffer_cache/mirrored/dirty_budget.hpp"
+
+#include <algorithm>
+
+#include "config/args.hpp"
+
+dirty_budget_t::registration_t::registration_t(dirty_budget_t *_budget,
+                                               int64_t _max_dirty_size)
+    : budget(_budget), max_dirty_size(_max_dirty_size), dirty_size(0) {
+    guarantee(max_dirty_size >= 0);
+    spinlock_acq_t acq(&budget->lock);
+    budget->registrations.push_back(this);
+    budget->total_max_dirty_size += max_dirty_size;
+    budget->recompute_budget_size();
+}
+
+dirty_budget_t::registration_t::~registration_t() {
+    spinlock_acq_t acq(&budget->lock);
+    budget->registrations.remove(this);
+    budget->total_max_dirty_size -= max_dirty_size;
+    budget->total_dirty_size -= dirty_size;
+    budget->recompute_budget_size();
+}
+
+double dirty_budget_t::registration_t::report_dirty_size(int64_t _dirty_size) {
+    rassert(_dirty_size >= 0);
+    spinlock_acq_t acq(&budget->lock);
+    budget->total_dirty_size += _dirty_size - dirty_size;
+    dirty_size = _dirty_size;
+
+    if (budget->budget_size == 0) {
+        return 0;
+    }
+    const double fair_share = static_cast<double>(budget->budget_size) * max_dirty_size
+        / budget->total_max_dirty_size;
+    if (dirty_size <= fair_share) {
+        return 0;
+    }
+    const double start = budget->budget_size * WRITEBACK_BACKPRESSURE_START_FRACTION;
+    if (budget->total_dirty_size <= start) {
+        return 0;
+    }
+    return std::min(1.0, (budget->total_dirty_size - start) / (budget->budget_size - start));
+}
+
+dirty_budget_t::dirty_budget_t()
+    : total_max_dirty_size(0), total_dirty_size(0), budget_size(0) { }
+
+dirty_budget_t::~dirty_budget_t() {
+    rassert(registrations.empty());
+}
+
+void dirty_budget_t::recompute_budget_size() {
+    int64_t largest = 0;
+    for (registration_t *r = registrations.head(); r != NULL; r = registrations.next(r)) {
+        largest = std::max(largest, r->max_dirty_size);
+    }
+    budget_size = std::max(largest, static_cast<int64_t>(total_max_dirty_size
+                                                         * WRITEBACK_NODE_DIRTY_BUDGET_FRACTION));
+}
+
+dirty_budget_t *get_global_dirty_budget() {
+    // See get_global_perfmon_collection() for why this is a function.
+    static dirty_budget_t budget;
+    return &budget;
+}
@@ -0,0 +1,65 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#ifndef BUFFER_CACHE_MIRRORED_DIRTY_BUDGET_HPP_
+#define BUFFER_CACHE_MIRRORED_DIRTY_BUDGET_HPP_
+
+#include <stdint.h>
+
+#include "arch/spinlock.hpp"
+#include "containers/intrusive_list.hpp"
+#include "errors.hpp"
+
+/* The dirty budget limits how much unwritten data all the caches of a process
+may hold together, so that one cache that takes a lot of writes (for example a
+bulk import) can't use up all of the flush bandwidth of the node.
+
+Every participating cache registers with its own dirty data limit. The budget is
+WRITEBACK_NODE_DIRTY_BUDGET_FRACTION of the sum of these limits, but never less
+than the largest of them, so that a cache on its own can always use its full
+limit. Each cache's fair share of the budget is proportional to its limit.
+
+Caches report how much dirty data they hold and get back how strongly they
+should slow down their writers: 0 if the node is within
+WRITEBACK_BACKPRESSURE_START_FRACTION of its budget or the cache doesn't use more
+than its fair share, rising to 1 as the node reaches its budget. */
+
+class dirty_budget_t {
+public:
+    class registration_t : public intrusive_list_node_t<registration_t> {
+    public:
+        registration_t(dirty_budget_t *budget, int64_t max_dirty_size);
+        ~registration_t();
+
+        // Records that the cache holds `dirty_size` bytes of data that is not on
+        // disk yet, and returns the backpressure (between 0 and 1) that the
+        // node's budget puts on the cache.
+        double report_dirty_size(int64_t dirty_size);
+
+    private:
+        friend class dirty_budget_t;
+
+        dirty_budget_t *const budget;
+        const int64_t max_dirty_size;
+        int64_t dirty_size;
+
+        DISABLE_COPYING(registration_t);
+    };
+
+    dirty_budget_t();
+    ~dirty_budget_t();
+
+private:
+    void recompute_budget_size();
+
+    spinlock_t lock;
+    intrusive_list_t<registration_t> registrations;
+    int64_t total_max_dirty_size;
+    int64_t total_dirty_size;
+    int64_t budget_size;
+
+    DISABLE_COPYING(dirty_budget_t);
+};
+
+// The budget that is shared by all the table caches of the process.
+dirty_budget_t *get_global_dirty_budget();
+
+#endif  // BUFFER_CACHE_MIRRORED_DIRTY_BUDGET_HPP_
@@ -11,7 +11,8 @@ flush_time_randomizer_t::flush_time_randomizer_t(int _flush_timer_ms)
     : rng(),
       flush_timer_ms(_flush_timer_ms),
       first_time_interval(flush_timer_ms == 1 ? 1 : 1 + rng.randint(flush_timer_ms - 1)),
-      done_first_time_interval(false) {
+      done_first_time_interval(false),
+      stretch(1.0) {
     guarantee(flush_timer_ms > 0 || flush_timer_ms == NEVER_FLUSH);
 }
 
@@ -23,10 +24,21 @@ int flush_time_randomizer_t::next_time_interval() {
         return first_time_interval;
     }
 
-    // We have about a 19/20 chance of returning flush_timer_ms.
-    if (flush_timer_ms > 1 && rng.randint(20) == 0) {
-        // Otherwise, we return a value uniformly in (flush_timer_ms / 2, flush_timer_ms].
-        return flush_timer_ms - rng.randint(flush_timer_ms / 2);
+    const int interval = flush_timer_ms * stretch;
+
+    // We have about a 19/20 chance of returning the interval.
+    if (interval > 1 && rng.randint(20) == 0) {
+        // Otherwise, we return a value uniformly in (interval / 2, interval].
+        return interval - rng.randint(interval / 2);
+    }
+    return interval;
+}
+
+void flush_time_randomizer_t::set_flush_latency(double flush_latency_ms) {
+    rassert(flush_latency_ms >= 0);
+    if (flush_timer_ms == NEVER_FLUSH || flush_timer_ms == 0) {
+        return;
     }
-    return flush_timer_ms;
+    const double saturation = flush_latency_ms / (flush_timer_ms * WRITEBACK_SATURATED_FLUSH_FRACTION);
+    stretch = std::min(WRITEBACK_MAX_FLUSH_INTERVAL_STRETCH, std::max(1.0, saturation));
 }
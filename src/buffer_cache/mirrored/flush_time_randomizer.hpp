@@ -20,6 +20,13 @@ public:
 
     // returns flush_timer_ms == 0, meaning we flush immediately.
     inline bool is_zero() const { return flush_timer_ms == 0; }
+
+    // For adaptive flushing: tells the randomizer how long flushes currently take.
+    // If that is a large part of flush_timer_ms, the disk is saturated and
+    // next_time_interval() returns proportionally longer intervals (up to
+    // WRITEBACK_MAX_FLUSH_INTERVAL_STRETCH times flush_timer_ms).
+    void set_flush_latency(double flush_latency_ms);
+
 private:
     rng_t rng;
 
@@ -27,6 +34,9 @@ private:
     const int first_time_interval;
     bool done_first_time_interval;
 
+    // What the intervals get multiplied with, at least 1.
+    double stretch;
+
     DISABLE_COPYING(flush_time_randomizer_t);
 };
 
@@ -0,0 +1,57 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "buffer_cache/mirrored/memory_broker.hpp"
+
+#include "config/args.hpp"
+
+memory_broker_t::registration_t::registration_t(memory_broker_t *_broker,
+                                                int64_t _configured_size)
+    : broker(_broker), configured_size(_configured_size), miss_rate(0) {
+    guarantee(configured_size >= 0);
+    spinlock_acq_t acq(&broker->lock);
+    broker->registrations.push_back(this);
+    broker->total_size += configured_size;
+}
+
+memory_broker_t::registration_t::~registration_t() {
+    spinlock_acq_t acq(&broker->lock);
+    broker->registrations.remove(this);
+    broker->total_size -= configured_size;
+}
+
+int64_t memory_broker_t::registration_t::report_misses(int64_t misses) {
+    rassert(misses >= 0);
+    spinlock_acq_t acq(&broker->lock);
+    miss_rate = MEMORY_BROKER_MISS_RATE_SMOOTHING * misses
+        + (1 - MEMORY_BROKER_MISS_RATE_SMOOTHING) * miss_rate;
+    return broker->size_for(this);
+}
+
+memory_broker_t::memory_broker_t() : total_size(0) { }
+
+memory_broker_t::~memory_broker_t() {
+    rassert(registrations.empty());
+}
+
+int64_t memory_broker_t::size_for(const registration_t *registration) {
+    double total_miss_rate = 0;
+    int64_t total_min_size = 0;
+    for (registration_t *r = registrations.head(); r != NULL; r = registrations.next(r)) {
+        total_miss_rate += r->miss_rate;
+        total_min_size += r->configured_size * MEMORY_BROKER_MIN_SIZE_FRACTION;
+    }
+
+    // Tiny miss rates are what's left of misses that happened a long time ago.
+    if (total_miss_rate < 1) {
+        return registration->configured_size;
+    }
+
+    const int64_t min_size = registration->configured_size * MEMORY_BROKER_MIN_SIZE_FRACTION;
+    const double share = registration->miss_rate / total_miss_rate;
+    return min_size + static_cast<int64_t>((total_size - total_min_size) * share);
+}
+
+memory_broker_t *get_global_memory_broker() {
+    // See get_global_perfmon_collection() for why this is a function.
+    static memory_broker_t broker;
+    return &broker;
+}
@@ -0,0 +1,61 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#ifndef BUFFER_CACHE_MIRRORED_MEMORY_BROKER_HPP_
+#define BUFFER_CACHE_MIRRORED_MEMORY_BROKER_HPP_
+
+#include <stdint.h>
+
+#include "arch/spinlock.hpp"
+#include "containers/intrusive_list.hpp"
+#include "errors.hpp"
+
+/* The memory broker moves memory between the caches of a process. Every
+participating cache registers with its configured size, and the sum of the
+configured sizes is the total limit that the broker shares out. Each cache
+periodically reports how many misses it had since its last report and gets its
+new size back: every cache keeps at least MEMORY_BROKER_MIN_SIZE_FRACTION of its
+configured size, and the rest of the total is split up in proportion to the
+caches' (smoothed) miss rates. If no cache has any misses, every cache gets its
+configured size.
+
+Caches live on different threads and report independently of each other, so the
+sizes handed out can exceed the total for up to one reporting interval while the
+other caches haven't picked up their smaller sizes yet. */
+
+class memory_broker_t {
+public:
+    class registration_t : public intrusive_list_node_t<registration_t> {
+    public:
+        registration_t(memory_broker_t *broker, int64_t configured_size);
+        ~registration_t();
+
+        // Records `misses` cache misses since the last call and returns the
+        // number of bytes the cache should use from now on.
+        int64_t report_misses(int64_t misses);
+
+    private:
+        friend class memory_broker_t;
+
+        memory_broker_t *const broker;
+        const int64_t configured_size;
+        double miss_rate;
+
+        DISABLE_COPYING(registration_t);
+    };
+
+    memory_broker_t();
+    ~memory_broker_t();
+
+private:
+    int64_t size_for(const registration_t *registration);
+
+    spinlock_t lock;
+    intrusive_list_t<registration_t> registrations;
+    int64_t total_size;
+
+    DISABLE_COPYING(memory_broker_t);
+};
+
+// The broker that is shared by all the table caches of the process.
+memory_broker_t *get_global_memory_broker();
+
+#endif  // BUFFER_CACHE_MIRRORED_MEMORY_BROKER_HPP_
@@ -7,6 +7,9 @@
 
 #include "arch/arch.hpp"
 #include "arch/runtime/coroutines.hpp"
+#include "buffer_cache/mirrored/warmup_manifest.hpp"
+#include "concurrency/lock_contention.hpp"
+#include "concurrency/pmap.hpp"
 #include "do_on_thread.hpp"
 #include "serializer/serializer.hpp"
 #include "protocol_api.hpp"
@@ -15,6 +18,11 @@
  * Buffer implementation.
  */
 
+// The superblock gets a lock site of its own, every write and most reads of the
+// btree wait for it.
+static lock_site_t buf_lock_site("buffer_cache.buf_lock");
+static lock_site_t superblock_lock_site("buffer_cache.superblock_lock");
+
 // Types of snapshots
 
 // In order for snapshots to get deleted properly, they must obey the invariant that, after
@@ -185,8 +193,35 @@ void mc_inner_buf_t::load_inner_buf(bool should_lock, file_account_t *io_account
     }
 }
 
+void mc_inner_buf_t::load_inner_bufs(mc_cache_t *cache, const std::vector<mc_inner_buf_t *> &bufs,
+                                     file_account_t *io_account) {
+    {
+        on_thread_t thread(cache->serializer->home_thread());
+        std::vector<counted_t<standard_block_token_t> > tokens;
+        tokens.reserve(bufs.size());
+        std::vector<ser_buffer_t *> ser_bufs;
+        ser_bufs.reserve(bufs.size());
+        for (auto it = bufs.begin(); it != bufs.end(); ++it) {
+            mc_inner_buf_t *buf = *it;
+            rassert(buf->lock.locked());
+            buf->subtree_recency = cache->serializer->get_recency(buf->block_id);
+            buf->data_token = cache->serializer->index_read(buf->block_id);
+            guarantee(buf->data_token.has());
+            buf->block_size = buf->data_token->block_size();
+            tokens.push_back(buf->data_token);
+            ser_bufs.push_back(buf->data.get_ser_buffer());
+        }
+        cache->serializer->block_reads(tokens, ser_bufs, io_account);
+    }
+
+    for (auto it = bufs.begin(); it != bufs.end(); ++it) {
+        (*it)->lock.unlock();
+    }
+}
+
 // This form of the buf constructor is used when the block exists on disk and needs to be loaded
-mc_inner_buf_t::mc_inner_buf_t(mc_cache_t *_cache, block_id_t _block_id, file_account_t *_io_account)
+mc_inner_buf_t::mc_inner_buf_t(mc_cache_t *_cache, block_id_t _block_id, file_account_t *_io_account,
+                               std::vector<mc_inner_buf_t *> *batch)
     : evictable_t(_cache),
       writeback_t::local_buf_t(),
       block_id(_block_id),
@@ -204,16 +239,30 @@ mc_inner_buf_t::mc_inner_buf_t(mc_cache_t *_cache, block_id_t _block_id, file_ac
 
     array_map_t::constructing_inner_buf(this);
 
-    // Some things expect us to return immediately (as of 5/12/2011), so we do the loading in a
-    // separate coro. We have to make sure that load_inner_buf() acquires the lock first
-    // however, so we use spawn_now_dangerously().
-    coro_t::spawn_now_dangerously(boost::bind(&mc_inner_buf_t::load_inner_buf, this, true, _io_account));
+    if (_cache->compressed_tier.has()
+        && _cache->compressed_tier->take(block_id, data.get_ser_buffer(),
+                                         &data_token, &subtree_recency)) {
+        // The block was still in memory in compressed form, so we don't have to
+        // go to disk.
+        block_size = data_token->block_size();
+    } else if (batch != NULL) {
+        // The lock has to be taken before anybody else can see the buf, just like
+        // load_inner_buf() does it below.
+        DEBUG_VAR bool locked = lock.lock(rwi_write, NULL);
+        rassert(locked);
+        batch->push_back(this);
+    } else {
+        // Some things expect us to return immediately (as of 5/12/2011), so we do the loading in a
+        // separate coro. We have to make sure that load_inner_buf() acquires the lock first
+        // however, so we use spawn_now_dangerously().
+        coro_t::spawn_now_dangerously(boost::bind(&mc_inner_buf_t::load_inner_buf, this, true, _io_account));
+    }
 
     // TODO: only increment pm_n_blocks_in_memory when we actually load the block into memory.
     ++_cache->stats->pm_n_blocks_in_memory;
     refcount++; // Make the refcount nonzero so this block won't be considered safe to unload.
 
-    _cache->page_repl.make_space();
+    _cache->page_repl->make_space();
     _cache->maybe_unregister_read_ahead_callback();
 
     refcount--;
@@ -221,7 +270,7 @@ mc_inner_buf_t::mc_inner_buf_t(mc_cache_t *_cache, block_id_t _block_id, file_ac
 
 // This form of the buf constructor is used when the block exists on disks but has been loaded into buf already
 mc_inner_buf_t::mc_inner_buf_t(mc_cache_t *_cache, block_id_t _block_id,
-                               scoped_malloc_t<ser_buffer_t> &&_buf,
+                               scoped_ser_buffer_t &&_buf,
                                const counted_t<standard_block_token_t>& token,
                                repli_timestamp_t _recency_timestamp)
     : evictable_t(_cache),
@@ -241,10 +290,13 @@ mc_inner_buf_t::mc_inner_buf_t(mc_cache_t *_cache, block_id_t _block_id,
     rassert(version_id != faux_version_id);
 
     array_map_t::constructing_inner_buf(this);
+    if (_cache->compressed_tier.has()) {
+        _cache->compressed_tier->discard(block_id);
+    }
 
     ++_cache->stats->pm_n_blocks_in_memory;
     refcount++; // Make the refcount nonzero so this block won't be considered safe to unload.
-    _cache->page_repl.make_space();
+    _cache->page_repl->make_space();
     _cache->maybe_unregister_read_ahead_callback();
     refcount--;
 }
@@ -317,17 +369,26 @@ mc_inner_buf_t::mc_inner_buf_t(mc_cache_t *_cache, block_id_t _block_id, version
     initialize_to_new(_snapshot_version, _recency_timestamp);
 
     array_map_t::constructing_inner_buf(this);
+    if (_cache->compressed_tier.has()) {
+        _cache->compressed_tier->discard(block_id);
+    }
 
     ++_cache->stats->pm_n_blocks_in_memory;
     ++refcount; // Make the refcount nonzero so this block won't be considered safe to unload.
 
-    _cache->page_repl.make_space();
+    _cache->page_repl->make_space();
     _cache->maybe_unregister_read_ahead_callback();
 
     --refcount;
 }
 
 void mc_inner_buf_t::unload() {
+    // If we are clean, the compressed tier may keep a copy of our data so that we
+    // don't have to be read from disk again.
+    if (cache->compressed_tier.has() && data.has() && data_token.has() && !do_delete) {
+        cache->compressed_tier->insert(block_id, data.get_ser_buffer(), block_size,
+                                       data_token, subtree_recency);
+    }
     delete this;
 }
 
@@ -367,7 +428,7 @@ bool mc_inner_buf_t::snapshot_if_needed(version_id_t new_version, bool leave_clo
     // all snapshot txns such that
     //   inner_version <= snapshot_txn->version_id < new_version
     // can see the current version of inner_buf->data, so we need to make some snapshots for them
-    size_t num_snapshots_affected = cache->calculate_snapshots_affected(version_id, new_version);
+    size_t num_snapshots_affected = cache->calculate_snapshots_affected(block_id, version_id, new_version);
     if (num_snapshots_affected + cow_refcount > 0) {
         if (!data.has()) {
             // Ok, we are in trouble. We don't have data (probably because we were constructed
@@ -383,7 +444,7 @@ bool mc_inner_buf_t::snapshot_if_needed(version_id_t new_version, bool leave_clo
             // actually not needed anymore (in which case we have loaded the block unnecessarily,
             // but what could we possibly do about that?). So, we update the count of affected
             // snapshots.
-            num_snapshots_affected = cache->calculate_snapshots_affected(version_id, new_version);
+            num_snapshots_affected = cache->calculate_snapshots_affected(block_id, version_id, new_version);
         }
     }
 
@@ -395,8 +456,10 @@ bool mc_inner_buf_t::snapshot_if_needed(version_id_t new_version, bool leave_clo
 
     // commented out: rassert(snap_refcount <= num_snapshots_affected); // sanity check
 
-    // check whether snapshot refcount is > 0
-    if (0 == num_snapshots_affected + cow_refcount)
+    // check whether snapshot refcount is > 0.  A snapshotted transaction that has
+    // passed the block may still hold a lock on the current data, which then has
+    // to be kept for the lock even though no snapshot is affected.
+    if (0 == num_snapshots_affected + cow_refcount + snap_refcount)
         return false;           // no snapshot necessary
 
     // Initially actively referencing the snapshotted buf are mc_buf_lock_t's in rwi_read_outdated_ok
@@ -499,6 +562,12 @@ mc_buf_lock_t::mc_buf_lock_t(mc_transaction_t *transaction,
 {
     transaction->assert_thread();
     rassert(block_id != NULL_BLOCK_ID);
+    rassert(!transaction->has_passed(block_id), "acquired block %" PRIu64 " after passing it", block_id);
+
+    const cache_access_hint_t hint = transaction->take_access_hint();
+    if (!transaction->is_writeback_transaction) {
+        transaction->cache->working_set.record_access(block_id);
+    }
 
     // Note that it is critical that between here and creating our buf_lock_t wrapper that we do nothing
     // blocking (unless it acquires a lock on inner_buf or otherwise prevents it from being
@@ -511,7 +580,15 @@ mc_buf_lock_t::mc_buf_lock_t(mc_transaction_t *transaction,
         // otherwise, the inner buf would be around to keep track of the snapshotted version. Thus,
         // it is not wasteful to load the latest version if should_load is true.
         inner_buf = new mc_inner_buf_t(transaction->cache, block_id, transaction->get_io_account());
+        if (hint == CACHE_ACCESS_HINT_ONCE) {
+            inner_buf->put_on_probation();
+        }
+        ++transaction->num_block_loads;
     } else {
+        if (hint != CACHE_ACCESS_HINT_ONCE) {
+            inner_buf->touch_in_page_repl();
+        }
+
         // TODO: the logic for when to load an inner_buf's versions (most recent or snapshotted) is
         // scattered around everywhere (eg: here). consolidate it, perhaps in mc_buf_lock_t.
         rassert(!inner_buf->do_delete || snapshotted);
@@ -527,6 +604,9 @@ mc_buf_lock_t::mc_buf_lock_t(mc_transaction_t *transaction,
 
             // Please keep in mind that this is blocking...
             inner_buf->load_inner_buf(true, transaction->get_io_account());
+            ++transaction->num_block_loads;
+        } else {
+            ++transaction->num_cache_hits;
         }
     }
 
@@ -611,7 +691,9 @@ void mc_buf_lock_t::initialize(file_account_t *io_account,
         ticks_t lock_start_time;
         // the top version is the right one for us; acquire a lock of the appropriate type first
         inner_buf->cache->stats->pm_bufs_acquiring.begin(&lock_start_time);
-        inner_buf->lock.co_lock(mode == rwi_read_outdated_ok ? rwi_read : mode, call_when_in_line);
+        inner_buf->lock.co_lock(mode == rwi_read_outdated_ok ? rwi_read : mode, call_when_in_line,
+                                inner_buf->block_id == SUPERBLOCK_ID
+                                ? &superblock_lock_site : &buf_lock_site);
         inner_buf->cache->stats->pm_bufs_acquiring.end(&lock_start_time);
 
         // Update version_to_access since the callback might have modified it:
@@ -825,6 +907,22 @@ void mc_buf_lock_t::touch_recency(repli_timestamp_t timestamp) {
     }
 }
 
+bool mc_buf_lock_t::can_use_derived_data() const {
+    return acquired && !snapshotted && (mode == rwi_read || mode == rwi_read_sync)
+        && inner_buf->data.equals(data);
+}
+
+buf_derived_data_t *mc_buf_lock_t::get_derived_data() const {
+    rassert(can_use_derived_data());
+    return inner_buf->derived_data.get_or_null();
+}
+
+void mc_buf_lock_t::set_derived_data(buf_derived_data_t *derived_data) {
+    rassert(can_use_derived_data());
+    inner_buf->derived_data.reset();
+    inner_buf->derived_data.init(derived_data);
+}
+
 repli_timestamp_t mc_buf_lock_t::get_recency() const {
     // TODO: Make it possible to get the recency _without_
     // acquiring the buf.  The recency should be locked with a
@@ -841,6 +939,13 @@ void mc_buf_lock_t::set_eviction_priority(eviction_priority_t val) {
     inner_buf->eviction_priority = val;
 }
 
+void mc_buf_lock_t::pin_in_cache() {
+    assert_thread();
+    if (!inner_buf->pinned()) {
+        inner_buf->pin_in_page_repl();
+    }
+}
+
 void *mc_buf_lock_t::get_data_write() {
     return get_data_write(inner_buf->cache->serializer->get_block_size().value());
 }
@@ -863,6 +968,7 @@ void *mc_buf_lock_t::get_data_write(uint32_t cache_block_size) {
 
     inner_buf->writeback_buf().set_dirty();
     inner_buf->data_token.reset();
+    inner_buf->derived_data.reset();
 
     inner_buf->block_size = bs;
     block_size = bs;
@@ -894,6 +1000,7 @@ void mc_buf_lock_t::mark_deleted() {
 
     inner_buf->do_delete = true;
     inner_buf->data_token.reset();
+    inner_buf->derived_data.reset();
 }
 
 
@@ -990,7 +1097,14 @@ mc_transaction_t::mc_transaction_t(mc_cache_t *_cache, access_t _access, int _ex
       snapshot_version(mc_inner_buf_t::faux_version_id),
       snapshotted(false),
       cache_account(NULL),
+      access_hint(CACHE_ACCESS_HINT_NORMAL),
+      has_next_access_hint(false),
+      next_access_hint(CACHE_ACCESS_HINT_NORMAL),
+      num_buf_snapshots_registered(0),
+      single_pass(false),
       num_buf_locks_acquired(0),
+      num_cache_hits(0),
+      num_block_loads(0),
       is_writeback_transaction(false),
       durability(_durability),
       token_pair(NULL) {
@@ -1022,7 +1136,14 @@ mc_transaction_t::mc_transaction_t(mc_cache_t *_cache, access_t _access, UNUSED
       snapshot_version(mc_inner_buf_t::faux_version_id),
       snapshotted(false),
       cache_account(NULL),
+      access_hint(CACHE_ACCESS_HINT_NORMAL),
+      has_next_access_hint(false),
+      next_access_hint(CACHE_ACCESS_HINT_NORMAL),
+      num_buf_snapshots_registered(0),
+      single_pass(false),
       num_buf_locks_acquired(0),
+      num_cache_hits(0),
+      num_block_loads(0),
       is_writeback_transaction(false),
       durability(WRITE_DURABILITY_INVALID),
       token_pair(NULL) {
@@ -1047,7 +1168,14 @@ mc_transaction_t::mc_transaction_t(mc_cache_t *_cache, access_t _access, UNUSED
     snapshot_version(mc_inner_buf_t::faux_version_id),
     snapshotted(false),
     cache_account(NULL),
+    access_hint(CACHE_ACCESS_HINT_NORMAL),
+    has_next_access_hint(false),
+    next_access_hint(CACHE_ACCESS_HINT_NORMAL),
+    num_buf_snapshots_registered(0),
+    single_pass(false),
     num_buf_locks_acquired(0),
+    num_cache_hits(0),
+    num_block_loads(0),
     is_writeback_transaction(true),
     durability(WRITE_DURABILITY_INVALID),
     token_pair(NULL) {
@@ -1064,7 +1192,12 @@ mc_transaction_t::mc_transaction_t(mc_cache_t *_cache, access_t _access, UNUSED
 void mc_transaction_t::register_buf_snapshot(mc_inner_buf_t *inner_buf, mc_inner_buf_t::buf_snapshot_t *snap) {
     assert_thread();
     ++cache->stats->pm_registered_snapshot_blocks;
-    owned_buf_snapshots.push_back(std::make_pair(inner_buf, snap));
+    ++num_buf_snapshots_registered;
+    owned_buf_snapshots.insert(std::make_pair(inner_buf->block_id, std::make_pair(inner_buf, snap)));
+}
+
+bool mc_transaction_t::has_passed(block_id_t block_id) const {
+    return passed_blocks.find(block_id) != passed_blocks.end();
 }
 
 mc_transaction_t::~mc_transaction_t() {
@@ -1092,14 +1225,14 @@ mc_transaction_t::~mc_transaction_t() {
 
     if (snapshotted && snapshot_version != mc_inner_buf_t::faux_version_id) {
         cache->unregister_snapshot(this);
-        for (std::vector<std::pair<mc_inner_buf_t*, mc_inner_buf_t::buf_snapshot_t*> >::iterator it = owned_buf_snapshots.begin();
-             it != owned_buf_snapshots.end();
-             ++it) {
-            it->first->release_snapshot(it->second);
+        for (auto it = owned_buf_snapshots.begin(); it != owned_buf_snapshots.end(); ++it) {
+            it->second.first->release_snapshot(it->second.second);
         }
     }
 
     if (access == rwi_write && durability == WRITE_DURABILITY_HARD) {
+        // Declared first so that it includes waiting for `disk_ack_signal`.
+        block_pm_duration durable_commit_timer(&cache->stats->pm_transactions_durable_commit);
         /* We have to call `sync_patiently()` before `on_transaction_commit()` so that if
         `on_transaction_commit()` starts a sync, we will get included in it */
         sync_callback_t disk_ack_signal;
@@ -1109,7 +1242,7 @@ mc_transaction_t::~mc_transaction_t() {
         cache->on_transaction_commit(this);
     }
 
-    cache->stats->pm_snapshots_per_transaction.record(owned_buf_snapshots.size());
+    cache->stats->pm_snapshots_per_transaction.record(num_buf_snapshots_registered);
     cache->stats->pm_registered_snapshot_blocks -= owned_buf_snapshots.size();
 }
 
@@ -1135,6 +1268,31 @@ void mc_transaction_t::snapshot() {
     snapshotted = true;
 }
 
+void mc_transaction_t::set_single_pass() {
+    single_pass = true;
+}
+
+void mc_transaction_t::pass_block(block_id_t block_id) {
+    assert_thread();
+    if (!snapshotted || !single_pass) {
+        return;
+    }
+    passed_blocks.insert(block_id);
+    auto range = owned_buf_snapshots.equal_range(block_id);
+    for (auto it = range.first; it != range.second; ++it) {
+        it->second.first->release_snapshot(it->second.second);
+        --cache->stats->pm_registered_snapshot_blocks;
+        ++cache->stats->pm_passed_snapshot_blocks;
+    }
+    owned_buf_snapshots.erase(range.first, range.second);
+}
+
+bool mc_transaction_t::snapshot_over_budget() const {
+    return snapshotted
+        && owned_buf_snapshots.size() * cache->get_block_size().value()
+           > SNAPSHOT_SCAN_MAX_COPIED_BYTES;
+}
+
 void mc_transaction_t::set_account(mc_cache_account_t *_cache_account) {
     rassert(cache_account == NULL, "trying to set the transaction's cache_account twice");
 
@@ -1145,6 +1303,86 @@ void mc_transaction_t::set_token_pair(write_token_pair_t *_token_pair) {
     token_pair = _token_pair;
 }
 
+const void *mc_transaction_t::peek(block_id_t block_id) {
+    assert_thread();
+    rassert(block_id != NULL_BLOCK_ID);
+    const cache_access_hint_t hint = take_access_hint();
+    if (is_write_mode(access) || snapshotted) {
+        return NULL;
+    }
+
+    mc_inner_buf_t *inner_buf = cache->page_map.find(block_id);
+    if (inner_buf == NULL || !inner_buf->data.has() || inner_buf->do_delete
+        || !inner_buf->lock.read_available()) {
+        return NULL;
+    }
+
+    // It's an access like any other, as far as the page replacement and the
+    // stats are concerned.
+    cache->working_set.record_access(block_id);
+    if (hint != CACHE_ACCESS_HINT_ONCE) {
+        inner_buf->touch_in_page_repl();
+    }
+    ++num_cache_hits;
+    return inner_buf->data.get();
+}
+
+void mc_transaction_t::prefetch(block_id_t block_id) {
+    assert_thread();
+    rassert(block_id != NULL_BLOCK_ID);
+    const cache_access_hint_t hint = take_access_hint();
+
+    // We don't use find_buf(), the buf lock that acquires the block later counts
+    // as the hit or miss.
+    if (cache->page_map.find(block_id) != NULL) {
+        return;
+    }
+
+    // Like in the mc_buf_lock_t constructor, it's fine to load the latest version
+    // even if we are snapshotted.
+    mc_inner_buf_t *inner_buf = new mc_inner_buf_t(cache, block_id, get_io_account());
+    if (hint == CACHE_ACCESS_HINT_ONCE) {
+        inner_buf->put_on_probation();
+    }
+    ++num_block_loads;
+    ++cache->stats->pm_n_blocks_prefetched;
+    ++cache->misses_since_memory_broker_report;
+}
+
+void mc_transaction_t::prefetch(const std::vector<block_id_t> &block_ids) {
+    assert_thread();
+    const cache_access_hint_t hint = take_access_hint();
+
+    std::vector<mc_inner_buf_t *> batch;
+    for (auto it = block_ids.begin(); it != block_ids.end(); ++it) {
+        rassert(*it != NULL_BLOCK_ID);
+        if (cache->page_map.find(*it) != NULL) {
+            continue;
+        }
+
+        mc_inner_buf_t *inner_buf = new mc_inner_buf_t(cache, *it, get_io_account(), &batch);
+        if (hint == CACHE_ACCESS_HINT_ONCE) {
+            inner_buf->put_on_probation();
+        }
+        ++num_block_loads;
+        ++cache->stats->pm_n_blocks_prefetched;
+        ++cache->misses_since_memory_broker_report;
+    }
+
+    if (!batch.empty()) {
+        coro_t::spawn_now_dangerously(boost::bind(&mc_inner_buf_t::load_inner_bufs,
+                                                  cache, batch, get_io_account()));
+    }
+}
+
+cache_access_hint_t mc_transaction_t::take_access_hint() {
+    if (has_next_access_hint) {
+        has_next_access_hint = false;
+        return next_access_hint;
+    }
+    return access_hint;
+}
+
 file_account_t *mc_transaction_t::get_io_account() const {
     return (cache_account == NULL ? cache->reads_io_account.get() : cache_account->io_account_);
 }
@@ -1202,7 +1440,7 @@ void mc_cache_t::create(serializer_t *serializer) {
 
     on_thread_t switcher(serializer->home_thread());
 
-    scoped_malloc_t<ser_buffer_t> superblock = serializer->malloc();
+    scoped_ser_buffer_t superblock = serializer->malloc();
     bzero(superblock->cache_data, serializer->get_block_size().value());
 
     index_write_op_t op(SUPERBLOCK_ID);
@@ -1218,16 +1456,15 @@ mc_cache_t::mc_cache_t(serializer_t *_serializer,
     dynamic_config(_dynamic_config),
     serializer(_serializer),
     stats(new mc_cache_stats_t(perfmon_parent)),
-    page_repl(
-        // Launch page replacement if the user-specified maximum number of blocks is reached
-        dynamic_config.max_size / _serializer->get_block_size().ser_value(),
-        this),
+    working_set(_serializer->get_block_size(), &stats->cache_collection),
     writeback(
         this,
         dynamic_config.flush_timer_ms,
         dynamic_config.flush_dirty_size / _serializer->get_block_size().ser_value(),
         dynamic_config.max_dirty_size / _serializer->get_block_size().ser_value(),
-        dynamic_config.max_concurrent_flushes),
+        dynamic_config.max_concurrent_flushes,
+        dynamic_config.use_dirty_budget,
+        dynamic_config.adaptive_flush),
     /* Build list of free blocks (the free_list constructor blocks) */
     free_list(_serializer, stats.get()),
     shutting_down(false),
@@ -1237,10 +1474,34 @@ mc_cache_t::mc_cache_t(serializer_t *_serializer,
     read_ahead_registered(false),
     next_snapshot_version(mc_inner_buf_t::faux_version_id+1) {
 
+    int64_t uncompressed_size = dynamic_config.max_size;
+    if (dynamic_config.compressed_tier_size > 0) {
+        guarantee(dynamic_config.compressed_tier_size < dynamic_config.max_size);
+        uncompressed_size -= dynamic_config.compressed_tier_size;
+        compressed_tier.init(new compressed_tier_t(dynamic_config.compressed_tier_size,
+                                                   stats.get()));
+    }
+
+    // Launch page replacement if the user-specified maximum number of blocks is reached
+    const size_t max_num_pages = uncompressed_size / serializer->get_block_size().ser_value();
+    make_page_repl(dynamic_config.page_repl_policy, max_num_pages, this, &page_repl);
+    page_map.reserve(max_num_pages);
+
+    warmup_conflicts = NULL;
+    misses_since_memory_broker_report = 0;
+    if (dynamic_config.use_memory_broker) {
+        memory_broker_registration.init(
+            new memory_broker_t::registration_t(get_global_memory_broker(),
+                                                uncompressed_size));
+        memory_broker_timer.init(new repeating_timer_t(MEMORY_BROKER_INTERVAL_MS, this));
+    }
+
     {
         on_thread_t thread_switcher(serializer->home_thread());
-        reads_io_account.init(serializer->make_io_account(dynamic_config.io_priority_reads));
-        writes_io_account.init(serializer->make_io_account(dynamic_config.io_priority_writes));
+        reads_io_account.init(serializer->make_io_account(dynamic_config.io_priority_reads,
+                                                          io_activity_t::query_reads));
+        writes_io_account.init(serializer->make_io_account(dynamic_config.io_priority_writes,
+                                                           io_activity_t::writeback));
     }
 
     // Register us for read ahead to warm up faster
@@ -1257,6 +1518,13 @@ mc_cache_t::~mc_cache_t() {
     shutting_down = true;
     serializer->unregister_read_ahead_cb(this);
 
+    // Give our memory back to the other caches.
+    memory_broker_timer.reset();
+    memory_broker_registration.reset();
+
+    // Stop warming up, this waits for the current batch of reads to finish.
+    warmup_drainer.reset();
+
     rassert(num_live_non_writeback_transactions == 0,
             "num_live_non_writeback_transactions is %d\n",
             num_live_non_writeback_transactions);
@@ -1288,12 +1556,24 @@ mc_cache_t::~mc_cache_t() {
         writeback.sync(&sync_cb);
     }
 
-    /* Delete all the buffers */
-    while (evictable_t *buf = page_repl.get_first_buf()) {
+    /* Delete all the buffers, keeping track of which blocks we had for the next
+    start */
+    std::vector<block_id_t> resident_block_ids;
+    while (evictable_t *buf = page_repl->get_first_buf()) {
         // TODO(rntz) check that buf is actually a mc_inner_buf_t
+        mc_inner_buf_t *inner_buf = static_cast<mc_inner_buf_t *>(buf);
+        if (!inner_buf->do_delete) {
+            resident_block_ids.push_back(inner_buf->block_id);
+        }
         delete buf;
     }
 
+    if (!warmup_manifest_path.empty()) {
+        // If this fails (it logs a warning), the next start is just slower.
+        UNUSED bool written = write_warmup_manifest(warmup_manifest_path, resident_block_ids);
+    }
+    warmup_cache_account.reset();
+
     {
         /* IO accounts must be destroyed on the thread they were created on */
         on_thread_t thread_switcher(serializer->home_thread());
@@ -1324,13 +1604,16 @@ void mc_cache_t::unregister_snapshot(mc_transaction_t *txn) {
     --stats->pm_registered_snapshots;
 }
 
-size_t mc_cache_t::calculate_snapshots_affected(mc_inner_buf_t::version_id_t snapshotted_version, mc_inner_buf_t::version_id_t new_version) {
+size_t mc_cache_t::calculate_snapshots_affected(block_id_t block_id, mc_inner_buf_t::version_id_t snapshotted_version, mc_inner_buf_t::version_id_t new_version) {
     rassert(snapshotted_version <= new_version);    // on equals we'll get 0 snapshots affected
     size_t num_snapshots_affected = 0;
     for (std::map<mc_inner_buf_t::version_id_t, mc_transaction_t *>::iterator it = active_snapshots.lower_bound(snapshotted_version),
              itend = active_snapshots.lower_bound(new_version);
          it != itend;
          it++) {
+        if (it->second->has_passed(block_id)) {
+            continue;
+        }
         num_snapshots_affected++;
     }
     return num_snapshots_affected;
@@ -1343,6 +1626,9 @@ size_t mc_cache_t::register_buf_snapshot(mc_inner_buf_t *inner_buf, mc_inner_buf
              itend = active_snapshots.lower_bound(new_version);
          it != itend;
          it++) {
+        if (it->second->has_passed(inner_buf->block_id)) {
+            continue;
+        }
         it->second->register_buf_snapshot(inner_buf, snap);
         num_snapshots_affected++;
     }
@@ -1355,10 +1641,21 @@ mc_inner_buf_t *mc_cache_t::find_buf(block_id_t block_id) {
         ++stats->pm_cache_hits;
     } else {
         ++stats->pm_cache_misses;
+        ++misses_since_memory_broker_report;
     }
     return buf;
 }
 
+void mc_cache_t::on_ring() {
+    assert_thread();
+    rassert(memory_broker_registration.has());
+    const int64_t size
+        = memory_broker_registration->report_misses(misses_since_memory_broker_report);
+    misses_since_memory_broker_report = 0;
+    page_repl->set_unload_threshold(size / serializer->get_block_size().ser_value());
+    page_repl->make_space();
+}
+
 unsigned int mc_cache_t::num_blocks() {
     return page_map.num_pages();
 }
@@ -1368,7 +1665,114 @@ bool mc_cache_t::contains_block(block_id_t block_id) {
 }
 
 
-void mc_cache_t::create_cache_account(int priority, scoped_ptr_t<mc_cache_account_t> *out) {
+void mc_cache_t::enable_warmup_manifest(const std::string &path) {
+    assert_thread();
+    rassert(warmup_manifest_path.empty());
+    warmup_manifest_path = path;
+
+    std::vector<block_id_t> block_ids;
+    if (take_warmup_manifest(path, &block_ids) && !block_ids.empty()) {
+        create_cache_account(CACHE_WARMUP_CACHE_PRIORITY, io_activity_t::warmup,
+                             &warmup_cache_account);
+        warmup_drainer.init(new auto_drainer_t);
+        coro_t::spawn_sometime(boost::bind(&mc_cache_t::warm_up, this, block_ids,
+                                           auto_drainer_t::lock_t(warmup_drainer.get())));
+    }
+}
+
+namespace {
+
+struct warmup_read_t {
+    block_id_t block_id;
+    counted_t<standard_block_token_t> token;
+    repli_timestamp_t recency;
+    scoped_ser_buffer_t buf;
+};
+
+void read_warmup_block(serializer_t *serializer, file_account_t *io_account,
+                       warmup_read_t *reads, int i) {
+    warmup_read_t *read = &reads[i];
+    read->token = serializer->index_read(read->block_id);
+    if (read->token.has()) {
+        read->recency = serializer->get_recency(read->block_id);
+        read->buf = serializer->malloc();
+        serializer->block_read(read->token, read->buf.get(), io_account);
+    }
+}
+
+}  // namespace
+
+void mc_cache_t::warm_up(const std::vector<block_id_t> &manifest,
+                         auto_drainer_t::lock_t keepalive) {
+    assert_thread();
+    stats->pm_warmup_blocks_pending += manifest.size();
+
+    // Look up where the blocks are on disk, so that we can read them in order.
+    // Blocks that were deleted after the manifest was written are skipped.
+    std::vector<block_id_t> block_ids;
+    {
+        on_thread_t thread(serializer->home_thread());
+        std::vector<std::pair<int64_t, block_id_t> > offsets;
+        offsets.reserve(manifest.size());
+        for (std::vector<block_id_t>::const_iterator it = manifest.begin();
+             it != manifest.end(); ++it) {
+            counted_t<standard_block_token_t> token = serializer->index_read(*it);
+            if (token.has()) {
+                offsets.push_back(std::make_pair(token->offset(), *it));
+            }
+        }
+        std::sort(offsets.begin(), offsets.end());
+        block_ids.reserve(offsets.size());
+        for (size_t i = 0; i < offsets.size(); ++i) {
+            block_ids.push_back(offsets[i].second);
+        }
+    }
+    stats->pm_warmup_blocks_pending -= manifest.size() - block_ids.size();
+
+    size_t begin = 0;
+    while (begin < block_ids.size()) {
+        const size_t end = std::min(block_ids.size(), begin + CACHE_WARMUP_BATCH_SIZE);
+        // We never evict anything for the warm-up.
+        if (keepalive.get_drain_signal()->is_pulsed() || page_repl->is_full(end - begin)) {
+            break;
+        }
+
+        scoped_array_t<warmup_read_t> reads(end - begin);
+        for (size_t i = 0; i < reads.size(); ++i) {
+            reads[i].block_id = block_ids[begin + i];
+        }
+
+        // A block can only change on disk while it's in the page map, so if a
+        // block neither entered nor left the page map while we were reading it
+        // and we don't have it now, what we read is up to date.
+        std::set<block_id_t> conflicts;
+        warmup_conflicts = &conflicts;
+        {
+            on_thread_t thread(serializer->home_thread());
+            pmap(reads.size(), boost::bind(&read_warmup_block, serializer,
+                                           warmup_cache_account->io_account_,
+                                           reads.data(), _1));
+        }
+        warmup_conflicts = NULL;
+
+        for (size_t i = 0; i < reads.size(); ++i) {
+            warmup_read_t *read = &reads[i];
+            if (read->token.has()
+                && conflicts.find(read->block_id) == conflicts.end()
+                && can_read_ahead_block_be_accepted(read->block_id)) {
+                new mc_inner_buf_t(this, read->block_id, std::move(read->buf),
+                                   read->token, read->recency);
+                ++stats->pm_warmup_blocks_loaded;
+            }
+        }
+        stats->pm_warmup_blocks_pending -= reads.size();
+        begin = end;
+    }
+    stats->pm_warmup_blocks_pending -= block_ids.size() - begin;
+}
+
+void mc_cache_t::create_cache_account(int priority, io_activity_t activity,
+                                      scoped_ptr_t<mc_cache_account_t> *out) {
     // We assume that a priority of 100 means that the transaction should have the same priority as
     // all the non-accounted transactions together. Not sure if this makes sense.
 
@@ -1381,7 +1785,8 @@ void mc_cache_t::create_cache_account(int priority, scoped_ptr_t<mc_cache_accoun
     file_account_t *io_account;
     {
         on_thread_t thread_switcher(serializer->home_thread());
-        io_account = serializer->make_io_account(io_priority, outstanding_requests_limit);
+        io_account = serializer->make_io_account(io_priority, outstanding_requests_limit,
+                                                 io_class_t::background, activity);
     }
 
     out->init(new mc_cache_account_t(serializer->home_thread(), io_account));
@@ -1406,7 +1811,7 @@ void mc_cache_t::on_transaction_commit(mc_transaction_t *txn) {
 }
 
 void mc_cache_t::offer_read_ahead_buf(block_id_t block_id,
-                                      scoped_malloc_t<ser_buffer_t> *buf,
+                                      scoped_ser_buffer_t *buf,
                                       const counted_t<standard_block_token_t>& token,
                                       repli_timestamp_t recency_timestamp) {
     // Note that the offered block might get deleted between the point where the
@@ -1424,7 +1829,7 @@ void mc_cache_t::offer_read_ahead_buf_home_thread(
     assert_thread();
 
     // Formally take ownership of buf.
-    scoped_malloc_t<ser_buffer_t> local_buf(buf);
+    scoped_ser_buffer_t local_buf(buf);
 
     // Check that the offered block is allowed to be accepted at the current time
     // (e.g. that we don't have a more recent version already nor that it got deleted in the meantime)
@@ -1449,7 +1854,7 @@ bool mc_cache_t::can_read_ahead_block_be_accepted(block_id_t block_id) {
 
 void mc_cache_t::maybe_unregister_read_ahead_callback() {
     // Unregister when 90 % of the cache are filled up.
-    if (read_ahead_registered && page_repl.is_full(dynamic_config.max_size / serializer->get_block_size().ser_value() / 10 + 1)) {
+    if (read_ahead_registered && page_repl->is_full(dynamic_config.max_size / serializer->get_block_size().ser_value() / 10 + 1)) {
         read_ahead_registered = false;
         // unregister_read_ahead_cb requires a coro context, but we might not be in any
         coro_t::spawn_now_dangerously(boost::bind(&serializer_t::unregister_read_ahead_cb, serializer, this));
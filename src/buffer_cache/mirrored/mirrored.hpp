@@ -4,12 +4,16 @@
 
 #include <algorithm>
 #include <map>
+#include <set>
+#include <string>
 #include <utility>
 #include <vector>
 
 #include "arch/types.hpp"
+#include "arch/timing.hpp"
 #include "buffer_cache/types.hpp"
 #include "concurrency/access.hpp"
+#include "concurrency/auto_drainer.hpp"
 #include "concurrency/coro_fifo.hpp"
 #include "concurrency/fifo_checker.hpp"
 #include "concurrency/rwi_lock.hpp"
@@ -17,13 +21,16 @@
 #include "concurrency/mutex.hpp"
 #include "containers/intrusive_list.hpp"
 #include "containers/scoped.hpp"
+#include "buffer_cache/mirrored/compressed_tier.hpp"
 #include "buffer_cache/mirrored/config.hpp"
+#include "buffer_cache/mirrored/memory_broker.hpp"
 #include "buffer_cache/mirrored/stats.hpp"
+#include "buffer_cache/mirrored/working_set.hpp"
 #include "repli_timestamp.hpp"
 
 #include "buffer_cache/mirrored/writeback.hpp"
 
-#include "buffer_cache/mirrored/page_repl_random.hpp"
+#include "buffer_cache/mirrored/page_repl.hpp"
 
 #include "buffer_cache/mirrored/free_list.hpp"
 
@@ -42,7 +49,7 @@ class mc_inner_buf_t : public evictable_t,
     friend class mc_buf_lock_t;
     friend class writeback_t;
     friend class writeback_t::local_buf_t;
-    friend class page_repl_random_t;
+    friend class page_repl_t;
     friend class array_map_t;
 
     typedef uint64_t version_id_t;
@@ -60,12 +67,14 @@ class mc_inner_buf_t : public evictable_t,
     bool safe_to_unload();
     void unload();
 
-    // Load an existing buf from disk
-    mc_inner_buf_t(mc_cache_t *cache, block_id_t block_id, file_account_t *io_account);
+    // Load an existing buf from disk.  If `batch` isn't NULL, the buf gets locked and
+    // appended to it, and the caller has to load it with load_inner_bufs().
+    mc_inner_buf_t(mc_cache_t *cache, block_id_t block_id, file_account_t *io_account,
+                   std::vector<mc_inner_buf_t *> *batch = NULL);
 
     // Load an existing buf but use the provided data buffer (for read ahead)
     mc_inner_buf_t(mc_cache_t *cache, block_id_t block_id,
-                   scoped_malloc_t<ser_buffer_t> &&buf,
+                   scoped_ser_buffer_t &&buf,
                    const counted_t<standard_block_token_t>& token,
                    repli_timestamp_t recency_timestamp);
 
@@ -78,6 +87,11 @@ class mc_inner_buf_t : public evictable_t,
     // Loads data from the serializer.
     void load_inner_buf(bool should_lock, file_account_t *io_account);
 
+    // Loads the data of several bufs created with a `batch` with one call to
+    // serializer_t::block_reads(), and unlocks them.
+    static void load_inner_bufs(mc_cache_t *cache, const std::vector<mc_inner_buf_t *> &bufs,
+                                file_account_t *io_account);
+
     // Informs us that a certain data buffer (whether the current one or one used by a
     // buf_snapshot_t) has been written back to disk; used by writeback
     void update_data_token(const void *data, const counted_t<standard_block_token_t>& token);
@@ -131,6 +145,9 @@ private:
     // snapshot types' implementations are internal and deferred to mirrored.cc
     intrusive_list_t<buf_snapshot_t> snapshots;
 
+    // Derived from the contents of `data`, see mc_buf_lock_t::set_derived_data().
+    scoped_ptr_t<buf_derived_data_t> derived_data;
+
     DISABLE_COPYING(mc_inner_buf_t);
 };
 
@@ -184,9 +201,25 @@ public:
     eviction_priority_t get_eviction_priority() const;
     void set_eviction_priority(eviction_priority_t val);
 
+    // Keeps the block in memory until it's deleted, if there's room for it in the
+    // cache's pinned region, see page_repl.hpp.  The btrees use it for their
+    // internal nodes.
+    void pin_in_cache();
+
     repli_timestamp_t get_recency() const;
     void touch_recency(repli_timestamp_t timestamp);
 
+    // True if we see the current contents of the buf and nobody can change them
+    // while we hold it, that is if we are a non-snapshotted read lock.  Only then
+    // can we use the buf's derived data.
+    bool can_use_derived_data() const;
+    // The data last given to set_derived_data() for the buf, or NULL if there
+    // is none or the buf's contents have changed since.
+    buf_derived_data_t *get_derived_data() const;
+    // Attaches `derived_data` to the buf until its contents change or it gets
+    // unloaded, and takes ownership of it.
+    void set_derived_data(buf_derived_data_t *derived_data);
+
 private:
     friend class mc_cache_t;
     friend class mc_transaction_t;
@@ -259,18 +292,73 @@ public:
     // This just sets the snapshotted flag, we finalize the snapshot as soon as the first block has been acquired (see finalize_version() )
     void snapshot();
 
+    // Tells a snapshotted transaction that it goes over the leaves of a btree
+    // once, like a range scan does.  After pass_block(), writers no longer keep
+    // the version of the block this transaction sees, and the copies they kept of
+    // it so far are dropped, so the transaction must not acquire it again.
+    void set_single_pass();
+    void pass_block(block_id_t block_id);
+
+    // True if the block copies that writers keep for this snapshotted transaction
+    // take more than SNAPSHOT_SCAN_MAX_COPIED_BYTES.  A long scan can then stop
+    // and go on in a new transaction, which only needs copies of newer writes.
+    bool snapshot_over_budget() const;
+
     void set_account(mc_cache_account_t *cache_account);
 
     void set_token_pair(write_token_pair_t *_token_pair);
-    
+
+    // Bufs that get loaded for a CACHE_ACCESS_HINT_ONCE transaction are put on
+    // probation, and its cache hits don't count as a reuse of the buf.
+    void set_access_hint(cache_access_hint_t hint) { access_hint = hint; }
+    cache_access_hint_t get_access_hint() const { return access_hint; }
+
+    // Overrides the access hint for only the next block that the transaction
+    // acquires, prefetches or peeks at.  It must be called right before that,
+    // without yielding in between.  This way a scan can load its leaves with
+    // CACHE_ACCESS_HINT_ONCE while its superblock and internal nodes, and the
+    // blocks other coroutines of the transaction acquire, keep the normal hint.
+    void set_next_access_hint(cache_access_hint_t hint) {
+        has_next_access_hint = true;
+        next_access_hint = hint;
+    }
+
+    // Starts loading the block into the cache, if it isn't there already, and
+    // returns right away without acquiring it. The caller must make sure that the
+    // block can't be deleted in the meantime, for example by holding a lock on
+    // the node that references it.
+    void prefetch(block_id_t block_id);
+
+    // Like prefetch(), for blocks that are likely to be next to each other on disk,
+    // such as the leaves of a blob.  The serializer can read them together.
+    void prefetch(const std::vector<block_id_t> &block_ids);
+
+    // Returns the data of the block without acquiring it, if it's in the cache and
+    // a read lock on it would be granted right away, and otherwise NULL.  It only
+    // works for read transactions that aren't snapshotted.  The data is good until
+    // the coroutine yields, because nothing can change it before then.
+    const void *peek(block_id_t block_id);
+
+    // How many of the blocks this transaction acquired were in the cache, and how
+    // many blocks it had to load, including the ones it prefetched.
+    int64_t get_cache_hits() const { return num_cache_hits; }
+    int64_t get_block_loads() const { return num_block_loads; }
+
 private:
     void register_buf_snapshot(mc_inner_buf_t *inner_buf, mc_inner_buf_t::buf_snapshot_t *snap);
 
+    // True if pass_block() was called on the block, so that writers needn't keep
+    // its version for this transaction.
+    bool has_passed(block_id_t block_id) const;
+
     // If not done before, sets snapshot_version, if in snapshotted mode also registers the snapshot
     void maybe_finalize_version();
 
     file_account_t *get_io_account() const;
 
+    // The hint for the current access, which uses up set_next_access_hint().
+    cache_access_hint_t take_access_hint();
+
     // Note: Make sure that no automatic destructors do anything
     // interesting, they could get run on the WRONG THREAD!
     mc_cache_t *const cache;
@@ -285,10 +373,22 @@ private:
 
     mc_cache_account_t *cache_account;
 
-    std::vector<std::pair<mc_inner_buf_t*, mc_inner_buf_t::buf_snapshot_t*> > owned_buf_snapshots;
+    cache_access_hint_t access_hint;
+    bool has_next_access_hint;
+    cache_access_hint_t next_access_hint;
+
+    // Keyed by block id, so that pass_block() can release them early.
+    std::multimap<block_id_t, std::pair<mc_inner_buf_t*, mc_inner_buf_t::buf_snapshot_t*> > owned_buf_snapshots;
+    int64_t num_buf_snapshots_registered;
+
+    bool single_pass;
+    std::set<block_id_t> passed_blocks;
 
     int64_t num_buf_locks_acquired;
 
+    int64_t num_cache_hits;
+    int64_t num_block_loads;
+
     const bool is_writeback_transaction;
 
     const write_durability_t durability;
@@ -310,13 +410,14 @@ private:
     DISABLE_COPYING(mc_cache_account_t);
 };
 
-class mc_cache_t : public home_thread_mixin_t, public serializer_read_ahead_callback_t {
+class mc_cache_t : public home_thread_mixin_t, public serializer_read_ahead_callback_t,
+                   private repeating_timer_callback_t {
     friend class mc_inner_buf_t;
     friend class mc_buf_lock_t;
     friend class mc_transaction_t;
     friend class writeback_t;
     friend class writeback_t::local_buf_t;
-    friend class page_repl_random_t;
+    friend class page_repl_t;
     friend class evictable_t;
     friend class array_map_t;
 
@@ -333,12 +434,22 @@ public:
 
     // TODO: Come up with a consistent priority scheme, i.e. define a "default" priority etc.
     // TODO: As soon as we can support it, we might consider supporting a mem_cap paremeter.
-    void create_cache_account(int priority, scoped_ptr_t<mc_cache_account_t> *out);
+    // The accounts are background accounts (warmup, backfills, secondary index
+    // construction), whose I/O can be held back while foreground reads are slow.
+    // Their I/O counts for `activity` in the serializer's stats.
+    void create_cache_account(int priority, io_activity_t activity,
+                              scoped_ptr_t<mc_cache_account_t> *out);
 
     bool contains_block(block_id_t block_id);
 
     unsigned int num_blocks();
 
+    /* Prefetches the blocks listed in the warm-up manifest at `path` (if there is
+    one) in the background, in the order in which they are stored on disk. When
+    the cache is shut down, it writes a new manifest of the blocks that are in
+    memory at that point to `path`. */
+    void enable_warmup_manifest(const std::string &path);
+
     mc_inner_buf_t::version_id_t get_current_version_id() { return next_snapshot_version; }
 
     // must be O(1)
@@ -359,15 +470,17 @@ private:
         return active_snapshots.lower_bound(from_version) == active_snapshots.upper_bound(to_version);
     }
 
+    // Both skip the snapshots that have passed `inner_buf`'s block, see
+    // mc_transaction_t::pass_block().
     size_t register_buf_snapshot(mc_inner_buf_t *inner_buf, mc_inner_buf_t::buf_snapshot_t *snap, mc_inner_buf_t::version_id_t snapshotted_version, mc_inner_buf_t::version_id_t new_version);
-    size_t calculate_snapshots_affected(mc_inner_buf_t::version_id_t snapshotted_version, mc_inner_buf_t::version_id_t new_version);
+    size_t calculate_snapshots_affected(block_id_t block_id, mc_inner_buf_t::version_id_t snapshotted_version, mc_inner_buf_t::version_id_t new_version);
 
     mc_inner_buf_t *find_buf(block_id_t block_id);
     void on_transaction_commit(mc_transaction_t *txn);
 
 public:
     void offer_read_ahead_buf(block_id_t block_id,
-                              scoped_malloc_t<ser_buffer_t> *buf,
+                              scoped_ser_buffer_t *buf,
                               const counted_t<standard_block_token_t>& token,
                               repli_timestamp_t recency_timestamp);
 
@@ -381,6 +494,11 @@ private:
     bool can_read_ahead_block_be_accepted(block_id_t block_id);
     void maybe_unregister_read_ahead_callback();
 
+    // Reports our misses to the memory broker and adopts the size it gives us.
+    void on_ring();
+
+    void warm_up(const std::vector<block_id_t> &block_ids, auto_drainer_t::lock_t keepalive);
+
 public:
     coro_fifo_t& co_begin_coro_fifo() { return co_begin_coro_fifo_; }
 
@@ -398,6 +516,8 @@ private:
     serializer_t *serializer;
     scoped_ptr_t<mc_cache_stats_t> stats;
 
+    working_set_estimator_t working_set;
+
     // We use a separate IO account for reads and writes, so reads can pass ahead
     // of active writebacks. Otherwise writebacks could badly block out readers,
     // thereby blocking user queries.
@@ -405,7 +525,9 @@ private:
     scoped_ptr_t<file_account_t> writes_io_account;
 
     array_map_t page_map;
-    page_repl_random_t page_repl;
+    scoped_ptr_t<page_repl_t> page_repl;
+    // Only initialized if dynamic_config.compressed_tier_size is nonzero.
+    scoped_ptr_t<compressed_tier_t> compressed_tier;
     writeback_t writeback;
     array_free_list_t free_list;
 
@@ -428,6 +550,20 @@ private:
 
     coro_fifo_t co_begin_coro_fifo_;
 
+    // Only initialized if dynamic_config.use_memory_broker is set.
+    scoped_ptr_t<memory_broker_t::registration_t> memory_broker_registration;
+    scoped_ptr_t<repeating_timer_t> memory_broker_timer;
+    int64_t misses_since_memory_broker_report;
+
+    // Where we write our warm-up manifest on shutdown, empty if we don't.
+    std::string warmup_manifest_path;
+    // While the warm-up reads a batch of blocks, this is the set of block ids that
+    // got loaded into or removed from the page map (the data we read for those
+    // might be out of date). NULL otherwise.
+    std::set<block_id_t> *warmup_conflicts;
+    scoped_ptr_t<mc_cache_account_t> warmup_cache_account;
+    scoped_ptr_t<auto_drainer_t> warmup_drainer;
+
     DISABLE_COPYING(mc_cache_t);
 };
 
@@ -9,6 +9,10 @@ void array_map_t::constructing_inner_buf(mc_inner_buf_t *gbuf) {
     rassert(map->array.get(id) == NULL);
     map->array.set(id, gbuf);
     ++map->count;
+
+    if (gbuf->cache->warmup_conflicts != NULL) {
+        gbuf->cache->warmup_conflicts->insert(id);
+    }
 }
 
 void array_map_t::destroying_inner_buf(mc_inner_buf_t *gbuf) {
@@ -18,4 +22,8 @@ void array_map_t::destroying_inner_buf(mc_inner_buf_t *gbuf) {
     rassert(map->array.get(id) != NULL);
     map->array.set(id, NULL);
     --map->count;
+
+    if (gbuf->cache->warmup_conflicts != NULL) {
+        gbuf->cache->warmup_conflicts->insert(id);
+    }
 }
@@ -2,7 +2,7 @@
 #ifndef BUFFER_CACHE_MIRRORED_PAGE_MAP_HPP_
 #define BUFFER_CACHE_MIRRORED_PAGE_MAP_HPP_
 
-#include "containers/two_level_array.hpp"
+#include "containers/open_addressed_map.hpp"
 #include "config/args.hpp"
 #include "buffer_cache/types.hpp"
 #include "serializer/types.hpp"
@@ -20,6 +20,12 @@ public:
     static void constructing_inner_buf(mc_inner_buf_t *gbuf);
     static void destroying_inner_buf(mc_inner_buf_t *gbuf);
 
+    // Sizes the map for `expected_num_pages` bufs, so that it doesn't have to
+    // rehash while the cache warms up.
+    void reserve(size_t expected_num_pages) {
+        array.reserve(expected_num_pages);
+    }
+
     mc_inner_buf_t *find(block_id_t block_id) {
         return array.get(block_id);
     }
@@ -29,7 +35,7 @@ public:
     }
 
 private:
-    two_level_array_t<mc_inner_buf_t *> array;
+    open_addressed_map_t<mc_inner_buf_t *> array;
 
     // The count of non-null array entries.
     size_t count;
@@ -0,0 +1,282 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "buffer_cache/mirrored/page_repl.hpp"
+
+#include "buffer_cache/mirrored/mirrored.hpp"
+#include "buffer_cache/mirrored/page_repl_clock.hpp"
+#include "buffer_cache/mirrored/page_repl_random.hpp"
+
+evictable_t::evictable_t(mc_cache_t *_cache, bool loaded)
+    : eviction_priority(DEFAULT_EVICTION_PRIORITY), cache(_cache),
+      page_repl_index(static_cast<size_t>(-1)),
+      probation_index(static_cast<size_t>(-1)),
+      page_repl_pinned(false),
+      page_repl_referenced(false),
+      page_repl_hot(false)
+{
+    cache->assert_thread();
+    if (loaded) {
+        insert_into_page_repl();
+    }
+}
+
+evictable_t::~evictable_t() {
+    cache->assert_thread();
+
+    // It's the subclass destructor's responsibility to run
+    //
+    //     if (in_page_repl()) { remove_from_page_repl(); }
+    rassert(!in_page_repl());
+}
+
+bool evictable_t::in_page_repl() {
+    return page_repl_index != static_cast<size_t>(-1);
+}
+
+void evictable_t::insert_into_page_repl() {
+    cache->assert_thread();
+    page_repl_t *page_repl = cache->page_repl.get();
+    page_repl_index = page_repl->array.size();
+    page_repl->array.push_back(this);
+    page_repl->on_insert(this);
+}
+
+void evictable_t::remove_from_page_repl() {
+    cache->assert_thread();
+    page_repl_t *page_repl = cache->page_repl.get();
+
+    if (page_repl_pinned) {
+        page_repl_t::remove_from_dense_array(&page_repl->pinned, this);
+        page_repl_pinned = false;
+        --cache->stats->pm_n_blocks_pinned;
+    } else {
+        if (on_probation()) {
+            page_repl->remove_from_probation(this);
+        }
+        page_repl->on_remove(this);
+        page_repl_t::remove_from_dense_array(&page_repl->array, this);
+    }
+}
+
+void evictable_t::touch_in_page_repl() {
+    cache->assert_thread();
+    if (in_page_repl() && !page_repl_pinned) {
+        if (on_probation()) {
+            cache->page_repl->remove_from_probation(this);
+        }
+        cache->page_repl->on_access(this);
+    }
+}
+
+void evictable_t::put_on_probation() {
+    cache->assert_thread();
+    if (in_page_repl() && !page_repl_pinned && !on_probation()) {
+        page_repl_t *page_repl = cache->page_repl.get();
+        probation_index = page_repl->probation.size();
+        page_repl->probation.push_back(this);
+    }
+}
+
+bool evictable_t::on_probation() const {
+    return probation_index != static_cast<size_t>(-1);
+}
+
+void evictable_t::pin_in_page_repl() {
+    cache->assert_thread();
+    if (in_page_repl() && !page_repl_pinned) {
+        cache->page_repl->pin(this);
+    }
+}
+
+bool evictable_t::pinned() const {
+    return page_repl_pinned;
+}
+
+page_repl_t::page_repl_t(size_t _unload_threshold, cache_t *_cache)
+    : unload_threshold(_unload_threshold),
+      cache(_cache)
+    {}
+
+page_repl_t::~page_repl_t() {
+    rassert(array.empty());
+    rassert(probation.empty());
+    rassert(pinned.empty());
+}
+
+void page_repl_t::remove_from_dense_array(segmented_vector_t<evictable_t *> *bufs,
+                                          evictable_t *buf) {
+    rassert(buf->page_repl_index < bufs->size());
+    evictable_t *replacement = bufs->back();
+    replacement->page_repl_index = buf->page_repl_index;
+    std::swap((*bufs)[buf->page_repl_index], bufs->back());
+    bufs->pop_back();
+    buf->page_repl_index = static_cast<size_t>(-1);
+}
+
+void page_repl_t::remove_from_probation(evictable_t *buf) {
+    rassert(buf->probation_index < probation.size());
+    evictable_t *replacement = probation.back();
+    replacement->probation_index = buf->probation_index;
+    std::swap(probation[buf->probation_index], probation.back());
+    probation.pop_back();
+    buf->probation_index = static_cast<size_t>(-1);
+}
+
+size_t page_repl_t::probation_limit() const {
+    return std::max<size_t>(1, unload_threshold * PAGE_REPL_PROBATION_FRACTION);
+}
+
+evictable_t *page_repl_t::choose_probationary_candidate() {
+    if (probation.empty()) {
+        return NULL;
+    }
+    // Most probationary bufs are unused leaves of a scan, so a few random picks
+    // almost always find one that is safe to unload.
+    for (int tries = PAGE_REPL_NUM_TRIES; tries > 0; --tries) {
+        evictable_t *buf = probation[randint(static_cast<int>(probation.size()))];
+        if (buf->safe_to_unload()) {
+            return buf;
+        }
+    }
+    return NULL;
+}
+
+size_t page_repl_t::pinned_limit() const {
+    return unload_threshold * cache->dynamic_config.pinned_fraction;
+}
+
+void page_repl_t::pin(evictable_t *buf) {
+    rassert(!buf->page_repl_pinned);
+    const size_t limit = pinned_limit();
+    if (limit == 0) {
+        return;
+    }
+
+    if (pinned.size() >= limit) {
+        // Out of a few random picks, the pinned buf that's the furthest down its
+        // btree makes room for `buf`, if `buf` is further up than it.
+        evictable_t *victim = NULL;
+        for (int tries = PAGE_REPL_NUM_TRIES; tries > 0; --tries) {
+            evictable_t *candidate = pinned[randint(static_cast<int>(pinned.size()))];
+            if (victim == NULL || victim->eviction_priority < candidate->eviction_priority) {
+                victim = candidate;
+            }
+        }
+        if (!(buf->eviction_priority < victim->eviction_priority)) {
+            return;
+        }
+        unpin(victim);
+    }
+
+    if (buf->on_probation()) {
+        remove_from_probation(buf);
+    }
+    on_remove(buf);
+    remove_from_dense_array(&array, buf);
+    buf->page_repl_index = pinned.size();
+    pinned.push_back(buf);
+    buf->page_repl_pinned = true;
+    ++cache->stats->pm_n_blocks_pinned;
+}
+
+void page_repl_t::unpin(evictable_t *buf) {
+    rassert(buf->page_repl_pinned);
+    remove_from_dense_array(&pinned, buf);
+    buf->page_repl_pinned = false;
+    --cache->stats->pm_n_blocks_pinned;
+    buf->insert_into_page_repl();
+}
+
+void page_repl_t::evict(evictable_t *buf) {
+    // Remove it from the page repl and call its callback. Need to remove it from the repl first
+    // because its callback could delete it.
+    buf->remove_from_page_repl();
+    buf->unload();
+    ++cache->stats->pm_n_blocks_evicted;
+}
+
+bool page_repl_t::is_full(size_t space_needed) {
+    cache->assert_thread();
+    return array.size() + pinned.size() + space_needed > unload_threshold;
+}
+
+// make_space tries to make sure that the number of blocks currently in memory is at least
+// 'space_needed' less than the user-specified memory limit.
+void page_repl_t::make_space(size_t space_needed) {
+    cache->assert_thread();
+    // `target` is how many free blocks we want to have when we return.
+    size_t target;
+    if (space_needed > unload_threshold) {
+        // We cannot accomplish our goal of having at least `space_needed` less
+        // blocks in memory than the memory limit (`unload_threshold`), because
+        // `space_needed` is too large.
+        // However we try to get as close as possible by unloading as many blocks
+        // as we can.
+        target = 0;
+    } else {
+        target = unload_threshold - space_needed;
+    }
+
+    // The cache may have shrunk since the bufs were pinned.
+    while (pinned.size() > pinned_limit()) {
+        unpin(pinned.back());
+    }
+
+    // Keep the probationary region small, even if the cache isn't full yet.
+    while (probation.size() > probation_limit()) {
+        evictable_t *block_to_unload = choose_probationary_candidate();
+        if (!block_to_unload) {
+            break;
+        }
+        evict(block_to_unload);
+    }
+
+    while (array.size() + pinned.size() > target) {
+        // Try to find a block we can unload. Blocks are ineligible to be unloaded if they are
+        // dirty or in use. Bufs on probation go first, pinned bufs never do.
+        evictable_t *block_to_unload = choose_probationary_candidate();
+        if (!block_to_unload && !array.empty()) {
+            block_to_unload = choose_eviction_candidate();
+        }
+
+        if (!block_to_unload) {
+            // The following log message blows the corostack because it has propensity to overlog.
+            // Commenting it out for 1.2. TODO: we might want to address it later in a different
+            // way (i.e. spawn_maybe?)
+            /*
+            if (array.size() > target + (target / 100) + 10)
+                logWRN("cache %p exceeding memory target. %d blocks in memory, %d dirty, target is %d.",
+                       cache, array.size(), cache->writeback.num_dirty_blocks(), target);
+            */
+            break;
+        }
+
+        evict(block_to_unload);
+    }
+}
+
+void page_repl_t::set_unload_threshold(size_t _unload_threshold) {
+    cache->assert_thread();
+    unload_threshold = _unload_threshold;
+}
+
+evictable_t *page_repl_t::get_first_buf() {
+    cache->assert_thread();
+    if (!array.empty()) {
+        return array[0];
+    }
+    return pinned.empty() ? NULL : pinned[0];
+}
+
+void make_page_repl(page_repl_policy_t policy, size_t unload_threshold,
+                    mc_cache_t *cache, scoped_ptr_t<page_repl_t> *out) {
+    switch (policy) {
+    case PAGE_REPL_POLICY_RANDOM:
+        out->init(new page_repl_random_t(unload_threshold, cache));
+        break;
+    case PAGE_REPL_POLICY_CLOCK:
+        out->init(new page_repl_clock_t(unload_threshold, cache));
+        break;
+    default:
+        unreachable();
+    }
+}
@@ -0,0 +1,160 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#ifndef BUFFER_CACHE_MIRRORED_PAGE_REPL_HPP_
+#define BUFFER_CACHE_MIRRORED_PAGE_REPL_HPP_
+
+#include "buffer_cache/types.hpp"
+#include "containers/segmented_vector.hpp"
+#include "containers/scoped.hpp"
+#include "buffer_cache/mirrored/config.hpp"
+
+/* Every page replacement policy keeps track of the bufs in memory using a dense
+array of evictable_t* in a completely arbitrary order. Each buf carries an index
+which is its position in the dense array. When a buf is removed from memory, the
+last buf in the array is moved to the slot it last occupied, keeping the array
+dense. This allows insertion and deletion to be done in constant time. The
+policies differ only in how they pick a victim from that array (and in what
+per-buf state they keep for doing so).
+
+Independently of the policy, bufs can be put on "probation". Probationary bufs are
+additionally tracked in a second dense array. They are always considered for
+eviction first and there can be at most PAGE_REPL_PROBATION_FRACTION of the cache
+of them, so streaming access can't push out the rest of the cache.
+
+The btrees also pin their internal nodes, which takes them out of the dense array
+and puts them in a third one which the policies never see, so they aren't evicted
+at all.  The pinned bufs may take up `pinned_fraction` of the cache (see
+mirrored_cache_config_t).  When that's full, a buf only gets pinned if it has a
+lower eviction priority, that is, it's higher up in its btree, than the one it
+replaces, so the region ends up holding the upper levels of every btree. */
+
+class mc_cache_t;
+class page_repl_t;
+
+class evictable_t {
+public:
+    explicit evictable_t(mc_cache_t *cache, bool loaded = true);
+    // removes us from the page repl if necessary; does not call unload()
+    virtual ~evictable_t();
+    // Returns true if this object can be unloaded from the cache.
+    virtual bool safe_to_unload() = 0;
+    // Called when the page replacement policy decides to evict this object. Must
+    // relinquish the buf associated with this object.
+    virtual void unload() = 0;
+
+    bool in_page_repl();
+    void insert_into_page_repl();
+    void remove_from_page_repl(); // does *not* call unload()
+
+    // Tells the page replacement policy that this object has been accessed
+    // again after it was loaded. Takes it out of probation.
+    void touch_in_page_repl();
+
+    // Puts this object on probation, it will be evicted before any object that
+    // isn't. Used for bufs that were loaded by a CACHE_ACCESS_HINT_ONCE transaction.
+    void put_on_probation();
+    bool on_probation() const;
+
+    // Keeps this object in memory until it's deleted, if there's room in the
+    // pinned region of the cache.  Does nothing if it's pinned already.
+    void pin_in_page_repl();
+    bool pinned() const;
+
+    /* The eviction priority represents how bad of a choice a buf is for
+     * eviction the buffer cache will (probabalistically) evict blocks of
+     * lower priority first. */
+    eviction_priority_t eviction_priority;
+
+protected:
+    mc_cache_t *cache;
+private:
+    friend class page_repl_t;
+    friend class page_repl_clock_t;
+
+    // Our position in `page_repl_t::array`, or in `page_repl_t::pinned` if we're
+    // pinned.
+    size_t page_repl_index;
+    // Our position in `page_repl_t::probation`, or -1.
+    size_t probation_index;
+    bool page_repl_pinned;
+
+    // Per-buf state that is only used by some of the policies.
+    bool page_repl_referenced;
+    bool page_repl_hot;
+};
+
+class page_repl_t {
+    typedef mc_cache_t cache_t;
+    friend class evictable_t;
+
+public:
+    page_repl_t(size_t _unload_threshold, cache_t *_cache);
+    virtual ~page_repl_t();
+
+    // If is_full(space_needed), the next call to make_space(space_needed) probably
+    // has to evict something
+    bool is_full(size_t space_needed);
+
+    // make_space tries to make sure that the number of blocks currently in memory is
+    // at least 'space_needed' less than the user-specified memory limit.
+    void make_space(size_t space_needed = 0);
+
+    // Changes the number of blocks the cache may hold. Doesn't evict anything by
+    // itself, the next call to make_space() does.
+    void set_unload_threshold(size_t _unload_threshold);
+
+    /* The page replacement component actually serves two roles. In addition to its
+    primary role as a mechanism for kicking out buffers when memory runs low, it also
+    has the job of keeping track of all of the buffers in memory in such a way that
+    the cache can quickly request a pointer to the next buffer in memory. This is
+    used during the cache's destructor. The rationale is that any reasonable
+    implementation of a page replacement system will need to keep track of all of the
+    buffers in memory anyway, so the cache can depend on the page replacement
+    system's buffer list rather than keeping a buffer list of its own. */
+    evictable_t *get_first_buf();
+
+protected:
+    // Returns a buf which is safe to unload, or NULL if the policy could not
+    // find one. The returned buf is still in the page repl.
+    virtual evictable_t *choose_eviction_candidate() = 0;
+
+    // Notifications about changes to `array`. `on_remove()` is called before the
+    // buf is taken out of the array.
+    virtual void on_insert(UNUSED evictable_t *buf) { }
+    virtual void on_remove(UNUSED evictable_t *buf) { }
+    virtual void on_access(UNUSED evictable_t *buf) { }
+
+    size_t unload_threshold;
+    cache_t *cache;
+    segmented_vector_t<evictable_t *> array;
+
+private:
+    size_t probation_limit() const;
+    // Like `choose_eviction_candidate()`, but only considers probationary bufs.
+    evictable_t *choose_probationary_candidate();
+    void evict(evictable_t *buf);
+
+    void remove_from_probation(evictable_t *buf);
+
+    size_t pinned_limit() const;
+    void pin(evictable_t *buf);
+    void unpin(evictable_t *buf);
+
+    // Takes `buf` out of `bufs`, which is `array` or `pinned`, and moves the last
+    // buf into its slot.
+    static void remove_from_dense_array(segmented_vector_t<evictable_t *> *bufs,
+                                        evictable_t *buf);
+
+    // The bufs that are on probation, a subset of `array`.
+    segmented_vector_t<evictable_t *> probation;
+
+    // The bufs that are pinned.  They aren't in `array`.
+    segmented_vector_t<evictable_t *> pinned;
+
+    DISABLE_COPYING(page_repl_t);
+};
+
+// Constructs the page replacement policy selected by `policy`.
+void make_page_repl(page_repl_policy_t policy, size_t unload_threshold,
+                    mc_cache_t *cache, scoped_ptr_t<page_repl_t> *out);
+
+#endif  // BUFFER_CACHE_MIRRORED_PAGE_REPL_HPP_
@@ -0,0 +1,82 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "buffer_cache/mirrored/page_repl_clock.hpp"
+
+#include "buffer_cache/mirrored/mirrored.hpp"
+
+page_repl_clock_t::page_repl_clock_t(size_t _unload_threshold, cache_t *_cache)
+    : page_repl_t(_unload_threshold, _cache),
+      hand(0),
+      num_hot(0)
+    {}
+
+size_t page_repl_clock_t::hot_target() const {
+    const size_t cold_target
+        = std::max<size_t>(1, unload_threshold * PAGE_REPL_CLOCK_COLD_FRACTION);
+    return unload_threshold > cold_target ? unload_threshold - cold_target : 0;
+}
+
+void page_repl_clock_t::on_insert(evictable_t *buf) {
+    buf->page_repl_referenced = false;
+    buf->page_repl_hot = false;
+}
+
+void page_repl_clock_t::on_remove(evictable_t *buf) {
+    if (buf->page_repl_hot) {
+        rassert(num_hot > 0);
+        --num_hot;
+        buf->page_repl_hot = false;
+    }
+}
+
+void page_repl_clock_t::on_access(evictable_t *buf) {
+    buf->page_repl_referenced = true;
+}
+
+evictable_t *page_repl_clock_t::choose_eviction_candidate() {
+    // Every referenced buf gets its bit cleared the first time we pass it, so two
+    // full revolutions are enough to find a victim if there is one.
+    size_t steps_left = 2 * array.size() + 1;
+    const size_t max_hot = hot_target();
+
+    // Like the random policy, we look at a few cold bufs that could go and evict
+    // the one with the highest eviction priority, so that bufs near the root of a
+    // btree outlast the leaves below them.
+    evictable_t *victim = NULL;
+    int candidates_left = PAGE_REPL_NUM_TRIES;
+
+    while (steps_left > 0) {
+        --steps_left;
+        if (hand >= array.size()) {
+            hand = 0;
+        }
+        evictable_t *buf = array[hand];
+
+        if (buf->page_repl_hot) {
+            if (buf->page_repl_referenced) {
+                buf->page_repl_referenced = false;
+            } else if (num_hot > max_hot) {
+                buf->page_repl_hot = false;
+                --num_hot;
+            }
+        } else if (buf->page_repl_referenced) {
+            // The buf was reused while it was cold.
+            buf->page_repl_referenced = false;
+            buf->page_repl_hot = true;
+            ++num_hot;
+        } else if (buf->safe_to_unload()) {
+            if (victim == NULL || victim->eviction_priority < buf->eviction_priority) {
+                victim = buf;
+            }
+            --candidates_left;
+            if (candidates_left == 0) {
+                // We leave the hand where it is. If `buf` is the victim, removing
+                // it from the array moves the last buf into its slot, which is then
+                // the next one we look at. Otherwise `buf` stays a candidate.
+                break;
+            }
+        }
+        ++hand;
+    }
+
+    return victim;
+}
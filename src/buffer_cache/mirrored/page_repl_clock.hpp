@@ -0,0 +1,47 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#ifndef BUFFER_CACHE_MIRRORED_PAGE_REPL_CLOCK_HPP_
+#define BUFFER_CACHE_MIRRORED_PAGE_REPL_CLOCK_HPP_
+
+#include "buffer_cache/mirrored/page_repl.hpp"
+#include "config/args.hpp"
+
+/* A scan-resistant page replacement policy in the spirit of CLOCK-Pro. The dense
+page repl array doubles as the clock; a single hand sweeps over it.
+
+Every buf is either "cold" or "hot". Freshly loaded bufs start out cold. A buf that
+gets accessed again while it is cold has proven that it is reused, and gets promoted
+to hot the next time the hand passes it. Only cold bufs are ever evicted, and out of
+the next PAGE_REPL_NUM_TRIES cold bufs the hand passes, the one with the highest
+eviction priority goes first. Hot bufs get a second chance through their reference
+bit. When the number of hot bufs exceeds
+its target, unreferenced hot bufs get demoted to cold as the hand passes them.
+
+A scan touches each of its bufs only once, so its pages never leave the cold region,
+which is limited to PAGE_REPL_CLOCK_COLD_FRACTION of the cache. That way a large scan
+can only churn through the cold region and leaves the hot working set alone.
+
+Unlike the full CLOCK-Pro algorithm we don't keep metadata for non-resident pages,
+so the size of the cold region is fixed rather than adaptive. */
+
+class page_repl_clock_t : public page_repl_t {
+    typedef mc_cache_t cache_t;
+
+public:
+    page_repl_clock_t(size_t _unload_threshold, cache_t *_cache);
+
+private:
+    evictable_t *choose_eviction_candidate();
+    void on_insert(evictable_t *buf);
+    void on_remove(evictable_t *buf);
+    void on_access(evictable_t *buf);
+
+    size_t hot_target() const;
+
+    // The position of the clock hand in `array`.
+    size_t hand;
+
+    // The number of bufs in `array` that are hot.
+    size_t num_hot;
+};
+
+#endif  // BUFFER_CACHE_MIRRORED_PAGE_REPL_CLOCK_HPP_
@@ -26,6 +26,7 @@ mc_cache_stats_t::mc_cache_stats_t(perfmon_collection_t *parent)
       cache_membership(parent, &cache_collection, "cache"),
       pm_registered_snapshots(),
       pm_registered_snapshot_blocks(),
+      pm_passed_snapshot_blocks(),
       pm_snapshots_per_transaction(secs_to_ticks(1), false),
       pm_cache_hits(),
       pm_cache_misses(),
@@ -34,19 +35,30 @@ mc_cache_stats_t::mc_cache_stats_t(perfmon_collection_t *parent)
       pm_transactions_starting(secs_to_ticks(1)),
       pm_transactions_active(secs_to_ticks(1)),
       pm_transactions_committing(secs_to_ticks(1)),
+      pm_transactions_durable_commit(secs_to_ticks(1)),
       pm_flushes_locking(secs_to_ticks(60)),
       pm_flushes_writing(secs_to_ticks(60)),
       pm_flushes_blocks(secs_to_ticks(1), true),
       pm_flushes_blocks_dirty(secs_to_ticks(1), true),
+      pm_flushes_commit_batch(secs_to_ticks(1), true),
       pm_throttling_waiting(secs_to_ticks(10)),
       pm_n_blocks_in_memory(),
       pm_n_blocks_dirty(),
       pm_n_blocks_total(),
       pm_n_blocks_evicted(),
+      pm_n_blocks_pinned(),
+      pm_n_blocks_prefetched(),
+      pm_compressed_tier_blocks(),
+      pm_compressed_tier_bytes(),
+      pm_compressed_tier_hits(),
+      pm_compressed_tier_rejected(),
+      pm_warmup_blocks_pending(),
+      pm_warmup_blocks_loaded(),
       pm_block_size(),
       cache_collection_membership(&cache_collection,
           &pm_registered_snapshots, "registered_snapshots",
           &pm_registered_snapshot_blocks, "registered_snapshot_blocks",
+          &pm_passed_snapshot_blocks, "passed_snapshot_blocks",
           &pm_snapshots_per_transaction, "snapshots_per_transaction",
           &pm_cache_hits, "cache_hits",
           &pm_cache_misses, "cache_misses",
@@ -55,15 +67,25 @@ mc_cache_stats_t::mc_cache_stats_t(perfmon_collection_t *parent)
           &pm_transactions_starting, "transactions_starting",
           &pm_transactions_active, "transactions_active",
           &pm_transactions_committing, "transactions_committing",
+          &pm_transactions_durable_commit, "transactions_durable_commit",
           &pm_throttling_waiting, "throttling_waiting",
           &pm_flushes_locking, "flushes_locking",
           &pm_flushes_writing, "flushes_writing",
           &pm_flushes_blocks, "flushes_blocks",
           &pm_flushes_blocks_dirty, "flushes_blocks_need_flush",
+          &pm_flushes_commit_batch, "flushes_commit_batch",
           &pm_n_blocks_in_memory, "blocks_in_memory",
           &pm_n_blocks_dirty, "blocks_dirty",
           &pm_n_blocks_total, "blocks_total",
           &pm_n_blocks_evicted, "blocks_evicted",
+          &pm_n_blocks_pinned, "blocks_pinned",
+          &pm_n_blocks_prefetched, "blocks_prefetched",
+          &pm_compressed_tier_blocks, "compressed_tier_blocks",
+          &pm_compressed_tier_bytes, "compressed_tier_bytes",
+          &pm_compressed_tier_hits, "compressed_tier_hits",
+          &pm_compressed_tier_rejected, "compressed_tier_rejected",
+          &pm_warmup_blocks_pending, "warmup_blocks_pending",
+          &pm_warmup_blocks_loaded, "warmup_blocks_loaded",
           &pm_block_size, "block_size",
           NULLPTR) { }
 
@@ -13,7 +13,8 @@ struct mc_cache_stats_t {
 
     perfmon_counter_t
         pm_registered_snapshots,
-        pm_registered_snapshot_blocks;
+        pm_registered_snapshot_blocks,
+        pm_passed_snapshot_blocks;
 
     perfmon_sampler_t pm_snapshots_per_transaction;
 
@@ -28,7 +29,8 @@ struct mc_cache_stats_t {
     perfmon_duration_sampler_t
         pm_transactions_starting,
         pm_transactions_active,
-        pm_transactions_committing;
+        pm_transactions_committing,
+        pm_transactions_durable_commit;
 
 
     /* Used in writeback.hpp */
@@ -38,7 +40,8 @@ struct mc_cache_stats_t {
 
     perfmon_sampler_t
         pm_flushes_blocks,
-        pm_flushes_blocks_dirty;
+        pm_flushes_blocks_dirty,
+        pm_flushes_commit_batch;
     
     perfmon_duration_sampler_t
         pm_throttling_waiting;
@@ -48,8 +51,23 @@ struct mc_cache_stats_t {
         pm_n_blocks_dirty,
         pm_n_blocks_total;
 
-    // used in buffer_cache/mirrored/page_repl_random.cc
+    // used in buffer_cache/mirrored/page_repl.cc
     perfmon_counter_t pm_n_blocks_evicted;
+    perfmon_counter_t pm_n_blocks_pinned;
+
+    perfmon_counter_t pm_n_blocks_prefetched;
+
+    // used in buffer_cache/mirrored/compressed_tier.cc
+    perfmon_counter_t
+        pm_compressed_tier_blocks,
+        pm_compressed_tier_bytes,
+        pm_compressed_tier_hits,
+        pm_compressed_tier_rejected;
+
+    // used for replaying the warm-up manifest in buffer_cache/mirrored/mirrored.cc
+    perfmon_counter_t
+        pm_warmup_blocks_pending,
+        pm_warmup_blocks_loaded;
 
     /* This is for exposing the block size */
     struct perfmon_cache_custom_t : public perfmon_t {
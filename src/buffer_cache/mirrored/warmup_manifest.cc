@@ -0,0 +1,104 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "buffer_cache/mirrored/warmup_manifest.hpp"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "arch/io/io_utils.hpp"
+#include "logger.hpp"
+#include "utils.hpp"
+
+namespace {
+
+const char WARMUP_MANIFEST_MAGIC[8] = { 'r', 'd', 'b', 'w', 'a', 'r', 'm', '1' };
+
+struct warmup_manifest_header_t {
+    char magic[sizeof(WARMUP_MANIFEST_MAGIC)];
+    uint64_t num_block_ids;
+};
+
+bool write_all(fd_t fd, const char *data, size_t size) {
+    while (size > 0) {
+        ssize_t res;
+        do {
+            res = ::write(fd, data, size);
+        } while (res == -1 && errno == EINTR);
+        if (res == -1) {
+            return false;
+        }
+        data += res;
+        size -= res;
+    }
+    return true;
+}
+
+}  // namespace
+
+bool write_warmup_manifest(const std::string &path,
+                           const std::vector<block_id_t> &block_ids) {
+    const std::string temporary_path = path + ".tmp";
+
+    {
+        scoped_fd_t fd;
+        int res;
+        do {
+            res = ::open(temporary_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        } while (res == -1 && errno == EINTR);
+        if (res == -1) {
+            logWRN("Could not write cache warm-up manifest %s: %s",
+                   temporary_path.c_str(), errno_string(errno).c_str());
+            return false;
+        }
+        fd.reset(res);
+
+        warmup_manifest_header_t header;
+        memcpy(header.magic, WARMUP_MANIFEST_MAGIC, sizeof(header.magic));
+        header.num_block_ids = block_ids.size();
+        if (!write_all(fd.get(), reinterpret_cast<const char *>(&header), sizeof(header))
+            || !write_all(fd.get(), reinterpret_cast<const char *>(block_ids.data()),
+                          block_ids.size() * sizeof(block_id_t))) {
+            logWRN("Could not write cache warm-up manifest %s: %s",
+                   temporary_path.c_str(), errno_string(errno).c_str());
+            ::unlink(temporary_path.c_str());
+            return false;
+        }
+    }
+
+    if (::rename(temporary_path.c_str(), path.c_str()) != 0) {
+        logWRN("Could not move cache warm-up manifest to %s: %s",
+               path.c_str(), errno_string(errno).c_str());
+        ::unlink(temporary_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool take_warmup_manifest(const std::string &path,
+                          std::vector<block_id_t> *block_ids_out) {
+    std::string contents;
+    if (!blocking_read_file(path.c_str(), &contents)) {
+        return false;
+    }
+    const int res = ::unlink(path.c_str());
+    guarantee_err(res == 0 || errno == ENOENT,
+                  "unlink failed for file %s", path.c_str());
+
+    warmup_manifest_header_t header;
+    if (contents.size() < sizeof(header)) {
+        return false;
+    }
+    memcpy(&header, contents.data(), sizeof(header));
+    if (memcmp(header.magic, WARMUP_MANIFEST_MAGIC, sizeof(header.magic)) != 0
+        || (contents.size() - sizeof(header)) / sizeof(block_id_t) != header.num_block_ids
+        || (contents.size() - sizeof(header)) % sizeof(block_id_t) != 0) {
+        logWRN("Ignoring malformed cache warm-up manifest %s", path.c_str());
+        return false;
+    }
+
+    block_ids_out->resize(header.num_block_ids);
+    memcpy(block_ids_out->data(), contents.data() + sizeof(header),
+           header.num_block_ids * sizeof(block_id_t));
+    return true;
+}
@@ -0,0 +1,28 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#ifndef BUFFER_CACHE_MIRRORED_WARMUP_MANIFEST_HPP_
+#define BUFFER_CACHE_MIRRORED_WARMUP_MANIFEST_HPP_
+
+#include <string>
+#include <vector>
+
+#include "serializer/types.hpp"
+
+/* A warm-up manifest is a small file listing the blocks that were in a cache
+when it was shut down. A cache that is started again reads the blocks back in
+before they are asked for, see mc_cache_t::enable_warmup_manifest(). The file is
+a header followed by the block ids in native byte order, which is fine because
+the manifest is only a hint for the same process on the same machine. Both
+functions use blocking I/O. */
+
+// Writes a manifest for `block_ids` to `path`, replacing any existing manifest
+// atomically. Returns false if the manifest could not be written.
+MUST_USE bool write_warmup_manifest(const std::string &path,
+                                    const std::vector<block_id_t> &block_ids);
+
+// Reads the manifest at `path` and removes it, so that an unclean shutdown
+// doesn't leave a stale manifest behind. Returns false if there is no valid
+// manifest at `path`.
+MUST_USE bool take_warmup_manifest(const std::string &path,
+                                   std::vector<block_id_t> *block_ids_out);
+
+#endif  // BUFFER_CACHE_MIRRORED_WARMUP_MANIFEST_HPP_
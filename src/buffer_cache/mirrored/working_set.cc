@@ -0,0 +1,97 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#define __STDC_FORMAT_MACROS
+#include "buffer_cache/mirrored/working_set.hpp"
+
+#include <inttypes.h>
+
+#include <utility>
+
+working_set_estimator_t::counts_t::counts_t() : accesses(0) {
+    for (int i = 0; i < WORKING_SET_CACHE_SIZES; ++i) {
+        hits[i] = 0;
+    }
+}
+
+working_set_estimator_t::working_set_estimator_t(block_size_t _block_size,
+                                                 perfmon_collection_t *parent)
+    : block_size(_block_size.ser_value()),
+      perfmon(this),
+      perfmon_membership(parent, &perfmon, "working_set") { }
+
+void working_set_estimator_t::record_access(block_id_t block_id) {
+    assert_thread();
+
+    // The multiplication scatters consecutive block ids, so that the nodes of a
+    // btree that were allocated together are as likely to be sampled as any.
+    if (((block_id * 0x9e3779b97f4a7c15ULL) >> 32) % WORKING_SET_SAMPLING_RATE != 0) {
+        return;
+    }
+
+    std::map<block_id_t, std::list<block_id_t>::iterator>::iterator it
+        = positions.find(block_id);
+    if (it == positions.end()) {
+        // The first access is a miss for every cache size.
+        lru.push_front(block_id);
+        positions.insert(std::make_pair(block_id, lru.begin()));
+        if (positions.size() > WORKING_SET_MAX_SAMPLED_BLOCKS) {
+            positions.erase(lru.back());
+            lru.pop_back();
+        }
+    } else {
+        int64_t distance = 0;
+        for (std::list<block_id_t>::iterator jt = lru.begin(); jt != it->second; ++jt) {
+            ++distance;
+        }
+        lru.splice(lru.begin(), lru, it->second);
+
+        // The cache needs room for the block and for all the blocks acquired since.
+        const int64_t needed_bytes = (distance + 1) * WORKING_SET_SAMPLING_RATE * block_size;
+        int64_t cache_size = WORKING_SET_MIN_CACHE_SIZE;
+        for (int i = 0; i < WORKING_SET_CACHE_SIZES; ++i, cache_size *= 2) {
+            if (needed_bytes <= cache_size) {
+                ++counts.hits[i];
+            }
+        }
+    }
+
+    ++counts.accesses;
+    if (counts.accesses >= WORKING_SET_DECAY_ACCESSES) {
+        counts.accesses /= 2;
+        for (int i = 0; i < WORKING_SET_CACHE_SIZES; ++i) {
+            counts.hits[i] /= 2;
+        }
+    }
+}
+
+working_set_estimator_t::perfmon_working_set_t::perfmon_working_set_t(
+        working_set_estimator_t *_parent)
+    : parent(_parent) { }
+
+void *working_set_estimator_t::perfmon_working_set_t::begin_stats() {
+    return new counts_t;
+}
+
+void working_set_estimator_t::perfmon_working_set_t::visit_stats(void *ctx) {
+    // The counts may only be read on the cache's thread.
+    if (get_thread_id() == parent->home_thread()) {
+        *static_cast<counts_t *>(ctx) = parent->counts;
+    }
+}
+
+scoped_ptr_t<perfmon_result_t>
+working_set_estimator_t::perfmon_working_set_t::end_stats(void *ctx) {
+    scoped_ptr_t<counts_t> counts(static_cast<counts_t *>(ctx));
+    scoped_ptr_t<perfmon_result_t> result = perfmon_result_t::alloc_map_result();
+    result->insert("sampled_accesses",
+                   new perfmon_result_t(strprintf("%" PRIi64, counts->accesses)));
+    if (counts->accesses > 0) {
+        int64_t cache_size = WORKING_SET_MIN_CACHE_SIZE;
+        for (int i = 0; i < WORKING_SET_CACHE_SIZES; ++i, cache_size *= 2) {
+            result->insert(strprintf("hit_ratio_if_cache_%" PRIi64 "MB",
+                                     static_cast<int64_t>(cache_size / MEGABYTE)),
+                           new perfmon_result_t(strprintf("%.4f",
+                               static_cast<double>(counts->hits[i]) / counts->accesses)));
+        }
+    }
+    return result;
+}
@@ -0,0 +1,61 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#ifndef BUFFER_CACHE_MIRRORED_WORKING_SET_HPP_
+#define BUFFER_CACHE_MIRRORED_WORKING_SET_HPP_
+
+#include <list>
+#include <map>
+
+#include "config/args.hpp"
+#include "perfmon/perfmon.hpp"
+#include "serializer/types.hpp"
+
+/* The working set estimator tells what the hit ratio of a cache would be if it
+had room for more or fewer blocks.  For every block that is reused, it counts how
+many distinct blocks were acquired since the last time, the reuse distance.  An
+LRU cache with room for more blocks than that would have had a hit.
+
+Following all the blocks would cost too much, so it only follows the ones whose
+block ids hash to one in WORKING_SET_SAMPLING_RATE, and it scales their reuse
+distances up by as much.  The cache's `working_set` stat has the hit ratios for
+caches from WORKING_SET_MIN_CACHE_SIZE up, as `hit_ratio_if_cache_<N>MB`. */
+
+class working_set_estimator_t : public home_thread_mixin_t {
+public:
+    working_set_estimator_t(block_size_t block_size, perfmon_collection_t *parent);
+
+    // Called whenever a transaction acquires the block, whether it's a hit or not.
+    void record_access(block_id_t block_id);
+
+private:
+    class perfmon_working_set_t : public perfmon_t {
+    public:
+        explicit perfmon_working_set_t(working_set_estimator_t *parent);
+        void *begin_stats();
+        void visit_stats(void *ctx);
+        scoped_ptr_t<perfmon_result_t> end_stats(void *ctx);
+    private:
+        working_set_estimator_t *const parent;
+        DISABLE_COPYING(perfmon_working_set_t);
+    };
+
+    struct counts_t {
+        counts_t();
+        int64_t accesses;
+        int64_t hits[WORKING_SET_CACHE_SIZES];
+    };
+
+    const int64_t block_size;
+
+    // The sampled blocks, the most recently acquired first.
+    std::list<block_id_t> lru;
+    std::map<block_id_t, std::list<block_id_t>::iterator> positions;
+
+    counts_t counts;
+
+    perfmon_working_set_t perfmon;
+    perfmon_membership_t perfmon_membership;
+
+    DISABLE_COPYING(working_set_estimator_t);
+};
+
+#endif  // BUFFER_CACHE_MIRRORED_WORKING_SET_HPP_
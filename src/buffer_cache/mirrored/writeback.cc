@@ -8,6 +8,7 @@
 
 #include "arch/runtime/coroutines.hpp"
 #include "arch/runtime/runtime.hpp"
+#include "arch/timing.hpp"
 #include "buffer_cache/mirrored/mirrored.hpp"
 #include "containers/scoped.hpp"
 #include "perfmon/perfmon.hpp"
@@ -22,22 +23,38 @@ writeback_t::writeback_t(
         unsigned int _flush_timer_ms,
         unsigned int _flush_threshold,
         unsigned int _max_dirty_blocks,
-        unsigned int _max_concurrent_flushes
+        unsigned int _max_concurrent_flushes,
+        bool use_dirty_budget,
+        bool _adaptive_flush
         ) :
     max_concurrent_flushes(_max_concurrent_flushes),
     max_dirty_blocks(_max_dirty_blocks),
     flush_time_randomizer(_flush_timer_ms),
     flush_threshold(_flush_threshold),
     flush_timer(NULL),
+    adaptive_flush(_adaptive_flush),
+    group_commit_timer(NULL),
+    num_active_write_transactions(0),
+    flush_latency_ms(0),
     writeback_in_progress(false),
     active_flushes(0),
     dirty_block_semaphore(_max_dirty_blocks),
     cache(_cache),
+    last_backpressure(0),
     start_next_sync_immediately(false),
     to_pulse_when_last_active_flush_finishes(NULL) {
 
     rassert(max_dirty_blocks >= 10); // sanity check: you really don't want to have less than this.
                                      // 10 is rather arbitrary.
+
+    group_commit_timer_callback.parent = this;
+
+    if (use_dirty_budget) {
+        const int64_t block_size = cache->serializer->get_block_size().ser_value();
+        dirty_budget_registration.init(
+            new dirty_budget_t::registration_t(get_global_dirty_budget(),
+                                               max_dirty_blocks * block_size));
+    }
 }
 
 writeback_t::~writeback_t() {
@@ -48,6 +65,10 @@ writeback_t::~writeback_t() {
         cancel_timer(flush_timer);
         flush_timer = NULL;
     }
+    if (group_commit_timer != NULL) {
+        cancel_timer(group_commit_timer);
+        group_commit_timer = NULL;
+    }
 }
 
 writeback_t::local_buf_t::local_buf_t() {
@@ -78,6 +99,12 @@ void writeback_t::sync(sync_callback_t *callback) {
         sync_callbacks.push_back(callback);
     }
 
+    // Whatever the group commit was waiting for will be part of this sync.
+    if (group_commit_timer != NULL) {
+        cancel_timer(group_commit_timer);
+        group_commit_timer = NULL;
+    }
+
     if (!writeback_in_progress && active_flushes < max_concurrent_flushes) {
         /* Start the writeback process immediately */
         start_concurrent_flush();
@@ -95,6 +122,55 @@ void writeback_t::sync_patiently(sync_callback_t *callback) {
     }
 }
 
+void writeback_t::schedule_group_commit() {
+    rassert(adaptive_flush);
+    rassert(!sync_callbacks.empty());
+
+    // Waiting only makes sense if there are other writers that could join us.
+    int64_t delay_ms = 0;
+    if (num_active_write_transactions > 0) {
+        delay_ms = std::min<int64_t>(WRITEBACK_GROUP_COMMIT_MAX_DELAY_MS,
+                                     flush_latency_ms * WRITEBACK_GROUP_COMMIT_DELAY_FRACTION);
+    }
+
+    if (delay_ms == 0 || sync_callbacks.size() >= WRITEBACK_GROUP_COMMIT_BATCH_SIZE) {
+        sync(NULL);
+    } else if (group_commit_timer == NULL) {
+        group_commit_timer = fire_timer_once(delay_ms, &group_commit_timer_callback);
+    }
+}
+
+void writeback_t::on_group_commit_timer() {
+    group_commit_timer = NULL;
+    cache->assert_thread();
+    if (!sync_callbacks.empty()) {
+        sync(NULL);
+    }
+}
+
+double writeback_t::compute_backpressure() {
+    const unsigned int dirty = dirty_block_semaphore.get_current();
+    const unsigned int start = std::max<unsigned int>(
+        flush_threshold, max_dirty_blocks * WRITEBACK_BACKPRESSURE_START_FRACTION);
+
+    double backpressure = 0;
+    if (dirty > start && max_dirty_blocks > start) {
+        backpressure = std::min(1.0, static_cast<double>(dirty - start)
+                                     / (max_dirty_blocks - start));
+    }
+    if (dirty_budget_registration.has()) {
+        backpressure = std::max(backpressure, report_to_dirty_budget());
+    }
+    return backpressure;
+}
+
+double writeback_t::report_to_dirty_budget() {
+    rassert(dirty_budget_registration.has());
+    const int64_t block_size = cache->serializer->get_block_size().ser_value();
+    return dirty_budget_registration->report_dirty_size(
+        dirty_block_semaphore.get_current() * block_size);
+}
+
 void writeback_t::begin_transaction(mc_transaction_t *txn) {
 
     if (txn->get_access() == rwi_write) {
@@ -103,10 +179,19 @@ void writeback_t::begin_transaction(mc_transaction_t *txn) {
         {
             ticks_t start_time;
             cache->stats->pm_throttling_waiting.begin(&start_time);
+            // Slow down writers gradually before the dirty block semaphore stops
+            // them completely. Transactions still begin in order because the
+            // transaction constructor keeps write transactions in a coro_fifo_t.
+            last_backpressure = compute_backpressure();
+            const int64_t delay_ms = last_backpressure * WRITEBACK_MAX_BACKPRESSURE_DELAY_MS;
+            if (delay_ms > 0) {
+                nap(delay_ms);
+            }
             txn->throttling_acq.init(
                     new semaphore_acq_t(&dirty_block_semaphore, txn->expected_change_count));
             cache->stats->pm_throttling_waiting.end(&start_time);
         }
+        ++num_active_write_transactions;
 
         /* Acquire flush lock in non-exclusive mode */
         flush_lock.co_lock(rwi_read);
@@ -135,17 +220,23 @@ void writeback_t::begin_transaction(mc_transaction_t *txn) {
 void writeback_t::on_transaction_commit(mc_transaction_t *txn) {
     if (txn->get_access() == rwi_write) {
         txn->throttling_acq.reset();
+        --num_active_write_transactions;
 
         flush_lock.unlock();
 
         /* At the end of every write transaction, check if the number of dirty blocks exceeds the
-        threshold to force writeback to start. */
-        if (num_dirty_blocks() > flush_threshold) {
+        threshold to force writeback to start. Also flush if writers are being slowed down,
+        which can be because of the node-wide dirty budget. */
+        if (num_dirty_blocks() > flush_threshold || last_backpressure > 0) {
             sync(NULL);
         } else if (num_dirty_blocks() > 0 && flush_time_randomizer.is_zero()) {
             sync(NULL);
         } else if (!sync_callbacks.empty()) {
-            sync(NULL);
+            if (adaptive_flush) {
+                schedule_group_commit();
+            } else {
+                sync(NULL);
+            }
         }
 
         if (flush_timer == NULL
@@ -361,6 +452,8 @@ void writeback_t::do_concurrent_flush() {
         cache->stats->pm_flushes_writing.begin(&start_time);
         flush_acquire_bufs(transaction, &state);
     }
+    cache->stats->pm_flushes_commit_batch.record(current_sync_callbacks.size());
+    const ticks_t writing_start_ticks = get_ticks();
 
     // Now that preparations are complete, send the writes to the serializer
     if (!state.serializer_writes.empty()) {
@@ -406,6 +499,11 @@ void writeback_t::do_concurrent_flush() {
     state.buf_writers.clear();
     delete transaction;
 
+    // The written blocks no longer count against the dirty budget.
+    if (dirty_budget_registration.has()) {
+        report_to_dirty_budget();
+    }
+
     while (!current_sync_callbacks.empty()) {
         sync_callback_t *cb = current_sync_callbacks.head();
         current_sync_callbacks.remove(cb);
@@ -415,6 +513,13 @@ void writeback_t::do_concurrent_flush() {
     cache->stats->pm_flushes_writing.end(&start_time);
     --active_flushes;
 
+    const double latency_ms = ticks_to_secs(get_ticks() - writing_start_ticks) * 1000;
+    flush_latency_ms = WRITEBACK_FLUSH_LATENCY_SMOOTHING * latency_ms
+        + (1 - WRITEBACK_FLUSH_LATENCY_SMOOTHING) * flush_latency_ms;
+    if (adaptive_flush) {
+        flush_time_randomizer.set_flush_latency(flush_latency_ms);
+    }
+
     // Try again to start the next sync now.  If we didn't do this,
     // then the following may occur.  If active_flushes ==
     // max_active_flushes and all the flush operations are waiting for
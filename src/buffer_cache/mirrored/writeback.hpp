@@ -6,6 +6,7 @@
 #include <vector>
 
 #include "arch/timer.hpp"
+#include "buffer_cache/mirrored/dirty_budget.hpp"
 #include "buffer_cache/mirrored/flush_time_randomizer.hpp"
 #include "buffer_cache/types.hpp"
 #include "concurrency/cond_var.hpp"
@@ -36,7 +37,9 @@ public:
         unsigned int flush_timer_ms,
         unsigned int flush_threshold,
         unsigned int max_dirty_blocks,
-        unsigned int max_concurrent_flushes);
+        unsigned int max_concurrent_flushes,
+        bool use_dirty_budget,
+        bool adaptive_flush);
     virtual ~writeback_t();
 
     /* Forces a writeback to happen soon. If there is nothing to write, pulses the callback.
@@ -47,7 +50,9 @@ public:
     void sync_patiently(sync_callback_t *callback);
 
     /* `begin_transaction()` will block if the transaction is a write transaction and
-    it ought to be throttled. */
+    it ought to be throttled. Write transactions are delayed a little once there is a
+    lot of dirty data (see `compute_backpressure()`), and have to wait for a flush
+    once there are `max_dirty_blocks` dirty blocks. */
     void begin_transaction(mc_transaction_t *txn);
 
     void on_transaction_commit(mc_transaction_t *txn);
@@ -112,6 +117,26 @@ private:
     // The flush timer callback.
     void on_timer();
 
+    // With adaptive flushing, hard durability commits don't start a flush right
+    // away if other write transactions are active and flushes are slow. Instead
+    // they wait (in sync_callbacks) for a few more commits to join them, until
+    // there are WRITEBACK_GROUP_COMMIT_BATCH_SIZE of them or the group commit
+    // timer fires.
+    const bool adaptive_flush;
+    void schedule_group_commit();
+    void on_group_commit_timer();
+    struct group_commit_timer_callback_t : public timer_callback_t {
+        void on_timer() { parent->on_group_commit_timer(); }
+        writeback_t *parent;
+    } group_commit_timer_callback;
+    timer_token_t *group_commit_timer;
+
+    // How many write transactions have begun but not committed yet.
+    int num_active_write_transactions;
+
+    // A smoothed average of how long (in ms) it takes to write out a flush.
+    double flush_latency_ms;
+
     bool writeback_in_progress;
     unsigned int active_flushes;
 
@@ -119,6 +144,20 @@ private:
 
     mc_cache_t *cache;
 
+    // Returns how much (from 0 to 1) write transactions should be slowed down,
+    // depending on how close the dirty blocks (including the ones that are being
+    // written) are to `max_dirty_blocks` and on the node-wide dirty budget.
+    double compute_backpressure();
+
+    // Tells the dirty budget how much dirty data we have, and returns its backpressure.
+    double report_to_dirty_budget();
+
+    // Only initialized if the cache uses the node-wide dirty budget.
+    scoped_ptr_t<dirty_budget_t::registration_t> dirty_budget_registration;
+
+    // The backpressure that the last write transaction saw.
+    double last_backpressure;
+
     /* The flush lock is necessary because if we acquire dirty blocks
      * in random order during the flush, there might be a deadlock
      * with set_fsm. When the flush is initiated, the flush_lock is
@@ -3,6 +3,8 @@
 #define BUFFER_CACHE_SEMANTIC_CHECKING_HPP_
 
 #include <algorithm>
+#include <string>
+#include <vector>
 
 #include "utils.hpp"
 #include <boost/crc.hpp>
@@ -59,6 +61,10 @@ public:
     bool is_deleted() const;
     repli_timestamp_t get_recency() const;
 
+    bool can_use_derived_data() const;
+    buf_derived_data_t *get_derived_data() const;
+    void set_derived_data(buf_derived_data_t *derived_data);
+
 private:
     bool snapshotted;
     bool has_been_changed;
@@ -78,6 +84,10 @@ public:
     void set_eviction_priority(eviction_priority_t val) {
         internal_buf_lock->set_eviction_priority(val);
     }
+
+    void pin_in_cache() {
+        internal_buf_lock->pin_in_cache();
+    }
 };
 
 /* Transaction */
@@ -96,6 +106,16 @@ public:
         snapshotted = true;
         inner_transaction.snapshot();
     }
+
+    void set_single_pass() {
+        inner_transaction.set_single_pass();
+    }
+    void pass_block(block_id_t block_id) {
+        inner_transaction.pass_block(block_id);
+    }
+    bool snapshot_over_budget() const {
+        return inner_transaction.snapshot_over_budget();
+    }
     
     access_t get_access() const {
         return inner_transaction.get_access();
@@ -117,6 +137,34 @@ public:
         inner_transaction.set_token_pair(token_pair);
     }
 
+    void set_access_hint(cache_access_hint_t hint) {
+        inner_transaction.set_access_hint(hint);
+    }
+    cache_access_hint_t get_access_hint() const {
+        return inner_transaction.get_access_hint();
+    }
+    void set_next_access_hint(cache_access_hint_t hint) {
+        inner_transaction.set_next_access_hint(hint);
+    }
+    void prefetch(block_id_t block_id) {
+        inner_transaction.prefetch(block_id);
+    }
+
+    void prefetch(const std::vector<block_id_t> &block_ids) {
+        inner_transaction.prefetch(block_ids);
+    }
+
+    const void *peek(block_id_t block_id) {
+        return inner_transaction.peek(block_id);
+    }
+
+    int64_t get_cache_hits() const {
+        return inner_transaction.get_cache_hits();
+    }
+    int64_t get_block_loads() const {
+        return inner_transaction.get_block_loads();
+    }
+
 private:
     bool snapshotted; // Disables CRC checks
 
@@ -143,14 +191,16 @@ public:
     block_size_t get_block_size();
     void create_cache_account(
             int priority,
+            io_activity_t activity,
             scoped_ptr_t<typename inner_cache_t::cache_account_type> *out);
 
     void offer_read_ahead_buf(block_id_t block_id,
-                              scoped_malloc_t<ser_buffer_t> *buf,
+                              scoped_ser_buffer_t *buf,
                               const counted_t<standard_block_token_t> &token,
                               repli_timestamp_t recency_timestamp);
     bool contains_block(block_id_t block_id);
     unsigned int num_blocks();
+    void enable_warmup_manifest(const std::string &path);
 
     coro_fifo_t &co_begin_coro_fifo() { return inner_cache.co_begin_coro_fifo(); }
 
@@ -59,6 +59,24 @@ void scc_buf_lock_t<inner_cache_t>::mark_deleted() {
     internal_buf_lock->mark_deleted();
 }
 
+template<class inner_cache_t>
+bool scc_buf_lock_t<inner_cache_t>::can_use_derived_data() const {
+    rassert(internal_buf_lock.has());
+    return internal_buf_lock->can_use_derived_data();
+}
+
+template<class inner_cache_t>
+buf_derived_data_t *scc_buf_lock_t<inner_cache_t>::get_derived_data() const {
+    rassert(internal_buf_lock.has());
+    return internal_buf_lock->get_derived_data();
+}
+
+template<class inner_cache_t>
+void scc_buf_lock_t<inner_cache_t>::set_derived_data(buf_derived_data_t *derived_data) {
+    rassert(internal_buf_lock.has());
+    internal_buf_lock->set_derived_data(derived_data);
+}
+
 template<class inner_cache_t>
 void scc_buf_lock_t<inner_cache_t>::touch_recency(repli_timestamp_t timestamp) {
     rassert(internal_buf_lock.has());
@@ -187,14 +205,14 @@ block_size_t scc_cache_t<inner_cache_t>::get_block_size() {
 }
 
 template<class inner_cache_t>
-void scc_cache_t<inner_cache_t>::create_cache_account(int priority, scoped_ptr_t<typename inner_cache_t::cache_account_type> *out) {
-    inner_cache.create_cache_account(priority, out);
+void scc_cache_t<inner_cache_t>::create_cache_account(int priority, io_activity_t activity, scoped_ptr_t<typename inner_cache_t::cache_account_type> *out) {
+    inner_cache.create_cache_account(priority, activity, out);
 }
 
 template<class inner_cache_t>
 void scc_cache_t<inner_cache_t>::offer_read_ahead_buf(
         block_id_t block_id,
-        scoped_malloc_t<ser_buffer_t> *buf,
+        scoped_ser_buffer_t *buf,
         const counted_t<standard_block_token_t>& token,
         repli_timestamp_t recency_timestamp) {
     inner_cache.offer_read_ahead_buf(block_id, buf,
@@ -210,3 +228,8 @@ template<class inner_cache_t>
 unsigned int scc_cache_t<inner_cache_t>::num_blocks() {
     return inner_cache.num_blocks();
 }
+
+template<class inner_cache_t>
+void scc_cache_t<inner_cache_t>::enable_warmup_manifest(const std::string &path) {
+    inner_cache.enable_warmup_manifest(path);
+}
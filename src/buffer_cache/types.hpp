@@ -13,6 +13,16 @@ enum write_durability_t { WRITE_DURABILITY_INVALID, WRITE_DURABILITY_SOFT, WRITE
 ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(write_durability_t, int8_t, WRITE_DURABILITY_SOFT, WRITE_DURABILITY_HARD);
 
 
+// Tells the cache how the blocks that a transaction acquires are likely to be used.
+enum cache_access_hint_t {
+    // The default, blocks might be accessed again soon.
+    CACHE_ACCESS_HINT_NORMAL,
+    // The transaction streams through a large number of blocks (range reads,
+    // backfills, ...) and is unlikely to come back to them. Blocks that the cache
+    // has to load for such a transaction are evicted before any others.
+    CACHE_ACCESS_HINT_ONCE
+};
+
 enum buffer_cache_order_mode_t {
     buffer_cache_order_mode_check,
     buffer_cache_order_mode_ignore
@@ -83,7 +93,14 @@ protected:
     virtual ~get_subtree_recencies_callback_t() { }
 };
 
-template <class T> class scoped_malloc_t;
+// Something that a user of the cache computes from a block's contents and keeps
+// alongside the block while it is in memory, so that it doesn't have to compute
+// it again on every access.  The cache throws it away whenever the contents
+// change, see mc_buf_lock_t::set_derived_data().
+class buf_derived_data_t {
+public:
+    virtual ~buf_derived_data_t() { }
+};
 
 
 
@@ -9,6 +9,10 @@ LDFLAGS ?=
 CXXFLAGS ?=
 RT_LDFLAGS := $(LDFLAGS) $(RE2_LIBS) $(TERMCAP_LIBS)
 RT_LDFLAGS += $(V8_LIBS) $(PROTOBUF_LIBS) $(TCMALLOC_MINIMAL_LIBS) $(PTHREAD_LIBS)
+ifeq ($(OS),Linux)
+  # shm_open, for the rings of the extproc workers
+  RT_LDFLAGS += -lrt
+endif
 RT_CXXFLAGS := $(CXXFLAGS) $(RE2_CXXFLAGS)
 
 ifeq ($(USE_CCACHE),1)
@@ -227,7 +231,7 @@ ifeq ($(MEMCACHED_STRICT),1)
 endif
 
 ifeq ($(LEGACY_LINUX),1)
-  RT_CXXFLAGS += -DLEGACY_LINUX -DNO_EPOLL -Wno-format
+  RT_CXXFLAGS += -DLEGACY_LINUX -DNO_EPOLL -DNO_IO_URING -Wno-format
 endif
 
 ifeq ($(LEGACY_GCC),1)
@@ -242,6 +246,10 @@ ifeq ($(NO_EPOLL),1)
   RT_CXXFLAGS += -DNO_EPOLL
 endif
 
+ifeq ($(NO_IO_URING),1)
+  RT_CXXFLAGS += -DNO_IO_URING
+endif
+
 ifeq ($(VALGRIND),1)
   ifneq (1,$(NO_TCMALLOC))
     $(error cannot build with VALGRIND=1 when NO_TCMALLOC=0)
@@ -276,7 +284,9 @@ RT_CXXFLAGS += -DMIGRATION_SCRIPT_LOCATION=\"$(scripts_dir)/rdb_migrate\"
 
 SOURCES := $(shell find $(SOURCE_DIR) -name '*.cc')
 
-SERVER_EXEC_SOURCES := $(filter-out $(SOURCE_DIR)/unittest/%,$(SOURCES))
+SERVER_EXEC_SOURCES := $(filter-out $(SOURCE_DIR)/unittest/% $(SOURCE_DIR)/microbench/%,$(SOURCES))
+
+MICROBENCH_SOURCES := $(filter $(SOURCE_DIR)/microbench/%,$(SOURCES))
 
 QL2_PROTO_NAMES := rdb_protocol/ql2 rdb_protocol/ql2_extensions
 QL2_PROTO_SOURCES := $(foreach _,$(QL2_PROTO_NAMES),$(SOURCE_DIR)/$_.proto)
@@ -292,10 +302,14 @@ OBJS := $(QL2_PROTO_OBJS) $(patsubst %,$(OBJ_DIR)/%.o,$(NAMES))
 
 SERVER_EXEC_OBJS := $(QL2_PROTO_OBJS) $(patsubst $(SOURCE_DIR)/%.cc,$(OBJ_DIR)/%.o,$(SERVER_EXEC_SOURCES))
 
-SERVER_NOMAIN_OBJS := $(QL2_PROTO_OBJS) $(patsubst $(SOURCE_DIR)/%.cc,$(OBJ_DIR)/%.o,$(filter-out %/main.cc,$(SOURCES)))
+SERVER_NOMAIN_OBJS := $(QL2_PROTO_OBJS) $(patsubst $(SOURCE_DIR)/%.cc,$(OBJ_DIR)/%.o,$(filter-out %/main.cc $(MICROBENCH_SOURCES),$(SOURCES)))
 
 SERVER_UNIT_TEST_OBJS := $(SERVER_NOMAIN_OBJS) $(OBJ_DIR)/unittest/main.o
 
+# The microbenchmarks use some of the unit tests' helpers, like their mock file,
+# so they link like the unit tests do.
+SERVER_MICROBENCH_OBJS := $(SERVER_NOMAIN_OBJS) $(patsubst $(SOURCE_DIR)/%.cc,$(OBJ_DIR)/%.o,$(MICROBENCH_SOURCES))
+
 ##### Version number handling
 
 RT_CXXFLAGS += -DRETHINKDB_VERSION=\"$(RETHINKDB_VERSION)\"
@@ -320,6 +334,16 @@ unit: $(BUILD_DIR)/$(SERVER_UNIT_TEST_NAME)
 	$P RUN $(SERVER_UNIT_TEST_NAME)
 	$(BUILD_DIR)/$(SERVER_UNIT_TEST_NAME) --gtest_filter=$(UNIT_TEST_FILTER)
 
+# `make microbench MICROBENCH_FILTER=leaf_node.` runs the benchmarks whose names
+# contain the filter and leaves their results in microbench.json.
+.PHONY: microbench
+microbench: $(BUILD_DIR)/$(SERVER_MICROBENCH_NAME)
+	$P RUN $(SERVER_MICROBENCH_NAME)
+	$(BUILD_DIR)/$(SERVER_MICROBENCH_NAME) --filter '$(MICROBENCH_FILTER)' --json $(BUILD_DIR)/microbench.json
+
+.PHONY: $(SERVER_MICROBENCH_NAME)
+$(SERVER_MICROBENCH_NAME): $(BUILD_DIR)/$(SERVER_MICROBENCH_NAME)
+
 .PRECIOUS: $(PROTO_DIR)/. $(QL2_PROTO_HEADERS) $(QL2_PROTO_CODE)
 
 $(PROTO_DIR)/%.pb.h $(PROTO_DIR)/%.pb.cc: $(SOURCE_DIR)/%.proto | $(PROTOC_DEP) $(PROTO_DIR)/.
@@ -357,6 +381,10 @@ $(BUILD_DIR)/$(SERVER_UNIT_TEST_NAME): $(SERVER_UNIT_TEST_OBJS) $(UNIT_STATIC_LI
 	$P LD $@
 	$(RT_CXX) $(SERVER_UNIT_TEST_OBJS) $(RT_LDFLAGS) $(UNIT_STATIC_LIBRARY_PATH) -o $@ $(LD_OUTPUT_FILTER)
 
+$(BUILD_DIR)/$(SERVER_MICROBENCH_NAME): $(SERVER_MICROBENCH_OBJS) $(UNIT_STATIC_LIBRARY_PATH) | $(BUILD_DIR)/. $(TCMALLOC_DEP)
+	$P LD $@
+	$(RT_CXX) $(SERVER_MICROBENCH_OBJS) $(RT_LDFLAGS) $(UNIT_STATIC_LIBRARY_PATH) -o $@ $(LD_OUTPUT_FILTER)
+
 $(BUILD_DIR)/$(GDB_FUNCTIONS_NAME):
 	$P CP $@
 	cp $(SCRIPTS_DIR)/$(GDB_FUNCTIONS_NAME) $@
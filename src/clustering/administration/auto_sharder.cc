@@ -0,0 +1,440 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "clustering/administration/auto_sharder.hpp"
+
+#include <stdlib.h>
+
+#include <algorithm>
+#include <set>
+#include <string>
+
+#include "errors.hpp"
+#include <boost/bind.hpp>
+#include <boost/ptr_container/ptr_map.hpp>
+
+#include "arch/runtime/coroutines.hpp"
+#include "clustering/administration/namespace_interface_repository.hpp"
+#include "clustering/administration/suggester.hpp"
+#include "concurrency/promise.hpp"
+#include "concurrency/signal.hpp"
+#include "concurrency/wait_any.hpp"
+#include "config/args.hpp"
+#include "logger.hpp"
+#include "perfmon/archive.hpp"
+#include "rdb_protocol/protocol.hpp"
+#include "utils.hpp"
+
+// How many ranges the distribution of a table is cut into to find split points.
+#define AUTO_SHARD_DISTRIBUTION_LIMIT 1024
+
+auto_shard_policy_t::auto_shard_policy_t()
+    : has_changed(false), last_change(0) { }
+
+auto_shard_policy_t::proposal_t auto_shard_policy_t::observe(
+        const std::vector<key_range_t> &shards,
+        const std::vector<shard_sample_t> &samples,
+        ticks_t now) {
+    guarantee(shards.size() == samples.size());
+    if (shards.empty()) {
+        return proposal_t();
+    }
+
+    double total_requests = 0;
+    int64_t total_bytes = 0;
+    for (size_t i = 0; i < samples.size(); ++i) {
+        total_requests += samples[i].requests_per_sec;
+        total_bytes += samples[i].bytes;
+    }
+    const double mean_requests = total_requests / samples.size();
+    const double mean_bytes = static_cast<double>(total_bytes) / samples.size();
+
+    /* Shards and pairs that aren't hot or cold this round drop out of the maps,
+    so only unbroken streaks count. */
+    std::map<store_key_t, int> new_hot_rounds, new_cold_rounds;
+    int hottest = -1;
+    double hottest_excess = 0;
+    int coldest = -1;
+
+    for (size_t i = 0; i < shards.size(); ++i) {
+        const shard_sample_t &s = samples[i];
+        const bool busy = s.requests_per_sec >= AUTO_SHARD_SPLIT_REQUESTS_PER_SEC
+            && (shards.size() == 1 || s.requests_per_sec >= AUTO_SHARD_HOT_RATIO * mean_requests);
+        const bool big = s.bytes >= AUTO_SHARD_SPLIT_BYTES
+            && (shards.size() == 1 || s.bytes >= AUTO_SHARD_HOT_RATIO * mean_bytes);
+        if (busy || big) {
+            const int rounds = hot_rounds[shards[i].left] + 1;
+            new_hot_rounds[shards[i].left] = rounds;
+            const double excess = std::max(s.requests_per_sec / AUTO_SHARD_SPLIT_REQUESTS_PER_SEC,
+                                           static_cast<double>(s.bytes) / AUTO_SHARD_SPLIT_BYTES);
+            if (rounds >= AUTO_SHARD_ROUNDS && s.split_point && excess > hottest_excess) {
+                hottest = static_cast<int>(i);
+                hottest_excess = excess;
+            }
+        }
+
+        if (i > 0) {
+            const shard_sample_t &l = samples[i - 1];
+            if (l.requests_per_sec + s.requests_per_sec < AUTO_SHARD_SPLIT_REQUESTS_PER_SEC / 4.0
+                && l.bytes + s.bytes < AUTO_SHARD_SPLIT_BYTES / 4) {
+                const int rounds = cold_rounds[shards[i].left] + 1;
+                new_cold_rounds[shards[i].left] = rounds;
+                if (rounds >= AUTO_SHARD_ROUNDS && coldest == -1) {
+                    coldest = static_cast<int>(i);
+                }
+            }
+        }
+    }
+
+    hot_rounds.swap(new_hot_rounds);
+    cold_rounds.swap(new_cold_rounds);
+
+    if (has_changed && now - last_change < secs_to_ticks(AUTO_SHARD_COOLDOWN_SECS)) {
+        return proposal_t();
+    }
+    if (hottest != -1 && shards.size() < AUTO_SHARD_MAX_SHARDS) {
+        return proposal_t(SPLIT, *samples[hottest].split_point);
+    }
+    if (coldest != -1) {
+        return proposal_t(MERGE, shards[coldest].left);
+    }
+    return proposal_t();
+}
+
+void auto_shard_policy_t::note_change(ticks_t now) {
+    has_changed = true;
+    last_change = now;
+    hot_rounds.clear();
+    cold_rounds.clear();
+}
+
+struct auto_shard_stats_request_t {
+    explicit auto_shard_stats_request_t(mailbox_manager_t *mailbox_manager) :
+        response_mailbox(mailbox_manager,
+                         boost::bind(&promise_t<perfmon_result_t>::pulse, &stats_promise, _1)) { }
+    promise_t<perfmon_result_t> stats_promise;
+    mailbox_t<void(perfmon_result_t)> response_mailbox;
+};
+
+/* Finds the "reads" and "writes" of the `master_t` of the given shard in the
+stats of its primary. */
+bool get_master_requests_per_sec(const perfmon_result_t &stats,
+                                 const namespace_id_t &ns_id,
+                                 const hash_region_t<key_range_t> &shard,
+                                 double *requests_out) {
+    const std::string path[] = { uuid_to_str(ns_id), "regions",
+                                 "be_primary_" + debug_strprint(shard), "master" };
+    const perfmon_result_t *res = &stats;
+    for (size_t i = 0; i < sizeof(path) / sizeof(path[0]); ++i) {
+        if (!res->is_map()) {
+            return false;
+        }
+        perfmon_result_t::const_iterator it = res->get_map()->find(path[i]);
+        if (it == res->end()) {
+            return false;
+        }
+        res = it->second;
+    }
+    if (!res->is_map()) {
+        return false;
+    }
+
+    *requests_out = 0;
+    const char *const rates[] = { "reads", "writes" };
+    for (size_t i = 0; i < sizeof(rates) / sizeof(rates[0]); ++i) {
+        perfmon_result_t::const_iterator it = res->get_map()->find(rates[i]);
+        if (it == res->end() || !it->second->is_string()) {
+            return false;
+        }
+        *requests_out += strtod(it->second->get_string()->c_str(), NULL);
+    }
+    return true;
+}
+
+auto_sharder_t::auto_sharder_t(
+        mailbox_manager_t *_mailbox_manager,
+        const machine_id_t &_machine_id,
+        const boost::shared_ptr<semilattice_readwrite_view_t<cluster_semilattice_metadata_t> > &_semilattice_view,
+        const clone_ptr_t<watchable_t<std::map<peer_id_t, cluster_directory_metadata_t> > > &_directory_view,
+        namespace_repo_t<rdb_protocol_t> *_ns_repo)
+    : mailbox_manager(_mailbox_manager),
+      machine_id(_machine_id),
+      semilattice_view(_semilattice_view),
+      directory_view(_directory_view),
+      ns_repo(_ns_repo),
+      checking(false),
+      timer(AUTO_SHARD_INTERVAL_MS, this) { }
+
+void auto_sharder_t::on_ring() {
+    /* A round can take longer than the interval if the cluster is slow to
+    answer; don't start another one on top of it. */
+    if (!checking) {
+        checking = true;
+        coro_t::spawn_sometime(boost::bind(&auto_sharder_t::check_tables, this,
+                                           auto_drainer_t::lock_t(&drainer)));
+    }
+}
+
+void auto_sharder_t::check_tables(auto_drainer_t::lock_t keepalive) {
+    std::map<peer_id_t, cluster_directory_metadata_t> directory = directory_view->get();
+    cluster_semilattice_metadata_t metadata = semilattice_view->get();
+
+    /* Find the tables that we are in charge of.  That's the ones whose first
+    shard we are the primary of, so that every table has a single server
+    looking after it while the blueprints agree. */
+    std::vector<namespace_id_t> our_tables;
+    const namespaces_semilattice_metadata_t<rdb_protocol_t> &namespaces = *metadata.rdb_namespaces;
+    for (namespaces_semilattice_metadata_t<rdb_protocol_t>::namespace_map_t::const_iterator it = namespaces.namespaces.begin();
+         it != namespaces.namespaces.end(); ++it) {
+        if (it->second.is_deleted() ||
+            it->second.get_ref().shards.in_conflict() ||
+            it->second.get_ref().blueprint.in_conflict()) {
+            continue;
+        }
+        const nonoverlapping_regions_t<rdb_protocol_t> shards = it->second.get_ref().shards.get();
+        const persistable_blueprint_t<rdb_protocol_t> blueprint = it->second.get_ref().blueprint.get();
+        if (shards.empty()) {
+            continue;
+        }
+        persistable_blueprint_t<rdb_protocol_t>::role_map_t::const_iterator us = blueprint.machines_roles.find(machine_id);
+        if (us != blueprint.machines_roles.end()) {
+            persistable_blueprint_t<rdb_protocol_t>::region_to_role_map_t::const_iterator role = us->second.find(*shards.begin());
+            if (role != us->second.end() && role->second == blueprint_role_primary) {
+                our_tables.push_back(it->first);
+            }
+        }
+    }
+
+    if (our_tables.empty()) {
+        checking = false;
+        return;
+    }
+
+    /* One stats request per server serves all of our tables. */
+    boost::ptr_map<machine_id_t, auto_shard_stats_request_t> requests;
+    std::set<std::string> requested_stats;
+    requested_stats.insert(".*");
+    for (std::map<peer_id_t, cluster_directory_metadata_t>::iterator it = directory.begin();
+         it != directory.end(); ++it) {
+        if (it->second.peer_type == SERVER_PEER) {
+            machine_id_t target = it->second.machine_id;
+            auto_shard_stats_request_t *request = new auto_shard_stats_request_t(mailbox_manager);
+            requests.insert(target, request);
+            send(mailbox_manager, it->second.get_stats_mailbox_address,
+                 request->response_mailbox.get_address(), requested_stats);
+        }
+    }
+
+    try {
+        signal_timer_t timeout;
+        timeout.start(AUTO_SHARD_STATS_TIMEOUT_MS);
+        std::map<machine_id_t, perfmon_result_t> stats;
+        for (boost::ptr_map<machine_id_t, auto_shard_stats_request_t>::iterator it = requests.begin();
+             it != requests.end(); ++it) {
+            const signal_t *stats_ready = it->second->stats_promise.get_ready_signal();
+            wait_any_t waiter(&timeout, stats_ready);
+            wait_interruptible(&waiter, keepalive.get_drain_signal());
+            if (stats_ready->is_pulsed()) {
+                stats.insert(std::make_pair(it->first, it->second->stats_promise.wait()));
+            }
+        }
+
+        /* Change at most one table per round, so that the cluster has to move
+        only one shard's worth of data at a time. */
+        for (size_t i = 0; i < our_tables.size(); ++i) {
+            if (check_table(our_tables[i], stats, keepalive.get_drain_signal())) {
+                break;
+            }
+        }
+    } catch (const interrupted_exc_t &) {
+        /* We're shutting down. */
+    }
+
+    checking = false;
+}
+
+bool auto_sharder_t::check_table(const namespace_id_t &ns_id,
+                                 const std::map<machine_id_t, perfmon_result_t> &stats,
+                                 signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) {
+    cluster_semilattice_metadata_t metadata = semilattice_view->get();
+    namespaces_semilattice_metadata_t<rdb_protocol_t>::namespace_map_t::const_iterator ns_it =
+        metadata.rdb_namespaces->namespaces.find(ns_id);
+    if (ns_it == metadata.rdb_namespaces->namespaces.end() ||
+        ns_it->second.is_deleted() ||
+        ns_it->second.get_ref().shards.in_conflict() ||
+        ns_it->second.get_ref().blueprint.in_conflict()) {
+        return false;
+    }
+    const nonoverlapping_regions_t<rdb_protocol_t> shards = ns_it->second.get_ref().shards.get();
+    const persistable_blueprint_t<rdb_protocol_t> blueprint = ns_it->second.get_ref().blueprint.get();
+
+    std::map<hash_region_t<key_range_t>, machine_id_t> primaries;
+    for (persistable_blueprint_t<rdb_protocol_t>::role_map_t::const_iterator it = blueprint.machines_roles.begin();
+         it != blueprint.machines_roles.end(); ++it) {
+        for (persistable_blueprint_t<rdb_protocol_t>::region_to_role_map_t::const_iterator jt = it->second.begin();
+             jt != it->second.end(); ++jt) {
+            if (jt->second == blueprint_role_primary) {
+                primaries[jt->first] = it->first;
+            }
+        }
+    }
+
+    std::vector<key_range_t> ranges;
+    std::vector<shard_sample_t> samples;
+    for (nonoverlapping_regions_t<rdb_protocol_t>::iterator it = shards.begin(); it != shards.end(); ++it) {
+        std::map<hash_region_t<key_range_t>, machine_id_t>::const_iterator primary = primaries.find(*it);
+        if (primary == primaries.end()) {
+            return false;
+        }
+        std::map<machine_id_t, perfmon_result_t>::const_iterator machine_stats = stats.find(primary->second);
+        if (machine_stats == stats.end()) {
+            // Without the rates of every shard we can't tell which are hot.
+            return false;
+        }
+        shard_sample_t sample;
+        if (!get_master_requests_per_sec(machine_stats->second, ns_id, *it, &sample.requests_per_sec)) {
+            // The primary isn't up yet, for example because it's backfilling.
+            return false;
+        }
+        ranges.push_back(it->inner);
+        samples.push_back(sample);
+    }
+
+    rdb_protocol_t::distribution_read_response_t distribution;
+    try {
+        namespace_repo_t<rdb_protocol_t>::access_t ns_access(ns_repo, ns_id, interruptor);
+        rdb_protocol_t::read_t read(rdb_protocol_t::distribution_read_t(0, AUTO_SHARD_DISTRIBUTION_LIMIT, distribution_mode_t::SAMPLE),
+                                    profile_bool_t::DONT_PROFILE);
+        rdb_protocol_t::read_response_t response;
+        ns_access.get_namespace_if()->read_outdated(read, &response, interruptor);
+        distribution = boost::get<rdb_protocol_t::distribution_read_response_t>(response.response);
+    } catch (const cannot_perform_query_exc_t &) {
+        return false;
+    }
+
+    /* `key_counts` and `byte_counts` have the left bounds of ranges as keys, so
+    each range is counted in the shard that its left bound is in. */
+    for (size_t i = 0; i < ranges.size(); ++i) {
+        int64_t keys = 0;
+        for (std::map<store_key_t, int64_t>::const_iterator it = distribution.key_counts.begin();
+             it != distribution.key_counts.end(); ++it) {
+            if (ranges[i].contains_key(it->first)) {
+                keys += it->second;
+            }
+        }
+        int64_t keys_so_far = 0;
+        for (std::map<store_key_t, int64_t>::const_iterator it = distribution.key_counts.begin();
+             it != distribution.key_counts.end(); ++it) {
+            if (ranges[i].contains_key(it->first)) {
+                if (it->first != ranges[i].left && keys_so_far >= keys / 2) {
+                    samples[i].split_point = it->first;
+                    break;
+                }
+                keys_so_far += it->second;
+            }
+        }
+        for (std::map<store_key_t, int64_t>::const_iterator it = distribution.byte_counts.begin();
+             it != distribution.byte_counts.end(); ++it) {
+            if (ranges[i].contains_key(it->first)) {
+                samples[i].bytes += it->second;
+            }
+        }
+    }
+
+    auto_shard_policy_t *policy = &policies[ns_id];
+    const auto_shard_policy_t::proposal_t proposal = policy->observe(ranges, samples, get_ticks());
+    if (proposal.action == auto_shard_policy_t::NONE) {
+        return false;
+    }
+    if (!apply(ns_id, proposal)) {
+        return false;
+    }
+    policy->note_change(get_ticks());
+    return true;
+}
+
+bool auto_sharder_t::apply(const namespace_id_t &ns_id,
+                           const auto_shard_policy_t::proposal_t &proposal) {
+    cluster_semilattice_metadata_t metadata = semilattice_view->get();
+    {
+        cow_ptr_t<namespaces_semilattice_metadata_t<rdb_protocol_t> >::change_t change(&metadata.rdb_namespaces);
+        namespaces_semilattice_metadata_t<rdb_protocol_t>::namespace_map_t::iterator ns_it =
+            change.get()->namespaces.find(ns_id);
+        if (ns_it == change.get()->namespaces.end() || ns_it->second.is_deleted()) {
+            return false;
+        }
+        namespace_semilattice_metadata_t<rdb_protocol_t> *ns = ns_it->second.get_mutable();
+        if (ns->shards.in_conflict()) {
+            return false;
+        }
+        nonoverlapping_regions_t<rdb_protocol_t> &shards = ns->shards.get_mutable();
+
+        /* Shards of rdb tables always cover the whole hash space, see
+        `admin_cluster_link_t::split_shards()`. */
+        std::set<hash_region_t<key_range_t> >::iterator shard = shards.begin();
+        std::set<hash_region_t<key_range_t> >::iterator prev = shards.end();
+        while (shard != shards.end() && !shard->inner.contains_key(proposal.key)) {
+            prev = shard;
+            ++shard;
+        }
+        if (shard == shards.end()) {
+            return false;
+        }
+
+        switch (proposal.action) {
+        case auto_shard_policy_t::SPLIT: {
+            if (shard->inner.left == proposal.key) {
+                return false;
+            }
+            key_range_t left;
+            left.left = shard->inner.left;
+            left.right = key_range_t::right_bound_t(proposal.key);
+            key_range_t right;
+            right.left = proposal.key;
+            right.right = shard->inner.right;
+
+            shards.remove_region(shard);
+            bool add_success = shards.add_region(hash_region_t<key_range_t>(left));
+            guarantee(add_success);
+            add_success = shards.add_region(hash_region_t<key_range_t>(right));
+            guarantee(add_success);
+            break;
+        }
+        case auto_shard_policy_t::MERGE: {
+            if (shard->inner.left != proposal.key || prev == shards.end()) {
+                return false;
+            }
+            key_range_t merged;
+            merged.left = prev->inner.left;
+            merged.right = shard->inner.right;
+
+            shards.remove_region(shard);
+            shards.remove_region(prev);
+            bool add_success = shards.add_region(hash_region_t<key_range_t>(merged));
+            guarantee(add_success);
+            break;
+        }
+        case auto_shard_policy_t::NONE:
+        default:
+            unreachable();
+        }
+        ns->shards.upgrade_version(machine_id);
+
+        // Any time shards are changed, we destroy existing pinnings
+        region_map_t<rdb_protocol_t, machine_id_t> new_primaries(rdb_protocol_t::region_t::universe(), nil_uuid());
+        region_map_t<rdb_protocol_t, std::set<machine_id_t> > new_secondaries(rdb_protocol_t::region_t::universe(), std::set<machine_id_t>());
+        ns->primary_pinnings = ns->primary_pinnings.make_resolving_version(new_primaries, machine_id);
+        ns->secondary_pinnings = ns->secondary_pinnings.make_resolving_version(new_secondaries, machine_id);
+    }
+
+    try {
+        fill_in_blueprints(&metadata, directory_view->get(), machine_id, true);
+    } catch (const missing_machine_exc_t &) {
+        // We'll try again once every machine is back.
+        return false;
+    }
+    semilattice_view->join(metadata);
+
+    logINF("Automatically %s table %s at key %s\n",
+           proposal.action == auto_shard_policy_t::SPLIT ? "split" : "merged the shards of",
+           uuid_to_str(ns_id).c_str(), key_to_debug_str(proposal.key).c_str());
+    return true;
+}
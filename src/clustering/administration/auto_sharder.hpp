@@ -0,0 +1,117 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#ifndef CLUSTERING_ADMINISTRATION_AUTO_SHARDER_HPP_
+#define CLUSTERING_ADMINISTRATION_AUTO_SHARDER_HPP_
+
+#include <map>
+#include <vector>
+
+#include "errors.hpp"
+#include <boost/optional.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include "arch/timing.hpp"
+#include "btree/keys.hpp"
+#include "clustering/administration/metadata.hpp"
+#include "concurrency/auto_drainer.hpp"
+#include "concurrency/watchable.hpp"
+#include "hash_region.hpp"
+#include "rpc/semilattice/view.hpp"
+
+template <class> class namespace_repo_t;
+struct rdb_protocol_t;
+
+/* What `auto_sharder_t` measured about one shard of a table in one round. */
+struct shard_sample_t {
+    shard_sample_t() : requests_per_sec(0), bytes(0) { }
+
+    /* The reads and writes per second its primary serves. */
+    double requests_per_sec;
+    int64_t bytes;
+    /* A key that splits the shard's keys into two halves of about the same
+    size, if the distribution of the table had one. */
+    boost::optional<store_key_t> split_point;
+};
+
+/* Decides when the shards of one table should be split or merged.  A shard
+that serves more than `AUTO_SHARD_SPLIT_REQUESTS_PER_SEC` or holds more than
+`AUTO_SHARD_SPLIT_BYTES`, and at least `AUTO_SHARD_HOT_RATIO` times the average
+of its table, is hot; two neighbouring shards that together stay well below
+both limits are cold.  Only a shard that has been hot (or a pair that has been
+cold) for `AUTO_SHARD_ROUNDS` rounds in a row is split (or merged), and a table
+changes at most once every `AUTO_SHARD_COOLDOWN_SECS`. */
+class auto_shard_policy_t {
+public:
+    enum action_t { NONE, SPLIT, MERGE };
+
+    struct proposal_t {
+        proposal_t() : action(NONE) { }
+        proposal_t(action_t a, const store_key_t &k) : action(a), key(k) { }
+
+        action_t action;
+        /* For `SPLIT`, the new split point.  For `MERGE`, the split point to
+        remove (the left bound of the right one of the two shards). */
+        store_key_t key;
+    };
+
+    auto_shard_policy_t();
+
+    /* `shards` and `samples` are the shards of the table in key order and what
+    was measured about each of them this round. */
+    proposal_t observe(const std::vector<key_range_t> &shards,
+                       const std::vector<shard_sample_t> &samples,
+                       ticks_t now);
+
+    /* To be called once a proposal has been applied. */
+    void note_change(ticks_t now);
+
+private:
+    /* How many rounds in a row each shard has been hot, and each pair of shards
+    has been cold, keyed by the left bound of the shard (of the right shard for
+    pairs). */
+    std::map<store_key_t, int> hot_rounds;
+    std::map<store_key_t, int> cold_rounds;
+
+    bool has_changed;
+    ticks_t last_change;
+};
+
+/* With `--auto-shard`, each server periodically looks at the rdb tables whose
+first shard it is the primary of.  It measures the request rate of every shard
+from the stats of the shards' primaries (see `master_t`) and its size from a
+distribution query, and splits and merges shards as `auto_shard_policy_t`
+decides, at most one table per round.  Changes go through the blueprint
+machinery like the ones made with `rethinkdb admin split shard`. */
+class auto_sharder_t : private repeating_timer_callback_t {
+public:
+    auto_sharder_t(
+            mailbox_manager_t *mailbox_manager,
+            const machine_id_t &machine_id,
+            const boost::shared_ptr<semilattice_readwrite_view_t<cluster_semilattice_metadata_t> > &semilattice_view,
+            const clone_ptr_t<watchable_t<std::map<peer_id_t, cluster_directory_metadata_t> > > &directory_view,
+            namespace_repo_t<rdb_protocol_t> *ns_repo);
+
+private:
+    void on_ring();
+    void check_tables(auto_drainer_t::lock_t keepalive);
+    bool check_table(const namespace_id_t &ns_id,
+                     const std::map<machine_id_t, perfmon_result_t> &stats,
+                     signal_t *interruptor) THROWS_ONLY(interrupted_exc_t);
+    bool apply(const namespace_id_t &ns_id,
+               const auto_shard_policy_t::proposal_t &proposal);
+
+    mailbox_manager_t *mailbox_manager;
+    machine_id_t machine_id;
+    boost::shared_ptr<semilattice_readwrite_view_t<cluster_semilattice_metadata_t> > semilattice_view;
+    clone_ptr_t<watchable_t<std::map<peer_id_t, cluster_directory_metadata_t> > > directory_view;
+    namespace_repo_t<rdb_protocol_t> *ns_repo;
+
+    std::map<namespace_id_t, auto_shard_policy_t> policies;
+    bool checking;
+
+    auto_drainer_t drainer;
+    repeating_timer_t timer;
+
+    DISABLE_COPYING(auto_sharder_t);
+};
+
+#endif  // CLUSTERING_ADMINISTRATION_AUTO_SHARDER_HPP_
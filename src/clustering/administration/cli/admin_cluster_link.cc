@@ -15,6 +15,7 @@
 
 #include "arch/io/network.hpp"
 #include "clustering/administration/cli/key_parsing.hpp"
+#include "clustering/administration/machine_load.hpp"
 #include "clustering/administration/suggester.hpp"
 #include "clustering/administration/metadata_change_handler.hpp"
 #include "clustering/administration/main/watchable_fields.hpp"
@@ -1162,6 +1163,8 @@ void admin_cluster_link_t::list_pinnings_internal(const persistable_blueprint_t<
                 delta.push_back("master");
             } else if (j->second == blueprint_role_secondary) {
                 delta.push_back("replica");
+            } else if (j->second == blueprint_role_async_secondary) {
+                delta.push_back("async replica");
             } else {
                 throw admin_cluster_exc_t("unexpected error, unrecognized role type encountered");
             }
@@ -1670,7 +1673,8 @@ size_t admin_cluster_link_t::get_replica_count_from_blueprint(const persistable_
              k != j->second.end(); ++k) {
             if (k->second == blueprint_role_primary) {
                 ++count;
-            } else if (k->second == blueprint_role_secondary) {
+            } else if (k->second == blueprint_role_secondary
+                       || k->second == blueprint_role_async_secondary) {
                 ++count;
             }
         }
@@ -1825,7 +1829,8 @@ void admin_cluster_link_t::add_machine_info_from_blueprint(const persistable_blu
                 if (k->second == blueprint_role_primary) {
                     ++it->second.primaries;
                     machine_used = true;
-                } else if (k->second == blueprint_role_secondary) {
+                } else if (k->second == blueprint_role_secondary
+                           || k->second == blueprint_role_async_secondary) {
                     ++it->second.secondaries;
                     machine_used = true;
                 }
@@ -2847,6 +2852,128 @@ void admin_cluster_link_t::do_admin_touch(const admin_command_parser_t::command_
     do_metadata_update(&cluster_metadata, &change_request, false);
 }
 
+// Asks every server for its stats, and scores how busy each one is for the suggester
+std::map<machine_id_t, double> admin_cluster_link_t::get_machine_load_scores() {
+    std::map<peer_id_t, cluster_directory_metadata_t> directory = directory_read_manager->get_root_view()->get();
+    boost::ptr_map<machine_id_t, admin_stats_request_t> request_map;
+    signal_timer_t timer;
+    timer.start(5000); // 5 second timeout to get all stats
+
+    std::set<stat_manager_t::stat_id_t> requested_stats;
+    requested_stats.insert(".*");
+    for (std::map<peer_id_t, cluster_directory_metadata_t>::iterator i = directory.begin(); i != directory.end(); ++i) {
+        if (i->second.peer_type == SERVER_PEER) {
+            machine_id_t target = i->second.machine_id;
+            admin_stats_request_t *request = new admin_stats_request_t(&mailbox_manager);
+            request_map.insert(target, request);
+            send(&mailbox_manager,
+                 i->second.get_stats_mailbox_address,
+                 request->response_mailbox.get_address(),
+                 requested_stats);
+        }
+    }
+
+    std::map<machine_id_t, machine_load_t> loads;
+    std::set<machine_id_t> unresponsive;
+    for (boost::ptr_map<machine_id_t, admin_stats_request_t>::iterator i = request_map.begin(); i != request_map.end(); ++i) {
+        const signal_t *stats_ready = i->second->stats_promise.get_ready_signal();
+        wait_any_t waiter(&timer, stats_ready);
+        waiter.wait();
+
+        if (stats_ready->is_pulsed()) {
+            loads[i->first] = machine_load_from_stats(i->second->stats_promise.wait());
+        } else {
+            unresponsive.insert(i->first);
+        }
+    }
+
+    std::map<machine_id_t, double> scores = compute_machine_load_scores(loads);
+
+    // We don't know how busy these are, so don't let them look idle
+    for (std::set<machine_id_t>::iterator i = unresponsive.begin(); i != unresponsive.end(); ++i) {
+        fprintf(stderr, "Warning: no stats from machine %s, assuming average load\n", uuid_to_str(*i).c_str());
+        scores[*i] = 1.0;
+    }
+    return scores;
+}
+
+template <class protocol_t>
+void admin_cluster_link_t::count_blueprint_roles(const namespaces_semilattice_metadata_t<protocol_t> &ns_map,
+                                                 std::map<machine_id_t, int> *primaries,
+                                                 std::map<machine_id_t, int> *secondaries) {
+    for (typename namespaces_semilattice_metadata_t<protocol_t>::namespace_map_t::const_iterator i = ns_map.namespaces.begin();
+         i != ns_map.namespaces.end(); ++i) {
+        if (i->second.is_deleted() || i->second.get_ref().blueprint.in_conflict()) {
+            continue;
+        }
+        const persistable_blueprint_t<protocol_t> blueprint = i->second.get_ref().blueprint.get();
+        for (typename persistable_blueprint_t<protocol_t>::role_map_t::const_iterator j = blueprint.machines_roles.begin();
+             j != blueprint.machines_roles.end(); ++j) {
+            for (typename persistable_blueprint_t<protocol_t>::region_to_role_map_t::const_iterator k = j->second.begin();
+                 k != j->second.end(); ++k) {
+                if (k->second == blueprint_role_primary) {
+                    ++(*primaries)[j->first];
+                } else if (k->second == blueprint_role_secondary) {
+                    ++(*secondaries)[j->first];
+                }
+            }
+        }
+    }
+}
+
+void admin_cluster_link_t::do_admin_rebalance(const admin_command_parser_t::command_data_t& data) {
+    const bool dry_run = data.params.count("dry-run") == 1;
+    const std::map<machine_id_t, double> machine_loads = get_machine_load_scores();
+
+    metadata_change_handler_t<cluster_semilattice_metadata_t>::metadata_change_request_t
+        change_request(&mailbox_manager, choose_sync_peer());
+    cluster_semilattice_metadata_t cluster_metadata = change_request.get();
+
+    std::map<machine_id_t, int> old_primaries, old_secondaries;
+    count_blueprint_roles(*cluster_metadata.rdb_namespaces, &old_primaries, &old_secondaries);
+    count_blueprint_roles(*cluster_metadata.memcached_namespaces, &old_primaries, &old_secondaries);
+
+    try {
+        fill_in_blueprints(&cluster_metadata, directory_read_manager->get_root_view()->get(),
+                           change_request_id, machine_loads, true);
+    } catch (const missing_machine_exc_t &ex) {
+        throw admin_cluster_exc_t(strprintf("cannot rebalance: %s", ex.what()));
+    }
+
+    std::map<machine_id_t, int> new_primaries, new_secondaries;
+    count_blueprint_roles(*cluster_metadata.rdb_namespaces, &new_primaries, &new_secondaries);
+    count_blueprint_roles(*cluster_metadata.memcached_namespaces, &new_primaries, &new_secondaries);
+
+    if (dry_run) {
+        std::vector<std::vector<std::string> > table;
+        std::vector<std::string> delta;
+
+        delta.push_back("machine");
+        delta.push_back("load");
+        delta.push_back("primaries");
+        delta.push_back("secondaries");
+        table.push_back(delta);
+
+        for (std::map<machine_id_t, double>::const_iterator i = machine_loads.begin(); i != machine_loads.end(); ++i) {
+            delta.clear();
+            delta.push_back(get_info_from_id(uuid_to_str(i->first))->name);
+            delta.push_back(strprintf("%.2f", i->second));
+            delta.push_back(strprintf("%d -> %d", old_primaries[i->first], new_primaries[i->first]));
+            delta.push_back(strprintf("%d -> %d", old_secondaries[i->first], new_secondaries[i->first]));
+            table.push_back(delta);
+        }
+
+        if (table.size() > 1) {
+            admin_print_table(table);
+        }
+        return;
+    }
+
+    if (!change_request.update(cluster_metadata)) {
+        throw admin_retry_exc_t();
+    }
+}
+
 template <class protocol_t>
 void admin_cluster_link_t::list_single_namespace(const namespace_id_t& ns_id,
                                                  const namespace_semilattice_metadata_t<protocol_t>& ns,
@@ -3055,7 +3182,8 @@ void admin_cluster_link_t::add_single_namespace_replicas(const nonoverlapping_re
         for (typename persistable_blueprint_t<protocol_t>::role_map_t::const_iterator i = blueprint.machines_roles.begin();
              i != blueprint.machines_roles.end(); ++i) {
             typename persistable_blueprint_t<protocol_t>::region_to_role_map_t::const_iterator j = i->second.find(*s);
-            if (j != i->second.end() && j->second == blueprint_role_secondary) {
+            if (j != i->second.end() && (j->second == blueprint_role_secondary
+                                         || j->second == blueprint_role_async_secondary)) {
                 std::vector<std::string> delta;
 
                 delta.push_back(shard_str);
@@ -3324,7 +3452,8 @@ bool admin_cluster_link_t::add_single_machine_blueprint(const machine_id_t& mach
 
     for (typename persistable_blueprint_t<protocol_t>::region_to_role_map_t::const_iterator i = machine_entry->second.begin();
          i != machine_entry->second.end(); ++i) {
-        if (i->second == blueprint_role_primary || i->second == blueprint_role_secondary) {
+        if (i->second == blueprint_role_primary || i->second == blueprint_role_secondary
+            || i->second == blueprint_role_async_secondary) {
             std::vector<std::string> delta;
 
             delta.push_back(ns_uuid);
@@ -91,6 +91,7 @@ public:
     void do_admin_remove_datacenter(const admin_command_parser_t::command_data_t& data);
     void do_admin_remove_database(const admin_command_parser_t::command_data_t& data);
     void do_admin_touch(const admin_command_parser_t::command_data_t& data);
+    void do_admin_rebalance(const admin_command_parser_t::command_data_t& data);
 
     void sync_from();
 
@@ -115,6 +116,13 @@ private:
                             metadata_change_handler_t<cluster_semilattice_metadata_t>::metadata_change_request_t *change_request,
                             bool prioritize_distribution);
 
+    std::map<machine_id_t, double> get_machine_load_scores();
+
+    template <class protocol_t>
+    void count_blueprint_roles(const namespaces_semilattice_metadata_t<protocol_t> &ns_map,
+                               std::map<machine_id_t, int> *primaries,
+                               std::map<machine_id_t, int> *secondaries);
+
     template <class protocol_t>
     std::string admin_merge_shard_internal(namespaces_semilattice_metadata_t<protocol_t> *ns_map,
                                            const namespace_id_t &ns_id,
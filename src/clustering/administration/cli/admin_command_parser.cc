@@ -53,6 +53,7 @@ const char *remove_table_command = "rm table";
 const char *remove_datacenter_command = "rm datacenter";
 const char *remove_database_command = "rm database";
 const char *touch_command = "touch";
+const char *rebalance_command = "rebalance";
 
 // Special commands - used only in certain cases
 const char *admin_command_parser_t::complete_command = "complete";
@@ -92,11 +93,13 @@ const char *create_datacenter_usage = "<NAME>";
 const char *create_database_usage = "<NAME>";
 const char *remove_usage = "<ID>...";
 const char *touch_usage = "";
+const char *rebalance_usage = "[--dry-run]";
 
 const char *list_id_option = "[<ID>]";
 const char *list_long_option = "[--long]";
 const char *list_stats_machine_option = "[<MACHINE>...]";
 const char *list_stats_table_option = "[<TABLE>...]";
+const char *rebalance_dry_run_option = "[--dry-run]";
 // TODO: fix this once multiple protocols are supported again
 // const char *list_tables_protocol_option = "[--protocol <PROTOCOL>]";
 const char *resolve_id_option = "<ID>";
@@ -144,6 +147,7 @@ const char *list_id_option_desc = "print out a detailed description of a single
 const char *list_long_option_desc = "print out full uuids (and extra information when listing machines, tables, datacenters, or databases)";
 const char *list_stats_machine_option_desc = "limit stat collection to the set of machines specified";
 const char *list_stats_table_option_desc = "limit stat collection to the set of tables specified";
+const char *rebalance_dry_run_option_desc = "print how many primaries and secondaries each machine would have afterwards, without changing anything";
 // TODO: fix this once multiple protocols are supported again
 // const char *list_tables_protocol_option_desc = "limit the list of tables to tables matching the specified protocol";
 const char *resolve_id_option_desc = "the name or uuid of an object with a conflicted field";
@@ -228,6 +232,7 @@ const char *remove_table_description = "Remove one or more tables from the clust
 const char *remove_datacenter_description = "Remove one or more datacenters from the cluster.";
 const char *remove_database_description = "Remove one or more database from the cluster.";
 const char *touch_description = "Update the cluster blueprints if any are out-of-date.  An out-of-date blueprint is caused by a machine being down when a table's requirements were changed.";
+const char *rebalance_description = "Redraw the cluster blueprints taking into account how much data and traffic each machine already has, so that busy machines give up shards to idle ones.  Machine load is taken from the same statistics that 'ls stats' prints.";
 
 std::vector<std::string> parse_line(const std::string& line) {
     std::vector<std::string> result;
@@ -526,6 +531,7 @@ void admin_command_parser_t::do_usage(bool console) {
     helps.push_back(admin_help_info_t("create", "", "add a new object to the cluster"));
     helps.push_back(admin_help_info_t("rm", "", "remove an object from the cluster"));
     helps.push_back(admin_help_info_t("touch", "", "make sure cluster blueprints are up-to-date"));
+    helps.push_back(admin_help_info_t("rebalance", "", "move shards from busy machines to idle ones"));
     helps.push_back(admin_help_info_t(help_command, "", "print help about the specified command"));
 
     if (console) {
@@ -730,12 +736,15 @@ void admin_command_parser_t::build_command_descriptions() {
 
     info = add_command(touch_command, touch_command, touch_usage, &admin_cluster_link_t::do_admin_touch, &commands);
 
+    info = add_command(rebalance_command, rebalance_command, rebalance_usage, &admin_cluster_link_t::do_admin_rebalance, &commands);
+    info->add_flag("dry-run", 0, false);
+
     info = add_command(help_command, help_command, help_usage, NULL, &commands); // Special case, 'help' is not done through the cluster
-    info->add_positional("command", 1, false)->add_options("split", "merge", "set", "unset", "ls", "create", "rm", "resolve", "help", "pin", "touch", NULLPTR);
+    info->add_positional("command", 1, false)->add_options("split", "merge", "set", "unset", "ls", "create", "rm", "resolve", "help", "pin", "touch", "rebalance", NULLPTR);
     info->add_positional("subcommand", 1, false);
 
     info = add_command(dashed_help_command, dashed_help_command, help_usage, NULL, &commands); // Also allow --help to work for consistency with other rethinkdb subcommands
-    info->add_positional("command", 1, false)->add_options("split", "merge", "set", "ls", "create", "rm", "resolve", "help", "pin", "touch", NULLPTR);
+    info->add_positional("command", 1, false)->add_options("split", "merge", "set", "ls", "create", "rm", "resolve", "help", "pin", "touch", "rebalance", NULLPTR);
     info->add_positional("subcommand", 1, false);
 }
 
@@ -1451,6 +1460,13 @@ void admin_command_parser_t::do_admin_help(const command_data_t& data) {
             }
             helps.push_back(admin_help_info_t(touch_command, touch_usage, touch_description));
             do_usage_internal(helps, options, "touch - make sure cluster blueprints are up-to-date", console_mode);
+        } else if (command == "rebalance") {
+            if (!subcommand.empty()) {
+                throw admin_parse_exc_t("no recognized subcommands for 'rebalance'");
+            }
+            helps.push_back(admin_help_info_t(rebalance_command, rebalance_usage, rebalance_description));
+            options.push_back(std::make_pair(rebalance_dry_run_option, rebalance_dry_run_option_desc));
+            do_usage_internal(helps, options, "rebalance - move shards from busy machines to idle ones", console_mode);
         } else {
             throw admin_parse_exc_t("unknown command: " + command);
         }
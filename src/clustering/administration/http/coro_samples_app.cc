@@ -0,0 +1,40 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "clustering/administration/http/coro_samples_app.hpp"
+
+#include <string>
+
+#include "arch/runtime/coro_sampler.hpp"
+
+http_res_t coro_samples_http_app_t::handle(const http_req_t &req) {
+    http_req_t::resource_t::iterator it = req.resource.begin();
+    const std::string action = it == req.resource.end() ? "" : *it;
+    if (it != req.resource.end() && ++it != req.resource.end()) {
+        return http_res_t(HTTP_NOT_FOUND);
+    }
+
+    on_thread_t thread_switcher(home_thread());
+    mutex_t::acq_t acq(&sampler_mutex);
+    coro_sampler_t *sampler = &coro_sampler_t::get_global_sampler();
+
+    if (action == "") {
+        if (req.method != GET) {
+            return http_res_t(HTTP_METHOD_NOT_ALLOWED);
+        }
+        return http_res_t(HTTP_OK, "text/plain", sampler->folded_stacks());
+    }
+
+    if (action != "start" && action != "stop" && action != "clear") {
+        return http_res_t(HTTP_NOT_FOUND);
+    }
+    if (req.method != POST) {
+        return http_res_t(HTTP_METHOD_NOT_ALLOWED);
+    }
+    if (action == "start") {
+        sampler->start();
+    } else if (action == "stop") {
+        sampler->stop();
+    } else {
+        sampler->clear();
+    }
+    return http_res_t(HTTP_OK);
+}
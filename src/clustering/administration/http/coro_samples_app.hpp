@@ -0,0 +1,24 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#ifndef CLUSTERING_ADMINISTRATION_HTTP_CORO_SAMPLES_APP_HPP_
+#define CLUSTERING_ADMINISTRATION_HTTP_CORO_SAMPLES_APP_HPP_
+
+#include "concurrency/mutex.hpp"
+#include "http/http.hpp"
+#include "utils.hpp"
+
+/* Drives the `coro_sampler_t` of this server.  A GET returns its samples as
+folded stacks for flamegraph.pl, a POST to `start`, `stop` or `clear` does that
+to the sampler. */
+class coro_samples_http_app_t : public http_app_t, public home_thread_mixin_t {
+public:
+    coro_samples_http_app_t() { }
+    http_res_t handle(const http_req_t &req);
+
+private:
+    // The sampler must only be used by one coroutine at a time.
+    mutex_t sampler_mutex;
+
+    DISABLE_COPYING(coro_samples_http_app_t);
+};
+
+#endif /* CLUSTERING_ADMINISTRATION_HTTP_CORO_SAMPLES_APP_HPP_ */
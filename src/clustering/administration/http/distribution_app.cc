@@ -56,7 +56,24 @@ http_res_t distribution_app_t::handle(const http_req_t &req) {
         }
     }
 
+    // With mode=sample, the distribution is estimated from a sample of the leaves,
+    // and the result also has the estimated bytes of each range, see
+    // distribution_mode_t.
+    distribution_mode_t mode = distribution_mode_t::TRAVERSE;
+    boost::optional<std::string> maybe_mode = req.find_query_param("mode");
+
+    if (maybe_mode) {
+        if (maybe_mode.get() == "sample") {
+            mode = distribution_mode_t::SAMPLE;
+        } else if (maybe_mode.get() != "traverse") {
+            return http_error_res("Invalid mode value.");
+        }
+    }
+
     if (std_contains(ns_snapshot->namespaces, n_id)) {
+        if (mode != distribution_mode_t::TRAVERSE) {
+            return http_error_res("Sampling is not supported for memcached namespaces.");
+        }
         try {
             cond_t interrupt;
             namespace_repo_t<memcached_protocol_t>::access_t ns_access(ns_repo, n_id, &interrupt);
@@ -77,14 +94,22 @@ http_res_t distribution_app_t::handle(const http_req_t &req) {
             cond_t interrupt;
             namespace_repo_t<rdb_protocol_t>::access_t rdb_ns_access(rdb_ns_repo, n_id, &interrupt);
 
-            rdb_protocol_t::distribution_read_t inner_read(depth, limit);
+            rdb_protocol_t::distribution_read_t inner_read(depth, limit, mode);
             rdb_protocol_t::read_t read(inner_read, profile_bool_t::DONT_PROFILE);
             rdb_protocol_t::read_response_t db_res;
             rdb_ns_access.get_namespace_if()->read_outdated(read,
                                                             &db_res,
                                                             &interrupt);
 
-            scoped_cJSON_t data(render_as_json(&boost::get<rdb_protocol_t::distribution_read_response_t>(db_res.response).key_counts));
+            rdb_protocol_t::distribution_read_response_t *dist_res
+                = boost::get<rdb_protocol_t::distribution_read_response_t>(&db_res.response);
+            if (mode == distribution_mode_t::SAMPLE) {
+                scoped_cJSON_t data(cJSON_CreateObject());
+                data.AddItemToObject("key_counts", render_as_json(&dist_res->key_counts));
+                data.AddItemToObject("byte_counts", render_as_json(&dist_res->byte_counts));
+                return http_json_res(data.get());
+            }
+            scoped_cJSON_t data(render_as_json(&dist_res->key_counts));
             return http_json_res(data.get());
         } catch (const cannot_perform_query_exc_t &) {
             return http_res_t(HTTP_INTERNAL_SERVER_ERROR);
@@ -59,6 +59,10 @@ public:
 
 
     boost::optional<backfiller_business_card_t<protocol_t> > operator()(const typename reactor_business_card_t<protocol_t>::secondary_up_to_date_t &secondary_up_to_date) const {
+        if (secondary_up_to_date.is_async) {
+            /* Async secondaries don't have a replier. */
+            return boost::optional<backfiller_business_card_t<protocol_t> >();
+        }
         return secondary_up_to_date.replier.backfiller_bcard;
     }
 
@@ -1,6 +1,7 @@
 // Copyright 2010-2012 RethinkDB, all rights reserved.
 #include "clustering/administration/http/server.hpp"
 
+#include "clustering/administration/http/coro_samples_app.hpp"
 #include "clustering/administration/http/cyanide.hpp"
 #include "clustering/administration/http/directory_app.hpp"
 #include "clustering/administration/http/distribution_app.hpp"
@@ -9,6 +10,7 @@
 #include "clustering/administration/http/log_app.hpp"
 #include "clustering/administration/http/progress_app.hpp"
 #include "clustering/administration/http/semilattice_app.hpp"
+#include "clustering/administration/http/slow_queries_app.hpp"
 #include "clustering/administration/http/stat_app.hpp"
 #include "clustering/administration/http/combining_app.hpp"
 #include "http/file_app.hpp"
@@ -238,6 +240,8 @@ administrative_http_server_manager_t::administrative_http_server_manager_t(
     progress_app.init(new progress_app_t(_directory_metadata, mbox_manager));
     distribution_app.init(new distribution_app_t(metadata_field(&cluster_semilattice_metadata_t::memcached_namespaces, _semilattice_metadata), _namespace_repo,
                                                  metadata_field(&cluster_semilattice_metadata_t::rdb_namespaces, _semilattice_metadata), _rdb_namespace_repo));
+    coro_samples_app.init(new coro_samples_http_app_t);
+    slow_queries_app.init(new slow_queries_http_app_t);
 
 #ifndef NDEBUG
     cyanide_app.init(new cyanide_http_app_t);
@@ -254,6 +258,8 @@ administrative_http_server_manager_t::administrative_http_server_manager_t(
     ajax_routes["semilattice"] = cluster_semilattice_app.get();
     ajax_routes["auth"] = auth_semilattice_app.get();
     ajax_routes["reql"] = reql_app;
+    ajax_routes["coro_samples"] = coro_samples_app.get();
+    ajax_routes["slow_queries"] = slow_queries_app.get();
     DEBUG_ONLY_CODE(ajax_routes["cyanide"] = cyanide_app.get());
 
     std::map<std::string, http_json_app_t *> default_views;
@@ -29,6 +29,8 @@ class stat_manager_t;
 class distribution_app_t;
 class cyanide_http_app_t;
 class combining_http_app_t;
+class coro_samples_http_app_t;
+class slow_queries_http_app_t;
 
 class administrative_http_server_manager_t {
 
@@ -63,6 +65,8 @@ private:
     scoped_ptr_t<progress_app_t> progress_app;
     scoped_ptr_t<distribution_app_t> distribution_app;
     scoped_ptr_t<combining_http_app_t> combining_app;
+    scoped_ptr_t<coro_samples_http_app_t> coro_samples_app;
+    scoped_ptr_t<slow_queries_http_app_t> slow_queries_app;
 #ifndef NDEBUG
     scoped_ptr_t<cyanide_http_app_t> cyanide_app;
 #endif
@@ -0,0 +1,81 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "clustering/administration/http/slow_queries_app.hpp"
+
+#include <string>
+#include <vector>
+
+#include "http/json.hpp"
+#include "rdb_protocol/slow_query_log.hpp"
+
+static cJSON *render_settings(const ql::slow_query_settings_t &settings) {
+    scoped_cJSON_t json(cJSON_CreateObject());
+    json.AddItemToObject("sample_every", cJSON_CreateNumber(settings.sample_every));
+    json.AddItemToObject("threshold_ms", cJSON_CreateNumber(settings.threshold_ms));
+    return json.release();
+}
+
+static cJSON *render_query(const ql::slow_query_t &query) {
+    scoped_cJSON_t json(cJSON_CreateObject());
+    json.AddItemToObject("time", cJSON_CreateNumber(query.when));
+    json.AddItemToObject("fingerprint", cJSON_CreateString(query.fingerprint.c_str()));
+    json.AddItemToObject("server_ms", cJSON_CreateNumber(query.server_ticks / static_cast<double>(MILLION)));
+    json.AddItemToObject("cpu_ms", cJSON_CreateNumber(query.cpu_ticks / static_cast<double>(MILLION)));
+    json.AddItemToObject("rows_scanned", cJSON_CreateNumber(query.rows_scanned));
+    json.AddItemToObject("datum_bytes", query.counted_bytes
+                         ? cJSON_CreateNumber(query.datum_bytes)
+                         : cJSON_CreateNull());
+    json.AddItemToObject("sampled", cJSON_CreateBool(query.sampled));
+    cJSON *profile = query.profile.empty() ? NULL : cJSON_Parse(query.profile.c_str());
+    json.AddItemToObject("profile", profile != NULL ? profile : cJSON_CreateNull());
+    return json.release();
+}
+
+static bool parse_setting(const http_req_t &req, const std::string &name,
+                          uint64_t *setting_out) {
+    boost::optional<std::string> value = req.find_query_param(name);
+    return !value || strtou64_strict(value.get(), 10, setting_out);
+}
+
+http_res_t slow_queries_http_app_t::handle(const http_req_t &req) {
+    http_req_t::resource_t::iterator it = req.resource.begin();
+    const std::string action = it == req.resource.end() ? "" : *it;
+    if (it != req.resource.end() && ++it != req.resource.end()) {
+        return http_res_t(HTTP_NOT_FOUND);
+    }
+    if (action != "" && action != "clear") {
+        return http_res_t(HTTP_NOT_FOUND);
+    }
+
+    ql::slow_query_log_t *log = &ql::slow_query_log_t::get_global_log();
+    if (action == "clear") {
+        if (req.method != POST) {
+            return http_res_t(HTTP_METHOD_NOT_ALLOWED);
+        }
+        log->clear();
+        return http_res_t(HTTP_OK);
+    }
+
+    if (req.method == POST) {
+        ql::slow_query_settings_t settings = log->get_settings();
+        if (!parse_setting(req, "sample_every", &settings.sample_every)
+            || !parse_setting(req, "threshold_ms", &settings.threshold_ms)) {
+            return http_res_t(HTTP_BAD_REQUEST);
+        }
+        log->set_settings(settings);
+        scoped_cJSON_t json(render_settings(settings));
+        return http_json_res(json.get());
+    }
+    if (req.method != GET) {
+        return http_res_t(HTTP_METHOD_NOT_ALLOWED);
+    }
+
+    scoped_cJSON_t json(cJSON_CreateObject());
+    json.AddItemToObject("settings", render_settings(log->get_settings()));
+    scoped_cJSON_t queries(cJSON_CreateArray());
+    std::vector<ql::slow_query_t> logged = log->get_queries();
+    for (auto jt = logged.begin(); jt != logged.end(); ++jt) {
+        queries.AddItemToArray(render_query(*jt));
+    }
+    json.AddItemToObject("queries", queries.release());
+    return http_json_res(json.get());
+}
@@ -0,0 +1,15 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#ifndef CLUSTERING_ADMINISTRATION_HTTP_SLOW_QUERIES_APP_HPP_
+#define CLUSTERING_ADMINISTRATION_HTTP_SLOW_QUERIES_APP_HPP_
+
+#include "http/http.hpp"
+
+/* Serves the slow query log of this server, see `ql::slow_query_log_t`.  A GET
+returns its settings and queries, a POST with `sample_every` or `threshold_ms`
+parameters changes its settings, and a POST to `clear` empties it. */
+class slow_queries_http_app_t : public http_app_t {
+public:
+    http_res_t handle(const http_req_t &req);
+};
+
+#endif /* CLUSTERING_ADMINISTRATION_HTTP_SLOW_QUERIES_APP_HPP_ */
@@ -1,4 +1,7 @@
 // Copyright 2010-2012 RethinkDB, all rights reserved.
+#include <ctype.h>
+#include <stdlib.h>
+
 #include <string>
 #include <set>
 
@@ -51,6 +54,41 @@ cJSON *render_as_json(perfmon_result_t *target) {
     }
 }
 
+std::string prometheus_name_part(const std::string &s) {
+    std::string res(s);
+    for (std::string::iterator it = res.begin(); it != res.end(); ++it) {
+        if (!isalnum(*it) && *it != '_') {
+            *it = '_';
+        }
+    }
+    return res;
+}
+
+/* Appends the numeric stats in `target` to `out` in Prometheus' text exposition
+format, each named after its path, so the stat at "<table id>/btree/keys_read" of
+machine M becomes `<name>_<table id>_btree_keys_read{machine="M"}`.  Stats that
+aren't numbers are left out. */
+void render_as_prometheus(const std::string &machine, const std::string &name,
+                          perfmon_result_t *target, std::string *out) {
+    if (target->is_map()) {
+        for (auto it = target->cbegin(); it != target->cend(); ++it) {
+            render_as_prometheus(machine, name + "_" + prometheus_name_part(it->first),
+                                 it->second, out);
+        }
+    } else if (target->is_string()) {
+        const std::string &value = *target->get_string();
+        char *end;
+        strtod(value.c_str(), &end);
+        if (value.empty() || *end != '\0') {
+            return;
+        }
+        out->append(strprintf("%s{machine=\"%s\"} %s\n",
+                              name.c_str(), machine.c_str(), value.c_str()));
+    } else {
+        crash("Unknown perfmon_result_type\n");
+    }
+}
+
 cJSON *stat_http_app_t::prepare_machine_info(const std::vector<machine_id_t> &not_replied) {
     scoped_cJSON_t machines(cJSON_CreateObject());
 
@@ -151,7 +189,12 @@ http_res_t stat_http_app_t::handle(const http_req_t &req) {
         parse_query_params(req, &filter_paths, &machine_whitelist, &timeout);
     if (maybe_error_res) return *maybe_error_res;
 
+    // /ajax/stat/prometheus serves the same stats for Prometheus to scrape.
+    http_req_t::resource_t::iterator subresource = req.resource.begin();
+    const bool prometheus = subresource != req.resource.end() && *subresource == "prometheus";
+
     scoped_cJSON_t body(cJSON_CreateObject());
+    std::string prometheus_body;
 
     peers_to_metadata_t peers_to_metadata = directory->get();
 
@@ -188,7 +231,9 @@ http_res_t stat_http_app_t::handle(const http_req_t &req) {
 
         if (stats_ready->is_pulsed()) {
             perfmon_result_t stats = it->second->stats.wait();
-            if (stats.get_map_size() != 0) {
+            if (prometheus) {
+                render_as_prometheus(uuid_to_str(machine), "rethinkdb", &stats, &prometheus_body);
+            } else if (stats.get_map_size() != 0) {
                 body.AddItemToObject(uuid_to_str(machine).c_str(), render_as_json(&stats));
             }
         } else {
@@ -196,6 +241,10 @@ http_res_t stat_http_app_t::handle(const http_req_t &req) {
         }
     }
 
+    if (prometheus) {
+        return http_res_t(HTTP_OK, "text/plain; version=0.0.4", prometheus_body);
+    }
+
     cJSON_AddItemToObject(body.get(), "machines", prepare_machine_info(not_replied));
 
     return http_json_res(body.get());
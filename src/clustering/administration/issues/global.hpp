@@ -37,6 +37,44 @@ private:
     DISABLE_COPYING(global_issue_tracker_t);
 };
 
+/* The trackers that only look at the metadata keep the issues they found in a
+`cached_issues_t` until the metadata changes, so that the web UI asking for the
+issues over and over doesn't scan the whole metadata every time. */
+template <class issue_t>
+class cached_issues_t : public home_thread_mixin_t {
+public:
+    cached_issues_t() : valid(false) { }
+
+    void invalidate() {
+        assert_thread();
+        valid = false;
+        issues.clear();
+    }
+
+    bool has() const {
+        assert_thread();
+        return valid;
+    }
+
+    const std::list<clone_ptr_t<issue_t> > &get() const {
+        assert_thread();
+        rassert(valid);
+        return issues;
+    }
+
+    void set(const std::list<clone_ptr_t<issue_t> > &_issues) {
+        assert_thread();
+        issues = _issues;
+        valid = true;
+    }
+
+private:
+    bool valid;
+    std::list<clone_ptr_t<issue_t> > issues;
+
+    DISABLE_COPYING(cached_issues_t);
+};
+
 class global_issue_aggregator_t : public global_issue_tracker_t {
 public:
     class source_t {
@@ -1,6 +1,9 @@
 // Copyright 2010-2012 RethinkDB, all rights reserved.
 #include "clustering/administration/issues/name_conflict.hpp"
 
+#include "errors.hpp"
+#include <boost/bind.hpp>
+
 name_conflict_issue_t::name_conflict_issue_t(
         const std::string &_type,
         const std::string &_contested_name,
@@ -122,11 +125,17 @@ private:
 };
 
 name_conflict_issue_tracker_t::name_conflict_issue_tracker_t(boost::shared_ptr<semilattice_read_view_t<cluster_semilattice_metadata_t> > _semilattice_view)
-    : semilattice_view(_semilattice_view) { }
+    : semilattice_view(_semilattice_view),
+      subscription(boost::bind(&cached_issues_t<global_issue_t>::invalidate, &cached_issues),
+                   semilattice_view) { }
 
 name_conflict_issue_tracker_t::~name_conflict_issue_tracker_t() { }
 
 std::list<clone_ptr_t<global_issue_t> > name_conflict_issue_tracker_t::get_issues() {
+    if (cached_issues.has()) {
+        return cached_issues.get();
+    }
+
     cluster_semilattice_metadata_t metadata = semilattice_view->get();
 
     std::list<clone_ptr_t<global_issue_t> > issues;
@@ -149,5 +158,6 @@ std::list<clone_ptr_t<global_issue_t> > name_conflict_issue_tracker_t::get_issue
     databases.file_away(metadata.databases.databases);
     databases.report("database", &issues);
 
+    cached_issues.set(issues);
     return issues;
 }
@@ -10,8 +10,7 @@
 #include "clustering/administration/issues/json.hpp"
 #include "clustering/administration/metadata.hpp"
 #include "http/json.hpp"
-
-template <class> class semilattice_read_view_t;
+#include "rpc/semilattice/view.hpp"
 
 class name_conflict_issue_t : public global_issue_t {
 public:
@@ -46,6 +45,9 @@ public:
 private:
     boost::shared_ptr<semilattice_read_view_t<cluster_semilattice_metadata_t> > semilattice_view;
 
+    cached_issues_t<global_issue_t> cached_issues;
+    semilattice_read_view_t<cluster_semilattice_metadata_t>::subscription_t subscription;
+
     DISABLE_COPYING(name_conflict_issue_tracker_t);
 };
 
@@ -1,6 +1,9 @@
 // Copyright 2010-2012 RethinkDB, all rights reserved.
 #include "clustering/administration/issues/pinnings_shards_mismatch.hpp"
 
+#include "errors.hpp"
+#include <boost/bind.hpp>
+
 #include "clustering/administration/http/json_adapters.hpp"
 #include "http/json/json_adapter.hpp"
 #include "utils.hpp"
@@ -56,59 +59,84 @@ pinnings_shards_mismatch_issue_t<protocol_t> *pinnings_shards_mismatch_issue_t<p
 
 template <class protocol_t>
 pinnings_shards_mismatch_issue_tracker_t<protocol_t>::pinnings_shards_mismatch_issue_tracker_t(boost::shared_ptr<semilattice_read_view_t<cow_ptr_t<namespaces_semilattice_metadata_t<protocol_t> > > > _semilattice_view)
-    : semilattice_view(_semilattice_view) { }
+    : semilattice_view(_semilattice_view),
+      subscription(boost::bind(&cached_issues_t<global_issue_t>::invalidate, &cached_issues),
+                   semilattice_view) { }
 
 template <class protocol_t>
 pinnings_shards_mismatch_issue_tracker_t<protocol_t>::~pinnings_shards_mismatch_issue_tracker_t() { }
 
+template <class protocol_t>
+static bool pinnings_match_shards(const nonoverlapping_regions_t<protocol_t> &shards,
+                                  const region_map_t<protocol_t, machine_id_t> &primary_pinnings,
+                                  const region_map_t<protocol_t, std::set<machine_id_t> > &secondary_pinnings) {
+    for (typename std::set<typename protocol_t::region_t>::iterator shit = shards.begin();
+         shit != shards.end(); ++shit) {
+        /* Check primary pinnings for problem. */
+        region_map_t<protocol_t, machine_id_t> primary_masked_pinnings = primary_pinnings.mask(*shit);
+
+        machine_id_t primary_expected_val = primary_masked_pinnings.begin()->second;
+        for (typename region_map_t<protocol_t, machine_id_t>::iterator pit = primary_masked_pinnings.begin();
+             pit != primary_masked_pinnings.end(); ++pit) {
+            if (pit->second != primary_expected_val) {
+                return false;
+            }
+        }
+
+        /* Check secondary pinnings for problem. */
+        region_map_t<protocol_t, std::set<machine_id_t> > secondary_masked_pinnings = secondary_pinnings.mask(*shit);
+
+        std::set<machine_id_t> secondary_expected_val = secondary_masked_pinnings.begin()->second;
+        for (typename region_map_t<protocol_t, std::set<machine_id_t> >::iterator pit  = secondary_masked_pinnings.begin();
+                                                                                  pit != secondary_masked_pinnings.end();
+                                                                                  ++pit) {
+            if (pit->second!= secondary_expected_val) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
 template <class protocol_t>
 std::list<clone_ptr_t<global_issue_t> > pinnings_shards_mismatch_issue_tracker_t<protocol_t>::get_issues() {
+    if (cached_issues.has()) {
+        return cached_issues.get();
+    }
+
     std::list<clone_ptr_t<global_issue_t> > res;
 
     cow_ptr_t<namespaces_semilattice_metadata_t<protocol_t> > namespaces = semilattice_view->get();
 
+    std::map<namespace_id_t, checked_namespace_t> still_checked;
     for (typename namespaces_semilattice_metadata_t<protocol_t>::namespace_map_t::const_iterator it = namespaces->namespaces.begin();
          it != namespaces->namespaces.end();
          ++it) {
         if (it->second.is_deleted()) {
             continue;
         }
-        nonoverlapping_regions_t<protocol_t> shards = it->second.get_ref().shards.get();
-        region_map_t<protocol_t, machine_id_t> primary_pinnings = it->second.get_ref().primary_pinnings.get();
-        region_map_t<protocol_t, std::set<machine_id_t> > secondary_pinnings = it->second.get_ref().secondary_pinnings.get();
-        for (typename std::set<typename protocol_t::region_t>::iterator shit = shards.begin();
-             shit != shards.end(); ++shit) {
-            /* Check primary pinnings for problem. */
-            region_map_t<protocol_t, machine_id_t> primary_masked_pinnings = primary_pinnings.mask(*shit);
-
-            machine_id_t primary_expected_val = primary_masked_pinnings.begin()->second;
-            for (typename region_map_t<protocol_t, machine_id_t>::iterator pit = primary_masked_pinnings.begin();
-                 pit != primary_masked_pinnings.end(); ++pit) {
-                if (pit->second != primary_expected_val) {
-                    res.push_back(clone_ptr_t<global_issue_t>(new pinnings_shards_mismatch_issue_t<protocol_t>(it->first, shards, primary_pinnings, secondary_pinnings)));
-                    goto namespace_has_issue;
-                }
-            }
-
-            /* Check secondary pinnings for problem. */
-            region_map_t<protocol_t, std::set<machine_id_t> > secondary_masked_pinnings = secondary_pinnings.mask(*shit);
-
-            std::set<machine_id_t> secondary_expected_val = secondary_masked_pinnings.begin()->second;
-            for (typename region_map_t<protocol_t, std::set<machine_id_t> >::iterator pit  = secondary_masked_pinnings.begin();
-                                                                                      pit != secondary_masked_pinnings.end();
-                                                                                      ++pit) {
-                if (pit->second!= secondary_expected_val) {
-                    res.push_back(clone_ptr_t<global_issue_t>(new pinnings_shards_mismatch_issue_t<protocol_t>(it->first, shards, primary_pinnings, secondary_pinnings)));
-                    goto namespace_has_issue;
-                }
-            }
+        checked_namespace_t *checked = &still_checked[it->first];
+        checked->shards = it->second.get_ref().shards.get();
+        checked->primary_pinnings = it->second.get_ref().primary_pinnings.get();
+        checked->secondary_pinnings = it->second.get_ref().secondary_pinnings.get();
+
+        typename std::map<namespace_id_t, checked_namespace_t>::const_iterator last = checked_namespaces.find(it->first);
+        if (last != checked_namespaces.end()
+            && last->second.shards == checked->shards
+            && last->second.primary_pinnings == checked->primary_pinnings
+            && last->second.secondary_pinnings == checked->secondary_pinnings) {
+            checked->mismatched = last->second.mismatched;
+        } else {
+            checked->mismatched = !pinnings_match_shards(checked->shards, checked->primary_pinnings, checked->secondary_pinnings);
         }
 
-    namespace_has_issue:
-        (void)0;
-        // do nothing, continue around loop.
+        if (checked->mismatched) {
+            res.push_back(clone_ptr_t<global_issue_t>(new pinnings_shards_mismatch_issue_t<protocol_t>(it->first, checked->shards, checked->primary_pinnings, checked->secondary_pinnings)));
+        }
     }
+    checked_namespaces.swap(still_checked);
 
+    cached_issues.set(res);
     return res;
 }
 
@@ -3,6 +3,7 @@
 #define CLUSTERING_ADMINISTRATION_ISSUES_PINNINGS_SHARDS_MISMATCH_HPP_
 
 #include <list>
+#include <map>
 #include <set>
 #include <string>
 
@@ -10,8 +11,7 @@
 #include "clustering/administration/issues/json.hpp"
 #include "clustering/administration/metadata.hpp"
 #include "http/json.hpp"
-
-template <class> class semilattice_read_view_t;
+#include "rpc/semilattice/view.hpp"
 
 template <class protocol_t>
 class pinnings_shards_mismatch_issue_t : public global_issue_t {
@@ -46,8 +46,22 @@ public:
     std::list<clone_ptr_t<global_issue_t> > get_issues();
 
 private:
+    // What the shards and pinnings of a namespace were the last time they were
+    // checked, so that only the namespaces whose shards or pinnings changed get
+    // checked again.
+    struct checked_namespace_t {
+        nonoverlapping_regions_t<protocol_t> shards;
+        region_map_t<protocol_t, machine_id_t> primary_pinnings;
+        region_map_t<protocol_t, std::set<machine_id_t> > secondary_pinnings;
+        bool mismatched;
+    };
+
     boost::shared_ptr<semilattice_read_view_t<cow_ptr_t<namespaces_semilattice_metadata_t<protocol_t> > > > semilattice_view;
 
+    std::map<namespace_id_t, checked_namespace_t> checked_namespaces;
+    cached_issues_t<global_issue_t> cached_issues;
+    typename semilattice_read_view_t<cow_ptr_t<namespaces_semilattice_metadata_t<protocol_t> > >::subscription_t subscription;
+
     DISABLE_COPYING(pinnings_shards_mismatch_issue_tracker_t);
 };
 
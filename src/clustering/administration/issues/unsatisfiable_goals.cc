@@ -1,7 +1,8 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "clustering/administration/issues/unsatisfiable_goals.hpp"
 
-#include "rpc/semilattice/view.hpp"
+#include "errors.hpp"
+#include <boost/bind.hpp>
 
 unsatisfiable_goals_issue_t::unsatisfiable_goals_issue_t(
         const namespace_id_t &ni,
@@ -97,10 +98,16 @@ static void make_issues(const cow_ptr_t<namespaces_semilattice_metadata_t<protoc
 }
 
 unsatisfiable_goals_issue_tracker_t::unsatisfiable_goals_issue_tracker_t(boost::shared_ptr<semilattice_read_view_t<cluster_semilattice_metadata_t> > _semilattice_view)
-    : semilattice_view(_semilattice_view) { }
+    : semilattice_view(_semilattice_view),
+      subscription(boost::bind(&cached_issues_t<global_issue_t>::invalidate, &cached_issues),
+                   semilattice_view) { }
 unsatisfiable_goals_issue_tracker_t::~unsatisfiable_goals_issue_tracker_t() { }
 
 std::list<clone_ptr_t<global_issue_t> > unsatisfiable_goals_issue_tracker_t::get_issues() {
+    if (cached_issues.has()) {
+        return cached_issues.get();
+    }
+
     cluster_semilattice_metadata_t metadata = semilattice_view->get();
 
     std::map<datacenter_id_t, int> actual_machines_in_datacenters;
@@ -115,5 +122,6 @@ std::list<clone_ptr_t<global_issue_t> > unsatisfiable_goals_issue_tracker_t::get
     make_issues(metadata.rdb_namespaces, actual_machines_in_datacenters, &issues);
     make_issues(metadata.dummy_namespaces, actual_machines_in_datacenters, &issues);
     make_issues(metadata.memcached_namespaces, actual_machines_in_datacenters, &issues);
+    cached_issues.set(issues);
     return issues;
 }
@@ -1,6 +1,9 @@
 // Copyright 2010-2012 RethinkDB, all rights reserved.
 #include "clustering/administration/issues/vector_clock_conflict.hpp"
 
+#include "errors.hpp"
+#include <boost/bind.hpp>
+
 namespace {
 
 template<class type_t>
@@ -33,6 +36,9 @@ void check_namespaces_for_protocol(
             check("namespace", it->first, "secondary_pinnings", it->second.get_ref().secondary_pinnings, out);
             check("namespace", it->first, "database", it->second.get_ref().database, out);
             check("namespace", it->first, "cache_size", it->second.get_ref().cache_size, out);
+            check("namespace", it->first, "max_backfill_mb_per_sec", it->second.get_ref().max_backfill_mb_per_sec, out);
+            check("namespace", it->first, "near_cache_rows", it->second.get_ref().near_cache_rows, out);
+            check("namespace", it->first, "block_size", it->second.get_ref().block_size, out);
         }
     }
 }
@@ -43,11 +49,19 @@ vector_clock_conflict_issue_tracker_t::vector_clock_conflict_issue_tracker_t(
     boost::shared_ptr<semilattice_read_view_t<cluster_semilattice_metadata_t> > _cluster_view,
     boost::shared_ptr<semilattice_read_view_t<auth_semilattice_metadata_t> > _auth_view) :
     cluster_view(_cluster_view),
-    auth_view(_auth_view) { }
+    auth_view(_auth_view),
+    cluster_subscription(boost::bind(&cached_issues_t<vector_clock_conflict_issue_t>::invalidate, &cached_issues),
+                         cluster_view),
+    auth_subscription(boost::bind(&cached_issues_t<vector_clock_conflict_issue_t>::invalidate, &cached_issues),
+                      auth_view) { }
 
 vector_clock_conflict_issue_tracker_t::~vector_clock_conflict_issue_tracker_t() { }
 
 std::list<clone_ptr_t<vector_clock_conflict_issue_t> > vector_clock_conflict_issue_tracker_t::get_vector_clock_issues() {
+    if (cached_issues.has()) {
+        return cached_issues.get();
+    }
+
     cluster_semilattice_metadata_t cluster_metadata = cluster_view->get();
     auth_semilattice_metadata_t auth_metadata = auth_view->get();
 
@@ -86,6 +100,7 @@ std::list<clone_ptr_t<vector_clock_conflict_issue_t> > vector_clock_conflict_iss
     // Check auth metadata
     check("auth_key", nil_uuid(), "auth_key", auth_metadata.auth_key, &issues);
 
+    cached_issues.set(issues);
     return issues;
 }
 
@@ -8,8 +8,7 @@
 #include "clustering/administration/issues/global.hpp"
 #include "clustering/administration/issues/json.hpp"
 #include "clustering/administration/metadata.hpp"
-
-template <class metadata_t> class semilattice_read_view_t;
+#include "rpc/semilattice/view.hpp"
 
 class vector_clock_conflict_issue_t : public global_issue_t {
 public:
@@ -66,6 +65,10 @@ private:
     boost::shared_ptr<semilattice_read_view_t<cluster_semilattice_metadata_t> > cluster_view;
     boost::shared_ptr<semilattice_read_view_t<auth_semilattice_metadata_t> > auth_view;
 
+    cached_issues_t<vector_clock_conflict_issue_t> cached_issues;
+    semilattice_read_view_t<cluster_semilattice_metadata_t>::subscription_t cluster_subscription;
+    semilattice_read_view_t<auth_semilattice_metadata_t>::subscription_t auth_subscription;
+
     DISABLE_COPYING(vector_clock_conflict_issue_tracker_t);
 };
 
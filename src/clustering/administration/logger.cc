@@ -258,11 +258,12 @@ public:
     friend class thread_pool_log_writer_t;
 
 private:
-    friend void log_coro(thread_pool_log_writer_t *writer, log_level_t level, const std::string &message, auto_drainer_t::lock_t);
     friend void log_internal(const char *src_file, int src_line, log_level_t level, const char *format, ...);
     friend void vlog_internal(const char *src_file, int src_line, log_level_t level, const char *format, va_list args);
 
-    bool write(const log_message_t &msg, std::string *error_out);
+    // Writes all of `msgs` to stderr and the log file at once, and syncs them if
+    // `sync` is set.
+    bool write(const std::vector<log_message_t> &msgs, bool sync, std::string *error_out);
     void initiate_write(log_level_t level, const std::string &message);
     base_path_t filename;
     struct timespec uptime_reference;
@@ -309,26 +310,48 @@ void fallback_log_writer_t::install(const std::string &logfile_name) {
     }
 }
 
-bool fallback_log_writer_t::write(const log_message_t &msg, std::string *error_out) {
-    std::string formatted = format_log_message(msg);
-    std::string console_formatted = format_log_message(msg, true);
+// Writes all of `data` to `fd`, or returns false with `errno` set.
+static bool write_fully(int fd, const std::string &data) {
+    size_t written = 0;
+    while (written < data.length()) {
+        ssize_t res = ::write(fd, data.data() + written, data.length() - written);
+        if (res == -1 && errno == EINTR) {
+            continue;
+        } else if (res <= 0) {
+            return false;
+        }
+        written += res;
+    }
+    return true;
+}
+
+bool fallback_log_writer_t::write(const std::vector<log_message_t> &msgs, bool sync, std::string *error_out) {
+    std::string formatted;
+    std::string console_formatted;
+    for (std::vector<log_message_t>::const_iterator it = msgs.begin(); it != msgs.end(); ++it) {
+        formatted += format_log_message(*it);
+        console_formatted += format_log_message(*it, true);
+    }
 
     flockfile(stderr);
+    bool stderr_ok = write_fully(STDERR_FILENO, console_formatted);
+    int write_errno = errno;
+    int res = 0;
+    if (stderr_ok && sync) {
+        res = fsync(STDERR_FILENO);
+        write_errno = errno;
+    }
+    funlockfile(stderr);
 
-    ssize_t write_res = ::write(STDERR_FILENO, console_formatted.data(), console_formatted.length());
-    if (write_res != static_cast<ssize_t>(console_formatted.length())) {
-        error_out->assign("cannot write to standard error: " + errno_string(errno));
+    if (!stderr_ok) {
+        error_out->assign("cannot write to standard error: " + errno_string(write_errno));
         return false;
     }
-
-    int res = fsync(STDERR_FILENO);
-    if (res != 0 && !(errno == EROFS || errno == EINVAL)) {
-        error_out->assign("cannot flush stderr: " + errno_string(errno));
+    if (res != 0 && !(write_errno == EROFS || write_errno == EINVAL)) {
+        error_out->assign("cannot flush stderr: " + errno_string(write_errno));
         return false;
     }
 
-    funlockfile(stderr);
-
     if (fd.get() == -1) {
         error_out->assign("cannot open or find log file");
         return false;
@@ -340,12 +363,21 @@ bool fallback_log_writer_t::write(const log_message_t &msg, std::string *error_o
         return false;
     }
 
-    write_res = ::write(fd.get(), formatted.data(), formatted.length());
-    if (write_res != static_cast<ssize_t>(formatted.length())) {
+    if (!write_fully(fd.get(), formatted)) {
         error_out->assign("cannot write to log file: " + errno_string(errno));
+        UNUSED int unlock_res = fcntl(fd.get(), F_SETLK, &fileunlock);
         return false;
     }
 
+    if (sync) {
+        res = fdatasync(fd.get());
+        if (res != 0) {
+            error_out->assign("cannot flush log file: " + errno_string(errno));
+            UNUSED int unlock_res = fcntl(fd.get(), F_SETLK, &fileunlock);
+            return false;
+        }
+    }
+
     res = fcntl(fd.get(), F_SETLK, &fileunlock);
     if (res != 0) {
         error_out->assign("cannot unlock log file: " + errno_string(errno));
@@ -356,9 +388,9 @@ bool fallback_log_writer_t::write(const log_message_t &msg, std::string *error_o
 }
 
 void fallback_log_writer_t::initiate_write(log_level_t level, const std::string &message) {
-    log_message_t log_msg = assemble_log_message(level, message, uptime_reference);
+    std::vector<log_message_t> log_msgs(1, assemble_log_message(level, message, uptime_reference));
     std::string error_message;
-    if (!write(log_msg, &error_message)) {
+    if (!write(log_msgs, true, &error_message)) {
         fprintf(stderr, "Previous message may not have been written to the log file (%s).\n", error_message.c_str());
     }
 }
@@ -367,9 +399,18 @@ void fallback_log_writer_t::initiate_write(log_level_t level, const std::string
 
 TLS_with_init(thread_pool_log_writer_t *, global_log_writer, NULL);
 TLS_with_init(auto_drainer_t *, global_log_drainer, NULL);
+TLS_with_init(unwritten_log_messages_t *, global_log_buffer, NULL);
 TLS_with_init(int, log_writer_block, 0);
 
-thread_pool_log_writer_t::thread_pool_log_writer_t(local_issue_tracker_t *it) : issue_tracker(it) {
+thread_pool_log_writer_t::thread_pool_log_writer_t(local_issue_tracker_t *it) :
+    writing(false),
+    unsynced(false),
+    last_sync_ticks(0),
+    last_level(log_level_debug),
+    last_message_ticks(0),
+    repeats(0),
+    issue_tracker(it),
+    sync_timer(LOG_FSYNC_INTERVAL_MS, this) {
     pmap(get_num_threads(), boost::bind(&thread_pool_log_writer_t::install_on_thread, this, _1));
 }
 
@@ -409,6 +450,7 @@ std::vector<log_message_t> thread_pool_log_writer_t::tail(int max_lines, struct
 void thread_pool_log_writer_t::install_on_thread(int i) {
     on_thread_t thread_switcher((threadnum_t(i)));
     guarantee(TLS_get_global_log_writer() == NULL);
+    TLS_set_global_log_buffer(new unwritten_log_messages_t);
     TLS_set_global_log_drainer(new auto_drainer_t);
     TLS_set_global_log_writer(this);
 }
@@ -419,29 +461,107 @@ void thread_pool_log_writer_t::uninstall_on_thread(int i) {
     TLS_set_global_log_writer(NULL);
     delete TLS_get_global_log_drainer();
     TLS_set_global_log_drainer(NULL);
+    delete TLS_get_global_log_buffer();
+    TLS_set_global_log_buffer(NULL);
 }
 
-void thread_pool_log_writer_t::write(const log_message_t &lm) {
-    mutex_t::acq_t write_mutex_acq(&write_mutex);
-    std::string error_message;
-    bool ok;
-    thread_pool_t::run_in_blocker_pool(boost::bind(&thread_pool_log_writer_t::write_blocking, this, lm, &error_message, &ok));
-    if (ok) {
-        issue.reset();
-    } else {
-        if (!issue.has()) {
-            issue.init(new local_issue_tracker_t::entry_t(
-                issue_tracker,
-                local_issue_t("LOGFILE_WRITE_ERROR", true, error_message)));
+void thread_pool_log_writer_t::write(const unwritten_log_messages_t &messages) {
+    assert_thread();
+    for (unwritten_log_messages_t::const_iterator it = messages.begin(); it != messages.end(); ++it) {
+        add_message(it->first, it->second);
+    }
+    if (!pending.empty()) {
+        start_writing();
+    }
+}
+
+void thread_pool_log_writer_t::add_message(log_level_t level, const std::string &message) {
+    const ticks_t now = get_ticks();
+    if (level == last_level && message == last_message
+        && now - last_message_ticks < secs_to_ticks(LOG_DUPLICATE_SUPPRESSION_SECS)) {
+        ++repeats;
+        return;
+    }
+    add_repeats_message();
+    pending.push_back(assemble_log_message(level, message, fallback_log_writer.uptime_reference));
+    last_level = level;
+    last_message = message;
+    last_message_ticks = now;
+}
+
+void thread_pool_log_writer_t::add_repeats_message() {
+    if (repeats > 0) {
+        pending.push_back(assemble_log_message(
+            last_level,
+            strprintf("The last message was repeated %d more times.", repeats),
+            fallback_log_writer.uptime_reference));
+        repeats = 0;
+    }
+}
+
+void thread_pool_log_writer_t::start_writing() {
+    if (!writing) {
+        writing = true;
+        coro_t::spawn_sometime(boost::bind(&thread_pool_log_writer_t::write_pending, this,
+                                           auto_drainer_t::lock_t(&drainer)));
+    }
+}
+
+void thread_pool_log_writer_t::write_pending(auto_drainer_t::lock_t) {
+    for (;;) {
+        std::vector<log_message_t> messages;
+        messages.swap(pending);
+        bool sync = (unsynced || !messages.empty())
+            && get_ticks() - last_sync_ticks >= static_cast<ticks_t>(LOG_FSYNC_INTERVAL_MS) * MILLION;
+        for (std::vector<log_message_t>::const_iterator it = messages.begin();
+             it != messages.end(); ++it) {
+            if (it->level == log_level_error) {
+                sync = true;
+            }
+        }
+        if (messages.empty() && !sync) {
+            break;
+        }
+
+        std::string error_message;
+        bool ok;
+        thread_pool_t::run_in_blocker_pool(boost::bind(&thread_pool_log_writer_t::write_blocking, this, boost::cref(messages), sync, &error_message, &ok));
+        if (sync) {
+            last_sync_ticks = get_ticks();
+            unsynced = false;
+        } else {
+            unsynced = true;
+        }
+        if (ok) {
+            issue.reset();
+        } else {
+            if (!issue.has()) {
+                issue.init(new local_issue_tracker_t::entry_t(
+                    issue_tracker,
+                    local_issue_t("LOGFILE_WRITE_ERROR", true, error_message)));
+            }
         }
     }
+    writing = false;
 }
 
-void thread_pool_log_writer_t::write_blocking(const log_message_t &msg, std::string *error_out, bool *ok_out) {
-    *ok_out = fallback_log_writer.write(msg, error_out);
+void thread_pool_log_writer_t::write_blocking(const std::vector<log_message_t> &msgs, bool sync, std::string *error_out, bool *ok_out) {
+    *ok_out = fallback_log_writer.write(msgs, sync, error_out);
     return;
 }
 
+void thread_pool_log_writer_t::on_ring() {
+    // A message that's still being repeated gets its count written once the
+    // suppression ends, and the writes since the last sync get synced.
+    if (repeats > 0 && get_ticks() - last_message_ticks >= secs_to_ticks(LOG_DUPLICATE_SUPPRESSION_SECS)) {
+        add_repeats_message();
+        last_message.clear();
+    }
+    if (unsynced || !pending.empty()) {
+        start_writing();
+    }
+}
+
 bool operator<(const struct timespec &t1, const struct timespec &t2) {
     return t1.tv_sec < t2.tv_sec || (t1.tv_sec == t2.tv_sec && t1.tv_nsec < t2.tv_nsec);
 }
@@ -480,11 +600,12 @@ void thread_pool_log_writer_t::tail_blocking(int max_lines, struct timespec min_
     }
 }
 
-void log_coro(thread_pool_log_writer_t *writer, log_level_t level, const std::string &message, auto_drainer_t::lock_t) {
-    on_thread_t thread_switcher(writer->home_thread());
+void log_coro(thread_pool_log_writer_t *writer, auto_drainer_t::lock_t) {
+    unwritten_log_messages_t messages;
+    messages.swap(*TLS_get_global_log_buffer());
 
-    log_message_t log_msg = assemble_log_message(level, message, fallback_log_writer.uptime_reference);
-    writer->write(log_msg);
+    on_thread_t thread_switcher(writer->home_thread());
+    writer->write(messages);
 }
 
 /* Declared in `logger.hpp`, not `clustering/administration/logger.hpp` like the
@@ -499,10 +620,14 @@ void log_internal(const char *src_file, int src_line, log_level_t level, const c
 void vlog_internal(UNUSED const char *src_file, UNUSED int src_line, log_level_t level, const char *format, va_list args) {
     thread_pool_log_writer_t *writer;
     if ((writer = TLS_get_global_log_writer()) && TLS_get_log_writer_block() == 0) {
-        auto_drainer_t::lock_t lock(TLS_get_global_log_drainer());
-
-        std::string message = vstrprintf(format, args);
-        coro_t::spawn_sometime(boost::bind(&log_coro, writer, level, message, lock));
+        // The first message in the thread's buffer sends all of them that get
+        // logged before the coroutine runs.
+        unwritten_log_messages_t *buffer = TLS_get_global_log_buffer();
+        buffer->push_back(std::make_pair(level, vstrprintf(format, args)));
+        if (buffer->size() == 1) {
+            auto_drainer_t::lock_t lock(TLS_get_global_log_drainer());
+            coro_t::spawn_sometime(boost::bind(&log_coro, writer, lock));
+        }
 
     } else {
         std::string message = vstrprintf(format, args);
@@ -7,10 +7,13 @@
 
 #include <queue>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "arch/io/io_utils.hpp"
+#include "arch/timing.hpp"
 #include "clustering/administration/issues/local.hpp"
+#include "concurrency/auto_drainer.hpp"
 #include "containers/scoped.hpp"
 #include "logger.hpp"
 #include "rpc/mailbox/typed.hpp"
@@ -42,7 +45,17 @@ log_message_t assemble_log_message(log_level_t level, const std::string &message
 void log_internal(const char *src_file, int src_line, log_level_t level, const char *format, ...) __attribute__((format (printf, 4, 5)));
 void vlog_internal(const char *src_file, int src_line, log_level_t level, const char *format, va_list args) __attribute__((format (printf, 4, 0)));
 
-class thread_pool_log_writer_t : public home_thread_mixin_t {
+// The messages a thread has logged that haven't gone to the log writer yet.
+typedef std::vector<std::pair<log_level_t, std::string> > unwritten_log_messages_t;
+
+/* thread_pool_log_writer_t writes the log from the blocker pool, so that the
+threads don't wait for the disk.  Every thread buffers the messages it logs and
+sends them all to the home thread at once, and the home thread writes all the
+messages that came in while the last write was on the disk in one write.  The log
+is synced on every error and otherwise at most every LOG_FSYNC_INTERVAL_MS.  When
+the same message is logged over and over, it's written once every
+LOG_DUPLICATE_SUPPRESSION_SECS and the log says how many times it was repeated. */
+class thread_pool_log_writer_t : public home_thread_mixin_t, private repeating_timer_callback_t {
 public:
     explicit thread_pool_log_writer_t(local_issue_tracker_t *issue_tracker);
     ~thread_pool_log_writer_t();
@@ -50,18 +63,40 @@ public:
     std::vector<log_message_t> tail(int max_lines, struct timespec min_timestamp, struct timespec max_timestamp, signal_t *interruptor) THROWS_ONLY(std::runtime_error, interrupted_exc_t);
 
 private:
-    friend void log_coro(thread_pool_log_writer_t *writer, log_level_t level, const std::string &message, auto_drainer_t::lock_t lock);
+    friend void log_coro(thread_pool_log_writer_t *writer, auto_drainer_t::lock_t lock);
     friend void log_internal(const char *src_file, int src_line, log_level_t level, const char *format, ...);
     friend void vlog_internal(const char *src_file, int src_line, log_level_t level, const char *format, va_list args);
     void install_on_thread(int i);
     void uninstall_on_thread(int i);
-    void write(const log_message_t &msg);
-    void write_blocking(const log_message_t &msg, std::string *error_out, bool *ok_out);
+    void write(const unwritten_log_messages_t &messages);
+    void add_message(log_level_t level, const std::string &message);
+    void add_repeats_message();
+    void start_writing();
+    void write_pending(auto_drainer_t::lock_t lock);
+    void write_blocking(const std::vector<log_message_t> &msgs, bool sync, std::string *error_out, bool *ok_out);
     void tail_blocking(int max_lines, struct timespec min_timestamp, struct timespec max_timestamp, volatile bool *cancel, std::vector<log_message_t> *messages_out, std::string *error_out, bool *ok_out);
-    mutex_t write_mutex;
+    void on_ring();
+
+    // The messages waiting for the next write, whether it's running, and whether
+    // the log has been written to since it was last synced.
+    std::vector<log_message_t> pending;
+    bool writing;
+    bool unsynced;
+    ticks_t last_sync_ticks;
+
+    // The last message that was written, when, and how many times it has been
+    // logged again since.
+    log_level_t last_level;
+    std::string last_message;
+    ticks_t last_message_ticks;
+    int repeats;
+
     local_issue_tracker_t *issue_tracker;
     scoped_ptr_t<local_issue_tracker_t::entry_t> issue;
 
+    auto_drainer_t drainer;
+    repeating_timer_t sync_timer;
+
     DISABLE_COPYING(thread_pool_log_writer_t);
 };
 
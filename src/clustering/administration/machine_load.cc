@@ -0,0 +1,66 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "clustering/administration/machine_load.hpp"
+
+#include <stdlib.h>
+
+#include <string>
+
+#include "perfmon/core.hpp"
+
+namespace {
+
+void add_stats_to_load(const perfmon_result_t &stats, machine_load_t *load) {
+    for (perfmon_result_t::const_iterator it = stats.begin(); it != stats.end(); ++it) {
+        if (it->second->is_map()) {
+            add_stats_to_load(*it->second, load);
+            continue;
+        }
+        const double value = strtod(it->second->get_string()->c_str(), NULL);
+        if (it->first == "serializer_bytes_in_use") {
+            load->disk_bytes += value;
+        } else if (it->first == "blocks_evicted") {
+            load->cache_evictions += value;
+        } else if (it->first == "keys_read") {
+            load->reads_per_sec += value;
+        } else if (it->first == "keys_set") {
+            load->writes_per_sec += value;
+        }
+    }
+}
+
+}  // namespace
+
+machine_load_t machine_load_from_stats(const perfmon_result_t &stats) {
+    machine_load_t load;
+    if (stats.is_map()) {
+        add_stats_to_load(stats, &load);
+    }
+    return load;
+}
+
+std::map<machine_id_t, double> compute_machine_load_scores(
+        const std::map<machine_id_t, machine_load_t> &loads) {
+    machine_load_t total;
+    for (std::map<machine_id_t, machine_load_t>::const_iterator it = loads.begin();
+         it != loads.end(); ++it) {
+        total.disk_bytes += it->second.disk_bytes;
+        total.cache_evictions += it->second.cache_evictions;
+        total.reads_per_sec += it->second.reads_per_sec;
+        total.writes_per_sec += it->second.writes_per_sec;
+    }
+
+    std::map<machine_id_t, double> scores;
+    const double n = loads.size();
+    for (std::map<machine_id_t, machine_load_t>::const_iterator it = loads.begin();
+         it != loads.end(); ++it) {
+        /* Kinds of load that every machine is free of say nothing about which
+        machine is busier, so they count as average for everyone. */
+        double score = 0;
+        score += total.disk_bytes > 0 ? it->second.disk_bytes * n / total.disk_bytes : 1;
+        score += total.cache_evictions > 0 ? it->second.cache_evictions * n / total.cache_evictions : 1;
+        score += total.reads_per_sec > 0 ? it->second.reads_per_sec * n / total.reads_per_sec : 1;
+        score += total.writes_per_sec > 0 ? it->second.writes_per_sec * n / total.writes_per_sec : 1;
+        scores[it->first] = score / 4;
+    }
+    return scores;
+}
@@ -0,0 +1,36 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#ifndef CLUSTERING_ADMINISTRATION_MACHINE_LOAD_HPP_
+#define CLUSTERING_ADMINISTRATION_MACHINE_LOAD_HPP_
+
+#include <map>
+
+#include "containers/uuid.hpp"
+
+class perfmon_result_t;
+
+/* The parts of a machine's stats (as returned by its `stat_manager_t`) that
+tell how much data and traffic it carries.  Each field is summed over all of the
+machine's tables. */
+struct machine_load_t {
+    machine_load_t()
+        : disk_bytes(0), cache_evictions(0), reads_per_sec(0), writes_per_sec(0) { }
+
+    // "serializer_bytes_in_use"
+    double disk_bytes;
+    // "blocks_evicted", how much its caches have been short of memory
+    double cache_evictions;
+    // "keys_read" and "keys_set"
+    double reads_per_sec;
+    double writes_per_sec;
+};
+
+machine_load_t machine_load_from_stats(const perfmon_result_t &stats);
+
+/* Turns the loads of the machines of a cluster into one number per machine, for
+`suggest_blueprint()`.  Each kind of load is divided by its average over the
+cluster and the ratios are averaged, so a machine with the average load of
+everything scores 1 and an idle one scores 0. */
+std::map<machine_id_t, double> compute_machine_load_scores(
+        const std::map<machine_id_t, machine_load_t> &loads);
+
+#endif  // CLUSTERING_ADMINISTRATION_MACHINE_LOAD_HPP_
@@ -22,7 +22,9 @@
 
 #include "arch/io/disk.hpp"
 #include "arch/os_signal.hpp"
+#include "arch/runtime/scheduler_stats.hpp"
 #include "arch/runtime/starter.hpp"
+#include "concurrency/lock_contention.hpp"
 #include "extproc/extproc_spawner.hpp"
 #include "clustering/administration/cli/admin_command_parser.hpp"
 #include "clustering/administration/main/names.hpp"
@@ -35,6 +37,8 @@
 #include "clustering/administration/persist.hpp"
 #include "logger.hpp"
 #include "mock/dummy_protocol.hpp"
+#include "serializer/block_buffer_pool.hpp"
+#include "rdb_protocol/query_resources.hpp"
 #include "utils.hpp"
 
 #define RETHINKDB_EXPORT_SCRIPT "rethinkdb-export"
@@ -308,16 +312,37 @@ public:
     serve_info_t(const std::vector<host_and_port_t> &_joins,
                  service_address_ports_t _ports,
                  std::string _web_assets,
-                 boost::optional<std::string> _config_file):
+                 boost::optional<std::string> _config_file,
+                 bool _scrub_on_startup,
+                 const std::vector<base_path_t> &_stripe_paths,
+                 size_t _query_cache_size,
+                 const boost::optional<std::string> &_capture_queries_file,
+                 const ql::query_limits_t &_query_limits,
+                 bool _driver_reuseport,
+                 bool _auto_shard):
         joins(&_joins),
         ports(_ports),
         web_assets(_web_assets),
-        config_file(_config_file) { }
+        config_file(_config_file),
+        scrub_on_startup(_scrub_on_startup),
+        stripe_paths(_stripe_paths),
+        query_cache_size(_query_cache_size),
+        capture_queries_file(_capture_queries_file),
+        query_limits(_query_limits),
+        driver_reuseport(_driver_reuseport),
+        auto_shard(_auto_shard) { }
 
     const std::vector<host_and_port_t> *joins;
     service_address_ports_t ports;
     std::string web_assets;
     boost::optional<std::string> config_file;
+    bool scrub_on_startup;
+    std::vector<base_path_t> stripe_paths;
+    size_t query_cache_size;
+    boost::optional<std::string> capture_queries_file;
+    ql::query_limits_t query_limits;
+    bool driver_reuseport;
+    bool auto_shard;
 };
 
 // Used for options that don't take parameters, such as --help or --exit-failure, tells whether the
@@ -579,9 +604,27 @@ peer_address_t get_canonical_addresses(const std::map<std::string, options::valu
     return peer_address_t(result);
 }
 
+cluster_compression_t get_cluster_compression(const std::map<std::string, options::values_t> &opts) {
+    const std::string value = get_single_option(opts, "--cluster-compression");
+    if (value == "none") {
+        return cluster_compression_t::none;
+    } else if (value == "bulk") {
+        return cluster_compression_t::bulk;
+    } else if (value == "all") {
+        return cluster_compression_t::all;
+    }
+    throw std::runtime_error(strprintf("ERROR: cluster-compression must be 'none', 'bulk' or 'all', not '%s'",
+                                       value.c_str()));
+}
+
 service_address_ports_t get_service_address_ports(const std::map<std::string, options::values_t> &opts) {
     const int port_offset = get_single_int(opts, "--port-offset");
     const int cluster_port = offseted_port(get_single_int(opts, "--cluster-port"), port_offset);
+    const int cluster_connections = get_single_int(opts, "--cluster-connections");
+    if (cluster_connections < 1 || cluster_connections > MAX_CLUSTER_CONNECTIONS_PER_PEER) {
+        throw std::runtime_error(strprintf("ERROR: cluster-connections must be between 1 and %d",
+                                           MAX_CLUSTER_CONNECTIONS_PER_PEER));
+    }
     return service_address_ports_t(get_local_addresses(all_options(opts, "--bind")),
                                    get_canonical_addresses(opts, cluster_port),
                                    cluster_port,
@@ -590,6 +633,8 @@ service_address_ports_t get_service_address_ports(const std::map<std::string, op
 #else
                                    port_defaults::client_port,
 #endif
+                                   cluster_connections,
+                                   get_cluster_compression(opts),
                                    exists_option(opts, "--no-http-admin"),
                                    offseted_port(get_single_int(opts, "--http-port"), port_offset),
                                    offseted_port(get_single_int(opts, "--driver-port"), port_offset),
@@ -601,6 +646,7 @@ void run_rethinkdb_create(const base_path_t &base_path,
                           const name_string_t &machine_name,
                           const file_direct_io_mode_t direct_io_mode,
                           const int max_concurrent_io_requests,
+                          const io_backend_t io_backend,
                           bool *const result_out) {
     machine_id_t our_machine_id = generate_uuid();
 
@@ -612,7 +658,7 @@ void run_rethinkdb_create(const base_path_t &base_path,
     machine_semilattice_metadata.datacenter = vclock_t<datacenter_id_t>(nil_uuid(), our_machine_id);
     cluster_metadata.machines.machines.insert(std::make_pair(our_machine_id, make_deletable(machine_semilattice_metadata)));
 
-    io_backender_t io_backender(direct_io_mode, max_concurrent_io_requests);
+    io_backender_t io_backender(direct_io_mode, max_concurrent_io_requests, io_backend);
 
     perfmon_collection_t metadata_perfmon_collection;
     perfmon_membership_t metadata_perfmon_membership(&get_global_perfmon_collection(), &metadata_perfmon_collection, "metadata");
@@ -704,6 +750,8 @@ void run_rethinkdb_serve(const base_path_t &base_path,
                          const serve_info_t &serve_info,
                          const file_direct_io_mode_t direct_io_mode,
                          const int max_concurrent_io_requests,
+                         const io_backend_t io_backend,
+                         const int64_t io_target_latency_nanos,
                          const machine_id_t *our_machine_id,
                          const cluster_semilattice_metadata_t *cluster_metadata,
                          directory_lock_t *data_directory_lock,
@@ -714,7 +762,8 @@ void run_rethinkdb_serve(const base_path_t &base_path,
 
     logINF("Loading data from directory %s\n", base_path.path().c_str());
 
-    io_backender_t io_backender(direct_io_mode, max_concurrent_io_requests);
+    io_backender_t io_backender(direct_io_mode, max_concurrent_io_requests, io_backend,
+                                io_target_latency_nanos);
 
     perfmon_collection_t metadata_perfmon_collection;
     perfmon_membership_t metadata_perfmon_membership(&get_global_perfmon_collection(), &metadata_perfmon_collection, "metadata");
@@ -754,13 +803,20 @@ void run_rethinkdb_serve(const base_path_t &base_path,
 
         *result_out = serve(&io_backender,
                             base_path,
+                            serve_info.stripe_paths,
                             cluster_metadata_file.get(),
                             auth_metadata_file.get(),
                             look_up_peers_addresses(*serve_info.joins),
                             serve_info.ports,
                             serve_info.web_assets,
                             &sigint_cond,
-                            serve_info.config_file);
+                            serve_info.config_file,
+                            serve_info.scrub_on_startup,
+                            serve_info.query_cache_size,
+                            serve_info.capture_queries_file,
+                            serve_info.query_limits,
+                            serve_info.driver_reuseport,
+                            serve_info.auto_shard);
 
     } catch (const metadata_persistence::file_in_use_exc_t &ex) {
         logINF("Directory '%s' is in use by another rethinkdb process.\n", base_path.path().c_str());
@@ -775,13 +831,16 @@ void run_rethinkdb_porcelain(const base_path_t &base_path,
                              const name_string_t &machine_name,
                              const file_direct_io_mode_t direct_io_mode,
                              const int max_concurrent_io_requests,
+                             const io_backend_t io_backend,
+                             const int64_t io_target_latency_nanos,
                              const bool new_directory,
                              const serve_info_t &serve_info,
                              directory_lock_t *data_directory_lock,
                              bool *const result_out) {
     if (!new_directory) {
         run_rethinkdb_serve(base_path, serve_info,
-                            direct_io_mode, max_concurrent_io_requests,
+                            direct_io_mode, max_concurrent_io_requests, io_backend,
+                            io_target_latency_nanos,
                             NULL, NULL, data_directory_lock,
                             result_out);
     } else {
@@ -814,7 +873,8 @@ void run_rethinkdb_porcelain(const base_path_t &base_path,
         }
 
         run_rethinkdb_serve(base_path, serve_info,
-                            direct_io_mode, max_concurrent_io_requests,
+                            direct_io_mode, max_concurrent_io_requests, io_backend,
+                            io_target_latency_nanos,
                             &our_machine_id, &cluster_metadata,
                             data_directory_lock, result_out);
     }
@@ -829,7 +889,11 @@ void run_rethinkdb_proxy(const serve_info_t &serve_info, bool *const result_out)
                                   serve_info.ports,
                                   serve_info.web_assets,
                                   &sigint_cond,
-                                  serve_info.config_file);
+                                  serve_info.config_file,
+                                  serve_info.query_cache_size,
+                                  serve_info.capture_queries_file,
+                                  serve_info.query_limits,
+                                  serve_info.driver_reuseport);
     } catch (const host_lookup_exc_t &ex) {
         logERR("%s\n", ex.what());
         *result_out = false;
@@ -862,6 +926,11 @@ options::help_section_t get_file_options(std::vector<options::option_t> *options
                                              options::OPTIONAL,
                                              "rethinkdb_data"));
     help.add("-d [ --directory ] path", "specify directory to store data and metadata");
+    options_out->push_back(options::option_t(options::names_t("--stripe-directory"),
+                                             options::OPTIONAL_REPEAT));
+    help.add("--stripe-directory path",
+             "stripe new tables over this directory as well as the data directory; can be "
+             "given several times, ideally once per device");
     options_out->push_back(options::option_t(options::names_t("--io-threads"),
                                              options::OPTIONAL,
                                              strprintf("%d", DEFAULT_MAX_CONCURRENT_IO_REQUESTS)));
@@ -870,6 +939,31 @@ options::help_section_t get_file_options(std::vector<options::option_t> *options
     options_out->push_back(options::option_t(options::names_t("--no-direct-io"),
                                              options::OPTIONAL_NO_PARAMETER));
     help.add("--no-direct-io", "disable direct I/O");
+    options_out->push_back(options::option_t(options::names_t("--block-huge-pages"),
+                                             options::OPTIONAL,
+                                             "off"));
+    help.add("--block-huge-pages {off,transparent,reserved}",
+             "back the block buffers of the caches with normal pages, transparent huge "
+             "pages, or 2MB huge pages reserved with vm.nr_hugepages, falling back to "
+             "transparent ones once those run out");
+    options_out->push_back(options::option_t(options::names_t("--io-backend"),
+                                             options::OPTIONAL,
+                                             "pool"));
+    help.add("--io-backend {pool,io_uring}",
+             "how to run I/O operations: on a thread pool, or through io_uring if the "
+             "kernel supports it");
+    options_out->push_back(options::option_t(options::names_t("--io-target-latency"),
+                                             options::OPTIONAL,
+                                             "0"));
+    help.add("--io-target-latency usecs",
+             "hold back background I/O (garbage collection, backfills, secondary index "
+             "construction) while reads take longer than this (default: 0, never)");
+    options_out->push_back(options::option_t(options::names_t("--scrub-on-startup"),
+                                             options::OPTIONAL_NO_PARAMETER));
+    help.add("--scrub-on-startup", "verify the checksums of all data blocks in the background after starting up");
+    options_out->push_back(options::option_t(options::names_t("--auto-shard"),
+                                             options::OPTIONAL_NO_PARAMETER));
+    help.add("--auto-shard", "split tables' shards that get too busy or too large, and merge neighbouring shards that stay small and idle");
     return help;
 }
 
@@ -918,6 +1012,16 @@ options::help_section_t get_network_options(const bool join_required, std::vecto
                                              strprintf("%d", port_defaults::peer_port)));
     help.add("--cluster-port port", "port for receiving connections from other nodes");
 
+    options_out->push_back(options::option_t(options::names_t("--cluster-connections"),
+                                             options::OPTIONAL,
+                                             strprintf("%d", DEFAULT_CLUSTER_CONNECTIONS_PER_PEER)));
+    help.add("--cluster-connections n", "the number of TCP connections to open to each other node; all but one carry large messages such as backfills");
+
+    options_out->push_back(options::option_t(options::names_t("--cluster-compression"),
+                                             options::OPTIONAL,
+                                             "none"));
+    help.add("--cluster-compression {none | bulk | all}", "compress no messages, large messages such as backfills, or all messages to other nodes (for example ones in another datacenter); used for a pair of nodes if either asks for it");
+
 #ifndef NDEBUG
     options_out->push_back(options::option_t(options::names_t("--client-port"),
                                              options::OPTIONAL,
@@ -930,6 +1034,34 @@ options::help_section_t get_network_options(const bool join_required, std::vecto
                                              strprintf("%d", port_defaults::reql_port)));
     help.add("--driver-port port", "port for rethinkdb protocol client drivers");
 
+    options_out->push_back(options::option_t(options::names_t("--driver-reuseport"),
+                                             options::OPTIONAL_NO_PARAMETER));
+    help.add("--driver-reuseport", "listen for client drivers on every core with SO_REUSEPORT, and keep each connection on the core that accepted it");
+
+    options_out->push_back(options::option_t(options::names_t("--query-cache-size"),
+                                             options::OPTIONAL,
+                                             "0"));
+    help.add("--query-cache-size n", "the number of compiled client driver queries to keep on each core for reuse by queries of the same shape (0 to disable)");
+
+    options_out->push_back(options::option_t(options::names_t("--capture-queries"),
+                                             options::OPTIONAL));
+    help.add("--capture-queries file", "write every client driver query to file, for replaying them with scripts/replay_queries.py");
+
+    options_out->push_back(options::option_t(options::names_t("--query-max-rows-scanned"),
+                                             options::OPTIONAL,
+                                             "0"));
+    help.add("--query-max-rows-scanned n", "the number of rows a query may read from tables before it fails (0 for no limit)");
+
+    options_out->push_back(options::option_t(options::names_t("--query-max-datum-bytes"),
+                                             options::OPTIONAL,
+                                             "0"));
+    help.add("--query-max-datum-bytes n", "the bytes of data a query may read and build before it fails (0 for no limit)");
+
+    options_out->push_back(options::option_t(options::names_t("--query-max-cpu-ms"),
+                                             options::OPTIONAL,
+                                             "0"));
+    help.add("--query-max-cpu-ms n", "the milliseconds of CPU time a query may use on the node that parses it before it fails (0 for no limit)");
+
     options_out->push_back(options::option_t(options::names_t("--port-offset", "-o"),
                                              options::OPTIONAL,
                                              strprintf("%d", port_defaults::port_offset)));
@@ -952,6 +1084,19 @@ options::help_section_t get_cpu_options(std::vector<options::option_t> *options_
                                              options::OPTIONAL,
                                              strprintf("%d", get_cpu_count())));
     help.add("-c [ --cores ] n", "the number of cores to use");
+    options_out->push_back(options::option_t(options::names_t("--pin-threads"),
+                                             options::OPTIONAL_NO_PARAMETER));
+    help.add("--pin-threads", "pin each thread to a core, and keep the threads and memory of each table on one NUMA node");
+    options_out->push_back(options::option_t(options::names_t("--event-loop-spin"),
+                                             options::OPTIONAL,
+                                             "0"));
+    help.add("--event-loop-spin usecs", "how long an idle thread spins, looking for work, before it sleeps; lowers latency at the cost of CPU time (default: 0, never spin)");
+    options_out->push_back(options::option_t(options::names_t("--profile-lock-contention"),
+                                             options::OPTIONAL_NO_PARAMETER));
+    help.add("--profile-lock-contention", "time how long the locks of the buffer cache, the serializer and the query queues wait, shown by the lock_contention stat");
+    options_out->push_back(options::option_t(options::names_t("--profile-scheduler"),
+                                             options::OPTIONAL_NO_PARAMETER));
+    help.add("--profile-scheduler", "time how long messages between threads wait and run and how long the event loops take, shown by the scheduler stat");
     return help;
 }
 
@@ -966,6 +1111,18 @@ MUST_USE bool parse_cores_option(const std::map<std::string, options::values_t>
     return true;
 }
 
+MUST_USE bool parse_event_loop_spin_option(const std::map<std::string, options::values_t> &opts,
+                                           int64_t *spin_nanos_out) {
+    const int spin_usecs = get_single_int(opts, "--event-loop-spin");
+    if (spin_usecs < 0 || spin_usecs > MAX_EVENT_LOOP_SPIN_USECS) {
+        fprintf(stderr, "ERROR: event-loop-spin must be between 0 and %d microseconds\n",
+                MAX_EVENT_LOOP_SPIN_USECS);
+        return false;
+    }
+    *spin_nanos_out = static_cast<int64_t>(spin_usecs) * THOUSAND;
+    return true;
+}
+
 options::help_section_t get_service_options(std::vector<options::option_t> *options_out) {
     options::help_section_t help("Service options");
     options_out->push_back(options::option_t(options::names_t("--pid-file"),
@@ -1141,12 +1298,116 @@ MUST_USE bool parse_io_threads_option(const std::map<std::string, options::value
     return true;
 }
 
+MUST_USE bool parse_query_cache_size_option(const std::map<std::string, options::values_t> &opts,
+                                           size_t *query_cache_size_out) {
+    int query_cache_size = get_single_int(opts, "--query-cache-size");
+    if (query_cache_size < 0) {
+        fprintf(stderr, "ERROR: query-cache-size must not be negative\n");
+        return false;
+    }
+    *query_cache_size_out = query_cache_size;
+    return true;
+}
+
+MUST_USE bool parse_query_limit_option(const std::map<std::string, options::values_t> &opts,
+                                       const std::string &name,
+                                       uint64_t *limit_out) {
+    const std::string value = get_single_option(opts, name);
+    if (!strtou64_strict(value, 10, limit_out)) {
+        fprintf(stderr, "ERROR: %s must be a non-negative integer\n", name.c_str() + 2);
+        return false;
+    }
+    return true;
+}
+
+MUST_USE bool parse_query_limits_options(const std::map<std::string, options::values_t> &opts,
+                                         ql::query_limits_t *query_limits_out) {
+    return parse_query_limit_option(opts, "--query-max-rows-scanned",
+                                    &query_limits_out->max_rows_scanned)
+        && parse_query_limit_option(opts, "--query-max-datum-bytes",
+                                    &query_limits_out->max_datum_bytes)
+        && parse_query_limit_option(opts, "--query-max-cpu-ms",
+                                    &query_limits_out->max_cpu_ms);
+}
+
 file_direct_io_mode_t parse_direct_io_mode_option(const std::map<std::string, options::values_t> &opts) {
     return exists_option(opts, "--no-direct-io") ?
         file_direct_io_mode_t::buffered_desired :
         file_direct_io_mode_t::direct_desired;
 }
 
+MUST_USE bool parse_io_backend_option(const std::map<std::string, options::values_t> &opts,
+                                      io_backend_t *io_backend_out) {
+    const std::string io_backend = get_single_option(opts, "--io-backend");
+    if (io_backend == "pool") {
+        *io_backend_out = io_backend_t::pool;
+    } else if (io_backend == "io_uring") {
+        *io_backend_out = io_backend_t::io_uring_desired;
+    } else {
+        fprintf(stderr, "ERROR: io-backend must be 'pool' or 'io_uring'\n");
+        return false;
+    }
+    return true;
+}
+
+MUST_USE bool parse_block_huge_pages_option(
+        const std::map<std::string, options::values_t> &opts,
+        block_huge_pages_t *huge_pages_out) {
+    const std::string huge_pages = get_single_option(opts, "--block-huge-pages");
+    if (huge_pages == "off") {
+        *huge_pages_out = block_huge_pages_t::off;
+    } else if (huge_pages == "transparent") {
+        *huge_pages_out = block_huge_pages_t::transparent;
+    } else if (huge_pages == "reserved") {
+        *huge_pages_out = block_huge_pages_t::reserved;
+    } else {
+        fprintf(stderr, "ERROR: block-huge-pages must be 'off', 'transparent' or 'reserved'\n");
+        return false;
+    }
+    return true;
+}
+
+MUST_USE bool parse_io_target_latency_option(const std::map<std::string, options::values_t> &opts,
+                                             int64_t *target_latency_nanos_out) {
+    const int target_usecs = get_single_int(opts, "--io-target-latency");
+    if (target_usecs < 0 || target_usecs > MAX_IO_TARGET_LATENCY_USECS) {
+        fprintf(stderr, "ERROR: io-target-latency must be between 0 and %d microseconds\n",
+                MAX_IO_TARGET_LATENCY_USECS);
+        return false;
+    }
+    *target_latency_nanos_out = static_cast<int64_t>(target_usecs) * THOUSAND;
+    return true;
+}
+
+// Every stripe directory must already exist (it's usually the mount point of a
+// device), and gets a temporary directory like the data directory does.
+MUST_USE bool parse_stripe_directory_options(const std::map<std::string, options::values_t> &opts,
+                                             const base_path_t &base_path,
+                                             std::vector<base_path_t> *stripe_paths_out) {
+    const std::vector<std::string> &paths = all_options(opts, "--stripe-directory");
+    for (auto it = paths.begin(); it != paths.end(); ++it) {
+        if (access(it->c_str(), R_OK | W_OK | X_OK) != 0) {
+            fprintf(stderr, "ERROR: The stripe directory '%s' is not an accessible directory.\n",
+                    it->c_str());
+            return false;
+        }
+        base_path_t stripe_path(*it);
+        stripe_path.make_absolute();
+        bool duplicate = stripe_path.path() == base_path.path();
+        for (auto jt = stripe_paths_out->begin(); jt != stripe_paths_out->end(); ++jt) {
+            duplicate = duplicate || jt->path() == stripe_path.path();
+        }
+        if (duplicate) {
+            fprintf(stderr, "ERROR: The directory '%s' is used more than once.\n",
+                    stripe_path.path().c_str());
+            return false;
+        }
+        recreate_temporary_directory(stripe_path);
+        stripe_paths_out->push_back(stripe_path);
+    }
+    return true;
+}
+
 int main_rethinkdb_create(int argc, char *argv[]) {
     std::vector<options::option_t> options;
     std::vector<options::help_section_t> help;
@@ -1177,6 +1438,11 @@ int main_rethinkdb_create(int argc, char *argv[]) {
             return EXIT_FAILURE;
         }
 
+        io_backend_t io_backend;
+        if (!parse_io_backend_option(opts, &io_backend)) {
+            return EXIT_FAILURE;
+        }
+
         const int num_workers = get_cpu_count();
 
         bool is_new_directory = false;
@@ -1198,6 +1464,7 @@ int main_rethinkdb_create(int argc, char *argv[]) {
                                      machine_name,
                                      direct_io_mode,
                                      max_concurrent_io_requests,
+                                     io_backend,
                                      &result),
                            num_workers);
 
@@ -1283,11 +1550,30 @@ int main_rethinkdb_serve(int argc, char *argv[]) {
             return EXIT_FAILURE;
         }
 
+        int64_t event_loop_spin_nanos;
+        if (!parse_event_loop_spin_option(opts, &event_loop_spin_nanos)) {
+            return EXIT_FAILURE;
+        }
+
         int max_concurrent_io_requests;
         if (!parse_io_threads_option(opts, &max_concurrent_io_requests)) {
             return EXIT_FAILURE;
         }
 
+        io_backend_t io_backend;
+        if (!parse_io_backend_option(opts, &io_backend)) {
+            return EXIT_FAILURE;
+        }
+
+        int64_t io_target_latency_nanos;
+        if (!parse_io_target_latency_option(opts, &io_target_latency_nanos)) {
+            return EXIT_FAILURE;
+        }
+
+        if (!parse_block_huge_pages_option(opts, &global_block_huge_pages)) {
+            return EXIT_FAILURE;
+        }
+
         // Open and lock the directory, but do not create it
         bool is_new_directory = false;
         directory_lock_t data_directory_lock(base_path, false, &is_new_directory);
@@ -1298,6 +1584,11 @@ int main_rethinkdb_serve(int argc, char *argv[]) {
         base_path.make_absolute();
         initialize_logfile(opts, base_path);
 
+        std::vector<base_path_t> stripe_paths;
+        if (!parse_stripe_directory_options(opts, base_path, &stripe_paths)) {
+            return EXIT_FAILURE;
+        }
+
         if (check_pid_file(opts) != EXIT_SUCCESS) {
             return EXIT_FAILURE;
         }
@@ -1311,23 +1602,47 @@ int main_rethinkdb_serve(int argc, char *argv[]) {
             return EXIT_FAILURE;
         }
 
+        size_t query_cache_size;
+        if (!parse_query_cache_size_option(opts, &query_cache_size)) {
+            return EXIT_FAILURE;
+        }
+
+        ql::query_limits_t query_limits;
+        if (!parse_query_limits_options(opts, &query_limits)) {
+            return EXIT_FAILURE;
+        }
+
         extproc_spawner_t extproc_spawner;
 
         serve_info_t serve_info(joins, address_ports, web_path,
-                                get_optional_option(opts, "--config-file"));
+                                get_optional_option(opts, "--config-file"),
+                                exists_option(opts, "--scrub-on-startup"),
+                                stripe_paths,
+                                query_cache_size,
+                                get_optional_option(opts, "--capture-queries"),
+                                query_limits,
+                                exists_option(opts, "--driver-reuseport"),
+                                exists_option(opts, "--auto-shard"));
 
         const file_direct_io_mode_t direct_io_mode = parse_direct_io_mode_option(opts);
 
+        global_lock_contention_profiling = exists_option(opts, "--profile-lock-contention");
+        global_scheduler_profiling = exists_option(opts, "--profile-scheduler");
+
         bool result;
         run_in_thread_pool(std::bind(&run_rethinkdb_serve, base_path,
                                      serve_info,
                                      direct_io_mode,
                                      max_concurrent_io_requests,
+                                     io_backend,
+                                     io_target_latency_nanos,
                                      static_cast<machine_id_t*>(NULL),
                                      static_cast<cluster_semilattice_metadata_t*>(NULL),
                                      &data_directory_lock,
                                      &result),
-                           num_workers);
+                           num_workers,
+                           exists_option(opts, "--pin-threads"),
+                           event_loop_spin_nanos);
         return result ? EXIT_SUCCESS : EXIT_FAILURE;
     } catch (const options::named_error_t &ex) {
         output_named_error(ex, help);
@@ -1431,10 +1746,27 @@ int main_rethinkdb_proxy(int argc, char *argv[]) {
             return EXIT_FAILURE;
         }
 
+        size_t query_cache_size;
+        if (!parse_query_cache_size_option(opts, &query_cache_size)) {
+            return EXIT_FAILURE;
+        }
+
+        ql::query_limits_t query_limits;
+        if (!parse_query_limits_options(opts, &query_limits)) {
+            return EXIT_FAILURE;
+        }
+
         extproc_spawner_t extproc_spawner;
 
         serve_info_t serve_info(joins, address_ports, web_path,
-                                get_optional_option(opts, "--config-file"));
+                                get_optional_option(opts, "--config-file"),
+                                false,
+                                std::vector<base_path_t>(),
+                                query_cache_size,
+                                get_optional_option(opts, "--capture-queries"),
+                                query_limits,
+                                exists_option(opts, "--driver-reuseport"),
+                                false);
 
         bool result;
         run_in_thread_pool(std::bind(&run_rethinkdb_proxy, serve_info, &result),
@@ -1540,11 +1872,30 @@ int main_rethinkdb_porcelain(int argc, char *argv[]) {
             return EXIT_FAILURE;
         }
 
+        int64_t event_loop_spin_nanos;
+        if (!parse_event_loop_spin_option(opts, &event_loop_spin_nanos)) {
+            return EXIT_FAILURE;
+        }
+
         int max_concurrent_io_requests;
         if (!parse_io_threads_option(opts, &max_concurrent_io_requests)) {
             return EXIT_FAILURE;
         }
 
+        io_backend_t io_backend;
+        if (!parse_io_backend_option(opts, &io_backend)) {
+            return EXIT_FAILURE;
+        }
+
+        int64_t io_target_latency_nanos;
+        if (!parse_io_target_latency_option(opts, &io_target_latency_nanos)) {
+            return EXIT_FAILURE;
+        }
+
+        if (!parse_block_huge_pages_option(opts, &global_block_huge_pages)) {
+            return EXIT_FAILURE;
+        }
+
         // Attempt to create the directory early so that the log file can use it.
         // If we create the file, it will be cleaned up unless directory_initialized()
         // is called on it.  This will be done after the metadata files have been created.
@@ -1556,6 +1907,11 @@ int main_rethinkdb_porcelain(int argc, char *argv[]) {
         base_path.make_absolute();
         initialize_logfile(opts, base_path);
 
+        std::vector<base_path_t> stripe_paths;
+        if (!parse_stripe_directory_options(opts, base_path, &stripe_paths)) {
+            return EXIT_FAILURE;
+        }
+
         if (check_pid_file(opts) != EXIT_SUCCESS) {
             return EXIT_FAILURE;
         }
@@ -1572,24 +1928,48 @@ int main_rethinkdb_porcelain(int argc, char *argv[]) {
             return EXIT_FAILURE;
         }
 
+        size_t query_cache_size;
+        if (!parse_query_cache_size_option(opts, &query_cache_size)) {
+            return EXIT_FAILURE;
+        }
+
+        ql::query_limits_t query_limits;
+        if (!parse_query_limits_options(opts, &query_limits)) {
+            return EXIT_FAILURE;
+        }
+
         extproc_spawner_t extproc_spawner;
 
         serve_info_t serve_info(joins, address_ports, web_path,
-                                get_optional_option(opts, "--config-file"));
+                                get_optional_option(opts, "--config-file"),
+                                exists_option(opts, "--scrub-on-startup"),
+                                stripe_paths,
+                                query_cache_size,
+                                get_optional_option(opts, "--capture-queries"),
+                                query_limits,
+                                exists_option(opts, "--driver-reuseport"),
+                                exists_option(opts, "--auto-shard"));
 
         const file_direct_io_mode_t direct_io_mode = parse_direct_io_mode_option(opts);
 
+        global_lock_contention_profiling = exists_option(opts, "--profile-lock-contention");
+        global_scheduler_profiling = exists_option(opts, "--profile-scheduler");
+
         bool result;
         run_in_thread_pool(std::bind(&run_rethinkdb_porcelain,
                                      base_path,
                                      machine_name,
                                      direct_io_mode,
                                      max_concurrent_io_requests,
+                                     io_backend,
+                                     io_target_latency_nanos,
                                      is_new_directory,
                                      serve_info,
                                      &data_directory_lock,
                                      &result),
-                           num_workers);
+                           num_workers,
+                           exists_option(opts, "--pin-threads"),
+                           event_loop_spin_nanos);
 
         return result ? EXIT_SUCCESS : EXIT_FAILURE;
     } catch (const options::named_error_t &ex) {
@@ -1625,6 +2005,7 @@ void help_rethinkdb_porcelain() {
     printf("    'rethinkdb import': import data from from a file or directory into an existing cluster\n");
     printf("    'rethinkdb dump': export and compress data from an existing cluster\n");
     printf("    'rethinkdb restore': import compressed data into an existing cluster\n");
+    printf("    'rethinkdb migrate': copy data from an older version into this one\n");
     printf("\n");
     printf("For more information, run 'rethinkdb help [subcommand]'.\n");
 }
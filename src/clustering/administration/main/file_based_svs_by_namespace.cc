@@ -1,6 +1,7 @@
 // Copyright 2010-2012 RethinkDB, all rights reserved.
 #include "clustering/administration/main/file_based_svs_by_namespace.hpp"
 
+#include "arch/runtime/runtime.hpp"
 #include "clustering/immediate_consistency/branch/multistore.hpp"
 #include "clustering/reactor/reactor.hpp"
 #include "serializer/config.hpp"
@@ -31,10 +32,100 @@ struct store_args_t {
     typename protocol_t::context_t *ctx;
 };
 
+/* The arguments that do_construct_serializer needs for every stripe of a table. */
+struct serializer_args_t {
+    serializer_args_t(io_backender_t *_io_backender,
+                      const std::vector<serializer_filepath_t> &_filepaths,
+                      const standard_serializer_t::dynamic_config_t &_config,
+                      const standard_serializer_t::static_config_t &_static_config,
+                      bool _create,
+                      perfmon_collection_t *_serializers_perfmon_collection)
+        : io_backender(_io_backender), filepaths(_filepaths), config(_config),
+          static_config(_static_config), create(_create),
+          serializers_perfmon_collection(_serializers_perfmon_collection)
+    { }
+
+    io_backender_t *io_backender;
+    std::vector<serializer_filepath_t> filepaths;
+    standard_serializer_t::dynamic_config_t config;
+    // What new files are created with.
+    standard_serializer_t::static_config_t static_config;
+    bool create;
+    perfmon_collection_t *serializers_perfmon_collection;
+};
+
+std::string stripe_perfmon_name(int stripe_number) {
+    return strprintf("stripe_%d", stripe_number);
+}
+
+// Opens the serializer of one of a table's stripes on that stripe's thread,
+// creating its file first if `args.create` is set.
+void do_construct_serializer(
+    const std::vector<threadnum_t> &threads,
+    int stripe,
+    serializer_args_t args,
+    scoped_array_t<scoped_ptr_t<filepath_file_opener_t> > *file_openers,
+    scoped_array_t<scoped_ptr_t<perfmon_membership_t> > *perfmon_memberships,
+    scoped_array_t<scoped_ptr_t<serializer_t> > *serializers_out) {
+
+    on_thread_t th(threads[stripe]);
+
+    // The first stripe reports its stats straight into the table's collection,
+    // like a table's only serializer always has.
+    perfmon_collection_t *perfmon_collection = args.serializers_perfmon_collection;
+    if (stripe != 0) {
+        perfmon_collection = new perfmon_collection_t;
+        (*perfmon_memberships)[stripe].init(
+            new perfmon_membership_t(args.serializers_perfmon_collection,
+                                     perfmon_collection,
+                                     stripe_perfmon_name(stripe),
+                                     true));
+    }
+
+    filepath_file_opener_t *file_opener
+        = new filepath_file_opener_t(args.filepaths[stripe], args.io_backender);
+    (*file_openers)[stripe].init(file_opener);
+    if (args.create) {
+        standard_serializer_t::create(file_opener, args.static_config);
+    }
+
+    // TODO: Could we handle failure when loading the serializer?  Right
+    // now, we don't.
+    (*serializers_out)[stripe].init(new merger_serializer_t(
+        scoped_ptr_t<serializer_t>(
+            new standard_serializer_t(args.config, file_opener, perfmon_collection)),
+        MERGER_SERIALIZER_MAX_ACTIVE_WRITES,
+        perfmon_collection));
+}
+
+// Destroys the file opener of one of a table's stripes on that stripe's thread,
+// moving a newly created file to its permanent location first.
+void do_release_file_opener(
+    const std::vector<threadnum_t> &threads,
+    int stripe,
+    bool move_to_permanent_location,
+    scoped_array_t<scoped_ptr_t<filepath_file_opener_t> > *file_openers) {
+
+    on_thread_t th(threads[stripe]);
+    if (move_to_permanent_location) {
+        (*file_openers)[stripe]->move_serializer_file_to_permanent_location();
+    }
+    (*file_openers)[stripe].reset();
+}
+
 std::string hash_shard_perfmon_name(int hash_shard_number) {
     return strprintf("shard_%d", hash_shard_number);
 }
 
+// Where the cache of a hash shard writes its warm-up manifest on shutdown (see
+// mc_cache_t::enable_warmup_manifest()), next to the serializer file.
+std::string cache_warmup_manifest_path(const base_path_t &base_path,
+                                       namespace_id_t namespace_id,
+                                       int hash_shard_number) {
+    return base_path.path() + "/" + uuid_to_str(namespace_id) + "."
+        + hash_shard_perfmon_name(hash_shard_number) + ".warmup";
+}
+
 template <class protocol_t>
 void do_construct_existing_store(
     const std::vector<threadnum_t> &threads,
@@ -52,6 +143,9 @@ void do_construct_existing_store(
         multiplexer->proxies[thread_offset], hash_shard_perfmon_name(thread_offset),
         store_args.cache_size, false, store_args.serializers_perfmon_collection,
         store_args.ctx, store_args.io_backender, store_args.base_path);
+    store->enable_cache_warmup_manifest(
+        cache_warmup_manifest_path(store_args.base_path, store_args.namespace_id,
+                                   thread_offset));
     (*stores_out_stores)[thread_offset].init(store);
     store_views[thread_offset] = store;
 }
@@ -70,6 +164,9 @@ void do_create_new_store(
         multiplexer->proxies[thread_offset], hash_shard_perfmon_name(thread_offset),
         store_args.cache_size, true, store_args.serializers_perfmon_collection,
         store_args.ctx, store_args.io_backender, store_args.base_path);
+    store->enable_cache_warmup_manifest(
+        cache_warmup_manifest_path(store_args.base_path, store_args.namespace_id,
+                                   thread_offset));
     (*stores_out_stores)[thread_offset].init(store);
     store_views[thread_offset] = store;
 }
@@ -80,6 +177,7 @@ file_based_svs_by_namespace_t<protocol_t>::get_svs(
             perfmon_collection_t *serializers_perfmon_collection,
             namespace_id_t namespace_id,
             int64_t cache_size,
+            int64_t block_size,
             stores_lifetimer_t<protocol_t> *stores_out,
             scoped_ptr_t<multistore_ptr_t<protocol_t> > *svs_out,
             typename protocol_t::context_t *ctx) {
@@ -93,47 +191,80 @@ file_based_svs_by_namespace_t<protocol_t>::get_svs(
     // exists and then assume it exists or does not exist when
     // loading or creating it.
 
-    // TODO: We should use N slices on M serializers, not N slices
-    // on N serializers.
-
     const int num_stores = CPU_SHARDING_FACTOR;
     scoped_array_t<scoped_ptr_t<typename protocol_t::store_t> > *stores_out_stores
         = stores_out->stores();
     stores_out_stores->init(num_stores);
 
-    const threadnum_t serializer_thread = next_thread(num_db_threads);
+    const std::vector<serializer_filepath_t> all_filepaths
+        = stripe_file_names_for(namespace_id);
+    const bool exists
+        = access(all_filepaths[0].permanent_path().c_str(), R_OK | W_OK) == 0;
+
+    // A new table is striped over all the stripe directories. An existing one
+    // keeps the stripes it was created with, which are the ones whose files
+    // exist, so that adding a stripe directory doesn't break the tables that
+    // are already there. (If a file is missing because its device is, the
+    // multiplexer will notice that the table has fewer stripes than it was
+    // created with.)
+    std::vector<serializer_filepath_t> filepaths;
+    for (size_t i = 0; i < all_filepaths.size(); ++i) {
+        if (!exists || i == 0
+            || access(all_filepaths[i].permanent_path().c_str(), F_OK) == 0) {
+            filepaths.push_back(all_filepaths[i]);
+        }
+    }
+    const int num_stripes = filepaths.size();
+
+    const std::vector<threadnum_t> node_threads = next_numa_node_threads(num_db_threads);
+    std::vector<threadnum_t> serializer_threads;
+    for (int i = 0; i < num_stripes; ++i) {
+        serializer_threads.push_back(next_thread(node_threads));
+    }
     std::vector<threadnum_t> store_threads;
     for (int i = 0; i < num_stores; ++i) {
-        store_threads.push_back(next_thread(num_db_threads));
+        store_threads.push_back(next_thread(node_threads));
     }
 
-    scoped_ptr_t<serializer_t> serializer;
+    // Wait for a turn to open the table. The stripes and stores of this table
+    // are still opened in parallel below.
+    semaphore_acq_t open_acq(&open_semaphore_);
+
+    scoped_array_t<scoped_ptr_t<serializer_t> > serializers(num_stripes);
+    scoped_array_t<scoped_ptr_t<perfmon_membership_t> >
+        serializer_perfmon_memberships(num_stripes);
     scoped_ptr_t<serializer_multiplexer_t> multiplexer;
     scoped_ptr_t<multistore_ptr_t<protocol_t> > mptr;
     {
-        on_thread_t th(serializer_thread);
+        on_thread_t th(serializer_threads[0]);
         scoped_array_t<store_view_t<protocol_t> *> store_views(num_stores);
 
-        const serializer_filepath_t serializer_filepath = file_name_for(namespace_id);
-        int res = access(serializer_filepath.permanent_path().c_str(), R_OK | W_OK);
         store_args_t<protocol_t> store_args(io_backender_, base_path_,
                                             namespace_id, cache_size / num_stores,
                                             serializers_perfmon_collection, ctx);
-        filepath_file_opener_t file_opener(serializer_filepath, io_backender_);
-        if (res == 0) {
-            // TODO: Could we handle failure when loading the serializer?  Right
-            // now, we don't.
-
-            serializer.init(new merger_serializer_t(
-                                scoped_ptr_t<serializer_t>(
-                                    new standard_serializer_t(
-                                        standard_serializer_t::dynamic_config_t(),
-                                        &file_opener,
-                                        serializers_perfmon_collection)),
-                                MERGER_SERIALIZER_MAX_ACTIVE_WRITES));
-
-            std::vector<serializer_t *> ptrs;
-            ptrs.push_back(serializer.get());
+        standard_serializer_t::dynamic_config_t serializer_config;
+        serializer_config.compress_blocks = TABLE_SERIALIZER_COMPRESS_BLOCKS;
+        serializer_config.scrub_on_startup = scrub_on_startup_;
+        // The caches and btrees take their block size from the serializer, so
+        // this is all it takes to give the table its block size.
+        standard_serializer_t::static_config_t serializer_static_config;
+        serializer_static_config.block_size_ = block_size;
+
+        scoped_array_t<scoped_ptr_t<filepath_file_opener_t> > file_openers(num_stripes);
+        serializer_args_t serializer_args(io_backender_, filepaths, serializer_config,
+                                          serializer_static_config, !exists,
+                                          serializers_perfmon_collection);
+        pmap(num_stripes, boost::bind(do_construct_serializer,
+                                      serializer_threads, _1, serializer_args,
+                                      &file_openers, &serializer_perfmon_memberships,
+                                      &serializers));
+
+        std::vector<serializer_t *> ptrs;
+        for (int i = 0; i < num_stripes; ++i) {
+            ptrs.push_back(serializers[i].get());
+        }
+
+        if (exists) {
             multiplexer.init(new serializer_multiplexer_t(ptrs));
 
             // TODO: Exceptions?  Can exceptions happen, and then
@@ -145,18 +276,6 @@ file_based_svs_by_namespace_t<protocol_t>::get_svs(
                                          stores_out_stores, store_views.data()));
             mptr.init(new multistore_ptr_t<protocol_t>(store_views.data(), num_stores));
         } else {
-            standard_serializer_t::create(&file_opener,
-                                          standard_serializer_t::static_config_t());
-            serializer.init(new merger_serializer_t(
-                                scoped_ptr_t<serializer_t>(
-                                    new standard_serializer_t(
-                                    standard_serializer_t::dynamic_config_t(),
-                                    &file_opener,
-                                    serializers_perfmon_collection)),
-                            MERGER_SERIALIZER_MAX_ACTIVE_WRITES));
-
-            std::vector<serializer_t *> ptrs;
-            ptrs.push_back(serializer.get());
             serializer_multiplexer_t::create(ptrs, num_stores);
             multiplexer.init(new serializer_multiplexer_t(ptrs));
 
@@ -184,14 +303,16 @@ file_based_svs_by_namespace_t<protocol_t>::get_svs(
                 order_source.check_in("file_based_svs_by_namespace_t"),
                 &write_token,
                 &dummy_interruptor);
-
-            // Finally, the store is created.
-            file_opener.move_serializer_file_to_permanent_location();
         }
+
+        // For a new table, this is where the store is finally created.
+        pmap(num_stripes, boost::bind(do_release_file_opener,
+                                      serializer_threads, _1, !exists, &file_openers));
     } // back on calling thread
 
     svs_out->init(mptr.release());
-    stores_out->serializer()->init(serializer.release());
+    stores_out->serializers()->swap(serializers);
+    stores_out->serializer_perfmon_memberships()->swap(serializer_perfmon_memberships);
     stores_out->multiplexer()->init(multiplexer.release());
 }
 
@@ -199,10 +320,22 @@ template<class protocol_t>
 void file_based_svs_by_namespace_t<protocol_t>::destroy_svs(namespace_id_t namespace_id) {
     // TODO: Handle errors?  It seems like we can't really handle the error so
     // let's just ignore it?
-    const std::string filepath = file_name_for(namespace_id).permanent_path();
-    const int res = ::unlink(filepath.c_str());
-    guarantee_err(res == 0 || errno == ENOENT,
-                  "unlink failed for file %s", filepath.c_str());
+    const std::vector<serializer_filepath_t> filepaths
+        = stripe_file_names_for(namespace_id);
+    for (size_t i = 0; i < filepaths.size(); ++i) {
+        const std::string filepath = filepaths[i].permanent_path();
+        const int res = ::unlink(filepath.c_str());
+        guarantee_err(res == 0 || errno == ENOENT,
+                      "unlink failed for file %s", filepath.c_str());
+    }
+
+    for (int i = 0; i < CPU_SHARDING_FACTOR; ++i) {
+        const std::string manifest_path
+            = cache_warmup_manifest_path(base_path_, namespace_id, i);
+        const int manifest_res = ::unlink(manifest_path.c_str());
+        guarantee_err(manifest_res == 0 || errno == ENOENT,
+                      "unlink failed for file %s", manifest_path.c_str());
+    }
 }
 
 template<class protocol_t>
@@ -211,9 +344,41 @@ serializer_filepath_t file_based_svs_by_namespace_t<protocol_t>::file_name_for(n
 }
 
 template<class protocol_t>
-threadnum_t file_based_svs_by_namespace_t<protocol_t>::next_thread(int num_db_threads) {
-    thread_counter_ = (thread_counter_ + 1) % num_db_threads;
-    return threadnum_t(thread_counter_);
+std::vector<serializer_filepath_t>
+file_based_svs_by_namespace_t<protocol_t>::stripe_file_names_for(namespace_id_t namespace_id) {
+    std::vector<serializer_filepath_t> filepaths;
+    filepaths.push_back(file_name_for(namespace_id));
+    for (size_t i = 0; i < stripe_paths_.size(); ++i) {
+        filepaths.push_back(serializer_filepath_t(stripe_paths_[i],
+                                                  uuid_to_str(namespace_id) + ".stripe"));
+    }
+    return filepaths;
+}
+
+template<class protocol_t>
+std::vector<threadnum_t>
+file_based_svs_by_namespace_t<protocol_t>::next_numa_node_threads(int num_db_threads) {
+    const int num_nodes = get_num_numa_nodes();
+    for (int tries = 0; tries < num_nodes; ++tries) {
+        node_counter_ = (node_counter_ + 1) % num_nodes;
+        std::vector<threadnum_t> threads;
+        for (int i = 0; i < num_db_threads; ++i) {
+            if (get_thread_numa_node(threadnum_t(i)) == node_counter_) {
+                threads.push_back(threadnum_t(i));
+            }
+        }
+        if (!threads.empty()) {
+            return threads;
+        }
+    }
+    unreachable("No NUMA node has any db threads.");
+}
+
+template<class protocol_t>
+threadnum_t file_based_svs_by_namespace_t<protocol_t>::next_thread(
+        const std::vector<threadnum_t> &threads) {
+    thread_counter_ = (thread_counter_ + 1) % threads.size();
+    return threads[thread_counter_];
 }
 
 #include "mock/dummy_protocol.hpp"
@@ -3,19 +3,29 @@
 #define CLUSTERING_ADMINISTRATION_MAIN_FILE_BASED_SVS_BY_NAMESPACE_HPP_
 
 #include <string>
+#include <vector>
 
 #include "clustering/administration/reactor_driver.hpp"
+#include "concurrency/semaphore.hpp"
+#include "config/args.hpp"
 
 template <class protocol_t>
 class file_based_svs_by_namespace_t : public svs_by_namespace_t<protocol_t> {
 public:
     file_based_svs_by_namespace_t(io_backender_t *io_backender,
-                                  const base_path_t& base_path)
-        : io_backender_(io_backender), base_path_(base_path), thread_counter_(0) { }
+                                  const base_path_t& base_path,
+                                  const std::vector<base_path_t> &stripe_paths,
+                                  bool scrub_on_startup)
+        : io_backender_(io_backender), base_path_(base_path),
+          stripe_paths_(stripe_paths),
+          scrub_on_startup_(scrub_on_startup),
+          open_semaphore_(MAX_CONCURRENT_TABLE_OPENS),
+          node_counter_(0), thread_counter_(0) { }
 
     void get_svs(perfmon_collection_t *serializers_perfmon_collection,
                  namespace_id_t namespace_id,
                  int64_t cache_size,
+                 int64_t block_size,
                  stores_lifetimer_t<protocol_t> *stores_out,
                  scoped_ptr_t<multistore_ptr_t<protocol_t> > *svs_out,
                  typename protocol_t::context_t *);
@@ -23,12 +33,34 @@ public:
     void destroy_svs(namespace_id_t namespace_id);
 
     serializer_filepath_t file_name_for(namespace_id_t namespace_id);
+    // The files of all of the table's stripes, starting with file_name_for().
+    std::vector<serializer_filepath_t> stripe_file_names_for(namespace_id_t namespace_id);
 
 private:
     io_backender_t *io_backender_;
     const base_path_t base_path_;
+    // Tables are striped over one serializer file in `base_path_` and one in each
+    // of these directories, which are meant to be on different devices. Every
+    // file gets its own serializer, with its own GC, I/O accounts and thread, and
+    // the table's hash shards are spread over them by serializer_multiplexer_t.
+    const std::vector<base_path_t> stripe_paths_;
+    // Whether table serializers verify their blocks' checksums after starting up.
+    const bool scrub_on_startup_;
 
-    threadnum_t next_thread(int num_db_threads);
+    // Bounds how many calls to `get_svs()` open their serializers and stores at
+    // the same time (see `MAX_CONCURRENT_TABLE_OPENS`). On startup the reactor
+    // driver asks for every table at once; the rest wait here in turn instead
+    // of all competing for the disks. It is only used on the thread that calls
+    // `get_svs()`, which is the reactor driver's.
+    static_semaphore_t open_semaphore_;
+
+    // The db threads of the next NUMA node in turn that has any.  All of the
+    // threads of a table come from one node, so that its caches and serializers
+    // live in the memory of the socket whose cores use them.
+    std::vector<threadnum_t> next_numa_node_threads(int num_db_threads);
+    int node_counter_; // should only be used by `next_numa_node_threads`
+
+    threadnum_t next_thread(const std::vector<threadnum_t> &threads);
     int thread_counter_; // should only be used by `next_thread`
 
     DISABLE_COPYING(file_based_svs_by_namespace_t);
@@ -7,6 +7,7 @@
 #include "arch/os_signal.hpp"
 #include "clustering/administration/admin_tracker.hpp"
 #include "clustering/administration/auto_reconnect.hpp"
+#include "clustering/administration/auto_sharder.hpp"
 #include "clustering/administration/http/server.hpp"
 #include "clustering/administration/issues/local.hpp"
 #include "clustering/administration/logger.hpp"
@@ -27,6 +28,7 @@
 #include "memcached/tcp_conn.hpp"
 #include "mock/dummy_protocol.hpp"
 #include "mock/dummy_protocol_parser.hpp"
+#include "rdb_protocol/external_sort.hpp"
 #include "rdb_protocol/parser.hpp"
 #include "rdb_protocol/pb_server.hpp"
 #include "rdb_protocol/protocol.hpp"
@@ -66,15 +68,22 @@ bool do_serve(
     bool i_am_a_server,
     // NB. filepath & persistent_file are used iff i_am_a_server is true.
     const base_path_t &base_path,
+    const std::vector<base_path_t> &stripe_paths,
     metadata_persistence::cluster_persistent_file_t *cluster_metadata_file,
     metadata_persistence::auth_persistent_file_t *auth_metadata_file,
     const peer_address_set_t &joins,
     service_address_ports_t address_ports,
     std::string web_assets,
     os_signal_cond_t *stop_cond,
-    const boost::optional<std::string> &config_file) {
+    const boost::optional<std::string> &config_file,
+    bool scrub_on_startup,
+    size_t query_cache_size,
+    const boost::optional<std::string> &capture_queries_file,
+    const ql::query_limits_t &query_limits,
+    bool driver_reuseport,
+    bool auto_shard) {
     try {
-        extproc_pool_t extproc_pool(get_num_threads());
+        extproc_pool_t extproc_pool(EXTPROC_MAX_WORKERS_PER_THREAD * get_num_threads());
 
         local_issue_tracker_t local_issue_tracker;
 
@@ -102,7 +111,10 @@ bool do_serve(
         heartbeat_manager_t heartbeat_manager(&heartbeat_manager_client);
         message_multiplexer_t::client_t::run_t heartbeat_manager_client_run(&heartbeat_manager_client, &heartbeat_manager);
 
-        message_multiplexer_t::client_t mailbox_manager_client(&message_multiplexer, 'M');
+        // Mailbox messages don't arrive in order anyway, so the large ones can
+        // go on the cluster's bulk connections.
+        message_multiplexer_t::client_t mailbox_manager_client(&message_multiplexer, 'M',
+                                                               message_class_t::bulk);
         mailbox_manager_t mailbox_manager(&mailbox_manager_client);
         message_multiplexer_t::client_t::run_t mailbox_manager_client_run(&mailbox_manager_client, &mailbox_manager);
 
@@ -157,7 +169,9 @@ bool do_serve(
                 address_ports.port,
                 &message_multiplexer_run,
                 address_ports.client_port,
-                &heartbeat_manager));
+                &heartbeat_manager,
+                address_ports.cluster_connections,
+                address_ports.cluster_compression));
 
             // Update the directory with the ip addresses that we are passing to peers
             std::set<ip_and_port_t> ips = connectivity_cluster_run->get_ips();
@@ -253,6 +267,12 @@ bool do_serve(
 
         //This is an annoying chicken and egg problem here
         rdb_ctx.ns_repo = &rdb_namespace_repo;
+        rdb_ctx.manager = &mailbox_manager;
+        rdb_ctx.query_limits = query_limits;
+
+        if (io_backender != NULL) {
+            rdb_ctx.spill_space.init(new ql::spill_space_t(io_backender, base_path));
+        }
 
         {
             // Reactor drivers
@@ -265,7 +285,7 @@ bool do_serve(
 
             if (i_am_a_server) {
                 dummy_svs_source.init(new file_based_svs_by_namespace_t<mock::dummy_protocol_t>(
-                    io_backender, base_path));
+                    io_backender, base_path, stripe_paths, scrub_on_startup));
                 dummy_reactor_driver.init(new reactor_driver_t<mock::dummy_protocol_t>(
                     base_path,
                     io_backender,
@@ -298,7 +318,7 @@ bool do_serve(
 
             if (i_am_a_server) {
                 memcached_svs_source.init(new file_based_svs_by_namespace_t<memcached_protocol_t>(
-                    io_backender, base_path));
+                    io_backender, base_path, stripe_paths, scrub_on_startup));
                 memcached_reactor_driver.init(new reactor_driver_t<memcached_protocol_t>(
                     base_path,
                     io_backender,
@@ -331,7 +351,7 @@ bool do_serve(
 
             if (i_am_a_server) {
                 rdb_svs_source.init(new file_based_svs_by_namespace_t<rdb_protocol_t>(
-                    io_backender, base_path));
+                    io_backender, base_path, stripe_paths, scrub_on_startup));
                 rdb_reactor_driver.init(new reactor_driver_t<rdb_protocol_t>(
                         base_path,
                         io_backender,
@@ -356,6 +376,16 @@ bool do_serve(
                     &our_root_directory_variable));
             }
 
+            scoped_ptr_t<auto_sharder_t> auto_sharder;
+            if (i_am_a_server && auto_shard) {
+                auto_sharder.init(new auto_sharder_t(
+                    &mailbox_manager,
+                    machine_id,
+                    semilattice_manager_cluster.get_root_view(),
+                    directory_read_manager.get_root_view(),
+                    &rdb_namespace_repo));
+            }
+
             {
                 parser_maker_t<mock::dummy_protocol_t, mock::dummy_protocol_parser_t> dummy_parser_maker(
                     &mailbox_manager,
@@ -378,7 +408,12 @@ bool do_serve(
                 rdb_protocol::query_http_app_t rdb_parser(semilattice_manager_cluster.get_root_view(), &rdb_namespace_repo);
 
                 query2_server_t rdb_pb2_server(address_ports.local_addresses,
-                                               address_ports.reql_port, &rdb_ctx);
+                                               address_ports.reql_port, &rdb_ctx,
+                                               query_cache_size,
+                                               capture_queries_file,
+                                               driver_reuseport
+                                               ? LISTENER_PER_THREAD
+                                               : SINGLE_LISTENER);
                 logINF("Listening for client driver connections on port %d\n",
                        rdb_pb2_server.get_port());
 
@@ -477,40 +512,65 @@ bool do_serve(
 
 bool serve(io_backender_t *io_backender,
            const base_path_t &base_path,
+           const std::vector<base_path_t> &stripe_paths,
            metadata_persistence::cluster_persistent_file_t *cluster_persistent_file,
            metadata_persistence::auth_persistent_file_t *auth_persistent_file,
            const peer_address_set_t &joins,
            service_address_ports_t address_ports,
            std::string web_assets,
            os_signal_cond_t *stop_cond,
-           const boost::optional<std::string>& config_file) {
+           const boost::optional<std::string>& config_file,
+           bool scrub_on_startup,
+           size_t query_cache_size,
+           const boost::optional<std::string> &capture_queries_file,
+           const ql::query_limits_t &query_limits,
+           bool driver_reuseport,
+           bool auto_shard) {
     return do_serve(io_backender,
                     true,
                     base_path,
+                    stripe_paths,
                     cluster_persistent_file,
                     auth_persistent_file,
                     joins,
                     address_ports,
                     web_assets,
                     stop_cond,
-                    config_file);
+                    config_file,
+                    scrub_on_startup,
+                    query_cache_size,
+                    capture_queries_file,
+                    query_limits,
+                    driver_reuseport,
+                    auto_shard);
 }
 
 bool serve_proxy(const peer_address_set_t &joins,
                  service_address_ports_t address_ports,
                  std::string web_assets,
                  os_signal_cond_t *stop_cond,
-                 const boost::optional<std::string>& config_file) {
+                 const boost::optional<std::string>& config_file,
+                 size_t query_cache_size,
+                 const boost::optional<std::string> &capture_queries_file,
+                 const ql::query_limits_t &query_limits,
+                 bool driver_reuseport) {
     // TODO: filepath doesn't _seem_ ignored.
     // filepath and persistent_file are ignored for proxies, so we use the empty string & NULL respectively.
     return do_serve(NULL,
                     false,
                     base_path_t(""),
+                    std::vector<base_path_t>(),
                     NULL,
                     NULL,
                     joins,
                     address_ports,
                     web_assets,
                     stop_cond,
-                    config_file);
+                    config_file,
+                    false,
+                    query_cache_size,
+                    capture_queries_file,
+                    query_limits,
+                    driver_reuseport,
+                    false);
 }
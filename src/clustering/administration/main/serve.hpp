@@ -4,12 +4,17 @@
 
 #include <set>
 #include <string>
+#include <vector>
 
 #include "clustering/administration/metadata.hpp"
 #include "clustering/administration/persist.hpp"
 #include "arch/address.hpp"
+#include "rpc/connectivity/cluster.hpp"
 
 class os_signal_cond_t;
+namespace ql {
+struct query_limits_t;
+}  // namespace ql
 
 class invalid_port_exc_t : public std::exception {
 public:
@@ -41,6 +46,8 @@ struct service_address_ports_t {
     service_address_ports_t() :
         port(0),
         client_port(0),
+        cluster_connections(1),
+        cluster_compression(cluster_compression_t::none),
         http_port(0),
         reql_port(0),
         port_offset(0) { }
@@ -49,6 +56,8 @@ struct service_address_ports_t {
                             const peer_address_t &_canonical_addresses,
                             int _port,
                             int _client_port,
+                            int _cluster_connections,
+                            cluster_compression_t _cluster_compression,
                             bool _http_admin_is_disabled,
                             int _http_port,
                             int _reql_port,
@@ -57,6 +66,8 @@ struct service_address_ports_t {
         canonical_addresses(_canonical_addresses),
         port(_port),
         client_port(_client_port),
+        cluster_connections(_cluster_connections),
+        cluster_compression(_cluster_compression),
         http_admin_is_disabled(_http_admin_is_disabled),
         http_port(_http_port),
         reql_port(_reql_port),
@@ -76,6 +87,10 @@ struct service_address_ports_t {
     peer_address_t canonical_addresses;
     int port;
     int client_port;
+    // How many TCP connections to open to each other node.
+    int cluster_connections;
+    // Which messages to other nodes to compress.
+    cluster_compression_t cluster_compression;
     bool http_admin_is_disabled;
     int http_port;
     int reql_port;
@@ -87,18 +102,29 @@ long time to compile. */
 
 bool serve(io_backender_t *io_backender,
            const base_path_t &base_path,
+           const std::vector<base_path_t> &stripe_paths,
            metadata_persistence::cluster_persistent_file_t *cluster_persistent_file,
            metadata_persistence::auth_persistent_file_t *auth_persistent_file,
            const peer_address_set_t &joins,
            service_address_ports_t ports,
            std::string web_assets,
            os_signal_cond_t *stop_cond,
-           const boost::optional<std::string>& config_file);
+           const boost::optional<std::string>& config_file,
+           bool scrub_on_startup,
+           size_t query_cache_size,
+           const boost::optional<std::string> &capture_queries_file,
+           const ql::query_limits_t &query_limits,
+           bool driver_reuseport,
+           bool auto_shard);
 
 bool serve_proxy(const peer_address_set_t &joins,
                  service_address_ports_t ports,
                  std::string web_assets,
                  os_signal_cond_t *stop_cond,
-                 const boost::optional<std::string>& config_file);
+                 const boost::optional<std::string>& config_file,
+                 size_t query_cache_size,
+                 const boost::optional<std::string> &capture_queries_file,
+                 const ql::query_limits_t &query_limits,
+           bool driver_reuseport);
 
 #endif /* CLUSTERING_ADMINISTRATION_MAIN_SERVE_HPP_ */
@@ -153,6 +153,16 @@ void with_ctx_on_subfield_change(databases_semilattice_metadata_t *target, const
 
 
 
+cluster_semilattice_metadata_t from_v1_11(const cluster_semilattice_metadata_v1_11_t &old) {
+    cluster_semilattice_metadata_t res;
+    res.dummy_namespaces.set(from_v1_11(old.dummy_namespaces));
+    res.memcached_namespaces.set(from_v1_11(old.memcached_namespaces));
+    res.rdb_namespaces.set(from_v1_11(old.rdb_namespaces));
+    res.machines = old.machines;
+    res.datacenters = old.datacenters;
+    res.databases = old.databases;
+    return res;
+}
 
 //json adapter concept for cluster_semilattice_metadata_t
 json_adapter_if_t::json_adapter_map_t with_ctx_get_json_subfields(cluster_semilattice_metadata_t *target, const vclock_ctx_t &ctx) {
@@ -258,6 +268,9 @@ json_adapter_if_t::json_adapter_map_t with_ctx_get_json_subfields(namespace_semi
     res["primary_key"] = boost::shared_ptr<json_adapter_if_t>(new json_vclock_adapter_t<std::string>(&target->primary_key, ctx));
     res["database"] = boost::shared_ptr<json_adapter_if_t>(new json_vclock_adapter_t<database_id_t>(&target->database, ctx));
     res["cache_size"] = boost::shared_ptr<json_adapter_if_t>(new json_vclock_adapter_t<int64_t>(&target->cache_size, ctx));
+    res["max_backfill_mb_per_sec"] = boost::shared_ptr<json_adapter_if_t>(new json_vclock_adapter_t<int64_t>(&target->max_backfill_mb_per_sec, ctx));
+    res["near_cache_rows"] = boost::shared_ptr<json_adapter_if_t>(new json_vclock_adapter_t<int64_t>(&target->near_cache_rows, ctx));
+    res["block_size"] = boost::shared_ptr<json_adapter_if_t>(new json_vclock_adapter_t<int64_t>(&target->block_size, ctx));
     return res;
 }
 
@@ -296,6 +309,9 @@ inline json_adapter_if_t::json_adapter_map_t with_ctx_get_json_subfields(namespa
     default_namespace.primary_key = default_namespace.primary_key.make_new_version("id", ctx.us);
 
     default_namespace.cache_size = default_namespace.cache_size.make_new_version(GIGABYTE, ctx.us);
+    default_namespace.max_backfill_mb_per_sec = default_namespace.max_backfill_mb_per_sec.make_new_version(0, ctx.us);
+    default_namespace.near_cache_rows = default_namespace.near_cache_rows.make_new_version(0, ctx.us);
+    default_namespace.block_size = default_namespace.block_size.make_new_version(DEFAULT_BTREE_BLOCK_SIZE, ctx.us);
 
     deletable_t<namespace_semilattice_metadata_t<protocol_t> > default_ns_in_deletable(default_namespace);
     return json_ctx_adapter_with_inserter_t<typename namespaces_semilattice_metadata_t<protocol_t>::namespace_map_t, vclock_ctx_t>(&target->namespaces, generate_uuid, ctx, default_ns_in_deletable).get_subfields();
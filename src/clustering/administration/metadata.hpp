@@ -50,6 +50,24 @@ public:
 RDB_MAKE_SEMILATTICE_JOINABLE_6(cluster_semilattice_metadata_t, dummy_namespaces, memcached_namespaces, rdb_namespaces, machines, datacenters, databases);
 RDB_MAKE_EQUALITY_COMPARABLE_6(cluster_semilattice_metadata_t, dummy_namespaces, memcached_namespaces, rdb_namespaces, machines, datacenters, databases);
 
+/* `cluster_semilattice_metadata_t` as version 1.11 serialized it, which is how the
+superblock of a cluster metadata file from 1.11 has it.  Only the namespaces have
+a different layout. */
+class cluster_semilattice_metadata_v1_11_t {
+public:
+    namespaces_semilattice_metadata_v1_11_t<mock::dummy_protocol_t> dummy_namespaces;
+    namespaces_semilattice_metadata_v1_11_t<memcached_protocol_t> memcached_namespaces;
+    namespaces_semilattice_metadata_v1_11_t<rdb_protocol_t> rdb_namespaces;
+
+    machines_semilattice_metadata_t machines;
+    datacenters_semilattice_metadata_t datacenters;
+    databases_semilattice_metadata_t databases;
+
+    RDB_MAKE_ME_SERIALIZABLE_6(dummy_namespaces, memcached_namespaces, rdb_namespaces, machines, datacenters, databases);
+};
+
+cluster_semilattice_metadata_t from_v1_11(const cluster_semilattice_metadata_v1_11_t &old);
+
 //json adapter concept for cluster_semilattice_metadata_t
 json_adapter_if_t::json_adapter_map_t with_ctx_get_json_subfields(cluster_semilattice_metadata_t *target, const vclock_ctx_t &ctx);
 cJSON *with_ctx_render_as_json(cluster_semilattice_metadata_t *target, const vclock_ctx_t &ctx);
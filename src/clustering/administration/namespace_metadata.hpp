@@ -64,7 +64,7 @@ void debug_print(printf_buffer_t *buf, const ack_expectation_t &x);
 template<class protocol_t>
 class namespace_semilattice_metadata_t {
 public:
-    namespace_semilattice_metadata_t() : cache_size(GIGABYTE) { }
+    namespace_semilattice_metadata_t() : cache_size(GIGABYTE), max_backfill_mb_per_sec(0), near_cache_rows(0), block_size(DEFAULT_BTREE_BLOCK_SIZE) { }
 
     vclock_t<persistable_blueprint_t<protocol_t> > blueprint;
     vclock_t<datacenter_id_t> primary_datacenter;
@@ -78,8 +78,17 @@ public:
     vclock_t<std::string> primary_key; //TODO this should actually never be changed...
     vclock_t<database_id_t> database;
     vclock_t<int64_t> cache_size;
-
-    RDB_MAKE_ME_SERIALIZABLE_12(blueprint, primary_datacenter, replica_affinities, ack_expectations, shards, name, port, primary_pinnings, secondary_pinnings, primary_key, database, cache_size);
+    /* How fast backfills of the table may send data, 0 for no limit.  See
+    `backfill_governor_t`. */
+    vclock_t<int64_t> max_backfill_mb_per_sec;
+    /* How many rows of the table each server keeps for reads with `use_outdated`,
+    0 for none.  See `ql::near_cache_t`. */
+    vclock_t<int64_t> near_cache_rows;
+    /* The block size of the table's btrees.  It's only used when a server
+    creates its files for the table, which keep the size they were created with. */
+    vclock_t<int64_t> block_size;
+
+    RDB_MAKE_ME_SERIALIZABLE_15(blueprint, primary_datacenter, replica_affinities, ack_expectations, shards, name, port, primary_pinnings, secondary_pinnings, primary_key, database, cache_size, max_backfill_mb_per_sec, near_cache_rows, block_size);
 };
 
 template <class protocol_t>
@@ -113,7 +122,7 @@ template<class protocol_t>
 namespace_semilattice_metadata_t<protocol_t> new_namespace(
     uuid_u machine, uuid_u database, uuid_u datacenter,
     const name_string_t &name, const std::string &key, int port,
-    int64_t cache_size) {
+    int64_t cache_size, int64_t block_size = DEFAULT_BTREE_BLOCK_SIZE) {
 
     namespace_semilattice_metadata_t<protocol_t> ns;
     ns.database           = make_vclock(database, machine);
@@ -140,14 +149,69 @@ namespace_semilattice_metadata_t<protocol_t> new_namespace(
     ns.secondary_pinnings = make_vclock(secondary_pinnings, machine);
 
     ns.cache_size = make_vclock(cache_size, machine);
+    ns.max_backfill_mb_per_sec = make_vclock(static_cast<int64_t>(0), machine);
+    ns.near_cache_rows = make_vclock(static_cast<int64_t>(0), machine);
+    ns.block_size = make_vclock(block_size, machine);
     return ns;
 }
 
 template<class protocol_t>
-RDB_MAKE_SEMILATTICE_JOINABLE_12(namespace_semilattice_metadata_t<protocol_t>, blueprint, primary_datacenter, replica_affinities, ack_expectations, shards, name, port, primary_pinnings, secondary_pinnings, primary_key, database, cache_size);
+RDB_MAKE_SEMILATTICE_JOINABLE_15(namespace_semilattice_metadata_t<protocol_t>, blueprint, primary_datacenter, replica_affinities, ack_expectations, shards, name, port, primary_pinnings, secondary_pinnings, primary_key, database, cache_size, max_backfill_mb_per_sec, near_cache_rows, block_size);
 
 template<class protocol_t>
-RDB_MAKE_EQUALITY_COMPARABLE_12(namespace_semilattice_metadata_t<protocol_t>, blueprint, primary_datacenter, replica_affinities, ack_expectations, shards, name, port, primary_pinnings, secondary_pinnings, primary_key, database, cache_size);
+RDB_MAKE_EQUALITY_COMPARABLE_15(namespace_semilattice_metadata_t<protocol_t>, blueprint, primary_datacenter, replica_affinities, ack_expectations, shards, name, port, primary_pinnings, secondary_pinnings, primary_key, database, cache_size, max_backfill_mb_per_sec, near_cache_rows, block_size);
+
+/* `namespace_semilattice_metadata_t` as version 1.11 serialized it, which is how
+the metadata files it wrote have it.  The fields are the same, but there are only
+the first twelve of them, so a record of this layout can't be read as a
+`namespace_semilattice_metadata_t`. */
+template <class protocol_t>
+class namespace_semilattice_metadata_v1_11_t {
+public:
+    vclock_t<persistable_blueprint_t<protocol_t> > blueprint;
+    vclock_t<datacenter_id_t> primary_datacenter;
+    vclock_t<std::map<datacenter_id_t, int32_t> > replica_affinities;
+    vclock_t<std::map<datacenter_id_t, ack_expectation_t> > ack_expectations;
+    vclock_t<nonoverlapping_regions_t<protocol_t> > shards;
+    vclock_t<name_string_t> name;
+    vclock_t<int> port;
+    vclock_t<region_map_t<protocol_t, machine_id_t> > primary_pinnings;
+    vclock_t<region_map_t<protocol_t, std::set<machine_id_t> > > secondary_pinnings;
+    vclock_t<std::string> primary_key;
+    vclock_t<database_id_t> database;
+    vclock_t<int64_t> cache_size;
+
+    RDB_MAKE_ME_SERIALIZABLE_12(blueprint, primary_datacenter, replica_affinities, ack_expectations, shards, name, port, primary_pinnings, secondary_pinnings, primary_key, database, cache_size);
+};
+
+/* The metadata that `old` has in the current layout.  The fields that version
+1.11 didn't have get unversioned defaults, so that any change a server makes to
+them wins over them. */
+template <class protocol_t>
+namespace_semilattice_metadata_t<protocol_t> from_v1_11(
+        const namespace_semilattice_metadata_v1_11_t<protocol_t> &old) {
+    namespace_semilattice_metadata_t<protocol_t> ns;
+    ns.blueprint = old.blueprint;
+    ns.primary_datacenter = old.primary_datacenter;
+    ns.replica_affinities = old.replica_affinities;
+    ns.ack_expectations = old.ack_expectations;
+    ns.shards = old.shards;
+    ns.name = old.name;
+    ns.port = old.port;
+    ns.primary_pinnings = old.primary_pinnings;
+    ns.secondary_pinnings = old.secondary_pinnings;
+    ns.primary_key = old.primary_key;
+    ns.database = old.database;
+    ns.cache_size = old.cache_size;
+    // Backfills of tables from before weren't limited.
+    ns.max_backfill_mb_per_sec = vclock_t<int64_t>(0);
+    // Nor did they keep rows for outdated reads.
+    ns.near_cache_rows = vclock_t<int64_t>(0);
+    /* Their files were all created with the serializer's default block size, and
+    a server that creates more files for one of them has to use that too. */
+    ns.block_size = vclock_t<int64_t>(DEFAULT_BTREE_BLOCK_SIZE);
+    return ns;
+}
 
 // ctx-less json adapter concept for ack_expectation_t
 json_adapter_if_t::json_adapter_map_t get_json_subfields(ack_expectation_t *target);
@@ -183,6 +247,33 @@ RDB_MAKE_SEMILATTICE_JOINABLE_1(namespaces_semilattice_metadata_t<protocol_t>, n
 template<class protocol_t>
 RDB_MAKE_EQUALITY_COMPARABLE_1(namespaces_semilattice_metadata_t<protocol_t>, namespaces);
 
+/* `namespaces_semilattice_metadata_t` as version 1.11 serialized it. */
+template <class protocol_t>
+class namespaces_semilattice_metadata_v1_11_t {
+public:
+    typedef std::map<namespace_id_t, deletable_t<namespace_semilattice_metadata_v1_11_t<protocol_t> > > namespace_map_t;
+    namespace_map_t namespaces;
+
+    RDB_MAKE_ME_SERIALIZABLE_1(namespaces);
+};
+
+template <class protocol_t>
+namespaces_semilattice_metadata_t<protocol_t> from_v1_11(
+        const namespaces_semilattice_metadata_v1_11_t<protocol_t> &old) {
+    namespaces_semilattice_metadata_t<protocol_t> res;
+    for (typename namespaces_semilattice_metadata_v1_11_t<protocol_t>::namespace_map_t::const_iterator it = old.namespaces.begin();
+         it != old.namespaces.end(); ++it) {
+        deletable_t<namespace_semilattice_metadata_t<protocol_t> > ns;
+        if (it->second.is_deleted()) {
+            ns.mark_deleted();
+        } else {
+            ns = make_deletable(from_v1_11(it->second.get_ref()));
+        }
+        res.namespaces[it->first] = ns;
+    }
+    return res;
+}
+
 // json adapter concept for namespaces_semilattice_metadata_t
 template <class protocol_t>
 json_adapter_if_t::json_adapter_map_t with_ctx_get_json_subfields(namespaces_semilattice_metadata_t<protocol_t> *target, const vclock_ctx_t &ctx);
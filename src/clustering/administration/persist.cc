@@ -4,10 +4,13 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 
+#include <map>
+
 #include "arch/runtime/thread_pool.hpp"
 #include "buffer_cache/blob.hpp"
 #include "containers/archive/buffer_group_stream.hpp"
 #include "clustering/immediate_consistency/branch/history.hpp"
+#include "concurrency/wait_any.hpp"
 #include "serializer/config.hpp"
 
 namespace metadata_persistence {
@@ -33,10 +36,30 @@ struct cluster_metadata_superblock_t {
     char dummy_branch_history_blob[BRANCH_HISTORY_BLOB_MAXREFLEN];
     char memcached_branch_history_blob[BRANCH_HISTORY_BLOB_MAXREFLEN];
     char rdb_branch_history_blob[BRANCH_HISTORY_BLOB_MAXREFLEN];
+
+    /* With `namespace_records_magic`, `metadata_blob` has the metadata without the
+    namespaces, and every namespace is in a `namespace_metadata_block_t` of its
+    own, which this lists.  Files from version 1.11 have `expected_magic` and all
+    of the metadata in `metadata_blob`, in the layout of
+    `cluster_semilattice_metadata_v1_11_t`.  They get converted when they're
+    opened. */
+    static const int NAMESPACE_BLOCKS_BLOB_MAXREFLEN = 500;
+    char namespace_blocks_blob[NAMESPACE_BLOCKS_BLOB_MAXREFLEN];
 };
 
-/* Etymology: (R)ethink(D)B (m)eta(d)ata */
+// The metadata of a namespace, so that a change to it only rewrites its block.
+struct namespace_metadata_block_t {
+    block_magic_t magic;
+
+    static const int METADATA_BLOB_MAXREFLEN = 1500;
+    char metadata_blob[METADATA_BLOB_MAXREFLEN];
+};
+
+/* Etymology: (R)ethink(D)B (m)eta(d)ata.  Cluster metadata files only have it
+from version 1.11. */
 const block_magic_t expected_magic = { { 'R', 'D', 'm', 'd' } };
+const block_magic_t namespace_records_magic = { { 'R', 'D', 'm', 'n' } };
+const block_magic_t namespace_block_magic = { { 'R', 'D', 'n', 's' } };
 
 template <class T>
 static void write_blob(transaction_t *txn, char *ref, int maxreflen, const T &value) {
@@ -200,6 +223,8 @@ cluster_persistent_file_t::cluster_persistent_file_t(io_backender_t *io_backende
                                                      perfmon_collection_t *perfmon_parent) :
     persistent_file_t<cluster_semilattice_metadata_t>(io_backender, filename, perfmon_parent, false) {
     construct_branch_history_managers(false);
+    last_written = read_metadata();
+    convert_v1_11_file();
 }
 
 cluster_persistent_file_t::cluster_persistent_file_t(io_backender_t *io_backender,
@@ -218,10 +243,7 @@ cluster_persistent_file_t::cluster_persistent_file_t(io_backender_t *io_backende
     bzero(sb, get_cache_block_size().value());
     sb->magic = expected_magic;
     sb->machine_id = machine_id;
-    write_blob(txn.get(),
-               sb->metadata_blob,
-               cluster_metadata_superblock_t::METADATA_BLOB_MAXREFLEN,
-               initial_metadata);
+    write_metadata(txn.get(), &superblock, initial_metadata);
     write_blob(txn.get(),
                sb->dummy_branch_history_blob,
                cluster_metadata_superblock_t::BRANCH_HISTORY_BLOB_MAXREFLEN,
@@ -242,24 +264,149 @@ cluster_persistent_file_t::~cluster_persistent_file_t() {
     // Do nothing
 }
 
+template <class protocol_t>
+static void read_namespace_records(transaction_t *txn,
+                                   const std::map<namespace_id_t, block_id_t> &blocks,
+                                   cow_ptr_t<namespaces_semilattice_metadata_t<protocol_t> > *namespaces_out) {
+    typename cow_ptr_t<namespaces_semilattice_metadata_t<protocol_t> >::change_t change(namespaces_out);
+    for (std::map<namespace_id_t, block_id_t>::const_iterator it = blocks.begin(); it != blocks.end(); ++it) {
+        buf_lock_t block(txn, it->second, rwi_read);
+        const namespace_metadata_block_t *nb = static_cast<const namespace_metadata_block_t *>(block.get_data_read());
+        guarantee(nb->magic == namespace_block_magic);
+        read_blob(txn, nb->metadata_blob, namespace_metadata_block_t::METADATA_BLOB_MAXREFLEN,
+                  &change.get()->namespaces[it->first]);
+    }
+}
+
 cluster_semilattice_metadata_t cluster_persistent_file_t::read_metadata() {
     object_buffer_t<transaction_t> txn;
     get_read_transaction(&txn, "read_metadata");
     buf_lock_t superblock(txn.get(), SUPERBLOCK_ID, rwi_read);
 
     const cluster_metadata_superblock_t *sb = static_cast<const cluster_metadata_superblock_t *>(superblock.get_data_read());
+    if (sb->magic == expected_magic) {
+        cluster_semilattice_metadata_v1_11_t old;
+        read_blob(txn.get(), sb->metadata_blob, cluster_metadata_superblock_t::METADATA_BLOB_MAXREFLEN, &old);
+        return from_v1_11(old);
+    }
+    guarantee(sb->magic == namespace_records_magic, "Unrecognized cluster metadata file format");
     cluster_semilattice_metadata_t metadata;
     read_blob(txn.get(), sb->metadata_blob, cluster_metadata_superblock_t::METADATA_BLOB_MAXREFLEN, &metadata);
+    read_blob(txn.get(), sb->namespace_blocks_blob, cluster_metadata_superblock_t::NAMESPACE_BLOCKS_BLOB_MAXREFLEN, &namespace_blocks);
+    read_namespace_records(txn.get(), namespace_blocks.dummy, &metadata.dummy_namespaces);
+    read_namespace_records(txn.get(), namespace_blocks.memcached, &metadata.memcached_namespaces);
+    read_namespace_records(txn.get(), namespace_blocks.rdb, &metadata.rdb_namespaces);
     return metadata;
 }
 
+void cluster_persistent_file_t::convert_v1_11_file() {
+    object_buffer_t<transaction_t> txn;
+    get_write_transaction(&txn, "convert_v1_11_file");
+    buf_lock_t superblock(txn.get(), SUPERBLOCK_ID, rwi_write);
+    const cluster_metadata_superblock_t *sb = static_cast<const cluster_metadata_superblock_t *>(superblock.get_data_read());
+    if (sb->magic == expected_magic) {
+        write_metadata(txn.get(), &superblock, last_written);
+    }
+}
+
 void cluster_persistent_file_t::update_metadata(const cluster_semilattice_metadata_t &metadata) {
     object_buffer_t<transaction_t> txn;
     get_write_transaction(&txn, "update_metadata");
     buf_lock_t superblock(txn.get(), SUPERBLOCK_ID, rwi_write);
+    write_metadata(txn.get(), &superblock, metadata);
+}
 
-    cluster_metadata_superblock_t *sb = static_cast<cluster_metadata_superblock_t *>(superblock.get_data_write());
-    write_blob(txn.get(), sb->metadata_blob, cluster_metadata_superblock_t::METADATA_BLOB_MAXREFLEN, metadata);
+/* Writes the namespaces of `namespaces` that aren't the same in `last_written`,
+or all of them if it's `NULL`, and frees the blocks of the ones that are gone. */
+template <class protocol_t>
+static void write_namespace_records(
+        transaction_t *txn,
+        const cow_ptr_t<namespaces_semilattice_metadata_t<protocol_t> > &namespaces,
+        const cow_ptr_t<namespaces_semilattice_metadata_t<protocol_t> > *last_written,
+        std::map<namespace_id_t, block_id_t> *blocks,
+        bool *blocks_changed_out) {
+    typedef typename namespaces_semilattice_metadata_t<protocol_t>::namespace_map_t namespace_map_t;
+    const block_size_t block_size = txn->get_cache()->get_block_size();
+
+    for (std::map<namespace_id_t, block_id_t>::iterator it = blocks->begin(); it != blocks->end();) {
+        if (std_contains(namespaces->namespaces, it->first)) {
+            ++it;
+            continue;
+        }
+        buf_lock_t block(txn, it->second, rwi_write);
+        namespace_metadata_block_t *nb = static_cast<namespace_metadata_block_t *>(block.get_data_write());
+        blob_t blob(block_size, nb->metadata_blob, namespace_metadata_block_t::METADATA_BLOB_MAXREFLEN);
+        blob.clear(txn);
+        block.mark_deleted();
+        blocks->erase(it++);
+        *blocks_changed_out = true;
+    }
+
+    for (typename namespace_map_t::const_iterator it = namespaces->namespaces.begin();
+         it != namespaces->namespaces.end(); ++it) {
+        std::map<namespace_id_t, block_id_t>::iterator block_it = blocks->find(it->first);
+        if (block_it == blocks->end()) {
+            buf_lock_t block(txn);
+            namespace_metadata_block_t *nb = static_cast<namespace_metadata_block_t *>(block.get_data_write());
+            bzero(nb, block_size.value());
+            nb->magic = namespace_block_magic;
+            write_blob(txn, nb->metadata_blob, namespace_metadata_block_t::METADATA_BLOB_MAXREFLEN, it->second);
+            (*blocks)[it->first] = block.get_block_id();
+            *blocks_changed_out = true;
+            continue;
+        }
+        if (last_written != NULL) {
+            typename namespace_map_t::const_iterator last = (*last_written)->namespaces.find(it->first);
+            if (last != (*last_written)->namespaces.end() && last->second == it->second) {
+                continue;
+            }
+        }
+        buf_lock_t block(txn, block_it->second, rwi_write);
+        namespace_metadata_block_t *nb = static_cast<namespace_metadata_block_t *>(block.get_data_write());
+        write_blob(txn, nb->metadata_blob, namespace_metadata_block_t::METADATA_BLOB_MAXREFLEN, it->second);
+    }
+}
+
+// The metadata that goes in the superblock, everything but the namespaces.
+static cluster_semilattice_metadata_t without_namespaces(const cluster_semilattice_metadata_t &metadata) {
+    cluster_semilattice_metadata_t res = metadata;
+    res.dummy_namespaces = cow_ptr_t<namespaces_semilattice_metadata_t<mock::dummy_protocol_t> >();
+    res.memcached_namespaces = cow_ptr_t<namespaces_semilattice_metadata_t<memcached_protocol_t> >();
+    res.rdb_namespaces = cow_ptr_t<namespaces_semilattice_metadata_t<rdb_protocol_t> >();
+    return res;
+}
+
+void cluster_persistent_file_t::write_metadata(transaction_t *txn, buf_lock_t *superblock,
+                                               const cluster_semilattice_metadata_t &metadata) {
+    /* The superblock only gets acquired for write if something in it changes, so
+    a change to a namespace only writes that namespace's block. */
+    const cluster_metadata_superblock_t *sb = static_cast<const cluster_metadata_superblock_t *>(superblock->get_data_read());
+    const bool rewrite_all = !(sb->magic == namespace_records_magic);
+
+    bool blocks_changed = rewrite_all;
+    write_namespace_records(txn, metadata.dummy_namespaces,
+                            rewrite_all ? NULL : &last_written.dummy_namespaces,
+                            &namespace_blocks.dummy, &blocks_changed);
+    write_namespace_records(txn, metadata.memcached_namespaces,
+                            rewrite_all ? NULL : &last_written.memcached_namespaces,
+                            &namespace_blocks.memcached, &blocks_changed);
+    write_namespace_records(txn, metadata.rdb_namespaces,
+                            rewrite_all ? NULL : &last_written.rdb_namespaces,
+                            &namespace_blocks.rdb, &blocks_changed);
+
+    const cluster_semilattice_metadata_t rest = without_namespaces(metadata);
+    const bool rest_changed = rewrite_all || !(rest == without_namespaces(last_written));
+    if (blocks_changed || rest_changed) {
+        cluster_metadata_superblock_t *wsb = static_cast<cluster_metadata_superblock_t *>(superblock->get_data_write());
+        if (blocks_changed) {
+            write_blob(txn, wsb->namespace_blocks_blob, cluster_metadata_superblock_t::NAMESPACE_BLOCKS_BLOB_MAXREFLEN, namespace_blocks);
+        }
+        if (rest_changed) {
+            write_blob(txn, wsb->metadata_blob, cluster_metadata_superblock_t::METADATA_BLOB_MAXREFLEN, rest);
+        }
+        wsb->magic = namespace_records_magic;
+    }
+    last_written = metadata;
 }
 
 machine_id_t cluster_persistent_file_t::read_machine_id() {
@@ -412,12 +559,19 @@ void semilattice_watching_persister_t<metadata_t>::dump_loop(auto_drainer_t::loc
                 wait_any_t c(flush_again.get(), &stop);
                 wait_interruptible(&c, keepalive.get_drain_signal());
             }
-            if (flush_again->is_pulsed()) {
-                scoped_ptr_t<cond_t> tmp(new cond_t);
-                flush_again.swap(tmp);
-            } else {
+            if (!flush_again->is_pulsed()) {
                 break;
             }
+            {
+                /* Let a burst of changes finish, so that it gets written once,
+                unless we're stopping. */
+                signal_timer_t coalesce_timer;
+                coalesce_timer.start(METADATA_PERSIST_COALESCE_MS);
+                wait_any_t c(&coalesce_timer, &stop);
+                wait_interruptible(&c, keepalive.get_drain_signal());
+            }
+            scoped_ptr_t<cond_t> tmp(new cond_t);
+            flush_again.swap(tmp);
         }
     } catch (const interrupted_exc_t &) {
         // do nothing
@@ -2,6 +2,7 @@
 #ifndef CLUSTERING_ADMINISTRATION_PERSIST_HPP_
 #define CLUSTERING_ADMINISTRATION_PERSIST_HPP_
 
+#include <map>
 #include <string>
 
 #include "buffer_cache/mirrored/config.hpp"
@@ -86,8 +87,24 @@ public:
     branch_history_manager_t<rdb_protocol_t> *get_rdb_branch_history_manager();
 
 private:
+    // The blocks that every namespace's metadata is in, by protocol.
+    struct namespace_blocks_t {
+        std::map<namespace_id_t, block_id_t> dummy, memcached, rdb;
+        RDB_MAKE_ME_SERIALIZABLE_3(dummy, memcached, rdb);
+    };
+
     void construct_branch_history_managers(bool create);
 
+    /* Rewrites a file from version 1.11, which `read_metadata()` converted the
+    metadata of, in the current format. */
+    void convert_v1_11_file();
+
+    /* Writes the namespaces whose metadata isn't what it was in `last_written`
+    to their blocks, and the rest of the metadata to the superblock if that
+    changed. */
+    void write_metadata(transaction_t *txn, buf_lock_t *superblock,
+                        const cluster_semilattice_metadata_t &metadata);
+
     template <class protocol_t> class persistent_branch_history_manager_t;
 
     friend class persistent_branch_history_manager_t<mock::dummy_protocol_t>;
@@ -97,6 +114,9 @@ private:
     scoped_ptr_t<persistent_branch_history_manager_t<mock::dummy_protocol_t> > dummy_branch_history_manager;
     scoped_ptr_t<persistent_branch_history_manager_t<memcached_protocol_t> > memcached_branch_history_manager;
     scoped_ptr_t<persistent_branch_history_manager_t<rdb_protocol_t> > rdb_branch_history_manager;
+
+    namespace_blocks_t namespace_blocks;
+    cluster_semilattice_metadata_t last_written;
 };
 
 template <class metadata_t>
@@ -29,6 +29,9 @@ cJSON *render_as_json(blueprint_role_t *target) {
     case blueprint_role_nothing:
         return cJSON_CreateString("role_nothing");
         break;
+    case blueprint_role_async_secondary:
+        return cJSON_CreateString("role_async_secondary");
+        break;
     default:
         unreachable();
         break;
@@ -44,10 +47,12 @@ void apply_json_to(cJSON *change, blueprint_role_t *target) {
         *target = blueprint_role_secondary;
     } else if (val == "role_nothing" || val == "N") {
         *target = blueprint_role_nothing;
+    } else if (val == "role_async_secondary" || val == "A") {
+        *target = blueprint_role_async_secondary;
     } else {
         throw schema_mismatch_exc_t("Cannot set a blueprint_role_t object using %s."
                 "Acceptable values are: \"role_primary\", \"role_secondary\","
-                "\"role_nothing\".\n");
+                "\"role_nothing\", \"role_async_secondary\".\n");
     }
 }
 
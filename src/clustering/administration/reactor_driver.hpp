@@ -13,6 +13,7 @@
 #include "clustering/immediate_consistency/branch/history.hpp"
 #include "clustering/reactor/blueprint.hpp"
 #include "concurrency/watchable.hpp"
+#include "perfmon/core.hpp"
 #include "rpc/semilattice/view.hpp"
 #include "serializer/serializer.hpp"
 #include "serializer/translator.hpp"
@@ -41,21 +42,34 @@ public:
                 stores_[i].reset();
             }
         }
-        if (serializer_.has()) {
-            on_thread_t th(serializer_->home_thread());
-            serializer_.reset();
+        if (serializers_.has()) {
+            for (int i = 0, e = serializers_.size(); i < e; ++i) {
+                on_thread_t th(serializers_[i]->home_thread());
+                serializers_[i].reset();
+                if (serializer_perfmon_memberships_.has()) {
+                    serializer_perfmon_memberships_[i].reset();
+                }
+            }
             if (multiplexer_.has()) {
                 multiplexer_.reset();
             }
         }
     }
 
-    scoped_ptr_t<serializer_t> *serializer() { return &serializer_; }
+    // One serializer per device the table is striped over, see
+    // file_based_svs_by_namespace_t.
+    scoped_array_t<scoped_ptr_t<serializer_t> > *serializers() { return &serializers_; }
+    // The perfmon collections of the serializers that don't report their stats
+    // straight into the table's collection (the entries for the others are empty).
+    scoped_array_t<scoped_ptr_t<perfmon_membership_t> > *serializer_perfmon_memberships() {
+        return &serializer_perfmon_memberships_;
+    }
     scoped_ptr_t<serializer_multiplexer_t> *multiplexer() { return &multiplexer_; }
     scoped_array_t<scoped_ptr_t<typename protocol_t::store_t> > *stores() { return &stores_; }
 
 private:
-    scoped_ptr_t<serializer_t> serializer_;
+    scoped_array_t<scoped_ptr_t<serializer_t> > serializers_;
+    scoped_array_t<scoped_ptr_t<perfmon_membership_t> > serializer_perfmon_memberships_;
     scoped_ptr_t<serializer_multiplexer_t> multiplexer_;
     scoped_array_t<scoped_ptr_t<typename protocol_t::store_t> > stores_;
 
@@ -65,8 +79,10 @@ private:
 template <class protocol_t>
 class svs_by_namespace_t {
 public:
+    // `block_size` is the block size of the table's files, if they have to be
+    // created.
     virtual void get_svs(perfmon_collection_t *perfmon_collection, namespace_id_t namespace_id,
-                         int64_t cache_size,
+                         int64_t cache_size, int64_t block_size,
                          stores_lifetimer_t<protocol_t> *stores_out,
                          scoped_ptr_t<multistore_ptr_t<protocol_t> > *svs_out,
                          typename protocol_t::context_t *) = 0;
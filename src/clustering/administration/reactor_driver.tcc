@@ -115,6 +115,7 @@ public:
                             reactor_driver_t<protocol_t> *parent,
                             namespace_id_t namespace_id,
                             int64_t _cache_size,
+                            int64_t _block_size,
                             const blueprint_t<protocol_t> &bp,
                             svs_by_namespace_t<protocol_t> *svs_by_namespace,
                             typename protocol_t::context_t *_ctx) :
@@ -124,7 +125,8 @@ public:
         parent_(parent),
         namespace_id_(namespace_id),
         svs_by_namespace_(svs_by_namespace),
-        cache_size(_cache_size)
+        cache_size(_cache_size),
+        block_size(_block_size)
     {
         coro_t::spawn_sometime(boost::bind(&watchable_and_reactor_t<protocol_t>::initialize_reactor, this, io_backender));
     }
@@ -278,6 +280,18 @@ public:
         return compute_write_durability(peer, namespace_id_, parent_->ack_info->per_thread_ack_info());
     }
 
+    int64_t get_backfill_bytes_per_sec() const {
+        cow_ptr_t<namespaces_semilattice_metadata_t<protocol_t> > nmd =
+            parent_->ack_info->per_thread_ack_info()->get_namespaces_view();
+        typename namespaces_semilattice_metadata_t<protocol_t>::namespace_map_t::const_iterator it =
+            nmd->namespaces.find(namespace_id_);
+        if (it == nmd->namespaces.end() || it->second.is_deleted()
+            || it->second.get_ref().max_backfill_mb_per_sec.in_conflict()) {
+            return 0;
+        }
+        return std::max<int64_t>(it->second.get_ref().max_backfill_mb_per_sec.get(), 0) * MEGABYTE;
+    }
+
 private:
     std::map<peer_id_t, boost::optional<directory_echo_wrapper_t<cow_ptr_t<reactor_business_card_t<protocol_t> > > > > extract_reactor_directory(
             const std::map<peer_id_t, namespaces_directory_metadata_t<protocol_t> > &nss) {
@@ -307,7 +321,7 @@ private:
         perfmon_collection_t *serializers_collection = &perfmon_collections->serializers_collection;
 
         // TODO: We probably shouldn't have to pass in this perfmon collection.
-        svs_by_namespace_->get_svs(serializers_collection, namespace_id_, cache_size, &stores_lifetimer_, &svs_, ctx);
+        svs_by_namespace_->get_svs(serializers_collection, namespace_id_, cache_size, block_size, &stores_lifetimer_, &svs_, ctx);
 
         reactor_.init(new reactor_t<protocol_t>(
             base_path,
@@ -356,6 +370,7 @@ private:
 
     scoped_ptr_t<typename watchable_t<directory_echo_wrapper_t<cow_ptr_t<reactor_business_card_t<protocol_t> > > >::subscription_t> reactor_directory_subscription_;
     int64_t cache_size;
+    int64_t block_size;
 
     DISABLE_COPYING(watchable_and_reactor_t);
 };
@@ -471,8 +486,24 @@ void reactor_driver_t<protocol_t>::on_change() {
                                 it->second.get_ref().name.in_conflict() ? "Name in conflict" : it->second.get_ref().name.get().c_str());
                     }
 
+                    // The block size can't be fixed up like the cache size, a
+                    // bad one would make the serializer fail.
+                    int64_t block_size = DEFAULT_BTREE_BLOCK_SIZE;
+                    const vclock_t<int64_t> &block_size_vclock = it->second.get_ref().block_size;
+                    if (!block_size_vclock.in_conflict()) {
+                        block_size = block_size_vclock.get();
+                        if (block_size < MIN_BTREE_BLOCK_SIZE || block_size > MAX_BTREE_BLOCK_SIZE
+                            || (block_size & (block_size - 1)) != 0) {
+                            logINF("Namespace %s(%s) has an invalid block size. Using %" PRIi64 " bytes instead.\n",
+                                   uuid_to_str(it->first).c_str(),
+                                   it->second.get_ref().name.in_conflict() ? "Name in conflict" : it->second.get_ref().name.get().c_str(),
+                                   static_cast<int64_t>(DEFAULT_BTREE_BLOCK_SIZE));
+                            block_size = DEFAULT_BTREE_BLOCK_SIZE;
+                        }
+                    }
+
                     namespace_id_t tmp = it->first;
-                    reactor_data.insert(tmp, new watchable_and_reactor_t<protocol_t>(base_path, io_backender, this, it->first, cache_size, bp, svs_by_namespace, ctx));
+                    reactor_data.insert(tmp, new watchable_and_reactor_t<protocol_t>(base_path, io_backender, this, it->first, cache_size, block_size, bp, svs_by_namespace, ctx));
                 } else {
                     reactor_data.find(it->first)->second->watchable.set_value(bp);
                 }
@@ -9,6 +9,7 @@
 #include "stl_utils.hpp"
 
 stat_manager_t::stat_manager_t(mailbox_manager_t* mm) :
+    snapshot_time(0),
     mailbox_manager(mm),
     get_stats_mailbox(mailbox_manager, boost::bind(&stat_manager_t::on_stats_request, this, _1, _2))
     { }
@@ -23,7 +24,15 @@ void stat_manager_t::on_stats_request(const return_address_t& reply_address, con
 
 void stat_manager_t::perform_stats_request(const return_address_t& reply_address, const std::set<std::string>& requested_stats, auto_drainer_t::lock_t) {
     perfmon_filter_t request(requested_stats);
-    scoped_ptr_t<perfmon_result_t> perfmon_result(perfmon_get_stats());
+    scoped_ptr_t<perfmon_result_t> perfmon_result;
+    {
+        mutex_t::acq_t snapshot_acq(&snapshot_mutex);
+        if (!snapshot.has() || get_ticks() - snapshot_time > STAT_SNAPSHOT_MAX_AGE_MS * MILLION) {
+            snapshot = perfmon_get_stats();
+            snapshot_time = get_ticks();
+        }
+        perfmon_result.init(new perfmon_result_t(*snapshot));
+    }
     request.filter(&perfmon_result);
     guarantee(perfmon_result.has());
     send(mailbox_manager, reply_address, *perfmon_result);
@@ -6,8 +6,11 @@
 #include <map>
 #include <set>
 
+#include "concurrency/mutex.hpp"
+#include "containers/scoped.hpp"
 #include "perfmon/types.hpp"
 #include "rpc/mailbox/typed.hpp"
+#include "utils.hpp"
 
 class stat_manager_t {
 public:
@@ -24,6 +27,14 @@ private:
     void on_stats_request(const return_address_t& reply_address, const std::set<stat_id_t>& requested_stats);
     void perform_stats_request(const return_address_t& reply_address, const std::set<stat_id_t>& requested_stats, auto_drainer_t::lock_t);
 
+    /* Collecting the stats visits every perfmon on every thread, so requests share
+    a snapshot of them, which is only collected again once it's older than
+    STAT_SNAPSHOT_MAX_AGE_MS.  Requests that come in while a new snapshot is being
+    collected wait for it on `snapshot_mutex`. */
+    scoped_ptr_t<perfmon_result_t> snapshot;
+    ticks_t snapshot_time;
+    mutex_t snapshot_mutex;
+
     mailbox_manager_t *mailbox_manager;
     get_stats_mailbox_t get_stats_mailbox;
 
@@ -10,6 +10,7 @@ persistable_blueprint_t<protocol_t> suggest_blueprint_for_namespace(
         const std::map<peer_id_t, boost::optional<directory_echo_wrapper_t<cow_ptr_t<reactor_business_card_t<protocol_t> > > > > &reactor_directory_view,
         const std::map<peer_id_t, machine_id_t> &machine_id_translation_table,
         const std::map<machine_id_t, datacenter_id_t> &machine_data_centers,
+        const std::map<machine_id_t, double> &machine_loads,
         std::map<machine_id_t, int> *usage,
         bool prioritize_distribution)
         THROWS_ONLY(cannot_satisfy_goals_exc_t, in_conflict_exc_t, missing_machine_exc_t) {
@@ -46,7 +47,7 @@ persistable_blueprint_t<protocol_t> suggest_blueprint_for_namespace(
 
     return suggest_blueprint(directory, primary_datacenter,
         datacenter_affinities, shards, machine_data_centers,
-        primary_pinnings, secondary_pinnings, usage, prioritize_distribution);
+        primary_pinnings, secondary_pinnings, machine_loads, usage, prioritize_distribution);
 }
 
 template<class protocol_t>
@@ -55,6 +56,7 @@ std::map<namespace_id_t, persistable_blueprint_t<protocol_t> > suggest_blueprint
         const std::map<peer_id_t, namespaces_directory_metadata_t<protocol_t> > &namespaces_directory,
         const std::map<peer_id_t, machine_id_t> &machine_id_translation_table,
         const std::map<machine_id_t, datacenter_id_t> &machine_data_centers,
+        const std::map<machine_id_t, double> &machine_loads,
         bool prioritize_distribution)
         THROWS_ONLY(missing_machine_exc_t)
 {
@@ -108,6 +110,7 @@ std::map<namespace_id_t, persistable_blueprint_t<protocol_t> > suggest_blueprint
                         reactor_directory,
                         machine_id_translation_table,
                         machine_data_centers,
+                        machine_loads,
                         &usage,
                         prioritize_distribution)));
         } catch (const cannot_satisfy_goals_exc_t &e) {
@@ -126,12 +129,13 @@ void fill_in_blueprints_for_protocol(
         const std::map<peer_id_t, machine_id_t> &machine_id_translation_table,
         const std::map<machine_id_t, datacenter_id_t> &machine_data_centers,
         const machine_id_t &us,
+        const std::map<machine_id_t, double> &machine_loads,
         bool prioritize_distribution)
         THROWS_ONLY(missing_machine_exc_t)
 {
     typedef std::map<namespace_id_t, persistable_blueprint_t<protocol_t> > blueprint_map_t;
     blueprint_map_t suggested_blueprints =
-        suggest_blueprints_for_protocol(*ns_goals, namespaces_directory, machine_id_translation_table, machine_data_centers, prioritize_distribution);
+        suggest_blueprints_for_protocol(*ns_goals, namespaces_directory, machine_id_translation_table, machine_data_centers, machine_loads, prioritize_distribution);
 
     for (typename blueprint_map_t::iterator it  = suggested_blueprints.begin();
                                             it != suggested_blueprints.end();
@@ -145,6 +149,15 @@ void fill_in_blueprints(cluster_semilattice_metadata_t *cluster_metadata,
                         const std::map<peer_id_t, cluster_directory_metadata_t> &directory,
                         const uuid_u &us,
                         bool prioritize_distribution) {
+    fill_in_blueprints(cluster_metadata, directory, us,
+                       std::map<machine_id_t, double>(), prioritize_distribution);
+}
+
+void fill_in_blueprints(cluster_semilattice_metadata_t *cluster_metadata,
+                        const std::map<peer_id_t, cluster_directory_metadata_t> &directory,
+                        const uuid_u &us,
+                        const std::map<machine_id_t, double> &machine_loads,
+                        bool prioritize_distribution) {
     std::map<machine_id_t, datacenter_id_t> machine_assignments;
 
     for (std::map<machine_id_t, deletable_t<machine_semilattice_metadata_t> >::iterator it = cluster_metadata->machines.machines.begin();
@@ -177,6 +190,7 @@ void fill_in_blueprints(cluster_semilattice_metadata_t *cluster_metadata,
                 machine_id_translation_table,
                 machine_assignments,
                 us,
+                machine_loads,
                 prioritize_distribution);
     }
 
@@ -187,6 +201,7 @@ void fill_in_blueprints(cluster_semilattice_metadata_t *cluster_metadata,
                 machine_id_translation_table,
                 machine_assignments,
                 us,
+                machine_loads,
                 prioritize_distribution);
     }
 }
@@ -200,6 +215,7 @@ persistable_blueprint_t<mock::dummy_protocol_t> suggest_blueprint_for_namespace<
         const std::map<peer_id_t, boost::optional<directory_echo_wrapper_t<cow_ptr_t<reactor_business_card_t<mock::dummy_protocol_t> > > > > &reactor_directory_view,
         const std::map<peer_id_t, machine_id_t> &machine_id_translation_table,
         const std::map<machine_id_t, datacenter_id_t> &machine_data_centers,
+        const std::map<machine_id_t, double> &machine_loads,
         std::map<machine_id_t, int> *usage,
         bool prioritize_distribution)
         THROWS_ONLY(cannot_satisfy_goals_exc_t, in_conflict_exc_t, missing_machine_exc_t);
@@ -210,6 +226,7 @@ std::map<namespace_id_t, persistable_blueprint_t<mock::dummy_protocol_t> > sugge
         const std::map<peer_id_t, namespaces_directory_metadata_t<mock::dummy_protocol_t> > &reactor_directory_view,
         const std::map<peer_id_t, machine_id_t> &machine_id_translation_table,
         const std::map<machine_id_t, datacenter_id_t> &machine_data_centers,
+        const std::map<machine_id_t, double> &machine_loads,
         bool prioritize_distribution)
         THROWS_ONLY(missing_machine_exc_t);
 
@@ -220,6 +237,7 @@ void fill_in_blueprints_for_protocol<mock::dummy_protocol_t>(
         const std::map<peer_id_t, machine_id_t> &machine_id_translation_table,
         const std::map<machine_id_t, datacenter_id_t> &machine_data_centers,
         const machine_id_t &us,
+        const std::map<machine_id_t, double> &machine_loads,
         bool prioritize_disribution)
         THROWS_ONLY(missing_machine_exc_t);
 
@@ -232,6 +250,7 @@ persistable_blueprint_t<memcached_protocol_t> suggest_blueprint_for_namespace<me
         const std::map<peer_id_t, boost::optional<directory_echo_wrapper_t<cow_ptr_t<reactor_business_card_t<memcached_protocol_t> > > > > &reactor_directory_view,
         const std::map<peer_id_t, machine_id_t> &machine_id_translation_table,
         const std::map<machine_id_t, datacenter_id_t> &machine_data_centers,
+        const std::map<machine_id_t, double> &machine_loads,
         std::map<machine_id_t, int> *usage,
         bool prioritize_distribution)
         THROWS_ONLY(cannot_satisfy_goals_exc_t, in_conflict_exc_t, missing_machine_exc_t);
@@ -242,6 +261,7 @@ std::map<namespace_id_t, persistable_blueprint_t<memcached_protocol_t> > suggest
         const std::map<peer_id_t, namespaces_directory_metadata_t<memcached_protocol_t> > &reactor_directory_view,
         const std::map<peer_id_t, machine_id_t> &machine_id_translation_table,
         const std::map<machine_id_t, datacenter_id_t> &machine_data_centers,
+        const std::map<machine_id_t, double> &machine_loads,
         bool prioritize_distribution)
         THROWS_ONLY(missing_machine_exc_t);
 
@@ -252,6 +272,7 @@ void fill_in_blueprints_for_protocol<memcached_protocol_t>(
         const std::map<peer_id_t, machine_id_t> &machine_id_translation_table,
         const std::map<machine_id_t, datacenter_id_t> &machine_data_centers,
         const machine_id_t &us,
+        const std::map<machine_id_t, double> &machine_loads,
         bool prioritize_disribution)
         THROWS_ONLY(missing_machine_exc_t);
 
@@ -263,6 +284,7 @@ persistable_blueprint_t<rdb_protocol_t> suggest_blueprint_for_namespace<rdb_prot
         const std::map<peer_id_t, boost::optional<directory_echo_wrapper_t<cow_ptr_t<reactor_business_card_t<rdb_protocol_t> > > > > &reactor_directory_view,
         const std::map<peer_id_t, machine_id_t> &machine_id_translation_table,
         const std::map<machine_id_t, datacenter_id_t> &machine_data_centers,
+        const std::map<machine_id_t, double> &machine_loads,
         std::map<machine_id_t, int> *usage,
         bool prioritize_distribution)
         THROWS_ONLY(cannot_satisfy_goals_exc_t, in_conflict_exc_t, missing_machine_exc_t);
@@ -273,6 +295,7 @@ std::map<namespace_id_t, persistable_blueprint_t<rdb_protocol_t> > suggest_bluep
         const std::map<peer_id_t, namespaces_directory_metadata_t<rdb_protocol_t> > &reactor_directory_view,
         const std::map<peer_id_t, machine_id_t> &machine_id_translation_table,
         const std::map<machine_id_t, datacenter_id_t> &machine_data_centers,
+        const std::map<machine_id_t, double> &machine_loads,
         bool prioritize_distribution)
         THROWS_ONLY(missing_machine_exc_t);
 
@@ -283,5 +306,6 @@ void fill_in_blueprints_for_protocol<rdb_protocol_t>(
         const std::map<peer_id_t, machine_id_t> &machine_id_translation_table,
         const std::map<machine_id_t, datacenter_id_t> &machine_data_centers,
         const machine_id_t &us,
+        const std::map<machine_id_t, double> &machine_loads,
         bool prioritize_disribution)
         THROWS_ONLY(missing_machine_exc_t);
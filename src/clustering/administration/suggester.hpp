@@ -28,6 +28,7 @@ std::map<namespace_id_t, persistable_blueprint_t<protocol_t> > suggest_blueprint
         const std::map<peer_id_t, namespaces_directory_metadata_t<protocol_t> > &reactor_directory_view,
         const std::map<peer_id_t, machine_id_t> &machine_id_translation_table,
         const std::map<machine_id_t, datacenter_id_t> &machine_data_centers,
+        const std::map<machine_id_t, double> &machine_loads,
         bool prioritize_disribution)
         THROWS_ONLY(missing_machine_exc_t);
 
@@ -38,6 +39,7 @@ void fill_in_blueprints_for_protocol(
         const std::map<peer_id_t, machine_id_t> &machine_id_translation_table,
         const std::map<machine_id_t, datacenter_id_t> &machine_data_centers,
         const machine_id_t &us,
+        const std::map<machine_id_t, double> &machine_loads,
         bool prioritize_disribution)
         THROWS_ONLY(missing_machine_exc_t);
 
@@ -46,4 +48,12 @@ void fill_in_blueprints(cluster_semilattice_metadata_t *cluster_metadata,
                         const uuid_u &us,
                         bool prioritize_disribution);
 
+/* Like the above, but also steers new roles away from busy machines.
+`machine_loads` is as for `suggest_blueprint()`. */
+void fill_in_blueprints(cluster_semilattice_metadata_t *cluster_metadata,
+                        const std::map<peer_id_t, cluster_directory_metadata_t> &directory,
+                        const uuid_u &us,
+                        const std::map<machine_id_t, double> &machine_loads,
+                        bool prioritize_disribution);
+
 #endif /* CLUSTERING_ADMINISTRATION_SUGGESTER_HPP_ */
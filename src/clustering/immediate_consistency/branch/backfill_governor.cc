@@ -0,0 +1,79 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "clustering/immediate_consistency/branch/backfill_governor.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "arch/timing.hpp"
+#include "clustering/immediate_consistency/query/master.hpp"
+#include "config/args.hpp"
+
+backfill_governor_t::backfill_governor_t(ack_checker_t *_ack_checker) :
+    ack_checker(_ack_checker),
+    share(1.0),
+    foreground_latency(0),
+    foreground_count(0),
+    last_update(0),
+    bytes_per_sec(0),
+    tokens(0),
+    last_refill(get_ticks()) {
+    update(get_ticks());
+}
+
+void backfill_governor_t::note_foreground_latency(ticks_t latency) {
+    assert_thread();
+    if (foreground_count == 0 && foreground_latency == 0) {
+        foreground_latency = latency;
+    } else {
+        foreground_latency += BACKFILL_GOVERNOR_LATENCY_SMOOTHING * (latency - foreground_latency);
+    }
+    ++foreground_count;
+}
+
+double backfill_governor_t::get_share() {
+    assert_thread();
+    update(get_ticks());
+    return share;
+}
+
+bool backfill_governor_t::is_rate_limited() {
+    assert_thread();
+    update(get_ticks());
+    return bytes_per_sec > 0;
+}
+
+void backfill_governor_t::consume(int64_t bytes, signal_t *interruptor)
+        THROWS_ONLY(interrupted_exc_t) {
+    assert_thread();
+    const ticks_t now = get_ticks();
+    update(now);
+    if (bytes_per_sec <= 0) {
+        return;
+    }
+    tokens = std::min(tokens + ticks_to_secs(now - last_refill) * bytes_per_sec,
+                      static_cast<double>(bytes_per_sec));
+    last_refill = now;
+    tokens -= bytes;
+    if (tokens < 0) {
+        /* The deficit is paid off by the time we wait, see the refill above. */
+        nap(static_cast<int64_t>(ceil(-tokens * THOUSAND / bytes_per_sec)), interruptor);
+    }
+}
+
+void backfill_governor_t::update(ticks_t now) {
+    if (now - last_update < static_cast<ticks_t>(BACKFILL_GOVERNOR_INTERVAL_MS) * MILLION) {
+        return;
+    }
+    /* Without foreground operations in the last interval there is nothing to be
+    slowed down, whatever the average says. */
+    if (foreground_count > 0
+        && foreground_latency > static_cast<double>(BACKFILL_TARGET_FOREGROUND_LATENCY_MS) * MILLION) {
+        share = std::max(share / 2, BACKFILL_GOVERNOR_MIN_SHARE);
+    } else {
+        share = std::min(share + BACKFILL_GOVERNOR_SHARE_STEP, 1.0);
+    }
+    foreground_count = 0;
+    last_update = now;
+
+    bytes_per_sec = ack_checker != NULL ? ack_checker->get_backfill_bytes_per_sec() : 0;
+}
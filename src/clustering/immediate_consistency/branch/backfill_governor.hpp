@@ -0,0 +1,58 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#ifndef CLUSTERING_IMMEDIATE_CONSISTENCY_BRANCH_BACKFILL_GOVERNOR_HPP_
+#define CLUSTERING_IMMEDIATE_CONSISTENCY_BRANCH_BACKFILL_GOVERNOR_HPP_
+
+#include "utils.hpp"
+
+class ack_checker_t;
+class signal_t;
+
+/* A `backfill_governor_t` keeps the backfills of one role of a reactor from
+crowding out the reads and writes it serves.  The `listener_t` reports how long
+each of its reads and writes takes; `backfiller_t` and `backfillee()` ask how much
+of their full concurrency they may use (see `BACKFILL_GOVERNOR_INTERVAL_MS` for
+how that adapts), and the backfiller also keeps the chunks it sends below the
+table's "max_backfill_mb_per_sec".
+
+Backfills that are passed no governor (NULL) run at full speed. */
+class backfill_governor_t : public home_thread_mixin_debug_only_t {
+public:
+    /* `ack_checker` says what the table's backfill rate limit is.  It may be
+    NULL, for no limit. */
+    explicit backfill_governor_t(ack_checker_t *ack_checker);
+
+    void note_foreground_latency(ticks_t latency);
+
+    /* The fraction of their full concurrency that backfills may use right now,
+    between `BACKFILL_GOVERNOR_MIN_SHARE` and 1. */
+    double get_share();
+
+    /* Whether `consume()` can block at all, so callers that would have to
+    measure their chunks first can skip that. */
+    bool is_rate_limited();
+
+    /* Called before `bytes` of backfill chunks are sent; blocks for as long as
+    sending them would exceed the table's rate limit. */
+    void consume(int64_t bytes, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t);
+
+private:
+    void update(ticks_t now);
+
+    ack_checker_t *const ack_checker;
+
+    double share;
+    /* The moving average of the foreground latency in ticks, and how many
+    foreground operations finished since the last update. */
+    double foreground_latency;
+    int foreground_count;
+    ticks_t last_update;
+
+    /* A token bucket that holds up to a second's worth of bytes. */
+    int64_t bytes_per_sec;
+    double tokens;
+    ticks_t last_refill;
+
+    DISABLE_COPYING(backfill_governor_t);
+};
+
+#endif  // CLUSTERING_IMMEDIATE_CONSISTENCY_BRANCH_BACKFILL_GOVERNOR_HPP_
@@ -1,6 +1,9 @@
 // Copyright 2010-2012 RethinkDB, all rights reserved.
 #include "clustering/immediate_consistency/branch/backfillee.hpp"
 
+#include <algorithm>
+
+#include "clustering/immediate_consistency/branch/backfill_governor.hpp"
 #include "clustering/immediate_consistency/branch/history.hpp"
 #include "concurrency/coro_pool.hpp"
 #include "concurrency/cross_thread_signal.hpp"
@@ -11,6 +14,9 @@
 
 #define ALLOCATION_CHUNK 50
 
+/* How many backfill chunks are applied at once, at most. */
+#define CHUNK_WORKERS 10
+
 template <class protocol_t>
 struct backfill_queue_entry_t {
     // TODO: The fact that fifo_enforcer_queue_t requires a default
@@ -18,25 +24,31 @@ struct backfill_queue_entry_t {
     backfill_queue_entry_t() { }
     backfill_queue_entry_t(bool _is_not_last_backfill_chunk,
                            const typename protocol_t::backfill_chunk_t &_chunk,
+                           const typename protocol_t::region_t &_done_region,
                            fifo_enforcer_write_token_t _write_token)
         : is_not_last_backfill_chunk(_is_not_last_backfill_chunk),
           chunk(_chunk),
+          done_region(_done_region),
           write_token(_write_token) { }
 
     bool is_not_last_backfill_chunk;
     typename protocol_t::backfill_chunk_t chunk;
+    /* For the entries that aren't chunks: which part of the region the
+    backfiller has sent entirely. */
+    typename protocol_t::region_t done_region;
     fifo_enforcer_write_token_t write_token;
 };
 
 template <class protocol_t>
 void push_chunk_on_queue(fifo_enforcer_queue_t<backfill_queue_entry_t<protocol_t> > *queue,
                          typename protocol_t::backfill_chunk_t chunk, fifo_enforcer_write_token_t token) {
-    queue->push(token, backfill_queue_entry_t<protocol_t>(true, chunk, token));
+    queue->push(token, backfill_queue_entry_t<protocol_t>(true, chunk, typename protocol_t::region_t(), token));
 }
 
 template <class protocol_t>
-void push_finish_on_queue(fifo_enforcer_queue_t<backfill_queue_entry_t<protocol_t> > *queue, fifo_enforcer_write_token_t token) {
-    queue->push(token, backfill_queue_entry_t<protocol_t>(false, typename protocol_t::backfill_chunk_t(), token));
+void push_finish_on_queue(fifo_enforcer_queue_t<backfill_queue_entry_t<protocol_t> > *queue,
+                          typename protocol_t::region_t done_region, fifo_enforcer_write_token_t token) {
+    queue->push(token, backfill_queue_entry_t<protocol_t>(false, typename protocol_t::backfill_chunk_t(), done_region, token));
 }
 
 
@@ -47,10 +59,15 @@ class chunk_callback_t : public coro_pool_callback_t<backfill_queue_entry_t<prot
                          public home_thread_mixin_debug_only_t {
 public:
     chunk_callback_t(store_view_t<protocol_t> *_svs,
+                     const typename protocol_t::region_t &_region,
+                     const region_map_t<protocol_t, version_range_t> *_end_point,
                      fifo_enforcer_queue_t<backfill_queue_entry_t<protocol_t> > *_chunk_queue, mailbox_manager_t *_mbox_manager,
-                     mailbox_addr_t<void(int)> _allocation_mailbox) :
-        svs(_svs), chunk_queue(_chunk_queue), mbox_manager(_mbox_manager),
-        allocation_mailbox(_allocation_mailbox), unacked_chunks(0),
+                     mailbox_addr_t<void(int)> _allocation_mailbox,
+                     backfill_governor_t *_governor) :
+        svs(_svs), region(_region), end_point(_end_point),
+        chunk_queue(_chunk_queue), mbox_manager(_mbox_manager),
+        allocation_mailbox(_allocation_mailbox), governor(_governor),
+        apply_limiter(CHUNK_WORKERS), unacked_chunks(0),
         done_message_arrived(false), num_outstanding_chunks(0)
     { }
 
@@ -63,6 +80,26 @@ public:
         svs->receive_backfill(chunk, &token_pair, interruptor);
     }
 
+    /* Records in the metainfo that `done_region` has reached the end point
+    already, so that if this backfill fails, the next one doesn't have to send
+    it again. The write token orders this after every chunk before it. */
+    void apply_checkpoint(fifo_enforcer_write_token_t chunk_token, const typename protocol_t::region_t &done_region, signal_t *interruptor) {
+        object_buffer_t<fifo_enforcer_sink_t::exit_write_t> write_token;
+        svs->new_write_token(&write_token);
+        chunk_queue->finish_write(chunk_token);
+
+        typename protocol_t::region_t ixn = region_intersection(region, done_region);
+        if (region_is_empty(ixn)) {
+            return;
+        }
+        svs->set_metainfo(
+            region_map_transform<protocol_t, version_range_t, binary_blob_t>(end_point->mask(ixn),
+                                                                             &binary_blob_t::make<version_range_t>),
+            order_token_t::ignore,
+            &write_token,
+            interruptor);
+    }
+
     void coro_pool_callback(backfill_queue_entry_t<protocol_t> chunk, signal_t *interruptor) {
         assert_thread();
         try {
@@ -77,8 +114,18 @@ public:
                    superblock in the correct order. */
                 num_outstanding_chunks++;
 
-                // We acquire the write token in apply_backfill_chunk.
-                apply_backfill_chunk(chunk.write_token, chunk.chunk, interruptor);
+                if (governor != NULL) {
+                    apply_limiter.set_capacity(
+                        std::max(1, static_cast<int>(CHUNK_WORKERS * governor->get_share())));
+                }
+
+                {
+                    /* Chunks wait here in queue order, so their write tokens
+                    are still acquired in order. */
+                    semaphore_acq_t apply_acq(&apply_limiter);
+                    // We acquire the write token in apply_backfill_chunk.
+                    apply_backfill_chunk(chunk.write_token, chunk.chunk, interruptor);
+                }
 
                 /* Allow the backfiller to send us more data */
                 int chunks_to_send_out = 0;
@@ -100,6 +147,12 @@ public:
 
                 num_outstanding_chunks--;
 
+            } else if (chunk.done_region != region) {
+                /* A part of the region is done, but not all of it */
+                num_outstanding_chunks++;
+                apply_checkpoint(chunk.write_token, chunk.done_region, interruptor);
+                num_outstanding_chunks--;
+
             } else {
                 /* This is a fake backfill "chunk" that just indicates
                    that the backfill is over */
@@ -125,9 +178,13 @@ public:
 
 private:
     store_view_t<protocol_t> *svs;
+    const typename protocol_t::region_t region;
+    const region_map_t<protocol_t, version_range_t> *end_point;
     fifo_enforcer_queue_t<backfill_queue_entry_t<protocol_t> > *chunk_queue;
     mailbox_manager_t *mbox_manager;
     mailbox_addr_t<void(int)> allocation_mailbox;
+    backfill_governor_t *governor;
+    adjustable_semaphore_t apply_limiter;
     int unacked_chunks;
     bool done_message_arrived;
     int num_outstanding_chunks;
@@ -150,6 +207,7 @@ void backfillee(
         typename protocol_t::region_t region,
         clone_ptr_t<watchable_t<boost::optional<boost::optional<backfiller_business_card_t<protocol_t> > > > > backfiller_metadata,
         backfill_session_id_t backfill_session_id,
+        backfill_governor_t *governor,
         signal_t *interruptor)
         THROWS_ONLY(interrupted_exc_t, resource_lost_exc_t)
 {
@@ -192,11 +250,13 @@ void backfillee(
 
         fifo_enforcer_queue_t<backfill_queue_entry_t<protocol_t> > chunk_queue;
 
-        /* The backfiller will notify `done_mailbox` when the backfill is all over
-        and the version described in `end_point_mailbox` has been achieved. */
-        mailbox_t<void(fifo_enforcer_write_token_t)> done_mailbox(
+        /* The backfiller will notify `done_mailbox` of each part of the region
+        that it has sent entirely, and of the whole region when the backfill is
+        all over and the version described in `end_point_mailbox` has been
+        achieved. */
+        mailbox_t<void(typename protocol_t::region_t, fifo_enforcer_write_token_t)> done_mailbox(
             mailbox_manager,
-            boost::bind(&push_finish_on_queue<protocol_t>, &chunk_queue, _1));
+            boost::bind(&push_finish_on_queue<protocol_t>, &chunk_queue, _1, _2));
 
         /* The backfiller will send individual chunks of the backfill to
         `chunk_mailbox`. */
@@ -317,9 +377,9 @@ void backfillee(
             &write_token,
             interruptor);
 
-        chunk_callback_t<protocol_t> chunk_callback(svs, &chunk_queue, mailbox_manager, allocation_mailbox);
+        chunk_callback_t<protocol_t> chunk_callback(svs, region, &end_point, &chunk_queue, mailbox_manager, allocation_mailbox, governor);
 
-        coro_pool_t<backfill_queue_entry_t<protocol_t> > backfill_workers(10, &chunk_queue, &chunk_callback);
+        coro_pool_t<backfill_queue_entry_t<protocol_t> > backfill_workers(CHUNK_WORKERS, &chunk_queue, &chunk_callback);
 
         /* Now wait for the backfill to be over */
         {
@@ -360,6 +420,7 @@ template void backfillee<mock::dummy_protocol_t>(
         mock::dummy_protocol_t::region_t region,
         clone_ptr_t<watchable_t<boost::optional<boost::optional<backfiller_business_card_t<mock::dummy_protocol_t> > > > > backfiller_metadata,
         backfill_session_id_t backfill_session_id,
+        backfill_governor_t *governor,
         signal_t *interruptor)
     THROWS_ONLY(interrupted_exc_t, resource_lost_exc_t);
 
@@ -370,6 +431,7 @@ template void backfillee<memcached_protocol_t>(
         memcached_protocol_t::region_t region,
         clone_ptr_t<watchable_t<boost::optional<boost::optional<backfiller_business_card_t<memcached_protocol_t> > > > > backfiller_metadata,
         backfill_session_id_t backfill_session_id,
+        backfill_governor_t *governor,
         signal_t *interruptor)
     THROWS_ONLY(interrupted_exc_t, resource_lost_exc_t);
 
@@ -380,5 +442,6 @@ template void backfillee<rdb_protocol_t>(
         rdb_protocol_t::region_t region,
         clone_ptr_t<watchable_t<boost::optional<boost::optional<backfiller_business_card_t<rdb_protocol_t> > > > > backfiller_metadata,
         backfill_session_id_t backfill_session_id,
+        backfill_governor_t *governor,
         signal_t *interruptor)
     THROWS_ONLY(interrupted_exc_t, resource_lost_exc_t);
@@ -7,6 +7,7 @@
 #include "clustering/generic/resource.hpp"
 #include "rpc/semilattice/view.hpp"
 
+class backfill_governor_t;
 template <class> class clone_ptr_t;
 template <class> class watchable_t;
 
@@ -33,6 +34,9 @@ void backfillee(
         backfill for progress-checking purposes. */
         backfill_session_id_t backfill_session_id,
 
+        /* Paces how many chunks are applied at once.  May be NULL. */
+        backfill_governor_t *governor,
+
         signal_t *interruptor)
     THROWS_ONLY(interrupted_exc_t, resource_lost_exc_t);
 
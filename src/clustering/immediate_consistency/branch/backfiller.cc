@@ -2,6 +2,7 @@
 #include "clustering/immediate_consistency/branch/backfiller.hpp"
 
 #include "btree/parallel_traversal.hpp"
+#include "clustering/immediate_consistency/branch/backfill_governor.hpp"
 #include "clustering/immediate_consistency/branch/history.hpp"
 #include "concurrency/fifo_enforcer.hpp"
 #include "concurrency/semaphore.hpp"
@@ -9,6 +10,9 @@
 #include "stl_utils.hpp"
 
 #define MAX_CHUNKS_OUT 5000
+/* The fewest chunks a governed backfill may have out.  This must stay above the
+`ALLOCATION_CHUNK` in which backfillees hand chunks back, or it would stall. */
+#define MIN_CHUNKS_OUT 100
 
 inline state_timestamp_t get_earliest_timestamp_of_version_range(const version_range_t &vr) {
     return vr.earliest.timestamp;
@@ -17,9 +21,10 @@ inline state_timestamp_t get_earliest_timestamp_of_version_range(const version_r
 template <class protocol_t>
 backfiller_t<protocol_t>::backfiller_t(mailbox_manager_t *mm,
                                        branch_history_manager_t<protocol_t> *bhm,
-                                       store_view_t<protocol_t> *_svs)
+                                       store_view_t<protocol_t> *_svs,
+                                       backfill_governor_t *_governor)
     : mailbox_manager(mm), branch_history_manager(bhm),
-      svs(_svs),
+      svs(_svs), governor(_governor),
       backfill_mailbox(mailbox_manager,
                        boost::bind(&backfiller_t::on_backfill, this, _1, _2, _3, _4, _5, _6, _7, auto_drainer_t::lock_t(&drainer))),
       cancel_backfill_mailbox(mailbox_manager,
@@ -90,8 +95,18 @@ void do_send_chunk(mailbox_manager_t *mbox_manager,
                    mailbox_addr_t<void(typename protocol_t::backfill_chunk_t, fifo_enforcer_write_token_t)> chunk_addr,
                    const typename protocol_t::backfill_chunk_t &chunk,
                    fifo_enforcer_source_t *fifo_src,
-                   semaphore_t *chunk_semaphore,
+                   adjustable_semaphore_t *chunk_semaphore,
+                   backfill_governor_t *governor,
                    signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) {
+    if (governor != NULL) {
+        chunk_semaphore->set_capacity(
+            std::max(MIN_CHUNKS_OUT, static_cast<int>(MAX_CHUNKS_OUT * governor->get_share())));
+        if (governor->is_rate_limited()) {
+            write_message_t msg;
+            msg << chunk;
+            governor->consume(msg.size(), interruptor);
+        }
+    }
     chunk_semaphore->co_lock_interruptible(interruptor);
     send(mbox_manager, chunk_addr, chunk, fifo_src->enter_write());
 }
@@ -103,13 +118,15 @@ public:
                                         mailbox_addr_t<void(region_map_t<protocol_t, version_range_t>, branch_history_t<protocol_t>)> end_point_cont,
                                         mailbox_manager_t *mailbox_manager,
                                         mailbox_addr_t<void(typename protocol_t::backfill_chunk_t, fifo_enforcer_write_token_t)> chunk_cont,
+                                        mailbox_addr_t<void(typename protocol_t::region_t, fifo_enforcer_write_token_t)> done_cont,
                                         fifo_enforcer_source_t *fifo_src,
-                                        semaphore_t *chunk_semaphore,
+                                        adjustable_semaphore_t *chunk_semaphore,
                                         backfiller_t<protocol_t> *backfiller)
         : start_point_(start_point),
           end_point_cont_(end_point_cont),
           mailbox_manager_(mailbox_manager),
           chunk_cont_(chunk_cont),
+          done_cont_(done_cont),
           fifo_src_(fifo_src),
           chunk_semaphore_(chunk_semaphore),
           backfiller_(backfiller) { }
@@ -119,15 +136,24 @@ public:
     }
 
     void send_chunk(const typename protocol_t::backfill_chunk_t &chunk, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) {
-        do_send_chunk<protocol_t>(mailbox_manager_, chunk_cont_, chunk, fifo_src_, chunk_semaphore_, interruptor);
+        do_send_chunk<protocol_t>(mailbox_manager_, chunk_cont_, chunk, fifo_src_, chunk_semaphore_,
+                                  backfiller_->governor, interruptor);
+    }
+
+    void send_checkpoint(const typename protocol_t::region_t &region, UNUSED signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) {
+        /* The whole region is confirmed once `send_backfill()` returns. */
+        if (!region_is_empty(region) && region != start_point_->get_domain()) {
+            send(mailbox_manager_, done_cont_, region, fifo_src_->enter_write());
+        }
     }
 private:
     const region_map_t<protocol_t, version_range_t> *start_point_;
     mailbox_addr_t<void(region_map_t<protocol_t, version_range_t>, branch_history_t<protocol_t>)> end_point_cont_;
     mailbox_manager_t *mailbox_manager_;
     mailbox_addr_t<void(typename protocol_t::backfill_chunk_t, fifo_enforcer_write_token_t)> chunk_cont_;
+    mailbox_addr_t<void(typename protocol_t::region_t, fifo_enforcer_write_token_t)> done_cont_;
     fifo_enforcer_source_t *fifo_src_;
-    semaphore_t *chunk_semaphore_;
+    adjustable_semaphore_t *chunk_semaphore_;
     backfiller_t<protocol_t> *backfiller_;
 
     DISABLE_COPYING(backfiller_send_backfill_callback_t);
@@ -139,7 +165,7 @@ void backfiller_t<protocol_t>::on_backfill(backfill_session_id_t session_id,
                                            const branch_history_t<protocol_t> &start_point_associated_branch_history,
                                            mailbox_addr_t<void(region_map_t<protocol_t, version_range_t>, branch_history_t<protocol_t>)> end_point_cont,
                                            mailbox_addr_t<void(typename protocol_t::backfill_chunk_t, fifo_enforcer_write_token_t)> chunk_cont,
-                                           mailbox_addr_t<void(fifo_enforcer_write_token_t)> done_cont,
+                                           mailbox_addr_t<void(typename protocol_t::region_t, fifo_enforcer_write_token_t)> done_cont,
                                            mailbox_addr_t<void(mailbox_addr_t<void(int)>)> allocation_registration_box,
                                            auto_drainer_t::lock_t keepalive) {
 
@@ -160,7 +186,7 @@ void backfiller_t<protocol_t>::on_backfill(backfill_session_id_t session_id,
        wait on that cond yet. */
     wait_any_t interrupted(&local_interruptor, keepalive.get_drain_signal());
 
-    static_semaphore_t chunk_semaphore(MAX_CHUNKS_OUT);
+    adjustable_semaphore_t chunk_semaphore(MAX_CHUNKS_OUT);
     mailbox_t<void(int)> receive_allocations_mbox(mailbox_manager, boost::bind(&semaphore_t::unlock, &chunk_semaphore, _1));
     send(mailbox_manager, allocation_registration_box, receive_allocations_mbox.get_address());
 
@@ -177,7 +203,7 @@ void backfiller_t<protocol_t>::on_backfill(backfill_session_id_t session_id,
         svs->new_read_token_pair(&send_backfill_token_pair);
 
         backfiller_send_backfill_callback_t<protocol_t>
-            send_backfill_cb(&start_point, end_point_cont, mailbox_manager, chunk_cont, &fifo_src, &chunk_semaphore, this);
+            send_backfill_cb(&start_point, end_point_cont, mailbox_manager, chunk_cont, done_cont, &fifo_src, &chunk_semaphore, this);
 
         /* Actually perform the backfill */
         svs->send_backfill(
@@ -191,7 +217,7 @@ void backfiller_t<protocol_t>::on_backfill(backfill_session_id_t session_id,
                      &interrupted);
 
         /* Send a confirmation */
-        send(mailbox_manager, done_cont, fifo_src.enter_write());
+        send(mailbox_manager, done_cont, start_point.get_domain(), fifo_src.enter_write());
 
     } catch (const interrupted_exc_t &) {
         /* Ignore. If we were interrupted by the backfillee, then it already
@@ -8,6 +8,7 @@
 #include "clustering/immediate_consistency/branch/history.hpp"
 #include "clustering/immediate_consistency/branch/metadata.hpp"
 
+class backfill_governor_t;
 template <class> class backfiller_send_backfill_callback_t;
 template <class> class semilattice_read_view_t;
 class traversal_progress_combiner_t;
@@ -19,9 +20,11 @@ its existence in the metadata and serve backfills over the network. Generally
 template <class protocol_t>
 class backfiller_t : public home_thread_mixin_debug_only_t {
 public:
+    /* `governor` paces the backfills; it may be NULL. */
     backfiller_t(mailbox_manager_t *mm,
                  branch_history_manager_t<protocol_t> *bhm,
-                 store_view_t<protocol_t> *svs);
+                 store_view_t<protocol_t> *svs,
+                 backfill_governor_t *governor);
 
     backfiller_business_card_t<protocol_t> get_business_card();
 
@@ -39,7 +42,7 @@ private:
             const branch_history_t<protocol_t> &start_point_associated_branch_history,
             mailbox_addr_t<void(region_map_t<protocol_t, version_range_t>, branch_history_t<protocol_t>)> end_point_cont,
             mailbox_addr_t<void(typename protocol_t::backfill_chunk_t, fifo_enforcer_write_token_t)> chunk_cont,
-            mailbox_addr_t<void(fifo_enforcer_write_token_t)> done_cont,
+            mailbox_addr_t<void(typename protocol_t::region_t, fifo_enforcer_write_token_t)> done_cont,
             mailbox_addr_t<void(mailbox_addr_t<void(int)>)> allocation_registration_box,
             auto_drainer_t::lock_t keepalive);
 
@@ -53,6 +56,7 @@ private:
     branch_history_manager_t<protocol_t> *const branch_history_manager;
 
     store_view_t<protocol_t> *const svs;
+    backfill_governor_t *const governor;
 
     std::map<backfill_session_id_t, cond_t *> local_interruptors;
     std::map<backfill_session_id_t, traversal_progress_combiner_t *> local_backfill_progress;
@@ -1,13 +1,17 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "clustering/immediate_consistency/branch/broadcaster.hpp"
 
+#include <deque>
+
 #include "utils.hpp"
 #include <boost/make_shared.hpp>
 
 #include "concurrency/coro_fifo.hpp"
 #include "concurrency/coro_pool.hpp"
 #include "concurrency/cross_thread_signal.hpp"
+#include "config/args.hpp"
 #include "containers/death_runner.hpp"
+#include "containers/map_sentries.hpp"
 #include "containers/uuid.hpp"
 #include "clustering/immediate_consistency/branch/listener.hpp"
 #include "clustering/immediate_consistency/branch/multistore.hpp"
@@ -41,6 +45,9 @@ broadcaster_t<protocol_t>::broadcaster_t(mailbox_manager_t *mm,
         signal_t *interruptor) THROWS_ONLY(interrupted_exc_t)
     : broadcaster_collection(),
       broadcaster_membership(parent_perfmon_collection, &broadcaster_collection, "broadcaster"),
+      pm_coalesced_reads(secs_to_ticks(1)),
+      pm_coalesced_reads_membership(&broadcaster_collection, &pm_coalesced_reads,
+                                    "coalesced_reads"),
       mailbox_manager(mm),
       branch_id(generate_uuid()),
       branch_history_manager(bhm),
@@ -200,6 +207,40 @@ private:
     boost::shared_ptr<incomplete_write_t> write;
 };
 
+/* A write that was queued for an async dispatchee but that its listener
+   hasn't acked yet. */
+struct async_write_t {
+    uint64_t write_seq;
+    ticks_t queued;
+    int64_t bytes;
+};
+
+/* Reports how far an async secondary lags behind us: the age of the oldest
+   write it hasn't acked, and the size of all of them. */
+class async_lag_perfmon_t : public perfmon_t {
+public:
+    async_lag_perfmon_t(const std::deque<async_write_t> *_unacked_writes,
+                        const int64_t *_unacked_bytes)
+        : unacked_writes(_unacked_writes), unacked_bytes(_unacked_bytes) { }
+
+    void *begin_stats() {
+        return NULL;
+    }
+    void visit_stats(void *) { }
+    scoped_ptr_t<perfmon_result_t> end_stats(void *) {
+        const double secs = unacked_writes->empty()
+            ? 0 : ticks_to_secs(get_ticks() - unacked_writes->front().queued);
+        scoped_ptr_t<perfmon_result_t> result = perfmon_result_t::alloc_map_result();
+        result->insert("secs", new perfmon_result_t(strprintf("%f", secs)));
+        result->insert("bytes", new perfmon_result_t(strprintf("%" PRIi64, *unacked_bytes)));
+        return result;
+    }
+
+private:
+    const std::deque<async_write_t> *unacked_writes;
+    const int64_t *unacked_bytes;
+};
+
 /* The `registrar_t` constructs a `dispatchee_t` for every mirror that
    connects to us. */
 
@@ -208,12 +249,25 @@ class broadcaster_t<protocol_t>::dispatchee_t : public intrusive_list_node_t<dis
 public:
     dispatchee_t(broadcaster_t *c, listener_business_card_t<protocol_t> d) THROWS_NOTHING :
         write_mailbox(d.write_mailbox), is_readable(false),
+        is_async(d.is_async),
+        next_write_seq(0),
+        async_lag_bytes(0),
         queue_count(),
         queue_count_membership(&c->broadcaster_collection, &queue_count, uuid_to_str(d.write_mailbox.get_peer().get_uuid()) + "_broadcast_queue_count"),
         background_write_queue(&queue_count),
+        async_lag_perfmon(&unacked_async_writes, &async_lag_bytes),
+        /* An async listener is usually far away, so it gets as many writes in
+        flight at once as a listener accepts. Its writes all go through this
+        pool, which keeps it at that. */
         // TODO magic constant
-        background_write_workers(100, &background_write_queue, &background_write_caller),
+        background_write_workers(d.is_async
+                                     ? listener_t<protocol_t>::MAX_OUTSTANDING_WRITES_FROM_BROADCASTER
+                                     : 100,
+                                 &background_write_queue, &background_write_caller),
         controller(c),
+        last_acked_write_seq(0),
+        write_ack_mailbox(controller->mailbox_manager,
+            boost::bind(&dispatchee_t::on_write_ack, this, _1, auto_drainer_t::lock_t(&drainer))),
         upgrade_mailbox(controller->mailbox_manager,
             boost::bind(&dispatchee_t::upgrade, this, _1, _2, auto_drainer_t::lock_t(&drainer))),
         downgrade_mailbox(controller->mailbox_manager,
@@ -231,6 +285,12 @@ public:
 
         controller->dispatchees[this] = auto_drainer_t::lock_t(&drainer);
 
+        if (is_async) {
+            async_lag_membership.init(new perfmon_membership_t(
+                &controller->broadcaster_collection, &async_lag_perfmon,
+                uuid_to_str(d.write_mailbox.get_peer().get_uuid()) + "_async_lag"));
+        }
+
         /* This coroutine will send an intro message to the newly-registered
         listener. It needs to be a separate coroutine so that we don't block while
         holding `controller->mutex`. */
@@ -240,8 +300,15 @@ public:
         for (typename std::list<boost::shared_ptr<incomplete_write_t> >::iterator it = controller->incomplete_writes.begin();
                 it != controller->incomplete_writes.end(); it++) {
 
-            coro_t::spawn_sometime(boost::bind(&broadcaster_t::background_write, controller,
-                                               this, auto_drainer_t::lock_t(&drainer), incomplete_write_ref_t(*it), order_source.check_in("dispatchee_t"), fifo_source.enter_write()));
+            const uint64_t write_seq = ++next_write_seq;
+            boost::function<void()> catch_up = boost::bind(&broadcaster_t::background_write, controller,
+                this, auto_drainer_t::lock_t(&drainer), incomplete_write_ref_t(*it), order_source.check_in("dispatchee_t"), fifo_source.enter_write(), write_seq);
+            if (is_async) {
+                note_async_write(write_seq, (*it)->write);
+                background_write_queue.push(catch_up);
+            } else {
+                coro_t::spawn_sometime(catch_up);
+            }
         }
     }
 
@@ -257,6 +324,36 @@ public:
         return write_mailbox.get_peer();
     }
 
+    typename listener_business_card_t<protocol_t>::write_ack_mailbox_t::address_t get_write_ack_address() {
+        return write_ack_mailbox.get_address();
+    }
+
+    /* Called for every write that is queued for an async dispatchee, in
+    `write_seq` order. */
+    void note_async_write(uint64_t write_seq, const typename protocol_t::write_t &write) {
+        rassert(is_async);
+        write_message_t msg;
+        msg << write;
+        async_write_t entry;
+        entry.write_seq = write_seq;
+        entry.queued = get_ticks();
+        entry.bytes = msg.size();
+        unacked_async_writes.push_back(entry);
+        async_lag_bytes += entry.bytes;
+    }
+
+    /* Returns when the listener has acked the write with this `write_seq` */
+    void wait_for_write_ack(uint64_t write_seq, signal_t *interruptor)
+            THROWS_ONLY(interrupted_exc_t) {
+        if (last_acked_write_seq >= write_seq) {
+            return;
+        }
+        cond_t acked;
+        multimap_insertion_sentry_t<uint64_t, cond_t *> sentry(
+            &write_ack_waiters, write_seq, &acked);
+        wait_interruptible(&acked, interruptor);
+    }
+
 private:
     /* The constructor spawns `send_intro()` in the background. */
     void send_intro(listener_business_card_t<protocol_t> to_send_intro_to,
@@ -271,7 +368,26 @@ private:
                                           downgrade_mailbox.get_address()));
     }
 
-    /* `upgrade()` and `downgrade()` are mailbox callbacks. */
+    /* `on_write_ack()`, `upgrade()`, and `downgrade()` are mailbox callbacks. */
+    void on_write_ack(uint64_t write_seq, auto_drainer_t::lock_t) THROWS_NOTHING {
+        ASSERT_FINITE_CORO_WAITING;
+        if (write_seq <= last_acked_write_seq) {
+            return;
+        }
+        last_acked_write_seq = write_seq;
+        while (!unacked_async_writes.empty()
+               && unacked_async_writes.front().write_seq <= write_seq) {
+            async_lag_bytes -= unacked_async_writes.front().bytes;
+            unacked_async_writes.pop_front();
+        }
+        for (std::multimap<uint64_t, cond_t *>::iterator it = write_ack_waiters.begin();
+             it != write_ack_waiters.end() && it->first <= write_seq; ++it) {
+            if (!it->second->is_pulsed()) {
+                it->second->pulse();
+            }
+        }
+    }
+
     void upgrade(typename listener_business_card_t<protocol_t>::writeread_mailbox_t::address_t wrm,
                  typename listener_business_card_t<protocol_t>::read_mailbox_t::address_t rm,
                  auto_drainer_t::lock_t)
@@ -304,6 +420,20 @@ public:
     typename listener_business_card_t<protocol_t>::writeread_mailbox_t::address_t writeread_mailbox;
     typename listener_business_card_t<protocol_t>::read_mailbox_t::address_t read_mailbox;
 
+    /* Whether the listener is an async secondary's. Writes don't wait for it
+    until it lags `ASYNC_REPLICA_MAX_LAG_BYTES` behind. */
+    const bool is_async;
+
+    /* Numbers the writes sent to `write_mailbox`, so that one ack from the
+    listener can cover all of the writes up to some number. Only touched while
+    holding `controller->mutex`. */
+    uint64_t next_write_seq;
+
+    /* For an async dispatchee, the writes its listener hasn't acked yet, oldest
+    first, and their total size. */
+    std::deque<async_write_t> unacked_async_writes;
+    int64_t async_lag_bytes;
+
     /* This is used to enforce that operations are performed on the
        destination machine in the same order that we send them, even if the
        network layer reorders the messages. */
@@ -322,40 +452,28 @@ public:
     calling_callback_t background_write_caller;
 
 private:
+    async_lag_perfmon_t async_lag_perfmon;
+    scoped_ptr_t<perfmon_membership_t> async_lag_membership;
+
     coro_pool_t<boost::function<void()> > background_write_workers;
     broadcaster_t *controller;
+
+    uint64_t last_acked_write_seq;
+    std::multimap<uint64_t, cond_t *> write_ack_waiters;
+
     auto_drainer_t drainer;
 
+    typename listener_business_card_t<protocol_t>::write_ack_mailbox_t write_ack_mailbox;
     typename listener_business_card_t<protocol_t>::upgrade_mailbox_t upgrade_mailbox;
     typename listener_business_card_t<protocol_t>::downgrade_mailbox_t downgrade_mailbox;
 
     DISABLE_COPYING(dispatchee_t);
 };
 
-/* Functions to send a read or write to a mirror and wait for a response.
+/* Functions to send a read to a mirror and wait for a response.
 Important: These functions must send the message before responding to
 `interruptor` being pulsed. */
 
-template<class protocol_t>
-void listener_write(
-        mailbox_manager_t *mailbox_manager,
-        const typename listener_business_card_t<protocol_t>::write_mailbox_t::address_t &write_mailbox,
-        const typename protocol_t::write_t &w, transition_timestamp_t ts,
-        order_token_t order_token, fifo_enforcer_write_token_t token,
-        signal_t *interruptor)
-        THROWS_ONLY(interrupted_exc_t)
-{
-    cond_t ack_cond;
-    mailbox_t<void()> ack_mailbox(
-        mailbox_manager,
-        boost::bind(&cond_t::pulse, &ack_cond));
-
-    send(mailbox_manager, write_mailbox,
-         w, ts, order_token, token, ack_mailbox.get_address());
-
-    wait_interruptible(&ack_cond, interruptor);
-}
-
 template <class response_t>
 void store_listener_response(response_t *result_out, const response_t &result_in, cond_t *done) {
     *result_out = result_in;
@@ -462,8 +580,23 @@ void broadcaster_t<protocol_t>::spawn_write(const typename protocol_t::write_t &
             it->first->background_write_queue.push(boost::bind(&broadcaster_t::background_writeread, this,
                 it->first, it->second, write_ref, order_token, fifo_enforcer_token, durability));
         } else {
-            it->first->background_write_queue.push(boost::bind(&broadcaster_t::background_write, this,
-                it->first, it->second, write_ref, order_token, fifo_enforcer_token));
+            const uint64_t write_seq = ++it->first->next_write_seq;
+            bool wait_for_mirror = true;
+            if (it->first->is_async) {
+                /* The write doesn't wait for an async mirror that isn't too far
+                behind yet, so the mirror gets its own copy. */
+                wait_for_mirror = it->first->async_lag_bytes >= ASYNC_REPLICA_MAX_LAG_BYTES;
+                it->first->note_async_write(write_seq, write);
+            }
+            if (wait_for_mirror) {
+                it->first->background_write_queue.push(boost::bind(&broadcaster_t::background_write, this,
+                    it->first, it->second, write_ref, order_token, fifo_enforcer_token,
+                    write_seq));
+            } else {
+                it->first->background_write_queue.push(boost::bind(&broadcaster_t::background_async_write, this,
+                    it->first, it->second, write, timestamp, order_token, fifo_enforcer_token,
+                    write_seq));
+            }
         }
     }
 }
@@ -508,11 +641,28 @@ void broadcaster_t<protocol_t>::get_all_readable_dispatchees(
 }
 
 template<class protocol_t>
-void broadcaster_t<protocol_t>::background_write(dispatchee_t *mirror, auto_drainer_t::lock_t mirror_lock, incomplete_write_ref_t write_ref, order_token_t order_token, fifo_enforcer_write_token_t token) THROWS_NOTHING {
+void broadcaster_t<protocol_t>::background_write(dispatchee_t *mirror, auto_drainer_t::lock_t mirror_lock, incomplete_write_ref_t write_ref, order_token_t order_token, fifo_enforcer_write_token_t token, uint64_t write_seq) THROWS_NOTHING {
+    try {
+        /* This must send the message before responding to the drain signal. */
+        send(mailbox_manager, mirror->write_mailbox,
+             write_ref.get()->write, write_ref.get()->timestamp, order_token, token,
+             write_seq, mirror->get_write_ack_address());
+        mirror->wait_for_write_ack(write_seq, mirror_lock.get_drain_signal());
+    } catch (const interrupted_exc_t &) {
+        return;
+    }
+}
+
+template<class protocol_t>
+void broadcaster_t<protocol_t>::background_async_write(dispatchee_t *mirror, auto_drainer_t::lock_t mirror_lock, const typename protocol_t::write_t &write, transition_timestamp_t timestamp, order_token_t order_token, fifo_enforcer_write_token_t token, uint64_t write_seq) THROWS_NOTHING {
     try {
-        listener_write<protocol_t>(mailbox_manager, mirror->write_mailbox,
-                                   write_ref.get()->write, write_ref.get()->timestamp, order_token, token,
-                                   mirror_lock.get_drain_signal());
+        /* Like `background_write()`, but the write may have completed
+        everywhere else already. We still wait for the ack, so that the listener
+        never has more writes in flight than it accepts. */
+        send(mailbox_manager, mirror->write_mailbox,
+             write, timestamp, order_token, token,
+             write_seq, mirror->get_write_ack_address());
+        mirror->wait_for_write_ack(write_seq, mirror_lock.get_drain_signal());
     } catch (const interrupted_exc_t &) {
         return;
     }
@@ -588,18 +738,44 @@ void broadcaster_t<protocol_t>::single_read(
     auto_drainer_t::lock_t reader_lock;
     state_timestamp_t timestamp;
     fifo_enforcer_read_token_t enforcer_token;
+    store_key_t coalescing_key;
+    const bool coalescable = read.coalescing_key(&coalescing_key);
+    scoped_ptr_t<typename coalesced_reads_t::ticket_t> ticket;
 
     {
         wait_interruptible(lock, interruptor);
         mutex_assertion_t::acq_t mutex_acq(&mutex);
         lock->end();
 
+        timestamp = current_timestamp;
+        if (coalescable) {
+            ticket.init(new typename coalesced_reads_t::ticket_t(
+                &coalesced_reads, std::make_pair(timestamp, coalescing_key)));
+        }
+        if (!ticket.has() || ticket->is_leader()) {
+            pick_a_readable_dispatchee(&reader, &mutex_acq, &reader_lock);
+            order_token = order_checkpoint.check_through(order_token);
+
+            /* This is safe even if `interruptor` gets pulsed because nothing
+            checks `interruptor` until after we have sent the message. */
+            enforcer_token = reader->fifo_source.enter_read();
+        }
+    }
+
+    if (ticket.has() && !ticket->is_leader()) {
+        /* No write can have come between the read we follow and us, so its
+        response is what we'd get. */
+        if (ticket->wait(response, interruptor)) {
+            pm_coalesced_reads.record();
+            return;
+        }
+        /* It failed, maybe because whoever sent it gave up on it, so we go on our
+        own, at the state the shard is in by now. */
+        ticket.reset();
+        mutex_assertion_t::acq_t mutex_acq(&mutex);
         pick_a_readable_dispatchee(&reader, &mutex_acq, &reader_lock);
         timestamp = current_timestamp;
         order_token = order_checkpoint.check_through(order_token);
-
-        /* This is safe even if `interruptor` gets pulsed because nothing
-        checks `interruptor` until after we have sent the message. */
         enforcer_token = reader->fifo_source.enter_read();
     }
 
@@ -615,6 +791,9 @@ void broadcaster_t<protocol_t>::single_read(
             throw cannot_perform_query_exc_t("lost contact with mirror during read");
         }
     }
+    if (ticket.has()) {
+        ticket->succeed(*response);
+    }
 }
 
 template<class protocol_t>
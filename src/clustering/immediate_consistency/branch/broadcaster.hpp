@@ -8,10 +8,12 @@
 #include "utils.hpp"
 #include <boost/shared_ptr.hpp>
 
+#include "btree/keys.hpp"
 #include "clustering/generic/registrar.hpp"
 #include "clustering/immediate_consistency/branch/history.hpp"
 #include "clustering/immediate_consistency/branch/metadata.hpp"
 #include "concurrency/queue/unlimited_fifo.hpp"
+#include "concurrency/single_flight.hpp"
 #include "protocol_api.hpp"
 #include "timestamps.hpp"
 
@@ -117,7 +119,14 @@ private:
     void background_write(
         dispatchee_t *mirror, auto_drainer_t::lock_t mirror_lock,
         incomplete_write_ref_t write_ref, order_token_t order_token,
-        fifo_enforcer_write_token_t token) THROWS_NOTHING;
+        fifo_enforcer_write_token_t token, uint64_t write_seq) THROWS_NOTHING;
+    /* Sends an async mirror its own copy of a write, so that the write can
+    finish without waiting for the mirror. */
+    void background_async_write(
+        dispatchee_t *mirror, auto_drainer_t::lock_t mirror_lock,
+        const typename protocol_t::write_t &write, transition_timestamp_t timestamp,
+        order_token_t order_token, fifo_enforcer_write_token_t token,
+        uint64_t write_seq) THROWS_NOTHING;
     void background_writeread(
         dispatchee_t *mirror, auto_drainer_t::lock_t mirror_lock,
         incomplete_write_ref_t write_ref, order_token_t order_token,
@@ -147,6 +156,10 @@ private:
     perfmon_collection_t broadcaster_collection;
     perfmon_membership_t broadcaster_membership;
 
+    // How many reads got their response from an equal read (see `coalesced_reads`).
+    perfmon_rate_monitor_t pm_coalesced_reads;
+    perfmon_membership_t pm_coalesced_reads_membership;
+
     mailbox_manager_t *mailbox_manager;
 
     branch_id_t branch_id;
@@ -177,6 +190,12 @@ private:
     order_checkpoint_t order_checkpoint;
     semaphore_assertion_t enforce_max_outstanding_writes;
 
+    /* Equal point reads at the same timestamp read the same state of the shard, so
+    when a hot key gets many of them at once, they share one trip to a mirror. */
+    typedef single_flight_t<std::pair<state_timestamp_t, store_key_t>,
+                            typename protocol_t::read_response_t> coalesced_reads_t;
+    coalesced_reads_t coalesced_reads;
+
     std::map<dispatchee_t *, auto_drainer_t::lock_t> dispatchees;
     intrusive_list_t<dispatchee_t> readable_dispatchees;
 
@@ -46,7 +46,7 @@ public:
     branch_id_t branch;
     state_timestamp_t timestamp;
 
-    RDB_MAKE_ME_SERIALIZABLE_2(branch, timestamp);
+    RDB_MAKE_ME_SERIALIZABLE_RAW_2(branch, timestamp);
 };
 
 inline void debug_print(printf_buffer_t *buf, const version_t& v) {
@@ -88,7 +88,7 @@ public:
 
     version_t earliest, latest;
 
-    RDB_MAKE_ME_SERIALIZABLE_2(earliest, latest);
+    RDB_MAKE_ME_SERIALIZABLE_RAW_2(earliest, latest);
 };
 
 inline void debug_print(printf_buffer_t *buf, const version_range_t& vr) {
@@ -3,11 +3,13 @@
 
 #include "clustering/generic/registrant.hpp"
 #include "clustering/generic/resource.hpp"
+#include "clustering/immediate_consistency/branch/backfill_governor.hpp"
 #include "clustering/immediate_consistency/branch/backfillee.hpp"
 #include "clustering/immediate_consistency/branch/broadcaster.hpp"
 #include "clustering/immediate_consistency/branch/history.hpp"
 #include "concurrency/coro_pool.hpp"
 #include "concurrency/cross_thread_signal.hpp"
+#include "concurrency/pmap.hpp"
 
 
 /* `WRITE_QUEUE_CORO_POOL_SIZE` is the number of coroutines that will be used
@@ -57,15 +59,19 @@ listener_t<protocol_t>::listener_t(const base_path_t &base_path,
                                    clone_ptr_t<watchable_t<boost::optional<boost::optional<broadcaster_business_card_t<protocol_t> > > > > broadcaster_metadata,
                                    branch_history_manager_t<protocol_t> *branch_history_manager,
                                    store_view_t<protocol_t> *svs,
-                                   clone_ptr_t<watchable_t<boost::optional<boost::optional<replier_business_card_t<protocol_t> > > > > replier,
+                                   const std::vector<replier_watchable_t> &repliers,
                                    backfill_session_id_t backfill_session_id,
+                                   bool is_async,
                                    perfmon_collection_t *backfill_stats_parent,
+                                   backfill_governor_t *backfill_governor,
                                    signal_t *interruptor,
                                    order_source_t *order_source)
         THROWS_ONLY(interrupted_exc_t, backfiller_lost_exc_t, broadcaster_lost_exc_t) :
 
     mailbox_manager_(mm),
     svs_(svs),
+    backfill_governor_(backfill_governor),
+    is_async_(is_async),
     uuid_(generate_uuid()),
     perfmon_collection_(),
     perfmon_collection_membership_(backfill_stats_parent, &perfmon_collection_, "backfill-serialization-" + uuid_to_str(uuid_)),
@@ -76,8 +82,11 @@ listener_t<protocol_t>::listener_t(const base_path_t &base_path,
     write_queue_semaphore_(SEMAPHORE_NO_LIMIT,
         WRITE_QUEUE_SEMAPHORE_TRICKLE_FRACTION),
     enforce_max_outstanding_writes_from_broadcaster_(MAX_OUTSTANDING_WRITES_FROM_BROADCASTER),
+    last_enqueued_write_seq_(0),
+    last_acked_write_seq_(0),
+    write_ack_sender_running_(false),
     write_mailbox_(mailbox_manager_,
-        boost::bind(&listener_t::on_write, this, _1, _2, _3, _4, _5)),
+        boost::bind(&listener_t::on_write, this, _1, _2, _3, _4, _5, _6)),
     writeread_mailbox_(mailbox_manager_,
         boost::bind(&listener_t::on_writeread, this, _1, _2, _3, _4, _5, _6)),
     read_mailbox_(mailbox_manager_,
@@ -140,31 +149,23 @@ listener_t<protocol_t>::listener_t(const base_path_t &base_path,
 
     state_timestamp_t streaming_begin_point = listener_intro.broadcaster_begin_timestamp;
 
-    try {
-        /* Go through a little song and dance to make sure that the
-         * backfiller will at least get us to the point that we will being
-         * live streaming from. */
-
-        cond_t backfiller_is_up_to_date;
-        mailbox_t<void()> ack_mbox(
-            mailbox_manager_,
-            boost::bind(&cond_t::pulse, &backfiller_is_up_to_date));
-
-        resource_access_t<replier_business_card_t<protocol_t> > replier_access(replier);
-        send(mailbox_manager_, replier_access.access().synchronize_mailbox, streaming_begin_point, ack_mbox.get_address());
-
-        wait_any_t interruptor2(interruptor, replier_access.get_failed_signal());
-        wait_interruptible(&backfiller_is_up_to_date, &interruptor2);
+    /* Backfill, with each replier supplying one part of our region. */
+    guarantee(!repliers.empty());
+    std::vector<typename protocol_t::region_t> parts;
+    const int num_parts = repliers.size();
+    for (int i = 0; i < num_parts; ++i) {
+        parts.push_back(region_subdivide(svs_->get_region(), i, num_parts));
+    }
 
-        /* Backfill */
-        backfillee<protocol_t>(mailbox_manager_,
-                               branch_history_manager,
-                               svs_,
-                               svs_->get_region(),
-                               replier->subview(&listener_t<protocol_t>::get_backfiller_from_replier_bcard),
-                               backfill_session_id,
-                               interruptor);
-    } catch (const resource_lost_exc_t &) {
+    cond_t backfill_failed;
+    pmap(parts.size(), boost::bind(&listener_t<protocol_t>::backfill_part, this,
+                                   _1, &repliers, &parts, streaming_begin_point,
+                                   branch_history_manager, backfill_session_id,
+                                   &backfill_failed, interruptor));
+    if (interruptor->is_pulsed()) {
+        throw interrupted_exc_t();
+    }
+    if (backfill_failed.is_pulsed()) {
         throw backfiller_lost_exc_t();
     }
 
@@ -196,6 +197,10 @@ listener_t<protocol_t>::listener_t(const base_path_t &base_path,
     operation to region A unnecessarily if we weren't actually updating any keys
     there. That's why it's OK to just take the maximum of all the timestamps
     that we see.
+    This only holds within the part of the region that we backfilled from one
+    replier, though; different repliers may have been at different timestamps
+    when they finished. So we remember where each part ended, and catch up
+    the parts that are behind from the write queue.
     TODO: If we change the way we shard such that each listener_t maps to a
     single B-tree on the same machine, then replace this loop with a strict
     assertion that requires everything to be at the same timestamp. */
@@ -208,7 +213,20 @@ listener_t<protocol_t>::listener_t(const base_path_t &base_path,
         backfill_end_timestamp = std::max(backfill_end_timestamp, it->second.earliest.timestamp);
     }
 
-    guarantee(backfill_end_timestamp >= streaming_begin_point);
+    for (size_t i = 0; i < parts.size(); ++i) {
+        if (region_is_empty(parts[i])) {
+            continue;
+        }
+        region_map_t<protocol_t, version_range_t> part_end_point = backfill_end_point.mask(parts[i]);
+        state_timestamp_t part_end_timestamp = part_end_point.begin()->second.earliest.timestamp;
+        for (typename region_map_t<protocol_t, version_range_t>::const_iterator it = part_end_point.begin();
+             it != part_end_point.end();
+             ++it) {
+            part_end_timestamp = std::max(part_end_timestamp, it->second.earliest.timestamp);
+        }
+        guarantee(part_end_timestamp >= streaming_begin_point);
+        backfill_end_points_.push_back(std::make_pair(parts[i], part_end_timestamp));
+    }
 
     current_timestamp_ = backfill_end_timestamp;
     write_queue_coro_pool_callback_.init(new boost_function_callback_t<write_queue_entry_t>(
@@ -233,10 +251,13 @@ listener_t<protocol_t>::listener_t(const base_path_t &base_path,
                                    branch_history_manager_t<protocol_t> *branch_history_manager,
                                    broadcaster_t<protocol_t> *broadcaster,
                                    perfmon_collection_t *backfill_stats_parent,
+                                   backfill_governor_t *backfill_governor,
                                    signal_t *interruptor,
                                    DEBUG_VAR order_source_t *order_source) THROWS_ONLY(interrupted_exc_t) :
     mailbox_manager_(mm),
     svs_(broadcaster->release_bootstrap_svs_for_listener()),
+    backfill_governor_(backfill_governor),
+    is_async_(false),
     branch_id_(broadcaster->get_branch_id()),
     uuid_(generate_uuid()),
     perfmon_collection_(),
@@ -246,8 +267,11 @@ listener_t<protocol_t>::listener_t(const base_path_t &base_path,
     write_queue_semaphore_(WRITE_QUEUE_SEMAPHORE_LONG_TERM_CAPACITY,
         WRITE_QUEUE_SEMAPHORE_TRICKLE_FRACTION),
     enforce_max_outstanding_writes_from_broadcaster_(MAX_OUTSTANDING_WRITES_FROM_BROADCASTER),
+    last_enqueued_write_seq_(0),
+    last_acked_write_seq_(0),
+    write_ack_sender_running_(false),
     write_mailbox_(mailbox_manager_,
-        boost::bind(&listener_t::on_write, this, _1, _2, _3, _4, _5)),
+        boost::bind(&listener_t::on_write, this, _1, _2, _3, _4, _5, _6)),
     writeread_mailbox_(mailbox_manager_,
         boost::bind(&listener_t::on_writeread, this, _1, _2, _3, _4, _5, _6)),
     read_mailbox_(mailbox_manager_,
@@ -309,6 +333,55 @@ listener_t<protocol_t>::listener_t(const base_path_t &base_path,
 template <class protocol_t>
 listener_t<protocol_t>::~listener_t() { }
 
+template <class protocol_t>
+void listener_t<protocol_t>::backfill_part(int part_number,
+        const std::vector<replier_watchable_t> *repliers,
+        const std::vector<typename protocol_t::region_t> *parts,
+        state_timestamp_t streaming_begin_point,
+        branch_history_manager_t<protocol_t> *branch_history_manager,
+        backfill_session_id_t backfill_session_id,
+        cond_t *backfill_failed,
+        signal_t *interruptor) THROWS_NOTHING {
+    if (region_is_empty((*parts)[part_number])) {
+        return;
+    }
+    const replier_watchable_t &replier = (*repliers)[part_number];
+
+    try {
+        wait_any_t interruptor2(interruptor, backfill_failed);
+
+        /* Go through a little song and dance to make sure that the
+         * backfiller will at least get us to the point that we will being
+         * live streaming from. */
+
+        cond_t backfiller_is_up_to_date;
+        mailbox_t<void()> ack_mbox(
+            mailbox_manager_,
+            boost::bind(&cond_t::pulse, &backfiller_is_up_to_date));
+
+        resource_access_t<replier_business_card_t<protocol_t> > replier_access(replier);
+        send(mailbox_manager_, replier_access.access().synchronize_mailbox, streaming_begin_point, ack_mbox.get_address());
+
+        wait_any_t interruptor3(&interruptor2, replier_access.get_failed_signal());
+        wait_interruptible(&backfiller_is_up_to_date, &interruptor3);
+
+        /* Backfill */
+        backfillee<protocol_t>(mailbox_manager_,
+                               branch_history_manager,
+                               svs_,
+                               (*parts)[part_number],
+                               replier->subview(&listener_t<protocol_t>::get_backfiller_from_replier_bcard),
+                               part_number == 0 ? backfill_session_id : generate_uuid(),
+                               backfill_governor_,
+                               &interruptor2);
+    } catch (const resource_lost_exc_t &) {
+        backfill_failed->pulse_if_not_already_pulsed();
+    } catch (const interrupted_exc_t &) {
+        /* Either our caller was interrupted or another part failed; the
+        constructor tells which. */
+    }
+}
+
 template <class protocol_t>
 signal_t *listener_t<protocol_t>::get_broadcaster_lost_signal() {
     return registrant_->get_failed_signal();
@@ -371,7 +444,7 @@ void listener_t<protocol_t>::try_start_receiving_writes(
         registrant_.init(new registrant_t<listener_business_card_t<protocol_t> >(
             mailbox_manager_,
             broadcaster->subview(&listener_t<protocol_t>::get_registrar_from_broadcaster_bcard),
-            listener_business_card_t<protocol_t>(intro_mailbox.get_address(), write_mailbox_.get_address())));
+            listener_business_card_t<protocol_t>(intro_mailbox.get_address(), write_mailbox_.get_address(), is_async_)));
     } catch (const resource_lost_exc_t &) {
         throw broadcaster_lost_exc_t();
     }
@@ -392,14 +465,15 @@ void listener_t<protocol_t>::on_write(const typename protocol_t::write_t &write,
         transition_timestamp_t transition_timestamp,
         order_token_t order_token,
         fifo_enforcer_write_token_t fifo_token,
-        mailbox_addr_t<void()> ack_addr) THROWS_NOTHING {
+        uint64_t write_seq,
+        mailbox_addr_t<void(uint64_t)> ack_addr) THROWS_NOTHING {
     rassert(region_is_superset(our_branch_region_, write.get_region()));
     rassert(!region_is_empty(write.get_region()));
     order_token.assert_write_mode();
 
     coro_t::spawn_sometime(boost::bind(
         &listener_t<protocol_t>::enqueue_write, this,
-        write, transition_timestamp, order_token, fifo_token, ack_addr,
+        write, transition_timestamp, order_token, fifo_token, write_seq, ack_addr,
         auto_drainer_t::lock_t(&drainer_)));
 }
 
@@ -408,7 +482,8 @@ void listener_t<protocol_t>::enqueue_write(const typename protocol_t::write_t &w
         transition_timestamp_t transition_timestamp,
         order_token_t order_token,
         fifo_enforcer_write_token_t fifo_token,
-        mailbox_addr_t<void()> ack_addr,
+        uint64_t write_seq,
+        mailbox_addr_t<void(uint64_t)> ack_addr,
         auto_drainer_t::lock_t keepalive) THROWS_NOTHING {
     try {
         /* Make sure that the broadcaster isn't sending us too many concurrent
@@ -423,13 +498,36 @@ void listener_t<protocol_t>::enqueue_write(const typename protocol_t::write_t &w
         /* Release the semaphore before sending the response, because the
         broadcaster can send us a new write as soon as we send the ack */
         sem_acq.reset();
-        send(mailbox_manager_, ack_addr);
+
+        /* We leave the FIFO in the broadcaster's order, so every write before
+        this one is queued too. */
+        guarantee(write_seq > last_enqueued_write_seq_);
+        last_enqueued_write_seq_ = write_seq;
+        write_ack_addr_ = ack_addr;
+        if (!write_ack_sender_running_) {
+            write_ack_sender_running_ = true;
+            coro_t::spawn_sometime(boost::bind(
+                &listener_t<protocol_t>::send_write_acks, this, keepalive));
+        }
 
     } catch (const interrupted_exc_t &) {
         /* pass */
     }
 }
 
+template <class protocol_t>
+void listener_t<protocol_t>::send_write_acks(auto_drainer_t::lock_t keepalive) THROWS_NOTHING {
+    keepalive.assert_is_holding(&drainer_);
+    /* Writes that get queued while `send()` blocks are covered by the next
+    ack. */
+    while (last_acked_write_seq_ < last_enqueued_write_seq_) {
+        uint64_t seq = last_enqueued_write_seq_;
+        send(mailbox_manager_, write_ack_addr_, seq);
+        last_acked_write_seq_ = seq;
+    }
+    write_ack_sender_running_ = false;
+}
+
 template <class protocol_t>
 void listener_t<protocol_t>::perform_enqueued_write(const write_queue_entry_t &qe,
         state_timestamp_t backfill_end_timestamp,
@@ -443,6 +541,7 @@ void listener_t<protocol_t>::perform_enqueued_write(const write_queue_entry_t &q
     {
         fifo_enforcer_sink_t::exit_write_t fifo_exit(&store_entrance_sink_, qe.fifo_token);
         if (qe.transition_timestamp.timestamp_before() < backfill_end_timestamp) {
+            perform_enqueued_write_on_lagging_parts(qe, &fifo_exit, interruptor);
             return;
         }
         wait_interruptible(&fifo_exit, interruptor);
@@ -459,6 +558,7 @@ void listener_t<protocol_t>::perform_enqueued_write(const write_queue_entry_t &q
 
     rassert(region_is_superset(svs_->get_region(), qe.write.get_region()));
 
+    const ticks_t start_time = get_ticks();
     // This isn't used for client writes, so we don't want to wait for a disk ack.
     svs_->write(
         DEBUG_ONLY(metainfo_checker, )
@@ -471,6 +571,54 @@ void listener_t<protocol_t>::perform_enqueued_write(const write_queue_entry_t &q
         qe.order_token,
         &write_token_pair,
         interruptor);
+
+    if (backfill_governor_ != NULL) {
+        backfill_governor_->note_foreground_latency(get_ticks() - start_time);
+    }
+}
+
+template <class protocol_t>
+void listener_t<protocol_t>::perform_enqueued_write_on_lagging_parts(const write_queue_entry_t &qe,
+        fifo_enforcer_sink_t::exit_write_t *fifo_exit,
+        signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) {
+    bool waited = false;
+    for (size_t i = 0; i < backfill_end_points_.size(); ++i) {
+        const typename protocol_t::region_t &part = backfill_end_points_[i].first;
+        if (backfill_end_points_[i].second > qe.transition_timestamp.timestamp_before()) {
+            continue;
+        }
+        typename protocol_t::write_t part_write;
+        if (!qe.write.shard(part, &part_write)) {
+            continue;
+        }
+
+        /* We keep holding `fifo_exit` so that the later writes, which cover
+        the whole region, can't overtake this one. */
+        if (!waited) {
+            wait_interruptible(fifo_exit, interruptor);
+            waited = true;
+        }
+        write_token_pair_t write_token_pair;
+        svs_->new_write_token_pair(&write_token_pair);
+
+#ifndef NDEBUG
+        version_leq_metainfo_checker_callback_t<protocol_t> metainfo_checker_callback(qe.transition_timestamp.timestamp_before());
+        metainfo_checker_t<protocol_t> metainfo_checker(&metainfo_checker_callback, part);
+#endif
+
+        typename protocol_t::write_response_t response;
+        svs_->write(
+            DEBUG_ONLY(metainfo_checker, )
+            region_map_t<protocol_t, binary_blob_t>(part,
+                binary_blob_t(version_range_t(version_t(branch_id_, qe.transition_timestamp.timestamp_after())))),
+            part_write,
+            &response,
+            WRITE_DURABILITY_SOFT,
+            qe.transition_timestamp,
+            qe.order_token,
+            &write_token_pair,
+            interruptor);
+    }
 }
 
 template <class protocol_t>
@@ -532,6 +680,7 @@ void listener_t<protocol_t>::perform_writeread(const typename protocol_t::write_
         // Perform the operation
         typename protocol_t::write_response_t response;
 
+        const ticks_t start_time = get_ticks();
         svs_->write(DEBUG_ONLY(metainfo_checker, )
                     region_map_t<protocol_t, binary_blob_t>(svs_->get_region(),
                                                             binary_blob_t(version_range_t(version_t(branch_id_, transition_timestamp.timestamp_after())))),
@@ -543,6 +692,10 @@ void listener_t<protocol_t>::perform_writeread(const typename protocol_t::write_
                     &write_token_pair,
                     keepalive.get_drain_signal());
 
+        if (backfill_governor_ != NULL) {
+            backfill_governor_->note_foreground_latency(get_ticks() - start_time);
+        }
+
         /* Release the semaphore before sending the response, because the
         broadcaster can send us a new write as soon as we send the ack */
         sem_acq.reset();
@@ -606,6 +759,7 @@ void listener_t<protocol_t>::perform_read(const typename protocol_t::read_t &rea
 
         // Perform the operation
         typename protocol_t::read_response_t response;
+        const ticks_t start_time = get_ticks();
         svs_->read(
             DEBUG_ONLY(metainfo_checker, )
             read,
@@ -614,6 +768,10 @@ void listener_t<protocol_t>::perform_read(const typename protocol_t::read_t &rea
             &read_token_pair,
             keepalive.get_drain_signal());
 
+        if (backfill_governor_ != NULL) {
+            backfill_governor_->note_foreground_latency(get_ticks() - start_time);
+        }
+
         send(mailbox_manager_, ack_addr, response);
     } catch (const interrupted_exc_t &) {
         /* pass */
@@ -3,6 +3,8 @@
 #define CLUSTERING_IMMEDIATE_CONSISTENCY_BRANCH_LISTENER_HPP_
 
 #include <map>
+#include <utility>
+#include <vector>
 
 #include "clustering/immediate_consistency/branch/metadata.hpp"
 #include "concurrency/promise.hpp"
@@ -12,6 +14,7 @@
 #include "timestamps.hpp"
 #include "utils.hpp"
 
+class backfill_governor_t;
 template <class> class boost_function_callback_t;
 template <class> class branch_history_manager_t;
 template <class> class broadcaster_t;
@@ -26,7 +29,7 @@ template <class> class watchable_t;
 
 /* `listener_t` keeps a store-view in sync with a branch. Its constructor
 contacts a `broadcaster_t` to sign up for real-time updates, and also backfills
-from a `replier_t` to get a copy of all the existing data. As long as the
+from one or more `replier_t`s to get a copy of all the existing data. As long as the
 `listener_t` exists and nothing goes wrong, it will keep in sync with the
 branch.
 
@@ -64,6 +67,15 @@ public:
         }
     };
 
+    typedef clone_ptr_t<watchable_t<boost::optional<boost::optional<replier_business_card_t<protocol_t> > > > > replier_watchable_t;
+
+    /* Backfills from every replier in `repliers` at once, each one supplying
+    its own part of `svs`'s region (see `region_subdivide()`). They must all be
+    up to date on the branch that `broadcaster_metadata` belongs to. If any of
+    them goes away the whole backfill fails with `backfiller_lost_exc_t`.
+    `backfill_session_id` is used for the backfill from the first replier.
+    `is_async` tells the broadcaster that we are an async secondary, so it
+    doesn't hold writes up for us. */
     listener_t(
             const base_path_t &base_path,
             io_backender_t *io_backender,
@@ -71,9 +83,11 @@ public:
             clone_ptr_t<watchable_t<boost::optional<boost::optional<broadcaster_business_card_t<protocol_t> > > > > broadcaster_metadata,
             branch_history_manager_t<protocol_t> *branch_history_manager,
             store_view_t<protocol_t> *svs,
-            clone_ptr_t<watchable_t<boost::optional<boost::optional<replier_business_card_t<protocol_t> > > > > replier,
+            const std::vector<replier_watchable_t> &repliers,
             backfill_session_id_t backfill_session_id,
+            bool is_async,
             perfmon_collection_t *backfill_stats_parent,
+            backfill_governor_t *backfill_governor,
             signal_t *interruptor,
             order_source_t *order_source) THROWS_ONLY(interrupted_exc_t, backfiller_lost_exc_t, broadcaster_lost_exc_t);
 
@@ -88,6 +102,7 @@ public:
             branch_history_manager_t<protocol_t> *branch_history_manager,
             broadcaster_t<protocol_t> *broadcaster,
             perfmon_collection_t *backfill_stats_parent,
+            backfill_governor_t *backfill_governor,
             signal_t *interruptor,
             order_source_t *order_source) THROWS_ONLY(interrupted_exc_t);
 
@@ -109,6 +124,11 @@ public:
         return branch_id_;
     }
 
+    /* May be NULL. */
+    backfill_governor_t *backfill_governor() const {
+        return backfill_governor_;
+    }
+
     typename listener_business_card_t<protocol_t>::writeread_mailbox_t::address_t writeread_address() const {
         return writeread_mailbox_.get_address();
     }
@@ -150,6 +170,19 @@ private:
     `interruptor` is pulsed. Otherwise, it fills `registration_result_cond` with
     a value indicating if the registration succeeded or not, and with the intro
     we got from the broadcaster if it succeeded. */
+    /* Backfills part number `part_number` of `parts` from the corresponding
+    replier, for the first constructor. Pulses `backfill_failed` if the replier
+    goes away, and gives up if it is pulsed by another part. */
+    void backfill_part(int part_number,
+            const std::vector<replier_watchable_t> *repliers,
+            const std::vector<typename protocol_t::region_t> *parts,
+            state_timestamp_t streaming_begin_point,
+            branch_history_manager_t<protocol_t> *branch_history_manager,
+            backfill_session_id_t backfill_session_id,
+            cond_t *backfill_failed,
+            signal_t *interruptor)
+        THROWS_NOTHING;
+
     void try_start_receiving_writes(
             clone_ptr_t<watchable_t<boost::optional<boost::optional<broadcaster_business_card_t<protocol_t> > > > > broadcaster,
             signal_t *interruptor)
@@ -159,20 +192,33 @@ private:
             transition_timestamp_t transition_timestamp,
             order_token_t order_token,
             fifo_enforcer_write_token_t fifo_token,
-            mailbox_addr_t<void()> ack_addr)
+            uint64_t write_seq,
+            mailbox_addr_t<void(uint64_t)> ack_addr)
         THROWS_NOTHING;
 
     void enqueue_write(const typename protocol_t::write_t &write,
             transition_timestamp_t transition_timestamp,
             order_token_t order_token,
             fifo_enforcer_write_token_t fifo_token,
-            mailbox_addr_t<void()> ack_addr,
+            uint64_t write_seq,
+            mailbox_addr_t<void(uint64_t)> ack_addr,
             auto_drainer_t::lock_t keepalive)
         THROWS_NOTHING;
 
+    /* Sends acks until the broadcaster has heard about every write we have
+    queued. `enqueue_write()` spawns it when none is running. */
+    void send_write_acks(auto_drainer_t::lock_t keepalive) THROWS_NOTHING;
+
     void perform_enqueued_write(const write_queue_entry_t &serialized_write, state_timestamp_t backfill_end_timestamp, signal_t *interruptor)
         THROWS_ONLY(interrupted_exc_t);
 
+    /* Applies a write from before `backfill_end_timestamp` to the parts of our
+    region whose backfill ended before it did, if any. */
+    void perform_enqueued_write_on_lagging_parts(const write_queue_entry_t &qe,
+            fifo_enforcer_sink_t::exit_write_t *fifo_exit,
+            signal_t *interruptor)
+        THROWS_ONLY(interrupted_exc_t);
+
     /* See the note at the place where `writeread_mailbox` is declared for an
     explanation of why `on_writeread()` and `on_read()` are here. */
 
@@ -214,6 +260,13 @@ private:
 
     store_view_t<protocol_t> *const svs_;
 
+    /* Learns how long our reads and writes take, so that backfills can make
+    room for them.  May be NULL. */
+    backfill_governor_t *const backfill_governor_;
+
+    /* Whether we register with the broadcaster as an async secondary. */
+    const bool is_async_;
+
     branch_id_t branch_id_;
 
     typename protocol_t::region_t our_branch_region_;
@@ -233,6 +286,11 @@ private:
     perfmon_membership_t perfmon_collection_membership_;
 
     state_timestamp_t current_timestamp_;
+
+    /* Where the backfill from each replier left each part of our region. Parts
+    that ended behind the others still need the queued writes in between, which
+    `perform_enqueued_write()` applies to just those parts. */
+    std::vector<std::pair<typename protocol_t::region_t, state_timestamp_t> > backfill_end_points_;
     fifo_enforcer_sink_t store_entrance_sink_;
 
     // Used by the replier_t which needs to be able to tell
@@ -255,6 +313,13 @@ private:
     writes at the same time. */
     semaphore_assertion_t enforce_max_outstanding_writes_from_broadcaster_;
 
+    /* The highest `write_seq` up to which we have queued all the writes from
+    the broadcaster, the highest we have acked, and where to send the acks. */
+    uint64_t last_enqueued_write_seq_;
+    uint64_t last_acked_write_seq_;
+    mailbox_addr_t<void(uint64_t)> write_ack_addr_;
+    bool write_ack_sender_running_;
+
     auto_drainer_t drainer_;
 
     typename listener_business_card_t<protocol_t>::write_mailbox_t write_mailbox_;
@@ -32,7 +32,13 @@ public:
                            transition_timestamp_t,
                            order_token_t,
                            fifo_enforcer_write_token_t,
-                           mailbox_addr_t<void()> ack_addr)> write_mailbox_t;
+                           uint64_t write_seq,
+                           mailbox_addr_t<void(uint64_t)> ack_addr)> write_mailbox_t;
+
+    /* The listener acks the writes that come in on `write_mailbox` by sending
+    the highest `write_seq` up to which it has queued all of them, so one ack
+    can cover many writes. */
+    typedef mailbox_t<void(uint64_t)> write_ack_mailbox_t;
 
     typedef mailbox_t<void(typename protocol_t::write_t,
                            transition_timestamp_t,
@@ -59,15 +65,21 @@ public:
 
     typedef mailbox_t<void(listener_intro_t<protocol_t>)> intro_mailbox_t;
 
-    listener_business_card_t() { }
+    listener_business_card_t() : is_async(false) { }
     listener_business_card_t(const typename intro_mailbox_t::address_t &im,
-                             const typename write_mailbox_t::address_t &wm)
-        : intro_mailbox(im), write_mailbox(wm) { }
+                             const typename write_mailbox_t::address_t &wm,
+                             bool _is_async)
+        : intro_mailbox(im), write_mailbox(wm), is_async(_is_async) { }
 
     typename intro_mailbox_t::address_t intro_mailbox;
     typename write_mailbox_t::address_t write_mailbox;
 
-    RDB_MAKE_ME_SERIALIZABLE_2(intro_mailbox, write_mailbox);
+    /* An async secondary's listener (see `blueprint_role_async_secondary`). The
+    broadcaster queues writes for it without making them wait for it, up to
+    `ASYNC_REPLICA_MAX_LAG_BYTES`. */
+    bool is_async;
+
+    RDB_MAKE_ME_SERIALIZABLE_3(intro_mailbox, write_mailbox, is_async);
 };
 
 
@@ -107,7 +119,9 @@ struct backfiller_business_card_t {
             branch_history_t<protocol_t>
             ) >,
         mailbox_addr_t<void(typename protocol_t::backfill_chunk_t, fifo_enforcer_write_token_t)>,
-        mailbox_t<void(fifo_enforcer_write_token_t)>::address_t,
+        /* Where the backfiller says which parts of the region it has sent
+        entirely. It sends the whole region last, once the backfill is over. */
+        mailbox_addr_t<void(typename protocol_t::region_t, fifo_enforcer_write_token_t)>,
         mailbox_t<void(mailbox_addr_t<void(int)>)>::address_t
         )> backfill_mailbox_t;
 
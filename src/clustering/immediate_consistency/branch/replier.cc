@@ -21,7 +21,8 @@ replier_t<protocol_t>::replier_t(listener_t<protocol_t> *li,
     /* Start serving backfills */
     backfiller_(mailbox_manager_,
                 branch_history_manager,
-                listener_->svs()) {
+                listener_->svs(),
+                listener_->backfill_governor()) {
 
 #ifndef NDEBUG
     {
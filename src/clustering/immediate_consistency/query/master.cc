@@ -1,15 +1,37 @@
 // Copyright 2010-2012 RethinkDB, all rights reserved.
 #include "clustering/immediate_consistency/query/master.hpp"
 
+#include "errors.hpp"
+#include <boost/bind.hpp>
+
+#include "arch/runtime/coroutines.hpp"
+#include "concurrency/lock_contention.hpp"
+#include "config/args.hpp"
 #include "containers/archive/boost_types.hpp"
+#include "containers/scoped.hpp"
+
+// The reads and writes of a client wait here for the ones it sent before them.
+static lock_site_t master_read_fifo_lock_site("master.read_fifo");
+static lock_site_t master_write_fifo_lock_site("master.write_fifo");
 
 template <class protocol_t>
 master_t<protocol_t>::master_t(mailbox_manager_t *mm, ack_checker_t *ac,
-                               typename protocol_t::region_t r, broadcaster_t<protocol_t> *b) THROWS_ONLY(interrupted_exc_t)
+                               typename protocol_t::region_t r, broadcaster_t<protocol_t> *b,
+                               perfmon_collection_t *parent_perfmon_collection) THROWS_ONLY(interrupted_exc_t)
     : mailbox_manager(mm),
       ack_checker(ac),
       broadcaster(b),
       region(r),
+      master_membership(parent_perfmon_collection, &master_collection, "master"),
+      pm_reads(secs_to_ticks(1)),
+      pm_writes(secs_to_ticks(1)),
+      pm_membership(&master_collection,
+                    &pm_reads, "reads",
+                    &pm_writes, "writes",
+                    NULLPTR),
+      combiner_running(false),
+      writes_in_flight(0),
+      write_slot_cond(NULL),
       multi_throttling_server(mm, this, broadcaster_t<protocol_t>::MAX_OUTSTANDING_WRITES) {
     guarantee(ack_checker);
 }
@@ -35,14 +57,22 @@ void master_t<protocol_t>::client_t::perform_request(
             boost::get<typename master_business_card_t<protocol_t>::read_request_t>(&request)) {
 
         read->order_token.assert_read_mode();
+        parent->pm_reads.record();
 
         boost::variant<typename protocol_t::read_response_t, std::string> reply;
         try {
             reply = typename protocol_t::read_response_t();
             typename protocol_t::read_response_t &resp = boost::get<typename protocol_t::read_response_t>(reply);
 
-            fifo_enforcer_sink_t::exit_read_t exiter(&fifo_sink, read->fifo_token);
+            const ticks_t received = get_ticks();
+            fifo_enforcer_sink_t::exit_read_t exiter(&fifo_sink, read->fifo_token,
+                                                     &master_read_fifo_lock_site);
+            // The broadcaster waits for the read's turn as well, but this way it
+            // gets timed.
+            wait_interruptible(&exiter, interruptor);
+            const ticks_t in_order = get_ticks();
             parent->broadcaster->read(read->read, &resp, &exiter, read->order_token, interruptor);
+            read->read.profile_master(received, in_order, &resp);
         } catch (const cannot_perform_query_exc_t &e) {
             reply = e.what();
         }
@@ -52,30 +82,7 @@ void master_t<protocol_t>::client_t::perform_request(
             boost::get<typename master_business_card_t<protocol_t>::write_request_t>(&request)) {
 
         write->order_token.assert_write_mode();
-
-        // TODO: avoid extra response_t copies here
-        class write_callback_t : public broadcaster_t<protocol_t>::write_callback_t {
-        public:
-            explicit write_callback_t(ack_checker_t *ac) : ack_checker(ac) { }
-            void on_response(peer_id_t peer, const typename protocol_t::write_response_t &response) {
-                if (!response_promise.get_ready_signal()->is_pulsed()) {
-                    ASSERT_NO_CORO_WAITING;
-                    ack_set.insert(peer);
-                    // TODO: Having this centralized ack checker is horrible?  But maybe it's ok.
-                    bool is_acceptable = ack_checker->is_acceptable_ack_set(ack_set);
-                    if (is_acceptable) {
-                        response_promise.pulse(response);
-                    }
-                }
-            }
-            void on_done() {
-                done_cond.pulse();
-            }
-            ack_checker_t *ack_checker;
-            std::set<peer_id_t> ack_set;
-            promise_t<typename protocol_t::write_response_t> response_promise;
-            cond_t done_cond;
-        } write_callback(parent->ack_checker);
+        parent->pm_writes.record();
 
         /* Avoid a potential race condition where `parent->shutting_down` has
         been pulsed but the `multi_throttling_server_t` hasn't stopped accepting
@@ -85,42 +92,180 @@ void master_t<protocol_t>::client_t::perform_request(
             return;
         }
 
-        fifo_enforcer_sink_t::exit_write_t exiter(&fifo_sink, write->fifo_token);
-        parent->broadcaster->spawn_write(write->write, &exiter, write->order_token, &write_callback, interruptor, parent->ack_checker);
-
-        wait_any_t waiter(&write_callback.done_cond, write_callback.response_promise.get_ready_signal());
-        /* Now that we've called `spawn_write()`, we've added another entry to
-        the broadcaster's write queue, and that entry will remain there until
-        `on_done()` is called on the write callback above. If we were to respect
-        `interruptor` here, then when we bailed out our multi-throttler ticket
-        would be returned to the free pool. Then if clients repeatedly
-        connected, sent a bunch of operations, and then disconnected, then the
-        broadcaster's write queue would grow without bound. So instead we use
-        our parent's `shutting_down` signal as the interruptor. That way we
-        won't bail out unless we're actually shutting down the broadcaster too.
-        */
-        wait_interruptible(&waiter, &parent->shutdown_cond);
-
-        typename protocol_t::write_response_t write_response;
-        if (write_callback.response_promise.try_get_value(&write_response)) {
-            send(parent->mailbox_manager, write->cont_addr,
-                 boost::variant<typename protocol_t::write_response_t, std::string>(write_response));
-        } else {
-            guarantee(write_callback.done_cond.is_pulsed());
-            send(parent->mailbox_manager, write->cont_addr,
-                 boost::variant<typename protocol_t::write_response_t, std::string>("not enough replicas responded"));
+        boost::shared_ptr<queued_write_t> queued(
+            new queued_write_t(write->write, write->order_token));
+        const ticks_t received = get_ticks();
+        ticks_t in_order;
+        {
+            /* The queue keeps the writes of every client in the order of its
+            FIFO tokens, so that's the order they get to the broadcaster in. */
+            fifo_enforcer_sink_t::exit_write_t exiter(&fifo_sink, write->fifo_token,
+                                                      &master_write_fifo_lock_site);
+            wait_interruptible(&exiter, interruptor);
+            in_order = get_ticks();
+            parent->enqueue_write(queued);
+        }
+
+        /* Once the write is in the queue, it will get to the broadcaster's
+        write queue, and that entry will remain there until `on_done()` is
+        called on its write callback. If we were to respect `interruptor` here,
+        then when we bailed out our multi-throttler ticket would be returned to
+        the free pool. Then if clients repeatedly connected, sent a bunch of
+        operations, and then disconnected, then the broadcaster's write queue
+        would grow without bound. So instead we use our parent's `shutting_down`
+        signal as the interruptor. That way we won't bail out unless we're
+        actually shutting down the broadcaster too. */
+        wait_interruptible(queued->reply.get_ready_signal(), &parent->shutdown_cond);
+        boost::variant<typename protocol_t::write_response_t, std::string> reply
+            = queued->reply.wait();
+        if (typename protocol_t::write_response_t *resp
+                = boost::get<typename protocol_t::write_response_t>(&reply)) {
+            write->write.profile_master(received, in_order, resp);
         }
+        send(parent->mailbox_manager, write->cont_addr, reply);
 
         /* When we return, our multi-throttler ticket will be returned to the
         free pool. So don't return until the entry that we made on the
         broadcaster's write queue is gone. */
-        wait_interruptible(&write_callback.done_cond, &parent->shutdown_cond);
+        wait_interruptible(&queued->done, &parent->shutdown_cond);
 
     } else {
         unreachable();
     }
 }
 
+template <class protocol_t>
+void master_t<protocol_t>::combined_write_t::on_response(
+        peer_id_t peer, const typename protocol_t::write_response_t &response) {
+    if (!response_promise.get_ready_signal()->is_pulsed()) {
+        ASSERT_NO_CORO_WAITING;
+        ack_set.insert(peer);
+        // TODO: Having this centralized ack checker is horrible?  But maybe it's ok.
+        bool is_acceptable = ack_checker->is_acceptable_ack_set(ack_set);
+        if (is_acceptable) {
+            response_promise.pulse(response);
+        }
+    }
+}
+
+template <class protocol_t>
+void master_t<protocol_t>::combined_write_t::on_done() {
+    done_cond.pulse();
+}
+
+template <class protocol_t>
+void master_t<protocol_t>::enqueue_write(const boost::shared_ptr<queued_write_t> &queued) {
+    write_queue.push_back(queued);
+    if (!combiner_running) {
+        combiner_running = true;
+        coro_t::spawn_sometime(boost::bind(&master_t<protocol_t>::combine_writes, this,
+                                           auto_drainer_t::lock_t(&drainer)));
+    }
+}
+
+template <class protocol_t>
+void master_t<protocol_t>::combine_writes(auto_drainer_t::lock_t keepalive) {
+    try {
+        while (!write_queue.empty()) {
+            if (write_queue.front()->write.is_combinable()) {
+                /* The longer the broadcaster is busy, the more writes pile up
+                behind this one to be combined with it. */
+                while (writes_in_flight >= MASTER_MAX_COMBINED_WRITES_IN_FLIGHT) {
+                    cond_t slot;
+                    assignment_sentry_t<cond_t *> slot_sentry(&write_slot_cond, &slot);
+                    wait_interruptible(&slot, keepalive.get_drain_signal());
+                }
+            }
+
+            boost::shared_ptr<queued_write_t> head = write_queue.front();
+            write_queue.pop_front();
+            std::vector<boost::shared_ptr<queued_write_t> > batch(1, head);
+            if (head->write.is_combinable()) {
+                /* Only adjacent writes are combined, so that none of them gets
+                ahead of a write that was queued before it. */
+                while (!write_queue.empty()
+                       && batch.size() < MASTER_MAX_COMBINED_WRITES
+                       && write_queue.front()->write.is_combinable()
+                       && write_queue.front()->write.can_combine_with(head->write)) {
+                    batch.push_back(write_queue.front());
+                    write_queue.pop_front();
+                }
+            }
+
+            scoped_ptr_t<combined_write_t> combined(new combined_write_t(ack_checker, batch));
+            fifo_enforcer_sink_t::exit_write_t exiter(&combined_fifo_sink,
+                                                      combined_fifo_source.enter_write());
+            if (batch.size() == 1) {
+                broadcaster->spawn_write(head->write, &exiter, head->order_token,
+                                         combined.get(), keepalive.get_drain_signal(),
+                                         ack_checker);
+            } else {
+                std::vector<const typename protocol_t::write_t *> writes;
+                writes.reserve(batch.size());
+                for (size_t i = 0; i < batch.size(); ++i) {
+                    writes.push_back(&batch[i]->write);
+                }
+                broadcaster->spawn_write(protocol_t::write_t::combine(writes), &exiter,
+                                         head->order_token, combined.get(),
+                                         keepalive.get_drain_signal(), ack_checker);
+            }
+            ++writes_in_flight;
+            coro_t::spawn_sometime(boost::bind(&master_t<protocol_t>::finish_combined_write,
+                                               this, combined.release(), keepalive));
+        }
+    } catch (const interrupted_exc_t &) {
+        /* We're shutting down, and so are the clients waiting for the writes
+        still in the queue. */
+    }
+    combiner_running = false;
+}
+
+template <class protocol_t>
+void master_t<protocol_t>::finish_combined_write(combined_write_t *combined_ptr,
+                                                 auto_drainer_t::lock_t keepalive) {
+    scoped_ptr_t<combined_write_t> combined(combined_ptr);
+    const std::vector<boost::shared_ptr<queued_write_t> > &batch = combined->batch;
+    try {
+        wait_any_t waiter(&combined->done_cond,
+                          combined->response_promise.get_ready_signal());
+        wait_interruptible(&waiter, keepalive.get_drain_signal());
+
+        --writes_in_flight;
+        if (write_slot_cond != NULL) {
+            write_slot_cond->pulse_if_not_already_pulsed();
+        }
+
+        typename protocol_t::write_response_t response;
+        if (combined->response_promise.try_get_value(&response)) {
+            if (batch.size() == 1) {
+                batch[0]->reply.pulse(
+                    boost::variant<typename protocol_t::write_response_t, std::string>(response));
+            } else {
+                std::vector<typename protocol_t::write_response_t> responses;
+                batch[0]->write.split_combined_response(response, batch.size(), &responses);
+                for (size_t i = 0; i < batch.size(); ++i) {
+                    batch[i]->reply.pulse(
+                        boost::variant<typename protocol_t::write_response_t, std::string>(
+                            responses[i]));
+                }
+            }
+        } else {
+            guarantee(combined->done_cond.is_pulsed());
+            for (size_t i = 0; i < batch.size(); ++i) {
+                batch[i]->reply.pulse(
+                    boost::variant<typename protocol_t::write_response_t, std::string>(
+                        "not enough replicas responded"));
+            }
+        }
+
+        wait_interruptible(&combined->done_cond, keepalive.get_drain_signal());
+        for (size_t i = 0; i < batch.size(); ++i) {
+            batch[i]->done.pulse();
+        }
+    } catch (const interrupted_exc_t &) {
+        /* We're shutting down. */
+    }
+}
 
 #include "memcached/protocol.hpp"
 template class master_t<memcached_protocol_t>;
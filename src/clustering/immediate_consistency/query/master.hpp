@@ -2,14 +2,22 @@
 #ifndef CLUSTERING_IMMEDIATE_CONSISTENCY_QUERY_MASTER_HPP_
 #define CLUSTERING_IMMEDIATE_CONSISTENCY_QUERY_MASTER_HPP_
 
+#include <deque>
 #include <map>
 #include <set>
 #include <string>
 #include <utility>
+#include <vector>
+
+#include "errors.hpp"
+#include <boost/shared_ptr.hpp>
 
 #include "clustering/generic/multi_throttling_server.hpp"
 #include "clustering/immediate_consistency/branch/broadcaster.hpp"
 #include "clustering/immediate_consistency/query/master_metadata.hpp"
+#include "concurrency/auto_drainer.hpp"
+#include "concurrency/promise.hpp"
+#include "perfmon/perfmon.hpp"
 
 /* Each shard has a `master_t` on its primary machine. The `master_t` is
 responsible for receiving queries from the machines that the clients connect to
@@ -18,13 +26,28 @@ and forwarding those queries to the `broadcaster_t`. Specifically, the class
 sends the queries to the `master_t`.
 
 `master_t` internally contains a `multi_throttling_server_t`, which is
-responsible for throttling queries from the different `master_access_t`s. */
+responsible for throttling queries from the different `master_access_t`s.
+
+Writes don't go to the `broadcaster_t` straight away but through a queue, in the
+order of their clients' FIFO tokens. While there are
+`MASTER_MAX_COMBINED_WRITES_IN_FLIGHT` writes in the broadcaster, combinable
+writes wait in the queue, and when a slot frees up the ones that can be combined
+with the first of them (see `write_t::is_combinable()`) go to the broadcaster as
+a single write, which is a single round trip to every replica.
+
+The reads and writes per second that a `master_t` serves go in the "master"
+collection of its perfmon collection, which is how `auto_sharder_t` tells hot
+shards apart. */
 
 class ack_checker_t : public home_thread_mixin_t {
 public:
     virtual bool is_acceptable_ack_set(const std::set<peer_id_t> &acks) = 0;
     virtual write_durability_t get_write_durability(const peer_id_t &peer) const = 0;
 
+    /* The table's "max_backfill_mb_per_sec" in bytes, or 0 for no limit.  See
+    `backfill_governor_t`. */
+    virtual int64_t get_backfill_bytes_per_sec() const { return 0; }
+
     ack_checker_t() { }
 protected:
     virtual ~ack_checker_t() { }
@@ -39,7 +62,8 @@ class master_t {
 public:
     master_t(mailbox_manager_t *mm, ack_checker_t *ac,
              typename protocol_t::region_t r,
-             broadcaster_t<protocol_t> *b) THROWS_ONLY(interrupted_exc_t);
+             broadcaster_t<protocol_t> *b,
+             perfmon_collection_t *parent_perfmon_collection) THROWS_ONLY(interrupted_exc_t);
 
     ~master_t();
 
@@ -61,14 +85,66 @@ private:
         fifo_enforcer_sink_t fifo_sink;
     };
 
+    /* A write of a client waiting in `write_queue` or in the broadcaster. */
+    class queued_write_t {
+    public:
+        queued_write_t(const typename protocol_t::write_t &w, order_token_t tok)
+            : write(w), order_token(tok) { }
+        typename protocol_t::write_t write;
+        order_token_t order_token;
+        promise_t<boost::variant<typename protocol_t::write_response_t, std::string> > reply;
+        /* Pulsed when the write is gone from the broadcaster's write queue. */
+        cond_t done;
+    };
+
+    /* One or more queued writes sent to the broadcaster as one write. */
+    class combined_write_t : public broadcaster_t<protocol_t>::write_callback_t {
+    public:
+        combined_write_t(ack_checker_t *ac,
+                         const std::vector<boost::shared_ptr<queued_write_t> > &b)
+            : ack_checker(ac), batch(b) { }
+        void on_response(peer_id_t peer, const typename protocol_t::write_response_t &response);
+        void on_done();
+
+        ack_checker_t *ack_checker;
+        std::vector<boost::shared_ptr<queued_write_t> > batch;
+        std::set<peer_id_t> ack_set;
+        promise_t<typename protocol_t::write_response_t> response_promise;
+        cond_t done_cond;
+    };
+
+    void enqueue_write(const boost::shared_ptr<queued_write_t> &queued);
+    void combine_writes(auto_drainer_t::lock_t keepalive);
+    void finish_combined_write(combined_write_t *combined, auto_drainer_t::lock_t keepalive);
+
     mailbox_manager_t *mailbox_manager;
     ack_checker_t *ack_checker;
     broadcaster_t<protocol_t> *broadcaster;
     typename protocol_t::region_t region;
 
+    perfmon_collection_t master_collection;
+    perfmon_membership_t master_membership;
+    perfmon_rate_monitor_t pm_reads, pm_writes;
+    perfmon_multi_membership_t pm_membership;
+
     /* See note in `client_t::perform_request()` for what this is about */
     cond_t shutdown_cond;
 
+    std::deque<boost::shared_ptr<queued_write_t> > write_queue;
+    bool combiner_running;
+    int writes_in_flight;
+    /* Pulsed when `writes_in_flight` goes down, if `combine_writes()` is waiting
+    for it to. */
+    cond_t *write_slot_cond;
+    /* The combined writes come from a single source, so they get tokens of their
+    own for the broadcaster. */
+    fifo_enforcer_source_t combined_fifo_source;
+    fifo_enforcer_sink_t combined_fifo_sink;
+
+    /* Destroyed after `multi_throttling_server`, so that no client enqueues a
+    write once it's draining. */
+    auto_drainer_t drainer;
+
     multi_throttling_server_t<
             typename master_business_card_t<protocol_t>::request_t,
             typename master_business_card_t<protocol_t>::inner_client_business_card_t,
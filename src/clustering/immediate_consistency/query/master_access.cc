@@ -6,10 +6,23 @@
 #include "arch/timing.hpp"
 #include "concurrency/promise.hpp"
 #include "containers/archive/boost_types.hpp"
+#include "perfmon/perfmon.hpp"
 
 // TODO: Was this macro supposed to be used?
 // #define THROTTLE_THRESHOLD 200
 
+// How long it takes from sending a request to the master until its reply (or the
+// loss of the master) comes back, over all the masters this machine talks to.
+static perfmon_hdr_histogram_t pm_master_read_round_trip(
+    secs_to_ticks(LATENCY_PERCENTILES_INTERVAL_SECS), LATENCY_PERCENTILES_RESOLUTION_SECS);
+static perfmon_hdr_histogram_t pm_master_write_round_trip(
+    secs_to_ticks(LATENCY_PERCENTILES_INTERVAL_SECS), LATENCY_PERCENTILES_RESOLUTION_SECS);
+static perfmon_multi_membership_t pm_master_round_trip_membership(
+    &get_global_perfmon_collection(),
+    &pm_master_read_round_trip, "master_read_round_trip",
+    &pm_master_write_round_trip, "master_write_round_trip",
+    NULL);
+
 template <class protocol_t>
 master_access_t<protocol_t>::master_access_t(
         mailbox_manager_t *mm,
@@ -71,10 +84,12 @@ void master_access_t<protocol_t>::read(
         token_for_master,
         result_or_failure_mailbox.get_address());
 
+    const ticks_t start_time = get_ticks();
     multi_throttling_client.spawn_request(read_request, &ticket, interruptor);
 
     wait_any_t waiter(result_or_failure.get_ready_signal(), get_failed_signal());
     wait_interruptible(&waiter, interruptor);
+    pm_master_read_round_trip.record(ticks_to_secs(get_ticks() - start_time));
 
     if (result_or_failure.is_pulsed()) {
         if (const std::string *error
@@ -84,6 +99,7 @@ void master_access_t<protocol_t>::read(
                 boost::get<typename protocol_t::read_response_t>(
                     &result_or_failure.wait())) {
             *response = *result;
+            read.profile_round_trip(start_time, response);
         } else {
             unreachable();
         }
@@ -126,10 +142,12 @@ void master_access_t<protocol_t>::write(
         token_for_master,
         result_or_failure_mailbox.get_address());
 
+    const ticks_t start_time = get_ticks();
     multi_throttling_client.spawn_request(write_request, &ticket, interruptor);
 
     wait_any_t waiter(result_or_failure.get_ready_signal(), get_failed_signal());
     wait_interruptible(&waiter, interruptor);
+    pm_master_write_round_trip.record(ticks_to_secs(get_ticks() - start_time));
 
     if (result_or_failure.get_ready_signal()->is_pulsed()) {
         if (const std::string *error = boost::get<std::string>(&result_or_failure.wait())) {
@@ -137,6 +155,7 @@ void master_access_t<protocol_t>::write(
         } else if (const typename protocol_t::write_response_t *result =
                 boost::get<typename protocol_t::write_response_t>(&result_or_failure.wait())) {
             *response = *result;
+            write.profile_round_trip(start_time, response);
         } else {
             unreachable();
         }
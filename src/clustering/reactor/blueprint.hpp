@@ -7,8 +7,12 @@
 #include "rpc/connectivity/connectivity.hpp"
 #include "rpc/serialize_macros.hpp"
 
-enum blueprint_role_t { blueprint_role_primary, blueprint_role_secondary, blueprint_role_nothing };
-ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(blueprint_role_t, int8_t, blueprint_role_primary, blueprint_role_nothing);
+/* An async secondary follows the primary like a secondary, but its acks never
+count towards a write's acks and writes don't wait for it (up to
+`ASYNC_REPLICA_MAX_LAG_BYTES` of lag), which is what a replica in a far away
+datacenter needs. In return, nothing backfills from it while it follows. */
+enum blueprint_role_t { blueprint_role_primary, blueprint_role_secondary, blueprint_role_nothing, blueprint_role_async_secondary };
+ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(blueprint_role_t, int8_t, blueprint_role_primary, blueprint_role_async_secondary);
 
 // Explain what a blueprint_t is here please.
 
@@ -84,23 +84,28 @@ public:
     RDB_MAKE_ME_SERIALIZABLE_4(broadcaster, replier, master, direct_reader);
 };
 
-/* This peer is currently a secondary in working order. */
+/* This peer is currently a secondary in working order. If `is_async`, it is an
+async secondary (see `blueprint_role_async_secondary`); it may lag behind the
+primary, so `replier` is empty and nobody may backfill from it. */
 template <class protocol_t>
 class secondary_up_to_date_t {
 public:
     secondary_up_to_date_t(branch_id_t _branch_id,
             replier_business_card_t<protocol_t> _replier,
-            direct_reader_business_card_t<protocol_t> _direct_reader)
-        : branch_id(_branch_id), replier(_replier), direct_reader(_direct_reader)
+            direct_reader_business_card_t<protocol_t> _direct_reader,
+            bool _is_async)
+        : branch_id(_branch_id), replier(_replier), direct_reader(_direct_reader),
+          is_async(_is_async)
     { }
 
-    secondary_up_to_date_t() { }
+    secondary_up_to_date_t() : is_async(false) { }
 
     branch_id_t branch_id;
     replier_business_card_t<protocol_t> replier;
     direct_reader_business_card_t<protocol_t> direct_reader;
+    bool is_async;
 
-    RDB_MAKE_ME_SERIALIZABLE_3(branch_id, replier, direct_reader);
+    RDB_MAKE_ME_SERIALIZABLE_4(branch_id, replier, direct_reader, is_async);
 };
 
 /* This peer would like to be a secondary but cannot because it failed to
@@ -3,6 +3,7 @@
 #include "clustering/immediate_consistency/query/master_access.hpp"
 #include "concurrency/fifo_enforcer.hpp"
 #include "concurrency/watchable.hpp"
+#include "config/args.hpp"
 
 template <class protocol_t>
 cluster_namespace_interface_t<protocol_t>::cluster_namespace_interface_t(
@@ -12,6 +13,7 @@ cluster_namespace_interface_t<protocol_t>::cluster_namespace_interface_t(
     : mailbox_manager(mm),
       directory_view(dv),
       ctx(_ctx),
+      master_routes_valid(false),
       start_count(0),
       watcher_subscription(new watchable_subscription_t<std::map<peer_id_t, cow_ptr_t<reactor_business_card_t<protocol_t> > > >(boost::bind(&cluster_namespace_interface_t::update_registrants, this, false))) {
     {
@@ -50,7 +52,20 @@ void cluster_namespace_interface_t<protocol_t>::read_outdated(const typename pro
     /* This seems kind of silly. We do it this way because
        `dispatch_outdated_read` needs to be able to see `outdated_read_info_t`,
        which is defined in the `private` section. */
+    store_key_t coalescing_key;
+    if (!r.coalescing_key(&coalescing_key)) {
+        dispatch_outdated_read(r, response, interruptor);
+        return;
+    }
+    typename single_flight_t<store_key_t, typename protocol_t::read_response_t>::ticket_t
+        ticket(&coalesced_outdated_reads, coalescing_key);
+    if (!ticket.is_leader() && ticket.wait(response, interruptor)) {
+        return;
+    }
     dispatch_outdated_read(r, response, interruptor);
+    if (ticket.is_leader()) {
+        ticket.succeed(*response);
+    }
 }
 
 template <class protocol_t>
@@ -81,6 +96,61 @@ cluster_namespace_interface_t<protocol_t>::get_sharding_scheme() THROWS_ONLY(can
     return std::set<typename protocol_t::region_t>(s.begin(), s.end());
 }
 
+template <class protocol_t>
+const std::vector<typename cluster_namespace_interface_t<protocol_t>::master_route_t> &
+cluster_namespace_interface_t<protocol_t>::get_master_routes() {
+    if (master_routes_valid) {
+        return master_routes;
+    }
+
+    /* The pieces of `relationships` that have exactly one master, grouped by
+    that master, and the routes for the pieces that don't. */
+    std::map<relationship_t *, std::vector<typename protocol_t::region_t> > by_master;
+    std::vector<master_route_t> routes;
+    for (auto it = relationships.begin(); it != relationships.end(); ++it) {
+        master_route_t route;
+        route.region = it->first;
+        route.master = NULL;
+        route.error = NULL;
+        for (auto jt = it->second.begin(); jt != it->second.end(); ++jt) {
+            if ((*jt)->master_access) {
+                if (route.master) {
+                    route.error = "Too many masters available";
+                }
+                route.master = *jt;
+            }
+        }
+        if (!route.master) {
+            route.error = "No master available";
+        }
+        if (route.error == NULL) {
+            by_master[route.master].push_back(route.region);
+        } else {
+            routes.push_back(route);
+        }
+    }
+
+    for (auto it = by_master.begin(); it != by_master.end(); ++it) {
+        master_route_t route;
+        route.master = it->first;
+        route.error = NULL;
+        if (region_join(it->second, &route.region) == REGION_JOIN_OK) {
+            routes.push_back(route);
+        } else {
+            /* The pieces don't make up a region we can express, so they have
+            to keep their own routes. */
+            for (auto jt = it->second.begin(); jt != it->second.end(); ++jt) {
+                route.region = *jt;
+                routes.push_back(route);
+            }
+        }
+    }
+
+    master_routes.swap(routes);
+    master_routes_valid = true;
+    return master_routes;
+}
+
 template <class protocol_t>
 template<class op_type, class fifo_enforcer_token_type, class op_response_type>
 void cluster_namespace_interface_t<protocol_t>::dispatch_immediate_op(
@@ -106,23 +176,13 @@ void cluster_namespace_interface_t<protocol_t>::dispatch_immediate_op(
         masters_to_contact;
     scoped_ptr_t<immediate_op_info_t<op_type, fifo_enforcer_token_type> >
         new_op_info(new immediate_op_info_t<op_type, fifo_enforcer_token_type>());
-    for (auto it = relationships.begin(); it != relationships.end(); ++it) {
-        if (op.shard(it->first, &new_op_info->sharded_op)) {
-            relationship_t *chosen_relationship = NULL;
-            const std::set<relationship_t *> *relationship_map = &it->second;
-            for (auto jt = relationship_map->begin();
-                 jt != relationship_map->end();
-                 ++jt) {
-                if ((*jt)->master_access) {
-                    if (chosen_relationship) {
-                        throw cannot_perform_query_exc_t("Too many masters available");
-                    }
-                    chosen_relationship = *jt;
-                }
-            }
-            if (!chosen_relationship) {
-                throw cannot_perform_query_exc_t("No master available");
+    const std::vector<master_route_t> &routes = get_master_routes();
+    for (auto it = routes.begin(); it != routes.end(); ++it) {
+        if (op.shard(it->region, &new_op_info->sharded_op)) {
+            if (it->error != NULL) {
+                throw cannot_perform_query_exc_t(it->error);
             }
+            relationship_t *chosen_relationship = it->master;
             new_op_info->master_access = chosen_relationship->master_access;
             (new_op_info->master_access->*how_to_make_token)(
                 &new_op_info->enforcement_token);
@@ -233,15 +293,14 @@ cluster_namespace_interface_t<protocol_t>::dispatch_outdated_read(
                 }
             }
             if (!chosen_relationship && !potential_relationships.empty()) {
-                chosen_relationship
-                    = potential_relationships[
-                        distributor_rng.randint(potential_relationships.size())];
+                chosen_relationship = choose_direct_reader(potential_relationships);
             }
             if (!chosen_relationship) {
                 /* Don't bother looking for masters; if there are no direct
                    readers, there won't be any masters either. */
                 throw cannot_perform_query_exc_t("No direct reader available");
             }
+            new_op_info->relationship = chosen_relationship;
             new_op_info->direct_reader_access
                 = chosen_relationship->direct_reader_access;
             new_op_info->keepalive = auto_drainer_t::lock_t(
@@ -267,6 +326,27 @@ cluster_namespace_interface_t<protocol_t>::dispatch_outdated_read(
     op.unshard(results.data(), results.size(), response, ctx, interruptor);
 }
 
+template <class protocol_t>
+typename cluster_namespace_interface_t<protocol_t>::relationship_t *
+cluster_namespace_interface_t<protocol_t>::choose_direct_reader(
+    const std::vector<relationship_t *> &candidates) {
+    guarantee(!candidates.empty());
+    relationship_t *first = candidates[distributor_rng.randint(candidates.size())];
+    if (candidates.size() == 1) {
+        return first;
+    }
+    relationship_t *second = first;
+    while (second == first) {
+        second = candidates[distributor_rng.randint(candidates.size())];
+    }
+    /* A replica we haven't timed yet costs nothing, so it gets tried. */
+    double first_cost = (first->outstanding_outdated_reads + 1)
+        * first->outdated_read_latency_secs;
+    double second_cost = (second->outstanding_outdated_reads + 1)
+        * second->outdated_read_latency_secs;
+    return second_cost < first_cost ? second : first;
+}
+
 template <class protocol_t>
 void outdated_read_store_result(typename protocol_t::read_response_t *result_out, const typename protocol_t::read_response_t &result_in, cond_t *done) {
     *result_out = result_in;
@@ -283,6 +363,9 @@ void cluster_namespace_interface_t<protocol_t>::perform_outdated_read(
     THROWS_NOTHING
 {
     outdated_read_info_t *direct_reader_to_contact = &(*direct_readers_to_contact)[i];
+    relationship_t *relationship = direct_reader_to_contact->relationship;
+    ++relationship->outstanding_outdated_reads;
+    const ticks_t start_ticks = get_ticks();
 
     try {
         cond_t done;
@@ -293,6 +376,10 @@ void cluster_namespace_interface_t<protocol_t>::perform_outdated_read(
         wait_any_t waiter(direct_reader_to_contact->direct_reader_access->get_failed_signal(), &done);
         wait_interruptible(&waiter, interruptor);
         direct_reader_to_contact->direct_reader_access->access();   /* throws if `get_failed_signal()->is_pulsed()` */
+        const double latency_secs = ticks_to_secs(get_ticks() - start_ticks);
+        relationship->outdated_read_latency_secs +=
+            OUTDATED_READ_LATENCY_WEIGHT
+            * (latency_secs - relationship->outdated_read_latency_secs);
     } catch (const resource_lost_exc_t &) {
         failures->at(i).assign("lost contact with direct reader");
     } catch (const interrupted_exc_t &) {
@@ -301,6 +388,7 @@ void cluster_namespace_interface_t<protocol_t>::perform_outdated_read(
            `read_outdated()` will notice that the interruptor has been pulsed
            and won't try to access our result. */
     }
+    --relationship->outstanding_outdated_reads;
 }
 
 template <class protocol_t>
@@ -433,10 +521,13 @@ void cluster_namespace_interface_t<protocol_t>::relationship_coroutine(peer_id_t
         relationship_record.region = region;
         relationship_record.master_access = master_access.has() ? master_access.get() : NULL;
         relationship_record.direct_reader_access = direct_reader_access.has() ? direct_reader_access.get() : NULL;
+        relationship_record.outstanding_outdated_reads = 0;
+        relationship_record.outdated_read_latency_secs = 0;
 
         region_map_set_membership_t<protocol_t, relationship_t *> relationship_map_insertion(&relationships,
                                                                                              region,
                                                                                              &relationship_record);
+        master_routes_valid = false;
 
         if (is_start) {
             guarantee(start_count > 0);
@@ -462,6 +553,9 @@ void cluster_namespace_interface_t<protocol_t>::relationship_coroutine(peer_id_t
         /* ignore */
     }
 
+    /* `relationship_map_insertion` has taken our relationship out again. */
+    master_routes_valid = false;
+
     if (is_start) {
         guarantee(start_count > 0);
         start_count--;
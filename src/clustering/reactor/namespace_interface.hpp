@@ -14,6 +14,7 @@
 #include <boost/ptr_container/ptr_vector.hpp>
 
 #include "arch/timing.hpp"
+#include "btree/keys.hpp"
 #include "clustering/generic/resource.hpp"
 #include "clustering/reactor/metadata.hpp"
 #include "containers/clone_ptr.hpp"
@@ -21,6 +22,7 @@
 #include "concurrency/fifo_enforcer.hpp"
 #include "concurrency/pmap.hpp"
 #include "concurrency/promise.hpp"
+#include "concurrency/single_flight.hpp"
 #include "concurrency/watchable.hpp"
 #include "protocol_api.hpp"
 
@@ -88,9 +90,33 @@ private:
         typename protocol_t::region_t region;
         master_access_t<protocol_t> *master_access;
         resource_access_t<direct_reader_business_card_t<protocol_t> > *direct_reader_access;
+
+        /* How many outdated reads this replica is working on for us, and a
+        moving average of how long they take. `choose_direct_reader()` uses
+        these to steer reads away from slow replicas. */
+        int outstanding_outdated_reads;
+        double outdated_read_latency_secs;
+
         auto_drainer_t drainer;
     };
 
+    /* Where reads and writes for a part of the table go. `relationships` gets
+    split into more and more pieces as masters come and go, so rather than
+    choosing a master for every piece on every query, `get_master_routes()`
+    computes the routes once and merges the pieces that go to the same master.
+    `error` is the message to fail with if an operation touches `region`; it is
+    NULL if `master` is the one master for it. */
+    class master_route_t {
+    public:
+        typename protocol_t::region_t region;
+        relationship_t *master;
+        const char *error;
+    };
+
+    /* The routes are recomputed after `relationships` changes, which is when
+    the directory shows a master or replica coming or going. */
+    const std::vector<master_route_t> &get_master_routes();
+
     /* The code for handling immediate reads is 99% the same as the code for
     handling writes, so it's factored out into the `dispatch_immediate_op()`
     function. */
@@ -107,6 +133,7 @@ private:
     class outdated_read_info_t {
     public:
         typename protocol_t::read_t sharded_op;
+        relationship_t *relationship;
         resource_access_t<direct_reader_business_card_t<protocol_t> > *direct_reader_access;
         auto_drainer_t::lock_t keepalive;
     };
@@ -143,6 +170,10 @@ private:
             signal_t *interruptor)
         THROWS_ONLY(interrupted_exc_t, cannot_perform_query_exc_t);
 
+    /* Picks the less loaded of two random replicas, judging by how many reads
+    each is working on and how long its reads take. */
+    relationship_t *choose_direct_reader(const std::vector<relationship_t *> &candidates);
+
     void perform_outdated_read(
             boost::ptr_vector<outdated_read_info_t> *direct_readers_to_contact,
             std::vector<typename protocol_t::read_response_t> *results,
@@ -163,6 +194,11 @@ private:
                                 bool is_start, bool is_primary, const typename protocol_t::region_t &region,
                                 auto_drainer_t::lock_t lock) THROWS_NOTHING;
 
+    /* Outdated reads may see any recent state of the table anyway, so equal ones
+    that are running at once share their response. */
+    single_flight_t<store_key_t, typename protocol_t::read_response_t>
+        coalesced_outdated_reads;
+
     mailbox_manager_t *mailbox_manager;
     clone_ptr_t<watchable_t<std::map<peer_id_t, cow_ptr_t<reactor_business_card_t<protocol_t> > > > > directory_view;
     typename protocol_t::context_t *ctx;
@@ -172,6 +208,9 @@ private:
     std::set<reactor_activity_id_t> handled_activity_ids;
     region_map_t<protocol_t, std::set<relationship_t *> > relationships;
 
+    std::vector<master_route_t> master_routes;
+    bool master_routes_valid;
+
     /* `start_cond` will be pulsed when we have either successfully connected to
     or tried and failed to connect to every peer present when the constructor
     was called. `start_count` is the number of peers we're still waiting for. */
@@ -190,7 +190,10 @@ void reactor_t<protocol_t>::run_cpu_sharded_role(
         be_primary(cpu_sharded_region, store_view, role->blueprint.get_watchable(), interruptor);
         break;
     case blueprint_role_secondary:
-        be_secondary(cpu_sharded_region, store_view, role->blueprint.get_watchable(), interruptor);
+        be_secondary(cpu_sharded_region, store_view, role->blueprint.get_watchable(), false, interruptor);
+        break;
+    case blueprint_role_async_secondary:
+        be_secondary(cpu_sharded_region, store_view, role->blueprint.get_watchable(), true, interruptor);
         break;
     case blueprint_role_nothing:
         be_nothing(cpu_sharded_region, store_view, role->blueprint.get_watchable(), interruptor);
@@ -130,10 +130,12 @@ private:
                                        clone_ptr_t<watchable_t<boost::optional<boost::optional<broadcaster_business_card_t<protocol_t> > > > > *broadcaster_out);
 
     bool find_replier_in_directory(const typename protocol_t::region_t &region, const branch_id_t &b_id, const blueprint_t<protocol_t> &bp, const std::map<peer_id_t, cow_ptr_t<reactor_business_card_t<protocol_t> > > &reactor_directory,
-                                      clone_ptr_t<watchable_t<boost::optional<boost::optional<replier_business_card_t<protocol_t> > > > > *replier_out, peer_id_t *peer_id_out, reactor_activity_id_t *activity_out);
+                                      std::vector<clone_ptr_t<watchable_t<boost::optional<boost::optional<replier_business_card_t<protocol_t> > > > > > *repliers_out, peer_id_t *peer_id_out, reactor_activity_id_t *activity_out);
 
+    /* An async secondary (`is_async`) follows the primary without a replier;
+    see `blueprint_role_async_secondary`. */
     void be_secondary(typename protocol_t::region_t region, store_view_t<protocol_t> *store, const clone_ptr_t<watchable_t<blueprint_t<protocol_t> > > &,
-            signal_t *interruptor) THROWS_NOTHING;
+            bool is_async, signal_t *interruptor) THROWS_NOTHING;
 
 
     /* Implemented in clustering/reactor/reactor_be_nothing.tcc */
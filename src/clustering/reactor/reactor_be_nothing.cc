@@ -1,6 +1,7 @@
 // Copyright 2010-2012 RethinkDB, all rights reserved.
 #include "clustering/reactor/reactor.hpp"
 
+#include "clustering/immediate_consistency/branch/backfill_governor.hpp"
 #include "clustering/immediate_consistency/branch/backfiller.hpp"
 #include "clustering/immediate_consistency/branch/replier.hpp"
 #include "concurrency/cross_thread_signal.hpp"
@@ -71,7 +72,8 @@ void reactor_t<protocol_t>::be_nothing(typename protocol_t::region_t region,
 
             /* We offer backfills while waiting for it to be safe to shutdown
              * in case another peer needs a copy of the data */
-            backfiller_t<protocol_t> backfiller(mailbox_manager, branch_history_manager, svs);
+            backfill_governor_t backfill_governor(ack_checker);
+            backfiller_t<protocol_t> backfiller(mailbox_manager, branch_history_manager, svs, &backfill_governor);
 
             /* Tell the other peers that we are looking to shutdown and
              * offering backfilling until we do. */
@@ -8,6 +8,7 @@
 #include <boost/ptr_container/ptr_vector.hpp>
 
 #include "clustering/administration/http/json_adapters.hpp"
+#include "clustering/immediate_consistency/branch/backfill_governor.hpp"
 #include "clustering/immediate_consistency/branch/backfillee.hpp"
 #include "clustering/immediate_consistency/branch/history.hpp"
 #include "clustering/immediate_consistency/branch/listener.hpp"
@@ -271,7 +272,9 @@ void do_backfill(
         cross_thread_signal_t ct_interruptor(interruptor, svs->home_thread());
         on_thread_t th(svs->home_thread());
 
-        backfillee<protocol_t>(mailbox_manager, branch_history_manager, svs, region, ct_backfiller_metadata.get_watchable(), backfill_session_id, &ct_interruptor);
+        /* We don't serve any queries for the region yet, so there is nothing
+        for a governor to make room for. */
+        backfillee<protocol_t>(mailbox_manager, branch_history_manager, svs, region, ct_backfiller_metadata.get_watchable(), backfill_session_id, NULL, &ct_interruptor);
 
         result = true;
     } catch (const interrupted_exc_t &) {
@@ -281,12 +284,6 @@ void do_backfill(
     success->pulse(result);
 }
 
-template <class protocol_t>
-bool check_that_we_see_our_broadcaster(const boost::optional<boost::optional<broadcaster_business_card_t<protocol_t> > > &maybe_a_business_card) {
-    guarantee(maybe_a_business_card, "Not connected to ourselves\n");
-    return maybe_a_business_card.get();
-}
-
 template <class protocol_t>
 bool reactor_t<protocol_t>::attempt_backfill_from_peers(directory_entry_t *directory_entry,
                                                         order_source_t *order_source,
@@ -335,6 +332,18 @@ bool reactor_t<protocol_t>::attempt_backfill_from_peers(directory_entry_t *direc
         }
     }
 
+    /* A secondary that was up to date has nothing to backfill, so it can go
+     * on to become the primary right away, without telling anyone. */
+    bool need_backfill = false;
+    for (typename best_backfiller_map_t::iterator it =  best_backfillers.begin();
+         it != best_backfillers.end();
+         ++it) {
+        need_backfill = need_backfill || !it->second.present_in_our_store;
+    }
+    if (!need_backfill) {
+        return true;
+    }
+
     /* We may be backfilling from several sources, each requires a
      * promise be passed in which gets pulsed with a value indicating
      * whether or not the backfill succeeded. */
@@ -414,8 +423,9 @@ void reactor_t<protocol_t>::be_primary(typename protocol_t::region_t region, sto
          * interrupted or we have backfilled the most up to date data. */
         while (!attempt_backfill_from_peers(&directory_entry, &order_source, region, svs, blueprint, interruptor)) { }
 
-        // TODO: Don't use local stack variable.
-        std::string region_name = strprintf("be_primary_%p", &region);
+        /* Named after the region, so that whoever reads the stats can tell which
+        shard they're for. */
+        std::string region_name = "be_primary_" + debug_strprint(region);
 
         cross_thread_signal_t ct_interruptor(interruptor, svs->home_thread());
         on_thread_t th(svs->home_thread());
@@ -423,32 +433,29 @@ void reactor_t<protocol_t>::be_primary(typename protocol_t::region_t region, sto
         perfmon_collection_t region_perfmon_collection;
         perfmon_membership_t region_perfmon_membership(&regions_perfmon_collection, &region_perfmon_collection, region_name);
 
-        broadcaster_t<protocol_t> broadcaster(mailbox_manager, branch_history_manager, svs, &region_perfmon_collection, &order_source, &ct_interruptor);
-
-        on_thread_t th2(this->home_thread());
-
-        directory_entry.set(typename reactor_business_card_t<protocol_t>::primary_t(broadcaster.get_business_card()));
-
-        clone_ptr_t<watchable_t<boost::optional<boost::optional<broadcaster_business_card_t<protocol_t> > > > > broadcaster_business_card =
-            get_directory_entry_view<typename reactor_business_card_t<protocol_t>::primary_t>(get_me(), directory_entry.get_reactor_activity_id())->
-                subview(&reactor_t<protocol_t>::extract_broadcaster_from_reactor_business_card_primary);
+        backfill_governor_t backfill_governor(ack_checker);
 
-        /* listener_t expects broadcaster to be visible in the directory at the
-         * time that it's constructed. It might take some time to propogate to
-         * ourselves after we've put it in the directory. */
-        broadcaster_business_card->run_until_satisfied(&check_that_we_see_our_broadcaster<protocol_t>, interruptor);
+        broadcaster_t<protocol_t> broadcaster(mailbox_manager, branch_history_manager, svs, &region_perfmon_collection, &order_source, &ct_interruptor);
 
-        cross_thread_watchable_variable_t<boost::optional<boost::optional<broadcaster_business_card_t<protocol_t> > > > ct_broadcaster_business_card(broadcaster_business_card, svs->home_thread());
+        /* Our own listener registers with the broadcaster right here, instead of
+         * waiting for the broadcaster to come back to us through the directory.
+         * The broadcaster can't go away while the listener is around, so the
+         * business card never changes. */
+        watchable_variable_t<boost::optional<boost::optional<broadcaster_business_card_t<protocol_t> > > > broadcaster_business_card(
+            boost::optional<boost::optional<broadcaster_business_card_t<protocol_t> > >(
+                boost::optional<broadcaster_business_card_t<protocol_t> >(broadcaster.get_business_card())));
 
-        on_thread_t th3(svs->home_thread());
-        listener_t<protocol_t> listener(base_path, io_backender, mailbox_manager, ct_broadcaster_business_card.get_watchable(), branch_history_manager, &broadcaster, &region_perfmon_collection, &ct_interruptor, &order_source);
+        listener_t<protocol_t> listener(base_path, io_backender, mailbox_manager, broadcaster_business_card.get_watchable(), branch_history_manager, &broadcaster, &region_perfmon_collection, &backfill_governor, &ct_interruptor, &order_source);
         replier_t<protocol_t> replier(&listener, mailbox_manager, branch_history_manager);
-        master_t<protocol_t> master(mailbox_manager, ack_checker, region, &broadcaster);
+        master_t<protocol_t> master(mailbox_manager, ack_checker, region, &broadcaster, &region_perfmon_collection);
         direct_reader_t<protocol_t> direct_reader(mailbox_manager, svs);
 
-        on_thread_t th4(this->home_thread());
+        on_thread_t th2(this->home_thread());
 
-        directory_entry.update_without_changing_id(
+        /* Everything goes in the directory at once, so the secondaries find our
+         * replier along with the broadcaster and start backfilling from it
+         * right away. */
+        directory_entry.set(
             typename reactor_business_card_t<protocol_t>::primary_t(
                 broadcaster.get_business_card(),
                 replier.get_business_card(),
@@ -1,6 +1,9 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "clustering/reactor/reactor.hpp"
 
+#include <boost/ptr_container/ptr_vector.hpp>
+
+#include "clustering/immediate_consistency/branch/backfill_governor.hpp"
 #include "clustering/immediate_consistency/branch/listener.hpp"
 #include "clustering/immediate_consistency/branch/replier.hpp"
 #include "clustering/immediate_consistency/query/direct_reader.hpp"
@@ -89,7 +92,7 @@ bool reactor_t<protocol_t>::find_replier_in_directory(
         const branch_id_t &b_id,
         const blueprint_t<protocol_t> &bp,
         const std::map<peer_id_t, cow_ptr_t<reactor_business_card_t<protocol_t> > > &_reactor_directory,
-        clone_ptr_t<watchable_t<boost::optional<boost::optional<replier_business_card_t<protocol_t> > > > > *replier_out,
+        std::vector<clone_ptr_t<watchable_t<boost::optional<boost::optional<replier_business_card_t<protocol_t> > > > > > *repliers_out,
         peer_id_t *peer_id_out,
         reactor_activity_id_t *activity_id_out) {
     std::vector<clone_ptr_t<watchable_t<boost::optional<boost::optional<replier_business_card_t<protocol_t> > > > > > backfill_candidates;
@@ -116,7 +119,9 @@ bool reactor_t<protocol_t>::find_replier_in_directory(
                             activity_ids.push_back(a_it->first);
                         }
                     } else if (const typename rb_t::secondary_up_to_date_t *secondary = boost::get<typename rb_t::secondary_up_to_date_t>(&a_it->second.activity)) {
-                        if (secondary->branch_id == b_id) {
+                        /* An async secondary may be missing writes that the
+                        broadcaster no longer has, so it can't be a source. */
+                        if (secondary->branch_id == b_id && !secondary->is_async) {
                             backfill_candidates.push_back(get_directory_entry_view<typename rb_t::secondary_up_to_date_t>(it->first, a_it->first)->
                                 subview(&extract_replier_from_reactor_business_card_secondary<protocol_t>));
                                 peer_ids.push_back(it->first);
@@ -134,8 +139,14 @@ bool reactor_t<protocol_t>::find_replier_in_directory(
     if (backfill_candidates.empty()) {
         return false;
     } else {
+        /* Backfill from up to `BACKFILL_MAX_SOURCES` of the candidates at
+        once, starting from a random one so that backfills are spread around.
+        The first one is the one we report progress for. */
         int selection = randint(backfill_candidates.size());
-        *replier_out = backfill_candidates[selection];
+        repliers_out->clear();
+        for (size_t i = 0; i < backfill_candidates.size() && i < BACKFILL_MAX_SOURCES; ++i) {
+            repliers_out->push_back(backfill_candidates[(selection + i) % backfill_candidates.size()]);
+        }
         *peer_id_out = peer_ids[selection];
         *activity_id_out = activity_ids[selection];
         return true;
@@ -143,7 +154,7 @@ bool reactor_t<protocol_t>::find_replier_in_directory(
 }
 
 template<class protocol_t>
-void reactor_t<protocol_t>::be_secondary(typename protocol_t::region_t region, store_view_t<protocol_t> *svs, const clone_ptr_t<watchable_t<blueprint_t<protocol_t> > > &blueprint, signal_t *interruptor) THROWS_NOTHING {
+void reactor_t<protocol_t>::be_secondary(typename protocol_t::region_t region, store_view_t<protocol_t> *svs, const clone_ptr_t<watchable_t<blueprint_t<protocol_t> > > &blueprint, bool is_async, signal_t *interruptor) THROWS_NOTHING {
     try {
         order_source_t order_source(svs->home_thread());  // TODO: order_token_t::ignore
 
@@ -152,7 +163,7 @@ void reactor_t<protocol_t>::be_secondary(typename protocol_t::region_t region, s
         directory_entry_t directory_entry(this, region);
         while (true) {
             clone_ptr_t<watchable_t<boost::optional<boost::optional<broadcaster_business_card_t<protocol_t> > > > > broadcaster;
-            clone_ptr_t<watchable_t<boost::optional<boost::optional<replier_business_card_t<protocol_t> > > > > location_to_backfill_from;
+            std::vector<clone_ptr_t<watchable_t<boost::optional<boost::optional<replier_business_card_t<protocol_t> > > > > > locations_to_backfill_from;
             branch_id_t branch_id;
             peer_id_t peer_id;
             reactor_activity_id_t activity_id;
@@ -168,7 +179,8 @@ void reactor_t<protocol_t>::be_secondary(typename protocol_t::region_t region, s
                  * Also this is potentially a performance boost because it
                  * allows other secondaries to preemptively backfill before the
                  * primary is up. */
-                backfiller_t<protocol_t> backfiller(mailbox_manager, branch_history_manager, svs);
+                backfill_governor_t backfill_governor(ack_checker);
+                backfiller_t<protocol_t> backfiller(mailbox_manager, branch_history_manager, svs, &backfill_governor);
 
                 /* Tell everyone in the cluster what state we're in. */
                 object_buffer_t<fifo_enforcer_sink_t::exit_read_t> read_token;
@@ -211,7 +223,7 @@ void reactor_t<protocol_t>::be_secondary(typename protocol_t::region_t region, s
                 run_until_satisfied_2(
                     directory_echo_mirror.get_internal(),
                     blueprint,
-                    boost::bind(&reactor_t<protocol_t>::find_replier_in_directory, this, region, branch_id, _2, _1, &location_to_backfill_from, &peer_id, &activity_id),
+                    boost::bind(&reactor_t<protocol_t>::find_replier_in_directory, this, region, branch_id, _2, _1, &locations_to_backfill_from, &peer_id, &activity_id),
                     interruptor);
 
                 /* Note, the backfiller goes out of scope here, that's because
@@ -234,7 +246,12 @@ void reactor_t<protocol_t>::be_secondary(typename protocol_t::region_t region, s
 
                 cross_thread_signal_t ct_interruptor(interruptor, svs->home_thread());
                 cross_thread_watchable_variable_t<boost::optional<boost::optional<broadcaster_business_card_t<protocol_t> > > > ct_broadcaster(broadcaster, svs->home_thread());
-                cross_thread_watchable_variable_t<boost::optional<boost::optional<replier_business_card_t<protocol_t> > > > ct_location_to_backfill_from(location_to_backfill_from, svs->home_thread());
+                boost::ptr_vector<cross_thread_watchable_variable_t<boost::optional<boost::optional<replier_business_card_t<protocol_t> > > > > ct_locations_to_backfill_from;
+                std::vector<typename listener_t<protocol_t>::replier_watchable_t> ct_replier_watchables;
+                for (size_t i = 0; i < locations_to_backfill_from.size(); ++i) {
+                    ct_locations_to_backfill_from.push_back(new cross_thread_watchable_variable_t<boost::optional<boost::optional<replier_business_card_t<protocol_t> > > >(locations_to_backfill_from[i], svs->home_thread()));
+                    ct_replier_watchables.push_back(ct_locations_to_backfill_from.back().get_watchable());
+                }
                 on_thread_t th(svs->home_thread());
 
                 // TODO: Don't use local stack variable for name.
@@ -242,13 +259,19 @@ void reactor_t<protocol_t>::be_secondary(typename protocol_t::region_t region, s
                 perfmon_collection_t region_perfmon_collection;
                 perfmon_membership_t region_perfmon_membership(&regions_perfmon_collection, &region_perfmon_collection, region_name);
 
+                backfill_governor_t backfill_governor(ack_checker);
+
                 /* This causes backfilling to happen. Once this constructor returns we are up to date. */
-                listener_t<protocol_t> listener(base_path, io_backender, mailbox_manager, ct_broadcaster.get_watchable(), branch_history_manager, svs, ct_location_to_backfill_from.get_watchable(), backfill_session_id, &regions_perfmon_collection, &ct_interruptor, &order_source);
+                listener_t<protocol_t> listener(base_path, io_backender, mailbox_manager, ct_broadcaster.get_watchable(), branch_history_manager, svs, ct_replier_watchables, backfill_session_id, is_async, &regions_perfmon_collection, &backfill_governor, &ct_interruptor, &order_source);
 
                 /* This gives others access to our services, in particular once
                  * this constructor returns people can send us queries and use
-                 * us for backfills. */
-                replier_t<protocol_t> replier(&listener, mailbox_manager, branch_history_manager);
+                 * us for backfills. An async secondary doesn't get one, so the
+                 * broadcaster never waits for its replies. */
+                scoped_ptr_t<replier_t<protocol_t> > replier;
+                if (!is_async) {
+                    replier.init(new replier_t<protocol_t>(&listener, mailbox_manager, branch_history_manager));
+                }
 
                 direct_reader_t<protocol_t> direct_reader(mailbox_manager, svs);
 
@@ -257,7 +280,11 @@ void reactor_t<protocol_t>::be_secondary(typename protocol_t::region_t region, s
 
                 /* Make the directory reflect the new role that we are filling.
                  * (Being a secondary). */
-                directory_entry.set(typename reactor_business_card_t<protocol_t>::secondary_up_to_date_t(branch_id, replier.get_business_card(), direct_reader.get_business_card()));
+                directory_entry.set(typename reactor_business_card_t<protocol_t>::secondary_up_to_date_t(
+                    branch_id,
+                    replier.has() ? replier->get_business_card() : replier_business_card_t<protocol_t>(),
+                    direct_reader.get_business_card(),
+                    is_async));
 
                 /* Wait for something to change. */
                 wait_interruptible(&ct_broadcaster_lost_signal, interruptor);
@@ -281,6 +308,6 @@ void reactor_t<protocol_t>::be_secondary(typename protocol_t::region_t region, s
 #include "memcached/protocol_json_adapter.hpp"
 #include "rdb_protocol/protocol.hpp"
 
-template void reactor_t<mock::dummy_protocol_t>::be_secondary(mock::dummy_protocol_t::region_t region, store_view_t<mock::dummy_protocol_t> *svs, const clone_ptr_t<watchable_t<blueprint_t<mock::dummy_protocol_t> > > &blueprint, signal_t *interruptor) THROWS_NOTHING;
-template void reactor_t<memcached_protocol_t>::be_secondary(memcached_protocol_t::region_t region, store_view_t<memcached_protocol_t> *svs, const clone_ptr_t<watchable_t<blueprint_t<memcached_protocol_t> > > &blueprint, signal_t *interruptor) THROWS_NOTHING;
-template void reactor_t<rdb_protocol_t>::be_secondary(rdb_protocol_t::region_t region, store_view_t<rdb_protocol_t> *svs, const clone_ptr_t<watchable_t<blueprint_t<rdb_protocol_t> > > &blueprint, signal_t *interruptor) THROWS_NOTHING;
+template void reactor_t<mock::dummy_protocol_t>::be_secondary(mock::dummy_protocol_t::region_t region, store_view_t<mock::dummy_protocol_t> *svs, const clone_ptr_t<watchable_t<blueprint_t<mock::dummy_protocol_t> > > &blueprint, bool is_async, signal_t *interruptor) THROWS_NOTHING;
+template void reactor_t<memcached_protocol_t>::be_secondary(memcached_protocol_t::region_t region, store_view_t<memcached_protocol_t> *svs, const clone_ptr_t<watchable_t<blueprint_t<memcached_protocol_t> > > &blueprint, bool is_async, signal_t *interruptor) THROWS_NOTHING;
+template void reactor_t<rdb_protocol_t>::be_secondary(rdb_protocol_t::region_t region, store_view_t<rdb_protocol_t> *svs, const clone_ptr_t<watchable_t<blueprint_t<rdb_protocol_t> > > &blueprint, bool is_async, signal_t *interruptor) THROWS_NOTHING;
@@ -76,6 +76,7 @@ json_adapter_if_t::json_adapter_map_t get_json_subfields(secondary_up_to_date_t<
     json_adapter_if_t::json_adapter_map_t res;
     res["type"] = boost::shared_ptr<json_adapter_if_t>(new json_temporary_adapter_t<std::string>("secondary_up_to_date"));
     res["branch_id"] = boost::shared_ptr<json_adapter_if_t>(new json_adapter_t<branch_id_t>(&target->branch_id));
+    res["is_async"] = boost::shared_ptr<json_adapter_if_t>(new json_adapter_t<bool>(&target->is_async));
     // TODO: git blame this and ask why it's commented out.
     //res["replier"] =   boost::shared_ptr<json_adapter_if_t>(new json_adapter_t<replier_business_card_t<protocol_t> >(&target->replier));
     return res;
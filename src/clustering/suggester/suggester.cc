@@ -2,6 +2,7 @@
 #include "clustering/suggester/suggester.hpp"
 
 #include "stl_utils.hpp"
+#include "config/args.hpp"
 #include "containers/priority_queue.hpp"
 #include "clustering/generic/nonoverlapping_regions.hpp"
 
@@ -12,14 +13,16 @@ struct priority_t {
 
     bool pinned;
     bool would_rob_secondary;
-    int redundancy_cost;
+    /* How many roles the machine already has, plus its share of the load
+    across the cluster weighted by `SUGGESTER_LOAD_WEIGHT`. */
+    double redundancy_cost;
     double backfill_cost;
     bool prioritize_distribution;
 
     priority_t() { }  // TODO: fix priority_queue_t
 
     priority_t(machine_id_t _machine_id, bool _pinned, bool _would_rob_secondary,
-               int _redundancy_cost, double _backfill_cost,
+               double _redundancy_cost, double _backfill_cost,
                bool _prioritize_distribution)
         : machine_id(_machine_id), pinned(_pinned), would_rob_secondary(_would_rob_secondary),
           redundancy_cost(_redundancy_cost), backfill_cost(_backfill_cost),
@@ -167,13 +170,16 @@ template <class protocol_t>
 priority_t priority_for_machine(machine_id_t id, const std::set<machine_id_t> &positive_pinnings,
                                 const std::set<machine_id_t> &negative_pinnings,
                                 const std::map<machine_id_t, int> &usage,
+                                const std::map<machine_id_t, double> &machine_loads,
                                 const std::map<machine_id_t, reactor_business_card_t<protocol_t> > &directory,
                                 const typename protocol_t::region_t &shard,
                                 bool prioritize_distribution) {
     const bool pinned = std_contains(positive_pinnings, id);
     const bool would_rob_someone = std_contains(negative_pinnings, id);
     const std::map<machine_id_t, int>::const_iterator usage_it = usage.find(id);
-    const int redundancy_cost = usage_it == usage.end() ? 0 : usage_it->second;
+    const std::map<machine_id_t, double>::const_iterator load_it = machine_loads.find(id);
+    const double redundancy_cost = (usage_it == usage.end() ? 0 : usage_it->second)
+        + (load_it == machine_loads.end() ? 0 : SUGGESTER_LOAD_WEIGHT * load_it->second);
     const typename std::map<machine_id_t, reactor_business_card_t<protocol_t> >::const_iterator directory_it = directory.find(id);
     const double backfill_cost = directory_it == directory.end() ? 3.0 : estimate_cost_to_get_up_to_date(directory_it->second, shard);
 
@@ -189,6 +195,7 @@ std::map<machine_id_t, blueprint_role_t> suggest_blueprint_for_shard(
         const std::map<machine_id_t, datacenter_id_t> &machine_data_centers,
         const std::set<machine_id_t> &primary_pinnings,
         const std::set<machine_id_t> &secondary_pinnings,
+        const std::map<machine_id_t, double> &machine_loads,
         std::map<machine_id_t, int> *usage,
         bool prioritize_distribution) {
 
@@ -212,7 +219,7 @@ std::map<machine_id_t, blueprint_role_t> suggest_blueprint_for_shard(
                                                     mt != unused_machines.end();
                                                     ++mt) {
             if (machine_data_centers.find(*mt)->second == primary_datacenter) {
-                primary_candidates.push(priority_for_machine(*mt, primary_pinnings, secondary_pinnings, *usage, directory, shard, prioritize_distribution));
+                primary_candidates.push(priority_for_machine(*mt, primary_pinnings, secondary_pinnings, *usage, machine_loads, directory, shard, prioritize_distribution));
             }
         }
 
@@ -236,7 +243,7 @@ std::map<machine_id_t, blueprint_role_t> suggest_blueprint_for_shard(
                                                     mt != unused_machines.end();
                                                     ++mt) {
             if (machine_data_centers.find(*mt)->second == it->first) {
-                secondary_candidates.push(priority_for_machine(*mt, secondary_pinnings, primary_pinnings, *usage, directory, shard, prioritize_distribution));
+                secondary_candidates.push(priority_for_machine(*mt, secondary_pinnings, primary_pinnings, *usage, machine_loads, directory, shard, prioritize_distribution));
             }
         }
         std::vector<machine_id_t> secondaries = pick_n_best(&secondary_candidates, it->second, it->first);
@@ -256,7 +263,7 @@ std::map<machine_id_t, blueprint_role_t> suggest_blueprint_for_shard(
         for (std::set<machine_id_t>::const_iterator mt  = unused_machines.begin();
                                                     mt != unused_machines.end();
                                                     ++mt) {
-            primary_candidates.push(priority_for_machine(*mt, primary_pinnings, secondary_pinnings, *usage, directory, shard, prioritize_distribution));
+            primary_candidates.push(priority_for_machine(*mt, primary_pinnings, secondary_pinnings, *usage, machine_loads, directory, shard, prioritize_distribution));
         }
 
         machine_id_t primary = pick_n_best(&primary_candidates, 1, primary_datacenter).front();
@@ -274,7 +281,7 @@ std::map<machine_id_t, blueprint_role_t> suggest_blueprint_for_shard(
         for (std::set<machine_id_t>::const_iterator mt  = unused_machines.begin();
                                                     mt != unused_machines.end();
                                                     ++mt) {
-            secondary_candidates.push(priority_for_machine(*mt, secondary_pinnings, primary_pinnings, *usage, directory, shard, prioritize_distribution));
+            secondary_candidates.push(priority_for_machine(*mt, secondary_pinnings, primary_pinnings, *usage, machine_loads, directory, shard, prioritize_distribution));
         }
         std::vector<machine_id_t> secondaries = pick_n_best(&secondary_candidates, datacenter_affinities.find(nil_uuid())->second, nil_uuid());
 
@@ -305,6 +312,7 @@ persistable_blueprint_t<protocol_t> suggest_blueprint(
         const std::map<machine_id_t, datacenter_id_t> &machine_data_centers,
         const region_map_t<protocol_t, machine_id_t> &primary_pinnings,
         const region_map_t<protocol_t, std::set<machine_id_t> > &secondary_pinnings,
+        const std::map<machine_id_t, double> &machine_loads,
         std::map<machine_id_t, int> *usage,
         bool prioritize_distribution) {
 
@@ -336,7 +344,7 @@ persistable_blueprint_t<protocol_t> suggest_blueprint(
         std::map<machine_id_t, blueprint_role_t> shard_blueprint =
             suggest_blueprint_for_shard(directory, primary_datacenter, datacenter_affinities, *it,
                                         machine_data_centers, machines_shard_primary_is_pinned_to,
-                                        machines_shard_secondary_is_pinned_to, usage, prioritize_distribution);
+                                        machines_shard_secondary_is_pinned_to, machine_loads, usage, prioritize_distribution);
         for (typename std::map<machine_id_t, blueprint_role_t>::iterator jt = shard_blueprint.begin();
                 jt != shard_blueprint.end(); jt++) {
             blueprint.machines_roles[jt->first][*it] = jt->second;
@@ -358,6 +366,7 @@ persistable_blueprint_t<mock::dummy_protocol_t> suggest_blueprint<mock::dummy_pr
         const std::map<machine_id_t, datacenter_id_t> &machine_data_centers,
         const region_map_t<mock::dummy_protocol_t, machine_id_t> &primary_pinnings,
         const region_map_t<mock::dummy_protocol_t, std::set<machine_id_t> > &secondary_pinnings,
+        const std::map<machine_id_t, double> &machine_loads,
         std::map<machine_id_t, int> *usage,
         bool prioritize_distribution);
 
@@ -373,6 +382,7 @@ persistable_blueprint_t<memcached_protocol_t> suggest_blueprint<memcached_protoc
         const std::map<machine_id_t, datacenter_id_t> &machine_data_centers,
         const region_map_t<memcached_protocol_t, machine_id_t> &primary_pinnings,
         const region_map_t<memcached_protocol_t, std::set<machine_id_t> > &secondary_pinnings,
+        const std::map<machine_id_t, double> &machine_loads,
         std::map<machine_id_t, int> *usage,
         bool prioritize_distribution);
 
@@ -388,5 +398,6 @@ persistable_blueprint_t<rdb_protocol_t> suggest_blueprint<rdb_protocol_t>(
         const std::map<machine_id_t, datacenter_id_t> &machine_data_centers,
         const region_map_t<rdb_protocol_t, machine_id_t> &primary_pinnings,
         const region_map_t<rdb_protocol_t, std::set<machine_id_t> > &secondary_pinnings,
+        const std::map<machine_id_t, double> &machine_loads,
         std::map<machine_id_t, int> *usage,
         bool prioritize_distribution);
@@ -28,6 +28,10 @@ public:
 
 };
 
+/* `machine_loads` tells how busy each machine already is, relative to the
+average machine in the cluster (see `compute_machine_load_scores()`).  Busier
+machines are less likely to get new roles.  Machines missing from it count as
+idle. */
 template<class protocol_t>
 persistable_blueprint_t<protocol_t> suggest_blueprint(
         const std::map<machine_id_t, reactor_business_card_t<protocol_t> > &directory,
@@ -37,6 +41,7 @@ persistable_blueprint_t<protocol_t> suggest_blueprint(
         const std::map<machine_id_t, datacenter_id_t> &machine_data_centers,
         const region_map_t<protocol_t, machine_id_t> &primary_pinnings,
         const region_map_t<protocol_t, std::set<machine_id_t> > &secondary_pinnings,
+        const std::map<machine_id_t, double> &machine_loads,
         std::map<machine_id_t, int> *usage,
         bool prioritize_distribution);
 
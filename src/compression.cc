@@ -0,0 +1,207 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "compression.hpp"
+
+#include <stdint.h>
+#include <string.h>
+
+#include "errors.hpp"
+
+namespace {
+
+const size_t MIN_MATCH = 4;
+const size_t MAX_OFFSET = 65535;
+const int HASH_BITS = 12;
+const uint8_t NIBBLE_MAX = 15;
+
+uint32_t read32(const char *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+uint32_t hash_sequence(uint32_t v) {
+    return (v * 2654435761U) >> (32 - HASH_BITS);
+}
+
+class output_t {
+public:
+    output_t(char *dest, size_t capacity) : dest_(dest), capacity_(capacity), pos_(0) { }
+
+    bool put_byte(uint8_t b) {
+        if (pos_ >= capacity_) {
+            return false;
+        }
+        dest_[pos_++] = b;
+        return true;
+    }
+
+    bool put_bytes(const char *src, size_t n) {
+        if (capacity_ - pos_ < n) {
+            return false;
+        }
+        memcpy(dest_ + pos_, src, n);
+        pos_ += n;
+        return true;
+    }
+
+    // Writes the continuation bytes for a count that didn't fit into its nibble.
+    bool put_count(size_t count) {
+        if (count < NIBBLE_MAX) {
+            return true;
+        }
+        count -= NIBBLE_MAX;
+        while (count >= 255) {
+            if (!put_byte(255)) {
+                return false;
+            }
+            count -= 255;
+        }
+        return put_byte(count);
+    }
+
+    size_t size() const { return pos_; }
+
+private:
+    char *dest_;
+    size_t capacity_;
+    size_t pos_;
+};
+
+uint8_t nibble(size_t count) {
+    return count < NIBBLE_MAX ? count : NIBBLE_MAX;
+}
+
+bool emit_sequence(output_t *out, const char *literals, size_t num_literals,
+                   size_t offset, size_t match_length) {
+    rassert(match_length >= MIN_MATCH);
+    const uint8_t token = (nibble(num_literals) << 4) | nibble(match_length - MIN_MATCH);
+    return out->put_byte(token)
+        && out->put_count(num_literals)
+        && out->put_bytes(literals, num_literals)
+        && out->put_byte(offset & 0xff)
+        && out->put_byte(offset >> 8)
+        && out->put_count(match_length - MIN_MATCH);
+}
+
+bool emit_last_literals(output_t *out, const char *literals, size_t num_literals) {
+    const uint8_t token = nibble(num_literals) << 4;
+    return out->put_byte(token)
+        && out->put_count(num_literals)
+        && out->put_bytes(literals, num_literals);
+}
+
+// Reads a count whose first part is `nib`. Returns false on truncated input.
+bool read_count(const char *src, size_t src_size, size_t *pos, uint8_t nib, size_t *count_out) {
+    size_t count = nib;
+    if (nib == NIBBLE_MAX) {
+        uint8_t b;
+        do {
+            if (*pos >= src_size) {
+                return false;
+            }
+            b = src[(*pos)++];
+            count += b;
+        } while (b == 255);
+    }
+    *count_out = count;
+    return true;
+}
+
+}  // namespace
+
+size_t lz_compress_bound(size_t src_size) {
+    return src_size + src_size / 255 + 16;
+}
+
+size_t lz_compress(const char *src, size_t src_size, char *dest, size_t dest_capacity) {
+    output_t out(dest, dest_capacity);
+
+    // Positions (plus one, so that zero means "empty") of recently seen
+    // four-byte sequences.
+    size_t table[1 << HASH_BITS];
+    memset(table, 0, sizeof(table));
+
+    size_t anchor = 0;
+    size_t pos = 0;
+    while (pos + MIN_MATCH <= src_size) {
+        const uint32_t sequence = read32(src + pos);
+        const uint32_t h = hash_sequence(sequence);
+        const size_t candidate = table[h];
+        table[h] = pos + 1;
+
+        if (candidate != 0
+            && pos - (candidate - 1) <= MAX_OFFSET
+            && read32(src + candidate - 1) == sequence) {
+            const size_t match_start = candidate - 1;
+            size_t length = MIN_MATCH;
+            while (pos + length < src_size && src[match_start + length] == src[pos + length]) {
+                ++length;
+            }
+
+            if (!emit_sequence(&out, src + anchor, pos - anchor, pos - match_start, length)) {
+                return 0;
+            }
+            pos += length;
+            anchor = pos;
+        } else {
+            ++pos;
+        }
+    }
+
+    if (!emit_last_literals(&out, src + anchor, src_size - anchor)) {
+        return 0;
+    }
+    return out.size();
+}
+
+bool lz_decompress(const char *src, size_t src_size, char *dest, size_t dest_size) {
+    size_t in = 0;
+    size_t out = 0;
+    for (;;) {
+        if (in >= src_size) {
+            return false;
+        }
+        const uint8_t token = src[in++];
+
+        size_t num_literals;
+        if (!read_count(src, src_size, &in, token >> 4, &num_literals)) {
+            return false;
+        }
+        if (src_size - in < num_literals || dest_size - out < num_literals) {
+            return false;
+        }
+        memcpy(dest + out, src + in, num_literals);
+        in += num_literals;
+        out += num_literals;
+
+        if (in == src_size) {
+            // That was the last sequence.
+            return out == dest_size;
+        }
+
+        if (src_size - in < 2) {
+            return false;
+        }
+        const size_t offset = static_cast<uint8_t>(src[in])
+            | (static_cast<size_t>(static_cast<uint8_t>(src[in + 1])) << 8);
+        in += 2;
+        if (offset == 0 || offset > out) {
+            return false;
+        }
+
+        size_t length;
+        if (!read_count(src, src_size, &in, token & NIBBLE_MAX, &length)) {
+            return false;
+        }
+        length += MIN_MATCH;
+        if (dest_size - out < length) {
+            return false;
+        }
+        // The match may overlap with the bytes it produces, so copy byte by byte.
+        const char *match = dest + out - offset;
+        for (size_t i = 0; i < length; ++i) {
+            dest[out + i] = match[i];
+        }
+        out += length;
+    }
+}
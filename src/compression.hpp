@@ -0,0 +1,37 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#ifndef COMPRESSION_HPP_
+#define COMPRESSION_HPP_
+
+#include <stddef.h>
+
+/* A small, fast LZ77 block compressor in the style of LZ4 (it is not compatible
+with the LZ4 format). It is meant for compressing individual blocks of a few
+kilobytes, where speed matters much more than the compression ratio.
+
+The compressed format is a sequence of
+
+    token (1 byte, high nibble: literal count, low nibble: match length - 4)
+    [literal count continuation bytes]
+    literals
+    match offset (2 bytes, little endian)
+    [match length continuation bytes]
+
+where a nibble value of 15 means that continuation bytes follow, each of which
+gets added to the count, until one of them is less than 255. The last sequence
+consists of only a token and literals. */
+
+// Compresses `src_size` bytes from `src` into `dest`. Returns the size of the
+// compressed data, or 0 if it would not fit into `dest_capacity` bytes. Callers
+// that only want to keep data that actually got smaller can pass a
+// `dest_capacity` less than `src_size`.
+size_t lz_compress(const char *src, size_t src_size, char *dest, size_t dest_capacity);
+
+// Decompresses `src_size` bytes of data produced by `lz_compress` into `dest`.
+// Returns false if the data is malformed or doesn't decompress to exactly
+// `dest_size` bytes.
+bool lz_decompress(const char *src, size_t src_size, char *dest, size_t dest_size);
+
+// The largest size `src_size` bytes can possibly compress to.
+size_t lz_compress_bound(size_t src_size);
+
+#endif  // COMPRESSION_HPP_
@@ -4,14 +4,18 @@
 
 #include "concurrency/watchable.hpp"
 #include "concurrency/auto_drainer.hpp"
-#include "concurrency/queue/single_value_producer.hpp"
-#include "concurrency/coro_pool.hpp"
 
 /* `cross_thread_watchable_variable_t` is used to "proxy" a `watchable_t` from
 one thread to another. Create the `cross_thread_watchable_variable_t` on the
 source thread; then call `get_watchable()`, and you will get a watchable that is
 usable on the `_dest_thread` that you passed to the constructor.
 
+The changes get coalesced: a change only schedules a delivery, and the delivery
+gets the value from the original watchable when it runs, so all the changes made
+before it runs, or while the last delivery was on its way, only get copied and
+sent to the other thread once.  Values that are big should be in a `cow_ptr_t`,
+the way the namespaces metadata is, so that the copies share them.
+
 See also: `cross_thread_signal_t`, which is the same thing for `signal_t`. */
 
 template <class value_t>
@@ -30,7 +34,7 @@ public:
 private:
     friend class cross_thread_watcher_subscription_t;
     void on_value_changed();
-    void deliver(value_t new_value);
+    void deliver(auto_drainer_t::lock_t keepalive);
 
     static void call(const boost::function<void()> &f) {
         f();
@@ -89,16 +93,19 @@ private:
         cross_thread_watchable_variable_t *parent;
     } rethreader;
 
+    /* Whether `deliver()` is running, and whether the value changed since it got
+    it.  These are only used on `watchable_thread`. */
+    bool delivering;
+    bool changed;
+
+    auto_drainer_t drainer;
+
     /* The destructor for `subs` must be run before the destructor for `drainer`
     because `drainer`'s destructor will block until all the
-    `auto_drainer_t::lock_t` objects are gone, and `subs`'s callback holds an
+    `auto_drainer_t::lock_t` objects are gone, and `subs`'s callback takes an
     `auto_drainer_t::lock_t`. */
     typename watchable_t<value_t>::subscription_t subs;
 
-    single_value_producer_t<value_t> value_producer;
-    boost_function_callback_t<value_t> deliver_cb;
-    coro_pool_t<value_t> messanger_pool;
-
     DISABLE_COPYING(cross_thread_watchable_variable_t);
 };
 
@@ -1,5 +1,9 @@
 // Copyright 2010-2012 RethinkDB, all rights reserved.
+#include <algorithm>
+
+#include "arch/runtime/coroutines.hpp"
 #include "arch/runtime/runtime.hpp"
+#include "containers/scoped.hpp"
 
 template <class value_t>
 cross_thread_watchable_variable_t<value_t>::cross_thread_watchable_variable_t(const clone_ptr_t<watchable_t<value_t> > &w,
@@ -9,9 +13,9 @@ cross_thread_watchable_variable_t<value_t>::cross_thread_watchable_variable_t(co
     watchable_thread(get_thread_id()),
     dest_thread(_dest_thread),
     rethreader(this),
-    subs(boost::bind(&cross_thread_watchable_variable_t<value_t>::on_value_changed, this)),
-    deliver_cb(boost::bind(&cross_thread_watchable_variable_t<value_t>::deliver, this, _1)),
-    messanger_pool(1, &value_producer, &deliver_cb) //Note it's very important that this coro_pool only have one worker it will be a race condition if it has more
+    delivering(false),
+    changed(false),
+    subs(boost::bind(&cross_thread_watchable_variable_t<value_t>::on_value_changed, this))
 {
     rassert(original->get_rwi_lock_assertion()->home_thread() == watchable_thread);
     typename watchable_t<value_t>::freeze_t freeze(original);
@@ -21,12 +25,29 @@ cross_thread_watchable_variable_t<value_t>::cross_thread_watchable_variable_t(co
 
 template <class value_t>
 void cross_thread_watchable_variable_t<value_t>::on_value_changed() {
-    value_producer.give_value(original->get());
+    changed = true;
+    /* Only one delivery runs at a time, otherwise the values could get to the
+    other thread out of order.  The one that's running picks the change up. */
+    if (!delivering) {
+        delivering = true;
+        coro_t::spawn_sometime(boost::bind(&cross_thread_watchable_variable_t<value_t>::deliver,
+                                           this, auto_drainer_t::lock_t(&drainer)));
+    }
 }
 
 template <class value_t>
-void cross_thread_watchable_variable_t<value_t>::deliver(value_t new_value) {
-    on_thread_t thread_switcher(dest_thread);
-    value = new_value;
-    publisher_controller.publish(&cross_thread_watchable_variable_t<value_t>::call);
+void cross_thread_watchable_variable_t<value_t>::deliver(UNUSED auto_drainer_t::lock_t keepalive) {
+    while (changed) {
+        changed = false;
+        /* The copy is destroyed on the other thread, where `value` used to be
+        destroyed when it got overwritten. */
+        scoped_ptr_t<value_t> new_value(new value_t(original->get()));
+        {
+            on_thread_t thread_switcher(dest_thread);
+            std::swap(value, *new_value);
+            new_value.reset();
+            publisher_controller.publish(&cross_thread_watchable_variable_t<value_t>::call);
+        }
+    }
+    delivering = false;
 }
@@ -1,8 +1,11 @@
 // Copyright 2010-2012 RethinkDB, all rights reserved.
 #include "concurrency/fifo_enforcer.hpp"
 
+#include <algorithm>
+
 #include "arch/runtime/coroutines.hpp"
 #include "concurrency/cond_var.hpp"
+#include "concurrency/lock_contention.hpp"
 #include "concurrency/wait_any.hpp"
 
 void fifo_enforcer_state_t::advance_by_read(DEBUG_VAR fifo_enforcer_read_token_t token) THROWS_NOTHING {
@@ -34,15 +37,17 @@ fifo_enforcer_write_token_t fifo_enforcer_source_t::enter_write() THROWS_NOTHING
 }
 
 fifo_enforcer_sink_t::exit_read_t::exit_read_t() THROWS_NOTHING :
-    parent(NULL), ended(false) { }
+    parent(NULL), ended(false), site(NULL), wait_start_time(0) { }
 
-fifo_enforcer_sink_t::exit_read_t::exit_read_t(fifo_enforcer_sink_t *p, fifo_enforcer_read_token_t t) THROWS_NOTHING :
-    parent(NULL), ended(false)
+fifo_enforcer_sink_t::exit_read_t::exit_read_t(fifo_enforcer_sink_t *p, fifo_enforcer_read_token_t t,
+                                               lock_site_t *s) THROWS_NOTHING :
+    parent(NULL), ended(false), site(NULL), wait_start_time(0)
 {
-    begin(p, t);
+    begin(p, t, s);
 }
 
-void fifo_enforcer_sink_t::exit_read_t::begin(fifo_enforcer_sink_t *p, fifo_enforcer_read_token_t t) THROWS_NOTHING {
+void fifo_enforcer_sink_t::exit_read_t::begin(fifo_enforcer_sink_t *p, fifo_enforcer_read_token_t t,
+                                              lock_site_t *s) THROWS_NOTHING {
     rassert(parent == NULL);
     rassert(p != NULL);
     parent = p;
@@ -52,6 +57,23 @@ void fifo_enforcer_sink_t::exit_read_t::begin(fifo_enforcer_sink_t *p, fifo_enfo
     mutex_assertion_t::acq_t acq(&parent->internal_lock);
     parent->internal_read_queue.push(this);
     parent->internal_pump();
+
+    if (s != NULL && lock_site_t::is_profiling()) {
+        site = s;
+        if (is_pulsed()) {
+            site->record_acquisition(0);
+        } else {
+            wait_start_time = get_ticks();
+        }
+    }
+}
+
+void fifo_enforcer_sink_t::exit_read_t::on_reached_head_of_queue() {
+    parent->internal_read_queue.remove(this);
+    if (wait_start_time != 0) {
+        site->record_acquisition(std::max<ticks_t>(get_ticks() - wait_start_time, 1));
+    }
+    pulse();
 }
 
 void fifo_enforcer_sink_t::exit_read_t::end() THROWS_NOTHING {
@@ -94,15 +116,17 @@ fifo_enforcer_sink_t::exit_read_t::~exit_read_t() THROWS_NOTHING {
 }
 
 fifo_enforcer_sink_t::exit_write_t::exit_write_t() THROWS_NOTHING :
-    parent(NULL), ended(false) { }
+    parent(NULL), ended(false), site(NULL), wait_start_time(0) { }
 
-fifo_enforcer_sink_t::exit_write_t::exit_write_t(fifo_enforcer_sink_t *p, fifo_enforcer_write_token_t t) THROWS_NOTHING :
-    parent(NULL), ended(false)
+fifo_enforcer_sink_t::exit_write_t::exit_write_t(fifo_enforcer_sink_t *p, fifo_enforcer_write_token_t t,
+                                                 lock_site_t *s) THROWS_NOTHING :
+    parent(NULL), ended(false), site(NULL), wait_start_time(0)
 {
-    begin(p, t);
+    begin(p, t, s);
 }
 
-void fifo_enforcer_sink_t::exit_write_t::begin(fifo_enforcer_sink_t *p, fifo_enforcer_write_token_t t) THROWS_NOTHING {
+void fifo_enforcer_sink_t::exit_write_t::begin(fifo_enforcer_sink_t *p, fifo_enforcer_write_token_t t,
+                                               lock_site_t *s) THROWS_NOTHING {
     ASSERT_FINITE_CORO_WAITING;
 
     rassert(parent == NULL);
@@ -114,6 +138,23 @@ void fifo_enforcer_sink_t::exit_write_t::begin(fifo_enforcer_sink_t *p, fifo_enf
     mutex_assertion_t::acq_t acq(&parent->internal_lock);
     parent->internal_write_queue.push(this);
     parent->internal_pump();
+
+    if (s != NULL && lock_site_t::is_profiling()) {
+        site = s;
+        if (is_pulsed()) {
+            site->record_acquisition(0);
+        } else {
+            wait_start_time = get_ticks();
+        }
+    }
+}
+
+void fifo_enforcer_sink_t::exit_write_t::on_reached_head_of_queue() {
+    parent->internal_write_queue.remove(this);
+    if (wait_start_time != 0) {
+        site->record_acquisition(std::max<ticks_t>(get_ticks() - wait_start_time, 1));
+    }
+    pulse();
 }
 
 void fifo_enforcer_sink_t::exit_write_t::end() THROWS_NOTHING {
@@ -15,6 +15,7 @@
 #include "utils.hpp"
 
 class cond_t;
+class lock_site_t;
 class signal_t;
 
 namespace unittest {
@@ -160,29 +161,30 @@ public:
     operations to proceed. If it hadn't reached the head of the queue by the
     time it was destroyed, operations that come later are still allowed to
     proceed, even though the destructor doesn't block. It accomplishes this by
-    putting a dummy entry into the queue. */
+    putting a dummy entry into the queue. If a `lock_site_t` is given and lock
+    contention is being profiled, the time until the token reaches the head of
+    the queue is counted for it. */
 
     class exit_read_t : public signal_t, public internal_exit_read_t {
     public:
         exit_read_t() THROWS_NOTHING;
 
         /* Calls `begin()` */
-        exit_read_t(fifo_enforcer_sink_t *, fifo_enforcer_read_token_t) THROWS_NOTHING;
+        exit_read_t(fifo_enforcer_sink_t *, fifo_enforcer_read_token_t,
+                    lock_site_t *site = NULL) THROWS_NOTHING;
 
         /* Calls `end()` if appropriate */
         ~exit_read_t() THROWS_NOTHING;
 
-        void begin(fifo_enforcer_sink_t *, fifo_enforcer_read_token_t) THROWS_NOTHING;
+        void begin(fifo_enforcer_sink_t *, fifo_enforcer_read_token_t,
+                   lock_site_t *site = NULL) THROWS_NOTHING;
         void end() THROWS_NOTHING;
 
     private:
         fifo_enforcer_read_token_t get_token() const {
             return token;
         }
-        void on_reached_head_of_queue() {
-            parent->internal_read_queue.remove(this);
-            pulse();
-        }
+        void on_reached_head_of_queue();
         void on_early_shutdown() {
             crash("illegal to destroy fifo_enforcer_sink_t while outstanding "
                 "exit_read_t objects exist");
@@ -194,6 +196,11 @@ public:
         bool ended;
 
         fifo_enforcer_read_token_t token;
+
+        /* `site` is `NULL` unless the wait is profiled, and `wait_start_time`
+        is 0 unless the token had to wait in the queue. */
+        lock_site_t *site;
+        ticks_t wait_start_time;
     };
 
     class exit_write_t : public signal_t, public internal_exit_write_t {
@@ -201,22 +208,21 @@ public:
         exit_write_t() THROWS_NOTHING;
 
         /* Calls `begin()` */
-        exit_write_t(fifo_enforcer_sink_t *, fifo_enforcer_write_token_t) THROWS_NOTHING;
+        exit_write_t(fifo_enforcer_sink_t *, fifo_enforcer_write_token_t,
+                    lock_site_t *site = NULL) THROWS_NOTHING;
 
         /* Calls `end()` if appropriate */
         ~exit_write_t() THROWS_NOTHING;
 
-        void begin(fifo_enforcer_sink_t *, fifo_enforcer_write_token_t) THROWS_NOTHING;
+        void begin(fifo_enforcer_sink_t *, fifo_enforcer_write_token_t,
+                   lock_site_t *site = NULL) THROWS_NOTHING;
         void end() THROWS_NOTHING;
 
     private:
         fifo_enforcer_write_token_t get_token() const {
             return token;
         }
-        void on_reached_head_of_queue() {
-            parent->internal_write_queue.remove(this);
-            pulse();
-        }
+        void on_reached_head_of_queue();
         void on_early_shutdown() {
             crash("illegal to destroy fifo_enforcer_sink_t while outstanding "
                 "exit_write_t objects exist");
@@ -228,6 +234,11 @@ public:
         bool ended;
 
         fifo_enforcer_write_token_t token;
+
+        /* `site` is `NULL` unless the wait is profiled, and `wait_start_time`
+        is 0 unless the token had to wait in the queue. */
+        lock_site_t *site;
+        ticks_t wait_start_time;
     };
 
     fifo_enforcer_sink_t() THROWS_NOTHING :
@@ -0,0 +1,113 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "concurrency/lock_contention.hpp"
+
+#include <inttypes.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "arch/runtime/runtime.hpp"
+#include "perfmon/perfmon.hpp"
+
+bool global_lock_contention_profiling = false;
+
+// Sites are only constructed during static initialization, so the list needs no
+// lock and is zero-initialized before the first of them registers.
+static lock_site_t *all_lock_sites = NULL;
+
+lock_site_t::lock_site_t(const char *_name) : name(_name), next(all_lock_sites) {
+    all_lock_sites = this;
+}
+
+void lock_site_t::record_acquisition(ticks_t waited) {
+    totals_t *totals = &threads[get_thread_id().threadnum].value;
+    ++totals->acquisitions;
+    if (waited > 0) {
+        ++totals->waits;
+        totals->wait_ticks += waited;
+        totals->max_wait_ticks = std::max(totals->max_wait_ticks, waited);
+    }
+}
+
+void lock_site_t::totals_t::add(const totals_t &other) {
+    acquisitions += other.acquisitions;
+    waits += other.waits;
+    wait_ticks += other.wait_ticks;
+    max_wait_ticks = std::max(max_wait_ticks, other.max_wait_ticks);
+}
+
+/* Every thread copies the totals of its counters of all the sites, in the order
+of `all_lock_sites`; the sites with the same name are added up afterwards. */
+class perfmon_lock_contention_t
+    : public perfmon_perthread_t<std::vector<lock_site_t::totals_t> > {
+private:
+    typedef std::vector<lock_site_t::totals_t> site_totals_t;
+
+    void get_thread_stat(site_totals_t *out) {
+        const int thread = get_thread_id().threadnum;
+        for (lock_site_t *site = all_lock_sites; site != NULL; site = site->next) {
+            out->push_back(site->threads[thread].value);
+        }
+    }
+
+    site_totals_t combine_stats(const site_totals_t *data) {
+        site_totals_t combined = data[0];
+        for (int i = 1; i < get_num_threads(); ++i) {
+            for (size_t j = 0; j < combined.size(); ++j) {
+                combined[j].add(data[i][j]);
+            }
+        }
+        return combined;
+    }
+
+    static bool waited_longer(const std::pair<std::string, lock_site_t::totals_t> &a,
+                              const std::pair<std::string, lock_site_t::totals_t> &b) {
+        return a.second.wait_ticks > b.second.wait_ticks;
+    }
+
+    scoped_ptr_t<perfmon_result_t> output_stat(const site_totals_t &combined) {
+        std::map<std::string, lock_site_t::totals_t> by_name;
+        size_t i = 0;
+        for (lock_site_t *site = all_lock_sites; site != NULL; site = site->next, ++i) {
+            by_name[site->name].add(combined[i]);
+        }
+
+        std::vector<std::pair<std::string, lock_site_t::totals_t> > sites;
+        for (std::map<std::string, lock_site_t::totals_t>::const_iterator it = by_name.begin();
+             it != by_name.end(); ++it) {
+            if (it->second.waits > 0) {
+                sites.push_back(*it);
+            }
+        }
+        std::sort(sites.begin(), sites.end(), &perfmon_lock_contention_t::waited_longer);
+        if (sites.size() > LOCK_CONTENTION_TOP_SITES) {
+            sites.resize(LOCK_CONTENTION_TOP_SITES);
+        }
+
+        scoped_ptr_t<perfmon_result_t> result = perfmon_result_t::alloc_map_result();
+        for (size_t j = 0; j < sites.size(); ++j) {
+            const lock_site_t::totals_t &totals = sites[j].second;
+            scoped_ptr_t<perfmon_result_t> site_result = perfmon_result_t::alloc_map_result();
+            site_result->insert("acquisitions",
+                new perfmon_result_t(strprintf("%" PRIi64, totals.acquisitions)));
+            site_result->insert("waits",
+                new perfmon_result_t(strprintf("%" PRIi64, totals.waits)));
+            site_result->insert("total_wait_secs",
+                new perfmon_result_t(strprintf("%.8f", ticks_to_secs(totals.wait_ticks))));
+            site_result->insert("mean_wait_secs",
+                new perfmon_result_t(strprintf("%.8f",
+                    ticks_to_secs(totals.wait_ticks) / totals.waits)));
+            site_result->insert("max_wait_secs",
+                new perfmon_result_t(strprintf("%.8f", ticks_to_secs(totals.max_wait_ticks))));
+            result->insert(sites[j].first, site_result.release());
+        }
+        return result;
+    }
+};
+
+static perfmon_lock_contention_t pm_lock_contention;
+static perfmon_membership_t pm_lock_contention_membership(&get_global_perfmon_collection(),
+    &pm_lock_contention, "lock_contention");
@@ -0,0 +1,54 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#ifndef CONCURRENCY_LOCK_CONTENTION_HPP_
+#define CONCURRENCY_LOCK_CONTENTION_HPP_
+
+#include <stdint.h>
+
+#include "config/args.hpp"
+#include "utils.hpp"
+
+/* With `--profile-lock-contention`, the `rwi_lock_t`s, `mutex_t`s and FIFO
+enforcer sinks that are acquired with a `lock_site_t` count how often they were
+acquired there and how long the acquisitions that had to wait waited, and the
+`lock_contention` stat shows the `LOCK_CONTENTION_TOP_SITES` sites that waited
+the longest in total.  Without it, acquiring with a site only costs a check of
+`global_lock_contention_profiling`. */
+extern bool global_lock_contention_profiling;
+
+/* A `lock_site_t` names a place that acquires locks, for example
+`static lock_site_t superblock_lock_site("btree.superblock");`.  Sites must
+have static storage duration, because they register themselves for the stat
+when they're constructed and never unregister; several sites may share a name,
+the stat adds them up. */
+class lock_site_t {
+public:
+    explicit lock_site_t(const char *name);
+
+    /* `is_profiling()` on the thread that starts the acquisition tells whether
+    to time it.  Acquisitions that got the lock at once call
+    `record_acquisition(0)`, the others the ticks they waited, on the thread
+    that acquired the lock. */
+    static bool is_profiling() { return global_lock_contention_profiling; }
+    void record_acquisition(ticks_t waited);
+
+    struct totals_t {
+        totals_t() : acquisitions(0), waits(0), wait_ticks(0), max_wait_ticks(0) { }
+        void add(const totals_t &other);
+
+        int64_t acquisitions;
+        int64_t waits;
+        ticks_t wait_ticks;
+        ticks_t max_wait_ticks;
+    };
+
+private:
+    friend class perfmon_lock_contention_t;
+
+    const char *const name;
+    lock_site_t *const next;
+    cache_line_padded_t<totals_t> threads[MAX_THREADS];
+
+    DISABLE_COPYING(lock_site_t);
+};
+
+#endif  // CONCURRENCY_LOCK_CONTENTION_HPP_
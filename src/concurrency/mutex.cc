@@ -1,10 +1,18 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "concurrency/mutex.hpp"
 
+#include <algorithm>
+
 #include "arch/runtime/coroutines.hpp"
+#include "concurrency/lock_contention.hpp"
 
 mutex_t::acq_t::acq_t(mutex_t *l, bool eager) : lock_(NULL), eager_(false) {
-    reset(l, eager);
+    reset(l, NULL, eager);
+}
+
+mutex_t::acq_t::acq_t(mutex_t *l, lock_site_t *site, bool eager)
+    : lock_(NULL), eager_(false) {
+    reset(l, site, eager);
 }
 
 mutex_t::acq_t::~acq_t() {
@@ -19,18 +27,30 @@ void mutex_t::acq_t::reset() {
 }
 
 void mutex_t::acq_t::reset(mutex_t *l, bool eager) {
+    reset(l, NULL, eager);
+}
+
+void mutex_t::acq_t::reset(mutex_t *l, lock_site_t *site, bool eager) {
     reset();
     lock_ = l;
     eager_ = eager;
-    co_lock_mutex(l);
+    co_lock_mutex(l, site);
 }
 
-void co_lock_mutex(mutex_t *mutex) {
+void co_lock_mutex(mutex_t *mutex, lock_site_t *site) {
+    const bool profiling = site != NULL && lock_site_t::is_profiling();
     if (mutex->locked) {
+        const ticks_t start_time = profiling ? get_ticks() : 0;
         mutex->waiters.push_back(coro_t::self());
         coro_t::wait();
+        if (profiling) {
+            site->record_acquisition(std::max<ticks_t>(get_ticks() - start_time, 1));
+        }
     } else {
         mutex->locked = true;
+        if (profiling) {
+            site->record_acquisition(0);
+        }
     }
 }
 
@@ -8,9 +8,12 @@
 #include "utils.hpp"
 
 class coro_t;
+class lock_site_t;
 class mutex_t;
 
-void co_lock_mutex(mutex_t *mutex);
+// If `site` is not `NULL` and lock contention is being profiled, the
+// acquisition and how long it waited are counted for `site`.
+void co_lock_mutex(mutex_t *mutex, lock_site_t *site = NULL);
 void unlock_mutex(mutex_t *mutex, bool eager = false);
 
 
@@ -20,9 +23,11 @@ public:
     public:
         acq_t() : lock_(NULL), eager_(false) { }
         explicit acq_t(mutex_t *l, bool eager = false);
+        acq_t(mutex_t *l, lock_site_t *site, bool eager = false);
         ~acq_t();
         void reset();
         void reset(mutex_t *l, bool eager = false);
+        void reset(mutex_t *l, lock_site_t *site, bool eager = false);
         void assert_is_holding(DEBUG_VAR mutex_t *m) const {
             rassert(lock_ == m);
         }
@@ -40,7 +45,7 @@ public:
         return locked;
     }
 
-    friend void co_lock_mutex(mutex_t *mutex);
+    friend void co_lock_mutex(mutex_t *mutex, lock_site_t *site);
     friend void unlock_mutex(mutex_t *mutex, bool eager);
 
 private:
@@ -1,42 +1,59 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "concurrency/rwi_lock.hpp"
 
+#include <algorithm>
+
 #include "config/args.hpp"
 #include "arch/runtime/runtime.hpp"
 #include "concurrency/cond_var.hpp"
+#include "concurrency/lock_contention.hpp"
 
 
 struct lock_request_t : public thread_message_t,
                         public intrusive_list_node_t<lock_request_t>
 {
-    lock_request_t(access_t _op, lock_available_callback_t *_callback)
-        : op(_op), callback(_callback)
+    lock_request_t(access_t _op, lock_available_callback_t *_callback, lock_site_t *_site)
+        : op(_op), callback(_callback), site(_site), enqueue_time(site ? get_ticks() : 0)
     {}
     access_t op;
     lock_available_callback_t *callback;
+    // `NULL` unless the acquisition is profiled.
+    lock_site_t *site;
+    ticks_t enqueue_time;
 
     // Actually, this is called later on the same thread...
     void on_thread_switch() {
+        if (site) {
+            site->record_acquisition(std::max<ticks_t>(get_ticks() - enqueue_time, 1));
+        }
         callback->on_lock_available();
         delete this;
     }
 };
 
 
-bool rwi_lock_t::lock(access_t access, lock_available_callback_t *callback) {
+bool rwi_lock_t::lock(access_t access, lock_available_callback_t *callback,
+                      lock_site_t *site) {
+    if (site && !lock_site_t::is_profiling()) {
+        site = NULL;
+    }
     if (try_lock(access, false)) {
+        if (site) {
+            site->record_acquisition(0);
+        }
         return true;
     } else {
-        enqueue_request(access, callback);
+        enqueue_request(access, callback, site);
         return false;
     }
 }
 
-void rwi_lock_t::co_lock(access_t access, lock_in_line_callback_t *call_when_in_line) {
+void rwi_lock_t::co_lock(access_t access, lock_in_line_callback_t *call_when_in_line,
+                         lock_site_t *site) {
     struct : public lock_available_callback_t, public cond_t {
         void on_lock_available() { pulse(); }
     } cb;
-    bool got_immediately = lock(access, &cb);
+    bool got_immediately = lock(access, &cb, site);
     if (call_when_in_line) {
         call_when_in_line->on_in_line();
     }
@@ -90,6 +107,13 @@ bool rwi_lock_t::locked() {
     return (state != rwis_unlocked);
 }
 
+bool rwi_lock_t::read_available() {
+    if (queue.head() && queue.head()->op == rwi_write) {
+        return false;
+    }
+    return state != rwis_writing;
+}
+
 bool rwi_lock_t::try_lock(access_t access, bool from_queue) {
     bool res = false;
     switch (access) {
@@ -200,8 +224,9 @@ bool rwi_lock_t::try_lock_upgrade(UNUSED bool from_queue) {
     }
 }
 
-void rwi_lock_t::enqueue_request(access_t access, lock_available_callback_t *callback) {
-    queue.push_back(new lock_request_t(access, callback));
+void rwi_lock_t::enqueue_request(access_t access, lock_available_callback_t *callback,
+                                 lock_site_t *site) {
+    queue.push_back(new lock_request_t(access, callback, site));
 }
 
 void rwi_lock_t::process_queue() {
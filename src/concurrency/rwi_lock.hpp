@@ -8,6 +8,7 @@
 // Forward declarations
 struct rwi_lock_t;
 struct lock_request_t;
+class lock_site_t;
 
 /**
  * Callback class used to notify lock clients that they now have the
@@ -44,8 +45,11 @@ public:
         : state(rwis_unlocked), nreaders(0)
         {}
 
-    // Call to lock for read, write, intent, or upgrade intent to write
-    bool lock(access_t access, lock_available_callback_t *callback);
+    // Call to lock for read, write, intent, or upgrade intent to write.  If
+    // `site` is not `NULL` and lock contention is being profiled, the
+    // acquisition and how long it waited are counted for `site`.
+    bool lock(access_t access, lock_available_callback_t *callback,
+              lock_site_t *site = NULL);
 
     // Like `lock()` but blocks; only legal in a coroutine. If `call_when_in_line` is not zero,
     // it will be called as soon as `co_lock()` has gotten in line for the lock but before
@@ -53,7 +57,8 @@ public:
 
     // You are encouraged to use `read_acq_t` and `write_acq_t` instead of
     // `co_lock()`.
-    void co_lock(access_t access, lock_in_line_callback_t *call_when_in_line = 0);
+    void co_lock(access_t access, lock_in_line_callback_t *call_when_in_line = 0,
+                 lock_site_t *site = NULL);
 
     // Call if you've locked for read or write, or upgraded to write,
     // and are now unlocking.
@@ -66,10 +71,14 @@ public:
     // cache, this is used by the page replacement algorithm to see whether the buffer is in use.)
     bool locked();
 
+    // Returns true if a read lock would be granted right away, but doesn't acquire
+    // the lock.
+    bool read_available();
+
     struct read_acq_t {
         read_acq_t() : lock(NULL) { }
-        explicit read_acq_t(rwi_lock_t *l) : lock(l) {
-            lock->co_lock(rwi_read);
+        explicit read_acq_t(rwi_lock_t *l, lock_site_t *site = NULL) : lock(l) {
+            lock->co_lock(rwi_read, NULL, site);
         }
         void reset() {
             if (lock) {
@@ -91,8 +100,8 @@ public:
 
     struct write_acq_t {
         write_acq_t() : lock(NULL) { }
-        explicit write_acq_t(rwi_lock_t *l) : lock(l) {
-            lock->co_lock(rwi_write);
+        explicit write_acq_t(rwi_lock_t *l, lock_site_t *site = NULL) : lock(l) {
+            lock->co_lock(rwi_write, NULL, site);
         }
         void reset() {
             if (lock) {
@@ -125,7 +134,8 @@ private:
     bool try_lock_write(bool from_queue);
     bool try_lock_intent(bool from_queue);
     bool try_lock_upgrade(bool from_queue);
-    void enqueue_request(access_t access, lock_available_callback_t *callback);
+    void enqueue_request(access_t access, lock_available_callback_t *callback,
+                         lock_site_t *site);
     void process_queue();
 
     rwi_state state;
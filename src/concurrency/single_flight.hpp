@@ -0,0 +1,127 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#ifndef CONCURRENCY_SINGLE_FLIGHT_HPP_
+#define CONCURRENCY_SINGLE_FLIGHT_HPP_
+
+#include <map>
+#include <utility>
+
+#include "errors.hpp"
+#include <boost/shared_ptr.hpp>
+
+#include "concurrency/cond_var.hpp"
+#include "concurrency/wait_any.hpp"
+
+/* `single_flight_t` lets concurrent operations that compute the same value share
+one computation.  The first one to take a ticket for a key leads: it computes the
+value and hands it over with `succeed()`.  The ones that take a ticket for the
+same key while it's at it follow: they `wait()` for the leader and get a copy of
+its value.  If the leader goes away without succeeding (say, because it was
+interrupted), its followers have to compute the value themselves.
+
+It's up to the caller to only use the same key for operations whose values are
+bound to be the same. */
+
+template <class key_t, class value_t>
+class single_flight_t : public home_thread_mixin_debug_only_t {
+private:
+    class flight_t {
+    public:
+        flight_t() : followers(0), succeeded(false) { }
+        int followers;
+        bool succeeded;
+        // Only set if there were followers when the leader succeeded.
+        value_t value;
+        cond_t done;
+    private:
+        DISABLE_COPYING(flight_t);
+    };
+
+public:
+    single_flight_t() { }
+    ~single_flight_t() {
+        rassert(flights.empty());
+    }
+
+    class ticket_t {
+    public:
+        // Leads the computation of the value of `key`, or follows the one that
+        // does already.
+        ticket_t(single_flight_t *_parent, const key_t &_key)
+            : parent(_parent), key(_key), leader(false), registered(false) {
+            parent->assert_thread();
+            typename std::map<key_t, boost::shared_ptr<flight_t> >::iterator it
+                = parent->flights.find(key);
+            if (it != parent->flights.end()) {
+                flight = it->second;
+                ++flight->followers;
+            } else {
+                flight.reset(new flight_t);
+                parent->flights.insert(std::make_pair(key, flight));
+                leader = true;
+                registered = true;
+            }
+        }
+
+        ~ticket_t() {
+            if (registered) {
+                // The followers are on their own.
+                unregister();
+                flight->done.pulse();
+            }
+        }
+
+        bool is_leader() const {
+            return leader;
+        }
+
+        // For the leader: hands `value` to the followers.  Nobody can start
+        // following after this.
+        void succeed(const value_t &value) {
+            guarantee(registered);
+            if (flight->followers > 0) {
+                flight->value = value;
+            }
+            flight->succeeded = true;
+            unregister();
+            flight->done.pulse();
+        }
+
+        // For a follower: waits for the leader and copies its value to
+        // `*value_out`.  Returns false if the leader failed, and the follower
+        // should do the work itself.
+        MUST_USE bool wait(value_t *value_out, signal_t *interruptor)
+            THROWS_ONLY(interrupted_exc_t) {
+            guarantee(!leader);
+            wait_interruptible(&flight->done, interruptor);
+            if (!flight->succeeded) {
+                return false;
+            }
+            *value_out = flight->value;
+            return true;
+        }
+
+    private:
+        void unregister() {
+            parent->assert_thread();
+            parent->flights.erase(key);
+            registered = false;
+        }
+
+        single_flight_t *const parent;
+        const key_t key;
+        boost::shared_ptr<flight_t> flight;
+        bool leader;
+        // Whether new tickets for `key` still follow us.
+        bool registered;
+
+        DISABLE_COPYING(ticket_t);
+    };
+
+private:
+    // The keys whose leaders haven't succeeded yet.
+    std::map<key_t, boost::shared_ptr<flight_t> > flights;
+
+    DISABLE_COPYING(single_flight_t);
+};
+
+#endif  // CONCURRENCY_SINGLE_FLIGHT_HPP_
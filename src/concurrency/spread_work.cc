@@ -0,0 +1,112 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "concurrency/spread_work.hpp"
+
+#include <algorithm>
+#include <exception>
+
+#include <boost/bind.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include "arch/runtime/runtime.hpp"
+#include "arch/spinlock.hpp"
+#include "concurrency/cond_var.hpp"
+#include "do_on_thread.hpp"
+#include "utils.hpp"
+
+/* The chunks of one `spread_work()` call.  The other threads share it through a
+`boost::shared_ptr`, because they may only get to it after the call returned; by
+then there's no chunk left, so they don't touch `fn` or `done`. */
+class spread_work_chunks_t {
+public:
+    spread_work_chunks_t(size_t _count, size_t _grain,
+                         const boost::function<void(size_t, size_t)> *_fn,
+                         cond_t *_done)
+        : count(_count), grain(_grain), num_chunks(ceil_divide(_count, _grain)),
+          fn(_fn), done(_done), home_thread(get_thread_id()),
+          next_chunk(0), chunks_left(num_chunks) { }
+
+    // Runs chunks until there are none left to take.
+    void run() {
+        for (;;) {
+            const size_t chunk = __sync_fetch_and_add(&next_chunk, 1);
+            if (chunk >= num_chunks) {
+                return;
+            }
+
+            try {
+                (*fn)(chunk * grain, std::min(count, (chunk + 1) * grain));
+            } catch (...) {
+                spinlock_acq_t acq(&error_lock);
+                if (error == std::exception_ptr()) {
+                    error = std::current_exception();
+                }
+            }
+
+            if (__sync_sub_and_fetch(&chunks_left, 1) == 0) {
+                do_on_thread(home_thread, boost::bind(&cond_t::pulse, done));
+            }
+        }
+    }
+
+    void rethrow_error() {
+        if (error != std::exception_ptr()) {
+            std::rethrow_exception(error);
+        }
+    }
+
+private:
+    const size_t count;
+    const size_t grain;
+    const size_t num_chunks;
+    const boost::function<void(size_t, size_t)> *const fn;
+    cond_t *const done;
+    const threadnum_t home_thread;
+
+    // Both are changed atomically.
+    size_t next_chunk;
+    size_t chunks_left;
+
+    spinlock_t error_lock;
+    std::exception_ptr error;
+
+    DISABLE_COPYING(spread_work_chunks_t);
+};
+
+void run_spread_work_chunks(const boost::shared_ptr<spread_work_chunks_t> &chunks) {
+    chunks->run();
+}
+
+void spread_work(size_t count, size_t grain,
+                 const boost::function<void(size_t, size_t)> &fn) {
+    guarantee(grain > 0);
+    const size_t num_chunks = ceil_divide(count, grain);
+    const int num_threads = get_num_db_threads();
+    if (num_chunks <= 1 || num_threads <= 1) {
+        if (count > 0) {
+            fn(0, count);
+        }
+        return;
+    }
+
+    cond_t done;
+    boost::shared_ptr<spread_work_chunks_t> chunks(
+        new spread_work_chunks_t(count, grain, &fn, &done));
+
+    // One chunk is for us, so there's no point in offering the others to more
+    // threads than there are chunks left for them.
+    const int me = get_thread_id().threadnum;
+    const size_t num_helpers = std::min<size_t>(num_chunks - 1, num_threads);
+    size_t helpers = 0;
+    for (int i = 1; i <= num_threads && helpers < num_helpers; ++i) {
+        const int thread = (me + i) % num_threads;
+        if (thread != me) {
+            do_on_thread(threadnum_t(thread),
+                         boost::bind(&run_spread_work_chunks, chunks));
+            ++helpers;
+        }
+    }
+
+    chunks->run();
+    done.wait_lazily_unordered();
+    chunks->rethrow_error();
+}
@@ -0,0 +1,26 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef CONCURRENCY_SPREAD_WORK_HPP_
+#define CONCURRENCY_SPREAD_WORK_HPP_
+
+#include <stddef.h>
+
+#include "errors.hpp"
+#include <boost/function.hpp>
+
+/* `spread_work()` calls `fn(begin, end)` on chunks of `grain` elements (the last
+one may be smaller) that cover [0, count), and returns when all of them are done.
+Besides running chunks on the calling thread, it offers them to the other db
+threads; they take them from a shared counter when they get to it, so a thread
+that's idle takes chunks right away and a busy one finds them all taken and does
+nothing.  That's how a single query's CPU work gets to use idle cores.
+
+`fn` gets called outside of a coroutine on threads that don't own the data, so it
+must not block, and must only read what the caller keeps alive and unchanged:
+think sorting a range of a vector, or encoding a range of datums into existing
+protobufs.  If it throws, `spread_work()` rethrows the first exception on the
+calling thread once all the chunks are done.  It's not interruptible, since the
+other threads may still be working on the caller's data. */
+void spread_work(size_t count, size_t grain,
+                 const boost::function<void(size_t, size_t)> &fn);
+
+#endif  // CONCURRENCY_SPREAD_WORK_HPP_
@@ -27,6 +27,17 @@
 // decrease concurrency
 #define MAX_IO_EVENT_PROCESSING_BATCH_SIZE        50
 
+// An event loop that's allowed to spin before it blocks spins for at least this
+// fraction of its allowed time, however long it has been since a spin paid off
+#define EVENT_LOOP_SPIN_MIN_FRACTION              16
+
+// The most that --event-loop-spin allows an idle thread to spin before it blocks
+#define MAX_EVENT_LOOP_SPIN_USECS                 10000
+
+// A blocker pool thread beyond a pool's minimum exits after it has been idle for
+// this long, so that a pool that grew under load shrinks back when the load is gone
+#define BLOCKER_POOL_IDLE_THREAD_NANOS            (10 * BILLION)
+
 // The io batch factor ensures a minimum number of i/o operations
 // which are picked from any specific i/o account consecutively.
 // A higher value might be advantageous for throughput if seek times
@@ -40,6 +51,49 @@
 // useful.
 #define DEFAULT_IO_BATCH_FACTOR                   1
 
+// When the kernel is out of resources for io_uring_enter() and none of its requests
+// are in flight, the io_uring disk manager retries after URING_SUBMIT_RETRY_MIN_MS,
+// doubling the wait up to URING_SUBMIT_RETRY_MAX_MS while it keeps failing.
+#define URING_SUBMIT_RETRY_MIN_MS                 1
+#define URING_SUBMIT_RETRY_MAX_MS                 64
+
+// With a target read latency (see `--io-target-latency`) the disk manager holds
+// back the i/o of background accounts (GC that can wait, backfills, secondary index
+// construction, scrubs and backups) while foreground reads take longer than the
+// target.  It keeps a moving average of the foreground read latency, weighting
+// each new read by 1/IO_SCHEDULER_LATENCY_SMOOTHING, and lets between
+// IO_SCHEDULER_MIN_BACKGROUND_REQUESTS and IO_SCHEDULER_MAX_BACKGROUND_REQUESTS
+// background requests be queued or running at once.  The limit halves, at most
+// once per target latency, while reads are too slow, and grows by about one per
+// round of background requests otherwise.  When there have been no foreground
+// reads for IO_SCHEDULER_FOREGROUND_IDLE_NANOS, the average is forgotten.
+#define IO_SCHEDULER_LATENCY_SMOOTHING            8
+#define IO_SCHEDULER_MIN_BACKGROUND_REQUESTS      1
+#define IO_SCHEDULER_MAX_BACKGROUND_REQUESTS      64
+#define IO_SCHEDULER_FOREGROUND_IDLE_NANOS        (1 * BILLION)
+#define MAX_IO_TARGET_LATENCY_USECS               10000000
+
+// The upper bound of the lowest bucket of the i/o accounts' latency histograms,
+// in seconds.  Every next bucket's is twice as high.
+#define IO_LATENCY_HISTOGRAM_FIRST_BOUND_SECS     0.00001
+
+// The latency percentiles of queries, i/o accounts and master round trips (see
+// perfmon_hdr_histogram_t) are those of the last complete interval this long, and
+// are counted in microseconds.
+#define LATENCY_PERCENTILES_INTERVAL_SECS         10
+#define LATENCY_PERCENTILES_RESOLUTION_SECS       0.000001
+
+// With --profile-lock-contention, the `lock_contention` stat shows this many of
+// the lock sites that waited the longest in total (see lock_site_t).
+#define LOCK_CONTENTION_TOP_SITES                 16
+
+// The disk manager merges the reads, and the writes, of an account that are
+// submitted during the same pass of the event loop and are next to each other in
+// the file into one vectored request of at most IO_MERGE_MAX_REQUESTS requests and
+// IO_MERGE_MAX_BYTES bytes.  An IO_MERGE_MAX_REQUESTS of 1 turns merging off.
+#define IO_MERGE_MAX_REQUESTS                     64
+#define IO_MERGE_MAX_BYTES                        MEGABYTE
+
 // Currently, each cache uses two IO accounts:
 // one account for writes, and one account for reads.
 // By adjusting the priorities of these accounts, reads
@@ -56,6 +110,143 @@
 // 0 = minimal priority
 #define SINDEX_POST_CONSTRUCTION_CACHE_PRIORITY   5
 
+// How many sub-ranges of the primary btree secondary index post construction
+// traverses concurrently, unless the store says otherwise, see
+// btree_store_t::set_sindex_post_construction_streams().  Each stream gets
+// another SINDEX_POST_CONSTRUCTION_CACHE_PRIORITY, up to 100.
+#define SINDEX_POST_CONSTRUCTION_STREAMS          4
+
+// How many secondary index entries a post construction stream collects before
+// it sorts them and inserts them in one write transaction.
+#define SINDEX_POST_CONSTRUCTION_BATCH_SIZE       256
+
+// How many entries of a secondary index a filter answered by intersecting indexes
+// reads at a time, before it checks the other indexes and reads the documents.
+#define SINDEX_INTERSECTION_CHUNK_SIZE            256
+
+// The longest word, in bytes, that a text index keeps.  The index keys of longer
+// ones could be truncated, and nobody searches for them anyway.
+#define TEXT_INDEX_MAX_TERM_SIZE                  64
+
+// How many of the best matches `search` returns unless it's given a `limit`.
+#define TEXT_SEARCH_DEFAULT_LIMIT                 100
+
+// How many freed `ql::datum_t` objects every thread keeps around for the next ones
+// it allocates, instead of returning them to malloc.
+#define DATUM_FREE_LIST_SIZE                      4096
+
+// How many freed `write_buffer_t`s (4 KB each) every thread keeps around for the
+// next messages it serializes, instead of returning them to malloc.
+#define WRITE_BUFFER_FREE_LIST_SIZE               256
+
+// Block buffers are carved out of slabs of this many bytes, which are mapped aligned
+// to their size, see block_buffer_pool.hpp.
+#define BLOCK_BUFFER_SLAB_SIZE                    (2 * MEGABYTE)
+
+// How many bytes of freed block buffers every thread keeps for the next ones it
+// allocates.  The pages of the ones it frees beyond that go back to the kernel.
+#define BLOCK_BUFFER_MAX_FREE_BYTES               (32 * MEGABYTE)
+
+// How many left rows an eq_join on the primary key looks up with each read, unless
+// the `batch_conf` optarg says otherwise.
+#define EQ_JOIN_BATCH_KEYS                        1000
+
+// How many batches of rows an insert from a stream writes at once, while it reads
+// the next batch from the stream.
+#define INSERT_MAX_BATCHES_IN_FLIGHT              4
+
+// The batches of a stream with `batch_conf: {adaptive: true}` start out at
+// ADAPTIVE_BATCH_FIRST_SIZE, so that the first rows get to the client quickly, and
+// grow by ADAPTIVE_BATCH_GROWTH times while the client is slower to come back for
+// the next one than it takes to compute, up to ADAPTIVE_BATCH_MAX_SIZE (or the
+// `max_size` of the `batch_conf`), which bounds what every stream of a connection
+// holds in memory at once.
+#define ADAPTIVE_BATCH_FIRST_SIZE                 (16 * KILOBYTE)
+#define ADAPTIVE_BATCH_GROWTH                     2
+#define ADAPTIVE_BATCH_MAX_SIZE                   (4 * MEGABYTE)
+
+// How many datums of a batch get encoded into the response at a time; the chunks
+// of bigger batches are spread over the idle db threads, see spread_work().
+#define RESPONSE_ENCODE_CHUNK_DATUMS              128
+
+// How many bytes of batches the streams of a connection may read ahead of the
+// client asking for them, by their size budgets, see stream_cache2_t.
+#define STREAM_PREFETCH_MAX_SIZE                  (16 * MEGABYTE)
+
+// How many bytes the streams the clients of a node have open may hold, by the
+// sizes of their batches, before the least recently used idle ones get evicted, see
+// stream_cache2_t.  Every thread gets an equal share.
+#define STREAM_CACHE_MAX_SIZE                     (256 * MEGABYTE)
+
+// How many of its traced and slow queries every thread keeps in the slow query log,
+// and which queries it logs until the admin API sets otherwise: one query in
+// SLOW_QUERY_DEFAULT_SAMPLE_EVERY gets traced, and every query that takes more than
+// SLOW_QUERY_DEFAULT_THRESHOLD_MS of server time is slow, see slow_query_log_t.
+#define SLOW_QUERY_LOG_SIZE_PER_THREAD            64
+#define SLOW_QUERY_DEFAULT_SAMPLE_EVERY           1000
+#define SLOW_QUERY_DEFAULT_THRESHOLD_MS           1000
+// Where the fingerprints of big queries get cut off.
+#define SLOW_QUERY_MAX_FINGERPRINT_SIZE           1024
+
+// The format of the files of `--capture-queries`, and how the capture writes them:
+// every thread appends its buffer to the file once it holds
+// QUERY_CAPTURE_BUFFER_SIZE bytes or every QUERY_CAPTURE_FLUSH_INTERVAL_MS, at most
+// QUERY_CAPTURE_MAX_PENDING_WRITES buffers wait for the disk, and the capture stops
+// at QUERY_CAPTURE_MAX_FILE_SIZE bytes, see query_capture_t.
+#define QUERY_CAPTURE_MAGIC                       "RQLCAP01"
+#define QUERY_CAPTURE_BUFFER_SIZE                 (64 * KILOBYTE)
+#define QUERY_CAPTURE_FLUSH_INTERVAL_MS           1000
+#define QUERY_CAPTURE_MAX_PENDING_WRITES          64
+#define QUERY_CAPTURE_MAX_FILE_SIZE               (4 * GIGABYTE)
+
+// How the server writes its log: the messages logged while a write is on the disk
+// all go out in the next write, the log is synced at most every
+// LOG_FSYNC_INTERVAL_MS unless an error is logged, and a message logged again
+// within LOG_DUPLICATE_SUPPRESSION_SECS of the last time it was written is only
+// counted, see thread_pool_log_writer_t.
+#define LOG_FSYNC_INTERVAL_MS                     1000
+#define LOG_DUPLICATE_SUPPRESSION_SECS            10
+
+// The precision of the HyperLogLog sketches of `approx_count_distinct`: they have
+// 2^DISTINCT_SKETCH_PRECISION one-byte registers and are off by about
+// 1.04 / sqrt(2^DISTINCT_SKETCH_PRECISION), 1.6% at 12.
+#define DISTINCT_SKETCH_PRECISION                 12
+
+// How many numbers the smallest compactor of the quantile sketches of
+// `approx_quantile` holds.  The sketches hold about three times that many, and
+// their rank error is around 1.7 / QUANTILE_SKETCH_K.
+#define QUANTILE_SKETCH_K                         200
+
+// How many changes a `changes` feed holds for its query before it drops the oldest
+// of them and fails, see changefeed::feed_t.
+#define CHANGEFEED_MAX_BUFFERED_CHANGES           100000
+
+// How many compiled regexps of `match` every thread keeps, by their patterns.
+#define REGEX_CACHE_SIZE                          64
+
+// How many bytes every direction of the shared memory ring between the main process
+// and an extproc worker holds, see shm_ring_t.  0 makes them use the socket.
+#define EXTPROC_RING_SIZE                         (1 * MEGABYTE)
+
+// How many extproc workers the pool keeps spawned even when they're idle, how
+// long the ones beyond that may stay idle before the pool kills them, and how
+// often it looks for them.
+#define EXTPROC_MIN_WORKERS                       2
+#define EXTPROC_WORKER_IDLE_TIMEOUT_MS            (60 * THOUSAND)
+#define EXTPROC_POOL_SHRINK_INTERVAL_MS           (5 * THOUSAND)
+
+// How many extproc workers the pool of a node may have per thread.  Queries hold
+// their worker while they wait on their tables, so more of them than threads keep
+// the CPUs busy.
+#define EXTPROC_MAX_WORKERS_PER_THREAD            4
+
+// The cache priority to use for replaying the warm-up manifest after a restart
+// (same scale as above).
+#define CACHE_WARMUP_CACHE_PRIORITY               5
+
+// How many blocks of the warm-up manifest a cache reads at once.
+#define CACHE_WARMUP_BATCH_SIZE                   64
+
 // Garbage Colletion uses its own two IO accounts.
 // There is one low-priority account that is meant to guarantee
 // (performance-wise) unintrusive garbage collection.
@@ -69,6 +260,64 @@
 #define GC_IO_PRIORITY_NICE                       8
 #define GC_IO_PRIORITY_HIGH                       (4 * CACHE_WRITES_IO_PRIORITY)
 
+// The i/o priority of the background scrub that verifies block checksums, see
+// log_serializer_dynamic_config_t::scrub_on_startup.
+#define SERIALIZER_SCRUB_IO_PRIORITY              GC_IO_PRIORITY_NICE
+
+// The i/o priority of the writes of the LBA's garbage collection, which the index
+// writes start: as high as those of the index writes of the cache.
+#define LBA_GC_IO_PRIORITY                        MERGED_INDEX_WRITE_IO_PRIORITY
+
+// The i/o priority of the reads of a physical backup, and how many blocks it reads
+// and restore writes at once, see serializer/backup.hpp.
+#define PHYSICAL_BACKUP_IO_PRIORITY               GC_IO_PRIORITY_NICE
+#define PHYSICAL_BACKUP_BATCH_BLOCKS              64
+
+// A disk-backed queue appends its values to a chunk of this many bytes in memory
+// and only writes the chunk to its file once it's full, and reads its file a chunk
+// at a time, see internal_disk_backed_queue_t.
+#define DISK_BACKED_QUEUE_CHUNK_SIZE              (512 * KILOBYTE)
+
+// How long the metadata persister waits after the metadata changes before it
+// writes it, so that a burst of changes gets written once, see
+// semilattice_watching_persister_t.
+#define METADATA_PERSIST_COALESCE_MS              50
+
+// How many freed extents per second the serializer discards at most, and how many
+// it may discard at once after a quiet period, see
+// log_serializer_dynamic_config_t::discard_freed_extents.
+#define EXTENT_DISCARD_RATE                       256
+#define EXTENT_DISCARD_BURST                      64
+
+// How many sub-ranges of a region a backfill traverses concurrently, see
+// do_agnostic_btree_backfill().
+#define BACKFILL_STREAMS_PER_RANGE                4
+
+// How many up-to-date replicas a new secondary backfills from at once, each one
+// supplying a part of its region.
+#define BACKFILL_MAX_SOURCES                      3
+
+// A backfill sends the key/value pairs it finds in chunks of up to about this many
+// bytes, which the backfillee writes in one transaction each.
+#define BACKFILL_CHUNK_MAX_BYTES                  (64 * KILOBYTE)
+
+// The backfills of a table on a server adapt to the latency of the table's
+// reads and writes there, see backfill_governor_t.  Every
+// BACKFILL_GOVERNOR_INTERVAL_MS, the share of their full concurrency they may use
+// halves if the moving average of that latency (weighting each new operation by
+// BACKFILL_GOVERNOR_LATENCY_SMOOTHING) is above
+// BACKFILL_TARGET_FOREGROUND_LATENCY_MS, and grows by BACKFILL_GOVERNOR_SHARE_STEP
+// otherwise.  It never drops below BACKFILL_GOVERNOR_MIN_SHARE.
+#define BACKFILL_TARGET_FOREGROUND_LATENCY_MS     20
+#define BACKFILL_GOVERNOR_INTERVAL_MS             100
+#define BACKFILL_GOVERNOR_LATENCY_SMOOTHING       0.2
+#define BACKFILL_GOVERNOR_SHARE_STEP              (1.0 / 16)
+#define BACKFILL_GOVERNOR_MIN_SHARE               (1.0 / 32)
+
+// How many random walks down to a leaf a sampled distribution read takes per
+// shard, see sample_btree_key_distribution().
+#define DISTRIBUTION_SAMPLE_DESCENTS              512
+
 // Size of the buffer used to perform IO operations (in bytes).
 #define IO_BUFFER_SIZE                            (4 * KILOBYTE)
 
@@ -81,6 +330,11 @@
 // Size of each btree node (in bytes) on disk
 #define DEFAULT_BTREE_BLOCK_SIZE                  (4 * KILOBYTE)
 
+// The block sizes a table can be created with, see the `block_size` optarg of
+// `table_create`.  Btree nodes use 16-bit offsets, so blocks can't be larger.
+#define MIN_BTREE_BLOCK_SIZE                      (4 * KILOBYTE)
+#define MAX_BTREE_BLOCK_SIZE                      (64 * KILOBYTE)
+
 // Size of each extent (in bytes)
 #define DEFAULT_EXTENT_SIZE                       (512 * KILOBYTE)
 
@@ -106,8 +360,14 @@
 // TODO: make this dynamic where possible
 #define MAX_THREADS                               128
 
-// Ticks (in milliseconds) the internal timed tasks are performed at
-#define TIMER_TICKS_IN_MS                         5
+// The timing wheel of timer_handler_t has TIMER_WHEEL_LEVELS levels of
+// TIMER_WHEEL_SLOTS slots (which must be 64, for the bitmaps of the occupied
+// ones), and its ticks are TIMER_WHEEL_TICK_NANOS long.  Timers ring on the first
+// tick after they're due, so that's how late they may be.  The wheel spans
+// 64^6 ticks, about 200 days; timers beyond that go around it again.
+#define TIMER_WHEEL_LEVELS                        6
+#define TIMER_WHEEL_SLOTS                         64
+#define TIMER_WHEEL_TICK_NANOS                    250000
 
 // How many milliseconds to allow changes to sit in memory before flushing to disk
 #define DEFAULT_FLUSH_TIMER_MS                    1000
@@ -117,6 +377,24 @@
 // on a specific slice at any given time.
 #define DEFAULT_MAX_CONCURRENT_FLUSHES            1
 
+// With adaptive flushing, a hard durability commit waits for up to this fraction of
+// the recent flush latency (but at most WRITEBACK_GROUP_COMMIT_MAX_DELAY_MS) for other
+// write transactions to commit, so that they can all be written by one flush...
+#define WRITEBACK_GROUP_COMMIT_DELAY_FRACTION     0.5
+#define WRITEBACK_GROUP_COMMIT_MAX_DELAY_MS       10
+
+// ...unless this many hard durability commits are already waiting for the flush.
+#define WRITEBACK_GROUP_COMMIT_BATCH_SIZE         16
+
+// With adaptive flushing, the flush timer interval gets stretched (by up to
+// WRITEBACK_MAX_FLUSH_INTERVAL_STRETCH times) once flushes take longer than this
+// fraction of it, so that a saturated disk doesn't spend all its time on timed flushes.
+#define WRITEBACK_SATURATED_FLUSH_FRACTION        0.25
+#define WRITEBACK_MAX_FLUSH_INTERVAL_STRETCH      4.0
+
+// How much weight the most recent flush gets when smoothing the flush latency.
+#define WRITEBACK_FLUSH_LATENCY_SMOOTHING         0.2
+
 // If more than this many bytes of dirty data accumulate in the cache, then write
 // transactions will be throttled.  A value of 0 means that it will automatically be
 // set to MAX_UNSAVED_DATA_LIMIT_FRACTION times the max cache size
@@ -128,12 +406,109 @@
 // We start flushing dirty pages as soon as we hit this fraction of the unsaved data limit
 #define FLUSH_AT_FRACTION_OF_UNSAVED_DATA_LIMIT   0.2
 
+// Write transactions get delayed once the dirty data in the cache exceeds this fraction
+// of the unsaved data limit (or the flush threshold, if that is higher), increasingly so
+// until the limit is reached and they have to wait for a flush.
+#define WRITEBACK_BACKPRESSURE_START_FRACTION     0.5
+
+// The longest a write transaction gets delayed (in ms) before the unsaved data limit
+// stops it outright.
+#define WRITEBACK_MAX_BACKPRESSURE_DELAY_MS       20
+
+// The caches that share the node-wide dirty budget may together hold this fraction of
+// the sum of their unsaved data limits, see buffer_cache/mirrored/dirty_budget.hpp.
+#define WRITEBACK_NODE_DIRTY_BUDGET_FRACTION      0.5
+
 // How many times the page replacement algorithm tries to find an eligible page before giving up.
 // Note that (MAX_UNSAVED_DATA_LIMIT_FRACTION ** PAGE_REPL_NUM_TRIES) is the probability that the
 // page replacement algorithm will succeed on a given try, and if that probability is less than 1/2
 // then the page replacement algorithm will on average be unable to evict pages from the cache.
 #define PAGE_REPL_NUM_TRIES                       10
 
+// The page replacement policy used by caches that don't ask for a specific one.
+// (One of the page_repl_policy_t values in buffer_cache/mirrored/config.hpp.)
+#define DEFAULT_PAGE_REPL_POLICY                  PAGE_REPL_POLICY_RANDOM
+
+// The page replacement policy used by the caches of table stores, which see a mix of
+// point lookups and large scans.
+#define TABLE_PAGE_REPL_POLICY                    PAGE_REPL_POLICY_CLOCK
+
+// The fraction of the cache that the clock page replacement policy reserves for bufs
+// which have not been reused since they were loaded. Larger values make the policy
+// behave more like plain LRU, smaller values make it more scan-resistant.
+#define PAGE_REPL_CLOCK_COLD_FRACTION             0.1
+
+// The maximum fraction of the cache that can be taken up by bufs that were loaded by
+// transactions with the CACHE_ACCESS_HINT_ONCE hint (for example range scans).
+#define PAGE_REPL_PROBATION_FRACTION              0.05
+
+// How many rows a range read without a terminal goes through before the leaves it
+// loads from then on get the CACHE_ACCESS_HINT_ONCE hint.  Reads with a terminal
+// (count, reduce, ...) go through their whole range, and use it right away.
+#define RGET_ACCESS_HINT_ONCE_MIN_ROWS            1000
+
+// The fraction of the cache that the btrees' internal nodes can be pinned in, so that
+// lookups don't have to read them from disk when the cache is under pressure.  With a
+// fanout in the hundreds they're about a percent of a btree, so this holds all of them
+// for btrees several times larger than the cache, and the upper levels beyond that.
+#define DEFAULT_CACHE_PINNED_FRACTION             0.05
+
+// Evicted blocks are only kept in the compressed tier of the cache if they compress
+// to at most this fraction of their size.
+#define COMPRESSED_TIER_MAX_COMPRESSION_RATIO     0.75
+
+// The fraction of a table store's cache that is used for the compressed tier. 0
+// disables the compressed tier.
+#define TABLE_CACHE_COMPRESSED_TIER_FRACTION      0.0
+
+// Whether table serializers store blocks compressed on disk. Files with
+// compressed blocks can't be read by versions that don't know about them.
+#define TABLE_SERIALIZER_COMPRESS_BLOCKS          false
+
+// How many tables a server opens at once, for example when it starts up and
+// the reactor driver asks for the stores of every table it knows about. Each
+// open reads the serializer's LBA and the stores' superblocks, so opening them
+// all at once would make every table wait for the slowest disk.
+#define MAX_CONCURRENT_TABLE_OPENS                4
+
+// How often (in ms) a cache that participates in the memory broker reports its miss
+// rate and picks up its new size, see buffer_cache/mirrored/memory_broker.hpp.
+#define MEMORY_BROKER_INTERVAL_MS                 1000
+
+// The memory broker never shrinks a cache below this fraction of its configured size.
+#define MEMORY_BROKER_MIN_SIZE_FRACTION           0.25
+
+// How much weight the memory broker gives to the most recent interval when
+// smoothing a cache's miss rate.
+#define MEMORY_BROKER_MISS_RATE_SMOOTHING         0.5
+
+// The working set estimator of a cache follows one in this many of its blocks,
+// picked by a hash of their block ids, see buffer_cache/mirrored/working_set.hpp.
+#define WORKING_SET_SAMPLING_RATE                 128
+
+// How many of the followed blocks the working set estimator remembers.  Blocks
+// that are reused after more distinct blocks than that count as misses for
+// every cache size.
+#define WORKING_SET_MAX_SAMPLED_BLOCKS            8192
+
+// The working set estimator reports the hit ratios for caches of
+// WORKING_SET_MIN_CACHE_SIZE, twice that, and so on, WORKING_SET_CACHE_SIZES
+// sizes in all.
+#define WORKING_SET_MIN_CACHE_SIZE                (64 * MEGABYTE)
+#define WORKING_SET_CACHE_SIZES                   9
+
+// After this many sampled accesses the working set estimator halves its counts,
+// so the hit ratios follow the recent workload.
+#define WORKING_SET_DECAY_ACCESSES                (1 << 16)
+
+// How many children of an internal node a btree traversal prefetches ahead of the
+// one it is descending into.
+#define BTREE_TRAVERSAL_PREFETCH_CHILDREN         8
+
+// How many bytes of block copies writers may keep for a snapshotted range scan
+// before the scan ends its batch early and continues in a new snapshot.
+#define SNAPSHOT_SCAN_MAX_COPIED_BYTES            (32 * MEGABYTE)
+
 // How large can the key be, in bytes?  This value needs to fit in a byte.
 #define MAX_KEY_SIZE                              250
 
@@ -152,9 +527,128 @@
 // have to wait until the first one finishes
 #define MAX_CONCURRENT_QUERIES_PER_CONNECTION     500
 
+// Requests of the protocol buffer servers up to this size are parsed right out of the
+// read buffer of their connection, and their protocol buffers objects get reused.
+#define PROTOB_BUFFERED_REQUEST_MAX_SIZE          (16 * KILOBYTE)
+
+// How many of the requests of a connection a protocol buffer server holds on to, to
+// parse later requests into once they're done.
+#define PROTOB_RECYCLED_REQUESTS_PER_CONNECTION   16
+
+// Responses to clients that asked for compression are compressed if they're at
+// least this big.  Smaller ones hardly shrink, and they cost a round trip anyway.
+#define PROTOB_COMPRESS_RESPONSE_MIN_SIZE         (4 * KILOBYTE)
+
+// How many queries of a client connection of the RDB protocol may run at once.  The
+// connection reads no more queries until one of them is done.
+#define MAX_CONCURRENT_RDB_QUERIES_PER_CONNECTION 64
+
+// How long a row in the near cache of a server answers `get`s with `use_outdated`,
+// see ql::near_cache_t.  Replicas may lag behind their primaries about as much.
+#define NEAR_CACHE_TTL_MS                         1000
+
 // The number of concurrent queries when loading memcached operations from a file.
 #define MAX_CONCURRENT_QUEURIES_ON_IMPORT         1000
 
+// A memcached store looks through this many keys for expired values at a time, and
+// erases the ones it finds in one write transaction.
+#define MEMCACHED_EXPIRY_SWEEP_BATCH_SIZE         1024
+
+// How long a memcached store waits between two batches of its expiry sweep, so the
+// sweep doesn't compete with queries for the btree.
+#define MEMCACHED_EXPIRY_SWEEP_BATCH_INTERVAL_MS  100
+
+// How long a memcached store waits after sweeping its whole btree for expired
+// values before it starts over.
+#define MEMCACHED_EXPIRY_SWEEP_PASS_INTERVAL_MS   (60 * THOUSAND)
+
+// How long the HTTP server waits for a client to send a whole request on a
+// persistent connection before it closes the connection.
+#define HTTP_KEEPALIVE_IDLE_TIMEOUT_MS            (30 * THOUSAND)
+
+// A node answers requests for its stats with the stats it collected for an earlier
+// request, unless they're older than this.
+#define STAT_SNAPSHOT_MAX_AGE_MS                  1000
+
+// While a shard's master has this many writes in the broadcaster, combinable writes
+// queue up behind them to be combined into one write.
+#define MASTER_MAX_COMBINED_WRITES_IN_FLIGHT      32
+
+// The most writes a master combines into one.
+#define MASTER_MAX_COMBINED_WRITES                500
+
+// How many TCP connections a node opens to each other node by default, and at
+// most.  All but the first of them carry large bulk-class messages, so that those
+// don't hold up heartbeats and other small messages behind them.
+#define DEFAULT_CLUSTER_CONNECTIONS_PER_PEER      2
+#define MAX_CLUSTER_CONNECTIONS_PER_PEER          16
+
+// Bulk-class cluster messages smaller than this still go on the first connection.
+#define CLUSTER_BULK_MESSAGE_MIN_BYTES            (16 * KILOBYTE)
+
+// Cluster messages smaller than this don't get compressed.
+#define CLUSTER_COMPRESSION_MIN_BYTES             KILOBYTE
+
+// A node checks its connections for heartbeats this often.  When the gaps
+// between a peer's heartbeats have been regular, a phi above
+// HEARTBEAT_PHI_THRESHOLD (a one in 10^8 chance that the peer is merely slow)
+// gets it disconnected, which happens sooner than the fixed timeout that is
+// used until HEARTBEAT_PHI_MIN_SAMPLES gaps have been seen.
+#define HEARTBEAT_CHECK_INTERVAL_MS               500
+#define HEARTBEAT_PHI_THRESHOLD                   8.0
+#define HEARTBEAT_PHI_MIN_SAMPLES                 10
+
+// How many of a peer's most recent heartbeat gaps the phi is computed from, the
+// smallest standard deviation assumed for them, and how much longer than the
+// mean gap a heartbeat may take without raising phi much.  The slack covers a
+// peer not sending heartbeats while it has other messages to send.
+#define HEARTBEAT_PHI_WINDOW                      200
+#define HEARTBEAT_PHI_MIN_STDDEV_MS               500
+#define HEARTBEAT_PHI_ACCEPTABLE_PAUSE_MS         2000
+
+// How many bytes of writes the broadcaster keeps queued for an async replica
+// (see blueprint_role_async_secondary) before it stops letting writes complete
+// ahead of that replica.  Past this, the replica holds writes up like any other
+// secondary, which bounds both its lag and the memory of its queue.
+#define ASYNC_REPLICA_MAX_LAG_BYTES               (64 * MEGABYTE)
+
+// How much each outdated read moves the estimate of its replica's latency
+// that is used to pick replicas for later outdated reads.
+#define OUTDATED_READ_LATENCY_WEIGHT              0.2
+
+// Every this many changes, a node sends its whole directory metadata to its
+// peers instead of just the part that changed.
+#define DIRECTORY_FULL_UPDATE_INTERVAL            64
+
+// A cluster connection holds back a write until the end of the event loop pass,
+// so that more messages can go out with it, only while its messages add up to
+// less than this.
+#define CLUSTER_COALESCE_MAX_BYTES                (64 * KILOBYTE)
+
+// How many shard roles a machine carrying the average load of its cluster is
+// worth when the suggester picks machines for new roles.
+#define SUGGESTER_LOAD_WEIGHT                     2.0
+
+// How often a server running with --auto-shard looks for shards to split or
+// merge, and how long it waits for the stats of the other servers each time.
+#define AUTO_SHARD_INTERVAL_MS                    (60 * THOUSAND)
+#define AUTO_SHARD_STATS_TIMEOUT_MS               (5 * THOUSAND)
+
+// A shard is split once it serves more requests per second or holds more bytes
+// than this, but only if that is also this many times the average shard of its
+// table.  Two neighbouring shards are merged once they serve less than a
+// quarter of the requests and hold less than a quarter of the bytes together.
+#define AUTO_SHARD_SPLIT_REQUESTS_PER_SEC         2000
+#define AUTO_SHARD_SPLIT_BYTES                    (16 * GIGABYTE)
+#define AUTO_SHARD_HOT_RATIO                      2.0
+
+// How many rounds in a row a shard has to be hot (or a pair of shards cold)
+// before it is split (or merged), how long a table is left alone after it was
+// changed, and how many shards the auto sharder splits a table into at most.
+#define AUTO_SHARD_ROUNDS                         3
+#define AUTO_SHARD_COOLDOWN_SECS                  600
+#define AUTO_SHARD_MAX_SHARDS                     32
+
 // How many timestamps we store in a leaf node.  We store the
 // NUM_LEAF_NODE_EARLIER_TIMES+1 most-recent timestamps.
 #define NUM_LEAF_NODE_EARLIER_TIMES               4
@@ -189,6 +683,9 @@
 #define GC_YOUNG_EXTENT_MAX_SIZE                  50
 // What's the definition of a "young" extent in microseconds?
 #define GC_YOUNG_EXTENT_TIMELIMIT_MICROS          50000
+// How often (in microseconds) the GC recomputes the age-weighted cost-benefit
+// scores of the old extents it picks victims from.
+#define GC_SCORE_REFRESH_INTERVAL_MICROS          1000000
 
 // If the size of the LBA on a given disk exceeds LBA_MIN_SIZE_FOR_GC, then the fraction of the
 // entries that are live and not garbage should be at least LBA_MIN_UNGARBAGE_FRACTION.
@@ -213,8 +710,32 @@
 
 #define COROUTINE_STACK_SIZE                      131072
 
+// How many unused coroutines a thread keeps ready with their stacks as they are.
+// The stacks of the ones beyond that, which went unused the longest, give their
+// pages back to the OS until they get used again, so a burst of coroutines doesn't
+// hold on to its memory afterwards.
+#define COROUTINE_HOT_FREE_STACKS                 256
+
 #define MAX_COROS_PER_THREAD                      10000
 
+// How many samples a second of its CPU time the coroutine sampler takes of each
+// thread once started (see coro_sampler_t), how many frames of the backtrace of
+// a sample it keeps, and how many different samples each thread has room for.
+#define CORO_SAMPLER_FREQUENCY                    97
+#define CORO_SAMPLER_BACKTRACE_DEPTH              12
+#define CORO_SAMPLER_TABLE_SIZE                   2048
+// How many slots of its table the signal handler looks at for a sample before it
+// counts it as dropped.
+#define CORO_SAMPLER_MAX_PROBES                   32
+
+// The rethinkdb-microbench benchmarks run in a thread pool of
+// MICROBENCH_NUM_THREADS threads, and each of them runs
+// MICROBENCH_DEFAULT_WARMUP_RUNS times and then MICROBENCH_DEFAULT_RUNS timed
+// times unless it's told otherwise (see microbench::run_config_t).
+#define MICROBENCH_NUM_THREADS                    4
+#define MICROBENCH_DEFAULT_WARMUP_RUNS            100
+#define MICROBENCH_DEFAULT_RUNS                   1000
+
 
 // Size of a cache line (used in cache_line_padded_t).
 #define CACHE_LINE_SIZE                           64
@@ -249,6 +770,10 @@
 // 2^(MESSAGE_SCHEDULER_MAX_PRIORITY - MESSAGE_SCHEDULER_MIN_PRIORITY + 1)
 #define MESSAGE_SCHEDULER_GRANULARITY           32
 
+// With --profile-scheduler, the messages that run this long before they give the
+// event loop back are counted as long slices (see scheduler_stats.hpp).
+#define SCHEDULER_LONG_SLICE_THRESHOLD_SECS     0.005
+
 // Priorities for specific tasks
 #define CORO_PRIORITY_SINDEX_CONSTRUCTION       (-2)
 #define CORO_PRIORITY_BACKFILL_SENDER           (-2)
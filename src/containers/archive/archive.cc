@@ -3,11 +3,15 @@
 
 #include <string.h>
 #include <netinet/in.h>
+#include <sys/uio.h>
 
 #include <algorithm>
+#include <vector>
 
+#include "config/args.hpp"
 #include "containers/uuid.hpp"
 #include "rpc/serialize_macros.hpp"
+#include "thread_local.hpp"
 
 const char *archive_result_as_str(archive_result_t archive_result) {
     switch (archive_result) {
@@ -55,17 +59,75 @@ int64_t force_read(read_stream_t *s, void *p, int64_t n) {
     return written_so_far;
 }
 
+// A freed buffer's memory holds the pointer to the next one on the list.
+struct free_write_buffer_t {
+    free_write_buffer_t *next;
+};
+
+TLS_with_init(free_write_buffer_t *, write_buffer_free_list, NULL);
+TLS_with_init(size_t, write_buffer_free_list_size, 0);
+
+void *write_buffer_t::operator new(size_t size) {
+    rassert(size == sizeof(write_buffer_t));
+    free_write_buffer_t *head = TLS_get_write_buffer_free_list();
+    if (head == NULL) {
+        return ::operator new(size);
+    }
+    TLS_set_write_buffer_free_list(head->next);
+    TLS_set_write_buffer_free_list_size(TLS_get_write_buffer_free_list_size() - 1);
+    return head;
+}
+
+void write_buffer_t::operator delete(void *p, size_t size) {
+    rassert(size == sizeof(write_buffer_t));
+    if (p == NULL) {
+        return;
+    }
+    // Messages are often sent from another thread than they were built on,
+    // then their buffers just end up on that thread's list.
+    const size_t list_size = TLS_get_write_buffer_free_list_size();
+    if (list_size >= WRITE_BUFFER_FREE_LIST_SIZE) {
+        ::operator delete(p);
+        return;
+    }
+    free_write_buffer_t *block = static_cast<free_write_buffer_t *>(p);
+    block->next = TLS_get_write_buffer_free_list();
+    TLS_set_write_buffer_free_list(block);
+    TLS_set_write_buffer_free_list_size(list_size + 1);
+}
+
 write_message_t::~write_message_t() {
     while (write_buffer_t *buffer = buffers_.head()) {
         buffers_.remove(buffer);
         delete buffer;
     }
+    while (write_buffer_t *buffer = spare_buffers_.head()) {
+        spare_buffers_.remove(buffer);
+        delete buffer;
+    }
+}
+
+void write_message_t::reserve(size_t n) {
+    size_t available = spare_buffers_.size() * write_buffer_t::DATA_SIZE;
+    if (!buffers_.empty()) {
+        available += write_buffer_t::DATA_SIZE - buffers_.tail()->size;
+    }
+    while (available < n) {
+        spare_buffers_.push_back(new write_buffer_t);
+        available += write_buffer_t::DATA_SIZE;
+    }
 }
 
 void write_message_t::append(const void *p, int64_t n) {
     while (n > 0) {
         if (buffers_.empty() || buffers_.tail()->size == write_buffer_t::DATA_SIZE) {
-            buffers_.push_back(new write_buffer_t);
+            write_buffer_t *spare = spare_buffers_.head();
+            if (spare != NULL) {
+                spare_buffers_.remove(spare);
+                buffers_.push_back(spare);
+            } else {
+                buffers_.push_back(new write_buffer_t);
+            }
         }
 
         write_buffer_t *b = buffers_.tail();
@@ -78,6 +140,10 @@ void write_message_t::append(const void *p, int64_t n) {
     }
 }
 
+void write_message_t::append_message(write_message_t *other) {
+    buffers_.append_and_clear(&other->buffers_);
+}
+
 size_t write_message_t::size() const {
     size_t ret = 0;
     for (write_buffer_t *h = buffers_.head(); h != NULL; h = buffers_.next(h)) {
@@ -86,15 +152,40 @@ size_t write_message_t::size() const {
     return ret;
 }
 
-int send_write_message(write_stream_t *s, const write_message_t *msg) {
-    intrusive_list_t<write_buffer_t> *list = const_cast<write_message_t *>(msg)->unsafe_expose_buffers();
-    for (write_buffer_t *p = list->head(); p; p = list->next(p)) {
-        int64_t res = s->write(p->data, p->size);
+int64_t write_stream_t::writev(const struct iovec *iov, int iovcnt) {
+    int64_t total = 0;
+    for (int i = 0; i < iovcnt; ++i) {
+        int64_t res = write(iov[i].iov_base, iov[i].iov_len);
         if (res == -1) {
             return -1;
         }
-        rassert(res == p->size);
+        rassert(res == static_cast<int64_t>(iov[i].iov_len));
+        total += res;
+    }
+    return total;
+}
+
+int send_write_message(write_stream_t *s, const write_message_t *msg) {
+    // The buffers go to the stream in one writev(), so that a stream like a
+    // tcp_conn_stream_t doesn't have to wait for them one by one.
+    intrusive_list_t<write_buffer_t> *list = const_cast<write_message_t *>(msg)->unsafe_expose_buffers();
+    std::vector<struct iovec> iov;
+    int64_t size = 0;
+    for (write_buffer_t *p = list->head(); p; p = list->next(p)) {
+        struct iovec buffer;
+        buffer.iov_base = p->data;
+        buffer.iov_len = p->size;
+        iov.push_back(buffer);
+        size += p->size;
+    }
+    if (iov.empty()) {
+        return 0;
+    }
+    int64_t res = s->writev(iov.data(), iov.size());
+    if (res == -1) {
+        return -1;
     }
+    rassert(res == size);
     return 0;
 }
 
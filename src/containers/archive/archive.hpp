@@ -4,10 +4,13 @@
 
 #include <stdint.h>
 
+#include <type_traits>
+
 #include "containers/intrusive_list.hpp"
 #include "utils.hpp"
 
 class uuid_u;
+struct iovec;
 
 struct fake_archive_exc_t {
     const char *what() const throw() {
@@ -75,6 +78,10 @@ public:
     write_stream_t() { }
     // Returns n, or -1 upon error. Blocks until all bytes are written.
     virtual MUST_USE int64_t write(const void *p, int64_t n) = 0;
+    // Like write(), of the `iovcnt` buffers of `iov` one after another.  Streams
+    // that can write them all at once override it; by default it writes them one
+    // by one.  Returns their size, or -1 upon error.
+    virtual MUST_USE int64_t writev(const struct iovec *iov, int iovcnt);
 protected:
     virtual ~write_stream_t() { }
 private:
@@ -85,6 +92,11 @@ class write_buffer_t : public intrusive_list_node_t<write_buffer_t> {
 public:
     write_buffer_t() : size(0) { }
 
+    // Large messages take hundreds of these, so freed ones go on a per-thread free
+    // list (see WRITE_BUFFER_FREE_LIST_SIZE) for the next messages to reuse.
+    static void *operator new(size_t size);
+    static void operator delete(void *p, size_t size);
+
     static const int DATA_SIZE = 4096;
     int size;
     char data[DATA_SIZE];
@@ -106,6 +118,15 @@ public:
 
     void append(const void *p, int64_t n);
 
+    // Makes sure that the next `n` bytes appended don't have to allocate any
+    // buffers, for callers that know how much they are about to append (for
+    // example from `serialized_size()`).
+    void reserve(size_t n);
+
+    // Moves the buffers of `other` to the end of this message, without copying
+    // them.  `other` is left empty.
+    void append_message(write_message_t *other);
+
     size_t size() const;
 
     intrusive_list_t<write_buffer_t> *unsafe_expose_buffers() { return &buffers_; }
@@ -119,6 +140,8 @@ private:
     friend int send_write_message(write_stream_t *s, const write_message_t *msg);
 
     intrusive_list_t<write_buffer_t> buffers_;
+    // Empty buffers that `reserve()` allocated for `append()` to use next.
+    intrusive_list_t<write_buffer_t> spare_buffers_;
 
     DISABLE_COPYING(write_message_t);
 };
@@ -184,9 +207,40 @@ empty_ok_t<T> empty_ok(T &field) {
     return empty_ok_t<T>(&field);
 }
 
+/* `archive_raw_t<T>` holds for the types whose serialized form is exactly the
+bytes they have in memory: the fixed-width primitive types below, `uuid_u`, and
+the classes that use `RDB_MAKE_ME_SERIALIZABLE_RAW_*()`.  Those get written and
+read with one copy, and so do whole vectors of them. */
+template <class T, class enable_t = void>
+struct archive_raw_t : public std::false_type { };
+
+template <class T>
+struct archive_raw_t<T, typename std::enable_if<T::rdb_archive_raw_size == sizeof(T)>::type>
+    : public std::true_type { };
+
+template <class T>
+void serialize_raw_array(write_message_t *msg, const T *p, size_t n) {
+    msg->append(p, n * sizeof(T));
+}
+
 template <class T>
+MUST_USE archive_result_t deserialize_raw_array(read_stream_t *s, T *p, size_t n) {
+    const int64_t sz = n * sizeof(T);
+    int64_t res = force_read(s, p, sz);
+    if (res == -1) { return ARCHIVE_SOCK_ERROR; }
+    if (res < sz) { return ARCHIVE_SOCK_EOF; }
+    return ARCHIVE_SUCCESS;
+}
+
+/* `serialized_size_t<T>::value` is the serialized size of every `T`, for the
+types that have a fixed one. */
+template <class T, class enable_t = void>
 struct serialized_size_t;
 
+template <class T>
+struct serialized_size_t<T, typename std::enable_if<T::rdb_archive_raw_size == sizeof(T)>::type>
+    : public std::integral_constant<size_t, sizeof(T)> { };
+
 
 
 // Keep in sync with serialized_size_t defined below.
@@ -251,7 +305,10 @@ struct serialized_size_t;
                                                                         \
     template <>                                                         \
     struct serialized_size_t<typ>                                       \
-        : public std::integral_constant<size_t, sizeof(typ)> { }
+        : public std::integral_constant<size_t, sizeof(typ)> { };       \
+                                                                        \
+    template <>                                                         \
+    struct archive_raw_t<typ> : public std::true_type { }
 
 
 ARCHIVE_PRIM_MAKE_RAW_SERIALIZABLE(unsigned char);  // NOLINT(runtime/int)
@@ -277,6 +334,9 @@ struct serialized_size_t<bool> : public serialized_size_t<int8_t> { };
 write_message_t &operator<<(write_message_t &msg, const uuid_u &uuid);
 MUST_USE archive_result_t deserialize(read_stream_t *s, uuid_u *uuid);
 
+template <>
+struct archive_raw_t<uuid_u> : public std::true_type { };
+
 struct in_addr;
 struct in6_addr;
 
@@ -12,6 +12,7 @@
 #include <map>
 #include <set>
 #include <string>
+#include <type_traits>
 #include <vector>
 #include <utility>
 
@@ -131,28 +132,66 @@ size_t serialized_size(const std::string &s);
 write_message_t &operator<<(write_message_t &msg, const std::string &s);
 MUST_USE archive_result_t deserialize(read_stream_t *s, std::string *out);
 
-// Think twice before using this function on vectors containing a primitive type --
-// it'll take O(n) time!
-// Keep in sync with operator<<.
+// Vectors of raw-serializable types (see `archive_raw_t`) are copied as one
+// block.  Anything else takes O(n) calls.
 template <class T>
-size_t serialized_size(const std::vector<T> &v) {
-    size_t ret = varint_uint64_serialized_size(v.size());
+size_t vector_elements_serialized_size(const std::vector<T> &v, std::true_type) {
+    return v.size() * sizeof(T);
+}
+
+template <class T>
+size_t vector_elements_serialized_size(const std::vector<T> &v, std::false_type) {
+    size_t ret = 0;
     for (auto it = v.begin(), e = v.end(); it != e; ++it) {
         ret += serialized_size(*it);
     }
     return ret;
 }
 
+// Keep in sync with operator<<.
+template <class T>
+size_t serialized_size(const std::vector<T> &v) {
+    return varint_uint64_serialized_size(v.size())
+        + vector_elements_serialized_size(v, archive_raw_t<T>());
+}
+
+template <class T>
+void serialize_vector_elements(write_message_t *msg, const std::vector<T> &v, std::true_type) {
+    if (!v.empty()) {
+        serialize_raw_array(msg, v.data(), v.size());
+    }
+}
+
+template <class T>
+void serialize_vector_elements(write_message_t *msg, const std::vector<T> &v, std::false_type) {
+    for (auto it = v.begin(), e = v.end(); it != e; ++it) {
+        *msg << *it;
+    }
+}
 
 // Keep in sync with serialized_size.
 template <class T>
 write_message_t &operator<<(write_message_t &msg, const std::vector<T> &v) {
     serialize_varint_uint64(&msg, v.size());
-    for (auto it = v.begin(), e = v.end(); it != e; ++it) {
-        msg << *it;
+    serialize_vector_elements(&msg, v, archive_raw_t<T>());
+    return msg;
+}
+
+template <class T>
+MUST_USE archive_result_t deserialize_vector_elements(read_stream_t *s, std::vector<T> *v, std::true_type) {
+    if (v->empty()) {
+        return ARCHIVE_SUCCESS;
     }
+    return deserialize_raw_array(s, v->data(), v->size());
+}
 
-    return msg;
+template <class T>
+MUST_USE archive_result_t deserialize_vector_elements(read_stream_t *s, std::vector<T> *v, std::false_type) {
+    for (size_t i = 0; i < v->size(); ++i) {
+        archive_result_t res = deserialize(s, &(*v)[i]);
+        if (res) { return res; }
+    }
+    return ARCHIVE_SUCCESS;
 }
 
 template <class T>
@@ -168,12 +207,7 @@ MUST_USE archive_result_t deserialize(read_stream_t *s, std::vector<T> *v) {
     }
 
     v->resize(sz);
-    for (uint64_t i = 0; i < sz; ++i) {
-        res = deserialize(s, &(*v)[i]);
-        if (res) { return res; }
-    }
-
-    return ARCHIVE_SUCCESS;
+    return deserialize_vector_elements(s, v, archive_raw_t<T>());
 }
 
 // TODO: Stop using std::list! What are you thinking?
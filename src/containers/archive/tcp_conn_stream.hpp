@@ -18,6 +18,7 @@ public:
 
     virtual MUST_USE int64_t read(void *p, int64_t n);
     virtual MUST_USE int64_t write(const void *p, int64_t n);
+    virtual MUST_USE int64_t writev(const struct iovec *iov, int iovcnt);
 
     void rethread(threadnum_t new_thread);
 
@@ -57,6 +58,7 @@ public:
 
     virtual MUST_USE int64_t read(void *p, int64_t n);
     virtual MUST_USE int64_t write(const void *p, int64_t n);
+    virtual MUST_USE int64_t writev(const struct iovec *iov, int iovcnt);
 
 private:
     keepalive_callback_t *keepalive_callback;
@@ -0,0 +1,22 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "containers/archive/write_message_stream.hpp"
+
+#include <sys/uio.h>
+
+write_message_stream_t::write_message_stream_t() { }
+
+write_message_stream_t::~write_message_stream_t() { }
+
+int64_t write_message_stream_t::write(const void *p, int64_t n) {
+    msg_.append(p, n);
+    return n;
+}
+
+int64_t write_message_stream_t::writev(const struct iovec *iov, int iovcnt) {
+    int64_t total = 0;
+    for (int i = 0; i < iovcnt; ++i) {
+        msg_.append(iov[i].iov_base, iov[i].iov_len);
+        total += iov[i].iov_len;
+    }
+    return total;
+}
@@ -0,0 +1,25 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#ifndef CONTAINERS_ARCHIVE_WRITE_MESSAGE_STREAM_HPP_
+#define CONTAINERS_ARCHIVE_WRITE_MESSAGE_STREAM_HPP_
+
+#include "containers/archive/archive.hpp"
+
+// A write_stream_t that appends everything written to it to a write_message_t,
+// so that it can be handed to send_write_message() without another copy.
+class write_message_stream_t : public write_stream_t {
+public:
+    write_message_stream_t();
+    virtual ~write_message_stream_t();
+
+    virtual MUST_USE int64_t write(const void *p, int64_t n);
+    virtual MUST_USE int64_t writev(const struct iovec *iov, int iovcnt);
+
+    write_message_t *message() { return &msg_; }
+
+private:
+    write_message_t msg_;
+
+    DISABLE_COPYING(write_message_stream_t);
+};
+
+#endif  // CONTAINERS_ARCHIVE_WRITE_MESSAGE_STREAM_HPP_
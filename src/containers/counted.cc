@@ -0,0 +1,19 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "containers/counted.hpp"
+
+#include "errors.hpp"
+#include <boost/bind.hpp>
+
+#include "arch/runtime/thread_pool.hpp"
+#include "do_on_thread.hpp"
+
+__thread char biased_countable_thread_tag;
+
+int biased_countable_owner_thread() {
+    return linux_thread_pool_t::thread_pool == NULL ? -1 : get_thread_id().threadnum;
+}
+
+void biased_countable_release_on_thread(int thread, void (*release)(const void *),
+                                        const void *p) {
+    do_on_thread(threadnum_t(thread), boost::bind(release, p));
+}
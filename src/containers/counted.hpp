@@ -267,6 +267,150 @@ inline intptr_t counted_use_count(const slow_atomic_countable_t<T> *p) {
 }
 
 
+template <class> class biased_countable_t;
+
+template <class T>
+inline void counted_add_ref(const biased_countable_t<T> *p);
+template <class T>
+inline void counted_release(const biased_countable_t<T> *p);
+template <class T>
+inline intptr_t counted_use_count(const biased_countable_t<T> *p);
+
+// Every thread has one, so its address tells the threads apart.
+extern __thread char biased_countable_thread_tag;
+
+// The thread pool thread this is, or -1 if it isn't one.
+int biased_countable_owner_thread();
+
+// Calls `release(p)` on `thread`.
+void biased_countable_release_on_thread(int thread, void (*release)(const void *),
+                                        const void *p);
+
+/* Nearly all references to objects like datums are taken and dropped on the thread
+that made the object, but a few of them go to other threads.  So the thread that made
+the object counts the references it takes without atomic operations, in `biased_`,
+and other threads count theirs atomically, in `shared_`.  Every reference is counted
+once in one of them, not necessarily the one of the thread that drops it, so a drop
+takes one off whichever count has it:
+
+ - The owning thread takes it off `biased_`, which is never zero while it owns it.
+   When `biased_` gets to zero, the object gives up being owned and sets MERGED in
+   `shared_`, after which all of its references are counted there.
+ - Other threads take it off `shared_`, unless that's zero, in which case all the
+   references, including theirs, are in `biased_` and they have the owning thread
+   drop it.
+
+The object is deleted when both counts are zero, by whoever gets the second one of
+them there.  Objects made outside the thread pool are never owned. */
+template <class T>
+class biased_countable_t {
+public:
+    biased_countable_t()
+        : owner_(NULL), owner_thread_(biased_countable_owner_thread()),
+          biased_(0), shared_(MERGED) {
+        if (owner_thread_ != -1) {
+            owner_ = &biased_countable_thread_tag;
+            shared_ = 0;
+        }
+    }
+
+protected:
+    ~biased_countable_t() {
+        rassert(biased_ == 0);
+        rassert(shared_ == MERGED);
+    }
+
+    counted_t<T> counted_from_this() {
+        return counted_t<T>(static_cast<T *>(this));
+    }
+
+    counted_t<const T> counted_from_this() const {
+        return counted_t<const T>(static_cast<const T *>(this));
+    }
+
+private:
+    friend void counted_add_ref<T>(const biased_countable_t<T> *p);
+    friend void counted_release<T>(const biased_countable_t<T> *p);
+    friend intptr_t counted_use_count<T>(const biased_countable_t<T> *p);
+
+    // `shared_` is twice the count of the references in it, plus MERGED once the
+    // object isn't owned any more.
+    static const intptr_t MERGED = 1;
+    static const intptr_t ONE_REF = 2;
+
+    void release_biased() const {
+        rassert(biased_ > 0);
+        --biased_;
+        if (biased_ == 0) {
+            owner_ = NULL;
+            intptr_t old = __sync_fetch_and_add(&shared_, MERGED);
+            if (old == 0) {
+                delete static_cast<const T *>(this);
+            }
+        }
+    }
+
+    void release_shared() const {
+        for (;;) {
+            intptr_t old = static_cast<const volatile intptr_t &>(shared_);
+            if (old < ONE_REF) {
+                // It can't be merged yet, we have a reference.
+                rassert(old == 0);
+                biased_countable_release_on_thread(owner_thread_, &release_on_owner,
+                                                   this);
+                return;
+            }
+            if (__sync_bool_compare_and_swap(&shared_, old, old - ONE_REF)) {
+                if (old - ONE_REF == MERGED) {
+                    delete static_cast<const T *>(this);
+                }
+                return;
+            }
+        }
+    }
+
+    static void release_on_owner(const void *p) {
+        counted_release(static_cast<const biased_countable_t *>(p));
+    }
+
+    // `&biased_countable_thread_tag` of the owning thread, or `NULL` once the object
+    // isn't owned.  Only the owning thread changes it, and other threads only
+    // compare it to their own.
+    mutable const char *owner_;
+    const int owner_thread_;
+    mutable intptr_t biased_;
+    mutable intptr_t shared_;
+    DISABLE_COPYING(biased_countable_t);
+};
+
+template <class T>
+inline void counted_add_ref(const biased_countable_t<T> *p) {
+    if (p->owner_ == &biased_countable_thread_tag) {
+        ++p->biased_;
+    } else {
+        DEBUG_VAR intptr_t res = __sync_add_and_fetch(&p->shared_, p->ONE_REF);
+        rassert(res >= p->ONE_REF);
+    }
+}
+
+template <class T>
+inline void counted_release(const biased_countable_t<T> *p) {
+    if (p->owner_ == &biased_countable_thread_tag) {
+        p->release_biased();
+    } else {
+        p->release_shared();
+    }
+}
+
+// Only exact on the owning thread, or once the object isn't owned.  Elsewhere it
+// leaves out the references counted in `biased_`.
+template <class T>
+inline intptr_t counted_use_count(const biased_countable_t<T> *p) {
+    intptr_t shared = static_cast<const volatile intptr_t &>(p->shared_) / p->ONE_REF;
+    return p->owner_ == &biased_countable_thread_tag ? p->biased_ + shared : shared;
+}
+
+
 // A noncopyable reference to a reference-counted object.
 template <class T>
 class movable_t {
@@ -1,81 +1,48 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "containers/disk_backed_queue.hpp"
 
+#include <string.h>
+#include <unistd.h>
+
+#include "arch/arch.hpp"
 #include "arch/io/disk.hpp"
-#include "buffer_cache/blob.hpp"
-#include "buffer_cache/buffer_cache.hpp"
-#include "buffer_cache/serialize_onto_blob.hpp"
-#include "serializer/config.hpp"
+#include "containers/buffer_group.hpp"
+#include "containers/intrusive_list.hpp"
 
-internal_disk_backed_queue_t::internal_disk_backed_queue_t(io_backender_t *io_backender,
-                                                           const serializer_filepath_t &filename,
+internal_disk_backed_queue_t::internal_disk_backed_queue_t(io_backender_t *_io_backender,
+                                                           const serializer_filepath_t &_filename,
                                                            perfmon_collection_t *stats_parent)
-    : perfmon_membership(stats_parent, &perfmon_collection,
+    : io_backender(_io_backender),
+      filename(_filename),
+      perfmon_membership(stats_parent, &perfmon_collection,
                          filename.permanent_path().c_str()),
+      stats_membership(&perfmon_collection,
+                       &written_bytes, "written_bytes",
+                       &read_bytes, "read_bytes",
+                       NULLPTR),
       queue_size(0),
-      head_block_id(NULL_BLOCK_ID),
-      tail_block_id(NULL_BLOCK_ID) {
-    filepath_file_opener_t file_opener(filename, io_backender);
-    standard_serializer_t::create(&file_opener,
-                                  standard_serializer_t::static_config_t());
-
-    serializer.init(new standard_serializer_t(standard_serializer_t::dynamic_config_t(),
-                                              &file_opener,
-                                              &perfmon_collection));
-
-    /* Remove the file we just created from the filesystem, so that it will
-       get deleted as soon as the serializer is destroyed or if the process
-       crashes. */
-    file_opener.unlink_serializer_file();
-
-    /* Create the cache. */
-    cache_t::create(serializer.get());
-
-    mirrored_cache_config_t cache_dynamic_config;
-    cache_dynamic_config.max_size = MEGABYTE;
-    cache_dynamic_config.max_dirty_size = MEGABYTE / 2;
-    cache.init(new cache_t(serializer.get(), cache_dynamic_config, &perfmon_collection));
+      read_offset(0),
+      write_offset(0),
+      head_chunk(malloc_aligned(DISK_BACKED_QUEUE_CHUNK_SIZE, DEVICE_BLOCK_SIZE)),
+      tail_chunk_offset(-1) { }
+
+internal_disk_backed_queue_t::~internal_disk_backed_queue_t() {
+    // The accounts go before the file.
+    read_account.reset();
+    write_account.reset();
 }
 
-internal_disk_backed_queue_t::~internal_disk_backed_queue_t() { }
-
 void internal_disk_backed_queue_t::push(const write_message_t &wm) {
     mutex_t::acq_t mutex_acq(&mutex);
 
-    // First, we need a transaction.
-    transaction_t txn(cache.get(),
-                      rwi_write,
-                      2,
-                      repli_timestamp_t::distant_past,
-                      cache_order_source.check_in("push"),
-                      WRITE_DURABILITY_SOFT /* No need for durability with unlinked dbq file. */);
-
-    if (head_block_id == NULL_BLOCK_ID) {
-        add_block_to_head(&txn);
-    }
-
-    scoped_ptr_t<buf_lock_t> _head(new buf_lock_t(&txn, head_block_id, rwi_write));
-    queue_block_t *head = reinterpret_cast<queue_block_t *>(_head->get_data_write());
-
-    char buffer[MAX_REF_SIZE];
-    memset(buffer, 0, MAX_REF_SIZE);
-
-    blob_t blob(txn.get_cache()->get_block_size(), buffer, MAX_REF_SIZE);
-
-    write_onto_blob(&txn, &blob, wm);
-
-    if (static_cast<size_t>((head->data + head->data_size) - reinterpret_cast<char *>(head)) + blob.refsize(cache->get_block_size()) > cache->get_block_size().value()) {
-        // The data won't fit in our current head block, so it's time to make a new one.
-        head = NULL;
-        _head.reset();
-        add_block_to_head(&txn);
-        _head.init(new buf_lock_t(&txn, head_block_id, rwi_write));
-        head = reinterpret_cast<queue_block_t *>(_head->get_data_write());
+    uint64_t size = wm.size();
+    append(reinterpret_cast<const char *>(&size), sizeof(size));
+    intrusive_list_t<write_buffer_t> *buffers =
+        const_cast<write_message_t &>(wm).unsafe_expose_buffers();
+    for (write_buffer_t *b = buffers->head(); b != NULL; b = buffers->next(b)) {
+        append(b->data, b->size);
     }
 
-    memcpy(head->data + head->data_size, buffer, blob.refsize(cache->get_block_size()));
-    head->data_size += blob.refsize(cache->get_block_size());
-
     queue_size++;
 }
 
@@ -83,43 +50,31 @@ void internal_disk_backed_queue_t::pop(buffer_group_viewer_t *viewer) {
     guarantee(size() != 0);
     mutex_t::acq_t mutex_acq(&mutex);
 
-    char buffer[MAX_REF_SIZE];
-    transaction_t txn(cache.get(),
-                      rwi_write,
-                      2,
-                      repli_timestamp_t::distant_past,
-                      cache_order_source.check_in("pop"),
-                      WRITE_DURABILITY_SOFT /* No durability for unlinked dbq file. */);
-
-    scoped_ptr_t<buf_lock_t> _tail(new buf_lock_t(&txn, tail_block_id, rwi_write));
-    queue_block_t *tail = reinterpret_cast<queue_block_t *>(_tail->get_data_write());
-    rassert(tail->data_size != tail->live_data_offset);
-
-    /* Grab the data from the blob and delete it. */
-
-    memcpy(buffer, tail->data + tail->live_data_offset, blob::ref_size(cache->get_block_size(), tail->data + tail->live_data_offset, MAX_REF_SIZE));
-    std::vector<char> data_vec;
-
-    blob_t blob(txn.get_cache()->get_block_size(), buffer, MAX_REF_SIZE);
-    {
-        blob_acq_t acq_group;
-        buffer_group_t blob_group;
-        blob.expose_all(&txn, rwi_read, &blob_group, &acq_group);
-
-        viewer->view_buffer_group(const_view(&blob_group));
+    uint64_t size;
+    read(reinterpret_cast<char *>(&size), sizeof(size));
+
+    const int64_t chunk_offset = floor_aligned(read_offset, DISK_BACKED_QUEUE_CHUNK_SIZE);
+    const_buffer_group_t group;
+    std::vector<char> copy;
+    if (read_offset + static_cast<int64_t>(size)
+        <= chunk_offset + DISK_BACKED_QUEUE_CHUNK_SIZE) {
+        // The value is all in one chunk, the viewer can look at it there.
+        group.add_buffer(size, get_chunk(read_offset) + (read_offset - chunk_offset));
+        consume_to(read_offset + size);
+    } else {
+        copy.resize(size);
+        read(copy.data(), size);
+        group.add_buffer(size, copy.data());
     }
-
-    /* Record how far along in the blob we are. */
-    tail->live_data_offset += blob.refsize(cache->get_block_size());
-
-    blob.clear(&txn);
+    viewer->view_buffer_group(&group);
 
     queue_size--;
 
-    /* If that was the last blob in this block move on to the next one. */
-    if (tail->live_data_offset == tail->data_size) {
-        _tail.reset();
-        remove_block_from_tail(&txn);
+    if (queue_size == 0) {
+        // Start again at the start of the file.
+        rassert(read_offset == write_offset);
+        read_offset = write_offset = 0;
+        tail_chunk_offset = -1;
     }
 }
 
@@ -131,37 +86,103 @@ int64_t internal_disk_backed_queue_t::size() {
     return queue_size;
 }
 
-void internal_disk_backed_queue_t::add_block_to_head(transaction_t *txn) {
-    buf_lock_t _new_head(txn);
-    queue_block_t *new_head = reinterpret_cast<queue_block_t *>(_new_head.get_data_write());
-    if (head_block_id == NULL_BLOCK_ID) {
-        rassert(tail_block_id == NULL_BLOCK_ID);
-        head_block_id = tail_block_id = _new_head.get_block_id();
-    } else {
-        buf_lock_t _old_head(txn, head_block_id, rwi_write);
-        queue_block_t *old_head = reinterpret_cast<queue_block_t *>(_old_head.get_data_write());
-        rassert(old_head->next == NULL_BLOCK_ID);
-        old_head->next = _new_head.get_block_id();
-        head_block_id = _new_head.get_block_id();
+void internal_disk_backed_queue_t::append(const char *data, size_t n) {
+    while (n > 0) {
+        const size_t in_chunk = write_offset % DISK_BACKED_QUEUE_CHUNK_SIZE;
+        const size_t count = std::min<size_t>(n, DISK_BACKED_QUEUE_CHUNK_SIZE - in_chunk);
+        memcpy(head_chunk.get() + in_chunk, data, count);
+        data += count;
+        n -= count;
+        write_offset += count;
+        if (in_chunk + count == DISK_BACKED_QUEUE_CHUNK_SIZE) {
+            write_head_chunk();
+        }
     }
+}
 
-    new_head->next = NULL_BLOCK_ID;
-    new_head->data_size = 0;
-    new_head->live_data_offset = 0;
+void internal_disk_backed_queue_t::write_head_chunk() {
+    const int64_t chunk_offset = write_offset - DISK_BACKED_QUEUE_CHUNK_SIZE;
+    rassert(chunk_offset % DISK_BACKED_QUEUE_CHUNK_SIZE == 0);
+    if (read_offset >= chunk_offset) {
+        // The front of the queue is in the chunk, so it would read it right back.
+        // It keeps it as its tail chunk instead, and it never gets written.
+        if (!tail_chunk.has()) {
+            tail_chunk.init(malloc_aligned(DISK_BACKED_QUEUE_CHUNK_SIZE,
+                                           DEVICE_BLOCK_SIZE));
+        }
+        std::swap(head_chunk, tail_chunk);
+        tail_chunk_offset = chunk_offset;
+        return;
+    }
+    if (!file.has()) {
+        open_file();
+    }
+    file->set_size_at_least(chunk_offset + DISK_BACKED_QUEUE_CHUNK_SIZE);
+    co_write(file.get(), chunk_offset, DISK_BACKED_QUEUE_CHUNK_SIZE, head_chunk.get(),
+             write_account.get(), file_t::NO_DATASYNCS);
+    written_bytes += DISK_BACKED_QUEUE_CHUNK_SIZE;
 }
 
-void internal_disk_backed_queue_t::remove_block_from_tail(transaction_t *txn) {
-    rassert(tail_block_id != NULL_BLOCK_ID);
-    buf_lock_t _old_tail(txn, tail_block_id, rwi_write);
-    queue_block_t *old_tail = reinterpret_cast<queue_block_t *>(_old_tail.get_data_write());
+const char *internal_disk_backed_queue_t::get_chunk(int64_t offset) {
+    const int64_t chunk_offset = floor_aligned(offset, DISK_BACKED_QUEUE_CHUNK_SIZE);
+    if (chunk_offset == floor_aligned(write_offset, DISK_BACKED_QUEUE_CHUNK_SIZE)) {
+        return head_chunk.get();
+    }
+    if (chunk_offset != tail_chunk_offset) {
+        if (!tail_chunk.has()) {
+            tail_chunk.init(malloc_aligned(DISK_BACKED_QUEUE_CHUNK_SIZE,
+                                           DEVICE_BLOCK_SIZE));
+        }
+        rassert(file.has());
+        co_read(file.get(), chunk_offset, DISK_BACKED_QUEUE_CHUNK_SIZE, tail_chunk.get(),
+                read_account.get());
+        read_bytes += DISK_BACKED_QUEUE_CHUNK_SIZE;
+        tail_chunk_offset = chunk_offset;
+    }
+    return tail_chunk.get();
+}
 
-    if (old_tail->next == NULL_BLOCK_ID) {
-        rassert(head_block_id == _old_tail.get_block_id());
-        tail_block_id = head_block_id = NULL_BLOCK_ID;
-    } else {
-        tail_block_id = old_tail->next;
+void internal_disk_backed_queue_t::read(char *out, size_t n) {
+    while (n > 0) {
+        const size_t in_chunk = read_offset % DISK_BACKED_QUEUE_CHUNK_SIZE;
+        const size_t count = std::min<size_t>(n, DISK_BACKED_QUEUE_CHUNK_SIZE - in_chunk);
+        memcpy(out, get_chunk(read_offset) + in_chunk, count);
+        out += count;
+        n -= count;
+        consume_to(read_offset + count);
     }
+}
 
-    _old_tail.mark_deleted();
+void internal_disk_backed_queue_t::consume_to(int64_t offset) {
+    rassert(offset <= write_offset);
+    const int64_t old_chunk = floor_aligned(read_offset, DISK_BACKED_QUEUE_CHUNK_SIZE);
+    const int64_t new_chunk = floor_aligned(offset, DISK_BACKED_QUEUE_CHUNK_SIZE);
+    if (new_chunk != old_chunk && file.has()
+        && old_chunk + DISK_BACKED_QUEUE_CHUNK_SIZE <= file->get_size()) {
+        // The file system can have the space of the chunks we're done with back.
+        UNUSED bool discarded = file->discard(old_chunk, new_chunk - old_chunk);
+    }
+    read_offset = offset;
 }
 
+void internal_disk_backed_queue_t::open_file() {
+    const std::string path = filename.temporary_path();
+    const file_open_result_t res = ::open_file(path.c_str(),
+                                               linux_file_t::mode_read
+                                               | linux_file_t::mode_write
+                                               | linux_file_t::mode_create
+                                               | linux_file_t::mode_truncate,
+                                               io_backender,
+                                               &file);
+    if (res.outcome == file_open_result_t::ERROR) {
+        crash_due_to_inaccessible_database_file(path.c_str(), res);
+    }
+    /* Remove the file we just created from the filesystem, so that it will
+       get deleted as soon as the queue is destroyed or if the process
+       crashes. */
+    const int unlink_res = ::unlink(path.c_str());
+    guarantee_err(unlink_res == 0, "unlink() failed");
+
+    read_account.init(new file_account_t(file.get(), CACHE_READS_IO_PRIORITY));
+    write_account.init(new file_account_t(file.get(), CACHE_WRITES_IO_PRIORITY));
+}
@@ -2,8 +2,6 @@
 #ifndef CONTAINERS_DISK_BACKED_QUEUE_HPP_
 #define CONTAINERS_DISK_BACKED_QUEUE_HPP_
 
-#define MAX_REF_SIZE 251
-
 #include <string>
 #include <vector>
 
@@ -13,24 +11,15 @@
 #include "concurrency/mutex.hpp"
 #include "containers/archive/vector_stream.hpp"
 #include "containers/scoped.hpp"
-#include "perfmon/core.hpp"
+#include "perfmon/perfmon.hpp"
 #include "serializer/types.hpp"
 
 class const_buffer_group_t;
+class file_account_t;
+class file_t;
 class io_backender_t;
 class perfmon_collection_t;
 
-//TODO there are extra copies all over the place mostly stemming from having a
-//vector<char> from the serialization code and strings from the blob code.
-
-struct queue_block_t {
-    block_id_t next;
-    int data_size, live_data_offset;
-    char data[0];
-};
-
-class value_acquisition_object_t;
-
 class buffer_group_viewer_t {
 public:
     virtual void view_buffer_group(const const_buffer_group_t *group) = 0;
@@ -42,6 +31,16 @@ protected:
     DISABLE_COPYING(buffer_group_viewer_t);
 };
 
+/* The values are appended to a spool file one after another, each one its size and
+then its serialization, and read back from the front.  The values go into a chunk
+of DISK_BACKED_QUEUE_CHUNK_SIZE bytes in memory, and the chunk is only written once
+it's full, so a queue whose values get popped soon after they're pushed never writes
+to disk at all, and the others write and read whole chunks at once.  The chunks
+that have been read go back to the file system, and the queue starts again at the
+start of the file whenever it's empty.
+
+The file is only created when the first chunk gets written, and it's unlinked right
+away, so that it goes away when the queue does or if the process crashes. */
 class internal_disk_backed_queue_t {
 public:
     internal_disk_backed_queue_t(io_backender_t *io_backender, const serializer_filepath_t& filename, perfmon_collection_t *stats_parent);
@@ -58,21 +57,40 @@ public:
     int64_t size();
 
 private:
-    void add_block_to_head(transaction_t *txn);
-
-    void remove_block_from_tail(transaction_t *txn);
+    // Appends `n` bytes to the head chunk, writing it out whenever it's full.
+    void append(const char *data, size_t n);
+    void write_head_chunk();
+    // Returns the chunk with the byte at `offset` in memory, reading it if needed.
+    const char *get_chunk(int64_t offset);
+    // Copies the next `n` bytes to `out` and moves past them.
+    void read(char *out, size_t n);
+    // Moves the front of the queue to `offset`, giving the chunks before it back.
+    void consume_to(int64_t offset);
+    void open_file();
 
     mutex_t mutex;
 
-    // Serves more as sanity-checking for the cache than this type's ordering.
-    order_source_t cache_order_source;
+    io_backender_t *const io_backender;
+    const serializer_filepath_t filename;
+
     perfmon_collection_t perfmon_collection;
     perfmon_membership_t perfmon_membership;
+    perfmon_counter_t written_bytes;
+    perfmon_counter_t read_bytes;
+    perfmon_multi_membership_t stats_membership;
 
     int64_t queue_size;
-    block_id_t head_block_id, tail_block_id;
-    scoped_ptr_t<standard_serializer_t> serializer;
-    scoped_ptr_t<cache_t> cache;
+    // Where the values start and end, as offsets in the file.
+    int64_t read_offset, write_offset;
+
+    // The chunk that `write_offset` is in, which isn't in the file yet.
+    scoped_malloc_t<char> head_chunk;
+    // The last chunk read from the file, and its offset, or -1.
+    scoped_malloc_t<char> tail_chunk;
+    int64_t tail_chunk_offset;
+
+    scoped_ptr_t<file_t> file;
+    scoped_ptr_t<file_account_t> read_account, write_account;
 
     DISABLE_COPYING(internal_disk_backed_queue_t);
 };
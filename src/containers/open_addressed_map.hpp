@@ -0,0 +1,183 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#ifndef CONTAINERS_OPEN_ADDRESSED_MAP_HPP_
+#define CONTAINERS_OPEN_ADDRESSED_MAP_HPP_
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "config/args.hpp"
+#include "errors.hpp"
+#include "utils.hpp"
+
+/* open_addressed_map_t maps integer keys to values, with the same interface as
+two_level_array_t: get() on a key that set() has never been called for returns
+value_t(), and setting a key to value_t() removes it. It makes the same
+assumptions about value_t as two_level_array_t does.
+
+Unlike two_level_array_t, its memory use is proportional to the number of keys it
+holds rather than to the largest key. It is a linear probing hash table whose
+slots are stored inline in one cache line aligned array, so a lookup usually
+touches a single cache line. Call reserve() with the expected number of keys to
+avoid rehashing while it fills up. Removal shifts the following entries back, so
+there are no tombstones and lookups don't get slower as keys come and go. */
+
+template <class value_t>
+class open_addressed_map_t {
+public:
+    explicit open_addressed_map_t(size_t expected_size = 0)
+        : slots(NULL), mask(0), shift(0), count(0) {
+        reserve(expected_size);
+    }
+
+    ~open_addressed_map_t() {
+        destroy_slots(slots, capacity());
+    }
+
+    value_t get(size_t key) const {
+        if (count == 0) {
+            return value_t();
+        }
+        for (size_t i = home_slot(key); ; i = (i + 1) & mask) {
+            const slot_t &slot = slots[i];
+            if (slot.value == value_t()) {
+                return value_t();
+            }
+            if (slot.key == key) {
+                return slot.value;
+            }
+        }
+    }
+
+    void set(size_t key, value_t value) {
+        if (value == value_t()) {
+            remove(key);
+            return;
+        }
+        if ((count + 1) * MAX_LOAD_DENOMINATOR > capacity() * MAX_LOAD_NUMERATOR) {
+            rehash(capacity() == 0 ? MIN_CAPACITY : capacity() * 2);
+        }
+        for (size_t i = home_slot(key); ; i = (i + 1) & mask) {
+            slot_t *slot = &slots[i];
+            if (slot->value == value_t()) {
+                slot->key = key;
+                slot->value = value;
+                ++count;
+                return;
+            }
+            if (slot->key == key) {
+                slot->value = value;
+                return;
+            }
+        }
+    }
+
+    // Makes sure that the map can hold `expected_size` keys without rehashing.
+    void reserve(size_t expected_size) {
+        size_t new_capacity = MIN_CAPACITY;
+        while (expected_size * MAX_LOAD_DENOMINATOR > new_capacity * MAX_LOAD_NUMERATOR) {
+            new_capacity *= 2;
+        }
+        if (new_capacity > capacity()) {
+            rehash(new_capacity);
+        }
+    }
+
+    size_t size() const { return count; }
+
+private:
+    struct slot_t {
+        slot_t() : key(0), value() { }
+        size_t key;
+        value_t value;
+    };
+
+    static const size_t MIN_CAPACITY = 16;
+    // The map grows when it is more than 3/4 full.
+    static const size_t MAX_LOAD_NUMERATOR = 3;
+    static const size_t MAX_LOAD_DENOMINATOR = 4;
+
+    size_t capacity() const { return slots == NULL ? 0 : mask + 1; }
+
+    size_t home_slot(size_t key) const {
+        // Fibonacci hashing: the high bits of the product depend on all bits of
+        // the key.
+        return (static_cast<uint64_t>(key) * 0x9E3779B97F4A7C15ULL) >> shift;
+    }
+
+    void remove(size_t key) {
+        if (count == 0) {
+            return;
+        }
+        size_t hole = home_slot(key);
+        for (;;) {
+            if (slots[hole].value == value_t()) {
+                return;
+            }
+            if (slots[hole].key == key) {
+                break;
+            }
+            hole = (hole + 1) & mask;
+        }
+
+        // Move back the entries that would no longer be found with `hole` empty.
+        for (size_t i = (hole + 1) & mask; !(slots[i].value == value_t()); i = (i + 1) & mask) {
+            const size_t home = home_slot(slots[i].key);
+            const bool home_between_hole_and_i = hole <= i
+                ? (hole < home && home <= i)
+                : (hole < home || home <= i);
+            if (!home_between_hole_and_i) {
+                slots[hole] = slots[i];
+                hole = i;
+            }
+        }
+        slots[hole] = slot_t();
+        --count;
+    }
+
+    void rehash(size_t new_capacity) {
+        rassert((new_capacity & (new_capacity - 1)) == 0);
+        rassert(new_capacity * MAX_LOAD_NUMERATOR >= count * MAX_LOAD_DENOMINATOR);
+
+        slot_t *old_slots = slots;
+        const size_t old_capacity = capacity();
+
+        slots = static_cast<slot_t *>(malloc_aligned(new_capacity * sizeof(slot_t),
+                                                     CACHE_LINE_SIZE));
+        for (size_t i = 0; i < new_capacity; ++i) {
+            new (&slots[i]) slot_t();
+        }
+        mask = new_capacity - 1;
+        shift = 64;
+        for (size_t c = new_capacity; c > 1; c /= 2) {
+            --shift;
+        }
+        count = 0;
+
+        for (size_t i = 0; i < old_capacity; ++i) {
+            if (!(old_slots[i].value == value_t())) {
+                set(old_slots[i].key, old_slots[i].value);
+            }
+        }
+        destroy_slots(old_slots, old_capacity);
+    }
+
+    static void destroy_slots(slot_t *s, size_t n) {
+        if (s != NULL) {
+            for (size_t i = 0; i < n; ++i) {
+                s[i].~slot_t();
+            }
+            free(s);
+        }
+    }
+
+    slot_t *slots;
+    // capacity() - 1, the capacity is always a power of two.
+    size_t mask;
+    // 64 - log2(capacity()).
+    int shift;
+    size_t count;
+
+    DISABLE_COPYING(open_addressed_map_t);
+};
+
+#endif  // CONTAINERS_OPEN_ADDRESSED_MAP_HPP_
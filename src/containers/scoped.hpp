@@ -207,9 +207,10 @@ private:
     DISABLE_COPYING(scoped_array_t);
 };
 
-// For dumb structs that get malloc/free for allocation.
+// For dumb structs that get malloc/free for allocation.  Memory from other allocators
+// can be held with their free function as `free_fn`.
 
-template <class T>
+template <class T, void (*free_fn)(void *) = free>
 class scoped_malloc_t {
 public:
     scoped_malloc_t() : ptr_(NULL) { }
@@ -227,7 +228,7 @@ public:
     }
 
     ~scoped_malloc_t() {
-        free(ptr_);
+        free_fn(ptr_);
     }
 
     void operator=(scoped_malloc_t &&movee) {
@@ -0,0 +1,74 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "crc32c.hpp"
+
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <cpuid.h>
+#endif
+
+namespace {
+
+// The CRC32C polynomial, bit-reversed.
+const uint32_t CRC32C_POLYNOMIAL = 0x82F63B78;
+
+struct crc32c_table_t {
+    crc32c_table_t() {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t crc = i;
+            for (int j = 0; j < 8; ++j) {
+                crc = (crc >> 1) ^ ((crc & 1) ? CRC32C_POLYNOMIAL : 0);
+            }
+            entries[i] = crc;
+        }
+    }
+    uint32_t entries[256];
+};
+
+uint32_t crc32c_software(uint32_t crc, const char *p, size_t size) {
+    static const crc32c_table_t table;
+    for (size_t i = 0; i < size; ++i) {
+        crc = table.entries[(crc ^ static_cast<uint8_t>(p[i])) & 0xff] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+#if defined(__x86_64__)
+bool cpu_has_sse42() {
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        return false;
+    }
+    return (ecx & bit_SSE4_2) != 0;
+}
+
+// We use inline assembly so that this file doesn't need to be compiled with
+// -msse4.2, which would let the compiler use SSE 4.2 everywhere in it.
+uint32_t crc32c_sse42(uint32_t crc, const char *p, size_t size) {
+    uint64_t crc64 = crc;
+    for (; size >= sizeof(uint64_t); p += sizeof(uint64_t), size -= sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, p, sizeof(word));
+        __asm__("crc32q %1, %0" : "+r"(crc64) : "rm"(word));
+    }
+    uint32_t crc32 = crc64;
+    for (; size > 0; ++p, --size) {
+        const uint8_t byte = *p;
+        __asm__("crc32b %1, %0" : "+r"(crc32) : "rm"(byte));
+    }
+    return crc32;
+}
+#endif  // defined(__x86_64__)
+
+}  // namespace
+
+uint32_t crc32c(const void *data, size_t size, uint32_t crc) {
+    const char *p = static_cast<const char *>(data);
+#if defined(__x86_64__)
+    static const bool use_sse42 = cpu_has_sse42();
+    if (use_sse42) {
+        return ~crc32c_sse42(~crc, p, size);
+    }
+#endif
+    return ~crc32c_software(~crc, p, size);
+}
@@ -0,0 +1,13 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#ifndef CRC32C_HPP_
+#define CRC32C_HPP_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Computes the CRC32C (Castagnoli) checksum of `size` bytes at `data`. Uses the
+SSE 4.2 crc32 instruction if the CPU has it. To checksum data in several pieces,
+pass the checksum of the previous pieces as `crc`. */
+uint32_t crc32c(const void *data, size_t size, uint32_t crc = 0);
+
+#endif  // CRC32C_HPP_
@@ -15,31 +15,31 @@ extproc_job_t::extproc_job_t(extproc_pool_t *_pool,
         combined_interruptor.add(user_interruptor);
     }
 
-    worker_lock.create(pool->get_worker_semaphore(), &combined_interruptor);
+    worker_lock.create(pool, &combined_interruptor);
 
     try {
-        worker_lock.get()->get_value()->acquired(&combined_interruptor);
-        worker_lock.get()->get_value()->run_job(worker_fn);
+        worker_lock.get()->get_worker()->acquired(&combined_interruptor);
+        worker_lock.get()->get_worker()->run_job(worker_fn);
     } catch (...) {
-        worker_lock.get()->get_value()->released(user_error, user_interruptor);
+        worker_lock.get()->get_worker()->released(user_error, user_interruptor);
         throw;
     }
 }
 
 extproc_job_t::~extproc_job_t() {
     assert_thread();
-    worker_lock.get()->get_value()->released(user_error, user_interruptor);
+    worker_lock.get()->get_worker()->released(user_error, user_interruptor);
 }
 
 // All data written and read by the user must be accounted for, or things will break
 read_stream_t *extproc_job_t::read_stream() {
     assert_thread();
-    return worker_lock.get()->get_value()->get_read_stream();
+    return worker_lock.get()->get_worker()->get_read_stream();
 }
 
 write_stream_t *extproc_job_t::write_stream() {
     assert_thread();
-    return worker_lock.get()->get_value()->get_write_stream();
+    return worker_lock.get()->get_worker()->get_write_stream();
 }
 
 void extproc_job_t::worker_error() {
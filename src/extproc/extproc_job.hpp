@@ -7,10 +7,9 @@
 #include "utils.hpp"
 #include "containers/archive/archive.hpp"
 #include "concurrency/wait_any.hpp"
-#include "concurrency/cross_thread_semaphore.hpp"
 #include "containers/object_buffer.hpp"
+#include "extproc/extproc_pool.hpp"
 
-class extproc_pool_t;
 class extproc_worker_t;
 
 class extproc_job_t : public home_thread_mixin_t {
@@ -35,7 +34,7 @@ private:
     bool user_error;
     signal_t *user_interruptor;
     wait_any_t combined_interruptor;
-    object_buffer_t<cross_thread_semaphore_t<extproc_worker_t>::lock_t> worker_lock;
+    object_buffer_t<extproc_pool_t::worker_lock_t> worker_lock;
 };
 
 #endif /* EXTPROC_EXTPROC_JOB_HPP_ */
@@ -1,11 +1,35 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "extproc/extproc_pool.hpp"
+
+#include <algorithm>
+
+#include "errors.hpp"
+#include <boost/bind.hpp>
+
+#include "arch/runtime/coroutines.hpp"
+#include "config/args.hpp"
 #include "extproc/extproc_spawner.hpp"
 
-extproc_pool_t::extproc_pool_t(size_t worker_count) :
+extproc_pool_t::extproc_pool_t(size_t _max_workers) :
     ct_interruptors(&interruptor),
-    worker_semaphore(worker_count,
-                     extproc_spawner_t::get_instance()) { }
+    max_workers(_max_workers),
+    min_workers(std::min<size_t>(EXTPROC_MIN_WORKERS, _max_workers)),
+    worker_count(0),
+    drainer(new auto_drainer_t)
+{
+    guarantee(max_workers > 0);
+
+    // Spawn the minimum of workers right away, spread over the threads
+    for (size_t i = 0; i < min_workers; ++i) {
+        ++worker_count;
+        coro_t::spawn_sometime(boost::bind(&extproc_pool_t::warm_up_coroutine, this,
+                                           new extproc_worker_t(extproc_spawner_t::get_instance()),
+                                           threadnum_t(i % get_num_threads()),
+                                           auto_drainer_t::lock_t(drainer.get())));
+    }
+
+    shrink_timer.init(new repeating_timer_t(EXTPROC_POOL_SHRINK_INTERVAL_MS, this));
+}
 
 extproc_pool_t::~extproc_pool_t() {
     // Can only be destructed on the same thread we were created on
@@ -13,16 +37,158 @@ extproc_pool_t::~extproc_pool_t() {
 
     // Interrupt any and all workers
     interruptor.pulse();
-}
 
-cross_thread_semaphore_t<extproc_worker_t> *extproc_pool_t::get_worker_semaphore() {
-    return &worker_semaphore;
+    // Let the workers being warmed up or killed finish, then take back all the others
+    shrink_timer.reset();
+    drainer.reset();
+
+    size_t count;
+    {
+        system_mutex_t::lock_t lock(&mutex);
+        count = worker_count;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        delete lock(NULL, false);
+    }
 }
 
 signal_t *extproc_pool_t::get_shutdown_signal() {
     return ct_interruptors.get();
 }
 
+extproc_pool_t::worker_lock_t::worker_lock_t(extproc_pool_t *_parent,
+                                             signal_t *interruptor) :
+    parent(_parent), worker(parent->lock(interruptor, true)) { }
+
+extproc_pool_t::worker_lock_t::~worker_lock_t() {
+    parent->unlock(worker);
+}
+
+extproc_worker_t *extproc_pool_t::lock(signal_t *interruptor, bool may_grow) {
+    system_mutex_t::lock_t lock(&mutex);
+
+    if (!idle_workers.empty()) {
+        // The worker this thread released last, or else the one released last
+        size_t index = idle_workers.size() - 1;
+        for (size_t i = idle_workers.size(); i-- > 0;) {
+            if (idle_workers[i].thread_id == get_thread_id()) {
+                index = i;
+                break;
+            }
+        }
+        extproc_worker_t *worker = idle_workers[index].worker;
+        idle_workers.erase(idle_workers.begin() + index);
+        return worker;
+    }
+
+    // Its process gets spawned when the job acquires it
+    if (may_grow && worker_count < max_workers) {
+        ++worker_count;
+        return new extproc_worker_t(extproc_spawner_t::get_instance());
+    }
+
+    promise_t<extproc_worker_t *> promise;
+    request_t *request = new request_t(&promise);
+    request_queue.push_back(request);
+    lock.unlock();
+
+    bool interrupted = false;
+    try {
+        if (interruptor == NULL) {
+            promise.wait();
+        } else {
+            wait_interruptible(promise.get_ready_signal(), interruptor);
+        }
+    } catch (const interrupted_exc_t &) {
+        interrupted = true;
+    }
+
+    extproc_worker_t *worker;
+    if (promise.try_get_value(&worker)) {
+        if (!interrupted) {
+            return worker;
+        }
+        unlock(worker);
+    } else {
+        // Whoever has the request now will delete it
+        system_mutex_t::lock_t abandon_lock(&mutex);
+        request->promise_out = NULL;
+    }
+    throw interrupted_exc_t();
+}
+
+void extproc_pool_t::unlock(extproc_worker_t *worker) {
+    system_mutex_t::lock_t lock(&mutex);
+
+    while (request_queue.size() > 0) {
+        request_t *request = request_queue.head();
+        request_queue.remove(request);
+
+        if (request->promise_out != NULL) {
+            coro_t::spawn_sometime(boost::bind(&extproc_pool_t::pass_worker_coroutine,
+                                               this, request, worker));
+            return;
+        }
+        delete request;
+    }
+
+    idle_workers.push_back(idle_worker_t(worker, get_thread_id()));
+}
+
+void extproc_pool_t::pass_worker_coroutine(request_t *request,
+                                           extproc_worker_t *worker) {
+    on_thread_t rethreader(request->thread_id);
+
+    promise_t<extproc_worker_t *> *promise_out;
+    {
+        system_mutex_t::lock_t lock(&mutex);
+        promise_out = request->promise_out;
+    }
+    delete request;
+
+    if (promise_out == NULL) {
+        // No one is waiting anymore, re-release the worker
+        unlock(worker);
+    } else {
+        promise_out->pulse(worker);
+    }
+}
+
+void extproc_pool_t::warm_up_coroutine(extproc_worker_t *worker, threadnum_t thread,
+                                       UNUSED auto_drainer_t::lock_t keepalive) {
+    on_thread_t rethreader(thread);
+    worker->warm_up();
+    unlock(worker);
+}
+
+void extproc_pool_t::kill_worker_coroutine(extproc_worker_t *worker,
+                                           UNUSED auto_drainer_t::lock_t keepalive) {
+    delete worker;
+}
+
+void extproc_pool_t::on_ring() {
+    assert_thread();
+    std::vector<extproc_worker_t *> expired;
+    {
+        system_mutex_t::lock_t lock(&mutex);
+        const microtime_t cutoff =
+            current_microtime() - EXTPROC_WORKER_IDLE_TIMEOUT_MS * THOUSAND;
+        while (!idle_workers.empty()
+               && worker_count > min_workers
+               && idle_workers.front().since < cutoff) {
+            expired.push_back(idle_workers.front().worker);
+            idle_workers.erase(idle_workers.begin());
+            --worker_count;
+        }
+    }
+
+    // Shutting down a worker talks to its process
+    for (auto it = expired.begin(); it != expired.end(); ++it) {
+        coro_t::spawn_sometime(boost::bind(&extproc_pool_t::kill_worker_coroutine, *it,
+                                           auto_drainer_t::lock_t(drainer.get())));
+    }
+}
+
 extproc_pool_t::ct_interruptors_t::ct_interruptors_t(signal_t *shutdown_signal) :
     ct_signals(get_num_threads())
 {
@@ -2,28 +2,85 @@
 #ifndef EXTPROC_EXTPROC_POOL_HPP_
 #define EXTPROC_EXTPROC_POOL_HPP_
 
+#include <vector>
+
 #include "utils.hpp"
+#include "arch/io/concurrency.hpp"
+#include "arch/runtime/runtime.hpp"
+#include "arch/timing.hpp"
+#include "containers/intrusive_list.hpp"
 #include "containers/scoped.hpp"
+#include "concurrency/auto_drainer.hpp"
 #include "concurrency/cond_var.hpp"
 #include "concurrency/cross_thread_signal.hpp"
-#include "concurrency/cross_thread_semaphore.hpp"
+#include "concurrency/promise.hpp"
 #include "extproc/extproc_worker.hpp"
 
 // Extproc pool is used to acquire and release workers from any thread,
 //  must be created from within the thread pool
-class extproc_pool_t : public home_thread_mixin_t {
+// It keeps EXTPROC_MIN_WORKERS workers spawned, spawns more (up to `max_workers`)
+//  when a job would have to wait for one, and kills the ones beyond the minimum
+//  that have been idle for EXTPROC_WORKER_IDLE_TIMEOUT_MS.  Jobs get the worker
+//  that last ran on their thread if there's one, so that its process stays warm.
+class extproc_pool_t : public home_thread_mixin_t, private repeating_timer_callback_t {
 public:
-    explicit extproc_pool_t(size_t worker_count);
+    explicit extproc_pool_t(size_t max_workers);
     ~extproc_pool_t();
 
     // Get the signal for the current thread that will indicate when this object is being
     //  destroyed, make sure to combine with any other interruptors or shutdown may hang
     signal_t *get_shutdown_signal();
 
-    // Get the semaphore of workers to obtain a lock (may be done from any thread)
-    cross_thread_semaphore_t<extproc_worker_t> *get_worker_semaphore();
+    // Holds a worker for a job (may be done from any thread)
+    class worker_lock_t {
+    public:
+        worker_lock_t(extproc_pool_t *_parent, signal_t *interruptor);
+        ~worker_lock_t();
+
+        extproc_worker_t *get_worker() { return worker; }
+
+    private:
+        extproc_pool_t *parent;
+        extproc_worker_t *worker;
+        DISABLE_COPYING(worker_lock_t);
+    };
 
 private:
+    // A job waiting for a worker to be released
+    class request_t : public intrusive_list_node_t<request_t> {
+    public:
+        explicit request_t(promise_t<extproc_worker_t *> *_promise_out) :
+            thread_id(get_thread_id()), promise_out(_promise_out) { }
+
+        threadnum_t thread_id;
+        // NULL once the job stopped waiting
+        promise_t<extproc_worker_t *> *promise_out;
+    };
+
+    struct idle_worker_t {
+        idle_worker_t(extproc_worker_t *_worker, threadnum_t _thread_id) :
+            worker(_worker), thread_id(_thread_id), since(current_microtime()) { }
+
+        extproc_worker_t *worker;
+        // The thread it last ran a job on
+        threadnum_t thread_id;
+        microtime_t since;
+    };
+
+    // Returns an idle worker, or a new one if there are fewer than `max_workers`
+    //  (and `may_grow`), or waits for one to be released
+    extproc_worker_t *lock(signal_t *interruptor, bool may_grow);
+    void unlock(extproc_worker_t *worker);
+
+    void pass_worker_coroutine(request_t *request, extproc_worker_t *worker);
+    void warm_up_coroutine(extproc_worker_t *worker, threadnum_t thread,
+                           auto_drainer_t::lock_t keepalive);
+    static void kill_worker_coroutine(extproc_worker_t *worker,
+                                      auto_drainer_t::lock_t keepalive);
+
+    // Kills the workers that have been idle too long
+    void on_ring();
+
     // The interruptor to be pulsed when shutting down
     cond_t interruptor;
 
@@ -37,8 +94,21 @@ private:
         scoped_array_t<scoped_ptr_t<cross_thread_signal_t> > ct_signals;
     } ct_interruptors;
 
-    // Cross-threaded semaphore allowing workers to be acquired from any thread
-    cross_thread_semaphore_t<extproc_worker_t> worker_semaphore;
+    const size_t max_workers;
+    const size_t min_workers;
+
+    // Guards the fields below, since workers are acquired from any thread
+    system_mutex_t mutex;
+    // How many workers there are, idle or not
+    size_t worker_count;
+    // In the order they were released
+    std::vector<idle_worker_t> idle_workers;
+    intrusive_list_t<request_t> request_queue;
+
+    scoped_ptr_t<auto_drainer_t> drainer;
+    scoped_ptr_t<repeating_timer_t> shrink_timer;
+
+    DISABLE_COPYING(extproc_pool_t);
 };
 
 #endif /* EXTPROC_EXTPROC_POOL_HPP_ */
@@ -8,6 +8,7 @@
 
 #include "extproc/extproc_spawner.hpp"
 #include "extproc/extproc_worker.hpp"
+#include "extproc/shm_ring.hpp"
 #include "arch/fd_send_recv.hpp"
 
 extproc_spawner_t *extproc_spawner_t::instance = NULL;
@@ -40,6 +41,20 @@ public:
         msg << getpid();
         int res = send_write_message(&socket_stream, &msg);
         guarantee(res == 0);
+
+        // Then the main process tells us if we get a shared memory ring
+        bool has_ring;
+        archive_result_t archive_res = deserialize(&socket_stream, &has_ring);
+        guarantee_deserialization(archive_res, "has_ring");
+        if (has_ring) {
+            fd_t ring_fd;
+            fd_recv_result_t recv_res = recv_fds(socket.get(), 1, &ring_fd);
+            guarantee(recv_res == FD_RECV_OK, "worker: could not receive ring");
+            scoped_fd_t closer(ring_fd);
+            ring.init(new shm_ring_t(ring_fd));
+            ring_stream.init(new shm_ring_stream_t(ring.get(), shm_ring_t::WORKER,
+                                                   &socket_stream));
+        }
     }
 
     ~worker_run_t() {
@@ -49,22 +64,29 @@ public:
 
     // Returning from this indicates an error, orderly shutdown will exit() manually
     void main_loop() {
+        read_stream_t *stream_in = &socket_stream;
+        write_stream_t *stream_out = &socket_stream;
+        if (ring_stream.has()) {
+            stream_in = ring_stream.get();
+            stream_out = ring_stream.get();
+        }
+
         // Receive and run a function from the main process until one returns false
         bool (*fn) (read_stream_t *, write_stream_t *);
         while (true) {
             int64_t read_size = sizeof(fn);
-            int64_t read_res = force_read(&socket_stream, &fn, read_size);
+            int64_t read_res = force_read(stream_in, &fn, read_size);
             if (read_res != read_size) {
                 break;
             }
 
-            if (!fn(&socket_stream, &socket_stream)) {
+            if (!fn(stream_in, stream_out)) {
                 break;
             }
 
             // Trade magic numbers with the parent
             uint64_t magic_from_parent;
-            read_res = deserialize(&socket_stream, &magic_from_parent);
+            read_res = deserialize(stream_in, &magic_from_parent);
             if (read_res != ARCHIVE_SUCCESS ||
                 magic_from_parent != extproc_worker_t::parent_to_worker_magic) {
                 break;
@@ -72,7 +94,7 @@ public:
 
             write_message_t msg;
             msg << extproc_worker_t::worker_to_parent_magic;
-            int res = send_write_message(&socket_stream, &msg);
+            int res = send_write_message(stream_out, &msg);
             if (res != 0) {
                 break;
             }
@@ -93,6 +115,8 @@ private:
     scoped_fd_t socket;
     blocking_fd_watcher_t blocking_watcher;
     socket_stream_t socket_stream;
+    scoped_ptr_t<shm_ring_t> ring;
+    scoped_ptr_t<shm_ring_stream_t> ring_stream;
 };
 
 pid_t worker_run_t::spawner_pid = -1;
@@ -204,7 +228,8 @@ void extproc_spawner_t::fork_spawner() {
 }
 
 // Spawns a new worker process and returns the fd of the socket used to communicate with it
-fd_t extproc_spawner_t::spawn(object_buffer_t<socket_stream_t> *stream_out, pid_t *pid_out) {
+fd_t extproc_spawner_t::spawn(object_buffer_t<socket_stream_t> *stream_out, pid_t *pid_out,
+                              scoped_ptr_t<shm_ring_t> *ring_out) {
     guarantee(spawner_socket.get() != INVALID_FD);
 
     fd_t fds[2];
@@ -222,6 +247,21 @@ fd_t extproc_spawner_t::spawn(object_buffer_t<socket_stream_t> *stream_out, pid_
     guarantee_deserialization(archive_res, "pid_out");
     guarantee(*pid_out != -1);
 
+    // Give the worker a shared memory ring, if we can
+    scoped_fd_t ring_fd(shm_ring_t::create_fd());
+    write_message_t msg;
+    msg << (ring_fd.get() != INVALID_FD);
+    res = send_write_message(stream_out->get(), &msg);
+    guarantee(res == 0, "could not send ring to worker process");
+    if (ring_fd.get() != INVALID_FD) {
+        fd_t fd = ring_fd.get();
+        res = send_fds(fds[0], 1, &fd);
+        guarantee_err(res == 0, "could not send ring file descriptor to worker process");
+        ring_out->init(new shm_ring_t(ring_fd.get()));
+    } else {
+        ring_out->reset();
+    }
+
     scoped_fd_t closer(fds[1]);
     return fds[0];
 }
@@ -7,6 +7,9 @@
 #include "arch/types.hpp"
 #include "containers/archive/socket_stream.hpp"
 #include "containers/object_buffer.hpp"
+#include "containers/scoped.hpp"
+
+class shm_ring_t;
 
 // The extproc_spawner_t controls an external process which launches workers
 // This is necessary to avoid some forking problems with tcmalloc, and
@@ -21,8 +24,10 @@ public:
     ~extproc_spawner_t();
 
     // Spawns a new worker, and returns the socket file descriptor for communication
-    //  with the worker process
-    fd_t spawn(object_buffer_t<socket_stream_t> *stream_out, pid_t *pid_out);
+    //  with the worker process.  Sets `*ring_out` to the shared memory ring the
+    //  worker talks through instead, unless we can't have one.
+    fd_t spawn(object_buffer_t<socket_stream_t> *stream_out, pid_t *pid_out,
+               scoped_ptr_t<shm_ring_t> *ring_out);
 
     static extproc_spawner_t *get_instance();
 
@@ -28,6 +28,7 @@ extproc_worker_t::extproc_worker_t(extproc_spawner_t *_spawner) :
 extproc_worker_t::~extproc_worker_t() {
     if (worker_pid != -1) {
         socket_stream.create(socket.get(), reinterpret_cast<fd_watcher_t*>(NULL));
+        create_ring_stream();
 
         // TODO: check that worker is extant and/or catch exceptions
         run_job(&worker_exit_fn);
@@ -37,6 +38,9 @@ extproc_worker_t::~extproc_worker_t() {
         msg << exit_code;
         int res = send_write_message(get_write_stream(), &msg);
 
+        if (ring_stream.has()) {
+            ring_stream.reset();
+        }
         socket_stream.reset();
 
         if (res != 0) {
@@ -48,16 +52,25 @@ extproc_worker_t::~extproc_worker_t() {
     }
 }
 
+void extproc_worker_t::warm_up() {
+    guarantee(interruptor == NULL);
+    if (worker_pid == -1) {
+        socket.reset(spawner->spawn(&socket_stream, &worker_pid, &ring));
+        socket_stream.reset();
+    }
+}
+
 void extproc_worker_t::acquired(signal_t *_interruptor) {
     // Only start the worker process once the worker is acquired for the first time
     // This will also repair a killed worker
 
     // We create the streams here, since they are thread-dependant
     if (worker_pid == -1) {
-        socket.reset(spawner->spawn(&socket_stream, &worker_pid));
+        socket.reset(spawner->spawn(&socket_stream, &worker_pid, &ring));
     } else {
         socket_stream.create(socket.get(), reinterpret_cast<fd_watcher_t*>(NULL));
     }
+    create_ring_stream();
 
     // Apply the user interruptor to our stream along with the extproc pool's interruptor
     guarantee(interruptor == NULL);
@@ -84,12 +97,12 @@ void extproc_worker_t::released(bool user_error, signal_t *user_interruptor) {
         try {
             write_message_t msg;
             msg << parent_to_worker_magic;
-            int res = send_write_message(socket_stream.get(), &msg);
+            int res = send_write_message(get_write_stream(), &msg);
             if (res != 0) { throw std::runtime_error("failed to send magic number"); }
 
 
             uint64_t magic_from_child;
-            res = deserialize(socket_stream.get(), &magic_from_child);
+            res = deserialize(get_read_stream(), &magic_from_child);
             if (res != ARCHIVE_SUCCESS || magic_from_child != worker_to_parent_magic) {
                 throw std::runtime_error("did not receive magic number");
             }
@@ -102,6 +115,9 @@ void extproc_worker_t::released(bool user_error, signal_t *user_interruptor) {
         }
     }
 
+    if (ring_stream.has()) {
+        ring_stream.reset();
+    }
     socket_stream.reset();
     interruptor = NULL;
 
@@ -117,8 +133,15 @@ void extproc_worker_t::kill_process() {
     ::kill(worker_pid, SIGKILL);
     worker_pid = -1;
 
-    // Clean up our socket fd
+    // Clean up our socket fd and ring
     socket.reset();
+    ring.reset();
+}
+
+void extproc_worker_t::create_ring_stream() {
+    if (ring.has()) {
+        ring_stream.create(ring.get(), shm_ring_t::PARENT, socket_stream.get());
+    }
 }
 
 void extproc_worker_t::run_job(bool (*fn) (read_stream_t *, write_stream_t *)) {
@@ -129,9 +152,15 @@ void extproc_worker_t::run_job(bool (*fn) (read_stream_t *, write_stream_t *)) {
 }
 
 read_stream_t *extproc_worker_t::get_read_stream() {
+    if (ring_stream.has()) {
+        return ring_stream.get();
+    }
     return socket_stream.get();
 }
 
 write_stream_t *extproc_worker_t::get_write_stream() {
+    if (ring_stream.has()) {
+        return ring_stream.get();
+    }
     return socket_stream.get();
 }
@@ -9,6 +9,7 @@
 #include "containers/object_buffer.hpp"
 #include "containers/scoped.hpp"
 #include "containers/archive/socket_stream.hpp"
+#include "extproc/shm_ring.hpp"
 
 class extproc_spawner_t;
 
@@ -17,6 +18,9 @@ public:
     explicit extproc_worker_t(extproc_spawner_t *_spawner);
     ~extproc_worker_t();
 
+    // Spawns the worker process ahead of the first job, unless it's running
+    void warm_up();
+
     // Called whenever the worker changes hands (system -> user -> system)
     void acquired(signal_t *_interruptor);
     void released(bool user_error, signal_t *user_interruptor);
@@ -34,6 +38,7 @@ public:
 private:
     void spawn();
     void kill_process();
+    void create_ring_stream();
 
     // This will run inside the blocker pool so the worker process doesn't inherit any
     //  of our coroutine stuff
@@ -45,6 +50,11 @@ private:
 
     object_buffer_t<socket_stream_t> socket_stream;
 
+    // The jobs talk through the ring, if the worker has one, and the socket only
+    //  wakes up the other side.
+    scoped_ptr_t<shm_ring_t> ring;
+    object_buffer_t<shm_ring_stream_t> ring_stream;
+
     signal_t *interruptor;
 };
 
@@ -78,6 +78,7 @@ public:
 enum js_task_t {
     TASK_EVAL,
     TASK_CALL,
+    TASK_CALL_BATCH,
     TASK_RELEASE,
     TASK_EXIT
 };
@@ -115,6 +116,26 @@ js_result_t js_job_t::call(js_id_t id, const std::vector<counted_t<const ql::dat
     return result;
 }
 
+std::vector<js_result_t> js_job_t::call_batch(
+        js_id_t id,
+        const std::vector<std::vector<counted_t<const ql::datum_t> > > &args_batch) {
+    js_task_t task = js_task_t::TASK_CALL_BATCH;
+    write_message_t msg;
+    msg.append(&task, sizeof(task));
+    msg << id;
+    msg << args_batch;
+    int res = send_write_message(extproc_job.write_stream(), &msg);
+    if (res != 0) { throw js_worker_exc_t("failed to send data to the worker"); }
+
+    std::vector<js_result_t> results;
+    res = deserialize(extproc_job.read_stream(), &results);
+    if (res != ARCHIVE_SUCCESS) { throw js_worker_exc_t("failed to deserialize result from worker"); }
+    if (results.size() != args_batch.size()) {
+        throw js_worker_exc_t("the worker returned the wrong number of results");
+    }
+    return results;
+}
+
 void js_job_t::release(js_id_t id) {
     js_task_t task = js_task_t::TASK_RELEASE;
     write_message_t msg;
@@ -176,6 +197,26 @@ bool js_job_t::worker_fn(read_stream_t *stream_in, write_stream_t *stream_out) {
                 if (res != 0) { return false; }
             }
             break;
+        case TASK_CALL_BATCH:
+            {
+                js_id_t id;
+                std::vector<std::vector<counted_t<const ql::datum_t> > > args_batch;
+                res = deserialize(stream_in, &id);
+                if (res != ARCHIVE_SUCCESS) { return false; }
+                res = deserialize(stream_in, &args_batch);
+                if (res != ARCHIVE_SUCCESS) { return false; }
+
+                std::vector<js_result_t> js_results;
+                js_results.reserve(args_batch.size());
+                for (auto it = args_batch.begin(); it != args_batch.end(); ++it) {
+                    js_results.push_back(js_env.call(id, *it));
+                }
+                write_message_t msg;
+                msg << js_results;
+                res = send_write_message(stream_out, &msg);
+                if (res != 0) { return false; }
+            }
+            break;
         case TASK_RELEASE:
             {
                 js_id_t id;
@@ -512,7 +553,7 @@ v8::Handle<v8::Value> js_from_datum(const counted_t<const ql::datum_t> &datum) {
             return date;
         } else {
             v8::Handle<v8::Object> obj = v8::Object::New();
-            const std::map<std::string, counted_t<const ql::datum_t> > &source_map = datum->as_object();
+            const ql::datum_object_t &source_map = datum->as_object();
 
             for (auto it = source_map.begin(); it != source_map.end(); ++it) {
                 v8::HandleScope scope;
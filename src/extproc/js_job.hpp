@@ -23,6 +23,11 @@ public:
 
     js_result_t eval(const std::string &source);
     js_result_t call(js_id_t id, const std::vector<counted_t<const ql::datum_t> > &args);
+    // Calls the function once for every element of `args_batch` with one message
+    // to the worker and one back, and returns the results in the same order.
+    std::vector<js_result_t> call_batch(
+        js_id_t id,
+        const std::vector<std::vector<counted_t<const ql::datum_t> > > &args_batch);
     void release(js_id_t id);
     void exit();
 
@@ -174,6 +174,42 @@ js_result_t js_runner_t::call(const std::string &source,
     return result;
 }
 
+std::vector<js_result_t> js_runner_t::call_batch(
+        const std::string &source,
+        const std::vector<std::vector<counted_t<const ql::datum_t> > > &args_batch,
+        const req_config_t &config) {
+    assert_thread();
+    guarantee(job_data.has());
+
+    // This will retrieve the function from the cache if it's there, or re-eval it
+    js_result_t fn_result = eval(source, config);
+    js_id_t *fn_id = boost::get<js_id_t>(&fn_result);
+    guarantee(fn_id != NULL);
+
+    object_buffer_t<js_timeout_t::sentry_t> sentry;
+    sentry.create(&job_data->js_timeout, config.timeout_ms * args_batch.size());
+
+    std::vector<js_result_t> results;
+    try {
+        results = job_data->js_job.call_batch(*fn_id, args_batch);
+        for (auto it = results.begin(); it != results.end(); ++it) {
+            if (js_id_t *any_id = boost::get<js_id_t>(&*it)) {
+                release_id(*any_id);
+            }
+        }
+    } catch (...) {
+        // Sentry must be destroyed before the js_timeout
+        sentry.reset();
+        // This will mark the worker as errored so we don't try to re-sync with it
+        //  on the next line (since we're in a catch statement, we aren't allowed)
+        job_data->js_job.worker_error();
+        job_data.reset();
+        throw;
+    }
+
+    return results;
+}
+
 void js_runner_t::cache_id(js_id_t id, const std::string &source) {
     guarantee(job_data.has());
     guarantee(id != INVALID_ID);
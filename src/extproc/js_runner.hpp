@@ -64,6 +64,15 @@ public:
                      const std::vector<counted_t<const ql::datum_t> > &args,
                      const req_config_t &config);
 
+    // Calls a previously compiled function with every one of `args_batch`, all in
+    // one round trip to the worker.  The calls get `config.timeout_ms` each, so
+    // the batch times out after `args_batch.size()` times that.  Functions that
+    // the calls return are released right away, so they can't be called by id.
+    std::vector<js_result_t> call_batch(
+        const std::string &source,
+        const std::vector<std::vector<counted_t<const ql::datum_t> > > &args_batch,
+        const req_config_t &config);
+
 private:
     static const size_t CACHE_SIZE;
 
@@ -0,0 +1,166 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "extproc/shm_ring.hpp"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+
+#include "config/args.hpp"
+#include "logger.hpp"
+#include "utils.hpp"
+
+shm_ring_t::shm_ring_t(fd_t fd) {
+    region = mmap(NULL, region_size(), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    guarantee_err(region != MAP_FAILED, "Could not map extproc ring");
+}
+
+shm_ring_t::~shm_ring_t() {
+    int res = munmap(region, region_size());
+    guarantee_err(res == 0, "Could not unmap extproc ring");
+}
+
+fd_t shm_ring_t::create_fd() {
+    if (EXTPROC_RING_SIZE == 0) {
+        return INVALID_FD;
+    }
+
+    // Workers get spawned from every thread.
+    static uint64_t counter = 0;
+    const std::string name = strprintf("/rethinkdb-extproc-%d-%" PRIu64,
+                                       static_cast<int>(getpid()),
+                                       __sync_fetch_and_add(&counter, 1));
+    scoped_fd_t fd(shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600));
+    if (fd.get() == INVALID_FD) {
+        logWRN("Could not create shared memory for an extproc worker, "
+               "falling back to its socket: %s", errno_string(errno).c_str());
+        return INVALID_FD;
+    }
+    // The worker gets the fd, so the name isn't needed.
+    int res = shm_unlink(name.c_str());
+    guarantee_err(res == 0, "Could not unlink extproc ring");
+
+    // The region starts out zeroed, so the rings start out empty.
+    res = ftruncate(fd.get(), region_size());
+    if (res != 0) {
+        logWRN("Could not size shared memory for an extproc worker, "
+               "falling back to its socket: %s", errno_string(errno).c_str());
+        return INVALID_FD;
+    }
+    return fd.release();
+}
+
+size_t shm_ring_t::region_size() {
+    return 2 * CACHE_LINE_SIZE + 2 * EXTPROC_RING_SIZE;
+}
+
+shm_ring_t::ring_header_t *shm_ring_t::header(side_t writer) {
+    CT_ASSERT(sizeof(ring_header_t) <= CACHE_LINE_SIZE);
+    return reinterpret_cast<ring_header_t *>(
+        static_cast<char *>(region) + (writer == PARENT ? 0 : CACHE_LINE_SIZE));
+}
+
+char *shm_ring_t::data(side_t writer) {
+    return static_cast<char *>(region) + 2 * CACHE_LINE_SIZE
+        + (writer == PARENT ? 0 : EXTPROC_RING_SIZE);
+}
+
+shm_ring_stream_t::shm_ring_stream_t(shm_ring_t *ring, shm_ring_t::side_t side,
+                                     socket_stream_t *_socket)
+    : socket(_socket) {
+    const shm_ring_t::side_t other =
+        side == shm_ring_t::PARENT ? shm_ring_t::WORKER : shm_ring_t::PARENT;
+    in = ring->header(other);
+    in_data = ring->data(other);
+    out = ring->header(side);
+    out_data = ring->data(side);
+}
+
+bool shm_ring_stream_t::ready(shm_ring_t::ring_header_t *ring, bool wait_for_data) {
+    const uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_SEQ_CST);
+    const uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_SEQ_CST);
+    return wait_for_data ? tail != head : tail - head < EXTPROC_RING_SIZE;
+}
+
+int64_t shm_ring_stream_t::read(void *p, int64_t n) {
+    guarantee(n > 0);
+    for (;;) {
+        const uint64_t head = in->head;
+        const uint64_t tail = __atomic_load_n(&in->tail, __ATOMIC_SEQ_CST);
+        if (tail == head) {
+            if (!wait(in, true, &in->reader_waiting)) {
+                return -1;
+            }
+            continue;
+        }
+
+        // The data may wrap around the end of the ring.
+        const uint64_t size = std::min<uint64_t>(tail - head, n);
+        const uint64_t offset = head % EXTPROC_RING_SIZE;
+        const uint64_t first = std::min<uint64_t>(size, EXTPROC_RING_SIZE - offset);
+        memcpy(p, in_data + offset, first);
+        memcpy(static_cast<char *>(p) + first, in_data, size - first);
+        __atomic_store_n(&in->head, head + size, __ATOMIC_SEQ_CST);
+
+        if (!wake(&in->writer_waiting)) {
+            return -1;
+        }
+        return size;
+    }
+}
+
+int64_t shm_ring_stream_t::write(const void *p, int64_t n) {
+    guarantee(n > 0);
+    const char *bufp = static_cast<const char *>(p);
+    int64_t left = n;
+    while (left > 0) {
+        const uint64_t head = __atomic_load_n(&out->head, __ATOMIC_SEQ_CST);
+        const uint64_t tail = out->tail;
+        const uint64_t space = EXTPROC_RING_SIZE - (tail - head);
+        if (space == 0) {
+            if (!wait(out, false, &out->writer_waiting)) {
+                return -1;
+            }
+            continue;
+        }
+
+        const uint64_t size = std::min<uint64_t>(space, left);
+        const uint64_t offset = tail % EXTPROC_RING_SIZE;
+        const uint64_t first = std::min<uint64_t>(size, EXTPROC_RING_SIZE - offset);
+        memcpy(out_data + offset, bufp, first);
+        memcpy(out_data, bufp + first, size - first);
+        __atomic_store_n(&out->tail, tail + size, __ATOMIC_SEQ_CST);
+
+        if (!wake(&out->reader_waiting)) {
+            return -1;
+        }
+        bufp += size;
+        left -= size;
+    }
+    return n;
+}
+
+bool shm_ring_stream_t::wait(shm_ring_t::ring_header_t *ring, bool wait_for_data,
+                             uint32_t *flag) {
+    __atomic_store_n(flag, 1, __ATOMIC_SEQ_CST);
+    // If the other side moved the ring before it could see the flag, we take the
+    // flag back, unless it got there first and is about to ring the socket.
+    if (ready(ring, wait_for_data)
+        && __atomic_exchange_n(flag, 0, __ATOMIC_SEQ_CST) == 1) {
+        return true;
+    }
+    char c;
+    return force_read(socket, &c, 1) == 1;
+}
+
+bool shm_ring_stream_t::wake(uint32_t *flag) {
+    if (__atomic_load_n(flag, __ATOMIC_SEQ_CST) == 0
+        || __atomic_exchange_n(flag, 0, __ATOMIC_SEQ_CST) == 0) {
+        return true;
+    }
+    const char c = 0;
+    return socket->write(&c, 1) == 1;
+}
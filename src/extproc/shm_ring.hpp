@@ -0,0 +1,84 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#ifndef EXTPROC_SHM_RING_HPP_
+#define EXTPROC_SHM_RING_HPP_
+
+#include <stdint.h>
+
+#include "arch/io/io_utils.hpp"
+#include "containers/archive/archive.hpp"
+#include "containers/archive/socket_stream.hpp"
+
+/* A shared memory region between the main process and an extproc worker, with a
+byte ring for every direction.  What the jobs read and write goes through the rings
+instead of the socket, so it's copied once and doesn't take any system calls as long
+as the other side is busy.  A side that finds its ring empty (or full) sets a flag in
+the ring and sleeps reading a byte off the socket, and the other side writes that
+byte only if it finds the flag set.  Waiting on the socket instead of an eventfd
+keeps noticing a dead worker and interrupting a job the way they work without the
+ring. */
+class shm_ring_t {
+public:
+    enum side_t { PARENT, WORKER };
+
+    // Maps the region of `fd`, which it doesn't take ownership of.
+    explicit shm_ring_t(fd_t fd);
+    ~shm_ring_t();
+
+    // Makes an unnamed region for rings of EXTPROC_RING_SIZE bytes, or returns
+    // INVALID_FD if we can't have shared memory.
+    static fd_t create_fd();
+
+private:
+    friend class shm_ring_stream_t;
+
+    struct ring_header_t {
+        // How many bytes have ever been read and written.  Only the reader moves
+        // `head` and only the writer moves `tail`.
+        uint64_t head;
+        uint64_t tail;
+        // Set by a side that sleeps until the other one rings the socket.
+        uint32_t reader_waiting;
+        uint32_t writer_waiting;
+    };
+
+    static size_t region_size();
+
+    ring_header_t *header(side_t writer);
+    char *data(side_t writer);
+
+    void *region;
+
+    DISABLE_COPYING(shm_ring_t);
+};
+
+// The streams of one side of a shm_ring_t.  They ring the other side through
+// `socket`, whose interruptor interrupts them too.
+class shm_ring_stream_t : public read_stream_t, public write_stream_t {
+public:
+    shm_ring_stream_t(shm_ring_t *ring, shm_ring_t::side_t side,
+                      socket_stream_t *socket);
+
+    virtual MUST_USE int64_t read(void *p, int64_t n);
+    virtual int64_t write(const void *p, int64_t n);
+
+private:
+    // Whether there's data (or space, if `wait_for_data` is false) in `ring`.
+    static bool ready(shm_ring_t::ring_header_t *ring, bool wait_for_data);
+    // Sleeps until the other side clears `*flag` and rings the socket, unless
+    // `wait_for_data` (or space, if false) in `ring` shows up first.  Returns false
+    // if the socket got closed.
+    bool wait(shm_ring_t::ring_header_t *ring, bool wait_for_data, uint32_t *flag);
+    // Rings the socket if the other side set `*flag`.  Returns false if the socket
+    // got closed.
+    bool wake(uint32_t *flag);
+
+    shm_ring_t::ring_header_t *in;
+    char *in_data;
+    shm_ring_t::ring_header_t *out;
+    char *out_data;
+    socket_stream_t *socket;
+
+    DISABLE_COPYING(shm_ring_stream_t);
+};
+
+#endif  // EXTPROC_SHM_RING_HPP_
@@ -9,24 +9,39 @@
 #include "memcached/region.hpp"
 #include "stl_utils.hpp"
 
+// By the power of magic, the 62nd, 61st, ..., 55th bits of the result are
+// equal to the 0th, 1st, 2nd, ..., 7th bits of ch.  This helps
+// hash_region_hasher meet the criterion specified below.
+uint64_t hash_region_spread_byte(uint8_t ch) {
+    return (((ch * 0x80200802ULL) & 0x0884422110ULL) * 0x0101010101ULL) << 23;
+}
+
+// hash_region_spread_byte for every byte, so that hashing a key costs a table
+// lookup per byte rather than two multiplications.
+class hash_region_spread_table_t {
+public:
+    hash_region_spread_table_t() {
+        for (int ch = 0; ch < 256; ++ch) {
+            table[ch] = hash_region_spread_byte(ch);
+        }
+    }
+    uint64_t table[256];
+};
+
 // TODO: Replace this with a real hash function, if it is not one
 // already.  It needs the property that values are uniformly
 // distributed beteween 0 and UINT64_MAX / 2, so that splitting
 // [0,UINT64_MAX/2] into equal intervals of size ((UINT64_MAX / 2 + 1)
-// / n) will uniformly distribute keys.
+// / n) will uniformly distribute keys.  Hash values are stored on disk as
+// the bounds of hash shards, so this must never change what it returns.
 uint64_t hash_region_hasher(const uint8_t *s, ssize_t len) {
     rassert(len >= 0);
 
+    static const hash_region_spread_table_t spread;
+
     uint64_t h = 0x47a59e381fb2dc06ULL;
     for (ssize_t i = 0; i < len; ++i) {
-        uint8_t ch = s[i];
-
-        // By the power of magic, the 62nd, 61st, ..., 55th bits of d
-        // are equal to the 0th, 1st, 2nd, ..., 7th bits of ch.  This
-        // helps us meet the criterion specified above.
-        uint64_t d = (((ch * 0x80200802ULL) & 0x0884422110ULL) * 0x0101010101ULL) << 23;
-
-        h += d;
+        h += spread.table[s[i]];
         h = h ^ (h >> 11) ^ (h << 21);
     }
 
@@ -22,6 +22,8 @@ struct store_key_t;
 // Returns a value in [0, HASH_REGION_HASH_SIZE).
 const uint64_t HASH_REGION_HASH_SIZE = 1ULL << 63;
 uint64_t hash_region_hasher(const uint8_t *s, ssize_t len);
+// The part of `hash_region_hasher` that depends on each byte of the key.
+uint64_t hash_region_spread_byte(uint8_t ch);
 
 // Forms a region that shards an inner_region_t by a different
 // dimension: hash values, which are computed by the function
@@ -146,6 +148,27 @@ hash_region_t<inner_region_t> drop_cpu_sharding(const hash_region_t<inner_region
     return hash_region_t<inner_region_t>(0, HASH_REGION_HASH_SIZE, r.inner);
 }
 
+// Cuts r's hash interval into num_parts roughly equal pieces and returns piece
+// number part_number, which may be empty if the interval is too narrow.
+template <class inner_region_t>
+hash_region_t<inner_region_t> region_subdivide(const hash_region_t<inner_region_t> &r,
+                                               int part_number, int num_parts) {
+    guarantee(part_number >= 0);
+    guarantee(part_number < num_parts);
+    if (region_is_empty(r)) {
+        return r;
+    }
+
+    // Like cpu_sharding_subspace, careful to avoid overflow.
+    uint64_t width = (r.end - r.beg) / num_parts;
+    uint64_t beg = r.beg + width * part_number;
+    uint64_t end = part_number + 1 == num_parts ? r.end : beg + width;
+    if (beg == end) {
+        return hash_region_t<inner_region_t>();
+    }
+    return hash_region_t<inner_region_t>(beg, end, r.inner);
+}
+
 template <class inner_region_t>
 std::vector< hash_region_t<inner_region_t> > region_subtract_many(const hash_region_t<inner_region_t> &minuend,
                                                                   const std::vector< hash_region_t<inner_region_t> >& subtrahends) {
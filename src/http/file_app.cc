@@ -2,7 +2,9 @@
 
 #include <time.h>
 
+#include <algorithm>
 #include <set>
+#include <stdexcept>
 #include <string>
 
 #include "errors.hpp"
@@ -95,33 +97,37 @@ void file_http_app_t::handle_blocking(std::string filename, http_res_t *res_out)
     }
 
     // FIXME: make sure that we won't walk out of our sandbox! Check symbolic links, etc.
-    blocking_read_file_stream_t stream;
-    bool initialized = stream.init((asset_dir + filename).c_str());
-
-    res_out->add_header_line("Content-Type", mimetype);
+    scoped_ptr_t<blocking_read_file_stream_t> stream(new blocking_read_file_stream_t);
+    bool initialized = stream->init((asset_dir + filename).c_str());
 
     if (!initialized) {
+        res_out->add_header_line("Content-Type", mimetype);
         res_out->code = 404;
         return;
     }
 
-    std::vector<char> body;
-
-    for (;;) {
-        const int bufsize = 4096;
-        char buf[bufsize];
-        int64_t res = stream.read(buf, bufsize);
-
-        if (res > 0) {
-            body.insert(body.end(), buf, buf + res);
-        } else if (res == 0) {
-            break;
-        } else {
-            res_out->code = 500;
-            return;
-        }
+    res_out->set_body_generator(mimetype, new file_body_generator_t(&stream));
+    res_out->code = 200;
+}
+
+file_body_generator_t::file_body_generator_t(scoped_ptr_t<blocking_read_file_stream_t> *_stream) {
+    stream.swap(*_stream);
+}
+
+file_body_generator_t::~file_body_generator_t() { }
+
+bool file_body_generator_t::next(std::string *piece_out) {
+    int64_t res;
+    thread_pool_t::run_in_blocker_pool(boost::bind(&file_body_generator_t::read_blocking, this, piece_out, &res));
+    if (res < 0) {
+        throw std::runtime_error("could not read a web asset");
     }
+    return res > 0;
+}
 
-    res_out->body.assign(body.begin(), body.end());
-    res_out->code = 200;
+void file_body_generator_t::read_blocking(std::string *piece_out, int64_t *res_out) {
+    const int bufsize = 64 * KILOBYTE;
+    piece_out->resize(bufsize);
+    *res_out = stream->read(&(*piece_out)[0], bufsize);
+    piece_out->resize(std::max<int64_t>(*res_out, 0));
 }
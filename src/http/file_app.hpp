@@ -5,8 +5,11 @@
 #include <string>
 #include <set>
 
+#include "containers/scoped.hpp"
 #include "http/http.hpp"
 
+class blocking_read_file_stream_t;
+
 class file_http_app_t : public http_app_t {
 public:
     file_http_app_t(std::set<std::string> _whitelist, std::string _asset_dir);
@@ -19,4 +22,20 @@ private:
     std::string asset_dir;
 };
 
+/* Streams a web asset out of its file, reading a piece at a time in the blocker
+pool, so that we don't hold the whole file in memory. */
+class file_body_generator_t : public http_body_generator_t {
+public:
+    explicit file_body_generator_t(scoped_ptr_t<blocking_read_file_stream_t> *_stream);
+    ~file_body_generator_t();
+
+    bool next(std::string *piece_out);
+private:
+    void read_blocking(std::string *piece_out, int64_t *res_out);
+
+    scoped_ptr_t<blocking_read_file_stream_t> stream;
+
+    DISABLE_COPYING(file_body_generator_t);
+};
+
 #endif /* HTTP_FILE_APP_HPP_ */
@@ -8,6 +8,9 @@
 #include <boost/algorithm/string.hpp>
 
 #include "arch/io/network.hpp"
+#include "arch/timing.hpp"
+#include "concurrency/wait_any.hpp"
+#include "containers/printf_buffer.hpp"
 #include "logger.hpp"
 
 static const char *resource_parts_sep_char = "/";
@@ -175,6 +178,19 @@ void http_res_t::set_body(const std::string& content_type, const std::string& co
     body = content;
 }
 
+void http_res_t::set_body_generator(const std::string &content_type, http_body_generator_t *generator) {
+    for (std::vector<header_line_t>::iterator it = header_lines.begin(); it != header_lines.end(); ++it) {
+        guarantee(it->key != "Content-Type");
+        guarantee(it->key != "Content-Length");
+    }
+    guarantee(body.size() == 0);
+    guarantee(!body_generator);
+
+    add_header_line("Content-Type", content_type);
+
+    body_generator.reset(generator);
+}
+
 http_res_t http_error_res(const std::string &content, http_status_code_t rescode) {
     return http_res_t(rescode, "application/text", content);
 }
@@ -284,41 +300,129 @@ std::string human_readable_status(int code) {
     }
 }
 
-void write_http_msg(tcp_conn_t *conn, const http_res_t &res, signal_t *closer) THROWS_ONLY(tcp_conn_write_closed_exc_t) {
-    conn->writef(closer, "HTTP/%s %d %s\r\n", res.version.c_str(), res.code, human_readable_status(res.code).c_str());
+/* Writes `res` to `conn`, all of its body unless `send_body` is false, and
+returns once it's all gone out.  A body that comes from a generator is sent with
+chunked transfer encoding if `chunked` is true, and as is otherwise, in which case
+the connection must be closed afterwards to mark its end. */
+void write_http_msg(tcp_conn_t *conn, const http_res_t &res, bool send_body, bool chunked,
+                    signal_t *closer)
+    THROWS_ONLY(tcp_conn_write_closed_exc_t, std::exception) {
+    printf_buffer_t head;
+    head.appendf("HTTP/%s %d %s\r\n", res.version.c_str(), res.code, human_readable_status(res.code).c_str());
+    bool has_content_length = false;
     for (std::vector<header_line_t>::const_iterator it = res.header_lines.begin(); it != res.header_lines.end(); ++it) {
-        conn->writef(closer, "%s: %s\r\n", it->key.c_str(), it->val.c_str());
+        head.appendf("%s: %s\r\n", it->key.c_str(), it->val.c_str());
+        has_content_length = has_content_length || boost::iequals(it->key, "Content-Length");
+    }
+    if (res.body_generator) {
+        if (chunked) {
+            head.appendf("Transfer-Encoding: chunked\r\n");
+        }
+    } else if (!has_content_length) {
+        // The client needs it to find the end of the body on a persistent
+        // connection.
+        head.appendf("Content-Length: %zu\r\n", res.body.size());
+    }
+    head.appendf("\r\n");
+    conn->write_buffered(head.data(), head.size(), closer);
+
+    if (send_body) {
+        if (res.body_generator) {
+            std::string piece;
+            while (res.body_generator->next(&piece)) {
+                // An empty chunk would end the body.
+                if (piece.empty()) {
+                    continue;
+                }
+                if (chunked) {
+                    printf_buffer_t chunk_head("%zx\r\n", piece.size());
+                    conn->write_buffered(chunk_head.data(), chunk_head.size(), closer);
+                }
+                conn->write_buffered(piece.data(), piece.size(), closer);
+                if (chunked) {
+                    conn->write_buffered("\r\n", 2, closer);
+                }
+                piece.clear();
+            }
+            if (chunked) {
+                conn->write_buffered("0\r\n\r\n", 5, closer);
+            }
+        } else {
+            conn->write_buffered(res.body.data(), res.body.size(), closer);
+        }
+    }
+    conn->flush_buffer(closer);
+}
+
+// Whether the client wants the connection kept open after the response to `req`.
+bool wants_keep_alive(const http_req_t &req) {
+    // We don't read chunked request bodies, so we wouldn't know where the next
+    // request starts.
+    if (req.has_header_line("Transfer-Encoding")) {
+        return false;
+    }
+    boost::optional<std::string> connection = req.find_header_line("Connection");
+    if (req.version == "1.1") {
+        return !connection || !boost::iequals(connection.get(), "close");
+    } else {
+        return connection && boost::iequals(connection.get(), "keep-alive");
     }
-    conn->writef(closer, "\r\n");
-    conn->write(res.body.c_str(), res.body.size(), closer);
 }
 
 void http_server_t::handle_conn(const scoped_ptr_t<tcp_conn_descriptor_t> &nconn, auto_drainer_t::lock_t keepalive) {
     scoped_ptr_t<tcp_conn_t> conn;
     nconn->make_overcomplicated(&conn);
 
-    http_req_t req;
-    tcp_http_msg_parser_t http_msg_parser;
-
-    /* parse the request */
     try {
-        if (http_msg_parser.parse(conn.get(), &req, keepalive.get_drain_signal())) {
+        // Requests that the client pipelines sit in the connection's read buffer
+        // until we get to them, so they're answered in order.
+        for (;;) {
+            http_req_t req;
+            tcp_http_msg_parser_t http_msg_parser;
+
+            /* parse the request */
+            bool parsed;
+            {
+                signal_timer_t idle_timer;
+                idle_timer.start(HTTP_KEEPALIVE_IDLE_TIMEOUT_MS);
+                wait_any_t closer(&idle_timer, keepalive.get_drain_signal());
+                parsed = http_msg_parser.parse(conn.get(), &req, &closer);
+            }
+
+            if (!parsed) {
+                // Write error.  We can't tell where the next request would start.
+                http_res_t res(HTTP_BAD_REQUEST);
+                res.version = "1.1";
+                res.add_header_line("Connection", "close");
+                write_http_msg(conn.get(), res, true, false, keepalive.get_drain_signal());
+                break;
+            }
+
             /* TODO pass interruptor */
             http_res_t res = application->handle(req);
             res.version = req.version;
-            write_http_msg(conn.get(), res, keepalive.get_drain_signal());
-        } else {
-            // Write error
-            http_res_t res;
-            res.code = 400;
-            write_http_msg(conn.get(), res, keepalive.get_drain_signal());
+
+            const bool chunked = req.version == "1.1";
+            const bool keep_alive = wants_keep_alive(req)
+                && (!res.body_generator || chunked || req.method == HEAD);
+            res.add_header_line("Connection", keep_alive ? "keep-alive" : "close");
+            write_http_msg(conn.get(), res, req.method != HEAD, chunked,
+                           keepalive.get_drain_signal());
+
+            if (!keep_alive) {
+                break;
+            }
         }
     } catch (const tcp_conn_read_closed_exc_t &) {
         // Someone disconnected before sending us all the information we
-        // needed... oh well.
+        // needed... oh well.  Or a persistent connection sat idle too long.
     } catch (const tcp_conn_write_closed_exc_t &) {
         // We were trying to write to someone and they didn't stick around long
         // enough to write it.
+    } catch (const std::exception &e) {
+        // A body generator failed partway through the body; dropping the
+        // connection tells the client the body is incomplete.
+        logERR("Could not produce the body of an HTTP response: %s", e.what());
     }
 }
 
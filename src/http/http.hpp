@@ -10,6 +10,7 @@
 #include "errors.hpp"
 #include <boost/tokenizer.hpp>
 #include <boost/shared_array.hpp>
+#include <boost/shared_ptr.hpp>
 #include <boost/optional.hpp>
 
 #include "arch/types.hpp"
@@ -99,15 +100,34 @@ enum http_status_code_t {
     HTTP_INTERNAL_SERVER_ERROR = 500
 };
 
+/* Produces the body of an `http_res_t` a piece at a time, so that the server can
+write it to the connection as it's made instead of holding all of it in memory.
+HTTP/1.1 clients get such a body with chunked transfer encoding; for older ones
+the server closes the connection after it. */
+class http_body_generator_t {
+public:
+    virtual ~http_body_generator_t() { }
+
+    /* Sets `*piece_out` to the next piece of the body and returns true, or returns
+    false once there are no more.  Throws `std::exception` if it can't produce the
+    rest of the body, in which case the server drops the connection, so that the
+    client doesn't take what it got for the whole body. */
+    virtual bool next(std::string *piece_out) = 0;
+};
+
 class http_res_t {
 public:
     std::string version;
     int code;
     std::vector<header_line_t> header_lines;
     std::string body;
+    // If set, this produces the body instead of `body`.
+    boost::shared_ptr<http_body_generator_t> body_generator;
 
     void add_header_line(const std::string&, const std::string&);
     void set_body(const std::string&, const std::string&);
+    // Takes ownership of `generator`.
+    void set_body_generator(const std::string &content_type, http_body_generator_t *generator);
 
     http_res_t();
     explicit http_res_t(http_status_code_t rescode);
@@ -160,7 +180,9 @@ public:
 /* creating an http server will bind to the specified port and listen for http
  * connections, the data from incoming connections will be parsed into
  * http_req_ts and passed to the handle function which must then return an http
- * msg that's a meaningful response */
+ * msg that's a meaningful response.  Connections are persistent unless the
+ * client asks otherwise, and the requests a client pipelines on one are
+ * answered in order. */
 class http_server_t {
 public:
     http_server_t(const std::set<ip_address_t> &local_addresses, int port, http_app_t *application);
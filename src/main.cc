@@ -5,6 +5,7 @@
 
 #include "clustering/administration/main/command_line.hpp"
 #include "clustering/administration/cli/admin_command_parser.hpp"
+#include "migrate/migrate.hpp"
 #include "utils.hpp"
 #include "config/args.hpp"
 
@@ -46,6 +47,8 @@ int main(int argc, char *argv[]) {
             return main_rethinkdb_dump(argc, argv);
         } else if (subcommand == "restore") {
             return main_rethinkdb_restore(argc, argv);
+        } else if (subcommand == "migrate") {
+            return run_migrate(argc, argv);
         } else if (subcommand == "--version" || subcommand == "-v") {
             if (argc != 2) {
 		          printf("WARNING: Ignoring extra parameters after '%s'.", subcommand.c_str());
@@ -83,6 +86,8 @@ int main(int argc, char *argv[]) {
                     help_rethinkdb_dump();
                 } else if (subcommand2 == "restore") {
                     help_rethinkdb_restore();
+                } else if (subcommand2 == "migrate") {
+                    migrate::usage(argv[0]);
                 } else {
                     printf("ERROR: No help for '%s'\n", subcommand2.c_str());
                     return 1;
@@ -0,0 +1,744 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "memcached/binary_parser.hpp"
+
+#ifndef __STDC_FORMAT_MACROS
+#define __STDC_FORMAT_MACROS
+#endif
+
+#include <inttypes.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "errors.hpp"
+#include <boost/bind.hpp>
+
+#include "arch/runtime/coroutines.hpp"
+#include "concurrency/coro_fifo.hpp"
+#include "concurrency/mutex.hpp"
+#include "concurrency/semaphore.hpp"
+#include "containers/scoped.hpp"
+#include "logger.hpp"
+#include "perfmon/collect.hpp"
+
+/* The binary protocol is described at
+https://code.google.com/p/memcached/wiki/MemcacheBinaryProtocol. Every request
+and every response is a 24-byte header followed by the extras, the key and the
+value, and all the numbers are big-endian. */
+
+enum bin_opcode_t {
+    bin_opcode_get = 0x00,
+    bin_opcode_set = 0x01,
+    bin_opcode_add = 0x02,
+    bin_opcode_replace = 0x03,
+    bin_opcode_delete = 0x04,
+    bin_opcode_increment = 0x05,
+    bin_opcode_decrement = 0x06,
+    bin_opcode_quit = 0x07,
+    bin_opcode_flush = 0x08,
+    bin_opcode_getq = 0x09,
+    bin_opcode_noop = 0x0a,
+    bin_opcode_version = 0x0b,
+    bin_opcode_getk = 0x0c,
+    bin_opcode_getkq = 0x0d,
+    bin_opcode_append = 0x0e,
+    bin_opcode_prepend = 0x0f,
+    bin_opcode_stat = 0x10,
+    bin_opcode_setq = 0x11,
+    bin_opcode_addq = 0x12,
+    bin_opcode_replaceq = 0x13,
+    bin_opcode_deleteq = 0x14,
+    bin_opcode_incrementq = 0x15,
+    bin_opcode_decrementq = 0x16,
+    bin_opcode_quitq = 0x17,
+    bin_opcode_flushq = 0x18,
+    bin_opcode_appendq = 0x19,
+    bin_opcode_prependq = 0x1a
+};
+
+enum bin_status_t {
+    bin_status_no_error = 0x0000,
+    bin_status_key_not_found = 0x0001,
+    bin_status_key_exists = 0x0002,
+    bin_status_value_too_large = 0x0003,
+    bin_status_invalid_arguments = 0x0004,
+    bin_status_item_not_stored = 0x0005,
+    bin_status_non_numeric_value = 0x0006,
+    bin_status_unknown_command = 0x0081,
+    bin_status_not_supported = 0x0083,
+    bin_status_temporary_failure = 0x0086
+};
+
+#define BIN_RESPONSE_MAGIC 0x81
+#define BIN_HEADER_SIZE 24
+
+/* The expiration time that tells an increment or decrement not to create a
+missing key. */
+#define BIN_NO_INITIAL_VALUE 0xffffffffu
+
+static uint16_t decode_be16(const uint8_t *p) {
+    return (uint16_t(p[0]) << 8) | p[1];
+}
+
+static uint32_t decode_be32(const uint8_t *p) {
+    return (uint32_t(decode_be16(p)) << 16) | decode_be16(p + 2);
+}
+
+static uint64_t decode_be64(const uint8_t *p) {
+    return (uint64_t(decode_be32(p)) << 32) | decode_be32(p + 4);
+}
+
+static void encode_be16(uint16_t x, uint8_t *p) {
+    p[0] = x >> 8;
+    p[1] = x;
+}
+
+static void encode_be32(uint32_t x, uint8_t *p) {
+    encode_be16(x >> 16, p);
+    encode_be16(x, p + 2);
+}
+
+static void encode_be64(uint64_t x, uint8_t *p) {
+    encode_be32(x >> 32, p);
+    encode_be32(x, p + 4);
+}
+
+/* The same rule as for the text protocol: expiration times of up to thirty days
+are relative to now, and anything longer is a Unix time. */
+static exptime_t absolute_exptime(exptime_t exptime) {
+    if (exptime <= 60*60*24*30 && exptime > 0) {
+        exptime += time(NULL);
+    }
+    return exptime;
+}
+
+struct bin_request_t {
+    uint8_t opcode;
+    uint32_t opaque;
+    cas_t cas;
+    std::vector<uint8_t> extras;
+    store_key_t key;
+    /* Set instead of `key` if the client sent one that we can't store. */
+    bool key_too_long;
+    counted_t<data_buffer_t> value;
+
+    /* `fifo_acq` makes the responses go out in the order the requests came in,
+    however long each of them takes. */
+    coro_fifo_acq_t fifo_acq;
+    order_token_t token;
+};
+
+struct bin_response_t {
+    bin_response_t()
+        : status(bin_status_no_error), cas(0), extras_size(0), with_key(false),
+          suppressed(false) { }
+
+    uint16_t status;
+    cas_t cas;
+    uint8_t extras[8];
+    uint8_t extras_size;
+    bool with_key;
+    /* The value is either `value`, for gets, or `body`, for everything else that
+    has one: error messages, counters and so on. */
+    counted_t<data_buffer_t> value;
+    std::string body;
+    /* The "STAT" responses, all but the last one, which has no key or value. */
+    std::vector<std::pair<std::string, std::string> > stats;
+    /* Quiet opcodes don't answer when everything went as expected. */
+    bool suppressed;
+};
+
+static bool is_quiet(uint8_t opcode) {
+    switch (opcode) {
+    case bin_opcode_getq:
+    case bin_opcode_getkq:
+    case bin_opcode_setq:
+    case bin_opcode_addq:
+    case bin_opcode_replaceq:
+    case bin_opcode_deleteq:
+    case bin_opcode_incrementq:
+    case bin_opcode_decrementq:
+    case bin_opcode_quitq:
+    case bin_opcode_flushq:
+    case bin_opcode_appendq:
+    case bin_opcode_prependq:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static void set_error(bin_status_t status, const char *message, bin_response_t *response) {
+    response->status = status;
+    response->body = message;
+}
+
+static void flatten_stats(const perfmon_result_t *stats, const std::string &name,
+                          std::vector<std::pair<std::string, std::string> > *out) {
+    switch (stats->get_type()) {
+    case perfmon_result_t::type_value:
+        out->push_back(std::make_pair(name, *stats->get_string()));
+        break;
+    case perfmon_result_t::type_map:
+        for (perfmon_result_t::const_iterator i = stats->begin(); i != stats->end(); ++i) {
+            flatten_stats(i->second, name.empty() ? i->first : name + "." + i->first, out);
+        }
+        break;
+    default:
+        unreachable("Bad perfmon result type");
+    }
+}
+
+class bin_memcached_handler_t : public home_thread_mixin_debug_only_t {
+public:
+    bin_memcached_handler_t(memcached_interface_t *_interface,
+                            namespace_interface_t<memcached_protocol_t> *_nsi,
+                            int max_concurrent_queries_per_connection,
+                            memcached_stats_t *_stats,
+                            signal_t *_interruptor)
+        : interface(_interface), nsi(_nsi), stats(_stats), interruptor(_interruptor),
+          requests_out_sem(max_concurrent_queries_per_connection) { }
+
+    void serve() {
+        while (!interruptor->is_pulsed()) {
+            scoped_ptr_t<bin_request_t> request(new bin_request_t);
+            bool quit = false;
+            try {
+                block_pm_duration read_timer(&stats->pm_conns_reading);
+                if (!read_request(request.get(), &quit)) {
+                    break;
+                }
+            } catch (const memcached_interface_t::no_more_data_exc_t &) {
+                break;
+            }
+
+            block_pm_duration action_timer(&stats->pm_conns_acting);
+            requests_out_sem.co_lock();
+            request->fifo_acq.enter(&fifo);
+            if (quit) {
+                /* Answer once everything before has been answered, and close
+                the connection. */
+                bin_response_t response;
+                response.suppressed = is_quiet(request->opcode);
+                finish_request(request.get(), &response);
+                break;
+            }
+            request->token = order_source.check_in("handle_binary_memcache");
+            coro_t::spawn_now_dangerously(boost::bind(&bin_memcached_handler_t::run_request,
+                                                      this, request.release()));
+        }
+
+        /* Make sure everything that's running has finished. */
+        coro_fifo_acq_t fifo_acq;
+        fifo_acq.enter(&fifo);
+        fifo_acq.leave();
+        mutex_t::acq_t write_acq(&write_mutex);
+        flush_buffer();
+    }
+
+private:
+    /* Reads one request off the connection.  Returns false if it's so malformed
+    that the connection should be closed right away. */
+    bool read_request(bin_request_t *request, bool *quit_out)
+        THROWS_ONLY(memcached_interface_t::no_more_data_exc_t) {
+        uint8_t header[BIN_HEADER_SIZE];
+        read(header, BIN_HEADER_SIZE);
+        if (header[0] != MEMCACHED_BINARY_REQUEST_MAGIC) {
+            logERR("Closing memcached connection %p because of a request with a bad magic byte",
+                   coro_t::self());
+            return false;
+        }
+        request->opcode = header[1];
+        const uint16_t key_size = decode_be16(header + 2);
+        const uint8_t extras_size = header[4];
+        const uint32_t body_size = decode_be32(header + 8);
+        request->opaque = decode_be32(header + 12);
+        request->cas = decode_be64(header + 16);
+
+        if (body_size < uint32_t(key_size) + extras_size
+            || body_size - key_size - extras_size > MAX_VALUE_SIZE) {
+            /* There's no point in reading the whole value of something we won't
+            store anyway, and no other way to find the next request. */
+            logERR("Closing memcached connection %p because of a request with a %" PRIu32
+                   "-byte body", coro_t::self(), body_size);
+            return false;
+        }
+
+        request->extras.resize(extras_size);
+        if (extras_size > 0) {
+            read(request->extras.data(), extras_size);
+        }
+        std::vector<uint8_t> key(key_size);
+        if (key_size > 0) {
+            read(key.data(), key_size);
+        }
+        const uint32_t value_size = body_size - key_size - extras_size;
+        request->value = data_buffer_t::create(value_size);
+        if (value_size > 0) {
+            read(request->value->buf(), value_size);
+        }
+
+        request->key_too_long = key_size > MAX_KEY_SIZE;
+        if (!request->key_too_long) {
+            request->key.assign(key_size, key.data());
+        }
+
+        *quit_out = request->opcode == bin_opcode_quit || request->opcode == bin_opcode_quitq;
+        return true;
+    }
+
+    void run_request(bin_request_t *request_raw) {
+        scoped_ptr_t<bin_request_t> request(request_raw);
+        bin_response_t response;
+        if (request->key_too_long) {
+            set_error(bin_status_invalid_arguments, "Key too long", &response);
+        } else {
+            perform(request.get(), &response);
+        }
+        finish_request(request.get(), &response);
+    }
+
+    void finish_request(bin_request_t *request, bin_response_t *response) {
+        request->fifo_acq.leave();
+        {
+            mutex_t::acq_t write_acq(&write_mutex);
+            if (!response->suppressed && interface->is_write_open()) {
+                write_response(*request, *response);
+                /* The responses to quiet requests wait in the buffer for the next
+                response that a client waits for, like the one to a NOOP. */
+                if (!is_quiet(request->opcode)) {
+                    block_pm_duration flush_timer(&stats->pm_conns_writing);
+                    flush_buffer();
+                }
+            }
+        }
+        requests_out_sem.unlock();
+    }
+
+    void perform(bin_request_t *request, bin_response_t *response) {
+        switch (request->opcode) {
+        case bin_opcode_get:
+        case bin_opcode_getq:
+        case bin_opcode_getk:
+        case bin_opcode_getkq:
+            perform_get(request, response);
+            break;
+        case bin_opcode_set:
+        case bin_opcode_setq:
+        case bin_opcode_add:
+        case bin_opcode_addq:
+        case bin_opcode_replace:
+        case bin_opcode_replaceq:
+            perform_sarc(request, response);
+            break;
+        case bin_opcode_append:
+        case bin_opcode_appendq:
+        case bin_opcode_prepend:
+        case bin_opcode_prependq:
+            perform_append_prepend(request, response);
+            break;
+        case bin_opcode_delete:
+        case bin_opcode_deleteq:
+            perform_delete(request, response);
+            break;
+        case bin_opcode_increment:
+        case bin_opcode_incrementq:
+        case bin_opcode_decrement:
+        case bin_opcode_decrementq:
+            perform_incr_decr(request, response);
+            break;
+        case bin_opcode_noop:
+            break;
+        case bin_opcode_version:
+            response->body = strprintf("rethinkdb-%s", RETHINKDB_VERSION);
+            break;
+        case bin_opcode_stat: {
+            scoped_ptr_t<perfmon_result_t> perfmon_stats(perfmon_get_stats());
+            flatten_stats(perfmon_stats.get(), std::string(), &response->stats);
+        } break;
+        case bin_opcode_flush:
+        case bin_opcode_flushq:
+            /* Neither protocol has a way to empty a table. */
+            set_error(bin_status_not_supported, "Not supported", response);
+            break;
+        default:
+            set_error(bin_status_unknown_command, "Unknown command", response);
+            break;
+        }
+    }
+
+    bool check_format(const bin_request_t *request, size_t extras_size, bool with_value,
+                      bin_response_t *response) {
+        if (request->extras.size() != extras_size || request->key.size() == 0
+            || (!with_value && request->value->size() != 0)) {
+            set_error(bin_status_invalid_arguments, "Invalid arguments", response);
+            return false;
+        }
+        return true;
+    }
+
+    void perform_get(bin_request_t *request, bin_response_t *response) {
+        const bool quiet = is_quiet(request->opcode);
+        response->with_key = request->opcode == bin_opcode_getk
+            || request->opcode == bin_opcode_getkq;
+        if (!check_format(request, 0, false, response)) {
+            return;
+        }
+        stats->pm_get_key_size.record(request->key.size());
+        block_pm_duration get_timer(&stats->pm_cmd_get);
+
+        get_result_t res;
+        std::string error_message;
+        try {
+            get_query_t get_query(request->key);
+            memcached_protocol_t::read_t read(get_query, time(NULL));
+            memcached_protocol_t::read_response_t read_response;
+            nsi->read(read, &read_response, request->token.with_read_mode(), interruptor);
+            res = boost::get<get_result_t>(read_response.result);
+        } catch (const cannot_perform_query_exc_t &e) {
+            error_message = e.what();
+        } catch (const interrupted_exc_t &) {
+            response->suppressed = true;
+            return;
+        }
+
+        if (!error_message.empty()) {
+            set_error(bin_status_temporary_failure, error_message.c_str(), response);
+        } else if (!res.value.has()) {
+            set_error(bin_status_key_not_found, "Not found", response);
+            response->suppressed = quiet;
+        } else {
+            /* Plain gets aren't given a CAS, like in the text protocol, so `cas`
+            is whatever the key already had. */
+            response->cas = res.cas;
+            encode_be32(res.flags, response->extras);
+            response->extras_size = 4;
+            response->value = res.value;
+        }
+    }
+
+    /* Runs `write`, and fills in `response` if that failed.  Returns false if it
+    did, or if we were interrupted. */
+    bool run_write(const memcached_protocol_t::write_t &write, order_token_t token,
+                   memcached_protocol_t::write_response_t *write_response,
+                   bin_response_t *response) {
+        std::string error_message;
+        try {
+            nsi->write(write, write_response, token, interruptor);
+            return true;
+        } catch (const cannot_perform_query_exc_t &e) {
+            error_message = e.what();
+        } catch (const interrupted_exc_t &) {
+            response->suppressed = true;
+            return false;
+        }
+        set_error(bin_status_temporary_failure, error_message.c_str(), response);
+        return false;
+    }
+
+    void perform_sarc(bin_request_t *request, bin_response_t *response) {
+        if (!check_format(request, 8, true, response)) {
+            return;
+        }
+        stats->pm_storage_key_size.record(request->key.size());
+        stats->pm_storage_value_size.record(request->value->size());
+        block_pm_duration set_timer(&stats->pm_cmd_set);
+
+        const mcflags_t mcflags = decode_be32(request->extras.data());
+        const exptime_t exptime = absolute_exptime(decode_be32(request->extras.data() + 4));
+
+        /* A CAS turns any of the three into the text protocol's "cas". */
+        add_policy_t add_policy;
+        replace_policy_t replace_policy;
+        switch (request->opcode) {
+        case bin_opcode_set:
+        case bin_opcode_setq:
+            add_policy = add_policy_yes;
+            replace_policy = replace_policy_yes;
+            break;
+        case bin_opcode_add:
+        case bin_opcode_addq:
+            add_policy = add_policy_yes;
+            replace_policy = replace_policy_no;
+            break;
+        case bin_opcode_replace:
+        case bin_opcode_replaceq:
+            add_policy = add_policy_no;
+            replace_policy = replace_policy_yes;
+            break;
+        default: unreachable();
+        }
+        if (request->cas != NO_CAS_SUPPLIED && replace_policy == replace_policy_yes) {
+            add_policy = add_policy_no;
+            replace_policy = replace_policy_if_cas_matches;
+        }
+
+        sarc_mutation_t sarc_mutation(request->key, request->value, mcflags, exptime,
+                                      add_policy, replace_policy, request->cas);
+        memcached_protocol_t::write_response_t write_response;
+        if (!run_write(memcached_protocol_t::write_t(sarc_mutation, generate_cas(), time(NULL)),
+                   request->token, &write_response, response)) {
+            return;
+        }
+
+        switch (boost::get<set_result_t>(write_response.result)) {
+        case sr_stored:
+            response->suppressed = is_quiet(request->opcode);
+            break;
+        case sr_didnt_add:
+            set_error(bin_status_key_not_found, "Not found", response);
+            break;
+        case sr_didnt_replace:
+            set_error(bin_status_key_exists, "Data exists for key", response);
+            break;
+        case sr_too_large:
+            set_error(bin_status_value_too_large, "Too large", response);
+            break;
+        default: unreachable();
+        }
+    }
+
+    void perform_append_prepend(bin_request_t *request, bin_response_t *response) {
+        if (!check_format(request, 0, true, response)) {
+            return;
+        }
+        stats->pm_storage_key_size.record(request->key.size());
+        stats->pm_storage_value_size.record(request->value->size());
+        block_pm_duration set_timer(&stats->pm_cmd_set);
+
+        const bool append = request->opcode == bin_opcode_append
+            || request->opcode == bin_opcode_appendq;
+        append_prepend_mutation_t append_prepend_mutation(
+            append ? append_prepend_APPEND : append_prepend_PREPEND,
+            request->key, request->value);
+        memcached_protocol_t::write_response_t write_response;
+        if (!run_write(memcached_protocol_t::write_t(append_prepend_mutation, generate_cas(), time(NULL)),
+                   request->token, &write_response, response)) {
+            return;
+        }
+
+        switch (boost::get<append_prepend_result_t>(write_response.result)) {
+        case apr_success:
+            response->suppressed = is_quiet(request->opcode);
+            break;
+        case apr_not_found:
+            set_error(bin_status_item_not_stored, "Not stored", response);
+            break;
+        case apr_too_large:
+            set_error(bin_status_value_too_large, "Too large", response);
+            break;
+        default: unreachable();
+        }
+    }
+
+    void perform_delete(bin_request_t *request, bin_response_t *response) {
+        if (!check_format(request, 0, false, response)) {
+            return;
+        }
+        stats->pm_delete_key_size.record(request->key.size());
+        block_pm_duration set_timer(&stats->pm_cmd_set);
+
+        delete_mutation_t delete_mutation(request->key, false);
+        memcached_protocol_t::write_response_t write_response;
+        if (!run_write(memcached_protocol_t::write_t(delete_mutation, INVALID_CAS, time(NULL)),
+                   request->token, &write_response, response)) {
+            return;
+        }
+
+        switch (boost::get<delete_result_t>(write_response.result)) {
+        case dr_deleted:
+            response->suppressed = is_quiet(request->opcode);
+            break;
+        case dr_not_found:
+            set_error(bin_status_key_not_found, "Not found", response);
+            break;
+        default: unreachable();
+        }
+    }
+
+    void perform_incr_decr(bin_request_t *request, bin_response_t *response) {
+        if (!check_format(request, 20, false, response)) {
+            return;
+        }
+        block_pm_duration set_timer(&stats->pm_cmd_set);
+
+        const bool incr = request->opcode == bin_opcode_increment
+            || request->opcode == bin_opcode_incrementq;
+        const uint64_t amount = decode_be64(request->extras.data());
+        const uint64_t initial = decode_be64(request->extras.data() + 8);
+        const exptime_t raw_exptime = decode_be32(request->extras.data() + 16);
+
+        incr_decr_mutation_t incr_decr_mutation(incr ? incr_decr_INCR : incr_decr_DECR,
+                                                request->key, amount);
+        memcached_protocol_t::write_response_t write_response;
+        if (!run_write(memcached_protocol_t::write_t(incr_decr_mutation, generate_cas(), time(NULL)),
+                   request->token, &write_response, response)) {
+            return;
+        }
+        incr_decr_result_t res = boost::get<incr_decr_result_t>(write_response.result);
+
+        if (res.res == incr_decr_result_t::idr_not_found && raw_exptime != BIN_NO_INITIAL_VALUE) {
+            /* The binary protocol creates missing counters with the initial value.
+            Values are stored as decimal strings, which is what incr and decr
+            work on. */
+            const std::string initial_str = strprintf("%" PRIu64, initial);
+            counted_t<data_buffer_t> data = data_buffer_t::create(initial_str.size());
+            memcpy(data->buf(), initial_str.data(), initial_str.size());
+            sarc_mutation_t sarc_mutation(request->key, data, 0, absolute_exptime(raw_exptime),
+                                          add_policy_yes, replace_policy_no, NO_CAS_SUPPLIED);
+            memcached_protocol_t::write_response_t add_response;
+            /* Every write gets its own order token, checked in after the writes
+            before it have been dispatched. */
+            if (!run_write(memcached_protocol_t::write_t(sarc_mutation, generate_cas(), time(NULL)),
+                       order_source.check_in("handle_binary_memcache+incr_decr_add"),
+                       &add_response, response)) {
+                return;
+            }
+            switch (boost::get<set_result_t>(add_response.result)) {
+            case sr_stored:
+                res = incr_decr_result_t(incr_decr_result_t::idr_success, initial);
+                break;
+            case sr_didnt_replace:
+                /* Somebody else created it in the meantime. */
+                if (!run_write(memcached_protocol_t::write_t(incr_decr_mutation, generate_cas(), time(NULL)),
+                           order_source.check_in("handle_binary_memcache+incr_decr_retry"),
+                           &write_response, response)) {
+                    return;
+                }
+                res = boost::get<incr_decr_result_t>(write_response.result);
+                break;
+            case sr_didnt_add:
+            case sr_too_large:
+            default: unreachable();
+            }
+        }
+
+        switch (res.res) {
+        case incr_decr_result_t::idr_success: {
+            uint8_t counter[8];
+            encode_be64(res.new_value, counter);
+            response->body.assign(reinterpret_cast<const char *>(counter), sizeof(counter));
+            response->suppressed = is_quiet(request->opcode);
+        } break;
+        case incr_decr_result_t::idr_not_found:
+            set_error(bin_status_key_not_found, "Not found", response);
+            break;
+        case incr_decr_result_t::idr_not_numeric:
+            set_error(bin_status_non_numeric_value,
+                      "Cannot increment or decrement non-numeric value", response);
+            break;
+        default: unreachable();
+        }
+    }
+
+    void write_header(const bin_request_t &request, uint16_t status, uint8_t extras_size,
+                      uint16_t key_size, uint32_t body_size, cas_t cas) {
+        uint8_t header[BIN_HEADER_SIZE];
+        header[0] = BIN_RESPONSE_MAGIC;
+        header[1] = request.opcode;
+        encode_be16(key_size, header + 2);
+        header[4] = extras_size;
+        header[5] = 0;
+        encode_be16(status, header + 6);
+        encode_be32(body_size, header + 8);
+        encode_be32(request.opaque, header + 12);
+        encode_be64(cas, header + 16);
+        write(header, BIN_HEADER_SIZE);
+    }
+
+    void write_response(const bin_request_t &request, const bin_response_t &response) {
+        for (size_t i = 0; i < response.stats.size(); ++i) {
+            const std::string &key = response.stats[i].first;
+            const std::string &value = response.stats[i].second;
+            write_header(request, bin_status_no_error, 0, key.size(),
+                         key.size() + value.size(), 0);
+            write(key.data(), key.size());
+            write(value.data(), value.size());
+        }
+
+        const uint16_t key_size = response.with_key ? request.key.size() : 0;
+        const uint32_t value_size = response.value.has()
+            ? response.value->size() : response.body.size();
+        write_header(request, response.status, response.extras_size, key_size,
+                     response.extras_size + key_size + value_size, response.cas);
+        write(response.extras, response.extras_size);
+        write(request.key.contents(), key_size);
+        if (response.value.has()) {
+            if (response.value->size() < MAX_BUFFERED_GET_SIZE) {
+                write(response.value->buf(), response.value->size());
+            } else {
+                write_unbuffered(response.value->buf(), response.value->size());
+            }
+        } else {
+            write(response.body.data(), response.body.size());
+        }
+    }
+
+    cas_t generate_cas() {
+        // Like `txt_memcached_handler_t::generate_cas()`.
+        return random();
+    }
+
+    void read(void *buf, size_t nbytes) THROWS_ONLY(memcached_interface_t::no_more_data_exc_t) {
+        try {
+            interface->read(buf, nbytes, interruptor);
+        } catch (const interrupted_exc_t &) {
+            throw memcached_interface_t::no_more_data_exc_t();
+        }
+    }
+
+    void write(const void *buffer, size_t bytes) THROWS_NOTHING {
+        if (bytes == 0) {
+            return;
+        }
+        try {
+            interface->write(static_cast<const char *>(buffer), bytes, interruptor);
+        } catch (const interrupted_exc_t &) {
+            /* ignore */
+        }
+    }
+
+    void write_unbuffered(const char *buffer, size_t bytes) THROWS_NOTHING {
+        try {
+            interface->write_unbuffered(buffer, bytes, interruptor);
+        } catch (const interrupted_exc_t &) {
+            /* ignore */
+        }
+    }
+
+    void flush_buffer() THROWS_NOTHING {
+        try {
+            interface->flush_buffer(interruptor);
+        } catch (const interrupted_exc_t &) {
+            /* ignore */
+        }
+    }
+
+    memcached_interface_t *const interface;
+    namespace_interface_t<memcached_protocol_t> *const nsi;
+    memcached_stats_t *const stats;
+    signal_t *const interruptor;
+
+    /* Like `pipeliner_t` in `memcached/parser.cc`, but since a request is read
+    whole before it's spawned, there's no argument parsing to serialize. */
+    coro_fifo_t fifo;
+    mutex_t write_mutex;
+    static_semaphore_t requests_out_sem;
+
+    order_source_t order_source;
+
+    DISABLE_COPYING(bin_memcached_handler_t);
+};
+
+void handle_binary_memcache(memcached_interface_t *interface,
+                            namespace_interface_t<memcached_protocol_t> *nsi,
+                            int max_concurrent_queries_per_connection,
+                            memcached_stats_t *stats,
+                            signal_t *interruptor) {
+    logDBG("Opened binary memcached stream: %p", coro_t::self());
+    bin_memcached_handler_t handler(interface, nsi, max_concurrent_queries_per_connection,
+                                    stats, interruptor);
+    handler.serve();
+    logDBG("Closed binary memcached stream: %p", coro_t::self());
+}
@@ -0,0 +1,24 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#ifndef MEMCACHED_BINARY_PARSER_HPP_
+#define MEMCACHED_BINARY_PARSER_HPP_
+
+#include "memcached/parser.hpp"
+
+/* Every request of the binary protocol starts with this byte.  No command of the
+text protocol does, so `handle_memcache()` looks at the first byte a client sends
+to tell which of the two protocols it speaks. */
+#define MEMCACHED_BINARY_REQUEST_MAGIC 0x80
+
+/* `handle_binary_memcache()` is `handle_memcache()` for clients that speak the
+binary protocol.  It serves the same queries (see `memcached/queries.hpp`), and
+understands the quiet opcodes, which only answer when something goes wrong, so
+clients can pipeline a multi-get as a run of GETKQs followed by a NOOP.  Values
+are written to the client straight out of the `data_buffer_t`s the queries return
+them in, and values to store are read straight into the ones the queries take. */
+void handle_binary_memcache(memcached_interface_t *interface,
+                            namespace_interface_t<memcached_protocol_t> *nsi,
+                            int max_concurrent_queries_per_connection,
+                            memcached_stats_t *stats,
+                            signal_t *interruptor);
+
+#endif /* MEMCACHED_BINARY_PARSER_HPP_ */
@@ -45,16 +45,21 @@ public:
         //tests to work.
     }
 
+    void on_range_done(const key_range_t &range, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) {
+        rassert(kr_.is_superset(range));
+        cb_->on_range_done(range, interruptor);
+    }
+
     backfill_callback_t *cb_;
     key_range_t kr_;
 };
 
 void memcached_backfill(btree_slice_t *slice, const key_range_t& key_range, repli_timestamp_t since_when, backfill_callback_t *callback,
-                    transaction_t *txn, superblock_t *superblock, buf_lock_t *sindex_block, parallel_traversal_progress_t *p,
+                    transaction_t *txn, superblock_t *superblock, buf_lock_t *sindex_block, traversal_progress_combiner_t *progress,
                     signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) {
     agnostic_memcached_backfill_callback_t agnostic_cb(callback, key_range);
     value_sizer_t<memcached_value_t> sizer(slice->cache()->get_block_size());
-    do_agnostic_btree_backfill(&sizer, slice, key_range, since_when, &agnostic_cb, txn, superblock, sindex_block, p, interruptor);
+    do_agnostic_btree_backfill(&sizer, slice, key_range, since_when, &agnostic_cb, txn, superblock, sindex_block, progress, interruptor);
 }
 
 
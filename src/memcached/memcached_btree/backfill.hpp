@@ -8,7 +8,7 @@
 #include "memcached/queries.hpp"
 
 class btree_slice_t;
-class parallel_traversal_progress_t;
+class traversal_progress_combiner_t;
 class printf_buffer_t;
 class superblock_t;
 
@@ -45,6 +45,8 @@ public:
     virtual void on_delete_range(const key_range_t &range, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) = 0;
     virtual void on_deletion(const btree_key_t *key, repli_timestamp_t recency, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) = 0;
     virtual void on_keyvalue(const backfill_atom_t& atom, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) = 0;
+    /* Everything in `range` has been passed to the other methods. */
+    virtual void on_range_done(const key_range_t &range, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) = 0;
 protected:
     virtual ~backfill_callback_t() { }
 };
@@ -56,7 +58,7 @@ void memcached_backfill(btree_slice_t *slice,
                         transaction_t *txn,
                         superblock_t *superblock,
                         buf_lock_t *sindex_block,
-                        parallel_traversal_progress_t *p,
+                        traversal_progress_combiner_t *progress,
                         signal_t *interruptor) THROWS_ONLY(interrupted_exc_t);
 
 #endif /* MEMCACHED_MEMCACHED_BTREE_BACKFILL_HPP_ */
@@ -1,5 +1,8 @@
 // Copyright 2010-2012 RethinkDB, all rights reserved.
 #include "memcached/memcached_btree/delete.hpp"
+
+#include "btree/operations.hpp"
+#include "btree/superblock.hpp"
 #include "memcached/memcached_btree/modify_oper.hpp"
 #include "repli_timestamp.hpp"
 
@@ -40,3 +43,39 @@ delete_result_t memcached_delete(const store_key_t &key, bool dont_put_in_delete
     return oper.result;
 }
 
+int64_t memcached_expire(const std::vector<store_key_t> &keys, btree_slice_t *slice, exptime_t effective_time,
+    transaction_t *txn, superblock_t *superblock) {
+
+    if (keys.empty()) {
+        superblock->release();
+        return 0;
+    }
+
+    int64_t bytes_erased = 0;
+    refcount_superblock_t refcount_superblock(superblock, keys.size());
+    for (std::vector<store_key_t>::const_iterator it = keys.begin(); it != keys.end(); ++it) {
+        keyvalue_location_t<memcached_value_t> kv_location;
+        find_keyvalue_location_for_write(txn, &refcount_superblock, it->btree_key(),
+                &kv_location, &slice->root_eviction_priority, &slice->stats, NULL);
+
+        // The value may have been overwritten since the key was found expired.
+        if (!kv_location.value.has() || !kv_location.value->expired(effective_time)) {
+            continue;
+        }
+
+        bytes_erased += it->size() + kv_location.value->value_size();
+        {
+            blob_t b(txn->get_cache()->get_block_size(),
+                     kv_location.value->value_ref(), blob::btree_maxreflen);
+            b.clear(txn);
+        }
+        kv_location.value.reset();
+
+        // Like the erasure of an expired value in run_memcached_modify_oper(), this
+        // needs no timestamp: it doesn't leave a deletion entry to be backfilled.
+        null_key_modification_callback_t<memcached_value_t> null_cb;
+        apply_keyvalue_change(txn, &kv_location, it->btree_key(), repli_timestamp_t::invalid,
+                              true, &null_cb, &slice->root_eviction_priority);
+    }
+    return bytes_erased;
+}
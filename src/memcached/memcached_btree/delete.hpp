@@ -2,6 +2,8 @@
 #ifndef MEMCACHED_MEMCACHED_BTREE_DELETE_HPP_
 #define MEMCACHED_MEMCACHED_BTREE_DELETE_HPP_
 
+#include <vector>
+
 #include "btree/node.hpp"
 #include "btree/slice.hpp"
 #include "memcached/queries.hpp"
@@ -10,4 +12,9 @@ class superblock_t;
 
 delete_result_t memcached_delete(const store_key_t &key, bool dont_put_in_delete_queue, btree_slice_t *slice, exptime_t effective_time, repli_timestamp_t timestamp, transaction_t *txn, superblock_t *superblock);
 
+/* Erases those of `keys` whose values have expired by `effective_time`, just like a
+write to them would, and releases `superblock`.  `keys` must be sorted.  Returns how
+many bytes of keys and values were erased. */
+int64_t memcached_expire(const std::vector<store_key_t> &keys, btree_slice_t *slice, exptime_t effective_time, transaction_t *txn, superblock_t *superblock);
+
 #endif // MEMCACHED_MEMCACHED_BTREE_DELETE_HPP_
@@ -1,9 +1,12 @@
 // Copyright 2010-2012 RethinkDB, all rights reserved.
 #include "memcached/memcached_btree/get.hpp"
 
+#include <algorithm>
+
 #include "btree/internal_node.hpp"
 #include "btree/leaf_node.hpp"
 #include "btree/operations.hpp"
+#include "btree/superblock.hpp"
 #include "memcached/memcached_btree/btree_data_provider.hpp"
 #include "memcached/memcached_btree/node.hpp"
 #include "memcached/memcached_btree/value.hpp"
@@ -28,3 +31,23 @@ get_result_t memcached_get(const store_key_t &store_key, btree_slice_t *slice, e
     return get_result_t(dp, value->mcflags(), 0);
 }
 
+
+void memcached_get_multi(const std::vector<store_key_t> &keys, btree_slice_t *slice, exptime_t effective_time, transaction_t *txn, superblock_t *superblock, std::map<store_key_t, get_result_t> *values_out) {
+    if (keys.empty()) {
+        superblock->release();
+        return;
+    }
+
+    // Every lookup releases the superblock once it has the root, so it stays
+    // acquired until the last one.  Going through the keys in order keeps the
+    // nodes that neighbouring keys share hot.
+    std::vector<store_key_t> sorted(keys);
+    std::sort(sorted.begin(), sorted.end());
+    refcount_superblock_t refcount_superblock(superblock, sorted.size());
+    for (std::vector<store_key_t>::const_iterator it = sorted.begin(); it != sorted.end(); ++it) {
+        get_result_t res = memcached_get(*it, slice, effective_time, txn, &refcount_superblock);
+        if (res.value.has()) {
+            values_out->insert(std::make_pair(*it, res));
+        }
+    }
+}
@@ -10,4 +10,8 @@ class superblock_t;
 
 get_result_t memcached_get(const store_key_t &key, btree_slice_t *slice, exptime_t effective_time, transaction_t *txn, superblock_t *superblock);
 
+/* Looks up all of `keys` under the same `superblock`, and puts the ones it finds in
+`values_out`. */
+void memcached_get_multi(const std::vector<store_key_t> &keys, btree_slice_t *slice, exptime_t effective_time, transaction_t *txn, superblock_t *superblock, std::map<store_key_t, get_result_t> *values_out);
+
 #endif // MEMCACHED_MEMCACHED_BTREE_GET_HPP_
@@ -30,6 +30,7 @@
 #include "logger.hpp"
 #include "arch/os_signal.hpp"
 #include "perfmon/collect.hpp"
+#include "memcached/binary_parser.hpp"
 #include "memcached/stats.hpp"
 
 static const char *crlf = "\r\n";
@@ -301,6 +302,40 @@ void do_one_get(txt_memcached_handler_t *rh, bool with_cas, get_t *gets, int i,
     }
 }
 
+/* Reads all of `gets` at once.  The namespace interface splits the read by shard,
+so this takes one read per shard that has any of the keys. */
+void do_multi_get(txt_memcached_handler_t *rh, std::vector<get_t> *gets, order_token_t token) {
+    std::string error_message;
+    try {
+        multi_get_query_t multi_get_query;
+        multi_get_query.keys.reserve(gets->size());
+        for (size_t i = 0; i < gets->size(); ++i) {
+            multi_get_query.keys.push_back((*gets)[i].key);
+        }
+        memcached_protocol_t::read_t read(multi_get_query, time(NULL));
+        memcached_protocol_t::read_response_t response;
+        rh->nsi->read(read, &response, token, rh->interruptor);
+        const multi_get_result_t &res = boost::get<multi_get_result_t>(response.result);
+        for (size_t i = 0; i < gets->size(); ++i) {
+            std::map<store_key_t, get_result_t>::const_iterator it = res.values.find((*gets)[i].key);
+            if (it != res.values.end()) {
+                (*gets)[i].res = it->second;
+            }
+            (*gets)[i].ok = true;
+        }
+    } catch (const cannot_perform_query_exc_t &e) {
+        error_message = e.what();
+    } catch (const interrupted_exc_t &) {
+        /* do nothing */
+    }
+    if (!error_message.empty()) {
+        for (size_t i = 0; i < gets->size(); ++i) {
+            (*gets)[i].error_message = error_message;
+            (*gets)[i].ok = false;
+        }
+    }
+}
+
 void do_get(txt_memcached_handler_t *rh, pipeliner_t *pipeliner, bool with_cas, int argc, char **argv, order_token_t token) {
     // We should already be spawned within a coroutine.
     pipeliner_acq_t pipeliner_acq(pipeliner);
@@ -336,8 +371,13 @@ void do_get(txt_memcached_handler_t *rh, pipeliner_t *pipeliner, bool with_cas,
 
     block_pm_duration get_timer(&rh->stats->pm_cmd_get);
 
-    /* Now that we're sure they're all valid, send off the requests */
-    pmap(gets.size(), boost::bind(&do_one_get, rh, with_cas, gets.data(), _1, token));
+    /* Now that we're sure they're all valid, send off the requests.  "gets" has
+    to allocate a CAS for each key, which is a write, so only "get" can batch. */
+    if (!with_cas && gets.size() > 1) {
+        do_multi_get(rh, &gets, token);
+    } else {
+        pmap(gets.size(), boost::bind(&do_one_get, rh, with_cas, gets.data(), _1, token));
+    }
 
     if (rh->interruptor->is_pulsed()) {
         pipeliner_acq.begin_write();
@@ -1107,6 +1147,22 @@ void handle_memcache(memcached_interface_t *interface,
         int max_concurrent_queries_per_connection,
         memcached_stats_t *stats,
         signal_t *interruptor) {
+    /* Binary clients start with a request header, and text ones with a command. */
+    bool binary;
+    try {
+        binary = static_cast<uint8_t>(interface->peek_byte(interruptor))
+            == MEMCACHED_BINARY_REQUEST_MAGIC;
+    } catch (const memcached_interface_t::no_more_data_exc_t &) {
+        return;
+    } catch (const interrupted_exc_t &) {
+        return;
+    }
+    if (binary) {
+        handle_binary_memcache(interface, nsi, max_concurrent_queries_per_connection,
+                               stats, interruptor);
+        return;
+    }
+
     logDBG("Opened memcached stream: %p", coro_t::self());
 
     /* This object just exists to group everything together so we don't have to pass a lot of
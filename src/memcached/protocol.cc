@@ -1,10 +1,15 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "memcached/protocol.hpp"
 
+#include <time.h>
+
 #include "errors.hpp"
 #include <boost/variant.hpp>
 #include <boost/bind.hpp>
 
+#include "arch/runtime/coroutines.hpp"
+#include "arch/timing.hpp"
+#include "btree/depth_first_traversal.hpp"
 #include "btree/operations.hpp"
 #include "btree/parallel_traversal.hpp"
 #include "btree/slice.hpp"
@@ -24,6 +29,7 @@
 #include "memcached/memcached_btree/incr_decr.hpp"
 #include "memcached/memcached_btree/rget.hpp"
 #include "memcached/memcached_btree/set.hpp"
+#include "memcached/memcached_btree/value.hpp"
 #include "memcached/queries.hpp"
 #include "stl_utils.hpp"
 #include "serializer/config.hpp"
@@ -77,9 +83,11 @@ archive_result_t deserialize(read_stream_t *s, counted_t<data_buffer_t> *buf) {
 }
 
 RDB_IMPL_SERIALIZABLE_1(get_query_t, key);
+RDB_IMPL_SERIALIZABLE_1(multi_get_query_t, keys);
 RDB_IMPL_SERIALIZABLE_2(rget_query_t, region, maximum);
 RDB_IMPL_SERIALIZABLE_3(distribution_get_query_t, max_depth, result_limit, region);
 RDB_IMPL_SERIALIZABLE_3(get_result_t, value, flags, cas);
+RDB_IMPL_SERIALIZABLE_1(multi_get_result_t, values);
 RDB_IMPL_SERIALIZABLE_3(key_with_data_buffer_t, key, mcflags, value_provider);
 RDB_IMPL_SERIALIZABLE_2(rget_result_t, pairs, truncated);
 RDB_IMPL_SERIALIZABLE_2(distribution_result_t, region, key_counts);
@@ -107,6 +115,29 @@ region_t monokey_region(const store_key_t &k) {
     return region_t(h, h + 1, key_range_t(key_range_t::closed, k, key_range_t::closed, k));
 }
 
+// The smallest region that has all of `keys`.
+region_t multikey_region(const std::vector<store_key_t> &keys) {
+    guarantee(!keys.empty());
+
+    store_key_t min_key = store_key_t::max();
+    store_key_t max_key = store_key_t::min();
+    uint64_t min_hash_value = HASH_REGION_HASH_SIZE - 1;
+    uint64_t max_hash_value = 0;
+    for (std::vector<store_key_t>::const_iterator it = keys.begin(); it != keys.end(); ++it) {
+        if (*it < min_key) {
+            min_key = *it;
+        }
+        if (*it > max_key) {
+            max_key = *it;
+        }
+        const uint64_t h = hash_region_hasher(it->contents(), it->size());
+        min_hash_value = std::min(min_hash_value, h);
+        max_hash_value = std::max(max_hash_value, h);
+    }
+    return region_t(min_hash_value, max_hash_value + 1,
+                    key_range_t(key_range_t::closed, min_key, key_range_t::closed, max_key));
+}
+
 /* `read_t::get_region()` */
 
 /* Wrap all our local types in anonymous namespaces so the linker doesn't
@@ -117,6 +148,9 @@ struct read_get_region_visitor_t : public boost::static_visitor<region_t> {
     region_t operator()(get_query_t get) {
         return monokey_region(get.key);
     }
+    region_t operator()(const multi_get_query_t &multi_get) {
+        return multikey_region(multi_get.keys);
+    }
     region_t operator()(rget_query_t rget) {
         return rget.region;
     }
@@ -149,6 +183,23 @@ struct read_shard_visitor_t : public boost::static_visitor<bool> {
         return ret;
     }
 
+    bool operator()(const multi_get_query_t &multi_get) const {
+        multi_get_query_t tmp;
+        for (std::vector<store_key_t>::const_iterator it = multi_get.keys.begin();
+             it != multi_get.keys.end();
+             ++it) {
+            if (region_contains_key(*region, *it)) {
+                tmp.keys.push_back(*it);
+            }
+        }
+        if (!tmp.keys.empty()) {
+            *read_out = read_t(tmp, effective_time);
+            return true;
+        } else {
+            return false;
+        }
+    }
+
     template <class T>
     bool rangey_query(const T &arg) const {
         const hash_region_t<key_range_t> intersection
@@ -237,6 +288,15 @@ struct read_unshard_visitor_t : public boost::static_visitor<read_response_t> {
         guarantee(count == 1);
         return read_response_t(boost::get<get_result_t>(bits[0].result));
     }
+    read_response_t operator()(UNUSED const multi_get_query_t &multi_get) {
+        multi_get_result_t result;
+        for (size_t i = 0; i < count; ++i) {
+            const multi_get_result_t *bit = boost::get<multi_get_result_t>(&bits[i].result);
+            guarantee(bit != NULL, "Bad boost::get\n");
+            result.values.insert(bit->values.begin(), bit->values.end());
+        }
+        return read_response_t(result);
+    }
     read_response_t operator()(rget_query_t rget) {
         // TODO: do this without dynamic memory?
         std::vector<key_with_data_buffer_t> pairs;
@@ -416,8 +476,13 @@ store_t::store_t(serializer_t *serializer,
     : btree_store_t<memcached_protocol_t>(
             serializer, perfmon_name, cache_size,
             create, parent_perfmon_collection, ctx, io,
-            base_path)
-{ }
+            base_path),
+      pm_expired_bytes(secs_to_ticks(1)),
+      pm_expired_bytes_membership(&perfmon_collection, &pm_expired_bytes, "bytes_expired")
+{
+    coro_t::spawn_sometime(boost::bind(&store_t::sweep_expired_values, this,
+                                       auto_drainer_t::lock_t(&sweep_drainer)));
+}
 
 store_t::~store_t() {
     assert_thread();
@@ -425,12 +490,113 @@ store_t::~store_t() {
 
 namespace {
 
+/* Collects the keys of the expired values among the first `max_keys` key/value
+pairs of a traversal. */
+class expired_key_collector_t : public depth_first_traversal_callback_t {
+public:
+    expired_key_collector_t(exptime_t _effective_time, size_t _max_keys)
+        : effective_time(_effective_time), max_keys(_max_keys), keys_seen(0) { }
+
+    bool handle_pair(scoped_key_value_t &&keyvalue) {
+        last_key.assign(keyvalue.key());
+        const memcached_value_t *value
+            = static_cast<const memcached_value_t *>(keyvalue.value());
+        if (value->expired(effective_time)) {
+            expired_keys.push_back(last_key);
+        }
+        ++keys_seen;
+        return keys_seen < max_keys;
+    }
+
+    const exptime_t effective_time;
+    const size_t max_keys;
+    size_t keys_seen;
+    store_key_t last_key;
+    std::vector<store_key_t> expired_keys;
+
+private:
+    DISABLE_COPYING(expired_key_collector_t);
+};
+
+}  // namespace
+
+void store_t::sweep_expired_values(auto_drainer_t::lock_t keepalive) {
+    key_range_t cursor = key_range_t::universe();
+    bool finished_pass = true;
+    try {
+        for (;;) {
+            nap(finished_pass
+                ? MEMCACHED_EXPIRY_SWEEP_PASS_INTERVAL_MS
+                : MEMCACHED_EXPIRY_SWEEP_BATCH_INTERVAL_MS,
+                keepalive.get_drain_signal());
+            finished_pass = sweep_expired_batch(&cursor, keepalive.get_drain_signal());
+        }
+    } catch (const interrupted_exc_t &) {
+        // The store is being destroyed.
+    }
+}
+
+bool store_t::sweep_expired_batch(key_range_t *cursor, signal_t *interruptor)
+    THROWS_ONLY(interrupted_exc_t) {
+    assert_thread();
+
+    const exptime_t effective_time = time(NULL);
+    expired_key_collector_t collector(effective_time, MEMCACHED_EXPIRY_SWEEP_BATCH_SIZE);
+    bool reached_end;
+    {
+        // A snapshot, so that the traversal doesn't hold up writes to the leaves
+        // it has yet to get to.
+        object_buffer_t<fifo_enforcer_sink_t::exit_read_t> token;
+        new_read_token(&token);
+        scoped_ptr_t<transaction_t> txn;
+        scoped_ptr_t<real_superblock_t> superblock;
+        acquire_superblock_for_read(rwi_read, &token, &txn, &superblock, interruptor, true);
+        reached_end = btree_depth_first_traversal(btree.get(), txn.get(), superblock.get(),
+                                                  *cursor, &collector, FORWARD);
+    }
+
+    if (!collector.expired_keys.empty()) {
+        write_token_pair_t token_pair;
+        new_write_token_pair(&token_pair);
+        token_pair.sindex_write_token.reset();
+
+        scoped_ptr_t<transaction_t> txn;
+        scoped_ptr_t<real_superblock_t> superblock;
+        // Erasures of expired values, like the ones reads and writes do, don't
+        // get a timestamp, since there's nothing to backfill about them: every
+        // replica sweeps its own copy of the data.  The expected change count is
+        // as rough as reset_data()'s, for the same reason.
+        acquire_superblock_for_write(repli_timestamp_t::invalid, 2, WRITE_DURABILITY_SOFT,
+                                     &token_pair, &txn, &superblock, interruptor);
+        const int64_t bytes_expired = memcached_expire(collector.expired_keys, btree.get(),
+                                                       effective_time, txn.get(), superblock.get());
+        pm_expired_bytes.record(bytes_expired);
+    }
+
+    if (reached_end) {
+        *cursor = key_range_t::universe();
+    } else {
+        *cursor = key_range_t(key_range_t::open, collector.last_key,
+                              key_range_t::none, store_key_t());
+    }
+    return reached_end;
+}
+
+namespace {
+
 struct read_visitor_t : public boost::static_visitor<read_response_t> {
     read_response_t operator()(const get_query_t& get) {
         return read_response_t(
             memcached_get(get.key, btree, effective_time, txn, superblock));
     }
 
+    read_response_t operator()(const multi_get_query_t& multi_get) {
+        multi_get_result_t result;
+        memcached_get_multi(multi_get.keys, btree, effective_time, txn, superblock,
+                            &result.values);
+        return read_response_t(result);
+    }
+
     read_response_t operator()(const rget_query_t& rget) {
         return read_response_t(
             memcached_rget_slice(btree, rget.region.inner, rget.maximum, effective_time, txn, superblock));
@@ -558,8 +724,9 @@ void store_t::protocol_write(const write_t &write,
 class memcached_backfill_callback_t : public backfill_callback_t {
     typedef backfill_chunk_t chunk_t;
 public:
-    explicit memcached_backfill_callback_t(chunk_fun_callback_t<memcached_protocol_t> *chunk_fun_cb)
-        : chunk_fun_cb_(chunk_fun_cb) { }
+    memcached_backfill_callback_t(chunk_fun_callback_t<memcached_protocol_t> *chunk_fun_cb,
+                                  const region_t &region)
+        : chunk_fun_cb_(chunk_fun_cb), region_(region) { }
 
     void on_delete_range(const key_range_t &range, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) {
         chunk_fun_cb_->send_chunk(chunk_t::delete_range(region_t(range)), interruptor);
@@ -572,6 +739,10 @@ public:
     void on_keyvalue(const backfill_atom_t& atom, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) {
         chunk_fun_cb_->send_chunk(chunk_t::set_key(atom), interruptor);
     }
+
+    void on_range_done(const key_range_t &range, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) {
+        chunk_fun_cb_->send_checkpoint(region_intersection(region_, region_t(range)), interruptor);
+    }
     ~memcached_backfill_callback_t() { }
 
 protected:
@@ -581,19 +752,18 @@ protected:
 
 private:
     chunk_fun_callback_t<memcached_protocol_t> *chunk_fun_cb_;
+    region_t region_;
 
     DISABLE_COPYING(memcached_backfill_callback_t);
 };
 
 static void call_memcached_backfill(int i, btree_slice_t *btree, const std::vector<std::pair<region_t, state_timestamp_t> > &regions,
-        memcached_backfill_callback_t *callback, transaction_t *txn, superblock_t *superblock, buf_lock_t *sindex_block, memcached_protocol_t::backfill_progress_t *progress,
+        chunk_fun_callback_t<memcached_protocol_t> *chunk_fun_cb, transaction_t *txn, superblock_t *superblock, buf_lock_t *sindex_block, memcached_protocol_t::backfill_progress_t *progress,
         signal_t *interruptor) {
-    parallel_traversal_progress_t *p = new parallel_traversal_progress_t;
-    scoped_ptr_t<traversal_progress_t> p_owner(p);
-    progress->add_constituent(&p_owner);
     repli_timestamp_t timestamp = regions[i].second.to_repli_timestamp();
+    memcached_backfill_callback_t callback(chunk_fun_cb, regions[i].first);
     try {
-        memcached_backfill(btree, regions[i].first.inner, timestamp, callback, txn, superblock, sindex_block, p, interruptor);
+        memcached_backfill(btree, regions[i].first.inner, timestamp, &callback, txn, superblock, sindex_block, progress, interruptor);
     } catch (const interrupted_exc_t &) {
         /* do nothing; `protocol_send_backfill()` will notice and deal with it.
         */
@@ -613,14 +783,12 @@ void store_t::protocol_send_backfill(const region_map_t<memcached_protocol_t, st
     std::vector<std::pair<region_t, state_timestamp_t> > regions(start_point.begin(), start_point.end());
 
     if (regions.size() > 0) {
-        memcached_backfill_callback_t callback(chunk_fun_cb);
-
         // pmapping by regions.size() is now the arguably wrong thing to do,
         // because adjacent regions often have the same value. On the other hand
         // it's harmless, because caching is basically perfect.
         refcount_superblock_t refcount_wrapper(superblock, regions.size());
         pmap(regions.size(), boost::bind(&call_memcached_backfill, _1,
-                                         btree, regions, &callback, txn, &refcount_wrapper, sindex_block, progress, interruptor));
+                                         btree, regions, chunk_fun_cb, txn, &refcount_wrapper, sindex_block, progress, interruptor));
 
         /* if interruptor was pulsed in `call_memcached_backfill()`, it returned
         normally anyway. So now we have to check manually. */
@@ -32,9 +32,11 @@ write_message_t &operator<<(write_message_t &msg, const rget_result_t &iter);
 archive_result_t deserialize(read_stream_t *s, rget_result_t *iter);
 
 RDB_DECLARE_SERIALIZABLE(get_query_t);
+RDB_DECLARE_SERIALIZABLE(multi_get_query_t);
 RDB_DECLARE_SERIALIZABLE(rget_query_t);
 RDB_DECLARE_SERIALIZABLE(distribution_get_query_t);
 RDB_DECLARE_SERIALIZABLE(get_result_t);
+RDB_DECLARE_SERIALIZABLE(multi_get_result_t);
 RDB_DECLARE_SERIALIZABLE(key_with_data_buffer_t);
 RDB_DECLARE_SERIALIZABLE(rget_result_t);
 RDB_DECLARE_SERIALIZABLE(distribution_result_t);
@@ -58,7 +60,8 @@ public:
     struct context_t { };
 
     struct read_response_t {
-        typedef boost::variant<get_result_t, rget_result_t, distribution_result_t> result_t;
+        typedef boost::variant<get_result_t, rget_result_t, distribution_result_t,
+                               multi_get_result_t> result_t;
 
         read_response_t() { }
         read_response_t(const read_response_t &r) : result(r.result) { }
@@ -70,7 +73,8 @@ public:
     struct read_t {
         typedef boost::variant<get_query_t,
                                rget_query_t,
-                               distribution_get_query_t> query_t;
+                               distribution_get_query_t,
+                               multi_get_query_t> query_t;
 
         region_t get_region() const THROWS_NOTHING;
         // Returns true if the read had any applicability to the region, and a
@@ -91,6 +95,12 @@ public:
         
         bool all_read() const { return false; }
 
+        bool coalescing_key(UNUSED store_key_t *key_out) const { return false; }
+
+        // Never profiled, see rdb_protocol_t::read_t::profile_master().
+        void profile_master(ticks_t, ticks_t, read_response_t *) const { }
+        void profile_round_trip(ticks_t, read_response_t *) const { }
+
         query_t query;
         exptime_t effective_time;
     };
@@ -118,6 +128,19 @@ public:
                    write_t *write_out) const THROWS_NOTHING;
         void unshard(const write_response_t *responses, size_t count, write_response_t *response, context_t *ctx, signal_t *) const THROWS_NOTHING;
 
+        // Never combined, see master_t.
+        bool is_combinable() const { return false; }
+        bool can_combine_with(const write_t &) const { unreachable(); }
+        static write_t combine(const std::vector<const write_t *> &) { unreachable(); }
+        void split_combined_response(const write_response_t &, size_t,
+                                     std::vector<write_response_t> *) const {
+            unreachable();
+        }
+
+        // Never profiled, see rdb_protocol_t::read_t::profile_master().
+        void profile_master(ticks_t, ticks_t, write_response_t *) const { }
+        void profile_round_trip(ticks_t, write_response_t *) const { }
+
         write_t() { }
         write_t(const write_t& w) : mutation(w.mutation), proposed_cas(w.proposed_cas), effective_time(w.effective_time) { }
         write_t(const query_t& m, cas_t pc, exptime_t et) : mutation(m), proposed_cas(pc), effective_time(et) { }
@@ -225,6 +248,25 @@ public:
                                  superblock_t *superblock,
                                  write_token_pair_t *token_pair,
                                  signal_t *interruptor);
+
+        /* Expired values are only hidden from reads; they take up space until
+        something writes to their keys.  So the store sweeps its btree in the
+        background, a batch of keys at a time, and erases the expired values it
+        finds. */
+        void sweep_expired_values(auto_drainer_t::lock_t keepalive);
+
+        /* Looks for expired values among the next batch of keys from `*cursor` on,
+        erases them, and moves `*cursor` past the batch.  Returns true if the
+        batch reached the end of the btree. */
+        bool sweep_expired_batch(key_range_t *cursor, signal_t *interruptor)
+            THROWS_ONLY(interrupted_exc_t);
+
+        // How many bytes of keys and values the sweep erases per second.
+        perfmon_rate_monitor_t pm_expired_bytes;
+        perfmon_membership_t pm_expired_bytes_membership;
+
+        // Mind the declaration ordering: the sweep uses the members above.
+        auto_drainer_t sweep_drainer;
     };
 
 };
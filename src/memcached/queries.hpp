@@ -52,6 +52,20 @@ struct get_result_t {
     cas_t cas;
 };
 
+/* `get` of many keys at once, so that a multi-key "get" takes one read per shard
+instead of one per key. */
+
+struct multi_get_query_t {
+    std::vector<store_key_t> keys;
+    multi_get_query_t() { }
+    explicit multi_get_query_t(const std::vector<store_key_t> &_keys) : keys(_keys) { }
+};
+
+struct multi_get_result_t {
+    // Only the keys that were found.
+    std::map<store_key_t, get_result_t> values;
+};
+
 /* `rget` */
 
 struct rget_query_t {
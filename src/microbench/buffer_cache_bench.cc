@@ -0,0 +1,96 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "microbench/microbench.hpp"
+
+#include <vector>
+
+#include "buffer_cache/buffer_cache.hpp"
+#include "concurrency/fifo_checker.hpp"
+#include "containers/scoped.hpp"
+#include "perfmon/core.hpp"
+#include "serializer/config.hpp"
+#include "unittest/mock_file.hpp"
+
+namespace microbench {
+
+namespace {
+
+const int cache_block_count = 1024;
+
+/* A cache over an in-memory file, big enough that the blocks never leave it, so
+that the acquisitions are the cache's own work and never wait for the disk. */
+class buffer_cache_fixture_t : public benchmark_t {
+public:
+    buffer_cache_fixture_t() {
+        standard_serializer_t::create(&file_opener,
+                                      standard_serializer_t::static_config_t());
+        serializer.init(new standard_serializer_t(standard_serializer_t::dynamic_config_t(),
+                                                  &file_opener,
+                                                  &get_global_perfmon_collection()));
+        cache_t::create(serializer.get());
+        mirrored_cache_config_t cache_config;
+        cache_config.flush_timer_ms = MILLION;
+        cache_config.flush_dirty_size = BILLION;
+        cache_config.max_size = GIGABYTE;
+        cache.init(new cache_t(serializer.get(), cache_config,
+                               &get_global_perfmon_collection()));
+
+        transaction_t txn(cache.get(), rwi_write, cache_block_count,
+                          repli_timestamp_t::distant_past,
+                          order_source.check_in("buffer_cache_fixture_t"),
+                          WRITE_DURABILITY_SOFT);
+        for (int i = 0; i < cache_block_count; ++i) {
+            buf_lock_t buf(&txn);
+            *static_cast<uint32_t *>(buf.get_data_write()) = i;
+            block_ids.push_back(buf.get_block_id());
+        }
+    }
+
+    int64_t ops_per_run() const { return block_ids.size(); }
+
+protected:
+    unittest::mock_file_opener_t file_opener;
+    scoped_ptr_t<standard_serializer_t> serializer;
+    scoped_ptr_t<cache_t> cache;
+    order_source_t order_source;
+    std::vector<block_id_t> block_ids;
+};
+
+/* Acquires every block for reading in one transaction. */
+class buffer_cache_acquire_read_benchmark_t : public buffer_cache_fixture_t {
+public:
+    void run_once() {
+        transaction_t txn(cache.get(), rwi_read,
+                          order_source.check_in("buffer_cache_acquire_read").with_read_mode());
+        for (size_t i = 0; i < block_ids.size(); ++i) {
+            buf_lock_t buf(&txn, block_ids[i], rwi_read);
+        }
+    }
+};
+
+/* Acquires every block for writing in one transaction and changes it. */
+class buffer_cache_acquire_write_benchmark_t : public buffer_cache_fixture_t {
+public:
+    void run_once() {
+        transaction_t txn(cache.get(), rwi_write, block_ids.size(),
+                          repli_timestamp_t::distant_past,
+                          order_source.check_in("buffer_cache_acquire_write"),
+                          WRITE_DURABILITY_SOFT);
+        for (size_t i = 0; i < block_ids.size(); ++i) {
+            buf_lock_t buf(&txn, block_ids[i], rwi_write);
+            ++*static_cast<uint32_t *>(buf.get_data_write());
+        }
+    }
+};
+
+}  // namespace
+
+void add_buffer_cache_benchmarks(std::vector<benchmark_spec_t> *benchmarks) {
+    benchmarks->push_back(benchmark_spec_t(
+        "buffer_cache.acquire_read",
+        &make_benchmark<buffer_cache_acquire_read_benchmark_t>));
+    benchmarks->push_back(benchmark_spec_t(
+        "buffer_cache.acquire_write",
+        &make_benchmark<buffer_cache_acquire_write_benchmark_t>));
+}
+
+}  // namespace microbench
@@ -0,0 +1,88 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "microbench/microbench.hpp"
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "containers/archive/vector_stream.hpp"
+#include "rdb_protocol/datum.hpp"
+#include "utils.hpp"
+
+namespace microbench {
+
+namespace {
+
+/* A made-up document the size and shape of a typical one: a dozen fields of
+strings and numbers, and an array of small objects. */
+counted_t<const ql::datum_t> make_document() {
+    std::map<std::string, counted_t<const ql::datum_t> > fields;
+    fields["id"] = make_counted<const ql::datum_t>("5c9a4e0e-1b2f-4b63-9d6a-0c1dfa3e7b21");
+    fields["name"] = make_counted<const ql::datum_t>("Stephen Crane");
+    fields["email"] = make_counted<const ql::datum_t>("stephen.crane@example.com");
+    fields["age"] = make_counted<const ql::datum_t>(29.0);
+    fields["score"] = make_counted<const ql::datum_t>(0.8125);
+    fields["created"] = make_counted<const ql::datum_t>(1378934400.0);
+    fields["active"] = make_counted<const ql::datum_t>(ql::datum_t::R_BOOL, true);
+    fields["bio"] = make_counted<const ql::datum_t>(std::string(200, 'x'));
+
+    std::vector<counted_t<const ql::datum_t> > tags;
+    for (int i = 0; i < 8; ++i) {
+        std::map<std::string, counted_t<const ql::datum_t> > tag;
+        tag["tag"] = make_counted<const ql::datum_t>(strprintf("tag%d", i));
+        tag["weight"] = make_counted<const ql::datum_t>(static_cast<double>(i));
+        tags.push_back(make_counted<const ql::datum_t>(std::move(tag)));
+    }
+    fields["tags"] = make_counted<const ql::datum_t>(std::move(tags));
+
+    return make_counted<const ql::datum_t>(std::move(fields));
+}
+
+class datum_serialize_benchmark_t : public benchmark_t {
+public:
+    datum_serialize_benchmark_t() : document(make_document()) { }
+
+    void run_once() {
+        vector_stream_t stream;
+        write_message_t wm;
+        wm << document;
+        int res = send_write_message(&stream, &wm);
+        guarantee(res == 0);
+    }
+
+private:
+    counted_t<const ql::datum_t> document;
+};
+
+class datum_deserialize_benchmark_t : public benchmark_t {
+public:
+    datum_deserialize_benchmark_t() {
+        vector_stream_t stream;
+        write_message_t wm;
+        wm << make_document();
+        int res = send_write_message(&stream, &wm);
+        guarantee(res == 0);
+        serialized = stream.vector();
+    }
+
+    void run_once() {
+        vector_read_stream_t stream(&serialized);
+        counted_t<const ql::datum_t> document;
+        archive_result_t res = deserialize(&stream, &document);
+        guarantee(res == ARCHIVE_SUCCESS);
+    }
+
+private:
+    std::vector<char> serialized;
+};
+
+}  // namespace
+
+void add_datum_benchmarks(std::vector<benchmark_spec_t> *benchmarks) {
+    benchmarks->push_back(benchmark_spec_t("datum.serialize",
+                                           &make_benchmark<datum_serialize_benchmark_t>));
+    benchmarks->push_back(benchmark_spec_t("datum.deserialize",
+                                           &make_benchmark<datum_deserialize_benchmark_t>));
+}
+
+}  // namespace microbench
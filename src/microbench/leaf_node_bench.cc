@@ -0,0 +1,134 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "microbench/microbench.hpp"
+
+#include <string>
+#include <vector>
+
+#include "btree/keys.hpp"
+#include "btree/leaf_node.hpp"
+#include "btree/node.hpp"
+#include "containers/scoped.hpp"
+#include "repli_timestamp.hpp"
+#include "utils.hpp"
+
+namespace microbench {
+
+namespace {
+
+const int leaf_block_size = 4096;
+const int leaf_key_size = 16;
+const int leaf_value_size = 32;
+
+/* The values are a length byte followed by that many bytes, like the short
+values of the leaf node unit tests. */
+class bench_value_sizer_t : public value_sizer_t<void> {
+public:
+    explicit bench_value_sizer_t(block_size_t bs) : block_size_(bs) { }
+
+    int size(const void *value) const {
+        return 1 + *static_cast<const uint8_t *>(value);
+    }
+
+    bool fits(const void *value, int length_available) const {
+        return length_available > 0 && size(value) <= length_available;
+    }
+
+    int max_possible_size() const {
+        return 256;
+    }
+
+    block_magic_t btree_leaf_magic() const {
+        block_magic_t magic = { { 'b', 'n', 'L', 'F' } };
+        return magic;
+    }
+
+    block_size_t block_size() const { return block_size_; }
+
+private:
+    block_size_t block_size_;
+
+    DISABLE_COPYING(bench_value_sizer_t);
+};
+
+/* A leaf node and random keys, as many as fit in it, in random order. */
+class leaf_fixture_t : public benchmark_t {
+public:
+    leaf_fixture_t()
+        : sizer(block_size_t::unsafe_make(leaf_block_size)),
+          node(leaf_block_size),
+          value(1 + leaf_value_size),
+          tstamp(repli_timestamp_t::distant_past) {
+        value[0] = leaf_value_size;
+        for (int i = 1; i <= leaf_value_size; ++i) {
+            value[i] = 'a' + randint(26);
+        }
+
+        leaf::init(&sizer, node.get());
+        for (;;) {
+            std::string key;
+            for (int i = 0; i < leaf_key_size; ++i) {
+                key.push_back('a' + randint(26));
+            }
+            store_key_t store_key(key);
+            if (leaf::is_full(&sizer, node.get(), store_key.btree_key(), value.data())) {
+                break;
+            }
+            insert(store_key);
+            keys.push_back(store_key);
+        }
+    }
+
+    int64_t ops_per_run() const { return keys.size(); }
+
+protected:
+    void insert(const store_key_t &key) {
+        tstamp = tstamp.next();
+        leaf::insert(&sizer, node.get(), key.btree_key(), value.data(), tstamp,
+                     key_modification_proof_t::real_proof());
+    }
+
+    bench_value_sizer_t sizer;
+    scoped_malloc_t<leaf_node_t> node;
+    std::vector<uint8_t> value;
+    repli_timestamp_t tstamp;
+    std::vector<store_key_t> keys;
+};
+
+/* Fills an empty leaf node. */
+class leaf_insert_benchmark_t : public leaf_fixture_t {
+public:
+    void run_once() {
+        leaf::init(&sizer, node.get());
+        for (size_t i = 0; i < keys.size(); ++i) {
+            insert(keys[i]);
+        }
+    }
+};
+
+/* Looks up every key of a full leaf node. */
+class leaf_lookup_benchmark_t : public leaf_fixture_t {
+public:
+    leaf_lookup_benchmark_t() : value_out(sizer.max_possible_size()) { }
+
+    void run_once() {
+        for (size_t i = 0; i < keys.size(); ++i) {
+            bool found = leaf::lookup(&sizer, node.get(), keys[i].btree_key(),
+                                      value_out.data());
+            guarantee(found);
+        }
+    }
+
+private:
+    std::vector<uint8_t> value_out;
+};
+
+}  // namespace
+
+void add_leaf_node_benchmarks(std::vector<benchmark_spec_t> *benchmarks) {
+    benchmarks->push_back(benchmark_spec_t("leaf_node.insert",
+                                           &make_benchmark<leaf_insert_benchmark_t>));
+    benchmarks->push_back(benchmark_spec_t("leaf_node.lookup",
+                                           &make_benchmark<leaf_lookup_benchmark_t>));
+}
+
+}  // namespace microbench
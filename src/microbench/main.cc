@@ -0,0 +1,128 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "errors.hpp"
+#include <boost/bind.hpp>
+
+#include "arch/runtime/starter.hpp"
+#include "config/args.hpp"
+#include "http/json.hpp"
+#include "microbench/microbench.hpp"
+#include "utils.hpp"
+
+/* rethinkdb-microbench runs the benchmarks of the components whose names
+contain the filter, prints a summary to stderr and writes the results as JSON to
+stdout or to the file given with --json, e.g.
+
+    rethinkdb-microbench --filter leaf_node. --runs 10000 --json leaf.json
+*/
+
+namespace {
+
+struct options_t {
+    options_t() : list(false) { }
+    std::string filter;
+    microbench::run_config_t config;
+    std::string json_path;
+    bool list;
+};
+
+void usage(const char *name) {
+    fprintf(stderr,
+            "Usage: %s [--filter SUBSTRING] [--warmup N] [--runs N] [--json FILE] [--list]\n"
+            "  --filter  Only run the benchmarks whose names contain SUBSTRING.\n"
+            "  --warmup  Untimed runs before the timed ones (default %d).\n"
+            "  --runs    Timed runs of each benchmark (default %d).\n"
+            "  --json    Write the results to FILE rather than stdout.\n"
+            "  --list    Print the names of the benchmarks and exit.\n",
+            name, MICROBENCH_DEFAULT_WARMUP_RUNS, MICROBENCH_DEFAULT_RUNS);
+}
+
+bool parse_count(const char *arg, int64_t *out) {
+    return strtoi64_strict(std::string(arg), 10, out) && *out >= 0;
+}
+
+bool parse_options(int argc, char **argv, options_t *options) {
+    for (int i = 1; i < argc; ++i) {
+        const bool has_value = i + 1 < argc;
+        if (strcmp(argv[i], "--list") == 0) {
+            options->list = true;
+        } else if (strcmp(argv[i], "--filter") == 0 && has_value) {
+            options->filter = argv[++i];
+        } else if (strcmp(argv[i], "--warmup") == 0 && has_value) {
+            if (!parse_count(argv[++i], &options->config.warmup_runs)) {
+                return false;
+            }
+        } else if (strcmp(argv[i], "--runs") == 0 && has_value) {
+            if (!parse_count(argv[++i], &options->config.runs)
+                || options->config.runs == 0) {
+                return false;
+            }
+        } else if (strcmp(argv[i], "--json") == 0 && has_value) {
+            options->json_path = argv[++i];
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+void run_benchmarks(const options_t &options,
+                    std::vector<microbench::benchmark_result_t> *results_out) {
+    std::vector<microbench::benchmark_spec_t> benchmarks = microbench::all_benchmarks();
+    for (size_t i = 0; i < benchmarks.size(); ++i) {
+        if (benchmarks[i].name.find(options.filter) == std::string::npos) {
+            continue;
+        }
+        microbench::benchmark_result_t result
+            = microbench::run_benchmark(benchmarks[i], options.config);
+        fprintf(stderr, "%-40s %12.1f ns/op  p50 %10.1f  p99 %10.1f  %14.1f ops/s\n",
+                result.name.c_str(), result.mean_ns, result.p50_ns, result.p99_ns,
+                result.ops_per_sec);
+        results_out->push_back(result);
+    }
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    startup_shutdown_t startup_shutdown;
+
+    options_t options;
+    if (!parse_options(argc, argv, &options)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (options.list) {
+        std::vector<microbench::benchmark_spec_t> benchmarks = microbench::all_benchmarks();
+        for (size_t i = 0; i < benchmarks.size(); ++i) {
+            printf("%s\n", benchmarks[i].name.c_str());
+        }
+        return 0;
+    }
+
+    std::vector<microbench::benchmark_result_t> results;
+    run_in_thread_pool(boost::bind(&run_benchmarks, boost::cref(options), &results),
+                       MICROBENCH_NUM_THREADS);
+
+    scoped_cJSON_t json;
+    microbench::results_to_json(results, &json);
+    const std::string rendered = json.Print() + "\n";
+    if (options.json_path.empty()) {
+        fputs(rendered.c_str(), stdout);
+    } else {
+        FILE *file = fopen(options.json_path.c_str(), "w");
+        if (file == NULL) {
+            fprintf(stderr, "Could not open %s for writing.\n", options.json_path.c_str());
+            return 1;
+        }
+        fputs(rendered.c_str(), file);
+        fclose(file);
+    }
+    return 0;
+}
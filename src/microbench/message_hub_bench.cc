@@ -0,0 +1,54 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "microbench/microbench.hpp"
+
+#include <vector>
+
+#include "arch/runtime/runtime.hpp"
+#include "concurrency/pmap.hpp"
+#include "utils.hpp"
+
+namespace microbench {
+
+namespace {
+
+const int hops_per_run = 100;
+
+/* Moves the coroutine to the next thread and back, which is two messages
+through the message hubs of the two threads. */
+class message_hub_round_trip_benchmark_t : public benchmark_t {
+public:
+    int64_t ops_per_run() const { return hops_per_run; }
+
+    void run_once() {
+        const threadnum_t other((get_thread_id().threadnum + 1) % get_num_threads());
+        for (int i = 0; i < hops_per_run; ++i) {
+            on_thread_t thread_switcher(other);
+        }
+    }
+};
+
+void visit_thread(int thread) {
+    on_thread_t thread_switcher((threadnum_t(thread)));
+}
+
+/* Visits every thread at once from coroutines of this one, the way the code
+that does something on every thread does. */
+class message_hub_fan_out_benchmark_t : public benchmark_t {
+public:
+    void run_once() {
+        pmap(get_num_threads(), &visit_thread);
+    }
+};
+
+}  // namespace
+
+void add_message_hub_benchmarks(std::vector<benchmark_spec_t> *benchmarks) {
+    benchmarks->push_back(benchmark_spec_t(
+        "message_hub.round_trip",
+        &make_benchmark<message_hub_round_trip_benchmark_t>));
+    benchmarks->push_back(benchmark_spec_t(
+        "message_hub.fan_out",
+        &make_benchmark<message_hub_fan_out_benchmark_t>));
+}
+
+}  // namespace microbench
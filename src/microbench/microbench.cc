@@ -0,0 +1,90 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "microbench/microbench.hpp"
+
+#include <algorithm>
+
+#include "config/args.hpp"
+#include "containers/scoped.hpp"
+#include "http/json.hpp"
+#include "utils.hpp"
+
+namespace microbench {
+
+std::vector<benchmark_spec_t> all_benchmarks() {
+    std::vector<benchmark_spec_t> benchmarks;
+    add_leaf_node_benchmarks(&benchmarks);
+    add_datum_benchmarks(&benchmarks);
+    add_buffer_cache_benchmarks(&benchmarks);
+    add_message_hub_benchmarks(&benchmarks);
+    return benchmarks;
+}
+
+run_config_t::run_config_t()
+    : warmup_runs(MICROBENCH_DEFAULT_WARMUP_RUNS),
+      runs(MICROBENCH_DEFAULT_RUNS) { }
+
+// The nearest-rank percentile of the sorted `samples`.
+static ticks_t percentile(const std::vector<ticks_t> &samples, double fraction) {
+    guarantee(!samples.empty());
+    size_t rank = static_cast<size_t>(fraction * samples.size());
+    return samples[std::min(rank, samples.size() - 1)];
+}
+
+benchmark_result_t run_benchmark(const benchmark_spec_t &spec,
+                                 const run_config_t &config) {
+    guarantee(config.runs > 0);
+    scoped_ptr_t<benchmark_t> benchmark(spec.make());
+
+    for (int64_t i = 0; i < config.warmup_runs; ++i) {
+        benchmark->run_once();
+    }
+
+    std::vector<ticks_t> samples;
+    samples.reserve(config.runs);
+    ticks_t total = 0;
+    for (int64_t i = 0; i < config.runs; ++i) {
+        const ticks_t start = get_ticks();
+        benchmark->run_once();
+        const ticks_t elapsed = get_ticks() - start;
+        samples.push_back(elapsed);
+        total += elapsed;
+    }
+    std::sort(samples.begin(), samples.end());
+
+    benchmark_result_t result;
+    result.name = spec.name;
+    result.runs = config.runs;
+    result.ops_per_run = benchmark->ops_per_run();
+    guarantee(result.ops_per_run > 0);
+    const double ops = result.ops_per_run;
+    result.min_ns = samples.front() / ops;
+    result.mean_ns = total / (ops * config.runs);
+    result.p50_ns = percentile(samples, 0.5) / ops;
+    result.p90_ns = percentile(samples, 0.9) / ops;
+    result.p99_ns = percentile(samples, 0.99) / ops;
+    result.max_ns = samples.back() / ops;
+    result.ops_per_sec = total == 0 ? 0 : (ops * config.runs) / ticks_to_secs(total);
+    return result;
+}
+
+void results_to_json(const std::vector<benchmark_result_t> &results,
+                     scoped_cJSON_t *json_out) {
+    json_out->reset(cJSON_CreateArray());
+    for (size_t i = 0; i < results.size(); ++i) {
+        const benchmark_result_t &r = results[i];
+        scoped_cJSON_t result(cJSON_CreateObject());
+        result.AddItemToObject("name", cJSON_CreateString(r.name.c_str()));
+        result.AddItemToObject("runs", cJSON_CreateNumber(r.runs));
+        result.AddItemToObject("ops_per_run", cJSON_CreateNumber(r.ops_per_run));
+        result.AddItemToObject("min_ns", cJSON_CreateNumber(r.min_ns));
+        result.AddItemToObject("mean_ns", cJSON_CreateNumber(r.mean_ns));
+        result.AddItemToObject("p50_ns", cJSON_CreateNumber(r.p50_ns));
+        result.AddItemToObject("p90_ns", cJSON_CreateNumber(r.p90_ns));
+        result.AddItemToObject("p99_ns", cJSON_CreateNumber(r.p99_ns));
+        result.AddItemToObject("max_ns", cJSON_CreateNumber(r.max_ns));
+        result.AddItemToObject("ops_per_sec", cJSON_CreateNumber(r.ops_per_sec));
+        cJSON_AddItemToArray(json_out->get(), result.release());
+    }
+}
+
+}  // namespace microbench
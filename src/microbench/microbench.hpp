@@ -0,0 +1,86 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#ifndef MICROBENCH_MICROBENCH_HPP_
+#define MICROBENCH_MICROBENCH_HPP_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "errors.hpp"
+
+class scoped_cJSON_t;
+
+namespace microbench {
+
+/* A `benchmark_t` is the fixture of one microbenchmark.  The harness constructs
+it, calls `run_once()` over and over, timing every call, and destroys it, all in
+one coroutine of a thread pool of `MICROBENCH_NUM_THREADS` threads.  Operations
+that take less than a microsecond or so should do a batch of them in every call
+of `run_once()` and say how many with `ops_per_run()`, so that the clock doesn't
+add up to more than they take. */
+class benchmark_t {
+public:
+    benchmark_t() { }
+    virtual ~benchmark_t() { }
+
+    virtual int64_t ops_per_run() const { return 1; }
+    virtual void run_once() = 0;
+
+private:
+    DISABLE_COPYING(benchmark_t);
+};
+
+template <class benchmark_type_t>
+benchmark_t *make_benchmark() {
+    return new benchmark_type_t;
+}
+
+struct benchmark_spec_t {
+    benchmark_spec_t(const std::string &_name, benchmark_t *(*_make)())
+        : name(_name), make(_make) { }
+    // Like `component.operation`, see the *_bench.cc files.
+    std::string name;
+    benchmark_t *(*make)();
+};
+
+/* Every *_bench.cc file adds its benchmarks to the list with one of these, see
+`all_benchmarks()`. */
+void add_leaf_node_benchmarks(std::vector<benchmark_spec_t> *benchmarks);
+void add_datum_benchmarks(std::vector<benchmark_spec_t> *benchmarks);
+void add_buffer_cache_benchmarks(std::vector<benchmark_spec_t> *benchmarks);
+void add_message_hub_benchmarks(std::vector<benchmark_spec_t> *benchmarks);
+
+std::vector<benchmark_spec_t> all_benchmarks();
+
+struct run_config_t {
+    run_config_t();
+    // The runs that are done before the timing starts, to fill the caches and
+    // let the allocator settle.
+    int64_t warmup_runs;
+    // The timed runs.
+    int64_t runs;
+};
+
+/* What one benchmark took, in nanoseconds per operation. */
+struct benchmark_result_t {
+    std::string name;
+    int64_t runs;
+    int64_t ops_per_run;
+    double min_ns, mean_ns, p50_ns, p90_ns, p99_ns, max_ns;
+    double ops_per_sec;
+};
+
+/* Runs `spec` as `config` says.  Must be called in a coroutine of the thread
+pool. */
+benchmark_result_t run_benchmark(const benchmark_spec_t &spec,
+                                 const run_config_t &config);
+
+/* Renders the results as a JSON array of objects, one per benchmark, that
+scripts can compare from one commit to the next. */
+void results_to_json(const std::vector<benchmark_result_t> &results,
+                     scoped_cJSON_t *json_out);
+
+}  // namespace microbench
+
+#endif  // MICROBENCH_MICROBENCH_HPP_
@@ -1,10 +1,18 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "migrate/migrate.hpp"
 
+#include <errno.h>
 #include <getopt.h>
+#include <limits.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
+#include <algorithm>
 #include <string>
+#include <vector>
 
 #include "errors.hpp"
 #include <boost/algorithm/string/join.hpp>
@@ -14,7 +22,8 @@ namespace migrate {
 
 NORETURN void usage(UNUSED const char *name) {
     printf("Usage:\n"
-           "        rethinkdb migrate --in -f <file_1> [-f <file_2> ...] --out -f <file_1> [-f <file_2>] [--intermediate file]\n");
+           "        rethinkdb migrate --in -f <file_1> [-f <file_2> ...] --out -f <file_1> [-f <file_2>] [--intermediate file]\n"
+           "        rethinkdb migrate --from HOST:PORT --to HOST:PORT [-a AUTH_KEY] [--clients NUM] [--intermediate file]\n");
     printf("\n"
            "Migrate legacy versions of RethinkDB data files to the current version.\n"
            "\n"
@@ -30,7 +39,18 @@ NORETURN void usage(UNUSED const char *name) {
            "      --intermediate    File to store intermediate raw memcached commands.\n"
            "                        It defaults to: %s.\n", TEMP_MIGRATION_FILE);
     printf("      --force           Allow migrate to overwrite an existing database file.\n");
+    printf("      --from HOST:PORT  Driver port of a running cluster with the old version.\n"
+           "      --to HOST:PORT    Driver port of a running cluster with the new version.\n"
+           "      -a, --auth KEY    Authorization key for both clusters.\n"
+           "      --clients NUM     Number of tables to copy at once (defaults to %d).\n",
+           MIGRATION_DEFAULT_CLIENTS);
     printf("\n"
+           "With --from and --to, migration runs 'rethinkdb dump' against the old\n"
+           "cluster and 'rethinkdb restore' against the new one.  Both stream each\n"
+           "table through a bounded pipe, copy --clients tables at a time and report\n"
+           "their progress, so neither cluster is taken down while the data moves.\n"
+           "The intermediate archive is removed once the restore succeeds.\n"
+           "\n"
            "Migration extracts data from the old database into a portable format of raw\n"
            "memcached commands and then reinserts the data into a new file version being\n"
            "migrated to.\n"
@@ -80,12 +100,16 @@ void parse_cmd_args(int argc, char **argv, config_t *config) {
                 {"file", required_argument, 0, 'f'},
                 {"intermediate", required_argument, 0, 'i'},
                 {"force", no_argument, &(config->force), 1},
+                {"from", required_argument, 0, 'F'},
+                {"to", required_argument, 0, 'T'},
+                {"auth", required_argument, 0, 'a'},
+                {"clients", required_argument, 0, 'c'},
                 {"help", no_argument, &do_help, 1},
                 {0, 0, 0, 0}
             };
 
         int option_index = 0;
-        int c = getopt_long(argc, argv, "f:i:", long_options, &option_index);
+        int c = getopt_long(argc, argv, "f:i:a:", long_options, &option_index);
 
         if (do_help) {
             c = 'h';
@@ -115,6 +139,23 @@ void parse_cmd_args(int argc, char **argv, config_t *config) {
         case 'i':
             config->intermediate_file = optarg;
             break;
+        case 'F':
+            config->from_host = optarg;
+            break;
+        case 'T':
+            config->to_host = optarg;
+            break;
+        case 'a':
+            config->auth_key = optarg;
+            break;
+        case 'c': {
+            char *end;
+            long clients = strtol(optarg, &end, 10);
+            if (*optarg == '\0' || *end != '\0' || clients < 1 || clients > INT_MAX) {
+                fail_due_to_user_error("--clients must be a positive integer, got \"%s\"", optarg);
+            }
+            config->clients = clients;
+        } break;
         default:
             // getopt_long already printed an error message.
             usage(argv[0]);
@@ -127,6 +168,16 @@ void parse_cmd_args(int argc, char **argv, config_t *config) {
 
     // Sanity checks
 
+    if (!config->from_host.empty() || !config->to_host.empty()) {
+        if (config->from_host.empty() || config->to_host.empty()) {
+            fail_due_to_user_error("--from and --to must be given together.");
+        }
+        if (!config->input_filenames.empty() || !config->output_filenames.empty()) {
+            fail_due_to_user_error("--from and --to can't be combined with --in or --out.");
+        }
+        return;
+    }
+
     if (config->input_filenames.empty()) {
         fprintf(stderr, "At least one input file must be specified.\n");
         usage(argv[0]);
@@ -159,11 +210,96 @@ std::string escape_spaces(const std::string& str) {
     return result;
 }
 
+/* Runs `argv[0] args...` and waits for it.  Returns true if it exited with
+status 0. */
+bool run_subcommand(const std::string &exec_name, const std::vector<std::string> &args) {
+    std::vector<char *> c_args;
+    c_args.push_back(const_cast<char *>(exec_name.c_str()));
+    for (std::vector<std::string>::const_iterator it = args.begin(); it != args.end(); ++it) {
+        c_args.push_back(const_cast<char *>(it->c_str()));
+    }
+    c_args.push_back(NULL);
+
+    pid_t pid = fork();
+    if (pid == -1) {
+        fprintf(stderr, "Could not fork: %s\n", errno_string(errno).c_str());
+        return false;
+    } else if (pid == 0) {
+        execvp(exec_name.c_str(), c_args.data());
+        fprintf(stderr, "Could not run %s: %s\n", exec_name.c_str(), errno_string(errno).c_str());
+        _exit(EXIT_FAILURE);
+    }
+
+    int status;
+    pid_t res;
+    do {
+        res = waitpid(pid, &status, 0);
+    } while (res == -1 && errno == EINTR);
+    guarantee_err(res == pid, "waitpid failed");
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+/* Copies every table of a running old-version cluster into a running
+new-version one by calling `rethinkdb dump` and `rethinkdb restore`.  They do
+the streaming, the per-table parallelism and the progress reporting. */
+int run_cluster_migrate(const migrate::config_t &cfg) {
+    std::string clients = strprintf("%d", cfg.clients);
+
+    std::vector<std::string> dump_args;
+    dump_args.push_back("dump");
+    dump_args.push_back("-c");
+    dump_args.push_back(cfg.from_host);
+    dump_args.push_back("-f");
+    dump_args.push_back(cfg.intermediate_file);
+    dump_args.push_back("--clients");
+    dump_args.push_back(clients);
+
+    std::vector<std::string> restore_args;
+    restore_args.push_back("restore");
+    restore_args.push_back(cfg.intermediate_file);
+    restore_args.push_back("-c");
+    restore_args.push_back(cfg.to_host);
+    restore_args.push_back("--clients");
+    restore_args.push_back(clients);
+
+    if (!cfg.auth_key.empty()) {
+        dump_args.push_back("-a");
+        dump_args.push_back(cfg.auth_key);
+        restore_args.push_back("-a");
+        restore_args.push_back(cfg.auth_key);
+    }
+
+    printf("Dumping %s into %s...\n", cfg.from_host.c_str(), cfg.intermediate_file.c_str());
+    if (!run_subcommand(cfg.exec_name, dump_args)) {
+        fprintf(stderr, "Migration failed while dumping %s.\n", cfg.from_host.c_str());
+        return EXIT_FAILURE;
+    }
+
+    printf("Restoring %s into %s...\n", cfg.intermediate_file.c_str(), cfg.to_host.c_str());
+    if (!run_subcommand(cfg.exec_name, restore_args)) {
+        fprintf(stderr,
+                "Migration failed while restoring into %s.  The dumped data is still in %s.\n",
+                cfg.to_host.c_str(), cfg.intermediate_file.c_str());
+        return EXIT_FAILURE;
+    }
+
+    if (unlink(cfg.intermediate_file.c_str()) != 0) {
+        fprintf(stderr, "Could not remove %s: %s\n",
+                cfg.intermediate_file.c_str(), errno_string(errno).c_str());
+    }
+    printf("Migration complete.\n");
+    return EXIT_SUCCESS;
+}
+
 int run_migrate(int argc, char **argv) {
 
     migrate::config_t cfg;
     migrate::parse_cmd_args(argc, argv, &cfg);
 
+    if (!cfg.from_host.empty()) {
+        return run_cluster_migrate(cfg);
+    }
+
     //BREAKPOINT;
     std::vector<std::string> command_line;
 #ifdef MIGRATION_SCRIPT_LOCATION //Defined in src/Makefile
@@ -9,6 +9,9 @@
 
 #define TEMP_MIGRATION_FILE "migration-db-dump"
 
+// How many tables `rethinkdb migrate --from --to` copies at once by default.
+#define MIGRATION_DEFAULT_CLIENTS 3
+
 namespace migrate {
 
 struct config_t {
@@ -17,8 +20,14 @@ struct config_t {
     std::string exec_name;
     std::string intermediate_file;
     int force;
+    // Set for cluster-to-cluster migration through dump and restore.
+    std::string from_host;
+    std::string to_host;
+    std::string auth_key;
+    int clients;
     config_t()
-        : intermediate_file(TEMP_MIGRATION_FILE), force(false)
+        : intermediate_file(TEMP_MIGRATION_FILE), force(false),
+          clients(MIGRATION_DEFAULT_CLIENTS)
     { }
 };
 
@@ -188,6 +188,19 @@ dummy_protocol_t::region_t drop_cpu_sharding(const dummy_protocol_t::region_t &r
     return r;
 }
 
+dummy_protocol_t::region_t region_subdivide(const dummy_protocol_t::region_t &r, int part_number, int num_parts) {
+    guarantee(part_number >= 0);
+    guarantee(part_number < num_parts);
+    dummy_protocol_t::region_t part;
+    int i = 0;
+    for (std::set<std::string>::const_iterator it = r.keys.begin(); it != r.keys.end(); ++it, ++i) {
+        if (i % num_parts == part_number) {
+            part.keys.insert(*it);
+        }
+    }
+    return part;
+}
+
 bool operator==(dummy_protocol_t::region_t a, dummy_protocol_t::region_t b) {
     return a.keys == b.keys;
 }
@@ -452,6 +465,9 @@ bool dummy_protocol_t::store_t::send_backfill(const region_map_t<dummy_protocol_
                     chunk.timestamp = timestamps_snapshot[*it];
                     send_backfill_cb->send_chunk(chunk, interruptor);
                 }
+                dummy_protocol_t::region_t done;
+                done.keys.insert(*it);
+                send_backfill_cb->send_checkpoint(done, interruptor);
                 if (rng.randint(2) == 0) nap(rng.randint(10), interruptor);
             }
         }
@@ -21,6 +21,7 @@
 class signal_t;
 class io_backender_t;
 class serializer_t;
+struct store_key_t;
 
 namespace mock {
 
@@ -59,6 +60,12 @@ public:
 
         bool all_read() const { return false; }
 
+        bool coalescing_key(UNUSED store_key_t *key_out) const { return false; }
+
+        // Never profiled, see rdb_protocol_t::read_t::profile_master().
+        void profile_master(ticks_t, ticks_t, read_response_t *) const { }
+        void profile_round_trip(ticks_t, read_response_t *) const { }
+
         RDB_MAKE_ME_SERIALIZABLE_1(keys);
         region_t keys;
     };
@@ -80,6 +87,19 @@ public:
                    write_t *write_out) const;
         void unshard(const write_response_t *resps, size_t count, write_response_t *response, context_t *cache, signal_t *) const;
 
+        // Never combined, see master_t.
+        bool is_combinable() const { return false; }
+        bool can_combine_with(const write_t &) const { unreachable(); }
+        static write_t combine(const std::vector<const write_t *> &) { unreachable(); }
+        void split_combined_response(const write_response_t &, size_t,
+                                     std::vector<write_response_t> *) const {
+            unreachable();
+        }
+
+        // Never profiled, see rdb_protocol_t::read_t::profile_master().
+        void profile_master(ticks_t, ticks_t, write_response_t *) const { }
+        void profile_round_trip(ticks_t, write_response_t *) const { }
+
         RDB_MAKE_ME_SERIALIZABLE_1(values);
         std::map<std::string, std::string> values;
     };
@@ -113,6 +133,9 @@ public:
                 io_backender_t *io, const base_path_t &);
         ~store_t();
 
+        // The dummy store has no cache to warm up.
+        void enable_cache_warmup_manifest(UNUSED const std::string &path) { }
+
         void new_read_token(object_buffer_t<fifo_enforcer_sink_t::exit_read_t> *token_out) THROWS_NOTHING;
         void new_write_token(object_buffer_t<fifo_enforcer_sink_t::exit_write_t> *token_out) THROWS_NOTHING;
 
@@ -191,6 +214,7 @@ std::vector<dummy_protocol_t::region_t> region_subtract_many(const dummy_protoco
 bool region_is_empty(const dummy_protocol_t::region_t &r);
 bool region_overlaps(const dummy_protocol_t::region_t &r1, const dummy_protocol_t::region_t &r2);
 dummy_protocol_t::region_t drop_cpu_sharding(const dummy_protocol_t::region_t &r);
+dummy_protocol_t::region_t region_subdivide(const dummy_protocol_t::region_t &r, int part_number, int num_parts);
 
 bool operator==(dummy_protocol_t::region_t a, dummy_protocol_t::region_t b);
 bool operator!=(dummy_protocol_t::region_t a, dummy_protocol_t::region_t b);
@@ -61,6 +61,36 @@ scoped_ptr_t<perfmon_result_t> perfmon_counter_t::output_stat(const int64_t &sta
     return make_scoped<perfmon_result_t>(strprintf("%" PRIi64, stat));
 }
 
+/* perfmon_counter_ratio_t */
+
+perfmon_counter_ratio_t::perfmon_counter_ratio_t(perfmon_counter_t *_numerator,
+                                                 perfmon_counter_t *_denominator)
+    : perfmon_perthread_t<std::pair<int64_t, int64_t> >(),
+      numerator(_numerator), denominator(_denominator) { }
+
+void perfmon_counter_ratio_t::get_thread_stat(std::pair<int64_t, int64_t> *stat) {
+    stat->first = numerator->get();
+    stat->second = denominator->get();
+}
+
+std::pair<int64_t, int64_t>
+perfmon_counter_ratio_t::combine_stats(const std::pair<int64_t, int64_t> *data) {
+    std::pair<int64_t, int64_t> total(0, 0);
+    for (int i = 0; i < get_num_threads(); i++) {
+        total.first += data[i].first;
+        total.second += data[i].second;
+    }
+    return total;
+}
+
+scoped_ptr_t<perfmon_result_t>
+perfmon_counter_ratio_t::output_stat(const std::pair<int64_t, int64_t> &stat) {
+    const double ratio = stat.second == 0
+        ? 0.0
+        : static_cast<double>(stat.first) / static_cast<double>(stat.second);
+    return make_scoped<perfmon_result_t>(strprintf("%.8f", ratio));
+}
+
 /* perfmon_sampler_t */
 
 perfmon_sampler_t::perfmon_sampler_t(ticks_t _length, bool _include_rate)
@@ -138,6 +168,205 @@ scoped_ptr_t<perfmon_result_t> perfmon_sampler_t::output_stat(const stats_t &agg
     return stat;
 }
 
+/* perfmon_histogram_t */
+
+int perfmon_histogram::bucket_of(double first_bound, double value) {
+    double bound = first_bound;
+    for (int i = 0; i < num_buckets - 1; ++i) {
+        if (value <= bound) {
+            return i;
+        }
+        bound *= 2;
+    }
+    return num_buckets - 1;
+}
+
+perfmon_histogram_t::perfmon_histogram_t(double _first_bound)
+    : perfmon_perthread_t<buckets_t>(), thread_data(new buckets_t[MAX_THREADS]),
+      first_bound(_first_bound) {
+    rassert(first_bound > 0);
+}
+
+perfmon_histogram_t::~perfmon_histogram_t() {
+    delete[] thread_data;
+}
+
+void perfmon_histogram_t::record(double value) {
+    rassert(get_thread_id().threadnum >= 0);
+    ++thread_data[get_thread_id().threadnum].counts[
+        perfmon_histogram::bucket_of(first_bound, value)];
+}
+
+void perfmon_histogram_t::get_thread_stat(buckets_t *stat) {
+    rassert(get_thread_id().threadnum >= 0);
+    *stat = thread_data[get_thread_id().threadnum];
+}
+
+perfmon_histogram_t::buckets_t perfmon_histogram_t::combine_stats(const buckets_t *stats) {
+    buckets_t combined;
+    for (int i = 0; i < get_num_threads(); i++) {
+        for (int j = 0; j < perfmon_histogram::num_buckets; ++j) {
+            combined.counts[j] += stats[i].counts[j];
+        }
+    }
+    return combined;
+}
+
+scoped_ptr_t<perfmon_result_t> perfmon_histogram_t::output_stat(const buckets_t &combined) {
+    scoped_ptr_t<perfmon_result_t> stat = perfmon_result_t::alloc_map_result();
+
+    // The keys are the buckets' upper bounds, formatted so that they sort in order.
+    double bound = first_bound;
+    for (int i = 0; i < perfmon_histogram::num_buckets - 1; ++i) {
+        stat->insert(strprintf("le_%014.8f", bound),
+                     new perfmon_result_t(strprintf("%" PRIi64, combined.counts[i])));
+        bound *= 2;
+    }
+    stat->insert("le_inf",
+                 new perfmon_result_t(strprintf("%" PRIi64,
+                     combined.counts[perfmon_histogram::num_buckets - 1])));
+    return stat;
+}
+
+/* perfmon_hdr_histogram_t */
+
+void perfmon_hdr_histogram::buckets_t::aggregate(const buckets_t &other) {
+    for (int i = 0; i < num_buckets; ++i) {
+        counts[i] += other.counts[i];
+    }
+    total += other.total;
+    max = std::max(max, other.max);
+}
+
+int perfmon_hdr_histogram::bucket_of(uint64_t value) {
+    // Values below `sub_buckets` each get their own bucket.  Above, the bucket is
+    // the position of the highest bit and the `sub_bucket_bits` bits after it.
+    if (value < static_cast<uint64_t>(sub_buckets)) {
+        return value;
+    }
+    value = std::min<uint64_t>(value, (1ULL << max_value_bits) - 1);
+    const int shift = (63 - __builtin_clzll(value)) - sub_bucket_bits;
+    return sub_buckets * (shift + 1) + ((value >> shift) & (sub_buckets - 1));
+}
+
+uint64_t perfmon_hdr_histogram::highest_value_of(int bucket) {
+    if (bucket < sub_buckets) {
+        return bucket;
+    }
+    const int shift = bucket / sub_buckets - 1;
+    const uint64_t sub_bucket = bucket % sub_buckets;
+    return ((sub_buckets + sub_bucket + 1) << shift) - 1;
+}
+
+perfmon_hdr_histogram_t::perfmon_hdr_histogram_t(ticks_t _length, double _resolution,
+                                                 bool _per_thread)
+    : perfmon_perthread_t<buckets_t>(), length(_length), resolution(_resolution),
+      per_thread(_per_thread) {
+    rassert(resolution > 0);
+}
+
+perfmon_hdr_histogram_t::~perfmon_hdr_histogram_t() { }
+
+perfmon_hdr_histogram_t::thread_info_t *perfmon_hdr_histogram_t::update(ticks_t now) {
+    int interval = now / length;
+    rassert(get_thread_id().threadnum >= 0);
+    thread_info_t *thread = thread_data[get_thread_id().threadnum].get_or_null();
+    if (thread == NULL) {
+        return NULL;
+    }
+
+    if (thread->current_interval == interval) {
+        /* We're up to date; nothing to do */
+    } else if (thread->current_interval + 1 == interval) {
+        /* We're one step behind */
+        thread->last_buckets = thread->current_buckets;
+        thread->current_buckets = buckets_t();
+        thread->current_interval++;
+    } else {
+        /* We're more than one step behind */
+        thread->last_buckets = thread->current_buckets = buckets_t();
+        thread->current_interval = interval;
+    }
+    return thread;
+}
+
+void perfmon_hdr_histogram_t::record(double v) {
+    ticks_t now = get_ticks();
+    thread_info_t *thread = update(now);
+    if (thread == NULL) {
+        thread = new thread_info_t;
+        thread->current_interval = now / length;
+        thread_data[get_thread_id().threadnum].init(thread);
+    }
+    const uint64_t value = v > 0 ? static_cast<uint64_t>(v / resolution + 0.5) : 0;
+    ++thread->current_buckets.counts[perfmon_hdr_histogram::bucket_of(value)];
+    ++thread->current_buckets.total;
+    thread->current_buckets.max = std::max(thread->current_buckets.max, value);
+}
+
+void perfmon_hdr_histogram_t::get_thread_stat(buckets_t *stat) {
+    /* Like perfmon_sampler_t, return the last complete interval's buckets. */
+    thread_info_t *thread = update(get_ticks());
+    if (thread != NULL) {
+        *stat = thread->last_buckets;
+    }
+}
+
+scoped_ptr_t<perfmon_result_t> perfmon_hdr_histogram_t::end_stats(void *v_data) {
+    if (!per_thread) {
+        return perfmon_perthread_t<buckets_t>::end_stats(v_data);
+    }
+    std::unique_ptr<buckets_t[]> data(static_cast<buckets_t *>(v_data));
+    scoped_ptr_t<perfmon_result_t> stat = perfmon_result_t::alloc_map_result();
+    for (int i = 0; i < get_num_threads(); ++i) {
+        stat->insert(strprintf("thread_%03d", i), output_stat(data[i]).release());
+    }
+    return stat;
+}
+
+perfmon_hdr_histogram_t::buckets_t perfmon_hdr_histogram_t::combine_stats(const buckets_t *stats) {
+    buckets_t combined;
+    for (int i = 0; i < get_num_threads(); i++) {
+        combined.aggregate(stats[i]);
+    }
+    return combined;
+}
+
+scoped_ptr_t<perfmon_result_t> perfmon_hdr_histogram_t::output_stat(const buckets_t &combined) {
+    scoped_ptr_t<perfmon_result_t> stat = perfmon_result_t::alloc_map_result();
+    stat->insert(stat_count, new perfmon_result_t(strprintf("%" PRIi64, combined.total)));
+
+    static const double quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+    static const char *quantile_names[] = { "p50", "p90", "p99", "p999" };
+    static const int num_quantiles = sizeof(quantiles) / sizeof(quantiles[0]);
+
+    if (combined.total == 0) {
+        for (int q = 0; q < num_quantiles; ++q) {
+            stat->insert(quantile_names[q], new perfmon_result_t(no_value));
+        }
+        stat->insert(stat_max, new perfmon_result_t(no_value));
+        return stat;
+    }
+
+    // The buckets are walked once for all the quantiles, which are in order.
+    int bucket = 0;
+    int64_t seen = combined.counts[0];
+    for (int q = 0; q < num_quantiles; ++q) {
+        const int64_t rank = std::max<int64_t>(1, ceil(quantiles[q] * combined.total));
+        while (seen < rank) {
+            ++bucket;
+            seen += combined.counts[bucket];
+        }
+        // No value in the bucket is above the maximum.
+        const uint64_t value = std::min(perfmon_hdr_histogram::highest_value_of(bucket),
+                                        combined.max);
+        stat->insert(quantile_names[q],
+                     new perfmon_result_t(strprintf("%.8f", value * resolution)));
+    }
+    stat->insert(stat_max, new perfmon_result_t(strprintf("%.8f", combined.max * resolution)));
+    return stat;
+}
+
 /* perfmon_stddev_t */
 
 stddev_t::stddev_t()
@@ -13,6 +13,7 @@
 #include <string>
 #include <map>
 #include <memory>
+#include <utility>
 
 #include "perfmon/types.hpp"
 #include "perfmon/core.hpp"
@@ -58,6 +59,7 @@ protected:
  */
 class perfmon_counter_t : public perfmon_perthread_t<cache_line_padded_t<int64_t>, int64_t> {
     friend class perfmon_counter_step_t;
+    friend class perfmon_counter_ratio_t;
 protected:
     typedef cache_line_padded_t<int64_t> padded_int64_t;
     padded_int64_t *thread_data;
@@ -76,6 +78,22 @@ public:
     void operator-=(int64_t num) { get() -= num; }
 };
 
+/* perfmon_counter_ratio_t reports the ratio of two perfmon_counter_ts, for
+ * example the number of bytes written to disk per byte of user data. It reports
+ * 0 while the denominator is 0. The counters must outlive it.
+ */
+class perfmon_counter_ratio_t : public perfmon_perthread_t<std::pair<int64_t, int64_t> > {
+private:
+    perfmon_counter_t *numerator;
+    perfmon_counter_t *denominator;
+
+    void get_thread_stat(std::pair<int64_t, int64_t> *);
+    std::pair<int64_t, int64_t> combine_stats(const std::pair<int64_t, int64_t> *);
+    scoped_ptr_t<perfmon_result_t> output_stat(const std::pair<int64_t, int64_t> &);
+public:
+    perfmon_counter_ratio_t(perfmon_counter_t *_numerator, perfmon_counter_t *_denominator);
+};
+
 /* perfmon_sampler_t is a perfmon_t that keeps a log of events that happen.
  * When something happens, call the perfmon_sampler_t's record() method. The
  * perfmon_sampler_t will retain that record until 'length' ticks have passed.
@@ -135,6 +153,110 @@ public:
     void record(double value);
 };
 
+/* perfmon_histogram_t counts the values it's given in buckets whose upper bounds
+ * double from one bucket to the next, starting at `first_bound`; the last bucket
+ * also takes everything above. It reports how many values each bucket got since
+ * the perfmon was created, which shows the tail of a distribution (of latencies,
+ * say) that perfmon_sampler_t's min, avg and max hide.
+ */
+
+namespace perfmon_histogram {
+
+static const int num_buckets = 20;
+
+struct buckets_t {
+    int64_t counts[num_buckets];
+    buckets_t() {
+        std::fill(counts, counts + num_buckets, 0);
+    }
+};
+
+// The bucket that `value` goes into.
+int bucket_of(double first_bound, double value);
+
+}   /* namespace perfmon_histogram */
+
+class perfmon_histogram_t : public perfmon_perthread_t<perfmon_histogram::buckets_t> {
+    typedef perfmon_histogram::buckets_t buckets_t;
+
+    buckets_t *thread_data;
+    double first_bound;
+
+    void get_thread_stat(buckets_t *);
+    buckets_t combine_stats(const buckets_t *);
+    scoped_ptr_t<perfmon_result_t> output_stat(const buckets_t &);
+public:
+    explicit perfmon_histogram_t(double _first_bound);
+    virtual ~perfmon_histogram_t();
+    void record(double value);
+};
+
+/* perfmon_hdr_histogram_t keeps an HDR-style histogram of the values it's given
+ * over each interval of `length` ticks and reports the count, the 50th, 90th,
+ * 99th and 99.9th percentiles and the maximum of the last complete interval, like
+ * perfmon_sampler_t does for the average.  Values are counted in multiples of
+ * `resolution`; every power of two of those is split into 16 equal buckets, so a
+ * percentile is off by at most 1/16th of itself, and values from 2^36
+ * resolutions on are counted as 2^36.  The buckets of a thread are allocated when
+ * it first records a value, and only that thread touches them, so recording takes
+ * no lock.  With `per_thread`, the stat has the percentiles of every thread on its
+ * own, as `thread_000`, `thread_001` and so on, instead of those of all of them
+ * together.
+ */
+
+namespace perfmon_hdr_histogram {
+
+static const int sub_bucket_bits = 4;
+static const int sub_buckets = 1 << sub_bucket_bits;
+static const int max_value_bits = 36;
+static const int num_buckets = sub_buckets * (max_value_bits - sub_bucket_bits + 1);
+
+struct buckets_t {
+    int64_t counts[num_buckets];
+    int64_t total;
+    uint64_t max;
+    buckets_t() : total(0), max(0) {
+        std::fill(counts, counts + num_buckets, 0);
+    }
+    void aggregate(const buckets_t &other);
+};
+
+// The bucket that `value` (in resolutions) goes into.
+int bucket_of(uint64_t value);
+
+// The largest value that goes into `bucket`.
+uint64_t highest_value_of(int bucket);
+
+}   /* namespace perfmon_hdr_histogram */
+
+class perfmon_hdr_histogram_t : public perfmon_perthread_t<perfmon_hdr_histogram::buckets_t> {
+    typedef perfmon_hdr_histogram::buckets_t buckets_t;
+    struct thread_info_t {
+        buckets_t current_buckets, last_buckets;
+        int current_interval;
+    };
+
+    scoped_ptr_t<thread_info_t> thread_data[MAX_THREADS];
+
+    // Returns the buckets of the current thread, up to date as of `now`, or NULL
+    // if it has never recorded a value.
+    thread_info_t *update(ticks_t now);
+
+    void get_thread_stat(buckets_t *);
+    buckets_t combine_stats(const buckets_t *);
+    scoped_ptr_t<perfmon_result_t> output_stat(const buckets_t &);
+
+    ticks_t length;
+    double resolution;
+    bool per_thread;
+public:
+    perfmon_hdr_histogram_t(ticks_t _length, double _resolution, bool _per_thread = false);
+    virtual ~perfmon_hdr_histogram_t();
+    void record(double value);
+
+    scoped_ptr_t<perfmon_result_t> end_stats(void *data);
+};
+
 // One-pass variance calculation algorithm/datastructure taken from
 // http://www.cs.berkeley.edu/~mhoemmen/cs194/Tutorials/variance.pdf
 struct stddev_t {
@@ -6,9 +6,12 @@ class perfmon_collection_t;
 class perfmon_result_t;
 class perfmon_counter_t;
 class perfmon_sampler_t;
+class perfmon_histogram_t;
+class perfmon_hdr_histogram_t;
 struct perfmon_stddev_t;
 struct perfmon_duration_sampler_t;
 class perfmon_rate_monitor_t;
+class perfmon_counter_ratio_t;
 struct perfmon_function_t;
 
 #endif  // PERFMON_TYPES_HPP_
@@ -16,12 +16,17 @@
 #include "arch/timing.hpp"
 #include "concurrency/auto_drainer.hpp"
 #include "concurrency/cross_thread_signal.hpp"
+#include "concurrency/mutex.hpp"
+#include "concurrency/semaphore.hpp"
 #include "containers/archive/archive.hpp"
+#include "containers/scoped.hpp"
 #include "http/http.hpp"
 
 class auth_key_t;
 class auth_semilattice_metadata_t;
+template <class> class cross_thread_watchable_variable_t;
 template <class> class semilattice_readwrite_view_t;
+template <class> class vclock_t;
 
 enum protob_server_callback_mode_t {
     INLINE, //protobs that arrive will be called inline
@@ -29,6 +34,11 @@ enum protob_server_callback_mode_t {
     CORO_UNORDERED //a coroutine is spawned for each request and responses are sent back as they are completed
 };
 
+enum protob_server_listen_mode_t {
+    SINGLE_LISTENER, //one listener accepts the connections and hands them to the db threads in turn
+    LISTENER_PER_THREAD //every db thread accepts on a SO_REUSEPORT socket of its own and keeps its connections
+};
+
 template<class context_t>
 class http_conn_cache_t : public repeating_timer_callback_t {
 public:
@@ -104,7 +114,18 @@ private:
 // // Retrieves the protocol buffers object from an initialized request_t.
 // request_t::protob_type *underlying_protob_value(request_t *request);
 //
-// "request_t::protob_type" does not actually have to be defined.
+// // If *request is initialized and nothing else refers to its protocol buffers
+// // object, clears that for the next request and returns true.
+// bool recycle_protob_bearer(request_t *request);
+//
+// context_t must define the magic numbers of the handshake: `no_auth_magic_number`
+// and `auth_magic_number`, and `options_magic_number`, after whose authorization
+// key comes a word of options, of which `compress_responses_option` is the one
+// there is.
+//
+// "request_t::protob_type" does not actually have to be defined.  For
+// CORO_UNORDERED, the protocol buffers object must have a `token()`, and the
+// queries with the same token run in the order they came in.
 
 
 template <class request_t, class response_t, class context_t>
@@ -115,15 +136,33 @@ public:
                     boost::function<bool(request_t, response_t *, context_t *)> _f,  // NOLINT(readability/casting)
                     response_t (*_on_unparsable_query)(request_t, std::string),
                     boost::shared_ptr<semilattice_readwrite_view_t<auth_semilattice_metadata_t> > _auth_metadata,
-                    protob_server_callback_mode_t _cb_mode = CORO_ORDERED);
+                    protob_server_callback_mode_t _cb_mode = CORO_ORDERED,
+                    protob_server_listen_mode_t listen_mode = SINGLE_LISTENER);
     ~protob_server_t();
 
     int get_port() const;
 private:
+    class thread_listener_t;
 
-    void handle_conn(const scoped_ptr_t<tcp_conn_descriptor_t> &nconn, auto_drainer_t::lock_t);
-    void send(const response_t &, tcp_conn_t *conn, signal_t *closer) THROWS_ONLY(tcp_conn_write_closed_exc_t);
+    // `thread_listener` is the listener of our thread that accepted `nconn`, or
+    // NULL for SINGLE_LISTENER.
+    void handle_conn(const scoped_ptr_t<tcp_conn_descriptor_t> &nconn,
+                     thread_listener_t *thread_listener,
+                     auto_drainer_t::lock_t);
+    // `compress` is whether the client asked for compressed responses.
+    void send(const response_t &, tcp_conn_t *conn, bool compress, signal_t *closer) THROWS_ONLY(tcp_conn_write_closed_exc_t);
     static auth_key_t read_auth_key(tcp_conn_t *conn, signal_t *interruptor);
+    class unordered_queries_t;
+    // Runs a query of a CORO_UNORDERED connection, or answers it with
+    // `forced_response`, and sends the response as soon as it's ready.
+    void run_unordered_query(unordered_queries_t *queries,
+                             request_t request,
+                             bool force_response,
+                             response_t forced_response,
+                             auto_drainer_t::lock_t keepalive);
+    // The db thread with the fewest queries running, and then the fewest
+    // connections, for a connection that SINGLE_LISTENER accepted.
+    threadnum_t choose_thread();
 
     // For HTTP server
     http_res_t handle(const http_req_t &);
@@ -135,11 +174,94 @@ private:
 
     protob_server_callback_mode_t cb_mode;
 
+    /* How busy each db thread is with our connections.  choose_thread() reads all
+    of them from the home thread while the threads change them, so they're changed
+    and read atomically.  It must outlive the connections. */
+    struct thread_load_t {
+        int64_t connections;
+        int64_t queries;
+    };
+    scoped_array_t<cache_line_padded_t<thread_load_t> > thread_loads;
+
+    // Counts one towards `*count` while it exists.
+    class load_count_t {
+    public:
+        explicit load_count_t(int64_t *_count) : count(_count) {
+            __sync_add_and_fetch(count, 1);
+        }
+        ~load_count_t() {
+            __sync_sub_and_fetch(count, 1);
+        }
+    private:
+        int64_t *count;
+        DISABLE_COPYING(load_count_t);
+    };
+
+    /* The queries of a CORO_UNORDERED connection, which run in coroutines of their
+    own and are answered in whatever order they finish in.  At most
+    MAX_CONCURRENT_RDB_QUERIES_PER_CONNECTION of them run at a time, and the
+    connection reads no more until one of them is done.  Queries with the same token
+    take turns, so that a CONTINUE or a STOP can't overtake the query it's about. */
+    class unordered_queries_t {
+    public:
+        unordered_queries_t(tcp_conn_t *_conn, bool _compress_responses,
+                            context_t *_ctx, thread_load_t *_load,
+                            signal_t *_closer, int max_concurrent_queries)
+            : conn(_conn), compress_responses(_compress_responses), ctx(_ctx),
+              load(_load), closer(_closer), window(max_concurrent_queries) { }
+
+        struct token_queue_t {
+            token_queue_t() : queries(0) { }
+            // How many queries with the token are running or waiting to.
+            int queries;
+            mutex_t mutex;
+        };
+
+        tcp_conn_t *const conn;
+        const bool compress_responses;
+        context_t *const ctx;
+        thread_load_t *const load;
+        signal_t *const closer;
+        static_semaphore_t window;
+        // Responses are written whole, one at a time.
+        mutex_t write_mutex;
+        // The tokens that have queries running.
+        boost::ptr_map<int64_t, token_queue_t> tokens;
+        // Waits for the queries, so it's destroyed first.
+        auto_drainer_t drainer;
+    private:
+        DISABLE_COPYING(unordered_queries_t);
+    };
+
     /* WARNING: The order here is fragile. */
     cond_t main_shutting_down_cond;
     signal_t *shutdown_signal() { return &shutting_down_conds[get_thread_id().threadnum]; }
     boost::ptr_vector<cross_thread_signal_t> shutting_down_conds;
     auto_drainer_t auto_drainer;
+
+    // For LISTENER_PER_THREAD, a listener on a db thread, along with what its
+    // connections use on that thread: a drainer for them, and a copy of the auth
+    // metadata, which only the home thread can read.  The listener and the drainer
+    // go away on their thread, after shutdown_signal() is pulsed.
+    class thread_listener_t {
+    public:
+        thread_listener_t(protob_server_t *parent, threadnum_t thread,
+                          const std::set<ip_address_t> &local_addresses, int port);
+        ~thread_listener_t();
+        int get_port() const;
+        // Only on `thread`.
+        vclock_t<auth_key_t> get_auth_key();
+    private:
+        threadnum_t thread;
+        scoped_ptr_t<cross_thread_watchable_variable_t<auth_semilattice_metadata_t> >
+            auth_metadata;
+        scoped_ptr_t<auto_drainer_t> drainer;
+        scoped_ptr_t<tcp_listener_t> listener;
+        DISABLE_COPYING(thread_listener_t);
+    };
+    // Empty for SINGLE_LISTENER.
+    boost::ptr_vector<thread_listener_t> thread_listeners;
+
     struct pulse_on_destruct_t {
         explicit pulse_on_destruct_t(cond_t *_cond) : cond(_cond) { }
         ~pulse_on_destruct_t() { cond->pulse(); }
@@ -147,6 +269,7 @@ private:
     } pulse_sdc_on_shutdown;
     http_conn_cache_t<context_t> http_conn_cache;
 
+    // Empty for LISTENER_PER_THREAD.
     scoped_ptr_t<tcp_listener_t> tcp_listener;
 
     unsigned next_thread;
@@ -6,6 +6,7 @@
 
 #include <google/protobuf/stubs/common.h>
 
+#include <deque>
 #include <set>
 #include <string>
 
@@ -15,11 +16,16 @@
 
 #include "arch/arch.hpp"
 #include "arch/io/network.hpp"
+#include "arch/runtime/coroutines.hpp"
 #include "clustering/administration/metadata.hpp"
+#include "compression.hpp"
 #include "concurrency/cross_thread_signal.hpp"
+#include "concurrency/cross_thread_watchable.hpp"
+#include "config/args.hpp"
 #include "containers/auth_key.hpp"
 #include "rpc/semilattice/joins/vclock.hpp"
 #include "rpc/semilattice/view.hpp"
+#include "rpc/semilattice/watchable.hpp"
 #include "utils.hpp"
 
 template <class request_t, class response_t, class context_t>
@@ -29,15 +35,22 @@ protob_server_t<request_t, response_t, context_t>::protob_server_t(
     boost::function<bool(request_t, response_t *, context_t *)> _f,  // NOLINT(readability/casting)
     response_t (*_on_unparsable_query)(request_t, std::string),
     boost::shared_ptr<semilattice_readwrite_view_t<auth_semilattice_metadata_t> > _auth_metadata,
-    protob_server_callback_mode_t _cb_mode)
+    protob_server_callback_mode_t _cb_mode,
+    protob_server_listen_mode_t listen_mode)
     : f(_f),
       on_unparsable_query(_on_unparsable_query),
       auth_metadata(_auth_metadata),
       cb_mode(_cb_mode),
+      thread_loads(get_num_db_threads()),
       shutting_down_conds(get_num_threads()),
       pulse_sdc_on_shutdown(&main_shutting_down_cond),
       next_thread(0) {
 
+    for (size_t i = 0; i < thread_loads.size(); ++i) {
+        thread_loads[i].value.connections = 0;
+        thread_loads[i].value.queries = 0;
+    }
+
     for (int i = 0; i < get_num_threads(); ++i) {
         cross_thread_signal_t *s =
             new cross_thread_signal_t(&main_shutting_down_cond, threadnum_t(i));
@@ -46,11 +59,22 @@ protob_server_t<request_t, response_t, context_t>::protob_server_t(
     }
 
     try {
-        tcp_listener.init(new tcp_listener_t(
-            local_addresses,
-            port,
-            boost::bind(&protob_server_t<request_t, response_t, context_t>::handle_conn,
-                        this, _1, auto_drainer_t::lock_t(&auto_drainer))));
+        if (listen_mode == LISTENER_PER_THREAD) {
+            // The first listener picks the port if we weren't given one, and the
+            // others share it.
+            for (int i = 0; i < get_num_db_threads(); ++i) {
+                thread_listeners.push_back(new thread_listener_t(
+                    this, threadnum_t(i), local_addresses,
+                    i == 0 ? port : thread_listeners[0].get_port()));
+            }
+        } else {
+            tcp_listener.init(new tcp_listener_t(
+                local_addresses,
+                port,
+                boost::bind(&protob_server_t<request_t, response_t, context_t>::handle_conn,
+                            this, _1, static_cast<thread_listener_t *>(NULL),
+                            auto_drainer_t::lock_t(&auto_drainer))));
+        }
     } catch (const address_in_use_exc_t &ex) {
         throw address_in_use_exc_t(strprintf("Could not bind to RDB protocol port: %s", ex.what()));
     }
@@ -60,7 +84,48 @@ protob_server_t<request_t, response_t, context_t>::~protob_server_t() { }
 
 template <class request_t, class response_t, class context_t>
 int protob_server_t<request_t, response_t, context_t>::get_port() const {
-    return tcp_listener->get_port();
+    return thread_listeners.empty()
+        ? tcp_listener->get_port()
+        : thread_listeners[0].get_port();
+}
+
+template <class request_t, class response_t, class context_t>
+protob_server_t<request_t, response_t, context_t>::thread_listener_t::thread_listener_t(
+        protob_server_t *parent, threadnum_t _thread,
+        const std::set<ip_address_t> &local_addresses, int port)
+    : thread(_thread),
+      auth_metadata(new cross_thread_watchable_variable_t<auth_semilattice_metadata_t>(
+          clone_ptr_t<watchable_t<auth_semilattice_metadata_t> >(
+              new semilattice_watchable_t<auth_semilattice_metadata_t>(
+                  parent->auth_metadata)),
+          thread)) {
+    on_thread_t thread_switcher(thread);
+    drainer.init(new auto_drainer_t);
+    listener.init(new tcp_listener_t(
+        local_addresses,
+        port,
+        boost::bind(&protob_server_t<request_t, response_t, context_t>::handle_conn,
+                    parent, _1, this, auto_drainer_t::lock_t(drainer.get())),
+        true));
+}
+
+template <class request_t, class response_t, class context_t>
+protob_server_t<request_t, response_t, context_t>::thread_listener_t::~thread_listener_t() {
+    // The auth metadata goes away on the home thread, where it came from.
+    on_thread_t thread_switcher(thread);
+    listener.reset();
+    drainer.reset();
+}
+
+template <class request_t, class response_t, class context_t>
+int protob_server_t<request_t, response_t, context_t>::thread_listener_t::get_port() const {
+    return listener->get_port();
+}
+
+template <class request_t, class response_t, class context_t>
+vclock_t<auth_key_t>
+protob_server_t<request_t, response_t, context_t>::thread_listener_t::get_auth_key() {
+    return auth_metadata->get_watchable()->get().auth_key;
 }
 
 struct protob_server_exc_t : public std::exception {
@@ -97,12 +162,21 @@ auth_key_t protob_server_t<request_t, response_t, context_t>::read_auth_key(tcp_
 template <class request_t, class response_t, class context_t>
 void protob_server_t<request_t, response_t, context_t>::handle_conn(
     const scoped_ptr_t<tcp_conn_descriptor_t> &nconn,
+    thread_listener_t *thread_listener,
     auto_drainer_t::lock_t keepalive) {
 
     // This must be read here because of home threads and stuff
-    const vclock_t<auth_key_t> auth_vclock = auth_metadata->get().auth_key;
-
-    threadnum_t chosen_thread = threadnum_t((next_thread++) % get_num_db_threads());
+    const vclock_t<auth_key_t> auth_vclock = thread_listener == NULL
+        ? auth_metadata->get().auth_key
+        : thread_listener->get_auth_key();
+
+    // A listener of our own thread keeps its connections here.
+    threadnum_t chosen_thread = thread_listener != NULL
+        ? get_thread_id()
+        : choose_thread();
+    // Counted before we get there, so that the next connections see it.
+    thread_load_t *load = &thread_loads[chosen_thread.threadnum].value;
+    load_count_t connection_count(&load->connections);
     cross_thread_signal_t ct_keepalive(keepalive.get_drain_signal(), chosen_thread);
     on_thread_t rethreader(chosen_thread);
 
@@ -121,6 +195,7 @@ void protob_server_t<request_t, response_t, context_t>::handle_conn(
 #endif  // __linux
 
     std::string init_error;
+    bool compress_responses = false;
 
     try {
         if (auth_vclock.in_conflict()) {
@@ -134,11 +209,20 @@ void protob_server_t<request_t, response_t, context_t>::handle_conn(
             if (!auth_vclock.get().str().empty()) {
                 throw protob_server_exc_t("authorization required, client does not support it");
             }
-        } else if (client_magic_number == context_t::auth_magic_number) {
+        } else if (client_magic_number == context_t::auth_magic_number
+                   || client_magic_number == context_t::options_magic_number) {
             auth_key_t provided_auth = read_auth_key(conn.get(), &ct_keepalive);
             if (!timing_sensitive_equals(provided_auth, auth_vclock.get())) {
                 throw protob_server_exc_t("incorrect authorization key");
             }
+            if (client_magic_number == context_t::options_magic_number) {
+                uint32_t options;
+                conn->read(&options, sizeof(options), &ct_keepalive);
+                if ((options & ~context_t::compress_responses_option) != 0) {
+                    throw protob_server_exc_t("client asked for unknown protocol options");
+                }
+                compress_responses = (options & context_t::compress_responses_option) != 0;
+            }
             const char *success_msg = "SUCCESS";
             conn->write(success_msg, strlen(success_msg) + 1, &ct_keepalive);
         } else {
@@ -164,26 +248,64 @@ void protob_server_t<request_t, response_t, context_t>::handle_conn(
         return;
     }
 
-    //TODO figure out how to do this with less copying
+    // Destroyed before `conn` and `ctx`, which it waits for its queries to be done
+    // with.
+    scoped_ptr_t<unordered_queries_t> unordered_queries;
+    if (cb_mode == CORO_UNORDERED) {
+        unordered_queries.init(new unordered_queries_t(
+            conn.get(), compress_responses, &ctx, load, &ct_keepalive,
+            MAX_CONCURRENT_RDB_QUERIES_PER_CONNECTION));
+    }
+
+    // The requests that were small enough to recycle, oldest first.  Once nothing
+    // refers to one anymore, the next request is parsed into its protocol buffers
+    // object, which keeps the memory of its fields.
+    std::deque<request_t> recent_requests;
+
     for (;;) {
         request_t request;
-        make_empty_protob_bearer(&request);
+        if (!recent_requests.empty()) {
+            // If it's still in use, it's left to whoever is using it.
+            request = recent_requests.front();
+            recent_requests.pop_front();
+        }
+        if (!recycle_protob_bearer(&request)) {
+            make_empty_protob_bearer(&request);
+        }
         bool force_response = false;
         response_t forced_response;
         std::string err;
         try {
+            // The size goes through the read buffer, so that a burst of small
+            // requests takes one read of the socket, not two reads each.
             int32_t size;
-            conn->read(&size, sizeof(int32_t), &ct_keepalive);
+            memcpy(&size, conn->peek(sizeof(int32_t), &ct_keepalive).beg, sizeof(int32_t));
             if (size < 0) {
+                conn->pop(sizeof(int32_t), &ct_keepalive);
                 err = strprintf("Negative protobuf size (%d).", size);
                 forced_response = on_unparsable_query(request_t(), err);
                 force_response = true;
             } else {
-                scoped_array_t<char> data(size);
-                conn->read(data.data(), size, &ct_keepalive);
-
-                const bool res
-                    = underlying_protob_value(&request)->ParseFromArray(data.data(), size);
+                bool res;
+                if (size <= PROTOB_BUFFERED_REQUEST_MAX_SIZE) {
+                    // Parse it right out of the read buffer.
+                    const_charslice data
+                        = conn->peek(sizeof(int32_t) + size, &ct_keepalive);
+                    res = underlying_protob_value(&request)->ParseFromArray(
+                        data.beg + sizeof(int32_t), size);
+                    conn->pop(sizeof(int32_t) + size, &ct_keepalive);
+                    if (res) {
+                        recent_requests.push_back(request);
+                        if (recent_requests.size() > PROTOB_RECYCLED_REQUESTS_PER_CONNECTION) {
+                            recent_requests.pop_front();
+                        }
+                    }
+                } else {
+                    conn->pop(sizeof(int32_t), &ct_keepalive);
+                    scoped_array_t<char> data(size);
+                    conn->read(data.data(), size, &ct_keepalive);
+                    res = underlying_protob_value(&request)->ParseFromArray(data.data(), size);
+                }
                 if (!res) {
                     err = "Client is buggy (failed to deserialize protobuf).";
                     forced_response = on_unparsable_query(request, err);
@@ -200,12 +322,16 @@ void protob_server_t<request_t, response_t, context_t>::handle_conn(
             switch (cb_mode) {
             case INLINE:
                 if (force_response) {
-                    send(forced_response, conn.get(), &ct_keepalive);
+                    send(forced_response, conn.get(), compress_responses, &ct_keepalive);
                 } else {
                     response_t response;
-                    bool response_needed = f(request, &response, &ctx);
+                    bool response_needed;
+                    {
+                        load_count_t query_count(&load->queries);
+                        response_needed = f(request, &response, &ctx);
+                    }
                     if (response_needed) {
-                        send(response, conn.get(), &ct_keepalive);
+                        send(response, conn.get(), compress_responses, &ct_keepalive);
                     }
                 }
                 break;
@@ -213,7 +339,12 @@ void protob_server_t<request_t, response_t, context_t>::handle_conn(
                 crash("unimplemented");
                 break;
             case CORO_UNORDERED:
-                crash("unimplemented");
+                // Reading the next query waits until there's room for it.
+                unordered_queries->window.co_lock();
+                coro_t::spawn_now_dangerously(boost::bind(
+                    &protob_server_t<request_t, response_t, context_t>::run_unordered_query,
+                    this, unordered_queries.get(), request, force_response,
+                    forced_response, auto_drainer_t::lock_t(&unordered_queries->drainer)));
                 break;
             default:
                 crash("unreachable");
@@ -227,16 +358,110 @@ void protob_server_t<request_t, response_t, context_t>::handle_conn(
     }
 }
 
+template <class request_t, class response_t, class context_t>
+void protob_server_t<request_t, response_t, context_t>::run_unordered_query(
+    unordered_queries_t *queries,
+    request_t request,
+    bool force_response,
+    response_t forced_response,
+    auto_drainer_t::lock_t) {
+
+    response_t response;
+    bool response_needed = true;
+    if (force_response) {
+        response = forced_response;
+    } else {
+        int64_t token = underlying_protob_value(&request)->token();
+        typename boost::ptr_map<int64_t, typename unordered_queries_t::token_queue_t>::iterator
+            it = queries->tokens.find(token);
+        if (it == queries->tokens.end()) {
+            it = queries->tokens.insert(
+                token, new typename unordered_queries_t::token_queue_t).first;
+        }
+        typename unordered_queries_t::token_queue_t *queue = it->second;
+        ++queue->queries;
+        {
+            // We got here straight from the connection's coroutine, so the queries
+            // with the token wait for the mutex in the order they came in.
+            mutex_t::acq_t token_acq(&queue->mutex);
+            load_count_t query_count(&queries->load->queries);
+            response_needed = f(request, &response, queries->ctx);
+        }
+        if (--queue->queries == 0) {
+            queries->tokens.erase(token);
+        }
+    }
+
+    if (response_needed) {
+        try {
+            mutex_t::acq_t write_acq(&queries->write_mutex);
+            send(response, queries->conn, queries->compress_responses, queries->closer);
+        } catch (const tcp_conn_write_closed_exc_t &) {
+            // The connection stops reading queries when its client goes away.
+        }
+    }
+    queries->window.unlock();
+}
+
+template <class request_t, class response_t, class context_t>
+threadnum_t protob_server_t<request_t, response_t, context_t>::choose_thread() {
+    // Ties go round-robin, so that idle threads still share the connections.
+    const int num_threads = get_num_db_threads();
+    const int start = (next_thread++) % num_threads;
+    int best = start;
+    int64_t best_queries = __sync_fetch_and_add(&thread_loads[best].value.queries, 0);
+    int64_t best_connections
+        = __sync_fetch_and_add(&thread_loads[best].value.connections, 0);
+    for (int i = 1; i < num_threads; ++i) {
+        const int thread = (start + i) % num_threads;
+        thread_load_t *load = &thread_loads[thread].value;
+        const int64_t queries = __sync_fetch_and_add(&load->queries, 0);
+        const int64_t connections = __sync_fetch_and_add(&load->connections, 0);
+        if (queries < best_queries
+            || (queries == best_queries && connections < best_connections)) {
+            best = thread;
+            best_queries = queries;
+            best_connections = connections;
+        }
+    }
+    return threadnum_t(best);
+}
+
 template <class request_t, class response_t, class context_t>
 void protob_server_t<request_t, response_t, context_t>::send(
     const response_t &res,
     tcp_conn_t *conn,
+    bool compress,
     signal_t *closer) THROWS_ONLY(tcp_conn_write_closed_exc_t) {
-    int size = res.ByteSize();
-    conn->write(&size, sizeof(res.ByteSize()), closer);
+    int32_t size = res.ByteSize();
     scoped_array_t<char> data(size);
-
     res.SerializeToArray(data.data(), size);
+
+    if (!compress) {
+        conn->write(&size, sizeof(size), closer);
+        conn->write(data.data(), size, closer);
+        return;
+    }
+
+    // The size on the wire, and then the size of the protobuf if it's compressed
+    // or zero if it isn't (see `ql2.proto`).
+    int32_t header[2];
+    if (size >= PROTOB_COMPRESS_RESPONSE_MIN_SIZE) {
+        // We only want it if it gets smaller.
+        scoped_array_t<char> compressed(size - 1);
+        const size_t compressed_size
+            = lz_compress(data.data(), size, compressed.data(), compressed.size());
+        if (compressed_size != 0) {
+            header[0] = compressed_size;
+            header[1] = size;
+            conn->write(header, sizeof(header), closer);
+            conn->write(compressed.data(), compressed_size, closer);
+            return;
+        }
+    }
+    header[0] = size;
+    header[1] = 0;
+    conn->write(header, sizeof(header), closer);
     conn->write(data.data(), size, closer);
 }
 
@@ -296,7 +521,10 @@ http_res_t protob_server_t<request_t, response_t, context_t>::handle(
         bool response_needed;
         response_t response;
         switch (cb_mode) {
-        case INLINE: {
+        // Every HTTP request is a call of its own, so they don't wait for each
+        // other anyway.
+        case INLINE:
+        case CORO_UNORDERED: {
             boost::shared_ptr<typename http_conn_cache_t<context_t>::http_conn_t> conn =
                 http_conn_cache.find(conn_id);
             if (!parseSucceeded) {
@@ -315,7 +543,6 @@ http_res_t protob_server_t<request_t, response_t, context_t>::handle(
             }
         } break;
         case CORO_ORDERED:
-        case CORO_UNORDERED:
             crash("unimplemented");
         default:
             crash("unreachable");
@@ -289,6 +289,10 @@ template <class protocol_t>
 class chunk_fun_callback_t {
 public:
     virtual void send_chunk(const typename protocol_t::backfill_chunk_t &, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) = 0;
+    /* Says that every chunk of `region` has been sent, so the backfillee can
+    record that part of the backfill as done. Stores that can't tell need not
+    call it. */
+    virtual void send_checkpoint(const typename protocol_t::region_t &region, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) = 0;
 
 protected:
     chunk_fun_callback_t() { }
@@ -0,0 +1,210 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "rdb_protocol/aggregation.hpp"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "containers/archive/stl_types.hpp"
+#include "rdb_protocol/batching.hpp"
+#include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/error.hpp"
+
+namespace ql {
+
+bool parse_group_aggregator(const std::string &name, group_aggregator_t *out) {
+    if (name == "COUNT") {
+        *out = group_aggregator_t::COUNT;
+    } else if (name == "SUM") {
+        *out = group_aggregator_t::SUM;
+    } else if (name == "AVG") {
+        *out = group_aggregator_t::AVG;
+    } else if (name == "MIN") {
+        *out = group_aggregator_t::MIN;
+    } else if (name == "MAX") {
+        *out = group_aggregator_t::MAX;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+group_accumulators_t::accumulator_t *group_accumulators_t::get(
+        const counted_t<const datum_t> &group) {
+    std::string key;
+    append_sort_key(*group, &key);
+    auto it = groups.find(key);
+    if (it == groups.end()) {
+        rcheck_datum(groups.size() < array_size_limit(), base_exc_t::GENERIC,
+                     strprintf("Too many groups (> %zu) in GROUPBY.",
+                               array_size_limit()).c_str());
+        it = groups.insert(std::make_pair(std::move(key), accumulator_t())).first;
+        it->second.group = group;
+    }
+    return &it->second;
+}
+
+static void take_extreme(group_aggregator_t aggregator,
+                         const counted_t<const datum_t> &candidate,
+                         counted_t<const datum_t> *extreme) {
+    if (!extreme->has()
+        || (aggregator == group_aggregator_t::MIN
+            ? *candidate < **extreme
+            : *candidate > **extreme)) {
+        *extreme = candidate;
+    }
+}
+
+void group_accumulators_t::add(const counted_t<const datum_t> &group,
+                               const counted_t<const datum_t> &field) {
+    accumulator_t *acc = get(group);
+    switch (aggregator) {
+    case group_aggregator_t::COUNT:
+        acc->count += 1;
+        break;
+    case group_aggregator_t::SUM: // fallthru
+    case group_aggregator_t::AVG:
+        if (field.has()) {
+            acc->count += 1;
+            acc->sum += field->as_num();
+        }
+        break;
+    case group_aggregator_t::MIN: // fallthru
+    case group_aggregator_t::MAX:
+        if (field.has()) {
+            acc->count += 1;
+            take_extreme(aggregator, field, &acc->extreme);
+        }
+        break;
+    default: unreachable();
+    }
+}
+
+void group_accumulators_t::add_summary(const counted_t<const datum_t> &group,
+                                       double rows, double with_field, double sum) {
+    accumulator_t *acc = get(group);
+    switch (aggregator) {
+    case group_aggregator_t::COUNT:
+        acc->count += rows;
+        break;
+    case group_aggregator_t::SUM: // fallthru
+    case group_aggregator_t::AVG:
+        acc->count += with_field;
+        acc->sum += sum;
+        break;
+    case group_aggregator_t::MIN: // fallthru
+    case group_aggregator_t::MAX: // fallthru
+    default: unreachable();
+    }
+}
+
+void group_accumulators_t::merge(const accumulator_t &other, accumulator_t *acc) const {
+    acc->count += other.count;
+    acc->sum += other.sum;
+    if (other.extreme.has()) {
+        take_extreme(aggregator, other.extreme, &acc->extreme);
+    }
+}
+
+void group_accumulators_t::add(const group_accumulators_t &other) {
+    r_sanity_check(other.aggregator == aggregator);
+    for (auto it = other.groups.begin(); it != other.groups.end(); ++it) {
+        auto jt = groups.find(it->first);
+        if (jt == groups.end()) {
+            rcheck_datum(groups.size() < array_size_limit(), base_exc_t::GENERIC,
+                         strprintf("Too many groups (> %zu) in GROUPBY.",
+                                   array_size_limit()).c_str());
+            groups.insert(*it);
+        } else {
+            merge(it->second, &jt->second);
+        }
+    }
+}
+
+struct group_key_less_t {
+    template <class T>
+    bool operator()(const T *a, const T *b) const {
+        return a->first < b->first;
+    }
+};
+
+counted_t<const datum_t> group_accumulators_t::to_arr() const {
+    // The sort keys order the groups the way they compare as datums.
+    std::vector<const std::pair<const std::string, accumulator_t> *> sorted;
+    sorted.reserve(groups.size());
+    for (auto it = groups.begin(); it != groups.end(); ++it) {
+        sorted.push_back(&*it);
+    }
+    std::sort(sorted.begin(), sorted.end(), group_key_less_t());
+
+    datum_ptr_t arr(datum_t::R_ARRAY);
+    for (auto it = sorted.begin(); it != sorted.end(); ++it) {
+        const accumulator_t &acc = (*it)->second;
+        counted_t<const datum_t> reduction;
+        switch (aggregator) {
+        case group_aggregator_t::COUNT:
+            reduction = make_counted<const datum_t>(acc.count);
+            break;
+        case group_aggregator_t::SUM:
+            reduction = make_counted<const datum_t>(acc.sum);
+            break;
+        case group_aggregator_t::AVG:
+            rcheck_datum(acc.count != 0, base_exc_t::GENERIC, "Cannot divide by zero.");
+            reduction = make_counted<const datum_t>(acc.sum / acc.count);
+            break;
+        case group_aggregator_t::MIN: // fallthru
+        case group_aggregator_t::MAX:
+            if (!acc.extreme.has()) {
+                continue;
+            }
+            reduction = acc.extreme;
+            break;
+        default: unreachable();
+        }
+        datum_ptr_t obj(datum_t::R_OBJECT);
+        UNUSED bool b1 = obj.add("group", acc.group);
+        UNUSED bool b2 = obj.add("reduction", reduction);
+        arr.add(obj.to_counted());
+    }
+    return arr.to_counted();
+}
+
+void group_accumulators_t::rdb_serialize(write_message_t &msg /* NOLINT */) const {
+    msg << aggregator;
+    msg << static_cast<uint64_t>(groups.size());
+    for (auto it = groups.begin(); it != groups.end(); ++it) {
+        msg << it->first;
+        msg << it->second.group;
+        msg << it->second.count;
+        msg << it->second.sum;
+        msg << empty_ok(it->second.extreme);
+    }
+}
+
+archive_result_t group_accumulators_t::rdb_deserialize(read_stream_t *s) {
+    archive_result_t res = deserialize(s, &aggregator);
+    if (res) return res;
+    uint64_t size;
+    res = deserialize(s, &size);
+    if (res) return res;
+    groups.clear();
+    groups.reserve(size);
+    for (uint64_t i = 0; i < size; ++i) {
+        std::string key;
+        accumulator_t acc;
+        res = deserialize(s, &key);
+        if (res) return res;
+        res = deserialize(s, &acc.group);
+        if (res) return res;
+        res = deserialize(s, &acc.count);
+        if (res) return res;
+        res = deserialize(s, &acc.sum);
+        if (res) return res;
+        res = deserialize(s, deserialize_deref(empty_ok(acc.extreme)));
+        if (res) return res;
+        groups.insert(std::make_pair(std::move(key), std::move(acc)));
+    }
+    return ARCHIVE_SUCCESS;
+}
+
+}  // namespace ql
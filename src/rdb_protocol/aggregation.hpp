@@ -0,0 +1,89 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_AGGREGATION_HPP_
+#define RDB_PROTOCOL_AGGREGATION_HPP_
+
+#include <string>
+#include <unordered_map>
+
+#include "errors.hpp"
+#include "containers/archive/archive.hpp"
+#include "containers/counted.hpp"
+#include "rpc/serialize_macros.hpp"
+
+namespace ql {
+
+class datum_t;
+
+// The aggregators of `groupby`.
+enum class group_aggregator_t {
+    COUNT = 0,
+    SUM = 1,
+    AVG = 2,
+    MIN = 3,
+    MAX = 4
+};
+ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(
+    group_aggregator_t, int8_t, group_aggregator_t::COUNT, group_aggregator_t::MAX);
+
+// Sets `*out` to the aggregator called `name` ("COUNT", "SUM", ...).  Returns
+// false if there is none.
+MUST_USE bool parse_group_aggregator(const std::string &name, group_aggregator_t *out);
+
+/* The state of a `groupby`: an accumulator for every group, in a hash table by the
+sort key of the group (see append_sort_key()).  Accumulators are plain numbers (and
+a datum for MIN and MAX) instead of the datums the functions of a grouped map
+reduce would build for every row, so the shards fold their rows into them without
+calling any ReQL functions, and the parser merges the ones of the shards the same
+way. */
+class group_accumulators_t {
+public:
+    group_accumulators_t() : aggregator(group_aggregator_t::COUNT) { }
+    explicit group_accumulators_t(group_aggregator_t _aggregator)
+        : aggregator(_aggregator) { }
+
+    // Adds a row of `group` whose aggregated field is `field`, which is empty if
+    // the row doesn't have one.  Throws if there get to be more groups than fit
+    // in an array.
+    void add(const counted_t<const datum_t> &group,
+             const counted_t<const datum_t> &field);
+    void add(const group_accumulators_t &other);
+    // Adds `rows` rows of `group` at once, `with_field` of which have the field,
+    // which sums up to `sum`, like the summaries of an aggregate index have them.
+    // Only for COUNT, SUM and AVG.
+    void add_summary(const counted_t<const datum_t> &group,
+                     double rows, double with_field, double sum);
+
+    size_t size() const { return groups.size(); }
+
+    // The `{group, reduction}` objects of the groups in order of the groups, like
+    // grouped_map_reduce returns them.  Groups without any field to take the
+    // MIN or MAX of are left out.
+    counted_t<const datum_t> to_arr() const;
+
+    friend class write_message_t;
+    void rdb_serialize(write_message_t &msg /* NOLINT */) const;
+    friend class archive_deserializer_t;
+    archive_result_t rdb_deserialize(read_stream_t *s);
+
+private:
+    struct accumulator_t {
+        accumulator_t() : count(0), sum(0) { }
+        counted_t<const datum_t> group;
+        // How many rows there were, or for anything but COUNT, how many of them
+        // had the field.
+        double count;
+        double sum;
+        // The least or greatest field so far, for MIN and MAX.
+        counted_t<const datum_t> extreme;
+    };
+
+    accumulator_t *get(const counted_t<const datum_t> &group);
+    void merge(const accumulator_t &other, accumulator_t *acc) const;
+
+    group_aggregator_t aggregator;
+    std::unordered_map<std::string, accumulator_t> groups;
+};
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_AGGREGATION_HPP_
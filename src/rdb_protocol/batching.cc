@@ -2,6 +2,7 @@
 
 #include "rdb_protocol/batching.hpp"
 
+#include "config/args.hpp"
 #include "rdb_protocol/datum.hpp"
 #include "rdb_protocol/env.hpp"
 #include "rdb_protocol/error.hpp"
@@ -61,6 +62,10 @@ batchspec_t batchspec_t::with_at_most(uint64_t _max_els) const {
         end_time);
 }
 
+batchspec_t batchspec_t::with_max_size(int64_t max_size) const {
+    return batchspec_t(batch_type, els_left, max_size, end_time);
+}
+
 batcher_t batchspec_t::to_batcher() const {
     microtime_t real_end_time =
         batch_type == batch_type_t::NORMAL && end_time > current_microtime()
@@ -86,6 +91,70 @@ batcher_t::batcher_t(
       size_left(size),
       end_time(_end_time) { }
 
+batch_sizer_t::batch_sizer_t()
+    : max_size(ADAPTIVE_BATCH_FIRST_SIZE), batch_start(0), batch_end(0), sent_time(0),
+      batch_size(0), has_fetch_latency(false), fetch_latency(0) { }
+
+void batch_sizer_t::note_request() {
+    if (sent_time != 0) {
+        has_fetch_latency = true;
+        fetch_latency = current_microtime() - sent_time;
+    }
+}
+
+batchspec_t batch_sizer_t::next_batchspec(env_t *env) {
+    counted_t<val_t> vconf = env->global_optargs.get_optarg(env, "batch_conf");
+    counted_t<const datum_t> conf, adaptive_d, max_size_d;
+    if (vconf.has()) {
+        conf = vconf->as_datum();
+        adaptive_d = conf->get("adaptive", NOTHROW);
+        max_size_d = conf->get("max_size", NOTHROW);
+    }
+    batchspec_t batchspec = batchspec_t::user(batch_type_t::NORMAL, conf);
+    if (!adaptive_d.has() || !adaptive_d->as_bool()) {
+        return batchspec;
+    }
+
+    const int64_t limit = max_size_d.has()
+        ? max_size_d->as_int()
+        : ADAPTIVE_BATCH_MAX_SIZE;
+    if (has_fetch_latency) {
+        microtime_t compute_time = batch_end - batch_start;
+        if (fetch_latency > compute_time && batch_size * 2 >= max_size) {
+            max_size *= ADAPTIVE_BATCH_GROWTH;
+        }
+        has_fetch_latency = false;
+    }
+    max_size = std::min(limit, max_size);
+    batch_start = current_microtime();
+    return batchspec.with_max_size(max_size);
+}
+
+void batch_sizer_t::note_computed() {
+    batch_end = current_microtime();
+}
+
+void batch_sizer_t::note_sent(int64_t size) {
+    sent_time = current_microtime();
+    batch_size = size;
+}
+
 size_t array_size_limit() { return 100000; }
 
+size_t eq_join_batch_keys(env_t *env) {
+    counted_t<val_t> vconf = env->global_optargs.get_optarg(env, "batch_conf");
+    counted_t<const datum_t> join_keys_d;
+    if (vconf.has()) {
+        join_keys_d = vconf->as_datum()->get("join_keys", NOTHROW);
+    }
+    if (!join_keys_d.has()) {
+        return EQ_JOIN_BATCH_KEYS;
+    }
+    int64_t join_keys = join_keys_d->as_int();
+    rcheck_datum(join_keys >= 1, base_exc_t::GENERIC,
+                 strprintf("`join_keys` must be at least 1 (got %" PRIi64 ").",
+                           join_keys).c_str());
+    return join_keys;
+}
+
 } // namespace ql
@@ -64,6 +64,9 @@ public:
     batch_type_t get_batch_type() const { return batch_type; }
     batchspec_t with_new_batch_type(batch_type_t new_batch_type) const;
     batchspec_t with_at_most(uint64_t max_els) const;
+    batchspec_t with_max_size(int64_t max_size) const;
+    int64_t get_max_size() const { return size_left; }
+    int64_t get_max_els() const { return els_left; }
     batcher_t to_batcher() const;
     RDB_MAKE_ME_SERIALIZABLE_4(batch_type, els_left, size_left, end_time);
 private:
@@ -77,9 +80,45 @@ private:
     microtime_t end_time;
 };
 
+/* Sizes the batches of a stream that the client reads one batch at a time.  That's
+always batchspec_t::user() unless the `batch_conf` optarg has `adaptive: true`, in
+which case the first batch is small and the ones after it grow geometrically as
+long as the client takes longer to come back for the next batch (the round trip,
+mostly) than the batch took to compute and the batch came near its size budget:
+on a slow link, fewer and bigger batches spend less of the time waiting on round
+trips.  Streams that compute slowly or send few rows keep their small batches. */
+class batch_sizer_t {
+public:
+    batch_sizer_t();
+
+    // Notes that the client asked for the next batch.
+    void note_request();
+    // The batchspec of the next batch, which is being computed from now on.  The
+    // batch may be read ahead of the request for it, see stream_cache2_t.
+    batchspec_t next_batchspec(env_t *env);
+    // Notes that the batch is computed.
+    void note_computed();
+    // Notes that the batch went to the client with `size` bytes.
+    void note_sent(int64_t size);
+
+private:
+    // The size budget of the next adaptive batch.
+    int64_t max_size;
+    microtime_t batch_start, batch_end, sent_time;
+    int64_t batch_size;
+    // How long the client took to ask for a batch after the one before, if that
+    // hasn't been used to size a batch yet.
+    bool has_fetch_latency;
+    microtime_t fetch_latency;
+};
+
 // TODO: make user-tunable.
 size_t array_size_limit();
 
+// How many left keys an eq_join looks up at once, `join_keys` in the `batch_conf`
+// optarg or EQ_JOIN_BATCH_KEYS.
+size_t eq_join_batch_keys(env_t *env);
+
 } // namespace ql
 
 #endif // RDB_PROTOCOL_BATCHING_HPP_
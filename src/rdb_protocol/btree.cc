@@ -1,27 +1,41 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "rdb_protocol/btree.hpp"
 
+#include <algorithm>
+#include <set>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "errors.hpp"
 #include <boost/bind.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
 #include <boost/variant.hpp>
 
 #include "btree/backfill.hpp"
+#include "btree/bulk_load.hpp"
 #include "btree/concurrent_traversal.hpp"
 #include "btree/erase_range.hpp"
 #include "btree/get_distribution.hpp"
+#include "btree/leaf_node.hpp"
+#include "btree/node.hpp"
 #include "btree/operations.hpp"
 #include "btree/parallel_traversal.hpp"
+#include "btree/superblock.hpp"
 #include "buffer_cache/serialize_onto_blob.hpp"
+#include "concurrency/pmap.hpp"
+#include "config/args.hpp"
 #include "containers/archive/boost_types.hpp"
 #include "containers/archive/buffer_group_stream.hpp"
+#include "containers/archive/string_stream.hpp"
 #include "containers/archive/vector_stream.hpp"
 #include "containers/scoped.hpp"
 #include "rdb_protocol/blob_wrapper.hpp"
+#include "rdb_protocol/changefeed.hpp"
+#include "rdb_protocol/filter_program.hpp"
 #include "rdb_protocol/func.hpp"
 #include "rdb_protocol/lazy_json.hpp"
+#include "rdb_protocol/text_index.hpp"
 #include "rdb_protocol/transform_visitors.hpp"
 
 value_sizer_t<rdb_value_t>::value_sizer_t(block_size_t bs) : block_size_(bs) { }
@@ -82,6 +96,95 @@ void rdb_get(const store_key_t &store_key, btree_slice_t *slice, transaction_t *
     }
 }
 
+// A node on the path of an rdb_get_multi() from the root to the leaf of the last
+// key, and the greatest key it can have, unless its subtree is on the right edge of
+// the tree.
+struct multi_get_level_t {
+    multi_get_level_t() : bounded(false) { }
+    buf_lock_t buf;
+    bool bounded;
+    store_key_t last_key;
+};
+
+static void acquire_multi_get_level(transaction_t *txn, block_id_t node_id,
+                                    eviction_priority_t eviction_priority,
+                                    multi_get_level_t *level, profile::trace_t *trace) {
+    profile::starter_t starter("Acquire a block for read.", trace);
+    buf_lock_t tmp(txn, node_id, rwi_read);
+    tmp.set_eviction_priority(eviction_priority);
+    level->buf.swap(tmp);
+}
+
+void rdb_get_multi(const std::vector<store_key_t> &keys, btree_slice_t *slice,
+        transaction_t *txn, superblock_t *superblock,
+        multi_point_read_response_t *response, profile::trace_t *trace) {
+    std::vector<store_key_t> sorted(keys);
+    std::sort(sorted.begin(), sorted.end());
+    sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+
+    const block_id_t root_id = superblock->get_root_block_id();
+    rassert(root_id != SUPERBLOCK_ID);
+    if (root_id == NULL_BLOCK_ID) {
+        // There is no root, so the tree is empty.
+        superblock->release();
+        return;
+    }
+
+    // The path to the last leaf stays locked, so that the next keys, which are
+    // greater, only go back up as far as the first node that can have them
+    // instead of every key going down from the root.
+    boost::ptr_vector<multi_get_level_t> path;
+    path.push_back(new multi_get_level_t());
+    acquire_multi_get_level(txn, root_id, slice->root_eviction_priority,
+                            &path.back(), trace);
+    superblock->release();
+
+    value_sizer_t<rdb_value_t> sizer(txn->get_cache()->get_block_size());
+    scoped_malloc_t<rdb_value_t> value(sizer.max_possible_size());
+    for (auto key = sorted.begin(); key != sorted.end(); ++key) {
+        slice->stats.pm_keys_read.record();
+        // The root isn't bounded, so this never pops it.
+        while (path.back().bounded && path.back().last_key < *key) {
+            path.pop_back();
+        }
+
+        while (node::is_internal(
+                   reinterpret_cast<const node_t *>(path.back().buf.get_data_read()))) {
+            multi_get_level_t *parent = &path.back();
+            const internal_node_t *node
+                = reinterpret_cast<const internal_node_t *>(parent->buf.get_data_read());
+            const int index = internal_node::get_offset_index(node, key->btree_key());
+            const btree_internal_pair *pair = internal_node::get_pair_by_index(node, index);
+            rassert(pair->lnode != NULL_BLOCK_ID && pair->lnode != SUPERBLOCK_ID);
+
+            multi_get_level_t *child = new multi_get_level_t();
+            path.push_back(child);
+            // The key of a pair is the greatest key under it, except for the last
+            // pair, whose subtree goes as far as the parent's.
+            if (index < node->npairs - 1) {
+                child->bounded = true;
+                child->last_key.assign(&pair->key);
+            } else {
+                child->bounded = parent->bounded;
+                child->last_key = parent->last_key;
+            }
+            acquire_multi_get_level(txn, pair->lnode,
+                                    incr_priority(parent->buf.get_eviction_priority()),
+                                    child, trace);
+#ifndef NDEBUG
+            node::validate(&sizer,
+                           reinterpret_cast<const node_t *>(child->buf.get_data_read()));
+#endif  // NDEBUG
+        }
+
+        const leaf_node_t *leaf
+            = reinterpret_cast<const leaf_node_t *>(path.back().buf.get_data_read());
+        if (leaf::lookup(&sizer, leaf, key->btree_key(), value.get())) {
+            response->rows.insert(std::make_pair(*key, get_data(value.get(), txn)));
+        }
+    }
+}
+
 void kv_location_delete(keyvalue_location_t<rdb_value_t> *kv_location,
                         const store_key_t &key,
                         btree_slice_t *slice,
@@ -144,6 +247,65 @@ void kv_location_set(keyvalue_location_t<rdb_value_t> *kv_location,
     //                    ^^^^^ That means the key isn't expired.
 }
 
+// Writes `data` over the value at `kv_location` in its own blob, if it serializes
+// to exactly as many bytes as that value.  Only the blob leaves whose bytes change
+// get rewritten (see blob_t::overwrite_changed_bytes()), so changing a field of a
+// large document that keeps it the same size, like incrementing a counter, costs
+// I/O proportional to the change.  Returns false, having done nothing, otherwise
+// and for values small enough to live in the leaf node.  Sindex entries that share
+// the blob see the new value right away, which is fine since the sindex update
+// that follows the write replaces them anyway.
+bool kv_location_overwrite(keyvalue_location_t<rdb_value_t> *kv_location,
+                           const store_key_t &key,
+                           counted_t<const ql::datum_t> data,
+                           btree_slice_t *slice,
+                           repli_timestamp_t timestamp,
+                           transaction_t *txn,
+                           rdb_modification_info_t *mod_info_out) {
+    guarantee(kv_location->value.has());
+    block_size_t block_size = txn->get_cache()->get_block_size();
+    rdb_value_t *value = kv_location->value.get();
+    if (blob::ref_info(block_size, value->value_ref(), blob::btree_maxreflen).levels == 0) {
+        return false;
+    }
+    blob_t blob(block_size, value->value_ref(), blob::btree_maxreflen);
+    if (static_cast<int64_t>(serialized_size(data)) != blob.valuesize()) {
+        return false;
+    }
+
+    write_message_t wm;
+    wm << data;
+    string_stream_t stream;
+    int res = send_write_message(&stream, &wm);
+    guarantee(res == 0);
+    if (static_cast<int64_t>(stream.str().size()) != blob.valuesize()) {
+        return false;
+    }
+    blob.overwrite_changed_bytes(stream.str(), txn);
+
+    if (mod_info_out) {
+        guarantee(mod_info_out->added.second.empty());
+        mod_info_out->added.second.assign(value->value_ref(),
+                                          value->value_ref() + value->inline_size(block_size));
+        // The old value's blocks are the new value's now, so there's nothing for
+        // rdb_update_sindexes() to delete once the sindexes are updated.  It gets
+        // the ref of an empty blob instead.
+        guarantee(mod_info_out->deleted.second.empty());
+        scoped_malloc_t<rdb_value_t> empty_value(blob::btree_maxreflen);
+        memset(empty_value.get(), 0, blob::btree_maxreflen);
+        mod_info_out->deleted.second.assign(
+            empty_value->value_ref(),
+            empty_value->value_ref() + empty_value->inline_size(block_size));
+    }
+
+    // The ref doesn't change, but the leaf still has to get the new timestamp,
+    // so that backfills see that the value changed.
+    null_key_modification_callback_t<rdb_value_t> null_cb;
+    apply_keyvalue_change(txn, kv_location, key.btree_key(), timestamp,
+                          false, &null_cb, &slice->root_eviction_priority);
+    return true;
+}
+
 void kv_location_set(keyvalue_location_t<rdb_value_t> *kv_location,
                      const store_key_t &key,
                      const std::vector<char> &value_ref,
@@ -175,6 +337,12 @@ void kv_location_delete(keyvalue_location_t<rdb_value_t> *kv_location,
                        info.btree->timestamp, info.btree->txn, mod_info_out);
 }
 
+// Counts the replace as `stat` in `resp`, unless nobody asked for the stats.
+// Returns whether `stat` was already there.
+bool add_replace_stat(ql::datum_ptr_t *resp, const char *stat, bool return_stats) {
+    return return_stats && resp->add(stat, make_counted<ql::datum_t>(1.0));
+}
+
 batched_replace_response_t rdb_replace_and_return_superblock(
     const btree_loc_info_t &info,
     const btree_point_replacer_t *replacer,
@@ -183,6 +351,7 @@ batched_replace_response_t rdb_replace_and_return_superblock(
     profile::trace_t *trace)
 {
     bool return_vals = replacer->should_return_vals();
+    const bool return_stats = replacer->should_return_stats();
     const std::string &primary_key = *info.btree->primary_key;
     const store_key_t &key = *info.key;
     ql::datum_ptr_t resp(ql::datum_t::R_OBJECT);
@@ -245,9 +414,9 @@ batched_replace_response_t rdb_replace_and_return_superblock(
         // ended_empty, and the result of the function call) and then do it.
         if (started_empty) {
             if (ended_empty) {
-                conflict = resp.add("skipped", make_counted<ql::datum_t>(1.0));
+                conflict = add_replace_stat(&resp, "skipped", return_stats);
             } else {
-                conflict = resp.add("inserted", make_counted<ql::datum_t>(1.0));
+                conflict = add_replace_stat(&resp, "inserted", return_stats);
                 r_sanity_check(new_val->get(primary_key, ql::NOTHROW).has());
                 kv_location_set(&kv_location, info, new_val, mod_info_out);
                 guarantee(mod_info_out->deleted.second.empty());
@@ -256,7 +425,7 @@ batched_replace_response_t rdb_replace_and_return_superblock(
             }
         } else {
             if (ended_empty) {
-                conflict = resp.add("deleted", make_counted<ql::datum_t>(1.0));
+                conflict = add_replace_stat(&resp, "deleted", return_stats);
                 kv_location_delete(&kv_location, info, mod_info_out);
                 guarantee(!mod_info_out->deleted.second.empty());
                 guarantee(mod_info_out->added.second.empty());
@@ -265,12 +434,15 @@ batched_replace_response_t rdb_replace_and_return_superblock(
                 r_sanity_check(
                     *old_val->get(primary_key) == *new_val->get(primary_key));
                 if (*old_val == *new_val) {
-                    conflict = resp.add("unchanged",
-                                         make_counted<ql::datum_t>(1.0));
+                    conflict = add_replace_stat(&resp, "unchanged", return_stats);
                 } else {
-                    conflict = resp.add("replaced", make_counted<ql::datum_t>(1.0));
+                    conflict = add_replace_stat(&resp, "replaced", return_stats);
                     r_sanity_check(new_val->get(primary_key, ql::NOTHROW).has());
-                    kv_location_set(&kv_location, info, new_val, mod_info_out);
+                    if (!kv_location_overwrite(&kv_location, key, new_val,
+                                               info.btree->slice, info.btree->timestamp,
+                                               info.btree->txn, mod_info_out)) {
+                        kv_location_set(&kv_location, info, new_val, mod_info_out);
+                    }
                     guarantee(!mod_info_out->deleted.second.empty());
                     guarantee(!mod_info_out->added.second.empty());
                     mod_info_out->added.first = new_val;
@@ -302,6 +474,7 @@ public:
         return replacer->replace(d, index);
     }
     bool should_return_vals() const { return replacer->should_return_vals(); }
+    bool should_return_stats() const { return replacer->should_return_stats(); }
 private:
     const btree_batched_replacer_t *const replacer;
     const size_t index;
@@ -322,9 +495,8 @@ void do_a_replace_from_batched_replace(
         batched_replaces_fifo_sink, batched_replaces_fifo_token);
 
     rdb_modification_report_t mod_report(*info.key);
-    counted_t<const ql::datum_t> res = rdb_replace_and_return_superblock(
+    *stats_out = rdb_replace_and_return_superblock(
         info, &one_replace, superblock_promise, &mod_report.info, trace);
-    *stats_out = (*stats_out)->merge(res, ql::stats_merge);
 
     exiter.wait();
     sindex_cb->on_mod_report(mod_report);
@@ -336,12 +508,15 @@ batched_replace_response_t rdb_batched_replace(
     const std::vector<store_key_t> &keys,
     const btree_batched_replacer_t *replacer,
     rdb_modification_report_cb_t *sindex_cb,
-    profile::trace_t *trace) {
+    profile::trace_t *trace,
+    std::vector<batched_replace_response_t> *stats_per_key_out) {
 
     fifo_enforcer_source_t batched_replaces_fifo_source;
     fifo_enforcer_sink_t batched_replaces_fifo_sink;
 
-    counted_t<const ql::datum_t> stats(new ql::datum_t(ql::datum_t::R_OBJECT));
+    // Every replace fills in the stats of its key, and they get merged in the order
+    // of the keys once they're all done.
+    std::vector<batched_replace_response_t> stats_per_key(keys.size());
 
     // We have to drain write operations before destructing everything above us,
     // because the coroutines being drained use them.
@@ -365,12 +540,23 @@ batched_replace_response_t rdb_batched_replace(
 
                     &superblock_promise,
                     sindex_cb,
-                    &stats,
+                    &stats_per_key[i],
                     trace));
 
             current_superblock.init(superblock_promise.wait());
         }
     } // Make sure the drainer is destructed before the return statement.
+    sindex_cb->finish();
+
+    counted_t<const ql::datum_t> stats(new ql::datum_t(ql::datum_t::R_OBJECT));
+    if (replacer->should_return_stats()) {
+        for (auto it = stats_per_key.begin(); it != stats_per_key.end(); ++it) {
+            stats = stats->merge(*it, ql::stats_merge);
+        }
+    }
+    if (stats_per_key_out != NULL) {
+        stats_per_key_out->swap(stats_per_key);
+    }
     return stats;
 }
 
@@ -405,6 +591,149 @@ void rdb_set(const store_key_t &key,
         (had_value ? point_write_result_t::DUPLICATE : point_write_result_t::STORED);
 }
 
+bool can_reuse_leaf(value_sizer_t<rdb_value_t> *sizer,
+                    const keyvalue_location_t<rdb_value_t> *kv_location,
+                    const store_key_t &key, const rdb_value_t *value);
+
+void rdb_set_batch(const std::vector<rdb_protocol_details::backfill_atom_t> &atoms,
+                   btree_slice_t *slice,
+                   transaction_t *txn,
+                   superblock_t *superblock,
+                   std::vector<rdb_modification_report_t> *mod_reports_out) {
+    guarantee(mod_reports_out->empty());
+
+    std::vector<std::pair<store_key_t, size_t> > keys;
+    keys.reserve(atoms.size());
+    for (size_t i = 0; i < atoms.size(); ++i) {
+        keys.push_back(std::make_pair(atoms[i].key, i));
+    }
+    std::sort(keys.begin(), keys.end());
+
+    const block_size_t block_size = txn->get_cache()->get_block_size();
+    value_sizer_t<rdb_value_t> sizer(block_size);
+    // The location of the previous key, which keeps its leaf and the leaf's parent.
+    scoped_ptr_t<promise_t<superblock_t *> > return_superblock;
+    scoped_ptr_t<keyvalue_location_t<rdb_value_t> > kv_location;
+    for (auto it = keys.begin(); it != keys.end(); ++it) {
+        const rdb_protocol_details::backfill_atom_t &atom = atoms[it->second];
+
+        // The value gets serialized first, so that we know whether it fits into
+        // the leaf of the previous key.
+        scoped_malloc_t<rdb_value_t> new_value(blob::btree_maxreflen);
+        memset(new_value.get(), 0, blob::btree_maxreflen);
+        blob_t blob(block_size, new_value->value_ref(), blob::btree_maxreflen);
+        serialize_onto_blob(txn, &blob, atom.value);
+
+        if (kv_location.has() && can_reuse_leaf(&sizer, kv_location.get(), atom.key,
+                                                new_value.get())) {
+            scoped_malloc_t<rdb_value_t> old_value(sizer.max_possible_size());
+            if (leaf::lookup(&sizer,
+                             static_cast<const leaf_node_t *>(kv_location->buf.get_data_read()),
+                             atom.key.btree_key(), old_value.get())) {
+                kv_location->there_originally_was_value = true;
+                kv_location->value = std::move(old_value);
+            } else {
+                kv_location->there_originally_was_value = false;
+                kv_location->value.reset();
+            }
+        } else {
+            if (kv_location.has()) {
+                kv_location.reset();
+                superblock = return_superblock->wait();
+            }
+            return_superblock.init(new promise_t<superblock_t *>);
+            kv_location.init(new keyvalue_location_t<rdb_value_t>);
+            find_keyvalue_location_for_write(txn, superblock, atom.key.btree_key(),
+                                             kv_location.get(),
+                                             &slice->root_eviction_priority,
+                                             &slice->stats,
+                                             static_cast<profile::trace_t *>(NULL),
+                                             return_superblock.get());
+        }
+
+        mod_reports_out->push_back(rdb_modification_report_t(atom.key));
+        rdb_modification_info_t *mod_info = &mod_reports_out->back().info;
+        if (kv_location->value.has()) {
+            mod_info->deleted.first = get_data(kv_location->value.get(), txn);
+            mod_info->deleted.second.assign(
+                kv_location->value->value_ref(),
+                kv_location->value->value_ref()
+                + kv_location->value->inline_size(block_size));
+        }
+        mod_info->added.first = atom.value;
+        mod_info->added.second.assign(new_value->value_ref(),
+                                      new_value->value_ref() + new_value->inline_size(block_size));
+
+        kv_location->value = std::move(new_value);
+        null_key_modification_callback_t<rdb_value_t> null_cb;
+        apply_keyvalue_change(txn, kv_location.get(), atom.key.btree_key(), atom.recency,
+                              false, &null_cb, &slice->root_eviction_priority);
+    }
+    if (kv_location.has()) {
+        kv_location.reset();
+        superblock = return_superblock->wait();
+    }
+    // rdb_set() doesn't keep it either.
+    superblock->release();
+}
+
+batched_replace_response_t rdb_bulk_load(
+        const std::vector<counted_t<const ql::datum_t> > &rows,
+        const std::string &pkey, double fill_factor,
+        btree_slice_t *slice, repli_timestamp_t timestamp,
+        transaction_t *txn, superblock_t *superblock,
+        std::vector<rdb_modification_report_t> *mod_reports_out) {
+    guarantee(mod_reports_out->empty());
+
+    // Rows with the same key stay in the order they came in, so the first of them
+    // is the one that gets inserted.
+    std::vector<std::pair<store_key_t, size_t> > keys;
+    keys.reserve(rows.size());
+    for (size_t i = 0; i < rows.size(); ++i) {
+        keys.push_back(std::make_pair(store_key_t(rows[i]->get(pkey)->print_primary()), i));
+    }
+    std::sort(keys.begin(), keys.end());
+
+    const block_size_t block_size = txn->get_cache()->get_block_size();
+    value_sizer_t<rdb_value_t> sizer(block_size);
+    ql::datum_ptr_t resp(ql::datum_t::R_OBJECT);
+
+    btree_bulk_loader_t loader(&sizer, slice, txn, superblock, timestamp, fill_factor);
+    size_t inserted_index = 0;
+    for (auto it = keys.begin(); it != keys.end(); ++it) {
+        const counted_t<const ql::datum_t> &row = rows[it->second];
+        if (!mod_reports_out->empty() && mod_reports_out->back().primary_key == it->first) {
+            std::string msg = strprintf("Duplicate primary key `%s`:\n%s\n%s",
+                                        pkey.c_str(),
+                                        rows[inserted_index]->print().c_str(),
+                                        row->print().c_str());
+            resp.add_error(msg.c_str());
+            continue;
+        }
+
+        scoped_malloc_t<rdb_value_t> value(blob::btree_maxreflen);
+        memset(value.get(), 0, blob::btree_maxreflen);
+        blob_t blob(block_size, value->value_ref(), blob::btree_maxreflen);
+        serialize_onto_blob(txn, &blob, row);
+        loader.add(it->first.btree_key(), value.get());
+        inserted_index = it->second;
+
+        mod_reports_out->push_back(rdb_modification_report_t(it->first));
+        rdb_modification_info_t *mod_info = &mod_reports_out->back().info;
+        mod_info->added.first = row;
+        mod_info->added.second.assign(value->value_ref(),
+                                      value->value_ref() + value->inline_size(block_size));
+    }
+    loader.finish();
+
+    if (!mod_reports_out->empty()) {
+        UNUSED bool conflict = resp.add(
+            "inserted",
+            make_counted<ql::datum_t>(static_cast<double>(mod_reports_out->size())));
+    }
+    return resp.to_counted();
+}
+
 class agnostic_rdb_backfill_callback_t : public agnostic_backfill_callback_t {
 public:
     agnostic_rdb_backfill_callback_t(rdb_backfill_callback_t *cb, const key_range_t &kr) : cb_(cb), kr_(kr) { }
@@ -434,6 +763,11 @@ public:
         cb_->on_sindexes(sindexes, interruptor);
     }
 
+    void on_range_done(const key_range_t &range, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) {
+        rassert(kr_.is_superset(range));
+        cb_->on_range_done(range, interruptor);
+    }
+
     rdb_backfill_callback_t *cb_;
     key_range_t kr_;
 };
@@ -442,11 +776,11 @@ void rdb_backfill(btree_slice_t *slice, const key_range_t& key_range,
         repli_timestamp_t since_when, rdb_backfill_callback_t *callback,
         transaction_t *txn, superblock_t *superblock,
         buf_lock_t *sindex_block,
-        parallel_traversal_progress_t *p, signal_t *interruptor)
+        traversal_progress_combiner_t *progress, signal_t *interruptor)
         THROWS_ONLY(interrupted_exc_t) {
     agnostic_rdb_backfill_callback_t agnostic_cb(callback, key_range);
     value_sizer_t<rdb_value_t> sizer(slice->cache()->get_block_size());
-    do_agnostic_btree_backfill(&sizer, slice, key_range, since_when, &agnostic_cb, txn, superblock, sindex_block, p, interruptor);
+    do_agnostic_btree_backfill(&sizer, slice, key_range, since_when, &agnostic_cb, txn, superblock, sindex_block, progress, interruptor);
 }
 
 void rdb_delete(const store_key_t &key, btree_slice_t *slice,
@@ -477,6 +811,179 @@ void rdb_value_deleter_t::delete_value(transaction_t *_txn, void *_value) {
 
 void rdb_value_non_deleter_t::delete_value(transaction_t *, void *) { }
 
+/* The btree of an aggregate index has an entry for every row, under
+AGGREGATE_ROW_KEY_PREFIX and the row's primary key, with the group of the row and
+the field the index sums up, and a summary for every group, under
+AGGREGATE_SUMMARY_KEY_PREFIX and the sort key of the group, with how many rows it
+has, how many of those have the field and what it sums up to.  A summary only ever
+changes along with an entry, by what the entry held before and holds after, so the
+summaries stay the sums of the entries whatever order the changes come in and
+however often the same one comes, like the queued ones of a post construction.  The
+rows that can't be summarized (see aggregate_row_entry()) only get counted under the
+summary prefix alone, and as long as there are any, the summaries can't be used. */
+static const char AGGREGATE_SUMMARY_KEY_PREFIX = '\0';
+static const char AGGREGATE_ROW_KEY_PREFIX = '\1';
+
+store_key_t aggregate_row_key(const store_key_t &primary_key) {
+    return store_key_t(std::string(1, AGGREGATE_ROW_KEY_PREFIX)
+                       + key_to_unescaped_str(primary_key));
+}
+
+// The key of the summary an entry counts in, or of the count of the rows that
+// can't be summarized, for an empty entry.
+store_key_t aggregate_summary_key(const counted_t<const ql::datum_t> &entry) {
+    std::string key(1, AGGREGATE_SUMMARY_KEY_PREFIX);
+    if (entry->size() != 0) {
+        ql::append_sort_key(*entry->get(0), &key);
+    }
+    return store_key_t(key);
+}
+
+// The summary of `rows` rows of `group`, see aggregate_row_entry().
+counted_t<const ql::datum_t> make_aggregate_summary(
+        const counted_t<const ql::datum_t> &group,
+        double rows, double with_field, double sum) {
+    std::vector<counted_t<const ql::datum_t> > summary;
+    summary.push_back(group);
+    summary.push_back(make_counted<const ql::datum_t>(rows));
+    summary.push_back(make_counted<const ql::datum_t>(with_field));
+    summary.push_back(make_counted<const ql::datum_t>(sum));
+    return make_counted<const ql::datum_t>(std::move(summary));
+}
+
+// Adds the row of `entry` to its summary, or takes it out of it if `sign` is -1.
+void update_aggregate_summary(transaction_t *txn, btree_slice_t *slice,
+                              superblock_t **superblock,
+                              const counted_t<const ql::datum_t> &entry, double sign,
+                              profile::trace_t *trace) {
+    const store_key_t key = aggregate_summary_key(entry);
+    promise_t<superblock_t *> return_superblock_local;
+    {
+        keyvalue_location_t<rdb_value_t> kv_location;
+        find_keyvalue_location_for_write(txn, *superblock, key.btree_key(),
+                                         &kv_location, &slice->root_eviction_priority,
+                                         &slice->stats, trace,
+                                         &return_superblock_local);
+
+        double rows = sign, with_field = 0, sum = 0;
+        if (kv_location.value.has()) {
+            counted_t<const ql::datum_t> old_summary
+                = get_data(kv_location.value.get(), txn);
+            rows += old_summary->get(old_summary->size() == 1 ? 0 : 1)->as_num();
+            if (old_summary->size() != 1) {
+                with_field = old_summary->get(2)->as_num();
+                sum = old_summary->get(3)->as_num();
+            }
+        }
+        guarantee(rows >= 0);
+
+        counted_t<const ql::datum_t> summary;
+        if (entry->size() == 0) {
+            std::vector<counted_t<const ql::datum_t> > count;
+            count.push_back(make_counted<const ql::datum_t>(rows));
+            summary = make_counted<const ql::datum_t>(std::move(count));
+        } else {
+            counted_t<const ql::datum_t> field = entry->get(1);
+            if (field->get_type() == ql::datum_t::R_NUM) {
+                with_field += sign;
+                sum += sign * field->as_num();
+            }
+            summary = make_aggregate_summary(entry->get(0), rows, with_field, sum);
+        }
+
+        if (rows != 0) {
+            kv_location_set(&kv_location, key, summary, slice,
+                            repli_timestamp_t::distant_past, txn, NULL);
+        } else if (kv_location.value.has()) {
+            kv_location_delete(&kv_location, key, slice,
+                               repli_timestamp_t::distant_past, txn, NULL);
+        }
+        // The keyvalue location gets destroyed here.
+    }
+    *superblock = return_superblock_local.wait();
+}
+
+// Sets the entry of an aggregate index at `key` to `entry`, or deletes it if
+// `entry` is empty, and moves the summaries along.
+void set_aggregate_entry(transaction_t *txn, btree_slice_t *slice,
+                         superblock_t **superblock, const store_key_t &key,
+                         const counted_t<const ql::datum_t> &entry,
+                         profile::trace_t *trace) {
+    counted_t<const ql::datum_t> old_entry;
+    bool unchanged = false;
+    promise_t<superblock_t *> return_superblock_local;
+    {
+        keyvalue_location_t<rdb_value_t> kv_location;
+        find_keyvalue_location_for_write(txn, *superblock, key.btree_key(),
+                                         &kv_location, &slice->root_eviction_priority,
+                                         &slice->stats, trace,
+                                         &return_superblock_local);
+        if (kv_location.value.has()) {
+            old_entry = get_data(kv_location.value.get(), txn);
+            unchanged = entry.has() && *old_entry == *entry;
+        }
+
+        if (unchanged) {
+            // Nothing to write, nor to move in the summaries.
+        } else if (entry.has()) {
+            kv_location_set(&kv_location, key, entry, slice,
+                            repli_timestamp_t::distant_past, txn, NULL);
+        } else if (old_entry.has()) {
+            kv_location_delete(&kv_location, key, slice,
+                               repli_timestamp_t::distant_past, txn, NULL);
+        }
+        // The keyvalue location gets destroyed here.
+    }
+    *superblock = return_superblock_local.wait();
+    if (unchanged) {
+        return;
+    }
+
+    if (old_entry.has()) {
+        update_aggregate_summary(txn, slice, superblock, old_entry, -1, trace);
+    }
+    if (entry.has()) {
+        update_aggregate_summary(txn, slice, superblock, entry, 1, trace);
+    }
+}
+
+// Collects the keys of the pairs it gets.
+class rdb_collect_all_keys_callback_t : public depth_first_traversal_callback_t {
+public:
+    explicit rdb_collect_all_keys_callback_t(std::vector<store_key_t> *_keys_out)
+        : keys_out(_keys_out) { }
+
+    bool handle_pair(scoped_key_value_t &&keyvalue) {
+        keys_out->push_back(store_key_t(keyvalue.key()));
+        return true;
+    }
+
+private:
+    std::vector<store_key_t> *const keys_out;
+};
+
+// Deletes the entries of the rows of `key_range` from an aggregate index, taking
+// them out of the summaries.  The entries of a range of primary keys are a range of
+// the index.
+void aggregate_erase_range(const key_range_t &key_range, transaction_t *txn,
+                           btree_slice_t *slice, superblock_t *superblock) {
+    const store_key_t left = aggregate_row_key(key_range.left);
+    const store_key_t right = key_range.right.unbounded
+        ? store_key_t(std::string(1, static_cast<char>(AGGREGATE_ROW_KEY_PREFIX + 1)))
+        : aggregate_row_key(key_range.right.key);
+    std::vector<store_key_t> keys;
+    rdb_collect_all_keys_callback_t callback(&keys);
+    btree_depth_first_traversal(slice, txn, superblock,
+                                key_range_t(key_range_t::closed, left,
+                                            key_range_t::open, right),
+                                &callback, FORWARD, false);
+
+    for (auto it = keys.begin(); it != keys.end(); ++it) {
+        set_aggregate_entry(txn, slice, &superblock, *it,
+                            counted_t<const ql::datum_t>(), NULL);
+    }
+}
+
 class sindex_key_range_tester_t : public key_tester_t {
 public:
     explicit sindex_key_range_tester_t(const key_range_t &key_range)
@@ -504,10 +1011,32 @@ void sindex_erase_range(const key_range_t &key_range,
 
     rdb_value_non_deleter_t deleter;
 
-    sindex_key_range_tester_t tester(key_range);
+    // The summaries of an aggregate index lose the rows that go, unless they all do.
+    ql::map_wire_func_t mapping;
+    sindex_multi_bool_t multi = sindex_multi_bool_t::MULTI;
+    std::vector<std::string> stored_fields;
+    ql::sindex_key_format_t key_format;
+    deserialize_sindex_info(sindex_access->sindex.opaque_definition, &mapping, &multi,
+                            &stored_fields, &key_format);
+    if (multi == sindex_multi_bool_t::AGGREGATE && key_range != key_range_t::universe()) {
+        aggregate_erase_range(key_range, txn, sindex_access->btree,
+                              sindex_access->super_block.get());
+        if (release_superblock) {
+            sindex_access->super_block->release();
+        }
+        return;
+    }
+
+    // If every primary key goes, so does every sindex key, and the sindex can be
+    // dropped wholesale.
+    sindex_key_range_tester_t range_tester(key_range);
+    always_true_key_tester_t always_true_tester;
+    key_tester_t *tester = key_range == key_range_t::universe()
+        ? static_cast<key_tester_t *>(&always_true_tester)
+        : static_cast<key_tester_t *>(&range_tester);
 
     try {
-        btree_erase_range_generic(sizer, sindex_access->btree, &tester,
+        btree_erase_range_generic(sizer, sindex_access->btree, tester,
                 &deleter, NULL, NULL, txn, sindex_access->super_block.get(), interruptor, release_superblock);
     } catch (const interrupted_exc_t &) {
         // We were interrupted. That's fine nothing to be done about it.
@@ -531,17 +1060,13 @@ void spawn_sindex_erase_ranges(
     }
 }
 
-void rdb_erase_range(btree_slice_t *slice, key_tester_t *tester,
-                     const key_range_t &key_range,
-                     transaction_t *txn, superblock_t *superblock,
-                     btree_store_t<rdb_protocol_t> *store,
-                     write_token_pair_t *token_pair,
-                     signal_t *interruptor) {
-    /* This is guaranteed because the way the keys are calculated below would
-     * lead to a single key being deleted even if the range was empty. */
-    guarantee(!key_range.is_empty());
-
-    /* Dispatch the erase range to the sindexes. */
+/* Erases the entries of the rows of `key_range` from the sindexes, and queues the
+erase for the sindexes that are still being constructed. */
+void erase_range_from_sindexes(const key_range_t &key_range,
+                               transaction_t *txn, superblock_t *superblock,
+                               btree_store_t<rdb_protocol_t> *store,
+                               write_token_pair_t *token_pair,
+                               signal_t *interruptor) {
     sindex_access_vector_t sindex_superblocks;
     {
         scoped_ptr_t<buf_lock_t> sindex_block;
@@ -579,6 +1104,21 @@ void rdb_erase_range(btree_slice_t *slice, key_tester_t *tester,
          * by spawn_sindex_erase_ranges complete before we proceed past this
          * point. */
     }
+}
+
+void rdb_erase_range(btree_slice_t *slice, key_tester_t *tester,
+                     const key_range_t &key_range,
+                     transaction_t *txn, superblock_t *superblock,
+                     btree_store_t<rdb_protocol_t> *store,
+                     write_token_pair_t *token_pair,
+                     signal_t *interruptor) {
+    /* This is guaranteed because the way the keys are calculated below would
+     * lead to a single key being deleted even if the range was empty. */
+    guarantee(!key_range.is_empty());
+
+    /* Dispatch the erase range to the sindexes. */
+    erase_range_from_sindexes(key_range, txn, superblock, store, token_pair,
+                              interruptor);
 
     /* Twiddle some keys to get the in the form we want. Notice these are keys
      * which will be made  exclusive and inclusive as their names suggest
@@ -609,12 +1149,187 @@ void rdb_erase_range(btree_slice_t *slice, key_tester_t *tester,
     // auto_drainer_t is destructed here so this waits for other coros to finish.
 }
 
+/* Deletes the rows of a key range leaf by leaf.  Unlike the erase range helper, it
+leaves deletion entries behind, with the timestamp of the write, so that the
+replicas that backfill later still learn of the deletes. */
+class rdb_delete_range_helper_t : public btree_traversal_helper_t {
+public:
+    rdb_delete_range_helper_t(value_sizer_t<void> *sizer, value_deleter_t *deleter,
+                              const key_range_t &range, repli_timestamp_t timestamp,
+                              ql::changefeed::server_t *changefeed_server_or_null)
+        : sizer_(sizer), deleter_(deleter), range_(range), timestamp_(timestamp),
+          changefeed_server_(changefeed_server_or_null), deleted_(0) { }
+
+    void process_a_leaf(transaction_t *txn, buf_lock_t *leaf_node_buf,
+                        const btree_key_t *, const btree_key_t *, signal_t *,
+                        int *population_change_out) THROWS_ONLY(interrupted_exc_t) {
+        leaf_node_t *node = static_cast<leaf_node_t *>(leaf_node_buf->get_data_write());
+
+        std::vector<store_key_t> keys_to_delete;
+        for (auto it = leaf::begin(*node); it != leaf::end(*node); ++it) {
+            const btree_key_t *k = (*it).first;
+            if (k == NULL) {
+                break;
+            }
+            if (range_.contains_key(k->contents, k->size)) {
+                keys_to_delete.push_back(store_key_t(k));
+            }
+        }
+
+        scoped_malloc_t<char> value(sizer_->max_possible_size());
+        for (auto it = keys_to_delete.begin(); it != keys_to_delete.end(); ++it) {
+            bool found = leaf::lookup(sizer_, node, it->btree_key(), value.get());
+            guarantee(found);
+            if (changefeed_server_ != NULL) {
+                rdb_modification_report_t report(*it);
+                report.info.deleted.first =
+                    get_data(reinterpret_cast<rdb_value_t *>(value.get()), txn);
+                changefeed_server_->send_change(report);
+            }
+            deleter_->delete_value(txn, value.get());
+            leaf::remove(sizer_, node, it->btree_key(), timestamp_,
+                         key_modification_proof_t::real_proof());
+        }
+
+        deleted_ += keys_to_delete.size();
+        *population_change_out = -static_cast<int>(keys_to_delete.size());
+    }
+
+    void postprocess_internal_node(UNUSED buf_lock_t *internal_node_buf) { }
+
+    void filter_interesting_children(UNUSED transaction_t *txn,
+                                     ranged_block_ids_t *ids_source,
+                                     interesting_children_callback_t *cb) {
+        for (int i = 0, e = ids_source->num_block_ids(); i < e; ++i) {
+            block_id_t block_id;
+            const btree_key_t *left_excl, *right_incl;
+            ids_source->get_block_id_and_bounding_interval(i, &block_id,
+                                                           &left_excl, &right_incl);
+            // The child has the keys in (left_excl, right_incl]; we may visit a
+            // child that turns out to have none of the range.
+            if ((right_incl == NULL || !(store_key_t(right_incl) < range_.left))
+                && (left_excl == NULL || range_.right.unbounded
+                    || store_key_t(left_excl) < range_.right.key)) {
+                cb->receive_interesting_child(i);
+            }
+        }
+        cb->no_more_interesting_children();
+    }
+
+    access_t btree_superblock_mode() { return rwi_write; }
+    access_t btree_node_mode() { return rwi_write; }
+
+    int64_t deleted() const { return deleted_; }
+
+private:
+    value_sizer_t<void> *const sizer_;
+    value_deleter_t *const deleter_;
+    const key_range_t range_;
+    const repli_timestamp_t timestamp_;
+    ql::changefeed::server_t *const changefeed_server_;
+    int64_t deleted_;
+
+    DISABLE_COPYING(rdb_delete_range_helper_t);
+};
+
+int64_t rdb_delete_range(btree_slice_t *slice, const key_range_t &key_range,
+                         repli_timestamp_t timestamp,
+                         transaction_t *txn, superblock_t *superblock,
+                         btree_store_t<rdb_protocol_t> *store,
+                         write_token_pair_t *token_pair,
+                         ql::changefeed::server_t *changefeed_server_or_null,
+                         signal_t *interruptor) {
+    guarantee(!key_range.is_empty());
+
+    erase_range_from_sindexes(key_range, txn, superblock, store, token_pair,
+                              interruptor);
+
+    value_sizer_t<rdb_value_t> rdb_sizer(slice->cache()->get_block_size());
+    rdb_value_deleter_t deleter;
+    rdb_delete_range_helper_t helper(&rdb_sizer, &deleter, key_range, timestamp,
+                                     changefeed_server_or_null);
+    btree_parallel_traversal(txn, superblock, slice, &helper, interruptor);
+    return helper.deleted();
+}
+
 // This is actually a kind of misleading name. This function estimates the size of a datum,
 // not a whole rget, though it is used for that purpose (by summing up these responses).
 size_t estimate_rget_response_size(const counted_t<const ql::datum_t> &datum) {
     return serialized_size(datum);
 }
 
+// Adds the fields `func` reads to `*fields_out`, or returns false if it reads more
+// of the rows than top-level fields.
+bool add_fields_func_reads(const counted_t<ql::func_t> &func,
+                           std::vector<std::string> *fields_out) {
+    std::vector<std::string> fields;
+    if (!ql::func_reads_top_level_fields(func, &fields)) {
+        return false;
+    }
+    fields_out->insert(fields_out->end(), fields.begin(), fields.end());
+    return true;
+}
+
+bool query_reads_top_level_fields(
+        const rdb_protocol_details::transform_t &transform,
+        const boost::optional<rdb_protocol_details::terminal_t> &terminal,
+        std::vector<std::string> *fields_out) {
+    try {
+        for (auto it = transform.begin(); it != transform.end(); ++it) {
+            if (const filter_transform_t *filter = boost::get<filter_transform_t>(&*it)) {
+                // The default is for rows the filter fails on, which a projection
+                // may not fail on alike.
+                if (filter->default_filter_val
+                    || !add_fields_func_reads(filter->filter_func.compile_wire_func(),
+                                              fields_out)) {
+                    return false;
+                }
+                continue;
+            }
+            // What comes after a map or a pluck only gets what they make of the rows.
+            if (const ql::map_wire_func_t *map = boost::get<ql::map_wire_func_t>(&*it)) {
+                return add_fields_func_reads(map->compile_wire_func(), fields_out);
+            }
+            const projection_transform_t *projection
+                = boost::get<projection_transform_t>(&*it);
+            if (projection == NULL || projection->type != projection_type_t::PLUCK
+                || projection->paths->get_type() != ql::datum_t::R_ARRAY) {
+                return false;
+            }
+            for (size_t i = 0; i < projection->paths->size(); ++i) {
+                counted_t<const ql::datum_t> path = projection->paths->get(i);
+                if (path->get_type() != ql::datum_t::R_STR) {
+                    return false;
+                }
+                fields_out->push_back(path->as_str());
+            }
+            return true;
+        }
+
+        if (!terminal) {
+            return false;
+        }
+        if (boost::get<ql::count_wire_func_t>(&*terminal) != NULL) {
+            return true;
+        }
+        if (const ql::gmr_wire_func_t *gmr = boost::get<ql::gmr_wire_func_t>(&*terminal)) {
+            return add_fields_func_reads(gmr->compile_group(), fields_out)
+                && add_fields_func_reads(gmr->compile_map(), fields_out);
+        }
+        if (const ql::groupby_wire_func_t *groupby
+                = boost::get<ql::groupby_wire_func_t>(&*terminal)) {
+            if (groupby->get_aggregator() != ql::group_aggregator_t::COUNT) {
+                fields_out->push_back(groupby->get_field());
+            }
+            return add_fields_func_reads(groupby->compile_group(), fields_out);
+        }
+        return false;
+    } catch (const ql::base_exc_t &) {
+        // The transform reports the error when it gets applied.
+        return false;
+    }
+}
+
 class rdb_rget_depth_first_traversal_callback_t
     : public concurrent_traversal_callback_t {
 public:
@@ -630,13 +1345,17 @@ public:
         sorting_t _sorting,
         rget_read_response_t *_response)
         : bad_init(false),
+          over_snapshot_budget(false),
+          considered_a_pair(false),
+          pairs_seen(0),
           transaction(txn),
           response(_response),
           ql_env(_ql_env),
           batcher(batchspec.to_batcher()),
           transform(_transform),
           terminal(_terminal),
-          sorting(_sorting)
+          sorting(_sorting),
+          skips_repeated_entries(false)
     {
         init(range);
     }
@@ -660,9 +1379,16 @@ public:
         sorting_t _sorting,
         ql::map_wire_func_t _sindex_function,
         sindex_multi_bool_t _sindex_multi,
+        ql::sindex_key_format_t _sindex_key_format,
         datum_range_t _sindex_range,
+        const std::vector<std::string> &_stored_fields,
+        btree_slice_t *_primary_slice,
+        superblock_t *_primary_superblock,
         rget_read_response_t *_response)
         : bad_init(false),
+          over_snapshot_budget(false),
+          considered_a_pair(false),
+          pairs_seen(0),
           transaction(txn),
           response(_response),
           ql_env(_ql_env),
@@ -670,11 +1396,21 @@ public:
           transform(_transform),
           terminal(_terminal),
           sorting(_sorting),
+          skips_repeated_entries(_sindex_multi == sindex_multi_bool_t::MULTI
+                                 && _sindex_range.is_point()),
           primary_key_range(_primary_key_range),
           sindex_range(_sindex_range),
-          sindex_multi(_sindex_multi)
+          sindex_multi(_sindex_multi),
+          sindex_key_format(_sindex_key_format),
+          stored_fields(_stored_fields),
+          covered_by_stored_fields(false),
+          primary_slice(_primary_slice),
+          primary_superblock(_primary_superblock)
     {
         sindex_function = _sindex_function.compile_wire_func();
+        if (!stored_fields.empty()) {
+            covered_by_stored_fields = query_covered_by_stored_fields();
+        }
         init(range);
     }
 
@@ -693,6 +1429,11 @@ public:
             if (terminal) {
                 query_language::terminal_initialize(&*terminal, &response->result);
             }
+            init_filter_program();
+            init_prefilter();
+            if (counts_only() || prefilter_func.has()) {
+                count_placeholder = make_counted<const ql::datum_t>(ql::datum_t::R_NULL);
+            }
 
             disabler.init(new profile::disabler_t(ql_env->trace));
             sampler.init(new profile::sampler_t("Range traversal doc evaluation.", ql_env->trace));
@@ -711,6 +1452,7 @@ public:
                      concurrent_traversal_fifo_enforcer_signal_t waiter)
         THROWS_ONLY(interrupted_exc_t) {
         sampler->new_sample();
+        ++pairs_seen;
         store_key_t store_key(keyvalue.key());
         if (bad_init) {
             return false;
@@ -723,50 +1465,186 @@ public:
             }
         }
         try {
-            lazy_json_t first_value(static_cast<const rdb_value_t *>(keyvalue.value()),
-                                    transaction);
+            // A plain count never looks at the documents, so there's no need to
+            // load them (and maybe their blobs).
+            const rdb_value_t *value = static_cast<const rdb_value_t *>(keyvalue.value());
+            // Nor does it have to load the documents the first transform filters
+            // out, if it can tell that from a few fields of them.
+            bool prefiltered = false;
+            bool passes_prefilter = true;
+            if (prefilter_func.has()) {
+                prefiltered = try_prefilter(value, &passes_prefilter);
+            }
+            counted_t<const ql::datum_t> stored_index_value;
+            lazy_json_t first_value = (counts_only() || !passes_prefilter)
+                ? lazy_json_t(count_placeholder)
+                : !stored_fields.empty()
+                ? lazy_json_t(load_sindex_entry(value, store_key, &stored_index_value))
+                : lazy_json_t(value, transaction);
             first_value.get();
 
             keyvalue.reset();
 
             waiter.wait_interruptible();
 
-            if ((response->last_considered_key < store_key && !reversed(sorting)) ||
-                (response->last_considered_key > store_key && reversed(sorting))) {
-                response->last_considered_key = store_key;
+            return handle_loaded(store_key, first_value, prefiltered, passes_prefilter,
+                                 stored_index_value);
+        } catch (const ql::exc_t &e2) {
+            /* Evaluation threw so we're not going to be accepting any more requests. */
+            response->result = e2;
+            return false;
+        }
+    }
+
+    // Goes through the document at `primary_key` as if the traversal had come to
+    // it, for reads that find their documents another way, see
+    // rdb_rget_intersection_slice().  Returns whether to go on.
+    bool handle_document(const store_key_t &primary_key, const rdb_value_t *value) {
+        sampler->new_sample();
+        if (bad_init) {
+            return false;
+        }
+        try {
+            bool prefiltered = false;
+            bool passes_prefilter = true;
+            if (prefilter_func.has()) {
+                prefiltered = try_prefilter(value, &passes_prefilter);
+            }
+            lazy_json_t first_value = (counts_only() || !passes_prefilter)
+                ? lazy_json_t(count_placeholder)
+                : lazy_json_t(value, transaction);
+            first_value.get();
+            return handle_loaded(primary_key, first_value, prefiltered, passes_prefilter,
+                                 counted_t<const ql::datum_t>());
+        } catch (const ql::exc_t &e2) {
+            /* Evaluation threw so we're not going to be accepting any more requests. */
+            response->result = e2;
+            return false;
+        }
+    }
+
+    void consider(const store_key_t &store_key) {
+        if ((response->last_considered_key < store_key && !reversed(sorting)) ||
+            (response->last_considered_key > store_key && reversed(sorting))) {
+            response->last_considered_key = store_key;
+        }
+    }
+
+    // The (maybe truncated) index value and the primary key of a secondary index
+    // entry, which its tag tells apart from the row's other entries.
+    static std::pair<std::string, std::string> entry_of(const store_key_t &store_key) {
+        std::string key = key_to_unescaped_str(store_key);
+        return std::make_pair(ql::datum_t::extract_secondary(key),
+                              ql::datum_t::extract_primary(key));
+    }
+
+    // True if `store_key` is an entry of the same row and value as the last entry
+    // that made it into the results.  A row whose array has a value more than once
+    // has an entry for every time, which are next to each other unless another
+    // primary key sorts between their tags, and a `get_all` returns the row once.
+    // (Another entry of a truncated value that isn't the one we look for wouldn't
+    // make it into the results anyway.)
+    bool repeats_last_entry(const store_key_t &store_key) const {
+        return last_entry && *last_entry == entry_of(store_key);
+    }
+
+    // Goes on with a pair once its value is loaded.
+    bool handle_loaded(const store_key_t &store_key, lazy_json_t first_value,
+                       bool prefiltered, bool passes_prefilter,
+                       const counted_t<const ql::datum_t> &stored_index_value) {
+        try {
+            // The traversal loads the pairs after the one that filled the batch
+            // before it sees that it should stop, but they're left for the next
+            // batch instead of going through the transforms for nothing.
+            if (skips_repeated_entries && repeats_last_entry(store_key)) {
+                // Even once the batch is full, so the next one doesn't start with
+                // a row this one returned.
+                consider(store_key);
+                return true;
+            }
+            if (!terminal && batcher.should_send_batch()) {
+                return false;
+            }
+            // Writers keep copies of the leaves a snapshotted scan has yet to
+            // get to.  Past a point, the batch ends early and the next one starts
+            // a new snapshot, but only once it has made some progress.  Once the
+            // budget is exceeded, later pairs stay out even if it no longer is.
+            if (!terminal && (over_snapshot_budget
+                              || (considered_a_pair
+                                  && transaction->snapshot_over_budget()))) {
+                over_snapshot_budget = true;
+                return false;
+            }
+            considered_a_pair = true;
+
+            consider(store_key);
+            if (!passes_prefilter) {
+                return true;
             }
 
             std::vector<lazy_json_t> data;
             data.push_back(first_value);
 
             counted_t<const ql::datum_t> sindex_value;
-            if (sindex_function) {
-                sindex_value =
-                    sindex_function->call(ql_env, first_value.get())->as_datum();
+            if (stored_index_value.has()) {
+                // The entry is for this very index value, even for a multi index.
+                sindex_value = stored_index_value;
+                guarantee(sindex_range);
+                if (!sindex_range->contains(sindex_value)) {
+                    return true;
+                }
+            } else if (sindex_function) {
                 guarantee(sindex_range);
                 guarantee(sindex_multi);
-
-                if (sindex_multi == sindex_multi_bool_t::MULTI &&
-                    sindex_value->get_type() == ql::datum_t::R_ARRAY) {
+                guarantee(sindex_key_format);
+                // A whole binary key holds the value of its entry (even for a
+                // multi index), so the function only runs again for truncated
+                // keys.
+                if (*sindex_key_format == ql::sindex_key_format_t::BINARY
+                    && !ql::datum_t::key_is_truncated(store_key)) {
+                    sindex_value = ql::datum_t::from_binary_secondary(
+                        ql::datum_t::extract_secondary(key_to_unescaped_str(store_key)));
+                }
+                if (!sindex_value.has()) {
+                    sindex_value =
+                        sindex_function->call(ql_env, first_value.get())->as_datum();
+                    if (sindex_multi == sindex_multi_bool_t::MULTI &&
+                        sindex_value->get_type() == ql::datum_t::R_ARRAY) {
                         boost::optional<uint64_t> tag =
                             ql::datum_t::extract_tag(key_to_unescaped_str(store_key));
                         guarantee(tag);
                         guarantee(sindex_value->size() > *tag);
                         sindex_value = sindex_value->get(*tag);
+                    }
                 }
                 if (!sindex_range->contains(sindex_value)) {
                     return true;
                 }
             }
+            if (skips_repeated_entries) {
+                last_entry = entry_of(store_key);
+            }
 
             // Apply transforms to the data
             {
-                rdb_protocol_details::transform_t::iterator it;
-                for (it = transform.begin(); it != transform.end(); ++it) {
+                rdb_protocol_details::transform_t::iterator it = transform.begin();
+                if (prefiltered) {
+                    // The document passed that filter already.
+                    ++it;
+                }
+                for (; it != transform.end(); ++it) {
                     try {
                         std::vector<counted_t<const ql::datum_t> > tmp;
 
                         for (auto jt = data.begin(); jt != data.end(); ++jt) {
+                            bool passes;
+                            if (it == transform.begin() && filter_program.has()
+                                && filter_program->eval(jt->get(), &passes)) {
+                                if (passes) {
+                                    tmp.push_back(jt->get());
+                                }
+                                continue;
+                            }
                             query_language::transform_apply(
                                 ql_env, jt->get(), &*it, &tmp);
                         }
@@ -826,21 +1704,169 @@ public:
         return ql_env->trace.get_or_null();
     }
 
+    // A read with a terminal goes through the whole range, one without stops at
+    // the end of its batch, which a small read reaches before long.
+    virtual bool leaves_accessed_once() THROWS_NOTHING {
+        return terminal || pairs_seen >= RGET_ACCESS_HINT_ONCE_MIN_ROWS;
+    }
 
-    bool bad_init;
-    transaction_t *transaction;
-    rget_read_response_t *response;
-    ql::env_t *ql_env;
-    ql::batcher_t batcher;
-    rdb_protocol_details::transform_t transform;
-    boost::optional<rdb_protocol_details::terminal_t> terminal;
+    bool counts_only() const {
+        return transform.empty() && !sindex_function && terminal
+            && boost::get<ql::count_wire_func_t>(&*terminal) != NULL;
+    }
+
+    // True if the query doesn't need any more of the documents than the index
+    // stores along with its entries, see query_reads_top_level_fields().
+    bool query_covered_by_stored_fields() const {
+        std::vector<std::string> fields;
+        if (!query_reads_top_level_fields(transform, terminal, &fields)) {
+            return false;
+        }
+        for (auto it = fields.begin(); it != fields.end(); ++it) {
+            if (std::find(stored_fields.begin(), stored_fields.end(), *it)
+                == stored_fields.end()) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Compiles the first transform to a filter program if it's a filter the
+    // program supports, see filter_program_t.
+    void init_filter_program() {
+        if (transform.empty()) {
+            return;
+        }
+        const filter_transform_t *filter
+            = boost::get<filter_transform_t>(&transform.front());
+        if (filter == NULL) {
+            return;
+        }
+        try {
+            filter_program.init(
+                ql::filter_program_t::compile(filter->filter_func.compile_wire_func()));
+        } catch (const ql::base_exc_t &) {
+            // The transform reports the error when it gets applied.
+        }
+    }
+
+    // Sets up the prefilter if the first transform of a primary btree read is a
+    // filter that only reads top-level fields of the documents.
+    void init_prefilter() {
+        if (sindex_function.has() || transform.empty()) {
+            return;
+        }
+        const filter_transform_t *filter
+            = boost::get<filter_transform_t>(&transform.front());
+        if (filter == NULL) {
+            return;
+        }
+        try {
+            counted_t<ql::func_t> func = filter->filter_func.compile_wire_func();
+            if (!ql::func_reads_top_level_fields(func, &prefilter_fields)) {
+                return;
+            }
+            if (filter->default_filter_val) {
+                prefilter_default = filter->default_filter_val->compile_wire_func();
+            }
+            prefilter_func = func;
+        } catch (const ql::base_exc_t &) {
+            // The transform reports the error when it gets applied.
+        }
+    }
+
+    // Applies the prefilter to the fields of the document it reads, without loading
+    // the rest.  Returns false if it couldn't tell whether the document passes.
+    bool try_prefilter(const rdb_value_t *value, bool *passes_out) {
+        counted_t<const ql::datum_t> fields
+            = get_data_fields(value, transaction, prefilter_fields);
+        if (!fields.has()) {
+            return false;
+        }
+        if (filter_program.has() && filter_program->eval(fields, passes_out)) {
+            return true;
+        }
+        try {
+            *passes_out = prefilter_func->filter_call(ql_env, fields, prefilter_default);
+            return true;
+        } catch (const ql::base_exc_t &) {
+            // Let the transform fail on the whole document, so that errors come out
+            // the same way as without the prefilter.
+            return false;
+        }
+    }
+
+    // Loads the document of a secondary index entry.  A covering entry holds its
+    // index value and the stored fields of the document instead of a reference to
+    // the document (see make_sindex_value_ref()).  The stored fields stand in for
+    // the document if they cover the query; otherwise the document is looked up in
+    // the primary btree.
+    counted_t<const ql::datum_t> load_sindex_entry(
+            const rdb_value_t *value, const store_key_t &store_key,
+            counted_t<const ql::datum_t> *index_value_out) {
+        counted_t<const ql::datum_t> entry = get_data(value, transaction);
+        if (entry->get_type() != ql::datum_t::R_ARRAY) {
+            // Documents are objects, so this entry refers to the document.
+            return entry;
+        }
+        *index_value_out = entry->get(0);
+        if (covered_by_stored_fields) {
+            return entry->get(1);
+        }
+
+        store_key_t pk(ql::datum_t::extract_primary(key_to_unescaped_str(store_key)));
+        // The lookup releases the superblock it gets, but we need to keep the
+        // primary superblock for the next one.
+        refcount_superblock_t superblock(primary_superblock, 2);
+        point_read_response_t res;
+        rdb_get(pk, primary_slice, transaction, &superblock, &res,
+                ql_env->trace.get_or_null());
+        return res.data;
+    }
+
+    bool bad_init;
+    // Set if the traversal stopped because of snapshot_over_budget().
+    bool over_snapshot_budget;
+    bool considered_a_pair;
+    // How many pairs the traversal passed to handle_pair().
+    int64_t pairs_seen;
+    transaction_t *transaction;
+    rget_read_response_t *response;
+    ql::env_t *ql_env;
+    ql::batcher_t batcher;
+    rdb_protocol_details::transform_t transform;
+    boost::optional<rdb_protocol_details::terminal_t> terminal;
     sorting_t sorting;
+    // Set for a `get_all` on a multi index, which skips the entries
+    // repeats_last_entry() tells it to.
+    bool skips_repeated_entries;
+    boost::optional<std::pair<std::string, std::string> > last_entry;
 
     /* Only present if we're doing a sindex read.*/
     boost::optional<key_range_t> primary_key_range;
     boost::optional<datum_range_t> sindex_range;
     counted_t<ql::func_t> sindex_function;
     boost::optional<sindex_multi_bool_t> sindex_multi;
+    boost::optional<ql::sindex_key_format_t> sindex_key_format;
+    // The fields a covering index stores along with its entries, and the primary
+    // btree to get the rest of the documents from.
+    std::vector<std::string> stored_fields;
+    bool covered_by_stored_fields;
+    btree_slice_t *primary_slice;
+    superblock_t *primary_superblock;
+
+    // Set if the first transform is a filter that only reads `prefilter_fields` of
+    // the documents, see init_prefilter().
+    counted_t<ql::func_t> prefilter_func;
+    counted_t<ql::func_t> prefilter_default;
+    std::vector<std::string> prefilter_fields;
+    // Set if the first transform is a filter that compiles to a program, which
+    // then goes first, before the function.  Empty if it didn't compile.
+    scoped_ptr_t<ql::filter_program_t> filter_program;
+
+    // Stands in for the documents when counts_only() or when they don't pass the
+    // prefilter.
+    counted_t<const ql::datum_t> count_placeholder;
 
     scoped_ptr_t<profile::disabler_t> disabler;
     scoped_ptr_t<profile::sampler_t> sampler;
@@ -854,26 +1880,75 @@ public:
     void operator()(const std::vector<ql::wire_datum_map_t> &) const { }
     void operator()(const rget_read_response_t::empty_t &) const { }
     void operator()(const counted_t<const ql::datum_t> &) const { }
+    void operator()(const ql::top_k_rows_t &) const { }
+    void operator()(const ql::group_accumulators_t &) const { }
+    void operator()(const ql::distinct_sketch_t &) const { }
+    void operator()(const ql::quantile_sketch_t &) const { }
+    void operator()(const ql::sample_rows_t &) const { }
 
     void operator()(ql::wire_datum_map_t &dm) const {  // NOLINT(runtime/references)
         dm.finalize();
     }
 };
 
+/* Answers a `count` without transforms over the whole key range, which is
+`table.count()` on a table with a single key range shard, from the population in
+the stat block.  The btree only holds the documents of its region, so that's all
+of them.  Counts with a filter or over part of the key range, such as `between()`
+or any count on a table with several key range shards, return false and walk the
+leaves: internal nodes don't keep the counts of their subtrees.
+
+TODO: Keep a count per child in internal nodes, so that counts over any key range
+and `skip(n)` only read O(height) nodes per shard.  Internal nodes have no room
+for them in their current format, so it needs a new one that the serializer's
+static config says a btree has.  The write path also has to update every
+ancestor's count, but it releases the ancestors on the way down, before the leaf
+knows whether the key is new. */
+static bool count_whole_btree_from_stat_block(
+        const key_range_t &range,
+        const rdb_protocol_details::transform_t &transform,
+        const boost::optional<rdb_protocol_details::terminal_t> &terminal,
+        transaction_t *txn, superblock_t *superblock,
+        rget_read_response_t *response) {
+    if (range != key_range_t::universe() || !transform.empty() || !terminal
+        || boost::get<ql::count_wire_func_t>(&*terminal) == NULL) {
+        return false;
+    }
+    int64_t population = 0;
+    if (superblock->get_stat_block_id() != NULL_BLOCK_ID) {
+        buf_lock_t stat_block(txn, superblock->get_stat_block_id(), rwi_read);
+        population = static_cast<const btree_statblock_t *>(
+            stat_block.get_data_read())->population;
+    }
+    response->result = make_counted<const ql::datum_t>(static_cast<double>(population));
+    response->truncated = false;
+    return true;
+}
+
 void rdb_rget_slice(btree_slice_t *slice, const key_range_t &range,
                     transaction_t *txn, superblock_t *superblock,
                     ql::env_t *ql_env, const ql::batchspec_t &batchspec,
                     const rdb_protocol_details::transform_t &transform,
                     const boost::optional<rdb_protocol_details::terminal_t> &terminal,
                     sorting_t sorting,
-                    rget_read_response_t *response) {
+                    rget_read_response_t *response,
+                    bool release_superblock) {
     profile::starter_t starter("Do range scan on primary index.", ql_env->trace);
+
+    if (count_whole_btree_from_stat_block(range, transform, terminal,
+                                          txn, superblock, response)) {
+        return;
+    }
+
+    txn->set_single_pass();
     rdb_rget_depth_first_traversal_callback_t callback(
         txn, ql_env, batchspec, transform, terminal, range, sorting, response);
     btree_concurrent_traversal(slice, txn, superblock, range, &callback,
-                               (!reversed(sorting) ? FORWARD : BACKWARD));
+                               (!reversed(sorting) ? FORWARD : BACKWARD),
+                               release_superblock);
 
-    response->truncated = callback.batcher.should_send_batch();
+    response->truncated = callback.batcher.should_send_batch()
+        || callback.over_snapshot_budget;
 
     boost::apply_visitor(result_finalizer_visitor_t(), response->result);
 }
@@ -892,22 +1967,210 @@ void rdb_rget_secondary_slice(
     sorting_t sorting,
     const ql::map_wire_func_t &sindex_func,
     sindex_multi_bool_t sindex_multi,
+    ql::sindex_key_format_t sindex_key_format,
+    const std::vector<std::string> &stored_fields,
+    btree_slice_t *primary_slice,
+    superblock_t *primary_superblock,
     rget_read_response_t *response) {
     profile::starter_t starter("Do range scan on secondary index.", ql_env->trace);
+    // The parsing node can't tell which keys hold `sindex_range`, since that
+    // depends on the format of the index.
+    const key_range_t sindex_keys = sindex_region.inner.intersection(
+        sindex_range.to_sindex_keyrange(sindex_key_format));
+    // Only the leaves of the sindex btree are passed, documents that aren't
+    // covered by the index are looked up in the primary btree as usual.
+    txn->set_single_pass();
     rdb_rget_depth_first_traversal_callback_t callback(
-        txn, ql_env, batchspec, transform, terminal, sindex_region.inner, pk_range,
-        sorting, sindex_func, sindex_multi, sindex_range, response);
+        txn, ql_env, batchspec, transform, terminal, sindex_keys, pk_range,
+        sorting, sindex_func, sindex_multi, sindex_key_format, sindex_range,
+        stored_fields, primary_slice, primary_superblock, response);
     btree_concurrent_traversal(
-        slice, txn, superblock, sindex_region.inner, &callback,
+        slice, txn, superblock, sindex_keys, &callback,
         (!reversed(sorting) ? FORWARD : BACKWARD));
 
-    response->truncated = callback.batcher.should_send_batch();
+    response->truncated = callback.batcher.should_send_batch()
+        || callback.over_snapshot_budget;
+    response->key_format = sindex_key_format;
 
     boost::apply_visitor(result_finalizer_visitor_t(), response->result);
 }
 
-void rdb_distribution_get(btree_slice_t *slice, int max_depth, const store_key_t &left_key,
-                          transaction_t *txn, superblock_t *superblock, distribution_read_response_t *response) {
+// Looks up the entry at `key`, keeping `superblock` for the next lookup.
+bool rdb_find_entry(btree_slice_t *slice, transaction_t *txn, superblock_t *superblock,
+                    const store_key_t &key,
+                    keyvalue_location_t<rdb_value_t> *kv_location_out,
+                    profile::trace_t *trace) {
+    // The lookup releases the superblock it gets.
+    refcount_superblock_t refcount_superblock(superblock, 2);
+    find_keyvalue_location_for_read(txn, &refcount_superblock, key.btree_key(),
+                                    kv_location_out, slice->root_eviction_priority,
+                                    &slice->stats, trace);
+    return kv_location_out->value.has();
+}
+
+// Collects the keys of up to `limit` pairs.
+class rdb_collect_keys_callback_t : public depth_first_traversal_callback_t {
+public:
+    rdb_collect_keys_callback_t(size_t _limit, std::vector<std::string> *_keys_out)
+        : limit(_limit), keys_out(_keys_out) { }
+
+    bool handle_pair(scoped_key_value_t &&keyvalue) {
+        keys_out->push_back(key_to_unescaped_str(store_key_t(keyvalue.key())));
+        return keys_out->size() < limit;
+    }
+
+private:
+    const size_t limit;
+    std::vector<std::string> *const keys_out;
+};
+
+/* The entries of an index for one value are ordered by the primary keys after the
+value, which orders them by primary key, but not quite: the entry of a key that is
+a prefix of another goes on with the offset byte of the mangled key where the other
+goes on with the rest of its key, see datum_t::mangle_secondary().  So an entry
+after `key`, the one of `pk`, may belong to a prefix of `pk`, and those are the
+only primary keys smaller than `pk` that come after it.  They're looked up into
+`*candidates`, and `*looked_up`, so that the scan passes them when it gets to them.
+That's rare, since the offset is the size of the value's key and the byte has to
+be no greater. */
+void rdb_find_prefix_entries(const rdb_equality_index_t &index, transaction_t *txn,
+                             const key_range_t &range, const std::string &key,
+                             const std::string &pk, std::set<store_key_t> *looked_up,
+                             std::set<store_key_t> *candidates,
+                             profile::trace_t *trace) {
+    const uint8_t pk_offset = static_cast<uint8_t>(index.secondary.size());
+    for (size_t size = 1; size < pk.size(); ++size) {
+        if (static_cast<uint8_t>(pk[size]) > pk_offset) {
+            continue;
+        }
+        const std::string prefix_key
+            = ql::datum_t::mangle_secondary(index.secondary, pk.substr(0, size), "");
+        store_key_t prefix(pk.substr(0, size));
+        if (prefix_key <= key || !range.contains_key(prefix)
+            || looked_up->count(prefix) != 0) {
+            continue;
+        }
+        keyvalue_location_t<rdb_value_t> entry;
+        if (rdb_find_entry(index.slice, txn, index.superblock, store_key_t(prefix_key),
+                           &entry, trace)) {
+            looked_up->insert(prefix);
+            candidates->insert(prefix);
+        }
+    }
+}
+
+void rdb_rget_intersection_slice(
+    btree_slice_t *slice,
+    const key_range_t &range,
+    transaction_t *txn,
+    superblock_t *superblock,
+    ql::env_t *ql_env,
+    const ql::batchspec_t &batchspec,
+    const rdb_protocol_details::transform_t &transform,
+    const boost::optional<rdb_protocol_details::terminal_t> &terminal,
+    const std::vector<rdb_equality_index_t> &indexes,
+    rget_read_response_t *response) {
+    profile::starter_t starter("Do range scan on the intersection of indexes.",
+                               ql_env->trace);
+    guarantee(!indexes.empty());
+    profile::trace_t *trace = ql_env->trace.get_or_null();
+    rdb_rget_depth_first_traversal_callback_t callback(
+        txn, ql_env, batchspec, transform, terminal, range, sorting_t::UNORDERED,
+        response);
+
+    const rdb_equality_index_t &scanned = indexes[0];
+    // Every entry of a primary key from `range.left` on is after this.
+    key_range_t scan = rdb_protocol_t::sindex_key_range(
+        store_key_t(scanned.secondary + key_to_unescaped_str(range.left)),
+        store_key_t(scanned.secondary));
+    std::set<store_key_t> looked_up;
+    bool done = false;
+    bool stopped = false;
+    while (!done && !stopped) {
+        std::vector<std::string> keys;
+        rdb_collect_keys_callback_t collector(SINDEX_INTERSECTION_CHUNK_SIZE, &keys);
+        done = btree_depth_first_traversal(scanned.slice, txn, scanned.superblock,
+                                           scan, &collector, FORWARD, false);
+
+        // The documents go through in primary key order, so that the last one
+        // considered is as far as the read got.
+        std::set<store_key_t> candidates;
+        for (auto it = keys.begin(); it != keys.end(); ++it) {
+            if (ql::datum_t::extract_secondary(*it) != scanned.secondary) {
+                continue;
+            }
+            const std::string pk = ql::datum_t::extract_primary(*it);
+            rdb_find_prefix_entries(scanned, txn, range, *it, pk, &looked_up,
+                                    &candidates, trace);
+            store_key_t primary_key(pk);
+            if (!range.right.unbounded && !(primary_key < range.right.key)) {
+                // Only the prefixes of this key can still be in the range.
+                done = true;
+                break;
+            }
+            if (range.contains_key(primary_key) && looked_up.count(primary_key) == 0) {
+                candidates.insert(primary_key);
+            }
+        }
+
+        for (auto it = candidates.begin(); it != candidates.end() && !stopped; ++it) {
+            const std::string pk = key_to_unescaped_str(*it);
+            bool in_all = true;
+            for (size_t i = 1; i < indexes.size() && in_all; ++i) {
+                keyvalue_location_t<rdb_value_t> entry;
+                in_all = rdb_find_entry(
+                    indexes[i].slice, txn, indexes[i].superblock,
+                    store_key_t(ql::datum_t::mangle_secondary(indexes[i].secondary, pk, "")),
+                    &entry, trace);
+            }
+            if (!in_all) {
+                continue;
+            }
+            keyvalue_location_t<rdb_value_t> document;
+            if (rdb_find_entry(slice, txn, superblock, *it, &document, trace)) {
+                stopped = !callback.handle_document(*it, document.value.get());
+            }
+        }
+
+        if (!keys.empty()) {
+            store_key_t next(keys.back());
+            if (next.increment()) {
+                scan.left = next;
+            } else {
+                done = true;
+            }
+        }
+    }
+
+    response->truncated = callback.batcher.should_send_batch()
+        || callback.over_snapshot_budget;
+
+    boost::apply_visitor(result_finalizer_visitor_t(), response->result);
+}
+
+void rdb_distribution_get(btree_slice_t *slice, distribution_mode_t mode, int max_depth,
+                          const store_key_t &left_key, transaction_t *txn,
+                          superblock_t *superblock, distribution_read_response_t *response) {
+    if (mode == distribution_mode_t::SAMPLE) {
+        int64_t key_count_out;
+        std::vector<key_distribution_bucket_t> buckets;
+        sample_btree_key_distribution(txn, superblock, DISTRIBUTION_SAMPLE_DESCENTS,
+                                      &key_count_out, &buckets);
+        if (buckets.empty()) {
+            response->key_counts[left_key] = key_count_out;
+            response->byte_counts[left_key] = 0;
+            return;
+        }
+        // The first bucket starts at `left_key`, not at the first key we happened
+        // to see.
+        for (size_t i = 0; i < buckets.size(); ++i) {
+            const store_key_t &key = i == 0 ? left_key : buckets[i].left_key;
+            response->key_counts[key] = buckets[i].key_count;
+            response->byte_counts[key] = buckets[i].byte_count;
+        }
+        return;
+    }
+
     int64_t key_count_out;
     std::vector<store_key_t> key_splits;
     get_btree_key_distribution(slice, txn, superblock, max_depth, &key_count_out, &key_splits);
@@ -978,10 +2241,11 @@ rdb_modification_report_cb_t::rdb_modification_report_cb_t(
         btree_store_t<rdb_protocol_t> *store,
         write_token_pair_t *token_pair,
         transaction_t *txn, block_id_t sindex_block_id,
-        auto_drainer_t::lock_t lock)
+        auto_drainer_t::lock_t lock,
+        ql::changefeed::server_t *changefeed_server)
     : store_(store), token_pair_(token_pair),
       txn_(txn), sindex_block_id_(sindex_block_id),
-      lock_(lock)
+      lock_(lock), changefeed_server_(changefeed_server)
 { }
 
 rdb_modification_report_cb_t::~rdb_modification_report_cb_t() {
@@ -990,8 +2254,7 @@ rdb_modification_report_cb_t::~rdb_modification_report_cb_t() {
     }
 }
 
-void rdb_modification_report_cb_t::on_mod_report(
-        const rdb_modification_report_t &mod_report) {
+void rdb_modification_report_cb_t::acquire_sindexes() {
     if (!sindex_block_.has()) {
         // Don't allow interruption here, or we may end up with inconsistent data
         cond_t dummy_interruptor;
@@ -1002,6 +2265,29 @@ void rdb_modification_report_cb_t::on_mod_report(
         store_->aquire_post_constructed_sindex_superblocks_for_write(
                 sindex_block_.get(), txn_, &sindexes_);
     }
+}
+
+btree_store_t<rdb_protocol_t>::sindex_access_t *
+rdb_modification_report_cb_t::get_sindex(const std::string &id, bool *exists_out) {
+    acquire_sindexes();
+    std::map<std::string, secondary_index_t> sindexes;
+    get_secondary_indexes(txn_, sindex_block_.get(), &sindexes);
+    auto it = sindexes.find(id);
+    *exists_out = (it != sindexes.end());
+    if (it == sindexes.end()) {
+        return NULL;
+    }
+    for (auto jt = sindexes_.begin(); jt != sindexes_.end(); ++jt) {
+        if (jt->sindex.id == it->second.id) {
+            return &*jt;
+        }
+    }
+    return NULL;
+}
+
+void rdb_modification_report_cb_t::on_mod_report(
+        const rdb_modification_report_t &mod_report) {
+    acquire_sindexes();
 
     mutex_t::acq_t acq;
     store_->lock_sindex_queue(sindex_block_.get(), &acq);
@@ -1010,125 +2296,744 @@ void rdb_modification_report_cb_t::on_mod_report(
     wm << rdb_sindex_change_t(mod_report);
     store_->sindex_queue_push(wm, &acq);
 
-    rdb_update_sindexes(sindexes_, &mod_report, txn_);
+    mod_reports_.push_back(mod_report);
+
+    if (changefeed_server_ != NULL) {
+        changefeed_server_->send_change(mod_report);
+    }
+}
+
+void rdb_modification_report_cb_t::finish() {
+    if (mod_reports_.empty()) {
+        return;
+    }
+    rdb_update_sindexes(sindexes_, mod_reports_, txn_);
+    mod_reports_.clear();
 }
 
 typedef btree_store_t<rdb_protocol_t>::sindex_access_vector_t sindex_access_vector_t;
 
+// An index function, compiled once for all the documents it gets called on.
+// Functions that only get fields of the document skip the interpreter.
+class compiled_sindex_func_t {
+public:
+    explicit compiled_sindex_func_t(const ql::map_wire_func_t &mapping)
+        : func(mapping.compile_wire_func()),
+          extractor(ql::field_extractor_t::create(func)) { }
+
+    counted_t<const ql::datum_t> call(ql::env_t *env,
+                                      const counted_t<const ql::datum_t> &doc) const {
+        counted_t<const ql::datum_t> res;
+        if (extractor.has() && extractor->extract(doc, &res)) {
+            return res;
+        }
+        return func->call(env, doc)->as_datum();
+    }
+
+private:
+    counted_t<ql::func_t> func;
+    scoped_ptr_t<ql::field_extractor_t> extractor;
+
+    DISABLE_COPYING(compiled_sindex_func_t);
+};
+
+// The entry of `doc` in an aggregate index, `[group, field]` with the group its
+// function puts the row in and the field the index sums up, or null if the row
+// doesn't have it.  It's `[]` for the rows whose group `groupby` would fail on, or
+// whose field isn't a number, or whose summary wouldn't fit in the leaf, which the
+// summaries leave out (see AGGREGATE_SUMMARY_KEY_PREFIX).
+counted_t<const ql::datum_t> aggregate_row_entry(
+        const compiled_sindex_func_t &group_func,
+        const std::vector<std::string> &stored_fields,
+        const counted_t<const ql::datum_t> &doc, ql::env_t *env) {
+    try {
+        counted_t<const ql::datum_t> group = group_func.call(env, doc);
+        counted_t<const ql::datum_t> field;
+        if (!stored_fields.empty()) {
+            field = doc->get(stored_fields[0], ql::NOTHROW);
+        }
+        if (!field.has()) {
+            field = make_counted<const ql::datum_t>(ql::datum_t::R_NULL);
+        }
+        if (field->get_type() == ql::datum_t::R_NUM
+            || field->get_type() == ql::datum_t::R_NULL) {
+            std::string sort_key;
+            ql::append_sort_key(*group, &sort_key);
+            if (sort_key.size() < MAX_KEY_SIZE
+                && serialized_size(make_aggregate_summary(group, 0, 0, 0))
+                   < static_cast<size_t>(blob::btree_maxreflen)) {
+                std::vector<counted_t<const ql::datum_t> > entry;
+                entry.push_back(group);
+                entry.push_back(field);
+                return make_counted<const ql::datum_t>(std::move(entry));
+            }
+        }
+    } catch (const ql::base_exc_t &) {
+        // `groupby` fails on the row, so the scan that the summaries leave it to
+        // reports that.
+    }
+    return make_counted<const ql::datum_t>(ql::datum_t::R_ARRAY);
+}
+
+// `index_values_out` gets the index value each of the keys is for, unless it's
+// NULL.
 void compute_keys(const store_key_t &primary_key, counted_t<const ql::datum_t> doc,
-                  ql::map_wire_func_t *mapping, sindex_multi_bool_t multi, ql::env_t *env,
-                  std::vector<store_key_t> *keys_out) {
+                  const compiled_sindex_func_t &mapping, sindex_multi_bool_t multi,
+                  ql::sindex_key_format_t key_format,
+                  ql::env_t *env, std::vector<store_key_t> *keys_out,
+                  std::vector<counted_t<const ql::datum_t> > *index_values_out) {
     guarantee(keys_out->empty());
-    counted_t<const ql::datum_t> index =
-        mapping->compile_wire_func()->call(env, doc)->as_datum();
-
-    if (multi == sindex_multi_bool_t::MULTI && index->get_type() == ql::datum_t::R_ARRAY) {
+    counted_t<const ql::datum_t> index = mapping.call(env, doc);
+
+    if (multi == sindex_multi_bool_t::TEXT) {
+        // The terms' keys are never truncated, and their tag is their count, see
+        // rdb_text_search().
+        std::vector<std::string> terms;
+        ql::tokenize_text(index->as_str(), &terms);
+        std::map<std::string, uint64_t> counts;
+        ql::count_text_terms(terms, &counts);
+        for (auto it = counts.begin(); it != counts.end(); ++it) {
+            counted_t<const ql::datum_t> term
+                = make_counted<const ql::datum_t>(std::string(it->first));
+            keys_out->push_back(
+                store_key_t(term->print_secondary(key_format, primary_key, it->second)));
+            if (index_values_out != NULL) {
+                index_values_out->push_back(term);
+            }
+        }
+    } else if (multi == sindex_multi_bool_t::MULTI
+               && index->get_type() == ql::datum_t::R_ARRAY) {
         for (uint64_t i = 0; i < index->size(); ++i) {
+            counted_t<const ql::datum_t> value = index->get(i, ql::THROW);
             keys_out->push_back(
-                store_key_t(index->get(i, ql::THROW)->print_secondary(primary_key, i)));
+                store_key_t(value->print_secondary(key_format, primary_key, i)));
+            if (index_values_out != NULL) {
+                index_values_out->push_back(value);
+            }
         }
     } else {
-        keys_out->push_back(store_key_t(index->print_secondary(primary_key)));
+        // Projection indexes map every row to its primary key, like a single index.
+        keys_out->push_back(store_key_t(index->print_secondary(key_format, primary_key)));
+        if (index_values_out != NULL) {
+            index_values_out->push_back(index);
+        }
     }
 }
 
-/* Used below by rdb_update_sindexes. */
-void rdb_update_single_sindex(
-        const btree_store_t<rdb_protocol_t>::sindex_access_t *sindex,
-        const rdb_modification_report_t *modification,
-        transaction_t *txn,
-        auto_drainer_t::lock_t) {
-    // Note if you get this error it's likely that you've passed in a default
-    // constructed mod_report. Don't do that.  Mod reports should always be passed
-    // to a function as an output parameter before they're passed to this
-    // function.
-    guarantee(modification->primary_key.size() != 0);
+// Collects the primary keys of `pk_range` whose entries in a secondary index have
+// a value in `sindex_range`.  A whole binary key holds the value of its entry, the
+// documents of the other entries get looked up to call the index function again.
+class rdb_sindex_range_keys_callback_t : public depth_first_traversal_callback_t {
+public:
+    rdb_sindex_range_keys_callback_t(const btree_info_t &_info, superblock_t *_superblock,
+                                     const ql::map_wire_func_t &mapping,
+                                     sindex_multi_bool_t _multi,
+                                     ql::sindex_key_format_t _key_format,
+                                     const datum_range_t &_sindex_range,
+                                     const key_range_t &_pk_range, ql::env_t *_ql_env,
+                                     profile::trace_t *_trace,
+                                     std::set<store_key_t> *_keys_out)
+        : info(_info), superblock(_superblock), sindex_func(mapping), multi(_multi),
+          key_format(_key_format), sindex_range(_sindex_range), pk_range(_pk_range),
+          ql_env(_ql_env), trace(_trace), keys_out(_keys_out) { }
+
+    bool handle_pair(scoped_key_value_t &&keyvalue) {
+        const store_key_t store_key(keyvalue.key());
+        const std::string key = key_to_unescaped_str(store_key);
+        const store_key_t primary_key(ql::datum_t::extract_primary(key));
+        if (!pk_range.contains_key(primary_key) || keys_out->count(primary_key) != 0) {
+            return true;
+        }
+
+        counted_t<const ql::datum_t> sindex_value;
+        if (key_format == ql::sindex_key_format_t::BINARY
+            && !ql::datum_t::key_is_truncated(store_key)) {
+            sindex_value = ql::datum_t::from_binary_secondary(
+                ql::datum_t::extract_secondary(key));
+        }
+        if (!sindex_value.has()) {
+            keyvalue_location_t<rdb_value_t> document;
+            if (!rdb_find_entry(info.slice, info.txn, superblock, primary_key,
+                                &document, trace)) {
+                return true;
+            }
+            try {
+                sindex_value = sindex_func.call(
+                    ql_env, get_data(document.value.get(), info.txn));
+                if (multi == sindex_multi_bool_t::MULTI
+                    && sindex_value->get_type() == ql::datum_t::R_ARRAY) {
+                    boost::optional<uint64_t> tag = ql::datum_t::extract_tag(key);
+                    guarantee(tag);
+                    guarantee(sindex_value->size() > *tag);
+                    sindex_value = sindex_value->get(*tag);
+                }
+            } catch (const ql::base_exc_t &) {
+                // The document had a value when the entry was written.
+                return true;
+            }
+        }
+        if (sindex_range.contains(sindex_value)) {
+            keys_out->insert(primary_key);
+        }
+        return true;
+    }
+
+private:
+    const btree_info_t &info;
+    superblock_t *const superblock;
+    const compiled_sindex_func_t sindex_func;
+    const sindex_multi_bool_t multi;
+    const ql::sindex_key_format_t key_format;
+    const datum_range_t &sindex_range;
+    const key_range_t &pk_range;
+    ql::env_t *const ql_env;
+    profile::trace_t *const trace;
+    std::set<store_key_t> *const keys_out;
+};
+
+class null_replacer_t : public btree_batched_replacer_t {
+public:
+    counted_t<const ql::datum_t> replace(const counted_t<const ql::datum_t> &,
+                                         size_t) const {
+        return make_counted<const ql::datum_t>(ql::datum_t::R_NULL);
+    }
+    bool should_return_vals() const { return false; }
+    bool should_return_stats() const { return true; }
+};
+
+batched_replace_response_t rdb_delete_sindex_range(
+    const btree_info_t &info,
+    scoped_ptr_t<superblock_t> *superblock,
+    const std::string &sindex_id,
+    const datum_range_t &sindex_range,
+    const key_range_t &pk_range,
+    ql::env_t *ql_env,
+    rdb_modification_report_cb_t *sindex_cb,
+    boost::optional<ql::datum_exc_t> *error_out,
+    profile::trace_t *trace) {
+    profile::starter_t starter("Delete a range of a secondary index.", trace);
+    bool exists;
+    btree_store_t<rdb_protocol_t>::sindex_access_t *sindex
+        = sindex_cb->get_sindex(sindex_id, &exists);
+    if (sindex == NULL) {
+        *error_out = ql::datum_exc_t(
+            ql::base_exc_t::GENERIC,
+            exists
+            ? strprintf("Index `%s` was accessed before its construction was finished.",
+                        sindex_id.c_str())
+            : strprintf("Index `%s` was not found.", sindex_id.c_str()));
+        return make_counted<const ql::datum_t>(ql::datum_t::R_OBJECT);
+    }
 
     ql::map_wire_func_t mapping;
-    sindex_multi_bool_t multi = sindex_multi_bool_t::MULTI;
-    vector_read_stream_t read_stream(&sindex->sindex.opaque_definition);
-    archive_result_t success = deserialize(&read_stream, &mapping);
+    sindex_multi_bool_t multi;
+    std::vector<std::string> stored_fields;
+    ql::sindex_key_format_t key_format;
+    deserialize_sindex_info(sindex->sindex.opaque_definition, &mapping, &multi,
+                            &stored_fields, &key_format);
+    if (multi == sindex_multi_bool_t::AGGREGATE) {
+        *error_out = ql::datum_exc_t(
+            ql::base_exc_t::GENERIC,
+            strprintf("Index `%s` is an aggregate index, which only answers `groupby`.",
+                      sindex_id.c_str()));
+        return make_counted<const ql::datum_t>(ql::datum_t::R_OBJECT);
+    }
+    // The keys of a hash index don't keep the order of its values.
+    if (key_format == ql::sindex_key_format_t::HASH && !sindex_range.is_point()) {
+        *error_out = ql::datum_exc_t(
+            ql::base_exc_t::GENERIC,
+            strprintf("Index `%s` is a hash index, which can only be "
+                      "read with `get_all`.", sindex_id.c_str()));
+        return make_counted<const ql::datum_t>(ql::datum_t::R_OBJECT);
+    }
+
+    // The index keeps its superblock for the updates of the deletes.
+    std::set<store_key_t> keys;
+    rdb_sindex_range_keys_callback_t callback(
+        info, superblock->get(), mapping, multi, key_format, sindex_range, pk_range,
+        ql_env, trace, &keys);
+    btree_depth_first_traversal(sindex->btree, info.txn, sindex->super_block.get(),
+                                sindex_range.to_sindex_keyrange(key_format),
+                                &callback, FORWARD, false);
+
+    null_replacer_t replacer;
+    return rdb_batched_replace(info, superblock,
+                               std::vector<store_key_t>(keys.begin(), keys.end()),
+                               &replacer, sindex_cb, trace);
+}
+
+// Goes through the entries of a term in a text index, adding their counts up for
+// the primary keys of `pk_range` that `*previous` has, or for all of them if it's
+// NULL.
+class rdb_text_postings_callback_t : public depth_first_traversal_callback_t {
+public:
+    rdb_text_postings_callback_t(const std::string &_secondary,
+                                 const key_range_t *_pk_range,
+                                 const std::map<store_key_t, uint64_t> *_previous,
+                                 std::map<store_key_t, uint64_t> *_counts_out)
+        : secondary(_secondary), pk_range(_pk_range), previous(_previous),
+          counts_out(_counts_out) { }
+
+    bool handle_pair(scoped_key_value_t &&keyvalue) {
+        const std::string key = key_to_unescaped_str(store_key_t(keyvalue.key()));
+        if (ql::datum_t::extract_secondary(key) != secondary) {
+            return true;
+        }
+        store_key_t primary_key(ql::datum_t::extract_primary(key));
+        if (!pk_range->contains_key(primary_key)) {
+            return true;
+        }
+        boost::optional<uint64_t> count = ql::datum_t::extract_tag(key);
+        guarantee(count);
+        if (previous == NULL) {
+            (*counts_out)[primary_key] = *count;
+        } else {
+            auto it = previous->find(primary_key);
+            if (it != previous->end()) {
+                (*counts_out)[primary_key] = it->second + *count;
+            }
+        }
+        return true;
+    }
+
+private:
+    const std::string &secondary;
+    const key_range_t *const pk_range;
+    const std::map<store_key_t, uint64_t> *const previous;
+    std::map<store_key_t, uint64_t> *const counts_out;
+};
+
+void rdb_text_search(btree_slice_t *sindex_slice, superblock_t *sindex_superblock,
+                     btree_slice_t *slice, superblock_t *superblock,
+                     transaction_t *txn, ql::env_t *ql_env,
+                     const ql::map_wire_func_t &mapping,
+                     const std::vector<std::string> &terms, bool phrase, size_t limit,
+                     const key_range_t &pk_range,
+                     text_search_response_t *response) {
+    profile::starter_t starter("Search a text index.", ql_env->trace);
+    profile::trace_t *trace = ql_env->trace.get_or_null();
+    std::vector<rdb_protocol_details::text_search_hit_t> hits;
+    if (terms.empty() || limit == 0) {
+        response->result = hits;
+        return;
+    }
+
+    // The rows that have every term so far, and how many times they have them.
+    std::map<store_key_t, uint64_t> counts;
+    std::set<std::string> distinct_terms(terms.begin(), terms.end());
+    bool first = true;
+    for (auto it = distinct_terms.begin(); it != distinct_terms.end(); ++it) {
+        if (!first && counts.empty()) {
+            break;
+        }
+        const std::string secondary = key_to_unescaped_str(
+            make_counted<const ql::datum_t>(std::string(*it))
+                ->truncated_secondary(ql::sindex_key_format_t::BINARY));
+        std::map<store_key_t, uint64_t> term_counts;
+        rdb_text_postings_callback_t callback(secondary, &pk_range,
+                                              first ? NULL : &counts, &term_counts);
+        btree_depth_first_traversal(
+            sindex_slice, txn, sindex_superblock,
+            rdb_protocol_t::sindex_key_range(store_key_t(secondary),
+                                             store_key_t(secondary)),
+            &callback, FORWARD, false);
+        counts.swap(term_counts);
+        first = false;
+    }
+
+    std::vector<rdb_protocol_details::text_search_hit_t> candidates;
+    candidates.reserve(counts.size());
+    for (auto it = counts.begin(); it != counts.end(); ++it) {
+        candidates.push_back(rdb_protocol_details::text_search_hit_t(
+            it->second, it->first, counted_t<const ql::datum_t>()));
+    }
+    std::sort(candidates.begin(), candidates.end(),
+              &rdb_protocol_details::better_text_search_hit);
+
+    // Only the rows that get returned are read, except that a phrase has to be
+    // looked for in the text of each row until enough of them have it.
+    scoped_ptr_t<compiled_sindex_func_t> func;
+    if (phrase) {
+        func.init(new compiled_sindex_func_t(mapping));
+    }
+    for (auto it = candidates.begin(); it != candidates.end() && hits.size() < limit;
+         ++it) {
+        keyvalue_location_t<rdb_value_t> location;
+        if (!rdb_find_entry(slice, txn, superblock, it->key, &location, trace)) {
+            continue;
+        }
+        it->data = get_data(location.value.get(), txn);
+        if (phrase) {
+            std::vector<std::string> text_terms;
+            try {
+                ql::tokenize_text(func->call(ql_env, it->data)->as_str(), &text_terms);
+            } catch (const ql::base_exc_t &) {
+                continue;
+            }
+            if (!ql::terms_contain_phrase(text_terms, terms)) {
+                continue;
+            }
+        }
+        hits.push_back(*it);
+    }
+    response->result = std::move(hits);
+}
+
+// Adds up the summaries of an aggregate index, stopping at the count of the rows
+// that can't be summarized, which comes first.
+class rdb_aggregate_summaries_callback_t : public depth_first_traversal_callback_t {
+public:
+    rdb_aggregate_summaries_callback_t(transaction_t *_txn,
+                                       ql::group_accumulators_t *_accumulators,
+                                       profile::trace_t *_trace)
+        : txn(_txn), accumulators(_accumulators), trace(_trace), summarized(true) { }
+
+    bool handle_pair(scoped_key_value_t &&keyvalue) {
+        if (keyvalue.key()->size == 1) {
+            summarized = false;
+            return false;
+        }
+        counted_t<const ql::datum_t> summary = get_data(
+            static_cast<const rdb_value_t *>(keyvalue.value()), txn);
+        try {
+            accumulators->add_summary(summary->get(0), summary->get(1)->as_num(),
+                                      summary->get(2)->as_num(),
+                                      summary->get(3)->as_num());
+        } catch (const ql::datum_exc_t &e) {
+            error = e;
+            return false;
+        }
+        return true;
+    }
+
+    profile::trace_t *get_trace() THROWS_NOTHING { return trace; }
+
+    transaction_t *const txn;
+    ql::group_accumulators_t *const accumulators;
+    profile::trace_t *const trace;
+    bool summarized;
+    boost::optional<ql::datum_exc_t> error;
+};
+
+bool rdb_read_aggregate_index(btree_slice_t *sindex_slice,
+                              superblock_t *sindex_superblock,
+                              transaction_t *txn,
+                              ql::group_aggregator_t aggregator,
+                              rget_read_response_t *response,
+                              profile::trace_t *trace) {
+    profile::starter_t starter("Read the summaries of an aggregate index.", trace);
+    ql::group_accumulators_t accumulators(aggregator);
+    rdb_aggregate_summaries_callback_t callback(txn, &accumulators, trace);
+    btree_depth_first_traversal(
+        sindex_slice, txn, sindex_superblock,
+        key_range_t(key_range_t::closed,
+                    store_key_t(std::string(1, AGGREGATE_SUMMARY_KEY_PREFIX)),
+                    key_range_t::open,
+                    store_key_t(std::string(1, AGGREGATE_ROW_KEY_PREFIX))),
+        &callback, FORWARD);
+    if (!callback.summarized) {
+        return false;
+    }
+    if (callback.error) {
+        response->result = *callback.error;
+    } else {
+        response->result = std::move(accumulators);
+    }
+    response->truncated = false;
+    return true;
+}
+
+void deserialize_sindex_info(const std::vector<char> &data,
+                             ql::map_wire_func_t *mapping,
+                             sindex_multi_bool_t *multi,
+                             std::vector<std::string> *stored_fields,
+                             ql::sindex_key_format_t *key_format) {
+    vector_read_stream_t read_stream(&data);
+    archive_result_t success = deserialize(&read_stream, mapping);
     guarantee_deserialization(success, "sindex deserialize");
-    success = deserialize(&read_stream, &multi);
+    success = deserialize(&read_stream, multi);
     guarantee_deserialization(success, "sindex deserialize");
 
-    // TODO we just use a NULL environment here. People should not be able
-    // to do anything that requires an environment like gets from other
-    // tables etc. but we don't have a nice way to disallow those things so
-    // for now we pass null and it will segfault if an illegal sindex
-    // mapping is passed.
-    cond_t non_interruptor;
-    ql::env_t env(&non_interruptor);
+    // Indexes created before there were stored fields end here.
+    success = deserialize(&read_stream, stored_fields);
+    if (success == ARCHIVE_SOCK_EOF) {
+        stored_fields->clear();
+        *key_format = ql::sindex_key_format_t::LEGACY;
+        return;
+    }
+    guarantee_deserialization(success, "sindex deserialize");
 
-    superblock_t *super_block = sindex->super_block.get();
+    // And those created before there were binary keys end here.
+    success = deserialize(&read_stream, key_format);
+    if (success == ARCHIVE_SOCK_EOF) {
+        *key_format = ql::sindex_key_format_t::LEGACY;
+    } else {
+        guarantee_deserialization(success, "sindex deserialize");
+    }
+}
 
-    if (modification->info.deleted.first) {
-        guarantee(!modification->info.deleted.second.empty());
-        try {
-            counted_t<const ql::datum_t> deleted = modification->info.deleted.first;
+void make_sindex_value_ref(transaction_t *txn, const std::vector<std::string> &stored_fields,
+                           counted_t<const ql::datum_t> index_value,
+                           counted_t<const ql::datum_t> doc,
+                           const std::vector<char> &primary_ref,
+                           std::vector<char> *ref_out) {
+    if (stored_fields.empty()) {
+        *ref_out = primary_ref;
+        return;
+    }
 
-            std::vector<store_key_t> keys;
+    ql::datum_ptr_t projection(ql::datum_t::R_OBJECT);
+    for (auto it = stored_fields.begin(); it != stored_fields.end(); ++it) {
+        counted_t<const ql::datum_t> field = doc->get(*it, ql::NOTHROW);
+        if (field.has()) {
+            UNUSED bool b = projection.add(*it, field);
+        }
+    }
+    std::vector<counted_t<const ql::datum_t> > entry;
+    entry.push_back(index_value);
+    entry.push_back(projection.to_counted());
 
-            compute_keys(modification->primary_key, deleted, &mapping, multi, &env, &keys);
+    write_message_t wm;
+    wm << counted_t<const ql::datum_t>(make_counted<const ql::datum_t>(std::move(entry)));
+    // Only keep it if it stays inside the blob ref, so that the entry doesn't own
+    // any blocks that would have to be deleted along with it.
+    if (wm.size() >= static_cast<size_t>(blob::btree_maxreflen)) {
+        *ref_out = primary_ref;
+        return;
+    }
 
-            for (auto it = keys.begin(); it != keys.end(); ++it) {
-                promise_t<superblock_t *> return_superblock_local;
-                {
-                    keyvalue_location_t<rdb_value_t> kv_location;
+    scoped_malloc_t<rdb_value_t> value(blob::btree_maxreflen);
+    memset(value.get(), 0, blob::btree_maxreflen);
+    blob_t blob(txn->get_cache()->get_block_size(), value->value_ref(), blob::btree_maxreflen);
+    write_onto_blob(txn, &blob, wm);
+    rassert(blob::ref_info(txn->get_cache()->get_block_size(), value->value_ref(),
+                           blob::btree_maxreflen).levels == 0);
+    ref_out->assign(value->value_ref(),
+                    value->value_ref() + value->inline_size(txn->get_cache()->get_block_size()));
+}
 
-                    find_keyvalue_location_for_write(txn, super_block,
-                                                     it->btree_key(),
-                                                     &kv_location,
-                                                     &sindex->btree->root_eviction_priority,
-                                                     &sindex->btree->stats,
-                                                     env.trace.get_or_null(),
-                                                     &return_superblock_local);
+// A change that one or more mod reports make to a secondary index.
+struct sindex_change_t {
+    sindex_change_t(const store_key_t &_key, size_t _report)
+        : key(_key), report(_report) { }
+
+    store_key_t key;
+    // The index of the mod report it comes from, so that the changes to a key
+    // can be applied in order.
+    size_t report;
+    // Empty if the change deletes the key.
+    std::vector<char> value_ref;
+
+    // A report's deletions go before its additions.
+    bool operator<(const sindex_change_t &other) const {
+        if (key == other.key) {
+            return report < other.report
+                || (report == other.report
+                    && value_ref.empty() && !other.value_ref.empty());
+        }
+        return key < other.key;
+    }
+};
 
-                    if (kv_location.value.has()) {
-                        kv_location_delete(&kv_location, *it,
-                            sindex->btree, repli_timestamp_t::distant_past, txn, NULL);
-                    }
-                    // The keyvalue location gets destroyed here.
-                }
-                super_block = return_superblock_local.wait();
+// Appends the changes `mod_report`, the `report`th one of a batch, makes to an
+// index: deleting the keys of the old row and setting the keys of the new one.
+// Keys the two have in common are both deleted and set, apply_sindex_changes()
+// drops the deletions.
+void compute_sindex_changes(const rdb_modification_report_t &mod_report,
+                            size_t report,
+                            const compiled_sindex_func_t &func,
+                            sindex_multi_bool_t multi,
+                            const std::vector<std::string> &stored_fields,
+                            ql::sindex_key_format_t key_format,
+                            ql::env_t *env,
+                            transaction_t *txn,
+                            std::vector<sindex_change_t> *changes) {
+    // Note if you get this error it's likely that you've passed in a default
+    // constructed mod_report. Don't do that.  Mod reports should always be passed
+    // to a function as an output parameter before they're passed to this
+    // function.
+    guarantee(mod_report.primary_key.size() != 0);
+
+    if (mod_report.info.deleted.first) {
+        guarantee(!mod_report.info.deleted.second.empty());
+        try {
+            std::vector<store_key_t> keys;
+            compute_keys(mod_report.primary_key, mod_report.info.deleted.first,
+                         func, multi, key_format, env, &keys, NULL);
+            for (auto it = keys.begin(); it != keys.end(); ++it) {
+                changes->push_back(sindex_change_t(*it, report));
             }
         } catch (const ql::base_exc_t &) {
             // Do nothing (it wasn't actually in the index).
         }
     }
 
-    if (modification->info.added.first) {
+    if (mod_report.info.added.first) {
         try {
-            counted_t<const ql::datum_t> added = modification->info.added.first;
-
             std::vector<store_key_t> keys;
+            std::vector<counted_t<const ql::datum_t> > index_values;
+            compute_keys(mod_report.primary_key, mod_report.info.added.first,
+                         func, multi, key_format, env, &keys, &index_values);
+            for (size_t i = 0; i < keys.size(); ++i) {
+                changes->push_back(sindex_change_t(keys[i], report));
+                make_sindex_value_ref(txn, stored_fields, index_values[i],
+                                      mod_report.info.added.first,
+                                      mod_report.info.added.second,
+                                      &changes->back().value_ref);
+            }
+        } catch (const ql::base_exc_t &) {
+            // Do nothing (we just drop the row from the index).
+        }
+    }
+}
 
-            compute_keys(modification->primary_key, added, &mapping, multi, &env, &keys);
+// True if `key`, which isn't less than the key `kv_location` was found for, can
+// be changed in the same leaf without walking down the tree again: it goes into
+// the leaf and doesn't make it split.  The leaf's parent is still held, so a merge
+// after a deletion is handled as usual, but we need the superblock to have been
+// released already, or the merge could make the leaf the root, and the parent
+// mustn't be underfull, since the walk down is what would fix that.
+bool can_reuse_leaf(value_sizer_t<rdb_value_t> *sizer,
+                    const keyvalue_location_t<rdb_value_t> *kv_location,
+                    const store_key_t &key, const rdb_value_t *value) {
+    if (kv_location->superblock != NULL || !kv_location->last_buf.is_acquired()
+        || node::is_underfull(sizer, static_cast<const node_t *>(
+                                  kv_location->last_buf.get_data_read()))) {
+        return false;
+    }
+    const leaf_node_t *leaf =
+        static_cast<const leaf_node_t *>(kv_location->buf.get_data_read());
+    return !leaf::is_past_last_key(leaf, key.btree_key())
+        && (value == NULL || !leaf::is_full(sizer, leaf, key.btree_key(), value));
+}
 
-            for (auto it = keys.begin(); it != keys.end(); ++it) {
-                promise_t<superblock_t *> return_superblock_local;
-                {
-                    keyvalue_location_t<rdb_value_t> kv_location;
+// Sorts `changes` and applies the last change to every key in key order, changing
+// the keys that fall into the same leaf without walking down the tree again.  An
+// entry that already has the value it gets is left alone, so that a row that keeps
+// most of its keys (like a multi index on an array that gets one more element)
+// only dirties the leaves of the keys that come and go.
+void apply_sindex_changes(const btree_store_t<rdb_protocol_t>::sindex_access_t *sindex,
+                          std::vector<sindex_change_t> *changes,
+                          transaction_t *txn,
+                          profile::trace_t *trace) {
+    std::sort(changes->begin(), changes->end());
+
+    value_sizer_t<rdb_value_t> sizer(txn->get_cache()->get_block_size());
+    superblock_t *super_block = sindex->super_block.get();
+    // The location of the previous key, which keeps its leaf and the leaf's parent.
+    scoped_ptr_t<promise_t<superblock_t *> > return_superblock;
+    scoped_ptr_t<keyvalue_location_t<rdb_value_t> > kv_location;
+    for (size_t i = 0; i < changes->size(); ++i) {
+        const sindex_change_t &change = (*changes)[i];
+        if (i + 1 < changes->size() && (*changes)[i + 1].key == change.key) {
+            // A later change to the key makes this one moot.
+            continue;
+        }
 
-                    find_keyvalue_location_for_write(txn, super_block,
-                                                     it->btree_key(),
-                                                     &kv_location,
-                                                     &sindex->btree->root_eviction_priority,
-                                                     &sindex->btree->stats,
-                                                     env.trace.get_or_null(),
-                                                     &return_superblock_local);
+        scoped_malloc_t<rdb_value_t> value;
+        if (!change.value_ref.empty()) {
+            value = scoped_malloc_t<rdb_value_t>(
+                change.value_ref.data(), change.value_ref.data() + change.value_ref.size());
+        }
 
-                    kv_location_set(&kv_location, *it,
-                                    modification->info.added.second, sindex->btree,
-                                    repli_timestamp_t::distant_past, txn);
-                    // The keyvalue location gets destroyed here.
-                }
-                super_block = return_superblock_local.wait();
+        if (kv_location.has() && can_reuse_leaf(&sizer, kv_location.get(), change.key,
+                                                value.get())) {
+            scoped_malloc_t<rdb_value_t> old_value(sizer.max_possible_size());
+            if (leaf::lookup(&sizer,
+                             static_cast<const leaf_node_t *>(kv_location->buf.get_data_read()),
+                             change.key.btree_key(), old_value.get())) {
+                kv_location->there_originally_was_value = true;
+                kv_location->value = std::move(old_value);
+            } else {
+                kv_location->there_originally_was_value = false;
+                kv_location->value.reset();
             }
-        } catch (const ql::base_exc_t &) {
-            // Do nothing (we just drop the row from the index).
+        } else {
+            if (kv_location.has()) {
+                kv_location.reset();
+                super_block = return_superblock->wait();
+            }
+            return_superblock.init(new promise_t<superblock_t *>);
+            kv_location.init(new keyvalue_location_t<rdb_value_t>);
+            find_keyvalue_location_for_write(txn, super_block,
+                                             change.key.btree_key(),
+                                             kv_location.get(),
+                                             &sindex->btree->root_eviction_priority,
+                                             &sindex->btree->stats,
+                                             trace,
+                                             return_superblock.get());
+        }
+
+        if (!change.value_ref.empty()) {
+            const bool unchanged = kv_location->value.has()
+                && sizer.size(kv_location->value.get())
+                   == static_cast<int>(change.value_ref.size())
+                && memcmp(kv_location->value.get(), change.value_ref.data(),
+                          change.value_ref.size()) == 0;
+            if (!unchanged) {
+                kv_location_set(kv_location.get(), change.key, change.value_ref,
+                                sindex->btree, repli_timestamp_t::distant_past, txn);
+            }
+        } else if (kv_location->value.has()) {
+            kv_location_delete(kv_location.get(), change.key, sindex->btree,
+                               repli_timestamp_t::distant_past, txn, NULL);
+        }
+    }
+    if (kv_location.has()) {
+        kv_location.reset();
+        return_superblock->wait();
+    }
+}
+
+/* Used below by rdb_update_sindexes. */
+void rdb_update_single_sindex(
+        const btree_store_t<rdb_protocol_t>::sindex_access_t *sindex,
+        const rdb_modification_report_t *modification,
+        transaction_t *txn,
+        auto_drainer_t::lock_t) {
+    // Note if you get this error it's likely that you've passed in a default
+    // constructed mod_report. Don't do that.  Mod reports should always be passed
+    // to a function as an output parameter before they're passed to this
+    // function.
+    guarantee(modification->primary_key.size() != 0);
+
+    ql::map_wire_func_t mapping;
+    sindex_multi_bool_t multi = sindex_multi_bool_t::MULTI;
+    std::vector<std::string> stored_fields;
+    ql::sindex_key_format_t key_format;
+    deserialize_sindex_info(sindex->sindex.opaque_definition, &mapping, &multi,
+                            &stored_fields, &key_format);
+    compiled_sindex_func_t func(mapping);
+
+    // TODO we just use a NULL environment here. People should not be able
+    // to do anything that requires an environment like gets from other
+    // tables etc. but we don't have a nice way to disallow those things so
+    // for now we pass null and it will segfault if an illegal sindex
+    // mapping is passed.
+    cond_t non_interruptor;
+    ql::env_t env(&non_interruptor);
+
+    // A row has one entry in an aggregate index, whatever its group.
+    if (multi == sindex_multi_bool_t::AGGREGATE) {
+        superblock_t *super_block = sindex->super_block.get();
+        counted_t<const ql::datum_t> entry;
+        if (modification->info.added.first) {
+            entry = aggregate_row_entry(func, stored_fields,
+                                        modification->info.added.first, &env);
         }
+        set_aggregate_entry(txn, sindex->btree, &super_block,
+                            aggregate_row_key(modification->primary_key), entry,
+                            env.trace.get_or_null());
+        return;
     }
+
+    // Going through the changes in key order instead of deleting all the old keys
+    // and then setting all the new ones means the keys the old and the new row
+    // have in common are only looked at once.
+    std::vector<sindex_change_t> changes;
+    compute_sindex_changes(*modification, 0, func, multi, stored_fields, key_format,
+                           &env, txn, &changes);
+    apply_sindex_changes(sindex, &changes, txn, env.trace.get_or_null());
 }
 
 void rdb_update_sindexes(const sindex_access_vector_t &sindexes,
@@ -1158,6 +3063,143 @@ void rdb_update_sindexes(const sindex_access_vector_t &sindexes,
     }
 }
 
+/* Used below by rdb_update_sindexes. */
+void rdb_update_single_sindex_batch(
+        const btree_store_t<rdb_protocol_t>::sindex_access_t *sindex,
+        const std::vector<rdb_modification_report_t> *mod_reports,
+        transaction_t *txn,
+        auto_drainer_t::lock_t lock) {
+    ql::map_wire_func_t mapping;
+    sindex_multi_bool_t multi = sindex_multi_bool_t::MULTI;
+    std::vector<std::string> stored_fields;
+    ql::sindex_key_format_t key_format;
+    deserialize_sindex_info(sindex->sindex.opaque_definition, &mapping, &multi,
+                            &stored_fields, &key_format);
+    // The summaries of an aggregate index change along with every entry.
+    if (multi == sindex_multi_bool_t::AGGREGATE) {
+        for (auto it = mod_reports->begin(); it != mod_reports->end(); ++it) {
+            rdb_update_single_sindex(sindex, &*it, txn, lock);
+        }
+        return;
+    }
+    compiled_sindex_func_t func(mapping);
+
+    // See rdb_update_single_sindex about the environment.
+    cond_t non_interruptor;
+    ql::env_t env(&non_interruptor);
+
+    std::vector<sindex_change_t> changes;
+    for (size_t i = 0; i < mod_reports->size(); ++i) {
+        compute_sindex_changes((*mod_reports)[i], i, func, multi, stored_fields,
+                               key_format, &env, txn, &changes);
+    }
+    apply_sindex_changes(sindex, &changes, txn, env.trace.get_or_null());
+}
+
+void rdb_update_sindexes(const sindex_access_vector_t &sindexes,
+        const std::vector<rdb_modification_report_t> &mod_reports,
+        transaction_t *txn) {
+    {
+        auto_drainer_t drainer;
+
+        for (sindex_access_vector_t::const_iterator it  = sindexes.begin();
+                                                    it != sindexes.end();
+                                                    ++it) {
+            coro_t::spawn_sometime(boost::bind(
+                        &rdb_update_single_sindex_batch, &*it,
+                        &mod_reports, txn, auto_drainer_t::lock_t(&drainer)));
+        }
+    }
+
+    // See rdb_update_sindexes above.
+    rdb_value_deleter_t deleter;
+    for (auto it = mod_reports.begin(); it != mod_reports.end(); ++it) {
+        if (it->info.deleted.first) {
+            std::vector<char> ref_cpy(it->info.deleted.second);
+            ref_cpy.insert(ref_cpy.end(), blob::btree_maxreflen - ref_cpy.size(), 0);
+            guarantee(ref_cpy.size() == static_cast<size_t>(blob::btree_maxreflen));
+            deleter.delete_value(txn, ref_cpy.data());
+        }
+    }
+}
+
+void rdb_bulk_load_single_sindex(
+        const btree_store_t<rdb_protocol_t>::sindex_access_t *sindex,
+        const std::vector<rdb_modification_report_t> *mod_reports,
+        double fill_factor,
+        transaction_t *txn,
+        auto_drainer_t::lock_t lock) {
+    ql::map_wire_func_t mapping;
+    sindex_multi_bool_t multi = sindex_multi_bool_t::MULTI;
+    std::vector<std::string> stored_fields;
+    ql::sindex_key_format_t key_format;
+    deserialize_sindex_info(sindex->sindex.opaque_definition, &mapping, &multi,
+                            &stored_fields, &key_format);
+
+    // The summaries of an aggregate index aren't in the order of the entries.
+    value_sizer_t<rdb_value_t> sizer(txn->get_cache()->get_block_size());
+    if (multi == sindex_multi_bool_t::AGGREGATE
+        || !btree_is_empty(&sizer, txn, sindex->super_block.get())) {
+        for (auto it = mod_reports->begin(); it != mod_reports->end(); ++it) {
+            rdb_update_single_sindex(sindex, &*it, txn, lock);
+        }
+        return;
+    }
+
+    compiled_sindex_func_t func(mapping);
+
+    // See rdb_update_single_sindex about the environment.
+    cond_t non_interruptor;
+    ql::env_t env(&non_interruptor);
+
+    // The secondary keys paired with the values that go with them.
+    std::vector<std::pair<store_key_t, std::vector<char> > > entries;
+    for (size_t i = 0; i < mod_reports->size(); ++i) {
+        const rdb_modification_report_t &mod_report = (*mod_reports)[i];
+        guarantee(!mod_report.info.deleted.first.has());
+        try {
+            std::vector<store_key_t> keys;
+            std::vector<counted_t<const ql::datum_t> > index_values;
+            compute_keys(mod_report.primary_key, mod_report.info.added.first,
+                         func, multi, key_format, &env, &keys, &index_values);
+            for (size_t j = 0; j < keys.size(); ++j) {
+                entries.push_back(std::make_pair(keys[j], std::vector<char>()));
+                make_sindex_value_ref(txn, stored_fields, index_values[j],
+                                      mod_report.info.added.first,
+                                      mod_report.info.added.second, &entries.back().second);
+            }
+        } catch (const ql::base_exc_t &) {
+            // Do nothing (we just drop the row from the index).
+        }
+    }
+    std::sort(entries.begin(), entries.end());
+
+    btree_bulk_loader_t loader(&sizer, sindex->btree, txn, sindex->super_block.get(),
+                               repli_timestamp_t::distant_past, fill_factor);
+    for (auto it = entries.begin(); it != entries.end(); ++it) {
+        const std::vector<char> &value_ref = it->second;
+        scoped_malloc_t<rdb_value_t> value(value_ref.data(),
+                                           value_ref.data() + value_ref.size());
+        loader.add(it->first.btree_key(), value.get());
+    }
+    loader.finish();
+}
+
+void rdb_bulk_load_sindexes(const sindex_access_vector_t &sindexes,
+        const std::vector<rdb_modification_report_t> &mod_reports,
+        double fill_factor,
+        transaction_t *txn) {
+    auto_drainer_t drainer;
+
+    for (sindex_access_vector_t::const_iterator it  = sindexes.begin();
+                                                it != sindexes.end();
+                                                ++it) {
+        coro_t::spawn_sometime(boost::bind(
+                    &rdb_bulk_load_single_sindex, &*it,
+                    &mod_reports, fill_factor, txn, auto_drainer_t::lock_t(&drainer)));
+    }
+}
+
 void rdb_erase_range_sindexes(const sindex_access_vector_t &sindexes,
         const rdb_erase_range_report_t *erase_range,
         transaction_t *txn, signal_t *interruptor) {
@@ -1168,22 +3210,124 @@ void rdb_erase_range_sindexes(const sindex_access_vector_t &sindexes,
             false, /* don't release the superblock */ interruptor);
 }
 
+// An entry for the secondary index `sindexes_[sindex]` of a
+// post_construct_traversal_helper_t.
+struct post_construct_entry_t {
+    post_construct_entry_t(size_t _sindex, const store_key_t &_key,
+                           const std::vector<char> &_value_ref)
+        : sindex(_sindex), key(_key), value_ref(_value_ref) { }
+
+    bool operator<(const post_construct_entry_t &other) const {
+        return sindex < other.sindex || (sindex == other.sindex && key < other.key);
+    }
+
+    size_t sindex;
+    store_key_t key;
+    std::vector<char> value_ref;
+    // Instead of `value_ref` for an aggregate index, see set_aggregate_entry().
+    counted_t<const ql::datum_t> aggregate_entry;
+};
+
+/* Computes the secondary index entries for the documents in `key_range` of the
+primary btree, and inserts them in sorted batches of about
+SINDEX_POST_CONSTRUCTION_BATCH_SIZE, each in a write transaction of its own.  The
+keys get computed without holding any locks on the secondary indexes, so that the
+concurrent streams of a post construction only have to wait for each other while
+they insert. */
 class post_construct_traversal_helper_t : public btree_traversal_helper_t {
 public:
     post_construct_traversal_helper_t(
             btree_store_t<rdb_protocol_t> *store,
             const std::set<uuid_u> &sindexes_to_post_construct,
+            const std::vector<secondary_index_t> &sindexes,
+            const key_range_t &key_range,
+            bool yield_every_document,
             cond_t *interrupt_myself,
             signal_t *interruptor
             )
         : store_(store),
           sindexes_to_post_construct_(sindexes_to_post_construct),
+          key_range_(key_range), yield_every_document_(yield_every_document),
+          env_(&non_interruptor_),
           interrupt_myself_(interrupt_myself), interruptor_(interruptor)
-    { }
+    {
+        for (auto it = sindexes.begin(); it != sindexes.end(); ++it) {
+            sindex_mapping_t *mapping = new sindex_mapping_t;
+            mappings_.push_back(mapping);
+            mapping->id = it->id;
+            mapping->multi = sindex_multi_bool_t::MULTI;
+            deserialize_sindex_info(it->opaque_definition, &mapping->mapping,
+                                    &mapping->multi, &mapping->stored_fields,
+                                    &mapping->key_format);
+            mapping->func.init(new compiled_sindex_func_t(mapping->mapping));
+        }
+    }
 
     void process_a_leaf(transaction_t *txn, buf_lock_t *leaf_node_buf,
                         const btree_key_t *, const btree_key_t *,
                         signal_t *, int *) THROWS_ONLY(interrupted_exc_t) {
+        const leaf_node_t *leaf_node = static_cast<const leaf_node_t *>(leaf_node_buf->get_data_read());
+
+        for (auto it = leaf::begin(*leaf_node); it != leaf::end(*leaf_node); ++it) {
+            /* Grab relevant values from the leaf node. */
+            const btree_key_t *key = (*it).first;
+            const void *value = (*it).second;
+            guarantee(key);
+            if (!key_range_.contains_key(key->contents, key->size)) {
+                continue;
+            }
+
+            store_key_t pk(key);
+            const rdb_value_t *rdb_value = static_cast<const rdb_value_t *>(value);
+            block_size_t block_size = txn->get_cache()->get_block_size();
+            counted_t<const ql::datum_t> doc = get_data(rdb_value, txn);
+            std::vector<char> value_ref(rdb_value->value_ref(),
+                                        rdb_value->value_ref() + rdb_value->inline_size(block_size));
+
+            for (size_t i = 0; i < mappings_.size(); ++i) {
+                if (mappings_[i].multi == sindex_multi_bool_t::AGGREGATE) {
+                    pending_.push_back(post_construct_entry_t(i, aggregate_row_key(pk),
+                                                              std::vector<char>()));
+                    pending_.back().aggregate_entry = aggregate_row_entry(
+                        *mappings_[i].func, mappings_[i].stored_fields, doc, &env_);
+                    continue;
+                }
+                try {
+                    std::vector<store_key_t> keys;
+                    std::vector<counted_t<const ql::datum_t> > index_values;
+                    compute_keys(pk, doc, *mappings_[i].func, mappings_[i].multi,
+                                 mappings_[i].key_format, &env_, &keys, &index_values);
+                    for (size_t j = 0; j < keys.size(); ++j) {
+                        pending_.push_back(post_construct_entry_t(i, keys[j],
+                                                                  std::vector<char>()));
+                        make_sindex_value_ref(txn, mappings_[i].stored_fields,
+                                              index_values[j], doc, value_ref,
+                                              &pending_.back().value_ref);
+                    }
+                } catch (const ql::base_exc_t &) {
+                    // Do nothing (we just drop the row from the index).
+                }
+            }
+
+            if (yield_every_document_) {
+                coro_t::yield();
+            }
+        }
+
+        if (pending_.size() >= SINDEX_POST_CONSTRUCTION_BATCH_SIZE) {
+            flush();
+        }
+    }
+
+    // Inserts the entries collected so far.
+    void flush() {
+        std::vector<post_construct_entry_t> batch;
+        batch.swap(pending_);
+        if (batch.empty()) {
+            return;
+        }
+        std::sort(batch.begin(), batch.end());
+
         write_token_pair_t token_pair;
         store_->new_write_token_pair(&token_pair);
 
@@ -1249,24 +3393,45 @@ public:
             return;
         }
 
-        const leaf_node_t *leaf_node = static_cast<const leaf_node_t *>(leaf_node_buf->get_data_read());
+        // Indexes that have been dropped in the meantime are missing from
+        // `sindexes`, their entries just get skipped.
+        for (auto it = sindexes.begin(); it != sindexes.end(); ++it) {
+            size_t i = 0;
+            while (i < mappings_.size() && mappings_[i].id != it->sindex.id) {
+                ++i;
+            }
+            if (i == mappings_.size()) {
+                continue;
+            }
 
-        for (auto it = leaf::begin(*leaf_node); it != leaf::end(*leaf_node); ++it) {
-            /* Grab relevant values from the leaf node. */
-            const btree_key_t *key = (*it).first;
-            const void *value = (*it).second;
-            guarantee(key);
+            superblock_t *super_block = it->super_block.get();
+            auto entry = std::lower_bound(batch.begin(), batch.end(),
+                                          post_construct_entry_t(i, store_key_t::min(),
+                                                                 std::vector<char>()));
+            for (; entry != batch.end() && entry->sindex == i; ++entry) {
+                if (mappings_[i].multi == sindex_multi_bool_t::AGGREGATE) {
+                    set_aggregate_entry(wtxn.get(), it->btree, &super_block, entry->key,
+                                        entry->aggregate_entry, NULL);
+                    continue;
+                }
+                promise_t<superblock_t *> return_superblock_local;
+                {
+                    keyvalue_location_t<rdb_value_t> kv_location;
 
-            store_key_t pk(key);
-            rdb_modification_report_t mod_report(pk);
-            const rdb_value_t *rdb_value = static_cast<const rdb_value_t *>(value);
-            block_size_t block_size = txn->get_cache()->get_block_size();
-            mod_report.info.added = std::make_pair(get_data(rdb_value, txn),
-                    std::vector<char>(rdb_value->value_ref(),
-                        rdb_value->value_ref() + rdb_value->inline_size(block_size)));
+                    find_keyvalue_location_for_write(wtxn.get(), super_block,
+                                                     entry->key.btree_key(),
+                                                     &kv_location,
+                                                     &it->btree->root_eviction_priority,
+                                                     &it->btree->stats,
+                                                     NULL,
+                                                     &return_superblock_local);
 
-            rdb_update_sindexes(sindexes, &mod_report, wtxn.get());
-            coro_t::yield();
+                    kv_location_set(&kv_location, entry->key, entry->value_ref,
+                                    it->btree, repli_timestamp_t::distant_past, wtxn.get());
+                    // The keyvalue location gets destroyed here.
+                }
+                super_block = return_superblock_local.wait();
+            }
         }
     }
 
@@ -1274,7 +3439,21 @@ public:
 
     void filter_interesting_children(UNUSED transaction_t *txn, ranged_block_ids_t *ids_source, interesting_children_callback_t *cb) {
         for (int i = 0, e = ids_source->num_block_ids(); i < e; ++i) {
-            cb->receive_interesting_child(i);
+            block_id_t id;
+            const btree_key_t *left, *right;
+            ids_source->get_block_id_and_bounding_interval(i, &id, &left, &right);
+            // The child covers (left, right].  This may let through a child whose
+            // keys start right at the end of `key_range_`, process_a_leaf() skips
+            // those keys anyway.
+            const bool left_ok = left == NULL || key_range_.right.unbounded
+                || sized_strcmp(left->contents, left->size, key_range_.right.key.contents(),
+                                key_range_.right.key.size()) < 0;
+            const bool right_ok = right == NULL
+                || sized_strcmp(key_range_.left.contents(), key_range_.left.size(),
+                                right->contents, right->size) <= 0;
+            if (left_ok && right_ok) {
+                cb->receive_interesting_child(i);
+            }
         }
         cb->no_more_interesting_children();
     }
@@ -1282,12 +3461,68 @@ public:
     access_t btree_superblock_mode() { return rwi_read; }
     access_t btree_node_mode() { return rwi_read; }
 
+    // A post construction reads every leaf of the primary btree once.
+    bool leaves_accessed_once() { return true; }
+
+private:
+    struct sindex_mapping_t {
+        uuid_u id;
+        ql::map_wire_func_t mapping;
+        sindex_multi_bool_t multi;
+        std::vector<std::string> stored_fields;
+        ql::sindex_key_format_t key_format;
+        scoped_ptr_t<compiled_sindex_func_t> func;
+    };
+
     btree_store_t<rdb_protocol_t> *store_;
     const std::set<uuid_u> &sindexes_to_post_construct_;
+    const key_range_t key_range_;
+    const bool yield_every_document_;
+    boost::ptr_vector<sindex_mapping_t> mappings_;
+
+    // See rdb_update_single_sindex about the environment.
+    cond_t non_interruptor_;
+    ql::env_t env_;
+
+    std::vector<post_construct_entry_t> pending_;
+
     cond_t *interrupt_myself_;
     signal_t *interruptor_;
 };
 
+// The sub-ranges of the primary btree a post construction traverses, and what it
+// takes to traverse each of them.
+struct post_construct_streams_t {
+    void traverse(int i) {
+        parallel_traversal_progress_t *p = new parallel_traversal_progress_t;
+        scoped_ptr_t<traversal_progress_t> p_owned(p);
+        progress->streams.add_constituent(&p_owned);
+
+        post_construct_traversal_helper_t helper(store, *sindexes_to_post_construct,
+                *sindexes, ranges[i], ranges.size() == 1, interrupt_myself, interruptor);
+        helper.progress = p;
+        try {
+            btree_parallel_traversal(txn, superblock, store->btree.get(), &helper,
+                                     traversal_interruptor);
+            helper.flush();
+        } catch (const interrupted_exc_t &) {
+            /* do nothing; `post_construct_secondary_indexes()` will notice that
+            an interruptor has been pulsed */
+        }
+    }
+
+    std::vector<key_range_t> ranges;
+    btree_store_t<rdb_protocol_t> *store;
+    const std::set<uuid_u> *sindexes_to_post_construct;
+    const std::vector<secondary_index_t> *sindexes;
+    transaction_t *txn;
+    superblock_t *superblock;
+    sindex_construction_progress_t *progress;
+    cond_t *interrupt_myself;
+    signal_t *interruptor;
+    signal_t *traversal_interruptor;
+};
+
 void post_construct_secondary_indexes(
         btree_store_t<rdb_protocol_t> *store,
         const std::set<uuid_u> &sindexes_to_post_construct,
@@ -1297,25 +3532,22 @@ void post_construct_secondary_indexes(
 
     wait_any_t wait_any(&local_interruptor, interruptor);
 
-    post_construct_traversal_helper_t helper(store,
-            sindexes_to_post_construct, &local_interruptor, interruptor);
-    /* Notice the ordering of progress_tracker and insertion_sentries matters.
+    /* Notice the ordering of progress and insertion_sentries matters.
      * insertion_sentries puts pointers in the progress tracker map. Once
      * insertion_sentries is destructed nothing has a reference to
-     * progress_tracker so we know it's safe to destruct it. */
-    parallel_traversal_progress_t progress_tracker;
-    helper.progress = &progress_tracker;
+     * progress so we know it's safe to destruct it. */
+    sindex_construction_progress_t progress;
 
-    std::vector<map_insertion_sentry_t<uuid_u, const parallel_traversal_progress_t *> >
+    std::vector<map_insertion_sentry_t<uuid_u, const sindex_construction_progress_t *> >
         insertion_sentries(sindexes_to_post_construct.size());
     auto sentry = insertion_sentries.begin();
     for (auto it = sindexes_to_post_construct.begin();
-         it != sindexes_to_post_construct.end(); ++it) {
-        store->add_progress_tracker(&*sentry, *it, &progress_tracker);
+         it != sindexes_to_post_construct.end(); ++it, ++sentry) {
+        store->add_progress_tracker(&*sentry, *it, &progress);
     }
 
-    object_buffer_t<fifo_enforcer_sink_t::exit_read_t> read_token;
-    store->new_read_token(&read_token);
+    read_token_pair_t token_pair;
+    store->new_read_token_pair(&token_pair);
 
     // Mind the destructor ordering.
     // The superblock must be released before txn (`btree_parallel_traversal`
@@ -1327,15 +3559,54 @@ void post_construct_secondary_indexes(
 
     store->acquire_superblock_for_read(
         rwi_read,
-        &read_token,
+        &token_pair.main_read_token,
         &txn,
         &superblock,
         interruptor,
         true /* USE_SNAPSHOT */);
 
-    txn->get_cache()->create_cache_account(SINDEX_POST_CONSTRUCTION_CACHE_PRIORITY, &cache_account);
+    const int num_streams = store->sindex_post_construction_streams();
+    txn->get_cache()->create_cache_account(
+        std::min(SINDEX_POST_CONSTRUCTION_CACHE_PRIORITY * num_streams, 100),
+        io_activity_t::sindex_build, &cache_account);
     txn->set_account(cache_account.get());
 
-    btree_parallel_traversal(txn.get(), superblock.get(),
-            store->btree.get(), &helper, &wait_any);
+    // The definitions of the indexes as of the snapshot, the streams compute the
+    // keys from them.
+    std::vector<secondary_index_t> sindexes;
+    {
+        std::map<std::string, secondary_index_t> all_sindexes;
+        store->get_sindexes(&token_pair, txn.get(), superblock.get(), &all_sindexes,
+                            interruptor);
+        for (auto it = all_sindexes.begin(); it != all_sindexes.end(); ++it) {
+            if (std_contains(sindexes_to_post_construct, it->second.id)) {
+                sindexes.push_back(it->second);
+            }
+        }
+    }
+    if (sindexes.empty()) {
+        // They have all been dropped already.
+        throw interrupted_exc_t();
+    }
+
+    post_construct_streams_t streams;
+    split_key_range_at_root(txn.get(), superblock.get(), key_range_t::universe(),
+                            num_streams, &streams.ranges);
+
+    // Every stream releases the superblock once it has the root.
+    refcount_superblock_t refcount_wrapper(superblock.get(), streams.ranges.size());
+    streams.store = store;
+    streams.sindexes_to_post_construct = &sindexes_to_post_construct;
+    streams.sindexes = &sindexes;
+    streams.txn = txn.get();
+    streams.superblock = &refcount_wrapper;
+    streams.progress = &progress;
+    streams.interrupt_myself = &local_interruptor;
+    streams.interruptor = interruptor;
+    streams.traversal_interruptor = &wait_any;
+    pmap(streams.ranges.size(), boost::bind(&post_construct_streams_t::traverse, &streams, _1));
+
+    if (wait_any.is_pulsed()) {
+        throw interrupted_exc_t();
+    }
 }
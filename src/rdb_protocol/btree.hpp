@@ -23,6 +23,7 @@ typedef rdb_protocol_t::read_response_t read_response_t;
 
 typedef rdb_protocol_t::point_read_t point_read_t;
 typedef rdb_protocol_t::point_read_response_t point_read_response_t;
+typedef rdb_protocol_t::multi_point_read_response_t multi_point_read_response_t;
 
 typedef rdb_protocol_t::rget_read_t rget_read_t;
 typedef rdb_protocol_t::rget_read_response_t rget_read_response_t;
@@ -30,6 +31,8 @@ typedef rdb_protocol_t::rget_read_response_t rget_read_response_t;
 typedef rdb_protocol_t::distribution_read_t distribution_read_t;
 typedef rdb_protocol_t::distribution_read_response_t distribution_read_response_t;
 
+typedef rdb_protocol_t::text_search_response_t text_search_response_t;
+
 typedef rdb_protocol_t::write_t write_t;
 typedef rdb_protocol_t::write_response_t write_response_t;
 
@@ -86,6 +89,17 @@ void rdb_get(
     point_read_response_t *response,
     profile::trace_t *trace);
 
+// Looks up all of `keys` in one traversal, in order, so that neighbouring keys share
+// the locks of their leaf and of the nodes above it.  Only the rows that exist go in
+// `response`.
+void rdb_get_multi(
+    const std::vector<store_key_t> &keys,
+    btree_slice_t *slice,
+    transaction_t *txn,
+    superblock_t *superblock,
+    multi_point_read_response_t *response,
+    profile::trace_t *trace);
+
 enum return_vals_t {
     NO_RETURN_VALS = 0,
     RETURN_VALS = 1
@@ -127,12 +141,16 @@ struct btree_batched_replacer_t {
     virtual counted_t<const ql::datum_t> replace(
         const counted_t<const ql::datum_t> &d, size_t index) const = 0;
     virtual bool should_return_vals() const = 0;
+    // If false, the replaces only report their errors, and rdb_batched_replace()
+    // doesn't merge anything.
+    virtual bool should_return_stats() const = 0;
 };
 struct btree_point_replacer_t {
     virtual ~btree_point_replacer_t() { }
     virtual counted_t<const ql::datum_t> replace(
         const counted_t<const ql::datum_t> &d) const = 0;
     virtual bool should_return_vals() const = 0;
+    virtual bool should_return_stats() const = 0;
 };
 
 batched_replace_response_t rdb_batched_replace(
@@ -141,7 +159,20 @@ batched_replace_response_t rdb_batched_replace(
     const std::vector<store_key_t> &keys,
     const btree_batched_replacer_t *replacer,
     rdb_modification_report_cb_t *sindex_cb,
-    profile::trace_t *trace);
+    profile::trace_t *trace,
+    // The stats of every key by itself, if not NULL
+    std::vector<batched_replace_response_t> *stats_per_key_out = NULL);
+
+/* Inserts `rows` into the primary btree, which has to be empty (see
+btree_is_empty()), with a btree_bulk_loader_t.  If several rows have the same
+primary key, only the first one of them gets inserted.  `mod_reports_out` gets a
+report for every row that was inserted, in key order. */
+batched_replace_response_t rdb_bulk_load(
+    const std::vector<counted_t<const ql::datum_t> > &rows,
+    const std::string &pkey, double fill_factor,
+    btree_slice_t *slice, repli_timestamp_t timestamp,
+    transaction_t *txn, superblock_t *superblock,
+    std::vector<rdb_modification_report_t> *mod_reports_out);
 
 void rdb_set(const store_key_t &key, counted_t<const ql::datum_t> data, bool overwrite,
              btree_slice_t *slice, repli_timestamp_t timestamp,
@@ -150,6 +181,17 @@ void rdb_set(const store_key_t &key, counted_t<const ql::datum_t> data, bool ove
              rdb_modification_info_t *mod_info,
              profile::trace_t *trace);
 
+/* Sets the keys of `atoms` like calling rdb_set() with `overwrite` for each of
+them would, but in key order, and the keys that go into the leaf of the previous
+key get set without walking down the tree again.  The keys must be distinct.
+`mod_reports_out` gets a report for every key, in key order, for the caller to
+update the secondary indexes with. */
+void rdb_set_batch(const std::vector<rdb_protocol_details::backfill_atom_t> &atoms,
+                   btree_slice_t *slice,
+                   transaction_t *txn,
+                   superblock_t *superblock,
+                   std::vector<rdb_modification_report_t> *mod_reports_out);
+
 class rdb_backfill_callback_t {
 public:
     virtual void on_delete_range(
@@ -165,6 +207,10 @@ public:
     virtual void on_sindexes(
         const std::map<std::string, secondary_index_t> &sindexes,
         signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) = 0;
+    /* Everything in `range` has been passed to the other methods. */
+    virtual void on_range_done(
+        const key_range_t &range,
+        signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) = 0;
 protected:
     virtual ~rdb_backfill_callback_t() { }
 };
@@ -174,7 +220,7 @@ void rdb_backfill(btree_slice_t *slice, const key_range_t& key_range,
         repli_timestamp_t since_when, rdb_backfill_callback_t *callback,
         transaction_t *txn, superblock_t *superblock,
         buf_lock_t *sindex_block,
-        parallel_traversal_progress_t *p, signal_t *interruptor)
+        traversal_progress_combiner_t *progress, signal_t *interruptor)
         THROWS_ONLY(interrupted_exc_t);
 
 
@@ -197,6 +243,32 @@ void rdb_erase_range(btree_slice_t *slice, key_tester_t *tester,
                      write_token_pair_t *token_pair,
                      signal_t *interruptor);
 
+/* Deletes the rows of `keys` like that many rdb_delete()s would, updating the
+sindexes in bulk like rdb_erase_range(), and tells `changefeed_server_or_null` of
+the deletes.  Returns how many rows there were. */
+int64_t rdb_delete_range(btree_slice_t *slice, const key_range_t &keys,
+                         repli_timestamp_t timestamp,
+                         transaction_t *txn, superblock_t *superblock,
+                         btree_store_t<rdb_protocol_t> *store,
+                         write_token_pair_t *token_pair,
+                         ql::changefeed::server_t *changefeed_server_or_null,
+                         signal_t *interruptor);
+
+/* Deletes the rows of `pk_range` whose values for the secondary index `sindex_id`
+are in `sindex_range`, finding their keys in the index and then deleting them like
+rdb_batched_replace() would.  If the index can't be used for that, sets `*error_out`
+and deletes nothing. */
+batched_replace_response_t rdb_delete_sindex_range(
+    const btree_info_t &info,
+    scoped_ptr_t<superblock_t> *superblock,
+    const std::string &sindex_id,
+    const datum_range_t &sindex_range,
+    const key_range_t &pk_range,
+    ql::env_t *ql_env,
+    rdb_modification_report_cb_t *sindex_cb,
+    boost::optional<ql::datum_exc_t> *error_out,
+    profile::trace_t *trace);
+
 /* RGETS */
 size_t estimate_rget_response_size(const counted_t<const ql::datum_t> &datum);
 
@@ -206,7 +278,8 @@ void rdb_rget_slice(btree_slice_t *slice, const key_range_t &range,
                     const rdb_protocol_details::transform_t &transform,
                     const boost::optional<rdb_protocol_details::terminal_t> &terminal,
                     sorting_t sorting,
-                    rget_read_response_t *response);
+                    rget_read_response_t *response,
+                    bool release_superblock = true);
 
 void rdb_rget_secondary_slice(
     btree_slice_t *slice,
@@ -222,10 +295,84 @@ void rdb_rget_secondary_slice(
     sorting_t sorting,
     const ql::map_wire_func_t &sindex_func,
     sindex_multi_bool_t sindex_multi,
+    ql::sindex_key_format_t sindex_key_format,
+    const std::vector<std::string> &stored_fields,
+    btree_slice_t *primary_slice,
+    superblock_t *primary_superblock,
+    rget_read_response_t *response);
+
+// Returns true if the rows of a read with `transform` and `terminal` may just as
+// well only have some of their top-level fields, and adds those to `*fields_out`.
+// That's if its leading filters (without a default) and then a map or a pluck, or
+// else its terminal, a count or a grouped aggregation, read nothing but them.
+bool query_reads_top_level_fields(
+        const rdb_protocol_details::transform_t &transform,
+        const boost::optional<rdb_protocol_details::terminal_t> &terminal,
+        std::vector<std::string> *fields_out);
+
+// An index that gets a top-level field of the documents, and the secondary part
+// of the keys of its entries for one value of the field.  The index isn't a multi
+// index, its keys are in the binary or hash format and that value's aren't
+// truncated.
+struct rdb_equality_index_t {
+    btree_slice_t *slice;
+    superblock_t *superblock;
+    std::string secondary;
+};
+
+// Reads the documents of `range` whose fields have the values of all of
+// `indexes`, for a read whose first transform is a filter that only passes those
+// (see ql::func_requires_field_values()).  The entries of indexes[0] for its value
+// are read, the other indexes are checked for the primary keys they have, and only
+// then the documents are read.  The read is unordered.
+void rdb_rget_intersection_slice(
+    btree_slice_t *slice,
+    const key_range_t &range,
+    transaction_t *txn,
+    superblock_t *superblock,
+    ql::env_t *ql_env,
+    const ql::batchspec_t &batchspec,
+    const rdb_protocol_details::transform_t &transform,
+    const boost::optional<rdb_protocol_details::terminal_t> &terminal,
+    const std::vector<rdb_equality_index_t> &indexes,
     rget_read_response_t *response);
 
-void rdb_distribution_get(btree_slice_t *slice, int max_depth, const store_key_t &left_key,
-                          transaction_t *txn, superblock_t *superblock, distribution_read_response_t *response);
+// Finds the `limit` rows of `pk_range` that have the most of `terms`, all of them,
+// in the text index whose function is `mapping`.  The terms' entries are read from
+// the index, and then the rows that are returned from the primary btree, along
+// with those that turn out not to have the terms in order, if they must be a
+// `phrase`.
+void rdb_text_search(btree_slice_t *sindex_slice, superblock_t *sindex_superblock,
+                     btree_slice_t *slice, superblock_t *superblock,
+                     transaction_t *txn, ql::env_t *ql_env,
+                     const ql::map_wire_func_t &mapping,
+                     const std::vector<std::string> &terms, bool phrase, size_t limit,
+                     const key_range_t &pk_range,
+                     text_search_response_t *response);
+
+// Answers a `groupby` with the aggregator COUNT, SUM or AVG out of the summaries of
+// an aggregate index whose function is its group function.  Returns false, having
+// set nothing, if the index has rows that the summaries leave out, which only a
+// scan of the documents can aggregate.
+MUST_USE bool rdb_read_aggregate_index(btree_slice_t *sindex_slice,
+                                       superblock_t *sindex_superblock,
+                                       transaction_t *txn,
+                                       ql::group_aggregator_t aggregator,
+                                       rget_read_response_t *response,
+                                       profile::trace_t *trace);
+
+// Reads the definition of a secondary index out of its opaque definition.
+// `stored_fields` gets the fields a covering index stores along with its entries,
+// and `key_format` the format of its keys.
+void deserialize_sindex_info(const std::vector<char> &data,
+                             ql::map_wire_func_t *mapping,
+                             sindex_multi_bool_t *multi,
+                             std::vector<std::string> *stored_fields,
+                             ql::sindex_key_format_t *key_format);
+
+void rdb_distribution_get(btree_slice_t *slice, distribution_mode_t mode, int max_depth,
+                          const store_key_t &left_key, transaction_t *txn,
+                          superblock_t *superblock, distribution_read_response_t *response);
 
 /* Secondary Indexes */
 
@@ -264,17 +411,32 @@ typedef boost::variant<rdb_modification_report_t,
         rdb_sindex_change_t;
 
 /* An rdb_modification_cb_t is passed to BTree operations and allows them to
- * modify the secondary while they perform an operation. */
+ * modify the secondary while they perform an operation.  The reports are
+ * collected and the secondary indexes get updated for all of them at once when
+ * finish() is called. */
 class rdb_modification_report_cb_t {
 public:
     rdb_modification_report_cb_t(
             btree_store_t<rdb_protocol_t> *store, write_token_pair_t *token_pair,
-            transaction_t *txn, block_id_t sindex_block, auto_drainer_t::lock_t lock);
+            transaction_t *txn, block_id_t sindex_block, auto_drainer_t::lock_t lock,
+            ql::changefeed::server_t *changefeed_server);
 
+    // Queues the report for the secondary indexes and sends it to the
+    // changefeeds, if `changefeed_server` isn't NULL.
     void on_mod_report(const rdb_modification_report_t &mod_report);
 
+    // Updates the secondary indexes for the reports since the last call.
+    void finish();
+
+    // The secondary index `id` that the reports update, so that a write can find
+    // its rows in it first, or NULL if it doesn't exist or isn't constructed yet,
+    // which `*exists_out` tells apart.
+    btree_store_t<rdb_protocol_t>::sindex_access_t *get_sindex(const std::string &id,
+                                                               bool *exists_out);
+
     ~rdb_modification_report_cb_t();
 private:
+    void acquire_sindexes();
 
     /* Fields initialized by the constructor. */
     btree_store_t<rdb_protocol_t> *store_;
@@ -282,10 +444,12 @@ private:
     transaction_t *txn_;
     block_id_t sindex_block_id_;
     auto_drainer_t::lock_t lock_;
+    ql::changefeed::server_t *changefeed_server_;
 
     /* Fields initialized by calls to on_mod_report */
     scoped_ptr_t<buf_lock_t> sindex_block_;
     btree_store_t<rdb_protocol_t>::sindex_access_vector_t sindexes_;
+    std::vector<rdb_modification_report_t> mod_reports_;
 };
 
 void rdb_update_sindexes(
@@ -293,6 +457,24 @@ void rdb_update_sindexes(
         const rdb_modification_report_t *modification,
         transaction_t *txn);
 
+/* Like calling rdb_update_sindexes() for each of `mod_reports` in order, except
+that the index functions get evaluated for all of them first, and each sindex is
+then updated in one pass over the sorted keys, which reuses the leaf of the
+previous key whenever the next key goes into it too. */
+void rdb_update_sindexes(
+        const btree_store_t<rdb_protocol_t>::sindex_access_vector_t &sindexes,
+        const std::vector<rdb_modification_report_t> &mod_reports,
+        transaction_t *txn);
+
+/* Like calling rdb_update_sindexes() for each of `mod_reports`, which must be the
+reports of rdb_bulk_load(), except that the sindexes that are still empty get
+bulk loaded as well. */
+void rdb_bulk_load_sindexes(
+        const btree_store_t<rdb_protocol_t>::sindex_access_vector_t &sindexes,
+        const std::vector<rdb_modification_report_t> &mod_reports,
+        double fill_factor,
+        transaction_t *txn);
+
 void rdb_erase_range_sindexes(
         const btree_store_t<rdb_protocol_t>::sindex_access_vector_t &sindexes,
         const rdb_erase_range_report_t *erase_range,
@@ -309,6 +491,9 @@ class rdb_value_deleter_t : public value_deleter_t {
 friend void rdb_update_sindexes(
         const btree_store_t<rdb_protocol_t>::sindex_access_vector_t &sindexes,
         const rdb_modification_report_t *modification, transaction_t *txn);
+friend void rdb_update_sindexes(
+        const btree_store_t<rdb_protocol_t>::sindex_access_vector_t &sindexes,
+        const std::vector<rdb_modification_report_t> &mod_reports, transaction_t *txn);
 
     void delete_value(transaction_t *_txn, void *_value);
 };
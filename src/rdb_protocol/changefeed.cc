@@ -0,0 +1,229 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "rdb_protocol/changefeed.hpp"
+
+#include "errors.hpp"
+#include <boost/bind.hpp>
+
+#include "arch/runtime/coroutines.hpp"
+#include "concurrency/wait_any.hpp"
+#include "config/args.hpp"
+#include "containers/archive/boost_types.hpp"
+#include "rpc/connectivity/connectivity.hpp"
+#include "rdb_protocol/batching.hpp"
+#include "rdb_protocol/btree.hpp"
+#include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/error.hpp"
+#include "utils.hpp"
+
+namespace ql {
+namespace changefeed {
+
+RDB_IMPL_ME_SERIALIZABLE_2(msg_t::change_t, old_val, new_val);
+RDB_IMPL_ME_SERIALIZABLE_0(msg_t::stop_t);
+RDB_IMPL_ME_SERIALIZABLE_1(msg_t, op);
+
+server_t::server_t(mailbox_manager_t *_manager)
+    : manager(_manager),
+      sending(false),
+      stop_mailbox(manager, boost::bind(&server_t::remove_client, this, _1)) { }
+
+server_t::~server_t() {
+    assert_thread();
+    if (clients.empty()) {
+        return;
+    }
+    while (!clients.empty()) {
+        drop_client(clients.begin());
+    }
+    // The drainer waits for these to go out before the mailboxes go away.
+    if (!sending) {
+        sending = true;
+        coro_t::spawn_sometime(boost::bind(&server_t::send_all, this,
+                                           auto_drainer_t::lock_t(&drainer)));
+    }
+}
+
+void server_t::add_client(const uuid_u &id, const client_addr_t &addr,
+                          const hash_region_t<key_range_t> &region) {
+    assert_thread();
+    client_t client;
+    client.addr = addr;
+    client.region = region;
+    clients[id] = client;
+    coro_t::spawn_sometime(boost::bind(&server_t::watch_client, this,
+                                       id, addr.get_peer(),
+                                       auto_drainer_t::lock_t(&drainer)));
+}
+
+void server_t::remove_client(const uuid_u &id) {
+    assert_thread();
+    auto it = clients.find(id);
+    if (it != clients.end()) {
+        if (it->second.removed != NULL) {
+            it->second.removed->pulse();
+        }
+        clients.erase(it);
+    }
+}
+
+void server_t::drop_client(std::map<uuid_u, client_t>::iterator it) {
+    assert_thread();
+    outbox.push_back(outgoing_t(it->first, it->second.addr, msg_t(msg_t::stop_t())));
+    if (it->second.removed != NULL) {
+        it->second.removed->pulse();
+    }
+    clients.erase(it);
+}
+
+void server_t::watch_client(uuid_u id, peer_id_t peer,
+                            auto_drainer_t::lock_t keepalive) {
+    assert_thread();
+    auto it = clients.find(id);
+    if (it == clients.end()) {
+        // It was removed before we got to run.
+        return;
+    }
+    cond_t removed;
+    it->second.removed = &removed;
+    disconnect_watcher_t disconnected(manager->get_connectivity_service(), peer);
+    wait_any_t waiter(&removed, &disconnected, keepalive.get_drain_signal());
+    waiter.wait_lazily_unordered();
+    if (!removed.is_pulsed()) {
+        // There's nobody to tell that the feed stopped.
+        remove_client(id);
+    }
+}
+
+void server_t::send_change(const rdb_modification_report_t &report) {
+    assert_thread();
+    counted_t<const datum_t> old_val = report.info.deleted.first;
+    counted_t<const datum_t> new_val = report.info.added.first;
+    if (clients.empty() || (!old_val.has() && !new_val.has())) {
+        return;
+    }
+    if (!old_val.has()) {
+        old_val = make_counted<datum_t>(datum_t::R_NULL);
+    }
+    if (!new_val.has()) {
+        new_val = make_counted<datum_t>(datum_t::R_NULL);
+    }
+
+    msg_t msg((msg_t::change_t(old_val, new_val)));
+    bool queued = false;
+    for (auto it = clients.begin(); it != clients.end();) {
+        if (!region_contains_key(it->second.region, report.primary_key)) {
+            ++it;
+        } else if (it->second.queued >= CHANGEFEED_MAX_BUFFERED_CHANGES) {
+            // The feed can't keep up, so it would drop changes anyway.
+            drop_client(it++);
+            queued = true;
+        } else {
+            outbox.push_back(outgoing_t(it->first, it->second.addr, msg));
+            ++it->second.queued;
+            ++it;
+            queued = true;
+        }
+    }
+    if (queued && !sending) {
+        sending = true;
+        coro_t::spawn_sometime(boost::bind(&server_t::send_all, this,
+                                           auto_drainer_t::lock_t(&drainer)));
+    }
+}
+
+void server_t::send_all(UNUSED auto_drainer_t::lock_t keepalive) {
+    assert_thread();
+    while (!outbox.empty()) {
+        outgoing_t next = outbox.front();
+        outbox.pop_front();
+        auto it = clients.find(next.id);
+        if (it != clients.end()) {
+            --it->second.queued;
+        } else if (boost::get<msg_t::stop_t>(&next.msg.op) == NULL) {
+            // The client was removed, so only its stop still has to go out.
+            continue;
+        }
+        // This may block, while the writes queue up more messages behind it.
+        send(manager, next.addr, next.msg);
+    }
+    sending = false;
+}
+
+feed_t::feed_t(mailbox_manager_t *_manager)
+    : manager(_manager),
+      id(generate_uuid()),
+      skipped(0),
+      stopped(false),
+      msg_cond(NULL),
+      mailbox(manager, boost::bind(&feed_t::on_msg, this, _1)) { }
+
+static void send_stop(mailbox_manager_t *manager,
+                      server_t::stop_addr_t addr, uuid_u id) {
+    send(manager, addr, id);
+}
+
+feed_t::~feed_t() {
+    assert_thread();
+    // The destructor can't block, so the unsubscriptions go out on their own.
+    for (auto it = servers.begin(); it != servers.end(); ++it) {
+        coro_t::spawn_sometime(boost::bind(&send_stop, manager, *it, id));
+    }
+}
+
+void feed_t::add_servers(const std::vector<server_t::stop_addr_t> &_servers) {
+    assert_thread();
+    servers.insert(servers.end(), _servers.begin(), _servers.end());
+}
+
+void feed_t::on_msg(const msg_t &msg) {
+    assert_thread();
+    if (const msg_t::change_t *change = boost::get<msg_t::change_t>(&msg.op)) {
+        datum_ptr_t obj(datum_t::R_OBJECT);
+        UNUSED bool b1 = obj.add("old_val", change->old_val);
+        UNUSED bool b2 = obj.add("new_val", change->new_val);
+        changes.push_back(obj.to_counted());
+        if (changes.size() > CHANGEFEED_MAX_BUFFERED_CHANGES) {
+            changes.pop_front();
+            ++skipped;
+        }
+    } else {
+        guarantee(boost::get<msg_t::stop_t>(&msg.op) != NULL);
+        stopped = true;
+    }
+    if (msg_cond != NULL) {
+        msg_cond->pulse_if_not_already_pulsed();
+    }
+}
+
+std::vector<counted_t<const datum_t> >
+feed_t::get_changes(const batchspec_t &batchspec, signal_t *interruptor) {
+    assert_thread();
+    while (changes.empty() && !stopped && skipped == 0) {
+        cond_t cond;
+        assignment_sentry_t<cond_t *> sentry(&msg_cond, &cond);
+        wait_interruptible(&cond, interruptor);
+    }
+    rcheck_datum(skipped == 0, base_exc_t::GENERIC,
+                 strprintf("Changefeed buffer over %zu changes, skipped %zu of them.",
+                           static_cast<size_t>(CHANGEFEED_MAX_BUFFERED_CHANGES),
+                           skipped));
+    if (changes.empty()) {
+        guarantee(stopped);
+        rfail_datum(base_exc_t::GENERIC,
+                    "Changefeed aborted (the table or one of its shards went away).");
+    }
+
+    std::vector<counted_t<const datum_t> > batch;
+    batcher_t batcher = batchspec.to_batcher();
+    while (!changes.empty()) {
+        batch.push_back(changes.front());
+        changes.pop_front();
+        if (batcher.note_el(batch.back())) {
+            break;
+        }
+    }
+    return batch;
+}
+
+}  // namespace changefeed
+}  // namespace ql
@@ -0,0 +1,160 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_CHANGEFEED_HPP_
+#define RDB_PROTOCOL_CHANGEFEED_HPP_
+
+#include <deque>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "errors.hpp"
+#include <boost/variant.hpp>
+
+#include "btree/keys.hpp"
+#include "concurrency/auto_drainer.hpp"
+#include "concurrency/cond_var.hpp"
+#include "containers/counted.hpp"
+#include "containers/uuid.hpp"
+#include "hash_region.hpp"
+#include "rpc/mailbox/typed.hpp"
+#include "rpc/serialize_macros.hpp"
+
+class mailbox_manager_t;
+struct rdb_modification_report_t;
+
+namespace ql {
+
+class batchspec_t;
+class datum_t;
+
+namespace changefeed {
+
+/* What a store sends to the feeds subscribed to it. */
+struct msg_t {
+    // A row of the feed's key range changed.  `old_val` is null for inserts and
+    // `new_val` is null for deletes.
+    struct change_t {
+        change_t() { }
+        change_t(counted_t<const datum_t> _old_val, counted_t<const datum_t> _new_val)
+            : old_val(_old_val), new_val(_new_val) { }
+        counted_t<const datum_t> old_val;
+        counted_t<const datum_t> new_val;
+        RDB_DECLARE_ME_SERIALIZABLE;
+    };
+    // The store is going away, so the feed won't get all the changes anymore.
+    struct stop_t {
+        RDB_DECLARE_ME_SERIALIZABLE;
+    };
+
+    msg_t() { }
+    explicit msg_t(const change_t &change) : op(change) { }
+    explicit msg_t(const stop_t &stop) : op(stop) { }
+
+    boost::variant<change_t, stop_t> op;
+    RDB_DECLARE_ME_SERIALIZABLE;
+};
+
+typedef mailbox_addr_t<void(msg_t)> client_addr_t;
+
+/* The feeds subscribed to a store, which the store tells about the rows its writes
+change (see rdb_modification_report_t).  It lives on the store's thread and has a
+single coroutine send the messages in order, so that the writes that produce them
+never wait on the network.  A feed unsubscribes through the mailbox of
+`get_stop_addr()` when it's destroyed; it's also dropped when its peer disconnects,
+or when more than CHANGEFEED_MAX_BUFFERED_CHANGES of its messages are waiting to
+go out, in which case it's sent a stop. */
+class server_t : public home_thread_mixin_t {
+public:
+    typedef mailbox_addr_t<void(uuid_u)> stop_addr_t;
+
+    explicit server_t(mailbox_manager_t *manager);
+    // Tells the feeds that are still subscribed that they stopped.
+    ~server_t();
+
+    void add_client(const uuid_u &id, const client_addr_t &addr,
+                    const hash_region_t<key_range_t> &region);
+    stop_addr_t get_stop_addr() const { return stop_mailbox.get_address(); }
+
+    // Sends the change of `report` to the feeds whose key ranges contain its key.
+    void send_change(const rdb_modification_report_t &report);
+
+private:
+    struct client_t {
+        client_t() : queued(0), removed(NULL) { }
+        client_addr_t addr;
+        hash_region_t<key_range_t> region;
+        // How many of the messages in `outbox` are for this client.
+        size_t queued;
+        // Pulsed when the client is removed, to stop `watch_client()`.
+        cond_t *removed;
+    };
+
+    struct outgoing_t {
+        outgoing_t(const uuid_u &_id, const client_addr_t &_addr, const msg_t &_msg)
+            : id(_id), addr(_addr), msg(_msg) { }
+        uuid_u id;
+        client_addr_t addr;
+        msg_t msg;
+    };
+
+    void remove_client(const uuid_u &id);
+    void drop_client(std::map<uuid_u, client_t>::iterator it);
+    // Removes the client when its peer disconnects.
+    void watch_client(uuid_u id, peer_id_t peer, auto_drainer_t::lock_t keepalive);
+    void send_all(auto_drainer_t::lock_t keepalive);
+
+    mailbox_manager_t *const manager;
+    std::map<uuid_u, client_t> clients;
+
+    std::deque<outgoing_t> outbox;
+    bool sending;
+
+    auto_drainer_t drainer;
+    mailbox_t<void(uuid_u)> stop_mailbox;
+
+    DISABLE_COPYING(server_t);
+};
+
+/* A subscription to the stores of a key range of a table, whose changes queue up
+until the query reads them.  At most CHANGEFEED_MAX_BUFFERED_CHANGES of them queue
+up; when a change comes in on top of those, the oldest one is dropped and the next
+read fails, so that a client that doesn't keep up can't take all the memory. */
+class feed_t : public home_thread_mixin_t {
+public:
+    explicit feed_t(mailbox_manager_t *manager);
+    // Unsubscribes from the stores.
+    ~feed_t();
+
+    const uuid_u &get_id() const { return id; }
+    client_addr_t get_addr() const { return mailbox.get_address(); }
+    // Keeps the addresses of the stores the feed subscribed to, for unsubscribing.
+    void add_servers(const std::vector<server_t::stop_addr_t> &servers);
+
+    // Waits until there are changes and returns the `{old_val, new_val}` objects of
+    // as many of them as fit in a batch.  Fails once a store stopped or changes
+    // were dropped.
+    std::vector<counted_t<const datum_t> >
+    get_changes(const batchspec_t &batchspec, signal_t *interruptor);
+
+private:
+    void on_msg(const msg_t &msg);
+
+    mailbox_manager_t *const manager;
+    const uuid_u id;
+    std::vector<server_t::stop_addr_t> servers;
+
+    std::deque<counted_t<const datum_t> > changes;
+    size_t skipped;
+    bool stopped;
+    // Pulsed when a message comes in, if get_changes() is waiting for one.
+    cond_t *msg_cond;
+
+    mailbox_t<void(msg_t)> mailbox;
+
+    DISABLE_COPYING(feed_t);
+};
+
+}  // namespace changefeed
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_CHANGEFEED_HPP_
@@ -5,18 +5,24 @@
 #include <math.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <algorithm>
+#include <limits>
 
 #include "errors.hpp"
 #include <boost/detail/endian.hpp>
 
+#include "config/args.hpp"
+#include "containers/archive/stl_types.hpp"
 #include "containers/archive/string_stream.hpp"
+#include "rdb_protocol/datum_json.hpp"
 #include "rdb_protocol/env.hpp"
 #include "rdb_protocol/error.hpp"
 #include "rdb_protocol/pseudo_time.hpp"
 #include "rdb_protocol/pseudo_literal.hpp"
 #include "stl_utils.hpp"
+#include "thread_local.hpp"
 
 
 namespace ql {
@@ -27,11 +33,170 @@ const std::set<std::string> datum_t::_allowed_pts = std::set<std::string>();
 
 const char* const datum_t::reql_type_string = "$reql_type$";
 
-datum_t::datum_t(type_t _type, bool _bool) : type(_type), r_bool(_bool) {
+// A freed datum's memory holds the pointer to the next one on the list.
+struct free_datum_t {
+    free_datum_t *next;
+};
+
+TLS_with_init(free_datum_t *, datum_free_list, NULL);
+TLS_with_init(size_t, datum_free_list_size, 0);
+
+void *datum_t::operator new(size_t size) {
+    rassert(size == sizeof(datum_t));
+    free_datum_t *head = TLS_get_datum_free_list();
+    if (head == NULL) {
+        return ::operator new(size);
+    }
+    TLS_set_datum_free_list(head->next);
+    TLS_set_datum_free_list_size(TLS_get_datum_free_list_size() - 1);
+    return head;
+}
+
+void datum_t::operator delete(void *p, size_t size) {
+    rassert(size == sizeof(datum_t));
+    if (p == NULL) {
+        return;
+    }
+    // Datums are often freed on another thread than they were allocated on,
+    // then they just end up on that thread's list.
+    const size_t list_size = TLS_get_datum_free_list_size();
+    if (list_size >= DATUM_FREE_LIST_SIZE) {
+        ::operator delete(p);
+        return;
+    }
+    free_datum_t *block = static_cast<free_datum_t *>(p);
+    block->next = TLS_get_datum_free_list();
+    TLS_set_datum_free_list(block);
+    TLS_set_datum_free_list_size(list_size + 1);
+}
+
+namespace {
+
+struct field_key_less_t {
+    bool operator()(const datum_object_t::value_type &field,
+                    const std::string &key) const {
+        return field.first < key;
+    }
+    bool operator()(const datum_object_t::value_type &a,
+                    const datum_object_t::value_type &b) const {
+        return a.first < b.first;
+    }
+};
+
+struct field_key_equal_t {
+    bool operator()(const datum_object_t::value_type &a,
+                    const datum_object_t::value_type &b) const {
+        return a.first == b.first;
+    }
+};
+
+}  // namespace
+
+datum_object_t::datum_object_t(std::map<std::string, counted_t<const datum_t> > &&map) {
+    // The map is sorted already.
+    fields_.reserve(map.size());
+    for (auto it = map.begin(); it != map.end(); ++it) {
+        fields_.push_back(value_type(it->first, std::move(it->second)));
+    }
+    map.clear();
+}
+
+std::vector<datum_object_t::value_type>::iterator
+datum_object_t::lower_bound(const std::string &key) {
+    // Fields usually get added in ascending order (deserialization, `merge`),
+    // so check the end first.
+    if (fields_.empty() || fields_.back().first < key) {
+        return fields_.end();
+    }
+    return std::lower_bound(fields_.begin(), fields_.end(), key, field_key_less_t());
+}
+
+datum_object_t::const_iterator datum_object_t::find(const std::string &key) const {
+    const_iterator it = std::lower_bound(fields_.begin(), fields_.end(), key,
+                                         field_key_less_t());
+    return (it != fields_.end() && it->first == key) ? it : fields_.end();
+}
+
+bool datum_object_t::set(const std::string &key, counted_t<const datum_t> val,
+                         clobber_bool_t clobber_bool) {
+    std::vector<value_type>::iterator it = lower_bound(key);
+    if (it != fields_.end() && it->first == key) {
+        if (clobber_bool == CLOBBER) {
+            it->second = std::move(val);
+        }
+        return true;
+    }
+    fields_.insert(it, value_type(key, std::move(val)));
+    return false;
+}
+
+bool datum_object_t::erase(const std::string &key) {
+    std::vector<value_type>::iterator it = lower_bound(key);
+    if (it == fields_.end() || it->first != key) {
+        return false;
+    }
+    fields_.erase(it);
+    return true;
+}
+
+bool datum_object_t::assign(std::vector<value_type> &&fields,
+                            std::string *duplicate_out) {
+    std::sort(fields.begin(), fields.end(), field_key_less_t());
+    std::vector<value_type>::iterator dup
+        = std::adjacent_find(fields.begin(), fields.end(), field_key_equal_t());
+    if (dup != fields.end()) {
+        *duplicate_out = dup->first;
+        return false;
+    }
+    fields_ = std::move(fields);
+    return true;
+}
+
+namespace {
+
+size_t serialized_size(const datum_object_t &object) {
+    size_t sz = varint_uint64_serialized_size(object.size());
+    for (auto it = object.begin(); it != object.end(); ++it) {
+        sz += serialized_size(*it);
+    }
+    return sz;
+}
+
+// The same format as a `std::map`, which is what objects used to be.
+write_message_t &operator<<(write_message_t &wm, const datum_object_t &object) {
+    serialize_varint_uint64(&wm, object.size());
+    for (auto it = object.begin(); it != object.end(); ++it) {
+        wm << *it;
+    }
+    return wm;
+}
+
+MUST_USE archive_result_t deserialize(read_stream_t *s, datum_object_t *object) {
+    uint64_t sz;
+    archive_result_t res = deserialize_varint_uint64(s, &sz);
+    if (res) { return res; }
+
+    for (uint64_t i = 0; i < sz; ++i) {
+        std::pair<std::string, counted_t<const datum_t> > field;
+        res = deserialize(s, &field);
+        if (res) { return res; }
+        // The fields were written in order, so each one is appended.
+        if (object->set(field.first, std::move(field.second), NOCLOBBER)) {
+            return ARCHIVE_RANGE_ERROR;
+        }
+    }
+    return ARCHIVE_SUCCESS;
+}
+
+}  // namespace
+
+datum_t::datum_t(type_t _type, bool _bool)
+    : type(_type), r_bool(_bool), serialized_size_cache(0) {
     r_sanity_check(_type == R_BOOL);
 }
 
-datum_t::datum_t(double _num) : type(R_NUM), r_num(_num) {
+datum_t::datum_t(double _num) : serialized_size_cache(0) {
+    init_num(_num);
     // so we can use `isfinite` in a GCC 4.4.3-compatible way
     using namespace std;  // NOLINT(build/namespaces)
     rcheck(isfinite(r_num), base_exc_t::GENERIC,
@@ -39,27 +204,34 @@ datum_t::datum_t(double _num) : type(R_NUM), r_num(_num) {
 }
 
 datum_t::datum_t(std::string &&_str)
-    : type(R_STR), r_str(new std::string(std::move(_str))) {
+    : type(R_STR), r_str(new std::string(std::move(_str))), serialized_size_cache(0) {
     check_str_validity(*r_str);
 }
 
 datum_t::datum_t(const char *cstr)
-    : type(R_STR), r_str(new std::string(cstr)) { }
+    : type(R_STR), r_str(new std::string(cstr)), serialized_size_cache(0) { }
 
 datum_t::datum_t(std::vector<counted_t<const datum_t> > &&_array)
     : type(R_ARRAY),
-      r_array(new std::vector<counted_t<const datum_t> >(std::move(_array))) {
+      r_array(new std::vector<counted_t<const datum_t> >(std::move(_array))),
+      serialized_size_cache(0) {
     rcheck_array_size(*r_array, base_exc_t::GENERIC);
 }
 
 datum_t::datum_t(std::map<std::string, counted_t<const datum_t> > &&_object)
     : type(R_OBJECT),
-      r_object(new std::map<std::string, counted_t<const datum_t> >(
-                   std::move(_object))) {
+      r_object(new datum_object_t(std::move(_object))),
+      serialized_size_cache(0) {
+    maybe_sanitize_ptype();
+}
+
+datum_t::datum_t(datum_object_t &&_object)
+    : type(R_OBJECT), r_object(new datum_object_t(std::move(_object))),
+      serialized_size_cache(0) {
     maybe_sanitize_ptype();
 }
 
-datum_t::datum_t(datum_t::type_t _type) : type(_type) {
+datum_t::datum_t(datum_t::type_t _type) : type(_type), serialized_size_cache(0) {
     r_sanity_check(type == R_ARRAY || type == R_OBJECT || type == R_NULL);
     switch (type) {
     case R_NULL: {
@@ -72,7 +244,7 @@ datum_t::datum_t(datum_t::type_t _type) : type(_type) {
         r_array = new std::vector<counted_t<const datum_t> >();
     } break;
     case R_OBJECT: {
-        r_object = new std::map<std::string, counted_t<const datum_t> >();
+        r_object = new datum_object_t();
     } break;
     case UNINITIALIZED: // fallthru
     default: unreachable();
@@ -101,6 +273,13 @@ datum_t::~datum_t() {
     }
 }
 
+void datum_t::init_num(double num) {
+    type = R_NUM;
+    r_num = num;
+    int64_t i;
+    num_is_int = number_as_integer(num, &i);
+}
+
 void datum_t::init_str() {
     type = R_STR;
     r_str = new std::string();
@@ -113,7 +292,7 @@ void datum_t::init_array() {
 
 void datum_t::init_object() {
     type = R_OBJECT;
-    r_object = new std::map<std::string, counted_t<const datum_t> >();
+    r_object = new datum_object_t();
 }
 
 void datum_t::init_json(cJSON *json) {
@@ -130,8 +309,7 @@ void datum_t::init_json(cJSON *json) {
         type = R_NULL;
     } break;
     case cJSON_Number: {
-        type = R_NUM;
-        r_num = json->valuedouble;
+        init_num(json->valuedouble);
         // so we can use `isfinite` in a GCC 4.4.3-compatible way
         using namespace std;  // NOLINT(build/namespaces)
         rcheck(isfinite(r_num), base_exc_t::GENERIC,
@@ -151,12 +329,16 @@ void datum_t::init_json(cJSON *json) {
     } break;
     case cJSON_Object: {
         init_object();
+        std::vector<datum_object_t::value_type> fields;
         json_object_iterator_t it(json);
         while (cJSON *item = it.next()) {
-            bool conflict = add(item->string, make_counted<datum_t>(item));
-            rcheck(!conflict, base_exc_t::GENERIC,
-                   strprintf("Duplicate key `%s` in JSON.", item->string));
+            std::string key(item->string);
+            check_str_validity(key);
+            fields.push_back(std::make_pair(std::move(key), make_counted<datum_t>(item)));
         }
+        std::string duplicate;
+        rcheck(r_object->assign(std::move(fields), &duplicate), base_exc_t::GENERIC,
+               strprintf("Duplicate key `%s` in JSON.", duplicate.c_str()));
         maybe_sanitize_ptype();
     } break;
     default: unreachable();
@@ -173,10 +355,10 @@ void datum_t::check_str_validity(const std::string &str) {
                      str.c_str(), null_offset));
 }
 
-datum_t::datum_t(cJSON *json) {
+datum_t::datum_t(cJSON *json) : serialized_size_cache(0) {
     init_json(json);
 }
-datum_t::datum_t(const scoped_cJSON_t &json) {
+datum_t::datum_t(const scoped_cJSON_t &json) : serialized_size_cache(0) {
     init_json(json.get());
 }
 
@@ -329,6 +511,262 @@ void datum_t::array_to_str_key(std::string *str_out) const {
     }
 }
 
+// The first byte of each value in a `BINARY` key.  The types are in the order
+// `cmp` puts them in, with pseudotypes after all of them.  Arrays and objects end
+// with a 0 byte, which sorts them before any longer value they're a prefix of.
+// Strings end with a 0 byte too, since they can't contain one.
+enum binary_key_tag_t {
+    BINARY_KEY_END = 0x00,
+    BINARY_KEY_OBJECT_FIELD = 0x01,
+    BINARY_KEY_ARRAY = 0x10,
+    BINARY_KEY_FALSE = 0x20,
+    BINARY_KEY_TRUE = 0x21,
+    BINARY_KEY_NULL = 0x30,
+    BINARY_KEY_NUM = 0x40,
+    BINARY_KEY_OBJECT = 0x50,
+    BINARY_KEY_STR = 0x60,
+    BINARY_KEY_PTYPE = 0x70
+};
+
+// Numbers take their 8 bytes big-endian, mangled like in `num_to_str_key`.
+void num_to_binary_key(double d, std::string *str_out) {
+    union {
+        double d;
+        uint64_t u;
+    } packed;
+    // -0.0 and 0.0 are equal values, so they get the same key.
+    packed.d = d == 0 ? 0.0 : d;
+    if (packed.u & (1ULL << 63)) {
+        packed.u = ~packed.u;
+    } else {
+        packed.u ^= (1ULL << 63);
+    }
+    for (int shift = 56; shift >= 0; shift -= 8) {
+        str_out->push_back(static_cast<char>((packed.u >> shift) & 0xFF));
+    }
+}
+
+bool binary_key_to_num(const std::string &key, size_t *pos, double *num_out) {
+    if (key.size() - *pos < sizeof(uint64_t)) {
+        return false;
+    }
+    union {
+        double d;
+        uint64_t u;
+    } packed;
+    packed.u = 0;
+    for (size_t i = 0; i < sizeof(uint64_t); ++i) {
+        packed.u = (packed.u << 8) | static_cast<uint8_t>(key[*pos + i]);
+    }
+    *pos += sizeof(uint64_t);
+    if (packed.u & (1ULL << 63)) {
+        packed.u ^= (1ULL << 63);
+    } else {
+        packed.u = ~packed.u;
+    }
+    *num_out = packed.d;
+    return true;
+}
+
+bool binary_key_to_str(const std::string &key, size_t *pos, std::string *str_out) {
+    size_t end = key.find('\0', *pos);
+    if (end == std::string::npos) {
+        return false;
+    }
+    str_out->assign(key, *pos, end - *pos);
+    *pos = end + 1;
+    return true;
+}
+
+void datum_t::to_binary_key(std::string *str_out) const {
+    switch (get_type()) {
+    case R_ARRAY: {
+        str_out->push_back(BINARY_KEY_ARRAY);
+        for (size_t i = 0; i < size(); ++i) {
+            get(i, NOTHROW)->to_binary_key(str_out);
+        }
+        str_out->push_back(BINARY_KEY_END);
+    } break;
+    case R_BOOL:
+        str_out->push_back(as_bool() ? BINARY_KEY_TRUE : BINARY_KEY_FALSE);
+        break;
+    case R_NULL:
+        str_out->push_back(BINARY_KEY_NULL);
+        break;
+    case R_NUM:
+        str_out->push_back(BINARY_KEY_NUM);
+        num_to_binary_key(as_num(), str_out);
+        break;
+    case R_OBJECT: {
+        if (is_ptype()) {
+            if (get_reql_type() != pseudo::time_string) {
+                rfail(base_exc_t::GENERIC,
+                      "Cannot use psuedotype %s as a primary or secondary key value .",
+                      get_type_name().c_str());
+            }
+            str_out->push_back(BINARY_KEY_PTYPE);
+            str_out->append(pseudo::time_string);
+            str_out->push_back(BINARY_KEY_END);
+            num_to_binary_key(get(pseudo::epoch_time_key)->as_num(), str_out);
+            break;
+        }
+        // Each field is marked, so that an empty key doesn't look like the end.
+        str_out->push_back(BINARY_KEY_OBJECT);
+        const datum_object_t &obj = as_object();
+        for (auto it = obj.begin(); it != obj.end(); ++it) {
+            str_out->push_back(BINARY_KEY_OBJECT_FIELD);
+            str_out->append(it->first);
+            str_out->push_back(BINARY_KEY_END);
+            it->second->to_binary_key(str_out);
+        }
+        str_out->push_back(BINARY_KEY_END);
+    } break;
+    case R_STR:
+        str_out->push_back(BINARY_KEY_STR);
+        str_out->append(as_str());
+        str_out->push_back(BINARY_KEY_END);
+        break;
+    case UNINITIALIZED: // fallthru
+    default:
+        unreachable();
+    }
+}
+
+// The 64-bit FNV-1a hash of the whole binary key, which unlike `std::hash` is the
+// same in every build that reads the index.
+void datum_t::to_hash_key(std::string *str_out) const {
+    std::string binary_key;
+    to_binary_key(&binary_key);
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < binary_key.size(); ++i) {
+        hash ^= static_cast<uint8_t>(binary_key[i]);
+        hash *= 1099511628211ULL;
+    }
+    for (size_t i = 0; i < sizeof(uint64_t); ++i) {
+        str_out->push_back(static_cast<char>(hash >> (8 * (sizeof(uint64_t) - 1 - i))));
+    }
+}
+
+// Reads the value at `*pos` of a `BINARY` key.  Fails at the end of a truncated
+// key, and at pseudotypes, which aren't whole in their keys.
+bool binary_key_to_datum(const std::string &key, size_t *pos,
+                         counted_t<const datum_t> *datum_out) {
+    if (*pos >= key.size()) {
+        return false;
+    }
+    const uint8_t tag = static_cast<uint8_t>(key[*pos]);
+    *pos += 1;
+    switch (tag) {
+    case BINARY_KEY_ARRAY: {
+        std::vector<counted_t<const datum_t> > array;
+        while (*pos < key.size() && key[*pos] != BINARY_KEY_END) {
+            counted_t<const datum_t> item;
+            if (!binary_key_to_datum(key, pos, &item)) {
+                return false;
+            }
+            array.push_back(item);
+        }
+        if (*pos >= key.size()) {
+            return false;
+        }
+        *pos += 1;
+        *datum_out = make_counted<const datum_t>(std::move(array));
+        return true;
+    }
+    case BINARY_KEY_FALSE: // fallthru
+    case BINARY_KEY_TRUE:
+        *datum_out = make_counted<const datum_t>(datum_t::R_BOOL,
+                                                 tag == BINARY_KEY_TRUE);
+        return true;
+    case BINARY_KEY_NULL:
+        *datum_out = make_counted<const datum_t>(datum_t::R_NULL);
+        return true;
+    case BINARY_KEY_NUM: {
+        double num;
+        if (!binary_key_to_num(key, pos, &num)) {
+            return false;
+        }
+        *datum_out = make_counted<const datum_t>(num);
+        return true;
+    }
+    case BINARY_KEY_OBJECT: {
+        std::map<std::string, counted_t<const datum_t> > object;
+        while (*pos < key.size() && key[*pos] == BINARY_KEY_OBJECT_FIELD) {
+            *pos += 1;
+            std::string field;
+            counted_t<const datum_t> value;
+            if (!binary_key_to_str(key, pos, &field)
+                || !binary_key_to_datum(key, pos, &value)) {
+                return false;
+            }
+            object[field] = value;
+        }
+        if (*pos >= key.size()) {
+            return false;
+        }
+        *pos += 1;
+        *datum_out = make_counted<const datum_t>(std::move(object));
+        return true;
+    }
+    case BINARY_KEY_STR: {
+        std::string str;
+        if (!binary_key_to_str(key, pos, &str)) {
+            return false;
+        }
+        *datum_out = make_counted<const datum_t>(std::move(str));
+        return true;
+    }
+    case BINARY_KEY_PTYPE:
+        return false;
+    default:
+        unreachable();
+    }
+}
+
+counted_t<const datum_t> datum_t::from_binary_secondary(const std::string &secondary) {
+    size_t pos = 0;
+    counted_t<const datum_t> res;
+    if (!binary_key_to_datum(secondary, &pos, &res) || pos != secondary.size()) {
+        return counted_t<const datum_t>();
+    }
+    return res;
+}
+
+// `BINARY` keys can hold any value, but secondary index values are limited to
+// the same types as `LEGACY` ones.
+void datum_t::check_secondary_value() const {
+    switch (get_type()) {
+    case R_NUM: // fallthru
+    case R_STR: // fallthru
+    case R_BOOL:
+        break;
+    case R_ARRAY:
+        for (size_t i = 0; i < size(); ++i) {
+            get(i, NOTHROW)->check_secondary_value();
+        }
+        break;
+    case R_OBJECT:
+        if (is_ptype()) {
+            if (get_reql_type() != pseudo::time_string) {
+                rfail(base_exc_t::GENERIC,
+                      "Cannot use psuedotype %s as a primary or secondary key value .",
+                      get_type_name().c_str());
+            }
+            break;
+        }
+        // fallthru
+    case R_NULL:
+        type_error(
+            strprintf("Secondary keys must be a number, string, bool, or array "
+                      "(got %s of type %s).", print().c_str(),
+                      get_type_name().c_str()));
+        break;
+    case UNINITIALIZED: // fallthru
+    default:
+        unreachable();
+    }
+}
+
 int datum_t::pseudo_cmp(const datum_t &rhs) const {
     r_sanity_check(is_ptype());
     if (get_reql_type() == pseudo::time_string) {
@@ -427,7 +865,8 @@ std::string datum_t::mangle_secondary(const std::string &secondary,
     return res;
 }
 
-std::string datum_t::print_secondary(const store_key_t &primary_key,
+std::string datum_t::print_secondary(sindex_key_format_t format,
+                                     const store_key_t &primary_key,
                                      boost::optional<uint64_t> tag_num) const {
     std::string secondary_key_string;
     std::string primary_key_string = key_to_unescaped_str(primary_key);
@@ -439,7 +878,13 @@ std::string datum_t::print_secondary(const store_key_t &primary_key,
               key_to_debug_str(primary_key).c_str());
     }
 
-    if (type == R_NUM) {
+    if (format == sindex_key_format_t::BINARY) {
+        check_secondary_value();
+        to_binary_key(&secondary_key_string);
+    } else if (format == sindex_key_format_t::HASH) {
+        check_secondary_value();
+        to_hash_key(&secondary_key_string);
+    } else if (type == R_NUM) {
         num_to_str_key(&secondary_key_string);
     } else if (type == R_STR) {
         str_to_str_key(&secondary_key_string);
@@ -519,9 +964,15 @@ boost::optional<uint64_t> datum_t::extract_tag(const std::string &secondary) {
 // but the amount truncated depends on the length of the primary key.  Since we
 // do not know how much was truncated, we have to truncate the maximum amount,
 // then return all matches and filter them out later.
-store_key_t datum_t::truncated_secondary() const {
+store_key_t datum_t::truncated_secondary(sindex_key_format_t format) const {
     std::string s;
-    if (type == R_NUM) {
+    if (format == sindex_key_format_t::BINARY) {
+        check_secondary_value();
+        to_binary_key(&s);
+    } else if (format == sindex_key_format_t::HASH) {
+        check_secondary_value();
+        to_hash_key(&s);
+    } else if (type == R_NUM) {
         num_to_str_key(&s);
     } else if (type == R_STR) {
         str_to_str_key(&s);
@@ -610,8 +1061,20 @@ struct datum_rcheckable_t : public rcheckable_t {
 };
 
 int64_t datum_t::as_int() const {
+    check_type(R_NUM);
+    if (num_is_int) {
+        return static_cast<int64_t>(r_num);
+    }
     datum_rcheckable_t target(this);
-    return checked_convert_to_int(&target, as_num());
+    return checked_convert_to_int(&target, r_num);
+}
+
+bool datum_t::num_as_int(int64_t *i_out) const {
+    check_type(R_NUM);
+    if (num_is_int) {
+        *i_out = static_cast<int64_t>(r_num);
+    }
+    return num_is_int;
 }
 
 const std::string &datum_t::as_str() const {
@@ -631,6 +1094,7 @@ void datum_t::change(size_t index, counted_t<const datum_t> val) {
            strprintf("Index `%zu` out of bounds for array of size: `%zu`.",
                      index, r_array->size()));
     (*r_array)[index] = val;
+    serialized_size_cache = 0;
 }
 
 void datum_t::insert(size_t index, counted_t<const datum_t> val) {
@@ -640,6 +1104,7 @@ void datum_t::insert(size_t index, counted_t<const datum_t> val) {
            strprintf("Index `%zu` out of bounds for array of size: `%zu`.",
                      index, r_array->size()));
     r_array->insert(r_array->begin() + index, val);
+    serialized_size_cache = 0;
 }
 
 void datum_t::erase(size_t index) {
@@ -649,6 +1114,7 @@ void datum_t::erase(size_t index) {
            strprintf("Index `%zu` out of bounds for array of size: `%zu`.",
                      index, r_array->size()));
     r_array->erase(r_array->begin() + index);
+    serialized_size_cache = 0;
 }
 
 void datum_t::erase_range(size_t start, size_t end) {
@@ -666,6 +1132,7 @@ void datum_t::erase_range(size_t start, size_t end) {
            strprintf("Start index `%zu` is greater than end index `%zu`.",
                       start, end));
     r_array->erase(r_array->begin() + start, r_array->begin() + end);
+    serialized_size_cache = 0;
 }
 
 void datum_t::splice(size_t index, counted_t<const datum_t> values) {
@@ -676,6 +1143,7 @@ void datum_t::splice(size_t index, counted_t<const datum_t> values) {
                      index, r_array->size()));
     r_array->insert(r_array->begin() + index,
                     values->as_array().begin(), values->as_array().end());
+    serialized_size_cache = 0;
 }
 
 size_t datum_t::size() const {
@@ -694,8 +1162,7 @@ counted_t<const datum_t> datum_t::get(size_t index, throw_bool_t throw_bool) con
 
 counted_t<const datum_t> datum_t::get(const std::string &key,
                                       throw_bool_t throw_bool) const {
-    std::map<std::string, counted_t<const datum_t> >::const_iterator it
-        = as_object().find(key);
+    datum_object_t::const_iterator it = as_object().find(key);
     if (it != as_object().end()) return it->second;
     if (throw_bool == THROW) {
         rfail(base_exc_t::NON_EXISTENCE,
@@ -704,7 +1171,7 @@ counted_t<const datum_t> datum_t::get(const std::string &key,
     return counted_t<const datum_t>();
 }
 
-const std::map<std::string, counted_t<const datum_t> > &datum_t::as_object() const {
+const datum_object_t &datum_t::as_object() const {
     check_type(R_OBJECT);
     return *r_object;
 }
@@ -724,8 +1191,8 @@ cJSON *datum_t::as_json_raw() const {
     } break;
     case R_OBJECT: {
         scoped_cJSON_t obj(cJSON_CreateObject());
-        for (std::map<std::string, counted_t<const datum_t> >::const_iterator
-                 it = r_object->begin(); it != r_object->end(); ++it) {
+        for (datum_object_t::const_iterator it = r_object->begin();
+             it != r_object->end(); ++it) {
             obj.AddItemToObject(it->first.c_str(), it->second->as_json_raw());
         }
         return obj.release();
@@ -740,6 +1207,97 @@ scoped_cJSON_t datum_t::as_json() const {
     return scoped_cJSON_t(as_json_raw());
 }
 
+namespace {
+
+// Escapes like cJSON's print_string_ptr().
+void write_json_string(const std::string &str, std::string *out) {
+    out->push_back('"');
+    for (auto it = str.begin(); it != str.end(); ++it) {
+        const unsigned char c = *it;
+        if (c > 31 && c != '"' && c != '\\') {
+            out->push_back(c);
+            continue;
+        }
+        out->push_back('\\');
+        switch (c) {
+        case '\\': out->push_back('\\'); break;
+        case '"': out->push_back('"'); break;
+        case '\b': out->push_back('b'); break;
+        case '\f': out->push_back('f'); break;
+        case '\n': out->push_back('n'); break;
+        case '\r': out->push_back('r'); break;
+        case '\t': out->push_back('t'); break;
+        default: {
+            char buf[8];
+            int len = snprintf(buf, sizeof(buf), "u%04x", c);
+            out->append(buf, len);
+        } break;
+        }
+    }
+    out->push_back('"');
+}
+
+}  // namespace
+
+void datum_t::write_json(std::string *out) const {
+    switch (get_type()) {
+    case R_NULL: out->append("null"); break;
+    case R_BOOL: out->append(r_bool ? "true" : "false"); break;
+    case R_NUM: {
+        // Integers up to 2^53 have fewer than 20 digits, so `%.20g` would print
+        // them as they are, but that takes a lot longer.  It prints -0.0 as
+        // "-0", though.
+        using namespace std;  // NOLINT(build/namespaces)
+        if (num_is_int && !(r_num == 0 && signbit(r_num))) {
+            char buf[24];
+            char *const end = buf + sizeof(buf);
+            char *p = end;
+            int64_t i = static_cast<int64_t>(r_num);
+            uint64_t u = i < 0 ? -static_cast<uint64_t>(i) : i;
+            do {
+                *--p = '0' + u % 10;
+                u /= 10;
+            } while (u != 0);
+            if (i < 0) {
+                *--p = '-';
+            }
+            out->append(p, end - p);
+            break;
+        }
+        // The same format as cJSON's print_number().
+        char buf[64];
+        int len = snprintf(buf, sizeof(buf), "%.20g", r_num);
+        guarantee(len > 0 && static_cast<size_t>(len) < sizeof(buf));
+        out->append(buf, len);
+    } break;
+    case R_STR: write_json_string(*r_str, out); break;
+    case R_ARRAY: {
+        out->push_back('[');
+        for (auto it = r_array->begin(); it != r_array->end(); ++it) {
+            if (it != r_array->begin()) {
+                out->push_back(',');
+            }
+            (*it)->write_json(out);
+        }
+        out->push_back(']');
+    } break;
+    case R_OBJECT: {
+        out->push_back('{');
+        for (auto it = r_object->begin(); it != r_object->end(); ++it) {
+            if (it != r_object->begin()) {
+                out->push_back(',');
+            }
+            write_json_string(it->first, out);
+            out->push_back(':');
+            it->second->write_json(out);
+        }
+        out->push_back('}');
+    } break;
+    case UNINITIALIZED: // fallthru
+    default: unreachable();
+    }
+}
+
 // TODO: make STR and OBJECT convertible to sequence?
 counted_t<datum_stream_t>
 datum_t::as_datum_stream(const protob_t<const Backtrace> &backtrace) const {
@@ -764,6 +1322,7 @@ void datum_t::add(counted_t<const datum_t> val) {
     check_type(R_ARRAY);
     r_sanity_check(val.has());
     r_array->push_back(val);
+    serialized_size_cache = 0;
     rcheck_array_size(*r_array, base_exc_t::GENERIC);
 }
 
@@ -772,12 +1331,12 @@ MUST_USE bool datum_t::add(const std::string &key, counted_t<const datum_t> val,
     check_type(R_OBJECT);
     check_str_validity(key);
     r_sanity_check(val.has());
-    bool key_in_obj = r_object->count(key) > 0;
-    if (!key_in_obj || (clobber_bool == CLOBBER)) (*r_object)[key] = val;
-    return key_in_obj;
+    serialized_size_cache = 0;
+    return r_object->set(key, std::move(val), clobber_bool);
 }
 
 MUST_USE bool datum_t::delete_field(const std::string &key) {
+    serialized_size_cache = 0;
     return r_object->erase(key);
 }
 
@@ -785,7 +1344,7 @@ counted_t<const datum_t> datum_t::merge(counted_t<const datum_t> rhs) const {
     if (get_type() != R_OBJECT || rhs->get_type() != R_OBJECT) { return rhs; }
 
     datum_ptr_t d(as_object());
-    const std::map<std::string, counted_t<const datum_t> > &rhs_obj = rhs->as_object();
+    const datum_object_t &rhs_obj = rhs->as_object();
     for (auto it = rhs_obj.begin(); it != rhs_obj.end(); ++it) {
         counted_t<const datum_t> sub_lhs = d->get(it->first, NOTHROW);
         bool is_literal = it->second->is_ptype(pseudo::literal_string);
@@ -811,7 +1370,7 @@ counted_t<const datum_t> datum_t::merge(counted_t<const datum_t> rhs) const {
 counted_t<const datum_t> datum_t::merge(counted_t<const datum_t> rhs,
                                         merge_resoluter_t f) const {
     datum_ptr_t d(as_object());
-    const std::map<std::string, counted_t<const datum_t> > &rhs_obj = rhs->as_object();
+    const datum_object_t &rhs_obj = rhs->as_object();
     for (auto it = rhs_obj.begin(); it != rhs_obj.end(); ++it) {
         if (counted_t<const datum_t> left = get(it->first, NOTHROW)) {
             bool b = d.add(it->first, f(it->first, left, it->second), CLOBBER);
@@ -866,9 +1425,8 @@ int datum_t::cmp(const datum_t &rhs) const {
             }
             return pseudo_cmp(rhs);
         } else {
-            const std::map<std::string, counted_t<const datum_t> > &obj = as_object();
-            const std::map<std::string, counted_t<const datum_t> > &rhs_obj
-                = rhs.as_object();
+            const datum_object_t &obj = as_object();
+            const datum_object_t &rhs_obj = rhs.as_object();
             auto it = obj.begin();
             auto it2 = rhs_obj.begin();
             while (it != obj.end() && it2 != rhs_obj.end()) {
@@ -906,9 +1464,9 @@ void datum_t::runtime_fail(base_exc_t::type_t exc_type,
     ql::runtime_fail(exc_type, test, file, line, msg);
 }
 
-datum_t::datum_t() : type(UNINITIALIZED) { }
+datum_t::datum_t() : type(UNINITIALIZED), serialized_size_cache(0) { }
 
-datum_t::datum_t(const Datum *d) : type(UNINITIALIZED) {
+datum_t::datum_t(const Datum *d) : type(UNINITIALIZED), serialized_size_cache(0) {
     init_from_pb(d);
 }
 
@@ -923,8 +1481,7 @@ void datum_t::init_from_pb(const Datum *d) {
         r_bool = d->r_bool();
     } break;
     case Datum::R_NUM: {
-        type = R_NUM;
-        r_num = d->r_num();
+        init_num(d->r_num());
         // so we can use `isfinite` in a GCC 4.4.3-compatible way
         using namespace std;  // NOLINT(build/namespaces)
         rcheck(isfinite(r_num),
@@ -937,8 +1494,8 @@ void datum_t::init_from_pb(const Datum *d) {
         check_str_validity(*r_str);
     } break;
     case Datum::R_JSON: {
-        scoped_cJSON_t cjson(cJSON_Parse(d->r_str().c_str()));
-        init_json(cjson.get());
+        rcheck(parse_json_datum_into(d->r_str(), this), base_exc_t::GENERIC,
+               "Failed to parse R_JSON datum.");
     } break;
     case Datum::R_ARRAY: {
         init_array();
@@ -948,15 +1505,18 @@ void datum_t::init_from_pb(const Datum *d) {
     } break;
     case Datum::R_OBJECT: {
         init_object();
+        std::vector<datum_object_t::value_type> fields;
+        fields.reserve(d->r_object_size());
         for (int i = 0; i < d->r_object_size(); ++i) {
             const Datum_AssocPair *ap = &d->r_object(i);
             const std::string &key = ap->key();
             check_str_validity(key);
-            rcheck(r_object->count(key) == 0,
-                   base_exc_t::GENERIC,
-                   strprintf("Duplicate key %s in object.", key.c_str()));
-            (*r_object)[key] = make_counted<datum_t>(&ap->val());
+            fields.push_back(std::make_pair(key, make_counted<datum_t>(&ap->val())));
         }
+        std::string duplicate;
+        rcheck(r_object->assign(std::move(fields), &duplicate),
+               base_exc_t::GENERIC,
+               strprintf("Duplicate key %s in object.", duplicate.c_str()));
         std::set<std::string> allowed_ptypes = { pseudo::literal_string };
         maybe_sanitize_ptype(allowed_ptypes);
     } break;
@@ -1027,7 +1587,8 @@ void datum_t::write_to_protobuf(Datum *d, use_json_t use_json) const {
     } break;
     case use_json_t::YES: {
         d->set_type(Datum::R_JSON);
-        d->set_r_str(as_json().PrintUnformatted());
+        d->clear_r_str();
+        write_json(d->mutable_r_str());
     } break;
     default: unreachable();
     }
@@ -1052,6 +1613,14 @@ ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(datum_serialized_type_t, int8_t,
 // datum_T> &).
 size_t serialized_size(const counted_t<const datum_t> &datum) {
     r_sanity_check(datum.has());
+    if (datum->serialized_size_cache == 0) {
+        datum->serialized_size_cache = datum->compute_serialized_size();
+    }
+    return datum->serialized_size_cache;
+}
+
+size_t datum_t::compute_serialized_size() const {
+    const datum_t *datum = this;
     size_t sz = 1; // 1 byte for the type
     switch (datum->get_type()) {
     case datum_t::R_ARRAY: {
@@ -1062,9 +1631,8 @@ size_t serialized_size(const counted_t<const datum_t> &datum) {
     } break;
     case datum_t::R_NULL: break;
     case datum_t::R_NUM: {
-        double d = datum->as_num();
         int64_t i;
-        if (number_as_integer(d, &i)) {
+        if (datum->num_as_int(&i)) {
             sz += varint_uint64_serialized_size(abs(i));
         } else {
             sz += serialized_size_t<double>::value;
@@ -1085,6 +1653,8 @@ size_t serialized_size(const counted_t<const datum_t> &datum) {
 
 write_message_t &operator<<(write_message_t &wm, const counted_t<const datum_t> &datum) {
     r_sanity_check(datum.has());
+    // The size is cached, so this is cheap for the nested datums too.
+    wm.reserve(serialized_size(datum));
     switch (datum->get_type()) {
     case datum_t::R_ARRAY: {
         wm << datum_serialized_type_t::R_ARRAY;
@@ -1102,7 +1672,7 @@ write_message_t &operator<<(write_message_t &wm, const counted_t<const datum_t>
     case datum_t::R_NUM: {
         double value = datum->as_num();
         int64_t i;
-        if (number_as_integer(value, &i)) {
+        if (datum->num_as_int(&i)) {
             // We serialize the signed-zero double, -0.0, with INT_NEGATIVE.
 
             // so we can use `signbit` in a GCC 4.4.3-compatible way
@@ -1121,7 +1691,7 @@ write_message_t &operator<<(write_message_t &wm, const counted_t<const datum_t>
     } break;
     case datum_t::R_OBJECT: {
         wm << datum_serialized_type_t::R_OBJECT;
-        const std::map<std::string, counted_t<const datum_t> > &value = datum->as_object();
+        const datum_object_t &value = datum->as_object();
         wm << value;
     } break;
     case datum_t::R_STR: {
@@ -1136,13 +1706,12 @@ write_message_t &operator<<(write_message_t &wm, const counted_t<const datum_t>
     return wm;
 }
 
-archive_result_t deserialize(read_stream_t *s, counted_t<const datum_t> *datum) {
-    datum_serialized_type_t type;
-    archive_result_t res = deserialize(s, &type);
-    if (res) {
-        return res;
-    }
+namespace {
 
+// Deserializes the rest of a datum whose type has been read already.
+archive_result_t deserialize_of_type(read_stream_t *s, datum_serialized_type_t type,
+                                     counted_t<const datum_t> *datum) {
+    archive_result_t res;
     switch (type) {
     case datum_serialized_type_t::R_ARRAY: {
         std::vector<counted_t<const datum_t> > value;
@@ -1208,7 +1777,7 @@ archive_result_t deserialize(read_stream_t *s, counted_t<const datum_t> *datum)
         }
     } break;
     case datum_serialized_type_t::R_OBJECT: {
-        std::map<std::string, counted_t<const datum_t> > value;
+        datum_object_t value;
         res = deserialize(s, &value);
         if (res) {
             return res;
@@ -1238,6 +1807,145 @@ archive_result_t deserialize(read_stream_t *s, counted_t<const datum_t> *datum)
     return ARCHIVE_SUCCESS;
 }
 
+}  // namespace
+
+archive_result_t deserialize(read_stream_t *s, counted_t<const datum_t> *datum) {
+    datum_serialized_type_t type;
+    archive_result_t res = deserialize(s, &type);
+    if (res) {
+        return res;
+    }
+    return deserialize_of_type(s, type, datum);
+}
+
+namespace {
+
+// Reads past `n` bytes.
+MUST_USE archive_result_t skip_bytes(read_stream_t *s, uint64_t n) {
+    char buf[1024];
+    while (n > 0) {
+        const int64_t chunk = std::min<uint64_t>(n, sizeof(buf));
+        int64_t num_read = force_read(s, buf, chunk);
+        if (num_read == -1) {
+            return ARCHIVE_SOCK_ERROR;
+        }
+        if (num_read < chunk) {
+            return ARCHIVE_SOCK_EOF;
+        }
+        n -= chunk;
+    }
+    return ARCHIVE_SUCCESS;
+}
+
+// Reads past a serialized datum without building it.
+MUST_USE archive_result_t skip_datum(read_stream_t *s) {
+    datum_serialized_type_t type;
+    archive_result_t res = deserialize(s, &type);
+    if (res) {
+        return res;
+    }
+
+    switch (type) {
+    case datum_serialized_type_t::R_ARRAY: {
+        uint64_t sz;
+        res = deserialize_varint_uint64(s, &sz);
+        for (uint64_t i = 0; !res && i < sz; ++i) {
+            res = skip_datum(s);
+        }
+        return res;
+    }
+    case datum_serialized_type_t::R_BOOL: {
+        bool value;
+        return deserialize(s, &value);
+    }
+    case datum_serialized_type_t::R_NULL:
+        return ARCHIVE_SUCCESS;
+    case datum_serialized_type_t::DOUBLE: {
+        double value;
+        return deserialize(s, &value);
+    }
+    case datum_serialized_type_t::INT_NEGATIVE:  // fall through
+    case datum_serialized_type_t::INT_POSITIVE: {
+        uint64_t value;
+        return deserialize_varint_uint64(s, &value);
+    }
+    case datum_serialized_type_t::R_OBJECT: {
+        uint64_t sz;
+        res = deserialize_varint_uint64(s, &sz);
+        for (uint64_t i = 0; !res && i < sz; ++i) {
+            uint64_t key_size;
+            res = deserialize_varint_uint64(s, &key_size);
+            if (!res) {
+                res = skip_bytes(s, key_size);
+            }
+            if (!res) {
+                res = skip_datum(s);
+            }
+        }
+        return res;
+    }
+    case datum_serialized_type_t::R_STR: {
+        uint64_t sz;
+        res = deserialize_varint_uint64(s, &sz);
+        return res ? res : skip_bytes(s, sz);
+    }
+    default:
+        return ARCHIVE_RANGE_ERROR;
+    }
+}
+
+}  // namespace
+
+archive_result_t deserialize_fields(read_stream_t *s,
+                                    const std::vector<std::string> &fields,
+                                    counted_t<const datum_t> *datum) {
+    rassert(std::is_sorted(fields.begin(), fields.end()));
+    datum_serialized_type_t type;
+    archive_result_t res = deserialize(s, &type);
+    if (res) {
+        return res;
+    }
+    if (type != datum_serialized_type_t::R_OBJECT) {
+        return deserialize_of_type(s, type, datum);
+    }
+
+    uint64_t sz;
+    res = deserialize_varint_uint64(s, &sz);
+    if (res) {
+        return res;
+    }
+    datum_object_t object;
+    for (uint64_t i = 0; i < sz; ++i) {
+        std::string key;
+        res = deserialize(s, &key);
+        if (res) {
+            return res;
+        }
+        if (key == datum_t::reql_type_string) {
+            // Only all of a pseudotype makes sense.
+            datum->reset();
+            return ARCHIVE_SUCCESS;
+        }
+        if (!std::binary_search(fields.begin(), fields.end(), key)) {
+            res = skip_datum(s);
+            if (res) {
+                return res;
+            }
+            continue;
+        }
+        counted_t<const datum_t> value;
+        res = deserialize(s, &value);
+        if (res) {
+            return res;
+        }
+        if (object.set(key, std::move(value), NOCLOBBER)) {
+            return ARCHIVE_RANGE_ERROR;
+        }
+    }
+    datum->reset(new datum_t(std::move(object)));
+    return ARCHIVE_SUCCESS;
+}
+
 write_message_t &operator<<(write_message_t &wm, const empty_ok_t<const counted_t<const datum_t> > &datum) {
     const counted_t<const datum_t> *pointer = datum.get();
     const bool has = pointer->has();
@@ -1330,6 +2038,198 @@ archive_result_t wire_datum_map_t::rdb_deserialize(read_stream_t *s) {
     return ARCHIVE_SUCCESS;
 }
 
+// Pseudotypes sort after everything else, see datum_t::cmp.
+static const char PTYPE_SORT_TAG = 0x7F;
+
+static void append_sort_key_str(const std::string &s, std::string *out) {
+    // Escaping the zeros keeps the terminator less than any character that can
+    // follow in a longer string.
+    for (auto it = s.begin(); it != s.end(); ++it) {
+        out->push_back(*it);
+        if (*it == '\0') {
+            out->push_back('\xFF');
+        }
+    }
+    out->push_back('\0');
+    out->push_back('\0');
+}
+
+static void append_sort_key_num(double d, std::string *out) {
+    uint64_t bits = 0;
+    // -0.0 == 0.0, so they get the same encoding.
+    if (d != 0) {
+        memcpy(&bits, &d, sizeof(bits));
+    }
+    // Flipping the sign bit of positive numbers puts them above the negative ones,
+    // and inverting negative numbers orders them by decreasing magnitude.
+    if ((bits >> 63) != 0) {
+        bits = ~bits;
+    } else {
+        bits |= static_cast<uint64_t>(1) << 63;
+    }
+    for (int shift = 56; shift >= 0; shift -= 8) {
+        out->push_back(static_cast<char>((bits >> shift) & 0xFF));
+    }
+}
+
+void append_sort_key(const datum_t &d, std::string *out) {
+    if (d.is_ptype()) {
+        out->push_back(PTYPE_SORT_TAG);
+        const std::string reql_type = d.get_reql_type();
+        append_sort_key_str(reql_type, out);
+        if (reql_type == pseudo::time_string) {
+            append_sort_key(*d.get(pseudo::epoch_time_key), out);
+            return;
+        }
+        rfail_datum(base_exc_t::GENERIC, "Incomparable type %s.", d.get_type_name().c_str());
+    }
+
+    // The types sort in the order of their enum values, see datum_t::cmp.
+    out->push_back(static_cast<char>(d.get_type()));
+    switch (d.get_type()) {
+    case datum_t::R_NULL: break;
+    case datum_t::R_BOOL: out->push_back(d.as_bool() ? '\1' : '\0'); break;
+    case datum_t::R_NUM: append_sort_key_num(d.as_num(), out); break;
+    case datum_t::R_STR: append_sort_key_str(d.as_str(), out); break;
+    case datum_t::R_ARRAY: {
+        // Every element starts with a nonzero type tag, so a shorter array sorts
+        // first.
+        const std::vector<counted_t<const datum_t> > &arr = d.as_array();
+        for (auto it = arr.begin(); it != arr.end(); ++it) {
+            append_sort_key(**it, out);
+        }
+        out->push_back('\0');
+    } break;
+    case datum_t::R_OBJECT: {
+        const datum_object_t &obj = d.as_object();
+        for (auto it = obj.begin(); it != obj.end(); ++it) {
+            out->push_back('\1');
+            append_sort_key_str(it->first, out);
+            append_sort_key(*it->second, out);
+        }
+        out->push_back('\0');
+    } break;
+    case datum_t::UNINITIALIZED: // fallthru
+    default: unreachable();
+    }
+}
+
+class keyed_row_less_t {
+public:
+    bool operator()(const keyed_row_t &l, const keyed_row_t &r) const {
+        return l.first < r.first;
+    }
+};
+
+void sort_keyed_rows(std::vector<keyed_row_t> *rows) {
+    std::sort(rows->begin(), rows->end(), keyed_row_less_t());
+}
+
+void top_k_rows_t::add(std::string &&key, const counted_t<const datum_t> &row) {
+    if (rows.size() >= k) {
+        if (rows.empty() || key >= rows.front().first) {
+            return;
+        }
+        std::pop_heap(rows.begin(), rows.end(), keyed_row_less_t());
+        rows.pop_back();
+    }
+    rows.push_back(keyed_row_t(std::move(key), row));
+    std::push_heap(rows.begin(), rows.end(), keyed_row_less_t());
+}
+
+void top_k_rows_t::add(const top_k_rows_t &other) {
+    for (auto it = other.rows.begin(); it != other.rows.end(); ++it) {
+        add(std::string(it->first), it->second);
+    }
+}
+
+std::vector<counted_t<const datum_t> > top_k_rows_t::sorted_rows() const {
+    std::vector<keyed_row_t> sorted = rows;
+    std::sort_heap(sorted.begin(), sorted.end(), keyed_row_less_t());
+    std::vector<counted_t<const datum_t> > ret;
+    ret.reserve(sorted.size());
+    for (auto it = sorted.begin(); it != sorted.end(); ++it) {
+        ret.push_back(it->second);
+    }
+    return ret;
+}
+
+void top_k_rows_t::rdb_serialize(write_message_t &msg /* NOLINT */) const {
+    msg << k;
+    msg << rows;
+}
+
+archive_result_t top_k_rows_t::rdb_deserialize(read_stream_t *s) {
+    archive_result_t res = deserialize(s, &k);
+    if (res) return res;
+    // The rows were a heap when they went out, so they still are.
+    return deserialize(s, &rows);
+}
+
+// A random number in [0, n), for when `n` may not fit in randint()'s int.
+static uint64_t random_below(uint64_t n) {
+    if (n <= static_cast<uint64_t>(std::numeric_limits<int>::max())) {
+        return randint(n);
+    }
+    return std::min<uint64_t>(randdouble() * n, n - 1);
+}
+
+void sample_rows_t::add(const counted_t<const datum_t> &row) {
+    ++seen;
+    if (rows.size() < k) {
+        rows.push_back(row);
+    } else if (k != 0) {
+        uint64_t index = random_below(seen);
+        if (index < k) {
+            rows[index] = row;
+        }
+    }
+}
+
+void sample_rows_t::add(const sample_rows_t &other) {
+    // Both are uniform samples of their own rows, so every row of the merged
+    // sample comes from one side or the other in proportion to the rows left on
+    // that side, and is any of the ones that side has left.
+    std::vector<counted_t<const datum_t> > lhs, rhs = other.rows;
+    lhs.swap(rows);
+    uint64_t lhs_left = seen, rhs_left = other.seen;
+    while (rows.size() < k && (!lhs.empty() || !rhs.empty())) {
+        std::vector<counted_t<const datum_t> > *side;
+        if (rhs.empty() || (!lhs.empty() && random_below(lhs_left + rhs_left) < lhs_left)) {
+            side = &lhs;
+            --lhs_left;
+        } else {
+            side = &rhs;
+            --rhs_left;
+        }
+        size_t index = random_below(side->size());
+        rows.push_back((*side)[index]);
+        (*side)[index] = side->back();
+        side->pop_back();
+    }
+    seen += other.seen;
+}
+
+std::vector<counted_t<const datum_t> > sample_rows_t::shuffled_rows() const {
+    std::vector<counted_t<const datum_t> > ret = rows;
+    std::random_shuffle(ret.begin(), ret.end());
+    return ret;
+}
+
+void sample_rows_t::rdb_serialize(write_message_t &msg /* NOLINT */) const {
+    msg << k;
+    msg << seen;
+    msg << rows;
+}
+
+archive_result_t sample_rows_t::rdb_deserialize(read_stream_t *s) {
+    archive_result_t res = deserialize(s, &k);
+    if (res) return res;
+    res = deserialize(s, &seen);
+    if (res) return res;
+    return deserialize(s, &rows);
+}
+
 // `key` is unused because this is passed to `datum_t::merge`, which takes a
 // generic conflict resolution function, but this particular conflict resolution
 // function doesn't care about they key (although we could add some
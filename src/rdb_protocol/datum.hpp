@@ -48,8 +48,69 @@ enum clobber_bool_t { NOCLOBBER = 0, CLOBBER = 1};
 
 enum class use_json_t { NO = 0, YES = 1 };
 
+// How the values of a secondary index are written into its btree keys.  An index
+// keeps the format it was created with.  `LEGACY` prints values the way primary
+// keys are printed.  `BINARY` is a compact encoding of any datum whose keys compare
+// bytewise the way `datum_t::cmp` compares the values, so that long values are
+// truncated less often and the value of an entry can be read back from its key.
+// `HASH` keys are a fixed-size hash of the binary encoding, which is all an index
+// that is only read with `get_all` needs, so they don't keep the order of the
+// values.  New formats go at the end.
+enum class sindex_key_format_t { LEGACY = 0, BINARY = 1, HASH = 2 };
+ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(sindex_key_format_t, int8_t,
+                                      sindex_key_format_t::LEGACY,
+                                      sindex_key_format_t::HASH);
+
+class datum_t;
+
+// The fields of an object `datum_t`, sorted by key in one contiguous array.  That
+// costs one allocation for all the fields of a document instead of a tree node per
+// field, and looking a field up is a binary search over adjacent memory.  It can be
+// read like the `std::map` it replaces; it can only be changed through `set` and
+// `erase`, so that it stays sorted.
+class datum_object_t {
+public:
+    typedef std::string key_type;
+    typedef std::pair<std::string, counted_t<const datum_t> > value_type;
+    typedef std::vector<value_type>::const_iterator const_iterator;
+    typedef std::vector<value_type>::const_reverse_iterator const_reverse_iterator;
+    typedef const_iterator iterator;
+
+    datum_object_t() { }
+    explicit datum_object_t(std::map<std::string, counted_t<const datum_t> > &&map);
+
+    const_iterator begin() const { return fields_.begin(); }
+    const_iterator end() const { return fields_.end(); }
+    const_reverse_iterator rbegin() const { return fields_.rbegin(); }
+    const_reverse_iterator rend() const { return fields_.rend(); }
+    size_t size() const { return fields_.size(); }
+    bool empty() const { return fields_.empty(); }
+
+    const_iterator find(const std::string &key) const;
+    size_t count(const std::string &key) const { return find(key) == end() ? 0 : 1; }
+
+    // Returns true if `key` was there already, in which case its value is only
+    // replaced if `clobber_bool` is `CLOBBER`.  Appending keys in ascending order
+    // is cheap, inserting them in a random order is quadratic; use `assign` to
+    // build a big object out of unsorted fields.
+    MUST_USE bool set(const std::string &key, counted_t<const datum_t> val,
+                      clobber_bool_t clobber_bool);
+    // Returns true if `key` was there.
+    MUST_USE bool erase(const std::string &key);
+
+    // Replaces the contents with `fields`, which can be in any order.  Returns
+    // false, with one of the keys there twice in `*duplicate_out`, if the keys
+    // aren't unique.
+    MUST_USE bool assign(std::vector<value_type> &&fields, std::string *duplicate_out);
+
+private:
+    std::vector<value_type>::iterator lower_bound(const std::string &key);
+
+    std::vector<value_type> fields_;
+};
+
 // A `datum_t` is basically a JSON value, although we may extend it later.
-class datum_t : public slow_atomic_countable_t<datum_t> {
+class datum_t : public biased_countable_t<datum_t> {
 public:
     // This ordering is important, because we use it to sort objects of
     // disparate type.  It should be alphabetical.
@@ -70,6 +131,7 @@ public:
     explicit datum_t(const char *cstr);
     explicit datum_t(std::vector<counted_t<const datum_t> > &&_array);
     explicit datum_t(std::map<std::string, counted_t<const datum_t> > &&object);
+    explicit datum_t(datum_object_t &&object);
 
     // These construct a datum from an equivalent representation.
     datum_t();
@@ -80,6 +142,12 @@ public:
 
     ~datum_t();
 
+    // Queries create and drop datums by the million, so the memory of freed ones
+    // goes on a per-thread free list (see DATUM_FREE_LIST_SIZE) to be reused by
+    // the next ones, without a trip through malloc.
+    static void *operator new(size_t size);
+    static void operator delete(void *p, size_t size);
+
     void write_to_protobuf(Datum *out, use_json_t use_json) const;
 
     type_t get_type() const;
@@ -93,20 +161,28 @@ public:
     std::string print_primary() const;
     static std::string mangle_secondary(const std::string &secondary,
             const std::string &primary, const std::string &tag);
-    std::string print_secondary(const store_key_t &key,
+    std::string print_secondary(sindex_key_format_t format, const store_key_t &key,
             boost::optional<uint64_t> tag_num = boost::optional<uint64_t>()) const;
     /* An inverse to print_secondary. Returns the primary key. */
     static std::string extract_primary(const std::string &secondary_and_primary);
     static std::string extract_secondary(const std::string &secondary_and_primary);
     static boost::optional<uint64_t> extract_tag(
         const std::string &secondary_and_primary);
-    store_key_t truncated_secondary() const;
+    store_key_t truncated_secondary(sindex_key_format_t format) const;
+    /* Reads the value back out of the secondary part of a `BINARY` key.  Returns
+     * an empty pointer if the key was truncated, or holds a pseudotype (whose
+     * key leaves out the parts `cmp` ignores, like the timezone of a time). */
+    static counted_t<const datum_t> from_binary_secondary(const std::string &secondary);
     void check_type(type_t desired, const char *msg = NULL) const;
     void type_error(const std::string &msg) const NORETURN;
 
     bool as_bool() const;
     double as_num() const;
     int64_t as_int() const;
+    // Returns true, with the number in `*i_out`, if the datum is a number that's an
+    // integer of at most 2^53 in magnitude (see number_as_integer()).  The datum
+    // knew that since it was made, so this doesn't check again.
+    bool num_as_int(int64_t *i_out) const;
     const std::string &as_str() const;
 
     // Use of `size` and `get` is preferred to `as_array` when possible.
@@ -115,7 +191,7 @@ public:
     // Access an element of an array.
     counted_t<const datum_t> get(size_t index, throw_bool_t throw_bool = THROW) const;
     // Use of `get` is preferred to `as_object` when possible.
-    const std::map<std::string, counted_t<const datum_t> > &as_object() const;
+    const datum_object_t &as_object() const;
 
     // Access an element of an object.
     counted_t<const datum_t> get(const std::string &key,
@@ -129,6 +205,9 @@ public:
 
     cJSON *as_json_raw() const;
     scoped_cJSON_t as_json() const;
+    // Appends the same text as `as_json().PrintUnformatted()` to `*out`, without
+    // building the cJSON tree first.
+    void write_json(std::string *out) const;
     counted_t<datum_stream_t> as_datum_stream(
             const protob_t<const Backtrace> &backtrace) const;
 
@@ -166,6 +245,7 @@ public:
 private:
     friend class datum_ptr_t;
     friend void pseudo::sanitize_time(datum_t *time);
+    friend class json_datum_parser_t;
     void add(counted_t<const datum_t> val); // add to an array
     // change an element of an array
     void change(size_t index, counted_t<const datum_t> val);
@@ -179,6 +259,7 @@ private:
     MUST_USE bool delete_field(const std::string &key);
 
     void init_empty();
+    void init_num(double num);
     void init_str();
     void init_array();
     void init_object();
@@ -192,21 +273,37 @@ private:
     void str_to_str_key(std::string *str_out) const;
     void bool_to_str_key(std::string *str_out) const;
     void array_to_str_key(std::string *str_out) const;
+    void to_binary_key(std::string *str_out) const;
+    void to_hash_key(std::string *str_out) const;
+    void check_secondary_value() const;
 
     int pseudo_cmp(const datum_t &rhs) const;
     static const std::set<std::string> _allowed_pts;
     void maybe_sanitize_ptype(const std::set<std::string> &allowed_pts = _allowed_pts);
 
     type_t type;
+    // For R_NUM, whether `r_num` is an integer that number_as_integer() accepts,
+    // which nearly every number is.  It fits in the padding after `type`.
+    bool num_is_int;
     union {
         bool r_bool;
         double r_num;
         // TODO: Make this a char vector
         std::string *r_str;
         std::vector<counted_t<const datum_t> > *r_array;
-        std::map<std::string, counted_t<const datum_t> > *r_object;
+        datum_object_t *r_object;
     };
 
+    // What `serialized_size()` returned for this datum, or 0 before it has been
+    // asked, so that batching, response size estimates and the serialization of
+    // large documents each don't walk the whole tree again.  Every datum takes at
+    // least one byte.  The mutators reset it; they only run while a datum is
+    // still being built.  Threads that share a datum may both fill it in, with the
+    // same value.
+    friend size_t serialized_size(const counted_t<const datum_t> &datum);
+    size_t compute_serialized_size() const;
+    mutable size_t serialized_size_cache;
+
 public:
     static const char* const reql_type_string;
 
@@ -219,6 +316,14 @@ size_t serialized_size(const counted_t<const datum_t> &datum);
 write_message_t &operator<<(write_message_t &wm, const counted_t<const datum_t> &datum);
 archive_result_t deserialize(read_stream_t *s, counted_t<const datum_t> *datum);
 
+// Like deserialize(), but if the datum is an object, only builds its top-level
+// fields that are in `fields` (which must be sorted) and reads past the others.  Sets
+// `*datum` to an empty pointer if the object is a pseudotype, those are all or
+// nothing.
+archive_result_t deserialize_fields(read_stream_t *s,
+                                    const std::vector<std::string> &fields,
+                                    counted_t<const datum_t> *datum);
+
 write_message_t &operator<<(write_message_t &wm, const empty_ok_t<const counted_t<const datum_t> > &datum);
 archive_result_t deserialize(read_stream_t *s, empty_ok_ref_t<counted_t<const datum_t> > datum);
 
@@ -317,6 +422,71 @@ private:
     enum { SERIALIZABLE, COMPILED } state;
 };
 
+// Appends an encoding of `d` to `out`, such that the encodings of two datums
+// compare bytewise (as unsigned chars, like std::string::compare or memcmp) the way
+// the datums compare with datum_t::cmp.  No encoding is a prefix of another one, so
+// they can be concatenated into keys of several values and still compare
+// correctly, and inverting all the bytes of one reverses its order.
+void append_sort_key(const datum_t &d, std::string *out);
+
+// A row along with the key it sorts by, see append_sort_key().
+typedef std::pair<std::string, counted_t<const datum_t> > keyed_row_t;
+
+// Sorts `rows` by their keys.
+void sort_keyed_rows(std::vector<keyed_row_t> *rows);
+
+// The `k` rows with the least keys out of the ones added, for the top-k terminal
+// of `orderby(...).limit(k)`, see top_k_wire_func_t.  Shards keep their own and the
+// parser merges them, so only `k` rows per shard come over the wire.
+class top_k_rows_t {
+public:
+    top_k_rows_t() : k(0) { }
+    explicit top_k_rows_t(uint64_t _k) : k(_k) { }
+
+    void add(std::string &&key, const counted_t<const datum_t> &row);
+    void add(const top_k_rows_t &other);
+
+    // The rows in order of their keys.
+    std::vector<counted_t<const datum_t> > sorted_rows() const;
+
+    friend class write_message_t;
+    void rdb_serialize(write_message_t &msg /* NOLINT */) const;
+    friend class archive_deserializer_t;
+    archive_result_t rdb_deserialize(read_stream_t *s);
+
+private:
+    uint64_t k;
+    // A heap with the greatest key on top, which is the one to go when a lesser
+    // one comes in.
+    std::vector<keyed_row_t> rows;
+};
+
+// A uniform sample of `k` of the rows added, for `sample`, see sample_wire_func_t.
+// Shards keep a reservoir of their own rows, and the parser merges the reservoirs
+// by how many rows each one saw, so only `k` rows per shard come over the wire.
+class sample_rows_t {
+public:
+    sample_rows_t() : k(0), seen(0) { }
+    explicit sample_rows_t(uint64_t _k) : k(_k), seen(0) { }
+
+    void add(const counted_t<const datum_t> &row);
+    void add(const sample_rows_t &other);
+
+    // The rows, in random order.
+    std::vector<counted_t<const datum_t> > shuffled_rows() const;
+
+    friend class write_message_t;
+    void rdb_serialize(write_message_t &msg /* NOLINT */) const;
+    friend class archive_deserializer_t;
+    archive_result_t rdb_deserialize(read_stream_t *s);
+
+private:
+    uint64_t k;
+    // How many rows were added, of which `rows` has min(k, seen).
+    uint64_t seen;
+    std::vector<counted_t<const datum_t> > rows;
+};
+
 
 // This function is used by e.g. foreach to merge statistics from multiple write
 // operations.
@@ -0,0 +1,313 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "rdb_protocol/datum_json.hpp"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <utility>
+#include <vector>
+
+#include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/error.hpp"
+
+namespace ql {
+
+namespace {
+
+const uint64_t ones = 0x0101010101010101ULL;
+const uint64_t highs = 0x8080808080808080ULL;
+
+// Nonzero iff one of the bytes of `word` is zero.
+inline uint64_t has_zero_byte(uint64_t word) {
+    return (word - ones) & ~word & highs;
+}
+
+// Nonzero iff one of the bytes of `word` ends an unescaped run of a string: a
+// quote, a backslash or the NUL that ends the text.
+inline uint64_t has_special_byte(uint64_t word) {
+    return has_zero_byte(word)
+        | has_zero_byte(word ^ (ones * '"'))
+        | has_zero_byte(word ^ (ones * '\\'));
+}
+
+}  // namespace
+
+// This follows cJSON's parse_value() and friends step by step, so that we accept
+// the same texts, but it puts the values in datums as it goes.
+class json_datum_parser_t {
+public:
+    explicit json_datum_parser_t(const std::string &json)
+        : p(json.c_str()), end(json.c_str() + json.size()) { }
+
+    bool parse(datum_t *out) {
+        r_sanity_check(out->type == datum_t::UNINITIALIZED);
+        skip();
+        return parse_value(out);
+    }
+
+private:
+    void skip() {
+        while (*p != '\0' && static_cast<unsigned char>(*p) <= 32) {
+            ++p;
+        }
+    }
+
+    bool parse_value(datum_t *out) {
+        if (strncmp(p, "null", 4) == 0) {
+            out->type = datum_t::R_NULL;
+            p += 4;
+            return true;
+        } else if (strncmp(p, "false", 5) == 0) {
+            out->type = datum_t::R_BOOL;
+            out->r_bool = false;
+            p += 5;
+            return true;
+        } else if (strncmp(p, "true", 4) == 0) {
+            out->type = datum_t::R_BOOL;
+            out->r_bool = true;
+            p += 4;
+            return true;
+        } else if (*p == '"') {
+            out->init_str();
+            parse_string(out->r_str);
+            return true;
+        } else if (*p == '-' || (*p >= '0' && *p <= '9')) {
+            return parse_number(out);
+        } else if (*p == '[') {
+            return parse_array(out);
+        } else if (*p == '{') {
+            return parse_object(out);
+        } else {
+            return false;
+        }
+    }
+
+    bool parse_number(datum_t *out) {
+        double n;
+        // Like cJSON, a hexadecimal number is a zero followed by trailing garbage.
+        if (p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) {
+            n = 0;
+            p += 1;
+        } else {
+            char *num_end;
+            n = strtod(p, &num_end);
+            if (num_end == p) {
+                return false;
+            }
+            p = num_end;
+        }
+        // so we can use `isfinite` in a GCC 4.4.3-compatible way
+        using namespace std;  // NOLINT(build/namespaces)
+        rcheck_datum(isfinite(n), base_exc_t::GENERIC,
+                     strprintf("Non-finite value `%lf` in JSON.", n));
+        out->init_num(n);
+        return true;
+    }
+
+    // Reads up to four hex digits, as `sscanf("%4x")` does for cJSON, but never
+    // past the end of the text.
+    unsigned parse_hex4() {
+        unsigned value = 0;
+        for (int i = 0; i < 4 && *p != '\0'; ++i, ++p) {
+            const char c = *p;
+            if (c >= '0' && c <= '9') {
+                value = value * 16 + (c - '0');
+            } else if (c >= 'a' && c <= 'f') {
+                value = value * 16 + (c - 'a' + 10);
+            } else if (c >= 'A' && c <= 'F') {
+                value = value * 16 + (c - 'A' + 10);
+            } else {
+                // Skip the rest of the four characters regardless, like cJSON.
+                while (i < 4 && *p != '\0') {
+                    ++i;
+                    ++p;
+                }
+                return value;
+            }
+        }
+        return value;
+    }
+
+    void append_utf8(unsigned uc, std::string *out) {
+        if (uc < 0x80) {
+            out->push_back(uc);
+        } else if (uc < 0x800) {
+            out->push_back(0xC0 | (uc >> 6));
+            out->push_back(0x80 | (uc & 0x3F));
+        } else if (uc < 0x10000) {
+            out->push_back(0xE0 | (uc >> 12));
+            out->push_back(0x80 | ((uc >> 6) & 0x3F));
+            out->push_back(0x80 | (uc & 0x3F));
+        } else {
+            out->push_back(0xF0 | (uc >> 18));
+            out->push_back(0x80 | ((uc >> 12) & 0x3F));
+            out->push_back(0x80 | ((uc >> 6) & 0x3F));
+            out->push_back(0x80 | (uc & 0x3F));
+        }
+    }
+
+    // `*p` is the opening quote.  An unterminated string runs to the end of the
+    // text, like in cJSON.
+    void parse_string(std::string *out) {
+        ++p;
+        for (;;) {
+            // Most of a string is plain characters; find where they stop eight
+            // bytes at a time and copy them all at once.
+            const char *run = p;
+            while (end - p >= 8) {
+                uint64_t word;
+                memcpy(&word, p, sizeof(word));
+                if (has_special_byte(word) != 0) {
+                    break;
+                }
+                p += 8;
+            }
+            while (*p != '"' && *p != '\\' && *p != '\0') {
+                ++p;
+            }
+            out->append(run, p - run);
+
+            if (*p == '"') {
+                ++p;
+                return;
+            } else if (*p == '\0') {
+                return;
+            }
+
+            // A backslash.
+            ++p;
+            const char c = *p;
+            if (c == '\0') {
+                return;
+            }
+            ++p;
+            switch (c) {
+            case 'b': out->push_back('\b'); break;
+            case 'f': out->push_back('\f'); break;
+            case 'n': out->push_back('\n'); break;
+            case 'r': out->push_back('\r'); break;
+            case 't': out->push_back('\t'); break;
+            case 'u': {
+                unsigned uc = parse_hex4();
+                // cJSON drops invalid code points and NULs.
+                if ((uc >= 0xDC00 && uc <= 0xDFFF) || uc == 0) {
+                    break;
+                }
+                if (uc >= 0xD800 && uc <= 0xDBFF) {
+                    // A surrogate pair, unless the second half is missing.
+                    if (p[0] != '\\' || p[1] != 'u') {
+                        break;
+                    }
+                    p += 2;
+                    const unsigned uc2 = parse_hex4();
+                    if (uc2 < 0xDC00 || uc2 > 0xDFFF) {
+                        break;
+                    }
+                    uc = 0x10000 | ((uc & 0x3FF) << 10) | (uc2 & 0x3FF);
+                }
+                append_utf8(uc, out);
+            } break;
+            default: out->push_back(c); break;
+            }
+        }
+    }
+
+    bool parse_array(datum_t *out) {
+        out->init_array();
+        ++p;
+        skip();
+        if (*p == ']') {
+            ++p;
+            return true;
+        }
+        for (;;) {
+            skip();
+            counted_t<datum_t> item = make_counted<datum_t>();
+            if (!parse_value(item.get())) {
+                return false;
+            }
+            out->add(std::move(item));
+            skip();
+            if (*p != ',') {
+                break;
+            }
+            ++p;
+        }
+        if (*p != ']') {
+            return false;
+        }
+        ++p;
+        return true;
+    }
+
+    bool parse_object(datum_t *out) {
+        out->init_object();
+        ++p;
+        skip();
+        if (*p == '}') {
+            ++p;
+            return true;
+        }
+        std::vector<datum_object_t::value_type> fields;
+        for (;;) {
+            skip();
+            if (*p != '"') {
+                return false;
+            }
+            std::string key;
+            parse_string(&key);
+            skip();
+            if (*p != ':') {
+                return false;
+            }
+            ++p;
+            skip();
+            counted_t<datum_t> item = make_counted<datum_t>();
+            if (!parse_value(item.get())) {
+                return false;
+            }
+            fields.push_back(std::make_pair(std::move(key), counted_t<const datum_t>(std::move(item))));
+            skip();
+            if (*p != ',') {
+                break;
+            }
+            ++p;
+        }
+        if (*p != '}') {
+            return false;
+        }
+        ++p;
+
+        // The text ends at its first NUL byte and `\u0000` is dropped, so unlike
+        // `init_json()` we needn't `check_str_validity()` the keys or strings.
+        std::string duplicate;
+        rcheck_datum(out->r_object->assign(std::move(fields), &duplicate),
+                     base_exc_t::GENERIC,
+                     strprintf("Duplicate key `%s` in JSON.", duplicate.c_str()));
+        out->maybe_sanitize_ptype();
+        return true;
+    }
+
+    const char *p;
+    // The terminating NUL of the text.  `*p` never goes past it.
+    const char *const end;
+
+    DISABLE_COPYING(json_datum_parser_t);
+};
+
+bool parse_json_datum_into(const std::string &json, datum_t *out) {
+    json_datum_parser_t parser(json);
+    return parser.parse(out);
+}
+
+counted_t<const datum_t> parse_json_datum(const std::string &json) {
+    counted_t<datum_t> datum = make_counted<datum_t>();
+    if (!parse_json_datum_into(json, datum.get())) {
+        return counted_t<const datum_t>();
+    }
+    return datum;
+}
+
+}  // namespace ql
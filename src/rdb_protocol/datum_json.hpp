@@ -0,0 +1,27 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_DATUM_JSON_HPP_
+#define RDB_PROTOCOL_DATUM_JSON_HPP_
+
+#include <string>
+
+#include "containers/counted.hpp"
+
+namespace ql {
+
+class datum_t;
+
+// Parses `json` straight into a datum, in one pass and without building a
+// `cJSON` tree first.  It accepts what `cJSON_Parse()` followed by
+// `datum_t(cJSON *)` would, including cJSON's leniencies (trailing text is
+// ignored, and the text ends at the first NUL byte).  Returns an empty pointer if
+// `json` isn't JSON, and throws like `datum_t(cJSON *)` if it's JSON that isn't a
+// valid datum (say, with duplicate keys).
+counted_t<const datum_t> parse_json_datum(const std::string &json);
+
+// Like `parse_json_datum()`, into `out`, which must have been constructed with
+// `datum_t()`.  Returns false if `json` isn't JSON.
+bool parse_json_datum_into(const std::string &json, datum_t *out);
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_DATUM_JSON_HPP_
@@ -1,10 +1,13 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "rdb_protocol/datum_stream.hpp"
 
+#include <exception>
 #include <map>
 
 #include "clustering/administration/metadata.hpp"
+#include "concurrency/pmap.hpp"
 #include "rdb_protocol/batching.hpp"
+#include "rdb_protocol/changefeed.hpp"
 #include "rdb_protocol/env.hpp"
 #include "rdb_protocol/func.hpp"
 #include "rdb_protocol/term.hpp"
@@ -139,8 +142,10 @@ rget_read_response_t reader_t::do_read(env_t *env, const read_t &read) {
     return std::move(*rget_res);
 }
 
-std::vector<rget_item_t> reader_t::do_range_read(env_t *env, const read_t &read) {
+std::vector<rget_item_t> reader_t::do_range_read(env_t *env, const read_t &read,
+                                                 sindex_key_format_t *key_format_out) {
     rget_read_response_t res = do_read(env, read);
+    *key_format_out = res.key_format;
 
     // It's called `do_range_read`.  If we have more than one type of range
     // read (which we might; rget_read_t should arguably be two types), this
@@ -173,16 +178,22 @@ bool reader_t::load_items(env_t *env, const batchspec_t &batchspec) {
     started = true;
     if (items_index >= items.size() && !finished) { // read some more
         items_index = 0;
+        sindex_key_format_t key_format;
         items = do_range_read(
-            env, readgen->next_read(active_range, transform, batchspec));
+            env, readgen->next_read(active_range, transform, batchspec), &key_format);
         // Everything below this point can handle `items` being empty (this is
         // good hygiene anyway).
         while (boost::optional<read_t> read
                = readgen->sindex_sort_read(active_range, items, transform, batchspec)) {
-            std::vector<rget_item_t> new_items = do_range_read(env, *read);
+            sindex_key_format_t new_key_format;
+            std::vector<rget_item_t> new_items
+                = do_range_read(env, *read, &new_key_format);
             if (new_items.size() == 0) {
                 break;
             }
+            if (new_key_format != key_format) {
+                key_format = sindex_key_format_t::LEGACY;
+            }
 
             rcheck_datum(
                 (items.size() + new_items.size()) <= array_size_limit(),
@@ -199,7 +210,7 @@ bool reader_t::load_items(env_t *env, const batchspec_t &batchspec) {
             items.reserve(items.size() + new_items.size());
             std::move(new_items.begin(), new_items.end(), std::back_inserter(items));
         }
-        readgen->sindex_sort(&items);
+        readgen->sindex_sort(&items, key_format);
     }
     if (items_index >= items.size()) {
         finished = true;
@@ -283,6 +294,36 @@ reader_t::next_batch(env_t *env, const batchspec_t &batchspec) {
 
 bool reader_t::is_finished() const { return finished; }
 
+bool reader_t::unread_primary_range(key_range_t *range_out,
+                                    transform_t *transform_out) const {
+    // The order doesn't matter to the writes, only the index does.
+    if (started || !readgen->sindex_name().empty()) {
+        return false;
+    }
+    for (auto it = transform.begin(); it != transform.end(); ++it) {
+        const filter_transform_t *filter = boost::get<filter_transform_t>(&*it);
+        if (filter == NULL
+            || !filter->filter_func.compile_wire_func()->is_deterministic()
+            || (filter->default_filter_val
+                && !filter->default_filter_val->compile_wire_func()->is_deterministic())) {
+            return false;
+        }
+    }
+    *range_out = active_range;
+    *transform_out = transform;
+    return true;
+}
+
+bool reader_t::unread_sindex_range(std::string *sindex_out,
+                                   datum_range_t *range_out) const {
+    if (started || readgen->sindex_name().empty() || !transform.empty()) {
+        return false;
+    }
+    *sindex_out = readgen->sindex_name();
+    *range_out = readgen->get_original_datum_range();
+    return true;
+}
+
 readgen_t::readgen_t(
     const std::map<std::string, wire_func_t> &_global_optargs,
     const datum_range_t &_original_datum_range,
@@ -340,14 +381,17 @@ primary_readgen_t::primary_readgen_t(
     const std::map<std::string, wire_func_t> &global_optargs,
     datum_range_t range,
     profile_bool_t profile,
-    sorting_t sorting)
-    : readgen_t(global_optargs, range, profile, sorting) { }
+    sorting_t sorting,
+    const key_range_t &_shard_range)
+    : readgen_t(global_optargs, range, profile, sorting),
+      shard_range(_shard_range) { }
 scoped_ptr_t<readgen_t> primary_readgen_t::make(
-    env_t *env, datum_range_t range, sorting_t sorting) {
+    env_t *env, datum_range_t range, sorting_t sorting,
+    const key_range_t &shard_range) {
     return scoped_ptr_t<readgen_t>(
         new primary_readgen_t(
             env->global_optargs.get_all_optargs(),
-            range, env->profile(), sorting));
+            range, env->profile(), sorting, shard_range));
 }
 
 rget_read_t primary_readgen_t::next_read_impl(
@@ -372,12 +416,13 @@ boost::optional<read_t> primary_readgen_t::sindex_sort_read(
     UNUSED const batchspec_t &batchspec) const {
     return boost::optional<read_t>();
 }
-void primary_readgen_t::sindex_sort(UNUSED std::vector<rget_item_t> *vec) const {
+void primary_readgen_t::sindex_sort(UNUSED std::vector<rget_item_t> *vec,
+                                    UNUSED sindex_key_format_t key_format) const {
     return;
 }
 
 key_range_t primary_readgen_t::original_keyrange() const {
-    return original_datum_range.to_primary_keyrange();
+    return original_datum_range.to_primary_keyrange().intersection(shard_range);
 }
 
 std::string primary_readgen_t::sindex_name() const {
@@ -413,12 +458,45 @@ private:
     sorting_t sorting;
 };
 
-void sindex_readgen_t::sindex_sort(std::vector<rget_item_t> *vec) const {
+// The first `datum_t::max_trunc_size()` bytes of the index value of an item, if
+// its key may not hold all of it.
+bool truncation_prefix(const rget_item_t &item, std::string *prefix_out) {
+    std::string skey = datum_t::extract_secondary(key_to_unescaped_str(item.key));
+    if (skey.size() < datum_t::max_trunc_size()) {
+        return false;
+    }
+    prefix_out->assign(skey, 0, datum_t::max_trunc_size());
+    return true;
+}
+
+void sindex_readgen_t::sindex_sort(std::vector<rget_item_t> *vec,
+                                   sindex_key_format_t key_format) const {
     if (vec->size() == 0) {
         return;
     }
-    if (sorting != sorting_t::UNORDERED) {
+    if (sorting == sorting_t::UNORDERED) {
+        return;
+    }
+    if (key_format != sindex_key_format_t::BINARY) {
         std::sort(vec->begin(), vec->end(), sindex_compare_t(sorting));
+        return;
+    }
+    // The shards merged the items by key, which for binary keys is the order of
+    // the index values.  That only leaves the items whose keys were truncated to
+    // the same bytes, or about as long, which are next to each other.
+    for (auto begin = vec->begin(); begin != vec->end();) {
+        auto end = begin + 1;
+        std::string prefix;
+        if (truncation_prefix(*begin, &prefix)) {
+            std::string next_prefix;
+            while (end != vec->end()
+                   && truncation_prefix(*end, &next_prefix)
+                   && next_prefix == prefix) {
+                ++end;
+            }
+            std::sort(begin, end, sindex_compare_t(sorting));
+        }
+        begin = end;
     }
 }
 
@@ -479,7 +557,13 @@ boost::optional<read_t> sindex_readgen_t::sindex_sort_read(
 }
 
 key_range_t sindex_readgen_t::original_keyrange() const {
-    return original_datum_range.to_sindex_keyrange();
+    // Which keys hold the range depends on the format of the index, which only
+    // the shards know.  They narrow the keys down to `original_datum_range`, and
+    // the keys they send back are in the format of the index.  Bounds that can't
+    // be index values at all still fail here, where the query is.
+    UNUSED key_range_t keys
+        = original_datum_range.to_sindex_keyrange(sindex_key_format_t::BINARY);
+    return key_range_t::universe();
 }
 
 std::string sindex_readgen_t::sindex_name() const {
@@ -487,6 +571,39 @@ std::string sindex_readgen_t::sindex_name() const {
 }
 
 // DATUM_STREAM_T
+counted_t<datum_stream_t> datum_stream_t::project(
+    counted_t<func_t> f, UNUSED const projection_transform_t &projection) {
+    return map(f);
+}
+
+std::vector<counted_t<const datum_t> >
+datum_stream_t::top_k(env_t *env, const order_funcs_t &funcs, size_t k) {
+    top_k_rows_t rows(k);
+    batchspec_t batchspec = batchspec_t::user(batch_type_t::TERMINAL, env);
+    {
+        profile::sampler_t sampler("Keeping the first rows in order.", env->trace);
+        while (counted_t<const datum_t> d = next(env, batchspec)) {
+            rows.add(order_key(env, funcs, d), d);
+            sampler.new_sample();
+        }
+    }
+    return rows.sorted_rows();
+}
+
+std::vector<counted_t<const datum_t> >
+datum_stream_t::sample(env_t *env, size_t k) {
+    sample_rows_t rows(k);
+    batchspec_t batchspec = batchspec_t::user(batch_type_t::TERMINAL, env);
+    {
+        profile::sampler_t sampler("Sampling elements.", env->trace);
+        while (counted_t<const datum_t> d = next(env, batchspec)) {
+            rows.add(d);
+            sampler.new_sample();
+        }
+    }
+    return rows.shuffled_rows();
+}
+
 counted_t<datum_stream_t> datum_stream_t::slice(size_t l, size_t r) {
     return make_counted<slice_datum_stream_t>(l, r, this->counted_from_this());
 }
@@ -505,10 +622,15 @@ std::vector<counted_t<const datum_t> >
 datum_stream_t::next_batch(env_t *env, const batchspec_t &batchspec) {
     DEBUG_ONLY_CODE(env->do_eval_callback());
     env->throw_if_interruptor_pulsed();
+    env->check_resources();
     // Cannot mix `next` and `next_batch`.
     r_sanity_check(batch_cache_index == 0 && batch_cache.size() == 0);
     try {
-        return next_batch_impl(env, batchspec);
+        std::vector<counted_t<const datum_t> > batch = next_batch_impl(env, batchspec);
+        if (env->resources.has()) {
+            env->resources->add_datums(batch);
+        }
+        return batch;
     } catch (const datum_exc_t &e) {
         rfail(e.get_type(), "%s", e.what());
         unreachable();
@@ -597,6 +719,34 @@ counted_t<const datum_t> eager_datum_stream_t::gmr(env_t *env,
     return wd_map.to_arr();
 }
 
+void eager_datum_stream_t::groupby(env_t *env, const groupby_wire_func_t &f,
+                                   group_accumulators_t *accumulators) {
+    batchspec_t batchspec = batchspec_t::user(batch_type_t::TERMINAL, env);
+    profile::sampler_t sampler("Grouping and aggregating eagerly.", env->trace);
+    while (counted_t<const datum_t> el = next(env, batchspec)) {
+        f.add_row(env, el, accumulators);
+        sampler.new_sample();
+    }
+}
+
+void eager_datum_stream_t::sketch_distinct(env_t *env, distinct_sketch_t *sketch) {
+    batchspec_t batchspec = batchspec_t::user(batch_type_t::TERMINAL, env);
+    profile::sampler_t sampler("Sketching distinct rows eagerly.", env->trace);
+    while (counted_t<const datum_t> el = next(env, batchspec)) {
+        sketch->add(*el);
+        sampler.new_sample();
+    }
+}
+
+void eager_datum_stream_t::sketch_quantiles(env_t *env, quantile_sketch_t *sketch) {
+    batchspec_t batchspec = batchspec_t::user(batch_type_t::TERMINAL, env);
+    profile::sampler_t sampler("Sketching quantiles eagerly.", env->trace);
+    while (counted_t<const datum_t> el = next(env, batchspec)) {
+        sketch->add(el->as_num());
+        sampler.new_sample();
+    }
+}
+
 counted_t<datum_stream_t> eager_datum_stream_t::filter(
     counted_t<func_t> f,
     counted_t<func_t> default_filter_val) {
@@ -643,6 +793,12 @@ counted_t<datum_stream_t> lazy_datum_stream_t::concatmap(counted_t<func_t> f) {
     return counted_from_this();
 }
 
+counted_t<datum_stream_t> lazy_datum_stream_t::project(
+    UNUSED counted_t<func_t> f, const projection_transform_t &projection) {
+    reader.add_transformation(projection_transform_t(projection));
+    return counted_from_this();
+}
+
 counted_t<datum_stream_t> lazy_datum_stream_t::filter(
     counted_t<func_t> f, counted_t<func_t> default_filter_val) {
     reader.add_transformation(
@@ -710,17 +866,72 @@ counted_t<const datum_t> lazy_datum_stream_t::gmr(
     }
 }
 
+void lazy_datum_stream_t::groupby(env_t *env, const groupby_wire_func_t &f,
+                                  group_accumulators_t *accumulators) {
+    rget_read_response_t::result_t res = reader.run_terminal(env, groupby_wire_func_t(f));
+    group_accumulators_t *acc = boost::get<group_accumulators_t>(&res);
+    r_sanity_check(acc);
+    accumulators->add(*acc);
+}
+
+void lazy_datum_stream_t::sketch_distinct(env_t *env, distinct_sketch_t *sketch) {
+    rget_read_response_t::result_t res
+        = reader.run_terminal(env, count_distinct_wire_func_t());
+    distinct_sketch_t *shards_sketch = boost::get<distinct_sketch_t>(&res);
+    r_sanity_check(shards_sketch);
+    sketch->add(*shards_sketch);
+}
+
+void lazy_datum_stream_t::sketch_quantiles(env_t *env, quantile_sketch_t *sketch) {
+    rget_read_response_t::result_t res = reader.run_terminal(env, quantile_wire_func_t());
+    quantile_sketch_t *shards_sketch = boost::get<quantile_sketch_t>(&res);
+    r_sanity_check(shards_sketch);
+    sketch->add(*shards_sketch);
+}
+
+std::vector<counted_t<const datum_t> >
+lazy_datum_stream_t::top_k(env_t *env, const order_funcs_t &funcs, size_t k) {
+    rget_read_response_t::result_t res
+        = reader.run_terminal(env, top_k_wire_func_t(funcs, k));
+    top_k_rows_t *rows = boost::get<top_k_rows_t>(&res);
+    r_sanity_check(rows);
+    return rows->sorted_rows();
+}
+
+std::vector<counted_t<const datum_t> >
+lazy_datum_stream_t::sample(env_t *env, size_t k) {
+    rget_read_response_t::result_t res
+        = reader.run_terminal(env, sample_wire_func_t(k));
+    sample_rows_t *rows = boost::get<sample_rows_t>(&res);
+    r_sanity_check(rows);
+    return rows->shuffled_rows();
+}
+
 std::vector<counted_t<const datum_t> >
 lazy_datum_stream_t::next_batch_impl(env_t *env, const batchspec_t &batchspec) {
     // Should never mix `next` with `next_batch`.
     r_sanity_check(current_batch_offset == 0 && current_batch.size() == 0);
-    return reader.next_batch(env, batchspec);
+    std::vector<counted_t<const datum_t> > batch = reader.next_batch(env, batchspec);
+    if (env->resources.has()) {
+        env->resources->add_rows(batch.size());
+    }
+    return batch;
 }
 
 bool lazy_datum_stream_t::is_exhausted() const {
     return reader.is_finished();
 }
 
+bool lazy_datum_stream_t::unread_primary_range(key_range_t *range_out,
+                                               transform_t *transform_out) const {
+    return current_batch.empty() && reader.unread_primary_range(range_out, transform_out);
+}
+
+bool lazy_datum_stream_t::unread_sindex_range(std::string *sindex_out,
+                                              datum_range_t *range_out) const {
+    return current_batch.empty() && reader.unread_sindex_range(sindex_out, range_out);
+}
+
 // ARRAY_DATUM_STREAM_T
 array_datum_stream_t::array_datum_stream_t(counted_t<const datum_t> _arr,
                                            const protob_t<const Backtrace> &bt_source)
@@ -756,14 +967,62 @@ bool array_datum_stream_t::is_array() {
     return true;
 }
 
+// CHANGEFEED_DATUM_STREAM_T
+changefeed_datum_stream_t::changefeed_datum_stream_t(
+    scoped_ptr_t<changefeed::feed_t> &&_feed, const protob_t<const Backtrace> &bt_src)
+    : eager_datum_stream_t(bt_src), feed(std::move(_feed)) { }
+
+std::vector<counted_t<const datum_t> >
+changefeed_datum_stream_t::next_batch_impl(env_t *env, const batchspec_t &batchspec) {
+    profile::sampler_t sampler("Waiting for changes.", env->trace);
+    return feed->get_changes(batchspec, env->interruptor);
+}
+
+void changefeed_datum_stream_t::fail_infinite(const char *what) {
+    rfail(base_exc_t::GENERIC, "Cannot %s an infinite stream (of changes).", what);
+}
+
+counted_t<const datum_t> changefeed_datum_stream_t::count(UNUSED env_t *env) {
+    fail_infinite("count");
+}
+
+counted_t<const datum_t> changefeed_datum_stream_t::reduce(
+    UNUSED env_t *env, UNUSED counted_t<val_t> base_val, UNUSED counted_t<func_t> f) {
+    fail_infinite("reduce");
+}
+
+counted_t<const datum_t> changefeed_datum_stream_t::gmr(
+    UNUSED env_t *env, UNUSED counted_t<func_t> g, UNUSED counted_t<func_t> m,
+    UNUSED counted_t<const datum_t> d, UNUSED counted_t<func_t> r) {
+    fail_infinite("group");
+}
+
+void changefeed_datum_stream_t::groupby(
+    UNUSED env_t *env, UNUSED const groupby_wire_func_t &f,
+    UNUSED group_accumulators_t *accumulators) {
+    fail_infinite("group");
+}
+
+void changefeed_datum_stream_t::sketch_distinct(
+    UNUSED env_t *env, UNUSED distinct_sketch_t *sketch) {
+    fail_infinite("count the distinct elements of");
+}
+
+void changefeed_datum_stream_t::sketch_quantiles(
+    UNUSED env_t *env, UNUSED quantile_sketch_t *sketch) {
+    fail_infinite("take the quantiles of");
+}
+
+std::vector<counted_t<const datum_t> > changefeed_datum_stream_t::sample(
+    UNUSED env_t *env, UNUSED size_t k) {
+    fail_infinite("sample");
+}
+
 // INDEXED_SORT_DATUM_STREAM_T
 indexed_sort_datum_stream_t::indexed_sort_datum_stream_t(
     counted_t<datum_stream_t> stream,
-    std::function<bool(env_t *,
-                       profile::sampler_t *,
-                       const counted_t<const datum_t> &,
-                       const counted_t<const datum_t> &)> _lt_cmp)
-    : wrapper_datum_stream_t(stream), lt_cmp(_lt_cmp), index(0) { }
+    const comparisons_t &_comparisons)
+    : wrapper_datum_stream_t(stream), comparisons(_comparisons), index(0) { }
 
 std::vector<counted_t<const datum_t> >
 indexed_sort_datum_stream_t::next_batch_impl(env_t *env, const batchspec_t &batchspec) {
@@ -785,9 +1044,7 @@ indexed_sort_datum_stream_t::next_batch_impl(env_t *env, const batchspec_t &batc
             if (index >= data.size()) {
                 return ret;
             }
-            std::sort(data.begin(), data.end(),
-                      std::bind(lt_cmp, env, &sampler,
-                                std::placeholders::_1, std::placeholders::_2));
+            sort_data(env, &sampler);
         }
         for (; index < data.size() && !batcher.should_send_batch(); ++index) {
             batcher.note_el(data[index]);
@@ -797,21 +1054,101 @@ indexed_sort_datum_stream_t::next_batch_impl(env_t *env, const batchspec_t &batc
     return ret;
 }
 
+// Orders rows by the values the comparisons got out of them, which are empty
+// where a function found nothing there.
+class sort_values_lt_t {
+public:
+    sort_values_lt_t(
+        const indexed_sort_datum_stream_t::comparisons_t *_comparisons,
+        const std::vector<std::vector<counted_t<const datum_t> > > *_values)
+        : comparisons(_comparisons), values(_values) { }
+    bool operator()(size_t l, size_t r) const {
+        for (size_t i = 0; i < comparisons->size(); ++i) {
+            const counted_t<const datum_t> &lval = (*values)[l][i];
+            const counted_t<const datum_t> &rval = (*values)[r][i];
+            const bool descending = (*comparisons)[i].second;
+            if (!lval.has() && !rval.has()) {
+                continue;
+            }
+            if (!lval.has()) {
+                return true != descending;
+            }
+            if (!rval.has()) {
+                return false != descending;
+            }
+            const int cmp = lval->cmp(*rval);
+            if (cmp != 0) {
+                return (cmp < 0) != descending;
+            }
+        }
+        return false;
+    }
+private:
+    const indexed_sort_datum_stream_t::comparisons_t *comparisons;
+    const std::vector<std::vector<counted_t<const datum_t> > > *values;
+};
+
+void indexed_sort_datum_stream_t::sort_data(env_t *env, profile::sampler_t *sampler) {
+    std::vector<std::vector<counted_t<const datum_t> > > values(data.size());
+    std::vector<size_t> order(data.size());
+    for (size_t i = 0; i < data.size(); ++i) {
+        sampler->new_sample();
+        order[i] = i;
+        values[i].resize(comparisons.size());
+        for (size_t j = 0; j < comparisons.size(); ++j) {
+            try {
+                values[i][j] = comparisons[j].first->call(env, data[i])->as_datum();
+            } catch (const base_exc_t &e) {
+                if (e.get_type() != base_exc_t::NON_EXISTENCE) {
+                    throw;
+                }
+            }
+        }
+    }
+    std::sort(order.begin(), order.end(), sort_values_lt_t(&comparisons, &values));
+
+    std::vector<counted_t<const datum_t> > sorted;
+    sorted.reserve(data.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        sorted.push_back(std::move(data[order[i]]));
+    }
+    data.swap(sorted);
+}
+
 // MAP_DATUM_STREAM_T
 map_datum_stream_t::map_datum_stream_t(counted_t<func_t> _f,
                                        counted_t<datum_stream_t> _source)
     : wrapper_datum_stream_t(_source), f(_f) {
     guarantee(f.has() && source.has());
+    program.init(filter_program_t::compile(f));
 }
 std::vector<counted_t<const datum_t> >
 map_datum_stream_t::next_batch_impl(env_t *env, const batchspec_t &batchspec) {
     std::vector<counted_t<const datum_t> > v = source->next_batch(env, batchspec);
     profile::sampler_t sampler("Mapping eagerly.", env->trace);
-    for (auto it = v.begin(); it != v.end(); ++it) {
-        *it = f->call(env, *it)->as_datum();
-        sampler.new_sample();
+    if (!program.has()) {
+        // JS functions get called on the whole batch at once.
+        return f->call_batch(env, v);
     }
-    return v;
+
+    std::vector<counted_t<const datum_t> > results;
+    program->eval_batch(v, &results);
+    // The rows the program gives up on get the function called on them instead.
+    std::vector<counted_t<const datum_t> > rest;
+    std::vector<size_t> rest_indices;
+    for (size_t i = 0; i < v.size(); ++i) {
+        if (!results[i].has()) {
+            rest.push_back(v[i]);
+            rest_indices.push_back(i);
+        }
+    }
+    if (!rest.empty()) {
+        std::vector<counted_t<const datum_t> > rest_results = f->call_batch(env, rest);
+        for (size_t i = 0; i < rest_indices.size(); ++i) {
+            results[rest_indices[i]] = std::move(rest_results[i]);
+        }
+    }
+    return results;
 }
 
 // INDEXES_OF_DATUM_STREAM_T
@@ -847,6 +1184,7 @@ filter_datum_stream_t::filter_datum_stream_t(counted_t<func_t> _f,
     : wrapper_datum_stream_t(_source), f(_f),
       default_filter_val(_default_filter_val) {
     guarantee(f.has() && source.has());
+    program.init(filter_program_t::compile(f));
 }
 
 std::vector<counted_t<const datum_t> >
@@ -858,9 +1196,34 @@ filter_datum_stream_t::next_batch_impl(env_t *env, const batchspec_t &batchspec)
         if (v.size() == 0) {
             break;
         }
-        for (auto it = v.begin(); it != v.end(); ++it) {
-            if (f->filter_call(env, *it, default_filter_val)) {
-                ret.push_back(std::move(*it));
+        std::vector<bool> passes;
+        if (program.has()) {
+            std::vector<bool> known;
+            program->eval_batch(v, &passes, &known);
+            // The rows the program gives up on get the function called on them
+            // instead.
+            std::vector<counted_t<const datum_t> > rest;
+            std::vector<size_t> rest_indices;
+            for (size_t i = 0; i < v.size(); ++i) {
+                if (!known[i]) {
+                    rest.push_back(v[i]);
+                    rest_indices.push_back(i);
+                }
+            }
+            if (!rest.empty()) {
+                std::vector<bool> rest_passes
+                    = f->filter_call_batch(env, rest, default_filter_val);
+                for (size_t i = 0; i < rest_indices.size(); ++i) {
+                    passes[rest_indices[i]] = rest_passes[i];
+                }
+            }
+        } else {
+            // JS functions get called on the whole batch at once.
+            passes = f->filter_call_batch(env, v, default_filter_val);
+        }
+        for (size_t i = 0; i < v.size(); ++i) {
+            if (passes[i]) {
+                ret.push_back(std::move(v[i]));
             }
             sampler.new_sample();
         }
@@ -971,6 +1334,88 @@ zip_datum_stream_t::next_batch_impl(env_t *env, const batchspec_t &batchspec) {
     return v;
 }
 
+// EQ_JOIN_DATUM_STREAM_T
+eq_join_datum_stream_t::eq_join_datum_stream_t(counted_t<datum_stream_t> left,
+                                               counted_t<func_t> _left_key,
+                                               counted_t<table_t> _right,
+                                               const boost::optional<std::string> &_sindex)
+    : wrapper_datum_stream_t(left), left_key(_left_key), right(_right),
+      sindex(_sindex) {
+    guarantee(left_key.has() && right.has());
+}
+
+std::vector<counted_t<const datum_t> >
+eq_join_datum_stream_t::next_batch_impl(env_t *env, const batchspec_t &batchspec) {
+    return sindex ? sindex_batch(env, batchspec) : primary_key_batch(env, batchspec);
+}
+
+static counted_t<const datum_t> join_pair(const counted_t<const datum_t> &left,
+                                          const counted_t<const datum_t> &right) {
+    datum_ptr_t pair(datum_t::R_OBJECT);
+    UNUSED bool b1 = pair.add("left", left);
+    UNUSED bool b2 = pair.add("right", right);
+    return pair.to_counted();
+}
+
+std::vector<counted_t<const datum_t> >
+eq_join_datum_stream_t::primary_key_batch(env_t *env, const batchspec_t &batchspec) {
+    std::vector<counted_t<const datum_t> > v;
+    const batchspec_t left_batchspec = batchspec.with_at_most(eq_join_batch_keys(env));
+    // An empty batch would mean the end of the stream, so keep going until some
+    // left row has a match.
+    while (v.empty()) {
+        std::vector<counted_t<const datum_t> > left_rows
+            = source->next_batch(env, left_batchspec);
+        if (left_rows.empty()) {
+            break;
+        }
+
+        std::vector<counted_t<const datum_t> > keys;
+        keys.reserve(left_rows.size());
+        {
+            profile::sampler_t sampler("Evaluating join keys.", env->trace);
+            for (auto it = left_rows.begin(); it != left_rows.end(); ++it) {
+                keys.push_back(left_key->call(env, *it)->as_datum());
+                sampler.new_sample();
+            }
+        }
+
+        std::vector<counted_t<const datum_t> > right_rows = right->get_rows(env, keys);
+        r_sanity_check(right_rows.size() == left_rows.size());
+        for (size_t i = 0; i < left_rows.size(); ++i) {
+            if (right_rows[i]->get_type() != datum_t::R_NULL) {
+                v.push_back(join_pair(left_rows[i], right_rows[i]));
+            }
+        }
+    }
+    return v;
+}
+
+std::vector<counted_t<const datum_t> >
+eq_join_datum_stream_t::sindex_batch(env_t *env, const batchspec_t &batchspec) {
+    profile::sampler_t sampler("Joining on a secondary index.", env->trace);
+    for (;;) {
+        if (!matches.has()) {
+            left_row = source->next(env, batchspec);
+            if (!left_row.has()) {
+                return std::vector<counted_t<const datum_t> >();
+            }
+            counted_t<const datum_t> key = left_key->call(env, left_row)->as_datum();
+            matches = right->get_all(env, key, *sindex, backtrace());
+            sampler.new_sample();
+        }
+        std::vector<counted_t<const datum_t> > v = matches->next_batch(env, batchspec);
+        if (v.size() != 0) {
+            for (auto it = v.begin(); it != v.end(); ++it) {
+                *it = join_pair(left_row, *it);
+            }
+            return v;
+        } else {
+            matches.reset();
+        }
+    }
+}
+
 // UNION_DATUM_STREAM_T
 counted_t<datum_stream_t> union_datum_stream_t::filter(
     counted_t<func_t> f,
@@ -987,6 +1432,13 @@ counted_t<datum_stream_t> union_datum_stream_t::map(counted_t<func_t> f) {
     }
     return counted_from_this();
 }
+counted_t<datum_stream_t> union_datum_stream_t::project(
+    counted_t<func_t> f, const projection_transform_t &projection) {
+    for (auto it = streams.begin(); it != streams.end(); ++it) {
+        *it = (*it)->project(f, projection);
+    }
+    return counted_from_this();
+}
 counted_t<datum_stream_t> union_datum_stream_t::concatmap(counted_t<func_t> f) {
     for (auto it = streams.begin(); it != streams.end(); ++it) {
         *it = (*it)->concatmap(f);
@@ -1060,6 +1512,25 @@ counted_t<const datum_t> union_datum_stream_t::gmr(
     return dm.to_arr();
 }
 
+void union_datum_stream_t::groupby(env_t *env, const groupby_wire_func_t &f,
+                                   group_accumulators_t *accumulators) {
+    for (auto it = streams.begin(); it != streams.end(); ++it) {
+        (*it)->groupby(env, f, accumulators);
+    }
+}
+
+void union_datum_stream_t::sketch_distinct(env_t *env, distinct_sketch_t *sketch) {
+    for (auto it = streams.begin(); it != streams.end(); ++it) {
+        (*it)->sketch_distinct(env, sketch);
+    }
+}
+
+void union_datum_stream_t::sketch_quantiles(env_t *env, quantile_sketch_t *sketch) {
+    for (auto it = streams.begin(); it != streams.end(); ++it) {
+        (*it)->sketch_quantiles(env, sketch);
+    }
+}
+
 bool union_datum_stream_t::is_array() {
     for (auto it = streams.begin(); it != streams.end(); ++it) {
         if (!(*it)->is_array()) {
@@ -1085,6 +1556,11 @@ counted_t<const datum_t> union_datum_stream_t::as_array(env_t *env) {
 }
 
 bool union_datum_stream_t::is_exhausted() const {
+    for (auto it = buffered.begin(); it != buffered.end(); ++it) {
+        if (!it->empty()) {
+            return false;
+        }
+    }
     for (auto it = streams.begin(); it != streams.end(); ++it) {
         if (!(*it)->is_exhausted()) {
             return false;
@@ -1095,6 +1571,22 @@ bool union_datum_stream_t::is_exhausted() const {
 
 std::vector<counted_t<const datum_t> >
 union_datum_stream_t::next_batch_impl(env_t *env, const batchspec_t &batchspec) {
+    // Only lazy streams can be read at once: their transforms run on the shards,
+    // while other streams may evaluate functions here, and the js runner isn't
+    // reentrant.  A profile can't have events from several coroutines at once
+    // either.  The union is unordered, so the order of the rows doesn't matter.
+    bool concurrent = streams.size() > 1 && !env->trace.has();
+    for (auto it = streams.begin(); concurrent && it != streams.end(); ++it) {
+        concurrent = dynamic_cast<lazy_datum_stream_t *>(it->get()) != NULL;
+    }
+    return concurrent
+        ? next_batch_concurrently(env, batchspec)
+        : next_batch_sequentially(env, batchspec);
+}
+
+std::vector<counted_t<const datum_t> >
+union_datum_stream_t::next_batch_sequentially(env_t *env,
+                                              const batchspec_t &batchspec) {
     for (; streams_index < streams.size(); ++streams_index) {
         std::vector<counted_t<const datum_t> > batch
             = streams[streams_index]->next_batch(env, batchspec);
@@ -1105,4 +1597,54 @@ union_datum_stream_t::next_batch_impl(env_t *env, const batchspec_t &batchspec)
     return std::vector<counted_t<const datum_t> >();
 }
 
+std::vector<counted_t<const datum_t> >
+union_datum_stream_t::next_batch_concurrently(env_t *env,
+                                              const batchspec_t &batchspec) {
+    for (;;) {
+        for (size_t i = 0; i < buffered.size(); ++i) {
+            if (!buffered[i].empty()) {
+                std::vector<counted_t<const datum_t> > batch;
+                batch.swap(buffered[i]);
+                return batch;
+            }
+        }
+
+        std::vector<size_t> inputs;
+        for (size_t i = 0; i < streams.size(); ++i) {
+            if (!exhausted[i]) {
+                inputs.push_back(i);
+            }
+        }
+        if (inputs.empty()) {
+            return std::vector<counted_t<const datum_t> >();
+        }
+
+        // Every read finishes before this returns, so none of them outlives the
+        // interruptor of `env`, which changes from one request to the next.
+        std::vector<std::exception_ptr> errors(inputs.size());
+        pmap(inputs.size(), boost::bind(&union_datum_stream_t::fetch_batch, this,
+                                        env, &batchspec, &inputs, &errors, _1));
+        for (auto it = errors.begin(); it != errors.end(); ++it) {
+            if (*it) {
+                std::rethrow_exception(*it);
+            }
+        }
+    }
+}
+
+void union_datum_stream_t::fetch_batch(env_t *env, const batchspec_t *batchspec,
+                                       const std::vector<size_t> *inputs,
+                                       std::vector<std::exception_ptr> *errors_out,
+                                       int i) {
+    size_t input = (*inputs)[i];
+    try {
+        buffered[input] = streams[input]->next_batch(env, *batchspec);
+        if (buffered[input].empty()) {
+            exhausted[input] = true;
+        }
+    } catch (const std::exception &) {
+        (*errors_out)[i] = std::current_exception();
+    }
+}
+
 } // namespace ql
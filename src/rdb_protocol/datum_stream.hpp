@@ -4,6 +4,7 @@
 
 #include <algorithm>
 #include <deque>
+#include <exception>
 #include <list>
 #include <map>
 #include <set>
@@ -19,11 +20,13 @@
 #include <boost/variant/get.hpp>
 
 #include "clustering/administration/namespace_interface_repository.hpp"
+#include "rdb_protocol/filter_program.hpp"
 #include "rdb_protocol/protocol.hpp"
 
 namespace ql {
 
 class env_t;
+class table_t;
 
 /* This wraps a namespace_interface_t and makes it automatically handle getting
  * profiling information from them. It acheives this by doing the following in
@@ -99,6 +102,10 @@ public:
                                              counted_t<func_t> default_filter_val) = 0;
     virtual counted_t<datum_stream_t> map(counted_t<func_t> f) = 0;
     virtual counted_t<datum_stream_t> concatmap(counted_t<func_t> f) = 0;
+    // Maps `f`, which does `projection` to every row.  Lazy streams have the shards
+    // project their rows without calling `f`, see projection_transform_t.
+    virtual counted_t<datum_stream_t> project(counted_t<func_t> f,
+                                              const projection_transform_t &projection);
 
     // stream -> atom
     virtual counted_t<const datum_t> count(env_t *env) = 0;
@@ -110,9 +117,27 @@ public:
                                          counted_t<func_t> m,
                                          counted_t<const datum_t> d,
                                          counted_t<func_t> r) = 0;
+    // Adds the rows to the accumulators of their groups.  Lazy streams have the
+    // shards accumulate their rows, see groupby_wire_func_t.
+    virtual void groupby(env_t *env, const groupby_wire_func_t &f,
+                         group_accumulators_t *accumulators) = 0;
+    // Add the rows, or for `sketch_quantiles` the numbers, to a sketch.  Lazy
+    // streams have the shards sketch their rows and merge the sketches.
+    virtual void sketch_distinct(env_t *env, distinct_sketch_t *sketch) = 0;
+    virtual void sketch_quantiles(env_t *env, quantile_sketch_t *sketch) = 0;
+
+    // The first `k` rows by `funcs`, in order.  Lazy streams have the shards keep
+    // their first `k` rows instead of sending all of them, see top_k_wire_func_t.
+    virtual std::vector<counted_t<const datum_t> >
+    top_k(env_t *env, const order_funcs_t &funcs, size_t k);
+
+    // A uniform sample of `k` of the rows, in random order.  Lazy streams have the
+    // shards sample their rows instead of sending all of them, see
+    // sample_wire_func_t.
+    virtual std::vector<counted_t<const datum_t> > sample(env_t *env, size_t k);
 
     // stream -> stream (always eager)
-    counted_t<datum_stream_t> slice(size_t l, size_t r);
+    virtual counted_t<datum_stream_t> slice(size_t l, size_t r);
     counted_t<datum_stream_t> zip();
     counted_t<datum_stream_t> indexes_of(counted_t<func_t> f);
 
@@ -129,6 +154,22 @@ public:
     virtual counted_t<const datum_t> next(env_t *env, const batchspec_t &batchspec);
     virtual bool is_exhausted() const = 0;
 
+    // Returns true if the stream is the rows of a range of a table's primary index
+    // that pass deterministic filters, and nothing was read from it yet, in which
+    // case it sets `*range_out` and `*transform_out` to them.  That lets a write to
+    // all the rows run on the shards, see range_replace_t.
+    virtual bool unread_primary_range(UNUSED key_range_t *range_out,
+                                      UNUSED transform_t *transform_out) const {
+        return false;
+    }
+    // Returns true if the stream is all the rows of a range of a table's secondary
+    // index, and nothing was read from it yet, in which case it sets `*sindex_out`
+    // and `*range_out` to them, see sindex_range_delete_t.
+    virtual bool unread_sindex_range(UNUSED std::string *sindex_out,
+                                     UNUSED datum_range_t *range_out) const {
+        return false;
+    }
+
 protected:
     explicit datum_stream_t(const protob_t<const Backtrace> &bt_src);
 
@@ -158,6 +199,10 @@ protected:
                                          counted_t<func_t> m,
                                          counted_t<const datum_t> d,
                                          counted_t<func_t> r);
+    virtual void groupby(env_t *env, const groupby_wire_func_t &f,
+                         group_accumulators_t *accumulators);
+    virtual void sketch_distinct(env_t *env, distinct_sketch_t *sketch);
+    virtual void sketch_quantiles(env_t *env, quantile_sketch_t *sketch);
 
     virtual bool is_array() = 0;
     virtual counted_t<const datum_t> as_array(env_t *env);
@@ -190,6 +235,9 @@ private:
     next_batch_impl(env_t *env, const batchspec_t &batchspec);
 
     counted_t<func_t> f;
+    // `f` compiled for evaluating whole batches at once, or empty if it doesn't
+    // compile.
+    scoped_ptr_t<filter_program_t> program;
 };
 
 class indexes_of_datum_stream_t : public wrapper_datum_stream_t {
@@ -216,6 +264,8 @@ private:
 
     counted_t<func_t> f;
     counted_t<func_t> default_filter_val;
+    // Like map_datum_stream_t::program.
+    scoped_ptr_t<filter_program_t> program;
 };
 
 class concatmap_datum_stream_t : public wrapper_datum_stream_t {
@@ -241,13 +291,18 @@ public:
         profile_bool_t profile,
         sorting_t sorting);
     virtual ~readgen_t() { }
+    const datum_range_t &get_original_datum_range() const {
+        return original_datum_range;
+    }
     read_t terminal_read(
         const transform_t &transform,
         terminal_t &&_terminal,
         const batchspec_t &batchspec) const;
     // This has to be on `readgen_t` because we sort differently depending on
-    // the kinds of reads we're doing.
-    virtual void sindex_sort(std::vector<rget_item_t> *vec) const = 0;
+    // the kinds of reads we're doing.  `key_format` is the format of the keys of
+    // the items, which says how far they're in order already.
+    virtual void sindex_sort(std::vector<rget_item_t> *vec,
+                             sindex_key_format_t key_format) const = 0;
 
     virtual read_t next_read(
         const key_range_t &active_range,
@@ -284,13 +339,16 @@ private:
 
 class primary_readgen_t : public readgen_t {
 public:
+    // The reads only go to `shard_range` of the primary keys, see table_t::shard().
     static scoped_ptr_t<readgen_t> make(
         env_t *env,
         datum_range_t range = datum_range_t::universe(),
-        sorting_t sorting = sorting_t::UNORDERED);
+        sorting_t sorting = sorting_t::UNORDERED,
+        const key_range_t &shard_range = key_range_t::universe());
 private:
     primary_readgen_t(const std::map<std::string, wire_func_t> &global_optargs,
-                      datum_range_t range, profile_bool_t profile, sorting_t sorting);
+                      datum_range_t range, profile_bool_t profile, sorting_t sorting,
+                      const key_range_t &shard_range);
     virtual rget_read_t next_read_impl(
         const key_range_t &active_range,
         const transform_t &transform,
@@ -300,9 +358,12 @@ private:
         const std::vector<rget_item_t> &items,
         const transform_t &transform,
         const batchspec_t &batchspec) const;
-    virtual void sindex_sort(std::vector<rget_item_t> *vec) const;
+    virtual void sindex_sort(std::vector<rget_item_t> *vec,
+                             sindex_key_format_t key_format) const;
     virtual key_range_t original_keyrange() const;
     virtual std::string sindex_name() const; // Used for error checking.
+
+    const key_range_t shard_range;
 };
 
 class sindex_readgen_t : public readgen_t {
@@ -326,7 +387,8 @@ private:
         const std::vector<rget_item_t> &items,
         const transform_t &transform,
         const batchspec_t &batchspec) const;
-    virtual void sindex_sort(std::vector<rget_item_t> *vec) const;
+    virtual void sindex_sort(std::vector<rget_item_t> *vec,
+                             sindex_key_format_t key_format) const;
     virtual key_range_t original_keyrange() const;
     virtual std::string sindex_name() const; // Used for error checking.
 
@@ -344,11 +406,16 @@ public:
     std::vector<counted_t<const datum_t> >
     next_batch(env_t *env, const batchspec_t &batchspec);
     bool is_finished() const;
+    // See datum_stream_t::unread_primary_range.
+    bool unread_primary_range(key_range_t *range_out, transform_t *transform_out) const;
+    // See datum_stream_t::unread_sindex_range.
+    bool unread_sindex_range(std::string *sindex_out, datum_range_t *range_out) const;
 private:
     // Returns `true` if there's data in `items`.
     bool load_items(env_t *env, const batchspec_t &batchspec);
     rget_read_response_t do_read(env_t *env, const read_t &read);
-    std::vector<rget_item_t> do_range_read(env_t *env, const read_t &read);
+    std::vector<rget_item_t> do_range_read(env_t *env, const read_t &read,
+                                           sindex_key_format_t *key_format_out);
 
     rdb_namespace_access_t ns_access;
     const bool use_outdated;
@@ -374,6 +441,8 @@ public:
                                              counted_t<func_t> default_filter_val);
     virtual counted_t<datum_stream_t> map(counted_t<func_t> f);
     virtual counted_t<datum_stream_t> concatmap(counted_t<func_t> f);
+    virtual counted_t<datum_stream_t> project(counted_t<func_t> f,
+                                              const projection_transform_t &projection);
 
     virtual counted_t<const datum_t> count(env_t *env);
     virtual counted_t<const datum_t> reduce(env_t *env,
@@ -384,12 +453,23 @@ public:
                                          counted_t<func_t> m,
                                          counted_t<const datum_t> base,
                                          counted_t<func_t> r);
+    virtual void groupby(env_t *env, const groupby_wire_func_t &f,
+                         group_accumulators_t *accumulators);
+    virtual void sketch_distinct(env_t *env, distinct_sketch_t *sketch);
+    virtual void sketch_quantiles(env_t *env, quantile_sketch_t *sketch);
+    virtual std::vector<counted_t<const datum_t> >
+    top_k(env_t *env, const order_funcs_t &funcs, size_t k);
+    virtual std::vector<counted_t<const datum_t> > sample(env_t *env, size_t k);
     virtual bool is_array() { return false; }
     virtual counted_t<const datum_t> as_array(UNUSED env_t *env) {
         return counted_t<const datum_t>();  // Cannot be converted implicitly.
     }
 
     bool is_exhausted() const;
+    virtual bool unread_primary_range(key_range_t *range_out,
+                                      transform_t *transform_out) const;
+    virtual bool unread_sindex_range(std::string *sindex_out,
+                                     datum_range_t *range_out) const;
 private:
     std::vector<counted_t<const datum_t> >
     next_batch_impl(env_t *env, const batchspec_t &batchspec);
@@ -422,6 +502,41 @@ private:
     counted_t<const datum_t> arr;
 };
 
+/* The changes of a table as they happen, see changefeed::feed_t.  It never runs
+out, so the terminals that would read all of it fail instead of waiting forever. */
+class changefeed_datum_stream_t : public eager_datum_stream_t {
+public:
+    changefeed_datum_stream_t(scoped_ptr_t<changefeed::feed_t> &&_feed,
+                              const protob_t<const Backtrace> &bt_src);
+    virtual bool is_exhausted() const { return false; }
+
+private:
+    virtual bool is_array() { return false; }
+    virtual counted_t<const datum_t> as_array(UNUSED env_t *env) {
+        return counted_t<const datum_t>();
+    }
+    virtual std::vector<counted_t<const datum_t> >
+    next_batch_impl(env_t *env, const batchspec_t &batchspec);
+
+    virtual counted_t<const datum_t> count(env_t *env);
+    virtual counted_t<const datum_t> reduce(env_t *env,
+                                            counted_t<val_t> base_val,
+                                            counted_t<func_t> f);
+    virtual counted_t<const datum_t> gmr(env_t *env,
+                                         counted_t<func_t> g,
+                                         counted_t<func_t> m,
+                                         counted_t<const datum_t> d,
+                                         counted_t<func_t> r);
+    virtual void groupby(env_t *env, const groupby_wire_func_t &f,
+                         group_accumulators_t *accumulators);
+    virtual void sketch_distinct(env_t *env, distinct_sketch_t *sketch);
+    virtual void sketch_quantiles(env_t *env, quantile_sketch_t *sketch);
+    virtual std::vector<counted_t<const datum_t> > sample(env_t *env, size_t k);
+    void NORETURN fail_infinite(const char *what);
+
+    scoped_ptr_t<changefeed::feed_t> feed;
+};
+
 class slice_datum_stream_t : public wrapper_datum_stream_t {
 public:
     slice_datum_stream_t(uint64_t left, uint64_t right, counted_t<datum_stream_t> src);
@@ -440,22 +555,50 @@ private:
     next_batch_impl(env_t *env, const batchspec_t &batchspec);
 };
 
+/* The `{left, right}` pairs of an eq_join of `source` with `right`.  On the primary
+key, the keys of a batch of left rows (see eq_join_batch_keys()) get looked up with a
+single multi_point_read_t, which the namespace interface splits into one read per
+shard, instead of a read for every row.  On a secondary index, every left row still
+needs a get_all of its own. */
+class eq_join_datum_stream_t : public wrapper_datum_stream_t {
+public:
+    eq_join_datum_stream_t(counted_t<datum_stream_t> left,
+                           counted_t<func_t> _left_key,
+                           counted_t<table_t> _right,
+                           const boost::optional<std::string> &_sindex);
+private:
+    virtual std::vector<counted_t<const datum_t> >
+    next_batch_impl(env_t *env, const batchspec_t &batchspec);
+
+    std::vector<counted_t<const datum_t> >
+    primary_key_batch(env_t *env, const batchspec_t &batchspec);
+    std::vector<counted_t<const datum_t> >
+    sindex_batch(env_t *env, const batchspec_t &batchspec);
+
+    counted_t<func_t> left_key;
+    counted_t<table_t> right;
+    boost::optional<std::string> sindex;
+
+    // For secondary index joins, the left row whose matches we're reading.
+    counted_t<const datum_t> left_row;
+    counted_t<datum_stream_t> matches;
+};
+
+// Orders the rows with the same index value by more functions, each paired with
+// whether it sorts descending.
 class indexed_sort_datum_stream_t : public wrapper_datum_stream_t {
 public:
+    typedef std::vector<std::pair<counted_t<func_t>, bool> > comparisons_t;
     indexed_sort_datum_stream_t(
         counted_t<datum_stream_t> stream, // Must be a table with a sorting applied.
-        std::function<bool(env_t *,
-                           profile::sampler_t *,
-                           const counted_t<const datum_t> &,
-                           const counted_t<const datum_t> &)> lt_cmp);
+        const comparisons_t &comparisons);
 private:
     virtual std::vector<counted_t<const datum_t> >
     next_batch_impl(env_t *env, const batchspec_t &batchspec);
+    // Sorts `data`, calling each function once per row.
+    void sort_data(env_t *env, profile::sampler_t *sampler);
 
-    std::function<bool(env_t *,
-                       profile::sampler_t *,
-                       const counted_t<const datum_t> &,
-                       const counted_t<const datum_t> &)> lt_cmp;
+    const comparisons_t comparisons;
     size_t index;
     std::vector<counted_t<const datum_t> > data;
 };
@@ -464,13 +607,16 @@ class union_datum_stream_t : public datum_stream_t {
 public:
     union_datum_stream_t(const std::vector<counted_t<datum_stream_t> > &_streams,
                          const protob_t<const Backtrace> &bt_src)
-        : datum_stream_t(bt_src), streams(_streams), streams_index(0) { }
+        : datum_stream_t(bt_src), streams(_streams), streams_index(0),
+          buffered(_streams.size()), exhausted(_streams.size(), false) { }
 
     // stream -> stream
     virtual counted_t<datum_stream_t> filter(counted_t<func_t> f,
                                              counted_t<func_t> default_filter_val);
     virtual counted_t<datum_stream_t> map(counted_t<func_t> f);
     virtual counted_t<datum_stream_t> concatmap(counted_t<func_t> f);
+    virtual counted_t<datum_stream_t> project(counted_t<func_t> f,
+                                              const projection_transform_t &projection);
 
     // stream -> atom
     virtual counted_t<const datum_t> count(env_t *env);
@@ -482,6 +628,10 @@ public:
                                          counted_t<func_t> m,
                                          counted_t<const datum_t> base,
                                          counted_t<func_t> r);
+    virtual void groupby(env_t *env, const groupby_wire_func_t &f,
+                         group_accumulators_t *accumulators);
+    virtual void sketch_distinct(env_t *env, distinct_sketch_t *sketch);
+    virtual void sketch_quantiles(env_t *env, quantile_sketch_t *sketch);
     virtual bool is_array();
     virtual counted_t<const datum_t> as_array(env_t *env);
     virtual bool is_exhausted() const;
@@ -490,8 +640,24 @@ private:
     std::vector<counted_t<const datum_t> >
     next_batch_impl(env_t *env, const batchspec_t &batchspec);
 
+    // Drains the streams one after another.
+    std::vector<counted_t<const datum_t> >
+    next_batch_sequentially(env_t *env, const batchspec_t &batchspec);
+    // Reads the next batch of every stream that isn't exhausted at once, and
+    // returns them one at a time.
+    std::vector<counted_t<const datum_t> >
+    next_batch_concurrently(env_t *env, const batchspec_t &batchspec);
+    void fetch_batch(env_t *env, const batchspec_t *batchspec,
+                     const std::vector<size_t> *inputs,
+                     std::vector<std::exception_ptr> *errors_out, int i);
+
     std::vector<counted_t<datum_stream_t> > streams;
     size_t streams_index;
+
+    // For `next_batch_concurrently`, the batch read from every stream that wasn't
+    // returned yet, and whether the stream returned an empty batch.
+    std::vector<std::vector<counted_t<const datum_t> > > buffered;
+    std::vector<bool> exhausted;
 };
 
 } // namespace ql
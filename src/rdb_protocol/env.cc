@@ -7,6 +7,7 @@
 #include "rdb_protocol/counted_term.hpp"
 #include "rdb_protocol/func.hpp"
 #include "rdb_protocol/minidriver.hpp"
+#include "rdb_protocol/slow_query_log.hpp"
 #include "rdb_protocol/term_walker.hpp"
 
 #pragma GCC diagnostic ignored "-Wshadow"
@@ -104,6 +105,16 @@ profile_bool_t env_t::profile() {
     return trace.has() ? profile_bool_t::PROFILE : profile_bool_t::DONT_PROFILE;
 }
 
+bool env_t::returns_profile() const {
+    return trace.has() && !(logged_query.has() && logged_query->is_sampled());
+}
+
+void env_t::profile_resources() {
+    if (trace.has() && resources.has()) {
+        profile::starter_t starter(resources->describe(), trace);
+    }
+}
+
 cluster_access_t::cluster_access_t(
         base_namespace_repo_t<rdb_protocol_t> *_ns_repo,
 
@@ -185,6 +196,10 @@ env_t::env_t(
                    _directory_read_manager,
                    _this_machine),
     interruptor(_interruptor),
+    spill_space(NULL),
+    mailbox_manager(NULL),
+    near_cache(NULL),
+    noreply(false),
     eval_callback(NULL)
 {
     if (query.has()) {
@@ -193,6 +208,9 @@ env_t::env_t(
             profile_arg->as_bool()) {
             trace.init(new profile::trace_t());
         }
+        counted_t<const datum_t> noreply_arg = static_optarg("noreply", query);
+        noreply = noreply_arg.has() && noreply_arg->get_type() == datum_t::type_t::R_BOOL
+            && noreply_arg->as_bool();
     }
 }
 
@@ -220,6 +238,10 @@ env_t::env_t(
                    _directory_read_manager,
                    _this_machine),
     interruptor(_interruptor),
+    spill_space(NULL),
+    mailbox_manager(NULL),
+    near_cache(NULL),
+    noreply(false),
     eval_callback(NULL)
 {
     if (_profile == profile_bool_t::PROFILE) {
@@ -237,9 +259,17 @@ env_t::env_t(signal_t *_interruptor)
                    NULL,
                    uuid_u()),
     interruptor(_interruptor),
+    spill_space(NULL),
+    mailbox_manager(NULL),
+    near_cache(NULL),
+    noreply(false),
     eval_callback(NULL)
 { }
 
-env_t::~env_t() { }
+env_t::~env_t() {
+    if (logged_query.has()) {
+        logged_query->finish(this);
+    }
+}
 
 } // namespace ql
@@ -13,6 +13,7 @@
 #include "extproc/js_runner.hpp"
 #include "rdb_protocol/error.hpp"
 #include "rdb_protocol/protocol.hpp"
+#include "rdb_protocol/query_resources.hpp"
 #include "rdb_protocol/datum_stream.hpp"
 #include "rdb_protocol/val.hpp"
 
@@ -20,8 +21,13 @@ class extproc_pool_t;
 
 namespace ql {
 class datum_t;
+class logged_query_t;
+class near_cache_t;
+class spill_space_t;
 class term_t;
 
+typedef std::map<const Datum *, std::vector<term_t *> > datum_terms_t;
+
 /* If and optarg with the given key is present and is of type DATUM it will be
  * returned. Otherwise an empty counted_t<const datum_t> will be returned. */
 counted_t<const datum_t> static_optarg(const std::string &key, protob_t<Query> q);
@@ -122,6 +128,11 @@ public:
     void throw_if_interruptor_pulsed() THROWS_ONLY(interrupted_exc_t) {
         if (interruptor->is_pulsed()) throw interrupted_exc_t();
     }
+    // Throws if the query is over one of its limits.  This can't be part of
+    // throw_if_interruptor_pulsed(), which only throws interrupted_exc_t.
+    void check_resources() {
+        if (resources.has()) resources->check();
+    }
 
 
     // Returns js_runner, but first calls js_runner->begin() if it hasn't
@@ -152,9 +163,38 @@ public:
     // The interruptor signal while a query evaluates.  This can get overwritten!
     signal_t *interruptor;
 
+    // Where the query can put what doesn't fit in memory, or NULL if it can't.
+    spill_space_t *spill_space;
+
+    // What the changefeeds of the query talk to the stores over, or NULL if it
+    // can't have any.
+    mailbox_manager_t *mailbox_manager;
+
+    // Where `get`s with `use_outdated` look for the rows of tables that have a
+    // near cache, or NULL if they always read them from the cluster.
+    near_cache_t *near_cache;
+
     scoped_ptr_t<profile::trace_t> trace;
 
+    // Whether the client asked for no response, in which case the writes of the
+    // query don't bother with their stats.
+    bool noreply;
+
+    // What the query used so far, against its limits, or empty if nothing counts
+    // (which is the case for the env_ts that don't evaluate client queries).
+    scoped_ptr_t<query_resources_t> resources;
+
+    // What logs the query in the slow query log when it's done, or empty for the
+    // env_ts that don't evaluate client queries.  This can be why the query has a
+    // trace.
+    scoped_ptr_t<logged_query_t> logged_query;
+
     profile_bool_t profile();
+    // Whether the client asked for the profile of the query.
+    bool returns_profile() const;
+
+    // Notes what the query used so far in its profile, if it's profiled.
+    void profile_resources();
 
 private:
     js_runner_t js_runner;
@@ -168,9 +208,13 @@ private:
 // evaluate anything, it doesn't need an env_t *.
 class compile_env_t {
 public:
-    explicit compile_env_t(var_visibility_t &&_visibility)
-        : visibility(std::move(_visibility)) { }
+    explicit compile_env_t(var_visibility_t &&_visibility,
+                           datum_terms_t *_datum_terms = NULL)
+        : visibility(std::move(_visibility)), datum_terms(_datum_terms) { }
     var_visibility_t visibility;
+    // If set, collects the datum terms along with the literals they come from, so
+    // that the query cache can give them other values, see query_cache_t.
+    datum_terms_t *datum_terms;
 };
 
 // This is an environment for evaluating things that use variables in scope.  It
@@ -0,0 +1,189 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "rdb_protocol/external_sort.hpp"
+
+#include <algorithm>
+#include <limits>
+
+#include "containers/archive/stl_types.hpp"
+#include "containers/uuid.hpp"
+#include "rdb_protocol/batching.hpp"
+#include "rdb_protocol/env.hpp"
+#include "rdb_protocol/error.hpp"
+
+namespace ql {
+
+spill_space_t::spill_space_t(io_backender_t *_io_backender, const base_path_t &_base_path)
+    : io_backender_(_io_backender), base_path_(_base_path),
+      stats_membership_(&get_global_perfmon_collection(), &stats_, "query_spill") { }
+
+serializer_filepath_t spill_space_t::new_filepath(const std::string &prefix) const {
+    return serializer_filepath_t(base_path_, prefix + uuid_to_str(generate_uuid()));
+}
+
+external_sort_datum_stream_t::external_sort_datum_stream_t(
+    spill_space_t *_spill_space, const protob_t<const Backtrace> &bt_src)
+    : eager_datum_stream_t(bt_src), spill_space(_spill_space), started(false) {
+    guarantee(spill_space != NULL);
+}
+
+external_sort_datum_stream_t::~external_sort_datum_stream_t() { }
+
+void external_sort_datum_stream_t::add_run(std::vector<keyed_row_t> *run) {
+    rassert(!started);
+    if (run->empty()) {
+        return;
+    }
+
+    sort_keyed_rows(run);
+    run_t *r = new run_t(new run_queue_t(spill_space->io_backender(),
+                                         spill_space->new_filepath("sort_"),
+                                         spill_space->stats()));
+    runs.push_back(r);
+    for (auto it = run->begin(); it != run->end(); ++it) {
+        r->queue->push(*it);
+    }
+    run->clear();
+    pop_head(r);
+}
+
+void external_sort_datum_stream_t::pop_head(run_t *run) {
+    if (run->queue->empty()) {
+        run->head = keyed_row_t();
+        run->has_head = false;
+    } else {
+        run->queue->pop(&run->head);
+        run->has_head = true;
+    }
+}
+
+bool external_sort_datum_stream_t::is_exhausted() const {
+    for (auto it = runs.begin(); it != runs.end(); ++it) {
+        if (it->has_head) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool external_sort_datum_stream_t::is_array() {
+    return false;
+}
+
+std::vector<counted_t<const datum_t> >
+external_sort_datum_stream_t::next_batch_impl(env_t *env, const batchspec_t &batchspec) {
+    started = true;
+    std::vector<counted_t<const datum_t> > v;
+    batcher_t batcher = batchspec.to_batcher();
+
+    profile::sampler_t sampler("Merging sorted runs.", env->trace);
+    for (;;) {
+        // Every run holds as many rows as fit in memory, so there are few enough
+        // of them that looking at all their heads is cheaper than keeping a heap.
+        run_t *least = NULL;
+        for (auto it = runs.begin(); it != runs.end(); ++it) {
+            if (it->has_head && (least == NULL || it->head.first < least->head.first)) {
+                least = &*it;
+            }
+        }
+        if (least == NULL) {
+            break;
+        }
+
+        counted_t<const datum_t> d = std::move(least->head.second);
+        pop_head(least);
+        batcher.note_el(d);
+        v.push_back(std::move(d));
+        if (batcher.should_send_batch()) {
+            break;
+        }
+        sampler.new_sample();
+    }
+    return v;
+}
+
+orderby_datum_stream_t::orderby_datum_stream_t(
+    counted_t<datum_stream_t> _source, order_funcs_t &&_funcs,
+    const protob_t<const Backtrace> &bt_src)
+    : eager_datum_stream_t(bt_src), source(_source), funcs(std::move(_funcs)),
+      limit(std::numeric_limits<size_t>::max()) { }
+
+counted_t<datum_stream_t> orderby_datum_stream_t::slice(size_t l, size_t r) {
+    if (!sorted.has()) {
+        limit = std::min(limit, r);
+    }
+    return eager_datum_stream_t::slice(l, r);
+}
+
+bool orderby_datum_stream_t::is_exhausted() const {
+    return sorted.has() && sorted->is_exhausted();
+}
+
+bool orderby_datum_stream_t::is_array() {
+    // Sorting happens in memory unless there are more rows than fit in an array.
+    return !sorted.has() || sorted->is_array();
+}
+
+std::vector<counted_t<const datum_t> >
+orderby_datum_stream_t::next_batch_impl(env_t *env, const batchspec_t &batchspec) {
+    if (!sorted.has()) {
+        sorted = sort(env);
+        source.reset();
+    }
+    return sorted->next_batch(env, batchspec);
+}
+
+counted_t<datum_stream_t> orderby_datum_stream_t::sort(env_t *env) {
+    if (limit <= array_size_limit()) {
+        std::vector<counted_t<const datum_t> > rows = source->top_k(env, funcs, limit);
+        return make_counted<array_datum_stream_t>(
+            make_counted<const datum_t>(std::move(rows)), backtrace());
+    }
+
+    // Rows beyond the array size limit get sorted in runs of that size and merged
+    // from disk, if there's a disk to spill to.
+    std::vector<keyed_row_t> run;
+    counted_t<external_sort_datum_stream_t> external_sort;
+    batchspec_t batchspec = batchspec_t::user(batch_type_t::TERMINAL, env);
+    for (;;) {
+        std::vector<counted_t<const datum_t> > data = source->next_batch(env, batchspec);
+        if (data.size() == 0) {
+            break;
+        }
+        {
+            profile::sampler_t sampler("Evaluating sort keys.", env->trace);
+            for (auto it = data.begin(); it != data.end(); ++it) {
+                run.push_back(keyed_row_t(order_key(env, funcs, *it), std::move(*it)));
+                sampler.new_sample();
+            }
+        }
+        if (run.size() > array_size_limit()) {
+            rcheck(env->spill_space != NULL, base_exc_t::GENERIC,
+                   strprintf("Array over size limit %zu.", run.size()).c_str());
+            if (!external_sort.has()) {
+                external_sort = make_counted<external_sort_datum_stream_t>(
+                    env->spill_space, backtrace());
+            }
+            profile::starter_t starter("Sorting a run and writing it to disk.",
+                                       env->trace);
+            external_sort->add_run(&run);
+        }
+    }
+
+    if (external_sort.has()) {
+        profile::starter_t starter("Sorting a run and writing it to disk.", env->trace);
+        external_sort->add_run(&run);
+        return counted_t<datum_stream_t>(std::move(external_sort));
+    }
+
+    profile::starter_t starter("Sorting in-memory.", env->trace);
+    sort_keyed_rows(&run);
+    std::vector<counted_t<const datum_t> > rows;
+    rows.reserve(run.size());
+    for (auto it = run.begin(); it != run.end(); ++it) {
+        rows.push_back(std::move(it->second));
+    }
+    return make_counted<array_datum_stream_t>(
+        make_counted<const datum_t>(std::move(rows)), backtrace());
+}
+
+}  // namespace ql
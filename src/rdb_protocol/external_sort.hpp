@@ -0,0 +1,111 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_EXTERNAL_SORT_HPP_
+#define RDB_PROTOCOL_EXTERNAL_SORT_HPP_
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "errors.hpp"
+#include <boost/ptr_container/ptr_vector.hpp>
+
+#include "containers/disk_backed_queue.hpp"
+#include "perfmon/core.hpp"
+#include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/datum_stream.hpp"
+#include "utils.hpp"
+
+class io_backender_t;
+
+namespace ql {
+
+// Where queries can put data that doesn't fit in memory.  The files go in the
+// temporary directory of `base_path` and are unlinked as soon as they're created,
+// see internal_disk_backed_queue_t.
+class spill_space_t {
+public:
+    spill_space_t(io_backender_t *_io_backender, const base_path_t &_base_path);
+
+    io_backender_t *io_backender() const { return io_backender_; }
+    perfmon_collection_t *stats() { return &stats_; }
+
+    // A file name that nothing else uses.
+    serializer_filepath_t new_filepath(const std::string &prefix) const;
+
+private:
+    io_backender_t *const io_backender_;
+    const base_path_t base_path_;
+
+    perfmon_collection_t stats_;
+    perfmon_membership_t stats_membership_;
+
+    DISABLE_COPYING(spill_space_t);
+};
+
+/* Sorts more rows than fit in memory: the rows come in runs that are sorted in
+memory and written to disk, and reading the stream merges them as it goes, so the
+whole result never has to be in memory at once. */
+class external_sort_datum_stream_t : public eager_datum_stream_t {
+public:
+    external_sort_datum_stream_t(spill_space_t *_spill_space,
+                                 const protob_t<const Backtrace> &bt_src);
+    virtual ~external_sort_datum_stream_t();
+
+    // Sorts `run` and writes it to disk, leaving `run` empty.  May only be called
+    // before the first read.
+    void add_run(std::vector<keyed_row_t> *run);
+
+    virtual bool is_exhausted() const;
+
+private:
+    typedef disk_backed_queue_t<keyed_row_t> run_queue_t;
+
+    struct run_t {
+        explicit run_t(run_queue_t *_queue) : queue(_queue), has_head(false) { }
+        scoped_ptr_t<run_queue_t> queue;
+        // The least row of the run that hasn't been read yet.
+        keyed_row_t head;
+        bool has_head;
+    };
+
+    virtual bool is_array();
+    virtual std::vector<counted_t<const datum_t> >
+    next_batch_impl(env_t *env, const batchspec_t &batchspec);
+
+    static void pop_head(run_t *run);
+
+    spill_space_t *const spill_space;
+    boost::ptr_vector<run_t> runs;
+    bool started;
+};
+
+/* The rows of `source` in the order of an unindexed orderby.  Nothing gets read
+until the stream is, so that a limit on it can still turn the sort into a top-k
+(see datum_stream_t::top_k), which keeps only the rows under the limit in memory
+and lets the shards send only those of theirs. */
+class orderby_datum_stream_t : public eager_datum_stream_t {
+public:
+    orderby_datum_stream_t(counted_t<datum_stream_t> _source, order_funcs_t &&_funcs,
+                           const protob_t<const Backtrace> &bt_src);
+
+    virtual counted_t<datum_stream_t> slice(size_t l, size_t r);
+    virtual bool is_exhausted() const;
+
+private:
+    virtual bool is_array();
+    virtual std::vector<counted_t<const datum_t> >
+    next_batch_impl(env_t *env, const batchspec_t &batchspec);
+
+    counted_t<datum_stream_t> sort(env_t *env);
+
+    counted_t<datum_stream_t> source;
+    const order_funcs_t funcs;
+    // How many rows anyone is going to read, if a slice says so.
+    size_t limit;
+    // The sorted rows, once the stream has been read.
+    counted_t<datum_stream_t> sorted;
+};
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_EXTERNAL_SORT_HPP_
@@ -0,0 +1,640 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "rdb_protocol/filter_program.hpp"
+
+#include <math.h>
+
+#include <re2/re2.h>
+
+#include "rdb_protocol/func.hpp"
+#include "rdb_protocol/ql2.pb.h"
+#include "rdb_protocol/terms/terms.hpp"
+
+namespace ql {
+
+class filter_program_compiler_t : public func_visitor_t {
+public:
+    filter_program_compiler_t() { }
+
+    void on_reql_func(const reql_func_t *reql_func) {
+        if (reql_func->arg_names.size() != 1) {
+            return;
+        }
+        const protob_t<const Term> body = reql_func->body->get_src();
+        // The interpreter matches objects that come out of literals against the
+        // row instead, see reql_func_t::filter_helper().
+        if (body->type() == Term::MAKE_OBJ || body->type() == Term::DATUM) {
+            return;
+        }
+
+        scoped_ptr_t<filter_program_t> res(new filter_program_t);
+        res->num_registers = 1;
+        try {
+            if (!compile_term(*body, static_cast<double>(reql_func->arg_names[0].value),
+                              0, res.get())) {
+                return;
+            }
+        } catch (const base_exc_t &) {
+            // From a literal, the interpreter reports that.
+            return;
+        }
+        program.init(res.release());
+    }
+
+    void on_js_func(const js_func_t *) { }
+
+    scoped_ptr_t<filter_program_t> program;
+
+private:
+    // Emits the instructions to compute `t` into register `dest`.  The implicit
+    // variable is the row, there are no nested functions to bind it otherwise.
+    static bool compile_term(const Term &t, double var, size_t dest,
+                             filter_program_t *prog) {
+        if (t.optargs_size() != 0) {
+            return false;
+        }
+        filter_program_t::instruction_t instr;
+        instr.dest = dest;
+        instr.first_src = prog->num_registers;
+        instr.num_srcs = 0;
+        instr.operand = 0;
+        // How many of the arguments of `t` are sources.
+        int num_srcs = t.args_size();
+
+        if (t.type() == Term::IMPLICIT_VAR) {
+            instr.opcode = filter_program_t::LOAD_ROW;
+            num_srcs = 0;
+        } else if (t.type() == Term::VAR) {
+            if (t.args_size() != 1
+                || t.args(0).type() != Term::DATUM
+                || t.args(0).datum().type() != Datum::R_NUM
+                || t.args(0).datum().r_num() != var) {
+                return false;
+            }
+            instr.opcode = filter_program_t::LOAD_ROW;
+            num_srcs = 0;
+        } else if (t.type() == Term::DATUM) {
+            instr.opcode = filter_program_t::LOAD_CONSTANT;
+            instr.operand = prog->constants.size();
+            prog->constants.push_back(make_counted<const datum_t>(&t.datum()));
+            num_srcs = 0;
+        } else if (t.type() == Term::GET_FIELD) {
+            if (t.args_size() != 2 || !is_string_literal(t.args(1))) {
+                return false;
+            }
+            instr.opcode = filter_program_t::GET_FIELD;
+            instr.field = t.args(1).datum().r_str();
+            num_srcs = 1;
+        } else if (t.type() == Term::MATCH) {
+            if (t.args_size() != 2 || !is_string_literal(t.args(1))) {
+                return false;
+            }
+            scoped_ptr_t<RE2> regexp(new RE2(t.args(1).datum().r_str()));
+            if (!regexp->ok()) {
+                return false;
+            }
+            instr.opcode = filter_program_t::MATCH;
+            instr.operand = prog->regexps.size();
+            prog->regexps.push_back(regexp.release());
+            num_srcs = 1;
+        } else {
+            const generic_term_t *generic = find_generic_term(t.type());
+            if (generic == NULL || t.args_size() < generic->min_args
+                || (generic->max_args != -1 && t.args_size() > generic->max_args)) {
+                return false;
+            }
+            instr.opcode = generic->opcode;
+        }
+
+        instr.num_srcs = num_srcs;
+        prog->num_registers += num_srcs;
+        for (int i = 0; i < num_srcs; ++i) {
+            if (!compile_term(t.args(i), var, instr.first_src + i, prog)) {
+                return false;
+            }
+        }
+        prog->instructions.push_back(instr);
+        return true;
+    }
+
+    // The terms that turn into a single instruction over all of their arguments.
+    struct generic_term_t {
+        Term::TermType type;
+        filter_program_t::opcode_t opcode;
+        int min_args;
+        // -1 for no limit.
+        int max_args;
+    };
+
+    static const generic_term_t *find_generic_term(Term::TermType type) {
+        static const generic_term_t generic_terms[] = {
+            { Term::MAKE_ARRAY, filter_program_t::MAKE_ARRAY, 0, -1 },
+            { Term::EQ, filter_program_t::EQ, 2, -1 },
+            { Term::NE, filter_program_t::NE, 2, -1 },
+            { Term::LT, filter_program_t::LT, 2, -1 },
+            { Term::LE, filter_program_t::LE, 2, -1 },
+            { Term::GT, filter_program_t::GT, 2, -1 },
+            { Term::GE, filter_program_t::GE, 2, -1 },
+            { Term::NOT, filter_program_t::NOT, 1, 1 },
+            { Term::ALL, filter_program_t::ALL, 1, -1 },
+            { Term::ANY, filter_program_t::ANY, 1, -1 },
+            { Term::ADD, filter_program_t::ADD, 1, -1 },
+            { Term::SUB, filter_program_t::SUB, 1, -1 },
+            { Term::MUL, filter_program_t::MUL, 1, -1 },
+            { Term::DIV, filter_program_t::DIV, 1, -1 },
+            { Term::CONTAINS, filter_program_t::CONTAINS, 2, -1 }
+        };
+        for (size_t i = 0; i < sizeof(generic_terms) / sizeof(generic_terms[0]); ++i) {
+            if (generic_terms[i].type == type) {
+                return &generic_terms[i];
+            }
+        }
+        return NULL;
+    }
+
+    static bool is_string_literal(const Term &t) {
+        return t.type() == Term::DATUM && t.datum().type() == Datum::R_STR;
+    }
+};
+
+filter_program_t::filter_program_t() : num_registers(0) { }
+
+filter_program_t::~filter_program_t() { }
+
+filter_program_t *filter_program_t::compile(const counted_t<func_t> &func) {
+    filter_program_compiler_t compiler;
+    func->visit(&compiler);
+    return compiler.program.release();
+}
+
+bool filter_program_t::eval(const counted_t<const datum_t> &row, bool *passes_out) const {
+    std::vector<counted_t<const datum_t> > registers(num_registers);
+    try {
+        for (auto it = instructions.begin(); it != instructions.end(); ++it) {
+            if (!execute(*it, row, registers.data() + it->first_src,
+                         &registers[it->dest])) {
+                return false;
+            }
+        }
+    } catch (const base_exc_t &) {
+        return false;
+    }
+    *passes_out = registers[0]->as_bool();
+    return true;
+}
+
+bool filter_program_t::execute(const instruction_t &instr,
+                               const counted_t<const datum_t> &row,
+                               const counted_t<const datum_t> *srcs,
+                               counted_t<const datum_t> *dest) const {
+    switch (instr.opcode) {
+    case LOAD_ROW: {
+        *dest = row;
+    } break;
+    case LOAD_CONSTANT: {
+        *dest = constants[instr.operand];
+    } break;
+    case GET_FIELD: {
+        if (srcs[0]->get_type() != datum_t::R_OBJECT) {
+            return false;
+        }
+        *dest = srcs[0]->get(instr.field, NOTHROW);
+        if (!dest->has()) {
+            return false;
+        }
+    } break;
+    case MAKE_ARRAY: {
+        std::vector<counted_t<const datum_t> > items(srcs, srcs + instr.num_srcs);
+        *dest = make_counted<const datum_t>(std::move(items));
+    } break;
+    case EQ: case NE: case LT: case LE: case GT: case GE: {
+        // Like predicate_term_t: `ne` is `not eq`, the others hold for every
+        // pair of neighbours.
+        bool holds = true;
+        for (size_t i = 1; holds && i < instr.num_srcs; ++i) {
+            const int cmp = srcs[i - 1]->cmp(*srcs[i]);
+            if (instr.opcode == EQ || instr.opcode == NE) {
+                holds = cmp == 0;
+            } else if (instr.opcode == LT) {
+                holds = cmp < 0;
+            } else if (instr.opcode == LE) {
+                holds = cmp <= 0;
+            } else if (instr.opcode == GT) {
+                holds = cmp > 0;
+            } else {
+                rassert(instr.opcode == GE);
+                holds = cmp >= 0;
+            }
+        }
+        *dest = make_counted<const datum_t>(datum_t::R_BOOL,
+                                            instr.opcode == NE ? !holds : holds);
+    } break;
+    case NOT: {
+        *dest = make_counted<const datum_t>(datum_t::R_BOOL, !srcs[0]->as_bool());
+    } break;
+    case ALL: {
+        // The first false one, or the last one.
+        size_t i = 0;
+        while (i + 1 < instr.num_srcs && srcs[i]->as_bool()) {
+            ++i;
+        }
+        *dest = srcs[i];
+    } break;
+    case ANY: {
+        // The first true one, or false.
+        *dest = counted_t<const datum_t>();
+        for (size_t i = 0; i < instr.num_srcs && !dest->has(); ++i) {
+            if (srcs[i]->as_bool()) {
+                *dest = srcs[i];
+            }
+        }
+        if (!dest->has()) {
+            *dest = make_counted<const datum_t>(datum_t::R_BOOL, false);
+        }
+    } break;
+    case ADD: case SUB: case MUL: case DIV: {
+        if (instr.num_srcs == 1) {
+            *dest = srcs[0];
+            break;
+        }
+        // Anything but numbers means strings, arrays or times, or errors.
+        for (size_t i = 0; i < instr.num_srcs; ++i) {
+            if (srcs[i]->get_type() != datum_t::R_NUM) {
+                return false;
+            }
+        }
+        double acc = srcs[0]->as_num();
+        for (size_t i = 1; i < instr.num_srcs; ++i) {
+            const double rhs = srcs[i]->as_num();
+            if (instr.opcode == ADD) {
+                acc += rhs;
+            } else if (instr.opcode == SUB) {
+                acc -= rhs;
+            } else if (instr.opcode == MUL) {
+                acc *= rhs;
+            } else {
+                rassert(instr.opcode == DIV);
+                if (rhs == 0) {
+                    return false;
+                }
+                acc /= rhs;
+            }
+            // Throws on non-finite results, like the interpreter.
+            *dest = make_counted<const datum_t>(acc);
+        }
+    } break;
+    case CONTAINS: {
+        if (srcs[0]->get_type() != datum_t::R_ARRAY) {
+            return false;
+        }
+        // Bag semantics, like contains_term_t.
+        std::vector<counted_t<const datum_t> > required(srcs + 1, srcs + instr.num_srcs);
+        const std::vector<counted_t<const datum_t> > &items = srcs[0]->as_array();
+        for (auto it = items.begin(); it != items.end() && !required.empty(); ++it) {
+            for (auto jt = required.begin(); jt != required.end(); ++jt) {
+                if (**jt == **it) {
+                    std::swap(*jt, required.back());
+                    required.pop_back();
+                    break;
+                }
+            }
+        }
+        *dest = make_counted<const datum_t>(datum_t::R_BOOL, required.empty());
+    } break;
+    case MATCH: {
+        if (srcs[0]->get_type() != datum_t::R_STR) {
+            return false;
+        }
+        *dest = match_regexp(regexps[instr.operand], srcs[0]->as_str());
+    } break;
+    default: unreachable();
+    }
+    return true;
+}
+
+struct filter_program_t::column_t {
+    enum kind_t { DATUMS, NUMBERS, BOOLS };
+
+    column_t() : kind(DATUMS) { }
+
+    void reset(kind_t _kind, size_t size) {
+        kind = _kind;
+        datums.clear();
+        numbers.clear();
+        bools.clear();
+        if (kind == DATUMS) {
+            datums.resize(size);
+        } else if (kind == NUMBERS) {
+            numbers.resize(size);
+        } else {
+            rassert(kind == BOOLS);
+            bools.resize(size);
+        }
+    }
+
+    // True if the value of every row that hasn't failed is a number.
+    bool all_numbers(const std::vector<char> &failed) const {
+        if (kind != DATUMS) {
+            return kind == NUMBERS;
+        }
+        for (size_t i = 0; i < datums.size(); ++i) {
+            if (!failed[i] && datums[i]->get_type() != datum_t::R_NUM) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Boxes the values of the rows that haven't failed.
+    void to_datums(const std::vector<char> &failed) {
+        if (kind == NUMBERS) {
+            std::vector<double> values;
+            values.swap(numbers);
+            reset(DATUMS, values.size());
+            for (size_t i = 0; i < values.size(); ++i) {
+                if (!failed[i]) {
+                    datums[i] = make_counted<const datum_t>(values[i]);
+                }
+            }
+        } else if (kind == BOOLS) {
+            std::vector<char> values;
+            values.swap(bools);
+            reset(DATUMS, values.size());
+            for (size_t i = 0; i < values.size(); ++i) {
+                if (!failed[i]) {
+                    datums[i] = make_counted<const datum_t>(datum_t::R_BOOL, values[i] != 0);
+                }
+            }
+        }
+    }
+
+    // Unboxes the numbers, the rows that have anything else fail.
+    void to_numbers(std::vector<char> *failed) {
+        if (kind == NUMBERS) {
+            return;
+        }
+        const size_t size = failed->size();
+        std::vector<counted_t<const datum_t> > values;
+        values.swap(datums);
+        const bool were_datums = kind == DATUMS;
+        reset(NUMBERS, size);
+        for (size_t i = 0; i < size; ++i) {
+            if ((*failed)[i]) {
+                continue;
+            }
+            if (were_datums && values[i]->get_type() == datum_t::R_NUM) {
+                numbers[i] = values[i]->as_num();
+            } else {
+                (*failed)[i] = 1;
+            }
+        }
+    }
+
+    // Replaces the values with their truthiness.
+    void to_bools(const std::vector<char> &failed) {
+        if (kind == BOOLS) {
+            return;
+        }
+        const size_t size = failed.size();
+        std::vector<counted_t<const datum_t> > values;
+        values.swap(datums);
+        const bool were_numbers = kind == NUMBERS;
+        reset(BOOLS, size);
+        for (size_t i = 0; i < size; ++i) {
+            bools[i] = were_numbers || (!failed[i] && values[i]->as_bool());
+        }
+    }
+
+    kind_t kind;
+    std::vector<counted_t<const datum_t> > datums;
+    std::vector<double> numbers;
+    std::vector<char> bools;
+};
+
+void filter_program_t::eval_batch(const std::vector<counted_t<const datum_t> > &rows,
+                                  std::vector<bool> *passes_out,
+                                  std::vector<bool> *known_out) const {
+    column_t result;
+    std::vector<char> failed;
+    run_batch(rows, &result, &failed);
+    result.to_bools(failed);
+    passes_out->assign(rows.size(), false);
+    known_out->assign(rows.size(), false);
+    for (size_t i = 0; i < rows.size(); ++i) {
+        if (!failed[i]) {
+            (*passes_out)[i] = result.bools[i] != 0;
+            (*known_out)[i] = true;
+        }
+    }
+}
+
+void filter_program_t::eval_batch(const std::vector<counted_t<const datum_t> > &rows,
+                                  std::vector<counted_t<const datum_t> > *results_out) const {
+    column_t result;
+    std::vector<char> failed;
+    run_batch(rows, &result, &failed);
+    result.to_datums(failed);
+    results_out->clear();
+    results_out->resize(rows.size());
+    for (size_t i = 0; i < rows.size(); ++i) {
+        if (!failed[i]) {
+            (*results_out)[i] = std::move(result.datums[i]);
+        }
+    }
+}
+
+void filter_program_t::run_batch(const std::vector<counted_t<const datum_t> > &rows,
+                                 column_t *result_out,
+                                 std::vector<char> *failed_out) const {
+    std::vector<column_t> columns(num_registers);
+    failed_out->assign(rows.size(), 0);
+    for (auto it = instructions.begin(); it != instructions.end(); ++it) {
+        execute_batch(*it, rows, &columns, failed_out);
+    }
+    std::swap(*result_out, columns[0]);
+}
+
+void filter_program_t::execute_batch(const instruction_t &instr,
+                                     const std::vector<counted_t<const datum_t> > &rows,
+                                     std::vector<column_t> *columns,
+                                     std::vector<char> *failed) const {
+    const size_t n = rows.size();
+    column_t *srcs = columns->data() + instr.first_src;
+    column_t *dest = &(*columns)[instr.dest];
+
+    switch (instr.opcode) {
+    case LOAD_ROW: {
+        dest->reset(column_t::DATUMS, 0);
+        dest->datums = rows;
+    } break;
+    case LOAD_CONSTANT: {
+        const counted_t<const datum_t> &constant = constants[instr.operand];
+        if (constant->get_type() == datum_t::R_NUM) {
+            dest->reset(column_t::NUMBERS, 0);
+            dest->numbers.assign(n, constant->as_num());
+        } else if (constant->get_type() == datum_t::R_BOOL) {
+            dest->reset(column_t::BOOLS, 0);
+            dest->bools.assign(n, constant->as_bool());
+        } else {
+            dest->reset(column_t::DATUMS, 0);
+            dest->datums.assign(n, constant);
+        }
+    } break;
+    case GET_FIELD: {
+        srcs[0].to_datums(*failed);
+        dest->reset(column_t::DATUMS, n);
+        for (size_t i = 0; i < n; ++i) {
+            if ((*failed)[i]) {
+                continue;
+            }
+            const counted_t<const datum_t> &obj = srcs[0].datums[i];
+            if (obj->get_type() == datum_t::R_OBJECT) {
+                dest->datums[i] = obj->get(instr.field, NOTHROW);
+            }
+            if (!dest->datums[i].has()) {
+                (*failed)[i] = 1;
+            }
+        }
+    } break;
+    case EQ: case NE: case LT: case LE: case GT: case GE: {
+        dest->reset(column_t::BOOLS, 0);
+        dest->bools.assign(n, 1);
+        char *holds = dest->bools.data();
+        bool numeric = true;
+        for (size_t j = 0; j < instr.num_srcs; ++j) {
+            numeric = numeric && srcs[j].all_numbers(*failed);
+        }
+        for (size_t j = 1; j < instr.num_srcs; ++j) {
+            if (numeric) {
+                srcs[j - 1].to_numbers(failed);
+                srcs[j].to_numbers(failed);
+                const double *lhs = srcs[j - 1].numbers.data();
+                const double *rhs = srcs[j].numbers.data();
+                // A loop of its own for every operator, so they vectorize.
+                if (instr.opcode == EQ || instr.opcode == NE) {
+                    for (size_t i = 0; i < n; ++i) { holds[i] &= lhs[i] == rhs[i]; }
+                } else if (instr.opcode == LT) {
+                    for (size_t i = 0; i < n; ++i) { holds[i] &= lhs[i] < rhs[i]; }
+                } else if (instr.opcode == LE) {
+                    for (size_t i = 0; i < n; ++i) { holds[i] &= lhs[i] <= rhs[i]; }
+                } else if (instr.opcode == GT) {
+                    for (size_t i = 0; i < n; ++i) { holds[i] &= lhs[i] > rhs[i]; }
+                } else {
+                    rassert(instr.opcode == GE);
+                    for (size_t i = 0; i < n; ++i) { holds[i] &= lhs[i] >= rhs[i]; }
+                }
+            } else {
+                srcs[j - 1].to_datums(*failed);
+                srcs[j].to_datums(*failed);
+                for (size_t i = 0; i < n; ++i) {
+                    if ((*failed)[i] || !holds[i]) {
+                        continue;
+                    }
+                    try {
+                        const int cmp = srcs[j - 1].datums[i]->cmp(*srcs[j].datums[i]);
+                        if (instr.opcode == EQ || instr.opcode == NE) {
+                            holds[i] = cmp == 0;
+                        } else if (instr.opcode == LT) {
+                            holds[i] = cmp < 0;
+                        } else if (instr.opcode == LE) {
+                            holds[i] = cmp <= 0;
+                        } else if (instr.opcode == GT) {
+                            holds[i] = cmp > 0;
+                        } else {
+                            rassert(instr.opcode == GE);
+                            holds[i] = cmp >= 0;
+                        }
+                    } catch (const base_exc_t &) {
+                        (*failed)[i] = 1;
+                    }
+                }
+            }
+        }
+        if (instr.opcode == NE) {
+            for (size_t i = 0; i < n; ++i) { holds[i] = !holds[i]; }
+        }
+    } break;
+    case NOT: {
+        srcs[0].to_bools(*failed);
+        dest->reset(column_t::BOOLS, n);
+        for (size_t i = 0; i < n; ++i) {
+            dest->bools[i] = !srcs[0].bools[i];
+        }
+    } break;
+    case ADD: case SUB: case MUL: case DIV: {
+        if (instr.num_srcs == 1) {
+            std::swap(*dest, srcs[0]);
+            break;
+        }
+        // Anything but numbers means strings, arrays or times, or errors, which
+        // the function does.
+        for (size_t j = 0; j < instr.num_srcs; ++j) {
+            srcs[j].to_numbers(failed);
+        }
+        std::swap(*dest, srcs[0]);
+        double *acc = dest->numbers.data();
+        char *fails = failed->data();
+        for (size_t j = 1; j < instr.num_srcs; ++j) {
+            const double *rhs = srcs[j].numbers.data();
+            if (instr.opcode == ADD) {
+                for (size_t i = 0; i < n; ++i) { acc[i] += rhs[i]; }
+            } else if (instr.opcode == SUB) {
+                for (size_t i = 0; i < n; ++i) { acc[i] -= rhs[i]; }
+            } else if (instr.opcode == MUL) {
+                for (size_t i = 0; i < n; ++i) { acc[i] *= rhs[i]; }
+            } else {
+                rassert(instr.opcode == DIV);
+                for (size_t i = 0; i < n; ++i) { acc[i] /= rhs[i]; }
+            }
+            // The interpreter throws on non-finite results, including the ones
+            // of dividing by zero.
+            using namespace std;  // NOLINT(build/namespaces)
+            for (size_t i = 0; i < n; ++i) { fails[i] |= !isfinite(acc[i]); }
+        }
+    } break;
+    case ALL: case ANY: {
+        bool all_bools = true;
+        for (size_t j = 0; j < instr.num_srcs; ++j) {
+            all_bools = all_bools && srcs[j].kind == column_t::BOOLS;
+        }
+        if (all_bools) {
+            std::swap(*dest, srcs[0]);
+            char *acc = dest->bools.data();
+            for (size_t j = 1; j < instr.num_srcs; ++j) {
+                const char *rhs = srcs[j].bools.data();
+                if (instr.opcode == ALL) {
+                    for (size_t i = 0; i < n; ++i) { acc[i] &= rhs[i]; }
+                } else {
+                    for (size_t i = 0; i < n; ++i) { acc[i] |= rhs[i]; }
+                }
+            }
+            break;
+        }
+    } // fallthrough
+    case MAKE_ARRAY: case CONTAINS: case MATCH: {
+        // One row at a time, like eval().
+        for (size_t j = 0; j < instr.num_srcs; ++j) {
+            srcs[j].to_datums(*failed);
+        }
+        dest->reset(column_t::DATUMS, n);
+        std::vector<counted_t<const datum_t> > args(instr.num_srcs);
+        for (size_t i = 0; i < n; ++i) {
+            if ((*failed)[i]) {
+                continue;
+            }
+            for (size_t j = 0; j < instr.num_srcs; ++j) {
+                args[j] = srcs[j].datums[i];
+            }
+            try {
+                if (!execute(instr, rows[i], args.data(), &dest->datums[i])) {
+                    (*failed)[i] = 1;
+                }
+            } catch (const base_exc_t &) {
+                (*failed)[i] = 1;
+            }
+        }
+    } break;
+    default: unreachable();
+    }
+}
+
+}  // namespace ql
@@ -0,0 +1,119 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_FILTER_PROGRAM_HPP_
+#define RDB_PROTOCOL_FILTER_PROGRAM_HPP_
+
+#include <string>
+#include <vector>
+
+#include "errors.hpp"
+#include <boost/ptr_container/ptr_vector.hpp>
+
+#include "containers/counted.hpp"
+#include "containers/scoped.hpp"
+#include "rdb_protocol/datum.hpp"
+
+namespace re2 {
+class RE2;
+}  // namespace re2
+
+namespace ql {
+
+class func_t;
+
+/* A filter predicate compiled to a flat list of instructions over registers, so
+that a range read can test documents against it without going through the term
+tree, val_t and the scope of the interpreter for every one of them.  Only the
+common subset of predicates compiles: the row, its fields, literals, comparisons,
+`not`, `and`, `or`, arithmetic, `contains` and `match` against a literal pattern.
+
+The map and filter streams run programs over whole batches of rows instead, one
+instruction at a time for all of the rows.  Each register then holds a column with
+a value for every row, and numbers and booleans stay unboxed in plain arrays, so
+arithmetic and comparisons are simple loops that don't allocate a datum for every
+intermediate result.  The same program works for a function that `map` calls.
+
+A program only handles the normal case.  Whenever the interpreter would do
+something out of the ordinary (a missing field, a type error, dividing by zero,
+getting a field of an array, which maps over it), the program gives up and the
+function has to be called, so the result and errors stay exactly the same. */
+class filter_program_t {
+public:
+    ~filter_program_t();
+
+    // Returns NULL if `func` uses anything a program doesn't support.
+    static filter_program_t *compile(const counted_t<func_t> &func);
+
+    // Sets `*passes_out` to whether `row` passes the filter.  Returns false if the
+    // program can't tell, see above.
+    MUST_USE bool eval(const counted_t<const datum_t> &row, bool *passes_out) const;
+
+    // Like eval() on every one of `rows`.  `(*known_out)[i]` is false for the rows
+    // the program can't tell about.
+    void eval_batch(const std::vector<counted_t<const datum_t> > &rows,
+                    std::vector<bool> *passes_out, std::vector<bool> *known_out) const;
+
+    // Sets `(*results_out)[i]` to what the function returns for `rows[i]`, or to an
+    // empty pointer if the program can't tell.
+    void eval_batch(const std::vector<counted_t<const datum_t> > &rows,
+                    std::vector<counted_t<const datum_t> > *results_out) const;
+
+private:
+    friend class filter_program_compiler_t;
+
+    // A register's values for every row of a batch.
+    struct column_t;
+
+    enum opcode_t {
+        LOAD_ROW,
+        LOAD_CONSTANT,
+        GET_FIELD,
+        MAKE_ARRAY,
+        EQ, NE, LT, LE, GT, GE,
+        NOT,
+        ALL,
+        ANY,
+        ADD, SUB, MUL, DIV,
+        CONTAINS,
+        MATCH
+    };
+
+    // Sets register `dest` out of the `num_srcs` registers from `first_src` on.
+    struct instruction_t {
+        opcode_t opcode;
+        size_t dest;
+        size_t first_src;
+        size_t num_srcs;
+        // The index into `constants` for LOAD_CONSTANT, or `regexps` for MATCH.
+        size_t operand;
+        // The field for GET_FIELD.
+        std::string field;
+    };
+
+    filter_program_t();
+
+    // Computes `*dest` out of `instr.num_srcs` values from `srcs` on.
+    MUST_USE bool execute(const instruction_t &instr, const counted_t<const datum_t> &row,
+                          const counted_t<const datum_t> *srcs,
+                          counted_t<const datum_t> *dest) const;
+
+    // Runs the program over `rows`, leaving register 0 in `*result_out`.  Sets the
+    // rows the program gives up on in `*failed_out`.
+    void run_batch(const std::vector<counted_t<const datum_t> > &rows,
+                   column_t *result_out, std::vector<char> *failed_out) const;
+    void execute_batch(const instruction_t &instr,
+                       const std::vector<counted_t<const datum_t> > &rows,
+                       std::vector<column_t> *columns, std::vector<char> *failed) const;
+
+    // Instructions come after the ones that set their sources, register 0 holds
+    // the result.
+    std::vector<instruction_t> instructions;
+    size_t num_registers;
+    std::vector<counted_t<const datum_t> > constants;
+    boost::ptr_vector<re2::RE2> regexps;
+
+    DISABLE_COPYING(filter_program_t);
+};
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_FILTER_PROGRAM_HPP_
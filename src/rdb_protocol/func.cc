@@ -1,5 +1,10 @@
 #include "rdb_protocol/func.hpp"
 
+#include <set>
+
+#include "errors.hpp"
+#include <boost/bind.hpp>
+
 #include "rdb_protocol/counted_term.hpp"
 #include "rdb_protocol/env.hpp"
 #include "rdb_protocol/minidriver.hpp"
@@ -169,7 +174,7 @@ func_term_t::func_term_t(compile_env_t *env, const protob_t<const Term> &t)
 
     var_visibility_t varname_visibility = env->visibility.with_func_arg_name_list(args);
 
-    compile_env_t body_env(std::move(varname_visibility));
+    compile_env_t body_env(std::move(varname_visibility), env->datum_terms);
 
     protob_t<const Term> body_source = t.make_child(&t->args(1));
     counted_t<term_t> compiled_body = compile_term(&body_env, body_source);
@@ -216,7 +221,7 @@ bool filter_match(counted_t<const datum_t> predicate, counted_t<const datum_t> v
     if (predicate->is_ptype(pseudo::literal_string)) {
         return *predicate->get(pseudo::value_key) == *value;
     } else {
-        const std::map<std::string, counted_t<const datum_t> > &obj = predicate->as_object();
+        const datum_object_t &obj = predicate->as_object();
         for (auto it = obj.begin(); it != obj.end(); ++it) {
             r_sanity_check(it->second.has());
             counted_t<const datum_t> elt = value->get(it->first, NOTHROW);
@@ -270,13 +275,20 @@ bool js_func_t::filter_helper(env_t *env, counted_t<const datum_t> arg) const {
 }
 
 bool func_t::filter_call(env_t *env, counted_t<const datum_t> arg, counted_t<func_t> default_filter_val) const {
+    return filter_or_default(env, boost::bind(&func_t::filter_helper, this, env, arg),
+                             default_filter_val);
+}
+
+bool func_t::filter_or_default(env_t *env,
+                               const boost::function<bool()> &filter,
+                               counted_t<func_t> default_filter_val) const {
     // We have to catch every exception type and save it so we can rethrow it later
     // So we don't trigger a coroutine wait in a catch statement
     std::exception_ptr saved_exception;
     base_exc_t::type_t exception_type;
 
     try {
-        return filter_helper(env, arg);
+        return filter();
     } catch (const base_exc_t &e) {
         saved_exception = std::current_exception();
         exception_type = e.get_type();
@@ -313,6 +325,93 @@ bool func_t::filter_call(env_t *env, counted_t<const datum_t> arg, counted_t<fun
     std::rethrow_exception(saved_exception);
 }
 
+std::vector<counted_t<const datum_t> > func_t::call_batch(
+    env_t *env, const std::vector<counted_t<const datum_t> > &args) const {
+    std::vector<counted_t<const datum_t> > results;
+    results.reserve(args.size());
+    for (auto it = args.begin(); it != args.end(); ++it) {
+        results.push_back(call(env, *it)->as_datum());
+    }
+    return results;
+}
+
+std::vector<bool> func_t::filter_call_batch(
+    env_t *env,
+    const std::vector<counted_t<const datum_t> > &args,
+    counted_t<func_t> default_filter_val) const {
+    std::vector<bool> results;
+    results.reserve(args.size());
+    for (auto it = args.begin(); it != args.end(); ++it) {
+        results.push_back(filter_call(env, *it, default_filter_val));
+    }
+    return results;
+}
+
+std::vector<js_result_t> js_func_t::call_js_batch(
+    env_t *env, const std::vector<counted_t<const datum_t> > &args) const {
+    js_runner_t::req_config_t config;
+    config.timeout_ms = js_timeout_ms;
+
+    r_sanity_check(!js_source.empty());
+    std::vector<std::vector<counted_t<const datum_t> > > args_batch;
+    args_batch.reserve(args.size());
+    for (auto it = args.begin(); it != args.end(); ++it) {
+        args_batch.push_back(make_vector(*it));
+    }
+
+    try {
+        return env->get_js_runner()->call_batch(js_source, args_batch, config);
+    } catch (const js_worker_exc_t &e) {
+        rfail(base_exc_t::GENERIC,
+              "Javascript query `%s` caused a crash in a worker process.",
+              js_source.c_str());
+    } catch (const interrupted_exc_t &e) {
+        rfail(base_exc_t::GENERIC,
+              "JavaScript query `%s` timed out after %" PRIu64 ".%03" PRIu64 " seconds.",
+              js_source.c_str(), js_timeout_ms / 1000, js_timeout_ms % 1000);
+    }
+}
+
+counted_t<val_t> js_func_t::result_val(const js_result_t &result) const {
+    try {
+        return boost::apply_visitor(js_result_visitor_t(js_source, js_timeout_ms, this),
+                                    result);
+    } catch (const datum_exc_t &e) {
+        rfail(e.get_type(), "%s", e.what());
+        unreachable();
+    }
+}
+
+bool js_func_t::filter_result(const js_result_t *result) const {
+    return result_val(*result)->as_datum()->as_bool();
+}
+
+std::vector<counted_t<const datum_t> > js_func_t::call_batch(
+    env_t *env, const std::vector<counted_t<const datum_t> > &args) const {
+    std::vector<js_result_t> js_results = call_js_batch(env, args);
+    std::vector<counted_t<const datum_t> > results;
+    results.reserve(js_results.size());
+    for (auto it = js_results.begin(); it != js_results.end(); ++it) {
+        results.push_back(result_val(*it)->as_datum());
+    }
+    return results;
+}
+
+std::vector<bool> js_func_t::filter_call_batch(
+    env_t *env,
+    const std::vector<counted_t<const datum_t> > &args,
+    counted_t<func_t> default_filter_val) const {
+    std::vector<js_result_t> js_results = call_js_batch(env, args);
+    std::vector<bool> results;
+    results.reserve(js_results.size());
+    for (auto it = js_results.begin(); it != js_results.end(); ++it) {
+        results.push_back(filter_or_default(
+            env, boost::bind(&js_func_t::filter_result, this, &*it),
+            default_filter_val));
+    }
+    return results;
+}
+
 counted_t<func_t> new_constant_func(counted_t<const datum_t> obj,
                                     const protob_t<const Backtrace> &bt_src) {
     protob_t<Term> twrap = r::fun(r::expr(obj)).release_counted();
@@ -349,6 +448,458 @@ counted_t<func_t> new_pluck_func(counted_t<const datum_t> obj,
     return func_term->eval_to_func(var_scope_t());
 }
 
+class field_projection_visitor_t : public func_visitor_t {
+public:
+    explicit field_projection_visitor_t(std::vector<std::string> *_fields_out)
+        : fields_out(_fields_out), result(false) { }
+
+    void on_reql_func(const reql_func_t *reql_func) {
+        if (reql_func->arg_names.size() != 1) {
+            return;
+        }
+        const protob_t<const Term> body = reql_func->body->get_src();
+        if (body->type() != Term::PLUCK && body->type() != Term::GET_FIELD) {
+            return;
+        }
+        if (body->args_size() < 2
+            || (body->type() == Term::GET_FIELD && body->args_size() != 2)) {
+            return;
+        }
+        for (int i = 0; i < body->optargs_size(); ++i) {
+            if (body->optargs(i).key() != "_NO_RECURSE_") {
+                return;
+            }
+        }
+
+        const Term &obj = body->args(0);
+        if (obj.type() != Term::VAR || obj.args_size() != 1
+            || obj.args(0).type() != Term::DATUM
+            || obj.args(0).datum().type() != Datum::R_NUM
+            || obj.args(0).datum().r_num()
+               != static_cast<double>(reql_func->arg_names[0].value)) {
+            return;
+        }
+
+        std::vector<std::string> fields;
+        for (int i = 1; i < body->args_size(); ++i) {
+            const Term &field = body->args(i);
+            if (field.type() != Term::DATUM || field.datum().type() != Datum::R_STR) {
+                return;
+            }
+            fields.push_back(field.datum().r_str());
+        }
+        fields_out->swap(fields);
+        result = true;
+    }
+
+    void on_js_func(const js_func_t *) { }
+
+    std::vector<std::string> *const fields_out;
+    bool result;
+};
+
+bool func_only_reads_fields(const counted_t<func_t> &func,
+                            std::vector<std::string> *fields_out) {
+    field_projection_visitor_t visitor(fields_out);
+    func->visit(&visitor);
+    return visitor.result;
+}
+
+class top_level_fields_visitor_t : public func_visitor_t {
+public:
+    explicit top_level_fields_visitor_t(std::vector<std::string> *_fields_out)
+        : fields_out(_fields_out), result(false) { }
+
+    void on_reql_func(const reql_func_t *reql_func) {
+        if (reql_func->arg_names.size() != 1) {
+            return;
+        }
+        std::set<std::string> fields;
+        if (!collect_fields(*reql_func->body->get_src(),
+                            static_cast<double>(reql_func->arg_names[0].value),
+                            0, &fields)) {
+            return;
+        }
+        fields_out->assign(fields.begin(), fields.end());
+        result = true;
+    }
+
+    void on_js_func(const js_func_t *) { }
+
+    std::vector<std::string> *const fields_out;
+    bool result;
+
+private:
+    // The implicit variable is the argument too, unless it's in a nested function.
+    static bool is_arg(const Term &t, double var, int func_depth) {
+        if (t.type() == Term::IMPLICIT_VAR) {
+            return func_depth == 0;
+        }
+        return t.type() == Term::VAR
+            && t.args_size() == 1
+            && t.args(0).type() == Term::DATUM
+            && t.args(0).datum().type() == Datum::R_NUM
+            && t.args(0).datum().r_num() == var;
+    }
+
+    static bool collect_fields(const Term &t, double var, int func_depth,
+                               std::set<std::string> *fields) {
+        if ((t.type() == Term::GET_FIELD || t.type() == Term::HAS_FIELDS
+             || t.type() == Term::PLUCK)
+            && t.args_size() >= 2 && is_arg(t.args(0), var, func_depth)) {
+            if (t.type() == Term::GET_FIELD && t.args_size() != 2) {
+                return false;
+            }
+            for (int i = 1; i < t.args_size(); ++i) {
+                const Term &field = t.args(i);
+                if (field.type() != Term::DATUM || field.datum().type() != Datum::R_STR) {
+                    return false;
+                }
+                fields->insert(field.datum().r_str());
+            }
+        } else if (t.type() == Term::IMPLICIT_VAR || is_arg(t, var, func_depth)) {
+            // The argument as a whole, or an implicit variable we can't tell apart
+            // from the one of a nested function.
+            return false;
+        } else {
+            const int arg_depth = func_depth + (t.type() == Term::FUNC ? 1 : 0);
+            for (int i = 0; i < t.args_size(); ++i) {
+                if (!collect_fields(t.args(i), var, arg_depth, fields)) {
+                    return false;
+                }
+            }
+        }
+        for (int i = 0; i < t.optargs_size(); ++i) {
+            if (!collect_fields(t.optargs(i).val(), var, func_depth, fields)) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+bool func_reads_top_level_fields(const counted_t<func_t> &func,
+                                 std::vector<std::string> *fields_out) {
+    top_level_fields_visitor_t visitor(fields_out);
+    func->visit(&visitor);
+    return visitor.result;
+}
+
+class pluck_fields_visitor_t : public func_visitor_t {
+public:
+    explicit pluck_fields_visitor_t(std::vector<std::string> *_fields_out)
+        : fields_out(_fields_out), result(false) { }
+
+    void on_reql_func(const reql_func_t *reql_func) {
+        if (reql_func->arg_names.size() != 1) {
+            return;
+        }
+        const Term &body = *reql_func->body->get_src();
+        if (body.type() != Term::PLUCK || body.args_size() < 2
+            || body.optargs_size() != 0) {
+            return;
+        }
+        const Term &obj = body.args(0);
+        if (obj.type() != Term::VAR || obj.args_size() != 1
+            || obj.args(0).type() != Term::DATUM
+            || obj.args(0).datum().type() != Datum::R_NUM
+            || obj.args(0).datum().r_num()
+               != static_cast<double>(reql_func->arg_names[0].value)) {
+            return;
+        }
+
+        std::set<std::string> fields;
+        for (int i = 1; i < body.args_size(); ++i) {
+            const Term &field = body.args(i);
+            if (field.type() != Term::DATUM) {
+                return;
+            }
+            const Datum &datum = field.datum();
+            if (datum.type() == Datum::R_STR) {
+                fields.insert(datum.r_str());
+            } else if (datum.type() == Datum::R_ARRAY) {
+                for (int j = 0; j < datum.r_array_size(); ++j) {
+                    if (datum.r_array(j).type() != Datum::R_STR) {
+                        return;
+                    }
+                    fields.insert(datum.r_array(j).r_str());
+                }
+            } else {
+                return;
+            }
+        }
+        fields_out->assign(fields.begin(), fields.end());
+        result = true;
+    }
+
+    void on_js_func(const js_func_t *) { }
+
+    std::vector<std::string> *const fields_out;
+    bool result;
+};
+
+bool func_plucks_top_level_fields(const counted_t<func_t> &func,
+                                  std::vector<std::string> *fields_out) {
+    pluck_fields_visitor_t visitor(fields_out);
+    func->visit(&visitor);
+    return visitor.result;
+}
+
+class field_values_visitor_t : public func_visitor_t {
+public:
+    explicit field_values_visitor_t(
+        std::vector<std::pair<std::string, counted_t<const datum_t> > > *_fields_out)
+        : fields_out(_fields_out) { }
+
+    void on_reql_func(const reql_func_t *reql_func) {
+        if (reql_func->arg_names.size() != 1) {
+            return;
+        }
+        const Term &body = *reql_func->body->get_src();
+        const double var = static_cast<double>(reql_func->arg_names[0].value);
+        std::vector<std::pair<std::string, counted_t<const datum_t> > > fields;
+        try {
+            if (body.type() == Term::MAKE_OBJ) {
+                // The row has to match every field, see filter_match().  Values
+                // other than literals get evaluated for every row.
+                if (body.args_size() != 0) {
+                    return;
+                }
+                for (int i = 0; i < body.optargs_size(); ++i) {
+                    if (body.optargs(i).val().type() != Term::DATUM) {
+                        return;
+                    }
+                    counted_t<const datum_t> value
+                        = make_counted<const datum_t>(&body.optargs(i).val().datum());
+                    if (is_field_value(value)) {
+                        fields.push_back(std::make_pair(body.optargs(i).key(), value));
+                    }
+                }
+            } else if (body.type() == Term::DATUM) {
+                counted_t<const datum_t> obj = make_counted<const datum_t>(&body.datum());
+                if (obj->get_type() != datum_t::R_OBJECT || obj->is_ptype()) {
+                    return;
+                }
+                const datum_object_t &fields_obj = obj->as_object();
+                for (auto it = fields_obj.begin(); it != fields_obj.end(); ++it) {
+                    if (is_field_value(it->second)) {
+                        fields.push_back(std::make_pair(it->first, it->second));
+                    }
+                }
+            } else {
+                collect_equalities(body, var, &fields);
+            }
+        } catch (const base_exc_t &) {
+            // From a literal, the interpreter reports that.
+            return;
+        }
+        fields_out->swap(fields);
+    }
+
+    void on_js_func(const js_func_t *) { }
+
+    std::vector<std::pair<std::string, counted_t<const datum_t> > > *const fields_out;
+
+private:
+    static bool is_field_value(const counted_t<const datum_t> &value) {
+        return value->get_type() == datum_t::R_NUM
+            || value->get_type() == datum_t::R_STR
+            || value->get_type() == datum_t::R_BOOL;
+    }
+
+    // Adds the equalities `t` requires, and returns whether that's all it does.
+    // `and` stops at its first false argument, so the arguments after the
+    // equalities only see the rows that have those values either way.
+    static bool collect_equalities(
+        const Term &t, double var,
+        std::vector<std::pair<std::string, counted_t<const datum_t> > > *fields) {
+        if (t.optargs_size() != 0) {
+            return false;
+        }
+        if (t.type() == Term::ALL) {
+            for (int i = 0; i < t.args_size(); ++i) {
+                if (!collect_equalities(t.args(i), var, fields)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        if (t.type() != Term::EQ || t.args_size() != 2) {
+            return false;
+        }
+        for (int i = 0; i < 2; ++i) {
+            const Term &field = t.args(i);
+            const Term &literal = t.args(1 - i);
+            if (field.type() != Term::GET_FIELD || field.args_size() != 2
+                || field.optargs_size() != 0 || !is_arg(field.args(0), var)
+                || field.args(1).type() != Term::DATUM
+                || field.args(1).datum().type() != Datum::R_STR
+                || literal.type() != Term::DATUM) {
+                continue;
+            }
+            counted_t<const datum_t> value = make_counted<const datum_t>(&literal.datum());
+            if (!is_field_value(value)) {
+                return false;
+            }
+            fields->push_back(std::make_pair(field.args(1).datum().r_str(), value));
+            return true;
+        }
+        return false;
+    }
+
+    // There are no nested functions in the terms we look at, so the implicit
+    // variable is the row too.
+    static bool is_arg(const Term &t, double var) {
+        if (t.type() == Term::IMPLICIT_VAR) {
+            return true;
+        }
+        return t.type() == Term::VAR
+            && t.args_size() == 1
+            && t.args(0).type() == Term::DATUM
+            && t.args(0).datum().type() == Datum::R_NUM
+            && t.args(0).datum().r_num() == var;
+    }
+};
+
+bool func_requires_field_values(
+    const counted_t<func_t> &func,
+    std::vector<std::pair<std::string, counted_t<const datum_t> > > *fields_out) {
+    fields_out->clear();
+    field_values_visitor_t visitor(fields_out);
+    func->visit(&visitor);
+    return !fields_out->empty();
+}
+
+class literal_null_visitor_t : public func_visitor_t {
+public:
+    literal_null_visitor_t() : result(false) { }
+
+    void on_reql_func(const reql_func_t *reql_func) {
+        const protob_t<const Term> body = reql_func->body->get_src();
+        result = reql_func->arg_names.size() == 1
+            && body->type() == Term::DATUM
+            && body->datum().type() == Datum::R_NULL;
+    }
+
+    void on_js_func(const js_func_t *) { }
+
+    bool result;
+};
+
+bool func_returns_literal_null(const counted_t<func_t> &func) {
+    literal_null_visitor_t visitor;
+    func->visit(&visitor);
+    return visitor.result;
+}
+
+class field_extractor_visitor_t : public func_visitor_t {
+public:
+    field_extractor_visitor_t() { }
+
+    void on_reql_func(const reql_func_t *reql_func) {
+        if (reql_func->arg_names.size() != 1) {
+            return;
+        }
+        const protob_t<const Term> body = reql_func->body->get_src();
+        const double var = static_cast<double>(reql_func->arg_names[0].value);
+
+        scoped_ptr_t<field_extractor_t> res(new field_extractor_t);
+        if (body->type() == Term::MAKE_ARRAY) {
+            if (body->args_size() == 0 || body->optargs_size() != 0) {
+                return;
+            }
+            res->make_array = true;
+            res->paths.resize(body->args_size());
+            for (int i = 0; i < body->args_size(); ++i) {
+                if (!parse_path(body->args(i), var, &res->paths[i])) {
+                    return;
+                }
+            }
+        } else {
+            res->paths.resize(1);
+            if (!parse_path(*body, var, &res->paths[0])) {
+                return;
+            }
+        }
+        extractor.init(res.release());
+    }
+
+    void on_js_func(const js_func_t *) { }
+
+    scoped_ptr_t<field_extractor_t> extractor;
+
+private:
+    // Parses `VAR(var)` (giving an empty path) or `GET_FIELD(<path>, "field")`.
+    static bool parse_path(const Term &t, double var, std::vector<std::string> *path_out) {
+        if (t.optargs_size() != 0) {
+            return false;
+        }
+        if (t.type() == Term::VAR) {
+            return t.args_size() == 1
+                && t.args(0).type() == Term::DATUM
+                && t.args(0).datum().type() == Datum::R_NUM
+                && t.args(0).datum().r_num() == var;
+        }
+        if (t.type() != Term::GET_FIELD || t.args_size() != 2
+            || t.args(1).type() != Term::DATUM
+            || t.args(1).datum().type() != Datum::R_STR
+            || !parse_path(t.args(0), var, path_out)) {
+            return false;
+        }
+        path_out->push_back(t.args(1).datum().r_str());
+        return true;
+    }
+};
+
+field_extractor_t *field_extractor_t::create(const counted_t<func_t> &func) {
+    field_extractor_visitor_t visitor;
+    func->visit(&visitor);
+    return visitor.extractor.release();
+}
+
+bool extract_field_path(const counted_t<const datum_t> &arg,
+                        const std::vector<std::string> &path,
+                        counted_t<const datum_t> *out) {
+    counted_t<const datum_t> d = arg;
+    for (auto it = path.begin(); it != path.end(); ++it) {
+        if (d->get_type() != datum_t::R_OBJECT) {
+            return false;
+        }
+        d = d->get(*it, NOTHROW);
+        if (!d.has()) {
+            return false;
+        }
+    }
+    *out = d;
+    return true;
+}
+
+bool field_extractor_t::extract(const counted_t<const datum_t> &arg,
+                                counted_t<const datum_t> *out) const {
+    if (!make_array) {
+        return extract_field_path(arg, paths[0], out);
+    }
+    std::vector<counted_t<const datum_t> > items;
+    items.reserve(paths.size());
+    for (auto it = paths.begin(); it != paths.end(); ++it) {
+        counted_t<const datum_t> item;
+        if (!extract_field_path(arg, *it, &item)) {
+            return false;
+        }
+        items.push_back(item);
+    }
+    *out = make_counted<const datum_t>(std::move(items));
+    return true;
+}
+
+bool field_extractor_t::gets_top_level_field(std::string *field_out) const {
+    if (make_array || paths.size() != 1 || paths[0].size() != 1) {
+        return false;
+    }
+    *field_out = paths[0][0];
+    return true;
+}
+
 counted_t<func_t> new_eq_comparison_func(counted_t<const datum_t> obj,
                                          const protob_t<const Backtrace> &bt_src) {
     pb::dummy_var_t var = pb::dummy_var_t::FUNC_EQCOMPARISON;
@@ -8,6 +8,7 @@
 #include <vector>
 
 #include "errors.hpp"
+#include <boost/function.hpp>
 #include <boost/variant/static_visitor.hpp>
 
 #include "containers/counted.hpp"
@@ -44,6 +45,16 @@ public:
                      counted_t<const datum_t> arg,
                      counted_t<func_t> default_filter_val) const;
 
+    // The same as `call(env, arg)->as_datum()` and `filter_call` on every one of
+    // `args` in order.  JS functions send all of them to their worker process in one
+    // message instead of taking a round trip for each.
+    virtual std::vector<counted_t<const datum_t> > call_batch(
+        env_t *env, const std::vector<counted_t<const datum_t> > &args) const;
+    virtual std::vector<bool> filter_call_batch(
+        env_t *env,
+        const std::vector<counted_t<const datum_t> > &args,
+        counted_t<func_t> default_filter_val) const;
+
     // These are simple, they call the vector version of call.
     counted_t<val_t> call(env_t *env) const;
     counted_t<val_t> call(env_t *env, counted_t<const datum_t> arg) const;
@@ -54,6 +65,11 @@ public:
 protected:
     explicit func_t(const protob_t<const Backtrace> &bt_source);
 
+    // What `filter_call` does with what `filter` returns (or throws).
+    bool filter_or_default(env_t *env,
+                           const boost::function<bool()> &filter,
+                           counted_t<func_t> default_filter_val) const;
+
 private:
     virtual bool filter_helper(env_t *env, counted_t<const datum_t> arg) const = 0;
 
@@ -78,6 +94,13 @@ public:
 
 private:
     friend class wire_func_serialization_visitor_t;
+    friend class field_projection_visitor_t;
+    friend class top_level_fields_visitor_t;
+    friend class pluck_fields_visitor_t;
+    friend class field_values_visitor_t;
+    friend class filter_program_compiler_t;
+    friend class field_extractor_visitor_t;
+    friend class literal_null_visitor_t;
     bool filter_helper(env_t *env, counted_t<const datum_t> arg) const;
 
     // Only contains the parts of the scope that `body` uses.
@@ -109,9 +132,21 @@ public:
 
     void visit(func_visitor_t *visitor) const;
 
+    std::vector<counted_t<const datum_t> > call_batch(
+        env_t *env, const std::vector<counted_t<const datum_t> > &args) const;
+    std::vector<bool> filter_call_batch(
+        env_t *env,
+        const std::vector<counted_t<const datum_t> > &args,
+        counted_t<func_t> default_filter_val) const;
+
 private:
     friend class wire_func_serialization_visitor_t;
     bool filter_helper(env_t *env, counted_t<const datum_t> arg) const;
+    // Calls the function on every one of `args` in the worker process.
+    std::vector<js_result_t> call_js_batch(
+        env_t *env, const std::vector<counted_t<const datum_t> > &args) const;
+    counted_t<val_t> result_val(const js_result_t &result) const;
+    bool filter_result(const js_result_t *result) const;
 
     std::string js_source;
     uint64_t js_timeout_ms;
@@ -144,6 +179,72 @@ counted_t<func_t> new_get_field_func(counted_t<const datum_t> obj,
 counted_t<func_t> new_eq_comparison_func(counted_t<const datum_t> obj,
                                          const protob_t<const Backtrace> &bt_src);
 
+// Returns true if `func` takes one argument and does nothing but pluck top-level
+// fields out of it or get a field of it, and sets `*fields_out` to those fields.
+// Such a function gives the same result on any object that has the same values
+// for those fields, so it can be called on a projection of a document instead of
+// the document itself.
+bool func_only_reads_fields(const counted_t<func_t> &func,
+                            std::vector<std::string> *fields_out);
+
+// Returns true if `func` takes one argument and never uses it but to get top-level
+// fields out of it (with get_field, has_fields or pluck and literal field names),
+// and sets `*fields_out` to those fields, sorted.  Like above, such a function can
+// be called on a projection of a document to those fields instead.
+bool func_reads_top_level_fields(const counted_t<func_t> &func,
+                                 std::vector<std::string> *fields_out);
+
+// Returns true if `func` takes one argument and just plucks top-level fields out of
+// it, with literal field names or arrays of them, like the group function of
+// `groupby`, and sets `*fields_out` to those fields, sorted and without repeats.
+bool func_plucks_top_level_fields(const counted_t<func_t> &func,
+                                  std::vector<std::string> *fields_out);
+
+// Returns true if `func` takes one argument and only passes a filter for objects
+// whose top-level fields have the values in `*fields_out`, which it sets.  The
+// predicate must not fail for objects that don't have them, so that a filter can
+// skip those without calling it: it's an object literal, or an `eq` of a field and
+// a literal, or an `and` that starts with those.  Only numbers, strings and bools
+// count as values.
+bool func_requires_field_values(
+    const counted_t<func_t> &func,
+    std::vector<std::pair<std::string, counted_t<const datum_t> > > *fields_out);
+
+// Returns true if `func` takes one argument and its body is a literal null, like
+// the function `delete` replaces rows with.
+bool func_returns_literal_null(const counted_t<func_t> &func);
+
+// Evaluates a function that gets a field of its argument (or a nested one, like
+// `r.row('a')('b')`), or makes an array of such fields, straight off the argument,
+// without the interpreter.  Most secondary index functions look like that.
+class field_extractor_t {
+public:
+    // Returns NULL if `func` isn't that simple.
+    static field_extractor_t *create(const counted_t<func_t> &func);
+
+    // Returns false if the function has to be called after all, for a missing
+    // field or something that isn't an object, since the interpreter has its own
+    // ways of dealing with those (getting a field of an array maps over it, for
+    // one).
+    MUST_USE bool extract(const counted_t<const datum_t> &arg,
+                          counted_t<const datum_t> *out) const;
+
+    // Returns true and sets `*field_out` if the function just gets one top-level
+    // field of its argument.
+    bool gets_top_level_field(std::string *field_out) const;
+
+private:
+    field_extractor_t() : make_array(false) { }
+    friend class field_extractor_visitor_t;
+
+    // True if the function makes an array of the fields at `paths`, otherwise it
+    // gets the one field at paths[0].
+    bool make_array;
+    std::vector<std::vector<std::string> > paths;
+
+    DISABLE_COPYING(field_extractor_t);
+};
+
 
 class js_result_visitor_t : public boost::static_visitor<counted_t<val_t> > {
 public:
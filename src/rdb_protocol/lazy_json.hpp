@@ -30,6 +30,13 @@ public:
 counted_t<const ql::datum_t> get_data(const rdb_value_t *value,
                                       transaction_t *txn);
 
+// Loads as little of the value as it takes to get the top-level `fields` of it (see
+// ql::deserialize_fields()).  Returns an empty pointer if it has to be loaded as a
+// whole.
+counted_t<const ql::datum_t> get_data_fields(const rdb_value_t *value,
+                                             transaction_t *txn,
+                                             const std::vector<std::string> &fields);
+
 class lazy_json_pointee_t : public single_threaded_countable_t<lazy_json_pointee_t> {
     lazy_json_pointee_t(const rdb_value_t *_rdb_value, transaction_t *_txn)
         : rdb_value(_rdb_value), txn(_txn) {
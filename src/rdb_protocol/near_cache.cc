@@ -0,0 +1,73 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "rdb_protocol/near_cache.hpp"
+
+#include "config/args.hpp"
+#include "perfmon/perfmon.hpp"
+#include "rdb_protocol/datum.hpp"
+
+namespace ql {
+
+static perfmon_counter_t pm_near_cache_hits, pm_near_cache_misses;
+static perfmon_multi_membership_t pm_near_cache_membership(&get_global_perfmon_collection(),
+    &pm_near_cache_hits, "near_cache_hits",
+    &pm_near_cache_misses, "near_cache_misses",
+    NULLPTR);
+
+near_cache_t::near_cache_t() { }
+
+bool near_cache_t::get(const uuid_u &table_id, const store_key_t &key,
+                       counted_t<const datum_t> *row_out) {
+    auto table = tables.find(table_id);
+    if (table == tables.end()) {
+        ++pm_near_cache_misses;
+        return false;
+    }
+    table_cache_t *cache = &table->second;
+    auto it = cache->entries_by_key.find(key);
+    if (it == cache->entries_by_key.end()) {
+        ++pm_near_cache_misses;
+        return false;
+    }
+    if (it->second->expiration < get_ticks()) {
+        cache->entries.erase(it->second);
+        cache->entries_by_key.erase(it);
+        if (cache->entries.empty()) {
+            tables.erase(table);
+        }
+        ++pm_near_cache_misses;
+        return false;
+    }
+    cache->entries.splice(cache->entries.begin(), cache->entries, it->second);
+    *row_out = it->second->row;
+    ++pm_near_cache_hits;
+    return true;
+}
+
+void near_cache_t::put(const uuid_u &table_id, size_t capacity, const store_key_t &key,
+                       const counted_t<const datum_t> &row) {
+    if (capacity == 0) {
+        return;
+    }
+    table_cache_t *cache = &tables[table_id];
+    auto it = cache->entries_by_key.find(key);
+    if (it != cache->entries_by_key.end()) {
+        cache->entries.erase(it->second);
+        cache->entries_by_key.erase(it);
+    }
+    entry_t entry;
+    entry.key = key;
+    entry.row = row;
+    entry.expiration = get_ticks() + NEAR_CACHE_TTL_MS * MILLION;
+    cache->entries.push_front(entry);
+    cache->entries_by_key[key] = cache->entries.begin();
+    while (cache->entries.size() > capacity) {
+        cache->entries_by_key.erase(cache->entries.back().key);
+        cache->entries.pop_back();
+    }
+}
+
+void near_cache_t::forget_table(const uuid_u &table_id) {
+    tables.erase(table_id);
+}
+
+}  // namespace ql
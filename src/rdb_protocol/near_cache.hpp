@@ -0,0 +1,63 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_NEAR_CACHE_HPP_
+#define RDB_PROTOCOL_NEAR_CACHE_HPP_
+
+#include <list>
+#include <map>
+
+#include "btree/keys.hpp"
+#include "containers/counted.hpp"
+#include "containers/uuid.hpp"
+#include "utils.hpp"
+
+namespace ql {
+
+class datum_t;
+
+/* Keeps the rows that recent `get`s with `use_outdated` read, so that the next
+`get` of a hot row is answered from memory instead of crossing the cluster.  Only
+tables whose `near_cache_rows` setting isn't zero are cached, and each table
+keeps its most recently used rows.
+
+Nothing tells the cache when a row changes on its replicas.  A row is only used
+for NEAR_CACHE_TTL_MS after it was read, which is within what an outdated read
+may see anyway, and writes that go through the same cache drop the rows of their
+table.  There is one cache per thread. */
+class near_cache_t {
+public:
+    near_cache_t();
+
+    // Sets `*row_out` to the row of table `table_id` at `key`, if it was put in
+    // less than NEAR_CACHE_TTL_MS ago.
+    MUST_USE bool get(const uuid_u &table_id, const store_key_t &key,
+                      counted_t<const datum_t> *row_out);
+
+    // Keeps `row` as the row of table `table_id` at `key`, and no more than
+    // `capacity` rows of the table.
+    void put(const uuid_u &table_id, size_t capacity, const store_key_t &key,
+             const counted_t<const datum_t> &row);
+
+    // Drops the rows of table `table_id`, after something wrote to it.
+    void forget_table(const uuid_u &table_id);
+
+private:
+    struct entry_t {
+        store_key_t key;
+        counted_t<const datum_t> row;
+        ticks_t expiration;
+    };
+
+    struct table_cache_t {
+        // Most recently used first.
+        std::list<entry_t> entries;
+        std::map<store_key_t, std::list<entry_t>::iterator> entries_by_key;
+    };
+
+    std::map<uuid_u, table_cache_t> tables;
+
+    DISABLE_COPYING(near_cache_t);
+};
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_NEAR_CACHE_HPP_
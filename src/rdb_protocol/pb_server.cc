@@ -3,12 +3,23 @@
 
 #include "concurrency/cross_thread_watchable.hpp"
 #include "concurrency/watchable.hpp"
+#include "perfmon/perfmon.hpp"
 #include "rdb_protocol/counted_term.hpp"
 #include "rdb_protocol/env.hpp"
+#include "rdb_protocol/near_cache.hpp"
 #include "rdb_protocol/profile.hpp"
+#include "rdb_protocol/query_cache.hpp"
+#include "rdb_protocol/query_capture.hpp"
 #include "rdb_protocol/stream_cache.hpp"
 #include "rpc/semilattice/view/field.hpp"
 
+// How long queries take to run, from when they're parsed to when their responses
+// are ready.
+static perfmon_hdr_histogram_t pm_query_latency(
+    secs_to_ticks(LATENCY_PERCENTILES_INTERVAL_SECS), LATENCY_PERCENTILES_RESOLUTION_SECS);
+static perfmon_membership_t pm_query_latency_membership(
+    &get_global_perfmon_collection(), &pm_query_latency, "query_latency");
+
 Response on_unparsable_query2(ql::protob_t<Query> q, std::string msg) {
     Response res;
     res.set_token((q.has() && q->has_token()) ? q->token() : -1);
@@ -18,15 +29,31 @@ Response on_unparsable_query2(ql::protob_t<Query> q, std::string msg) {
 
 query2_server_t::query2_server_t(const std::set<ip_address_t> &local_addresses,
                                  int port,
-                                 rdb_protocol_t::context_t *_ctx) :
+                                 rdb_protocol_t::context_t *_ctx,
+                                 size_t _query_cache_size,
+                                 const boost::optional<std::string> &capture_queries_file,
+                                 protob_server_listen_mode_t listen_mode) :
     server(local_addresses,
            port,
            boost::bind(&query2_server_t::handle, this, _1, _2, _3),
            &on_unparsable_query2,
            _ctx->auth_metadata,
-           INLINE),
-    ctx(_ctx), parser_id(generate_uuid()), thread_counters(0)
-{ }
+           CORO_UNORDERED,
+           listen_mode),
+    ctx(_ctx), parser_id(generate_uuid()), thread_counters(0),
+    query_cache_size(_query_cache_size), query_caches(_query_cache_size) {
+    if (capture_queries_file) {
+        query_capture.init(new ql::query_capture_t(*capture_queries_file));
+    }
+}
+
+query2_server_t::~query2_server_t() { }
+
+static uint64_t next_connection_id = 0;
+
+query2_server_t::context_t::context_t()
+    : interruptor(0),
+      connection_id(__sync_add_and_fetch(&next_connection_id, 1)) { }
 
 http_app_t *query2_server_t::get_http_app() {
     return &server;
@@ -42,7 +69,9 @@ namespace ql {
              rdb_protocol_t::context_t *ctx,
              signal_t *interruptor,
              Response *res,
-             stream_cache2_t *stream_cache2);
+             stream_cache2_t *stream_cache2,
+             query_cache_t *query_cache,
+             near_cache_t *near_cache);
 }
 
 bool query2_server_t::handle(ql::protob_t<Query> q,
@@ -57,10 +86,16 @@ bool query2_server_t::handle(ql::protob_t<Query> q,
     bool response_needed = !(noreply.has() &&
          noreply->get_type() == ql::datum_t::type_t::R_BOOL &&
          noreply->as_bool());
+    if (query_capture.has()) {
+        query_capture->capture(query2_context->connection_id, *q);
+    }
+    const ticks_t start_time = get_ticks();
     try {
         guarantee(ctx->directory_read_manager);
         // `ql::run` will set the status code
-        ql::run(q, ctx, interruptor, response_out, stream_cache2);
+        ql::run(q, ctx, interruptor, response_out, stream_cache2,
+                query_cache_size != 0 ? query_caches.get() : NULL,
+                near_caches.get());
     } catch (const ql::exc_t &e) {
         fill_error(response_out, Response::COMPILE_ERROR, e.what(), e.backtrace());
     } catch (const ql::datum_exc_t &e) {
@@ -72,6 +107,7 @@ bool query2_server_t::handle(ql::protob_t<Query> q,
         ql::fill_error(response_out, Response::RUNTIME_ERROR,
                        strprintf("Unexpected exception: %s\n", e.what()));
     }
+    pm_query_latency.record(ticks_to_secs(get_ticks() - start_time));
 
     return response_needed;
 }
@@ -83,3 +119,15 @@ void make_empty_protob_bearer(ql::protob_t<Query> *request) {
 Query *underlying_protob_value(ql::protob_t<Query> *request) {
     return request->get();
 }
+
+bool recycle_protob_bearer(ql::protob_t<Query> *request) {
+    // A cursor, say, may still be running parts of the query.
+    if (!request->has() || !request->unique()) {
+        return false;
+    }
+    // The protocol buffers keep their sub-messages and the capacity of their
+    // strings when they're cleared, so parsing a similar query into it allocates
+    // little.
+    request->get()->Clear();
+    return true;
+}
@@ -6,32 +6,52 @@
 #include <set>
 #include <string>
 
+#include "errors.hpp"
+#include <boost/optional.hpp>
+
+#include "containers/scoped.hpp"
 #include "protob/protob.hpp"
 #include "protocol_api.hpp"
 #include "rdb_protocol/protocol.hpp"
 #include "rdb_protocol/stream_cache.hpp"
 
-namespace ql { template <class> class protob_t; }
+namespace ql {
+template <class> class protob_t;
+class near_cache_t;
+class query_cache_t;
+class query_capture_t;
+}
 
 // Overloads used by protob_server_t.
 void make_empty_protob_bearer(ql::protob_t<Query> *request);
 Query *underlying_protob_value(ql::protob_t<Query> *request);
+bool recycle_protob_bearer(ql::protob_t<Query> *request);
 
 class query2_server_t {
 public:
+    // Keeps the compiled term trees of up to `_query_cache_size` queries per
+    // thread, see ql::query_cache_t.  Zero disables the cache.  Captures every
+    // query to `capture_queries_file` if it's set, see ql::query_capture_t.
     query2_server_t(const std::set<ip_address_t> &local_addresses, int port,
-                    rdb_protocol_t::context_t *_ctx);
+                    rdb_protocol_t::context_t *_ctx, size_t _query_cache_size,
+                    const boost::optional<std::string> &capture_queries_file,
+                    protob_server_listen_mode_t listen_mode);
+    ~query2_server_t();
 
     http_app_t *get_http_app();
 
     int get_port() const;
 
     struct context_t {
-        context_t() : interruptor(0) { }
+        context_t();
         static const int32_t no_auth_magic_number = VersionDummy::V0_1;
         static const int32_t auth_magic_number = VersionDummy::V0_2;
+        static const int32_t options_magic_number = VersionDummy::V0_3;
+        static const uint32_t compress_responses_option = OptionsDummy::COMPRESS_RESPONSES;
         ql::stream_cache2_t stream_cache2;
         signal_t *interruptor;
+        // Tells the connections apart in the captured queries.
+        const uint64_t connection_id;
     };
 private:
     MUST_USE bool handle(ql::protob_t<Query> q,
@@ -41,6 +61,10 @@ private:
     rdb_protocol_t::context_t *ctx;
     uuid_u parser_id;
     one_per_thread_t<int> thread_counters;
+    const size_t query_cache_size;
+    one_per_thread_t<ql::query_cache_t> query_caches;
+    one_per_thread_t<ql::near_cache_t> near_caches;
+    scoped_ptr_t<ql::query_capture_t> query_capture;
 
     DISABLE_COPYING(query2_server_t);
 };
@@ -14,6 +14,9 @@ start_t::start_t() { }
 start_t::start_t(const std::string &description)
     : description_(description), when_(get_ticks()) { }
 
+start_t::start_t(const std::string &description, ticks_t when)
+    : description_(description), when_(when) { }
+
 RDB_IMPL_ME_SERIALIZABLE_2(start_t, description_, when_);
 
 split_t::split_t() { }
@@ -36,6 +39,9 @@ RDB_IMPL_ME_SERIALIZABLE_3(sample_t, description_, mean_duration_, n_samples_);
 stop_t::stop_t()
     : when_(get_ticks()) { }
 
+stop_t::stop_t(ticks_t when)
+    : when_(when) { }
+
 RDB_IMPL_ME_SERIALIZABLE_1(stop_t, when_);
 
 counted_t<const ql::datum_t> construct_start(
@@ -147,6 +153,71 @@ void print_event_log(const event_log_t &event_log) {
     }
 }
 
+// The event log of a parallel task ends with the stop_t of the task.
+static void guarantee_parallel_task(const event_log_t &event_log) {
+    guarantee(!event_log.empty() && boost::get<stop_t>(&event_log.back()) != NULL);
+}
+
+void wrap_parallel_task(const std::string &description, ticks_t start,
+                        event_log_t *event_log) {
+    guarantee_parallel_task(*event_log);
+    event_log->insert(event_log->end() - 1, stop_t());
+    event_log->insert(event_log->begin(), start_t(description, start));
+}
+
+void prepend_to_parallel_task(const std::string &description, ticks_t start,
+                              ticks_t stop, event_log_t *event_log) {
+    guarantee_parallel_task(*event_log);
+    event_log->insert(event_log->begin(), stop_t(stop));
+    event_log->insert(event_log->begin(), start_t(description, start));
+}
+
+/* Adds up the durations of the outermost tasks and samples in the events of a
+parallel task, which the other nodes timed. */
+static ticks_t outermost_duration(const event_log_t &event_log) {
+    ticks_t total = 0;
+    size_t depth = 0;
+    ticks_t start = 0;
+    for (auto it = event_log.begin(); it + 1 < event_log.end(); ++it) {
+        if (const start_t *st = boost::get<start_t>(&*it)) {
+            if (depth == 0) {
+                start = st->when_;
+            }
+            ++depth;
+        } else if (const split_t *split = boost::get<split_t>(&*it)) {
+            // Every parallel task of the split ends with a stop_t of its own.
+            depth += split->n_parallel_jobs_;
+        } else if (const sample_t *sample = boost::get<sample_t>(&*it)) {
+            if (depth == 0) {
+                total += sample->mean_duration_ * sample->n_samples_;
+            }
+        } else if (const stop_t *stop = boost::get<stop_t>(&*it)) {
+            guarantee(depth > 0);
+            --depth;
+            if (depth == 0 && stop->when_ > start) {
+                total += stop->when_ - start;
+            }
+        } else {
+            unreachable();
+        }
+    }
+    return total;
+}
+
+void wrap_round_trip(const std::string &description,
+                     const std::string &transit_description, ticks_t start,
+                     event_log_t *event_log) {
+    guarantee_parallel_task(*event_log);
+    const ticks_t now = get_ticks();
+    const ticks_t round_trip = now > start ? now - start : 0;
+    const ticks_t inside = outermost_duration(*event_log);
+    event_log->insert(event_log->end() - 1, stop_t(now));
+    event_log->insert(event_log->begin(),
+                      sample_t(transit_description,
+                               round_trip > inside ? round_trip - inside : 0, 1));
+    event_log->insert(event_log->begin(), start_t(description, start));
+}
+
 starter_t::starter_t(const std::string &description, trace_t *parent) {
     init(description, parent);
 }
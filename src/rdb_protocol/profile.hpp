@@ -23,6 +23,7 @@ namespace profile {
 struct start_t {
     start_t();
     explicit start_t(const std::string &description);
+    start_t(const std::string &description, ticks_t when);
     std::string description_;
     ticks_t when_;
 
@@ -51,6 +52,7 @@ struct sample_t {
 
 struct stop_t {
     stop_t();
+    explicit stop_t(ticks_t when);
     ticks_t when_;
 
     RDB_DECLARE_ME_SERIALIZABLE;
@@ -198,5 +200,26 @@ private:
 
 void print_event_log(const event_log_t &event_log);
 
+/* These add the hops of a read or write on its way to a shard and back to the
+ * event log the shard sent back.  That's the event log of a parallel task of a
+ * splitter_t: what the shard recorded, then the stop_t that ends the task.  The
+ * tasks they add start and stop on the clock of the node that adds them, so
+ * their durations are right even though the clocks of the nodes differ.  The
+ * masters and their clients use them, see read_t::profile_master() in
+ * rdb_protocol/protocol.hpp. */
+
+// Wraps the events of the task in a task that started at `start` and stops now.
+void wrap_parallel_task(const std::string &description, ticks_t start,
+                        event_log_t *event_log);
+// Puts a task that ran from `start` to `stop` in front of the events of the task.
+void prepend_to_parallel_task(const std::string &description, ticks_t start,
+                              ticks_t stop, event_log_t *event_log);
+// Wraps the events like wrap_parallel_task() does, with a sample of the time the
+// tasks inside don't account for first.  That's the time the request and its
+// response spent on the wire and in the message queues of the nodes.
+void wrap_round_trip(const std::string &description,
+                     const std::string &transit_description, ticks_t start,
+                     event_log_t *event_log);
+
 } //namespace profile
 #endif
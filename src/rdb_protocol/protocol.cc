@@ -1,14 +1,21 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "rdb_protocol/protocol.hpp"
 
+#include <inttypes.h>
+
 #include <algorithm>
+#include <queue>
+#include <set>
 
 #include "errors.hpp"
 #include <boost/bind.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
 
 #include "arch/io/disk.hpp"
+#include "btree/bulk_load.hpp"
 #include "btree/erase_range.hpp"
 #include "btree/parallel_traversal.hpp"
+#include "btree/secondary_operations.hpp"
 #include "btree/slice.hpp"
 #include "btree/superblock.hpp"
 #include "clustering/administration/metadata.hpp"
@@ -20,6 +27,7 @@
 #include "protob/protob.hpp"
 #include "rdb_protocol/btree.hpp"
 #include "rdb_protocol/env.hpp"
+#include "rdb_protocol/external_sort.hpp"
 #include "rdb_protocol/func.hpp"
 #include "rdb_protocol/transform_visitors.hpp"
 #include "rdb_protocol/minidriver.hpp"
@@ -33,6 +41,7 @@
 
 typedef rdb_protocol_details::backfill_atom_t rdb_backfill_atom_t;
 typedef rdb_protocol_details::range_key_tester_t range_key_tester_t;
+typedef rdb_protocol_details::text_search_hit_t text_search_hit_t;
 
 typedef rdb_protocol_t::context_t context_t;
 
@@ -45,6 +54,9 @@ typedef rdb_protocol_t::read_response_t read_response_t;
 typedef rdb_protocol_t::point_read_t point_read_t;
 typedef rdb_protocol_t::point_read_response_t point_read_response_t;
 
+typedef rdb_protocol_t::multi_point_read_t multi_point_read_t;
+typedef rdb_protocol_t::multi_point_read_response_t multi_point_read_response_t;
+
 typedef rdb_protocol_t::rget_read_t rget_read_t;
 typedef rdb_protocol_t::rget_read_response_t rget_read_response_t;
 
@@ -57,11 +69,25 @@ typedef rdb_protocol_t::sindex_list_response_t sindex_list_response_t;
 typedef rdb_protocol_t::sindex_status_t sindex_status_t;
 typedef rdb_protocol_t::sindex_status_response_t sindex_status_response_t;
 
+typedef rdb_protocol_t::changefeed_subscribe_t changefeed_subscribe_t;
+typedef rdb_protocol_t::changefeed_subscribe_response_t changefeed_subscribe_response_t;
+
+typedef rdb_protocol_t::text_search_t text_search_t;
+typedef rdb_protocol_t::text_search_response_t text_search_response_t;
+
 typedef rdb_protocol_t::write_t write_t;
 typedef rdb_protocol_t::write_response_t write_response_t;
 
 typedef rdb_protocol_t::batched_replace_t batched_replace_t;
 typedef rdb_protocol_t::batched_insert_t batched_insert_t;
+typedef rdb_protocol_t::combined_insert_t combined_insert_t;
+typedef rdb_protocol_t::combined_insert_response_t combined_insert_response_t;
+typedef rdb_protocol_t::bulk_insert_t bulk_insert_t;
+typedef rdb_protocol_t::range_replace_t range_replace_t;
+typedef rdb_protocol_t::range_replace_response_t range_replace_response_t;
+typedef rdb_protocol_t::range_delete_t range_delete_t;
+typedef rdb_protocol_t::sindex_range_delete_t sindex_range_delete_t;
+typedef rdb_protocol_t::sindex_range_delete_response_t sindex_range_delete_response_t;
 
 typedef rdb_protocol_t::point_write_t point_write_t;
 typedef rdb_protocol_t::point_write_response_t point_write_response_t;
@@ -97,6 +123,32 @@ RDB_IMPL_PROTOB_SERIALIZABLE(Backtrace);
 
 RDB_IMPL_SERIALIZABLE_2(filter_transform_t, filter_func, default_filter_val);
 
+const char *projection_transform_t::name() const {
+    switch (type) {
+    case projection_type_t::PLUCK: return "pluck";
+    case projection_type_t::WITHOUT: return "without";
+    default: unreachable();
+    }
+}
+
+void projection_transform_t::rdb_serialize(write_message_t &msg /* NOLINT */) const {
+    msg << type;
+    msg << paths;
+    msg << *bt;
+}
+
+archive_result_t projection_transform_t::rdb_deserialize(read_stream_t *s) {
+    archive_result_t res = deserialize(s, &type);
+    if (res) { return res; }
+    res = deserialize(s, &paths);
+    if (res) { return res; }
+    ql::protob_t<Backtrace> backtrace = ql::make_counted_backtrace();
+    res = deserialize(s, &*backtrace);
+    if (res) { return res; }
+    bt = backtrace;
+    return res;
+}
+
 datum_range_t::datum_range_t()
     : left_bound_type(key_range_t::none), right_bound_type(key_range_t::none) { }
 datum_range_t::datum_range_t(
@@ -117,6 +169,13 @@ bool datum_range_t::is_universe() const {
         && left_bound_type == key_range_t::open && right_bound_type == key_range_t::open;
 }
 
+bool datum_range_t::is_point() const {
+    return left_bound.has() && right_bound.has()
+        && left_bound_type == key_range_t::closed
+        && right_bound_type == key_range_t::closed
+        && *left_bound == *right_bound;
+}
+
 bool datum_range_t::contains(counted_t<const ql::datum_t> val) const {
     return (!left_bound.has()
             || *left_bound < *val
@@ -138,13 +197,13 @@ key_range_t datum_range_t::to_primary_keyrange() const {
             : store_key_t::max());
 }
 
-key_range_t datum_range_t::to_sindex_keyrange() const {
+key_range_t datum_range_t::to_sindex_keyrange(ql::sindex_key_format_t format) const {
     return rdb_protocol_t::sindex_key_range(
         left_bound.has()
-            ? store_key_t(left_bound->truncated_secondary())
+            ? store_key_t(left_bound->truncated_secondary(format))
             : store_key_t::min(),
         right_bound.has()
-            ? store_key_t(right_bound->truncated_secondary())
+            ? store_key_t(right_bound->truncated_secondary(format))
             : store_key_t::max());
 }
 
@@ -383,6 +442,11 @@ bool range_key_tester_t::key_should_be_erased(const btree_key_t *key) {
         && delete_range->inner.contains_key(key->contents, key->size);
 }
 
+bool range_key_tester_t::erases_every_key() {
+    // The erase is limited to delete_range->inner anyway.
+    return delete_range->beg == 0 && delete_range->end == HASH_REGION_HASH_SIZE;
+}
+
 typedef boost::variant<rdb_modification_report_t,
                        rdb_erase_range_report_t>
         sindex_change_t;
@@ -392,6 +456,16 @@ void add_status(const single_sindex_status_t &new_status,
     status_out->blocks_processed += new_status.blocks_processed;
     status_out->blocks_total += new_status.blocks_total;
     status_out->ready &= new_status.ready;
+    // The shards get constructed at the same time.
+    if (status_out->eta_secs < 0 || new_status.eta_secs < 0) {
+        status_out->eta_secs = -1;
+    } else {
+        status_out->eta_secs = std::max(status_out->eta_secs, new_status.eta_secs);
+    }
+}
+
+bool better_text_search_hit(const text_search_hit_t &a, const text_search_hit_t &b) {
+    return a.score > b.score || (a.score == b.score && a.key < b.key);
 }
 
 }  // namespace rdb_protocol_details
@@ -401,7 +475,8 @@ rdb_protocol_t::context_t::context_t()
     cross_thread_namespace_watchables(get_num_threads()),
     cross_thread_database_watchables(get_num_threads()),
     directory_read_manager(NULL),
-    signals(get_num_threads())
+    signals(get_num_threads()),
+    manager(NULL)
 { }
 
 rdb_protocol_t::context_t::context_t(
@@ -421,7 +496,8 @@ rdb_protocol_t::context_t::context_t(
       auth_metadata(_auth_metadata),
       directory_read_manager(_directory_read_manager),
       signals(get_num_threads()),
-      machine_id(_machine_id)
+      machine_id(_machine_id),
+      manager(NULL)
 {
     for (int thread = 0; thread < get_num_threads(); ++thread) {
         cross_thread_namespace_watchables[thread].init(new cross_thread_watchable_variable_t<cow_ptr_t<namespaces_semilattice_metadata_t<rdb_protocol_t> > >(
@@ -472,12 +548,55 @@ store_key_t sindex_list_region_key() {
     return store_key_t();
 }
 
+// The region of a read or write of several keys.
+// TODO: This entire type is suspect, given the performance for
+// batched_replaces_t.  Is it used in anything other than assertions?
+region_t region_from_keys(const std::vector<store_key_t> &keys) {
+    // It shouldn't be empty, but we let the places that would break use a
+    // guarantee.
+    rassert(!keys.empty());
+    if (keys.empty()) {
+        return hash_region_t<key_range_t>();
+    }
+
+    store_key_t min_key = store_key_t::max();
+    store_key_t max_key = store_key_t::min();
+    uint64_t min_hash_value = HASH_REGION_HASH_SIZE - 1;
+    uint64_t max_hash_value = 0;
+
+    for (auto it = keys.begin(); it != keys.end(); ++it) {
+        const store_key_t &key = *it;
+        if (key < min_key) {
+            min_key = key;
+        }
+        if (key > max_key) {
+            max_key = key;
+        }
+
+        const uint64_t hash_value = hash_region_hasher(key.contents(), key.size());
+        if (hash_value < min_hash_value) {
+            min_hash_value = hash_value;
+        }
+        if (hash_value > max_hash_value) {
+            max_hash_value = hash_value;
+        }
+    }
+
+    return hash_region_t<key_range_t>(
+        min_hash_value, max_hash_value + 1,
+        key_range_t(key_range_t::closed, min_key, key_range_t::closed, max_key));
+}
+
 /* read_t::get_region implementation */
 struct rdb_r_get_region_visitor : public boost::static_visitor<region_t> {
     region_t operator()(const point_read_t &pr) const {
         return rdb_protocol_t::monokey_region(pr.key);
     }
 
+    region_t operator()(const multi_point_read_t &mpr) const {
+        return region_from_keys(mpr.keys);
+    }
+
     region_t operator()(const rget_read_t &rg) const {
         return rg.region;
     }
@@ -493,6 +612,14 @@ struct rdb_r_get_region_visitor : public boost::static_visitor<region_t> {
     region_t operator()(const sindex_status_t &ss) const {
         return ss.region;
     }
+
+    region_t operator()(const changefeed_subscribe_t &s) const {
+        return s.region;
+    }
+
+    region_t operator()(const text_search_t &ts) const {
+        return ts.region;
+    }
 };
 
 region_t read_t::get_region() const THROWS_NOTHING {
@@ -519,6 +646,21 @@ struct rdb_r_shard_visitor_t : public boost::static_visitor<bool> {
         return keyed_read(pr, pr.key);
     }
 
+    bool operator()(const multi_point_read_t &mpr) const {
+        std::vector<store_key_t> shard_keys;
+        for (auto it = mpr.keys.begin(); it != mpr.keys.end(); ++it) {
+            if (region_contains_key(*region, *it)) {
+                shard_keys.push_back(*it);
+            }
+        }
+        if (!shard_keys.empty()) {
+            *read_out = read_t(multi_point_read_t(std::move(shard_keys)), profile);
+            return true;
+        } else {
+            return false;
+        }
+    }
+
     template <class T>
     bool rangey_read(const T &arg) const {
         const hash_region_t<key_range_t> intersection
@@ -549,6 +691,14 @@ struct rdb_r_shard_visitor_t : public boost::static_visitor<bool> {
         return rangey_read(ss);
     }
 
+    bool operator()(const changefeed_subscribe_t &s) const {
+        return rangey_read(s);
+    }
+
+    bool operator()(const text_search_t &ts) const {
+        return rangey_read(ts);
+    }
+
     const hash_region_t<key_range_t> *region;
     profile_bool_t profile;
     read_t *read_out;
@@ -559,6 +709,38 @@ bool read_t::shard(const hash_region_t<key_range_t> &region,
     return boost::apply_visitor(rdb_r_shard_visitor_t(&region, profile, read_out), read);
 }
 
+bool read_t::coalescing_key(store_key_t *key_out) const THROWS_NOTHING {
+    // A profiled read reports the work that it did itself.
+    if (profile == profile_bool_t::PROFILE) {
+        return false;
+    }
+    const point_read_t *pr = boost::get<point_read_t>(&read);
+    if (pr == NULL) {
+        return false;
+    }
+    *key_out = pr->key;
+    return true;
+}
+
+void read_t::profile_master(ticks_t received, ticks_t in_order,
+                            read_response_t *response) const {
+    if (profile == profile_bool_t::PROFILE) {
+        profile::wrap_parallel_task("Dispatch the read through the broadcaster.",
+                                    in_order, &response->event_log);
+        profile::prepend_to_parallel_task("Wait for the FIFO enforcer of the master.",
+                                          received, in_order, &response->event_log);
+        profile::wrap_parallel_task("Perform the read on the master.", received,
+                                    &response->event_log);
+    }
+}
+
+void read_t::profile_round_trip(ticks_t sent, read_response_t *response) const {
+    if (profile == profile_bool_t::PROFILE) {
+        profile::wrap_round_trip("Send the read to the master.",
+                                 "Messages in transit.", sent, &response->event_log);
+    }
+}
+
 /* A visitor to handle this unsharding process for us. */
 
 class distribution_read_response_less_t {
@@ -574,7 +756,10 @@ public:
 
 // Scale the distribution down by combining ranges to fit it within the limit of
 // the query
-void scale_down_distribution(size_t result_limit, std::map<store_key_t, int64_t> *key_counts) {
+// `byte_counts` is either empty or has the same keys as `key_counts`, and its
+// ranges get combined the same way.
+void scale_down_distribution(size_t result_limit, std::map<store_key_t, int64_t> *key_counts,
+                             std::map<store_key_t, int64_t> *byte_counts) {
     guarantee(result_limit > 0);
     const size_t combine = (key_counts->size() / result_limit); // Combine this many other ranges into the previous range
     for (std::map<store_key_t, int64_t>::iterator it = key_counts->begin(); it != key_counts->end(); ) {
@@ -582,6 +767,11 @@ void scale_down_distribution(size_t result_limit, std::map<store_key_t, int64_t>
         ++next;
         for (size_t i = 0; i < combine && next != key_counts->end(); ++i) {
             it->second += next->second;
+            std::map<store_key_t, int64_t>::iterator bytes = byte_counts->find(next->first);
+            if (bytes != byte_counts->end()) {
+                (*byte_counts)[it->first] += bytes->second;
+                byte_counts->erase(bytes);
+            }
             std::map<store_key_t, int64_t>::iterator tmp = next;
             ++next;
             key_counts->erase(tmp);
@@ -590,6 +780,25 @@ void scale_down_distribution(size_t result_limit, std::map<store_key_t, int64_t>
     }
 }
 
+// Orders the shards' streams by their next rows in a heap, so that the stream
+// whose row goes next is on top.
+class rget_stream_order_t {
+public:
+    typedef rdb_protocol_t::rget_read_response_t::stream_t stream_t;
+    typedef std::pair<stream_t::const_iterator, stream_t::const_iterator> range_t;
+
+    explicit rget_stream_order_t(sorting_t _sorting) : sorting(_sorting) { }
+    bool operator()(const range_t &l, const range_t &r) const {
+        // `std::priority_queue` puts the greatest on top.
+        return !reversed(sorting)
+            ? r.first->key < l.first->key
+            : l.first->key < r.first->key;
+    }
+
+private:
+    sorting_t sorting;
+};
+
 class rdb_r_unshard_visitor_t : public boost::static_visitor<void> {
 public:
     rdb_r_unshard_visitor_t(const read_response_t *_responses,
@@ -625,6 +834,18 @@ public:
         *response_out = responses[0];
     }
 
+    void operator()(const multi_point_read_t &) {
+        response_out->response = multi_point_read_response_t();
+        multi_point_read_response_t *res
+            = boost::get<multi_point_read_response_t>(&response_out->response);
+        for (size_t i = 0; i < count; ++i) {
+            const multi_point_read_response_t *shard_res
+                = boost::get<multi_point_read_response_t>(&responses[i].response);
+            guarantee(shard_res != NULL);
+            res->rows.insert(shard_res->rows.begin(), shard_res->rows.end());
+        }
+    }
+
     void operator()(const rget_read_t &rg) {
         response_out->response = rget_read_response_t();
         rget_read_response_t *rg_response
@@ -649,6 +870,15 @@ public:
             }
         }
 
+        // The merged rows are only in value order if every shard's are.
+        rg_response->key_format = ql::sindex_key_format_t::BINARY;
+        for (size_t i = 0; i < count; ++i) {
+            auto rr = boost::get<rget_read_response_t>(&responses[i].response);
+            if (rr->key_format != ql::sindex_key_format_t::BINARY) {
+                rg_response->key_format = ql::sindex_key_format_t::LEGACY;
+            }
+        }
+
         if (!rg.terminal) {
             unshard_range_get(rg);
         } else {
@@ -705,14 +935,20 @@ public:
                      ++mit) {
                     mit->second = static_cast<int64_t>(mit->second * scale_factor);
                 }
+                for (std::map<store_key_t, int64_t>::iterator mit = results[largest_index].byte_counts.begin();
+                     mit != results[largest_index].byte_counts.end();
+                     ++mit) {
+                    mit->second = static_cast<int64_t>(mit->second * scale_factor);
+                }
 
                 res.key_counts.insert(results[largest_index].key_counts.begin(), results[largest_index].key_counts.end());
+                res.byte_counts.insert(results[largest_index].byte_counts.begin(), results[largest_index].byte_counts.end());
             }
         }
 
         // If the result is larger than the requested limit, scale it down
         if (dg.result_limit > 0 && res.key_counts.size() > dg.result_limit) {
-            scale_down_distribution(dg.result_limit, &res.key_counts);
+            scale_down_distribution(dg.result_limit, &res.key_counts, &res.byte_counts);
         }
 
         response_out->response = res;
@@ -728,7 +964,7 @@ public:
         *response_out = read_response_t(sindex_status_response_t());
         auto ss_response = boost::get<sindex_status_response_t>(&response_out->response);
         for (size_t i = 0; i < count; ++i) {
-            auto resp = boost::get<sindex_status_response_t>(&responses[0].response);
+            auto resp = boost::get<sindex_status_response_t>(&responses[i].response);
             guarantee(resp);
             for (auto it = resp->statuses.begin();
                  it != resp->statuses.end(); ++it) {
@@ -737,6 +973,44 @@ public:
         }
     }
 
+    void operator()(UNUSED const changefeed_subscribe_t &s) {
+        *response_out = read_response_t(changefeed_subscribe_response_t());
+        auto s_response =
+            boost::get<changefeed_subscribe_response_t>(&response_out->response);
+        for (size_t i = 0; i < count; ++i) {
+            auto resp =
+                boost::get<changefeed_subscribe_response_t>(&responses[i].response);
+            guarantee(resp);
+            s_response->servers.insert(s_response->servers.end(),
+                                       resp->servers.begin(), resp->servers.end());
+        }
+    }
+
+    void operator()(const text_search_t &ts) {
+        *response_out = read_response_t(text_search_response_t());
+        auto ts_response = boost::get<text_search_response_t>(&response_out->response);
+        std::vector<text_search_hit_t> hits;
+        for (size_t i = 0; i < count; ++i) {
+            auto resp = boost::get<text_search_response_t>(&responses[i].response);
+            guarantee(resp);
+            if (auto e = boost::get<ql::datum_exc_t>(&resp->result)) {
+                ts_response->result = *e;
+                return;
+            }
+            auto shard_hits
+                = boost::get<std::vector<text_search_hit_t> >(&resp->result);
+            guarantee(shard_hits);
+            hits.insert(hits.end(), shard_hits->begin(), shard_hits->end());
+        }
+        // Every shard sent its best `ts.limit` matches.
+        std::sort(hits.begin(), hits.end(),
+                  &rdb_protocol_details::better_text_search_hit);
+        if (hits.size() > ts.limit) {
+            hits.erase(hits.begin() + ts.limit, hits.end());
+        }
+        ts_response->result = std::move(hits);
+    }
+
 private:
     const read_response_t *responses;
     size_t count;
@@ -786,48 +1060,53 @@ private:
                 rg_response->truncated = rg_response->truncated || rr->truncated;
             }
         } else {
-            std::vector<std::pair<stream_t::const_iterator, stream_t::const_iterator> >
-                iterators;
-
+            // The shards' streams are each in key order, so they're merged with
+            // a heap of their next rows, up to the cutoff key.
+            std::priority_queue<rget_stream_order_t::range_t,
+                                std::vector<rget_stream_order_t::range_t>,
+                                rget_stream_order_t> heads(
+                rget_stream_order_t(rg.sorting));
             for (size_t i = 0; i < count; ++i) {
-                // TODO: we're ignoring the limit when recombining.
                 auto rr = boost::get<rget_read_response_t>(&responses[i].response);
                 guarantee(rr != NULL);
 
                 const stream_t *stream = boost::get<stream_t>(&(rr->result));
-                iterators.push_back(std::make_pair(stream->begin(), stream->end()));
+                if (stream->begin() != stream->end()
+                    && before_cutoff(rg.sorting, stream->begin()->key,
+                                     rg_response->last_considered_key)) {
+                    heads.push(std::make_pair(stream->begin(), stream->end()));
+                }
             }
 
-            while (true) {
-                store_key_t key_to_beat = !reversed(rg.sorting)
-                    ? store_key_t::max() : store_key_t::min();
-                stream_t::const_iterator *value = NULL;
-
-                for (auto it = iterators.begin(); it != iterators.end(); ++it) {
-                    if (it->first == it->second) {
-                        continue;
-                    }
-
-                    if ((!reversed(rg.sorting)
-                         && it->first->key <= key_to_beat
-                         && it->first->key <= rg_response->last_considered_key)
-                        || (reversed(rg.sorting)
-                            && it->first->key >= key_to_beat
-                            && it->first->key >= rg_response->last_considered_key)) {
-                        key_to_beat = it->first->key;
-                        value = &it->first;
-                    }
-                }
-                if (value != NULL) {
-                    res_stream->push_back(**value);
-                    ++(*value);
-                } else {
+            // Every shard sent up to a batch of its own, but the merged stream
+            // only needs a batch of them, and `limit` and such made the batch as
+            // small as they need.  Past that, the rest is left for the next read.
+            const int64_t max_els = rg.batchspec.get_max_els();
+            while (!heads.empty()) {
+                if (static_cast<int64_t>(res_stream->size()) >= max_els) {
+                    rg_response->last_considered_key = res_stream->back().key;
+                    rg_response->truncated = true;
                     break;
                 }
+                rget_stream_order_t::range_t head = heads.top();
+                heads.pop();
+                res_stream->push_back(*head.first);
+                ++head.first;
+                if (head.first != head.second
+                    && before_cutoff(rg.sorting, head.first->key,
+                                     rg_response->last_considered_key)) {
+                    heads.push(head);
+                }
             }
         }
     }
 
+    // Whether a row at `key` is within what every shard has considered.
+    static bool before_cutoff(sorting_t sorting, const store_key_t &key,
+                              const store_key_t &cutoff) {
+        return !reversed(sorting) ? key <= cutoff : key >= cutoff;
+    }
+
     void unshard_reduce(const rget_read_t &rg) {
         rget_read_response_t *rg_response = boost::get<rget_read_response_t>(
             &response_out->response);
@@ -908,6 +1187,69 @@ private:
                     }
                 }
                 boost::get<ql::wire_datum_map_t>(rg_response->result).finalize();
+            } else if (const ql::top_k_wire_func_t *top_k_func =
+                    boost::get<ql::top_k_wire_func_t>(&*rg.terminal)) {
+                ql::top_k_rows_t rows(top_k_func->get_k());
+                for (size_t i = 0; i < count; ++i) {
+                    const rget_read_response_t *_rr =
+                        boost::get<rget_read_response_t>(&responses[i].response);
+                    guarantee(_rr);
+                    const ql::top_k_rows_t *rhs =
+                        boost::get<ql::top_k_rows_t>(&(_rr->result));
+                    r_sanity_check(rhs);
+                    rows.add(*rhs);
+                }
+                rg_response->result = rows;
+            } else if (const ql::groupby_wire_func_t *groupby_func =
+                    boost::get<ql::groupby_wire_func_t>(&*rg.terminal)) {
+                ql::group_accumulators_t accumulators(groupby_func->get_aggregator());
+                for (size_t i = 0; i < count; ++i) {
+                    const rget_read_response_t *_rr =
+                        boost::get<rget_read_response_t>(&responses[i].response);
+                    guarantee(_rr);
+                    const ql::group_accumulators_t *rhs =
+                        boost::get<ql::group_accumulators_t>(&(_rr->result));
+                    r_sanity_check(rhs);
+                    accumulators.add(*rhs);
+                }
+                rg_response->result = std::move(accumulators);
+            } else if (boost::get<ql::count_distinct_wire_func_t>(&*rg.terminal)) {
+                ql::distinct_sketch_t sketch;
+                for (size_t i = 0; i < count; ++i) {
+                    const rget_read_response_t *_rr =
+                        boost::get<rget_read_response_t>(&responses[i].response);
+                    guarantee(_rr);
+                    const ql::distinct_sketch_t *rhs =
+                        boost::get<ql::distinct_sketch_t>(&(_rr->result));
+                    r_sanity_check(rhs);
+                    sketch.add(*rhs);
+                }
+                rg_response->result = std::move(sketch);
+            } else if (boost::get<ql::quantile_wire_func_t>(&*rg.terminal)) {
+                ql::quantile_sketch_t sketch;
+                for (size_t i = 0; i < count; ++i) {
+                    const rget_read_response_t *_rr =
+                        boost::get<rget_read_response_t>(&responses[i].response);
+                    guarantee(_rr);
+                    const ql::quantile_sketch_t *rhs =
+                        boost::get<ql::quantile_sketch_t>(&(_rr->result));
+                    r_sanity_check(rhs);
+                    sketch.add(*rhs);
+                }
+                rg_response->result = std::move(sketch);
+            } else if (const ql::sample_wire_func_t *sample_func =
+                    boost::get<ql::sample_wire_func_t>(&*rg.terminal)) {
+                ql::sample_rows_t rows(sample_func->get_k());
+                for (size_t i = 0; i < count; ++i) {
+                    const rget_read_response_t *_rr =
+                        boost::get<rget_read_response_t>(&responses[i].response);
+                    guarantee(_rr);
+                    const ql::sample_rows_t *rhs =
+                        boost::get<ql::sample_rows_t>(&(_rr->result));
+                    r_sanity_check(rhs);
+                    rows.add(*rhs);
+                }
+                rg_response->result = std::move(rows);
             } else {
                 unreachable();
             }
@@ -952,49 +1294,29 @@ void read_t::unshard(read_response_t *responses, size_t count,
 
 /* write_t::get_region() implementation */
 
-// TODO: This entire type is suspect, given the performance for
-// batched_replaces_t.  Is it used in anything other than assertions?
-region_t region_from_keys(const std::vector<store_key_t> &keys) {
-    // It shouldn't be empty, but we let the places that would break use a
-    // guarantee.
-    rassert(!keys.empty());
-    if (keys.empty()) {
-        return hash_region_t<key_range_t>();
+struct rdb_w_get_region_visitor : public boost::static_visitor<region_t> {
+    region_t operator()(const batched_replace_t &br) const {
+        return region_from_keys(br.keys);
     }
-
-    store_key_t min_key = store_key_t::max();
-    store_key_t max_key = store_key_t::min();
-    uint64_t min_hash_value = HASH_REGION_HASH_SIZE - 1;
-    uint64_t max_hash_value = 0;
-
-    for (auto it = keys.begin(); it != keys.end(); ++it) {
-        const store_key_t &key = *it;
-        if (key < min_key) {
-            min_key = key;
-        }
-        if (key > max_key) {
-            max_key = key;
+    region_t operator()(const batched_insert_t &bi) const {
+        std::vector<store_key_t> keys;
+        keys.reserve(bi.inserts.size());
+        for (auto it = bi.inserts.begin(); it != bi.inserts.end(); ++it) {
+            keys.emplace_back((*it)->get(bi.pkey)->print_primary());
         }
+        return region_from_keys(keys);
+    }
 
-        const uint64_t hash_value = hash_region_hasher(key.contents(), key.size());
-        if (hash_value < min_hash_value) {
-            min_hash_value = hash_value;
-        }
-        if (hash_value > max_hash_value) {
-            max_hash_value = hash_value;
+    region_t operator()(const combined_insert_t &ci) const {
+        std::vector<store_key_t> keys;
+        keys.reserve(ci.inserts.size());
+        for (auto it = ci.inserts.begin(); it != ci.inserts.end(); ++it) {
+            keys.emplace_back((*it)->get(ci.pkey)->print_primary());
         }
+        return region_from_keys(keys);
     }
 
-    return hash_region_t<key_range_t>(
-        min_hash_value, max_hash_value + 1,
-        key_range_t(key_range_t::closed, min_key, key_range_t::closed, max_key));
-}
-
-struct rdb_w_get_region_visitor : public boost::static_visitor<region_t> {
-    region_t operator()(const batched_replace_t &br) const {
-        return region_from_keys(br.keys);
-    }
-    region_t operator()(const batched_insert_t &bi) const {
+    region_t operator()(const bulk_insert_t &bi) const {
         std::vector<store_key_t> keys;
         keys.reserve(bi.inserts.size());
         for (auto it = bi.inserts.begin(); it != bi.inserts.end(); ++it) {
@@ -1003,6 +1325,30 @@ struct rdb_w_get_region_visitor : public boost::static_visitor<region_t> {
         return region_from_keys(keys);
     }
 
+    region_t operator()(const range_replace_t &rr) const {
+        // The smallest region that holds all of `rr.regions`.
+        region_t hull = rr.regions[0];
+        for (auto it = rr.regions.begin(); it != rr.regions.end(); ++it) {
+            hull.beg = std::min(hull.beg, it->beg);
+            hull.end = std::max(hull.end, it->end);
+            if (it->inner.left < hull.inner.left) {
+                hull.inner.left = it->inner.left;
+            }
+            if (hull.inner.right < it->inner.right) {
+                hull.inner.right = it->inner.right;
+            }
+        }
+        return hull;
+    }
+
+    region_t operator()(const range_delete_t &rd) const {
+        return rd.region;
+    }
+
+    region_t operator()(const sindex_range_delete_t &srd) const {
+        return srd.region;
+    }
+
     region_t operator()(const point_write_t &pw) const {
         return rdb_protocol_t::monokey_region(pw.key);
     }
@@ -1065,7 +1411,8 @@ struct rdb_w_shard_visitor_t : public boost::static_visitor<bool> {
                     br.pkey,
                     br.f.compile_wire_func(),
                     br.optargs,
-                    br.return_vals),
+                    br.return_vals,
+                    br.return_stats),
                 durability_requirement,
                 profile);
             return true;
@@ -1085,7 +1432,69 @@ struct rdb_w_shard_visitor_t : public boost::static_visitor<bool> {
         if (!shard_inserts.empty()) {
             *write_out = write_t(
                 batched_insert_t(
-                    std::move(shard_inserts), bi.pkey, bi.upsert, bi.return_vals),
+                    std::move(shard_inserts), bi.pkey, bi.upsert, bi.return_vals,
+                    bi.return_stats),
+                durability_requirement,
+                profile);
+            return true;
+        } else {
+            return false;
+        }
+    }
+
+    bool operator()(const combined_insert_t &ci) const {
+        std::vector<counted_t<const ql::datum_t> > shard_inserts;
+        std::vector<uint64_t> shard_positions;
+        for (size_t i = 0; i < ci.inserts.size(); ++i) {
+            store_key_t key(ci.inserts[i]->get(ci.pkey)->print_primary());
+            if (region_contains_key(*region, key)) {
+                shard_inserts.push_back(ci.inserts[i]);
+                shard_positions.push_back(ci.positions[i]);
+            }
+        }
+        if (!shard_inserts.empty()) {
+            *write_out = write_t(
+                combined_insert_t(std::move(shard_inserts), std::move(shard_positions),
+                                  ci.pkey, ci.upsert),
+                durability_requirement,
+                profile);
+            return true;
+        } else {
+            return false;
+        }
+    }
+
+    bool operator()(const bulk_insert_t &bi) const {
+        std::vector<counted_t<const ql::datum_t> > shard_inserts;
+        for (auto it = bi.inserts.begin(); it != bi.inserts.end(); ++it) {
+            store_key_t key((*it)->get(bi.pkey)->print_primary());
+            if (region_contains_key(*region, key)) {
+                shard_inserts.push_back(*it);
+            }
+        }
+        if (!shard_inserts.empty()) {
+            *write_out = write_t(
+                bulk_insert_t(std::move(shard_inserts), bi.pkey, bi.fill_factor),
+                durability_requirement,
+                profile);
+            return true;
+        } else {
+            return false;
+        }
+    }
+
+    bool operator()(const range_replace_t &rr) const {
+        std::vector<region_t> shard_regions;
+        for (auto it = rr.regions.begin(); it != rr.regions.end(); ++it) {
+            region_t intersection = region_intersection(*region, *it);
+            if (!region_is_empty(intersection)) {
+                shard_regions.push_back(intersection);
+            }
+        }
+        if (!shard_regions.empty()) {
+            *write_out = write_t(
+                range_replace_t(std::move(shard_regions), rr.pkey, rr.transform,
+                                rr.f, rr.optargs, rr.batchspec),
                 durability_requirement,
                 profile);
             return true;
@@ -1116,6 +1525,14 @@ struct rdb_w_shard_visitor_t : public boost::static_visitor<bool> {
         }
     }
 
+    bool operator()(const range_delete_t &rd) const {
+        return rangey_write(rd);
+    }
+
+    bool operator()(const sindex_range_delete_t &srd) const {
+        return rangey_write(srd);
+    }
+
     bool operator()(const sindex_create_t &c) const {
         return rangey_write(c);
     }
@@ -1167,6 +1584,62 @@ struct rdb_w_unshard_visitor_t : public boost::static_visitor<void> {
         merge_stats();
     }
 
+    void operator()(const combined_insert_t &) const {
+        combined_insert_response_t combined;
+        for (size_t i = 0; i < count; ++i) {
+            const combined_insert_response_t *response_i =
+                boost::get<combined_insert_response_t>(&responses[i].response);
+            guarantee(response_i != NULL);
+            combined.positions.insert(combined.positions.end(),
+                                      response_i->positions.begin(),
+                                      response_i->positions.end());
+            combined.stats.insert(combined.stats.end(),
+                                  response_i->stats.begin(), response_i->stats.end());
+        }
+        *response_out = write_response_t(combined);
+    }
+
+    void operator()(const bulk_insert_t &) const {
+        merge_stats();
+    }
+
+    void operator()(const range_replace_t &) const {
+        range_replace_response_t combined;
+        combined.stats = make_counted<const ql::datum_t>(ql::datum_t::R_OBJECT);
+        for (size_t i = 0; i < count; ++i) {
+            const range_replace_response_t *response_i =
+                boost::get<range_replace_response_t>(&responses[i].response);
+            guarantee(response_i != NULL);
+            combined.stats = combined.stats->merge(response_i->stats, ql::stats_merge);
+            combined.unfinished.insert(combined.unfinished.end(),
+                                       response_i->unfinished.begin(),
+                                       response_i->unfinished.end());
+            if (!combined.error && response_i->error) {
+                combined.error = response_i->error;
+            }
+        }
+        *response_out = write_response_t(combined);
+    }
+
+    void operator()(const range_delete_t &) const {
+        merge_stats();
+    }
+
+    void operator()(const sindex_range_delete_t &) const {
+        sindex_range_delete_response_t combined;
+        combined.stats = make_counted<const ql::datum_t>(ql::datum_t::R_OBJECT);
+        for (size_t i = 0; i < count; ++i) {
+            const sindex_range_delete_response_t *response_i =
+                boost::get<sindex_range_delete_response_t>(&responses[i].response);
+            guarantee(response_i != NULL);
+            combined.stats = combined.stats->merge(response_i->stats, ql::stats_merge);
+            if (!combined.error && response_i->error) {
+                combined.error = response_i->error;
+            }
+        }
+        *response_out = write_response_t(combined);
+    }
+
     void operator()(const point_write_t &) const { monokey_response(); }
     void operator()(const point_delete_t &) const { monokey_response(); }
 
@@ -1207,6 +1680,7 @@ void write_t::unshard(write_response_t *responses, size_t count,
     const rdb_w_unshard_visitor_t visitor(responses, count, response_out);
     boost::apply_visitor(visitor, write);
 
+
     /* We've got some profiling to do. */
     /* This is a tad hacky, some of the methods in rdb_w_unshard_visitor_t set
      * these fields because they just do dumb copies. So we clear them before
@@ -1224,6 +1698,79 @@ void write_t::unshard(write_response_t *responses, size_t count,
     }
 }
 
+
+/* write_t::combine() implementation */
+
+bool write_t::is_combinable() const {
+    // Writes that return values or get profiled have to stay by themselves.
+    const batched_insert_t *bi = boost::get<batched_insert_t>(&write);
+    return bi != NULL && bi->inserts.size() == 1 && !bi->return_vals
+        && profile == profile_bool_t::DONT_PROFILE;
+}
+
+bool write_t::can_combine_with(const write_t &other) const {
+    const batched_insert_t *bi = boost::get<batched_insert_t>(&write);
+    const batched_insert_t *other_bi = boost::get<batched_insert_t>(&other.write);
+    guarantee(bi != NULL && other_bi != NULL);
+    return durability_requirement == other.durability_requirement
+        && bi->pkey == other_bi->pkey
+        && bi->upsert == other_bi->upsert;
+}
+
+void write_t::profile_master(ticks_t received, ticks_t in_order,
+                             write_response_t *response) const {
+    if (profile == profile_bool_t::PROFILE) {
+        profile::wrap_parallel_task("Wait for the broadcaster and the acks.",
+                                    in_order, &response->event_log);
+        profile::prepend_to_parallel_task("Wait for the FIFO enforcer of the master.",
+                                          received, in_order, &response->event_log);
+        profile::wrap_parallel_task("Perform the write on the master.", received,
+                                    &response->event_log);
+    }
+}
+
+void write_t::profile_round_trip(ticks_t sent, write_response_t *response) const {
+    if (profile == profile_bool_t::PROFILE) {
+        profile::wrap_round_trip("Send the write to the master.",
+                                 "Messages in transit.", sent, &response->event_log);
+    }
+}
+
+write_t write_t::combine(const std::vector<const write_t *> &writes) {
+    guarantee(!writes.empty());
+    std::vector<counted_t<const ql::datum_t> > inserts;
+    std::vector<uint64_t> positions;
+    inserts.reserve(writes.size());
+    positions.reserve(writes.size());
+    for (size_t i = 0; i < writes.size(); ++i) {
+        const batched_insert_t *bi = boost::get<batched_insert_t>(&writes[i]->write);
+        guarantee(bi != NULL && bi->inserts.size() == 1);
+        inserts.push_back(bi->inserts[0]);
+        positions.push_back(i);
+    }
+    const batched_insert_t &first = boost::get<batched_insert_t>(writes[0]->write);
+    return write_t(combined_insert_t(std::move(inserts), std::move(positions),
+                                     first.pkey, first.upsert),
+                   writes[0]->durability_requirement,
+                   profile_bool_t::DONT_PROFILE);
+}
+
+void write_t::split_combined_response(
+        const write_response_t &response, size_t count,
+        std::vector<write_response_t> *responses_out) const {
+    const combined_insert_response_t *combined =
+        boost::get<combined_insert_response_t>(&response.response);
+    guarantee(combined != NULL);
+    guarantee(combined->positions.size() == count && combined->stats.size() == count);
+    responses_out->resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        guarantee(combined->positions[i] < count);
+        write_response_t *out = &(*responses_out)[combined->positions[i]];
+        *out = write_response_t(combined->stats[i]);
+        out->n_shards = 1;
+    }
+}
+
 store_t::store_t(serializer_t *serializer,
                  const std::string &perfmon_name,
                  int64_t cache_target,
@@ -1275,6 +1822,15 @@ store_t::~store_t() {
     assert_thread();
 }
 
+ql::changefeed::server_t *store_t::get_changefeed_server() {
+    assert_thread();
+    if (!changefeed_server.has()) {
+        guarantee(ctx->manager != NULL);
+        changefeed_server.init(new ql::changefeed::server_t(ctx->manager));
+    }
+    return changefeed_server.get();
+}
+
 // TODO: get rid of this extra response_t copy on the stack
 struct rdb_read_visitor_t : public boost::static_visitor<void> {
     void operator()(const point_read_t &get) {
@@ -1284,6 +1840,13 @@ struct rdb_read_visitor_t : public boost::static_visitor<void> {
         rdb_get(get.key, btree, txn, superblock, res, ql_env.trace.get_or_null());
     }
 
+    void operator()(const multi_point_read_t &get) {
+        response->response = multi_point_read_response_t();
+        multi_point_read_response_t *res =
+            boost::get<multi_point_read_response_t>(&response->response);
+        rdb_get_multi(get.keys, btree, txn, superblock, res, ql_env.trace.get_or_null());
+    }
+
     void operator()(const rget_read_t &rget) {
         if (rget.transform.size() != 0 || rget.terminal) {
             rassert(rget.optargs.size() != 0);
@@ -1294,6 +1857,78 @@ struct rdb_read_visitor_t : public boost::static_visitor<void> {
             boost::get<rget_read_response_t>(&response->response);
 
         if (!rget.sindex) {
+            // A filter for values of fields that have indexes only reads the
+            // documents all of the indexes have, and an aggregation that only reads
+            // the fields of a projection index scans that instead of the documents.
+            std::vector<std::pair<std::string, counted_t<const ql::datum_t> > >
+                filter_fields;
+            bool may_intersect = get_intersection_fields(rget, &filter_fields);
+            std::vector<std::string> read_fields;
+            bool may_project = rget.terminal
+                && rget.sorting == sorting_t::UNORDERED
+                && query_reads_top_level_fields(rget.transform, rget.terminal,
+                                                &read_fields);
+            // A `groupby` of all the rows by fields reads the summaries of an
+            // aggregate index of those fields, if it has any.
+            std::vector<std::string> group_fields;
+            const ql::groupby_wire_func_t *groupby = get_summarizable_groupby(
+                rget, &group_fields);
+            if (may_intersect || may_project || groupby != NULL) {
+                scoped_ptr_t<buf_lock_t> sindex_block;
+                store->acquire_sindex_block_for_read(token_pair, txn, &sindex_block,
+                                                     superblock->get_sindex_block_id(),
+                                                     &interruptor);
+                std::map<std::string, secondary_index_t> sindexes;
+                get_secondary_indexes(txn, sindex_block.get(), &sindexes);
+
+                std::string aggregate_id;
+                scoped_ptr_t<real_superblock_t> aggregate_sb;
+                if (groupby != NULL
+                    && acquire_aggregate_index(*groupby, group_fields, sindexes,
+                                               &aggregate_sb, &aggregate_id)) {
+                    if (rdb_read_aggregate_index(
+                            store->get_sindex_slice(aggregate_id), aggregate_sb.get(),
+                            txn, groupby->get_aggregator(), res,
+                            ql_env.trace.get_or_null())) {
+                        return;
+                    }
+                    aggregate_sb.reset();
+                }
+
+                boost::ptr_vector<real_superblock_t> sindex_superblocks;
+                std::vector<rdb_equality_index_t> indexes;
+                if (may_intersect
+                    && acquire_intersection_indexes(filter_fields, sindexes,
+                                                    &sindex_superblocks, &indexes)) {
+                    sindex_block.reset();
+                    rdb_rget_intersection_slice(btree, rget.region.inner, txn,
+                                                superblock, &ql_env, rget.batchspec,
+                                                rget.transform, rget.terminal,
+                                                indexes, res);
+                    return;
+                }
+
+                scoped_ptr_t<real_superblock_t> projection_sb;
+                std::string projection_id;
+                ql::map_wire_func_t projection_mapping;
+                std::vector<std::string> projected_fields;
+                if (may_project
+                    && acquire_projection_index(read_fields, sindexes, &projection_sb,
+                                                &projection_id, &projection_mapping,
+                                                &projected_fields)) {
+                    sindex_block.reset();
+                    rdb_rget_secondary_slice(
+                        store->get_sindex_slice(projection_id),
+                        datum_range_t::universe(), region_t::universe(),
+                        txn, projection_sb.get(), &ql_env, rget.batchspec,
+                        rget.transform, rget.terminal, rget.region.inner,
+                        rget.sorting, projection_mapping,
+                        sindex_multi_bool_t::PROJECTION,
+                        ql::sindex_key_format_t::BINARY, projected_fields, btree,
+                        superblock, res);
+                    return;
+                }
+            }
             // Normal rget
             rdb_rget_slice(btree, rget.region.inner, txn, superblock,
                            &ql_env, rget.batchspec, rget.transform, rget.terminal,
@@ -1330,29 +1965,256 @@ struct rdb_read_visitor_t : public boost::static_visitor<void> {
             //  between sindex_start_value and sindex_end_value.
             ql::map_wire_func_t sindex_mapping;
             sindex_multi_bool_t multi_bool = sindex_multi_bool_t::MULTI;
-            vector_read_stream_t read_stream(&sindex_mapping_data);
-            archive_result_t success = deserialize(&read_stream, &sindex_mapping);
-            guarantee_deserialization(success, "sindex description");
-            success = deserialize(&read_stream, &multi_bool);
-            guarantee_deserialization(success, "sindex description");
+            std::vector<std::string> stored_fields;
+            ql::sindex_key_format_t key_format;
+            deserialize_sindex_info(sindex_mapping_data, &sindex_mapping, &multi_bool,
+                                    &stored_fields, &key_format);
+
+            // Only the summaries of an aggregate index get read.
+            if (multi_bool == sindex_multi_bool_t::AGGREGATE) {
+                res->result = ql::datum_exc_t(
+                    ql::base_exc_t::GENERIC,
+                    strprintf("Index `%s` is an aggregate index, which only "
+                              "answers `groupby`.",
+                              rget.sindex->id.c_str()));
+                return;
+            }
+
+            // The keys of a hash index don't keep the order of its values.
+            if (key_format == ql::sindex_key_format_t::HASH
+                && (rget.sorting != sorting_t::UNORDERED
+                    || !rget.sindex->original_range.is_point())) {
+                res->result = ql::datum_exc_t(
+                    ql::base_exc_t::GENERIC,
+                    strprintf("Index `%s` is a hash index, which can only be "
+                              "read with `get_all`.",
+                              rget.sindex->id.c_str()));
+                return;
+            }
 
             rdb_rget_secondary_slice(
                 store->get_sindex_slice(rget.sindex->id),
                 rget.sindex->original_range, rget.sindex->region,
                 txn, sindex_sb.get(), &ql_env, rget.batchspec, rget.transform,
                 rget.terminal, rget.region.inner, rget.sorting,
-                sindex_mapping, multi_bool, res);
+                sindex_mapping, multi_bool, key_format, stored_fields, btree,
+                superblock, res);
+        }
+    }
+
+    // Returns true if the filter of `rget` only passes documents with some values
+    // of at least two of their fields, and adds those to `*fields_out`.
+    bool get_intersection_fields(
+            const rget_read_t &rget,
+            std::vector<std::pair<std::string, counted_t<const ql::datum_t> > >
+                *fields_out) {
+        if (rget.sorting != sorting_t::UNORDERED || rget.transform.empty()) {
+            return false;
+        }
+        const filter_transform_t *filter
+            = boost::get<filter_transform_t>(&rget.transform.front());
+        // With a default, documents without the fields may pass.
+        if (filter == NULL || filter->default_filter_val) {
+            return false;
+        }
+        try {
+            if (!ql::func_requires_field_values(filter->filter_func.compile_wire_func(),
+                                                fields_out)
+                || fields_out->size() < 2) {
+                fields_out->clear();
+                return false;
+            }
+        } catch (const ql::base_exc_t &) {
+            // The transform reports the error when it gets applied.
+            fields_out->clear();
+            return false;
+        }
+        return true;
+    }
+
+    // Acquires the indexes of `sindexes` that can answer a filter for the values
+    // of `fields`, if at least two of the fields have an index that
+    // rdb_rget_intersection_slice() can use.
+    bool acquire_intersection_indexes(
+            const std::vector<std::pair<std::string, counted_t<const ql::datum_t> > >
+                &fields,
+            const std::map<std::string, secondary_index_t> &sindexes,
+            boost::ptr_vector<real_superblock_t> *superblocks_out,
+            std::vector<rdb_equality_index_t> *indexes_out) {
+        std::vector<bool> indexed(fields.size(), false);
+        for (auto it = sindexes.begin(); it != sindexes.end(); ++it) {
+            if (!it->second.post_construction_complete) {
+                continue;
+            }
+            ql::map_wire_func_t mapping;
+            sindex_multi_bool_t multi;
+            std::vector<std::string> stored_fields;
+            ql::sindex_key_format_t key_format;
+            deserialize_sindex_info(it->second.opaque_definition, &mapping, &multi,
+                                    &stored_fields, &key_format);
+            // Legacy keys of equal numbers may differ.
+            if (multi != sindex_multi_bool_t::SINGLE
+                || key_format == ql::sindex_key_format_t::LEGACY) {
+                continue;
+            }
+            std::string field;
+            try {
+                scoped_ptr_t<ql::field_extractor_t> extractor(
+                    ql::field_extractor_t::create(mapping.compile_wire_func()));
+                if (!extractor.has() || !extractor->gets_top_level_field(&field)) {
+                    continue;
+                }
+            } catch (const ql::base_exc_t &) {
+                continue;
+            }
+            for (size_t i = 0; i < fields.size(); ++i) {
+                if (indexed[i] || fields[i].first != field) {
+                    continue;
+                }
+                std::string secondary = key_to_unescaped_str(
+                    fields[i].second->truncated_secondary(key_format));
+                if (secondary.size() >= ql::datum_t::max_trunc_size()) {
+                    continue;
+                }
+                indexed[i] = true;
+                buf_lock_t superblock_lock(txn, it->second.superblock, rwi_read);
+                superblocks_out->push_back(new real_superblock_t(&superblock_lock));
+                rdb_equality_index_t index;
+                index.slice = store->get_sindex_slice(it->first);
+                index.superblock = &superblocks_out->back();
+                index.secondary = secondary;
+                indexes_out->push_back(index);
+                break;
+            }
+        }
+        if (indexes_out->size() < 2) {
+            indexes_out->clear();
+            superblocks_out->clear();
+            return false;
+        }
+        return true;
+    }
+
+    // Returns the `groupby` of `rget` if it aggregates all the rows of the shard
+    // with COUNT, SUM or AVG, grouped by plucking their `*fields_out`, like an
+    // aggregate index might.
+    const ql::groupby_wire_func_t *get_summarizable_groupby(
+            const rget_read_t &rget, std::vector<std::string> *fields_out) {
+        // The btree only holds the documents of its region, like the count from the
+        // stat block in rdb_rget_slice() goes by.
+        if (!rget.terminal || !rget.transform.empty()
+            || !(rget.region.inner == key_range_t::universe())) {
+            return NULL;
+        }
+        const ql::groupby_wire_func_t *groupby
+            = boost::get<ql::groupby_wire_func_t>(&*rget.terminal);
+        if (groupby == NULL
+            || groupby->get_aggregator() == ql::group_aggregator_t::MIN
+            || groupby->get_aggregator() == ql::group_aggregator_t::MAX) {
+            return NULL;
+        }
+        try {
+            if (!ql::func_plucks_top_level_fields(groupby->compile_group(), fields_out)) {
+                return NULL;
+            }
+        } catch (const ql::base_exc_t &) {
+            // The terminal reports the error when it gets applied.
+            return NULL;
+        }
+        return groupby;
+    }
+
+    // Acquires an aggregate index of `sindexes` that groups by plucking `fields`
+    // and sums up the field of `groupby`, if it needs one.
+    bool acquire_aggregate_index(const ql::groupby_wire_func_t &groupby,
+                                 const std::vector<std::string> &fields,
+                                 const std::map<std::string, secondary_index_t> &sindexes,
+                                 scoped_ptr_t<real_superblock_t> *superblock_out,
+                                 std::string *id_out) {
+        for (auto it = sindexes.begin(); it != sindexes.end(); ++it) {
+            if (!it->second.post_construction_complete) {
+                continue;
+            }
+            ql::map_wire_func_t mapping;
+            sindex_multi_bool_t multi;
+            std::vector<std::string> stored_fields;
+            ql::sindex_key_format_t key_format;
+            deserialize_sindex_info(it->second.opaque_definition, &mapping, &multi,
+                                    &stored_fields, &key_format);
+            if (multi != sindex_multi_bool_t::AGGREGATE
+                || (groupby.get_aggregator() != ql::group_aggregator_t::COUNT
+                    && (stored_fields.size() != 1
+                        || stored_fields[0] != groupby.get_field()))) {
+                continue;
+            }
+            std::vector<std::string> index_fields;
+            try {
+                if (!ql::func_plucks_top_level_fields(mapping.compile_wire_func(),
+                                                      &index_fields)
+                    || index_fields != fields) {
+                    continue;
+                }
+            } catch (const ql::base_exc_t &) {
+                continue;
+            }
+            buf_lock_t superblock_lock(txn, it->second.superblock, rwi_read);
+            superblock_out->init(new real_superblock_t(&superblock_lock));
+            *id_out = it->first;
+            return true;
+        }
+        return false;
+    }
+
+    // Acquires a projection index of `sindexes` that stores all of `fields`.
+    bool acquire_projection_index(const std::vector<std::string> &fields,
+                                  const std::map<std::string, secondary_index_t> &sindexes,
+                                  scoped_ptr_t<real_superblock_t> *superblock_out,
+                                  std::string *id_out,
+                                  ql::map_wire_func_t *mapping_out,
+                                  std::vector<std::string> *stored_fields_out) {
+        for (auto it = sindexes.begin(); it != sindexes.end(); ++it) {
+            if (!it->second.post_construction_complete) {
+                continue;
+            }
+            ql::map_wire_func_t mapping;
+            sindex_multi_bool_t multi;
+            std::vector<std::string> stored_fields;
+            ql::sindex_key_format_t key_format;
+            deserialize_sindex_info(it->second.opaque_definition, &mapping, &multi,
+                                    &stored_fields, &key_format);
+            if (multi != sindex_multi_bool_t::PROJECTION) {
+                continue;
+            }
+            std::set<std::string> stored(stored_fields.begin(), stored_fields.end());
+            bool covered = true;
+            for (size_t i = 0; i < fields.size(); ++i) {
+                if (stored.count(fields[i]) == 0) {
+                    covered = false;
+                    break;
+                }
+            }
+            if (!covered) {
+                continue;
+            }
+            buf_lock_t superblock_lock(txn, it->second.superblock, rwi_read);
+            superblock_out->init(new real_superblock_t(&superblock_lock));
+            *id_out = it->first;
+            *mapping_out = mapping;
+            stored_fields_out->swap(stored_fields);
+            return true;
         }
+        return false;
     }
 
     void operator()(const distribution_read_t &dg) {
         response->response = distribution_read_response_t();
         distribution_read_response_t *res = boost::get<distribution_read_response_t>(&response->response);
-        rdb_distribution_get(btree, dg.max_depth, dg.region.inner.left, txn, superblock, res);
+        rdb_distribution_get(btree, dg.mode, dg.max_depth, dg.region.inner.left, txn, superblock, res);
         for (std::map<store_key_t, int64_t>::iterator it = res->key_counts.begin(); it != res->key_counts.end(); ) {
             if (!dg.region.inner.contains_key(store_key_t(it->first))) {
                 std::map<store_key_t, int64_t>::iterator tmp = it;
                 ++it;
+                res->byte_counts.erase(tmp->first);
                 res->key_counts.erase(tmp);
             } else {
                 ++it;
@@ -1361,7 +2223,7 @@ struct rdb_read_visitor_t : public boost::static_visitor<void> {
 
         // If the result is larger than the requested limit, scale it down
         if (dg.result_limit > 0 && res->key_counts.size() > dg.result_limit) {
-            scale_down_distribution(dg.result_limit, &res->key_counts);
+            scale_down_distribution(dg.result_limit, &res->key_counts, &res->byte_counts);
         }
 
         res->region = dg.region;
@@ -1390,8 +2252,9 @@ struct rdb_read_visitor_t : public boost::static_visitor<void> {
         for (auto it = sindexes.begin(); it != sindexes.end(); ++it) {
             if (std_contains(sindex_status.sindexes, it->first) ||
                 sindex_status.sindexes.empty()) {
+                double elapsed_secs;
                 progress_completion_fraction_t frac =
-                    store->get_progress(it->second.id);
+                    store->get_progress(it->second.id, &elapsed_secs);
                 rdb_protocol_details::single_sindex_status_t *s =
                     &res->statuses[it->first];
                 s->ready = it->second.post_construction_complete;
@@ -1403,13 +2266,73 @@ struct rdb_read_visitor_t : public boost::static_visitor<void> {
                         s->blocks_processed = frac.estimate_of_released_nodes;
                         s->blocks_total = frac.estimate_of_total_nodes;
                     }
+                    s->eta_secs = -1;
+                    if (s->blocks_processed != 0) {
+                        s->eta_secs = elapsed_secs
+                            * (s->blocks_total - s->blocks_processed) / s->blocks_processed;
+                    }
                 }
             }
         }
     }
 
+    void operator()(const changefeed_subscribe_t &s) {
+        // The read token orders the subscription after the writes before it, so
+        // the feed gets exactly the changes of the writes after it.
+        ql::changefeed::server_t *server = store->get_changefeed_server();
+        server->add_client(s.id, s.addr, s.region);
+        response->response = changefeed_subscribe_response_t();
+        auto res = boost::get<changefeed_subscribe_response_t>(&response->response);
+        res->servers.push_back(server->get_stop_addr());
+    }
+
+    void operator()(const text_search_t &search) {
+        response->response = text_search_response_t();
+        text_search_response_t *res =
+            boost::get<text_search_response_t>(&response->response);
+
+        scoped_ptr_t<real_superblock_t> sindex_sb;
+        std::vector<char> sindex_mapping_data;
+        try {
+            bool found = store->acquire_sindex_superblock_for_read(search.sindex,
+                    superblock->get_sindex_block_id(), token_pair,
+                    txn, &sindex_sb, &sindex_mapping_data, &interruptor);
+            if (!found) {
+                res->result = ql::datum_exc_t(
+                    ql::base_exc_t::GENERIC,
+                    strprintf("Index `%s` was not found.", search.sindex.c_str()));
+                return;
+            }
+        } catch (const sindex_not_post_constructed_exc_t &) {
+            res->result = ql::datum_exc_t(
+                ql::base_exc_t::GENERIC,
+                strprintf("Index `%s` was accessed before "
+                          "its construction was finished.",
+                          search.sindex.c_str()));
+            return;
+        }
+
+        ql::map_wire_func_t sindex_mapping;
+        sindex_multi_bool_t multi_bool = sindex_multi_bool_t::MULTI;
+        std::vector<std::string> stored_fields;
+        ql::sindex_key_format_t key_format;
+        deserialize_sindex_info(sindex_mapping_data, &sindex_mapping, &multi_bool,
+                                &stored_fields, &key_format);
+        if (multi_bool != sindex_multi_bool_t::TEXT) {
+            res->result = ql::datum_exc_t(
+                ql::base_exc_t::GENERIC,
+                strprintf("Index `%s` is not a text index.", search.sindex.c_str()));
+            return;
+        }
+
+        rdb_text_search(store->get_sindex_slice(search.sindex), sindex_sb.get(),
+                        btree, superblock, txn, &ql_env, sindex_mapping,
+                        search.terms, search.phrase, search.limit,
+                        search.region.inner, res);
+    }
+
     rdb_read_visitor_t(btree_slice_t *_btree,
-                       btree_store_t<rdb_protocol_t> *_store,
+                       store_t *_store,
                        transaction_t *_txn,
                        superblock_t *_superblock,
                        read_token_pair_t *_token_pair,
@@ -1453,7 +2376,7 @@ struct rdb_read_visitor_t : public boost::static_visitor<void> {
 private:
     read_response_t *response;
     btree_slice_t *btree;
-    btree_store_t<rdb_protocol_t> *store;
+    store_t *store;
     transaction_t *txn;
     superblock_t *superblock;
     read_token_pair_t *token_pair;
@@ -1461,6 +2384,17 @@ private:
     ql::env_t ql_env;
 };
 
+// Adds how many blocks the transaction found in the cache and how many it loaded to
+// the profile, as a task that takes no time.
+void profile_cache_usage(const transaction_t *txn, const scoped_ptr_t<profile::trace_t> &trace) {
+    if (trace.has()) {
+        profile::starter_t cache_usage(
+            strprintf("Cache: %" PRIi64 " hits, %" PRIi64 " block loads.",
+                      txn->get_cache_hits(), txn->get_block_loads()),
+            trace);
+    }
+}
+
 void store_t::protocol_read(const read_t &read,
                             read_response_t *response,
                             btree_slice_t *btree,
@@ -1474,6 +2408,7 @@ void store_t::protocol_read(const read_t &read,
     {
         profile::starter_t start_write("Perform read on shard.", v.get_env()->trace);
         boost::apply_visitor(v, read.read);
+        profile_cache_usage(txn, v.get_env()->trace);
     }
 
     response->n_shards = 1;
@@ -1484,24 +2419,30 @@ void store_t::protocol_read(const read_t &read,
 
 class func_replacer_t : public btree_batched_replacer_t {
 public:
-    func_replacer_t(ql::env_t *_env, const ql::wire_func_t &wf, bool _return_vals)
-        : env(_env), f(wf.compile_wire_func()), return_vals(_return_vals) { }
+    func_replacer_t(ql::env_t *_env, const ql::wire_func_t &wf, bool _return_vals,
+                    bool _return_stats)
+        : env(_env), f(wf.compile_wire_func()), return_vals(_return_vals),
+          return_stats(_return_stats) { }
     counted_t<const ql::datum_t> replace(
         const counted_t<const ql::datum_t> &d, size_t) const {
         return f->call(env, d)->as_datum();
     }
     bool should_return_vals() const { return return_vals; }
+    bool should_return_stats() const { return return_stats; }
 private:
     ql::env_t *const env;
     const counted_t<ql::func_t> f;
     const bool return_vals;
+    const bool return_stats;
 };
 
 class datum_replacer_t : public btree_batched_replacer_t {
 public:
     datum_replacer_t(const std::vector<counted_t<const ql::datum_t> > *_datums,
-                     bool _upsert, const std::string &_pkey, bool _return_vals)
-        : datums(_datums), upsert(_upsert), pkey(_pkey), return_vals(_return_vals) { }
+                     bool _upsert, const std::string &_pkey, bool _return_vals,
+                     bool _return_stats)
+        : datums(_datums), upsert(_upsert), pkey(_pkey), return_vals(_return_vals),
+          return_stats(_return_stats) { }
     counted_t<const ql::datum_t> replace(
         const counted_t<const ql::datum_t> &d, size_t index) const {
         guarantee(index < datums->size());
@@ -1516,11 +2457,13 @@ public:
         unreachable();
     }
     bool should_return_vals() const { return return_vals; }
+    bool should_return_stats() const { return return_stats; }
 private:
     const std::vector<counted_t<const ql::datum_t> > *const datums;
     const bool upsert;
     const std::string pkey;
     const bool return_vals;
+    const bool return_stats;
 };
 
 // TODO: get rid of this extra response_t copy on the stack
@@ -1536,8 +2479,9 @@ struct rdb_write_visitor_t : public boost::static_visitor<void> {
         rdb_modification_report_cb_t sindex_cb(
             store, token_pair, txn,
             (*superblock)->get_sindex_block_id(),
-            auto_drainer_t::lock_t(&store->drainer));
-        func_replacer_t replacer(&ql_env, br.f, br.return_vals);
+            auto_drainer_t::lock_t(&store->drainer),
+            store->changefeed_server_if_any());
+        func_replacer_t replacer(&ql_env, br.f, br.return_vals, br.return_stats);
         response->response =
             rdb_batched_replace(
                 btree_info_t(btree, timestamp, txn, &br.pkey),
@@ -1549,8 +2493,10 @@ struct rdb_write_visitor_t : public boost::static_visitor<void> {
         rdb_modification_report_cb_t sindex_cb(
             store, token_pair, txn,
             (*superblock)->get_sindex_block_id(),
-            auto_drainer_t::lock_t(&store->drainer));
-        datum_replacer_t replacer(&bi.inserts, bi.upsert, bi.pkey, bi.return_vals);
+            auto_drainer_t::lock_t(&store->drainer),
+            store->changefeed_server_if_any());
+        datum_replacer_t replacer(&bi.inserts, bi.upsert, bi.pkey, bi.return_vals,
+                                  bi.return_stats);
         std::vector<store_key_t> keys;
         keys.reserve(bi.inserts.size());
         for (auto it = bi.inserts.begin(); it != bi.inserts.end(); ++it) {
@@ -1563,6 +2509,133 @@ struct rdb_write_visitor_t : public boost::static_visitor<void> {
                 ql_env.trace.get_or_null());
     }
 
+    void operator()(const combined_insert_t &ci) {
+        rdb_modification_report_cb_t sindex_cb(
+            store, token_pair, txn,
+            (*superblock)->get_sindex_block_id(),
+            auto_drainer_t::lock_t(&store->drainer),
+            store->changefeed_server_if_any());
+        datum_replacer_t replacer(&ci.inserts, ci.upsert, ci.pkey, false, true);
+        std::vector<store_key_t> keys;
+        keys.reserve(ci.inserts.size());
+        for (auto it = ci.inserts.begin(); it != ci.inserts.end(); ++it) {
+            keys.emplace_back((*it)->get(ci.pkey)->print_primary());
+        }
+        combined_insert_response_t combined;
+        combined.positions = ci.positions;
+        rdb_batched_replace(
+            btree_info_t(btree, timestamp, txn, &ci.pkey),
+            superblock, keys, &replacer, &sindex_cb,
+            ql_env.trace.get_or_null(), &combined.stats);
+        response->response = combined;
+    }
+
+    void operator()(const bulk_insert_t &bi) {
+        value_sizer_t<rdb_value_t> sizer(txn->get_cache()->get_block_size());
+        if (!btree_is_empty(&sizer, txn, superblock->get())) {
+            std::vector<counted_t<const ql::datum_t> > inserts(bi.inserts);
+            (*this)(batched_insert_t(std::move(inserts), bi.pkey, false, false, true));
+            return;
+        }
+
+        std::vector<rdb_modification_report_t> mod_reports;
+        response->response =
+            rdb_bulk_load(bi.inserts, bi.pkey, bi.fill_factor, btree, timestamp,
+                          txn, superblock->get(), &mod_reports);
+
+        bulk_load_sindexes(mod_reports, bi.fill_factor);
+    }
+
+    void operator()(const range_replace_t &rr) {
+        try {
+            ql_env.global_optargs.init_optargs(rr.optargs);
+        } catch (const interrupted_exc_t &) {
+            // Clear the sindex_write_token because we didn't have a chance to use it
+            token_pair->sindex_write_token.reset();
+            throw;
+        }
+        range_replace_response_t res;
+        std::vector<store_key_t> keys;
+        for (auto it = rr.regions.begin(); it != rr.regions.end(); ++it) {
+            // We keep the superblock, since we write with it below.
+            rget_read_response_t scan;
+            rdb_rget_slice(btree, it->inner, txn, superblock->get(), &ql_env,
+                           rr.batchspec, rr.transform,
+                           boost::optional<rdb_protocol_details::terminal_t>(),
+                           sorting_t::UNORDERED, &scan, false);
+            if (const ql::exc_t *e = boost::get<ql::exc_t>(&scan.result)) {
+                res.error = *e;
+                break;
+            } else if (const ql::datum_exc_t *e
+                       = boost::get<ql::datum_exc_t>(&scan.result)) {
+                res.error = ql::exc_t(*e, NULL);
+                break;
+            }
+            const rget_read_response_t::stream_t *stream
+                = boost::get<rget_read_response_t::stream_t>(&scan.result);
+            guarantee(stream != NULL);
+            for (auto jt = stream->begin(); jt != stream->end(); ++jt) {
+                keys.push_back(jt->key);
+            }
+            if (scan.truncated) {
+                // Everything up to `last_considered_key` went into this batch.
+                region_t rest = *it;
+                rest.inner.left = scan.last_considered_key;
+                if (rest.inner.left.increment() && !rest.inner.is_empty()) {
+                    res.unfinished.push_back(rest);
+                }
+            }
+        }
+
+        if (res.error) {
+            // The parser fails the query, so we don't replace what came before.
+            keys.clear();
+            res.unfinished.clear();
+        }
+        if (keys.empty()) {
+            token_pair->sindex_write_token.reset();
+            res.stats = make_counted<const ql::datum_t>(ql::datum_t::R_OBJECT);
+        } else {
+            rdb_modification_report_cb_t sindex_cb(
+                store, token_pair, txn,
+                (*superblock)->get_sindex_block_id(),
+                auto_drainer_t::lock_t(&store->drainer),
+                store->changefeed_server_if_any());
+            func_replacer_t replacer(&ql_env, rr.f, false, true);
+            res.stats = rdb_batched_replace(
+                btree_info_t(btree, timestamp, txn, &rr.pkey),
+                superblock, keys, &replacer, &sindex_cb,
+                ql_env.trace.get_or_null());
+        }
+        response->response = res;
+    }
+
+    void operator()(const range_delete_t &rd) {
+        int64_t deleted = rdb_delete_range(
+            btree, rd.region.inner, timestamp, txn, superblock->get(), store,
+            token_pair, store->changefeed_server_if_any(), &interruptor);
+        ql::datum_ptr_t stats(ql::datum_t::R_OBJECT);
+        if (deleted != 0) {
+            UNUSED bool b = stats.add(
+                "deleted", make_counted<ql::datum_t>(static_cast<double>(deleted)));
+        }
+        response->response = stats.to_counted();
+    }
+
+    void operator()(const sindex_range_delete_t &srd) {
+        rdb_modification_report_cb_t sindex_cb(
+            store, token_pair, txn,
+            (*superblock)->get_sindex_block_id(),
+            auto_drainer_t::lock_t(&store->drainer),
+            store->changefeed_server_if_any());
+        sindex_range_delete_response_t res;
+        res.stats = rdb_delete_sindex_range(
+            btree_info_t(btree, timestamp, txn, &srd.pkey), superblock,
+            srd.sindex, srd.sindex_range, srd.region.inner, &ql_env, &sindex_cb,
+            &res.error, ql_env.trace.get_or_null());
+        response->response = res;
+    }
+
     void operator()(const point_write_t &w) {
         response->response = point_write_response_t();
         point_write_response_t *res =
@@ -1593,6 +2666,8 @@ struct rdb_write_visitor_t : public boost::static_visitor<void> {
         write_message_t wm;
         wm << c.mapping;
         wm << c.multi;
+        wm << c.stored_fields;
+        wm << c.key_format;
 
         vector_stream_t stream;
         int write_res = send_write_message(&stream, &wm);
@@ -1647,7 +2722,7 @@ struct rdb_write_visitor_t : public boost::static_visitor<void> {
 
 
     rdb_write_visitor_t(btree_slice_t *_btree,
-                        btree_store_t<rdb_protocol_t> *_store,
+                        store_t *_store,
                         transaction_t *_txn,
                         scoped_ptr_t<superblock_t> *_superblock,
                         write_token_pair_t *_token_pair,
@@ -1706,10 +2781,42 @@ private:
         sindex_access_vector_t sindexes;
         store->aquire_post_constructed_sindex_superblocks_for_write(sindex_block.get(), txn, &sindexes);
         rdb_update_sindexes(sindexes, mod_report, txn);
+
+        if (ql::changefeed::server_t *server = store->changefeed_server_if_any()) {
+            server->send_change(*mod_report);
+        }
+    }
+
+    void bulk_load_sindexes(const std::vector<rdb_modification_report_t> &mod_reports,
+                            double fill_factor) {
+        scoped_ptr_t<buf_lock_t> sindex_block;
+        // Don't allow interruption here, or we may end up with inconsistent data
+        cond_t dummy_interruptor;
+        store->acquire_sindex_block_for_write(token_pair, txn, &sindex_block,
+                                              sindex_block_id, &dummy_interruptor);
+
+        mutex_t::acq_t acq;
+        store->lock_sindex_queue(sindex_block.get(), &acq);
+
+        for (auto it = mod_reports.begin(); it != mod_reports.end(); ++it) {
+            write_message_t wm;
+            wm << rdb_sindex_change_t(*it);
+            store->sindex_queue_push(wm, &acq);
+        }
+
+        sindex_access_vector_t sindexes;
+        store->aquire_post_constructed_sindex_superblocks_for_write(sindex_block.get(), txn, &sindexes);
+        rdb_bulk_load_sindexes(sindexes, mod_reports, fill_factor, txn);
+
+        if (ql::changefeed::server_t *server = store->changefeed_server_if_any()) {
+            for (auto it = mod_reports.begin(); it != mod_reports.end(); ++it) {
+                server->send_change(*it);
+            }
+        }
     }
 
     btree_slice_t *btree;
-    btree_store_t<rdb_protocol_t> *store;
+    store_t *store;
     transaction_t *txn;
     write_response_t *response;
     scoped_ptr_t<superblock_t> *superblock;
@@ -1733,6 +2840,7 @@ void store_t::protocol_write(const write_t &write,
     {
         profile::starter_t start_write("Perform write on shard.", v.get_env()->trace);
         boost::apply_visitor(v, write.write);
+        profile_cache_usage(txn, v.get_env()->trace);
     }
 
     response->n_shards = 1;
@@ -1757,6 +2865,14 @@ struct rdb_backfill_chunk_get_btree_repli_timestamp_visitor_t : public boost::st
     repli_timestamp_t operator()(const backfill_chunk_t::sindexes_t &) {
         return repli_timestamp_t::invalid;
     }
+
+    repli_timestamp_t operator()(const backfill_chunk_t::key_value_pairs_t &kvs) {
+        repli_timestamp_t latest = repli_timestamp_t::distant_past;
+        for (auto it = kvs.backfill_atoms.begin(); it != kvs.backfill_atoms.end(); ++it) {
+            latest = std::max(latest, it->recency);
+        }
+        return latest;
+    }
 };
 
 repli_timestamp_t backfill_chunk_t::get_btree_repli_timestamp() const THROWS_NOTHING {
@@ -1768,46 +2884,94 @@ struct rdb_backfill_callback_impl_t : public rdb_backfill_callback_t {
 public:
     typedef backfill_chunk_t chunk_t;
 
-    explicit rdb_backfill_callback_impl_t(chunk_fun_callback_t<rdb_protocol_t> *_chunk_fun_cb)
-        : chunk_fun_cb(_chunk_fun_cb) { }
+    rdb_backfill_callback_impl_t(chunk_fun_callback_t<rdb_protocol_t> *_chunk_fun_cb,
+                                 const region_t &_region)
+        : chunk_fun_cb(_chunk_fun_cb), region(_region), pending_bytes(0) { }
     ~rdb_backfill_callback_impl_t() { }
 
     void on_delete_range(const key_range_t &range, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) {
+        mutex_t::acq_t acq(&send_mutex);
+        send_pending_atoms(interruptor);
         chunk_fun_cb->send_chunk(chunk_t::delete_range(region_t(range)), interruptor);
     }
 
     void on_deletion(const btree_key_t *key, repli_timestamp_t recency, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) {
+        mutex_t::acq_t acq(&send_mutex);
+        send_pending_atoms(interruptor);
         chunk_fun_cb->send_chunk(chunk_t::delete_key(to_store_key(key), recency), interruptor);
     }
 
     void on_keyvalue(const rdb_backfill_atom_t &atom, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) {
-        chunk_fun_cb->send_chunk(chunk_t::set_key(atom), interruptor);
+        pending_atoms.push_back(atom);
+        pending_bytes += atom.key.size() + serialized_size(atom.value);
+        if (pending_bytes >= BACKFILL_CHUNK_MAX_BYTES) {
+            mutex_t::acq_t acq(&send_mutex);
+            send_pending_atoms(interruptor);
+        }
     }
 
     void on_sindexes(const std::map<std::string, secondary_index_t> &sindexes, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) {
+        mutex_t::acq_t acq(&send_mutex);
+        send_pending_atoms(interruptor);
         chunk_fun_cb->send_chunk(chunk_t::sindexes(sindexes), interruptor);
     }
 
+    void on_range_done(const key_range_t &range, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) {
+        mutex_t::acq_t acq(&send_mutex);
+        send_pending_atoms(interruptor);
+        chunk_fun_cb->send_checkpoint(region_intersection(region, region_t(range)), interruptor);
+    }
+
+    // Sends the key/value pairs that haven't filled a chunk yet.
+    void finish(signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) {
+        mutex_t::acq_t acq(&send_mutex);
+        send_pending_atoms(interruptor);
+    }
+
 protected:
     store_key_t to_store_key(const btree_key_t *key) {
         return store_key_t(key->size, key->contents);
     }
 
 private:
+    // Must be called with `send_mutex` held.  The streams of the backfill call us
+    // at once, and a checkpoint must not overtake the key/value pairs of its range
+    // that another stream took out of `pending_atoms` but is still sending.
+    void send_pending_atoms(signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) {
+        if (pending_atoms.empty()) {
+            return;
+        }
+        std::vector<rdb_backfill_atom_t> atoms;
+        atoms.swap(pending_atoms);
+        pending_bytes = 0;
+        if (atoms.size() == 1) {
+            chunk_fun_cb->send_chunk(chunk_t::set_key(atoms[0]), interruptor);
+        } else {
+            chunk_fun_cb->send_chunk(chunk_t::set_keys(atoms), interruptor);
+        }
+    }
+
     chunk_fun_callback_t<rdb_protocol_t> *chunk_fun_cb;
+    /* The part of the store being backfilled; the btree only knows about the
+    key ranges. */
+    region_t region;
+
+    // The key/value pairs for the next chunk, and about how big they are.
+    std::vector<rdb_backfill_atom_t> pending_atoms;
+    size_t pending_bytes;
+    mutex_t send_mutex;
 
     DISABLE_COPYING(rdb_backfill_callback_impl_t);
 };
 
 static void call_rdb_backfill(int i, btree_slice_t *btree, const std::vector<std::pair<region_t, state_timestamp_t> > &regions,
-        rdb_backfill_callback_t *callback, transaction_t *txn, superblock_t *superblock, buf_lock_t *sindex_block, backfill_progress_t *progress,
+        chunk_fun_callback_t<rdb_protocol_t> *chunk_fun_cb, transaction_t *txn, superblock_t *superblock, buf_lock_t *sindex_block, backfill_progress_t *progress,
         signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) {
-    parallel_traversal_progress_t *p = new parallel_traversal_progress_t;
-    scoped_ptr_t<traversal_progress_t> p_owned(p);
-    progress->add_constituent(&p_owned);
     repli_timestamp_t timestamp = regions[i].second.to_repli_timestamp();
+    rdb_backfill_callback_impl_t callback(chunk_fun_cb, regions[i].first);
     try {
-        rdb_backfill(btree, regions[i].first.inner, timestamp, callback, txn, superblock, sindex_block, p, interruptor);
+        rdb_backfill(btree, regions[i].first.inner, timestamp, &callback, txn, superblock, sindex_block, progress, interruptor);
+        callback.finish(interruptor);
     } catch (const interrupted_exc_t &) {
         /* do nothing; `protocol_send_backfill()` will notice that interruptor
         has been pulsed */
@@ -1824,11 +2988,10 @@ void store_t::protocol_send_backfill(const region_map_t<rdb_protocol_t, state_ti
                                      signal_t *interruptor)
                                      THROWS_ONLY(interrupted_exc_t) {
     with_priority_t p(CORO_PRIORITY_BACKFILL_SENDER);
-    rdb_backfill_callback_impl_t callback(chunk_fun_cb);
     std::vector<std::pair<region_t, state_timestamp_t> > regions(start_point.begin(), start_point.end());
     refcount_superblock_t refcount_wrapper(superblock, regions.size());
     pmap(regions.size(), boost::bind(&call_rdb_backfill, _1,
-        btree, regions, &callback, txn, &refcount_wrapper, sindex_block, progress, interruptor));
+        btree, regions, chunk_fun_cb, txn, &refcount_wrapper, sindex_block, progress, interruptor));
 
     /* If interruptor was pulsed, `call_rdb_backfill()` exited silently, so we
     have to check directly. */
@@ -1875,6 +3038,19 @@ struct rdb_receive_backfill_visitor_t : public boost::static_visitor<void> {
         update_sindexes(&mod_report);
     }
 
+    void operator()(const backfill_chunk_t::key_value_pairs_t &kvs) const {
+        std::vector<rdb_modification_report_t> mod_reports;
+        rdb_set_batch(kvs.backfill_atoms, btree, txn, superblock, &mod_reports);
+
+        rdb_modification_report_cb_t sindex_cb(
+            store, token_pair, txn, sindex_block_id,
+            auto_drainer_t::lock_t(&store->drainer), NULL);
+        for (auto it = mod_reports.begin(); it != mod_reports.end(); ++it) {
+            sindex_cb.on_mod_report(*it);
+        }
+        sindex_cb.finish();
+    }
+
     void operator()(const backfill_chunk_t::sindexes_t &s) const {
         value_sizer_t<rdb_value_t> sizer(txn->get_cache()->get_block_size());
         rdb_value_deleter_t deleter;
@@ -1966,20 +3142,26 @@ region_t rdb_protocol_t::cpu_sharding_subspace(int subregion_number,
 }
 
 RDB_IMPL_ME_SERIALIZABLE_3(rdb_protocol_details::rget_item_t, key, sindex_key, data);
-RDB_IMPL_ME_SERIALIZABLE_3(rdb_protocol_details::single_sindex_status_t,
-                           blocks_total, blocks_processed, ready);
+RDB_IMPL_ME_SERIALIZABLE_4(rdb_protocol_details::single_sindex_status_t,
+                           blocks_total, blocks_processed, ready, eta_secs);
 
 RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::point_read_response_t, data);
-RDB_IMPL_ME_SERIALIZABLE_4(rdb_protocol_t::rget_read_response_t,
-                           result, key_range, truncated, last_considered_key);
-RDB_IMPL_ME_SERIALIZABLE_2(rdb_protocol_t::distribution_read_response_t,
-                           region, key_counts);
+RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::multi_point_read_response_t, rows);
+RDB_IMPL_ME_SERIALIZABLE_5(rdb_protocol_t::rget_read_response_t,
+                           result, key_range, truncated, last_considered_key,
+                           key_format);
+RDB_IMPL_ME_SERIALIZABLE_3(rdb_protocol_t::distribution_read_response_t,
+                           region, key_counts, byte_counts);
 RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::sindex_list_response_t, sindexes);
 RDB_IMPL_ME_SERIALIZABLE_3(rdb_protocol_t::read_response_t,
                            response, event_log, n_shards);
 RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::sindex_status_response_t, statuses);
+RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::changefeed_subscribe_response_t, servers);
+RDB_IMPL_ME_SERIALIZABLE_3(rdb_protocol_details::text_search_hit_t, score, key, data);
+RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::text_search_response_t, result);
 
 RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::point_read_t, key);
+RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::multi_point_read_t, keys);
 RDB_IMPL_ME_SERIALIZABLE_3(rdb_protocol_t::sindex_rangespec_t,
                            id, region, original_range);
 
@@ -1992,10 +3174,13 @@ RDB_IMPL_ME_SERIALIZABLE_7(rdb_protocol_t::rget_read_t,
                            region, optargs, batchspec,
                            transform, terminal, sindex, sorting);
 
-RDB_IMPL_ME_SERIALIZABLE_3(rdb_protocol_t::distribution_read_t,
-                           max_depth, result_limit, region);
+RDB_IMPL_ME_SERIALIZABLE_4(rdb_protocol_t::distribution_read_t,
+                           max_depth, result_limit, region, mode);
 RDB_IMPL_ME_SERIALIZABLE_0(rdb_protocol_t::sindex_list_t);
 RDB_IMPL_ME_SERIALIZABLE_2(rdb_protocol_t::sindex_status_t, sindexes, region);
+RDB_IMPL_ME_SERIALIZABLE_3(rdb_protocol_t::changefeed_subscribe_t, id, addr, region);
+RDB_IMPL_ME_SERIALIZABLE_5(rdb_protocol_t::text_search_t,
+                           sindex, terms, phrase, limit, region);
 RDB_IMPL_ME_SERIALIZABLE_2(rdb_protocol_t::read_t, read, profile);
 RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::point_write_response_t, result);
 
@@ -2004,17 +3189,32 @@ RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::sindex_create_response_t, success);
 RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::sindex_drop_response_t, success);
 RDB_IMPL_ME_SERIALIZABLE_0(rdb_protocol_t::sync_response_t);
 
+RDB_IMPL_ME_SERIALIZABLE_2(rdb_protocol_t::combined_insert_response_t,
+                           positions, stats);
 RDB_IMPL_ME_SERIALIZABLE_3(rdb_protocol_t::write_response_t, response, event_log, n_shards);
 
-RDB_IMPL_ME_SERIALIZABLE_5(rdb_protocol_t::batched_replace_t,
-                           keys, pkey, f, optargs, return_vals);
-RDB_IMPL_ME_SERIALIZABLE_4(rdb_protocol_t::batched_insert_t,
-                           inserts, pkey, upsert, return_vals);
+RDB_IMPL_ME_SERIALIZABLE_6(rdb_protocol_t::batched_replace_t,
+                           keys, pkey, f, optargs, return_vals, return_stats);
+RDB_IMPL_ME_SERIALIZABLE_5(rdb_protocol_t::batched_insert_t,
+                           inserts, pkey, upsert, return_vals, return_stats);
+RDB_IMPL_ME_SERIALIZABLE_4(rdb_protocol_t::combined_insert_t,
+                           inserts, positions, pkey, upsert);
+RDB_IMPL_ME_SERIALIZABLE_3(rdb_protocol_t::bulk_insert_t, inserts, pkey, fill_factor);
+RDB_IMPL_ME_SERIALIZABLE_6(rdb_protocol_t::range_replace_t,
+                           regions, pkey, transform, f, optargs, batchspec);
+RDB_IMPL_ME_SERIALIZABLE_3(rdb_protocol_t::range_replace_response_t,
+                           stats, unfinished, error);
+RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::range_delete_t, region);
+RDB_IMPL_ME_SERIALIZABLE_4(rdb_protocol_t::sindex_range_delete_t,
+                           sindex, sindex_range, pkey, region);
+RDB_IMPL_ME_SERIALIZABLE_2(rdb_protocol_t::sindex_range_delete_response_t,
+                           stats, error);
 
 RDB_IMPL_ME_SERIALIZABLE_3(rdb_protocol_t::point_write_t, key, data, overwrite);
 RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::point_delete_t, key);
 
-RDB_IMPL_ME_SERIALIZABLE_4(rdb_protocol_t::sindex_create_t, id, mapping, region, multi);
+RDB_IMPL_ME_SERIALIZABLE_6(rdb_protocol_t::sindex_create_t,
+                           id, mapping, region, multi, stored_fields, key_format);
 RDB_IMPL_ME_SERIALIZABLE_2(rdb_protocol_t::sindex_drop_t, id, region);
 RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::sync_t, region);
 
@@ -2029,4 +3229,7 @@ RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::backfill_chunk_t::key_value_pair_t,
 
 RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::backfill_chunk_t::sindexes_t, sindexes);
 
+RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::backfill_chunk_t::key_value_pairs_t,
+                           backfill_atoms);
+
 RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::backfill_chunk_t, val);
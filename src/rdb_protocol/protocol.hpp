@@ -25,9 +25,12 @@
 #include "http/json/cJSON.hpp"
 #include "memcached/region.hpp"
 #include "protocol_api.hpp"
+#include "rdb_protocol/changefeed.hpp"
 #include "rdb_protocol/datum.hpp"
 #include "rdb_protocol/profile.hpp"
+#include "rdb_protocol/query_resources.hpp"
 #include "rdb_protocol/rdb_protocol_json.hpp"
+#include "rdb_protocol/sketch.hpp"
 #include "rdb_protocol/wire_func.hpp"
 #include "rdb_protocol/batching.hpp"
 #include "utils.hpp"
@@ -44,6 +47,10 @@ template <class> class namespaces_semilattice_metadata_t;
 template <class> class semilattice_readwrite_view_t;
 class traversal_progress_combiner_t;
 
+namespace ql {
+class spill_space_t;
+}  // namespace ql
+
 using query_language::shared_scoped_less_t;
 
 enum class profile_bool_t {
@@ -54,6 +61,16 @@ ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(
         profile_bool_t, int8_t,
         profile_bool_t::PROFILE, profile_bool_t::DONT_PROFILE);
 
+// TRAVERSE reads the btree down to `max_depth`, SAMPLE estimates the distribution
+// from random walks down to the leaves, see sample_btree_key_distribution().
+enum class distribution_mode_t {
+    TRAVERSE,
+    SAMPLE
+};
+ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(
+        distribution_mode_t, int8_t,
+        distribution_mode_t::TRAVERSE, distribution_mode_t::SAMPLE);
+
 enum class point_write_result_t {
     STORED,
     DUPLICATE
@@ -92,6 +109,7 @@ class env_t;
 class primary_readgen_t;
 class readgen_t;
 class sindex_readgen_t;
+class table_t;
 } // namespace ql
 
 class datum_range_t {
@@ -108,14 +126,21 @@ public:
 
     bool contains(counted_t<const ql::datum_t> val) const;
     bool is_universe() const;
+    // Whether the range includes just one value.
+    bool is_point() const;
+    // The keys of a secondary index in `format` that the values in the range may
+    // be under.  Only the shards know the format of an index, so they turn the
+    // range into keys there.
+    key_range_t to_sindex_keyrange(ql::sindex_key_format_t format) const;
     RDB_DECLARE_ME_SERIALIZABLE;
 private:
     // Only `readgen_t` and its subclasses should do anything fancy with a range.
     friend class ql::readgen_t;
     friend class ql::primary_readgen_t;
     friend class ql::sindex_readgen_t;
+    // And `table_t::changes()`, for the range of its feed.
+    friend class ql::table_t;
     key_range_t to_primary_keyrange() const;
-    key_range_t to_sindex_keyrange() const;
     counted_t<const ql::datum_t> left_bound, right_bound;
     key_range_t::bound_t left_bound_type, right_bound_type;
 };
@@ -133,6 +158,36 @@ struct filter_transform_t {
 
 RDB_DECLARE_SERIALIZABLE(filter_transform_t);
 
+enum class projection_type_t {
+    PLUCK = 0,  // Keeps the fields of the paths.
+    WITHOUT = 1 // Drops them.
+};
+ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(
+    projection_type_t, int8_t, projection_type_t::PLUCK, projection_type_t::WITHOUT);
+
+/* A `pluck` or `without` of a lazy stream.  The shards project their rows by the
+paths themselves instead of calling the function of a map_wire_func_t for every row,
+and then only the fields that are kept get sent to the parser. */
+struct projection_transform_t {
+    projection_transform_t() : type(projection_type_t::PLUCK) { }
+    projection_transform_t(projection_type_t _type,
+                           const counted_t<const ql::datum_t> &_paths,
+                           const ql::protob_t<const Backtrace> &_bt)
+        : type(_type), paths(_paths), bt(_bt) { }
+
+    // "pluck" or "without".
+    const char *name() const;
+
+    projection_type_t type;
+    // The paths as the arguments of the term, which the parser has checked make a
+    // pathspec_t.
+    counted_t<const ql::datum_t> paths;
+    // The backtrace of the term, for errors.
+    ql::protob_t<const Backtrace> bt;
+
+    RDB_DECLARE_ME_SERIALIZABLE;
+};
+
 namespace rdb_protocol_details {
 
 struct backfill_atom_t {
@@ -154,12 +209,18 @@ RDB_DECLARE_SERIALIZABLE(backfill_atom_t);
 
 typedef boost::variant<ql::map_wire_func_t,
                        filter_transform_t,
-                       ql::concatmap_wire_func_t> transform_variant_t;
+                       ql::concatmap_wire_func_t,
+                       projection_transform_t> transform_variant_t;
 typedef std::list<transform_variant_t> transform_t;
 
 typedef boost::variant<ql::gmr_wire_func_t,
                        ql::count_wire_func_t,
-                       ql::reduce_wire_func_t> terminal_variant_t;
+                       ql::reduce_wire_func_t,
+                       ql::top_k_wire_func_t,
+                       ql::groupby_wire_func_t,
+                       ql::count_distinct_wire_func_t,
+                       ql::quantile_wire_func_t,
+                       ql::sample_wire_func_t> terminal_variant_t;
 typedef terminal_variant_t terminal_t;
 
 void bring_sindexes_up_to_date(
@@ -185,26 +246,57 @@ struct rget_item_t {
     counted_t<const ql::datum_t> data;
 };
 
+// A row that `search` found, and how many times the terms it searched for are in
+// the row's text.
+struct text_search_hit_t {
+    text_search_hit_t() : score(0) { }
+    text_search_hit_t(uint64_t _score, const store_key_t &_key,
+                      counted_t<const ql::datum_t> _data)
+        : score(_score), key(_key), data(_data) { }
+
+    RDB_DECLARE_ME_SERIALIZABLE;
+
+    uint64_t score;
+    store_key_t key;
+    counted_t<const ql::datum_t> data;
+};
+
+// Whether `a` is a better match than `b`.  Equal scores go by primary key.
+bool better_text_search_hit(const text_search_hit_t &a, const text_search_hit_t &b);
+
 struct single_sindex_status_t {
     single_sindex_status_t()
         : blocks_processed(0),
-          blocks_total(0), ready(true)
+          blocks_total(0), ready(true), eta_secs(0)
     { }
-    single_sindex_status_t(size_t _blocks_processed, size_t _blocks_total, bool _ready)
+    single_sindex_status_t(size_t _blocks_processed, size_t _blocks_total, bool _ready,
+                           double _eta_secs)
         : blocks_processed(_blocks_processed),
-          blocks_total(_blocks_total), ready(_ready) { }
+          blocks_total(_blocks_total), ready(_ready), eta_secs(_eta_secs) { }
     size_t blocks_processed, blocks_total;
     bool ready;
+    // How long the construction is going to take until it's ready, extrapolated
+    // from how long it has taken so far.  -1 if there is no telling yet.
+    double eta_secs;
 
     RDB_DECLARE_ME_SERIALIZABLE;
 };
 
 } // namespace rdb_protocol_details
 
-enum class sindex_multi_bool_t { SINGLE = 0, MULTI = 1};
+// `TEXT` indexes have an entry for every term of the string their function
+// returns, see tokenize_text(), whose tag is how many times the term is in it.
+// `PROJECTION` indexes have one for every row, by its primary key, which stores
+// some of its fields, so that reads that only need those can scan the index
+// instead of the documents.  `AGGREGATE` indexes keep the count and a sum of the
+// rows of every group their function puts them in, for `groupby`, see
+// rdb_read_aggregate_index().
+enum class sindex_multi_bool_t {
+    SINGLE = 0, MULTI = 1, TEXT = 2, PROJECTION = 3, AGGREGATE = 4
+};
 
 ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(sindex_multi_bool_t, int8_t,
-        sindex_multi_bool_t::SINGLE, sindex_multi_bool_t::MULTI);
+        sindex_multi_bool_t::SINGLE, sindex_multi_bool_t::AGGREGATE);
 
 class cluster_semilattice_metadata_t;
 class auth_semilattice_metadata_t;
@@ -256,6 +348,18 @@ struct rdb_protocol_t {
         cond_t interruptor;
         scoped_array_t<scoped_ptr_t<cross_thread_signal_t> > signals;
         uuid_u machine_id;
+
+        // Where queries put what doesn't fit in memory, like the runs of an
+        // external sort.  Empty on proxies, which have no disk to spill to.
+        scoped_ptr_t<ql::spill_space_t> spill_space;
+
+        // What the changefeeds of queries and stores talk over.  NULL in tests
+        // without a cluster, where there are no changefeeds.
+        mailbox_manager_t *manager;
+
+        // What each query may use before it fails, set with the `--query-max-*`
+        // options.
+        ql::query_limits_t query_limits;
     };
 
     struct point_read_response_t {
@@ -266,6 +370,12 @@ struct rdb_protocol_t {
         RDB_DECLARE_ME_SERIALIZABLE;
     };
 
+    struct multi_point_read_response_t {
+        // Only the rows that exist.
+        std::map<store_key_t, counted_t<const ql::datum_t> > rows;
+        RDB_DECLARE_ME_SERIALIZABLE;
+    };
+
     struct rget_read_response_t {
          // Present if there was no terminal
         typedef std::vector<rdb_protocol_details::rget_item_t> stream_t;
@@ -281,6 +391,11 @@ struct rdb_protocol_t {
             counted_t<const ql::datum_t>,
             empty_t, // for `reduce`, sometimes
             ql::wire_datum_map_t, // for `gmr`, always
+            ql::top_k_rows_t, // for top-k
+            ql::group_accumulators_t, // for `groupby`
+            ql::distinct_sketch_t, // for `approx_count_distinct`
+            ql::quantile_sketch_t, // for `approx_quantile`
+            ql::sample_rows_t, // for `sample`
 
             // Streaming Result.
             stream_t
@@ -290,15 +405,22 @@ struct rdb_protocol_t {
         result_t result;
         bool truncated;
         store_key_t last_considered_key;
+        // The format of the keys of a secondary index read.  Rows under `BINARY`
+        // keys come in the order of their index values, except among those
+        // whose keys were truncated alike.
+        ql::sindex_key_format_t key_format;
 
         // Code seems to depend on a default-initialized rget_read_response_t
         // having a `stream_t` in this variant.  TODO: wtf?
-        rget_read_response_t() : result(stream_t()), truncated(false) { }
+        rget_read_response_t()
+            : result(stream_t()), truncated(false),
+              key_format(ql::sindex_key_format_t::LEGACY) { }
         rget_read_response_t(
             const key_range_t &_key_range, const result_t _result,
             bool _truncated, const store_key_t &_last_considered_key)
             : key_range(_key_range), result(_result),
-              truncated(_truncated), last_considered_key(_last_considered_key) { }
+              truncated(_truncated), last_considered_key(_last_considered_key),
+              key_format(ql::sindex_key_format_t::LEGACY) { }
 
         RDB_DECLARE_ME_SERIALIZABLE;
     };
@@ -312,6 +434,20 @@ struct rdb_protocol_t {
         // key_counts[kn] = the number of keys in [kn, right_key)
         region_t region;
         std::map<store_key_t, int64_t> key_counts;
+        // The bytes the keys of each range take up in the leaves, with the same
+        // keys as `key_counts`.  Only filled in by distribution_mode_t::SAMPLE.
+        std::map<store_key_t, int64_t> byte_counts;
+
+        RDB_DECLARE_ME_SERIALIZABLE;
+    };
+
+    struct text_search_response_t {
+        // The best matches, best first, unless the search failed.
+        boost::variant<std::vector<rdb_protocol_details::text_search_hit_t>,
+                       ql::datum_exc_t> result;
+
+        text_search_response_t()
+            : result(std::vector<rdb_protocol_details::text_search_hit_t>()) { }
 
         RDB_DECLARE_ME_SERIALIZABLE;
     };
@@ -331,12 +467,23 @@ struct rdb_protocol_t {
         RDB_DECLARE_ME_SERIALIZABLE;
     };
 
+    struct changefeed_subscribe_response_t {
+        changefeed_subscribe_response_t() { }
+        // Where to unsubscribe from the stores that subscribed the feed.
+        std::vector<ql::changefeed::server_t::stop_addr_t> servers;
+
+        RDB_DECLARE_ME_SERIALIZABLE;
+    };
+
     struct read_response_t {
         typedef boost::variant<point_read_response_t,
                                rget_read_response_t,
                                distribution_read_response_t,
                                sindex_list_response_t,
-                               sindex_status_response_t> variant_t;
+                               sindex_status_response_t,
+                               multi_point_read_response_t,
+                               changefeed_subscribe_response_t,
+                               text_search_response_t> variant_t;
         variant_t response;
         profile::event_log_t event_log;
         size_t n_shards;
@@ -358,6 +505,19 @@ struct rdb_protocol_t {
         RDB_DECLARE_ME_SERIALIZABLE;
     };
 
+    // Reads the rows of many primary keys at once, so that looking up a batch of
+    // them takes one read per shard instead of one per key.
+    class multi_point_read_t {
+    public:
+        multi_point_read_t() { }
+        explicit multi_point_read_t(std::vector<store_key_t> &&_keys)
+            : keys(std::move(_keys)) { }
+
+        std::vector<store_key_t> keys;
+
+        RDB_DECLARE_ME_SERIALIZABLE;
+    };
+
     struct sindex_rangespec_t {
         sindex_rangespec_t() { }
         sindex_rangespec_t(const std::string &_id,
@@ -413,16 +573,20 @@ struct rdb_protocol_t {
     class distribution_read_t {
     public:
         distribution_read_t()
-            : max_depth(0), result_limit(0), region(region_t::universe())
+            : max_depth(0), result_limit(0), region(region_t::universe()),
+              mode(distribution_mode_t::TRAVERSE)
         { }
-        distribution_read_t(int _max_depth, size_t _result_limit)
+        distribution_read_t(int _max_depth, size_t _result_limit,
+                            distribution_mode_t _mode = distribution_mode_t::TRAVERSE)
             : max_depth(_max_depth), result_limit(_result_limit),
-              region(region_t::universe())
+              region(region_t::universe()), mode(_mode)
         { }
 
+        // Ignored by distribution_mode_t::SAMPLE.
         int max_depth;
         size_t result_limit;
         region_t region;
+        distribution_mode_t mode;
 
         RDB_DECLARE_ME_SERIALIZABLE;
     };
@@ -444,12 +608,50 @@ struct rdb_protocol_t {
         RDB_DECLARE_ME_SERIALIZABLE;
     };
 
+    // Subscribes the feed `id`, whose mailbox is `addr`, to the changes of the rows
+    // of `region` on the stores that serve it.
+    class changefeed_subscribe_t {
+    public:
+        changefeed_subscribe_t() { }
+        changefeed_subscribe_t(const uuid_u &_id,
+                               const ql::changefeed::client_addr_t &_addr,
+                               const region_t &_region)
+            : id(_id), addr(_addr), region(_region) { }
+        uuid_u id;
+        ql::changefeed::client_addr_t addr;
+        region_t region;
+        RDB_DECLARE_ME_SERIALIZABLE;
+    };
+
+    // Finds the rows of `region` whose text the text index `sindex` has all of
+    // `terms` for, or has them in order if `phrase` is set, and returns the
+    // `limit` rows that have them the most times.
+    class text_search_t {
+    public:
+        text_search_t() : phrase(false), limit(0) { }
+        text_search_t(const std::string &_sindex, const std::vector<std::string> &_terms,
+                      bool _phrase, size_t _limit)
+            : sindex(_sindex), terms(_terms), phrase(_phrase), limit(_limit),
+              region(region_t::universe()) { }
+
+        std::string sindex;
+        std::vector<std::string> terms;
+        bool phrase;
+        size_t limit;
+        region_t region;
+
+        RDB_DECLARE_ME_SERIALIZABLE;
+    };
+
     struct read_t {
         typedef boost::variant<point_read_t,
                                rget_read_t,
                                distribution_read_t,
                                sindex_list_t,
-                               sindex_status_t> variant_t;
+                               sindex_status_t,
+                               multi_point_read_t,
+                               changefeed_subscribe_t,
+                               text_search_t> variant_t;
         variant_t read;
         profile_bool_t profile;
 
@@ -474,6 +676,19 @@ struct rdb_protocol_t {
         // Returns true if this read should be sent to every replica.
         bool all_read() const THROWS_NOTHING { return boost::get<sindex_status_t>(&read); }
 
+        // Returns true, and the key in `key_out`, if this is a read that equal
+        // reads at the same state of the table can share a response with.
+        bool coalescing_key(store_key_t *key_out) const THROWS_NOTHING;
+
+        // If the read is profiled, these add its hops on the way to the shard and
+        // back to the profile the shard put in `response`: the master_t calls
+        // profile_master() with when it got the read and when the read's turn
+        // came, the master_access_t calls profile_round_trip() with when it sent
+        // the read to the master.
+        void profile_master(ticks_t received, ticks_t in_order,
+                            read_response_t *response) const;
+        void profile_round_trip(ticks_t sent, read_response_t *response) const;
+
         RDB_DECLARE_ME_SERIALIZABLE;
     };
 
@@ -518,9 +733,38 @@ struct rdb_protocol_t {
     };
 
     typedef counted_t<const ql::datum_t> batched_replace_response_t;
+
+    // The stats of every insert of a combined_insert_t by itself.
+    struct combined_insert_response_t {
+        std::vector<uint64_t> positions;
+        std::vector<batched_replace_response_t> stats;
+        RDB_DECLARE_ME_SERIALIZABLE;
+    };
+
+    // What the shards made of a range_replace_t: the stats of the rows they
+    // replaced, and the parts of its regions they didn't get to yet.
+    struct range_replace_response_t {
+        batched_replace_response_t stats;
+        std::vector<region_t> unfinished;
+        // Set if a filter failed, in which case the shard stopped there.
+        boost::optional<ql::exc_t> error;
+        RDB_DECLARE_ME_SERIALIZABLE;
+    };
+
+    // What the shards made of a sindex_range_delete_t.
+    struct sindex_range_delete_response_t {
+        batched_replace_response_t stats;
+        // Set if the shard couldn't use the index, in which case it deleted nothing.
+        boost::optional<ql::datum_exc_t> error;
+        RDB_DECLARE_ME_SERIALIZABLE;
+    };
+
     struct write_response_t {
         boost::variant<batched_replace_response_t,
                        // batched_replace_response_t is also for batched_insert
+                       combined_insert_response_t,
+                       range_replace_response_t,
+                       sindex_range_delete_response_t,
                        point_write_response_t,
                        point_delete_response_t,
                        sindex_create_response_t,
@@ -544,17 +788,22 @@ struct rdb_protocol_t {
             const std::string &_pkey,
             const counted_t<ql::func_t> &func,
             const std::map<std::string, ql::wire_func_t > &_optargs,
-            bool _return_vals)
+            bool _return_vals,
+            bool _return_stats)
             : keys(std::move(_keys)), pkey(_pkey), f(func), optargs(_optargs),
-              return_vals(_return_vals) {
+              return_vals(_return_vals), return_stats(_return_stats) {
             r_sanity_check(keys.size() != 0);
             r_sanity_check(keys.size() == 1 || !return_vals);
+            r_sanity_check(return_stats || !return_vals);
         }
         std::vector<store_key_t> keys;
         std::string pkey;
         ql::wire_func_t f;
         std::map<std::string, ql::wire_func_t > optargs;
         bool return_vals;
+        // False for the writes of `noreply` queries, whose shards then don't count
+        // what they did to every row, since nobody gets to see it.
+        bool return_stats;
         RDB_DECLARE_ME_SERIALIZABLE;
     };
 
@@ -562,11 +811,13 @@ struct rdb_protocol_t {
         batched_insert_t() { }
         batched_insert_t(
             std::vector<counted_t<const ql::datum_t> > &&_inserts,
-            const std::string &_pkey, bool _upsert, bool _return_vals)
+            const std::string &_pkey, bool _upsert, bool _return_vals,
+            bool _return_stats)
             : inserts(std::move(_inserts)), pkey(_pkey),
-              upsert(_upsert), return_vals(_return_vals) {
+              upsert(_upsert), return_vals(_return_vals), return_stats(_return_stats) {
             r_sanity_check(inserts.size() != 0);
             r_sanity_check(inserts.size() == 1 || !return_vals);
+            r_sanity_check(return_stats || !return_vals);
 #ifndef NDEBUG
             // These checks are done above us, but in debug mode we do them
             // again.  (They're slow.)  We do them above us because the code in
@@ -588,6 +839,105 @@ struct rdb_protocol_t {
         std::string pkey;
         bool upsert;
         bool return_vals;
+        // See batched_replace_t::return_stats.
+        bool return_stats;
+        RDB_DECLARE_ME_SERIALIZABLE;
+    };
+
+    // The single-row inserts of different clients that the master of a shard
+    // combined into one write, see write_t::combine().
+    struct combined_insert_t {
+        combined_insert_t() : upsert(false) { }
+        combined_insert_t(
+            std::vector<counted_t<const ql::datum_t> > &&_inserts,
+            std::vector<uint64_t> &&_positions,
+            const std::string &_pkey, bool _upsert)
+            : inserts(std::move(_inserts)), positions(std::move(_positions)),
+              pkey(_pkey), upsert(_upsert) {
+            r_sanity_check(inserts.size() != 0);
+            r_sanity_check(inserts.size() == positions.size());
+        }
+        std::vector<counted_t<const ql::datum_t> > inserts;
+        // Which of the combined writes every insert came from, since a shard of
+        // this only has some of them.
+        std::vector<uint64_t> positions;
+        std::string pkey;
+        bool upsert;
+        RDB_DECLARE_ME_SERIALIZABLE;
+    };
+
+    // Inserts rows into a table whose primary btree is still empty by building
+    // the btree bottom-up, see btree_bulk_loader_t.  Leaves are filled up to
+    // `fill_factor` of their space.  If the btree isn't empty (on some shard),
+    // this is the same as a batched_insert_t without upsert.
+    struct bulk_insert_t {
+        bulk_insert_t() : fill_factor(1.0) { }
+        bulk_insert_t(
+            std::vector<counted_t<const ql::datum_t> > &&_inserts,
+            const std::string &_pkey, double _fill_factor)
+            : inserts(std::move(_inserts)), pkey(_pkey), fill_factor(_fill_factor) {
+            r_sanity_check(inserts.size() != 0);
+            r_sanity_check(0.5 <= fill_factor && fill_factor <= 1.0);
+        }
+        std::vector<counted_t<const ql::datum_t> > inserts;
+        std::string pkey;
+        double fill_factor;
+        RDB_DECLARE_ME_SERIALIZABLE;
+    };
+
+    // Replaces the rows of `regions` that pass the filters of `transform` with
+    // what `f` makes of them, on the shards themselves, so the rows don't have to
+    // go to the parser and back.  Each shard replaces one batch of `batchspec`
+    // per region, in key order, and sends back what's left of the region, which
+    // the parser sends again in the next range_replace_t.  The filters and `f`
+    // have to be deterministic, and `batchspec` of type TERMINAL, so that every
+    // replica replaces the same rows the same way.
+    struct range_replace_t {
+        range_replace_t() : batchspec(ql::batchspec_t::empty()) { }
+        range_replace_t(
+            std::vector<region_t> &&_regions,
+            const std::string &_pkey,
+            const rdb_protocol_details::transform_t &_transform,
+            const ql::wire_func_t &_f,
+            const std::map<std::string, ql::wire_func_t> &_optargs,
+            const ql::batchspec_t &_batchspec)
+            : regions(std::move(_regions)), pkey(_pkey), transform(_transform),
+              f(_f), optargs(_optargs), batchspec(_batchspec) {
+            r_sanity_check(!regions.empty());
+            r_sanity_check(batchspec.get_batch_type() == ql::batch_type_t::TERMINAL);
+        }
+        std::vector<region_t> regions;
+        std::string pkey;
+        rdb_protocol_details::transform_t transform;
+        ql::wire_func_t f;
+        std::map<std::string, ql::wire_func_t> optargs;
+        ql::batchspec_t batchspec;
+        RDB_DECLARE_ME_SERIALIZABLE;
+    };
+
+    // Deletes all the rows of `region`, leaf by leaf instead of key by key, and
+    // responds with the stats a delete of them would have.
+    struct range_delete_t {
+        range_delete_t() { }
+        explicit range_delete_t(const region_t &_region) : region(_region) { }
+        region_t region;
+        RDB_DECLARE_ME_SERIALIZABLE;
+    };
+
+    // Deletes the rows of `region` whose values for the secondary index `sindex`
+    // are in `sindex_range`, which the shards find in the index, so that deleting
+    // the old rows of a table by a time index only reads the index and the rows.
+    struct sindex_range_delete_t {
+        sindex_range_delete_t() : region(region_t::universe()) { }
+        sindex_range_delete_t(const std::string &_sindex,
+                              const datum_range_t &_sindex_range,
+                              const std::string &_pkey)
+            : sindex(_sindex), sindex_range(_sindex_range), pkey(_pkey),
+              region(region_t::universe()) { }
+        std::string sindex;
+        datum_range_t sindex_range;
+        std::string pkey;
+        region_t region;
         RDB_DECLARE_ME_SERIALIZABLE;
     };
 
@@ -621,14 +971,25 @@ struct rdb_protocol_t {
     public:
         sindex_create_t() { }
         sindex_create_t(const std::string &_id, const ql::map_wire_func_t &_mapping,
-                        sindex_multi_bool_t _multi)
-            : id(_id), mapping(_mapping), region(region_t::universe()), multi(_multi)
+                        sindex_multi_bool_t _multi,
+                        const std::vector<std::string> &_stored_fields
+                            = std::vector<std::string>(),
+                        ql::sindex_key_format_t _key_format
+                            = ql::sindex_key_format_t::BINARY)
+            : id(_id), mapping(_mapping), region(region_t::universe()), multi(_multi),
+              stored_fields(_stored_fields), key_format(_key_format)
         { }
 
         std::string id;
         ql::map_wire_func_t mapping;
         region_t region;
         sindex_multi_bool_t multi;
+        // The fields of the documents a covering index stores along with its
+        // entries, so that queries that only need those can skip the documents.
+        std::vector<std::string> stored_fields;
+        // `HASH` for indexes that are only read with `get_all`.  New indexes are
+        // never `LEGACY`.
+        ql::sindex_key_format_t key_format;
 
         RDB_DECLARE_ME_SERIALIZABLE;
     };
@@ -660,6 +1021,11 @@ struct rdb_protocol_t {
     struct write_t {
         boost::variant<batched_replace_t,
                        batched_insert_t,
+                       combined_insert_t,
+                       bulk_insert_t,
+                       range_replace_t,
+                       range_delete_t,
+                       sindex_range_delete_t,
                        point_write_t,
                        point_delete_t,
                        sindex_create_t,
@@ -680,6 +1046,24 @@ struct rdb_protocol_t {
 
         durability_requirement_t durability() const { return durability_requirement; }
 
+        // The master of a shard combines the single-row inserts of different
+        // clients that wait for it into one combined_insert_t, see master_t.
+        bool is_combinable() const;
+        // Whether this write and `other`, which are both combinable, can be
+        // combined with each other.
+        bool can_combine_with(const write_t &other) const;
+        static write_t combine(const std::vector<const write_t *> &writes);
+        // Splits the response to a write combine() made back into the responses
+        // to the `count` writes it combined.
+        void split_combined_response(const write_response_t &response, size_t count,
+                                     std::vector<write_response_t> *responses_out)
+            const;
+
+        // See read_t::profile_master().
+        void profile_master(ticks_t received, ticks_t in_order,
+                            write_response_t *response) const;
+        void profile_round_trip(ticks_t sent, write_response_t *response) const;
+
         write_t() : durability_requirement(DURABILITY_REQUIREMENT_DEFAULT) { }
         write_t(const batched_replace_t &br,
                 durability_requirement_t durability,
@@ -689,6 +1073,26 @@ struct rdb_protocol_t {
                 durability_requirement_t durability,
                 profile_bool_t _profile)
             : write(bi), durability_requirement(durability), profile(_profile) { }
+        write_t(const combined_insert_t &ci,
+                durability_requirement_t durability,
+                profile_bool_t _profile)
+            : write(ci), durability_requirement(durability), profile(_profile) { }
+        write_t(const bulk_insert_t &bi,
+                durability_requirement_t durability,
+                profile_bool_t _profile)
+            : write(bi), durability_requirement(durability), profile(_profile) { }
+        write_t(const range_replace_t &rr,
+                durability_requirement_t durability,
+                profile_bool_t _profile)
+            : write(rr), durability_requirement(durability), profile(_profile) { }
+        write_t(const range_delete_t &rd,
+                durability_requirement_t durability,
+                profile_bool_t _profile)
+            : write(rd), durability_requirement(durability), profile(_profile) { }
+        write_t(const sindex_range_delete_t &srd,
+                durability_requirement_t durability,
+                profile_bool_t _profile)
+            : write(srd), durability_requirement(durability), profile(_profile) { }
         write_t(const point_write_t &w,
                 durability_requirement_t durability,
                 profile_bool_t _profile)
@@ -754,6 +1158,17 @@ struct rdb_protocol_t {
 
             RDB_DECLARE_ME_SERIALIZABLE;
         };
+        /* Several key/value pairs, up to about BACKFILL_CHUNK_MAX_BYTES, which get
+        written in one transaction. */
+        struct key_value_pairs_t {
+            std::vector<rdb_protocol_details::backfill_atom_t> backfill_atoms;
+
+            key_value_pairs_t() { }
+            explicit key_value_pairs_t(const std::vector<rdb_protocol_details::backfill_atom_t> &_backfill_atoms)
+                : backfill_atoms(_backfill_atoms) { }
+
+            RDB_DECLARE_ME_SERIALIZABLE;
+        };
         struct sindexes_t {
             std::map<std::string, secondary_index_t> sindexes;
 
@@ -764,7 +1179,8 @@ struct rdb_protocol_t {
             RDB_DECLARE_ME_SERIALIZABLE;
         };
 
-        typedef boost::variant<delete_range_t, delete_key_t, key_value_pair_t, sindexes_t> value_t;
+        typedef boost::variant<delete_range_t, delete_key_t, key_value_pair_t, sindexes_t,
+                               key_value_pairs_t> value_t;
 
         backfill_chunk_t() { }
         explicit backfill_chunk_t(const value_t &_val) : val(_val) { }
@@ -779,6 +1195,9 @@ struct rdb_protocol_t {
         static backfill_chunk_t set_key(const rdb_protocol_details::backfill_atom_t& key) {
             return backfill_chunk_t(key_value_pair_t(key));
         }
+        static backfill_chunk_t set_keys(const std::vector<rdb_protocol_details::backfill_atom_t> &keys) {
+            return backfill_chunk_t(key_value_pairs_t(keys));
+        }
 
         static backfill_chunk_t sindexes(const std::map<std::string, secondary_index_t> &sindexes) {
             return backfill_chunk_t(sindexes_t(sindexes));
@@ -804,6 +1223,13 @@ struct rdb_protocol_t {
                 const base_path_t &base_path);
         ~store_t();
 
+        // The feeds subscribed to the store, made for the first one.
+        ql::changefeed::server_t *get_changefeed_server();
+        // NULL until a feed subscribed.
+        ql::changefeed::server_t *changefeed_server_if_any() {
+            return changefeed_server.get_or_null();
+        }
+
     private:
         friend struct read_visitor_t;
         void protocol_read(const read_t &read,
@@ -848,6 +1274,8 @@ struct rdb_protocol_t {
                                  write_token_pair_t *token_pair,
                                  signal_t *interruptor);
         context_t *ctx;
+
+        scoped_ptr_t<ql::changefeed::server_t> changefeed_server;
     };
 
     static region_t cpu_sharding_subspace(int subregion_number, int num_cpu_shards);
@@ -860,6 +1288,7 @@ between the source and destination machines. */
 struct range_key_tester_t : public key_tester_t {
     explicit range_key_tester_t(const rdb_protocol_t::region_t *_delete_range) : delete_range(_delete_range) { }
     bool key_should_be_erased(const btree_key_t *key);
+    bool erases_every_key();
 
     const rdb_protocol_t::region_t *delete_range;
 };
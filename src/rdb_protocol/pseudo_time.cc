@@ -1,6 +1,7 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "rdb_protocol/pseudo_time.hpp"
 
+#include <inttypes.h>
 #include <time.h>
 #include <math.h>
 
@@ -305,6 +306,201 @@ bool tz_valid(const std::string &tz, std::string *tz_out = NULL) {
     return true;
 }
 
+// The fast paths below do the calendar arithmetic themselves instead of building
+// boost times, for the times whose time zone is in the `+HH:MM` form that
+// sanitize::tz() gives, which is what the time zones of time objects are in, and
+// whose dates boost can represent.  They give the same results as boost.  All
+// other times, and all the errors, go through boost like before.
+namespace civil {
+
+const int64_t secs_per_day = 24 * 60 * 60;
+const int64_t micros_per_sec = 1000000;
+const int64_t micros_per_day = secs_per_day * micros_per_sec;
+
+int64_t floor_div(int64_t a, int64_t b) {
+    return a >= 0 ? a / b : -((-a - 1) / b) - 1;
+}
+
+// The days from 1970-01-01 to the date, and back (the algorithms are Howard
+// Hinnant's).
+int64_t days_from_civil(int64_t year, int month, int day) {
+    year -= month <= 2;
+    const int64_t era = (year >= 0 ? year : year - 399) / 400;
+    const int64_t year_of_era = year - era * 400;
+    const int64_t day_of_year = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    const int64_t day_of_era =
+        year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+    return era * 146097 + day_of_era - 719468;
+}
+void civil_from_days(int64_t days, int64_t *year_out, int *month_out, int *day_out) {
+    days += 719468;
+    const int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    const int64_t day_of_era = days - era * 146097;
+    const int64_t year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524
+                                 - day_of_era / 146096) / 365;
+    const int64_t day_of_year =
+        day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+    const int64_t shifted_month = (5 * day_of_year + 2) / 153;
+    *day_out = day_of_year - (153 * shifted_month + 2) / 5 + 1;
+    *month_out = shifted_month < 10 ? shifted_month + 3 : shifted_month - 9;
+    *year_out = year_of_era + era * 400 + (*month_out <= 2);
+}
+
+int days_in_month(int64_t year, int month) {
+    static const int days[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+    const bool leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+    return month == 2 && leap ? 29 : days[month - 1];
+}
+
+// The days boost's dates go from and to.  The fast paths leave the rest (and
+// year 10000, which boost still has) to boost.
+const int64_t min_days = days_from_civil(1400, 1, 1);
+const int64_t max_days = days_from_civil(9999, 12, 31);
+
+// The offset from UTC of a time zone in the `+HH:MM` form, in seconds.  Returns
+// false for anything else, and for the offsets boost rejects.
+bool tz_offset(const std::string &tz, int64_t *secs_out) {
+    if (tz.size() != 6 || (tz[0] != '+' && tz[0] != '-') || tz[3] != ':'
+        || !sanitize::hours_valid(tz[1], tz[2]) || !sanitize::minutes_valid(tz[4], tz[5])
+        || tz == "-00:00") {
+        return false;
+    }
+    const int64_t hours = (tz[1] - '0') * 10 + (tz[2] - '0');
+    const int64_t minutes = (tz[4] - '0') * 10 + (tz[5] - '0');
+    const int64_t secs = (tz[0] == '-' ? -1 : 1) * (hours * 60 * 60 + minutes * 60);
+    // Boost's time zones only go from -12:00 to +14:00.
+    if (secs < -12 * 60 * 60 || secs > 14 * 60 * 60) {
+        return false;
+    }
+    *secs_out = secs;
+    return true;
+}
+
+struct local_time_t {
+    int64_t year;
+    int month, day;
+    // Counting from 0 for Sunday, like boost.
+    int day_of_week;
+    int day_of_year;
+    int hours, minutes, seconds;
+    int64_t microseconds;
+};
+
+// The local time of a time object, with its time rounded to microseconds the way
+// add_seconds_to_ptime() does.
+bool get_local_time(const counted_t<const datum_t> &time, local_time_t *out) {
+    counted_t<const datum_t> tz = time->get(timezone_key, NOTHROW);
+    int64_t offset;
+    if (!tz.has() || tz->get_type() != datum_t::R_STR
+        || !tz_offset(tz->as_str(), &offset)) {
+        return false;
+    }
+    const double raw_sec = time->get(epoch_time_key)->as_num();
+    // Also keeps the microseconds below from overflowing.
+    if (!(raw_sec > -1e12 && raw_sec < 1e12)) {
+        return false;
+    }
+    const int64_t sec = raw_sec;
+    const int64_t microsec = (raw_sec * 1000000.0) - (sec * 1000000);
+    const int64_t utc_micros = sec * micros_per_sec + microsec;
+    const int64_t local_micros = utc_micros + offset * micros_per_sec;
+    const int64_t utc_days = floor_div(utc_micros, micros_per_day);
+    const int64_t days = floor_div(local_micros, micros_per_day);
+    if (utc_days < min_days || utc_days > max_days
+        || days < min_days || days > max_days) {
+        return false;
+    }
+    civil_from_days(days, &out->year, &out->month, &out->day);
+    // 1970-01-01 was a Thursday.
+    out->day_of_week = (days + 4) - floor_div(days + 4, 7) * 7;
+    out->day_of_year = days - days_from_civil(out->year, 1, 1) + 1;
+    const int64_t micros_of_day = local_micros - days * micros_per_day;
+    const int64_t secs_of_day = micros_of_day / micros_per_sec;
+    out->hours = secs_of_day / (60 * 60);
+    out->minutes = (secs_of_day / 60) % 60;
+    out->seconds = secs_of_day % 60;
+    out->microseconds = micros_of_day % micros_per_sec;
+    return true;
+}
+
+bool digits(const std::string &s, size_t at, size_t n, int *out) {
+    if (at + n > s.size()) {
+        return false;
+    }
+    int res = 0;
+    for (size_t i = at; i < at + n; ++i) {
+        if (s[i] < '0' || s[i] > '9') {
+            return false;
+        }
+        res = res * 10 + (s[i] - '0');
+    }
+    *out = res;
+    return true;
+}
+
+// Parses the `YYYY-MM-DDTHH:MM:SS[.sss...](Z|+HH:MM)` form of ISO 8601 that
+// nearly everything writes, where `default_tz` is in the `+HH:MM` form if the
+// time zone is left out, the way sanitize::iso8601() and boost would.  Returns
+// false for anything else, including invalid dates.
+bool iso8601_to_time(const std::string &s, const std::string &default_tz,
+                     counted_t<const datum_t> *out) {
+    int year, month, day, hours, minutes, seconds;
+    if (!(digits(s, 0, 4, &year) && s.size() >= 19 && s[4] == '-'
+          && digits(s, 5, 2, &month) && s[7] == '-' && digits(s, 8, 2, &day)
+          && s[10] == 'T' && digits(s, 11, 2, &hours) && s[13] == ':'
+          && digits(s, 14, 2, &minutes) && s[16] == ':' && digits(s, 17, 2, &seconds))) {
+        return false;
+    }
+    if (year < 1400 || month < 1 || month > 12 || day < 1
+        || day > days_in_month(year, month)
+        || hours > 23 || minutes > 59 || seconds > 59) {
+        return false;
+    }
+    size_t at = 19;
+    int64_t millis = 0;
+    if (at < s.size() && s[at] == '.') {
+        ++at;
+        // Only the milliseconds count, but the rest have to be digits.
+        size_t read = 0;
+        while (at < s.size() && '0' <= s[at] && s[at] <= '9') {
+            if (read < 3) {
+                millis = millis * 10 + (s[at] - '0');
+            }
+            ++read;
+            ++at;
+        }
+        if (read == 0) {
+            return false;
+        }
+        for (; read < 3; ++read) {
+            millis *= 10;
+        }
+    }
+    std::string tz;
+    if (at == s.size()) {
+        tz = default_tz;
+    } else if (at + 1 == s.size() && s[at] == 'Z') {
+        tz = "+00:00";
+    } else {
+        tz = s.substr(at);
+    }
+    int64_t offset;
+    if (!tz_offset(tz, &offset)) {
+        return false;
+    }
+    const int64_t utc_secs = days_from_civil(year, month, day) * secs_per_day
+        + hours * 60 * 60 + minutes * 60 + seconds - offset;
+    const int64_t utc_days = floor_div(utc_secs, secs_per_day);
+    if (utc_days < min_days || utc_days > max_days) {
+        return false;
+    }
+    const int64_t utc_micros = utc_secs * micros_per_sec + millis * 1000;
+    *out = make_time(utc_micros / 1000000.0, tz);
+    return true;
+}
+
+} // namespace civil
+
 // Sanitize the timezone we retrieve from a boost local time.  Boost local time
 // gives a slight superset of ISO 8601 even when only fed ISO 8601 timezones, so
 // we adjust for that here.
@@ -337,6 +533,15 @@ counted_t<const datum_t> boost_to_time(time_t t, const rcheckable_t *target) {
 }
 
 counted_t<const datum_t> iso8601_to_time(
+    const std::string &s, const std::string &default_tz, const rcheckable_t *target) {
+    counted_t<const datum_t> fast_time;
+    if (civil::iso8601_to_time(s, default_tz, &fast_time)) {
+        return fast_time;
+    }
+    return iso8601_to_time_with_boost(s, default_tz, target);
+}
+
+counted_t<const datum_t> iso8601_to_time_with_boost(
     const std::string &s, const std::string &default_tz, const rcheckable_t *target) {
     try {
         date_format_t df = UNSET;
@@ -411,6 +616,22 @@ const std::locale tz_format =
 const std::locale no_tz_format =
     std::locale(std::locale::classic(), new output_timefmt_t("%Y-%m-%dT%H:%M:%S%F"));
 std::string time_to_iso8601(counted_t<const datum_t> d) {
+    civil::local_time_t local;
+    if (civil::get_local_time(d, &local)) {
+        // Boost's `%F` leaves out the fraction when it's zero, and we cut it
+        // down to milliseconds.
+        std::string s = strprintf("%04" PRIi64 "-%02d-%02dT%02d:%02d:%02d",
+                                  local.year, local.month, local.day,
+                                  local.hours, local.minutes, local.seconds);
+        if (local.microseconds != 0) {
+            s += strprintf(".%03d", static_cast<int>(local.microseconds / 1000));
+        }
+        return s + d->get(timezone_key)->as_str();
+    }
+    return time_to_iso8601_with_boost(d);
+}
+
+std::string time_to_iso8601_with_boost(counted_t<const datum_t> d) {
     try {
         time_t t = time_to_boost(d);
         int year = t.date().year();
@@ -618,7 +839,31 @@ counted_t<const datum_t> time_sub(counted_t<const datum_t> time,
     }
 }
 
+// The fraction of the seconds of a time, the way time_portion() adds it.
+double fractional_seconds(counted_t<const datum_t> time) {
+    double frac = modf(time->get(epoch_time_key)->as_num(), &frac);
+    return round(frac * 1000) / 1000;
+}
+
 double time_portion(counted_t<const datum_t> time, time_component_t c) {
+    civil::local_time_t local;
+    if (civil::get_local_time(time, &local)) {
+        switch (c) {
+        case YEAR: return local.year;
+        case MONTH: return local.month;
+        case DAY: return local.day;
+        case DAY_OF_WEEK: return local.day_of_week == 0 ? 7 : local.day_of_week;
+        case DAY_OF_YEAR: return local.day_of_year;
+        case HOURS: return local.hours;
+        case MINUTES: return local.minutes;
+        case SECONDS: return local.seconds + fractional_seconds(time);
+        default: unreachable();
+        }
+    }
+    return time_portion_with_boost(time, c);
+}
+
+double time_portion_with_boost(counted_t<const datum_t> time, time_component_t c) {
     try {
         ptime_t ptime = time_to_boost(time).local_time();
         switch (c) {
@@ -633,11 +878,7 @@ double time_portion(counted_t<const datum_t> time, time_component_t c) {
         case DAY_OF_YEAR: return ptime.date().day_of_year();
         case HOURS: return ptime.time_of_day().hours();
         case MINUTES: return ptime.time_of_day().minutes();
-        case SECONDS: {
-            double frac = modf(time->get(epoch_time_key)->as_num(), &frac);
-            frac = round(frac * 1000) / 1000;
-            return ptime.time_of_day().seconds() + frac;
-        } break;
+        case SECONDS: return ptime.time_of_day().seconds() + fractional_seconds(time);
         default: unreachable();
         }
     } HANDLE_BOOST_ERRORS_NO_TARGET;
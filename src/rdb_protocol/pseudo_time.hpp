@@ -12,6 +12,7 @@ class datum_t;
 
 namespace pseudo {
 extern const char *const time_string;
+extern const char *const epoch_time_key;
 
 counted_t<const datum_t> iso8601_to_time(
     const std::string &s, const std::string &default_tz, const rcheckable_t *t);
@@ -51,6 +52,14 @@ counted_t<const datum_t> time_of_day(counted_t<const datum_t> time);
 
 void time_to_str_key(const datum_t &d, std::string *str_out);
 
+// The same as iso8601_to_time(), time_to_iso8601() and time_portion(), but always
+// through boost, without their fast paths.  The unit tests check them against
+// these.
+counted_t<const datum_t> iso8601_to_time_with_boost(
+    const std::string &s, const std::string &default_tz, const rcheckable_t *t);
+std::string time_to_iso8601_with_boost(counted_t<const datum_t> d);
+double time_portion_with_boost(counted_t<const datum_t> time, time_component_t c);
+
 } // namespace pseudo
 } // namespace ql
 
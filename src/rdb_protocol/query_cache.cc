@@ -0,0 +1,176 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "rdb_protocol/query_cache.hpp"
+
+#include "perfmon/perfmon.hpp"
+#include "rdb_protocol/env.hpp"
+#include "rdb_protocol/term.hpp"
+#include "rdb_protocol/terms/terms.hpp"
+
+namespace ql {
+
+static perfmon_counter_t pm_query_cache_hits, pm_query_cache_misses;
+static perfmon_multi_membership_t pm_query_cache_membership(&get_global_perfmon_collection(),
+    &pm_query_cache_hits, "query_cache_hits",
+    &pm_query_cache_misses, "query_cache_misses",
+    NULLPTR);
+
+namespace {
+
+// The terms that do nothing with their arguments but compile and evaluate them,
+// see query_cache_t.  Their optional arguments can still be special.
+const Term::TermType plain_argument_terms[] = {
+    Term::MAKE_ARRAY, Term::DB, Term::TABLE, Term::GET, Term::GET_ALL,
+    Term::EQ, Term::NE, Term::LT, Term::LE, Term::GT, Term::GE, Term::NOT,
+    Term::ADD, Term::SUB, Term::MUL, Term::DIV, Term::MOD,
+    Term::ALL, Term::ANY, Term::BRANCH, Term::DEFAULT,
+    Term::CONTAINS, Term::NTH, Term::LIMIT, Term::COUNT, Term::FILTER,
+    Term::INSERT
+};
+
+bool arg_can_be_parameter(const Term &t, int i) {
+    if (t.type() == Term::FUNC) {
+        // The first argument holds the variables.
+        return i == 1;
+    }
+    for (size_t j = 0; j < sizeof(plain_argument_terms) / sizeof(plain_argument_terms[0]);
+         ++j) {
+        if (plain_argument_terms[j] == t.type()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool optarg_can_be_parameter(const Term &t) {
+    return t.type() == Term::MAKE_OBJ;
+}
+
+void append_int(int64_t i, std::string *shape_out) {
+    shape_out->append(reinterpret_cast<const char *>(&i), sizeof(i));
+}
+
+// Appends the shape of `t` to `*shape_out` and its parameters to
+// `*parameters_out`, if `parameter_ok` says its literals can be parameters.
+void shape_of(Term *t, bool parameter_ok, std::string *shape_out,
+              std::vector<Datum *> *parameters_out) {
+    append_int(t->type(), shape_out);
+    if (t->type() == Term::DATUM) {
+        if (parameter_ok) {
+            parameters_out->push_back(t->mutable_datum());
+        } else {
+            std::string datum = t->datum().SerializeAsString();
+            append_int(datum.size(), shape_out);
+            shape_out->append(datum);
+        }
+        return;
+    }
+    append_int(t->args_size(), shape_out);
+    for (int i = 0; i < t->args_size(); ++i) {
+        shape_of(t->mutable_args(i), parameter_ok && arg_can_be_parameter(*t, i),
+                 shape_out, parameters_out);
+    }
+    append_int(t->optargs_size(), shape_out);
+    for (int i = 0; i < t->optargs_size(); ++i) {
+        Term::AssocPair *ap = t->mutable_optargs(i);
+        append_int(ap->key().size(), shape_out);
+        shape_out->append(ap->key());
+        shape_of(ap->mutable_val(), parameter_ok && optarg_can_be_parameter(*t),
+                 shape_out, parameters_out);
+    }
+}
+
+}  // namespace
+
+query_cache_t::query_cache_t(size_t _capacity) : capacity(_capacity) { }
+
+query_cache_t::~query_cache_t() {
+    for (auto it = entries.begin(); it != entries.end(); ++it) {
+        delete *it;
+    }
+}
+
+query_cache_t::entry_t *query_cache_t::take(const std::string &shape) {
+    auto it = entries_by_shape.find(shape);
+    if (it == entries_by_shape.end()) {
+        return NULL;
+    }
+    entry_t *entry = *it->second;
+    entries.erase(it->second);
+    entries_by_shape.erase(it);
+    return entry;
+}
+
+void query_cache_t::give_back(entry_t *entry) {
+    if (entries_by_shape.count(entry->shape) != 0) {
+        // A query of the same shape came in while this one was running.
+        delete entry;
+        return;
+    }
+    entries.push_front(entry);
+    entries_by_shape[entry->shape] = entries.begin();
+    while (entries.size() > capacity) {
+        entries_by_shape.erase(entries.back()->shape);
+        delete entries.back();
+        entries.pop_back();
+    }
+}
+
+cached_query_t::cached_query_t(query_cache_t *_cache, const protob_t<Query> &q)
+    : cache(_cache) {
+    Term *t = q->mutable_query();
+    std::string shape;
+    std::vector<Datum *> parameters;
+    if (cache != NULL) {
+        shape_of(t, true, &shape, &parameters);
+        if (query_cache_t::entry_t *cached = cache->take(shape)) {
+            ++pm_query_cache_hits;
+            entry.init(cached);
+            // The protobufs of the cached query are what gets sent to the shards
+            // for functions, and what some terms look at as they get evaluated,
+            // so they have to have the new values as well.
+            rassert(parameters.size() == entry->parameters.size());
+            for (size_t i = 0; i < parameters.size(); ++i) {
+                entry->parameters[i]->Swap(parameters[i]);
+                rebind_datum_term(entry->parameter_terms[i], entry->parameters[i]);
+            }
+            return;
+        }
+        ++pm_query_cache_misses;
+    }
+
+    entry.init(new query_cache_t::entry_t);
+    entry->shape.swap(shape);
+    entry->parameters.swap(parameters);
+    datum_terms_t datum_terms;
+    compile_env_t compile_env(var_visibility_t(), cache != NULL ? &datum_terms : NULL);
+    entry->query = q;
+    entry->root = compile_term(&compile_env, q.make_child(t));
+
+    if (cache != NULL) {
+        for (auto it = entry->parameters.begin(); it != entry->parameters.end(); ++it) {
+            auto jt = datum_terms.find(*it);
+            if (jt == datum_terms.end() || jt->second.size() != 1) {
+                // Something compiled the literal into more than a datum term.
+                cache = NULL;
+                return;
+            }
+            entry->parameter_terms.push_back(jt->second[0]);
+        }
+    }
+}
+
+cached_query_t::~cached_query_t() {
+    if (cache != NULL) {
+        cache->give_back(entry.release());
+    }
+}
+
+const counted_t<term_t> &cached_query_t::root() const {
+    return entry->root;
+}
+
+void cached_query_t::disown() {
+    cache = NULL;
+}
+
+}  // namespace ql
@@ -0,0 +1,90 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_QUERY_CACHE_HPP_
+#define RDB_PROTOCOL_QUERY_CACHE_HPP_
+
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "containers/counted.hpp"
+#include "containers/scoped.hpp"
+#include "rdb_protocol/counted_term.hpp"
+#include "rdb_protocol/ql2.pb.h"
+
+namespace ql {
+
+class term_t;
+
+/* Keeps the compiled term trees of recent queries, so that a query that comes
+again doesn't have to be compiled again.  Queries are looked up by their shape:
+the query with the values of some of its literals left out.  Those literals are
+the parameters of the cached query and get the values of the new query before it
+is evaluated.
+
+A literal is a parameter only if every term above it just evaluates it as an
+argument, like `get`, `eq` or the body of a function do.  Other terms look at
+their literal arguments while they get compiled (`pluck` and the other
+rewrites copy them into the terms that they expand into, functions take their
+variables out of them), so the query has to match those exactly, and they are
+part of its shape.
+
+A cached query is only ever used by one query at a time, see
+cached_query_t.  There is one cache per thread. */
+class query_cache_t {
+public:
+    // Keeps up to `capacity` queries.
+    explicit query_cache_t(size_t capacity);
+    ~query_cache_t();
+
+private:
+    friend class cached_query_t;
+
+    struct entry_t {
+        std::string shape;
+        // The query that `root` was compiled from.  Its literals get swapped
+        // with the ones of the queries that use it.
+        protob_t<Query> query;
+        counted_t<term_t> root;
+        // The parameters of `query`, in the order shape_of() finds them, and
+        // the datum terms that evaluate each of them.
+        std::vector<Datum *> parameters;
+        std::vector<term_t *> parameter_terms;
+    };
+
+    // Checks out the entry for `shape`, or returns NULL.
+    entry_t *take(const std::string &shape);
+    void give_back(entry_t *entry);
+
+    const size_t capacity;
+    // Most recently used first.
+    std::list<entry_t *> entries;
+    std::map<std::string, std::list<entry_t *>::iterator> entries_by_shape;
+
+    DISABLE_COPYING(query_cache_t);
+};
+
+/* Compiles a query, or takes its compiled term tree out of `cache` if it's there,
+and gives the tree to `cache` afterwards.  `cache` can be NULL to just compile. */
+class cached_query_t {
+public:
+    // Throws the compile errors of the query.
+    cached_query_t(query_cache_t *cache, const protob_t<Query> &q);
+    ~cached_query_t();
+
+    const counted_t<term_t> &root() const;
+
+    // The terms of the query are going to be used after the query is done with
+    // them, by a stream that stays in the stream cache, so they can't be reused.
+    void disown();
+
+private:
+    query_cache_t *cache;
+    scoped_ptr_t<query_cache_t::entry_t> entry;
+
+    DISABLE_COPYING(cached_query_t);
+};
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_QUERY_CACHE_HPP_
@@ -0,0 +1,202 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "rdb_protocol/query_capture.hpp"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <boost/bind.hpp>
+
+#include "arch/runtime/coroutines.hpp"
+#include "arch/runtime/runtime.hpp"
+#include "arch/runtime/thread_pool.hpp"
+#include "arch/types.hpp"
+#include "concurrency/pmap.hpp"
+#include "logger.hpp"
+
+namespace ql {
+
+namespace {
+
+const size_t record_header_size = 8 + 8 + 8 + 4;
+
+char *append_little_endian(uint64_t value, size_t size, char *out) {
+    for (size_t i = 0; i < size; ++i) {
+        out[i] = static_cast<char>(value >> (8 * i));
+    }
+    return out + size;
+}
+
+bool write_all(fd_t fd, const char *data, size_t size) {
+    while (size > 0) {
+        ssize_t res = ::write(fd, data, size);
+        if (res == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += res;
+        size -= res;
+    }
+    return true;
+}
+
+}  // namespace
+
+query_capture_t::query_capture_t(const std::string &_path)
+    : path(_path),
+      bytes_written(0),
+      pending_writes(0),
+      dropped_buffers(0),
+      full(false),
+      timer(QUERY_CAPTURE_FLUSH_INTERVAL_MS, this) {
+    int res;
+    do {
+        res = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    } while (res == -1 && errno == EINTR);
+    fd.reset(res);
+
+    const std::string magic(QUERY_CAPTURE_MAGIC);
+    if (fd.get() == INVALID_FD) {
+        logERR("Failed to open `%s` to capture queries: %s",
+               path.c_str(), errno_string(errno).c_str());
+    } else if (!write_all(fd.get(), magic.data(), magic.size())) {
+        logERR("Failed to write to `%s` to capture queries: %s",
+               path.c_str(), errno_string(errno).c_str());
+        fd.reset();
+    } else {
+        bytes_written = magic.size();
+        logINF("Capturing the queries of the clients to `%s`.", path.c_str());
+    }
+
+    for (int i = 0; i < get_num_threads(); ++i) {
+        threads[i].stopped = (fd.get() == INVALID_FD);
+    }
+    pmap(get_num_threads(), boost::bind(&query_capture_t::start_on_thread, this, _1));
+}
+
+query_capture_t::~query_capture_t() {
+    assert_thread();
+    flush_all(auto_drainer_t::lock_t(&drainer));
+    pmap(get_num_threads(), boost::bind(&query_capture_t::drain_on_thread, this, _1));
+    if (dropped_buffers > 0) {
+        logERR("The disk fell behind the queries captured to `%s`, %" PRIi64
+               " buffers of them were dropped.", path.c_str(), dropped_buffers);
+    }
+}
+
+void query_capture_t::start_on_thread(int thread) {
+    on_thread_t thread_switcher((threadnum_t(thread)));
+    threads[thread].drainer.init(new auto_drainer_t);
+}
+
+void query_capture_t::drain_on_thread(int thread) {
+    on_thread_t thread_switcher((threadnum_t(thread)));
+    threads[thread].drainer.reset();
+}
+
+void query_capture_t::capture(uint64_t connection_id, const Query &query) {
+    const int thread = get_thread_id().threadnum;
+    per_thread_t *t = &threads[thread];
+    if (t->stopped) {
+        return;
+    }
+
+    const int size = query.ByteSize();
+    const size_t offset = t->buffer.size();
+    t->buffer.resize(offset + record_header_size + size);
+    char *out = &t->buffer[offset];
+    out = append_little_endian(current_microtime(), 8, out);
+    out = append_little_endian(connection_id, 8, out);
+    out = append_little_endian(query.token(), 8, out);
+    out = append_little_endian(size, 4, out);
+    query.SerializeWithCachedSizesToArray(reinterpret_cast<uint8_t *>(out));
+
+    if (t->buffer.size() >= QUERY_CAPTURE_BUFFER_SIZE) {
+        std::string *buffer = new std::string;
+        buffer->swap(t->buffer);
+        t->buffer.reserve(buffer->size());
+        coro_t::spawn_sometime(boost::bind(&query_capture_t::write_buffer, this,
+                                           buffer, auto_drainer_t::lock_t(t->drainer.get())));
+    }
+}
+
+void query_capture_t::on_ring() {
+    coro_t::spawn_sometime(boost::bind(&query_capture_t::flush_all, this,
+                                       auto_drainer_t::lock_t(&drainer)));
+}
+
+void query_capture_t::flush_all(auto_drainer_t::lock_t keepalive) {
+    assert_thread();
+    pmap(get_num_threads(), boost::bind(&query_capture_t::flush_on_thread, this,
+                                        _1, keepalive));
+}
+
+void query_capture_t::flush_on_thread(int thread, auto_drainer_t::lock_t keepalive) {
+    std::string *buffer = new std::string;
+    {
+        on_thread_t thread_switcher((threadnum_t(thread)));
+        buffer->swap(threads[thread].buffer);
+    }
+    if (buffer->empty()) {
+        delete buffer;
+        return;
+    }
+    write_buffer(buffer, keepalive);
+}
+
+void query_capture_t::write_buffer(std::string *buffer_ptr,
+                                   UNUSED auto_drainer_t::lock_t keepalive) {
+    scoped_ptr_t<std::string> buffer(buffer_ptr);
+    on_thread_t thread_switcher(home_thread());
+
+    if (full) {
+        return;
+    }
+    if (pending_writes >= QUERY_CAPTURE_MAX_PENDING_WRITES) {
+        ++dropped_buffers;
+        return;
+    }
+
+    ++pending_writes;
+    bool ok;
+    {
+        mutex_t::acq_t write_mutex_acq(&write_mutex);
+        if (full) {
+            --pending_writes;
+            return;
+        }
+        thread_pool_t::run_in_blocker_pool(boost::bind(&query_capture_t::write_blocking,
+                                                       this, buffer.get(), &ok));
+        if (ok) {
+            bytes_written += buffer->size();
+        }
+        full = !ok || bytes_written >= QUERY_CAPTURE_MAX_FILE_SIZE;
+    }
+    --pending_writes;
+
+    if (!ok) {
+        logERR("Failed to write to `%s`, stopped capturing queries.", path.c_str());
+    } else if (full) {
+        logINF("`%s` reached %" PRIi64 " bytes, stopped capturing queries.",
+               path.c_str(), bytes_written);
+    }
+    if (full) {
+        pmap(get_num_threads(), boost::bind(&query_capture_t::stop_on_thread, this, _1));
+    }
+}
+
+void query_capture_t::write_blocking(const std::string *buffer, bool *ok_out) {
+    *ok_out = write_all(fd.get(), buffer->data(), buffer->size());
+}
+
+void query_capture_t::stop_on_thread(int thread) {
+    on_thread_t thread_switcher((threadnum_t(thread)));
+    threads[thread].stopped = true;
+    threads[thread].buffer.clear();
+}
+
+}  // namespace ql
@@ -0,0 +1,86 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_QUERY_CAPTURE_HPP_
+#define RDB_PROTOCOL_QUERY_CAPTURE_HPP_
+
+#include <stdint.h>
+
+#include <array>
+#include <string>
+
+#include "arch/io/io_utils.hpp"
+#include "arch/timing.hpp"
+#include "concurrency/auto_drainer.hpp"
+#include "concurrency/mutex.hpp"
+#include "config/args.hpp"
+#include "containers/scoped.hpp"
+#include "rdb_protocol/ql2.pb.h"
+#include "utils.hpp"
+
+namespace ql {
+
+/* With `--capture-queries FILE`, the `query2_server_t` gives every query it gets
+to a `query_capture_t`, which writes them to FILE for `scripts/replay_queries.py`
+to replay against another cluster.
+
+The file starts with the 8 bytes of `QUERY_CAPTURE_MAGIC`, and then has a record
+for every query: the `microtime_t` it came in at, the id of its connection, its
+token, the size of the `Query` protobuf and the protobuf, with the integers as
+the 8, 8, 8 and 4 bytes of their little-endian representation.  Every thread
+gathers its records in a buffer and appends the buffer to the file once it holds
+`QUERY_CAPTURE_BUFFER_SIZE` bytes or `QUERY_CAPTURE_FLUSH_INTERVAL_MS` have
+passed, so the records of different threads are only in order of time within a
+buffer, and the clocks of the threads may differ a bit.
+
+The capture stops once the file reaches `QUERY_CAPTURE_MAX_FILE_SIZE` bytes.  If
+the disk falls behind by more than `QUERY_CAPTURE_MAX_PENDING_WRITES` buffers, the
+ones that don't fit are dropped and counted in the log, rather than held in
+memory. */
+class query_capture_t : private repeating_timer_callback_t, public home_thread_mixin_t {
+public:
+    // Logs an error and captures nothing if the file can't be opened.
+    explicit query_capture_t(const std::string &path);
+    ~query_capture_t();
+
+    // May be called on any thread.
+    void capture(uint64_t connection_id, const Query &query);
+
+private:
+    void start_on_thread(int thread);
+    void drain_on_thread(int thread);
+    void on_ring();
+    void flush_all(auto_drainer_t::lock_t keepalive);
+    void flush_on_thread(int thread, auto_drainer_t::lock_t keepalive);
+    void write_buffer(std::string *buffer, auto_drainer_t::lock_t keepalive);
+    void write_blocking(const std::string *buffer, bool *ok_out);
+    void stop_on_thread(int thread);
+
+    const std::string path;
+    scoped_fd_t fd;
+
+    struct per_thread_t {
+        per_thread_t() : stopped(false) { }
+        std::string buffer;
+        // Set once the file is full, or was never opened.
+        bool stopped;
+        // Keeps the writes of the buffers the thread filled alive, the
+        // `auto_drainer_t` of the home thread can't be locked from it.
+        scoped_ptr_t<auto_drainer_t> drainer;
+    };
+    std::array<per_thread_t, MAX_THREADS> threads;
+
+    // On the home thread.
+    mutex_t write_mutex;
+    int64_t bytes_written;
+    int pending_writes;
+    int64_t dropped_buffers;
+    bool full;
+
+    auto_drainer_t drainer;
+    repeating_timer_t timer;
+
+    DISABLE_COPYING(query_capture_t);
+};
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_QUERY_CAPTURE_HPP_
@@ -0,0 +1,97 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "rdb_protocol/query_resources.hpp"
+
+#include "arch/runtime/coroutines.hpp"
+#include "perfmon/perfmon.hpp"
+#include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/error.hpp"
+
+namespace ql {
+
+static perfmon_counter_t pm_query_rows_scanned, pm_query_datum_bytes,
+    pm_query_cpu_usecs, pm_queries_over_limits;
+static perfmon_multi_membership_t pm_query_resources_membership(
+    &get_global_perfmon_collection(),
+    &pm_query_rows_scanned, "query_rows_scanned",
+    &pm_query_datum_bytes, "query_datum_bytes",
+    &pm_query_cpu_usecs, "query_cpu_usecs",
+    &pm_queries_over_limits, "queries_over_limits",
+    NULLPTR);
+
+query_resources_t::query_resources_t(const query_limits_t &_limits, bool _profile)
+    : limits(_limits), profile(_profile),
+      rows_scanned(0), datum_bytes(0), done_cpu_ticks(0), timer(NULL) { }
+
+query_resources_t::~query_resources_t() {
+    guarantee(timer == NULL);
+    pm_query_rows_scanned += rows_scanned;
+    pm_query_datum_bytes += datum_bytes;
+    pm_query_cpu_usecs += done_cpu_ticks / THOUSAND;
+}
+
+void query_resources_t::add_datums(
+        const std::vector<counted_t<const datum_t> > &datums) {
+    if (counts_bytes()) {
+        for (auto it = datums.begin(); it != datums.end(); ++it) {
+            datum_bytes += serialized_size(*it);
+        }
+    }
+}
+
+void query_resources_t::add_datum(const counted_t<const datum_t> &datum) {
+    if (counts_bytes()) {
+        datum_bytes += serialized_size(datum);
+    }
+}
+
+ticks_t query_resources_t::cpu_ticks() const {
+    return done_cpu_ticks
+        + (timer != NULL ? timer->coro->get_running_ticks() - timer->start : 0);
+}
+
+void query_resources_t::check() {
+    if (limits.max_rows_scanned != 0 && rows_scanned > limits.max_rows_scanned) {
+        ++pm_queries_over_limits;
+        rfail_toplevel(base_exc_t::GENERIC,
+                       "Query scanned more than %" PRIu64 " rows.",
+                       limits.max_rows_scanned);
+    }
+    if (limits.max_datum_bytes != 0 && datum_bytes > limits.max_datum_bytes) {
+        ++pm_queries_over_limits;
+        rfail_toplevel(base_exc_t::GENERIC,
+                       "Query produced more than %" PRIu64 " bytes of data.",
+                       limits.max_datum_bytes);
+    }
+    if (limits.max_cpu_ms != 0 && cpu_ticks() > limits.max_cpu_ms * MILLION) {
+        ++pm_queries_over_limits;
+        rfail_toplevel(base_exc_t::GENERIC,
+                       "Query used more than %" PRIu64 " ms of CPU time.",
+                       limits.max_cpu_ms);
+    }
+}
+
+std::string query_resources_t::describe() const {
+    std::string bytes = counts_bytes()
+        ? strprintf(", %.1f KB of datums", datum_bytes / 1024.0)
+        : std::string();
+    return strprintf("Used %" PRIu64 " rows%s and %.3f ms of CPU.",
+                     rows_scanned, bytes.c_str(), cpu_ticks() / static_cast<double>(MILLION));
+}
+
+query_resources_t::cpu_timer_t::cpu_timer_t(query_resources_t *_parent)
+    : parent(_parent != NULL && _parent->timer == NULL ? _parent : NULL), coro(coro_t::self()), start(0) {
+    if (parent != NULL) {
+        coro_t::time_running();
+        start = coro->get_running_ticks();
+        parent->timer = this;
+    }
+}
+
+query_resources_t::cpu_timer_t::~cpu_timer_t() {
+    if (parent != NULL) {
+        parent->done_cpu_ticks += coro->get_running_ticks() - start;
+        parent->timer = NULL;
+    }
+}
+
+}  // namespace ql
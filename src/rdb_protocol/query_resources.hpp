@@ -0,0 +1,100 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_QUERY_RESOURCES_HPP_
+#define RDB_PROTOCOL_QUERY_RESOURCES_HPP_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "errors.hpp"
+#include "containers/counted.hpp"
+#include "utils.hpp"
+
+class coro_t;
+
+namespace ql {
+
+class datum_t;
+
+/* How much of each resource a query may use, or 0 for no limit.  They're set for
+all the queries of a node with the `--query-max-*` options. */
+struct query_limits_t {
+    query_limits_t() : max_rows_scanned(0), max_datum_bytes(0), max_cpu_ms(0) { }
+    uint64_t max_rows_scanned;
+    uint64_t max_datum_bytes;
+    uint64_t max_cpu_ms;
+};
+
+/* What a query used so far, over its first batch and all the ones it continues
+with:
+ - The rows it read from tables.
+ - The bytes of the datums its streams read from tables and built, by their
+   serialized sizes and once for every stage they go through.  Datums are shared
+   between queries and don't know who made them, so this is what the query
+   produced rather than what it holds alive at once.  It's only counted when it's
+   limited or profiled, because it takes a walk over every datum.
+ - The CPU time of the coroutines evaluating it on the node that parses it, not
+   counting what the shards do for it.
+Once a query is over one of its limits, check() fails it, which env_t does
+wherever it checks its interruptor, so a runaway query stops at its next term or
+batch. */
+class query_resources_t {
+public:
+    query_resources_t(const query_limits_t &limits, bool profile);
+    // Adds what the query used to the perfmons.
+    ~query_resources_t();
+
+    void add_rows(size_t n) {
+        rows_scanned += n;
+    }
+    // Adds the bytes of `datums`, if they're counted.
+    void add_datums(const std::vector<counted_t<const datum_t> > &datums);
+    void add_datum(const counted_t<const datum_t> &datum);
+
+    // Throws if the query is over one of its limits.
+    void check();
+
+    // Something like "Used 10 rows, 1.2 KB of datums and 3.4 ms of CPU.", for the
+    // profile.
+    std::string describe() const;
+
+    uint64_t get_rows_scanned() const { return rows_scanned; }
+    // Whether the bytes get counted, see above.
+    bool counts_bytes() const { return limits.max_datum_bytes != 0 || profile; }
+    uint64_t get_datum_bytes() const { return datum_bytes; }
+    ticks_t cpu_ticks() const;
+
+    /* Counts the time the current coroutine runs while it exists towards the CPU
+    time of the query.  `parent` may be NULL, for queries that aren't counted. */
+    class cpu_timer_t {
+    public:
+        explicit cpu_timer_t(query_resources_t *parent);
+        ~cpu_timer_t();
+    private:
+        friend class query_resources_t;
+        // NULL if there's nothing to count or another timer was running already.
+        query_resources_t *parent;
+        coro_t *coro;
+        ticks_t start;
+        DISABLE_COPYING(cpu_timer_t);
+    };
+
+private:
+    const query_limits_t limits;
+    const bool profile;
+
+    uint64_t rows_scanned;
+    uint64_t datum_bytes;
+    // The CPU time of the timers that are done.
+    ticks_t done_cpu_ticks;
+    // The timer that's running, if any.  Timers made while one runs don't
+    // count, so that nested ones don't count the same time twice.
+    cpu_timer_t *timer;
+
+    DISABLE_COPYING(query_resources_t);
+};
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_QUERY_RESOURCES_HPP_
@@ -0,0 +1,162 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "rdb_protocol/sketch.hpp"
+
+#include <math.h>
+
+#include <algorithm>
+#include <string>
+#include <utility>
+
+#include "config/args.hpp"
+#include "rdb_protocol/datum.hpp"
+
+namespace ql {
+
+// FNV-1a, followed by the finalizer of MurmurHash3 so that the first bits, which
+// pick the register, depend on all of the key.
+static uint64_t hash_sort_key(const std::string &key) {
+    uint64_t h = 14695981039346656037ULL;
+    for (auto it = key.begin(); it != key.end(); ++it) {
+        h ^= static_cast<uint8_t>(*it);
+        h *= 1099511628211ULL;
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+void distinct_sketch_t::add(const datum_t &d) {
+    // Equal datums have equal sort keys, whatever their representation.
+    std::string key;
+    append_sort_key(d, &key);
+    uint64_t h = hash_sort_key(key);
+
+    if (registers.empty()) {
+        registers.resize(static_cast<size_t>(1) << DISTINCT_SKETCH_PRECISION, 0);
+    }
+    size_t index = h >> (64 - DISTINCT_SKETCH_PRECISION);
+    uint64_t rest = h << DISTINCT_SKETCH_PRECISION;
+    uint8_t rank = rest == 0
+        ? 64 - DISTINCT_SKETCH_PRECISION + 1
+        : __builtin_clzll(rest) + 1;
+    registers[index] = std::max(registers[index], rank);
+}
+
+void distinct_sketch_t::add(const distinct_sketch_t &other) {
+    if (other.registers.empty()) {
+        return;
+    }
+    if (registers.empty()) {
+        registers = other.registers;
+        return;
+    }
+    guarantee(registers.size() == other.registers.size());
+    for (size_t i = 0; i < registers.size(); ++i) {
+        registers[i] = std::max(registers[i], other.registers[i]);
+    }
+}
+
+double distinct_sketch_t::estimate() const {
+    if (registers.empty()) {
+        return 0;
+    }
+    const double m = registers.size();
+    double sum = 0;
+    size_t zeros = 0;
+    for (auto it = registers.begin(); it != registers.end(); ++it) {
+        sum += ldexp(1.0, -static_cast<int>(*it));
+        if (*it == 0) {
+            ++zeros;
+        }
+    }
+    const double alpha = 0.7213 / (1 + 1.079 / m);
+    double estimate = alpha * m * m / sum;
+    // HyperLogLog overestimates small sets, which leave registers empty, and linear
+    // counting by the empty registers is closer for them.
+    if (estimate <= 2.5 * m && zeros != 0) {
+        estimate = m * log(m / zeros);
+    }
+    return floor(estimate + 0.5);
+}
+
+size_t quantile_sketch_t::capacity(size_t level) const {
+    double c = QUANTILE_SKETCH_K * pow(2.0 / 3.0, compactors.size() - 1 - level);
+    return std::max<size_t>(2, static_cast<size_t>(ceil(c)));
+}
+
+void quantile_sketch_t::add(double d) {
+    if (compactors.empty()) {
+        compactors.resize(1);
+    }
+    compactors[0].push_back(d);
+    ++count;
+    if (compactors[0].size() > capacity(0)) {
+        compress();
+    }
+}
+
+void quantile_sketch_t::add(const quantile_sketch_t &other) {
+    if (compactors.size() < other.compactors.size()) {
+        compactors.resize(other.compactors.size());
+    }
+    for (size_t i = 0; i < other.compactors.size(); ++i) {
+        compactors[i].insert(compactors[i].end(),
+                             other.compactors[i].begin(), other.compactors[i].end());
+    }
+    count += other.count;
+    compress();
+}
+
+void quantile_sketch_t::compress() {
+    bool compacted;
+    do {
+        compacted = false;
+        for (size_t level = 0; level < compactors.size(); ++level) {
+            if (compactors[level].size() <= capacity(level)) {
+                continue;
+            }
+            if (level + 1 == compactors.size()) {
+                compactors.resize(level + 2);
+            }
+            std::vector<double> *c = &compactors[level];
+            std::vector<double> *next = &compactors[level + 1];
+            std::sort(c->begin(), c->end());
+            // If there's an odd one out, the greatest number stays behind, so that
+            // the numbers still stand for exactly `count` of them.
+            size_t even = c->size() - c->size() % 2;
+            for (size_t i = odd_offset ? 1 : 0; i < even; i += 2) {
+                next->push_back((*c)[i]);
+            }
+            c->erase(c->begin(), c->begin() + even);
+            odd_offset = !odd_offset;
+            compacted = true;
+        }
+    } while (compacted);
+}
+
+double quantile_sketch_t::quantile(double q) const {
+    guarantee(!empty());
+    std::vector<std::pair<double, uint64_t> > weighted;
+    for (size_t level = 0; level < compactors.size(); ++level) {
+        for (auto it = compactors[level].begin(); it != compactors[level].end(); ++it) {
+            weighted.push_back(std::make_pair(*it, static_cast<uint64_t>(1) << level));
+        }
+    }
+    std::sort(weighted.begin(), weighted.end());
+
+    // The least number with at least `q * count` numbers up to it.
+    const double rank = q * count;
+    uint64_t seen = 0;
+    for (auto it = weighted.begin(); it != weighted.end(); ++it) {
+        seen += it->second;
+        if (seen >= rank) {
+            return it->first;
+        }
+    }
+    return weighted.back().first;
+}
+
+}  // namespace ql
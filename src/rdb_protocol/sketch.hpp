@@ -0,0 +1,77 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_SKETCH_HPP_
+#define RDB_PROTOCOL_SKETCH_HPP_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "errors.hpp"
+#include "containers/archive/stl_types.hpp"
+#include "rpc/serialize_macros.hpp"
+
+namespace ql {
+
+class datum_t;
+
+/* A HyperLogLog sketch of a set of datums, for `approx_count_distinct`.  Every datum
+is hashed, the first DISTINCT_SKETCH_PRECISION bits of the hash pick a register, and
+the register keeps the most leading zeros any of the rest of the bits of its hashes
+had.  The more distinct datums there are, the more zeros, so the registers estimate
+how many there were while taking a few kilobytes no matter how many rows there are.
+Merging two sketches takes the greater of every pair of registers, so the shards
+send theirs and the parser merges them into a sketch of all the rows. */
+class distinct_sketch_t {
+public:
+    distinct_sketch_t() { }
+
+    void add(const datum_t &d);
+    void add(const distinct_sketch_t &other);
+
+    // The estimated number of distinct datums added.
+    double estimate() const;
+
+    RDB_MAKE_ME_SERIALIZABLE_1(registers);
+
+private:
+    // Empty until the first datum, so that shards without any don't send the
+    // registers.
+    std::vector<uint8_t> registers;
+};
+
+/* A KLL sketch of a multiset of numbers, for `approx_quantile`.  It keeps a stack of
+compactors, where the numbers of compactor `i` stand for 2^i numbers each.  When a
+compactor fills up, it's sorted and every other one of its numbers moves up to the
+next compactor, which leaves the ranks of all numbers off by at most one number of
+that compactor.  The compactors shrink by 2/3 from the top down, so the ones that
+count most are the largest and the whole sketch stays around 3 * QUANTILE_SKETCH_K
+numbers.  Merging two sketches merges their compactors and compacts them again. */
+class quantile_sketch_t {
+public:
+    quantile_sketch_t() : count(0), odd_offset(false) { }
+
+    void add(double d);
+    void add(const quantile_sketch_t &other);
+
+    bool empty() const { return count == 0; }
+    // The estimated `q`-quantile, for `q` between 0 and 1, of the numbers added,
+    // unless it's empty.
+    double quantile(double q) const;
+
+    RDB_MAKE_ME_SERIALIZABLE_3(compactors, count, odd_offset);
+
+private:
+    size_t capacity(size_t level) const;
+    // Compacts compactors until none of them holds more than its capacity.
+    void compress();
+
+    std::vector<std::vector<double> > compactors;
+    uint64_t count;
+    // Which half of a compactor to keep next.  Alternating between them keeps the
+    // errors of successive compactions from piling up in the same direction.
+    bool odd_offset;
+};
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_SKETCH_HPP_
@@ -0,0 +1,197 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "rdb_protocol/slow_query_log.hpp"
+
+#include <algorithm>
+#include <iterator>
+
+#include "errors.hpp"
+#include <boost/bind.hpp>
+
+#include "arch/runtime/runtime.hpp"
+#include "concurrency/pmap.hpp"
+#include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/env.hpp"
+#include "rdb_protocol/profile.hpp"
+
+namespace ql {
+
+slow_query_t::slow_query_t()
+    : when(0), server_ticks(0), rows_scanned(0), counted_bytes(false),
+      datum_bytes(0), cpu_ticks(0), sampled(false) { }
+
+slow_query_settings_t::slow_query_settings_t()
+    : sample_every(SLOW_QUERY_DEFAULT_SAMPLE_EVERY),
+      threshold_ms(SLOW_QUERY_DEFAULT_THRESHOLD_MS) { }
+
+namespace {
+
+// Returns false once the fingerprint is full.
+bool append_fingerprint(const Term &t, std::string *out) {
+    if (out->size() >= SLOW_QUERY_MAX_FINGERPRINT_SIZE) {
+        return false;
+    }
+    if (t.type() == Term::DATUM) {
+        out->append("?");
+        return true;
+    }
+    out->append(Term::TermType_Name(t.type()));
+    out->append("(");
+    bool first = true;
+    for (int i = 0; i < t.args_size(); ++i) {
+        if (!first) {
+            out->append(", ");
+        }
+        first = false;
+        if (!append_fingerprint(t.args(i), out)) {
+            return false;
+        }
+    }
+    for (int i = 0; i < t.optargs_size(); ++i) {
+        if (!first) {
+            out->append(", ");
+        }
+        first = false;
+        out->append(t.optargs(i).key());
+        out->append(": ");
+        if (!append_fingerprint(t.optargs(i).val(), out)) {
+            return false;
+        }
+    }
+    out->append(")");
+    return true;
+}
+
+}  // namespace
+
+std::string query_fingerprint(const Term &term) {
+    std::string fingerprint;
+    if (!append_fingerprint(term, &fingerprint)) {
+        fingerprint.resize(SLOW_QUERY_MAX_FINGERPRINT_SIZE);
+        fingerprint.append("...");
+    }
+    return fingerprint;
+}
+
+slow_query_log_t &slow_query_log_t::get_global_log() {
+    // See coro_profiler_t::get_global_profiler().
+    static slow_query_log_t log;
+    return log;
+}
+
+slow_query_log_t::per_thread_t::per_thread_t()
+    : queries_to_sample(settings.sample_every) { }
+
+bool slow_query_log_t::sample_query() {
+    per_thread_t *thread = &threads[get_thread_id().threadnum];
+    if (thread->settings.sample_every == 0) {
+        return false;
+    }
+    if (thread->queries_to_sample > 1) {
+        --thread->queries_to_sample;
+        return false;
+    }
+    thread->queries_to_sample = thread->settings.sample_every;
+    return true;
+}
+
+bool slow_query_log_t::should_record(bool sampled, ticks_t server_ticks) {
+    const uint64_t threshold_ms = threads[get_thread_id().threadnum].settings.threshold_ms;
+    return sampled || (threshold_ms != 0 && server_ticks > threshold_ms * MILLION);
+}
+
+void slow_query_log_t::record(slow_query_t &&query) {
+    per_thread_t *thread = &threads[get_thread_id().threadnum];
+    thread->queries.push_front(std::move(query));
+    if (thread->queries.size() > SLOW_QUERY_LOG_SIZE_PER_THREAD) {
+        thread->queries.pop_back();
+    }
+}
+
+slow_query_settings_t slow_query_log_t::get_settings() {
+    // They're the same on every thread.
+    return threads[get_thread_id().threadnum].settings;
+}
+
+void slow_query_log_t::set_settings(const slow_query_settings_t &settings) {
+    pmap(get_num_threads(), boost::bind(&slow_query_log_t::set_settings_on_thread,
+                                        this, _1, settings));
+}
+
+void slow_query_log_t::set_settings_on_thread(int thread,
+                                              const slow_query_settings_t &settings) {
+    on_thread_t thread_switcher((threadnum_t(thread)));
+    threads[thread].settings = settings;
+    threads[thread].queries_to_sample = settings.sample_every;
+}
+
+static bool more_recent(const slow_query_t &a, const slow_query_t &b) {
+    return a.when > b.when;
+}
+
+std::vector<slow_query_t> slow_query_log_t::get_queries() {
+    std::vector<std::vector<slow_query_t> > per_thread_queries(get_num_threads());
+    pmap(get_num_threads(), boost::bind(&slow_query_log_t::get_queries_on_thread,
+                                        this, _1, &per_thread_queries));
+    std::vector<slow_query_t> queries;
+    for (size_t i = 0; i < per_thread_queries.size(); ++i) {
+        std::move(per_thread_queries[i].begin(), per_thread_queries[i].end(),
+                  std::back_inserter(queries));
+    }
+    std::stable_sort(queries.begin(), queries.end(), &more_recent);
+    return queries;
+}
+
+void slow_query_log_t::get_queries_on_thread(
+        int thread, std::vector<std::vector<slow_query_t> > *queries_out) {
+    on_thread_t thread_switcher((threadnum_t(thread)));
+    (*queries_out)[thread].assign(threads[thread].queries.begin(),
+                                  threads[thread].queries.end());
+}
+
+void slow_query_log_t::clear() {
+    pmap(get_num_threads(), boost::bind(&slow_query_log_t::clear_on_thread, this, _1));
+}
+
+void slow_query_log_t::clear_on_thread(int thread) {
+    on_thread_t thread_switcher((threadnum_t(thread)));
+    threads[thread].queries.clear();
+}
+
+logged_query_t::logged_query_t(const protob_t<Query> &_query, bool _sampled)
+    : query(_query), when(time(NULL)), sampled(_sampled), server_ticks(0) { }
+
+logged_query_t::server_timer_t::server_timer_t(logged_query_t *_parent)
+    : parent(_parent), start(parent != NULL ? get_ticks() : 0) { }
+
+logged_query_t::server_timer_t::~server_timer_t() {
+    if (parent != NULL) {
+        parent->server_ticks += get_ticks() - start;
+    }
+}
+
+void logged_query_t::finish(env_t *env) {
+    slow_query_log_t *log = &slow_query_log_t::get_global_log();
+    // Only the queries that get logged are worth the fingerprint and the profile.
+    if (!log->should_record(sampled, server_ticks)) {
+        return;
+    }
+
+    slow_query_t logged;
+    logged.when = when;
+    logged.server_ticks = server_ticks;
+    logged.sampled = sampled;
+    if (env->resources.has()) {
+        logged.rows_scanned = env->resources->get_rows_scanned();
+        logged.counted_bytes = env->resources->counts_bytes();
+        logged.datum_bytes = env->resources->get_datum_bytes();
+        logged.cpu_ticks = env->resources->cpu_ticks();
+    }
+    logged.fingerprint = query_fingerprint(query->query());
+    if (env->trace.has()) {
+        env->profile_resources();
+        logged.profile = env->trace->as_datum()->as_json().PrintUnformatted();
+    }
+    log->record(std::move(logged));
+}
+
+}  // namespace ql
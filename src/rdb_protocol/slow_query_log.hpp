@@ -0,0 +1,140 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_SLOW_QUERY_LOG_HPP_
+#define RDB_PROTOCOL_SLOW_QUERY_LOG_HPP_
+
+#include <stdint.h>
+#include <time.h>
+
+#include <array>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "config/args.hpp"
+#include "rdb_protocol/counted_term.hpp"
+#include "utils.hpp"
+
+namespace ql {
+
+class env_t;
+
+/* A query in the slow query log. */
+struct slow_query_t {
+    slow_query_t();
+
+    // When the query started.
+    time_t when;
+    // The query with its literals left out, like `GET(TABLE(DB(?), ?), ?)`, so
+    // that the runs of the same query look the same, see query_fingerprint().
+    std::string fingerprint;
+    // The time the server spent on the query, over its first batch and all the
+    // ones it continued with, but not the time it waited for the client.
+    ticks_t server_ticks;
+    // What it used, see query_resources_t.  The bytes are only there if they
+    // were counted.
+    uint64_t rows_scanned;
+    bool counted_bytes;
+    uint64_t datum_bytes;
+    ticks_t cpu_ticks;
+    // Whether it was traced because it was sampled, rather than logged only for
+    // being slow.
+    bool sampled;
+    // The JSON of its profile, with the timings of its terms and of what it did on
+    // the shards, or empty if it wasn't traced.
+    std::string profile;
+};
+
+struct slow_query_settings_t {
+    slow_query_settings_t();
+    // One query in `sample_every` gets traced and logged, none if it's 0.
+    uint64_t sample_every;
+    // The queries that take longer than this get logged, none if it's 0.
+    uint64_t threshold_ms;
+};
+
+/* Renders `term` the way slow_query_t::fingerprint is, cut off after
+SLOW_QUERY_MAX_FINGERPRINT_SIZE bytes. */
+std::string query_fingerprint(const Term &term);
+
+/* The slow query log keeps the last SLOW_QUERY_LOG_SIZE_PER_THREAD queries that
+every thread traced for it or found slow.  The clients can't see what it traces
+for it; the operators read it through the `/ajax/slow_queries` page of the admin
+API.  Every thread has its own part of it and its own copy of the settings, so
+that the queries don't have to leave their thread to use it, and the functions
+that don't say otherwise work on the part of the current thread. */
+class slow_query_log_t {
+public:
+    static slow_query_log_t &get_global_log();
+
+    // Returns whether to trace the query that's starting.
+    bool sample_query();
+    // Whether a query that's done gets logged: if it was sampled or slow.
+    bool should_record(bool sampled, ticks_t server_ticks);
+    void record(slow_query_t &&query);
+
+    slow_query_settings_t get_settings();
+    // These go to every thread, so they must be called from a coroutine.
+    void set_settings(const slow_query_settings_t &settings);
+    // The queries of every thread, the most recent first.
+    std::vector<slow_query_t> get_queries();
+    void clear();
+
+private:
+    slow_query_log_t() { }
+
+    struct per_thread_t {
+        per_thread_t();
+        slow_query_settings_t settings;
+        // How many queries are left until the next one that gets sampled.
+        uint64_t queries_to_sample;
+        // The most recent first.
+        std::deque<slow_query_t> queries;
+    };
+
+    void set_settings_on_thread(int thread, const slow_query_settings_t &settings);
+    void get_queries_on_thread(int thread,
+                               std::vector<std::vector<slow_query_t> > *queries_out);
+    void clear_on_thread(int thread);
+
+    // Like in coro_profiler_t, one_per_thread_t would make the construction order
+    // tricky.
+    std::array<per_thread_t, MAX_THREADS> threads;
+
+    DISABLE_COPYING(slow_query_log_t);
+};
+
+/* What the env_t of a client query keeps to log the query when it's done. */
+class logged_query_t {
+public:
+    logged_query_t(const protob_t<Query> &query, bool sampled);
+
+    // Whether the query is traced for the slow query log only.
+    bool is_sampled() const { return sampled; }
+
+    /* Counts the time it exists towards the server time of the query.  `parent`
+    may be NULL, for queries that don't get logged. */
+    class server_timer_t {
+    public:
+        explicit server_timer_t(logged_query_t *parent);
+        ~server_timer_t();
+    private:
+        logged_query_t *parent;
+        ticks_t start;
+        DISABLE_COPYING(server_timer_t);
+    };
+
+    // Gives the query to the slow query log, with what `env` traced and counted.
+    void finish(env_t *env);
+
+private:
+    const protob_t<Query> query;
+    const time_t when;
+    const bool sampled;
+    ticks_t server_ticks;
+
+    DISABLE_COPYING(logged_query_t);
+};
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_SLOW_QUERY_LOG_HPP_
@@ -1,10 +1,69 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "rdb_protocol/stream_cache.hpp"
 
+#include <algorithm>
+
+#include "errors.hpp"
+#include <boost/bind.hpp>
+
+#include "arch/runtime/coroutines.hpp"
+#include "concurrency/spread_work.hpp"
+#include "concurrency/wait_any.hpp"
+#include "config/args.hpp"
+#include "perfmon/perfmon.hpp"
 #include "rdb_protocol/env.hpp"
+#include "rdb_protocol/slow_query_log.hpp"
+#include "thread_local.hpp"
 
 namespace ql {
 
+// Encodes the datums [begin, end) of a batch into their responses, which exist
+// already; see spread_work().
+void write_batch_chunk(const std::vector<counted_t<const datum_t> > *ds,
+                       use_json_t use_json, Response *res,
+                       size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+        (*ds)[i]->write_to_protobuf(res->mutable_response(i), use_json);
+    }
+}
+
+static perfmon_counter_t pm_stream_cache_cursors, pm_stream_cache_bytes,
+    pm_stream_cache_evictions;
+static perfmon_multi_membership_t pm_stream_cache_membership(
+    &get_global_perfmon_collection(),
+    &pm_stream_cache_cursors, "stream_cache_cursors",
+    &pm_stream_cache_bytes, "stream_cache_bytes",
+    &pm_stream_cache_evictions, "stream_cache_evictions",
+    NULLPTR);
+
+// The streams of the stream caches of a thread that aren't serving a batch, most
+// recently used first, and how many bytes all of the thread's streams hold.
+class stream_cache_lru_t {
+public:
+    stream_cache_lru_t() : size(0) { }
+    intrusive_list_t<stream_cache2_t::entry_t> idle;
+    int64_t size;
+};
+
+TLS_with_init(stream_cache_lru_t *, stream_cache_lru, NULL);
+
+static stream_cache_lru_t *get_stream_cache_lru() {
+    stream_cache_lru_t *lru = TLS_get_stream_cache_lru();
+    if (lru == NULL) {
+        // It lives as long as the thread.
+        lru = new stream_cache_lru_t();
+        TLS_set_stream_cache_lru(lru);
+    }
+    return lru;
+}
+
+stream_cache2_t::~stream_cache2_t() {
+    // Other connections may evict the streams that haven't been destroyed yet.
+    while (!streams.empty()) {
+        erase(streams.begin());
+    }
+}
+
 bool stream_cache2_t::contains(int64_t key) {
     return streams.find(key) != streams.end();
 }
@@ -13,15 +72,26 @@ void stream_cache2_t::insert(int64_t key,
                              use_json_t use_json,
                              scoped_ptr_t<env_t> &&val_env,
                              counted_t<datum_stream_t> val_stream) {
-    maybe_evict();
+    entry_t *entry = new entry_t(this, key, time(0), use_json, std::move(val_env),
+                                 val_stream);
     std::pair<boost::ptr_map<int64_t, entry_t>::iterator, bool> res = streams.insert(
-        key, new entry_t(time(0), use_json, std::move(val_env), val_stream));
+        key, entry);
     guarantee(res.second);
+    entry->lru->idle.push_front(entry);
 }
 
 void stream_cache2_t::erase(int64_t key) {
-    size_t num_erased = streams.erase(key);
-    guarantee(num_erased == 1);
+    boost::ptr_map<int64_t, entry_t>::iterator it = streams.find(key);
+    guarantee(it != streams.end());
+    erase(it);
+}
+
+void stream_cache2_t::erase(boost::ptr_map<int64_t, entry_t>::iterator it) {
+    if (it->second->prefetch.has()) {
+        prefetch_reserved -= it->second->prefetch->reserved;
+    }
+    // Destroying the entry interrupts and waits for its prefetch.
+    boost::ptr_map<int64_t, entry_t>::auto_type entry = streams.release(it);
 }
 
 bool stream_cache2_t::serve(int64_t key, Response *res, signal_t *interruptor) {
@@ -29,52 +99,158 @@ bool stream_cache2_t::serve(int64_t key, Response *res, signal_t *interruptor) {
     if (it == streams.end()) return false;
     entry_t *entry = it->second;
     entry->last_activity = time(0);
+    // Serving a batch may block, and the entry can't be evicted meanwhile.
+    if (entry->in_a_list()) {
+        entry->lru->idle.remove(entry);
+    }
+    // Erasing the entry may wait for its prefetch, which can't happen in a catch
+    // block.
+    std::exception_ptr exc;
     try {
-        // Reset the env_t's interruptor to a good one before we use it.  This may be a
-        // hack.  (I'd rather not have env_t be mutable this way -- could we construct
-        // a new env_t instead?  Why do we keep env_t's around anymore?)
-        entry->env->interruptor = interruptor;
-
-        std::vector<counted_t<const datum_t> > ds
-            = entry->stream->next_batch(
-                entry->env.get(),
-                batchspec_t::user(batch_type_t::NORMAL, entry->env.get()));
-        for (auto d = ds.begin(); d != ds.end(); ++d) {
-            (*d)->write_to_protobuf(res->add_response(), entry->use_json);
+        logged_query_t::server_timer_t server_timer(entry->env->logged_query.get_or_null());
+        std::vector<counted_t<const datum_t> > ds = next_batch(entry, interruptor);
+        for (size_t i = 0; i < ds.size(); ++i) {
+            res->add_response();
         }
-        if (entry->env->trace.has()) {
+        spread_work(ds.size(), RESPONSE_ENCODE_CHUNK_DATUMS,
+                    boost::bind(&write_batch_chunk, &ds, entry->use_json, res,
+                                _1, _2));
+        entry->batch_sizer.note_sent(res->ByteSize());
+        if (entry->env->returns_profile()) {
+            entry->env->profile_resources();
             entry->env->trace->as_datum()->write_to_protobuf(
                 res->mutable_profile(), entry->use_json);
         }
-    } catch (const std::exception &e) {
+    } catch (const std::exception &) {
+        exc = std::current_exception();
+    }
+    if (exc != std::exception_ptr()) {
         erase(key);
-        throw;
+        std::rethrow_exception(exc);
     }
     if (entry->stream->is_exhausted() || res->response_size() == 0) {
         erase(key);
         res->set_type(Response::SUCCESS_SEQUENCE);
     } else {
         res->set_type(Response::SUCCESS_PARTIAL);
+        maybe_prefetch(entry);
+        entry->set_size(res->ByteSize()
+                        + (entry->prefetch.has() ? entry->prefetch->reserved : 0));
+        entry->lru->idle.push_front(entry);
+        maybe_evict(entry);
     }
 
     return true;
 }
 
-void stream_cache2_t::maybe_evict() {
-    // We never evict right now.
+std::vector<counted_t<const datum_t> > stream_cache2_t::next_batch(
+        entry_t *entry, signal_t *interruptor) {
+    entry->batch_sizer.note_request();
+    if (entry->prefetch.has()) {
+        wait_interruptible(&entry->prefetch->done, interruptor);
+        scoped_ptr_t<prefetch_t> prefetch(entry->prefetch.release());
+        prefetch_reserved -= prefetch->reserved;
+        entry->env->interruptor = interruptor;
+        if (prefetch->exc != std::exception_ptr()) {
+            std::rethrow_exception(prefetch->exc);
+        }
+        return std::move(prefetch->batch);
+    }
+
+    // Reset the env_t's interruptor to a good one before we use it.  This may be a
+    // hack.  (I'd rather not have env_t be mutable this way -- could we construct
+    // a new env_t instead?  Why do we keep env_t's around anymore?)
+    entry->env->interruptor = interruptor;
+    std::vector<counted_t<const datum_t> > batch;
+    {
+        query_resources_t::cpu_timer_t cpu_timer(entry->env->resources.get());
+        batch = entry->stream->next_batch(
+            entry->env.get(), entry->batch_sizer.next_batchspec(entry->env.get()));
+    }
+    entry->batch_sizer.note_computed();
+    return batch;
 }
 
-stream_cache2_t::entry_t::entry_t(time_t _last_activity,
+void stream_cache2_t::maybe_prefetch(entry_t *entry) {
+    r_sanity_check(!entry->prefetch.has());
+    batchspec_t batchspec = entry->batch_sizer.next_batchspec(entry->env.get());
+    const int64_t reserved = std::min<int64_t>(batchspec.get_max_size(),
+                                               STREAM_PREFETCH_MAX_SIZE);
+    if (prefetch_reserved + reserved > STREAM_PREFETCH_MAX_SIZE) {
+        // The next batch gets read when the client asks for it.
+        return;
+    }
+    prefetch_reserved += reserved;
+    entry->prefetch.init(new prefetch_t(reserved));
+    coro_t::spawn_sometime(boost::bind(&stream_cache2_t::do_prefetch, this, entry,
+                                       batchspec, auto_drainer_t::lock_t(&entry->drainer)));
+}
+
+void stream_cache2_t::do_prefetch(entry_t *entry, batchspec_t batchspec,
+                                  auto_drainer_t::lock_t lock) {
+    prefetch_t *prefetch = entry->prefetch.get();
+    // The interruptor of the request that got the last batch goes away with it.
+    entry->env->interruptor = lock.get_drain_signal();
+    try {
+        query_resources_t::cpu_timer_t cpu_timer(entry->env->resources.get());
+        prefetch->batch = entry->stream->next_batch(entry->env.get(), batchspec);
+    } catch (const interrupted_exc_t &) {
+        // The entry is being destroyed, so nobody is waiting for the batch.
+        return;
+    } catch (const std::exception &) {
+        prefetch->exc = std::current_exception();
+    }
+    entry->batch_sizer.note_computed();
+    prefetch->done.pulse();
+}
+
+void stream_cache2_t::maybe_evict(entry_t *keep) {
+    stream_cache_lru_t *lru = get_stream_cache_lru();
+    const int64_t max_size = STREAM_CACHE_MAX_SIZE / get_num_threads();
+    // Evicting a stream may block on its prefetch, and other streams may be
+    // evicted or used meanwhile, so this looks at the list anew every time.
+    while (lru->size > max_size && !lru->idle.empty() && lru->idle.tail() != keep) {
+        entry_t *victim = lru->idle.tail();
+        ++pm_stream_cache_evictions;
+        stream_cache2_t *parent = victim->parent;
+        boost::ptr_map<int64_t, entry_t>::iterator it = parent->streams.find(victim->key);
+        r_sanity_check(it != parent->streams.end());
+        parent->erase(it);
+    }
+}
+
+void stream_cache2_t::entry_t::set_size(int64_t _size) {
+    lru->size += _size - size;
+    pm_stream_cache_bytes += _size - size;
+    size = _size;
+}
+
+stream_cache2_t::entry_t::entry_t(stream_cache2_t *_parent,
+                                  int64_t _key,
+                                  time_t _last_activity,
                                   use_json_t _use_json,
                                   scoped_ptr_t<env_t> &&env_ptr,
                                   counted_t<datum_stream_t> _stream)
-    : last_activity(_last_activity),
+    : parent(_parent),
+      key(_key),
+      lru(get_stream_cache_lru()),
+      size(0),
+      last_activity(_last_activity),
       use_json(_use_json),
       env(std::move(env_ptr)),
       stream(_stream),
-      max_age(DEFAULT_MAX_AGE) { }
+      max_age(DEFAULT_MAX_AGE) {
+    ++pm_stream_cache_cursors;
+}
 
-stream_cache2_t::entry_t::~entry_t() { }
+stream_cache2_t::entry_t::~entry_t() {
+    assert_thread();
+    if (in_a_list()) {
+        lru->idle.remove(this);
+    }
+    set_size(0);
+    --pm_stream_cache_cursors;
+}
 
 
 } // namespace ql
@@ -4,12 +4,17 @@
 
 #include <time.h>
 
+#include <exception>
 #include <map>
+#include <vector>
 
 #include "errors.hpp"
 #include <boost/ptr_container/ptr_map.hpp>
 
+#include "concurrency/auto_drainer.hpp"
+#include "concurrency/cond_var.hpp"
 #include "concurrency/signal.hpp"
+#include "containers/intrusive_list.hpp"
 #include "containers/scoped.hpp"
 #include "rdb_protocol/datum_stream.hpp"
 #include "rdb_protocol/ql2.pb.h"
@@ -20,9 +25,25 @@ class env_t;
 
 namespace ql {
 
+class stream_cache_lru_t;
+
+/* The streams of a connection whose batches the client reads one at a time.  After a
+batch goes to the client, the next one gets read ahead in a coroutine while the
+client processes that one and asks for the next, so that the round trip to the
+client and the reads of the shards overlap instead of taking turns.  The batches
+read ahead of all the streams take at most STREAM_PREFETCH_MAX_SIZE by their size
+budgets.
+
+A stream holds about as much memory as its batches take, so it's accounted for by the
+size of the last batch it sent and of the one it's reading ahead.  All the streams
+of a thread are in a list by when they were last used, and when there are more than
+the thread's share of STREAM_CACHE_MAX_SIZE of them, the least recently used ones
+that aren't serving a batch get evicted, wherever the connection they belong to is,
+so that cursors abandoned by their clients can't take up all the memory. */
 class stream_cache2_t {
 public:
-    stream_cache2_t() { }
+    stream_cache2_t() : prefetch_reserved(0) { }
+    ~stream_cache2_t();
     MUST_USE bool contains(int64_t key);
     void insert(int64_t key,
                 use_json_t use_json,
@@ -31,25 +52,67 @@ public:
     void erase(int64_t key);
     MUST_USE bool serve(int64_t key, Response *res, signal_t *interruptor);
 private:
-    void maybe_evict();
+    friend class stream_cache_lru_t;
+
+    struct entry_t;
+    // Removes the entry from `streams` before destroying it, so that the connection
+    // can't serve it while its prefetch is being waited for.
+    void erase(boost::ptr_map<int64_t, entry_t>::iterator it);
+    // Evicts the least recently used idle streams of the thread until they fit in
+    // its share of STREAM_CACHE_MAX_SIZE, except for `keep`.
+    void maybe_evict(entry_t *keep);
 
-    struct entry_t {
+    // A batch being read ahead.
+    struct prefetch_t {
+        explicit prefetch_t(int64_t _reserved) : reserved(_reserved) { }
+        // The size budget of the batch, which counts toward
+        // STREAM_PREFETCH_MAX_SIZE until the batch is served.
+        const int64_t reserved;
+        cond_t done;
+        std::vector<counted_t<const datum_t> > batch;
+        // What reading the batch threw, if it did.
+        std::exception_ptr exc;
+    };
+
+    struct entry_t : public intrusive_list_node_t<entry_t>,
+                     public home_thread_mixin_debug_only_t {
         ~entry_t(); // `env_t` is incomplete
         static const time_t DEFAULT_MAX_AGE = 0; // 0 = never evict
-        entry_t(time_t _last_activity,
+        entry_t(stream_cache2_t *_parent,
+                int64_t _key,
+                time_t _last_activity,
                 use_json_t use_json,
                 scoped_ptr_t<env_t> &&env_ptr,
                 counted_t<datum_stream_t> _stream);
+        // Sets how many bytes the stream holds.
+        void set_size(int64_t _size);
+        stream_cache2_t *const parent;
+        const int64_t key;
+        // The LRU of the thread, which the entry is in unless it's serving a batch.
+        stream_cache_lru_t *const lru;
+        int64_t size;
         time_t last_activity;
         use_json_t use_json;
         scoped_ptr_t<env_t> env;
         counted_t<datum_stream_t> stream;
+        batch_sizer_t batch_sizer;
         time_t max_age;
+        scoped_ptr_t<prefetch_t> prefetch;
+        // Interrupts and waits for the prefetch coroutine, so it's destroyed
+        // first.
+        auto_drainer_t drainer;
     private:
         DISABLE_COPYING(entry_t);
     };
 
+    std::vector<counted_t<const datum_t> > next_batch(entry_t *entry,
+                                                      signal_t *interruptor);
+    void maybe_prefetch(entry_t *entry);
+    void do_prefetch(entry_t *entry, batchspec_t batchspec, auto_drainer_t::lock_t lock);
+
     boost::ptr_map<int64_t, entry_t> streams;
+    // The sum of the `reserved` of the batches being read ahead.
+    int64_t prefetch_reserved;
     DISABLE_COPYING(stream_cache2_t);
 };
 
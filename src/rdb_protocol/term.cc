@@ -5,6 +5,9 @@
 #include "rdb_protocol/env.hpp"
 #include "rdb_protocol/func.hpp"
 #include "rdb_protocol/minidriver.hpp"
+#include "rdb_protocol/profile.hpp"
+#include "rdb_protocol/query_cache.hpp"
+#include "rdb_protocol/slow_query_log.hpp"
 #include "rdb_protocol/stream_cache.hpp"
 #include "rdb_protocol/term_walker.hpp"
 #include "rdb_protocol/validate.hpp"
@@ -19,7 +22,13 @@ namespace ql {
 
 counted_t<term_t> compile_term(compile_env_t *env, protob_t<const Term> t) {
     switch (t->type()) {
-    case Term::DATUM:              return make_datum_term(t);
+    case Term::DATUM: {
+        counted_t<term_t> term = make_datum_term(t);
+        if (env->datum_terms != NULL) {
+            (*env->datum_terms)[&t->datum()].push_back(term.get());
+        }
+        return term;
+    }
     case Term::MAKE_ARRAY:         return make_make_array_term(env, t);
     case Term::MAKE_OBJ:           return make_make_obj_term(env, t);
     case Term::VAR:                return make_var_term(env, t);
@@ -30,6 +39,7 @@ counted_t<term_t> compile_term(compile_env_t *env, protob_t<const Term> t) {
     case Term::TABLE:              return make_table_term(env, t);
     case Term::GET:                return make_get_term(env, t);
     case Term::GET_ALL:            return make_get_all_term(env, t);
+    case Term::SEARCH:             return make_search_term(env, t);
     case Term::EQ:                 // fallthru
     case Term::NE:                 // fallthru
     case Term::LT:                 // fallthru
@@ -95,6 +105,8 @@ counted_t<term_t> compile_term(compile_env_t *env, protob_t<const Term> t) {
     case Term::TABLE_DROP:         return make_table_drop_term(env, t);
     case Term::TABLE_LIST:         return make_table_list_term(env, t);
     case Term::SYNC:               return make_sync_term(env, t);
+    case Term::CHANGES:            return make_changes_term(env, t);
+    case Term::SHARD:              return make_shard_term(env, t);
     case Term::INDEX_CREATE:       return make_sindex_create_term(env, t);
     case Term::INDEX_DROP:         return make_sindex_drop_term(env, t);
     case Term::INDEX_LIST:         return make_sindex_list_term(env, t);
@@ -112,6 +124,8 @@ counted_t<term_t> compile_term(compile_env_t *env, protob_t<const Term> t) {
     case Term::MATCH:              return make_match_term(env, t);
     case Term::SAMPLE:             return make_sample_term(env, t);
     case Term::IS_EMPTY:           return make_is_empty_term(env, t);
+    case Term::APPROX_COUNT_DISTINCT: return make_approx_count_distinct_term(env, t);
+    case Term::APPROX_QUANTILE:    return make_approx_quantile_term(env, t);
     case Term::DEFAULT:            return make_default_term(env, t);
     case Term::JSON:               return make_json_term(env, t);
     case Term::ISO8601:            return make_iso8601_term(env, t);
@@ -163,7 +177,9 @@ void run(protob_t<Query> q,
          rdb_protocol_t::context_t *ctx,
          signal_t *interruptor,
          Response *res,
-         stream_cache2_t *stream_cache2) {
+         stream_cache2_t *stream_cache2,
+         query_cache_t *query_cache,
+         near_cache_t *near_cache) {
     try {
         validate_pb(*q);
     } catch (const base_exc_t &e) {
@@ -187,12 +203,22 @@ void run(protob_t<Query> q,
                 ctx->cross_thread_database_watchables[th.threadnum]->get_watchable(),
                 ctx->cluster_metadata, ctx->directory_read_manager,
                 interruptor, ctx->machine_id, q));
+        env->spill_space = ctx->spill_space.get();
+        env->mailbox_manager = ctx->manager;
+        env->near_cache = near_cache;
+        // A query the client doesn't profile may still get traced for the slow
+        // query log, without the client seeing it.
+        const bool sampled = !env->trace.has()
+            && slow_query_log_t::get_global_log().sample_query();
+        if (sampled) {
+            env->trace.init(new profile::trace_t());
+        }
+        env->logged_query.init(new logged_query_t(q, sampled));
+        env->resources.init(new query_resources_t(ctx->query_limits, env->trace.has()));
 
-        counted_t<term_t> root_term;
+        scoped_ptr_t<cached_query_t> compiled;
         try {
-            Term *t = q->mutable_query();
-            compile_env_t compile_env((var_visibility_t()));
-            root_term = compile_term(&compile_env, q.make_child(t));
+            compiled.init(new cached_query_t(query_cache, q));
             // TODO: handle this properly
         } catch (const exc_t &e) {
             fill_error(res, Response::COMPILE_ERROR, e.what(), e.backtrace());
@@ -215,13 +241,22 @@ void run(protob_t<Query> q,
         }
 
         try {
+            // Ended before the stream cache takes the environment, which it may
+            // destroy.
+            scoped_ptr_t<query_resources_t::cpu_timer_t> cpu_timer(
+                new query_resources_t::cpu_timer_t(env->resources.get()));
+            scoped_ptr_t<logged_query_t::server_timer_t> server_timer(
+                new logged_query_t::server_timer_t(env->logged_query.get()));
             scope_env_t scope_env(env.get(), var_scope_t());
-            counted_t<val_t> val = root_term->eval(&scope_env);
+            counted_t<val_t> val = compiled->root()->eval(&scope_env);
             if (val->get_type().is_convertible(val_t::type_t::DATUM)) {
                 res->set_type(Response_ResponseType_SUCCESS_ATOM);
                 counted_t<const datum_t> d = val->as_datum();
                 d->write_to_protobuf(res->add_response(), use_json);
-                if (env->trace.has()) {
+                cpu_timer.reset();
+                server_timer.reset();
+                if (env->returns_profile()) {
+                    env->profile_resources();
                     env->trace->as_datum()->write_to_protobuf(
                         res->mutable_profile(), use_json);
                 }
@@ -230,11 +265,17 @@ void run(protob_t<Query> q,
                 if (counted_t<const datum_t> arr = seq->as_array(env.get())) {
                     res->set_type(Response_ResponseType_SUCCESS_ATOM);
                     arr->write_to_protobuf(res->add_response(), use_json);
-                    if (env->trace.has()) {
+                    cpu_timer.reset();
+                    server_timer.reset();
+                    if (env->returns_profile()) {
+                        env->profile_resources();
                         env->trace->as_datum()->write_to_protobuf(
                             res->mutable_profile(), use_json);
                     }
                 } else {
+                    cpu_timer.reset();
+                    server_timer.reset();
+                    compiled->disown();
                     stream_cache2->insert(token, use_json, std::move(env), seq);
                     bool b = stream_cache2->serve(token, res, interruptor);
                     r_sanity_check(b);
@@ -256,8 +297,10 @@ void run(protob_t<Query> q,
     case Query_QueryType_CONTINUE: {
         try {
             bool b = stream_cache2->serve(token, res, interruptor);
+            // The stream may have been evicted while the client was idle.
             rcheck_toplevel(b, base_exc_t::GENERIC,
-                            strprintf("Token %" PRIi64 " not in stream cache.", token));
+                            strprintf("Token %" PRIi64 " not in stream cache "
+                                      "(it may have been evicted).", token));
         } catch (const exc_t &e) {
             fill_error(res, Response::CLIENT_ERROR, e.what(), e.backtrace());
             return;
@@ -335,6 +378,7 @@ counted_t<val_t> term_t::eval(scope_env_t *env, eval_flags_t eval_flags) {
     DEBUG_ONLY_CODE(env->env->do_eval_callback());
     DBG("EVALUATING %s (%d):\n", name(), is_deterministic());
     env->env->throw_if_interruptor_pulsed();
+    env->env->check_resources();
     INC_DEPTH;
 
     try {
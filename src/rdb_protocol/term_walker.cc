@@ -120,6 +120,7 @@ private:
         case Term::TABLE:
         case Term::GET:
         case Term::GET_ALL:
+        case Term::SEARCH:
         case Term::EQ:
         case Term::NE:
         case Term::LT:
@@ -183,6 +184,10 @@ private:
         case Term::MATCH:
         case Term::SAMPLE:
         case Term::IS_EMPTY:
+        case Term::APPROX_COUNT_DISTINCT:
+        case Term::APPROX_QUANTILE:
+        case Term::CHANGES:
+        case Term::SHARD:
         case Term::DEFAULT:
         case Term::CONTAINS:
         case Term::KEYS:
@@ -278,6 +283,7 @@ private:
         case Term::TABLE:
         case Term::GET:
         case Term::GET_ALL:
+        case Term::SEARCH:
         case Term::EQ:
         case Term::NE:
         case Term::LT:
@@ -343,6 +349,10 @@ private:
         case Term::MATCH:
         case Term::SAMPLE:
         case Term::IS_EMPTY:
+        case Term::APPROX_COUNT_DISTINCT:
+        case Term::APPROX_QUANTILE:
+        case Term::CHANGES:
+        case Term::SHARD:
         case Term::DEFAULT:
         case Term::CONTAINS:
         case Term::KEYS:
@@ -3,11 +3,14 @@
 
 #include <map>
 #include <string>
+#include <vector>
 
 #include "clustering/administration/main/ports.hpp"
 #include "clustering/administration/suggester.hpp"
+#include "config/args.hpp"
 #include "rdb_protocol/meta_utils.hpp"
 #include "rdb_protocol/op.hpp"
+#include "rdb_protocol/text_index.hpp"
 #include "rpc/directory/read_manager.hpp"
 
 namespace ql {
@@ -155,7 +158,7 @@ public:
     table_create_term_t(compile_env_t *env, const protob_t<const Term> &term) :
         meta_write_op_t(env, term, argspec_t(1, 2),
                         optargspec_t({"datacenter", "primary_key",
-                                    "cache_size", "durability"})) { }
+                                    "cache_size", "block_size", "durability"})) { }
 private:
     virtual std::string write_eval_impl(scope_env_t *env, UNUSED eval_flags_t flags) {
         uuid_u dc_id = nil_uuid();
@@ -183,6 +186,20 @@ private:
             cache_size = v->as_int<int64_t>();
         }
 
+        // Larger blocks make for shallower btrees that scans read with fewer
+        // seeks, smaller ones cost less to write for point updates.
+        int64_t block_size = DEFAULT_BTREE_BLOCK_SIZE;
+        if (counted_t<val_t> v = optarg(env, "block_size")) {
+            block_size = v->as_int<int64_t>();
+            rcheck(block_size >= MIN_BTREE_BLOCK_SIZE && block_size <= MAX_BTREE_BLOCK_SIZE
+                   && (block_size & (block_size - 1)) == 0,
+                   base_exc_t::GENERIC,
+                   strprintf("`block_size` must be a power of two between %" PRIi64
+                             " and %" PRIi64 " (got %" PRIi64 ").",
+                             static_cast<int64_t>(MIN_BTREE_BLOCK_SIZE),
+                             static_cast<int64_t>(MAX_BTREE_BLOCK_SIZE), block_size));
+        }
+
         uuid_u db_id;
         name_string_t tbl_name;
         if (num_args() == 1) {
@@ -213,7 +230,7 @@ private:
             namespace_semilattice_metadata_t<rdb_protocol_t> ns =
                 new_namespace<rdb_protocol_t>(env->env->cluster_access.this_machine, db_id, dc_id, tbl_name,
                                               primary_key, port_defaults::reql_port,
-                                              cache_size);
+                                              cache_size, block_size);
 
             // Set Durability
             std::map<datacenter_id_t, ack_expectation_t> *ack_map =
@@ -421,6 +438,34 @@ private:
     virtual const char *name() const { return "sync"; }
 };
 
+class changes_term_t : public op_term_t {
+public:
+    changes_term_t(compile_env_t *env, const protob_t<const Term> &term)
+        : op_term_t(env, term, argspec_t(1)) { }
+private:
+    virtual counted_t<val_t> eval_impl(scope_env_t *env, UNUSED eval_flags_t flags) {
+        counted_t<table_t> t = arg(env, 0)->as_table();
+        return new_val(env->env, t->changes(env->env, this, backtrace()));
+    }
+    virtual bool is_deterministic() const { return false; }
+    virtual const char *name() const { return "changes"; }
+};
+
+class shard_term_t : public op_term_t {
+public:
+    shard_term_t(compile_env_t *env, const protob_t<const Term> &term)
+        : op_term_t(env, term, argspec_t(2)) { }
+private:
+    virtual counted_t<val_t> eval_impl(scope_env_t *env, UNUSED eval_flags_t flags) {
+        counted_t<table_t> table = arg(env, 0)->as_table();
+        int64_t shard = arg(env, 1)->as_int();
+        rcheck(shard >= 0, base_exc_t::GENERIC,
+               strprintf("Shard must be nonnegative (got %" PRIi64 ").", shard));
+        return new_val(table->shard(env->env, shard, this, backtrace()), table);
+    }
+    virtual const char *name() const { return "shard"; }
+};
+
 class table_term_t : public op_term_t {
 public:
     table_term_t(compile_env_t *env, const protob_t<const Term> &term)
@@ -480,12 +525,17 @@ private:
                 = make_counted<union_datum_stream_t>(streams, backtrace());
             return new_val(stream, table);
         } else {
-            datum_ptr_t arr(datum_t::R_ARRAY);
+            std::vector<counted_t<const datum_t> > keys;
+            keys.reserve(num_args() - 1);
             for (size_t i = 1; i < num_args(); ++i) {
-                counted_t<const datum_t> key = arg(env, i)->as_datum();
-                counted_t<const datum_t> row = table->get_row(env->env, key);
-                if (row->get_type() != datum_t::R_NULL) {
-                    arr.add(row);
+                keys.push_back(arg(env, i)->as_datum());
+            }
+            // One read for all the keys, which goes to every shard only once.
+            std::vector<counted_t<const datum_t> > rows = table->get_rows(env->env, keys);
+            datum_ptr_t arr(datum_t::R_ARRAY);
+            for (auto it = rows.begin(); it != rows.end(); ++it) {
+                if ((*it)->get_type() != datum_t::R_NULL) {
+                    arr.add(*it);
                 }
             }
             counted_t<datum_stream_t> stream
@@ -496,6 +546,42 @@ private:
     virtual const char *name() const { return "get_all"; }
 };
 
+class search_term_t : public op_term_t {
+public:
+    search_term_t(compile_env_t *env, const protob_t<const Term> &term)
+        : op_term_t(env, term, argspec_t(2),
+                    optargspec_t({ "index", "phrase", "limit" })) { }
+private:
+    virtual counted_t<val_t> eval_impl(scope_env_t *env, UNUSED eval_flags_t flags) {
+        counted_t<table_t> table = arg(env, 0)->as_table();
+        std::vector<std::string> terms;
+        tokenize_text(arg(env, 1)->as_str(), &terms);
+
+        counted_t<val_t> index = optarg(env, "index");
+        rcheck(index, base_exc_t::GENERIC, "`search` needs the text index to use.");
+        counted_t<val_t> phrase_val = optarg(env, "phrase");
+        bool phrase = phrase_val && phrase_val->as_bool();
+        size_t limit = TEXT_SEARCH_DEFAULT_LIMIT;
+        if (counted_t<val_t> limit_val = optarg(env, "limit")) {
+            int64_t l = limit_val->as_int();
+            rcheck(l >= 0, base_exc_t::GENERIC,
+                   strprintf("`limit` must be nonnegative (got %" PRIi64 ").", l));
+            limit = l;
+        }
+
+        std::vector<counted_t<const datum_t> > rows
+            = table->search(env->env, index->as_str(), terms, phrase, limit);
+        datum_ptr_t arr(datum_t::R_ARRAY);
+        for (auto it = rows.begin(); it != rows.end(); ++it) {
+            arr.add(*it);
+        }
+        counted_t<datum_stream_t> stream
+            = make_counted<array_datum_stream_t>(arr.to_counted(), backtrace());
+        return new_val(stream, table);
+    }
+    virtual const char *name() const { return "search"; }
+};
+
 counted_t<term_t> make_db_term(compile_env_t *env, const protob_t<const Term> &term) {
     return make_counted<db_term_t>(env, term);
 }
@@ -512,6 +598,14 @@ counted_t<term_t> make_get_all_term(compile_env_t *env, const protob_t<const Ter
     return make_counted<get_all_term_t>(env, term);
 }
 
+counted_t<term_t> make_search_term(compile_env_t *env, const protob_t<const Term> &term) {
+    return make_counted<search_term_t>(env, term);
+}
+
+counted_t<term_t> make_shard_term(compile_env_t *env, const protob_t<const Term> &term) {
+    return make_counted<shard_term_t>(env, term);
+}
+
 counted_t<term_t> make_db_create_term(compile_env_t *env, const protob_t<const Term> &term) {
     return make_counted<db_create_term_t>(env, term);
 }
@@ -540,6 +634,10 @@ counted_t<term_t> make_sync_term(compile_env_t *env, const protob_t<const Term>
     return make_counted<sync_term_t>(env, term);
 }
 
+counted_t<term_t> make_changes_term(compile_env_t *env, const protob_t<const Term> &term) {
+    return make_counted<changes_term_t>(env, term);
+}
+
 
 
 } // namespace ql
@@ -1,9 +1,13 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "rdb_protocol/terms/terms.hpp"
 
+#include <string>
+
+#include "rdb_protocol/aggregation.hpp"
 #include "rdb_protocol/op.hpp"
 #include "rdb_protocol/error.hpp"
 #include "rdb_protocol/func.hpp"
+#include "rdb_protocol/wire_func.hpp"
 
 namespace ql {
 
@@ -25,8 +29,39 @@ private:
     virtual const char *name() const { return "grouped_map_reduce"; }
 };
 
+class groupby_term_t : public op_term_t {
+public:
+    groupby_term_t(compile_env_t *env, const protob_t<const Term> &term)
+        : op_term_t(env, term, argspec_t(3)) { }
+private:
+    virtual counted_t<val_t> eval_impl(scope_env_t *env, UNUSED eval_flags_t flags) {
+        counted_t<datum_stream_t> seq = arg(env, 0)->as_seq(env->env);
+        counted_t<func_t> g = arg(env, 1)->as_func(PLUCK_SHORTCUT);
+
+        counted_t<const datum_t> dc = arg(env, 2)->as_datum();
+        rcheck(dc->get_type() == datum_t::R_OBJECT && dc->as_object().size() == 1,
+               base_exc_t::GENERIC, "Invalid aggregator for GROUPBY.");
+        const std::string &dc_name = dc->as_object().begin()->first;
+        group_aggregator_t aggregator;
+        rcheck(parse_group_aggregator(dc_name, &aggregator), base_exc_t::GENERIC,
+               strprintf("Unrecognized GROUPBY aggregator `%s`.", dc_name.c_str()));
+        std::string field;
+        if (aggregator != group_aggregator_t::COUNT) {
+            field = dc->as_object().begin()->second->as_str();
+        }
+
+        group_accumulators_t accumulators(aggregator);
+        seq->groupby(env->env, groupby_wire_func_t(g, aggregator, field), &accumulators);
+        return new_val(accumulators.to_arr());
+    }
+    virtual const char *name() const { return "groupby"; }
+};
+
 counted_t<term_t> make_gmr_term(compile_env_t *env, const protob_t<const Term> &term) {
     return make_counted<gmr_term_t>(env, term);
 }
+counted_t<term_t> make_groupby_term(compile_env_t *env, const protob_t<const Term> &term) {
+    return make_counted<groupby_term_t>(env, term);
+}
 
 } // namespace ql
@@ -1,4 +1,5 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "rdb_protocol/datum_json.hpp"
 #include "rdb_protocol/op.hpp"
 #include "rdb_protocol/term.hpp"
 #include "rdb_protocol/terms/terms.hpp"
@@ -11,13 +12,13 @@ public:
 
     counted_t<val_t> eval_impl(scope_env_t *env, UNUSED eval_flags_t flags) {
         std::string data = arg(env, 0)->as_str();
-        scoped_cJSON_t cjson(cJSON_Parse(data.c_str()));
-        rcheck(cjson.get() != NULL, base_exc_t::GENERIC,
+        counted_t<const datum_t> datum = parse_json_datum(data);
+        rcheck(datum.has(), base_exc_t::GENERIC,
                strprintf("Failed to parse \"%s\" as JSON.",
                  (data.size() > 40
                   ? (data.substr(0, 37) + "...").c_str()
                   : data.c_str())));
-        return new_val(make_counted<const datum_t>(cjson.get()));
+        return new_val(datum);
     }
 
     virtual const char *name() const { return "json"; }
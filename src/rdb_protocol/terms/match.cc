@@ -3,11 +3,113 @@
 
 #include <re2/re2.h>
 
+#include <list>
+#include <map>
+#include <string>
+#include <utility>
+
+#include "errors.hpp"
+#include <boost/shared_ptr.hpp>
+
+#include "config/args.hpp"
+#include "perfmon/perfmon.hpp"
 #include "rdb_protocol/error.hpp"
 #include "rdb_protocol/op.hpp"
+#include "thread_local.hpp"
 
 namespace ql {
 
+static perfmon_counter_t pm_regex_cache_hits, pm_regex_cache_misses;
+static perfmon_multi_membership_t pm_regex_cache_membership(&get_global_perfmon_collection(),
+    &pm_regex_cache_hits, "regex_cache_hits",
+    &pm_regex_cache_misses, "regex_cache_misses",
+    NULLPTR);
+
+/* The most recently used compiled regexps of a thread, so that the rows of a filter,
+and the batches and queries after them, don't all compile the same patterns over
+again.  Patterns that don't compile are kept too, for their error. */
+class regex_cache_t {
+public:
+    boost::shared_ptr<const RE2> get(const std::string &pattern) {
+        auto it = by_pattern.find(pattern);
+        if (it != by_pattern.end()) {
+            ++pm_regex_cache_hits;
+            entries.splice(entries.begin(), entries, it->second);
+            return it->second->second;
+        }
+
+        ++pm_regex_cache_misses;
+        boost::shared_ptr<const RE2> regexp(new RE2(pattern));
+        entries.push_front(std::make_pair(pattern, regexp));
+        by_pattern.insert(std::make_pair(pattern, entries.begin()));
+        if (entries.size() > REGEX_CACHE_SIZE) {
+            by_pattern.erase(entries.back().first);
+            entries.pop_back();
+        }
+        return regexp;
+    }
+
+private:
+    typedef std::list<std::pair<std::string, boost::shared_ptr<const RE2> > > list_t;
+    // Most recently used first.
+    list_t entries;
+    std::map<std::string, list_t::iterator> by_pattern;
+};
+
+TLS_with_init(regex_cache_t *, regex_cache, NULL);
+
+static boost::shared_ptr<const RE2> get_regexp(const std::string &pattern) {
+    regex_cache_t *cache = TLS_get_regex_cache();
+    if (cache == NULL) {
+        // It lives as long as the thread.
+        cache = new regex_cache_t();
+        TLS_set_regex_cache(cache);
+    }
+    return cache->get(pattern);
+}
+
+counted_t<const datum_t> match_regexp(const RE2 &regexp, const std::string &str) {
+    // We add 1 to account for $0.
+    int ngroups = regexp.NumberOfCapturingGroups() + 1;
+    scoped_array_t<re2::StringPiece> groups(ngroups);
+    if (regexp.Match(str, 0, str.size(), RE2::UNANCHORED, groups.data(), ngroups)) {
+        datum_ptr_t match(datum_t::R_OBJECT);
+        // We use `b` to store whether or not we got a conflict when writing
+        // to an object.  This should never happen here because we aren't
+        // using user-generated keys, but the result of `add` is marked
+        // MUST_USE.
+        bool b = false;
+        b |= match.add("str", make_counted<const datum_t>(groups[0].as_string()));
+        b |= match.add("start", make_counted<const datum_t>(
+                           static_cast<double>(groups[0].begin() - str.data())));
+        b |= match.add("end", make_counted<const datum_t>(
+                           static_cast<double>(groups[0].end() - str.data())));
+        datum_ptr_t match_groups(datum_t::R_ARRAY);
+        for (int i = 1; i < ngroups; ++i) {
+            const re2::StringPiece &group = groups[i];
+            if (group.data() == NULL) {
+                match_groups.add(make_counted<datum_t>(datum_t::R_NULL));
+            } else {
+                datum_ptr_t match_group(datum_t::R_OBJECT);
+                b |= match_group.add(
+                    "str", make_counted<const datum_t>(group.as_string()));
+                b |= match_group.add(
+                    "start", make_counted<const datum_t>(
+                        static_cast<double>(group.begin() - str.data())));
+                b |= match_group.add(
+                    "end", make_counted<const datum_t>(
+                        static_cast<double>(group.end() - str.data())));
+                match_groups.add(match_group.to_counted());
+            }
+        }
+        b |= match.add("groups", match_groups.to_counted());
+        r_sanity_check(!b);
+        return match.to_counted();
+    } else {
+        return make_counted<const datum_t>(datum_t::R_NULL);
+    }
+}
+
 class match_term_t : public op_term_t {
 public:
     match_term_t(compile_env_t *env, const protob_t<const Term> &term)
@@ -15,55 +117,24 @@ public:
 private:
     virtual counted_t<val_t> eval_impl(scope_env_t *env, UNUSED eval_flags_t flags) {
         std::string str = arg(env, 0)->as_str();
-        RE2 regexp(arg(env, 1)->as_str());
-        if (!regexp.ok()) {
+        std::string pattern = arg(env, 1)->as_str();
+        // The pattern is usually the same for every row, so the term keeps the
+        // last regexp and doesn't even have to look it up.
+        if (!regexp || pattern != regexp->pattern()) {
+            regexp = get_regexp(pattern);
+        }
+        if (!regexp->ok()) {
             rfail(base_exc_t::GENERIC,
                   "Error in regexp `%s` (portion `%s`): %s",
-                  regexp.pattern().c_str(),
-                  regexp.error_arg().c_str(),
-                  regexp.error().c_str());
-        }
-        // We add 1 to account for $0.
-        int ngroups = regexp.NumberOfCapturingGroups() + 1;
-        scoped_array_t<re2::StringPiece> groups(ngroups);
-        if (regexp.Match(str, 0, str.size(), RE2::UNANCHORED, groups.data(), ngroups)) {
-            datum_ptr_t match(datum_t::R_OBJECT);
-            // We use `b` to store whether or not we got a conflict when writing
-            // to an object.  This should never happen here because we aren't
-            // using user-generated keys, but the result of `add` is marked
-            // MUST_USE.
-            bool b = false;
-            b |= match.add("str", make_counted<const datum_t>(groups[0].as_string()));
-            b |= match.add("start", make_counted<const datum_t>(
-                               static_cast<double>(groups[0].begin() - str.data())));
-            b |= match.add("end", make_counted<const datum_t>(
-                               static_cast<double>(groups[0].end() - str.data())));
-            datum_ptr_t match_groups(datum_t::R_ARRAY);
-            for (int i = 1; i < ngroups; ++i) {
-                const re2::StringPiece &group = groups[i];
-                if (group.data() == NULL) {
-                    match_groups.add(make_counted<datum_t>(datum_t::R_NULL));
-                } else {
-                    datum_ptr_t match_group(datum_t::R_OBJECT);
-                    b |= match_group.add(
-                        "str", make_counted<const datum_t>(group.as_string()));
-                    b |= match_group.add(
-                        "start", make_counted<const datum_t>(
-                            static_cast<double>(group.begin() - str.data())));
-                    b |= match_group.add(
-                        "end", make_counted<const datum_t>(
-                            static_cast<double>(group.end() - str.data())));
-                    match_groups.add(match_group.to_counted());
-                }
-            }
-            b |= match.add("groups", match_groups.to_counted());
-            r_sanity_check(!b);
-            return new_val(match.to_counted());
-        } else {
-            return new_val(make_counted<const datum_t>(datum_t::R_NULL));
+                  regexp->pattern().c_str(),
+                  regexp->error_arg().c_str(),
+                  regexp->error().c_str());
         }
+        return new_val(match_regexp(*regexp, str));
     }
     virtual const char *name() const { return "match"; }
+
+    boost::shared_ptr<const RE2> regexp;
 };
 
 counted_t<term_t> make_match_term(compile_env_t *env, const protob_t<const Term> &term) {
@@ -54,8 +54,27 @@ public:
 
         prop_bt(func.get());
     }
+protected:
+    // The args after the first one, as an array that makes a pathspec_t.
+    counted_t<const datum_t> paths_arg(scope_env_t *env) {
+        const size_t n = num_args();
+        std::vector<counted_t<const datum_t> > paths;
+        paths.reserve(n - 1);
+        for (size_t i = 1; i < n; ++i) {
+            paths.push_back(arg(env, i)->as_datum());
+        }
+        return make_counted<const datum_t>(std::move(paths));
+    }
+
 private:
     virtual counted_t<val_t> obj_eval(scope_env_t *env, counted_t<val_t> v0) = 0;
+    // Maps `func`, which evaluates the term on an element, over a sequence of the
+    // MAP kind.
+    virtual counted_t<datum_stream_t> map_seq(UNUSED scope_env_t *env,
+                                              counted_t<datum_stream_t> seq,
+                                              counted_t<func_t> func) {
+        return seq->map(func);
+    }
 
     virtual counted_t<val_t> eval_impl(scope_env_t *env, UNUSED eval_flags_t flags) {
         counted_t<val_t> v0 = arg(env, 0);
@@ -82,7 +101,7 @@ private:
 
             switch (poly_type) {
             case MAP:
-                return new_val(env->env, v0->as_seq(env->env)->map(func));
+                return new_val(env->env, map_seq(env, v0->as_seq(env->env), func));
             case FILTER:
                 return new_val(env->env,
                                v0->as_seq(env->env)->filter(func, counted_t<func_t>()));
@@ -110,15 +129,18 @@ private:
         counted_t<const datum_t> obj = v0->as_datum();
         r_sanity_check(obj->get_type() == datum_t::R_OBJECT);
 
-        const size_t n = num_args();
-        std::vector<counted_t<const datum_t> > paths;
-        paths.reserve(n - 1);
-        for (size_t i = 1; i < n; ++i) {
-            paths.push_back(arg(env, i)->as_datum());
-        }
-        pathspec_t pathspec(make_counted<const datum_t>(std::move(paths)), this);
+        pathspec_t pathspec(paths_arg(env), this);
         return new_val(project(obj, pathspec, DONT_RECURSE));
     }
+    virtual counted_t<datum_stream_t> map_seq(scope_env_t *env,
+                                              counted_t<datum_stream_t> seq,
+                                              counted_t<func_t> func) {
+        counted_t<const datum_t> paths = paths_arg(env);
+        // The shards can't report invalid paths.
+        pathspec_t pathspec(paths, this);
+        return seq->project(
+            func, projection_transform_t(projection_type_t::PLUCK, paths, backtrace()));
+    }
     virtual const char *name() const { return "pluck"; }
 };
 
@@ -131,15 +153,18 @@ private:
         counted_t<const datum_t> obj = v0->as_datum();
         r_sanity_check(obj->get_type() == datum_t::R_OBJECT);
 
-        std::vector<counted_t<const datum_t> > paths;
-        const size_t n = num_args();
-        paths.reserve(n - 1);
-        for (size_t i = 1; i < n; ++i) {
-            paths.push_back(arg(env, i)->as_datum());
-        }
-        pathspec_t pathspec(make_counted<const datum_t>(std::move(paths)), this);
+        pathspec_t pathspec(paths_arg(env), this);
         return new_val(unproject(obj, pathspec, DONT_RECURSE));
     }
+    virtual counted_t<datum_stream_t> map_seq(scope_env_t *env,
+                                              counted_t<datum_stream_t> seq,
+                                              counted_t<func_t> func) {
+        counted_t<const datum_t> paths = paths_arg(env);
+        // The shards can't report invalid paths.
+        pathspec_t pathspec(paths, this);
+        return seq->project(
+            func, projection_transform_t(projection_type_t::WITHOUT, paths, backtrace()));
+    }
     virtual const char *name() const { return "without"; }
 };
 
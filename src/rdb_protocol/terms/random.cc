@@ -1,6 +1,4 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
-#include <algorithm>
-
 #include "rdb_protocol/op.hpp"
 #include "rdb_protocol/term.hpp"
 #include "rdb_protocol/terms/terms.hpp"
@@ -32,29 +30,7 @@ public:
             seq = v->as_seq(env->env);
         }
 
-        std::vector<counted_t<const datum_t> > result;
-        result.reserve(num);
-        size_t element_number = 0;
-        batchspec_t batchspec = batchspec_t::user(batch_type_t::TERMINAL, env->env);
-        {
-            profile::sampler_t sampler("Sampling elements.", env->env->trace);
-            while (counted_t<const datum_t> row = seq->next(env->env, batchspec)) {
-                element_number++;
-                if (result.size() < num) {
-                    result.push_back(row);
-                } else {
-                    /* We have a limitation on the size of arrays that makes
-                     * sure they are less than the size of an integer. */
-                    size_t new_index = randint(element_number);
-                    if (new_index < num) {
-                        result[new_index] = row;
-                    }
-                }
-                sampler.new_sample();
-            }
-        }
-
-        std::random_shuffle(result.begin(), result.end());
+        std::vector<counted_t<const datum_t> > result = seq->sample(env->env, num);
 
         counted_t<datum_stream_t> new_ds(
             new array_datum_stream_t(make_counted<const datum_t>(std::move(result)),
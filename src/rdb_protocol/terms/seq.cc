@@ -32,6 +32,59 @@ private:
     virtual const char *name() const { return "count"; }
 };
 
+class approx_count_distinct_term_t : public op_term_t {
+public:
+    approx_count_distinct_term_t(compile_env_t *env, const protob_t<const Term> &term)
+        : op_term_t(env, term, argspec_t(1)) { }
+private:
+    virtual counted_t<val_t> eval_impl(scope_env_t *env, UNUSED eval_flags_t flags) {
+        distinct_sketch_t sketch;
+        arg(env, 0)->as_seq(env->env)->sketch_distinct(env->env, &sketch);
+        return new_val(make_counted<const datum_t>(sketch.estimate()));
+    }
+    virtual const char *name() const { return "approx_count_distinct"; }
+};
+
+class approx_quantile_term_t : public op_term_t {
+public:
+    approx_quantile_term_t(compile_env_t *env, const protob_t<const Term> &term)
+        : op_term_t(env, term, argspec_t(2)) { }
+private:
+    virtual counted_t<val_t> eval_impl(scope_env_t *env, UNUSED eval_flags_t flags) {
+        counted_t<datum_stream_t> seq = arg(env, 0)->as_seq(env->env);
+        // A quantile or an array of them.
+        counted_t<const datum_t> q = arg(env, 1)->as_datum();
+        std::vector<double> quantiles;
+        if (q->get_type() == datum_t::R_ARRAY) {
+            for (size_t i = 0; i < q->size(); ++i) {
+                quantiles.push_back(quantile_arg(q->get(i)));
+            }
+        } else {
+            quantiles.push_back(quantile_arg(q));
+        }
+
+        quantile_sketch_t sketch;
+        seq->sketch_quantiles(env->env, &sketch);
+        rcheck(!sketch.empty(), base_exc_t::NON_EXISTENCE,
+               "Cannot take a quantile of an empty stream.");
+        if (q->get_type() != datum_t::R_ARRAY) {
+            return new_val(make_counted<const datum_t>(sketch.quantile(quantiles[0])));
+        }
+        std::vector<counted_t<const datum_t> > estimates;
+        for (auto it = quantiles.begin(); it != quantiles.end(); ++it) {
+            estimates.push_back(make_counted<const datum_t>(sketch.quantile(*it)));
+        }
+        return new_val(make_counted<const datum_t>(std::move(estimates)));
+    }
+    double quantile_arg(const counted_t<const datum_t> &d) {
+        double q = d->as_num();
+        rcheck(q >= 0 && q <= 1, base_exc_t::GENERIC,
+               strprintf("Quantile %s is not between 0 and 1.", d->print().c_str()));
+        return q;
+    }
+    virtual const char *name() const { return "approx_quantile"; }
+};
+
 class map_term_t : public op_term_t {
 public:
     map_term_t(compile_env_t *env, const protob_t<const Term> &term)
@@ -164,6 +217,27 @@ private:
     virtual const char *name() const { return "zip"; }
 };
 
+class eq_join_term_t : public op_term_t {
+public:
+    eq_join_term_t(compile_env_t *env, const protob_t<const Term> &term)
+        : op_term_t(env, term, argspec_t(3), optargspec_t({ "index" })) { }
+private:
+    virtual counted_t<val_t> eval_impl(scope_env_t *env, UNUSED eval_flags_t flags) {
+        counted_t<datum_stream_t> left = arg(env, 0)->as_seq(env->env);
+        counted_t<func_t> left_key = arg(env, 1)->as_func(GET_FIELD_SHORTCUT);
+        counted_t<table_t> right = arg(env, 2)->as_table();
+        boost::optional<std::string> sindex;
+        counted_t<val_t> index = optarg(env, "index");
+        if (index.has() && index->as_str() != right->get_pkey()) {
+            sindex = index->as_str();
+        }
+        counted_t<datum_stream_t> join
+            = make_counted<eq_join_datum_stream_t>(left, left_key, right, sindex);
+        return new_val(env->env, join);
+    }
+    virtual const char *name() const { return "eq_join"; }
+};
+
 counted_t<term_t> make_between_term(compile_env_t *env, const protob_t<const Term> &term) {
     return make_counted<between_term_t>(env, term);
 }
@@ -182,11 +256,22 @@ counted_t<term_t> make_concatmap_term(compile_env_t *env, const protob_t<const T
 counted_t<term_t> make_count_term(compile_env_t *env, const protob_t<const Term> &term) {
     return make_counted<count_term_t>(env, term);
 }
+counted_t<term_t> make_approx_count_distinct_term(
+        compile_env_t *env, const protob_t<const Term> &term) {
+    return make_counted<approx_count_distinct_term_t>(env, term);
+}
+counted_t<term_t> make_approx_quantile_term(
+        compile_env_t *env, const protob_t<const Term> &term) {
+    return make_counted<approx_quantile_term_t>(env, term);
+}
 counted_t<term_t> make_union_term(compile_env_t *env, const protob_t<const Term> &term) {
     return make_counted<union_term_t>(env, term);
 }
 counted_t<term_t> make_zip_term(compile_env_t *env, const protob_t<const Term> &term) {
     return make_counted<zip_term_t>(env, term);
 }
+counted_t<term_t> make_eq_join_term(compile_env_t *env, const protob_t<const Term> &term) {
+    return make_counted<eq_join_term_t>(env, term);
+}
 
 } // namespace ql
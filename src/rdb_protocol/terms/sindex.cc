@@ -2,6 +2,7 @@
 #include "rdb_protocol/terms/terms.hpp"
 
 #include <string>
+#include <vector>
 
 #include "rdb_protocol/error.hpp"
 #include "rdb_protocol/func.hpp"
@@ -18,7 +19,8 @@ namespace ql {
 class sindex_create_term_t : public op_term_t {
 public:
     sindex_create_term_t(compile_env_t *env, const protob_t<const Term> &term)
-        : op_term_t(env, term, argspec_t(2, 3), optargspec_t({"multi"})) { }
+        : op_term_t(env, term, argspec_t(2, 3), optargspec_t({"multi", "stored", "hash", "text", "projection",
+                                                        "aggregate", "sum"})) { }
 
     virtual counted_t<val_t> eval_impl(scope_env_t *env, UNUSED eval_flags_t flags) {
         counted_t<table_t> table = arg(env, 0)->as_table();
@@ -28,13 +30,49 @@ public:
                base_exc_t::GENERIC,
                strprintf("Index name conflict: `%s` is the name of the primary key.",
                          name.c_str()));
+
+        /* A projection index keeps some fields of every row, by its primary key. */
+        counted_t<val_t> projection_val = optarg(env, "projection");
+        rcheck(!projection_val || num_args() == 2, base_exc_t::GENERIC,
+               "A projection index cannot have an index function.");
+
+        /* An aggregate index groups the rows by plucking some fields, like
+           `groupby`, and keeps the count and a sum of every group. */
+        counted_t<val_t> aggregate_val = optarg(env, "aggregate");
+        counted_t<val_t> sum_val = optarg(env, "sum");
+        rcheck(!aggregate_val || num_args() == 2, base_exc_t::GENERIC,
+               "An aggregate index cannot have an index function.");
+        rcheck(!sum_val || aggregate_val, base_exc_t::GENERIC,
+               "Only an aggregate index can have a field to sum up.");
+
         counted_t<func_t> index_func;
         if (num_args() == 3) {
             index_func = arg(env, 2)->as_func();
+        } else if (aggregate_val) {
+            counted_t<const datum_t> fields_datum = aggregate_val->as_datum();
+            std::vector<std::string> group_fields;
+            get_field_names(fields_datum, &group_fields);
+            rcheck(!group_fields.empty(), base_exc_t::GENERIC,
+                   "An aggregate index needs at least one field to group by.");
+
+            pb::dummy_var_t x = pb::dummy_var_t::SINDEXCREATE_X;
+            protob_t<Term> func_term
+                = r::fun(x, r::var(x).pluck(fields_datum)).release_counted();
+
+            prop_bt(func_term.get());
+            compile_env_t empty_compile_env((var_visibility_t()));
+            counted_t<func_term_t> func_term_term = make_counted<func_term_t>(&empty_compile_env,
+                                                                              func_term);
+
+            index_func = func_term_term->eval_to_func(env->scope);
         } else {
+            counted_t<const datum_t> field_datum =
+                projection_val
+                ? make_counted<const datum_t>(std::string(table->get_pkey()))
+                : name_datum;
 
             pb::dummy_var_t x = pb::dummy_var_t::SINDEXCREATE_X;
-            protob_t<Term> func_term = r::fun(x, r::var(x)[name_datum]).release_counted();
+            protob_t<Term> func_term = r::fun(x, r::var(x)[field_datum]).release_counted();
 
             prop_bt(func_term.get());
             compile_env_t empty_compile_env((var_visibility_t()));
@@ -52,7 +90,64 @@ public:
              ? sindex_multi_bool_t::MULTI
              : sindex_multi_bool_t::SINGLE);
 
-        bool success = table->sindex_create(env->env, name, index_func, multi);
+        /* A text index has the words of the string its function returns. */
+        counted_t<val_t> text_val = optarg(env, "text");
+        if (text_val && text_val->as_datum()->as_bool()) {
+            rcheck(multi == sindex_multi_bool_t::SINGLE, base_exc_t::GENERIC,
+                   "A text index cannot also be a multi index.");
+            multi = sindex_multi_bool_t::TEXT;
+        }
+
+        /* A covering index stores these fields of the documents in its entries. */
+        std::vector<std::string> stored_fields;
+        counted_t<val_t> stored_val = optarg(env, "stored");
+        if (stored_val) {
+            get_field_names(stored_val->as_datum(), &stored_fields);
+        }
+
+        if (projection_val) {
+            rcheck(multi == sindex_multi_bool_t::SINGLE && !stored_val,
+                   base_exc_t::GENERIC,
+                   "A projection index cannot also be a multi, text or covering index.");
+            get_field_names(projection_val->as_datum(), &stored_fields);
+            rcheck(!stored_fields.empty(), base_exc_t::GENERIC,
+                   "A projection index needs at least one field.");
+            multi = sindex_multi_bool_t::PROJECTION;
+        }
+
+        if (aggregate_val) {
+            rcheck(multi == sindex_multi_bool_t::SINGLE && !stored_val,
+                   base_exc_t::GENERIC,
+                   "An aggregate index cannot also be a multi, text, projection "
+                   "or covering index.");
+            if (sum_val) {
+                stored_fields.push_back(sum_val->as_str());
+            }
+            multi = sindex_multi_bool_t::AGGREGATE;
+        }
+
+        /* A hash index only answers `get_all`, with smaller keys. */
+        counted_t<val_t> hash_val = optarg(env, "hash");
+        sindex_key_format_t key_format =
+            (hash_val && hash_val->as_datum()->as_bool()
+             ? sindex_key_format_t::HASH
+             : sindex_key_format_t::BINARY);
+        // `search` reads the entries of a term in key order.
+        rcheck(multi != sindex_multi_bool_t::TEXT
+               || key_format == sindex_key_format_t::BINARY,
+               base_exc_t::GENERIC, "A text index cannot also be a hash index.");
+        // Aggregations scan the whole projection index, and hashed keys save nothing
+        // on a primary key that is already there.
+        rcheck(multi != sindex_multi_bool_t::PROJECTION
+               || key_format == sindex_key_format_t::BINARY,
+               base_exc_t::GENERIC, "A projection index cannot also be a hash index.");
+        // The keys of an aggregate index are its own, see aggregate_row_key().
+        rcheck(multi != sindex_multi_bool_t::AGGREGATE
+               || key_format == sindex_key_format_t::BINARY,
+               base_exc_t::GENERIC, "An aggregate index cannot also be a hash index.");
+
+        bool success = table->sindex_create(env->env, name, index_func, multi,
+                                            stored_fields, key_format);
         if (success) {
             datum_ptr_t res(datum_t::R_OBJECT);
             UNUSED bool b = res.add("created", make_counted<datum_t>(1.0));
@@ -63,6 +158,19 @@ public:
     }
 
     virtual const char *name() const { return "sindex_create"; }
+
+private:
+    // Reads a field name or an array of them.
+    static void get_field_names(counted_t<const datum_t> names,
+                                std::vector<std::string> *names_out) {
+        if (names->get_type() == datum_t::R_ARRAY) {
+            for (size_t i = 0; i < names->size(); ++i) {
+                names_out->push_back(names->get(i)->as_str());
+            }
+        } else {
+            names_out->push_back(names->as_str());
+        }
+    }
 };
 
 class sindex_drop_term_t : public op_term_t {
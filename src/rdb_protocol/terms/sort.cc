@@ -7,6 +7,7 @@
 
 #include "rdb_protocol/datum_stream.hpp"
 #include "rdb_protocol/error.hpp"
+#include "rdb_protocol/external_sort.hpp"
 #include "rdb_protocol/func.hpp"
 #include "rdb_protocol/op.hpp"
 #include "rdb_protocol/term_walker.hpp"
@@ -52,61 +53,6 @@ public:
           optargspec_t({"index"})), src_term(term) { }
 private:
     enum order_direction_t { ASC, DESC };
-    class lt_cmp_t {
-    public:
-        typedef bool result_type;
-        explicit lt_cmp_t(
-            std::vector<std::pair<order_direction_t, counted_t<func_t> > > _comparisons)
-            : comparisons(std::move(_comparisons)) { }
-
-        bool operator()(env_t *env,
-                        profile::sampler_t *sampler,
-                        counted_t<const datum_t> l,
-                        counted_t<const datum_t> r) const {
-            sampler->new_sample();
-            for (auto it = comparisons.begin(); it != comparisons.end(); ++it) {
-                counted_t<const datum_t> lval;
-                counted_t<const datum_t> rval;
-                try {
-                    lval = it->second->call(env, l)->as_datum();
-                } catch (const base_exc_t &e) {
-                    if (e.get_type() != base_exc_t::NON_EXISTENCE) {
-                        throw;
-                    }
-                }
-
-                try {
-                    rval = it->second->call(env, r)->as_datum();
-                } catch (const base_exc_t &e) {
-                    if (e.get_type() != base_exc_t::NON_EXISTENCE) {
-                        throw;
-                    }
-                }
-
-                if (!lval.has() && !rval.has()) {
-                    continue;
-                }
-                if (!lval.has()) {
-                    return true != (it->first == DESC);
-                }
-                if (!rval.has()) {
-                    return false != (it->first == DESC);
-                }
-                // TODO: use datum_t::cmp instead to be faster
-                if (*lval == *rval) {
-                    continue;
-                }
-                return (*lval < *rval) != (it->first == DESC);
-            }
-
-            return false;
-        }
-
-    private:
-        const std::vector<std::pair<order_direction_t, counted_t<func_t> > >
-            comparisons;
-    };
-
     virtual counted_t<val_t> eval_impl(scope_env_t *env, UNUSED eval_flags_t flags) {
         std::vector<std::pair<order_direction_t, counted_t<func_t> > > comparisons;
         scoped_ptr_t<datum_t> arr(new datum_t(datum_t::R_ARRAY));
@@ -119,7 +65,6 @@ private:
                         std::make_pair(ASC, arg(env, i)->as_func(GET_FIELD_SHORTCUT)));
             }
         }
-        lt_cmp_t lt_cmp(comparisons);
 
         counted_t<table_t> tbl;
         counted_t<datum_stream_t> seq;
@@ -155,8 +100,12 @@ private:
             tbl->add_sorting(index->as_str(), sorting, this);
             if (index->as_str() != tbl->get_pkey()
                 && !comparisons.empty()) {
+                indexed_sort_datum_stream_t::comparisons_t funcs;
+                for (auto it = comparisons.begin(); it != comparisons.end(); ++it) {
+                    funcs.push_back(std::make_pair(it->second, it->first == DESC));
+                }
                 seq = make_counted<indexed_sort_datum_stream_t>(
-                    tbl->as_datum_stream(env->env, backtrace()), lt_cmp);
+                    tbl->as_datum_stream(env->env, backtrace()), funcs);
             } else {
                 seq = tbl->as_datum_stream(env->env, backtrace());
             }
@@ -166,23 +115,13 @@ private:
             }
             rcheck(!comparisons.empty(), base_exc_t::GENERIC,
                    "Must specify something to order by.");
-            std::vector<counted_t<const datum_t> > to_sort;
-            batchspec_t batchspec = batchspec_t::user(batch_type_t::TERMINAL, env->env);
-            for (;;) {
-                std::vector<counted_t<const datum_t> > data
-                    = seq->next_batch(env->env, batchspec);
-                if (data.size() == 0) {
-                    break;
-                }
-                std::move(data.begin(), data.end(), std::back_inserter(to_sort));
-                rcheck(to_sort.size() <= array_size_limit(), base_exc_t::GENERIC,
-                       strprintf("Array over size limit %zu.", to_sort.size()).c_str());
+            order_funcs_t funcs;
+            for (auto it = comparisons.begin(); it != comparisons.end(); ++it) {
+                funcs.push_back(std::make_pair(map_wire_func_t(it->second),
+                                               it->first == DESC));
             }
-            profile::sampler_t sampler("Sorting in-memory.", env->env->trace);
-            auto fn = boost::bind(lt_cmp, env->env, &sampler, _1, _2);
-            std::sort(to_sort.begin(), to_sort.end(), fn);
-            seq = make_counted<array_datum_stream_t>(
-                make_counted<const datum_t>(std::move(to_sort)), backtrace());
+            seq = make_counted<orderby_datum_stream_t>(seq, std::move(funcs),
+                                                       backtrace());
         }
         return tbl.has() ? new_val(seq, tbl) : new_val(env->env, seq);
     }
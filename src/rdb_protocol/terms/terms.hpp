@@ -6,6 +6,10 @@
 #include "rdb_protocol/counted_term.hpp"
 #include "rdb_protocol/pseudo_time.hpp"
 
+namespace re2 {
+class RE2;
+}  // namespace re2
+
 namespace ql {
 class compile_env_t;
 class term_t;
@@ -43,6 +47,8 @@ counted_t<term_t> make_funcall_term(compile_env_t *env, const protob_t<const Ter
 
 // datum_terms.cc
 counted_t<term_t> make_datum_term(const protob_t<const Term> &term);
+// Makes a term from make_datum_term() evaluate to `datum` from now on.
+void rebind_datum_term(term_t *term, const Datum *datum);
 counted_t<term_t> make_constant_term(compile_env_t *env, const protob_t<const Term> &term,
                                      double constant, const char *name);
 counted_t<term_t> make_make_array_term(compile_env_t *env, const protob_t<const Term> &term);
@@ -53,6 +59,8 @@ counted_t<term_t> make_db_term(compile_env_t *env, const protob_t<const Term> &t
 counted_t<term_t> make_table_term(compile_env_t *env, const protob_t<const Term> &term);
 counted_t<term_t> make_get_term(compile_env_t *env, const protob_t<const Term> &term);
 counted_t<term_t> make_get_all_term(compile_env_t *env, const protob_t<const Term> &term);
+counted_t<term_t> make_search_term(compile_env_t *env, const protob_t<const Term> &term);
+counted_t<term_t> make_shard_term(compile_env_t *env, const protob_t<const Term> &term);
 counted_t<term_t> make_db_create_term(compile_env_t *env, const protob_t<const Term> &term);
 counted_t<term_t> make_db_drop_term(compile_env_t *env, const protob_t<const Term> &term);
 counted_t<term_t> make_db_list_term(compile_env_t *env, const protob_t<const Term> &term);
@@ -60,6 +68,7 @@ counted_t<term_t> make_table_create_term(compile_env_t *env, const protob_t<cons
 counted_t<term_t> make_table_drop_term(compile_env_t *env, const protob_t<const Term> &term);
 counted_t<term_t> make_table_list_term(compile_env_t *env, const protob_t<const Term> &term);
 counted_t<term_t> make_sync_term(compile_env_t *env, const protob_t<const Term> &term);
+counted_t<term_t> make_changes_term(compile_env_t *env, const protob_t<const Term> &term);
 
 // error.cc
 counted_t<term_t> make_error_term(compile_env_t *env, const protob_t<const Term> &term);
@@ -67,6 +76,7 @@ counted_t<term_t> make_default_term(compile_env_t *env, const protob_t<const Ter
 
 // gmr.cc
 counted_t<term_t> make_gmr_term(compile_env_t *env, const protob_t<const Term> &term);
+counted_t<term_t> make_groupby_term(compile_env_t *env, const protob_t<const Term> &term);
 
 // js.cc
 counted_t<term_t> make_javascript_term(compile_env_t *env, const protob_t<const Term> &term);
@@ -76,6 +86,8 @@ counted_t<term_t> make_json_term(compile_env_t *env, const protob_t<const Term>
 
 // match.cc
 counted_t<term_t> make_match_term(compile_env_t *env, const protob_t<const Term> &term);
+// What `match` returns for `str`: the match object, or null if there is none.
+counted_t<const datum_t> match_regexp(const re2::RE2 &regexp, const std::string &str);
 
 // obj.cc
 counted_t<term_t> make_keys_term(compile_env_t *env, const protob_t<const Term> &term);
@@ -94,10 +106,8 @@ counted_t<term_t> make_not_term(compile_env_t *env, const protob_t<const Term> &
 
 // rewrites.cc
 counted_t<term_t> make_skip_term(compile_env_t *env, const protob_t<const Term> &term);
-counted_t<term_t> make_groupby_term(compile_env_t *env, const protob_t<const Term> &term);
 counted_t<term_t> make_inner_join_term(compile_env_t *env, const protob_t<const Term> &term);
 counted_t<term_t> make_outer_join_term(compile_env_t *env, const protob_t<const Term> &term);
-counted_t<term_t> make_eq_join_term(compile_env_t *env, const protob_t<const Term> &term);
 counted_t<term_t> make_update_term(compile_env_t *env, const protob_t<const Term> &term);
 counted_t<term_t> make_delete_term(compile_env_t *env, const protob_t<const Term> &term);
 counted_t<term_t> make_difference_term(compile_env_t *env, const protob_t<const Term> &term);
@@ -110,8 +120,13 @@ counted_t<term_t> make_map_term(compile_env_t *env, const protob_t<const Term> &
 counted_t<term_t> make_filter_term(compile_env_t *env, const protob_t<const Term> &term);
 counted_t<term_t> make_concatmap_term(compile_env_t *env, const protob_t<const Term> &term);
 counted_t<term_t> make_count_term(compile_env_t *env, const protob_t<const Term> &term);
+counted_t<term_t> make_approx_count_distinct_term(
+        compile_env_t *env, const protob_t<const Term> &term);
+counted_t<term_t> make_approx_quantile_term(
+        compile_env_t *env, const protob_t<const Term> &term);
 counted_t<term_t> make_union_term(compile_env_t *env, const protob_t<const Term> &term);
 counted_t<term_t> make_zip_term(compile_env_t *env, const protob_t<const Term> &term);
+counted_t<term_t> make_eq_join_term(compile_env_t *env, const protob_t<const Term> &term);
 
 // sindex.cc
 counted_t<term_t> make_sindex_create_term(compile_env_t *env, const protob_t<const Term> &term);
@@ -166,8 +166,7 @@ private:
 
                 // OBJECT -> ARRAY
                 if (start_type == R_OBJECT_TYPE && end_type == R_ARRAY_TYPE) {
-                    const std::map<std::string, counted_t<const datum_t> > &obj
-                        = d->as_object();
+                    const datum_object_t &obj = d->as_object();
                     std::vector<counted_t<const datum_t> > arr;
                     arr.reserve(obj.size());
                     for (auto it = obj.begin(); it != obj.end(); ++it) {
@@ -306,6 +305,8 @@ private:
             b |= info.add("primary_key",
                           make_counted<datum_t>(std::string(table->get_pkey())));
             b |= info.add("indexes", table->sindex_list(env->env));
+            b |= info.add("shards", make_counted<datum_t>(
+                              static_cast<double>(table->shard_count(this))));
             b |= info.add("db", val_info(env, new_val(table->db)));
         } break;
         case SELECTION_TYPE: {
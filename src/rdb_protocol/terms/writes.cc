@@ -1,9 +1,17 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 
+#include <deque>
+#include <exception>
 #include <string>
 #include <utility>
 #include <vector>
 
+#include "errors.hpp"
+#include <boost/bind.hpp>
+
+#include "arch/runtime/coroutines.hpp"
+#include "concurrency/cond_var.hpp"
+#include "containers/scoped.hpp"
 #include "rdb_protocol/func.hpp"
 #include "rdb_protocol/error.hpp"
 #include "rdb_protocol/op.hpp"
@@ -41,6 +49,84 @@ durability_requirement_t parse_durability_optarg(counted_t<val_t> arg,
                  str.c_str());
 }
 
+// Writes the batches of an insert from a stream in the background, so that the next
+// batch can be read from the stream while the last ones are being acknowledged.  At
+// most INSERT_MAX_BATCHES_IN_FLIGHT of them are written at once, and their stats are
+// merged in the order the batches came in.
+class insert_pipeline_t {
+public:
+    insert_pipeline_t(env_t *_env, counted_t<table_t> _table, bool _upsert,
+                      durability_requirement_t _durability_requirement)
+        : env(_env), table(_table), upsert(_upsert),
+          durability_requirement(_durability_requirement) { }
+
+    // The writes use `env`, so none of them may outlive the pipeline, even if the
+    // stream or a write threw.
+    ~insert_pipeline_t() {
+        for (auto it = in_flight.begin(); it != in_flight.end(); ++it) {
+            (*it)->done.wait_lazily_unordered();
+        }
+    }
+
+    // Starts writing `datums`, first waiting for the oldest write if there are too
+    // many of them, and merges the stats of the writes that finished into `*stats`.
+    void insert(std::vector<counted_t<const datum_t> > &&datums,
+                counted_t<const datum_t> *stats) {
+        while (in_flight.size() >= INSERT_MAX_BATCHES_IN_FLIGHT) {
+            finish_oldest(stats);
+        }
+        scoped_ptr_t<batch_t> batch(new batch_t(std::move(datums)));
+        coro_t::spawn_sometime(boost::bind(&insert_pipeline_t::write_batch,
+                                           this, batch.get()));
+        in_flight.push_back(std::move(batch));
+    }
+
+    // Waits for all the writes and merges their stats into `*stats`.
+    void finish(counted_t<const datum_t> *stats) {
+        while (!in_flight.empty()) {
+            finish_oldest(stats);
+        }
+    }
+
+private:
+    struct batch_t {
+        explicit batch_t(std::vector<counted_t<const datum_t> > &&_datums)
+            : datums(std::move(_datums)) { }
+        std::vector<counted_t<const datum_t> > datums;
+        counted_t<const datum_t> stats;
+        std::exception_ptr exc;
+        cond_t done;
+    };
+
+    void write_batch(batch_t *batch) {
+        try {
+            batch->stats = table->batched_insert(
+                env, std::move(batch->datums), upsert, durability_requirement, false);
+        } catch (const std::exception &) {
+            batch->exc = std::current_exception();
+        }
+        batch->done.pulse();
+    }
+
+    void finish_oldest(counted_t<const datum_t> *stats) {
+        scoped_ptr_t<batch_t> batch(std::move(in_flight.front()));
+        in_flight.pop_front();
+        batch->done.wait_lazily_unordered();
+        if (batch->exc) {
+            std::rethrow_exception(batch->exc);
+        }
+        *stats = (*stats)->merge(batch->stats, stats_merge);
+    }
+
+    env_t *const env;
+    const counted_t<table_t> table;
+    const bool upsert;
+    const durability_requirement_t durability_requirement;
+    std::deque<scoped_ptr_t<batch_t> > in_flight;
+
+    DISABLE_COPYING(insert_pipeline_t);
+};
+
 class insert_term_t : public op_term_t {
 public:
     insert_term_t(compile_env_t *env, const protob_t<const Term> &term)
@@ -106,6 +192,7 @@ private:
                    "Optarg RETURN_VALS is invalid for multi-row inserts.");
 
             batchspec_t batchspec = batchspec_t::user(batch_type_t::TERMINAL, env->env);
+            insert_pipeline_t pipeline(env->env, t, upsert, durability_requirement);
             for (;;) {
                 std::vector<counted_t<const datum_t> > datums
                     = datum_stream->next_batch(env->env, batchspec);
@@ -122,10 +209,9 @@ private:
                     }
                 }
 
-                counted_t<const datum_t> replace_stats = t->batched_insert(
-                    env->env, std::move(datums), upsert, durability_requirement, false);
-                stats = stats->merge(replace_stats, stats_merge);
+                pipeline.insert(std::move(datums), &stats);
             }
+            pipeline.finish(&stats);
         }
 
         if (generated_keys.size() > 0) {
@@ -202,6 +288,30 @@ private:
             rcheck(!return_vals, base_exc_t::GENERIC,
                    "Optarg RETURN_VALS is invalid for multi-row modifications.");
 
+            // If the shards can find the rows themselves, they replace them
+            // without sending them here and back.
+            key_range_t range;
+            transform_t transform;
+            if (f->is_deterministic() && ds->unread_primary_range(&range, &transform)) {
+                // A delete of a whole range doesn't even have to look at the rows.
+                counted_t<const datum_t> replace_stats
+                    = transform.empty() && func_returns_literal_null(f)
+                    ? tbl->range_delete(env->env, range, durability_requirement)
+                    : tbl->range_replace(
+                        env->env, range, transform, f, durability_requirement);
+                return new_val(stats->merge(replace_stats, stats_merge));
+            }
+            // So does a delete of a range of a secondary index, like one of the
+            // old rows by a time index.
+            std::string sindex;
+            datum_range_t sindex_range;
+            if (func_returns_literal_null(f)
+                && ds->unread_sindex_range(&sindex, &sindex_range)) {
+                counted_t<const datum_t> delete_stats = tbl->sindex_range_delete(
+                    env->env, sindex, sindex_range, durability_requirement);
+                return new_val(stats->merge(delete_stats, stats_merge));
+            }
+
             batchspec_t batchspec = batchspec_t::user(batch_type_t::TERMINAL, env->env);
             for (;;) {
                 std::vector<counted_t<const datum_t> > datums
@@ -0,0 +1,41 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "rdb_protocol/text_index.hpp"
+
+#include <algorithm>
+
+#include "config/args.hpp"
+
+namespace ql {
+
+void tokenize_text(const std::string &text, std::vector<std::string> *terms_out) {
+    std::string term;
+    for (size_t i = 0; i <= text.size(); ++i) {
+        const uint8_t c = i < text.size() ? static_cast<uint8_t>(text[i]) : ' ';
+        if (c >= 0x80 || ('0' <= c && c <= '9') || ('a' <= c && c <= 'z')) {
+            term.push_back(c);
+        } else if ('A' <= c && c <= 'Z') {
+            term.push_back(c - 'A' + 'a');
+        } else if (!term.empty()) {
+            if (term.size() <= TEXT_INDEX_MAX_TERM_SIZE) {
+                terms_out->push_back(term);
+            }
+            term.clear();
+        }
+    }
+}
+
+void count_text_terms(const std::vector<std::string> &terms,
+                      std::map<std::string, uint64_t> *counts_out) {
+    for (auto it = terms.begin(); it != terms.end(); ++it) {
+        ++(*counts_out)[*it];
+    }
+}
+
+bool terms_contain_phrase(const std::vector<std::string> &terms,
+                          const std::vector<std::string> &phrase) {
+    return phrase.empty()
+        || std::search(terms.begin(), terms.end(), phrase.begin(), phrase.end())
+           != terms.end();
+}
+
+}  // namespace ql
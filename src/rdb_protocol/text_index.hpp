@@ -0,0 +1,29 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_TEXT_INDEX_HPP_
+#define RDB_PROTOCOL_TEXT_INDEX_HPP_
+
+#include <stdint.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace ql {
+
+/* Splits `text` into the terms a text index keeps for it, in order.  A term is a run
+of ASCII letters and digits and of non-ASCII bytes, so that the words of UTF-8 text
+stay whole, with the ASCII letters lowercased.  Anything else separates terms.  Runs
+longer than TEXT_INDEX_MAX_TERM_SIZE are left out. */
+void tokenize_text(const std::string &text, std::vector<std::string> *terms_out);
+
+// How many times each of `terms` is in it.
+void count_text_terms(const std::vector<std::string> &terms,
+                      std::map<std::string, uint64_t> *counts_out);
+
+// Whether `phrase` is in `terms`, its terms next to each other and in order.
+bool terms_contain_phrase(const std::vector<std::string> &terms,
+                          const std::vector<std::string> &phrase);
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_TEXT_INDEX_HPP_
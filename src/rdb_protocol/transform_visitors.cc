@@ -3,6 +3,7 @@
 
 #include "rdb_protocol/func.hpp"
 #include "rdb_protocol/lazy_json.hpp"
+#include "rdb_protocol/pathspec.hpp"
 
 typedef rdb_protocol_t::rget_read_response_t rget_read_response_t;
 
@@ -27,6 +28,27 @@ public:
         *res_out = exc_t(exc, func.get_bt().get(), 1);
     }
 
+    void operator()(const top_k_wire_func_t &func) const {
+        *res_out = exc_t(exc, func.get_bt().get(), 1);
+    }
+
+    void operator()(const groupby_wire_func_t &func) const {
+        *res_out = exc_t(exc, func.get_bt().get(), 1);
+    }
+
+    // These have no functions to blame, so the error goes back to the term.
+    void operator()(const count_distinct_wire_func_t &) const {
+        *res_out = exc;
+    }
+
+    void operator()(const quantile_wire_func_t &) const {
+        *res_out = exc;
+    }
+
+    void operator()(const sample_wire_func_t &) const {
+        *res_out = exc;
+    }
+
 private:
     const datum_exc_t exc;
     rget_read_response_t::result_t *res_out;
@@ -59,6 +81,10 @@ public:
         *res_out = exc_t(exc, func.get_bt().get(), 1);
     }
 
+    void operator()(const projection_transform_t &transf) const {
+        *res_out = exc_t(exc, transf.bt.get());
+    }
+
 private:
     const datum_exc_t exc;
     rget_read_response_t::result_t *res_out;
@@ -88,6 +114,7 @@ public:
     void operator()(const ql::map_wire_func_t &func) const;
     void operator()(const filter_transform_t &func) const;
     void operator()(const ql::concatmap_wire_func_t &func) const;
+    void operator()(const projection_transform_t &transf) const;
 
 private:
     counted_t<const ql::datum_t> arg;
@@ -133,6 +160,30 @@ void transform_visitor_t::operator()(const filter_transform_t &transf) const {
     }
 }
 
+// The same as what `pluck` and `without` do to the elements of a sequence (see
+// obj_or_seq_op_term_t), errors and all.
+void transform_visitor_t::operator()(const projection_transform_t &transf) const {
+    if (arg->get_type() == ql::datum_t::R_OBJECT) {
+        ql::pathspec_t pathspec(transf.paths, NULL);
+        switch (transf.type) {
+        case projection_type_t::PLUCK:
+            out->push_back(ql::project(arg, pathspec, ql::DONT_RECURSE));
+            break;
+        case projection_type_t::WITHOUT:
+            out->push_back(ql::unproject(arg, pathspec, ql::DONT_RECURSE));
+            break;
+        default: unreachable();
+        }
+    } else if (arg->get_type() == ql::datum_t::R_ARRAY) {
+        rfail_datum(ql::base_exc_t::GENERIC,
+                    "Cannot perform %s on a sequence of sequences.", transf.name());
+    } else {
+        rfail_datum(ql::exc_type(arg),
+                    "Cannot perform %s on a non-object non-sequence `%s`.",
+                    transf.name(), arg->trunc_print().c_str());
+    }
+}
+
 void transform_apply(ql::env_t *ql_env,
                      counted_t<const ql::datum_t> json,
                      const rdb_protocol_details::transform_variant_t *t,
@@ -150,6 +201,11 @@ public:
     void operator()(const ql::count_wire_func_t &) const;
     void operator()(const ql::gmr_wire_func_t &) const;
     void operator()(const ql::reduce_wire_func_t &) const;
+    void operator()(const ql::top_k_wire_func_t &) const;
+    void operator()(const ql::groupby_wire_func_t &) const;
+    void operator()(const ql::count_distinct_wire_func_t &) const;
+    void operator()(const ql::quantile_wire_func_t &) const;
+    void operator()(const ql::sample_wire_func_t &) const;
 private:
     lazy_json_t json;
     ql::env_t *ql_env;
@@ -200,6 +256,37 @@ void terminal_visitor_t::operator()(const ql::reduce_wire_func_t &func) const {
     }
 }
 
+void terminal_visitor_t::operator()(const ql::top_k_wire_func_t &func) const {
+    ql::top_k_rows_t *rows = boost::get<ql::top_k_rows_t>(out);
+    guarantee(rows);
+    counted_t<const ql::datum_t> row = json.get();
+    rows->add(ql::order_key(ql_env, func.get_funcs(), row), row);
+}
+
+void terminal_visitor_t::operator()(const ql::groupby_wire_func_t &func) const {
+    ql::group_accumulators_t *accumulators = boost::get<ql::group_accumulators_t>(out);
+    guarantee(accumulators);
+    func.add_row(ql_env, json.get(), accumulators);
+}
+
+void terminal_visitor_t::operator()(UNUSED const ql::count_distinct_wire_func_t &func) const {
+    ql::distinct_sketch_t *sketch = boost::get<ql::distinct_sketch_t>(out);
+    guarantee(sketch);
+    sketch->add(*json.get());
+}
+
+void terminal_visitor_t::operator()(UNUSED const ql::quantile_wire_func_t &func) const {
+    ql::quantile_sketch_t *sketch = boost::get<ql::quantile_sketch_t>(out);
+    guarantee(sketch);
+    sketch->add(json.get()->as_num());
+}
+
+void terminal_visitor_t::operator()(UNUSED const ql::sample_wire_func_t &func) const {
+    ql::sample_rows_t *rows = boost::get<ql::sample_rows_t>(out);
+    guarantee(rows);
+    rows->add(json.get());
+}
+
 void terminal_apply(ql::env_t *ql_env,
                     lazy_json_t json,
                     const rdb_protocol_details::terminal_variant_t *t,
@@ -232,6 +319,26 @@ public:
         *out = rget_read_response_t::empty_t();
     }
 
+    void operator()(const ql::top_k_wire_func_t &f) const {
+        *out = ql::top_k_rows_t(f.get_k());
+    }
+
+    void operator()(const ql::groupby_wire_func_t &f) const {
+        *out = ql::group_accumulators_t(f.get_aggregator());
+    }
+
+    void operator()(const ql::count_distinct_wire_func_t &) const {
+        *out = ql::distinct_sketch_t();
+    }
+
+    void operator()(const ql::quantile_wire_func_t &) const {
+        *out = ql::quantile_sketch_t();
+    }
+
+    void operator()(const ql::sample_wire_func_t &f) const {
+        *out = ql::sample_rows_t(f.get_k());
+    }
+
 private:
     rget_read_response_t::result_t *out;
 };
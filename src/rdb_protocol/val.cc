@@ -1,10 +1,13 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "rdb_protocol/val.hpp"
 
+#include <set>
+
 #include "rdb_protocol/env.hpp"
 #include "rdb_protocol/func.hpp"
 #include "rdb_protocol/meta_utils.hpp"
 #include "rdb_protocol/minidriver.hpp"
+#include "rdb_protocol/near_cache.hpp"
 #include "rdb_protocol/term.hpp"
 
 #pragma GCC diagnostic ignored "-Wshadow"
@@ -18,6 +21,7 @@ table_t::table_t(env_t *env,
       db(_db),
       name(_name),
       use_outdated(_use_outdated),
+      near_cache_capacity(0),
       bounds(datum_range_t::universe()),
       sorting(sorting_t::UNORDERED) {
     uuid_u db_id = db->id;
@@ -34,11 +38,11 @@ table_t::table_t(env_t *env,
         ns_searcher(&namespaces_metadata_change.get()->namespaces);
     // TODO: fold into iteration below
     namespace_predicate_t pred(&table_name, &db_id);
-    uuid_u id = meta_get_uuid(&ns_searcher, pred,
-                              strprintf("Table `%s` does not exist.",
-                                        table_name.c_str()), this);
+    table_id = meta_get_uuid(&ns_searcher, pred,
+                             strprintf("Table `%s` does not exist.",
+                                       table_name.c_str()), this);
 
-    access.init(new rdb_namespace_access_t(id, env));
+    access.init(new rdb_namespace_access_t(table_id, env));
 
     metadata_search_status_t status;
     metadata_searcher_t<namespace_semilattice_metadata_t<rdb_protocol_t> >::iterator
@@ -49,6 +53,14 @@ table_t::table_t(env_t *env,
     guarantee(!ns_metadata_it->second.is_deleted());
     r_sanity_check(!ns_metadata_it->second.get_ref().primary_key.in_conflict());
     pkey =  ns_metadata_it->second.get_ref().primary_key.get();
+
+    const vclock_t<int64_t> &near_cache_rows =
+        ns_metadata_it->second.get_ref().near_cache_rows;
+    if (!near_cache_rows.in_conflict() && near_cache_rows.get() > 0) {
+        // Every thread has its own near cache.
+        near_cache_capacity = std::max<int64_t>(
+            near_cache_rows.get() / get_num_threads(), 1);
+    }
 }
 
 counted_t<const datum_t> table_t::make_error_datum(const base_exc_t &exception) {
@@ -77,6 +89,10 @@ counted_t<const datum_t> table_t::do_batched_write(
     rdb_protocol_t::write_response_t response;
     access->get_namespace_if().write(
         &write, &response, order_token_t::ignore, env->interruptor);
+    if (env->near_cache != NULL) {
+        // The rows we wrote may be in the near cache.
+        env->near_cache->forget_table(table_id);
+    }
     auto dp = boost::get<counted_t<const datum_t> >(&response.response);
     r_sanity_check(dp != NULL);
     return *dp;
@@ -109,13 +125,17 @@ counted_t<const datum_t> table_t::batched_replace(
                 r_sanity_check(new_val.has());
                 replacement_values.push_back(new_val);
             } catch (const base_exc_t &e) {
-                stats.add_error(e.what());
+                if (!env->noreply) {
+                    stats.add_error(e.what());
+                }
             }
         }
         counted_t<const datum_t> insert_stats = batched_insert(
             env, std::move(replacement_values), true,
             durability_requirement, return_vals);
-        return stats.to_counted()->merge(insert_stats, stats_merge);
+        return env->noreply
+            ? insert_stats
+            : stats.to_counted()->merge(insert_stats, stats_merge);
     } else {
         std::vector<store_key_t> keys;
         keys.reserve(original_values.size());
@@ -129,11 +149,87 @@ counted_t<const datum_t> table_t::batched_replace(
                 get_pkey(),
                 replacement_generator,
                 env->global_optargs.get_all_optargs(),
-                return_vals),
+                return_vals,
+                return_vals || !env->noreply),
             durability_requirement);
     }
 }
 
+counted_t<const datum_t> table_t::range_replace(
+    env_t *env,
+    const key_range_t &range,
+    const transform_t &transform,
+    counted_t<func_t> replacement_generator,
+    durability_requirement_t durability_requirement) {
+    r_sanity_check(replacement_generator->is_deterministic());
+    // The replicas scan the same batches, so they can't depend on the time.
+    const batchspec_t batchspec = batchspec_t::user(batch_type_t::TERMINAL, env);
+    counted_t<const datum_t> stats = make_counted<const datum_t>(datum_t::R_OBJECT);
+    std::vector<region_t> regions(1, region_t(range));
+    while (!regions.empty()) {
+        rdb_protocol_t::write_t write(
+            rdb_protocol_t::range_replace_t(
+                std::move(regions),
+                get_pkey(),
+                transform,
+                wire_func_t(replacement_generator),
+                env->global_optargs.get_all_optargs(),
+                batchspec),
+            durability_requirement,
+            env->profile());
+        rdb_protocol_t::write_response_t response;
+        access->get_namespace_if().write(
+            &write, &response, order_token_t::ignore, env->interruptor);
+        if (env->near_cache != NULL) {
+            env->near_cache->forget_table(table_id);
+        }
+        rdb_protocol_t::range_replace_response_t *res
+            = boost::get<rdb_protocol_t::range_replace_response_t>(&response.response);
+        r_sanity_check(res != NULL);
+        if (res->error) {
+            throw *res->error;
+        }
+        stats = stats->merge(res->stats, stats_merge);
+        regions = std::move(res->unfinished);
+    }
+    return stats;
+}
+
+counted_t<const datum_t> table_t::range_delete(
+    env_t *env,
+    const key_range_t &range,
+    durability_requirement_t durability_requirement) {
+    if (range.is_empty()) {
+        return make_counted<const datum_t>(datum_t::R_OBJECT);
+    }
+    return do_batched_write(
+        env, rdb_protocol_t::range_delete_t(region_t(range)), durability_requirement);
+}
+
+counted_t<const datum_t> table_t::sindex_range_delete(
+    env_t *env,
+    const std::string &sindex,
+    const datum_range_t &range,
+    durability_requirement_t durability_requirement) {
+    rdb_protocol_t::write_t write(
+        rdb_protocol_t::sindex_range_delete_t(sindex, range, get_pkey()),
+        durability_requirement,
+        env->profile());
+    rdb_protocol_t::write_response_t response;
+    access->get_namespace_if().write(
+        &write, &response, order_token_t::ignore, env->interruptor);
+    if (env->near_cache != NULL) {
+        env->near_cache->forget_table(table_id);
+    }
+    rdb_protocol_t::sindex_range_delete_response_t *res
+        = boost::get<rdb_protocol_t::sindex_range_delete_response_t>(&response.response);
+    r_sanity_check(res != NULL);
+    if (res->error) {
+        rfail(res->error->get_type(), "%s", res->error->what());
+    }
+    return res->stats;
+}
+
 counted_t<const datum_t> table_t::batched_insert(
     env_t *env,
     std::vector<counted_t<const datum_t> > &&insert_datums,
@@ -152,7 +248,10 @@ counted_t<const datum_t> table_t::batched_insert(
             (*it)->get(get_pkey())->print_primary(); // does error checking
             valid_inserts.push_back(std::move(*it));
         } catch (const base_exc_t &e) {
-            stats.add_error(e.what());
+            // Nobody would see the error of a `noreply` insert.
+            if (!env->noreply) {
+                stats.add_error(e.what());
+            }
         }
     }
 
@@ -165,19 +264,26 @@ counted_t<const datum_t> table_t::batched_insert(
     counted_t<const datum_t> insert_stats = do_batched_write(
         env,
         rdb_protocol_t::batched_insert_t(
-            std::move(valid_inserts), get_pkey(), upsert, return_vals),
+            std::move(valid_inserts), get_pkey(), upsert, return_vals,
+            return_vals || !env->noreply),
         durability_requirement);
-    return stats.to_counted()->merge(insert_stats, stats_merge);
+    return env->noreply
+        ? insert_stats
+        : stats.to_counted()->merge(insert_stats, stats_merge);
 }
 
 MUST_USE bool table_t::sindex_create(env_t *env,
                                      const std::string &id,
                                      counted_t<func_t> index_func,
-                                     sindex_multi_bool_t multi) {
+                                     sindex_multi_bool_t multi,
+                                     const std::vector<std::string> &stored_fields,
+                                     sindex_key_format_t key_format) {
     index_func->assert_deterministic("Index functions must be deterministic.");
     map_wire_func_t wire_func(index_func);
     rdb_protocol_t::write_t write(
-            rdb_protocol_t::sindex_create_t(id, wire_func, multi), env->profile());
+            rdb_protocol_t::sindex_create_t(id, wire_func, multi, stored_fields,
+                                            key_format),
+            env->profile());
 
     rdb_protocol_t::write_response_t res;
     access->get_namespace_if().write(
@@ -250,6 +356,9 @@ counted_t<const datum_t> table_t::sindex_status(env_t *env, std::set<std::string
                     make_counted<const datum_t>(
                         safe_to_double(it->second.blocks_total));
             }
+            if (!it->second.ready && it->second.eta_secs >= 0) {
+                status["eta_secs"] = make_counted<const datum_t>(it->second.eta_secs);
+            }
             status["ready"] = make_counted<const datum_t>(datum_t::R_BOOL, it->second.ready);
             std::string index_name = it->first;
             status["index"] = make_counted<const datum_t>(std::move(index_name));
@@ -263,6 +372,76 @@ counted_t<const datum_t> table_t::sindex_status(env_t *env, std::set<std::string
     }
 }
 
+counted_t<datum_stream_t> table_t::changes(env_t *env, const rcheckable_t *parent,
+                                           const protob_t<const Backtrace> &bt) {
+    rcheck_target(parent, base_exc_t::GENERIC,
+                  (!sindex_id || *sindex_id == get_pkey())
+                  && sorting == sorting_t::UNORDERED,
+                  "changes can only be applied to a table or a range of its "
+                  "primary key.");
+    rcheck_target(parent, base_exc_t::GENERIC, env->mailbox_manager != NULL,
+                  "changes are not available here.");
+
+    scoped_ptr_t<changefeed::feed_t> feed(
+        new changefeed::feed_t(env->mailbox_manager));
+    rdb_protocol_t::changefeed_subscribe_t subscribe(
+        feed->get_id(), feed->get_addr(),
+        rdb_protocol_t::region_t(bounds.to_primary_keyrange()));
+    rdb_protocol_t::read_t read(subscribe, env->profile());
+    try {
+        rdb_protocol_t::read_response_t res;
+        access->get_namespace_if().read(
+            read, &res, order_token_t::ignore, env->interruptor);
+        auto s_res =
+            boost::get<rdb_protocol_t::changefeed_subscribe_response_t>(&res.response);
+        r_sanity_check(s_res);
+        feed->add_servers(s_res->servers);
+    } catch (const cannot_perform_query_exc_t &ex) {
+        rfail_target(parent, base_exc_t::GENERIC,
+                     "cannot perform read %s", ex.what());
+    }
+    return make_counted<changefeed_datum_stream_t>(std::move(feed), bt);
+}
+
+std::vector<key_range_t> table_t::shard_ranges(const rcheckable_t *parent) {
+    std::set<key_range_t> ranges;
+    try {
+        std::set<rdb_protocol_t::region_t> scheme
+            = access->get_namespace_if().get_sharding_scheme();
+        for (auto it = scheme.begin(); it != scheme.end(); ++it) {
+            ranges.insert(it->inner);
+        }
+    } catch (const cannot_perform_query_exc_t &ex) {
+        rfail_target(parent, base_exc_t::GENERIC,
+                     "cannot perform read %s", ex.what());
+    }
+    return std::vector<key_range_t>(ranges.begin(), ranges.end());
+}
+
+size_t table_t::shard_count(const rcheckable_t *parent) {
+    return shard_ranges(parent).size();
+}
+
+counted_t<datum_stream_t> table_t::shard(env_t *env, size_t shard,
+                                         const rcheckable_t *parent,
+                                         const protob_t<const Backtrace> &bt) {
+    rcheck_target(parent, base_exc_t::GENERIC,
+                  !sindex_id && bounds.is_universe() && sorting == sorting_t::UNORDERED,
+                  "shard can only be applied to a whole table.");
+    std::vector<key_range_t> ranges = shard_ranges(parent);
+    rcheck_target(parent, base_exc_t::GENERIC, shard < ranges.size(),
+                  strprintf("Shard %zu is out of range (the table has %zu shards).",
+                            shard, ranges.size()));
+    // In order, so that a client that lost the stream can go on from its last
+    // primary key with a `between`.
+    return make_counted<lazy_datum_stream_t>(
+        access.get(),
+        use_outdated,
+        primary_readgen_t::make(env, datum_range_t::universe(), sorting_t::ASCENDING,
+                                ranges[shard]),
+        bt);
+}
+
 MUST_USE bool table_t::sync(env_t *env, const rcheckable_t *parent) {
     rcheck_target(parent, base_exc_t::GENERIC,
                   bounds.is_universe() && sorting == sorting_t::UNORDERED,
@@ -289,9 +468,53 @@ MUST_USE bool table_t::sync_depending_on_durability(env_t *env,
 const std::string &table_t::get_pkey() { return pkey; }
 
 counted_t<const datum_t> table_t::get_row(env_t *env, counted_t<const datum_t> pval) {
-    std::string pks = pval->print_primary();
+    store_key_t key(pval->print_primary());
+    // Profiled reads go to the cluster, so that their profile says what
+    // happened there.
+    const bool use_near_cache = use_outdated && near_cache_capacity != 0
+        && env->near_cache != NULL && env->profile() == profile_bool_t::DONT_PROFILE;
+    counted_t<const datum_t> row;
+    if (!use_near_cache || !env->near_cache->get(table_id, key, &row)) {
+        rdb_protocol_t::read_t read(rdb_protocol_t::point_read_t(key), env->profile());
+        rdb_protocol_t::read_response_t res;
+        if (use_outdated) {
+            access->get_namespace_if().read_outdated(read, &res, env->interruptor);
+        } else {
+            access->get_namespace_if().read(
+                read, &res, order_token_t::ignore, env->interruptor);
+        }
+        rdb_protocol_t::point_read_response_t *p_res =
+            boost::get<rdb_protocol_t::point_read_response_t>(&res.response);
+        r_sanity_check(p_res);
+        row = p_res->data;
+        if (use_near_cache) {
+            env->near_cache->put(table_id, near_cache_capacity, key, row);
+        }
+    }
+    if (env->resources.has()) {
+        env->resources->add_rows(1);
+        if (row.has()) {
+            env->resources->add_datum(row);
+        }
+    }
+    return row;
+}
+
+std::vector<counted_t<const datum_t> > table_t::get_rows(
+        env_t *env, const std::vector<counted_t<const datum_t> > &pvals) {
+    std::vector<counted_t<const datum_t> > rows;
+    if (pvals.empty()) {
+        return rows;
+    }
+
+    std::vector<store_key_t> keys;
+    keys.reserve(pvals.size());
+    for (auto it = pvals.begin(); it != pvals.end(); ++it) {
+        keys.push_back(store_key_t((*it)->print_primary()));
+    }
     rdb_protocol_t::read_t read(
-            rdb_protocol_t::point_read_t(store_key_t(pks)), env->profile());
+            rdb_protocol_t::multi_point_read_t(std::vector<store_key_t>(keys)),
+            env->profile());
     rdb_protocol_t::read_response_t res;
     if (use_outdated) {
         access->get_namespace_if().read_outdated(read, &res, env->interruptor);
@@ -299,10 +522,65 @@ counted_t<const datum_t> table_t::get_row(env_t *env, counted_t<const datum_t> p
         access->get_namespace_if().read(
             read, &res, order_token_t::ignore, env->interruptor);
     }
-    rdb_protocol_t::point_read_response_t *p_res =
-        boost::get<rdb_protocol_t::point_read_response_t>(&res.response);
-    r_sanity_check(p_res);
-    return p_res->data;
+    rdb_protocol_t::multi_point_read_response_t *mp_res =
+        boost::get<rdb_protocol_t::multi_point_read_response_t>(&res.response);
+    r_sanity_check(mp_res);
+    if (env->resources.has()) {
+        env->resources->add_rows(mp_res->rows.size());
+        for (auto it = mp_res->rows.begin(); it != mp_res->rows.end(); ++it) {
+            env->resources->add_datum(it->second);
+        }
+    }
+
+    rows.reserve(keys.size());
+    for (auto it = keys.begin(); it != keys.end(); ++it) {
+        auto row = mp_res->rows.find(*it);
+        rows.push_back(row != mp_res->rows.end()
+                       ? row->second
+                       : make_counted<const datum_t>(datum_t::R_NULL));
+    }
+    return rows;
+}
+
+std::vector<counted_t<const datum_t> > table_t::search(
+        env_t *env, const std::string &sindex_id,
+        const std::vector<std::string> &terms, bool phrase, size_t limit) {
+    rdb_protocol_t::read_t read(
+            rdb_protocol_t::text_search_t(sindex_id, terms, phrase, limit),
+            env->profile());
+    rdb_protocol_t::read_response_t res;
+    try {
+        if (use_outdated) {
+            access->get_namespace_if().read_outdated(read, &res, env->interruptor);
+        } else {
+            access->get_namespace_if().read(
+                read, &res, order_token_t::ignore, env->interruptor);
+        }
+    } catch (const cannot_perform_query_exc_t &ex) {
+        rfail(ql::base_exc_t::GENERIC, "cannot perform read: %s", ex.what());
+    }
+    rdb_protocol_t::text_search_response_t *ts_res =
+        boost::get<rdb_protocol_t::text_search_response_t>(&res.response);
+    r_sanity_check(ts_res);
+    if (auto e = boost::get<datum_exc_t>(&ts_res->result)) {
+        rfail(e->get_type(), "%s", e->what());
+    }
+    auto hits = boost::get<std::vector<rdb_protocol_details::text_search_hit_t> >(
+        &ts_res->result);
+    r_sanity_check(hits);
+
+    std::vector<counted_t<const datum_t> > rows;
+    rows.reserve(hits->size());
+    for (auto it = hits->begin(); it != hits->end(); ++it) {
+        rows.push_back(it->data);
+    }
+    if (env->resources.has()) {
+        env->resources->add_rows(rows.size());
+        for (auto it = rows.begin(); it != rows.end(); ++it) {
+            env->resources->add_datum(*it);
+        }
+    }
+    return rows;
 }
 
 counted_t<datum_stream_t> table_t::get_all(
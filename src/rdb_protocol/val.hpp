@@ -36,6 +36,15 @@ public:
                                               const protob_t<const Backtrace> &bt);
     const std::string &get_pkey();
     counted_t<const datum_t> get_row(env_t *env, counted_t<const datum_t> pval);
+    // The rows of all of `pvals` in the same order, with null for the missing
+    // ones, read with one read per shard.
+    std::vector<counted_t<const datum_t> > get_rows(
+            env_t *env, const std::vector<counted_t<const datum_t> > &pvals);
+    // The `limit` rows whose text in the text index `sindex_id` has the most of
+    // `terms`, all of them (and in order for a `phrase`), best first.
+    std::vector<counted_t<const datum_t> > search(
+            env_t *env, const std::string &sindex_id,
+            const std::vector<std::string> &terms, bool phrase, size_t limit);
     counted_t<datum_stream_t> get_all(
             env_t *env,
             counted_t<const datum_t> value,
@@ -58,6 +67,30 @@ public:
         durability_requirement_t durability_requirement,
         bool return_vals);
 
+    // Replaces the rows of `range` that pass the filters of `transform` with what
+    // the deterministic `replacement_generator` makes of them, on the shards, see
+    // range_replace_t.
+    counted_t<const datum_t> range_replace(
+        env_t *env,
+        const key_range_t &range,
+        const transform_t &transform,
+        counted_t<func_t> replacement_generator,
+        durability_requirement_t durability_requirement);
+
+    // Deletes all the rows of `range` with one write, see range_delete_t.
+    counted_t<const datum_t> range_delete(
+        env_t *env,
+        const key_range_t &range,
+        durability_requirement_t durability_requirement);
+
+    // Deletes the rows whose values for `sindex` are in `range` with one write,
+    // see sindex_range_delete_t.
+    counted_t<const datum_t> sindex_range_delete(
+        env_t *env,
+        const std::string &sindex,
+        const datum_range_t &range,
+        durability_requirement_t durability_requirement);
+
     counted_t<const datum_t> batched_insert(
         env_t *env,
         std::vector<counted_t<const datum_t> > &&insert_datums,
@@ -67,12 +100,27 @@ public:
 
     MUST_USE bool sindex_create(
         env_t *env, const std::string &name,
-        counted_t<func_t> index_func, sindex_multi_bool_t multi);
+        counted_t<func_t> index_func, sindex_multi_bool_t multi,
+        const std::vector<std::string> &stored_fields,
+        sindex_key_format_t key_format);
     MUST_USE bool sindex_drop(env_t *env, const std::string &name);
     counted_t<const datum_t> sindex_list(env_t *env);
     counted_t<const datum_t> sindex_status(env_t *env,
         std::set<std::string> sindex);
     MUST_USE bool sync(env_t *env, const rcheckable_t *parent);
+    // The changes of the rows between the bounds of the table from now on.
+    counted_t<datum_stream_t> changes(env_t *env, const rcheckable_t *parent,
+                                      const protob_t<const Backtrace> &bt);
+    // How many shards the table has, and the rows of the `shard`th of them (in
+    // the order of their ranges of primary keys) in the order of their primary
+    // keys.  The reads of a shard's stream only go to the nodes of that shard, so
+    // a client can export a table by reading all of its shards at once.  The
+    // shards can change in between, which a client can tell by comparing the
+    // counts before and after.
+    size_t shard_count(const rcheckable_t *parent);
+    counted_t<datum_stream_t> shard(env_t *env, size_t shard,
+                                    const rcheckable_t *parent,
+                                    const protob_t<const Backtrace> &bt);
 
     counted_t<const db_t> db;
     const std::string name;
@@ -94,8 +142,15 @@ private:
     MUST_USE bool sync_depending_on_durability(
         env_t *env, durability_requirement_t durability_requirement);
 
+    // The ranges of primary keys of the table's shards, in order.
+    std::vector<key_range_t> shard_ranges(const rcheckable_t *parent);
+
     bool use_outdated;
     std::string pkey;
+    uuid_u table_id;
+    // How many of the table's rows the near cache of this thread may keep, see
+    // near_cache_t.
+    size_t near_cache_capacity;
     scoped_ptr_t<rdb_namespace_access_t> access;
 
     boost::optional<std::string> sindex_id;
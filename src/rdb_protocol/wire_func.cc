@@ -138,6 +138,45 @@ map_wire_func_t map_wire_func_t::make_safely(
 }
 
 
+std::string order_key(env_t *env, const order_funcs_t &funcs,
+                      const counted_t<const datum_t> &row) {
+    std::string key;
+    for (auto it = funcs.begin(); it != funcs.end(); ++it) {
+        counted_t<const datum_t> val;
+        try {
+            val = it->first.compile_wire_func()->call(env, row)->as_datum();
+        } catch (const base_exc_t &e) {
+            if (e.get_type() != base_exc_t::NON_EXISTENCE) {
+                throw;
+            }
+        }
+
+        const size_t start = key.size();
+        if (!val.has()) {
+            key.push_back('\0');
+        } else {
+            key.push_back('\1');
+            append_sort_key(*val, &key);
+        }
+        if (it->second) {
+            for (size_t i = start; i < key.size(); ++i) {
+                key[i] = static_cast<char>(~key[i]);
+            }
+        }
+    }
+    return key;
+}
+
+top_k_wire_func_t::top_k_wire_func_t(const order_funcs_t &_funcs, uint64_t _k)
+    : funcs(_funcs), k(_k) {
+    r_sanity_check(!funcs.empty());
+}
+
+protob_t<const Backtrace> top_k_wire_func_t::get_bt() const {
+    r_sanity_check(!funcs.empty());
+    return funcs.front().first.get_bt();
+}
+
 gmr_wire_func_t::gmr_wire_func_t(counted_t<func_t> _group,
                                  counted_t<func_t> _map,
                                  counted_t<func_t> _reduce)
@@ -153,5 +192,32 @@ counted_t<func_t> gmr_wire_func_t::compile_reduce() const {
     return reduce.compile_wire_func();
 }
 
+groupby_wire_func_t::groupby_wire_func_t(counted_t<func_t> _group,
+                                         group_aggregator_t _aggregator,
+                                         const std::string &_field)
+    : group(_group), aggregator(_aggregator), field(_field) { }
+
+counted_t<func_t> groupby_wire_func_t::compile_group() const {
+    return group.compile_wire_func();
+}
+
+void groupby_wire_func_t::add_row(env_t *env, const counted_t<const datum_t> &row,
+                                  group_accumulators_t *accumulators) const {
+    counted_t<const datum_t> row_group
+        = group.compile_wire_func()->call(env, row)->as_datum();
+    counted_t<const datum_t> row_field;
+    if (aggregator != group_aggregator_t::COUNT) {
+        // Like `has_fields`, which is what a null field counts as missing for.
+        rcheck_datum(row->get_type() == datum_t::R_OBJECT, base_exc_t::GENERIC,
+                     strprintf("Cannot perform has_fields on a non-object "
+                               "non-sequence `%s`.", row->trunc_print().c_str()).c_str());
+        row_field = row->get(field, NOTHROW);
+        if (row_field.has() && row_field->get_type() == datum_t::R_NULL) {
+            row_field.reset();
+        }
+    }
+    accumulators->add(row_group, row_field);
+}
+
 
 }  // namespace ql
@@ -7,7 +7,9 @@
 #include <string>
 #include <vector>
 
+#include "containers/archive/stl_types.hpp"
 #include "containers/uuid.hpp"
+#include "rdb_protocol/aggregation.hpp"
 #include "rdb_protocol/counted_term.hpp"
 #include "rdb_protocol/pb_utils.hpp"
 #include "rdb_protocol/sym.hpp"
@@ -19,6 +21,7 @@ class Datum;
 class Term;
 
 namespace ql {
+class datum_t;
 class func_t;
 class env_t;
 
@@ -77,6 +80,35 @@ public:
 };
 
 
+// The key functions of an unindexed orderby, in order, each with whether it sorts
+// descending.
+typedef std::vector<std::pair<map_wire_func_t, bool> > order_funcs_t;
+
+// Evaluates `funcs` on `row` into a key that sorts the rows the way the orderby
+// does, see append_sort_key().  A row that's missing a value sorts before the ones
+// that have it (after them when descending).
+std::string order_key(env_t *env, const order_funcs_t &funcs,
+                      const counted_t<const datum_t> &row);
+
+// Top-k, the `k` first rows by an orderby, for `orderby(...).limit(k)`, see
+// top_k_rows_t.
+class top_k_wire_func_t {
+public:
+    top_k_wire_func_t() : k(0) { }
+    top_k_wire_func_t(const order_funcs_t &_funcs, uint64_t _k);
+
+    const order_funcs_t &get_funcs() const { return funcs; }
+    uint64_t get_k() const { return k; }
+
+    protob_t<const Backtrace> get_bt() const;
+
+    RDB_MAKE_ME_SERIALIZABLE_2(funcs, k);
+
+private:
+    order_funcs_t funcs;
+    uint64_t k;
+};
+
 // Grouped Map Reduce
 class gmr_wire_func_t {
 public:
@@ -101,6 +133,57 @@ private:
     reduce_wire_func_t reduce;
 };
 
+// Groupby, which aggregates `field` of the rows in every group with one of the
+// native aggregators, see group_accumulators_t.
+class groupby_wire_func_t {
+public:
+    groupby_wire_func_t() : aggregator(group_aggregator_t::COUNT) { }
+    groupby_wire_func_t(counted_t<func_t> _group, group_aggregator_t _aggregator,
+                        const std::string &_field);
+
+    group_aggregator_t get_aggregator() const { return aggregator; }
+    counted_t<func_t> compile_group() const;
+    const std::string &get_field() const { return field; }
+
+    // Adds `row` to the accumulator of its group.
+    void add_row(env_t *env, const counted_t<const datum_t> &row,
+                 group_accumulators_t *accumulators) const;
+
+    protob_t<const Backtrace> get_bt() const { return group.get_bt(); }
+
+    RDB_MAKE_ME_SERIALIZABLE_3(group, aggregator, field);
+
+private:
+    map_wire_func_t group;
+    group_aggregator_t aggregator;
+    // Unused for COUNT.
+    std::string field;
+};
+
+// `approx_count_distinct`, which adds the rows to a distinct_sketch_t.
+class count_distinct_wire_func_t {
+public:
+    RDB_MAKE_ME_SERIALIZABLE_0()
+};
+
+// `approx_quantile`, which adds the rows, numbers, to a quantile_sketch_t.  Which
+// quantiles to estimate from it doesn't matter until all the rows are in.
+class quantile_wire_func_t {
+public:
+    RDB_MAKE_ME_SERIALIZABLE_0()
+};
+
+// `sample`, which keeps a reservoir of `k` of the rows, see sample_rows_t.
+class sample_wire_func_t {
+public:
+    sample_wire_func_t() : k(0) { }
+    explicit sample_wire_func_t(uint64_t _k) : k(_k) { }
+    uint64_t get_k() const { return k; }
+    RDB_MAKE_ME_SERIALIZABLE_1(k);
+private:
+    uint64_t k;
+};
+
 }  // namespace ql
 
 #endif  // RDB_PROTOCOL_WIRE_FUNC_HPP_
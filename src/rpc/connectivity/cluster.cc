@@ -9,13 +9,21 @@
 
 #include "concurrency/cross_thread_signal.hpp"
 #include "concurrency/pmap.hpp"
+#include "compression.hpp"
 #include "concurrency/semaphore.hpp"
 #include "containers/archive/string_stream.hpp"
+#include "containers/archive/varint.hpp"
+#include "containers/archive/write_message_stream.hpp"
 #include "containers/object_buffer.hpp"
 #include "containers/uuid.hpp"
 #include "logger.hpp"
 #include "utils.hpp"
 
+// When a peer's messages may be compressed, each of them starts with one of these.
+static const uint8_t MESSAGE_FORMAT_PLAIN = 0;
+// Followed by the size of the message and its `lz_compress`ed bytes.
+static const uint8_t MESSAGE_FORMAT_LZ = 1;
+
 const std::string connectivity_cluster_t::cluster_proto_header("RethinkDB cluster\n");
 const std::string connectivity_cluster_t::cluster_version(RETHINKDB_CODE_VERSION);
 
@@ -70,10 +78,14 @@ connectivity_cluster_t::run_t::run_t(connectivity_cluster_t *p,
                                      int port,
                                      message_handler_t *mh,
                                      int client_port,
-                                     heartbeat_manager_t *_heartbeat_manager) THROWS_ONLY(address_in_use_exc_t) :
+                                     heartbeat_manager_t *_heartbeat_manager,
+                                     int _connections_per_peer,
+                                     cluster_compression_t _compression) THROWS_ONLY(address_in_use_exc_t) :
     parent(p),
     message_handler(mh),
     heartbeat_manager(_heartbeat_manager),
+    connections_per_peer(_connections_per_peer),
+    compression(_compression),
 
     /* Create the socket to use when listening for connections from peers */
     cluster_listener_socket(new tcp_bound_socket_t(local_addresses, port)),
@@ -104,13 +116,15 @@ connectivity_cluster_t::run_t::run_t(connectivity_cluster_t *p,
     `connection_map` on each thread and notifying any listeners that we're now
     connected to ourself. The destructor will remove us from the
     `connection_map` and again notify any listeners. */
-    connection_to_ourself(this, parent->me, NULL, routing_table[parent->me]),
+    connection_to_ourself(this, parent->me, NULL, routing_table[parent->me], NULL,
+                          cluster_compression_t::none),
 
     listener(new tcp_listener_t(cluster_listener_socket.get(),
                                 boost::bind(&connectivity_cluster_t::run_t::on_new_connection,
                                             this, _1, auto_drainer_t::lock_t(&drainer))))
 {
     parent->assert_thread();
+    guarantee(connections_per_peer >= 1);
 }
 
 connectivity_cluster_t::run_t::~run_t() { }
@@ -138,12 +152,15 @@ void connectivity_cluster_t::run_t::join(const peer_address_t &address) THROWS_N
 connectivity_cluster_t::run_t::connection_entry_t::connection_entry_t(run_t *p,
                                                                       peer_id_t id,
                                                                       tcp_conn_stream_t *c,
-                                                                      const peer_address_t &a) THROWS_NOTHING :
-    conn(c), address(a), session_id(generate_uuid()),
+                                                                      const peer_address_t &a,
+                                                                      bulk_connection_set_t *b,
+                                                                      cluster_compression_t comp) THROWS_NOTHING :
+    conn(c), bulk_connections(b), compression(comp), address(a), session_id(generate_uuid()),
     pm_collection(),
     pm_bytes_sent(secs_to_ticks(1), true),
     pm_collection_membership(&p->parent->connectivity_collection, &pm_collection, uuid_to_str(id.get_uuid())),
     pm_bytes_sent_membership(&pm_collection, &pm_bytes_sent, "bytes_sent"),
+    sender(&pm_collection, "messages_per_write"),
     parent(p), peer(id),
     entries(new one_per_thread_t<entry_installation_t>(this)) {
     if (peer != parent->parent->me && parent->heartbeat_manager != NULL) {
@@ -160,8 +177,119 @@ connectivity_cluster_t::run_t::connection_entry_t::~connection_entry_t() THROWS_
     entries.reset();
 
     /* `~entry_installation_t` destroys the `auto_drainer_t`'s in entries,
-    so nothing can be holding the `send_mutex`. */
-    guarantee(!send_mutex.is_locked());
+    so nothing can be sending. */
+    guarantee(!sender.is_busy());
+}
+
+connectivity_cluster_t::run_t::bulk_connection_t::bulk_connection_t(bulk_connection_set_t *s,
+                                                                    int i,
+                                                                    tcp_conn_stream_t *c) THROWS_NOTHING :
+    conn(c),
+    pm_bytes_sent(secs_to_ticks(1), true),
+    pm_bytes_sent_membership(&s->pm_collection, &pm_bytes_sent,
+                             strprintf("connection_%d_bytes_sent", i).c_str()),
+    sender(&s->pm_collection, strprintf("connection_%d_messages_per_write", i)),
+    set(s), index(i) {
+    rassert(get_thread_id() == set->thread);
+    guarantee(set->conns[index - 1] == NULL);
+    set->conns[index - 1] = this;
+}
+
+connectivity_cluster_t::run_t::bulk_connection_t::~bulk_connection_t() THROWS_NOTHING {
+    rassert(get_thread_id() == set->thread);
+    guarantee(set->conns[index - 1] == this);
+    set->conns[index - 1] = NULL;
+
+    /* Make any senders that are still writing to us give up, so that `drainer`
+    doesn't wait for them forever. */
+    if (conn->is_write_open()) {
+        conn->shutdown_write();
+    }
+}
+
+connectivity_cluster_t::run_t::coalescing_sender_t::coalescing_sender_t(perfmon_collection_t *stats,
+                                                                        const std::string &name) THROWS_NOTHING :
+    pending_size(0),
+    pending_count(0),
+    next_write(0),
+    pm_messages_per_write(secs_to_ticks(1), false),
+    pm_messages_per_write_membership(stats, &pm_messages_per_write, name.c_str()) { }
+
+void connectivity_cluster_t::run_t::coalescing_sender_t::send(tcp_conn_stream_t *conn,
+                                                              write_message_t *msg) THROWS_NOTHING {
+    const uint64_t our_write = next_write;
+    pending_size += msg->size();
+    ++pending_count;
+    pending.append_message(msg);
+
+    mutex_t::acq_t acq(&mutex);
+    if (our_write != next_write) {
+        /* Whoever had the mutex before us wrote our message along with
+        theirs. */
+        rassert(our_write < next_write);
+        return;
+    }
+
+    /* Let the coroutines that run in this pass of the event loop add their
+    messages, unless we have plenty already. */
+    if (pending_size < CLUSTER_COALESCE_MAX_BYTES) {
+        coro_t::yield();
+    }
+
+    write_message_t batch;
+    batch.append_message(&pending);
+    pm_messages_per_write.record(pending_count);
+    pending_size = 0;
+    pending_count = 0;
+    ++next_write;
+
+    int res = send_write_message(conn, &batch);
+    if (res) {
+        /* Close the other half of the connection to make sure that
+           `connectivity_cluster_t::run_t::handle()` notices that something is
+           up */
+        if (conn->is_read_open()) {
+            conn->shutdown_read();
+        }
+    }
+}
+
+connectivity_cluster_t::run_t::bulk_connection_set_t::bulk_connection_set_t(run_t *parent,
+                                                                            peer_id_t peer,
+                                                                            int count,
+                                                                            threadnum_t _thread,
+                                                                            cluster_compression_t _compression) THROWS_NOTHING :
+    thread(_thread),
+    compression(_compression),
+    conns(count, NULL),
+    next_pick(0),
+    primary_conn(NULL),
+    pm_collection(),
+    pm_collection_membership(&parent->parent->connectivity_collection, &pm_collection,
+                             uuid_to_str(peer.get_uuid()) + "_bulk") {
+    guarantee(count > 0);
+}
+
+connectivity_cluster_t::run_t::bulk_connection_t *
+connectivity_cluster_t::run_t::bulk_connection_set_t::pick() THROWS_NOTHING {
+    rassert(get_thread_id() == thread);
+    bulk_connection_t *busy = NULL;
+    for (size_t i = 0; i < conns.size(); ++i) {
+        const size_t slot = (next_pick + i) % conns.size();
+        bulk_connection_t *b = conns[slot];
+        if (b == NULL) {
+            continue;
+        }
+        if (!b->sender.is_busy()) {
+            next_pick = slot + 1;
+            return b;
+        }
+        if (busy == NULL) {
+            busy = b;
+        }
+    }
+    ++next_pick;
+    return busy;
 }
 
 static void ping_connection_watcher(peer_id_t peer, peers_list_callback_t *connect_disconnect_cb) THROWS_NOTHING {
@@ -211,7 +339,7 @@ void connectivity_cluster_t::run_t::on_new_connection(const scoped_ptr_t<tcp_con
     nconn->make_overcomplicated(&conn);
     keepalive_tcp_conn_stream_t conn_stream(conn);
 
-    handle(&conn_stream, boost::none, boost::none, lock, NULL);
+    handle(&conn_stream, boost::none, boost::none, lock, NULL, boost::none, 0);
 }
 
 void connectivity_cluster_t::run_t::connect_to_peer(const peer_address_t *address,
@@ -246,7 +374,8 @@ void connectivity_cluster_t::run_t::connect_to_peer(const peer_address_t *addres
             keepalive_tcp_conn_stream_t conn(selected_addr->ip(), selected_addr->port().value(),
                                              drainer_lock.get_drain_signal(), cluster_client_port);
             if (!*successful_join) {
-                handle(&conn, expected_id, boost::optional<peer_address_t>(*address), drainer_lock, successful_join);
+                handle(&conn, expected_id, boost::optional<peer_address_t>(*address), drainer_lock, successful_join,
+                       boost::optional<ip_and_port_t>(*selected_addr), 0);
             }
         } catch (const tcp_conn_t::connect_failed_exc_t &) {
             /* Ignore */
@@ -315,6 +444,28 @@ private:
     DISABLE_COPYING(cluster_conn_closing_subscription_t);
 };
 
+void connectivity_cluster_t::run_t::connect_bulk(ip_and_port_t address,
+                                                 peer_id_t peer,
+                                                 int index,
+                                                 auto_drainer_t::lock_t bulk_connections_lock,
+                                                 auto_drainer_t::lock_t drainer_lock) THROWS_NOTHING {
+    parent->assert_thread();
+    wait_any_t interruptor(bulk_connections_lock.get_drain_signal(),
+                           drainer_lock.get_drain_signal());
+    try {
+        /* We don't use `cluster_client_port` here; `handle()` doesn't open bulk
+        connections when it's set, because they would all come from the same
+        port as the first one. */
+        keepalive_tcp_conn_stream_t conn(address.ip(), address.port().value(), &interruptor);
+        handle(&conn, boost::optional<peer_id_t>(peer), boost::none, drainer_lock, NULL,
+               boost::none, index);
+    } catch (const tcp_conn_t::connect_failed_exc_t &) {
+        /* Ignore */
+    } catch (const interrupted_exc_t &) {
+        /* Ignore */
+    }
+}
+
 class heartbeat_keepalive_t : public keepalive_tcp_conn_stream_t::keepalive_callback_t,
                               public heartbeat_manager_t::heartbeat_keepalive_tracker_t {
 public:
@@ -509,7 +660,9 @@ void connectivity_cluster_t::run_t::handle(
         boost::optional<peer_id_t> expected_id,
         boost::optional<peer_address_t> expected_address,
         auto_drainer_t::lock_t drainer_lock,
-        bool *successful_join) THROWS_NOTHING
+        bool *successful_join,
+        boost::optional<ip_and_port_t> connected_to,
+        int bulk_index) THROWS_NOTHING
 {
     parent->assert_thread();
 
@@ -525,8 +678,8 @@ void connectivity_cluster_t::run_t::handle(
     cluster_conn_closing_subscription_t conn_closer_1(conn);
     conn_closer_1.reset(drainer_lock.get_drain_signal());
 
-    // Each side sends a header followed by its own ID and address, then receives and checks the
-    // other side's.
+    // Each side sends a header followed by its own ID and address and how it would like
+    // to be connected, then receives and checks the other side's.
     {
         write_message_t msg;
         msg.append(cluster_proto_header.c_str(), cluster_proto_header.length());
@@ -538,6 +691,9 @@ void connectivity_cluster_t::run_t::handle(
         msg.append(cluster_build_mode.data(), cluster_build_mode.length());
         msg << parent->me;
         msg << routing_table[parent->me].hosts();
+        msg << static_cast<int32_t>(connections_per_peer);
+        msg << static_cast<int32_t>(bulk_index);
+        msg << static_cast<int32_t>(compression);
         if (send_write_message(conn, &msg))
             return; // network error.
     }
@@ -612,8 +768,14 @@ void connectivity_cluster_t::run_t::handle(
     // Receive id, host/ports.
     peer_id_t other_id;
     std::set<host_and_port_t> other_peer_addr_hosts;
+    int32_t other_connections_per_peer;
+    int32_t other_bulk_index;
+    int32_t other_compression;
     if (deserialize_and_check(conn, &other_id, peername) ||
-        deserialize_and_check(conn, &other_peer_addr_hosts, peername))
+        deserialize_and_check(conn, &other_peer_addr_hosts, peername) ||
+        deserialize_and_check(conn, &other_connections_per_peer, peername) ||
+        deserialize_and_check(conn, &other_bulk_index, peername) ||
+        deserialize_and_check(conn, &other_compression, peername))
         return;
 
     // Look up the ip addresses for the other host
@@ -628,6 +790,11 @@ void connectivity_cluster_t::run_t::handle(
         logERR("received nil peer id from %s, closing connection", peername);
         return;
     }
+    if (other_compression < static_cast<int32_t>(cluster_compression_t::none) ||
+        other_compression > static_cast<int32_t>(cluster_compression_t::all)) {
+        logERR("received invalid compression setting from %s, closing connection", peername);
+        return;
+    }
     if (expected_id && other_id != *expected_id) {
         // This is only a problem if we're not using a loopback address
         if (!peer_addr.is_loopback()) {
@@ -650,6 +817,33 @@ void connectivity_cluster_t::run_t::handle(
     // Just saying that we're still on the rpc listener thread.
     parent->assert_thread();
 
+    /* A bulk connection belongs to a peer that we're already connected to, so
+    it skips the rest of this. Only the side that opened it says so. */
+    if (bulk_index != 0 || other_bulk_index != 0) {
+        if (bulk_index != 0 && other_bulk_index != 0) {
+            logERR("received a bulk connection header in reply to ours from %s, closing connection", peername);
+            return;
+        }
+        conn_closer_1.reset();
+        handle_bulk(conn, other_id, bulk_index != 0 ? bulk_index : other_bulk_index, peername);
+        return;
+    }
+
+    /* The peer's connections besides this one carry bulk messages, as many as
+    both of us want. They are opened by whichever of us opened this one, unless
+    `cluster_client_port` makes all of our connections come from one port. */
+    const int bulk_count = std::max<int>(0, std::min<int>(connections_per_peer,
+                                                          other_connections_per_peer) - 1);
+
+    /* Either of us can ask for compression, for example because the other one
+    is in another datacenter. */
+    const cluster_compression_t negotiated_compression =
+        std::max(compression, static_cast<cluster_compression_t>(other_compression));
+
+    // We could pick a better way to pick a better thread, our choice
+    // now is hopefully a performance non-problem.
+    threadnum_t chosen_thread = threadnum_t(rng.randint(get_num_threads()));
+
     /* The trickiest case is when there are two or more parallel connections
     that are trying to be established between the same two machines. We can get
     this when e.g. machine A and machine B try to connect to each other at the
@@ -660,6 +854,11 @@ void connectivity_cluster_t::run_t::handle(
     object_buffer_t<map_insertion_sentry_t<peer_id_t, peer_address_t> >
         routing_table_entry_sentry;
 
+    /* Registered alongside `routing_table_entry_sentry`, so that it's there by
+    the time the other side can open a bulk connection. */
+    object_buffer_t<bulk_connection_set_t> bulk_connections;
+    map_insertion_sentry_t<peer_id_t, bulk_connection_set_t *> bulk_connections_entry;
+
     /* We pick one side of the connection to be the "leader" and the other side
     to be the "follower". These roles are only relevant in the initial startup
     process. The leader registers the connection locally. If there's a conflict,
@@ -682,6 +881,11 @@ void connectivity_cluster_t::run_t::handle(
                                                     &routing_table_to_send)) {
             return;
         }
+        if (bulk_count > 0) {
+            bulk_connections.create(this, other_id, bulk_count, chosen_thread,
+                                    negotiated_compression);
+            bulk_connections_entry.reset(&bulk_connection_sets, other_id, bulk_connections.get());
+        }
 
         /* We're good to go! Transmit the routing table to the follower, so it
         knows we're in. */
@@ -710,6 +914,11 @@ void connectivity_cluster_t::run_t::handle(
                                                     &routing_table_to_send)) {
             return;
         }
+        if (bulk_count > 0) {
+            bulk_connections.create(this, other_id, bulk_count, chosen_thread,
+                                    negotiated_compression);
+            bulk_connections_entry.reset(&bulk_connection_sets, other_id, bulk_connections.get());
+        }
 
         /* Send our routing table to the leader */
         {
@@ -748,6 +957,16 @@ void connectivity_cluster_t::run_t::handle(
                     drainer_lock));
             }
         }
+
+        if (bulk_connections.has() && connected_to && cluster_client_port == 0) {
+            for (int i = 1; i <= bulk_count; ++i) {
+                coro_t::spawn_now_dangerously(boost::bind(
+                    &connectivity_cluster_t::run_t::connect_bulk, this,
+                    *connected_to, other_id, i,
+                    auto_drainer_t::lock_t(&bulk_connections->drainer),
+                    drainer_lock));
+            }
+        }
     }
 
     /* Now that we're about to switch threads, it's not safe to try to close
@@ -755,10 +974,6 @@ void connectivity_cluster_t::run_t::handle(
     anything that permanently blocks before setting up `conn_closer_2`. */
     conn_closer_1.reset();
 
-    // We could pick a better way to pick a better thread, our choice
-    // now is hopefully a performance non-problem.
-    threadnum_t chosen_thread = threadnum_t(rng.randint(get_num_threads()));
-
     cross_thread_signal_t connection_thread_drain_signal(drainer_lock.get_drain_signal(), chosen_thread);
 
     rethread_tcp_conn_stream_t unregister_conn(conn, INVALID_THREAD);
@@ -774,50 +989,183 @@ void connectivity_cluster_t::run_t::handle(
         /* `connection_entry_t` is the public interface of this coroutine. Its
         constructor registers it in the `connectivity_cluster_t`'s connection
         map and notifies any connect listeners. */
-        connection_entry_t conn_structure(this, other_id, conn, other_peer_addr);
+        connection_entry_t conn_structure(this, other_id, conn, other_peer_addr,
+                                          bulk_connections.has() ? bulk_connections.get() : NULL,
+                                          negotiated_compression);
         object_buffer_t<heartbeat_keepalive_t> keepalive;
 
         if (heartbeat_manager != NULL) {
             keepalive.create(conn, heartbeat_manager, other_id);
         }
 
-        /* Main message-handling loop: read messages off the connection until
-        it's closed, which may be due to network events, or the other end
-        shutting down, or us shutting down. */
-        try {
-            while (true) {
-                /* For now, we use `std::string` for messages on the wire: it's
-                just a length and a byte vector. This is obviously slow and we
-                should change it when we care about performance. */
-                std::string message;
-                if (deserialize_and_check(conn, &message, peername))
-                    break;
-
-                string_read_stream_t stream(std::move(message), 0);
-                message_handler->on_message(other_id, &stream); // might raise fake_archive_exc_t
-                coro_t::yield();
-            }
-        } catch (const fake_archive_exc_t &) {
-            /* The exception broke us out of the loop, and that's what we
-            wanted. This could either be because we lost contact with the peer
-            or because the cluster is shutting down and `close_conn()` got
-            called. */
+        if (bulk_connections.has()) {
+            bulk_connections->primary_conn = conn;
         }
 
-        guarantee(!conn->is_read_open(), "the connection is still open for "
-            "read, which means we had a problem other than the TCP "
-            "connection closing or dying");
+        receive_messages(conn, other_id, peername, negotiated_compression);
+
+        if (bulk_connections.has()) {
+            bulk_connections->primary_conn = NULL;
+        }
 
         /* The `conn_structure` destructor removes us from the connection map
         and notifies any disconnect listeners. */
     }
 }
 
+void connectivity_cluster_t::run_t::handle_bulk(
+        keepalive_tcp_conn_stream_t *conn,
+        peer_id_t other_id,
+        int index,
+        const char *peername) THROWS_NOTHING {
+    parent->assert_thread();
+
+    std::map<peer_id_t, bulk_connection_set_t *>::iterator it =
+        bulk_connection_sets.find(other_id);
+    if (it == bulk_connection_sets.end()) {
+        /* Our first connection to the peer is already gone, or we don't want
+        bulk connections to it. */
+        return;
+    }
+    bulk_connection_set_t *set = it->second;
+    if (index < 1 || static_cast<size_t>(index) > set->conns.size()) {
+        logERR("received an invalid bulk connection index (%d) from %s, closing connection", index, peername);
+        return;
+    }
+
+    auto_drainer_t::lock_t set_lock(&set->drainer);
+    cross_thread_signal_t connection_thread_drain_signal(set_lock.get_drain_signal(), set->thread);
+
+    rethread_tcp_conn_stream_t unregister_conn(conn, INVALID_THREAD);
+    on_thread_t conn_threader(set->thread);
+    rethread_tcp_conn_stream_t reregister_conn(conn, get_thread_id());
+
+    /* Make sure that when the peer's first connection goes away, any pending
+    read or write on this one gets interrupted. */
+    cluster_conn_closing_subscription_t conn_closer(conn);
+    conn_closer.reset(&connection_thread_drain_signal);
+
+    if (set->conns[index - 1] != NULL) {
+        logERR("received a duplicate bulk connection from %s, closing connection", peername);
+        return;
+    }
+
+    {
+        bulk_connection_t bulk(set, index, conn);
+        receive_messages(conn, other_id, peername, set->compression);
+    }
+
+    /* Messages that were sent on this connection may be lost, and the only way
+    to let the peer's users know is for the peer to disconnect. */
+    if (!connection_thread_drain_signal.is_pulsed() && set->primary_conn != NULL &&
+        set->primary_conn->is_read_open()) {
+        set->primary_conn->shutdown_read();
+    }
+}
+
+void connectivity_cluster_t::run_t::receive_messages(
+        tcp_conn_stream_t *conn,
+        peer_id_t other_id,
+        const char *peername,
+        cluster_compression_t message_compression) THROWS_NOTHING {
+    /* Main message-handling loop: read messages off the connection until
+    it's closed, which may be due to network events, or the other end
+    shutting down, or us shutting down. */
+    try {
+        while (true) {
+            /* For now, we use `std::string` for messages on the wire: it's
+            just a length and a byte vector. This is obviously slow and we
+            should change it when we care about performance. */
+            std::string message;
+            if (deserialize_and_check(conn, &message, peername))
+                break;
+
+            int64_t offset = 0;
+            if (message_compression != cluster_compression_t::none) {
+                if (!unframe_message(&message, &offset)) {
+                    logERR("received a malformed message from %s, closing connection", peername);
+                    if (conn->is_read_open()) {
+                        conn->shutdown_read();
+                    }
+                    break;
+                }
+            }
+
+            string_read_stream_t stream(std::move(message), offset);
+            message_handler->on_message(other_id, &stream); // might raise fake_archive_exc_t
+            coro_t::yield();
+        }
+    } catch (const fake_archive_exc_t &) {
+        /* The exception broke us out of the loop, and that's what we
+        wanted. This could either be because we lost contact with the peer
+        or because the cluster is shutting down and `close_conn()` got
+        called. */
+    }
+
+    guarantee(!conn->is_read_open(), "the connection is still open for "
+        "read, which means we had a problem other than the TCP "
+        "connection closing or dying");
+}
+
+bool connectivity_cluster_t::run_t::unframe_message(std::string *message,
+                                                    int64_t *offset_out) THROWS_NOTHING {
+    if (message->empty()) {
+        return false;
+    }
+    const uint8_t format = (*message)[0];
+    if (format == MESSAGE_FORMAT_PLAIN) {
+        *offset_out = 1;
+        return true;
+    }
+    if (format != MESSAGE_FORMAT_LZ) {
+        return false;
+    }
+
+    uint64_t size;
+    int64_t offset;
+    {
+        string_read_stream_t header(std::move(*message), 1);
+        archive_result_t res = deserialize_varint_uint64(&header, &size);
+        header.swap(message, &offset);
+        if (res != ARCHIVE_SUCCESS) {
+            return false;
+        }
+    }
+    // No count in the compressed data can make more than 255 bytes per byte.
+    const size_t compressed_size = message->size() - offset;
+    if (size / 256 > compressed_size) {
+        return false;
+    }
+
+    const ticks_t start_ticks = get_ticks();
+    std::string plain(size, '\0');
+    if (!lz_decompress(message->data() + offset, compressed_size, &plain[0], size)) {
+        return false;
+    }
+    parent->pm_decompression_secs.record(ticks_to_secs(get_ticks() - start_ticks));
+
+    message->swap(plain);
+    *offset_out = 0;
+    return true;
+}
+
 connectivity_cluster_t::connectivity_cluster_t() THROWS_NOTHING :
     me(peer_id_t(generate_uuid())),
     current_run(NULL),
     connectivity_collection(),
-    stats_membership(&get_global_perfmon_collection(), &connectivity_collection, "connectivity")
+    stats_membership(&get_global_perfmon_collection(), &connectivity_collection, "connectivity"),
+    compression_collection(),
+    pm_compression_ratio(&pm_compression_output_bytes, &pm_compression_input_bytes),
+    pm_compression_secs(secs_to_ticks(1), false),
+    pm_decompression_secs(secs_to_ticks(1), false),
+    compression_collection_membership(&connectivity_collection, &compression_collection, "compression"),
+    compression_stats_membership(&compression_collection,
+                                 &pm_compression_input_bytes, "input_bytes",
+                                 &pm_compression_output_bytes, "output_bytes",
+                                 &pm_compression_ratio, "ratio",
+                                 &pm_compression_secs, "compress_time",
+                                 &pm_decompression_secs, "decompress_time",
+                                 NULLPTR)
     { }
 
 connectivity_cluster_t::~connectivity_cluster_t() THROWS_NOTHING {
@@ -863,15 +1211,17 @@ void connectivity_cluster_t::send_message(peer_id_t dest, send_message_write_cal
 
     guarantee(!dest.is_nil());
 
-    /* We currently write the message to a string_stream_t, then
-       serialize that as a string. It's horribly inefficient, of course. */
-    // TODO: If we don't do it this way, we (or the caller) will need
-    // to worry about having the writer run on the connection thread.
-    string_stream_t buffer;
+    /* The callback writes the message right into the buffers that go to the
+    connection.  On the wire it is framed like a serialized string, so we put
+    its size in front of those buffers instead of copying them into one.  The
+    callback still runs here rather than on the connection thread, because
+    whatever it serializes belongs to our caller's thread. */
+    write_message_stream_t buffer;
     {
         ASSERT_FINITE_CORO_WAITING;
         callback->write(&buffer);
     }
+    write_message_t *body = buffer.message();
 
 #ifdef CLUSTER_MESSAGE_DEBUGGING
     {
@@ -882,7 +1232,12 @@ void connectivity_cluster_t::send_message(peer_id_t dest, send_message_write_cal
         debug_print(&buf, dest);
         buf.appendf("\n");
         fprintf(stderr, "%s", buf.c_str());
-        print_hd(buffer.str()->data(), 0, buffer.str()->size());
+        intrusive_list_t<write_buffer_t> *list = body->unsafe_expose_buffers();
+        size_t offset = 0;
+        for (write_buffer_t *b = list->head(); b != NULL; b = list->next(b)) {
+            print_hd(b->data, offset, b->size);
+            offset += b->size;
+        }
     }
 #endif
 
@@ -912,40 +1267,102 @@ void connectivity_cluster_t::send_message(peer_id_t dest, send_message_write_cal
         conn_structure_lock = it->second.second;
     }
 
-    size_t bytes_sent = buffer.str().size();
+    size_t bytes_sent = body->size();
 
     if (conn_structure->conn == NULL) {
         // We're sending a message to ourself
         guarantee(dest == me);
         // We could be on any thread here! Oh no!
-        string_read_stream_t read_stream(std::move(buffer.str()), 0);
+        std::string str;
+        str.reserve(bytes_sent);
+        intrusive_list_t<write_buffer_t> *list = body->unsafe_expose_buffers();
+        for (write_buffer_t *b = list->head(); b != NULL; b = list->next(b)) {
+            str.append(b->data, b->size);
+        }
+        string_read_stream_t read_stream(std::move(str), 0);
         current_run->message_handler->on_message(me, &read_stream);
     } else {
         guarantee(dest != me);
-        on_thread_t threader(conn_structure->conn->home_thread());
 
-        /* Acquire the send-mutex so we don't collide with other things trying
-        to send on the same connection. */
-        mutex_t::acq_t acq(&conn_structure->send_mutex);
+        /* This is the caller's thread, so compressing here spreads the work
+        over the callers instead of the connection's thread. */
+        const message_class_t message_class = callback->get_message_class();
+        write_message_t msg;
+        frame_message(body, bytes_sent, conn_structure->compression, message_class, &msg);
 
-        {
-            write_message_t msg;
-            msg << buffer.str();
-            int res = send_write_message(conn_structure->conn, &msg);
-            if (res) {
-                /* Close the other half of the connection to make sure that
-                   `connectivity_cluster_t::run_t::handle()` notices that something is
-                   up */
-                if (conn_structure->conn->is_read_open()) {
-                    conn_structure->conn->shutdown_read();
-                }
+        on_thread_t threader(conn_structure->conn->home_thread());
+
+        /* Large bulk messages go on one of the bulk connections, if there are
+        any, so they don't hold up the small ones behind them. */
+        run_t::bulk_connection_t *bulk = NULL;
+        auto_drainer_t::lock_t bulk_lock;
+        if (conn_structure->bulk_connections != NULL &&
+            message_class == message_class_t::bulk &&
+            bytes_sent >= CLUSTER_BULK_MESSAGE_MIN_BYTES) {
+            bulk = conn_structure->bulk_connections->pick();
+            if (bulk != NULL) {
+                bulk_lock = auto_drainer_t::lock_t(&bulk->drainer);
             }
         }
+        tcp_conn_stream_t *conn = bulk != NULL ? bulk->conn : conn_structure->conn;
+
+        run_t::coalescing_sender_t *sender =
+            bulk != NULL ? &bulk->sender : &conn_structure->sender;
+        sender->send(conn, &msg);
+
+        if (bulk != NULL) {
+            bulk->pm_bytes_sent.record(bytes_sent);
+            return;
+        }
     }
 
     conn_structure->pm_bytes_sent.record(bytes_sent);
 }
 
+void connectivity_cluster_t::frame_message(write_message_t *body, size_t body_size,
+                                           cluster_compression_t compression,
+                                           message_class_t message_class,
+                                           write_message_t *out) THROWS_NOTHING {
+    if (compression == cluster_compression_t::none) {
+        serialize_varint_uint64(out, body_size);
+        out->append_message(body);
+        return;
+    }
+
+    if (body_size >= CLUSTER_COMPRESSION_MIN_BYTES &&
+        (compression == cluster_compression_t::all || message_class == message_class_t::bulk)) {
+        const ticks_t start_ticks = get_ticks();
+        scoped_array_t<char> plain(body_size);
+        size_t offset = 0;
+        intrusive_list_t<write_buffer_t> *list = body->unsafe_expose_buffers();
+        for (write_buffer_t *b = list->head(); b != NULL; b = list->next(b)) {
+            memcpy(plain.data() + offset, b->data, b->size);
+            offset += b->size;
+        }
+        rassert(offset == body_size);
+
+        // We only keep the compressed message if it got smaller.
+        scoped_array_t<char> compressed(body_size - 1);
+        const size_t compressed_size = lz_compress(plain.data(), body_size,
+                                                   compressed.data(), compressed.size());
+        pm_compression_secs.record(ticks_to_secs(get_ticks() - start_ticks));
+        pm_compression_input_bytes += body_size;
+        pm_compression_output_bytes += compressed_size != 0 ? compressed_size : body_size;
+
+        if (compressed_size != 0) {
+            serialize_varint_uint64(out, 1 + varint_uint64_serialized_size(body_size) + compressed_size);
+            out->append(&MESSAGE_FORMAT_LZ, 1);
+            serialize_varint_uint64(out, body_size);
+            out->append(compressed.data(), compressed_size);
+            return;
+        }
+    }
+
+    serialize_varint_uint64(out, 1 + body_size);
+    out->append(&MESSAGE_FORMAT_PLAIN, 1);
+    out->append_message(body);
+}
+
 void connectivity_cluster_t::kill_connection(peer_id_t peer) THROWS_NOTHING {
     std::map<peer_id_t, std::pair<run_t::connection_entry_t *, auto_drainer_t::lock_t> > *connection_map =
         &thread_info.get()->connection_map;
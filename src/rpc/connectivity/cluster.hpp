@@ -55,6 +55,11 @@ private:
     std::vector<peer_address_t> vec;
 };
 
+/* Which messages to a peer get compressed: none of them, the bulk-class ones, or
+all of them. Each node asks for one of these, and the messages between two
+nodes get compressed as the one that wants more asked for. */
+enum class cluster_compression_t { none, bulk, all };
+
 class connectivity_cluster_t :
     public connectivity_service_t,
     public message_service_t,
@@ -74,7 +79,9 @@ public:
               int port,
               message_handler_t *message_handler,
               int client_port,
-              heartbeat_manager_t *_heartbeat_manager) THROWS_ONLY(address_in_use_exc_t);
+              heartbeat_manager_t *_heartbeat_manager,
+              int connections_per_peer = 1,
+              cluster_compression_t compression = cluster_compression_t::none) THROWS_ONLY(address_in_use_exc_t);
 
         ~run_t();
 
@@ -89,31 +96,147 @@ public:
     private:
         friend class connectivity_cluster_t;
 
+        class bulk_connection_set_t;
+
+        /* Writes messages to one connection. The messages that queue up while
+        a write is in progress, or during the same pass of the event loop, all
+        go out in the next write. Only used on the connection's thread. */
+        class coalescing_sender_t {
+        public:
+            coalescing_sender_t(perfmon_collection_t *stats,
+                                const std::string &name) THROWS_NOTHING;
+
+            /* Takes the buffers of `msg` and returns once they are written. If
+            the write fails, this shuts down `conn` for reading so that
+            `handle()` notices. */
+            void send(tcp_conn_stream_t *conn, write_message_t *msg) THROWS_NOTHING;
+
+            bool is_busy() { return mutex.is_locked(); }
+
+        private:
+            /* Held by whoever is writing. */
+            mutex_t mutex;
+
+            /* The messages for the next write, and how many bytes and messages
+            they are. */
+            write_message_t pending;
+            size_t pending_size;
+            int pending_count;
+
+            /* Counts the writes so far; the messages in `pending` go out in the
+            write with this number. */
+            uint64_t next_write;
+
+            perfmon_sampler_t pm_messages_per_write;
+            perfmon_membership_t pm_messages_per_write_membership;
+
+            DISABLE_COPYING(coalescing_sender_t);
+        };
+
+        /* One of the extra connections to a peer, which carry its bulk-class
+        messages. It lives in the `handle()` call for its TCP connection, on the
+        thread of the peer's first connection. */
+        class bulk_connection_t {
+        public:
+            /* The constructor puts us in slot `index` of `set`, the destructor
+            takes us out and waits for any senders to finish. */
+            bulk_connection_t(bulk_connection_set_t *set, int index,
+                              tcp_conn_stream_t *conn) THROWS_NOTHING;
+            ~bulk_connection_t() THROWS_NOTHING;
+
+            tcp_conn_stream_t *conn;
+
+            perfmon_sampler_t pm_bytes_sent;
+            perfmon_membership_t pm_bytes_sent_membership;
+
+            coalescing_sender_t sender;
+
+            bulk_connection_set_t *set;
+            int index;
+
+            /* Senders hold a lock on this while they use `conn`. */
+            auto_drainer_t drainer;
+
+        private:
+            DISABLE_COPYING(bulk_connection_t);
+        };
+
+        /* The bulk connections to a peer. It's created on the listener thread
+        by the `handle()` call of the peer's first connection, before that
+        connection is registered, and lives until that call returns. */
+        class bulk_connection_set_t {
+        public:
+            bulk_connection_set_t(run_t *parent, peer_id_t peer, int count,
+                                  threadnum_t thread,
+                                  cluster_compression_t compression) THROWS_NOTHING;
+
+            /* Returns one of the bulk connections, preferring one that nobody
+            is sending on, or NULL if none is connected. Must be called on
+            `thread`. */
+            bulk_connection_t *pick() THROWS_NOTHING;
+
+            /* The thread that the peer's connections live on. */
+            const threadnum_t thread;
+
+            /* What we negotiated on the peer's first connection. */
+            const cluster_compression_t compression;
+
+            /* Slot `i - 1` holds the bulk connection with index `i`, or NULL.
+            Only accessed on `thread`. */
+            std::vector<bulk_connection_t *> conns;
+            size_t next_pick;
+
+            /* The peer's first connection while it's registered, otherwise
+            NULL. A bulk connection that fails closes it, so that the peer
+            sees a disconnection instead of silently losing messages. Only
+            accessed on `thread`. */
+            tcp_conn_stream_t *primary_conn;
+
+            perfmon_collection_t pm_collection;
+            perfmon_membership_t pm_collection_membership;
+
+            /* The bulk connections' `handle()` calls hold locks on this. */
+            auto_drainer_t drainer;
+
+        private:
+            DISABLE_COPYING(bulk_connection_set_t);
+        };
+
         class connection_entry_t : public home_thread_mixin_debug_only_t {
         public:
             /* The constructor registers us in every thread's `connection_map`;
             the destructor deregisters us. Both also notify all subscribers. */
             connection_entry_t(run_t *, peer_id_t, tcp_conn_stream_t *,
-                               const peer_address_t &peer) THROWS_NOTHING;
+                               const peer_address_t &peer,
+                               bulk_connection_set_t *bulk_connections,
+                               cluster_compression_t compression) THROWS_NOTHING;
             ~connection_entry_t() THROWS_NOTHING;
 
             /* NULL for our "connection" to ourself */
             tcp_conn_stream_t *conn;
 
+            /* The extra connections for bulk-class messages. NULL for our
+            connection to ourself. */
+            bulk_connection_set_t *bulk_connections;
+
+            /* Which messages we compress. Unless it's `none`, every message on
+            the peer's connections starts with a format byte. */
+            cluster_compression_t compression;
+
             /* `connection_t` contains the addresses so that we can call
             `get_peers_list()` on any thread. Otherwise, we would have to go
             cross-thread to access the routing table. */
             peer_address_t address;
 
-            /* Unused for our connection to ourself */
-            mutex_t send_mutex;
-
             uuid_u session_id;
 
             perfmon_collection_t pm_collection;
             perfmon_sampler_t pm_bytes_sent;
             perfmon_membership_t pm_collection_membership, pm_bytes_sent_membership;
 
+            /* Unused for our connection to ourself */
+            coalescing_sender_t sender;
+
         private:
             /* We only hold this information so we can deregister ourself */
             run_t *parent;
@@ -175,6 +298,14 @@ public:
                            boost::optional<peer_id_t>,
                            auto_drainer_t::lock_t) THROWS_NOTHING;
 
+        /* `connect_bulk()` is spawned by `handle()` for each bulk connection we
+        open to a peer that we connected to at `address`. */
+        void connect_bulk(ip_and_port_t address,
+                          peer_id_t peer,
+                          int index,
+                          auto_drainer_t::lock_t bulk_connections_lock,
+                          auto_drainer_t::lock_t drainer_lock) THROWS_NOTHING;
+
         // Normal routing table isn't serializable, so we send just the hosts/ports
         bool get_routing_table_to_send_and_add_peer(const peer_id_t &other_peer_id,
                                                     const peer_address_t &other_peer_addr,
@@ -187,12 +318,37 @@ public:
         It handles the handshake, exchanging node maps, sending out the
         connect-notification, receiving messages from the peer until it
         disconnects or we are shut down, and sending out the
-        disconnect-notification. */
+        disconnect-notification. `connected_to` is the address we connected to,
+        if it was us who did; `bulk_index` is nonzero if this is a bulk
+        connection that we opened. */
         void handle(keepalive_tcp_conn_stream_t *c,
             boost::optional<peer_id_t> expected_id,
             boost::optional<peer_address_t> expected_address,
             auto_drainer_t::lock_t,
-            bool *successful_join) THROWS_NOTHING;
+            bool *successful_join,
+            boost::optional<ip_and_port_t> connected_to,
+            int bulk_index) THROWS_NOTHING;
+
+        /* `handle_bulk()` does the part of `handle()` after the handshake for a
+        bulk connection: it attaches the connection to the peer's
+        `bulk_connection_set_t` and receives messages from it. */
+        void handle_bulk(keepalive_tcp_conn_stream_t *c,
+            peer_id_t other_id,
+            int bulk_index,
+            const char *peername) THROWS_NOTHING;
+
+        /* Delivers the messages that arrive on `conn` to `message_handler`,
+        until the connection is closed. With a `compression` other than `none`,
+        the messages start with a format byte. */
+        void receive_messages(tcp_conn_stream_t *c,
+            peer_id_t other_id,
+            const char *peername,
+            cluster_compression_t compression) THROWS_NOTHING;
+
+        /* Strips the format byte from a message that `frame_message()` made,
+        decompressing it if need be. Sets `*offset_out` to where the message
+        starts in `*message`. Returns false if the message is malformed. */
+        bool unframe_message(std::string *message, int64_t *offset_out) THROWS_NOTHING;
 
         connectivity_cluster_t *parent;
 
@@ -200,6 +356,13 @@ public:
 
         heartbeat_manager_t *heartbeat_manager;
 
+        /* How many connections we would like to each peer. We use as many as
+        the lesser of ours and the peer's number. */
+        const int connections_per_peer;
+
+        /* Which messages we would like to be compressed. */
+        const cluster_compression_t compression;
+
         /* `attempt_table` is a table of all the host:port pairs we're currently
         trying to connect to or have connected to. If we are told to connect to
         an address already in this table, we'll just ignore it. That's important
@@ -215,6 +378,10 @@ public:
         `parent->thread_info.get()->connection_map`. */
         std::map<peer_id_t, peer_address_t> routing_table;
 
+        /* The `bulk_connection_set_t` of each peer with more than one
+        connection. Only accessed on the listener thread. */
+        std::map<peer_id_t, bulk_connection_set_t *> bulk_connection_sets;
+
         /* Writes to `routing_table` are protected by this mutex so we never get
         redundant connections to the same peer. */
         mutex_t new_connection_mutex;
@@ -262,6 +429,13 @@ public:
 private:
     friend class run_t;
 
+    /* Puts `body`, of `body_size` bytes, into `out` the way it goes on the wire
+    to a peer with the given `compression`. Takes the buffers of `body`. */
+    void frame_message(write_message_t *body, size_t body_size,
+                       cluster_compression_t compression,
+                       message_class_t message_class,
+                       write_message_t *out) THROWS_NOTHING;
+
     class thread_info_t {
     public:
         /* `connection_map` holds open connections to other peers. It's the same
@@ -296,6 +470,15 @@ private:
     perfmon_collection_t connectivity_collection;
     perfmon_membership_t stats_membership;
 
+    /* How well compressing messages works, and what it costs. The byte counts
+    are of the messages that we tried to compress. */
+    perfmon_collection_t compression_collection;
+    perfmon_counter_t pm_compression_input_bytes, pm_compression_output_bytes;
+    perfmon_counter_ratio_t pm_compression_ratio;
+    perfmon_sampler_t pm_compression_secs, pm_decompression_secs;
+    perfmon_membership_t compression_collection_membership;
+    perfmon_multi_membership_t compression_stats_membership;
+
     DISABLE_COPYING(connectivity_cluster_t);
 };
 
@@ -1,12 +1,57 @@
 #include "rpc/connectivity/heartbeat.hpp"
 
+#include <math.h>
+
 #include "errors.hpp"
 #include <boost/bind.hpp>
 
+#include "config/args.hpp"
 #include "logger.hpp"
 
+phi_accrual_detector_t::phi_accrual_detector_t() :
+    sum_ms(0), sum_sq_ms(0), has_heartbeat(false), last_heartbeat(0) { }
+
+void phi_accrual_detector_t::heartbeat(ticks_t now) {
+    if (has_heartbeat) {
+        const double interval_ms = static_cast<double>(now - last_heartbeat) / MILLION;
+        intervals_ms.push_back(interval_ms);
+        sum_ms += interval_ms;
+        sum_sq_ms += interval_ms * interval_ms;
+        if (intervals_ms.size() > HEARTBEAT_PHI_WINDOW) {
+            sum_ms -= intervals_ms.front();
+            sum_sq_ms -= intervals_ms.front() * intervals_ms.front();
+            intervals_ms.pop_front();
+        }
+    }
+    has_heartbeat = true;
+    last_heartbeat = now;
+}
+
+double phi_accrual_detector_t::phi(ticks_t now) const {
+    if (intervals_ms.empty()) {
+        return 0;
+    }
+    const double n = intervals_ms.size();
+    const double mean_ms = sum_ms / n + HEARTBEAT_PHI_ACCEPTABLE_PAUSE_MS;
+    const double variance = std::max(0.0, sum_sq_ms / n - (sum_ms / n) * (sum_ms / n));
+    const double stddev_ms = std::max(sqrt(variance), static_cast<double>(HEARTBEAT_PHI_MIN_STDDEV_MS));
+    const double elapsed_ms = static_cast<double>(now - last_heartbeat) / MILLION;
+
+    /* A logistic approximation of the normal distribution's tail, which unlike
+    `erfc` keeps its precision far out in the tail. */
+    const double y = (elapsed_ms - mean_ms) / stddev_ms;
+    const double e = exp(-y * (1.5976 + 0.070566 * y * y));
+    if (elapsed_ms > mean_ms) {
+        return -log10(e / (1.0 + e));
+    } else {
+        return -log10(1.0 - 1.0 / (1.0 + e));
+    }
+}
+
 heartbeat_manager_t::heartbeat_manager_t(message_service_t *_message_service) :
-    message_service(_message_service) {
+    message_service(_message_service),
+    phi_perfmon(this),
+    phi_membership(&get_global_perfmon_collection(), &phi_perfmon, "heartbeat_phi") {
     // Do nothing
 }
 
@@ -25,11 +70,39 @@ heartbeat_manager_t::per_thread_data_t::~per_thread_data_t() {
 }
 
 heartbeat_manager_t::per_thread_data_t::conn_data_t::conn_data_t() :
-    outstanding(0),
+    last_read(get_ticks()),
+    last_write(last_read),
     tracker(NULL) {
     // Do nothing
 }
 
+void *heartbeat_manager_t::phi_perfmon_t::begin_stats() {
+    return new std::map<peer_id_t, double>[get_num_threads()];
+}
+
+void heartbeat_manager_t::phi_perfmon_t::visit_stats(void *ctx) {
+    std::map<peer_id_t, double> *phis = static_cast<std::map<peer_id_t, double> *>(ctx);
+    per_thread_data_t *data = parent->thread_data.get();
+    const ticks_t now = get_ticks();
+    for (std::map<peer_id_t, per_thread_data_t::conn_data_t>::iterator it = data->connections.begin();
+         it != data->connections.end(); ++it) {
+        phis[get_thread_id().threadnum][it->first] = it->second.detector.phi(now);
+    }
+}
+
+scoped_ptr_t<perfmon_result_t> heartbeat_manager_t::phi_perfmon_t::end_stats(void *ctx) {
+    std::map<peer_id_t, double> *phis = static_cast<std::map<peer_id_t, double> *>(ctx);
+    scoped_ptr_t<perfmon_result_t> result = perfmon_result_t::alloc_map_result();
+    for (int i = 0; i < get_num_threads(); ++i) {
+        for (std::map<peer_id_t, double>::iterator it = phis[i].begin(); it != phis[i].end(); ++it) {
+            result->insert(uuid_to_str(it->first.get_uuid()),
+                           new perfmon_result_t(strprintf("%f", it->second)));
+        }
+    }
+    delete[] phis;
+    return result;
+}
+
 
 void heartbeat_manager_t::begin_peer_heartbeat(const peer_id_t &peer_id) {
     per_thread_data_t *data = thread_data.get();
@@ -37,7 +110,7 @@ void heartbeat_manager_t::begin_peer_heartbeat(const peer_id_t &peer_id) {
 
     if (data->timer_token == NULL) {
         rassert(data->connections.size() == 1);
-        data->timer_token = add_timer(HEARTBEAT_INTERVAL_MS, this);
+        data->timer_token = add_timer(HEARTBEAT_CHECK_INTERVAL_MS, this);
     }
 }
 
@@ -65,37 +138,45 @@ void heartbeat_manager_t::on_timer() {
     ASSERT_FINITE_CORO_WAITING;
     heartbeat_manager_t *self = this;
     per_thread_data_t *data = self->thread_data.get();
+    const ticks_t now = get_ticks();
     for (std::map<peer_id_t, per_thread_data_t::conn_data_t>::iterator it = data->connections.begin();
          it != data->connections.end(); ++it) {
-        bool read_done = false;
-        bool write_done = false;
+        per_thread_data_t::conn_data_t *conn = &it->second;
+
+        if (conn->tracker != NULL) {
+            if (conn->tracker->check_and_reset_reads()) {
+                conn->detector.heartbeat(now);
+                conn->last_read = now;
+            }
+            if (conn->tracker->check_and_reset_writes()) {
+                conn->last_write = now;
+            }
+        }
 
-        if (it->second.tracker != NULL) {
-            read_done = it->second.tracker->check_and_reset_reads();
-            write_done = it->second.tracker->check_and_reset_writes();
+        bool timed_out;
+        const double phi = conn->detector.phi(now);
+        if (conn->detector.sample_count() >= HEARTBEAT_PHI_MIN_SAMPLES) {
+            timed_out = phi > HEARTBEAT_PHI_THRESHOLD;
+        } else {
+            timed_out = now - conn->last_read >=
+                static_cast<ticks_t>(HEARTBEAT_TIMEOUT_INTERVALS * HEARTBEAT_INTERVAL_MS) * MILLION;
         }
 
-        if (it->second.outstanding >= HEARTBEAT_TIMEOUT_INTERVALS) {
+        if (timed_out) {
             const std::string peer_str(uuid_to_str(it->first.get_uuid()).c_str());
-            logERR("Heartbeat timeout, killing connection to peer: %s.", peer_str.c_str());
+            logERR("Heartbeat timeout (phi %f), killing connection to peer: %s.", phi, peer_str.c_str());
             coro_t::spawn_later_ordered(boost::bind(&heartbeat_manager_t::kill_connection_wrapper,
                                                     self,
                                                     it->first,
                                                     auto_drainer_t::lock_t(&data->drainer)));
-        } else if (!write_done) {
-            // Only send a heartbeat if nothing was sent since the last timer
+        } else if (now - conn->last_write >= static_cast<ticks_t>(HEARTBEAT_INTERVAL_MS) * MILLION) {
+            // Only send a heartbeat if nothing was sent for a whole interval
+            conn->last_write = now;
             coro_t::spawn_later_ordered(boost::bind(&heartbeat_manager_t::send_message_wrapper,
                                                     self,
                                                     it->first,
                                                     auto_drainer_t::lock_t(&data->drainer)));
         }
-
-        if (read_done) {
-            // If we've read data from the socket since the last timer, clear the outstanding acks
-            it->second.outstanding = 0;
-        }
-
-        ++it->second.outstanding;
     }
 }
 
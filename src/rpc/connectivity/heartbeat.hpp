@@ -2,6 +2,7 @@
 #ifndef RPC_CONNECTIVITY_HEARTBEAT_HPP_
 #define RPC_CONNECTIVITY_HEARTBEAT_HPP_
 
+#include <deque>
 #include <map>
 
 #include "arch/timer.hpp"
@@ -9,8 +10,32 @@
 #include "concurrency/one_per_thread.hpp"
 #include "rpc/connectivity/connectivity.hpp"
 #include "rpc/connectivity/messages.hpp"
+#include "perfmon/perfmon.hpp"
 #include "utils.hpp"
 
+/* A `phi_accrual_detector_t` keeps the gaps between the last
+`HEARTBEAT_PHI_WINDOW` heartbeats from a peer and says how suspicious the time
+since the latest one is.  `phi()` is -log10 of the probability that a gap at
+least that long comes from the same distribution as the ones seen so far (taken
+to be normal), so a phi of 8 means a one in 10^8 chance of a live peer being
+that late.  Peers whose heartbeats have been irregular, for example because of
+I/O stalls, get proportionally more time. */
+class phi_accrual_detector_t {
+public:
+    phi_accrual_detector_t();
+
+    void heartbeat(ticks_t now);
+    double phi(ticks_t now) const;
+
+    /* How many gaps the estimate is based on. */
+    size_t sample_count() const { return intervals_ms.size(); }
+
+private:
+    std::deque<double> intervals_ms;
+    double sum_ms, sum_sq_ms;
+    bool has_heartbeat;
+    ticks_t last_heartbeat;
+};
 
 class heartbeat_manager_t : public message_handler_t, private timer_callback_t {
 public:
@@ -34,8 +59,21 @@ public:
 
 private:
     static const int64_t HEARTBEAT_INTERVAL_MS = 2000;
+    /* Until the detector has seen `HEARTBEAT_PHI_MIN_SAMPLES` heartbeats from a
+    peer, it is disconnected after this many intervals without one. */
     static const uint32_t HEARTBEAT_TIMEOUT_INTERVALS = 5;
 
+    /* Reports the phi of every connected peer, keyed by peer id. */
+    class phi_perfmon_t : public perfmon_t {
+    public:
+        explicit phi_perfmon_t(heartbeat_manager_t *_parent) : parent(_parent) { }
+        void *begin_stats();
+        void visit_stats(void *ctx);
+        scoped_ptr_t<perfmon_result_t> end_stats(void *ctx);
+    private:
+        heartbeat_manager_t *parent;
+    };
+
     void on_timer();
 
     // This is a stub, we do everything in message_from_peer instead
@@ -56,7 +94,10 @@ private:
 
         struct conn_data_t {
             conn_data_t();
-            uint32_t outstanding;
+            /* When we last read from or wrote to the peer, or began the
+            heartbeat if we haven't yet. */
+            ticks_t last_read, last_write;
+            phi_accrual_detector_t detector;
             heartbeat_keepalive_tracker_t *tracker;
         };
 
@@ -68,6 +109,9 @@ private:
     message_service_t *message_service;
     one_per_thread_t<per_thread_data_t> thread_data;
 
+    phi_perfmon_t phi_perfmon;
+    perfmon_membership_t phi_membership;
+
     DISABLE_COPYING(heartbeat_manager_t);
 };
 
@@ -46,10 +46,19 @@ no further messages are delivered. This gives a natural way to make sure that no
 messages are still being delivered at the time that the `application_t`
 destructor is called. */
 
+/* A message of the `bulk` class may be sent on a different connection than the
+`control` messages to the same peer, so that a large one doesn't hold up the
+small ones behind it.  Bulk messages can overtake control messages and each
+other, so only messages that don't rely on arriving in order should be bulk. */
+enum class message_class_t { control, bulk };
+
 class send_message_write_callback_t {
 public:
     virtual ~send_message_write_callback_t() { }
     virtual void write(write_stream_t *stream) = 0;
+    virtual message_class_t get_message_class() const {
+        return message_class_t::control;
+    }
 };
 
 class message_service_t  {
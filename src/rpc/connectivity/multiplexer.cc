@@ -52,9 +52,11 @@ message_multiplexer_t::client_t::run_t::~run_t() {
     parent->run = NULL;
 }
 
-message_multiplexer_t::client_t::client_t(message_multiplexer_t *p, tag_t t) :
+message_multiplexer_t::client_t::client_t(message_multiplexer_t *p, tag_t t,
+                                          message_class_t mc) :
     parent(p),
     tag(t),
+    message_class(mc),
     run(NULL),
     outstanding_writes_semaphores(MAX_OUTSTANDING_WRITES_PER_MULTIPLEXER_CLIENT_THREAD)
 {
@@ -75,8 +77,10 @@ connectivity_service_t *message_multiplexer_t::client_t::get_connectivity_servic
 
 class tagged_message_writer_t : public send_message_write_callback_t {
 public:
-    tagged_message_writer_t(message_multiplexer_t::tag_t _tag, send_message_write_callback_t *_subwriter) :
-        tag(_tag), subwriter(_subwriter) { }
+    tagged_message_writer_t(message_multiplexer_t::tag_t _tag,
+                            message_class_t _message_class,
+                            send_message_write_callback_t *_subwriter) :
+        tag(_tag), message_class(_message_class), subwriter(_subwriter) { }
     virtual ~tagged_message_writer_t() { }
 
     void write(write_stream_t *os) {
@@ -87,13 +91,18 @@ public:
         subwriter->write(os);
     }
 
+    message_class_t get_message_class() const {
+        return message_class;
+    }
+
 private:
     message_multiplexer_t::tag_t tag;
+    message_class_t message_class;
     send_message_write_callback_t *subwriter;
 };
 
 void message_multiplexer_t::client_t::send_message(peer_id_t dest, send_message_write_callback_t *callback) {
-    tagged_message_writer_t writer(tag, callback);
+    tagged_message_writer_t writer(tag, message_class, callback);
     {
         semaphore_acq_t outstanding_write_acq (outstanding_writes_semaphores.get());
         parent->message_service->send_message(dest, &writer);
@@ -53,7 +53,10 @@ public:
             client_t *const parent;
             message_handler_t *const message_handler;
         };
-        client_t(message_multiplexer_t *, tag_t tag);
+        /* The messages of a client with the `bulk` class may be reordered, see
+        `message_class_t`. */
+        client_t(message_multiplexer_t *, tag_t tag,
+                 message_class_t message_class = message_class_t::control);
         ~client_t();
         connectivity_service_t *get_connectivity_service();
         void send_message(peer_id_t, send_message_write_callback_t *callback);
@@ -62,6 +65,7 @@ public:
         friend class message_multiplexer_t;
         message_multiplexer_t *const parent;
         const tag_t tag;
+        const message_class_t message_class;
         run_t *run;
         one_per_thread_t<static_semaphore_t> outstanding_writes_semaphores;
     };
@@ -0,0 +1,37 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "rpc/directory/delta.hpp"
+
+#include <algorithm>
+
+directory_delta_t::directory_delta_t() : prefix(0), suffix(0) { }
+
+directory_delta_t::directory_delta_t(const std::string &old_value,
+                                     const std::string &new_value) {
+    const size_t limit = std::min(old_value.size(), new_value.size());
+    size_t p = 0;
+    while (p < limit && old_value[p] == new_value[p]) {
+        ++p;
+    }
+    size_t s = 0;
+    while (s < limit - p
+           && old_value[old_value.size() - 1 - s] == new_value[new_value.size() - 1 - s]) {
+        ++s;
+    }
+    prefix = p;
+    suffix = s;
+    middle = new_value.substr(p, new_value.size() - p - s);
+}
+
+bool directory_delta_t::apply(std::string *value) const {
+    if (prefix > value->size() || suffix > value->size() - prefix) {
+        return false;
+    }
+    value->replace(prefix, value->size() - prefix - suffix, middle);
+    return true;
+}
+
+size_t directory_delta_t::size() const {
+    return sizeof(prefix) + sizeof(suffix) + middle.size();
+}
+
+RDB_IMPL_ME_SERIALIZABLE_3(directory_delta_t, prefix, suffix, middle);
@@ -0,0 +1,54 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#ifndef RPC_DIRECTORY_DELTA_HPP_
+#define RPC_DIRECTORY_DELTA_HPP_
+
+#include <string>
+
+#include "containers/archive/archive.hpp"
+#include "containers/archive/stl_types.hpp"
+#include "containers/archive/string_stream.hpp"
+#include "rpc/serialize_macros.hpp"
+
+/* The directory managers send a peer's metadata as the difference between its
+serialized form and the serialized form they sent before. The new value is the
+old one with everything from `prefix` bytes in up to `suffix` bytes from the end
+replaced by `middle`. A delta against the empty string carries the whole value. */
+class directory_delta_t {
+public:
+    directory_delta_t();
+    directory_delta_t(const std::string &old_value, const std::string &new_value);
+
+    /* Turns `value` into the new value. Returns false if `value` is too short
+    to be the old value. */
+    MUST_USE bool apply(std::string *value) const;
+
+    /* About how many bytes this takes on the wire */
+    size_t size() const;
+
+private:
+    uint64_t prefix;
+    uint64_t suffix;
+    std::string middle;
+
+    RDB_DECLARE_ME_SERIALIZABLE;
+};
+
+template <class metadata_t>
+std::string serialize_directory_value(const metadata_t &value) {
+    write_message_t msg;
+    msg << value;
+    string_stream_t stream;
+    int res = send_write_message(&stream, &msg);
+    guarantee(res == 0);
+    return stream.str();
+}
+
+template <class metadata_t>
+archive_result_t deserialize_directory_value(const std::string &serialized,
+                                             metadata_t *value_out) {
+    std::string copy = serialized;
+    string_read_stream_t stream(std::move(copy), 0);
+    return deserialize(&stream, value_out);
+}
+
+#endif /* RPC_DIRECTORY_DELTA_HPP_ */
@@ -43,10 +43,13 @@ void directory_read_manager_t<metadata_t>::on_message(peer_id_t source_peer, str
     switch (code) {
         case 'I': {
             /* Initial message from another peer */
+            std::string serialized_value;
             metadata_t initial_value = metadata_t();
             fifo_enforcer_state_t metadata_fifo_state;
             {
-                archive_result_t res = deserialize(s, &initial_value);
+                archive_result_t res = deserialize(s, &serialized_value);
+                guarantee_deserialization(res, "serialized metadata");
+                res = deserialize_directory_value(serialized_value, &initial_value);
                 guarantee_deserialization(res, "metadata");
                 res = deserialize(s, &metadata_fifo_state);
                 guarantee_deserialization(res, "metadata fifo state");
@@ -58,19 +61,21 @@ void directory_read_manager_t<metadata_t>::on_message(peer_id_t source_peer, str
             coro_t::spawn_sometime(boost::bind(
                 &directory_read_manager_t::propagate_initialization, this,
                 source_peer, connectivity_service->get_connection_session_id(source_peer),
-                initial_value, metadata_fifo_state,
+                initial_value, serialized_value, metadata_fifo_state,
                 auto_drainer_t::lock_t(per_thread_drainers.get())));
 
             break;
         }
 
         case 'U': {
-            /* Update from another peer */
-            metadata_t new_value = metadata_t();
+            /* Update from another peer. We can only apply it to the peer's
+            value once the updates before it are applied, so
+            `propagate_update()` deserializes the new value. */
+            directory_delta_t delta;
             fifo_enforcer_write_token_t metadata_fifo_token;
             {
-                archive_result_t res = deserialize(s, &new_value);
-                guarantee_deserialization(res, "metadata");
+                archive_result_t res = deserialize(s, &delta);
+                guarantee_deserialization(res, "metadata delta");
                 res = deserialize(s, &metadata_fifo_token);
                 guarantee_deserialization(res, "metadata fifo state");
 
@@ -82,7 +87,7 @@ void directory_read_manager_t<metadata_t>::on_message(peer_id_t source_peer, str
             coro_t::spawn_sometime(boost::bind(
                 &directory_read_manager_t::propagate_update, this,
                 source_peer, connectivity_service->get_connection_session_id(source_peer),
-                new_value, metadata_fifo_token,
+                delta, metadata_fifo_token,
                 auto_drainer_t::lock_t(per_thread_drainers.get())));
 
             break;
@@ -124,7 +129,7 @@ void directory_read_manager_t<metadata_t>::on_disconnect(peer_id_t peer) THROWS_
 }
 
 template<class metadata_t>
-void directory_read_manager_t<metadata_t>::propagate_initialization(peer_id_t peer, uuid_u session_id, metadata_t initial_value, fifo_enforcer_state_t metadata_fifo_state, auto_drainer_t::lock_t per_thread_keepalive) THROWS_NOTHING {
+void directory_read_manager_t<metadata_t>::propagate_initialization(peer_id_t peer, uuid_u session_id, metadata_t initial_value, std::string serialized_value, fifo_enforcer_state_t metadata_fifo_state, auto_drainer_t::lock_t per_thread_keepalive) THROWS_NOTHING {
     per_thread_keepalive.assert_is_holding(per_thread_drainers.get());
     on_thread_t thread_switcher(home_thread());
 
@@ -161,11 +166,12 @@ void directory_read_manager_t<metadata_t>::propagate_initialization(peer_id_t pe
     // that it'll be initialized only once.
     session->metadata_fifo_sink.reset();
     session->metadata_fifo_sink.init(new fifo_enforcer_sink_t(metadata_fifo_state));
+    session->serialized_value.swap(serialized_value);
     session->got_initial_message.pulse();
 }
 
 template<class metadata_t>
-void directory_read_manager_t<metadata_t>::propagate_update(peer_id_t peer, uuid_u session_id, metadata_t new_value, fifo_enforcer_write_token_t metadata_fifo_token, auto_drainer_t::lock_t per_thread_keepalive) THROWS_NOTHING {
+void directory_read_manager_t<metadata_t>::propagate_update(peer_id_t peer, uuid_u session_id, directory_delta_t delta, fifo_enforcer_write_token_t metadata_fifo_token, auto_drainer_t::lock_t per_thread_keepalive) THROWS_NOTHING {
     per_thread_keepalive.assert_is_holding(per_thread_drainers.get());
     on_thread_t thread_switcher(home_thread());
 
@@ -200,6 +206,16 @@ void directory_read_manager_t<metadata_t>::propagate_update(peer_id_t peer, uuid
                                                      metadata_fifo_token);
         wait_interruptible(&fifo_exit, session_keepalive.get_drain_signal());
 
+        // TODO Don't fail catastrophically just because there's bad data on the stream.
+        guarantee(delta.apply(&session->serialized_value),
+                  "Directory update doesn't fit the peer's previous value");
+        metadata_t new_value = metadata_t();
+        {
+            archive_result_t res = deserialize_directory_value(session->serialized_value,
+                                                               &new_value);
+            guarantee_deserialization(res, "metadata");
+        }
+
         {
             DEBUG_VAR mutex_assertion_t::acq_t acq(&variable_lock);
             std::map<peer_id_t, metadata_t> map = variable.get_watchable()->get();
@@ -2,10 +2,13 @@
 #ifndef RPC_DIRECTORY_WRITE_MANAGER_HPP_
 #define RPC_DIRECTORY_WRITE_MANAGER_HPP_
 
+#include <string>
+
 #include "concurrency/auto_drainer.hpp"
 #include "concurrency/fifo_enforcer.hpp"
 #include "concurrency/watchable.hpp"
 #include "rpc/connectivity/connectivity.hpp"
+#include "rpc/directory/delta.hpp"
 
 class message_service_t;
 
@@ -22,14 +25,21 @@ private:
     void on_disconnect(UNUSED peer_id_t p) { }
     void on_change() THROWS_NOTHING;
 
-    void send_initialization(peer_id_t peer, const metadata_t &initial_value, fifo_enforcer_state_t metadata_fifo_state, auto_drainer_t::lock_t keepalive) THROWS_NOTHING;
-    void send_update(peer_id_t peer, const metadata_t &new_value, fifo_enforcer_write_token_t metadata_fifo_token, auto_drainer_t::lock_t keepalive) THROWS_NOTHING;
+    void send_initialization(peer_id_t peer, const std::string &initial_value, fifo_enforcer_state_t metadata_fifo_state, auto_drainer_t::lock_t keepalive) THROWS_NOTHING;
+    void send_update(peer_id_t peer, const directory_delta_t &delta, fifo_enforcer_write_token_t metadata_fifo_token, auto_drainer_t::lock_t keepalive) THROWS_NOTHING;
 
     class initialization_writer_t;
     class update_writer_t;
 
     message_service_t *const message_service;
     clone_ptr_t<watchable_t<metadata_t> > value_watchable;
+
+    /* The value we sent last, serialized; updates are sent as the difference
+    from it. Every `DIRECTORY_FULL_UPDATE_INTERVAL` changes we send the whole
+    thing anyway. */
+    std::string serialized_value;
+    int changes_since_full_update;
+
     fifo_enforcer_source_t metadata_fifo_source;
     auto_drainer_t drainer;
     typename watchable_t<metadata_t>::subscription_t value_subscription;
@@ -7,6 +7,7 @@
 #include <set>
 
 #include "arch/runtime/coroutines.hpp"
+#include "config/args.hpp"
 #include "rpc/connectivity/messages.hpp"
 
 template<class metadata_t>
@@ -15,11 +16,13 @@ directory_write_manager_t<metadata_t>::directory_write_manager_t(
         const clone_ptr_t<watchable_t<metadata_t> > &value) THROWS_NOTHING :
     message_service(sub),
     value_watchable(value),
+    changes_since_full_update(0),
     value_subscription(boost::bind(&directory_write_manager_t::on_change, this)),
     connectivity_subscription(this) {
     typename watchable_t<metadata_t>::freeze_t value_freeze(value_watchable);
     connectivity_service_t::peers_list_freeze_t connectivity_freeze(message_service->get_connectivity_service());
     guarantee(message_service->get_connectivity_service()->get_peers_list().empty());
+    serialized_value = serialize_directory_value(value_watchable->get());
     value_subscription.reset(value_watchable, &value_freeze);
     connectivity_subscription.reset(message_service->get_connectivity_service(), &connectivity_freeze);
 }
@@ -33,7 +36,7 @@ void directory_write_manager_t<metadata_t>::on_connect(peer_id_t peer) THROWS_NO
     coro_t::spawn_sometime(boost::bind(
         &directory_write_manager_t::send_initialization, this,
         peer,
-        value_watchable->get(), metadata_fifo_source.get_state(),
+        serialized_value, metadata_fifo_source.get_state(),
         auto_drainer_t::lock_t(&drainer)));
 }
 
@@ -44,13 +47,26 @@ void directory_write_manager_t<metadata_t>::on_change() THROWS_NOTHING {
     crash on the receiving end because the receiving FIFO would get a duplicate
     update.) */
     connectivity_service_t::peers_list_freeze_t freeze(message_service->get_connectivity_service());
+
+    std::string new_value = serialize_directory_value(value_watchable->get());
+    directory_delta_t delta(serialized_value, new_value);
+    ++changes_since_full_update;
+    if (changes_since_full_update >= DIRECTORY_FULL_UPDATE_INTERVAL
+        || delta.size() >= new_value.size()) {
+        /* A delta against nothing replaces the peer's whole copy, in case it
+        somehow got out of sync with ours. */
+        delta = directory_delta_t(std::string(), new_value);
+        changes_since_full_update = 0;
+    }
+    serialized_value.swap(new_value);
+
     fifo_enforcer_write_token_t metadata_fifo_token = metadata_fifo_source.enter_write();
     std::set<peer_id_t> peers = message_service->get_connectivity_service()->get_peers_list();
     for (std::set<peer_id_t>::iterator it = peers.begin(); it != peers.end(); it++) {
         coro_t::spawn_sometime(boost::bind(
             &directory_write_manager_t::send_update, this,
             *it,
-            value_watchable->get(), metadata_fifo_token,
+            delta, metadata_fifo_token,
             auto_drainer_t::lock_t(&drainer)));
     }
 }
@@ -58,7 +74,7 @@ void directory_write_manager_t<metadata_t>::on_change() THROWS_NOTHING {
 template <class metadata_t>
 class directory_write_manager_t<metadata_t>::initialization_writer_t : public send_message_write_callback_t {
 public:
-    initialization_writer_t(const metadata_t &_initial_value, fifo_enforcer_state_t _metadata_fifo_state) :
+    initialization_writer_t(const std::string &_initial_value, fifo_enforcer_state_t _metadata_fifo_state) :
         initial_value(_initial_value), metadata_fifo_state(_metadata_fifo_state) { }
     ~initialization_writer_t() { }
 
@@ -74,22 +90,22 @@ public:
         }
     }
 private:
-    const metadata_t &initial_value;
+    const std::string &initial_value;
     fifo_enforcer_state_t metadata_fifo_state;
 };
 
 template <class metadata_t>
 class directory_write_manager_t<metadata_t>::update_writer_t : public send_message_write_callback_t {
 public:
-    update_writer_t(const metadata_t &_new_value, fifo_enforcer_write_token_t _metadata_fifo_token) :
-        new_value(_new_value), metadata_fifo_token(_metadata_fifo_token) { }
+    update_writer_t(const directory_delta_t &_delta, fifo_enforcer_write_token_t _metadata_fifo_token) :
+        delta(_delta), metadata_fifo_token(_metadata_fifo_token) { }
     ~update_writer_t() { }
 
     void write(write_stream_t *stream) {
         write_message_t msg;
         uint8_t code = 'U';
         msg << code;
-        msg << new_value;
+        msg << delta;
         msg << metadata_fifo_token;
         int res = send_write_message(stream, &msg);
         if (res) {
@@ -97,19 +113,19 @@ public:
         }
     }
 private:
-    const metadata_t &new_value;
+    const directory_delta_t &delta;
     fifo_enforcer_write_token_t metadata_fifo_token;
 };
 
 template<class metadata_t>
-void directory_write_manager_t<metadata_t>::send_initialization(peer_id_t peer, const metadata_t &initial_value, fifo_enforcer_state_t metadata_fifo_state, auto_drainer_t::lock_t) THROWS_NOTHING {
+void directory_write_manager_t<metadata_t>::send_initialization(peer_id_t peer, const std::string &initial_value, fifo_enforcer_state_t metadata_fifo_state, auto_drainer_t::lock_t) THROWS_NOTHING {
     initialization_writer_t writer(initial_value, metadata_fifo_state);
     message_service->send_message(peer, &writer);
 }
 
 template<class metadata_t>
-void directory_write_manager_t<metadata_t>::send_update(peer_id_t peer, const metadata_t &new_value, fifo_enforcer_write_token_t metadata_fifo_token, auto_drainer_t::lock_t) THROWS_NOTHING {
-    update_writer_t writer(new_value, metadata_fifo_token);
+void directory_write_manager_t<metadata_t>::send_update(peer_id_t peer, const directory_delta_t &delta, fifo_enforcer_write_token_t metadata_fifo_token, auto_drainer_t::lock_t) THROWS_NOTHING {
+    update_writer_t writer(delta, metadata_fifo_token);
     message_service->send_message(peer, &writer);
 }
 
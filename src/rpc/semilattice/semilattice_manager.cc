@@ -1,6 +1,16 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "rpc/semilattice/semilattice_manager.tcc"
 
+semilattice_digest_t::semilattice_digest_t(const std::string &serialized) :
+    size(serialized.size()) {
+    /* 64-bit FNV-1a */
+    hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < serialized.size(); ++i) {
+        hash ^= static_cast<uint8_t>(serialized[i]);
+        hash *= 1099511628211ULL;
+    }
+}
+
 #include "clustering/administration/metadata.hpp"
 template class semilattice_manager_t<cluster_semilattice_metadata_t>;
 template class semilattice_manager_t<auth_semilattice_metadata_t>;
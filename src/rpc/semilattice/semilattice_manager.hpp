@@ -3,14 +3,38 @@
 #define RPC_SEMILATTICE_SEMILATTICE_MANAGER_HPP_
 
 #include <map>
+#include <string>
 #include <utility>
 
 #include "rpc/mailbox/mailbox.hpp"
 #include "rpc/semilattice/view.hpp"
+#include "rpc/serialize_macros.hpp"
 
 class cond_t;
 template <class> class promise_t;
 
+/* Identifies a serialized metadata value. When two nodes connect they send
+each other the digest of their metadata first, and only send the whole value if
+the digests differ. */
+class semilattice_digest_t {
+public:
+    semilattice_digest_t() : size(0), hash(0) { }
+    explicit semilattice_digest_t(const std::string &serialized);
+
+    bool operator==(const semilattice_digest_t &other) const {
+        return size == other.size && hash == other.hash;
+    }
+    bool operator!=(const semilattice_digest_t &other) const {
+        return !(*this == other);
+    }
+
+private:
+    uint64_t size;
+    uint64_t hash;
+
+    RDB_MAKE_ME_SERIALIZABLE_2(size, hash);
+};
+
 /* `semilattice_manager_t` runs on top of a `message_service_t` and synchronizes
 a value, called the "global semilattice metadata", between all of the nodes in
 the cluster. `semilattice_manager_t` is templatized on the type of the global
@@ -57,6 +81,8 @@ private:
     };
 
     class metadata_writer_t;
+    class digest_writer_t;
+    class metadata_request_writer_t;
     class sync_from_query_writer_t;
     class sync_from_reply_writer_t;
     class sync_to_query_writer_t;
@@ -70,14 +96,20 @@ private:
 
     /* These are spawned in new coroutines. */
     void send_metadata_to_peer(peer_id_t, metadata_t, metadata_version_t, auto_drainer_t::lock_t);
+    void send_digest_to_peer(peer_id_t, semilattice_digest_t, metadata_version_t, auto_drainer_t::lock_t);
     void deliver_metadata_on_home_thread(peer_id_t sender, metadata_t, metadata_version_t, auto_drainer_t::lock_t);
+    void deliver_digest_on_home_thread(peer_id_t sender, semilattice_digest_t, metadata_version_t, auto_drainer_t::lock_t);
+    void deliver_metadata_request_on_home_thread(peer_id_t sender, auto_drainer_t::lock_t);
     void deliver_sync_from_query_on_home_thread(peer_id_t sender, sync_from_query_id_t query_id, auto_drainer_t::lock_t);
     void deliver_sync_from_reply_on_home_thread(peer_id_t sender, sync_from_query_id_t query_id, metadata_version_t version, auto_drainer_t::lock_t);
     void deliver_sync_to_query_on_home_thread(peer_id_t sender, sync_to_query_id_t query_id, metadata_version_t version, auto_drainer_t::lock_t);
     void deliver_sync_to_reply_on_home_thread(peer_id_t sender, sync_to_query_id_t query_id, auto_drainer_t::lock_t);
 
     static void call_function_with_no_args(const boost::function<void()> &);
-    void join_metadata_locally(metadata_t);
+    /* Returns false, and doesn't tell anyone, if `metadata` already had
+    everything in the argument. */
+    bool join_metadata_locally(metadata_t);
+    void note_version_from_peer(peer_id_t peer, metadata_version_t version);
     void wait_for_version_from_peer(peer_id_t peer, metadata_version_t version, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t, sync_failed_exc_t);
 
     message_service_t *const message_service;
@@ -85,6 +117,8 @@ private:
 
     metadata_version_t metadata_version;
     metadata_t metadata;
+    /* The digest of `metadata`, kept up to date by `join_metadata_locally()` */
+    semilattice_digest_t metadata_digest;
     publisher_controller_t<boost::function<void()> > metadata_publisher;
     rwi_lock_assertion_t metadata_mutex;
 
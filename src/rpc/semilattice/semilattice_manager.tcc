@@ -11,17 +11,29 @@
 #include <boost/make_shared.hpp>
 
 #include "concurrency/cross_thread_signal.hpp"
+#include "containers/archive/string_stream.hpp"
 #include "concurrency/pmap.hpp"
 #include "concurrency/promise.hpp"
 #include "concurrency/wait_any.hpp"
 #include "logger.hpp"
 
+template <class metadata_t>
+semilattice_digest_t digest_metadata(const metadata_t &metadata) {
+    write_message_t msg;
+    msg << metadata;
+    string_stream_t stream;
+    int res = send_write_message(&stream, &msg);
+    guarantee(res == 0);
+    return semilattice_digest_t(stream.str());
+}
+
 template<class metadata_t>
 semilattice_manager_t<metadata_t>::semilattice_manager_t(message_service_t *ms, const metadata_t &initial_metadata) :
     message_service(ms),
     root_view(boost::make_shared<root_view_t>(this)),
     metadata_version(0),
     metadata(initial_metadata),
+    metadata_digest(digest_metadata(initial_metadata)),
     next_sync_from_query_id(0), next_sync_to_query_id(0),
     event_watcher(this) {
     ASSERT_FINITE_CORO_WAITING;
@@ -60,8 +72,13 @@ void semilattice_manager_t<metadata_t>::root_view_t::join(const metadata_t &adde
     guarantee(parent, "accessing `semilattice_manager_t` root view when cluster no longer exists");
     parent->assert_thread();
 
+    if (!parent->join_metadata_locally(added_metadata)) {
+        /* We already had all of it, so whoever gave it to us has told our
+        peers already, or will tell them when they connect. Not bumping the
+        version keeps `sync_to()` from waiting for a message we don't send. */
+        return;
+    }
     metadata_version_t new_version = ++parent->metadata_version;
-    parent->join_metadata_locally(added_metadata);
 
     /* Distribute changes to all peers we can currently see. If we can't
     currently see a peer, that's OK; it will hear about the metadata change when
@@ -83,6 +100,8 @@ static const char message_code_sync_from_query = 'F';
 static const char message_code_sync_from_reply = 'f';
 static const char message_code_sync_to_query = 'T';
 static const char message_code_sync_to_reply = 't';
+static const char message_code_digest = 'D';
+static const char message_code_metadata_request = 'R';
 
 template <class metadata_t>
 class semilattice_manager_t<metadata_t>::metadata_writer_t : public send_message_write_callback_t {
@@ -104,6 +123,40 @@ private:
     metadata_version_t mdv;
 };
 
+template <class metadata_t>
+class semilattice_manager_t<metadata_t>::digest_writer_t : public send_message_write_callback_t {
+public:
+    digest_writer_t(const semilattice_digest_t &_digest, metadata_version_t _mdv) :
+        digest(_digest), mdv(_mdv) { }
+
+    void write(write_stream_t *stream) {
+        write_message_t msg;
+        uint8_t code = message_code_digest;
+        msg << code;
+        msg << digest;
+        msg << mdv;
+        int res = send_write_message(stream, &msg);
+        if (res) { throw fake_archive_exc_t(); }
+    }
+private:
+    semilattice_digest_t digest;
+    metadata_version_t mdv;
+};
+
+template <class metadata_t>
+class semilattice_manager_t<metadata_t>::metadata_request_writer_t : public send_message_write_callback_t {
+public:
+    metadata_request_writer_t() { }
+
+    void write(write_stream_t *stream) {
+        write_message_t msg;
+        uint8_t code = message_code_metadata_request;
+        msg << code;
+        int res = send_write_message(stream, &msg);
+        if (res) { throw fake_archive_exc_t(); }
+    }
+};
+
 template <class metadata_t>
 class semilattice_manager_t<metadata_t>::sync_from_query_writer_t : public send_message_write_callback_t {
 public:
@@ -246,6 +299,26 @@ void semilattice_manager_t<metadata_t>::on_message(peer_id_t sender, string_read
                 sender, added_metadata, change_version, auto_drainer_t::lock_t(drainers.get())));
             break;
         }
+        case message_code_digest: {
+            semilattice_digest_t digest;
+            metadata_version_t version;
+            {
+                int res = deserialize(stream, &digest);
+                if (res) { throw fake_archive_exc_t(); }
+                res = deserialize(stream, &version);
+                if (res) { throw fake_archive_exc_t(); }
+            }
+            coro_t::spawn_sometime(boost::bind(
+                &semilattice_manager_t<metadata_t>::deliver_digest_on_home_thread, this,
+                sender, digest, version, auto_drainer_t::lock_t(drainers.get())));
+            break;
+        }
+        case message_code_metadata_request: {
+            coro_t::spawn_sometime(boost::bind(
+                &semilattice_manager_t<metadata_t>::deliver_metadata_request_on_home_thread, this,
+                sender, auto_drainer_t::lock_t(drainers.get())));
+            break;
+        }
         case message_code_sync_from_query: {
             sync_from_query_id_t query_id;
             {
@@ -310,10 +383,11 @@ void semilattice_manager_t<metadata_t>::on_connect(peer_id_t peer) {
     assert_thread();
 
     /* We have to spawn this in a separate coroutine because `on_connect()` is
-    not supposed to block. */
+    not supposed to block. The peer asks for the whole metadata if it doesn't
+    already have the same. */
     coro_t::spawn_sometime(boost::bind(
-        &semilattice_manager_t<metadata_t>::send_metadata_to_peer, this,
-        peer, metadata, metadata_version, auto_drainer_t::lock_t(drainers.get())));
+        &semilattice_manager_t<metadata_t>::send_digest_to_peer, this,
+        peer, metadata_digest, metadata_version, auto_drainer_t::lock_t(drainers.get())));
 }
 
 template<class metadata_t>
@@ -329,10 +403,42 @@ void semilattice_manager_t<metadata_t>::send_metadata_to_peer(peer_id_t peer, me
     message_service->send_message(peer, &writer);
 }
 
+template<class metadata_t>
+void semilattice_manager_t<metadata_t>::send_digest_to_peer(peer_id_t peer, semilattice_digest_t digest, metadata_version_t mv, auto_drainer_t::lock_t) {
+    digest_writer_t writer(digest, mv);
+    message_service->send_message(peer, &writer);
+}
+
 template<class metadata_t>
 void semilattice_manager_t<metadata_t>::deliver_metadata_on_home_thread(peer_id_t sender, metadata_t md, metadata_version_t mv, auto_drainer_t::lock_t) {
     on_thread_t thread_switcher(home_thread());
     join_metadata_locally(md);
+    note_version_from_peer(sender, mv);
+}
+
+template<class metadata_t>
+void semilattice_manager_t<metadata_t>::deliver_digest_on_home_thread(peer_id_t sender, semilattice_digest_t digest, metadata_version_t mv, auto_drainer_t::lock_t) {
+    on_thread_t thread_switcher(home_thread());
+    if (digest == metadata_digest) {
+        /* Joining the sender's metadata would change nothing, so we already
+        have version `mv` of it. */
+        note_version_from_peer(sender, mv);
+    } else {
+        metadata_request_writer_t writer;
+        message_service->send_message(sender, &writer);
+    }
+}
+
+template<class metadata_t>
+void semilattice_manager_t<metadata_t>::deliver_metadata_request_on_home_thread(peer_id_t sender, auto_drainer_t::lock_t) {
+    on_thread_t thread_switcher(home_thread());
+    metadata_writer_t writer(metadata, metadata_version);
+    message_service->send_message(sender, &writer);
+}
+
+template<class metadata_t>
+void semilattice_manager_t<metadata_t>::note_version_from_peer(peer_id_t sender, metadata_version_t mv) {
+    assert_thread();
     DEBUG_VAR mutex_assertion_t::acq_t acq(&peer_version_mutex);
     std::pair<typename std::map<peer_id_t, metadata_version_t>::iterator, bool> inserted =
         last_versions_seen.insert(std::make_pair(sender, mv));
@@ -401,11 +507,17 @@ void semilattice_manager_t<metadata_t>::call_function_with_no_args(const boost::
 }
 
 template<class metadata_t>
-void semilattice_manager_t<metadata_t>::join_metadata_locally(metadata_t added_metadata) {
+bool semilattice_manager_t<metadata_t>::join_metadata_locally(metadata_t added_metadata) {
     assert_thread();
     DEBUG_VAR rwi_lock_assertion_t::write_acq_t acq(&metadata_mutex);
     semilattice_join(&metadata, added_metadata);
+    semilattice_digest_t new_digest = digest_metadata(metadata);
+    if (new_digest == metadata_digest) {
+        return false;
+    }
+    metadata_digest = new_digest;
     metadata_publisher.publish(&semilattice_manager_t<metadata_t>::call_function_with_no_args);
+    return true;
 }
 
 template<class metadata_t>
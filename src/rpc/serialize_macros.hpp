@@ -24,7 +24,13 @@ invoke it at global scope after the class declaration, or use
 RDB_MAKE_ME_SERIALIZABLE_*() instead. In order to force the compiler to catch
 this error, we declare a dummy "extern int" in RDB_MAKE_ME_SERIALIZABLE_*().
 This is a noop at the global scope, but produces a (somewhat weird) error in
-the class scope. */
+the class scope.
+
+RDB_MAKE_ME_SERIALIZABLE_RAW_*(field1, ...) is for classes whose fields are all
+raw-serializable (see `archive_raw_t`) and have no padding between them, such as
+timestamps and versions. It writes the same bytes as RDB_MAKE_ME_SERIALIZABLE_*(),
+but with a single copy, and makes vectors of the class be copied as one block
+too. */
 
 #define RDB_DECLARE_SERIALIZABLE(type_t) \
     write_message_t &operator<<(write_message_t &, const type_t &); \
@@ -2346,4 +2352,72 @@ the class scope. */
         return res; \
     }
 
+#define RDB_MAKE_ME_SERIALIZABLE_RAW_1(field1) \
+    template <class, class> friend struct archive_raw_t; \
+    template <class, class> friend struct serialized_size_t; \
+    static const size_t rdb_archive_raw_size = sizeof(field1); \
+    friend class write_message_t; \
+    void rdb_serialize(write_message_t &msg /* NOLINT */) const { \
+        static_assert(archive_raw_t<decltype(field1)>::value, \
+                      "every field must be raw-serializable"); \
+        static_assert(rdb_archive_raw_size == sizeof(*this), \
+                      "there must be no padding between the fields"); \
+        serialize_raw_array(&msg, this, 1); \
+    } \
+    friend class archive_deserializer_t; \
+    archive_result_t rdb_deserialize(read_stream_t *s) { \
+        return deserialize_raw_array(s, this, 1); \
+    }
+
+#define RDB_MAKE_ME_SERIALIZABLE_RAW_2(field1, field2) \
+    template <class, class> friend struct archive_raw_t; \
+    template <class, class> friend struct serialized_size_t; \
+    static const size_t rdb_archive_raw_size = sizeof(field1) + sizeof(field2); \
+    friend class write_message_t; \
+    void rdb_serialize(write_message_t &msg /* NOLINT */) const { \
+        static_assert(archive_raw_t<decltype(field1)>::value && archive_raw_t<decltype(field2)>::value, \
+                      "every field must be raw-serializable"); \
+        static_assert(rdb_archive_raw_size == sizeof(*this), \
+                      "there must be no padding between the fields"); \
+        serialize_raw_array(&msg, this, 1); \
+    } \
+    friend class archive_deserializer_t; \
+    archive_result_t rdb_deserialize(read_stream_t *s) { \
+        return deserialize_raw_array(s, this, 1); \
+    }
+
+#define RDB_MAKE_ME_SERIALIZABLE_RAW_3(field1, field2, field3) \
+    template <class, class> friend struct archive_raw_t; \
+    template <class, class> friend struct serialized_size_t; \
+    static const size_t rdb_archive_raw_size = sizeof(field1) + sizeof(field2) + sizeof(field3); \
+    friend class write_message_t; \
+    void rdb_serialize(write_message_t &msg /* NOLINT */) const { \
+        static_assert(archive_raw_t<decltype(field1)>::value && archive_raw_t<decltype(field2)>::value && archive_raw_t<decltype(field3)>::value, \
+                      "every field must be raw-serializable"); \
+        static_assert(rdb_archive_raw_size == sizeof(*this), \
+                      "there must be no padding between the fields"); \
+        serialize_raw_array(&msg, this, 1); \
+    } \
+    friend class archive_deserializer_t; \
+    archive_result_t rdb_deserialize(read_stream_t *s) { \
+        return deserialize_raw_array(s, this, 1); \
+    }
+
+#define RDB_MAKE_ME_SERIALIZABLE_RAW_4(field1, field2, field3, field4) \
+    template <class, class> friend struct archive_raw_t; \
+    template <class, class> friend struct serialized_size_t; \
+    static const size_t rdb_archive_raw_size = sizeof(field1) + sizeof(field2) + sizeof(field3) + sizeof(field4); \
+    friend class write_message_t; \
+    void rdb_serialize(write_message_t &msg /* NOLINT */) const { \
+        static_assert(archive_raw_t<decltype(field1)>::value && archive_raw_t<decltype(field2)>::value && archive_raw_t<decltype(field3)>::value && archive_raw_t<decltype(field4)>::value, \
+                      "every field must be raw-serializable"); \
+        static_assert(rdb_archive_raw_size == sizeof(*this), \
+                      "there must be no padding between the fields"); \
+        serialize_raw_array(&msg, this, 1); \
+    } \
+    friend class archive_deserializer_t; \
+    archive_result_t rdb_deserialize(read_stream_t *s) { \
+        return deserialize_raw_array(s, this, 1); \
+    }
+
 #endif // RPC_SERIALIZE_MACROS_HPP_
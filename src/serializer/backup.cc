@@ -0,0 +1,300 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#define __STDC_FORMAT_MACROS
+#include "serializer/backup.hpp"
+
+#include <inttypes.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "arch/runtime/coroutines.hpp"
+#include "concurrency/cond_var.hpp"
+#include "concurrency/signal.hpp"
+#include "config/args.hpp"
+#include "containers/archive/archive.hpp"
+#include "containers/scoped.hpp"
+#include "crc32c.hpp"
+#include "serializer/serializer.hpp"
+
+const char physical_backup_header_t::expected_magic[16] = "rethinkdb_pbk_1";
+
+namespace {
+
+struct pinned_block_t {
+    pinned_block_t(block_id_t _block_id, repli_timestamp_t _recency,
+                   const counted_t<standard_block_token_t> &_token)
+        : block_id(_block_id), recency(_recency), token(_token) { }
+
+    block_id_t block_id;
+    repli_timestamp_t recency;
+    // Empty for a deleted block.
+    counted_t<standard_block_token_t> token;
+};
+
+// Holds the tokens of the blocks we back up, along with our i/o account.  Both of
+// them have to be destroyed on the serializer's thread.
+class backup_snapshot_t {
+public:
+    explicit backup_snapshot_t(serializer_t *_ser) : ser(_ser) { }
+
+    ~backup_snapshot_t() {
+        on_thread_t thread(ser->home_thread());
+        blocks.clear();
+        io_account.reset();
+    }
+
+    serializer_t *const ser;
+    std::vector<pinned_block_t> blocks;
+    scoped_ptr_t<file_account_t> io_account;
+
+private:
+    DISABLE_COPYING(backup_snapshot_t);
+};
+
+void take_snapshot(repli_timestamp_t since, backup_snapshot_t *snapshot) {
+    serializer_t *ser = snapshot->ser;
+    on_thread_t thread(ser->home_thread());
+    snapshot->io_account.init(ser->make_io_account(PHYSICAL_BACKUP_IO_PRIORITY,
+                                                   UNLIMITED_OUTSTANDING_REQUESTS,
+                                                   io_class_t::background,
+                                                   io_activity_t::backup));
+
+    // Nothing in here may block, so that no index write can come in between.
+    ASSERT_NO_CORO_WAITING;
+    const block_id_t end = ser->max_block_id();
+    for (block_id_t id = 0; id < end; ++id) {
+        counted_t<standard_block_token_t> token = ser->index_read(id);
+        if (!token.has()) {
+            if (since != repli_timestamp_t::distant_past) {
+                snapshot->blocks.push_back(pinned_block_t(id, repli_timestamp_t::invalid,
+                                                          token));
+            }
+            continue;
+        }
+        const repli_timestamp_t recency = ser->get_recency(id);
+        if (since == repli_timestamp_t::distant_past || recency > since) {
+            snapshot->blocks.push_back(pinned_block_t(id, recency, token));
+        }
+    }
+}
+
+// Reads the blocks [begin, end) of the snapshot into `bufs_out`, with an empty buffer
+// for each deleted block, and drops their tokens.
+void read_snapshot_blocks(backup_snapshot_t *snapshot, size_t begin, size_t end,
+                          std::vector<scoped_ser_buffer_t > *bufs_out) {
+    serializer_t *ser = snapshot->ser;
+    on_thread_t thread(ser->home_thread());
+
+    std::vector<counted_t<standard_block_token_t> > tokens;
+    std::vector<ser_buffer_t *> ser_bufs;
+    bufs_out->resize(end - begin);
+    for (size_t i = begin; i < end; ++i) {
+        pinned_block_t *block = &snapshot->blocks[i];
+        if (block->token.has()) {
+            (*bufs_out)[i - begin] = ser->malloc();
+            tokens.push_back(block->token);
+            ser_bufs.push_back((*bufs_out)[i - begin].get());
+        }
+    }
+    ser->block_reads(tokens, ser_bufs, snapshot->io_account.get());
+
+    tokens.clear();
+    for (size_t i = begin; i < end; ++i) {
+        snapshot->blocks[i].token.reset();
+    }
+}
+
+MUST_USE bool read_exactly(read_stream_t *stream, void *p, int64_t n) {
+    return force_read(stream, p, n) == n;
+}
+
+struct restore_write_t {
+    restore_write_t(block_id_t _block_id, repli_timestamp_t _recency,
+                    scoped_ser_buffer_t &&_buf)
+        : block_id(_block_id), recency(_recency), buf(std::move(_buf)) { }
+    restore_write_t(restore_write_t &&other)
+        : block_id(other.block_id), recency(other.recency), buf(std::move(other.buf)) { }
+
+    block_id_t block_id;
+    repli_timestamp_t recency;
+    // Empty for a deleted block.
+    scoped_ser_buffer_t buf;
+};
+
+void write_restored_blocks(serializer_t *ser, file_account_t *io_account,
+                           const std::vector<restore_write_t> &writes) {
+    ser->assert_thread();
+    if (writes.empty()) {
+        return;
+    }
+
+    std::vector<buf_write_info_t> write_infos;
+    for (auto it = writes.begin(); it != writes.end(); ++it) {
+        if (it->buf.has()) {
+            write_infos.push_back(buf_write_info_t(it->buf.get(), ser->get_block_size(),
+                                                   it->block_id));
+        }
+    }
+
+    struct : public iocallback_t, public cond_t {
+        void on_io_complete() { pulse(); }
+    } block_write_cond;
+    std::vector<counted_t<standard_block_token_t> > tokens;
+    if (!write_infos.empty()) {
+        tokens = ser->block_writes(write_infos, io_account, &block_write_cond);
+    } else {
+        block_write_cond.pulse();
+    }
+
+    std::vector<index_write_op_t> index_write_ops;
+    size_t tokens_index = 0;
+    for (auto it = writes.begin(); it != writes.end(); ++it) {
+        if (it->buf.has()) {
+            index_write_ops.push_back(index_write_op_t(it->block_id, tokens[tokens_index],
+                                                       it->recency));
+            ++tokens_index;
+        } else {
+            index_write_ops.push_back(index_write_op_t(it->block_id,
+                                                       counted_t<standard_block_token_t>(),
+                                                       repli_timestamp_t::invalid));
+        }
+    }
+    guarantee(tokens_index == tokens.size());
+
+    block_write_cond.wait();
+    ser->index_write(index_write_ops, io_account);
+}
+
+}  // namespace
+
+bool physical_backup(serializer_t *ser, repli_timestamp_t since,
+                     write_stream_t *stream, signal_t *interruptor)
+    THROWS_ONLY(interrupted_exc_t) {
+    {
+        physical_backup_header_t header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, physical_backup_header_t::expected_magic, sizeof(header.magic));
+        header.ser_block_size = ser->get_block_size().ser_value();
+        header.since = since.longtime;
+        write_message_t msg;
+        msg.append(&header, sizeof(header));
+        if (send_write_message(stream, &msg) != 0) {
+            return false;
+        }
+    }
+
+    backup_snapshot_t snapshot(ser);
+    take_snapshot(since, &snapshot);
+
+    const uint32_t block_size = ser->get_block_size().value();
+    for (size_t begin = 0; begin < snapshot.blocks.size();
+         begin += PHYSICAL_BACKUP_BATCH_BLOCKS) {
+        if (interruptor->is_pulsed()) {
+            throw interrupted_exc_t();
+        }
+
+        const size_t end = std::min<size_t>(begin + PHYSICAL_BACKUP_BATCH_BLOCKS,
+                                            snapshot.blocks.size());
+        std::vector<scoped_ser_buffer_t > bufs;
+        read_snapshot_blocks(&snapshot, begin, end, &bufs);
+
+        write_message_t msg;
+        for (size_t i = begin; i < end; ++i) {
+            const scoped_ser_buffer_t &buf = bufs[i - begin];
+            physical_backup_record_t record;
+            record.block_id = snapshot.blocks[i].block_id;
+            record.recency = snapshot.blocks[i].recency.longtime;
+            record.size = buf.has() ? block_size : 0;
+            record.checksum = buf.has() ? crc32c(buf->cache_data, block_size) : 0;
+            msg.append(&record, sizeof(record));
+            if (buf.has()) {
+                msg.append(buf->cache_data, block_size);
+            }
+        }
+        if (send_write_message(stream, &msg) != 0) {
+            return false;
+        }
+    }
+
+    physical_backup_record_t trailer;
+    trailer.block_id = NULL_BLOCK_ID;
+    trailer.recency = snapshot.blocks.size();
+    trailer.size = 0;
+    trailer.checksum = 0;
+    write_message_t msg;
+    msg.append(&trailer, sizeof(trailer));
+    return send_write_message(stream, &msg) == 0;
+}
+
+bool physical_restore(serializer_t *ser, read_stream_t *stream, std::string *error_out) {
+    ser->assert_thread();
+
+    physical_backup_header_t header;
+    if (!read_exactly(stream, &header, sizeof(header))
+        || memcmp(header.magic, physical_backup_header_t::expected_magic,
+                  sizeof(header.magic)) != 0) {
+        *error_out = "The stream is not a physical backup.";
+        return false;
+    }
+    if (header.ser_block_size != ser->get_block_size().ser_value()) {
+        *error_out = strprintf("The backup has a block size of %" PRIu32 " bytes, "
+                               "but the serializer has a block size of %" PRIu32 " bytes.",
+                               header.ser_block_size, ser->get_block_size().ser_value());
+        return false;
+    }
+
+    scoped_ptr_t<file_account_t> io_account(ser->make_io_account(PHYSICAL_BACKUP_IO_PRIORITY,
+                                                                 io_activity_t::backup));
+    const uint32_t block_size = ser->get_block_size().value();
+    std::vector<restore_write_t> writes;
+    uint64_t num_records = 0;
+    for (;;) {
+        physical_backup_record_t record;
+        if (!read_exactly(stream, &record, sizeof(record))) {
+            *error_out = "The backup is truncated.";
+            break;
+        }
+        if (record.block_id == NULL_BLOCK_ID) {
+            if (record.recency != num_records) {
+                *error_out = strprintf("The backup should contain %" PRIu64 " blocks, "
+                                       "but it contains %" PRIu64 ".",
+                                       record.recency, num_records);
+                break;
+            }
+            write_restored_blocks(ser, io_account.get(), writes);
+            return true;
+        }
+        if (record.size != 0 && record.size != block_size) {
+            *error_out = strprintf("Block %" PRIu64 " in the backup has a bad size.",
+                                   record.block_id);
+            break;
+        }
+
+        repli_timestamp_t recency;
+        recency.longtime = record.recency;
+        scoped_ser_buffer_t buf;
+        if (record.size != 0) {
+            buf = ser->malloc();
+            if (!read_exactly(stream, buf->cache_data, record.size)) {
+                *error_out = "The backup is truncated.";
+                break;
+            }
+            if (crc32c(buf->cache_data, record.size) != record.checksum) {
+                *error_out = strprintf("Block %" PRIu64 " in the backup doesn't match "
+                                       "its checksum.", record.block_id);
+                break;
+            }
+        }
+        writes.push_back(restore_write_t(record.block_id, recency, std::move(buf)));
+        ++num_records;
+
+        if (writes.size() == PHYSICAL_BACKUP_BATCH_BLOCKS) {
+            write_restored_blocks(ser, io_account.get(), writes);
+            writes.clear();
+        }
+    }
+
+    write_restored_blocks(ser, io_account.get(), writes);
+    return false;
+}
@@ -0,0 +1,71 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#ifndef SERIALIZER_BACKUP_HPP_
+#define SERIALIZER_BACKUP_HPP_
+
+#include <stdint.h>
+
+#include <string>
+
+#include "errors.hpp"
+#include "repli_timestamp.hpp"
+#include "utils.hpp"
+
+class read_stream_t;
+class serializer_t;
+class signal_t;
+class write_stream_t;
+
+/* A physical backup is a copy of the blocks of a serializer, as opposed to a logical
+export of the documents stored in it.  It is taken while the serializer is in use:
+physical_backup() first takes a token for every block in the index, without
+blocking in between, so the backup is a consistent snapshot of the serializer at
+that moment.  The tokens keep the blocks they point to alive, so neither later
+writes nor the GC can make them go away while they are being streamed.
+
+The blocks are read in batches (so that blocks that sit next to each other on disk
+get read together) with a low i/o priority, see PHYSICAL_BACKUP_IO_PRIORITY.
+
+An incremental backup only contains the blocks whose recency is after `since`,
+plus a record for every block that is currently deleted.  Restoring a full backup
+into a freshly created serializer and then each incremental backup taken after it,
+in order, gives back the serializer as it was when the last backup was taken.
+
+The stream consists of a physical_backup_header_t, a physical_backup_record_t plus
+block contents for each block, and a physical_backup_record_t with a block id of
+NULL_BLOCK_ID that marks the end, whose recency field holds the number of records
+before it. */
+
+struct physical_backup_header_t {
+    static const char expected_magic[16];
+
+    char magic[16];
+    // The serializer's block size, a restore doesn't work with a different one.
+    uint32_t ser_block_size;
+    // repli_timestamp_t::distant_past for a full backup.
+    uint64_t since;
+} __attribute__((__packed__));
+
+struct physical_backup_record_t {
+    uint64_t block_id;
+    uint64_t recency;
+    // The number of bytes of block contents that follow the record, 0 if the block
+    // is deleted.
+    uint32_t size;
+    // The crc32c of the block contents.
+    uint32_t checksum;
+} __attribute__((__packed__));
+
+// Streams a backup of `ser` to `stream`, see above.  Must be called on the thread
+// `stream` can be used on.  Returns false if writing to `stream` failed.
+MUST_USE bool physical_backup(serializer_t *ser, repli_timestamp_t since,
+                              write_stream_t *stream, signal_t *interruptor)
+    THROWS_ONLY(interrupted_exc_t);
+
+// Writes the blocks of a backup read from `stream` into `ser`, on `ser`'s thread, with
+// one big sequential write per batch of blocks.  Returns false and
+// sets `*error_out` if the stream isn't a complete backup for a serializer like
+// `ser`; the blocks read up to that point have been written anyway.
+MUST_USE bool physical_restore(serializer_t *ser, read_stream_t *stream,
+                               std::string *error_out);
+
+#endif  // SERIALIZER_BACKUP_HPP_
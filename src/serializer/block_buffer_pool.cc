@@ -0,0 +1,286 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "serializer/block_buffer_pool.hpp"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "arch/runtime/runtime.hpp"
+#include "config/args.hpp"
+#include "errors.hpp"
+#include "perfmon/perfmon.hpp"
+#include "thread_local.hpp"
+#include "utils.hpp"
+
+block_huge_pages_t global_block_huge_pages = block_huge_pages_t::off;
+
+namespace {
+
+// The first page of every slab holds this, so a buffer's slab is its address
+// rounded down to BLOCK_BUFFER_SLAB_SIZE.
+struct slab_header_t {
+    size_t buffer_size;
+    // The size of the mapping if the slab is a single buffer too big to share a
+    // slab with others, or 0.
+    size_t single_map_size;
+    // Whether the slab is on reserved huge pages, whose pages can't go back to the
+    // kernel one buffer at a time.
+    bool reserved_huge_pages;
+};
+
+// A freed buffer's memory holds the pointer to the next one on the list.
+struct free_buffer_t {
+    free_buffer_t *next;
+};
+
+struct size_class_t {
+    explicit size_class_t(size_t _buffer_size)
+        : buffer_size(_buffer_size), free_list(NULL), slab_next(NULL), slab_end(NULL) { }
+    size_t buffer_size;
+    free_buffer_t *free_list;
+    // Freed buffers whose pages went back to the kernel, so we can't write in them
+    // without getting the pages back.
+    std::vector<void *> released;
+    // What's left of the last slab.
+    char *slab_next;
+    char *slab_end;
+};
+
+struct thread_buffers_t {
+    thread_buffers_t() : free_bytes(0) { }
+    // There are only ever a few block sizes.
+    std::vector<size_class_t> size_classes;
+    size_t free_bytes;
+};
+
+TLS_with_init(thread_buffers_t *, thread_buffers, NULL);
+
+class block_buffer_stats_t {
+public:
+    block_buffer_stats_t()
+        : free_ratio(&free_bytes, &slab_bytes),
+          huge_page_ratio(&huge_page_bytes, &slab_bytes),
+          block_buffers_membership(&get_global_perfmon_collection(),
+                                   &block_buffers_collection, "block_buffers"),
+          stats_membership(&block_buffers_collection,
+                           &slab_bytes, "slab_bytes",
+                           &used_bytes, "used_bytes",
+                           &free_bytes, "free_bytes",
+                           &released_bytes, "released_bytes",
+                           &free_ratio, "free_ratio",
+                           &huge_page_bytes, "huge_page_bytes",
+                           &huge_page_ratio, "huge_page_ratio",
+                           &huge_page_fallbacks, "huge_page_fallbacks",
+                           NULLPTR) { }
+
+    perfmon_collection_t block_buffers_collection;
+    // All the slabs, whether their pages are there or not.
+    perfmon_counter_t slab_bytes;
+    // The buffers that weren't freed.
+    perfmon_counter_t used_bytes;
+    // The buffers that are on free lists, with their pages.
+    perfmon_counter_t free_bytes;
+    // The freed buffers whose pages went back to the kernel.
+    perfmon_counter_t released_bytes;
+    // How much of the slabs is taken up by free buffers.
+    perfmon_counter_ratio_t free_ratio;
+    // The slabs on reserved huge pages, and how much of all the slabs they are.
+    // Transparent huge pages aren't counted, the kernel doesn't tell.
+    perfmon_counter_t huge_page_bytes;
+    perfmon_counter_ratio_t huge_page_ratio;
+    // How many slabs got normal or transparent huge pages because there were no
+    // reserved huge pages left.
+    perfmon_counter_t huge_page_fallbacks;
+
+private:
+    perfmon_membership_t block_buffers_membership;
+    perfmon_multi_membership_t stats_membership;
+
+    DISABLE_COPYING(block_buffer_stats_t);
+};
+
+block_buffer_stats_t block_buffer_stats;
+
+thread_buffers_t *get_thread_buffers() {
+    thread_buffers_t *buffers = TLS_get_thread_buffers();
+    if (buffers == NULL) {
+        // Like the slabs, it's never freed.
+        buffers = new thread_buffers_t;
+        TLS_set_thread_buffers(buffers);
+    }
+    return buffers;
+}
+
+size_class_t *get_size_class(thread_buffers_t *buffers, size_t buffer_size) {
+    for (auto it = buffers->size_classes.begin();
+         it != buffers->size_classes.end(); ++it) {
+        if (it->buffer_size == buffer_size) {
+            return &*it;
+        }
+    }
+    buffers->size_classes.push_back(size_class_t(buffer_size));
+    return &buffers->size_classes.back();
+}
+
+// Maps `size` bytes, a multiple of BLOCK_BUFFER_SLAB_SIZE, on reserved huge pages,
+// or returns `NULL` if there aren't enough of them left.
+char *map_reserved_huge_pages(size_t size) {
+#ifdef MAP_HUGETLB
+    void *res = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (res == MAP_FAILED) {
+        return NULL;
+    }
+    // Huge pages are aligned to their size, which is the slab size unless the
+    // default huge page size is bigger or smaller.
+    if (reinterpret_cast<uintptr_t>(res) % BLOCK_BUFFER_SLAB_SIZE != 0) {
+        guarantee_err(munmap(res, size) == 0, "munmap failed");
+        return NULL;
+    }
+    return static_cast<char *>(res);
+#else
+    (void)size;
+    return NULL;
+#endif
+}
+
+// Maps `size` bytes aligned to BLOCK_BUFFER_SLAB_SIZE, by mapping more and giving
+// the ends back.
+char *map_normal_pages(size_t size) {
+    const size_t map_size = size + BLOCK_BUFFER_SLAB_SIZE;
+    void *res = mmap(NULL, map_size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    guarantee_err(res != MAP_FAILED, "Could not map a slab for block buffers");
+    char *map = static_cast<char *>(res);
+    char *slab = reinterpret_cast<char *>(
+        ceil_aligned(reinterpret_cast<uintptr_t>(map), BLOCK_BUFFER_SLAB_SIZE));
+    if (slab != map) {
+        guarantee_err(munmap(map, slab - map) == 0, "munmap failed");
+    }
+    char *slab_end = slab + size;
+    if (slab_end != map + map_size) {
+        guarantee_err(munmap(slab_end, map + map_size - slab_end) == 0,
+                      "munmap failed");
+    }
+#ifdef MADV_HUGEPAGE
+    if (global_block_huge_pages != block_huge_pages_t::off) {
+        // The kernel may not have transparent huge pages, then the slab just gets
+        // normal ones.
+        UNUSED int ignored = madvise(slab, size, MADV_HUGEPAGE);
+    }
+#endif
+    return slab;
+}
+
+// Maps a slab of `size` bytes and writes its header.
+char *map_slab(size_t size, size_t buffer_size, size_t single_map_size) {
+    char *slab = NULL;
+    bool reserved_huge_pages = false;
+    if (global_block_huge_pages == block_huge_pages_t::reserved) {
+        slab = map_reserved_huge_pages(size);
+        if (slab != NULL) {
+            reserved_huge_pages = true;
+            block_buffer_stats.huge_page_bytes += size;
+        } else {
+            ++block_buffer_stats.huge_page_fallbacks;
+        }
+    }
+    if (slab == NULL) {
+        slab = map_normal_pages(size);
+    }
+    block_buffer_stats.slab_bytes += size;
+
+    slab_header_t *header = reinterpret_cast<slab_header_t *>(slab);
+    header->buffer_size = buffer_size;
+    header->single_map_size = single_map_size;
+    header->reserved_huge_pages = reserved_huge_pages;
+    return slab;
+}
+
+void release_pages(void *buffer, size_t buffer_size) {
+    // The buffer is page-aligned and a whole number of pages.
+    int res = madvise(buffer, buffer_size, MADV_DONTNEED);
+    guarantee_err(res == 0, "madvise failed");
+}
+
+}  // namespace
+
+void *block_buffer_malloc(size_t size) {
+    rassert(get_thread_id().threadnum != -1);
+    const size_t page_size = getpagesize();
+    const size_t buffer_size = ceil_aligned(size, page_size);
+    block_buffer_stats.used_bytes += buffer_size;
+
+    if (buffer_size > BLOCK_BUFFER_SLAB_SIZE / 8) {
+        const size_t map_size = ceil_aligned(page_size + buffer_size,
+                                             BLOCK_BUFFER_SLAB_SIZE);
+        char *slab = map_slab(map_size, buffer_size, map_size);
+        return slab + page_size;
+    }
+
+    thread_buffers_t *buffers = get_thread_buffers();
+    size_class_t *size_class = get_size_class(buffers, buffer_size);
+    if (size_class->free_list != NULL) {
+        free_buffer_t *head = size_class->free_list;
+        size_class->free_list = head->next;
+        buffers->free_bytes -= buffer_size;
+        block_buffer_stats.free_bytes -= buffer_size;
+        return head;
+    }
+    if (!size_class->released.empty()) {
+        void *buffer = size_class->released.back();
+        size_class->released.pop_back();
+        block_buffer_stats.released_bytes -= buffer_size;
+        return buffer;
+    }
+    if (size_class->slab_next == size_class->slab_end) {
+        char *slab = map_slab(BLOCK_BUFFER_SLAB_SIZE, buffer_size, 0);
+        // The header gets the first buffer's worth of the slab, so the buffers stay
+        // aligned.
+        size_class->slab_next = slab + buffer_size;
+        size_class->slab_end = slab + ((BLOCK_BUFFER_SLAB_SIZE / buffer_size)
+                                       * buffer_size);
+    }
+    void *buffer = size_class->slab_next;
+    size_class->slab_next += buffer_size;
+    return buffer;
+}
+
+void block_buffer_free(void *ptr) {
+    if (ptr == NULL) {
+        return;
+    }
+    const slab_header_t *header = reinterpret_cast<const slab_header_t *>(
+        floor_aligned(reinterpret_cast<uintptr_t>(ptr), BLOCK_BUFFER_SLAB_SIZE));
+    const size_t buffer_size = header->buffer_size;
+    block_buffer_stats.used_bytes -= buffer_size;
+
+    if (header->single_map_size != 0) {
+        const size_t map_size = header->single_map_size;
+        if (header->reserved_huge_pages) {
+            block_buffer_stats.huge_page_bytes -= map_size;
+        }
+        guarantee_err(munmap(const_cast<slab_header_t *>(header), map_size) == 0,
+                      "munmap failed");
+        block_buffer_stats.slab_bytes -= map_size;
+        return;
+    }
+
+    // Buffers are often freed on another thread than they were allocated on, they
+    // go on the list of the thread that frees them.
+    thread_buffers_t *buffers = get_thread_buffers();
+    size_class_t *size_class = get_size_class(buffers, buffer_size);
+    if (buffers->free_bytes + buffer_size <= BLOCK_BUFFER_MAX_FREE_BYTES
+        || header->reserved_huge_pages) {
+        free_buffer_t *buffer = static_cast<free_buffer_t *>(ptr);
+        buffer->next = size_class->free_list;
+        size_class->free_list = buffer;
+        buffers->free_bytes += buffer_size;
+        block_buffer_stats.free_bytes += buffer_size;
+    } else {
+        release_pages(ptr, buffer_size);
+        size_class->released.push_back(ptr);
+        block_buffer_stats.released_bytes += buffer_size;
+    }
+}
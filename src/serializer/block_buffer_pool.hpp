@@ -0,0 +1,39 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#ifndef SERIALIZER_BLOCK_BUFFER_POOL_HPP_
+#define SERIALIZER_BLOCK_BUFFER_POOL_HPP_
+
+#include <stddef.h>
+
+/* The cache and the serializer allocate and free block buffers (`ser_buffer_t`s) all
+the time, and they all have one of a few sizes, so they don't come from malloc.
+Every thread keeps the buffers that are freed on it in a free list for their size,
+and carves new ones out of slabs of BLOCK_BUFFER_SLAB_SIZE bytes that it maps
+itself; with `--pin-threads`, the kernel puts those on the thread's NUMA node.  Once
+a thread's free lists hold BLOCK_BUFFER_MAX_FREE_BYTES, the pages of the buffers it
+frees go back to the kernel, so that the RSS follows what the caches use.  The
+`block_buffers` stat has how many bytes of slabs there are, how they're used and how
+many of them are on reserved huge pages. */
+
+// What `--block-huge-pages` says the slabs are backed by.  It's set before the
+// thread pool starts and never changes after.
+enum class block_huge_pages_t {
+    // Normal pages.
+    off,
+    // Transparent huge pages, which the kernel gives when it has them.
+    transparent,
+    // Huge pages reserved with `vm.nr_hugepages`, of the default huge page size,
+    // which must be BLOCK_BUFFER_SLAB_SIZE.  Once there are none left, new slabs get
+    // transparent huge pages instead.  The pages of buffers on reserved huge pages
+    // never go back to the kernel.
+    reserved
+};
+extern block_huge_pages_t global_block_huge_pages;
+
+// Returns a buffer of `size` bytes, aligned to the page size.  Only threads of the
+// thread pool can allocate them, but any of them can free them.
+void *block_buffer_malloc(size_t size);
+
+// Frees a buffer that came from `block_buffer_malloc`, or does nothing for `NULL`.
+void block_buffer_free(void *ptr);
+
+#endif  // SERIALIZER_BLOCK_BUFFER_POOL_HPP_
@@ -16,6 +16,9 @@ struct log_serializer_dynamic_config_t {
         gc_high_ratio = DEFAULT_GC_HIGH_RATIO;
         read_ahead = true;
         io_batch_factor = DEFAULT_IO_BATCH_FACTOR;
+        compress_blocks = false;
+        scrub_on_startup = false;
+        discard_freed_extents = false;
     }
 
     /* When the proportion of garbage blocks hits gc_high_ratio, then the serializer will collect
@@ -30,7 +33,21 @@ struct log_serializer_dynamic_config_t {
     /* Enable reading more data than requested to let the cache warmup more quickly esp. on rotational drives */
     bool read_ahead;
 
-    RDB_MAKE_ME_SERIALIZABLE_4(gc_low_ratio, gc_high_ratio, io_batch_factor, read_ahead);
+    /* Store blocks compressed on disk when that saves space. Only blocks of the
+    serializer's block size get compressed. */
+    bool compress_blocks;
+
+    /* Read every block in the background after starting up and report the ones
+    that don't match their checksums. */
+    bool scrub_on_startup;
+
+    /* Discard extents once they are freed and the metablock that frees them is on
+    disk, so the file system (and SSD) can reclaim their space. The rate is limited
+    by EXTENT_DISCARD_RATE. */
+    bool discard_freed_extents;
+
+    RDB_MAKE_ME_SERIALIZABLE_7(gc_low_ratio, gc_high_ratio, io_batch_factor, read_ahead,
+                               compress_blocks, scrub_on_startup, discard_freed_extents);
 };
 
 /* This is equivalent to log_serializer_static_config_t below, but is an on-disk
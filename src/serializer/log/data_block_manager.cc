@@ -6,18 +6,33 @@
 #include <inttypes.h>
 #include <sys/uio.h>
 
+#include <algorithm>
+
 #include "utils.hpp"
 #include <boost/bind.hpp>
 
 #include "arch/arch.hpp"
 #include "arch/runtime/coroutines.hpp"
+#include "compression.hpp"
 #include "concurrency/mutex.hpp"
+#include "concurrency/pmap.hpp"
+#include "crc32c.hpp"
 #include "perfmon/perfmon.hpp"
 #include "serializer/log/log_serializer.hpp"
 #include "stl_utils.hpp"
 
-// Max amount of bytes which can be read ahead in one i/o transaction (if enabled)
-const int64_t APPROXIMATE_READ_AHEAD_SIZE = 32 * DEFAULT_BTREE_BLOCK_SIZE;
+// How many bytes are read ahead in one i/o transaction (if enabled), for random reads
+// and at most for reads that continue a stream, see read_ahead_detector_t.
+const int64_t MIN_READ_AHEAD_SIZE = 4 * DEFAULT_BTREE_BLOCK_SIZE;
+const int64_t MAX_READ_AHEAD_SIZE = 128 * DEFAULT_BTREE_BLOCK_SIZE;
+
+// How many concurrent streams of reads read_ahead_detector_t can tell apart.
+const size_t READ_AHEAD_STREAMS = 8;
+
+// read_many() reads blocks of the same extent with one i/o transaction if there are at
+// most this many bytes between them.  Reading a few bytes we don't need is cheaper
+// than another seek.
+const int64_t MAX_MERGED_READ_GAP = 16 * DEFAULT_BTREE_BLOCK_SIZE;
 
 // Identifies an extent, the time we started writing to the
 // extent, whether it's the extent we're currently writing to, and
@@ -163,6 +178,21 @@ public:
         return garbage_bytes_stat;
     }
 
+    // How worthwhile it would be to GC this extent, as in LFS's cost-benefit
+    // policy: the space we'd win, (1 - u), times how long the data has stayed
+    // put, divided by the cost of reading the extent and rewriting its live
+    // data, (1 + u), where u is the fraction of the extent that is live.
+    // Old, mostly-dead extents win; cold extents get collected even when they
+    // are fuller than hot extents whose blocks will die soon anyway.
+    double gc_score() const {
+        const double extent_size = parent->static_config->extent_size();
+        const double live_fraction = (extent_size - garbage_bytes()) / extent_size;
+        const microtime_t now = parent->gc_score_time;
+        // The + 1 keeps extents that have the same age ordered by garbage.
+        const double age = (now > timestamp ? now - timestamp : 0) + 1;
+        return (1.0 - live_fraction) * age / (1.0 + live_fraction);
+    }
+
     bool block_is_garbage(unsigned int block_index) const {
         guarantee(state != state_reconstructing);
         guarantee(block_index < block_infos.size());
@@ -341,7 +371,7 @@ public:
         // It has been, or is being, reconstructed from data on disk.
         state_reconstructing,
         // We are currently putting things on this extent. It is equal to
-        // last_data_extent.
+        // active_extent or gc_active_extent.
         state_active,
         // Not active, but not a GC candidate yet. It is in young_extent_queue.
         state_young,
@@ -383,7 +413,9 @@ private:
 data_block_manager_t::data_block_manager_t(const log_serializer_dynamic_config_t *_dynamic_config, extent_manager_t *em, log_serializer_t *_serializer, const log_serializer_on_disk_static_config_t *_static_config, log_serializer_stats_t *_stats)
     : stats(_stats), shutdown_callback(NULL), state(state_unstarted), dynamic_config(_dynamic_config),
       static_config(_static_config), extent_manager(em), serializer(_serializer),
-      gc_state(), gc_stats(stats)
+      gc_active_extent(NULL), gc_score_time(current_microtime()),
+      gc_state(), gc_stats(stats),
+      read_ahead_detector(MIN_READ_AHEAD_SIZE, MAX_READ_AHEAD_SIZE, READ_AHEAD_STREAMS)
 {
     rassert(dynamic_config != NULL);
     rassert(static_config != NULL);
@@ -432,8 +464,13 @@ void data_block_manager_t::start_existing(file_t *file,
                                           data_block_manager::metablock_mixin_t *last_metablock) {
     guarantee(state == state_unstarted);
     dbfile = file;
-    gc_io_account_nice.init(new file_account_t(file, GC_IO_PRIORITY_NICE));
-    gc_io_account_high.init(new file_account_t(file, GC_IO_PRIORITY_HIGH));
+    io_activity_stats_t *gc_io_stats = serializer->get_io_activity_stats(io_activity_t::gc);
+    gc_io_account_nice.init(new file_account_t(file, GC_IO_PRIORITY_NICE,
+                                               UNLIMITED_OUTSTANDING_REQUESTS,
+                                               io_class_t::background, gc_io_stats));
+    gc_io_account_high.init(new file_account_t(file, GC_IO_PRIORITY_HIGH,
+                                               UNLIMITED_OUTSTANDING_REQUESTS,
+                                               io_class_t::foreground, gc_io_stats));
 
     /* Reconstruct the active data block extents from the metablock. */
     const int64_t offset = last_metablock->active_extent;
@@ -476,27 +513,23 @@ void data_block_manager_t::start_existing(file_t *file,
     state = state_ready;
 }
 
-// Computes an offset and end offset for the purposes of readahead.  Returns an interval
-// that contains the [block_offset, block_offset + ser_block_size_in) interval that
-// is also contained within a single extent.  boundaries is the extent's gc_entry_t's
-// block_boundaries() value.  Outputs an interval that is _NOT_ fit to device block
-// size boundaries.  This is used by read_ahead_offset_and_size.
-void unaligned_read_ahead_interval(const int64_t block_offset,
-                                   const uint32_t ser_block_size,
-                                   const int64_t extent_size,
-                                   const int64_t read_ahead_size,
-                                   const std::vector<uint32_t> &boundaries,
-                                   int64_t *const offset_out,
-                                   int64_t *const end_offset_out) {
+// Computes the part of [raw_floor, raw_ceil) that is within the extent of the block at
+// block_offset, stretched to the boundaries of the blocks it overlaps.  This is used by
+// unaligned_read_ahead_interval and unaligned_forward_read_ahead_interval.
+static void read_ahead_interval_in_extent(const int64_t block_offset,
+                                          const uint32_t ser_block_size,
+                                          const int64_t extent_size,
+                                          const int64_t raw_readahead_floor,
+                                          const int64_t raw_readahead_ceil,
+                                          const std::vector<uint32_t> &boundaries,
+                                          int64_t *const offset_out,
+                                          int64_t *const end_offset_out) {
     guarantee(!boundaries.empty());
     guarantee(ser_block_size > 0);
     guarantee(boundaries.back() <= extent_size);
 
     const int64_t extent = floor_aligned(block_offset, extent_size);
 
-    const int64_t raw_readahead_floor = floor_aligned(block_offset, read_ahead_size);
-    const int64_t raw_readahead_ceil = raw_readahead_floor + read_ahead_size;
-
     // In case the extent size is configured to something weird, we cannot assume
     // that the readahead values are contained within the extent.
     const int64_t readahead_floor = std::max(raw_readahead_floor, extent);
@@ -524,6 +557,37 @@ void unaligned_read_ahead_interval(const int64_t block_offset,
     *end_offset_out = end_ret;
 }
 
+// Computes an offset and end offset for the purposes of readahead.  Returns an interval
+// that contains the [block_offset, block_offset + ser_block_size_in) interval that
+// is also contained within a single extent.  boundaries is the extent's gc_entry_t's
+// block_boundaries() value.  Outputs an interval that is _NOT_ fit to device block
+// size boundaries.  This is used by read_ahead_offset_and_size.
+void unaligned_read_ahead_interval(const int64_t block_offset,
+                                   const uint32_t ser_block_size,
+                                   const int64_t extent_size,
+                                   const int64_t read_ahead_size,
+                                   const std::vector<uint32_t> &boundaries,
+                                   int64_t *const offset_out,
+                                   int64_t *const end_offset_out) {
+    const int64_t raw_readahead_floor = floor_aligned(block_offset, read_ahead_size);
+    read_ahead_interval_in_extent(block_offset, ser_block_size, extent_size,
+                                  raw_readahead_floor,
+                                  raw_readahead_floor + read_ahead_size,
+                                  boundaries, offset_out, end_offset_out);
+}
+
+void unaligned_forward_read_ahead_interval(const int64_t block_offset,
+                                           const uint32_t ser_block_size,
+                                           const int64_t extent_size,
+                                           const int64_t read_ahead_size,
+                                           const std::vector<uint32_t> &boundaries,
+                                           int64_t *const offset_out,
+                                           int64_t *const end_offset_out) {
+    read_ahead_interval_in_extent(block_offset, ser_block_size, extent_size,
+                                  block_offset, block_offset + read_ahead_size,
+                                  boundaries, offset_out, end_offset_out);
+}
+
 // Computes a device block size aligned interval to be read for the purposes of
 // readahead.  Returns an interval that contains the [block_offset, block_offset +
 // ser_block_size_in) interval.  boundaries is the extent's gc_entry_t's
@@ -532,30 +596,114 @@ void read_ahead_interval(const int64_t block_offset,
                          const uint32_t ser_block_size,
                          const int64_t extent_size,
                          const int64_t read_ahead_size,
+                         const bool forward,
                          const int64_t device_block_size,
                          const std::vector<uint32_t> &boundaries,
                          int64_t *const offset_out,
                          int64_t *const end_offset_out) {
     int64_t unaligned_offset;
     int64_t unaligned_end_offset;
-    unaligned_read_ahead_interval(block_offset, ser_block_size, extent_size,
-                                  read_ahead_size, boundaries,
-                                  &unaligned_offset, &unaligned_end_offset);
+    if (forward) {
+        unaligned_forward_read_ahead_interval(block_offset, ser_block_size, extent_size,
+                                              read_ahead_size, boundaries,
+                                              &unaligned_offset, &unaligned_end_offset);
+    } else {
+        unaligned_read_ahead_interval(block_offset, ser_block_size, extent_size,
+                                      read_ahead_size, boundaries,
+                                      &unaligned_offset, &unaligned_end_offset);
+    }
 
     *offset_out = floor_aligned(unaligned_offset, device_block_size);
     *end_offset_out = ceil_aligned(unaligned_end_offset, device_block_size);
 }
 
 
+// The on-disk layout of a block that many_writes stored compressed. The serializer
+// header stays uncompressed, so that read-ahead can see the block id.
+struct compressed_block_t {
+    ls_buf_data_t ser_header;
+    uint32_t compressed_size;
+    char compressed_data[];
+} __attribute__((__packed__));
+
+// Compresses `buf`, a block of size `block_size`. Returns an empty buffer if that
+// wouldn't save at least one device block on disk.
+scoped_malloc_t<char> compress_block(const ser_buffer_t *buf, block_size_t block_size,
+                                     block_size_t *compressed_size_out) {
+    const uint32_t aligned_size = gc_entry_t::aligned_value(block_size);
+    if (aligned_size <= DEVICE_BLOCK_SIZE) {
+        return scoped_malloc_t<char>();
+    }
+    const uint32_t max_aligned_size = aligned_size - DEVICE_BLOCK_SIZE;
+
+    scoped_malloc_t<char> ret(malloc_aligned(max_aligned_size, DEVICE_BLOCK_SIZE));
+    compressed_block_t *block = reinterpret_cast<compressed_block_t *>(ret.get());
+    const size_t compressed_size = lz_compress(buf->cache_data, block_size.value(),
+                                               block->compressed_data,
+                                               max_aligned_size - sizeof(compressed_block_t));
+    if (compressed_size == 0) {
+        return scoped_malloc_t<char>();
+    }
+    block->ser_header = buf->ser_header;
+    block->compressed_size = compressed_size;
+
+    const uint32_t ser_size = sizeof(compressed_block_t) + compressed_size;
+    // The padding up to the next device block gets written too.
+    memset(ret.get() + ser_size, 0, ceil_aligned(ser_size, DEVICE_BLOCK_SIZE) - ser_size);
+    *compressed_size_out = block_size_t::unsafe_make(ser_size);
+    return ret;
+}
+
+// Copies the `ondisk_size` bytes of a block as they are stored on disk into
+// `buf_out`, decompressing them if necessary. `block_size` is the size of the
+// block when it's not compressed.
+void copy_block_from_disk(const char *data, uint32_t ondisk_size, bool compressed,
+                          block_size_t block_size, void *buf_out) {
+    if (!compressed) {
+        memcpy(buf_out, data, ondisk_size);
+        return;
+    }
+
+    const compressed_block_t *block = reinterpret_cast<const compressed_block_t *>(data);
+    guarantee(ondisk_size >= sizeof(compressed_block_t)
+              && block->compressed_size == ondisk_size - sizeof(compressed_block_t),
+              "Corrupted compressed block");
+    ser_buffer_t *buf = static_cast<ser_buffer_t *>(buf_out);
+    buf->ser_header = block->ser_header;
+    const bool success = lz_decompress(block->compressed_data, block->compressed_size,
+                                       buf->cache_data, block_size.value());
+    guarantee(success, "Corrupted compressed block (block id %" PRIu64 ")",
+              block->ser_header.block_id);
+}
+
+// Tells whether the `ondisk_size` bytes of a block as they are stored on disk
+// match the block's checksum, if it has one.
+bool block_checksum_matches(const char *data, uint32_t ondisk_size,
+                            bool has_checksum, uint32_t checksum) {
+    return !has_checksum || crc32c(data, ondisk_size) == checksum;
+}
+
+void guarantee_block_checksum_matches(const char *data, const ls_block_token_pointee_t *token,
+                                      int64_t offset) {
+    const uint32_t ondisk_size = token->ondisk_block_size().ser_value();
+    guarantee(block_checksum_matches(data, ondisk_size, token->has_checksum(),
+                                     token->has_checksum() ? token->checksum() : 0),
+              "The data block at offset %" PRIi64 " (size %" PRIu32 ") doesn't match its "
+              "checksum.  The data file is corrupted.", offset, ondisk_size);
+}
+
 void read_ahead_offset_and_size(int64_t off_in,
                                 int64_t ser_block_size_in,
                                 int64_t extent_size,
+                                int64_t approximate_read_ahead_size,
+                                bool forward,
                                 const std::vector<uint32_t> &boundaries,
                                 int64_t *offset_out, int64_t *size_out) {
     int64_t offset;
     int64_t end_offset;
     read_ahead_interval(off_in, ser_block_size_in, extent_size,
-                        APPROXIMATE_READ_AHEAD_SIZE,
+                        approximate_read_ahead_size,
+                        forward,
                         DEVICE_BLOCK_SIZE,
                         boundaries,
                         &offset,
@@ -577,19 +725,25 @@ public:
     }
 
     static void perform_read_ahead(data_block_manager_t *const parent,
+                                   const ls_block_token_pointee_t *const required_token,
                                    const int64_t off_in,
-                                   const uint32_t ser_block_size_in,
+                                   const int64_t approximate_read_ahead_size,
+                                   const bool sequential,
                                    void *const buf_out,
                                    file_account_t *const io_account) {
+        const uint32_t ser_block_size_in = required_token->ondisk_block_size().ser_value();
         const std::vector<uint32_t> boundaries = get_boundaries(parent, off_in);
 
         int64_t read_ahead_offset;
         int64_t read_ahead_size;
 
-        // Finish initialization.
+        // Finish initialization.  A stream of forward reads won't come back for the
+        // blocks before this one.
         read_ahead_offset_and_size(off_in,
                                    ser_block_size_in,
                                    parent->static_config->extent_size(),
+                                   approximate_read_ahead_size,
+                                   sequential,
                                    boundaries,
                                    &read_ahead_offset,
                                    &read_ahead_size);
@@ -614,6 +768,7 @@ public:
                                                relative_end_offset) - 1;
 
         bool handled_required_block = false;
+        int64_t bytes_offered = 0;
 
         for (; lower_it < upper_it; ++lower_it) {
             const char *current_buf
@@ -624,7 +779,10 @@ public:
             if (current_offset == off_in) {
                 guarantee(!handled_required_block);
 
-                memcpy(buf_out, current_buf, ser_block_size_in);
+                guarantee_block_checksum_matches(current_buf, required_token, off_in);
+                copy_block_from_disk(current_buf, ser_block_size_in,
+                                     required_token->is_compressed(),
+                                     parent->static_config->block_size(), buf_out);
                 handled_required_block = true;
             } else {
                 const block_id_t block_id
@@ -640,13 +798,23 @@ public:
                     continue;
                 }
 
-                scoped_malloc_t<ser_buffer_t> data = parent->serializer->malloc();
-                memcpy(data.get(), current_buf, info.ser_block_size);
-                guarantee(info.ser_block_size <= *(lower_it + 1) - *lower_it);
+                const uint32_t ondisk_size = lba_ondisk_block_size(info.ser_block_size);
+                guarantee(ondisk_size <= *(lower_it + 1) - *lower_it);
+
+                // Corrupted blocks get reported when somebody actually reads them.
+                if (!block_checksum_matches(current_buf, ondisk_size,
+                                            lba_block_has_checksum(info.ser_block_size),
+                                            info.checksum)) {
+                    continue;
+                }
+
+                scoped_ser_buffer_t data = parent->serializer->malloc();
+                copy_block_from_disk(current_buf, ondisk_size,
+                                     lba_block_is_compressed(info.ser_block_size),
+                                     parent->static_config->block_size(), data.get());
 
                 counted_t<ls_block_token_pointee_t> ls_token
-                    = parent->serializer->generate_block_token(current_offset,
-                                                               block_size_t::unsafe_make(info.ser_block_size));
+                    = parent->serializer->generate_block_token_from_lba(current_offset, info);
 
                 counted_t<standard_block_token_t> token
                     = to_standard_block_token(block_id, ls_token);
@@ -656,14 +824,63 @@ public:
                         std::move(data),
                         token,
                         info.recency);
+                bytes_offered += ondisk_size;
             }
         }
 
         guarantee(handled_required_block);
+
+        // Everything we read besides the required block and the live blocks we could
+        // offer is wasted.
+        const int64_t bytes_read_ahead = read_ahead_size - ser_block_size_in;
+        log_serializer_stats_t *const stats = parent->stats;
+        ++stats->pm_serializer_read_ahead_reads;
+        if (sequential) {
+            ++stats->pm_serializer_read_ahead_sequential_reads;
+        }
+        stats->pm_serializer_read_ahead_bytes += bytes_read_ahead;
+        stats->pm_serializer_read_ahead_bytes_wasted
+            += std::max<int64_t>(0, bytes_read_ahead - bytes_offered);
     }
 };
 
 
+read_ahead_detector_t::read_ahead_detector_t(int64_t _min_size, int64_t _max_size,
+                                             size_t num_streams)
+    : min_size(_min_size), max_size(_max_size), streams(num_streams), use_counter(0) {
+    guarantee(0 < min_size && min_size <= max_size);
+    guarantee(num_streams > 0);
+}
+
+int64_t read_ahead_detector_t::read_ahead_size(int64_t offset, bool *sequential_out) {
+    ++use_counter;
+    stream_t *least_recently_used = &streams[0];
+    for (auto it = streams.begin(); it != streams.end(); ++it) {
+        // A stream continues if the read lands within one read-ahead of where we
+        // expected it.  The read can come somewhat early because a block we read
+        // ahead got evicted or rejected by the cache, or somewhat late because the
+        // reader skipped over blocks it didn't need.
+        if (it->next_offset != -1
+            && offset >= it->next_offset - it->size
+            && offset < it->next_offset + it->size) {
+            it->size = std::min(it->size * 2, max_size);
+            it->next_offset = offset + it->size;
+            it->last_use = use_counter;
+            *sequential_out = true;
+            return it->size;
+        }
+        if (it->last_use < least_recently_used->last_use) {
+            least_recently_used = &*it;
+        }
+    }
+
+    least_recently_used->size = min_size;
+    least_recently_used->next_offset = offset + min_size;
+    least_recently_used->last_use = use_counter;
+    *sequential_out = false;
+    return min_size;
+}
+
 bool data_block_manager_t::should_perform_read_ahead(int64_t offset) {
     uint64_t extent_id = static_config->extent_index(offset);
 
@@ -675,17 +892,26 @@ bool data_block_manager_t::should_perform_read_ahead(int64_t offset) {
     return !entry->was_written && serializer->should_perform_read_ahead();
 }
 
-void data_block_manager_t::read(int64_t off_in, uint32_t ser_block_size_in,
+void data_block_manager_t::read(const ls_block_token_pointee_t *token,
                                 void *buf_out, file_account_t *io_account) {
     guarantee(state == state_ready);
+    // The GC may move the block while we read it, so we read from where it is now.
+    const int64_t off_in = token->offset();
+    const uint32_t ser_block_size_in = token->ondisk_block_size().ser_value();
+    const bool compressed = token->is_compressed();
     if (should_perform_read_ahead(off_in)) {
-        dbm_read_ahead_t::perform_read_ahead(this, off_in, ser_block_size_in,
-                                             buf_out, io_account);
+        bool sequential;
+        const int64_t read_ahead_size
+            = read_ahead_detector.read_ahead_size(off_in, &sequential);
+        dbm_read_ahead_t::perform_read_ahead(this, token, off_in, read_ahead_size,
+                                             sequential, buf_out, io_account);
     } else {
-        if (divides(DEVICE_BLOCK_SIZE, reinterpret_cast<intptr_t>(buf_out)) &&
+        if (!compressed &&
+            divides(DEVICE_BLOCK_SIZE, reinterpret_cast<intptr_t>(buf_out)) &&
             divides(DEVICE_BLOCK_SIZE, off_in) &&
             divides(DEVICE_BLOCK_SIZE, ser_block_size_in)) {
             co_read(dbfile, off_in, ser_block_size_in, buf_out, io_account);
+            guarantee_block_checksum_matches(static_cast<const char *>(buf_out), token, off_in);
         } else {
             int64_t floor_off_in = floor_aligned(off_in, DEVICE_BLOCK_SIZE);
             int64_t ceil_off_end = ceil_aligned(off_in + ser_block_size_in,
@@ -695,11 +921,109 @@ void data_block_manager_t::read(int64_t off_in, uint32_t ser_block_size_in,
             co_read(dbfile, floor_off_in, ceil_off_end - floor_off_in,
                     buf.get(), io_account);
 
-            memcpy(buf_out, buf.get() + (off_in - floor_off_in), ser_block_size_in);
+            const char *const block_data = buf.get() + (off_in - floor_off_in);
+            guarantee_block_checksum_matches(block_data, token, off_in);
+            copy_block_from_disk(block_data, ser_block_size_in,
+                                 compressed, static_config->block_size(), buf_out);
         }
     }
 }
 
+struct merged_read_block_t {
+    merged_read_block_t(int64_t _offset, const ls_block_token_pointee_t *_token, void *_buf_out)
+        : offset(_offset), token(_token), buf_out(_buf_out) { }
+    bool operator<(const merged_read_block_t &other) const {
+        return offset < other.offset;
+    }
+
+    int64_t offset;
+    const ls_block_token_pointee_t *token;
+    void *buf_out;
+};
+
+void data_block_manager_t::read_merged_group(const std::vector<merged_read_block_t> *blocks,
+                                             const std::vector<std::pair<size_t, size_t> > *groups,
+                                             file_account_t *io_account,
+                                             size_t group_index) {
+    const size_t begin = (*groups)[group_index].first;
+    const size_t end = (*groups)[group_index].second;
+
+    if (end - begin == 1) {
+        const merged_read_block_t &block = (*blocks)[begin];
+        read(block.token, block.buf_out, io_account);
+        return;
+    }
+
+    const uint32_t last_size
+        = (*blocks)[end - 1].token->ondisk_block_size().ser_value();
+    const int64_t floor_off = floor_aligned((*blocks)[begin].offset, DEVICE_BLOCK_SIZE);
+    const int64_t ceil_end = ceil_aligned((*blocks)[end - 1].offset + last_size,
+                                          DEVICE_BLOCK_SIZE);
+    scoped_malloc_t<char> buf(malloc_aligned(ceil_end - floor_off, DEVICE_BLOCK_SIZE));
+    co_read(dbfile, floor_off, ceil_end - floor_off, buf.get(), io_account);
+
+    for (size_t i = begin; i < end; ++i) {
+        const merged_read_block_t &block = (*blocks)[i];
+        const char *const block_data = buf.get() + (block.offset - floor_off);
+        guarantee_block_checksum_matches(block_data, block.token, block.offset);
+        copy_block_from_disk(block_data, block.token->ondisk_block_size().ser_value(),
+                             block.token->is_compressed(), static_config->block_size(),
+                             block.buf_out);
+    }
+    stats->pm_serializer_data_blocks_read_merged += end - begin;
+}
+
+void data_block_manager_t::read_many(const std::vector<const ls_block_token_pointee_t *> &tokens,
+                                     const std::vector<void *> &bufs_out,
+                                     file_account_t *io_account) {
+    guarantee(state == state_ready);
+    guarantee(tokens.size() == bufs_out.size());
+
+    // Like in read(), we read the blocks from wherever they are now.
+    std::vector<merged_read_block_t> blocks;
+    blocks.reserve(tokens.size());
+    for (size_t i = 0; i < tokens.size(); ++i) {
+        blocks.push_back(merged_read_block_t(tokens[i]->offset(), tokens[i], bufs_out[i]));
+    }
+    std::sort(blocks.begin(), blocks.end());
+
+    // Each group is a range of `blocks` that gets read with one i/o transaction.
+    std::vector<std::pair<size_t, size_t> > groups;
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        if (!groups.empty()) {
+            const merged_read_block_t &prev = blocks[i - 1];
+            const int64_t prev_end
+                = prev.offset + prev.token->ondisk_block_size().ser_value();
+            if (static_config->extent_index(prev.offset)
+                == static_config->extent_index(blocks[i].offset)
+                && blocks[i].offset - prev_end <= MAX_MERGED_READ_GAP) {
+                groups.back().second = i + 1;
+                continue;
+            }
+        }
+        groups.push_back(std::make_pair(i, i + 1));
+    }
+
+    pmap(groups.size(), boost::bind(&data_block_manager_t::read_merged_group, this,
+                                    &blocks, &groups, io_account, _1));
+}
+
+bool data_block_manager_t::verify(const ls_block_token_pointee_t *token,
+                                  file_account_t *io_account) {
+    guarantee(state == state_ready);
+    const int64_t offset = token->offset();
+    const uint32_t ser_block_size = token->ondisk_block_size().ser_value();
+
+    const int64_t floor_offset = floor_aligned(offset, DEVICE_BLOCK_SIZE);
+    const int64_t ceil_end = ceil_aligned(offset + ser_block_size, DEVICE_BLOCK_SIZE);
+    scoped_malloc_t<char> buf(malloc_aligned(ceil_end - floor_offset, DEVICE_BLOCK_SIZE));
+    co_read(dbfile, floor_offset, ceil_end - floor_offset, buf.get(), io_account);
+
+    return block_checksum_matches(buf.get() + (offset - floor_offset), ser_block_size,
+                                  token->has_checksum(),
+                                  token->has_checksum() ? token->checksum() : 0);
+}
+
 std::vector<counted_t<ls_block_token_pointee_t> >
 data_block_manager_t::many_writes(const std::vector<buf_write_info_t> &writes,
                                   bool assign_new_block_sequence_id,
@@ -710,11 +1034,6 @@ data_block_manager_t::many_writes(const std::vector<buf_write_info_t> &writes,
     guarantee(state == state_ready ||
               (state == state_shutting_down && gc_state.step() == gc_write));
 
-    // These tokens are grouped by extent.  You can do a contiguous write in each
-    // extent.
-    std::vector<std::vector<counted_t<ls_block_token_pointee_t> > > token_groups
-        = gimme_some_new_offsets(writes);
-
     for (auto it = writes.begin(); it != writes.end(); ++it) {
         it->buf->ser_header.block_id = it->block_id;
         if (assign_new_block_sequence_id) {
@@ -723,7 +1042,54 @@ data_block_manager_t::many_writes(const std::vector<buf_write_info_t> &writes,
         }
     }
 
+    // Full-size blocks get compressed if that's enabled.  The GC, which doesn't
+    // assign new block sequence ids, writes blocks back exactly as they were on
+    // disk.
+    std::vector<buf_write_info_t> ondisk_writes;
+    ondisk_writes.reserve(writes.size());
+    std::vector<bool> compressed;
+    compressed.reserve(writes.size());
+    std::vector<scoped_malloc_t<char> > compressed_bufs;
+    for (auto it = writes.begin(); it != writes.end(); ++it) {
+        scoped_malloc_t<char> compressed_buf;
+        block_size_t compressed_size = block_size_t::undefined();
+        if (assign_new_block_sequence_id && dynamic_config->compress_blocks
+            && it->block_size == static_config->block_size()) {
+            compressed_buf = compress_block(it->buf, it->block_size, &compressed_size);
+        }
+
+        if (compressed_buf.has()) {
+            ++stats->pm_serializer_data_blocks_compressed;
+            stats->pm_serializer_data_bytes_saved_by_compression
+                += gc_entry_t::aligned_value(it->block_size)
+                - gc_entry_t::aligned_value(compressed_size);
+            ondisk_writes.push_back(
+                    buf_write_info_t(reinterpret_cast<ser_buffer_t *>(compressed_buf.get()),
+                                     compressed_size, it->block_id));
+            compressed.push_back(true);
+            compressed_bufs.push_back(std::move(compressed_buf));
+        } else {
+            ondisk_writes.push_back(*it);
+            compressed.push_back(false);
+        }
+    }
+
+    // These tokens are grouped by extent.  You can do a contiguous write in each
+    // extent.
+    std::vector<std::vector<counted_t<ls_block_token_pointee_t> > > token_groups
+        = gimme_some_new_offsets(ondisk_writes, compressed, !assign_new_block_sequence_id);
+
     stats->pm_serializer_data_blocks_written += writes.size();
+    int64_t bytes_written = 0;
+    for (auto it = ondisk_writes.begin(); it != ondisk_writes.end(); ++it) {
+        bytes_written += gc_entry_t::aligned_value(it->block_size);
+    }
+    stats->pm_serializer_data_bytes_written += bytes_written;
+    if (assign_new_block_sequence_id) {
+        stats->pm_serializer_data_bytes_written_by_writes += bytes_written;
+    } else {
+        stats->pm_serializer_data_bytes_written_by_gc += bytes_written;
+    }
 
     struct intermediate_cb_t : public iocallback_t {
         virtual void on_io_complete() {
@@ -737,18 +1103,22 @@ data_block_manager_t::many_writes(const std::vector<buf_write_info_t> &writes,
 
         size_t ops_remaining;
         iocallback_t *cb;
+        // The compressed copies of the blocks, which must live until the writes
+        // are done.
+        std::vector<scoped_malloc_t<char> > compressed_bufs;
     };
 
     intermediate_cb_t *const intermediate_cb = new intermediate_cb_t;
     intermediate_cb->ops_remaining = token_groups.size();
     intermediate_cb->cb = cb;
+    intermediate_cb->compressed_bufs = std::move(compressed_bufs);
 
     size_t write_number = 0;
     for (size_t i = 0; i < token_groups.size(); ++i) {
 
         const int64_t front_offset = token_groups[i].front()->offset();
         const int64_t back_offset = token_groups[i].back()->offset()
-            + gc_entry_t::aligned_value(token_groups[i].back()->block_size());
+            + gc_entry_t::aligned_value(token_groups[i].back()->ondisk_block_size());
 
         guarantee(divides(DEVICE_BLOCK_SIZE, front_offset));
 
@@ -760,15 +1130,23 @@ data_block_manager_t::many_writes(const std::vector<buf_write_info_t> &writes,
 
         for (size_t j = 0; j < token_groups[i].size(); ++j) {
             const int64_t j_offset = token_groups[i][j]->offset();
-            const block_size_t j_block_size = token_groups[i][j]->block_size();
+            const block_size_t j_block_size = token_groups[i][j]->ondisk_block_size();
             guarantee(j_offset == last_written_offset);
             const size_t j_aligned_size = gc_entry_t::aligned_value(j_block_size);
 
             // The behavior of gimme_some_new_offsets is supposed to retain order, so
-            // we expect writes[write_number] to have the currently-relevant write.
-            guarantee(writes[write_number].block_size == j_block_size);
+            // we expect ondisk_writes[write_number] to have the currently-relevant
+            // write.
+            guarantee(ondisk_writes[write_number].block_size == j_block_size);
+
+            // Blocks the GC moves keep the checksums they have in the LBA.
+            if (assign_new_block_sequence_id) {
+                token_groups[i][j]->has_checksum_ = true;
+                token_groups[i][j]->checksum_ = crc32c(ondisk_writes[write_number].buf,
+                                                       j_block_size.ser_value());
+            }
 
-            iovecs[j].iov_base = writes[write_number].buf;
+            iovecs[j].iov_base = ondisk_writes[write_number].buf;
             iovecs[j].iov_len = j_aligned_size;
             last_written_offset = j_offset + j_aligned_size;
 
@@ -946,7 +1324,8 @@ void data_block_manager_t::gc_writer_t::write_gcs(gc_write_t *writes, size_t num
             the_writes.reserve(num_writes);
             for (size_t i = 0; i < num_writes; ++i) {
                 old_block_tokens.push_back(parent->serializer->generate_block_token(writes[i].old_offset,
-                                                                                    writes[i].block_size));
+                                                                                    writes[i].block_size,
+                                                                                    false));
 
                 the_writes.push_back(buf_write_info_t(writes[i].buf,
                                                       writes[i].block_size,
@@ -982,11 +1361,19 @@ void data_block_manager_t::gc_writer_t::write_gcs(gc_write_t *writes, size_t num
                 if (parent->gc_state.current_entry->block_referenced_by_index(block_index)) {
                     block_id_t block_id = writes[i].buf->ser_header.block_id;
 
+                    // The block got copied as it was on disk, so it keeps its
+                    // compression flag and checksum.
+                    const index_block_info_t info
+                        = parent->serializer->lba_index->get_block_info(block_id);
+                    guarantee(lba_ondisk_block_size(info.ser_block_size)
+                              == new_block_tokens[i]->ondisk_block_size().ser_value());
+                    counted_t<ls_block_token_pointee_t> token
+                        = parent->serializer->generate_block_token_from_lba(
+                                new_block_tokens[i]->offset(), info);
+
                     index_write_ops.push_back(
                             index_write_op_t(block_id,
-                                             to_standard_block_token(
-                                                     block_id,
-                                                     new_block_tokens[i])));
+                                             to_standard_block_token(block_id, token)));
                 }
 
                 // (If we don't have an i_array entry, the block is referenced
@@ -1053,6 +1440,10 @@ void data_block_manager_t::run_gc() {
 
                 ASSERT_NO_CORO_WAITING;
 
+                if (current_microtime() - gc_score_time > GC_SCORE_REFRESH_INTERVAL_MICROS) {
+                    refresh_gc_scores();
+                }
+
                 ++stats->pm_serializer_data_extents_gced;
 
                 /* grab the entry */
@@ -1267,6 +1658,12 @@ void data_block_manager_t::actually_shutdown() {
         active_extent = NULL;
     }
 
+    if (gc_active_extent != NULL) {
+        UNUSED int64_t extent = gc_active_extent->extent_ref.release();
+        delete gc_active_extent;
+        gc_active_extent = NULL;
+    }
+
     while (gc_entry_t *entry = young_extent_queue.head()) {
         young_extent_queue.remove(entry);
         UNUSED int64_t extent = entry->extent_ref.release();
@@ -1285,17 +1682,22 @@ void data_block_manager_t::actually_shutdown() {
 }
 
 std::vector<std::vector<counted_t<ls_block_token_pointee_t> > >
-data_block_manager_t::gimme_some_new_offsets(const std::vector<buf_write_info_t> &writes) {
+data_block_manager_t::gimme_some_new_offsets(const std::vector<buf_write_info_t> &writes,
+                                             const std::vector<bool> &compressed,
+                                             bool for_gc) {
     ASSERT_NO_CORO_WAITING;
+    guarantee(compressed.size() == writes.size());
+
+    gc_entry_t **const extent = for_gc ? &gc_active_extent : &active_extent;
 
     // Start a new extent if necessary.
-    if (active_extent == NULL) {
-        active_extent = new gc_entry_t(this);
+    if (*extent == NULL) {
+        *extent = new gc_entry_t(this);
         ++stats->pm_serializer_data_extents_allocated;
     }
 
 
-    guarantee(active_extent->state == gc_entry_t::state_active);
+    guarantee((*extent)->state == gc_entry_t::state_active);
 
     std::vector<std::vector<counted_t<ls_block_token_pointee_t> > > ret;
 
@@ -1303,19 +1705,19 @@ data_block_manager_t::gimme_some_new_offsets(const std::vector<buf_write_info_t>
     for (auto it = writes.begin(); it != writes.end(); ++it) {
         uint32_t relative_offset = valgrind_undefined<uint32_t>(UINT32_MAX);
         unsigned int block_index = valgrind_undefined<unsigned int>(UINT_MAX);
-        if (!active_extent->new_offset(it->block_size,
-                                       &relative_offset, &block_index)) {
-            // Move the active_extent gc_entry_t to the young extent queue, and make a
+        if (!(*extent)->new_offset(it->block_size,
+                                   &relative_offset, &block_index)) {
+            // Move the active gc_entry_t to the young extent queue, and make a
             // new gc_entry_t.
-            active_extent->state = gc_entry_t::state_young;
-            young_extent_queue.push_back(active_extent);
+            (*extent)->state = gc_entry_t::state_young;
+            young_extent_queue.push_back(*extent);
             mark_unyoung_entries();
 
-            active_extent = new gc_entry_t(this);
+            *extent = new gc_entry_t(this);
             ++stats->pm_serializer_data_extents_allocated;
-            const bool succeeded = active_extent->new_offset(it->block_size,
-                                                             &relative_offset,
-                                                             &block_index);
+            const bool succeeded = (*extent)->new_offset(it->block_size,
+                                                         &relative_offset,
+                                                         &block_index);
             guarantee(succeeded);
 
             // Push the current group of tokens, if it's nonempty, onto the return vector.
@@ -1325,11 +1727,12 @@ data_block_manager_t::gimme_some_new_offsets(const std::vector<buf_write_info_t>
             }
         }
 
-        const int64_t offset = active_extent->extent_ref.offset() + relative_offset;
-        active_extent->was_written = true;
-        active_extent->mark_live_tokenwise(block_index);
+        const int64_t offset = (*extent)->extent_ref.offset() + relative_offset;
+        (*extent)->was_written = true;
+        (*extent)->mark_live_tokenwise(block_index);
 
-        tokens.push_back(serializer->generate_block_token(offset, it->block_size));
+        tokens.push_back(serializer->generate_block_token(offset, it->block_size,
+                                                          compressed[it - writes.begin()]));
     }
 
     if (!tokens.empty()) {
@@ -1389,7 +1792,25 @@ bool data_block_manager_t::do_we_want_to_start_gcing() const {
 }
 
 bool gc_entry_less_t::operator()(const gc_entry_t *x, const gc_entry_t *y) {
-    return x->garbage_bytes() < y->garbage_bytes();
+    return x->gc_score() < y->gc_score();
+}
+
+// The extents' scores grow at different rates as time passes, so we can't just
+// advance gc_score_time; the queue has to be rebuilt with the new scores.
+void data_block_manager_t::refresh_gc_scores() {
+    ASSERT_NO_CORO_WAITING;
+    std::vector<gc_entry_t *> old_entries;
+    old_entries.reserve(gc_pq.size());
+    while (!gc_pq.empty()) {
+        old_entries.push_back(gc_pq.pop());
+    }
+
+    gc_score_time = current_microtime();
+
+    for (auto it = old_entries.begin(); it != old_entries.end(); ++it) {
+        guarantee((*it)->state == gc_entry_t::state_old);
+        (*it)->our_pq_entry = gc_pq.push(*it);
+    }
 }
 
 /****************
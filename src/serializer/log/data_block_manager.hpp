@@ -2,6 +2,7 @@
 #ifndef SERIALIZER_LOG_DATA_BLOCK_MANAGER_HPP_
 #define SERIALIZER_LOG_DATA_BLOCK_MANAGER_HPP_
 
+#include <utility>
 #include <vector>
 
 #include "arch/types.hpp"
@@ -18,8 +19,42 @@ class log_serializer_t;
 
 class data_block_manager_t;
 
+// Decides how much to read ahead around each read of a data file.  It keeps track of
+// the last few streams of reads that move forward through the file, such as a
+// backfill or a full traversal.  A read near where one of them is expected to go
+// next continues that stream, and each time a stream continues it reads ahead twice
+// as much, up to `max_size`.  Any other read starts a new stream in place of the
+// least recently used one, which reads ahead only `min_size`, so that random reads
+// don't waste bandwidth.
+class read_ahead_detector_t {
+public:
+    read_ahead_detector_t(int64_t min_size, int64_t max_size, size_t num_streams);
+
+    // Returns how many bytes to read ahead for a read at `offset`, and whether the
+    // read continues a stream.
+    int64_t read_ahead_size(int64_t offset, bool *sequential_out);
+
+private:
+    struct stream_t {
+        stream_t() : next_offset(-1), size(0), last_use(0) { }
+        // Where the next read of the stream is expected, or -1 for an unused slot.
+        int64_t next_offset;
+        int64_t size;
+        uint64_t last_use;
+    };
+
+    const int64_t min_size;
+    const int64_t max_size;
+    std::vector<stream_t> streams;
+    uint64_t use_counter;
+
+    DISABLE_COPYING(read_ahead_detector_t);
+};
+
 class gc_entry_t;
 
+struct merged_read_block_t;
+
 struct gc_entry_less_t {
     bool operator() (const gc_entry_t *x, const gc_entry_t *y);
 };
@@ -64,9 +99,20 @@ public:
     static void prepare_initial_metablock(data_block_manager::metablock_mixin_t *mb);
     void start_existing(file_t *dbfile, data_block_manager::metablock_mixin_t *last_metablock);
 
-    void read(int64_t off_in, uint32_t ser_block_size,
+    // Reads the block `token` points to, decompressing it if necessary.  Crashes
+    // if the block doesn't match its checksum.
+    void read(const ls_block_token_pointee_t *token,
               void *buf_out, file_account_t *io_account);
 
+    // Reads the blocks `tokens` point to into `bufs_out`, like read() does.  Blocks
+    // that are close to each other on disk get read with one i/o transaction.
+    void read_many(const std::vector<const ls_block_token_pointee_t *> &tokens,
+                   const std::vector<void *> &bufs_out, file_account_t *io_account);
+
+    // Reads the block `token` points to and tells whether it matches its
+    // checksum.
+    bool verify(const ls_block_token_pointee_t *token, file_account_t *io_account);
+
     /* exposed gc api */
     /* mark a buffer as garbage */
     void mark_garbage(int64_t offset, extent_transaction_t *txn);  // Takes a real int64_t.
@@ -104,7 +150,9 @@ public:
                 iocallback_t *cb);
 
     std::vector<std::vector<counted_t<ls_block_token_pointee_t> > >
-    gimme_some_new_offsets(const std::vector<buf_write_info_t> &writes);
+    gimme_some_new_offsets(const std::vector<buf_write_info_t> &writes,
+                           const std::vector<bool> &compressed,
+                           bool for_gc);
 
 
 private:
@@ -128,6 +176,10 @@ private:
 
     bool should_perform_read_ahead(int64_t offset);
 
+    void read_merged_group(const std::vector<merged_read_block_t> *blocks,
+                           const std::vector<std::pair<size_t, size_t> > *groups,
+                           file_account_t *io_account, size_t group_index);
+
     /* internal garbage collection structures */
     struct gc_read_callback_t : public iocallback_t {
         data_block_manager_t *parent;
@@ -171,8 +223,13 @@ private:
     /* Contains every extent in the gc_entry_t::state_reconstructing state */
     intrusive_list_t<gc_entry_t> reconstructed_extents;
 
-    /* Contains the extent in the gc_entry_t::state_active state. */
+    /* Contain the extents in the gc_entry_t::state_active state.  Fresh writes go
+    to active_extent, and the blocks that the GC moves go to gc_active_extent, so
+    that (mostly cold) GC survivors don't get mixed with (mostly hot) new data.
+    Only active_extent is recorded in the metablock; on startup, a partially
+    filled gc_active_extent just becomes an old extent. */
     gc_entry_t *active_extent;
+    gc_entry_t *gc_active_extent;
 
     /* Contains every extent in the gc_entry_t::state_young state */
     intrusive_list_t<gc_entry_t> young_extent_queue;
@@ -180,6 +237,12 @@ private:
     /* Contains every extent in the gc_entry_t::state_old state */
     priority_queue_t<gc_entry_t *, gc_entry_less_t> gc_pq;
 
+    /* The time that gc_pq's cost-benefit scores measure the extents' ages
+    against.  It only moves forward in refresh_gc_scores(), which rebuilds gc_pq,
+    so that the scores don't change behind the priority queue's back. */
+    microtime_t gc_score_time;
+    void refresh_gc_scores();
+
 
     /* Buffer used during GC. */
     std::vector<gc_write_t> gc_writes;
@@ -249,6 +312,8 @@ private:
 
     gc_stats_t gc_stats;
 
+    read_ahead_detector_t read_ahead_detector;
+
     DISABLE_COPYING(data_block_manager_t);
 };
 
@@ -263,4 +328,14 @@ void unaligned_read_ahead_interval(const int64_t block_offset,
                                    int64_t *const offset_out,
                                    int64_t *const end_offset_out);
 
+// Exposed for unit tests.  Like unaligned_read_ahead_interval, but only reads ahead
+// past the block, for reads that continue a stream of forward reads.
+void unaligned_forward_read_ahead_interval(const int64_t block_offset,
+                                           const uint32_t ser_block_size,
+                                           const int64_t extent_size,
+                                           const int64_t read_ahead_size,
+                                           const std::vector<uint32_t> &boundaries,
+                                           int64_t *const offset_out,
+                                           int64_t *const end_offset_out);
+
 #endif /* SERIALIZER_LOG_DATA_BLOCK_MANAGER_HPP_ */
@@ -2,6 +2,7 @@
 #include "serializer/log/extent_manager.hpp"
 
 #include <queue>
+#include <set>
 
 #include "arch/arch.hpp"
 #include "logger.hpp"
@@ -68,13 +69,23 @@ class extent_zone_t {
     // The number of free extents in the file.
     size_t held_extents_;
 
+    // Whether we discard free extents, and the free extents that we haven't
+    // discarded yet.
+    bool discarding_;
+    std::set<size_t> undiscarded;
+
 public:
     size_t held_extents() const {
         return held_extents_;
     }
 
-    extent_zone_t(file_t *_dbfile, size_t _extent_size)
-        : extent_size(_extent_size), dbfile(_dbfile), held_extents_(0) {
+    bool discarding() const {
+        return discarding_;
+    }
+
+    extent_zone_t(file_t *_dbfile, size_t _extent_size, bool discard_freed_extents)
+        : extent_size(_extent_size), dbfile(_dbfile), held_extents_(0),
+          discarding_(discard_freed_extents) {
         // (Avoid a bunch of reallocations by resize calls (avoiding O(n log n)
         // work on average).)
         extents.reserve(dbfile->get_size() / extent_size);
@@ -98,6 +109,8 @@ public:
                 extents[extent_id].set_state(extent_info_t::state_free);
                 free_queue.push(extent_id);
                 ++held_extents_;
+                // We don't know whether it was discarded before we shut down.
+                mark_undiscarded(extent_id);
             }
         }
     }
@@ -119,6 +132,7 @@ public:
             extents.push_back(extent_info_t());
         } else {
             extent = free_queue.top() * extent_size;
+            undiscarded.erase(free_queue.top());
             free_queue.pop();
             --held_extents_;
         }
@@ -149,6 +163,7 @@ public:
             shrink_file = true;
             --held_extents_;
             extents.pop_back();
+            undiscarded.erase(extents.size());
         }
 
         if (shrink_file) {
@@ -186,19 +201,56 @@ public:
             info->set_state(extent_info_t::state_free);
             free_queue.push(offset_to_id(extent));
             ++held_extents_;
+            mark_undiscarded(offset_to_id(extent));
             try_shrink_file();
         }
     }
+
+    void mark_undiscarded(size_t extent_id) {
+        if (discarding_) {
+            undiscarded.insert(extent_id);
+        }
+    }
+
+    // Discards up to `max_extents` free extents, in as few calls as possible, and
+    // returns how many it discarded.
+    size_t discard(size_t max_extents) {
+        // gen_extent() hands out the lowest free extents first, so the highest ones
+        // are the least likely to be overwritten again soon.
+        size_t n_discarded = 0;
+        while (n_discarded < max_extents && !undiscarded.empty()) {
+            const size_t last = *undiscarded.rbegin();
+            size_t first = last;
+            while (n_discarded + (last - first) + 1 < max_extents
+                   && first > 0 && undiscarded.count(first - 1) > 0) {
+                --first;
+            }
+            undiscarded.erase(undiscarded.find(first), undiscarded.end());
+
+            if (!dbfile->discard(first * extent_size, (last - first + 1) * extent_size)) {
+                logWRN("The file system doesn't support discarding freed space. Freed "
+                       "extents will not be discarded.");
+                discarding_ = false;
+                undiscarded.clear();
+                break;
+            }
+            n_discarded += last - first + 1;
+        }
+        return n_discarded;
+    }
 };
 
 extent_manager_t::extent_manager_t(file_t *file,
                                    const log_serializer_on_disk_static_config_t *static_config,
+                                   bool discard_freed_extents,
                                    log_serializer_stats_t *_stats)
     : stats(_stats), extent_size(static_config->extent_size()),
-      state(state_reserving_extents) {
+      state(state_reserving_extents),
+      discard_budget(EXTENT_DISCARD_BURST),
+      last_discard_time(current_microtime()) {
     guarantee(divides(DEVICE_BLOCK_SIZE, extent_size));
 
-    zone.init(new extent_zone_t(file, extent_size));
+    zone.init(new extent_zone_t(file, extent_size, discard_freed_extents));
 }
 
 extent_manager_t::~extent_manager_t() {
@@ -294,6 +346,22 @@ void extent_manager_t::commit_transaction(extent_transaction_t *t) {
     for (auto it = extents.begin(); it != extents.end(); ++it) {
         zone->release_extent(std::move(*it));
     }
+    discard_freed_extents();
+}
+
+void extent_manager_t::discard_freed_extents() {
+    if (!zone->discarding()) {
+        return;
+    }
+    const microtime_t now = current_microtime();
+    discard_budget = std::min<double>(EXTENT_DISCARD_BURST,
+                                      discard_budget
+                                      + (now - last_discard_time) * EXTENT_DISCARD_RATE / 1e6);
+    last_discard_time = now;
+
+    const size_t n_discarded = zone->discard(static_cast<size_t>(discard_budget));
+    discard_budget -= n_discarded;
+    stats->pm_serializer_extents_discarded += n_discarded;
 }
 
 size_t extent_manager_t::held_extents() {
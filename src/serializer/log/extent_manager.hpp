@@ -101,6 +101,7 @@ public:
 
     extent_manager_t(file_t *file,
                      const log_serializer_on_disk_static_config_t *static_config,
+                     bool discard_freed_extents,
                      log_serializer_stats_t *);
     ~extent_manager_t();
 
@@ -121,7 +122,12 @@ public:
     manager transaction. They are only allowed to be reused after the transaction
     is committed; the log serializer only commits the transaction after the metablock
     has been written. This guarantees that we will not overwrite extents that the
-    most recent metablock points to. */
+    most recent metablock points to.
+
+    For the same reason, freed extents are only discarded (if discard_freed_extents
+    is set) when a transaction commits, and never while something else could be
+    writing to them: an extent that gets handed out again before we got around to
+    discarding it is simply not discarded. */
 
     MUST_USE extent_reference_t copy_extent_reference(const extent_reference_t &copyee);
 
@@ -141,6 +147,8 @@ public:
 
 private:
     void release_extent_preliminaries();
+    // Discards as many freed extents as the rate limit allows.
+    void discard_freed_extents();
 
     scoped_ptr_t<extent_zone_t> zone;
 
@@ -156,6 +164,10 @@ private:
 
     extent_transaction_t *current_transaction;
 
+    // How many extents we may discard right now, and when we last topped that up.
+    double discard_budget;
+    microtime_t last_discard_time;
+
     DISABLE_COPYING(extent_manager_t);
 };
 #endif /* SERIALIZER_LOG_EXTENT_MANAGER_HPP_ */
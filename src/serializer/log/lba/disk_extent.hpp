@@ -35,7 +35,9 @@ public:
     /* To read from an LBA on disk, first call read_step_1(), passing it the address of a
     new read_info_t structure. When it calls the callback you provide, then call
     read_step_2() with the same read_info_t as before and with a pointer to the
-    in_memory_index_t to be filled with data. */
+    in_memory_index_t to be filled with data. read_step_2() only touches the
+    read_info_t and the index shard of this extent's LBA shard, so it can be
+    called on a different thread than the extent manager's. */
 
     struct read_info_t {
         void *buffer;
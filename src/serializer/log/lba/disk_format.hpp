@@ -59,29 +59,46 @@ inline bool operator==(flagged_off64_t x, flagged_off64_t y) {
 
 static const block_id_t PADDING_BLOCK_ID = NULL_BLOCK_ID;
 
+// The high bit of lba_entry_t::ser_block_size marks blocks that the data block
+// manager stored compressed. The next bit marks blocks whose lba_entry_t::checksum
+// is valid (blocks written by older versions have none). The remaining bits are
+// the block's size on disk.
+static const uint32_t LBA_COMPRESSED_BLOCK_FLAG = 0x80000000;
+static const uint32_t LBA_CHECKSUMMED_BLOCK_FLAG = 0x40000000;
+
+inline uint32_t lba_ondisk_block_size(uint32_t ser_block_size) {
+    return ser_block_size & ~(LBA_COMPRESSED_BLOCK_FLAG | LBA_CHECKSUMMED_BLOCK_FLAG);
+}
+
+inline bool lba_block_is_compressed(uint32_t ser_block_size) {
+    return (ser_block_size & LBA_COMPRESSED_BLOCK_FLAG) != 0;
+}
+
+inline bool lba_block_has_checksum(uint32_t ser_block_size) {
+    return (ser_block_size & LBA_CHECKSUMMED_BLOCK_FLAG) != 0;
+}
+
 struct lba_entry_t {
     block_id_t block_id;
 
     uint32_t ser_block_size;
 
-    // TODO: Remove the need for these fields (or this zero field).  Remove the
-    // requirement that lba_entry_t be a divisor of DEVICE_BLOCK_SIZE.  When doing
-    // so, be sure to make lba entries backwards compatiblizable for now.  (We could
-    // in the future use this value being non-zero to mean the lba entry is a
-    // new-style entry.)
-    uint32_t zero2;
+    // The CRC32C of the block's bytes on disk, if ser_block_size has the
+    // LBA_CHECKSUMMED_BLOCK_FLAG.  This used to be a field that was always zero.
+    uint32_t checksum;
 
     repli_timestamp_t recency;
     // An offset into the file, with is_delete set appropriately.
     flagged_off64_t offset;
 
     static lba_entry_t make(block_id_t block_id, repli_timestamp_t recency,
-                            flagged_off64_t offset, uint32_t ser_block_size) {
+                            flagged_off64_t offset, uint32_t ser_block_size,
+                            uint32_t checksum) {
         guarantee(ser_block_size != 0 || !offset.has_value());
         lba_entry_t entry;
         entry.block_id = block_id;
         entry.ser_block_size = ser_block_size;
-        entry.zero2 = 0;
+        entry.checksum = checksum;
         entry.recency = recency;
         entry.offset = offset;
         return entry;
@@ -92,7 +109,7 @@ struct lba_entry_t {
     }
 
     static lba_entry_t make_padding_entry() {
-        return make(PADDING_BLOCK_ID, repli_timestamp_t::invalid, flagged_off64_t::padding(), 0);
+        return make(PADDING_BLOCK_ID, repli_timestamp_t::invalid, flagged_off64_t::padding(), 0, 0);
     }
 } __attribute__((__packed__));
 
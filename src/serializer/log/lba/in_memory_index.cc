@@ -7,25 +7,103 @@
 
 #include <inttypes.h>
 
+#include <algorithm>
+
 #include "serializer/log/lba/disk_format.hpp"
 
-in_memory_index_t::in_memory_index_t() : end_block_id_(0) { }
+in_memory_index_t::shard_t::shard_t() : end_block_id(0) {
+    size_classes.push_back(0);
+}
+
+uint32_t in_memory_index_t::shard_t::size_class(uint32_t ser_block_size) {
+    if (ser_block_size == 0) {
+        return 0;
+    }
+    const uint32_t existing = size_class_of.get(ser_block_size);
+    if (existing != 0) {
+        return existing - 1;
+    }
+    const uint32_t new_class = size_classes.size();
+    guarantee(new_class <= compact_block_info_t::MAX_SIZE_CLASS);
+    size_classes.push_back(ser_block_size);
+    size_class_of.set(ser_block_size, new_class + 1);
+    return new_class;
+}
+
+in_memory_index_t::in_memory_index_t() { }
 
 block_id_t in_memory_index_t::end_block_id() {
-    return end_block_id_;
+    block_id_t ret = 0;
+    for (int i = 0; i < LBA_SHARD_FACTOR; ++i) {
+        ret = std::max(ret, shards_[i].end_block_id);
+    }
+    return ret;
 }
 
 index_block_info_t in_memory_index_t::get_block_info(block_id_t id) {
-    return infos_.get(id);
+    const shard_t &shard = shards_[id % LBA_SHARD_FACTOR];
+    const block_id_t key = id / LBA_SHARD_FACTOR;
+    const compact_block_info_t compact = shard.infos.get(key);
+
+    const uint64_t offset_number
+        = compact.offset_and_size_class & compact_block_info_t::OFFSET_MASK;
+    const flagged_off64_t offset = offset_number == 0
+        ? flagged_off64_t::unused()
+        : flagged_off64_t::make((offset_number - 1) * DEVICE_BLOCK_SIZE);
+
+    const uint64_t size_class
+        = compact.offset_and_size_class >> compact_block_info_t::OFFSET_BITS;
+    rassert(size_class < shard.size_classes.size());
+
+    repli_timestamp_t recency;
+    if (compact.recency == 0) {
+        recency = repli_timestamp_t::invalid;
+    } else if (compact.recency == compact_block_info_t::RECENCY_IN_SIDE_TABLE) {
+        recency.longtime = shard.large_recencies.get(key);
+        rassert(recency.longtime != 0);
+    } else {
+        recency.longtime = compact.recency - 1;
+    }
+
+    return index_block_info_t(offset, recency, shard.size_classes[size_class],
+                              compact.checksum);
 }
 
 void in_memory_index_t::set_block_info(block_id_t id, repli_timestamp_t recency,
-                                       flagged_off64_t offset, uint32_t ser_block_size) {
-    if (id >= end_block_id_) {
-        end_block_id_ = id + 1;
+                                       flagged_off64_t offset, uint32_t ser_block_size,
+                                       uint32_t checksum) {
+    shard_t *shard = &shards_[id % LBA_SHARD_FACTOR];
+    const block_id_t key = id / LBA_SHARD_FACTOR;
+
+    if (id >= shard->end_block_id) {
+        shard->end_block_id = id + 1;
     }
 
-    index_block_info_t info(offset, recency, ser_block_size);
-    infos_.set(id, info);
-}
+    compact_block_info_t compact;
 
+    if (offset.has_value()) {
+        guarantee(divides(DEVICE_BLOCK_SIZE, offset.get_value()),
+                  "Unaligned block offset %" PRIi64, offset.get_value());
+        const uint64_t offset_number = offset.get_value() / DEVICE_BLOCK_SIZE + 1;
+        guarantee(offset_number <= compact_block_info_t::OFFSET_MASK,
+                  "Block offset %" PRIi64 " is too large", offset.get_value());
+        compact.offset_and_size_class = offset_number;
+    }
+    compact.offset_and_size_class
+        |= static_cast<uint64_t>(shard->size_class(ser_block_size))
+        << compact_block_info_t::OFFSET_BITS;
+
+    if (recency == repli_timestamp_t::invalid) {
+        compact.recency = 0;
+        shard->large_recencies.set(key, 0);
+    } else if (recency.longtime < compact_block_info_t::RECENCY_IN_SIDE_TABLE - 1) {
+        compact.recency = recency.longtime + 1;
+        shard->large_recencies.set(key, 0);
+    } else {
+        compact.recency = compact_block_info_t::RECENCY_IN_SIDE_TABLE;
+        shard->large_recencies.set(key, recency.longtime);
+    }
+
+    compact.checksum = checksum;
+    shard->infos.set(key, compact);
+}
@@ -2,6 +2,9 @@
 #ifndef SERIALIZER_LOG_LBA_IN_MEMORY_INDEX_HPP_
 #define SERIALIZER_LOG_LBA_IN_MEMORY_INDEX_HPP_
 
+#include <vector>
+
+#include "containers/open_addressed_map.hpp"
 #include "containers/two_level_array.hpp"
 #include "config/args.hpp"
 #include "serializer/serializer.hpp"
@@ -11,32 +14,96 @@ struct index_block_info_t {
     index_block_info_t()
         : offset(flagged_off64_t::unused()),
           recency(repli_timestamp_t::invalid),
-          ser_block_size(0) { }
+          ser_block_size(0),
+          checksum(0) { }
 
     index_block_info_t(flagged_off64_t _offset,
                        repli_timestamp_t _recency,
-                       uint32_t _ser_block_size)
+                       uint32_t _ser_block_size,
+                       uint32_t _checksum)
         : offset(_offset),
           recency(_recency),
-          ser_block_size(_ser_block_size) { }
+          ser_block_size(_ser_block_size),
+          checksum(_checksum) { }
 
     // For two_level_array_t.
     bool operator==(const index_block_info_t &other) const {
         return offset == other.offset &&
             recency == other.recency &&
-            ser_block_size == other.ser_block_size;
+            ser_block_size == other.ser_block_size &&
+            checksum == other.checksum;
     }
 
     flagged_off64_t offset;
     repli_timestamp_t recency;
+    // See lba_entry_t for the meaning of these.
     uint32_t ser_block_size;
+    uint32_t checksum;
 } __attribute__((__packed__));
 
 
 
+/* The in-memory index keeps one of these per block id instead of a whole
+index_block_info_t, which cuts the index's size from 24 to 16 bytes per block:
+
+ - The offset is stored as a DEVICE_BLOCK_SIZE-sized block number, plus one so
+   that 0 means flagged_off64_t::unused(). 40 bits cover 512 terabytes.
+ - Live blocks tend to share a small number of distinct ser_block_size values
+   (including the flag bits), so the index stores the position of the value in
+   a table of the values it has seen instead.
+ - repli_timestamp_t values are counters that stay far below 2^32 in practice,
+   so the index stores them in 32 bits, plus one so that 0 means
+   repli_timestamp_t::invalid. Larger values go into a sparse side table.
+
+Zero-initialized entries decode to index_block_info_t(). */
+struct compact_block_info_t {
+    compact_block_info_t() : offset_and_size_class(0), recency(0), checksum(0) { }
+
+    // For two_level_array_t.
+    bool operator==(const compact_block_info_t &other) const {
+        return offset_and_size_class == other.offset_and_size_class &&
+            recency == other.recency &&
+            checksum == other.checksum;
+    }
+
+    static const int OFFSET_BITS = 40;
+    static const uint64_t OFFSET_MASK = (1ULL << OFFSET_BITS) - 1;
+    static const uint64_t MAX_SIZE_CLASS = (1ULL << (64 - OFFSET_BITS)) - 1;
+    // The value of `recency` for recencies that live in the side table.
+    static const uint32_t RECENCY_IN_SIDE_TABLE = UINT32_MAX;
+
+    // Bits 0-39: device block number of the offset + 1; bits 40-63: size class.
+    uint64_t offset_and_size_class;
+    uint32_t recency;
+    uint32_t checksum;
+};
+
+/* The index is split into LBA_SHARD_FACTOR independent shards, by block id
+modulo LBA_SHARD_FACTOR, the same way the LBA on disk is. Different shards share
+no state, so when the LBA is loaded on startup, each shard can be filled on a
+different thread (as long as each shard is only used by one thread at a time). */
 class in_memory_index_t {
-    two_level_array_t<index_block_info_t> infos_;
-    block_id_t end_block_id_;
+    struct shard_t {
+        shard_t();
+
+        // Indexed by block id / LBA_SHARD_FACTOR.
+        two_level_array_t<compact_block_info_t> infos;
+        block_id_t end_block_id;
+
+        // Maps size classes to ser_block_size values and back. Size class 0 is
+        // ser_block_size 0. size_class_of stores size classes plus one.
+        std::vector<uint32_t> size_classes;
+        open_addressed_map_t<uint32_t> size_class_of;
+
+        // The recencies that don't fit into compact_block_info_t::recency.
+        open_addressed_map_t<uint64_t> large_recencies;
+
+        uint32_t size_class(uint32_t ser_block_size);
+
+        DISABLE_COPYING(shard_t);
+    };
+
+    shard_t shards_[LBA_SHARD_FACTOR];
 
 public:
     in_memory_index_t();
@@ -46,8 +113,10 @@ public:
 
     index_block_info_t get_block_info(block_id_t id);
     void set_block_info(block_id_t id, repli_timestamp_t recency,
-                        flagged_off64_t offset, uint32_t ser_block_size);
+                        flagged_off64_t offset, uint32_t ser_block_size,
+                        uint32_t checksum);
 
+    DISABLE_COPYING(in_memory_index_t);
 };
 
 #endif  // SERIALIZER_LOG_LBA_IN_MEMORY_INDEX_HPP_
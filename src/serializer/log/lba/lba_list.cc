@@ -81,9 +81,14 @@ public:
         rassert(cbs_out > 0);
         cbs_out--;
         if (cbs_out == 0) {
+            // Each shard gets parsed on its own thread (if there are enough
+            // threads), which makes starting up with a large LBA much faster.
+            // The shards of in_memory_index_t are independent, so this is safe.
             cbs_out = LBA_SHARD_FACTOR;
             for (int i = 0; i < LBA_SHARD_FACTOR; i++) {
-                owner->disk_structures[i]->read(&owner->in_memory_index, this);
+                const threadnum_t parse_thread(
+                    (get_thread_id().threadnum + i) % get_num_threads());
+                owner->disk_structures[i]->read(&owner->in_memory_index, parse_thread, this);
             }
         }
     }
@@ -101,7 +106,8 @@ public:
                         e->block_id,
                         e->recency,
                         e->offset,
-                        e->ser_block_size);
+                        e->ser_block_size,
+                        e->checksum);
             }
             
             owner->state = lba_list_t::state_ready;
@@ -145,7 +151,7 @@ uint32_t lba_list_t::get_ser_block_size(block_id_t block) {
 }
 
 block_size_t lba_list_t::get_block_size(block_id_t block) {
-    return block_size_t::unsafe_make(get_block_info(block).ser_block_size);
+    return block_size_t::unsafe_make(lba_ondisk_block_size(get_block_info(block).ser_block_size));
 }
 
 repli_timestamp_t lba_list_t::get_block_recency(block_id_t block) {
@@ -154,10 +160,11 @@ repli_timestamp_t lba_list_t::get_block_recency(block_id_t block) {
 
 void lba_list_t::set_block_info(block_id_t block, repli_timestamp_t recency,
                                 flagged_off64_t offset, uint32_t ser_block_size,
+                                uint32_t checksum,
                                 file_account_t *io_account, extent_transaction_t *txn) {
     rassert(state == state_ready);
 
-    in_memory_index.set_block_info(block, recency, offset, ser_block_size);
+    in_memory_index.set_block_info(block, recency, offset, ser_block_size, checksum);
 
     // If the inline LBA is full, free it up first by moving its entries to
     // the LBA extents
@@ -166,7 +173,7 @@ void lba_list_t::set_block_info(block_id_t block, repli_timestamp_t recency,
         rassert(!check_inline_lba_full());
     }
     // Then store the entry inline
-    add_inline_entry(block, recency, offset, ser_block_size);
+    add_inline_entry(block, recency, offset, ser_block_size, checksum);
 }
 
 bool lba_list_t::check_inline_lba_full() const {
@@ -204,6 +211,7 @@ void lba_list_t::move_inline_entries_to_extents(file_account_t *io_account, exte
                 e.recency,
                 e.offset,
                 e.ser_block_size,
+                e.checksum,
                 io_account,
                 txn);
     }
@@ -212,11 +220,12 @@ void lba_list_t::move_inline_entries_to_extents(file_account_t *io_account, exte
 }
 
 void lba_list_t::add_inline_entry(block_id_t block, repli_timestamp_t recency,
-                                flagged_off64_t offset, uint32_t ser_block_size) {
+                                flagged_off64_t offset, uint32_t ser_block_size,
+                                uint32_t checksum) {
     
     rassert(!check_inline_lba_full());
     inline_lba_entries[inline_lba_entries_count++] =
-            lba_entry_t::make(block, recency, offset, ser_block_size);
+            lba_entry_t::make(block, recency, offset, ser_block_size, checksum);
 }
 
 class lba_syncer_t :
@@ -294,12 +303,12 @@ public:
              id < end_id;
              id += LBA_SHARD_FACTOR) {
             block_id_t block_id = id;
-            flagged_off64_t off = owner->get_block_offset(block_id);
-            if (off.has_value()) {
-                uint32_t ser_block_size = owner->get_ser_block_size(block_id);
+            const index_block_info_t info = owner->get_block_info(block_id);
+            if (info.offset.has_value()) {
                 owner->disk_structures[i]->add_entry(block_id,
-                                                     owner->get_block_recency(block_id),
-                                                     off, ser_block_size,
+                                                     info.recency,
+                                                     info.offset, info.ser_block_size,
+                                                     info.checksum,
                                                      io_account, txn);
             }
         }
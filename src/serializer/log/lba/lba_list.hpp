@@ -53,6 +53,7 @@ public:
 
     void set_block_info(block_id_t block, repli_timestamp_t recency,
                         flagged_off64_t offset, uint32_t ser_block_size,
+                        uint32_t checksum,
                         file_account_t *io_account,
                         extent_transaction_t *txn);
 
@@ -98,7 +99,8 @@ private:
     bool check_inline_lba_full() const;
     void move_inline_entries_to_extents(file_account_t *io_account, extent_transaction_t *txn);
     void add_inline_entry(block_id_t block, repli_timestamp_t recency,
-                                flagged_off64_t offset, uint32_t ser_block_size);
+                                flagged_off64_t offset, uint32_t ser_block_size,
+                                uint32_t checksum);
     
     lba_disk_structure_t *disk_structures[LBA_SHARD_FACTOR];
 
@@ -1,11 +1,16 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
+#define __STDC_FORMAT_MACROS
 #include "serializer/log/log_serializer.hpp"
 
 #include <fcntl.h>
+#include <inttypes.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include "errors.hpp"
+#include <boost/bind.hpp>
+
 #include "arch/io/disk.hpp"
 #include "arch/runtime/runtime.hpp"
 #include "arch/runtime/coroutines.hpp"
@@ -118,12 +123,31 @@ log_serializer_stats_t::log_serializer_stats_t(perfmon_collection_t *parent)
       pm_serializer_index_writes_size(secs_to_ticks(1), false),
       pm_extents_in_use(),
       pm_bytes_in_use(),
+      pm_serializer_extents_discarded(),
       pm_serializer_lba_extents(),
       pm_serializer_data_extents(),
       pm_serializer_data_extents_allocated(),
       pm_serializer_data_extents_reclaimed(),
       pm_serializer_data_extents_gced(),
       pm_serializer_data_blocks_written(),
+      pm_serializer_data_blocks_compressed(),
+      pm_serializer_data_blocks_read_merged(),
+      pm_serializer_read_ahead_reads(),
+      pm_serializer_read_ahead_sequential_reads(),
+      pm_serializer_read_ahead_hit_ratio(&pm_serializer_read_ahead_sequential_reads,
+                                         &pm_serializer_read_ahead_reads),
+      pm_serializer_read_ahead_bytes(),
+      pm_serializer_read_ahead_bytes_wasted(),
+      pm_serializer_read_ahead_waste_ratio(&pm_serializer_read_ahead_bytes_wasted,
+                                           &pm_serializer_read_ahead_bytes),
+      pm_serializer_data_bytes_saved_by_compression(),
+      pm_serializer_data_bytes_written(),
+      pm_serializer_data_bytes_written_by_writes(),
+      pm_serializer_data_bytes_written_by_gc(),
+      pm_serializer_write_amplification(&pm_serializer_data_bytes_written,
+                                        &pm_serializer_data_bytes_written_by_writes),
+      pm_serializer_scrub_blocks_verified(),
+      pm_serializer_scrub_checksum_failures(),
       pm_serializer_old_garbage_block_bytes(),
       pm_serializer_old_total_block_bytes(),
       pm_serializer_lba_gcs(),
@@ -136,12 +160,28 @@ log_serializer_stats_t::log_serializer_stats_t(perfmon_collection_t *parent)
           &pm_serializer_index_writes_size, "serializer_index_writes_size",
           &pm_extents_in_use, "serializer_extents_in_use",
           &pm_bytes_in_use, "serializer_bytes_in_use",
+          &pm_serializer_extents_discarded, "serializer_extents_discarded",
           &pm_serializer_lba_extents, "serializer_lba_extents",
           &pm_serializer_data_extents, "serializer_data_extents",
           &pm_serializer_data_extents_allocated, "serializer_data_extents_allocated",
           &pm_serializer_data_extents_reclaimed, "serializer_data_extents_reclaimed",
           &pm_serializer_data_extents_gced, "serializer_data_extents_gced",
           &pm_serializer_data_blocks_written, "serializer_data_blocks_written",
+          &pm_serializer_data_blocks_compressed, "serializer_data_blocks_compressed",
+          &pm_serializer_data_blocks_read_merged, "serializer_data_blocks_read_merged",
+          &pm_serializer_read_ahead_reads, "serializer_read_ahead_reads",
+          &pm_serializer_read_ahead_sequential_reads, "serializer_read_ahead_sequential_reads",
+          &pm_serializer_read_ahead_hit_ratio, "serializer_read_ahead_hit_ratio",
+          &pm_serializer_read_ahead_bytes, "serializer_read_ahead_bytes",
+          &pm_serializer_read_ahead_bytes_wasted, "serializer_read_ahead_bytes_wasted",
+          &pm_serializer_read_ahead_waste_ratio, "serializer_read_ahead_waste_ratio",
+          &pm_serializer_data_bytes_saved_by_compression, "serializer_data_bytes_saved_by_compression",
+          &pm_serializer_data_bytes_written, "serializer_data_bytes_written",
+          &pm_serializer_data_bytes_written_by_writes, "serializer_data_bytes_written_by_writes",
+          &pm_serializer_data_bytes_written_by_gc, "serializer_data_bytes_written_by_gc",
+          &pm_serializer_write_amplification, "serializer_write_amplification",
+          &pm_serializer_scrub_blocks_verified, "serializer_scrub_blocks_verified",
+          &pm_serializer_scrub_checksum_failures, "serializer_scrub_checksum_failures",
           &pm_serializer_old_garbage_block_bytes, "serializer_old_garbage_block_bytes",
           &pm_serializer_old_total_block_bytes, "serializer_old_total_block_bytes",
           &pm_serializer_lba_gcs, "serializer_lba_gcs",
@@ -195,6 +235,10 @@ struct ls_start_existing_fsm_t :
         scoped_ptr_t<file_t> dbfile;
         file_opener->open_serializer_file_existing(&dbfile);
         ser->dbfile = dbfile.release();
+        ser->lba_gc_io_account.init(ser->make_io_account(LBA_GC_IO_PRIORITY,
+                                                         UNLIMITED_OUTSTANDING_REQUESTS,
+                                                         io_class_t::foreground,
+                                                         io_activity_t::lba_gc));
 
         start_existing_state = state_read_static_header;
         // STATE A above implies STATE B here
@@ -229,6 +273,7 @@ struct ls_start_existing_fsm_t :
         if (start_existing_state == state_find_metablock) {
             // STATE D
             ser->extent_manager = new extent_manager_t(ser->dbfile, &ser->static_config,
+                                                       ser->dynamic_config.discard_freed_extents,
                                                        ser->stats.get());
             {
                 // We never end up releasing the static header extent reference.  Nobody says we
@@ -350,6 +395,7 @@ log_serializer_t::log_serializer_t(dynamic_config_t _dynamic_config, serializer_
     : stats(new log_serializer_stats_t(_perfmon_collection)),  // can block in a perfmon_collection_t::add call.
       disk_stats_collection(),
       disk_stats_membership(_perfmon_collection, &disk_stats_collection, "disk"),  // can block in a perfmon_collection_t::add call.
+      io_activity_stats(&disk_stats_collection),
 #ifndef NDEBUG
       expecting_no_more_tokens(false),
 #endif
@@ -368,10 +414,19 @@ log_serializer_t::log_serializer_t(dynamic_config_t _dynamic_config, serializer_
     ls_start_existing_fsm_t *s = new ls_start_existing_fsm_t(this);
     cond_t cond;
     if (!s->run(&cond, file_opener)) cond.wait();
+
+    if (dynamic_config.scrub_on_startup) {
+        scrub_drainer.init(new auto_drainer_t);
+        coro_t::spawn_sometime(boost::bind(&log_serializer_t::scrub, this,
+                                           auto_drainer_t::lock_t(scrub_drainer.get())));
+    }
 }
 
 log_serializer_t::~log_serializer_t() {
     assert_thread();
+    // Stop the scrub before shutting down, it reads blocks.
+    scrub_drainer.reset();
+
     cond_t cond;
     if (!shutdown(&cond)) cond.wait();
 
@@ -380,28 +435,33 @@ log_serializer_t::~log_serializer_t() {
     rassert(active_write_count == 0);
 }
 
-scoped_malloc_t<ser_buffer_t> log_serializer_t::malloc() {
-    scoped_malloc_t<ser_buffer_t> buf(
-        malloc_aligned(static_config.block_size().ser_value(),
-                       DEVICE_BLOCK_SIZE));
+scoped_ser_buffer_t log_serializer_t::malloc() {
+    scoped_ser_buffer_t buf(
+        block_buffer_malloc(static_config.block_size().ser_value()));
 
     // Initialize the block sequence id...
     buf->ser_header.block_sequence_id = NULL_BLOCK_SEQUENCE_ID;
     return buf;
 }
 
-scoped_malloc_t<ser_buffer_t> log_serializer_t::clone(const ser_buffer_t *_data) {
-    scoped_malloc_t<ser_buffer_t> buf(
-        malloc_aligned(static_config.block_size().ser_value(),
-                       DEVICE_BLOCK_SIZE));
+scoped_ser_buffer_t log_serializer_t::clone(const ser_buffer_t *_data) {
+    scoped_ser_buffer_t buf(
+        block_buffer_malloc(static_config.block_size().ser_value()));
     memcpy(buf.get(), _data, static_config.block_size().ser_value());
     return buf;
 }
 
-file_account_t *log_serializer_t::make_io_account(int priority, int outstanding_requests_limit) {
+file_account_t *log_serializer_t::make_io_account(int priority, int outstanding_requests_limit,
+                                                  io_class_t io_class,
+                                                  io_activity_t activity) {
     assert_thread();
     rassert(dbfile);
-    return new file_account_t(dbfile, priority, outstanding_requests_limit);
+    return new file_account_t(dbfile, priority, outstanding_requests_limit, io_class,
+                              get_io_activity_stats(activity));
+}
+
+io_activity_stats_t *log_serializer_t::get_io_activity_stats(io_activity_t activity) {
+    return io_activity_stats.get(activity);
 }
 
 void log_serializer_t::block_read(const counted_t<ls_block_token_pointee_t> &token,
@@ -413,8 +473,29 @@ void log_serializer_t::block_read(const counted_t<ls_block_token_pointee_t> &tok
     ticks_t pm_time;
     stats->pm_serializer_block_reads.begin(&pm_time);
 
-    data_block_manager->read(token->offset_, token->block_size().ser_value(),
-                             buf, io_account);
+    data_block_manager->read(token.get(), buf, io_account);
+
+    stats->pm_serializer_block_reads.end(&pm_time);
+}
+
+void log_serializer_t::block_reads(const std::vector<counted_t<ls_block_token_pointee_t> > &tokens,
+                                   const std::vector<ser_buffer_t *> &bufs,
+                                   file_account_t *io_account) {
+    assert_thread();
+    guarantee(tokens.size() == bufs.size());
+    guarantee(state == state_ready);
+
+    ticks_t pm_time;
+    stats->pm_serializer_block_reads.begin(&pm_time);
+
+    std::vector<const ls_block_token_pointee_t *> raw_tokens;
+    raw_tokens.reserve(tokens.size());
+    for (auto it = tokens.begin(); it != tokens.end(); ++it) {
+        guarantee(it->has());
+        raw_tokens.push_back(it->get());
+    }
+    std::vector<void *> bufs_out(bufs.begin(), bufs.end());
+    data_block_manager->read_many(raw_tokens, bufs_out, io_account);
 
     stats->pm_serializer_block_reads.end(&pm_time);
 }
@@ -444,7 +525,7 @@ void log_serializer_t::index_write(const std::vector<index_write_op_t> &write_op
     stats->pm_serializer_index_writes_size.record(write_ops.size());
 
     index_write_context_t context;
-    index_write_prepare(&context, io_account);
+    index_write_prepare(&context);
 
     {
         // The in-memory index updates, at least due to the needs of
@@ -456,8 +537,10 @@ void log_serializer_t::index_write(const std::vector<index_write_op_t> &write_op
              write_op_it != write_ops.end();
              ++write_op_it) {
             const index_write_op_t& op = *write_op_it;
-            flagged_off64_t offset = lba_index->get_block_offset(op.block_id);
-            uint32_t ser_block_size = lba_index->get_ser_block_size(op.block_id);
+            const index_block_info_t old_info = lba_index->get_block_info(op.block_id);
+            flagged_off64_t offset = old_info.offset;
+            uint32_t ser_block_size = old_info.ser_block_size;
+            uint32_t checksum = old_info.checksum;
 
             if (op.token) {
                 // Update the offset pointed to, and mark garbage/liveness as necessary.
@@ -472,13 +555,23 @@ void log_serializer_t::index_write(const std::vector<index_write_op_t> &write_op
                 // Write new token to index, or remove from index as appropriate.
                 if (token.has()) {
                     offset = flagged_off64_t::make(token->offset_);
-                    ser_block_size = token->block_size().ser_value();
+                    ser_block_size = token->ondisk_block_size().ser_value();
+                    if (token->is_compressed()) {
+                        ser_block_size |= LBA_COMPRESSED_BLOCK_FLAG;
+                    }
+                    if (token->has_checksum()) {
+                        ser_block_size |= LBA_CHECKSUMMED_BLOCK_FLAG;
+                        checksum = token->checksum();
+                    } else {
+                        checksum = 0;
+                    }
 
                     /* mark the life */
-                    data_block_manager->mark_live(offset.get_value(), token->block_size());
+                    data_block_manager->mark_live(offset.get_value(), token->ondisk_block_size());
                 } else {
                     offset = flagged_off64_t::unused();
                     ser_block_size = 0;
+                    checksum = 0;
                 }
             }
 
@@ -486,7 +579,7 @@ void log_serializer_t::index_write(const std::vector<index_write_op_t> &write_op
                 : lba_index->get_block_recency(op.block_id);
 
             lba_index->set_block_info(op.block_id, recency,
-                                      offset, ser_block_size,
+                                      offset, ser_block_size, checksum,
                                       io_account, &context.extent_txn);
         }
     }
@@ -496,7 +589,7 @@ void log_serializer_t::index_write(const std::vector<index_write_op_t> &write_op
     stats->pm_serializer_index_writes.end(&pm_time);
 }
 
-void log_serializer_t::index_write_prepare(index_write_context_t *context, file_account_t *io_account) {
+void log_serializer_t::index_write_prepare(index_write_context_t *context) {
     assert_thread();
     active_write_count++;
 
@@ -504,7 +597,7 @@ void log_serializer_t::index_write_prepare(index_write_context_t *context, file_
     extent_manager->begin_transaction(&context->extent_txn);
 
     /* Just to make sure that the LBA GC gets exercised */
-    lba_index->consider_gc(io_account, &context->extent_txn);
+    lba_index->consider_gc(lba_gc_io_account.get(), &context->extent_txn);
 }
 
 void log_serializer_t::index_write_finish(index_write_context_t *context, file_account_t *io_account) {
@@ -576,12 +669,73 @@ void log_serializer_t::index_write_finish(index_write_context_t *context, file_a
 }
 
 counted_t<ls_block_token_pointee_t>
-log_serializer_t::generate_block_token(int64_t offset, block_size_t block_size) {
+log_serializer_t::generate_block_token(int64_t offset, block_size_t ondisk_block_size,
+                                       bool compressed) {
     assert_thread();
-    counted_t<ls_block_token_pointee_t> ret(new ls_block_token_pointee_t(this, offset, block_size));
+    counted_t<ls_block_token_pointee_t> ret(new ls_block_token_pointee_t(this, offset,
+                                                                         ondisk_block_size,
+                                                                         compressed));
     return ret;
 }
 
+counted_t<ls_block_token_pointee_t>
+log_serializer_t::generate_block_token_from_lba(int64_t offset, const index_block_info_t &info) {
+    counted_t<ls_block_token_pointee_t> ret
+        = generate_block_token(offset,
+                               block_size_t::unsafe_make(lba_ondisk_block_size(info.ser_block_size)),
+                               lba_block_is_compressed(info.ser_block_size));
+    if (lba_block_has_checksum(info.ser_block_size)) {
+        ret->has_checksum_ = true;
+        ret->checksum_ = info.checksum;
+    }
+    return ret;
+}
+
+void log_serializer_t::scrub(auto_drainer_t::lock_t lock) {
+    assert_thread();
+    scoped_ptr_t<file_account_t> io_account(make_io_account(SERIALIZER_SCRUB_IO_PRIORITY,
+                                                          UNLIMITED_OUTSTANDING_REQUESTS,
+                                                          io_class_t::background,
+                                                          io_activity_t::scrub));
+    int64_t num_corrupted = 0;
+
+    for (block_id_t block_id = 0; block_id < lba_index->end_block_id(); ++block_id) {
+        if (lock.get_drain_signal()->is_pulsed()) {
+            return;
+        }
+
+        const index_block_info_t info = lba_index->get_block_info(block_id);
+        if (!info.offset.has_value() || !lba_block_has_checksum(info.ser_block_size)) {
+            continue;
+        }
+
+        // The token keeps the GC from reusing the block's extent while we read it.
+        counted_t<ls_block_token_pointee_t> token
+            = generate_block_token_from_lba(info.offset.get_value(), info);
+        int64_t offset;
+        bool matches;
+        do {
+            // If the GC moved the block while we read it, we read it again.
+            offset = token->offset();
+            matches = data_block_manager->verify(token.get(), io_account.get());
+        } while (!matches && offset != token->offset());
+
+        ++stats->pm_serializer_scrub_blocks_verified;
+        if (!matches) {
+            ++stats->pm_serializer_scrub_checksum_failures;
+            ++num_corrupted;
+            logERR("Scrub: block %" PRIu64 " at offset %" PRIi64 " doesn't match its "
+                   "checksum.\n", block_id, offset);
+        }
+    }
+
+    if (num_corrupted != 0) {
+        logERR("Scrub found %" PRIi64 " corrupted blocks.\n", num_corrupted);
+    } else {
+        logINF("Scrub finished, no corrupted blocks found.\n");
+    }
+}
+
 std::vector<counted_t<ls_block_token_pointee_t> >
 log_serializer_t::block_writes(const std::vector<buf_write_info_t> &write_infos,
                                file_account_t *io_account, iocallback_t *cb) {
@@ -712,7 +866,7 @@ counted_t<ls_block_token_pointee_t> log_serializer_t::index_read(block_id_t bloc
 
     index_block_info_t info = lba_index->get_block_info(block_id);
     if (info.offset.has_value()) {
-        return generate_block_token(info.offset.get_value(), block_size_t::unsafe_make(info.ser_block_size));
+        return generate_block_token_from_lba(info.offset.get_value(), info);
     } else {
         return counted_t<ls_block_token_pointee_t>();
     }
@@ -806,6 +960,7 @@ bool log_serializer_t::next_shutdown_step() {
         delete extent_manager;
         extent_manager = NULL;
 
+        lba_gc_io_account.reset();
         delete dbfile;
         dbfile = NULL;
 
@@ -873,12 +1028,12 @@ void log_serializer_t::unregister_read_ahead_cb(serializer_read_ahead_callback_t
 
 void log_serializer_t::offer_buf_to_read_ahead_callbacks(
         block_id_t block_id,
-        scoped_malloc_t<ser_buffer_t> &&buf,
+        scoped_ser_buffer_t &&buf,
         const counted_t<standard_block_token_t>& token,
         repli_timestamp_t recency_timestamp) {
     assert_thread();
 
-    scoped_malloc_t<ser_buffer_t> local_buf = std::move(buf);
+    scoped_ser_buffer_t local_buf = std::move(buf);
     for (size_t i = 0; local_buf.has() && i < read_ahead_callbacks.size(); ++i) {
         read_ahead_callbacks[i]->offer_read_ahead_buf(block_id,
                                                       &local_buf,
@@ -893,9 +1048,16 @@ bool log_serializer_t::should_perform_read_ahead() {
 
 ls_block_token_pointee_t::ls_block_token_pointee_t(log_serializer_t *serializer,
                                                    int64_t initial_offset,
-                                                   block_size_t initial_block_size)
+                                                   block_size_t initial_ondisk_block_size,
+                                                   bool compressed)
     : serializer_(serializer), ref_count_(0),
-      block_size_(initial_block_size), offset_(initial_offset) {
+      // Only full-size blocks get compressed.
+      block_size_(compressed ? serializer->get_block_size() : initial_ondisk_block_size),
+      ondisk_block_size_(initial_ondisk_block_size),
+      compressed_(compressed),
+      has_checksum_(false),
+      checksum_(0),
+      offset_(initial_offset) {
     serializer_->assert_thread();
     serializer_->register_block_token(this, initial_offset);
 }
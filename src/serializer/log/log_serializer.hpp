@@ -9,6 +9,7 @@
 #include "serializer/serializer.hpp"
 #include "serializer/log/config.hpp"
 #include "utils.hpp"
+#include "concurrency/auto_drainer.hpp"
 #include "concurrency/mutex.hpp"
 #include "concurrency/mutex_assertion.hpp"
 
@@ -16,6 +17,7 @@
 #include "serializer/log/extent_manager.hpp"
 #include "serializer/log/lba/lba_list.hpp"
 #include "serializer/log/stats.hpp"
+#include "arch/io/disk/activity_stats.hpp"
 
 class cond_t;
 class data_block_manager_t;
@@ -135,10 +137,14 @@ public:
 
 public:
     /* Implementation of the serializer_t API */
-    scoped_malloc_t<ser_buffer_t> malloc();
-    scoped_malloc_t<ser_buffer_t> clone(const ser_buffer_t *);
+    scoped_ser_buffer_t malloc();
+    scoped_ser_buffer_t clone(const ser_buffer_t *);
 
-    file_account_t *make_io_account(int priority, int outstanding_requests_limit);
+    file_account_t *make_io_account(int priority, int outstanding_requests_limit,
+                                    io_class_t io_class, io_activity_t activity);
+
+    // Where the I/O of the accounts of `activity` on the file gets counted.
+    io_activity_stats_t *get_io_activity_stats(io_activity_t activity);
 
     void register_read_ahead_cb(serializer_read_ahead_callback_t *cb);
     void unregister_read_ahead_cb(serializer_read_ahead_callback_t *cb);
@@ -149,6 +155,8 @@ public:
     counted_t<ls_block_token_pointee_t> index_read(block_id_t block_id);
 
     void block_read(const counted_t<ls_block_token_pointee_t> &token, ser_buffer_t *buf, file_account_t *io_account);
+    void block_reads(const std::vector<counted_t<ls_block_token_pointee_t> > &tokens,
+                     const std::vector<ser_buffer_t *> &bufs, file_account_t *io_account);
 
     void index_write(const std::vector<index_write_op_t> &write_ops, file_account_t *io_account);
 
@@ -165,11 +173,20 @@ private:
     void unregister_block_token(ls_block_token_pointee_t *token);
     void remap_block_to_new_offset(int64_t current_offset, int64_t new_offset);
     counted_t<ls_block_token_pointee_t> generate_block_token(int64_t offset,
-                                                             block_size_t block_size);
+                                                             block_size_t ondisk_block_size,
+                                                             bool compressed);
+    // Makes a token for a block at `offset` with the size, flags and checksum it
+    // has in the LBA entry `info`.
+    counted_t<ls_block_token_pointee_t> generate_block_token_from_lba(int64_t offset,
+                                                                      const index_block_info_t &info);
+
+    // Reads every block that has a checksum and reports the ones that don't match
+    // it.  Runs in the background if dynamic_config.scrub_on_startup is set.
+    void scrub(auto_drainer_t::lock_t lock);
 
     void offer_buf_to_read_ahead_callbacks(
             block_id_t block_id,
-            scoped_malloc_t<ser_buffer_t> &&buf,
+            scoped_ser_buffer_t &&buf,
             const counted_t<standard_block_token_t>& token,
             repli_timestamp_t recency_timestamp);
     bool should_perform_read_ahead();
@@ -183,7 +200,7 @@ private:
         DISABLE_COPYING(index_write_context_t);
     };
     /* Starts a new transaction, updates perfmons etc. */
-    void index_write_prepare(index_write_context_t *context, file_account_t *io_account);
+    void index_write_prepare(index_write_context_t *context);
     /* Finishes a write transaction */
     void index_write_finish(index_write_context_t *context, file_account_t *io_account);
 
@@ -203,6 +220,7 @@ private:
     scoped_ptr_t<log_serializer_stats_t> stats;
     perfmon_collection_t disk_stats_collection;
     perfmon_membership_t disk_stats_membership;
+    io_activities_stats_t io_activity_stats;
 
     // TODO: Just make this available in release mode?
 #ifndef NDEBUG
@@ -235,6 +253,9 @@ private:
     } state;
 
     file_t *dbfile;
+    // The index writes garbage collect the LBA through it, rather than through the
+    // account they write through, so that the LBA GC's I/O counts apart.
+    scoped_ptr_t<file_account_t> lba_gc_io_account;
 
     extent_manager_t *extent_manager;
     mb_manager_t *metablock_manager;
@@ -251,6 +272,9 @@ private:
 
     block_sequence_id_t latest_block_sequence_id;
 
+    // Keeps the scrub alive, if there is one.
+    scoped_ptr_t<auto_drainer_t> scrub_drainer;
+
     DISABLE_COPYING(log_serializer_t);
 };
 
@@ -11,9 +11,13 @@
 #include "arch/arch.hpp"
 #include "arch/runtime/coroutines.hpp"
 #include "concurrency/cond_var.hpp"
+#include "concurrency/lock_contention.hpp"
 
 #include "serializer/log/log_serializer.hpp"
 
+// The index writes of the serializer wait here for the metablock write before.
+static lock_site_t metablock_write_lock_site("serializer.metablock_write");
+
 std::vector<int64_t> initial_metablock_offsets(int64_t extent_size) {
     std::vector<int64_t> offsets;
 
@@ -235,7 +239,7 @@ bool metablock_manager_t<metablock_t>::start_existing(file_t *file, bool *mb_fou
 }
 template<class metablock_t>
 void metablock_manager_t<metablock_t>::co_write_metablock(metablock_t *mb, file_account_t *io_account) {
-    mutex_t::acq_t hold(&write_lock);
+    mutex_t::acq_t hold(&write_lock, &metablock_write_lock_site);
 
     rassert(state == state_ready);
     rassert(!mb_buffer_in_use);
@@ -17,6 +17,7 @@ struct log_serializer_stats_t {
     /* used in serializer/log/extent_manager.cc */
     perfmon_counter_t pm_extents_in_use;
     perfmon_counter_t pm_bytes_in_use;
+    perfmon_counter_t pm_serializer_extents_discarded;
 
     /* used in serializer/log/lba/extent.cc */
     perfmon_counter_t pm_serializer_lba_extents;
@@ -27,6 +28,26 @@ struct log_serializer_stats_t {
     perfmon_counter_t pm_serializer_data_extents_reclaimed;
     perfmon_counter_t pm_serializer_data_extents_gced;
     perfmon_counter_t pm_serializer_data_blocks_written;
+    perfmon_counter_t pm_serializer_data_blocks_compressed;
+    perfmon_counter_t pm_serializer_data_blocks_read_merged;
+    perfmon_counter_t pm_serializer_read_ahead_reads;
+    perfmon_counter_t pm_serializer_read_ahead_sequential_reads;
+    // pm_serializer_read_ahead_sequential_reads / pm_serializer_read_ahead_reads
+    perfmon_counter_ratio_t pm_serializer_read_ahead_hit_ratio;
+    perfmon_counter_t pm_serializer_read_ahead_bytes;
+    perfmon_counter_t pm_serializer_read_ahead_bytes_wasted;
+    // pm_serializer_read_ahead_bytes_wasted / pm_serializer_read_ahead_bytes
+    perfmon_counter_ratio_t pm_serializer_read_ahead_waste_ratio;
+    perfmon_counter_t pm_serializer_data_bytes_saved_by_compression;
+    perfmon_counter_t pm_serializer_data_bytes_written;
+    perfmon_counter_t pm_serializer_data_bytes_written_by_writes;
+    perfmon_counter_t pm_serializer_data_bytes_written_by_gc;
+    // pm_serializer_data_bytes_written / pm_serializer_data_bytes_written_by_writes
+    perfmon_counter_ratio_t pm_serializer_write_amplification;
+
+    /* used in serializer/log/log_serializer.cc */
+    perfmon_counter_t pm_serializer_scrub_blocks_verified;
+    perfmon_counter_t pm_serializer_scrub_checksum_failures;
     perfmon_counter_t pm_serializer_old_garbage_block_bytes;
     perfmon_counter_t pm_serializer_old_total_block_bytes;
 
@@ -9,12 +9,24 @@
 
 
 
-merger_serializer_t::merger_serializer_t(scoped_ptr_t<serializer_t> _inner, int _max_active_writes) :
+merger_serializer_t::merger_serializer_t(scoped_ptr_t<serializer_t> _inner,
+                                         int _max_active_writes,
+                                         perfmon_collection_t *perfmon_collection) :
     inner(std::move(_inner)),
-    index_writes_io_account(make_io_account(MERGED_INDEX_WRITE_IO_PRIORITY)),
+    index_writes_io_account(make_io_account(MERGED_INDEX_WRITE_IO_PRIORITY,
+                                            io_activity_t::writeback)),
     on_inner_index_write_complete(new counted_cond_t()),
+    num_outstanding_index_writes(0),
     num_active_writes(0),
-    max_active_writes(_max_active_writes) {
+    max_active_writes(_max_active_writes),
+    pm_group_commits(secs_to_ticks(1)),
+    pm_group_commit_size(secs_to_ticks(1), false),
+    pm_index_write_latency(secs_to_ticks(1)),
+    stats_membership(perfmon_collection,
+        &pm_group_commits, "serializer_group_commits",
+        &pm_group_commit_size, "serializer_group_commit_size",
+        &pm_index_write_latency, "serializer_index_write_latency",
+        NULLPTR) {
 }
 
 merger_serializer_t::~merger_serializer_t() {
@@ -26,7 +38,8 @@ merger_serializer_t::~merger_serializer_t() {
 void merger_serializer_t::index_write(const std::vector<index_write_op_t> &write_ops, file_account_t *) {
     rassert(coro_t::self() != NULL);
     assert_thread();
-    
+    block_pm_duration latency_timer(&pm_index_write_latency);
+
     counted_t<counted_cond_t> write_complete;
     {
         // Our set of write ops must be processed atomically...
@@ -38,6 +51,7 @@ void merger_serializer_t::index_write(const std::vector<index_write_op_t> &write
         // so we get notified exactly when all of our write ops have
         // been completed.
         write_complete = on_inner_index_write_complete;
+        ++num_outstanding_index_writes;
     }
     
     // Check if we can initiate a new index write
@@ -59,12 +73,15 @@ void merger_serializer_t::do_index_write() {
     counted_t<counted_cond_t> write_complete;
     std::vector<index_write_op_t> write_ops;
     write_ops.reserve(outstanding_index_write_ops.size());
+    int num_index_writes;
     {
         ASSERT_NO_CORO_WAITING;
         for (auto op_pair = outstanding_index_write_ops.begin(); op_pair != outstanding_index_write_ops.end(); ++op_pair) {
             write_ops.push_back(op_pair->second);
         }
         outstanding_index_write_ops.clear();
+        num_index_writes = num_outstanding_index_writes;
+        num_outstanding_index_writes = 0;
         
         // Swap out the on_inner_index_write_complete signal so subsequent index
         // writes can be captured by the next round of do_index_write().
@@ -72,14 +89,18 @@ void merger_serializer_t::do_index_write() {
         write_complete.swap(on_inner_index_write_complete);
     }
     
-    inner->index_write(write_ops, index_writes_io_account.get());
+    pm_group_commit_size.record(num_index_writes);
+    {
+        block_pm_duration group_commit_timer(&pm_group_commits);
+        inner->index_write(write_ops, index_writes_io_account.get());
+    }
     
     write_complete->pulse();
     
     --num_active_writes;
     
     // Check if we should start another index write
-    if (num_active_writes < max_active_writes && !outstanding_index_write_ops.empty()) {
+    if (num_active_writes < max_active_writes && num_outstanding_index_writes != 0) {
         ++num_active_writes;
         coro_t::spawn_sometime(std::bind(&merger_serializer_t::do_index_write, this));
     }
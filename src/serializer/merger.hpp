@@ -8,6 +8,7 @@
 
 #include "buffer_cache/types.hpp"
 #include "containers/scoped.hpp"
+#include "perfmon/perfmon.hpp"
 #include "serializer/serializer.hpp"
 
 /* 
@@ -18,25 +19,35 @@
  * The advantage of this is that multiple index writes (e.g. coming from different
  * hash shards) can be merged together, improving efficiency and significantly
  * reducing the number of disk seeks on rotational drives.
+ *
+ * This is also the group commit of hard durability transactions: every
+ * index_write() that comes in while the inner one is in flight (with its
+ * metablock write wrapped in datasyncs) joins the next one, so the number of
+ * datasyncs doesn't grow with the number of concurrent writers.
  * 
  */
 
 class merger_serializer_t : public serializer_t {
 public:
-    merger_serializer_t(scoped_ptr_t<serializer_t> _inner, int _max_active_writes);
+    merger_serializer_t(scoped_ptr_t<serializer_t> _inner, int _max_active_writes,
+                        perfmon_collection_t *perfmon_collection);
     ~merger_serializer_t();
 
 
     /* serializer_t interface */
 
-    scoped_malloc_t<ser_buffer_t> malloc() { return inner->malloc(); }
-    scoped_malloc_t<ser_buffer_t> clone(const ser_buffer_t *b) { return inner->clone(b); }
+    scoped_ser_buffer_t malloc() { return inner->malloc(); }
+    scoped_ser_buffer_t clone(const ser_buffer_t *b) { return inner->clone(b); }
 
     /* Allocates a new io account for the underlying file.
     Use delete to free it. */
-    file_account_t *make_io_account(int priority) { return inner->make_io_account(priority); }
-    file_account_t *make_io_account(int priority, int outstanding_requests_limit) {
-        return inner->make_io_account(priority, outstanding_requests_limit);
+    file_account_t *make_io_account(int priority, io_activity_t activity) {
+        return inner->make_io_account(priority, activity);
+    }
+    file_account_t *make_io_account(int priority, int outstanding_requests_limit,
+                                    io_class_t io_class, io_activity_t activity) {
+        return inner->make_io_account(priority, outstanding_requests_limit, io_class,
+                                      activity);
     }
 
     /* Some serializer implementations support read-ahead to speed up cache warmup.
@@ -52,6 +63,11 @@ public:
         inner->block_read(token, buf, io_account);
     }
 
+    void block_reads(const std::vector<counted_t<standard_block_token_t> > &tokens,
+                     const std::vector<ser_buffer_t *> &bufs, file_account_t *io_account) {
+        inner->block_reads(tokens, bufs, io_account);
+    }
+
     /* The index stores three pieces of information for each ID:
      * 1. A pointer to a data block on disk (which may be NULL)
      * 2. A repli_timestamp_t, called the "recency"
@@ -112,9 +128,21 @@ private:
     class counted_cond_t : public cond_t, public single_threaded_countable_t<counted_cond_t> { };
     counted_t<counted_cond_t> on_inner_index_write_complete;
 
+    // How many index_write() calls wait for the next round of do_index_write().
+    int num_outstanding_index_writes;
+
     int num_active_writes;
     int max_active_writes;
 
+    // How long each of the inner index writes takes, and how many index_write()
+    // calls it carries.
+    perfmon_duration_sampler_t pm_group_commits;
+    perfmon_sampler_t pm_group_commit_size;
+    // How long index_write() calls wait, including for the group commit in
+    // flight when they come in.
+    perfmon_duration_sampler_t pm_index_write_latency;
+    perfmon_multi_membership_t stats_membership;
+
     void do_index_write();
     
     DISABLE_COPYING(merger_serializer_t);
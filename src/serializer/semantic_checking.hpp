@@ -49,10 +49,11 @@ public:
     semantic_checking_serializer_t(dynamic_config_t config, serializer_file_opener_t *file_opener, perfmon_collection_t *perfmon_collection);
     ~semantic_checking_serializer_t();
 
-    scoped_malloc_t<ser_buffer_t> malloc();
-    scoped_malloc_t<ser_buffer_t> clone(const ser_buffer_t *data);
+    scoped_ser_buffer_t malloc();
+    scoped_ser_buffer_t clone(const ser_buffer_t *data);
 
-    file_account_t *make_io_account(int priority, int outstanding_requests_limit = UNLIMITED_OUTSTANDING_REQUESTS);
+    file_account_t *make_io_account(int priority, int outstanding_requests_limit,
+                                    io_class_t io_class, io_activity_t activity);
     counted_t< scs_block_token_t<inner_serializer_t> > index_read(block_id_t block_id);
 
     void block_read(const counted_t< scs_block_token_t<inner_serializer_t> > &_token, ser_buffer_t *buf, file_account_t *io_account);
@@ -61,20 +61,20 @@ template<class inner_serializer_t>
 semantic_checking_serializer_t<inner_serializer_t>::~semantic_checking_serializer_t() { }
 
 template<class inner_serializer_t>
-scoped_malloc_t<ser_buffer_t>
+scoped_ser_buffer_t
 semantic_checking_serializer_t<inner_serializer_t>::malloc() {
     return inner_serializer.malloc();
 }
 
 template<class inner_serializer_t>
-scoped_malloc_t<ser_buffer_t>
+scoped_ser_buffer_t
 semantic_checking_serializer_t<inner_serializer_t>::clone(const ser_buffer_t *data) {
     return inner_serializer.clone(data);
 }
 
 template<class inner_serializer_t>
-file_account_t *semantic_checking_serializer_t<inner_serializer_t>::make_io_account(int priority, int outstanding_requests_limit) {
-    return inner_serializer.make_io_account(priority, outstanding_requests_limit);
+file_account_t *semantic_checking_serializer_t<inner_serializer_t>::make_io_account(int priority, int outstanding_requests_limit, io_class_t io_class, io_activity_t activity) {
+    return inner_serializer.make_io_account(priority, outstanding_requests_limit, io_class, activity);
 }
 
 template<class inner_serializer_t>
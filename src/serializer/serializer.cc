@@ -1,10 +1,32 @@
 // Copyright 2010-2012 RethinkDB, all rights reserved.
 #include "serializer/serializer.hpp"
+
+#include "errors.hpp"
+#include <boost/bind.hpp>
+
 #include "arch/arch.hpp"
+#include "concurrency/pmap.hpp"
+
+file_account_t *serializer_t::make_io_account(int priority, io_activity_t activity) {
+    assert_thread();
+    return make_io_account(priority, UNLIMITED_OUTSTANDING_REQUESTS, io_class_t::foreground,
+                           activity);
+}
+
+static void read_one_of_blocks(serializer_t *ser,
+                               const std::vector<counted_t<standard_block_token_t> > *tokens,
+                               const std::vector<ser_buffer_t *> *bufs,
+                               file_account_t *io_account, int i) {
+    ser->block_read((*tokens)[i], (*bufs)[i], io_account);
+}
 
-file_account_t *serializer_t::make_io_account(int priority) {
+void serializer_t::block_reads(const std::vector<counted_t<standard_block_token_t> > &tokens,
+                               const std::vector<ser_buffer_t *> &bufs,
+                               file_account_t *io_account) {
     assert_thread();
-    return make_io_account(priority, UNLIMITED_OUTSTANDING_REQUESTS);
+    guarantee(tokens.size() == bufs.size());
+    pmap(tokens.size(), boost::bind(&read_one_of_blocks, this, &tokens, &bufs,
+                                    io_account, _1));
 }
 
 serializer_write_t serializer_write_t::make_touch(block_id_t block_id, repli_timestamp_t recency) {
@@ -42,13 +42,15 @@ public:
     /* The buffers that are used with do_read() and do_write() must be allocated using
     these functions. They can be safely called from any thread. */
 
-    virtual scoped_malloc_t<ser_buffer_t> malloc() = 0;
-    virtual scoped_malloc_t<ser_buffer_t> clone(const ser_buffer_t *) = 0;
+    virtual scoped_ser_buffer_t malloc() = 0;
+    virtual scoped_ser_buffer_t clone(const ser_buffer_t *) = 0;
 
-    /* Allocates a new io account for the underlying file.
-    Use delete to free it. */
-    file_account_t *make_io_account(int priority);
-    virtual file_account_t *make_io_account(int priority, int outstanding_requests_limit) = 0;
+    /* Allocates a new io account for the underlying file.  Its I/O counts for
+    `activity` in the serializer's stats.  Use delete to free it. */
+    file_account_t *make_io_account(int priority, io_activity_t activity);
+    virtual file_account_t *make_io_account(int priority, int outstanding_requests_limit,
+                                            io_class_t io_class,
+                                            io_activity_t activity) = 0;
 
     /* Some serializer implementations support read-ahead to speed up cache warmup.
     This is supported through a serializer_read_ahead_callback_t which gets called whenever the serializer has read-ahead some buf.
@@ -61,6 +63,14 @@ public:
     virtual void block_read(const counted_t<standard_block_token_t> &token,
                             ser_buffer_t *buf, file_account_t *io_account) = 0;
 
+    // Reads several blocks at once, `tokens[i]` into `bufs[i]`, and blocks the
+    // coroutine until all of them are read.  Serializers that know where their
+    // blocks are on disk can merge reads of nearby blocks; by default this just
+    // reads the blocks in parallel.
+    virtual void block_reads(const std::vector<counted_t<standard_block_token_t> > &tokens,
+                             const std::vector<ser_buffer_t *> &bufs,
+                             file_account_t *io_account);
+
     /* The index stores three pieces of information for each ID:
      * 1. A pointer to a data block on disk (which may be NULL)
      * 2. A repli_timestamp_t, called the "recency"
@@ -39,7 +39,7 @@ void prep_serializer(
     on_thread_t thread_switcher(ser->home_thread());
 
     /* Write the initial configuration block */
-    scoped_malloc_t<ser_buffer_t> buf = ser->malloc();
+    scoped_ser_buffer_t buf = ser->malloc();
     multiplexer_config_block_t *c
         = reinterpret_cast<multiplexer_config_block_t *>(buf->cache_data);
 
@@ -78,7 +78,7 @@ void create_proxies(const std::vector<serializer_t *>& underlying,
     on_thread_t thread_switcher(ser->home_thread());
 
     /* Load config block */
-    scoped_malloc_t<ser_buffer_t> buf = ser->malloc();
+    scoped_ser_buffer_t buf = ser->malloc();
     ser->block_read(ser->index_read(CONFIG_BLOCK_ID.ser_id), buf.get(), DEFAULT_DISK_ACCOUNT);
     multiplexer_config_block_t *c
         = reinterpret_cast<multiplexer_config_block_t *>(buf->cache_data);
@@ -92,7 +92,11 @@ void create_proxies(const std::vector<serializer_t *>& underlying,
             "the same call to 'rethinkdb create'.");
     }
 
-    guarantee(c->n_files == static_cast<int>(underlying.size()));
+    if (c->n_files != static_cast<int>(underlying.size())) {
+        fail_due_to_user_error("The database was created with %d files, but the server was "
+            "started with %d of them. (Is one of the stripe directories missing?)",
+            c->n_files, static_cast<int>(underlying.size()));
+    }
     guarantee(c->this_serializer >= 0 && c->this_serializer < static_cast<int>(underlying.size()));
     guarantee(c->n_proxies == static_cast<int>(proxies->size()));
 
@@ -129,7 +133,7 @@ serializer_multiplexer_t::serializer_multiplexer_t(const std::vector<serializer_
         on_thread_t thread_switcher(underlying[0]->home_thread());
 
         /* Load config block */
-        scoped_malloc_t<ser_buffer_t> buf = underlying[0]->malloc();
+        scoped_ser_buffer_t buf = underlying[0]->malloc();
         underlying[0]->block_read(underlying[0]->index_read(CONFIG_BLOCK_ID.ser_id), buf.get(), DEFAULT_DISK_ACCOUNT);
 
         multiplexer_config_block_t *c
@@ -190,16 +194,18 @@ translator_serializer_t::translator_serializer_t(serializer_t *_inner, int _mod_
     rassert(mod_id < mod_count);
 }
 
-scoped_malloc_t<ser_buffer_t> translator_serializer_t::malloc() {
+scoped_ser_buffer_t translator_serializer_t::malloc() {
     return inner->malloc();
 }
 
-scoped_malloc_t<ser_buffer_t> translator_serializer_t::clone(const ser_buffer_t *data) {
+scoped_ser_buffer_t translator_serializer_t::clone(const ser_buffer_t *data) {
     return inner->clone(data);
 }
 
-file_account_t *translator_serializer_t::make_io_account(int priority, int outstanding_requests_limit) {
-    return inner->make_io_account(priority, outstanding_requests_limit);
+file_account_t *translator_serializer_t::make_io_account(int priority, int outstanding_requests_limit,
+                                                         io_class_t io_class,
+                                                         io_activity_t activity) {
+    return inner->make_io_account(priority, outstanding_requests_limit, io_class, activity);
 }
 
 void translator_serializer_t::index_write(const std::vector<index_write_op_t> &write_ops, file_account_t *io_account) {
@@ -228,6 +234,12 @@ void translator_serializer_t::block_read(const counted_t<standard_block_token_t>
     return inner->block_read(token, buf, io_account);
 }
 
+void translator_serializer_t::block_reads(const std::vector<counted_t<standard_block_token_t> > &tokens,
+                                          const std::vector<ser_buffer_t *> &bufs,
+                                          file_account_t *io_account) {
+    inner->block_reads(tokens, bufs, io_account);
+}
+
 counted_t<standard_block_token_t> translator_serializer_t::index_read(block_id_t block_id) {
     return inner->index_read(translate_block_id(block_id));
 }
@@ -270,7 +282,7 @@ bool translator_serializer_t::get_delete_bit(block_id_t id) {
 
 void translator_serializer_t::offer_read_ahead_buf(
         block_id_t block_id,
-        scoped_malloc_t<ser_buffer_t> *buf,
+        scoped_ser_buffer_t *buf,
         const counted_t<standard_block_token_t> &token,
         repli_timestamp_t recency_timestamp) {
     inner->assert_thread();
@@ -290,7 +302,7 @@ void translator_serializer_t::offer_read_ahead_buf(
 
     // Okay, we take ownership of the buf, it's ours (even if read_ahead_callback is
     // NULL).
-    scoped_malloc_t<ser_buffer_t> local_buf = std::move(*buf);
+    scoped_ser_buffer_t local_buf = std::move(*buf);
 
     if (read_ahead_callback != NULL) {
         const block_id_t inner_block_id = untranslate_block_id_to_id(block_id, mod_count, mod_id, cfgid);
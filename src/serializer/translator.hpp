@@ -110,11 +110,12 @@ public:
     are greater than or equal to 'min' and such that ((id - min) % mod_count) == mod_id. */
     translator_serializer_t(serializer_t *inner, int mod_count, int mod_id, config_block_id_t cfgid);
 
-    scoped_malloc_t<ser_buffer_t> malloc();
-    scoped_malloc_t<ser_buffer_t> clone(const ser_buffer_t *);
+    scoped_ser_buffer_t malloc();
+    scoped_ser_buffer_t clone(const ser_buffer_t *);
 
     /* Allocates a new io account for the underlying file */
-    file_account_t *make_io_account(int priority, int outstanding_requests_limit);
+    file_account_t *make_io_account(int priority, int outstanding_requests_limit,
+                                    io_class_t io_class, io_activity_t activity);
 
     void index_write(const std::vector<index_write_op_t> &write_ops, file_account_t *io_account);
 
@@ -136,11 +137,13 @@ public:
     bool get_delete_bit(block_id_t id);
 
     void block_read(const counted_t<standard_block_token_t> &token, ser_buffer_t *buf, file_account_t *io_account);
+    void block_reads(const std::vector<counted_t<standard_block_token_t> > &tokens,
+                     const std::vector<ser_buffer_t *> &bufs, file_account_t *io_account);
     counted_t<standard_block_token_t> index_read(block_id_t block_id);
 
 public:
     void offer_read_ahead_buf(block_id_t block_id,
-                              scoped_malloc_t<ser_buffer_t> *buf,
+                              scoped_ser_buffer_t *buf,
                               const counted_t<standard_block_token_t> &token,
                               repli_timestamp_t recency_timestamp);
 };
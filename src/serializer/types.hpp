@@ -15,6 +15,7 @@
 #include "containers/counted.hpp"
 #include "containers/scoped.hpp"
 #include "errors.hpp"
+#include "serializer/block_buffer_pool.hpp"
 
 // A relatively "lightweight" header file (we wish), in a sense.
 
@@ -45,6 +46,8 @@ struct ser_buffer_t {
     char cache_data[];
 } __attribute__((__packed__));
 
+// Block buffers come from the block buffer pool, see block_buffer_pool.hpp.
+typedef scoped_malloc_t<ser_buffer_t, block_buffer_free> scoped_ser_buffer_t;
 
 class block_size_t {
 public:
@@ -102,15 +105,30 @@ public:
     int64_t offset() const { return offset_; }
     block_size_t block_size() const { return block_size_; }
 
+    // How much space the block takes up on disk. This is less than block_size() if
+    // the block is stored compressed.
+    block_size_t ondisk_block_size() const { return ondisk_block_size_; }
+    bool is_compressed() const { return compressed_; }
+
+    // The CRC32C of the block's bytes on disk.  Blocks written by older versions
+    // don't have one.
+    bool has_checksum() const { return has_checksum_; }
+    uint32_t checksum() const {
+        rassert(has_checksum_);
+        return checksum_;
+    }
+
 private:
     friend class log_serializer_t;
+    friend class data_block_manager_t;  // Sets the checksums of new blocks.
     friend class dbm_read_ahead_fsm_t;  // For read-ahead tokens.
 
     friend void adjust_ref(ls_block_token_pointee_t *p, int adjustment);
 
     ls_block_token_pointee_t(log_serializer_t *serializer,
                              int64_t initial_offset,
-                             block_size_t initial_ser_block_size);
+                             block_size_t initial_ondisk_block_size,
+                             bool compressed);
 
     log_serializer_t *serializer_;
     intptr_t ref_count_;
@@ -118,6 +136,13 @@ private:
     // The block's size.
     block_size_t block_size_;
 
+    // The block's size on disk, and whether it's compressed there.
+    block_size_t ondisk_block_size_;
+    bool compressed_;
+
+    bool has_checksum_;
+    uint32_t checksum_;
+
     // The block's offset on disk.
     int64_t offset_;
 
@@ -260,7 +285,7 @@ class serializer_data_ptr_t {
 public:
     serializer_data_ptr_t() { }
     explicit serializer_data_ptr_t(void *ptr) : ptr_(ptr) { }
-    explicit serializer_data_ptr_t(scoped_malloc_t<ser_buffer_t> &&ptr)
+    explicit serializer_data_ptr_t(scoped_ser_buffer_t &&ptr)
         : ptr_(std::move(ptr)) { }
 
     void free();
@@ -291,7 +316,7 @@ public:
     }
 
 private:
-    scoped_malloc_t<ser_buffer_t> ptr_;
+    scoped_ser_buffer_t ptr_;
     DISABLE_COPYING(serializer_data_ptr_t);
 };
 
@@ -304,7 +329,7 @@ public:
     // ownership of the `ser_buffer_t *` from `*buf`.  It's also free to decline
     // ownership, by leaving the pointer owned by `*buf`.
     virtual void offer_read_ahead_buf(block_id_t block_id,
-                                      scoped_malloc_t<ser_buffer_t> *buf,
+                                      scoped_ser_buffer_t *buf,
                                       const counted_t<standard_block_token_t> &token,
                                       repli_timestamp_t recency_timestamp) = 0;
 };
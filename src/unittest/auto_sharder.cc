@@ -0,0 +1,88 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "unittest/gtest.hpp"
+
+#include "clustering/administration/auto_sharder.hpp"
+
+namespace unittest {
+
+std::vector<key_range_t> two_shards() {
+    std::vector<key_range_t> shards;
+    shards.push_back(key_range_t(key_range_t::none, store_key_t(),
+                                 key_range_t::open, store_key_t("m")));
+    shards.push_back(key_range_t(key_range_t::closed, store_key_t("m"),
+                                 key_range_t::none, store_key_t()));
+    return shards;
+}
+
+shard_sample_t make_sample(double requests_per_sec, int64_t bytes, const std::string &split_point) {
+    shard_sample_t s;
+    s.requests_per_sec = requests_per_sec;
+    s.bytes = bytes;
+    s.split_point = store_key_t(split_point);
+    return s;
+}
+
+TEST(AutoShardPolicy, SplitsAfterSeveralHotRounds) {
+    auto_shard_policy_t policy;
+    std::vector<key_range_t> shards(1, key_range_t::universe());
+    std::vector<shard_sample_t> samples(1, make_sample(3 * AUTO_SHARD_SPLIT_REQUESTS_PER_SEC, 0, "m"));
+
+    for (int i = 1; i < AUTO_SHARD_ROUNDS; ++i) {
+        EXPECT_EQ(auto_shard_policy_t::NONE, policy.observe(shards, samples, 0).action);
+    }
+    auto_shard_policy_t::proposal_t p = policy.observe(shards, samples, 0);
+    EXPECT_EQ(auto_shard_policy_t::SPLIT, p.action);
+    EXPECT_EQ(store_key_t("m"), p.key);
+}
+
+TEST(AutoShardPolicy, InterruptedStreakStartsOver) {
+    auto_shard_policy_t policy;
+    std::vector<key_range_t> shards(1, key_range_t::universe());
+    std::vector<shard_sample_t> hot(1, make_sample(3 * AUTO_SHARD_SPLIT_REQUESTS_PER_SEC, 0, "m"));
+    std::vector<shard_sample_t> quiet(1, make_sample(0, 0, "m"));
+
+    for (int i = 1; i < AUTO_SHARD_ROUNDS; ++i) {
+        EXPECT_EQ(auto_shard_policy_t::NONE, policy.observe(shards, hot, 0).action);
+    }
+    EXPECT_EQ(auto_shard_policy_t::NONE, policy.observe(shards, quiet, 0).action);
+    EXPECT_EQ(auto_shard_policy_t::NONE, policy.observe(shards, hot, 0).action);
+}
+
+TEST(AutoShardPolicy, EvenLoadIsNotSplit) {
+    /* Both shards are busy, but neither is busier than the other. */
+    auto_shard_policy_t policy;
+    std::vector<key_range_t> shards = two_shards();
+    std::vector<shard_sample_t> samples(2, make_sample(3 * AUTO_SHARD_SPLIT_REQUESTS_PER_SEC, 0, "x"));
+
+    for (int i = 0; i < 2 * AUTO_SHARD_ROUNDS; ++i) {
+        EXPECT_EQ(auto_shard_policy_t::NONE, policy.observe(shards, samples, 0).action);
+    }
+}
+
+TEST(AutoShardPolicy, WaitsOutCooldown) {
+    auto_shard_policy_t policy;
+    std::vector<key_range_t> shards(1, key_range_t::universe());
+    std::vector<shard_sample_t> samples(1, make_sample(0, 2 * AUTO_SHARD_SPLIT_BYTES, "m"));
+
+    policy.note_change(0);
+    for (int i = 0; i < AUTO_SHARD_ROUNDS; ++i) {
+        EXPECT_EQ(auto_shard_policy_t::NONE, policy.observe(shards, samples, 0).action);
+    }
+    EXPECT_EQ(auto_shard_policy_t::SPLIT,
+              policy.observe(shards, samples, secs_to_ticks(AUTO_SHARD_COOLDOWN_SECS)).action);
+}
+
+TEST(AutoShardPolicy, MergesColdNeighbours) {
+    auto_shard_policy_t policy;
+    std::vector<key_range_t> shards = two_shards();
+    std::vector<shard_sample_t> samples(2, make_sample(1, 1000, "x"));
+
+    for (int i = 1; i < AUTO_SHARD_ROUNDS; ++i) {
+        EXPECT_EQ(auto_shard_policy_t::NONE, policy.observe(shards, samples, 0).action);
+    }
+    auto_shard_policy_t::proposal_t p = policy.observe(shards, samples, 0);
+    EXPECT_EQ(auto_shard_policy_t::MERGE, p.action);
+    EXPECT_EQ(store_key_t("m"), p.key);
+}
+
+}  // namespace unittest
@@ -0,0 +1,60 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "unittest/gtest.hpp"
+
+#include "arch/timing.hpp"
+#include "clustering/immediate_consistency/branch/backfill_governor.hpp"
+#include "clustering/immediate_consistency/query/master.hpp"
+#include "concurrency/cond_var.hpp"
+#include "config/args.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+class fixed_rate_ack_checker_t : public ack_checker_t {
+public:
+    explicit fixed_rate_ack_checker_t(int64_t _bytes_per_sec) : bytes_per_sec(_bytes_per_sec) { }
+    bool is_acceptable_ack_set(const std::set<peer_id_t> &) { return true; }
+    write_durability_t get_write_durability(const peer_id_t &) const { return WRITE_DURABILITY_SOFT; }
+    int64_t get_backfill_bytes_per_sec() const { return bytes_per_sec; }
+private:
+    int64_t bytes_per_sec;
+};
+
+void run_share_test() {
+    backfill_governor_t governor(NULL);
+    EXPECT_EQ(1.0, governor.get_share());
+    EXPECT_FALSE(governor.is_rate_limited());
+
+    /* Slow foreground operations halve the share once per interval. */
+    governor.note_foreground_latency(10 * BACKFILL_TARGET_FOREGROUND_LATENCY_MS * MILLION);
+    nap(BACKFILL_GOVERNOR_INTERVAL_MS + 10);
+    EXPECT_EQ(0.5, governor.get_share());
+    EXPECT_EQ(0.5, governor.get_share());
+
+    /* Without any foreground operations it grows back. */
+    nap(BACKFILL_GOVERNOR_INTERVAL_MS + 10);
+    EXPECT_EQ(0.5 + BACKFILL_GOVERNOR_SHARE_STEP, governor.get_share());
+}
+
+TEST(BackfillGovernor, ShareFollowsForegroundLatency) {
+    run_in_thread_pool(&run_share_test);
+}
+
+void run_rate_limit_test() {
+    fixed_rate_ack_checker_t ack_checker(10 * MEGABYTE);
+    backfill_governor_t governor(&ack_checker);
+    EXPECT_TRUE(governor.is_rate_limited());
+
+    cond_t non_interruptor;
+    const ticks_t start = get_ticks();
+    governor.consume(MEGABYTE, &non_interruptor);
+    governor.consume(MEGABYTE, &non_interruptor);
+    /* Two megabytes at ten per second take at least 0.2 seconds. */
+    EXPECT_LE(0.19, ticks_to_secs(get_ticks() - start));
+}
+
+TEST(BackfillGovernor, RateLimit) {
+    run_in_thread_pool(&run_rate_limit_test);
+}
+
+}  // namespace unittest
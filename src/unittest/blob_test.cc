@@ -153,6 +153,16 @@ public:
         check(txn);
     }
 
+    void overwrite(transaction_t *txn, const std::string &x, int64_t expected_rewritten) {
+        SCOPED_TRACE(strprintf("overwrite (%zu)", x.size()));
+        ASSERT_EQ(expected_.size(), x.size());
+
+        EXPECT_EQ(expected_rewritten, blob_.overwrite_changed_bytes(x, txn));
+        expected_ = x;
+
+        check(txn);
+    }
+
     void clear(transaction_t *txn) {
         SCOPED_TRACE("clear");
         blob_.clear(txn);
@@ -188,6 +198,28 @@ private:
         special_4080_prepend_4081_test(cache);
         special_4161600_prepend_12484801_test(cache);
         combinations_test(cache);
+        overwrite_changed_bytes_test(cache);
+    }
+
+    void overwrite_changed_bytes_test(cache_t *cache) {
+        SCOPED_TRACE("overwrite_changed_bytes_test");
+        order_source_t order_source;
+        transaction_t txn(cache, rwi_write, 0, repli_timestamp_t::distant_past,
+                          order_source.check_in("overwrite_changed_bytes_test"),
+                          WRITE_DURABILITY_SOFT);
+
+        blob_tracker_t tk(251);
+        std::string value(3 * size_after_magic, 'a');
+        tk.append(&txn, value);
+
+        tk.overwrite(&txn, value, 0);
+        value[size_after_magic + 10] = 'b';
+        value[size_after_magic + 20] = 'b';
+        tk.overwrite(&txn, value, 11);
+        // Changes in two leaves are rewritten separately.
+        value[0] = 'c';
+        value[3 * size_after_magic - 1] = 'c';
+        tk.overwrite(&txn, value, 2);
     }
 
     void small_value_test(cache_t *cache) {
@@ -0,0 +1,69 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "serializer/block_buffer_pool.hpp"
+
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "config/args.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+bool is_page_aligned(void *ptr) {
+    return reinterpret_cast<uintptr_t>(ptr) % getpagesize() == 0;
+}
+
+void run_reuses_freed_buffers_test() {
+    void *a = block_buffer_malloc(4 * KILOBYTE);
+    void *b = block_buffer_malloc(4 * KILOBYTE);
+    EXPECT_TRUE(is_page_aligned(a));
+    EXPECT_TRUE(is_page_aligned(b));
+    EXPECT_NE(a, b);
+    memset(a, 0xAB, 4 * KILOBYTE);
+    memset(b, 0xCD, 4 * KILOBYTE);
+    block_buffer_free(a);
+    // The buffer freed last is the next one handed out.
+    void *c = block_buffer_malloc(4 * KILOBYTE);
+    EXPECT_EQ(a, c);
+    block_buffer_free(b);
+    block_buffer_free(c);
+}
+
+TEST(BlockBufferPoolTest, ReusesFreedBuffers) {
+    unittest::run_in_thread_pool(&run_reuses_freed_buffers_test);
+}
+
+void run_large_buffers_test() {
+    const size_t size = BLOCK_BUFFER_SLAB_SIZE + 1;
+    void *a = block_buffer_malloc(size);
+    EXPECT_TRUE(is_page_aligned(a));
+    memset(a, 0xAB, size);
+    block_buffer_free(a);
+}
+
+TEST(BlockBufferPoolTest, LargeBuffers) {
+    unittest::run_in_thread_pool(&run_large_buffers_test);
+}
+
+void run_reserved_huge_pages_test() {
+    // Works whether or not there are reserved huge pages, without them the slabs
+    // get normal pages.
+    global_block_huge_pages = block_huge_pages_t::reserved;
+    void *a = block_buffer_malloc(4 * KILOBYTE);
+    void *b = block_buffer_malloc(BLOCK_BUFFER_SLAB_SIZE);
+    global_block_huge_pages = block_huge_pages_t::off;
+    EXPECT_TRUE(is_page_aligned(a));
+    EXPECT_TRUE(is_page_aligned(b));
+    memset(a, 0xAB, 4 * KILOBYTE);
+    memset(b, 0xCD, BLOCK_BUFFER_SLAB_SIZE);
+    block_buffer_free(a);
+    block_buffer_free(b);
+}
+
+TEST(BlockBufferPoolTest, ReservedHugePages) {
+    unittest::run_in_thread_pool(&run_reserved_huge_pages_test);
+}
+
+}  // namespace unittest
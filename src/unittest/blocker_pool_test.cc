@@ -0,0 +1,68 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <unistd.h>
+
+#include "unittest/gtest.hpp"
+
+#include "arch/io/blocker_pool.hpp"
+#include "arch/runtime/thread_pool.hpp"
+#include "concurrency/cond_var.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+// Sleeps on a blocker pool thread, recording how many jobs ran at once.
+struct sleeping_job_t : public blocker_pool_t::job_t {
+    sleeping_job_t() : running(NULL), most_running(NULL), left(NULL), done_cond(NULL) { }
+    void run() {
+        int now = __sync_add_and_fetch(running, 1);
+        int most = *most_running;
+        while (now > most) {
+            const int seen = __sync_val_compare_and_swap(most_running, most, now);
+            if (seen == most) {
+                break;
+            }
+            most = seen;
+        }
+        usleep(50 * THOUSAND);
+        __sync_sub_and_fetch(running, 1);
+    }
+    void done() {
+        --*left;
+        if (*left == 0) {
+            done_cond->pulse();
+        }
+    }
+    int *running;
+    int *most_running;
+    int *left;
+    cond_t *done_cond;
+};
+
+void run_GrowsUnderLoad() {
+    const int num_jobs = 4;
+    blocker_pool_t pool(1, num_jobs, &linux_thread_pool_t::thread->queue);
+
+    int running = 0;
+    int most_running = 0;
+    int left = num_jobs;
+    cond_t done_cond;
+    sleeping_job_t jobs[num_jobs];
+    for (int i = 0; i < num_jobs; ++i) {
+        jobs[i].running = &running;
+        jobs[i].most_running = &most_running;
+        jobs[i].left = &left;
+        jobs[i].done_cond = &done_cond;
+        pool.do_job(&jobs[i]);
+    }
+    done_cond.wait();
+
+    // With one thread, they would have run one at a time.
+    ASSERT_LT(1, most_running);
+    ASSERT_GE(num_jobs, most_running);
+}
+
+TEST(BlockerPoolTest, GrowsUnderLoad) {
+    run_in_thread_pool(run_GrowsUnderLoad);
+}
+
+}  // namespace unittest
@@ -1,5 +1,6 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "unittest/gtest.hpp"
+#include "arch/timing.hpp"
 #include "clustering/immediate_consistency/branch/backfiller.hpp"
 #include "clustering/immediate_consistency/branch/backfillee.hpp"
 #include "containers/uuid.hpp"
@@ -22,7 +23,9 @@ boost::optional<boost::optional<backfiller_business_card_t<dummy_protocol_t> > >
 
 }   /* anonymous namespace */
 
-void run_backfill_test() {
+/* If `interrupt_first` is set, a first backfill gets interrupted partway
+through, and the second one has to finish it. */
+void run_backfill_test(bool interrupt_first) {
 
     order_source_t order_source;
 
@@ -109,11 +112,43 @@ void run_backfill_test() {
     backfiller_t<dummy_protocol_t> backfiller(
         cluster.get_mailbox_manager(),
         &branch_history_manager,
-        &backfiller_store);
+        &backfiller_store,
+        NULL);
 
     watchable_variable_t<boost::optional<backfiller_business_card_t<dummy_protocol_t> > > pseudo_directory(
         boost::optional<backfiller_business_card_t<dummy_protocol_t> >(backfiller.get_business_card()));
 
+    if (interrupt_first) {
+        signal_timer_t timer;
+        timer.start(30);
+        try {
+            backfillee<dummy_protocol_t>(
+                cluster.get_mailbox_manager(),
+                &branch_history_manager,
+                &backfillee_store,
+                backfillee_store.get_region(),
+                pseudo_directory.get_watchable()->subview(&wrap_in_optional),
+                generate_uuid(),
+                NULL,
+                &timer);
+        } catch (const interrupted_exc_t &) {
+        }
+
+        /* Every key that the metainfo says is done must really be done. */
+        region_map_t<dummy_protocol_t, version_range_t> partial_metainfo =
+            region_map_transform<dummy_protocol_t, binary_blob_t, version_range_t>(
+                backfillee_store.metainfo, &binary_blob_t::get<version_range_t>);
+        for (region_map_t<dummy_protocol_t, version_range_t>::const_iterator it = partial_metainfo.begin();
+             it != partial_metainfo.end();
+             ++it) {
+            if (it->second.is_coherent() && it->second.earliest.timestamp == timestamp) {
+                for (std::set<std::string>::const_iterator k = it->first.keys.begin(); k != it->first.keys.end(); ++k) {
+                    EXPECT_EQ(backfiller_store.values[*k], backfillee_store.values[*k]);
+                }
+            }
+        }
+    }
+
     /* Run a backfill */
 
     cond_t interruptor;
@@ -124,6 +159,7 @@ void run_backfill_test() {
         backfillee_store.get_region(),
         pseudo_directory.get_watchable()->subview(&wrap_in_optional),
         generate_uuid(),
+        NULL,
         &interruptor);
 
     /* Make sure everything got transferred properly */
@@ -163,7 +199,11 @@ void run_backfill_test() {
     //EXPECT_EQ(timestamp, backfillee_metadata[0].second.earliest.timestamp);
 }
 TEST(ClusteringBackfill, BackfillTest) {
-    unittest::run_in_thread_pool(&run_backfill_test);
+    unittest::run_in_thread_pool(boost::bind(&run_backfill_test, false));
+}
+
+TEST(ClusteringBackfill, ResumeAfterInterruption) {
+    unittest::run_in_thread_pool(boost::bind(&run_backfill_test, true));
 }
 
 }   /* namespace unittest */
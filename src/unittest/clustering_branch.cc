@@ -73,6 +73,7 @@ void run_with_broadcaster(
                                          &branch_history_manager,
                                          broadcaster.get(),
                                          &get_global_perfmon_collection(),
+                                         NULL,
                                          &interruptor,
                                          &order_source));
 
@@ -222,9 +223,12 @@ void run_backfill_test(io_backender_t *io_backender,
         broadcaster_metadata_view->subview(&wrap_broadcaster_in_optional),
         branch_history_manager,
         &store2.store,
-        replier_directory_controller.get_watchable()->subview(&wrap_replier_in_optional),
+        std::vector<listener_t<dummy_protocol_t>::replier_watchable_t>(1,
+            replier_directory_controller.get_watchable()->subview(&wrap_replier_in_optional)),
         generate_uuid(),
+        false,
         &get_global_perfmon_collection(),
+        NULL,
         &interruptor,
         order_source);
 
@@ -288,9 +292,12 @@ void run_partial_backfill_test(io_backender_t *io_backender,
         broadcaster_metadata_view->subview(&wrap_broadcaster_in_optional),
         branch_history_manager,
         &store2.store,
-        replier_directory_controller.get_watchable()->subview(&wrap_replier_in_optional),
+        std::vector<listener_t<dummy_protocol_t>::replier_watchable_t>(1,
+            replier_directory_controller.get_watchable()->subview(&wrap_replier_in_optional)),
         generate_uuid(),
+        false,
         &get_global_perfmon_collection(),
+        NULL,
         &interruptor,
         order_source);
 
@@ -318,4 +325,98 @@ TEST(ClusteringBranch, PartialBackfill) {
     run_in_thread_pool_with_broadcaster(&run_partial_backfill_test);
 }
 
+/* `MultiSourceBackfill` backfills a third mirror from the first two at once. */
+
+void run_multi_source_backfill_test(io_backender_t *io_backender,
+                                    simple_mailbox_cluster_t *cluster,
+                                    branch_history_manager_t<dummy_protocol_t> *branch_history_manager,
+                                    clone_ptr_t<watchable_t<boost::optional<broadcaster_business_card_t<dummy_protocol_t> > > > broadcaster_metadata_view,
+                                    scoped_ptr_t<broadcaster_t<dummy_protocol_t> > *broadcaster,
+                                    test_store_t<dummy_protocol_t> *store1,
+                                    scoped_ptr_t<listener_t<dummy_protocol_t> > *initial_listener,
+                                    order_source_t *order_source) {
+    /* Set up a replier so the broadcaster can handle operations */
+    EXPECT_FALSE((*initial_listener)->get_broadcaster_lost_signal()->is_pulsed());
+    replier_t<dummy_protocol_t> replier(initial_listener->get(), cluster->get_mailbox_manager(), branch_history_manager);
+
+    watchable_variable_t<boost::optional<replier_business_card_t<dummy_protocol_t> > > replier_directory_controller(
+        boost::optional<replier_business_card_t<dummy_protocol_t> >(replier.get_business_card()));
+
+    /* Start sending operations to the broadcaster */
+    std::map<std::string, std::string> inserter_state;
+    test_inserter_t inserter(
+        boost::bind(&write_to_broadcaster, broadcaster->get(), _1, _2, _3, _4),
+        NULL,
+        &dummy_key_gen,
+        order_source,
+        "run_multi_source_backfill_test/inserter",
+        &inserter_state);
+    nap(100);
+
+    /* Set up a second mirror with its own replier */
+    test_store_t<dummy_protocol_t> store2(io_backender, order_source, static_cast<dummy_protocol_t::context_t *>(NULL));
+    cond_t interruptor;
+    listener_t<dummy_protocol_t> listener2(
+        base_path_t("."),
+        io_backender,
+        cluster->get_mailbox_manager(),
+        broadcaster_metadata_view->subview(&wrap_broadcaster_in_optional),
+        branch_history_manager,
+        &store2.store,
+        std::vector<listener_t<dummy_protocol_t>::replier_watchable_t>(1,
+            replier_directory_controller.get_watchable()->subview(&wrap_replier_in_optional)),
+        generate_uuid(),
+        false,
+        &get_global_perfmon_collection(),
+        NULL,
+        &interruptor,
+        order_source);
+    replier_t<dummy_protocol_t> replier2(&listener2, cluster->get_mailbox_manager(), branch_history_manager);
+
+    watchable_variable_t<boost::optional<replier_business_card_t<dummy_protocol_t> > > replier2_directory_controller(
+        boost::optional<replier_business_card_t<dummy_protocol_t> >(replier2.get_business_card()));
+    nap(100);
+
+    /* Set up a third mirror that backfills from both of them */
+    std::vector<listener_t<dummy_protocol_t>::replier_watchable_t> repliers;
+    repliers.push_back(replier_directory_controller.get_watchable()->subview(&wrap_replier_in_optional));
+    repliers.push_back(replier2_directory_controller.get_watchable()->subview(&wrap_replier_in_optional));
+
+    test_store_t<dummy_protocol_t> store3(io_backender, order_source, static_cast<dummy_protocol_t::context_t *>(NULL));
+    listener_t<dummy_protocol_t> listener3(
+        base_path_t("."),
+        io_backender,
+        cluster->get_mailbox_manager(),
+        broadcaster_metadata_view->subview(&wrap_broadcaster_in_optional),
+        branch_history_manager,
+        &store3.store,
+        repliers,
+        generate_uuid(),
+        false,
+        &get_global_perfmon_collection(),
+        NULL,
+        &interruptor,
+        order_source);
+
+    EXPECT_FALSE(listener2.get_broadcaster_lost_signal()->is_pulsed());
+    EXPECT_FALSE(listener3.get_broadcaster_lost_signal()->is_pulsed());
+
+    nap(100);
+
+    /* Stop the inserter, then let any lingering writes finish */
+    inserter.stop();
+    let_stuff_happen();
+
+    /* Confirm that all three mirrors have all of the writes */
+    for (std::map<std::string, std::string>::iterator it = inserter.values_inserted->begin();
+            it != inserter.values_inserted->end(); it++) {
+        EXPECT_EQ(it->second, store1->store.values[it->first]);
+        EXPECT_EQ(it->second, store2.store.values[it->first]);
+        EXPECT_EQ(it->second, store3.store.values[it->first]);
+    }
+}
+TEST(ClusteringBranch, MultiSourceBackfill) {
+    run_in_thread_pool_with_broadcaster(&run_multi_source_backfill_test);
+}
+
 }   /* namespace unittest */
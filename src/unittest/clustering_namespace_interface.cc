@@ -83,5 +83,52 @@ TEST(ClusteringNamespaceInterface, ReadOutdated) {
     unittest::run_in_thread_pool(&run_read_outdated_test);
 }
 
+static void run_masters_move_test() {
+    test_cluster_group_t<dummy_protocol_t> cluster_group(2);
+
+    cluster_group.construct_all_reactors(cluster_group.compile_blueprint("ps,sp"));
+    cluster_group.wait_until_blueprint_is_satisfied("ps,sp");
+
+    /* The same namespace interface keeps working after both masters move, so
+    its routes must have followed them. */
+    scoped_ptr_t<cluster_namespace_interface_t<dummy_protocol_t> > namespace_if;
+    cluster_group.make_namespace_interface(0, &namespace_if);
+
+    order_source_t order_source;
+    cond_t non_interruptor;
+    dummy_protocol_t::write_t w;
+    dummy_protocol_t::write_response_t wr;
+    w.values["a"] = "b";
+    w.values["z"] = "y";
+    namespace_if->write(w, &wr, order_source.check_in("unittest::run_masters_move_test(A)"), &non_interruptor);
+
+    cluster_group.set_all_blueprints(cluster_group.compile_blueprint("sp,ps"));
+    cluster_group.wait_until_blueprint_is_satisfied("sp,ps");
+
+    /* The namespace interface may take a moment to connect to the new masters. */
+    bool written = false;
+    for (int i = 0; i < 100 && !written; ++i) {
+        try {
+            namespace_if->write(w, &wr, order_source.check_in("unittest::run_masters_move_test(B)"), &non_interruptor);
+            written = true;
+        } catch (const cannot_perform_query_exc_t &) {
+            nap(50);
+        }
+    }
+    EXPECT_TRUE(written);
+
+    dummy_protocol_t::read_t r;
+    dummy_protocol_t::read_response_t rr;
+    r.keys.keys.insert("a");
+    r.keys.keys.insert("z");
+    namespace_if->read(r, &rr, order_source.check_in("unittest::run_masters_move_test(C)").with_read_mode(), &non_interruptor);
+    EXPECT_EQ("b", rr.values["a"]);
+    EXPECT_EQ("y", rr.values["z"]);
+}
+
+TEST(ClusteringNamespaceInterface, MastersMove) {
+    unittest::run_in_thread_pool(&run_masters_move_test);
+}
+
 }   /* namespace unittest */
 
@@ -59,6 +59,7 @@ static void run_read_write_test() {
         &branch_history_manager,
         &broadcaster,
         &get_global_perfmon_collection(),
+        NULL,
         &interruptor,
         &order_source);
 
@@ -74,7 +75,7 @@ static void run_read_write_test() {
             return WRITE_DURABILITY_SOFT;
         }
     } ack_checker;
-    master_t<dummy_protocol_t> master(cluster.get_mailbox_manager(), &ack_checker, mock::a_thru_z_region(), &broadcaster);
+    master_t<dummy_protocol_t> master(cluster.get_mailbox_manager(), &ack_checker, mock::a_thru_z_region(), &broadcaster, &get_global_perfmon_collection());
 
     /* Set up a master access */
     watchable_variable_t<boost::optional<boost::optional<master_business_card_t<dummy_protocol_t> > > > master_directory_view(
@@ -151,6 +152,7 @@ static void run_broadcaster_problem_test() {
         &branch_history_manager,
         &broadcaster,
         &get_global_perfmon_collection(),
+        NULL,
         &interruptor,
         &order_source);
 
@@ -167,7 +169,7 @@ static void run_broadcaster_problem_test() {
             return WRITE_DURABILITY_SOFT;
         }
     } ack_checker;
-    master_t<dummy_protocol_t> master(cluster.get_mailbox_manager(), &ack_checker, mock::a_thru_z_region(), &broadcaster);
+    master_t<dummy_protocol_t> master(cluster.get_mailbox_manager(), &ack_checker, mock::a_thru_z_region(), &broadcaster, &get_global_perfmon_collection());
 
     /* Set up a master access */
     watchable_variable_t<boost::optional<boost::optional<master_business_card_t<dummy_protocol_t> > > > master_directory_view(
@@ -105,6 +105,22 @@ TEST(ClusteringReactor, AddSecondaryTest) {
     unittest::run_in_thread_pool(&runAddSecondaryTest);
 }
 
+void runAsyncSecondaryTest() {
+    test_cluster_group_t<dummy_protocol_t> cluster_group(3);
+    cluster_group.construct_all_reactors(cluster_group.compile_blueprint("p,s,a"));
+    cluster_group.wait_until_blueprint_is_satisfied("p,s,a");
+    cluster_group.run_queries();
+
+    /* An async secondary can be promoted to an ordinary one. */
+    cluster_group.set_all_blueprints(cluster_group.compile_blueprint("p,s,s"));
+    cluster_group.wait_until_blueprint_is_satisfied("p,s,s");
+    cluster_group.run_queries();
+}
+
+TEST(ClusteringReactor, AsyncSecondaryTest) {
+    unittest::run_in_thread_pool(&runAsyncSecondaryTest);
+}
+
 void runReshardingTest() {
     test_cluster_group_t<dummy_protocol_t> cluster_group(2);
 
@@ -1,6 +1,7 @@
 // Copyright 2010-2012 RethinkDB, all rights reserved.
 #include "unittest/gtest.hpp"
 
+#include "clustering/administration/machine_load.hpp"
 #include "clustering/suggester/suggester.hpp"
 #include "clustering/generic/nonoverlapping_regions.hpp"
 #include "mock/dummy_protocol.hpp"
@@ -51,10 +52,58 @@ TEST(ClusteringSuggester, NewNamespace) {
         machine_data_centers,
         region_map_t<dummy_protocol_t, machine_id_t>(dummy_protocol_t::region_t::universe(), nil_uuid()),
         region_map_t<dummy_protocol_t, std::set<machine_id_t> >(),
+        std::map<machine_id_t, double>(),
         &usage,
         true);
 
     EXPECT_EQ(machines.size(), blueprint.machines_roles.size());
 }
 
+TEST(ClusteringSuggester, AvoidsBusyMachines) {
+    std::vector<machine_id_t> machines;
+    std::map<machine_id_t, reactor_business_card_t<dummy_protocol_t> > directory;
+    std::map<machine_id_t, datacenter_id_t> machine_data_centers;
+    std::map<machine_id_t, machine_load_t> loads;
+    for (int i = 0; i < 4; i++) {
+        machines.push_back(generate_uuid());
+        reactor_business_card_t<dummy_protocol_t> rb;
+        rb.activities[generate_uuid()] = reactor_business_card_t<dummy_protocol_t>::activity_entry_t(a_thru_z_region(), reactor_business_card_t<dummy_protocol_t>::nothing_t());
+        directory[machines[i]] = rb;
+        machine_data_centers[machines[i]] = nil_uuid();
+        loads[machines[i]] = machine_load_t();
+    }
+    /* The first two machines serve all of the traffic. */
+    loads[machines[0]].reads_per_sec = 1000;
+    loads[machines[0]].writes_per_sec = 1000;
+    loads[machines[1]].reads_per_sec = 1000;
+    loads[machines[1]].writes_per_sec = 1000;
+    std::map<machine_id_t, double> scores = compute_machine_load_scores(loads);
+    EXPECT_LT(scores[machines[2]], scores[machines[0]]);
+    EXPECT_EQ(scores[machines[2]], scores[machines[3]]);
+
+    std::map<datacenter_id_t, int> affinities;
+    affinities[nil_uuid()] = 1;
+
+    nonoverlapping_regions_t<dummy_protocol_t> shards;
+    ASSERT_TRUE(shards.add_region(a_thru_z_region()));
+
+    std::map<machine_id_t, int> usage;
+    persistable_blueprint_t<dummy_protocol_t> blueprint = suggest_blueprint<dummy_protocol_t>(
+        directory,
+        nil_uuid(),
+        affinities,
+        shards,
+        machine_data_centers,
+        region_map_t<dummy_protocol_t, machine_id_t>(dummy_protocol_t::region_t::universe(), nil_uuid()),
+        region_map_t<dummy_protocol_t, std::set<machine_id_t> >(),
+        scores,
+        &usage,
+        true);
+
+    EXPECT_EQ(0, usage[machines[0]]);
+    EXPECT_EQ(0, usage[machines[1]]);
+    EXPECT_EQ(1, usage[machines[2]]);
+    EXPECT_EQ(1, usage[machines[3]]);
+}
+
 }  // namespace unittest
@@ -0,0 +1,78 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include <string>
+#include <vector>
+
+#include "compression.hpp"
+#include "unittest/gtest.hpp"
+#include "utils.hpp"
+
+namespace unittest {
+
+std::string compress_string(const std::string &s) {
+    std::vector<char> buf(lz_compress_bound(s.size()));
+    size_t size = lz_compress(s.data(), s.size(), buf.data(), buf.size());
+    EXPECT_NE(0u, size);
+    return std::string(buf.data(), size);
+}
+
+void check_roundtrip(const std::string &s) {
+    std::string compressed = compress_string(s);
+    std::string decompressed(s.size(), '\0');
+    ASSERT_TRUE(lz_decompress(compressed.data(), compressed.size(),
+                              &decompressed[0], decompressed.size()));
+    EXPECT_EQ(s, decompressed);
+}
+
+TEST(CompressionTest, Roundtrip) {
+    check_roundtrip("");
+    check_roundtrip("a");
+    check_roundtrip("abcabcabcabcabcabcabcabcabcabcabcabcabc");
+    check_roundtrip(std::string(100000, 'x'));
+
+    for (int i = 0; i < 100; ++i) {
+        const size_t size = randint(10000);
+        std::string random(size, '\0');
+        std::string repetitive(size, '\0');
+        for (size_t j = 0; j < size; ++j) {
+            random[j] = randint(256);
+            repetitive[j] = "{\"id\": 1234, \"name\": \"x\"}"[randint(8)];
+        }
+        check_roundtrip(random);
+        check_roundtrip(repetitive);
+    }
+}
+
+TEST(CompressionTest, CompressesRepetitiveData) {
+    std::string s;
+    for (int i = 0; i < 100; ++i) {
+        s += strprintf("{\"id\": %d, \"name\": \"some name\", \"tags\": []}", i);
+    }
+    EXPECT_LT(compress_string(s).size(), s.size() / 3);
+}
+
+TEST(CompressionTest, RespectsCapacity) {
+    std::string s(4096, '\0');
+    for (size_t i = 0; i < s.size(); ++i) {
+        s[i] = randint(256);
+    }
+    std::vector<char> buf(s.size() / 2);
+    EXPECT_EQ(0u, lz_compress(s.data(), s.size(), buf.data(), buf.size()));
+}
+
+TEST(CompressionTest, RejectsMalformedData) {
+    const std::string s = strprintf("%s%s%s", std::string(1000, 'a').c_str(),
+                                    "some text in between",
+                                    std::string(1000, 'b').c_str());
+    const std::string compressed = compress_string(s);
+    std::string decompressed(s.size(), '\0');
+
+    // Truncated input.
+    for (size_t i = 0; i < compressed.size(); ++i) {
+        EXPECT_FALSE(lz_decompress(compressed.data(), i, &decompressed[0], decompressed.size()));
+    }
+    // Wrong output size.
+    EXPECT_FALSE(lz_decompress(compressed.data(), compressed.size(),
+                               &decompressed[0], decompressed.size() - 1));
+}
+
+}  // namespace unittest
@@ -0,0 +1,60 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "containers/counted.hpp"
+
+#include "arch/runtime/coroutines.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+class biased_counted_t : public biased_countable_t<biased_counted_t> {
+public:
+    explicit biased_counted_t(bool *_destroyed) : destroyed(_destroyed) { }
+    ~biased_counted_t() { *destroyed = true; }
+private:
+    bool *destroyed;
+};
+
+void run_counts_other_threads_references_test() {
+    bool destroyed = false;
+    counted_t<biased_counted_t> p = make_counted<biased_counted_t>(&destroyed);
+    counted_t<biased_counted_t> q, r;
+    {
+        on_thread_t switcher(threadnum_t(1));
+        q = p;
+        r = q;
+    }
+    EXPECT_EQ(3, counted_use_count(p.get()));
+    // The object isn't owned once the owning thread drops its references.
+    p.reset();
+    EXPECT_FALSE(destroyed);
+    EXPECT_EQ(2, counted_use_count(q.get()));
+    q.reset();
+    EXPECT_FALSE(destroyed);
+    r.reset();
+    EXPECT_TRUE(destroyed);
+}
+
+TEST(CountedTest, BiasedCountsOtherThreadsReferences) {
+    unittest::run_in_thread_pool(&run_counts_other_threads_references_test, 2);
+}
+
+void run_drops_owned_reference_on_other_thread_test() {
+    bool destroyed = false;
+    counted_t<biased_counted_t> p = make_counted<biased_counted_t>(&destroyed);
+    {
+        on_thread_t switcher(threadnum_t(1));
+        // Counted by the owning thread, so it drops it there.
+        p.reset();
+    }
+    for (int i = 0; i < 100 && !destroyed; ++i) {
+        coro_t::yield();
+    }
+    EXPECT_TRUE(destroyed);
+}
+
+TEST(CountedTest, BiasedDropsOwnedReferenceOnOtherThread) {
+    unittest::run_in_thread_pool(&run_drops_owned_reference_on_other_thread_test, 2);
+}
+
+}  // namespace unittest
@@ -0,0 +1,41 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include <string>
+
+#include "crc32c.hpp"
+#include "unittest/gtest.hpp"
+#include "utils.hpp"
+
+namespace unittest {
+
+TEST(Crc32cTest, KnownValues) {
+    EXPECT_EQ(0u, crc32c("", 0));
+    EXPECT_EQ(0xE3069283u, crc32c("123456789", 9));
+    // Test vectors from RFC 3720.
+    EXPECT_EQ(0x8A9136AAu, crc32c(std::string(32, '\x00').data(), 32));
+    EXPECT_EQ(0x62A8AB43u, crc32c(std::string(32, '\xff').data(), 32));
+}
+
+TEST(Crc32cTest, Incremental) {
+    std::string s(10000, '\0');
+    for (size_t i = 0; i < s.size(); ++i) {
+        s[i] = randint(256);
+    }
+    const uint32_t whole = crc32c(s.data(), s.size());
+    for (int i = 0; i < 100; ++i) {
+        const size_t split = randint(s.size() + 1);
+        EXPECT_EQ(whole, crc32c(s.data() + split, s.size() - split,
+                                crc32c(s.data(), split)));
+    }
+}
+
+TEST(Crc32cTest, DetectsBitFlips) {
+    std::string s(4096, 'x');
+    const uint32_t original = crc32c(s.data(), s.size());
+    for (size_t i = 0; i < s.size(); i += 97) {
+        s[i] ^= 1;
+        EXPECT_NE(original, crc32c(s.data(), s.size()));
+        s[i] ^= 1;
+    }
+}
+
+}  // namespace unittest
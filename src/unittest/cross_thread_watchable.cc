@@ -66,4 +66,47 @@ TEST(CrossThreadWatchable, CrossThreadWatchableTest) {
     unittest::run_in_thread_pool(&runCrossThreadWatchabletest, 2);
 }
 
+void count_change(int *count) {
+    ++*count;
+}
+
+void run_coalesces_changes_test() {
+    boost::scoped_ptr<watchable_variable_t<int> > watchable;
+    boost::scoped_ptr<cross_thread_watchable_variable_t<int> > ctw;
+    {
+        on_thread_t thread_switcher(threadnum_t(0));
+        watchable.reset(new watchable_variable_t<int>(0));
+        ctw.reset(new cross_thread_watchable_variable_t<int>(watchable->get_watchable(), threadnum_t(1)));
+    }
+
+    int changes = 0;
+    {
+        on_thread_t switcher(threadnum_t(1));
+        watchable_t<int>::freeze_t freeze(ctw->get_watchable());
+        watchable_t<int>::subscription_t subs(boost::bind(&count_change, &changes),
+                                              ctw->get_watchable(), &freeze);
+        {
+            on_thread_t switcher2(threadnum_t(0));
+            // The delivery can't start before this coroutine yields.
+            for (int i = 1; i <= 100; ++i) {
+                watchable->set_value(i);
+            }
+        }
+        signal_timer_t timer;
+        timer.start(5000);
+        ctw->get_watchable()->run_until_satisfied(boost::bind(&equals, 100, _1), &timer);
+    }
+    EXPECT_EQ(1, changes);
+
+    {
+        on_thread_t thread_switcher(threadnum_t(0));
+        ctw.reset();
+        watchable.reset();
+    }
+}
+
+TEST(CrossThreadWatchable, CoalescesChanges) {
+    unittest::run_in_thread_pool(&run_coalesces_changes_test, 2);
+}
+
 } //namespace unittest
@@ -1,23 +1,41 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 
+#include <set>
+
+#include "errors.hpp"
+#include <boost/bind.hpp>
+
 #include "containers/archive/string_stream.hpp"
+#include "rdb_protocol/aggregation.hpp"
 #include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/datum_json.hpp"
+#include "rdb_protocol/env.hpp"
+#include "rdb_protocol/minidriver.hpp"
+#include "rdb_protocol/term.hpp"
 #include "unittest/gtest.hpp"
+#include "unittest/rdb_env.hpp"
+#include "unittest/unittest_utils.hpp"
 
 
 namespace unittest {
 
-void test_datum_serialization(const counted_t<const ql::datum_t> datum) {
+void serialize_and_deserialize(const counted_t<const ql::datum_t> &datum,
+                               counted_t<const ql::datum_t> *deserialized_out) {
     string_stream_t write_stream;
     write_message_t wm;
     wm << datum;
+    ASSERT_EQ(wm.size(), serialized_size(datum));
     int write_res = send_write_message(&write_stream, &wm);
     ASSERT_EQ(0, write_res);
 
     string_read_stream_t read_stream(std::move(write_stream.str()), 0);
-    counted_t<const ql::datum_t> deserialized_datum;
-    archive_result_t res = deserialize(&read_stream, &deserialized_datum);
+    archive_result_t res = deserialize(&read_stream, deserialized_out);
     ASSERT_EQ(ARCHIVE_SUCCESS, res);
+}
+
+void test_datum_serialization(const counted_t<const ql::datum_t> datum) {
+    counted_t<const ql::datum_t> deserialized_datum;
+    serialize_and_deserialize(datum, &deserialized_datum);
     ASSERT_EQ(datum, deserialized_datum);
 }
 
@@ -62,6 +80,372 @@ TEST(DatumTest, NumericSerialization) {
     test_datum_serialization(make_counted<ql::datum_t>(std::move(vec)));
 }
 
+TEST(DatumTest, IntegerNumbers) {
+    double ints[] = { 0.0, -0.0, 3.0, -3.0, (1ull << 53), -static_cast<double>(1ull << 53) };
+    for (size_t i = 0; i < sizeof(ints) / sizeof(ints[0]); ++i) {
+        ql::datum_t datum(ints[i]);
+        int64_t value;
+        ASSERT_TRUE(datum.num_as_int(&value));
+        ASSERT_EQ(static_cast<int64_t>(ints[i]), value);
+        ASSERT_EQ(value, datum.as_int());
+    }
+    double non_ints[] = { 0.5, -1.5, (1ull << 53) + 2.0, 6.02214179e23 };
+    for (size_t i = 0; i < sizeof(non_ints) / sizeof(non_ints[0]); ++i) {
+        ql::datum_t datum(non_ints[i]);
+        int64_t value;
+        ASSERT_FALSE(datum.num_as_int(&value));
+    }
+}
+
+// Checks that `datum`, however it was made, is the number `num`, and is an
+// integer exactly when `is_int` says so.
+void check_integer_number(const ql::datum_t &datum, double num, bool is_int) {
+    SCOPED_TRACE(strprintf("%.17g", num));
+    ASSERT_EQ(num, datum.as_num());
+    int64_t value;
+    ASSERT_EQ(is_int, datum.num_as_int(&value));
+    if (is_int) {
+        ASSERT_EQ(static_cast<int64_t>(num), value);
+        ASSERT_EQ(value, datum.as_int());
+    } else {
+        ASSERT_THROW(datum.as_int(), ql::base_exc_t);
+    }
+}
+
+// Evaluates `query` the way the server evaluates a client's.
+counted_t<const ql::datum_t> eval_datum(test_rdb_env_t::instance_t *env_instance,
+                                        ql::r::reql_t &&query) {
+    ql::protob_t<const Term> term = query.release_counted();
+    ql::compile_env_t compile_env((ql::var_visibility_t()));
+    counted_t<ql::term_t> compiled_term = ql::compile_term(&compile_env, term);
+    ql::scope_env_t scope_env(env_instance->get(), ql::var_scope_t());
+    return compiled_term->eval(&scope_env)->as_datum();
+}
+
+// An arithmetic term on two number literals.
+ql::r::reql_t arithmetic(Term_TermType type, double a, double b) {
+    return ql::r::reql_t(type, ql::r::expr(a), ql::r::expr(b));
+}
+
+void run_integer_arithmetic_test(test_rdb_env_t *test_env) {
+    scoped_ptr_t<test_rdb_env_t::instance_t> env_instance;
+    test_env->make_env(&env_instance);
+    test_rdb_env_t::instance_t *env = env_instance.get();
+
+    const double two_53 = static_cast<double>(1ull << 53);
+    // Non-integers that add up to integers, and integers that don't divide.
+    check_integer_number(*eval_datum(env, arithmetic(Term::ADD, 0.5, 0.5)), 1.0, true);
+    check_integer_number(*eval_datum(env, arithmetic(Term::ADD, 0.1, 0.2)), 0.1 + 0.2,
+                         false);
+    check_integer_number(*eval_datum(env, arithmetic(Term::MUL, 0.1, 10)), 1.0, true);
+    check_integer_number(*eval_datum(env, arithmetic(Term::DIV, 7, 2)), 3.5, false);
+    check_integer_number(*eval_datum(env, arithmetic(Term::DIV, 6, 3)), 2.0, true);
+    check_integer_number(*eval_datum(env, arithmetic(Term::DIV, 1e20, 1e5)), 1e15, true);
+    check_integer_number(*eval_datum(env, arithmetic(Term::MOD, 7, 3)), 1.0, true);
+    check_integer_number(*eval_datum(env, arithmetic(Term::SUB, 0.75, 0.25)), 0.5, false);
+    // Zero, negative or not.
+    check_integer_number(*eval_datum(env, arithmetic(Term::SUB, 3, 3)), 0.0, true);
+    check_integer_number(*eval_datum(env, arithmetic(Term::MUL, -1, 0)), -0.0, true);
+    check_integer_number(*eval_datum(env, arithmetic(Term::SUB, -2.5, 0.5)), -3.0, true);
+    // Around 2^53, where doubles stop holding every integer.
+    check_integer_number(*eval_datum(env, arithmetic(Term::MUL, two_53 / 2, 2)), two_53,
+                         true);
+    check_integer_number(*eval_datum(env, arithmetic(Term::ADD, two_53, 1)), two_53, true);
+    check_integer_number(*eval_datum(env, arithmetic(Term::SUB, -two_53, 1)), -two_53,
+                         true);
+    check_integer_number(*eval_datum(env, arithmetic(Term::MUL, two_53, 2)), two_53 * 2,
+                         false);
+    // Counts are numbers made on the server, not parsed from the query.
+    check_integer_number(*eval_datum(env, ql::r::array(1.5, 2.5, 3.5).count()), 3.0, true);
+}
+
+TEST(DatumTest, IntegerArithmetic) {
+    test_rdb_env_t test_env;
+    unittest::run_in_thread_pool(boost::bind(run_integer_arithmetic_test, &test_env));
+}
+
+TEST(DatumTest, IntegerDeserialization) {
+    const double two_53 = static_cast<double>(1ull << 53);
+    const struct {
+        double num;
+        bool is_int;
+    } nums[] = { { 0.0, true }, { -0.0, true }, { 1.0, true }, { -1.0, true },
+                 { 1e3, true }, { two_53, true }, { -two_53, true }, { 0.5, false },
+                 { -1.5, false }, { 0.1 + 0.2, false }, { two_53 + 2.0, false },
+                 { -two_53 - 2.0, false }, { static_cast<double>(1ull << 62), false },
+                 { 6.02214179e23, false } };
+    for (size_t i = 0; i < sizeof(nums) / sizeof(nums[0]); ++i) {
+        counted_t<const ql::datum_t> deserialized;
+        serialize_and_deserialize(make_counted<const ql::datum_t>(nums[i].num),
+                                  &deserialized);
+        check_integer_number(*deserialized, nums[i].num, nums[i].is_int);
+
+        Datum pb;
+        pb.set_type(Datum::R_NUM);
+        pb.set_r_num(nums[i].num);
+        check_integer_number(ql::datum_t(&pb), nums[i].num, nums[i].is_int);
+    }
+
+    const struct {
+        const char *json;
+        double num;
+        bool is_int;
+    } docs[] = { { "3", 3.0, true }, { "-3", -3.0, true }, { "3.0", 3.0, true },
+                 { "-0", -0.0, true }, { "1e3", 1e3, true }, { "3.5", 3.5, false },
+                 { "2.5e-1", 0.25, false },
+                 // Rounds down to 2^53.
+                 { "9007199254740993", two_53, true },
+                 { "18014398509481984", two_53 * 2, false } };
+    for (size_t i = 0; i < sizeof(docs) / sizeof(docs[0]); ++i) {
+        SCOPED_TRACE(docs[i].json);
+        counted_t<const ql::datum_t> datum = ql::parse_json_datum(docs[i].json);
+        ASSERT_TRUE(datum.has());
+        check_integer_number(*datum, docs[i].num, docs[i].is_int);
+    }
+}
+
+TEST(DatumTest, ObjectFields) {
+    const char *keys[] = { "m", "c", "x", "a", "mm", "b", "z" };
+    ql::datum_ptr_t obj(ql::datum_t::R_OBJECT);
+    for (size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); ++i) {
+        ASSERT_FALSE(obj.add(keys[i], make_counted<const ql::datum_t>(static_cast<double>(i))));
+    }
+    ASSERT_TRUE(obj.add("c", make_counted<const ql::datum_t>(10.0), ql::NOCLOBBER));
+    ASSERT_TRUE(obj.add("x", make_counted<const ql::datum_t>(20.0), ql::CLOBBER));
+    ASSERT_TRUE(obj.delete_field("mm"));
+    ASSERT_FALSE(obj.delete_field("q"));
+    counted_t<const ql::datum_t> datum = obj.to_counted();
+
+    const ql::datum_object_t &fields = datum->as_object();
+    ASSERT_EQ(6u, fields.size());
+    std::string last;
+    for (auto it = fields.begin(); it != fields.end(); ++it) {
+        ASSERT_LT(last, it->first);
+        last = it->first;
+    }
+    ASSERT_EQ(1.0, datum->get("c")->as_num());
+    ASSERT_EQ(20.0, datum->get("x")->as_num());
+    ASSERT_FALSE(datum->get("mm", ql::NOTHROW).has());
+    ASSERT_TRUE(fields.find("n") == fields.end());
+    test_datum_serialization(datum);
+
+    scoped_cJSON_t json(cJSON_Parse("{\"b\": 1, \"a\": 2, \"b\": 3}"));
+    ASSERT_THROW(ql::datum_t d(json), ql::base_exc_t);
+}
 
+TEST(DatumTest, SerializedSizeOfNestedDocument) {
+    counted_t<const ql::datum_t> doc = make_counted<const ql::datum_t>(scoped_cJSON_t(cJSON_Parse(
+        "{\"a\": [1, -2, 3.5, {\"x\": null}], \"b\": {\"c\": \"s\"}, \"c\": true}")));
+    const size_t first = serialized_size(doc);
+    // The second time comes from the cache, and the nested datums were cached on
+    // the way.
+    ASSERT_EQ(first, serialized_size(doc));
+    ASSERT_EQ(serialized_size(doc->get("b")) + 2 + serialized_size(doc->get("a"))
+              + 2 + serialized_size(doc->get("c")) + 2 + 1 + 1,
+              first);
+    test_datum_serialization(doc);
+}
+
+counted_t<const ql::datum_t> deserialize_fields_of(const char *json,
+                                                   const std::vector<std::string> &fields) {
+    string_stream_t write_stream;
+    write_message_t wm;
+    wm << make_counted<const ql::datum_t>(scoped_cJSON_t(cJSON_Parse(json)));
+    int write_res = send_write_message(&write_stream, &wm);
+    EXPECT_EQ(0, write_res);
+
+    string_read_stream_t read_stream(std::move(write_stream.str()), 0);
+    counted_t<const ql::datum_t> datum;
+    archive_result_t res = ql::deserialize_fields(&read_stream, fields, &datum);
+    EXPECT_EQ(ARCHIVE_SUCCESS, res);
+    return datum;
+}
+
+TEST(DatumTest, DeserializeFields) {
+    std::vector<std::string> fields;
+    fields.push_back("b");
+    fields.push_back("d");
+
+    counted_t<const ql::datum_t> projection = deserialize_fields_of(
+        "{\"a\": [1, -2, 3.5, {\"x\": null}], \"b\": {\"c\": \"s\"},"
+        " \"c\": true, \"e\": \"str\"}", fields);
+    ASSERT_TRUE(projection.has());
+    ASSERT_EQ(1u, projection->as_object().size());
+    ASSERT_EQ("s", projection->get("b")->get("c")->as_str());
+
+    // Anything else than an object comes out as a whole.
+    counted_t<const ql::datum_t> array = deserialize_fields_of("[1, 2]", fields);
+    ASSERT_EQ(2u, array->size());
+
+    counted_t<const ql::datum_t> time = deserialize_fields_of(
+        "{\"$reql_type$\": \"TIME\", \"epoch_time\": 0, \"timezone\": \"+00:00\"}",
+        fields);
+    ASSERT_FALSE(time.has());
+}
+
+
+
+TEST(DatumTest, WriteJson) {
+    const char *docs[] = {
+        "null", "true", "[]", "{}", "-0.5", "1e300", "12345678901234567",
+        "0", "-0", "-42", "9007199254740992", "-9007199254740992",
+        "\"quote\\\" backslash\\\\ tab\\t bell\\u0007 \\u00e9\"",
+        "[1, [2, {\"b\": false, \"a\": \"x\"}], null]",
+        "{\"z\": {\"y\": [0.1, 2]}, \"\\n\": 3}",
+    };
+    for (size_t i = 0; i < sizeof(docs) / sizeof(docs[0]); ++i) {
+        ql::datum_t datum(scoped_cJSON_t(cJSON_Parse(docs[i])));
+        std::string json;
+        datum.write_json(&json);
+        ASSERT_EQ(datum.as_json().PrintUnformatted(), json);
+    }
+}
+
+TEST(DatumTest, ParseJson) {
+    const char *docs[] = {
+        "null", "true", "false", " \n\t[ ]", "{}", "-0.5", "1e300", "0x10",
+        "\"\"", "\"a string long enough to be scanned a word at a time\"",
+        "\"quote\\\" backslash\\\\ slash\\/ tab\\t bell\\u0007 \\u00e9 \\u20AC\"",
+        "\"surrogates \\ud83d\\ude00, lone \\ud83d and \\ude00, \\u0000 dropped\"",
+        "\"unterminated", "\"escape at the end\\",
+        "[1, [2, {\"b\": false, \"a\": \"x\"}], null]",
+        "{\"z\": {\"y\": [0.1, 2]}, \"\\n\": 3, \"long keys are word-scanned too\": 4}",
+        "{\"a\": 1} trailing text", "[1, 2]]",
+    };
+    for (size_t i = 0; i < sizeof(docs) / sizeof(docs[0]); ++i) {
+        counted_t<const ql::datum_t> datum = ql::parse_json_datum(docs[i]);
+        ASSERT_TRUE(datum.has()) << docs[i];
+        ql::datum_t expected(scoped_cJSON_t(cJSON_Parse(docs[i])));
+        ASSERT_EQ(expected, *datum) << docs[i];
+    }
+
+    const char *not_json[] = {
+        "", "   ", "nul", "+1", "[1, 2", "[1,, 2]", "{\"a\" 1}", "{a: 1}",
+        "{\"a\": 1,}", "[\"x\" 3]",
+    };
+    for (size_t i = 0; i < sizeof(not_json) / sizeof(not_json[0]); ++i) {
+        ASSERT_TRUE(scoped_cJSON_t(cJSON_Parse(not_json[i])).get() == NULL) << not_json[i];
+        ASSERT_FALSE(ql::parse_json_datum(not_json[i]).has()) << not_json[i];
+    }
+
+    ASSERT_THROW(ql::parse_json_datum("{\"a\": 1, \"b\": 2, \"a\": 3}"), ql::base_exc_t);
+    ASSERT_THROW(ql::parse_json_datum("[1e999]"), ql::base_exc_t);
+}
+
+TEST(DatumTest, SortKeysCompareLikeDatums) {
+    const char *docs[] = {
+        "null", "false", "true", "-1e300", "-2.5", "-0.0", "0", "1e-300", "3", "1e300",
+        "\"\"", "\"a\"", "\"a\\u0000\"", "\"a\\u0001\"", "\"ab\"", "\"b\"",
+        "[]", "[null]", "[0]", "[0, 1]", "[1]", "[[]]",
+        "{}", "{\"a\": 1}", "{\"a\": 1, \"b\": 0}", "{\"a\": 2}", "{\"ab\": 0}",
+        "{\"b\": null}",
+        "{\"$reql_type$\": \"TIME\", \"epoch_time\": -1, \"timezone\": \"+00:00\"}",
+        "{\"$reql_type$\": \"TIME\", \"epoch_time\": 5, \"timezone\": \"-07:00\"}",
+    };
+    const size_t n = sizeof(docs) / sizeof(docs[0]);
+    std::vector<std::string> keys;
+    std::vector<counted_t<const ql::datum_t> > datums;
+    for (size_t i = 0; i < n; ++i) {
+        datums.push_back(make_counted<const ql::datum_t>(
+                             scoped_cJSON_t(cJSON_Parse(docs[i]))));
+        std::string key;
+        ql::append_sort_key(*datums.back(), &key);
+        keys.push_back(key);
+    }
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t j = 0; j < n; ++j) {
+            int datum_cmp = datums[i]->cmp(*datums[j]);
+            int key_cmp = keys[i].compare(keys[j]);
+            ASSERT_EQ(datum_cmp < 0, key_cmp < 0) << docs[i] << " vs " << docs[j];
+            ASSERT_EQ(datum_cmp == 0, key_cmp == 0) << docs[i] << " vs " << docs[j];
+        }
+    }
+}
+
+TEST(DatumTest, TopKRows) {
+    ql::top_k_rows_t left(3), right(3);
+    const double nums[] = { 5, 1, 9, 3, 7, 2, 8 };
+    for (size_t i = 0; i < sizeof(nums) / sizeof(nums[0]); ++i) {
+        counted_t<const ql::datum_t> d = make_counted<const ql::datum_t>(nums[i]);
+        std::string key;
+        ql::append_sort_key(*d, &key);
+        (i % 2 == 0 ? left : right).add(std::move(key), d);
+    }
+    left.add(right);
+    std::vector<counted_t<const ql::datum_t> > rows = left.sorted_rows();
+    ASSERT_EQ(3u, rows.size());
+    ASSERT_EQ(1, rows[0]->as_num());
+    ASSERT_EQ(2, rows[1]->as_num());
+    ASSERT_EQ(3, rows[2]->as_num());
+}
+
+TEST(DatumTest, SampleRows) {
+    // With room for all of them, the merged sample has every row.
+    ql::sample_rows_t left(5), right(5);
+    for (int i = 0; i < 3; ++i) {
+        left.add(make_counted<const ql::datum_t>(static_cast<double>(i)));
+    }
+    for (int i = 3; i < 5; ++i) {
+        right.add(make_counted<const ql::datum_t>(static_cast<double>(i)));
+    }
+    left.add(right);
+    std::vector<counted_t<const ql::datum_t> > rows = left.shuffled_rows();
+    ASSERT_EQ(5u, rows.size());
+    std::set<double> nums;
+    for (auto it = rows.begin(); it != rows.end(); ++it) {
+        nums.insert((*it)->as_num());
+    }
+    ASSERT_EQ(5u, nums.size());
+
+    // A sample of one row out of a hundred picks the one shard that saw a single
+    // row about as rarely as any other row.
+    int picked_single = 0;
+    for (int trial = 0; trial < 1000; ++trial) {
+        ql::sample_rows_t single(1), many(1);
+        single.add(make_counted<const ql::datum_t>(-1.0));
+        for (int i = 0; i < 99; ++i) {
+            many.add(make_counted<const ql::datum_t>(static_cast<double>(i)));
+        }
+        single.add(many);
+        rows = single.shuffled_rows();
+        ASSERT_EQ(1u, rows.size());
+        if (rows[0]->as_num() == -1) {
+            ++picked_single;
+        }
+    }
+    ASSERT_LT(picked_single, 100);
+}
+
+TEST(DatumTest, GroupAccumulators) {
+    ql::group_accumulators_t left(ql::group_aggregator_t::AVG);
+    ql::group_accumulators_t right(ql::group_aggregator_t::AVG);
+    const double groups[] = { 2, 1, 2, 1, 2, 1 };
+    const double fields[] = { 1, 4, 3, 6, 5, -1 };
+    for (size_t i = 0; i < sizeof(groups) / sizeof(groups[0]); ++i) {
+        counted_t<const ql::datum_t> field;
+        if (fields[i] >= 0) {
+            field = make_counted<const ql::datum_t>(fields[i]);
+        }
+        (i < 3 ? left : right).add(make_counted<const ql::datum_t>(groups[i]), field);
+    }
+
+    // What a shard sends has to merge the same way on the other end.
+    string_stream_t write_stream;
+    write_message_t wm;
+    wm << right;
+    ASSERT_EQ(0, send_write_message(&write_stream, &wm));
+    string_read_stream_t read_stream(std::move(write_stream.str()), 0);
+    ql::group_accumulators_t deserialized;
+    ASSERT_EQ(ARCHIVE_SUCCESS, deserialize(&read_stream, &deserialized));
+
+    left.add(deserialized);
+    ASSERT_EQ(2u, left.size());
+    counted_t<const ql::datum_t> arr = left.to_arr();
+    ASSERT_EQ(2u, arr->size());
+    ASSERT_EQ(1, arr->get(0)->get("group")->as_num());
+    ASSERT_EQ(5, arr->get(0)->get("reduction")->as_num());
+    ASSERT_EQ(2, arr->get(1)->get("group")->as_num());
+    ASSERT_EQ(3, arr->get(1)->get("reduction")->as_num());
+}
 
 }  // namespace unittest
@@ -48,6 +48,55 @@ TEST(DBMTest, ReadAheadInterval) {
     ASSERT_EQ(100, end_offset);
 }
 
+TEST(DBMTest, ForwardReadAheadInterval) {
+    int64_t offset;
+    int64_t end_offset;
+
+    std::vector<uint32_t> boundaries = { 0, 20, 35, 45, 55, 65, 80, 100 };
+
+    unaligned_forward_read_ahead_interval(35, 10, 100, 25, boundaries, &offset, &end_offset);
+    ASSERT_EQ(35, offset);
+    ASSERT_EQ(65, end_offset);
+
+    unaligned_forward_read_ahead_interval(35, 10, 100, 5, boundaries, &offset, &end_offset);
+    ASSERT_EQ(35, offset);
+    ASSERT_EQ(45, end_offset);
+
+    unaligned_forward_read_ahead_interval(55, 3, 100, 1200, boundaries, &offset, &end_offset);
+    ASSERT_EQ(55, offset);
+    ASSERT_EQ(100, end_offset);
+}
+
+TEST(DBMTest, ReadAheadDetector) {
+    read_ahead_detector_t detector(10, 80, 2);
+    bool sequential;
+
+    // A forward scan reads ahead more and more.
+    ASSERT_EQ(10, detector.read_ahead_size(1000, &sequential));
+    ASSERT_FALSE(sequential);
+    ASSERT_EQ(20, detector.read_ahead_size(1010, &sequential));
+    ASSERT_TRUE(sequential);
+    ASSERT_EQ(40, detector.read_ahead_size(1030, &sequential));
+    ASSERT_TRUE(sequential);
+    ASSERT_EQ(80, detector.read_ahead_size(1070, &sequential));
+    ASSERT_EQ(80, detector.read_ahead_size(1150, &sequential));
+    ASSERT_TRUE(sequential);
+
+    // A random read doesn't.
+    ASSERT_EQ(10, detector.read_ahead_size(50000, &sequential));
+    ASSERT_FALSE(sequential);
+
+    // The scan keeps its stream, even with a random read in between.
+    ASSERT_EQ(80, detector.read_ahead_size(1230, &sequential));
+    ASSERT_TRUE(sequential);
+
+    // With only two streams, random reads replace the least recently used one.
+    ASSERT_EQ(10, detector.read_ahead_size(90000, &sequential));
+    ASSERT_EQ(10, detector.read_ahead_size(70000, &sequential));
+    ASSERT_EQ(10, detector.read_ahead_size(1310, &sequential));
+    ASSERT_FALSE(sequential);
+}
+
 
 
 }  // namespace unittest
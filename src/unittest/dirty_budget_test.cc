@@ -0,0 +1,58 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "buffer_cache/mirrored/dirty_budget.hpp"
+#include "config/args.hpp"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+TEST(DirtyBudgetTest, SingleCacheUsesItsWholeLimit) {
+    dirty_budget_t budget;
+    dirty_budget_t::registration_t a(&budget, 100 * MEGABYTE);
+    EXPECT_EQ(0, a.report_dirty_size(0));
+    EXPECT_EQ(0, a.report_dirty_size(100 * MEGABYTE));
+}
+
+TEST(DirtyBudgetTest, SlowsDownCacheOverItsShare) {
+    dirty_budget_t budget;
+    dirty_budget_t::registration_t bulk(&budget, 100 * MEGABYTE);
+    dirty_budget_t::registration_t small(&budget, 100 * MEGABYTE);
+
+    // Together they may hold 100 MB, and each one's share is 50 MB.
+    EXPECT_EQ(0, bulk.report_dirty_size(40 * MEGABYTE));
+    EXPECT_EQ(0, small.report_dirty_size(10 * MEGABYTE));
+
+    const double bulk_pressure = bulk.report_dirty_size(80 * MEGABYTE);
+    EXPECT_GT(bulk_pressure, 0);
+    EXPECT_LT(bulk_pressure, 1);
+    EXPECT_EQ(0, small.report_dirty_size(10 * MEGABYTE));
+
+    EXPECT_EQ(1, bulk.report_dirty_size(100 * MEGABYTE));
+    EXPECT_EQ(0, small.report_dirty_size(10 * MEGABYTE));
+}
+
+TEST(DirtyBudgetTest, ShareIsProportionalToLimit) {
+    dirty_budget_t budget;
+    dirty_budget_t::registration_t large(&budget, 300 * MEGABYTE);
+    dirty_budget_t::registration_t small(&budget, 100 * MEGABYTE);
+
+    // The budget is 300 MB, of which 225 MB belong to `large`.
+    EXPECT_EQ(0, small.report_dirty_size(70 * MEGABYTE));
+    EXPECT_EQ(0, large.report_dirty_size(220 * MEGABYTE));
+    EXPECT_GT(small.report_dirty_size(80 * MEGABYTE), 0);
+}
+
+TEST(DirtyBudgetTest, ReleasesDirtyDataOnUnregister) {
+    dirty_budget_t budget;
+    dirty_budget_t::registration_t a(&budget, 100 * MEGABYTE);
+    dirty_budget_t::registration_t b(&budget, 100 * MEGABYTE);
+    double pressure_with_c;
+    {
+        dirty_budget_t::registration_t c(&budget, 100 * MEGABYTE);
+        c.report_dirty_size(90 * MEGABYTE);
+        pressure_with_c = a.report_dirty_size(60 * MEGABYTE);
+        EXPECT_GT(pressure_with_c, 0);
+    }
+    EXPECT_LT(a.report_dirty_size(60 * MEGABYTE), pressure_with_c);
+}
+
+}  // namespace unittest
@@ -0,0 +1,121 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include <vector>
+
+#include "errors.hpp"
+#include <boost/bind.hpp>
+
+#include "arch/io/disk/merging.hpp"
+#include "arch/runtime/coroutines.hpp"
+#include "containers/scoped.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+static const int MERGE_TEST_FD = 0;
+static const int MERGE_TEST_OTHER_FD = 1;
+
+struct merge_test_driver_t {
+    merge_test_driver_t() : merger(&get_global_perfmon_collection()) {
+        merger.submit_fun = boost::bind(&merge_test_driver_t::on_submit, this, _1);
+        merger.done_fun = boost::bind(&merge_test_driver_t::on_done, this, _1);
+    }
+
+    void on_submit(accounting_diskmgr_action_t *a) {
+        submitted.push_back(a);
+    }
+    void on_done(accounting_diskmgr_action_t *a) {
+        done.push_back(a);
+    }
+
+    merging_diskmgr_t merger;
+    std::vector<accounting_diskmgr_action_t *> submitted, done;
+};
+
+void run_merges_adjacent_reads_test() {
+    merge_test_driver_t driver;
+    scoped_array_t<char> buf(4 * DEVICE_BLOCK_SIZE);
+    accounting_diskmgr_action_t actions[4];
+
+    // Submitted out of order; the first three are next to each other.
+    actions[0].make_read(MERGE_TEST_FD, buf.data() + DEVICE_BLOCK_SIZE,
+                         DEVICE_BLOCK_SIZE, DEVICE_BLOCK_SIZE);
+    actions[1].make_read(MERGE_TEST_FD, buf.data(), DEVICE_BLOCK_SIZE, 0);
+    actions[2].make_read(MERGE_TEST_FD, buf.data() + 2 * DEVICE_BLOCK_SIZE,
+                         DEVICE_BLOCK_SIZE, 2 * DEVICE_BLOCK_SIZE);
+    actions[3].make_read(MERGE_TEST_OTHER_FD, buf.data() + 3 * DEVICE_BLOCK_SIZE,
+                         DEVICE_BLOCK_SIZE, 3 * DEVICE_BLOCK_SIZE);
+    for (int i = 0; i < 4; ++i) {
+        actions[i].account = NULL;
+        driver.merger.submit(&actions[i]);
+    }
+
+    // Nothing goes on before the event loop comes around.
+    EXPECT_TRUE(driver.submitted.empty());
+    coro_t::yield();
+    ASSERT_EQ(2u, driver.submitted.size());
+
+    accounting_diskmgr_action_t *merged = driver.submitted[0];
+    EXPECT_TRUE(merged->get_is_read());
+    EXPECT_EQ(0, merged->get_offset());
+    EXPECT_EQ(static_cast<size_t>(3 * DEVICE_BLOCK_SIZE), merged->get_count());
+    iovec *vecs;
+    size_t vecs_len;
+    merged->get_bufs(&vecs, &vecs_len);
+    ASSERT_EQ(3u, vecs_len);
+    EXPECT_EQ(buf.data(), vecs[0].iov_base);
+    EXPECT_EQ(buf.data() + 2 * DEVICE_BLOCK_SIZE, vecs[2].iov_base);
+    EXPECT_EQ(&actions[3], driver.submitted[1]);
+
+    merged->set_successful_due_to_conflict();
+    driver.merger.done(merged);
+    ASSERT_EQ(3u, driver.done.size());
+    EXPECT_EQ(&actions[1], driver.done[0]);
+    EXPECT_EQ(&actions[0], driver.done[1]);
+    EXPECT_EQ(&actions[2], driver.done[2]);
+    for (size_t i = 0; i < driver.done.size(); ++i) {
+        EXPECT_TRUE(driver.done[i]->get_succeeded());
+    }
+
+    actions[3].set_successful_due_to_conflict();
+    driver.merger.done(&actions[3]);
+    ASSERT_EQ(4u, driver.done.size());
+    EXPECT_EQ(&actions[3], driver.done[3]);
+}
+
+TEST(DiskMergingTest, MergesAdjacentReads) {
+    run_in_thread_pool(run_merges_adjacent_reads_test);
+}
+
+void run_keeps_datasynced_writes_apart_test() {
+    merge_test_driver_t driver;
+    scoped_array_t<char> buf(2 * DEVICE_BLOCK_SIZE);
+    accounting_diskmgr_action_t actions[2];
+
+    actions[0].make_write(MERGE_TEST_FD, buf.data(), DEVICE_BLOCK_SIZE, 0, true);
+    actions[1].make_write(MERGE_TEST_FD, buf.data() + DEVICE_BLOCK_SIZE,
+                          DEVICE_BLOCK_SIZE, DEVICE_BLOCK_SIZE, false);
+    for (int i = 0; i < 2; ++i) {
+        actions[i].account = NULL;
+        driver.merger.submit(&actions[i]);
+    }
+
+    // The datasynced write goes on right away, the other one waits for merging.
+    ASSERT_EQ(1u, driver.submitted.size());
+    EXPECT_EQ(&actions[0], driver.submitted[0]);
+    coro_t::yield();
+    ASSERT_EQ(2u, driver.submitted.size());
+    EXPECT_EQ(&actions[1], driver.submitted[1]);
+
+    for (int i = 0; i < 2; ++i) {
+        actions[i].set_successful_due_to_conflict();
+        driver.merger.done(&actions[i]);
+    }
+    EXPECT_EQ(2u, driver.done.size());
+}
+
+TEST(DiskMergingTest, KeepsDatasyncedWritesApart) {
+    run_in_thread_pool(run_keeps_datasynced_writes_apart_test);
+}
+
+}  // namespace unittest
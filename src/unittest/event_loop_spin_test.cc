@@ -0,0 +1,50 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "errors.hpp"
+#include <boost/bind.hpp>
+
+#include "unittest/gtest.hpp"
+
+#include "arch/runtime/runtime.hpp"
+#include "arch/runtime/starter.hpp"
+#include "arch/timing.hpp"
+#include "concurrency/pmap.hpp"
+#include "utils.hpp"
+
+namespace unittest {
+
+void hop_between_threads(int hops, int *count) {
+    for (int i = 0; i < hops; ++i) {
+        on_thread_t th(threadnum_t(i % get_num_threads()));
+        ++*count;
+    }
+}
+
+void hop_from(int i, int *counts) {
+    hop_between_threads(200 + i, &counts[i]);
+}
+
+void run_SpinningThreadsPassMessages() {
+    // Every hop wakes up a thread that's spinning or about to.
+    int count = 0;
+    hop_between_threads(1000, &count);
+    ASSERT_EQ(1000, count);
+
+    // After a while idle, the threads block; they must still get woken up.
+    nap(20);
+    {
+        on_thread_t th(threadnum_t(1));
+    }
+
+    // Lots of threads sending each other messages at once.
+    int counts[4] = { 0, 0, 0, 0 };
+    pmap(4, boost::bind(&hop_from, _1, counts));
+    for (int i = 0; i < 4; ++i) {
+        ASSERT_EQ(200 + i, counts[i]);
+    }
+}
+
+TEST(EventLoopSpinTest, SpinningThreadsPassMessages) {
+    ::run_in_thread_pool(run_SpinningThreadsPassMessages, 3, false, 50 * THOUSAND);
+}
+
+}  // namespace unittest
@@ -5,6 +5,7 @@
 #include "unittest/unittest_utils.hpp"
 
 #include "arch/runtime/coroutines.hpp"
+#include "config/args.hpp"
 #include "containers/archive/archive.hpp"
 #include "extproc/extproc_pool.hpp"
 #include "extproc/extproc_spawner.hpp"
@@ -396,6 +397,65 @@ TEST(ExtProc, HangingJob) {
     unittest::run_in_thread_pool(boost::bind(run_hanging_job_test));
 }
 
+// Echoes a string, which may be bigger than the ring of the worker.
+class echo_job_t {
+public:
+    echo_job_t(extproc_pool_t *pool, signal_t *interruptor) :
+        extproc_job(pool, &worker_fn, interruptor) { }
+
+    std::string run(const std::string &str) {
+        write_message_t wm;
+        wm << str;
+        int res = send_write_message(extproc_job.write_stream(), &wm);
+        guarantee(res == 0);
+
+        std::string result;
+        res = deserialize(extproc_job.read_stream(), &result);
+        guarantee(res == ARCHIVE_SUCCESS);
+        return result;
+    }
+
+private:
+    static bool worker_fn(read_stream_t *stream_in, write_stream_t *stream_out) {
+        std::string str;
+        int res = deserialize(stream_in, &str);
+        guarantee(res == ARCHIVE_SUCCESS);
+
+        write_message_t wm;
+        wm << str;
+        res = send_write_message(stream_out, &wm);
+        guarantee(res == 0);
+        return true;
+    }
+
+    extproc_job_t extproc_job;
+};
+
+void run_large_job_test() {
+    extproc_pool_t pool(1);
+
+    std::string str;
+    for (size_t i = 0; str.size() < 3 * EXTPROC_RING_SIZE + 12345; ++i) {
+        str += strprintf("%zu,", i);
+    }
+
+    for (size_t i = 0; i < 3; ++i) {
+        echo_job_t job(&pool, NULL);
+        ASSERT_EQ(str, job.run(str));
+    }
+
+    // Small jobs still work after the rings wrapped around
+    for (size_t i = 0; i < 10; ++i) {
+        fib_job_t job(10, &pool, NULL);
+        ASSERT_EQ(fib(10), job.run());
+    }
+}
+
+TEST(ExtProc, LargeJob) {
+    extproc_spawner_t extproc_spawner;
+    unittest::run_in_thread_pool(boost::bind(&run_large_job_test));
+}
+
 class corrupt_job_t {
 public:
     explicit corrupt_job_t(extproc_pool_t *pool) :
@@ -1,6 +1,7 @@
 // Copyright 2010-2012 RethinkDB, all rights reserved.
 #include "unittest/gtest.hpp"
 
+#include "arch/timing.hpp"
 #include "hash_region.hpp"
 #include "btree/keys.hpp"
 #include "memcached/region.hpp"
@@ -19,6 +20,62 @@ void assert_empty(const hash_region_t<key_range_t>& r) {
     assert_equal(key_range_t::empty(), r.inner);
 }
 
+// The hasher as it was written before it used a table, byte by byte.
+uint64_t reference_hash_region_hasher(const uint8_t *s, ssize_t len) {
+    uint64_t h = 0x47a59e381fb2dc06ULL;
+    for (ssize_t i = 0; i < len; ++i) {
+        h += hash_region_spread_byte(s[i]);
+        h = h ^ (h >> 11) ^ (h << 21);
+    }
+    return h & 0x7fffffffffffffffULL;
+}
+
+// Existing hash shards are stored on disk, so the hash of a key must not
+// change.
+TEST(HashRegionTest, HasherIsStable) {
+    EXPECT_EQ(0x47a59e381fb2dc06ULL, hash_region_hasher(NULL, 0));
+
+    std::vector<uint8_t> key;
+    for (int i = 0; i < MAX_KEY_SIZE; ++i) {
+        key.push_back(i * 37 + 11);
+        EXPECT_EQ(reference_hash_region_hasher(key.data(), key.size()),
+                  hash_region_hasher(key.data(), key.size()));
+    }
+    for (int ch = 0; ch < 256; ++ch) {
+        uint8_t c = ch;
+        EXPECT_EQ(reference_hash_region_hasher(&c, 1), hash_region_hasher(&c, 1));
+    }
+}
+
+// Compares the hasher with the byte-by-byte version. Run it with
+// --gtest_also_run_disabled_tests --gtest_filter=HashRegionTest.DISABLED_HasherBenchmark
+TEST(HashRegionTest, DISABLED_HasherBenchmark) {
+    const int num_keys = 10 * MILLION;
+    std::vector<uint8_t> key(32);
+    for (size_t i = 0; i < key.size(); ++i) {
+        key[i] = randint(256);
+    }
+
+    uint64_t sink = 0;
+    ticks_t start = get_ticks();
+    for (int i = 0; i < num_keys; ++i) {
+        key[i % key.size()] = i;
+        sink += hash_region_hasher(key.data(), key.size());
+    }
+    const double table_ns = ticks_to_secs(get_ticks() - start) * BILLION / num_keys;
+
+    start = get_ticks();
+    for (int i = 0; i < num_keys; ++i) {
+        key[i % key.size()] = i;
+        sink += reference_hash_region_hasher(key.data(), key.size());
+    }
+    const double reference_ns = ticks_to_secs(get_ticks() - start) * BILLION / num_keys;
+
+    EXPECT_NE(0u, sink);
+    printf("%zu byte keys: table %.1f ns/key, byte by byte %.1f ns/key\n",
+           key.size(), table_ns, reference_ns);
+}
+
 TEST(HashRegionTest, RegionJoinHashwise) {
 
     key_range_t kr(key_range_t::closed, store_key_t("Alpha"), key_range_t::open, store_key_t("Beta"));
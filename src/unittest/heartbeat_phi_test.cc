@@ -0,0 +1,56 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "unittest/gtest.hpp"
+
+#include "config/args.hpp"
+#include "rpc/connectivity/heartbeat.hpp"
+
+namespace unittest {
+
+ticks_t ms_to_ticks(int64_t ms) {
+    return static_cast<ticks_t>(ms) * MILLION;
+}
+
+TEST(PhiAccrualDetector, RegularHeartbeats) {
+    phi_accrual_detector_t detector;
+    EXPECT_EQ(0.0, detector.phi(0));
+
+    ticks_t now = ms_to_ticks(1000);
+    for (int i = 0; i < HEARTBEAT_PHI_MIN_SAMPLES + 1; ++i) {
+        detector.heartbeat(now);
+        now += ms_to_ticks(2000);
+    }
+    EXPECT_EQ(static_cast<size_t>(HEARTBEAT_PHI_MIN_SAMPLES), detector.sample_count());
+
+    const ticks_t last = now - ms_to_ticks(2000);
+    /* On time is fine, and phi keeps growing as the next heartbeat is late. */
+    EXPECT_GT(1.0, detector.phi(last + ms_to_ticks(2000)));
+    EXPECT_LT(detector.phi(last + ms_to_ticks(4000)), detector.phi(last + ms_to_ticks(6000)));
+    EXPECT_LT(HEARTBEAT_PHI_THRESHOLD, detector.phi(last + ms_to_ticks(10000)));
+}
+
+TEST(PhiAccrualDetector, IrregularHeartbeatsGetMoreTime) {
+    phi_accrual_detector_t regular, irregular;
+    ticks_t regular_now = 0, irregular_now = 0;
+    for (int i = 0; i < 50; ++i) {
+        regular_now += ms_to_ticks(2000);
+        /* Every fifth gap is a long stall. */
+        irregular_now += ms_to_ticks(i % 5 == 4 ? 8000 : 500);
+        regular.heartbeat(regular_now);
+        irregular.heartbeat(irregular_now);
+    }
+
+    EXPECT_LT(HEARTBEAT_PHI_THRESHOLD, regular.phi(regular_now + ms_to_ticks(8000)));
+    EXPECT_GT(HEARTBEAT_PHI_THRESHOLD, irregular.phi(irregular_now + ms_to_ticks(8000)));
+}
+
+TEST(PhiAccrualDetector, WindowForgetsOldGaps) {
+    phi_accrual_detector_t detector;
+    ticks_t now = 0;
+    for (int i = 0; i < 2 * HEARTBEAT_PHI_WINDOW; ++i) {
+        detector.heartbeat(now);
+        now += ms_to_ticks(100);
+    }
+    EXPECT_EQ(static_cast<size_t>(HEARTBEAT_PHI_WINDOW), detector.sample_count());
+}
+
+}  // namespace unittest
@@ -1,7 +1,10 @@
 // Copyright 2010-2012 RethinkDB, all rights reserved.
 #include <ctime>
 
+#include "arch/io/network.hpp"
+#include "concurrency/cond_var.hpp"
 #include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
 #include "http/http.hpp"
 
 namespace unittest {
@@ -14,4 +17,76 @@ TEST(Http, FormatTime) {
 
 }
 
+class two_piece_generator_t : public http_body_generator_t {
+public:
+    two_piece_generator_t() : pieces_left(2) { }
+
+    bool next(std::string *piece_out) {
+        if (pieces_left == 0) {
+            return false;
+        }
+        *piece_out = pieces_left == 2 ? "abc" : "de";
+        --pieces_left;
+        return true;
+    }
+
+private:
+    int pieces_left;
+};
+
+class keepalive_test_app_t : public http_app_t {
+public:
+    http_res_t handle(const http_req_t &req) {
+        if (req.resource.as_string() == "/stream") {
+            http_res_t res(HTTP_OK);
+            res.set_body_generator("text/plain", new two_piece_generator_t);
+            return res;
+        } else {
+            return http_res_t(HTTP_OK, "text/plain", "hello");
+        }
+    }
+};
+
+void run_keepalive_test() {
+    keepalive_test_app_t app;
+    std::set<ip_address_t> addresses = get_unittest_addresses();
+    http_server_t server(addresses, ANY_PORT, &app);
+
+    cond_t non_interruptor;
+    tcp_conn_t conn(*addresses.begin(), server.get_port(), &non_interruptor);
+
+    // Both requests go out before the first response comes back.
+    std::string requests =
+        "GET /hello HTTP/1.1\r\n\r\n"
+        "GET /stream HTTP/1.1\r\nConnection: close\r\n\r\n";
+    conn.write(requests.data(), requests.size(), &non_interruptor);
+
+    std::string expected =
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Type: text/plain\r\n"
+        "Content-Length: 5\r\n"
+        "Connection: keep-alive\r\n"
+        "\r\n"
+        "hello"
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Type: text/plain\r\n"
+        "Connection: close\r\n"
+        "Transfer-Encoding: chunked\r\n"
+        "\r\n"
+        "3\r\nabc\r\n"
+        "2\r\nde\r\n"
+        "0\r\n\r\n";
+    std::string responses(expected.size(), '\0');
+    conn.read(&responses[0], responses.size(), &non_interruptor);
+    EXPECT_EQ(expected, responses);
+
+    // The server closes the connection after the response the client asked it to.
+    char c;
+    EXPECT_THROW(conn.read(&c, 1, &non_interruptor), tcp_conn_read_closed_exc_t);
+}
+
+TEST(Http, KeepAliveAndChunked) {
+    unittest::run_in_thread_pool(&run_keepalive_test);
+}
+
 }
@@ -0,0 +1,56 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "serializer/log/lba/in_memory_index.hpp"
+
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+void check_info_roundtrip(in_memory_index_t *index, block_id_t id, repli_timestamp_t recency,
+                     flagged_off64_t offset, uint32_t ser_block_size, uint32_t checksum) {
+    index->set_block_info(id, recency, offset, ser_block_size, checksum);
+    const index_block_info_t info = index->get_block_info(id);
+    EXPECT_TRUE(info == index_block_info_t(offset, recency, ser_block_size, checksum));
+}
+
+TEST(InMemoryIndexTest, Roundtrip) {
+    in_memory_index_t index;
+
+    EXPECT_TRUE(index.get_block_info(12345) == index_block_info_t());
+    EXPECT_EQ(0u, index.end_block_id());
+
+    repli_timestamp_t small = { 1234 };
+    repli_timestamp_t large = { 1ULL << 40 };
+    repli_timestamp_t almost_invalid = { UINT32_MAX - 1 };
+
+    check_info_roundtrip(&index, 0, small, flagged_off64_t::make(0), 4096, 0);
+    check_info_roundtrip(&index, 1, repli_timestamp_t::distant_past,
+                    flagged_off64_t::make(512), 4096 | LBA_CHECKSUMMED_BLOCK_FLAG, 0xdeadbeef);
+    check_info_roundtrip(&index, 2, large, flagged_off64_t::make(4LL << 40), 1536, 42);
+    check_info_roundtrip(&index, 3, almost_invalid, flagged_off64_t::make(1024),
+                    1000 | LBA_COMPRESSED_BLOCK_FLAG | LBA_CHECKSUMMED_BLOCK_FLAG, 7);
+    // Deleted blocks keep their recency.
+    check_info_roundtrip(&index, 100000, small, flagged_off64_t::unused(), 0, 0);
+    check_info_roundtrip(&index, 100001, repli_timestamp_t::invalid, flagged_off64_t::unused(), 0, 0);
+
+    EXPECT_EQ(100002u, index.end_block_id());
+
+    // Overwriting a block with a large recency with a small one.
+    check_info_roundtrip(&index, 2, small, flagged_off64_t::make(4LL << 40), 1536, 42);
+}
+
+TEST(InMemoryIndexTest, ManySizes) {
+    in_memory_index_t index;
+    for (block_id_t i = 0; i < 10000; ++i) {
+        repli_timestamp_t recency = { i * 3 };
+        check_info_roundtrip(&index, i, recency, flagged_off64_t::make(i * 8192),
+                        1 + i % 4096, i * 2654435761U);
+    }
+    for (block_id_t i = 0; i < 10000; ++i) {
+        repli_timestamp_t recency = { i * 3 };
+        EXPECT_TRUE(index.get_block_info(i)
+                    == index_block_info_t(flagged_off64_t::make(i * 8192), recency,
+                                          1 + i % 4096, i * 2654435761U));
+    }
+}
+
+}  // namespace unittest
@@ -210,11 +210,47 @@ public:
         ASSERT_EQ(key_to_unescaped_str(p->first), key_to_unescaped_str(median));
     }
 
+    void SplitForAppend(LeafNodeTracker *right) {
+        ASSERT_EQ(bs_.ser_value(), right->bs_.ser_value());
+
+        ASSERT_TRUE(leaf::is_empty(right->node()));
+
+        store_key_t median;
+        leaf::split_for_append(&sizer_, node(), right->node(), median.btree_key());
+
+        ASSERT_TRUE(leaf::is_empty(right->node()));
+        ASSERT_FALSE(IsPastLastKey(median));
+        ASSERT_TRUE(kv_.empty() || !(median < kv_.rbegin()->first));
+    }
+
+    bool IsPastLastKey(const store_key_t &key) {
+        return leaf::is_past_last_key(node(), key.btree_key());
+    }
+
+    void NarrowKeyRange(const store_key_t &left_exclusive, const store_key_t &right_inclusive) {
+        leaf::narrow_key_range(&sizer_, node(), left_exclusive.btree_key(), right_inclusive.btree_key());
+        Verify();
+    }
+
+    bool Lookup(const store_key_t &key, std::string *value_out) {
+        short_value_buffer_t v("");
+        if (!leaf::lookup(&sizer_, node(), key.btree_key(), v.data())) {
+            return false;
+        }
+        *value_out = v.as_str();
+        return true;
+    }
+
     bool IsFull(const store_key_t& key, const std::string& value) {
         short_value_buffer_t value_buf(value);
         return leaf::is_full(&sizer_, node(), key.btree_key(), value_buf.data());
     }
 
+    bool IsFull(const store_key_t& key, const std::string& value, double fill_factor) {
+        short_value_buffer_t value_buf(value);
+        return leaf::is_full(&sizer_, node(), key.btree_key(), value_buf.data(), fill_factor);
+    }
+
     bool ShouldHave(const store_key_t& key) {
         return kv_.end() != kv_.find(key);
     }
@@ -605,6 +641,39 @@ TEST(LeafNodeTest, Splitting) {
     left.Split(&right);
 }
 
+TEST(LeafNodeTest, AppendSplitting) {
+    LeafNodeTracker left;
+    int i = 0;
+    while (left.Insert(store_key_t(strprintf("a%04d", i)), strprintf("A%04d", i))) {
+        ++i;
+    }
+    ASSERT_FALSE(left.IsPastLastKey(store_key_t(strprintf("a%04d", i - 1))));
+    ASSERT_TRUE(left.IsPastLastKey(store_key_t(strprintf("a%04d", i))));
+
+    LeafNodeTracker right;
+    left.SplitForAppend(&right);
+    left.Verify();
+    right.Verify();
+
+    // The left node stays full, the appends go on in the right node.
+    ASSERT_TRUE(left.IsFull(store_key_t(strprintf("a%04d", i)), strprintf("A%04d", i)));
+    for (int j = i; j < i + 10; ++j) {
+        ASSERT_TRUE(right.Insert(store_key_t(strprintf("a%04d", j)), strprintf("A%04d", j)));
+    }
+}
+
+TEST(LeafNodeTest, PastLastKeyWithDeletions) {
+    LeafNodeTracker node;
+    ASSERT_TRUE(node.IsPastLastKey(store_key_t("a")));
+    node.Insert(store_key_t("a"), "A");
+    node.Insert(store_key_t("b"), "B");
+    node.Remove(store_key_t("b"));
+
+    // The deletion entry for "b" still counts.
+    ASSERT_FALSE(node.IsPastLastKey(store_key_t("b")));
+    ASSERT_TRUE(node.IsPastLastKey(store_key_t("c")));
+}
+
 TEST(LeafNodeTest, Fullness) {
     LeafNodeTracker node;
     int i;
@@ -615,4 +684,138 @@ TEST(LeafNodeTest, Fullness) {
     ASSERT_TRUE(node.IsFull(store_key_t(strprintf("a%d", i)), strprintf("A%d", i)));
 }
 
+TEST(LeafNodeTest, FillFactor) {
+    LeafNodeTracker node;
+    int i = 0;
+    while (!node.IsFull(store_key_t(strprintf("a%04d", i)), strprintf("A%04d", i), 0.5)) {
+        node.Insert(store_key_t(strprintf("a%04d", i)), strprintf("A%04d", i));
+        ++i;
+    }
+    const int half_count = i;
+
+    while (!node.IsFull(store_key_t(strprintf("a%04d", i)), strprintf("A%04d", i), 1.0)) {
+        node.Insert(store_key_t(strprintf("a%04d", i)), strprintf("A%04d", i));
+        ++i;
+    }
+    ASSERT_TRUE(node.IsFull(store_key_t(strprintf("a%04d", i)), strprintf("A%04d", i)));
+    // The node's fixed overhead counts in both cases, so the half full node
+    // holds a bit less than half as many pairs.
+    ASSERT_LE(2 * half_count, i);
+    ASSERT_GE(2 * half_count, i * 9 / 10);
+}
+
+TEST(LeafNodeTest, PrefixElision) {
+    LeafNodeTracker node;
+    int i = 0;
+    while (node.Insert(store_key_t(strprintf("prefix:%04d", i)), "v")) {
+        ++i;
+    }
+    const int plain_count = i;
+
+    node.NarrowKeyRange(store_key_t("prefix:"), store_key_t("prefix:~"));
+
+    // Every entry got 7 bytes shorter, so there is room for more of them.
+    while (node.Insert(store_key_t(strprintf("prefix:%04d", i)), "v")) {
+        ++i;
+    }
+    ASSERT_GT(i, plain_count + plain_count / 4);
+
+    std::string value;
+    ASSERT_TRUE(node.Lookup(store_key_t("prefix:0000"), &value));
+    ASSERT_EQ("v", value);
+    ASSERT_FALSE(node.Lookup(store_key_t("prefix"), &value));
+    ASSERT_FALSE(node.Lookup(store_key_t("prefiw:0000"), &value));
+    ASSERT_FALSE(node.Lookup(store_key_t("prefiy"), &value));
+
+    for (int j = 0; j < i; j += 3) {
+        node.Remove(store_key_t(strprintf("prefix:%04d", j)));
+    }
+}
+
+TEST(LeafNodeTest, PrefixSplitting) {
+    LeafNodeTracker left;
+    left.NarrowKeyRange(store_key_t("pre:"), store_key_t("pre:~"));
+    for (int i = 0; left.Insert(store_key_t(strprintf("pre:%d", i)), strprintf("A%d", i)); ++i) { }
+
+    LeafNodeTracker right;
+    left.Split(&right);
+    left.Verify();
+    right.Verify();
+
+    // Both halves keep the prefix, so keys within it still fit in either.
+    ASSERT_TRUE(left.Insert(store_key_t("pre:0a"), "B"));
+    ASSERT_TRUE(right.Insert(store_key_t("pre:99a"), "B"));
+}
+
+TEST(LeafNodeTest, PrefixMerging) {
+    LeafNodeTracker left;
+    LeafNodeTracker right;
+    left.NarrowKeyRange(store_key_t("a:"), store_key_t("a:~"));
+    right.NarrowKeyRange(store_key_t("b:"), store_key_t("b:~"));
+
+    for (int i = 0; i < 50; ++i) {
+        left.Insert(store_key_t(strprintf("a:%d", i)), strprintf("A%d", i));
+        right.Insert(store_key_t(strprintf("b:%d", i)), strprintf("B%d", i));
+    }
+
+    ASSERT_TRUE(leaf::is_mergable(&right.sizer_, left.node(), right.node()));
+    right.Merge(&left);
+}
+
+TEST(LeafNodeTest, PrefixLeveling) {
+    LeafNodeTracker left;
+    LeafNodeTracker right;
+    left.NarrowKeyRange(store_key_t("a:"), store_key_t("a:~"));
+    right.NarrowKeyRange(store_key_t("a:x"), store_key_t("a:x~"));
+
+    for (int i = 0; left.Insert(store_key_t(strprintf("a:%d", i)), strprintf("A%d", i)); ++i) { }
+    right.Insert(store_key_t("a:x0"), "B0");
+
+    bool could_level;
+    right.Level(1, &left, &could_level);
+    ASSERT_TRUE(could_level);
+    ASSERT_TRUE(right.Insert(store_key_t("a:x1"), "B1"));
+}
+
+class history_counting_callback_t : public leaf::entry_reception_callback_t {
+public:
+    history_counting_callback_t() : lost(false), deletions(0), key_values(0) { }
+
+    void lost_deletions() { lost = true; }
+    void deletion(const btree_key_t *, repli_timestamp_t) { ++deletions; }
+    void key_value(const btree_key_t *, const void *, repli_timestamp_t) { ++key_values; }
+
+    bool lost;
+    int deletions;
+    int key_values;
+};
+
+TEST(LeafNodeTest, NoHistory) {
+    LeafNodeTracker node;
+    for (int i = 0; i < 20; ++i) {
+        node.Insert(store_key_t(strprintf("a%d", i)), strprintf("A%d", i));
+    }
+    node.Remove(store_key_t("a0"));
+    ASSERT_LT(node.node()->frontmost, node.node()->tstamp_cutpoint);
+
+    // The history goes away with the next change, not right away.
+    node.sizer_.set_leaf_history(leaf_history_t::NONE);
+    node.Insert(store_key_t("b"), "B");
+    ASSERT_EQ(node.node()->frontmost, node.node()->tstamp_cutpoint);
+
+    for (int i = 1; i < 20; i += 2) {
+        node.Remove(store_key_t(strprintf("a%d", i)));
+        node.Insert(store_key_t(strprintf("c%d", i)), strprintf("C%d", i));
+    }
+    ASSERT_EQ(node.node()->frontmost, node.node()->tstamp_cutpoint);
+
+    // A backfill from any time gets the whole leaf instead of the changes.
+    history_counting_callback_t cb;
+    leaf::dump_entries_since_time(&node.sizer_, node.node(), repli_timestamp_t::distant_past.next(),
+                                  node.NextTimestamp(), &cb);
+    ASSERT_TRUE(cb.lost);
+    ASSERT_EQ(0, cb.deletions);
+    ASSERT_EQ(20, cb.key_values);
+}
+
 }  // namespace unittest
@@ -0,0 +1,96 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "concurrency/lock_contention.hpp"
+
+#include <string>
+
+#include "errors.hpp"
+#include <boost/bind.hpp>
+
+#include "arch/runtime/coroutines.hpp"
+#include "concurrency/cond_var.hpp"
+#include "concurrency/mutex.hpp"
+#include "concurrency/rwi_lock.hpp"
+#include "perfmon/collect.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+static lock_site_t unittest_mutex_lock_site("unittest.mutex");
+static lock_site_t unittest_rwi_lock_site("unittest.rwi_lock");
+
+// Returns the stat called `name` in `map`, or `NULL`.
+const perfmon_result_t *find_stat(const perfmon_result_t *map, const std::string &name) {
+    if (map == NULL) {
+        return NULL;
+    }
+    perfmon_result_t::const_iterator it = map->get_map()->find(name);
+    return it == map->end() ? NULL : it->second;
+}
+
+// Returns `stat` of `site` in the `lock_contention` stat, or "" if the site
+// isn't there.
+std::string get_lock_contention_stat(const std::string &site, const std::string &stat) {
+    scoped_ptr_t<perfmon_result_t> stats = perfmon_get_stats();
+    const perfmon_result_t *value =
+        find_stat(find_stat(find_stat(stats.get(), "lock_contention"), site), stat);
+    return value == NULL ? "" : *value->get_string();
+}
+
+void hold_mutex(mutex_t *mutex, cond_t *locked, cond_t *release) {
+    mutex_t::acq_t acq(mutex, &unittest_mutex_lock_site);
+    locked->pulse();
+    release->wait_lazily_unordered();
+}
+
+void run_counts_mutex_waits_test() {
+    global_lock_contention_profiling = true;
+    {
+        mutex_t mutex;
+        cond_t locked, release;
+        coro_t::spawn_now_dangerously(boost::bind(&hold_mutex, &mutex, &locked, &release));
+        locked.wait_lazily_unordered();
+        coro_t::spawn_sometime(boost::bind(&cond_t::pulse, &release));
+        mutex_t::acq_t acq(&mutex, &unittest_mutex_lock_site);
+    }
+    global_lock_contention_profiling = false;
+
+    EXPECT_EQ("2", get_lock_contention_stat("unittest.mutex", "acquisitions"));
+    EXPECT_EQ("1", get_lock_contention_stat("unittest.mutex", "waits"));
+}
+
+TEST(LockContention, CountsMutexWaits) {
+    unittest::run_in_thread_pool(&run_counts_mutex_waits_test);
+}
+
+void hold_write_lock(rwi_lock_t *lock, cond_t *locked, cond_t *release) {
+    rwi_lock_t::write_acq_t acq(lock, &unittest_rwi_lock_site);
+    locked->pulse();
+    release->wait_lazily_unordered();
+}
+
+void run_counts_rwi_lock_waits_test() {
+    rwi_lock_t lock;
+    {
+        // Not counted, profiling is off.
+        rwi_lock_t::read_acq_t acq(&lock, &unittest_rwi_lock_site);
+    }
+    global_lock_contention_profiling = true;
+    {
+        cond_t locked, release;
+        coro_t::spawn_now_dangerously(boost::bind(&hold_write_lock, &lock, &locked, &release));
+        locked.wait_lazily_unordered();
+        coro_t::spawn_sometime(boost::bind(&cond_t::pulse, &release));
+        rwi_lock_t::read_acq_t acq(&lock, &unittest_rwi_lock_site);
+    }
+    global_lock_contention_profiling = false;
+
+    EXPECT_EQ("2", get_lock_contention_stat("unittest.rwi_lock", "acquisitions"));
+    EXPECT_EQ("1", get_lock_contention_stat("unittest.rwi_lock", "waits"));
+}
+
+TEST(LockContention, CountsRwiLockWaits) {
+    unittest::run_in_thread_pool(&run_counts_rwi_lock_waits_test);
+}
+
+}  // namespace unittest
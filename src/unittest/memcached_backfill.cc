@@ -55,6 +55,7 @@ void run_with_broadcaster(
                                              &branch_history_manager,
                                              broadcaster.get(),
                                              &get_global_perfmon_collection(),
+                                             NULL,
                                              &interruptor,
                                              &order_source));
 
@@ -147,9 +148,12 @@ void run_partial_backfill_test(io_backender_t *io_backender,
         broadcaster_metadata_view,
         branch_history_manager,
         &store2.store,
-        replier_business_card_variable.get_watchable(),
+        std::vector<listener_t<memcached_protocol_t>::replier_watchable_t>(1,
+            replier_business_card_variable.get_watchable()),
         generate_uuid(),
+        false,
         &get_global_perfmon_collection(),
+        NULL,
         &interruptor,
         order_source);
 
@@ -37,7 +37,8 @@ void run_with_namespace_interface(boost::function<void(namespace_interface_t<mem
                             new standard_serializer_t(standard_serializer_t::dynamic_config_t(),
                                                       &file_opener,
                                                       &get_global_perfmon_collection())),
-                        MERGER_SERIALIZER_MAX_ACTIVE_WRITES));
+                        MERGER_SERIALIZER_MAX_ACTIVE_WRITES,
+                        &get_global_perfmon_collection()));
 
 
     scoped_ptr_t<serializer_multiplexer_t> multiplexer;
@@ -148,5 +149,55 @@ TEST(MemcachedProtocol, GetSet) {
     run_in_thread_pool_with_namespace_interface(&run_get_set_test);
 }
 
+/* `MultiGet` reads keys from both shards at once */
+void run_multi_get_test(namespace_interface_t<memcached_protocol_t> *nsi, order_source_t *order_source) {
+    const char *keys[] = { "a", "m", "n", "z" };
+    for (size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); ++i) {
+        sarc_mutation_t set;
+        set.key = store_key_t(keys[i]);
+        set.data = data_buffer_t::create(1);
+        set.data->buf()[0] = keys[i][0] - 'a' + 'A';
+        set.flags = i;
+        set.exptime = 0;
+        set.add_policy = add_policy_yes;
+        set.replace_policy = replace_policy_yes;
+        memcached_protocol_t::write_t write(set, time(NULL), 12345);
+
+        cond_t interruptor;
+        memcached_protocol_t::write_response_t result;
+        nsi->write(write, &result, order_source->check_in("unittest::run_multi_get_test(memcached_protocol.cc-A)"), &interruptor);
+        EXPECT_EQ(sr_stored, boost::get<set_result_t>(result.result));
+    }
+
+    multi_get_query_t multi_get;
+    multi_get.keys.push_back(store_key_t("z"));
+    multi_get.keys.push_back(store_key_t("a"));
+    multi_get.keys.push_back(store_key_t("missing"));
+    multi_get.keys.push_back(store_key_t("n"));
+    multi_get.keys.push_back(store_key_t("a"));
+    memcached_protocol_t::read_t read(multi_get, time(NULL));
+
+    cond_t interruptor;
+    memcached_protocol_t::read_response_t result;
+    nsi->read(read, &result, order_source->check_in("unittest::run_multi_get_test(memcached_protocol.cc-B)").with_read_mode(), &interruptor);
+
+    multi_get_result_t *maybe_multi_get_result = boost::get<multi_get_result_t>(&result.result);
+    ASSERT_TRUE(maybe_multi_get_result != NULL);
+    const std::map<store_key_t, get_result_t> &values = maybe_multi_get_result->values;
+    ASSERT_EQ(3u, values.size());
+    EXPECT_EQ(0u, values.count(store_key_t("missing")));
+    EXPECT_EQ(0u, values.count(store_key_t("m")));
+    ASSERT_EQ(1u, values.count(store_key_t("n")));
+    EXPECT_EQ('N', values.find(store_key_t("n"))->second.value->buf()[0]);
+    EXPECT_EQ(2u, values.find(store_key_t("n"))->second.flags);
+    ASSERT_EQ(1u, values.count(store_key_t("z")));
+    EXPECT_EQ('Z', values.find(store_key_t("z"))->second.value->buf()[0]);
+    ASSERT_EQ(1u, values.count(store_key_t("a")));
+    EXPECT_EQ('A', values.find(store_key_t("a"))->second.value->buf()[0]);
+}
+TEST(MemcachedProtocol, MultiGet) {
+    run_in_thread_pool_with_namespace_interface(&run_multi_get_test);
+}
+
 }   /* namespace unittest */
 
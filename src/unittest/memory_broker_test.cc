@@ -0,0 +1,62 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "buffer_cache/mirrored/memory_broker.hpp"
+#include "config/args.hpp"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+TEST(MemoryBrokerTest, KeepsConfiguredSizesWithoutMisses) {
+    memory_broker_t broker;
+    memory_broker_t::registration_t a(&broker, 100 * MEGABYTE);
+    memory_broker_t::registration_t b(&broker, 300 * MEGABYTE);
+    EXPECT_EQ(100 * MEGABYTE, a.report_misses(0));
+    EXPECT_EQ(300 * MEGABYTE, b.report_misses(0));
+}
+
+TEST(MemoryBrokerTest, MovesMemoryToMissingCache) {
+    memory_broker_t broker;
+    memory_broker_t::registration_t hot(&broker, 100 * MEGABYTE);
+    memory_broker_t::registration_t idle(&broker, 100 * MEGABYTE);
+
+    int64_t hot_size = 0;
+    int64_t idle_size = 0;
+    for (int i = 0; i < 10; ++i) {
+        hot_size = hot.report_misses(1000);
+        idle_size = idle.report_misses(0);
+    }
+
+    EXPECT_GT(hot_size, 100 * MEGABYTE);
+    EXPECT_LT(idle_size, 100 * MEGABYTE);
+    EXPECT_GE(idle_size, static_cast<int64_t>(100 * MEGABYTE * MEMORY_BROKER_MIN_SIZE_FRACTION));
+    EXPECT_LE(hot_size + idle_size, 200 * MEGABYTE);
+}
+
+TEST(MemoryBrokerTest, SplitsByMissRate) {
+    memory_broker_t broker;
+    memory_broker_t::registration_t a(&broker, 100 * MEGABYTE);
+    memory_broker_t::registration_t b(&broker, 100 * MEGABYTE);
+
+    int64_t a_size = 0;
+    int64_t b_size = 0;
+    for (int i = 0; i < 10; ++i) {
+        a_size = a.report_misses(3000);
+        b_size = b.report_misses(1000);
+    }
+    EXPECT_GT(a_size, b_size);
+    EXPECT_GT(b_size, static_cast<int64_t>(100 * MEGABYTE * MEMORY_BROKER_MIN_SIZE_FRACTION));
+}
+
+TEST(MemoryBrokerTest, ReturnsMemoryOnUnregister) {
+    memory_broker_t broker;
+    memory_broker_t::registration_t a(&broker, 100 * MEGABYTE);
+    {
+        memory_broker_t::registration_t b(&broker, 100 * MEGABYTE);
+        b.report_misses(0);
+        for (int i = 0; i < 10; ++i) {
+            EXPECT_GT(a.report_misses(1000), 100 * MEGABYTE);
+        }
+    }
+    EXPECT_EQ(100 * MEGABYTE, a.report_misses(1000));
+}
+
+}  // namespace unittest
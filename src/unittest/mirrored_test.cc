@@ -1,9 +1,17 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 
+#include <unistd.h>
+
+#include <map>
+
 #include "errors.hpp"
 #include <boost/bind.hpp>
 
+#include "arch/timing.hpp"
 #include "buffer_cache/buffer_cache.hpp"
+#include "concurrency/pmap.hpp"
+#include "containers/open_addressed_map.hpp"
+#include "containers/two_level_array.hpp"
 #include "unittest/unittest_utils.hpp"
 #include "serializer/config.hpp"
 #include "serializer/translator.hpp"
@@ -50,7 +58,7 @@ private:
         buf1_A.release();
 
         // create a fake buffer (be careful with populating it with data
-        scoped_malloc_t<ser_buffer_t> fake_buf = serializer->malloc();
+        scoped_ser_buffer_t fake_buf = serializer->malloc();
         fake_buf->ser_header.block_id = serializer->translate_block_id(block_A);
         fake_buf->ser_header.block_sequence_id = 1;
 
@@ -130,5 +138,485 @@ TEST(MirroredTest, Durability) {
     unittest::run_in_thread_pool(boost::bind(&durability_tester_t::check_snapshotted_file_contents, &tester));
 }
 
+class scan_resistance_tester_t : public server_test_helper_t {
+protected:
+    void run_serializer_tests() {
+        cache_t::create(this->serializer);
+        mirrored_cache_config_t cache_cfg;
+        cache_cfg.flush_timer_ms = MILLION;
+        cache_cfg.flush_dirty_size = BILLION;
+        cache_cfg.max_size = cache_blocks * this->serializer->get_block_size().ser_value();
+        cache_cfg.page_repl_policy = PAGE_REPL_POLICY_CLOCK;
+        cache_t cache(this->serializer, cache_cfg, &get_global_perfmon_collection());
+
+        run_tests(&cache);
+    }
+
+    void run_tests(cache_t *cache) {
+        std::vector<block_id_t> hot_blocks, scan_blocks;
+        {
+            // Hard durability, so that all the blocks are clean (and thus
+            // evictable) once the transaction is gone.
+            transaction_t txn(cache, rwi_write, 0, repli_timestamp_t::distant_past,
+                              order_token_t::ignore, WRITE_DURABILITY_HARD);
+            for (int i = 0; i < num_hot_blocks + num_scan_blocks; ++i) {
+                buf_lock_t buf(&txn);
+                change_value(&buf, init_value);
+                (i < num_hot_blocks ? hot_blocks : scan_blocks).push_back(buf.get_block_id());
+            }
+        }
+
+        transaction_t txn(cache, rwi_read, order_token_t::ignore);
+
+        // Access the hot blocks twice, so that they are known to be reused.
+        for (int round = 0; round < 2; ++round) {
+            for (size_t i = 0; i < hot_blocks.size(); ++i) {
+                buf_lock_t buf(&txn, hot_blocks[i], rwi_read);
+                EXPECT_EQ(init_value, get_value(&buf));
+            }
+        }
+
+        // Each block of a scan gets accessed only once.
+        for (size_t i = 0; i < scan_blocks.size(); ++i) {
+            buf_lock_t buf(&txn, scan_blocks[i], rwi_read);
+            EXPECT_EQ(init_value, get_value(&buf));
+        }
+
+        for (size_t i = 0; i < hot_blocks.size(); ++i) {
+            EXPECT_TRUE(cache->contains_block(hot_blocks[i]));
+        }
+        EXPECT_GE(static_cast<unsigned int>(cache_blocks), cache->num_blocks());
+    }
+
+private:
+    static const int cache_blocks = 100;
+    static const int num_hot_blocks = 20;
+    static const int num_scan_blocks = 1000;
+};
+
+TEST(MirroredTest, ClockScanResistance) {
+    scan_resistance_tester_t().run();
+}
+
+class clock_priority_tester_t : public server_test_helper_t {
+protected:
+    void run_serializer_tests() {
+        cache_t::create(this->serializer);
+        mirrored_cache_config_t cache_cfg;
+        cache_cfg.flush_timer_ms = MILLION;
+        cache_cfg.flush_dirty_size = BILLION;
+        cache_cfg.max_size = cache_blocks * this->serializer->get_block_size().ser_value();
+        cache_cfg.page_repl_policy = PAGE_REPL_POLICY_CLOCK;
+        cache_t cache(this->serializer, cache_cfg, &get_global_perfmon_collection());
+
+        run_tests(&cache);
+    }
+
+    void run_tests(cache_t *cache) {
+        std::vector<block_id_t> other_blocks;
+        block_id_t root_block;
+        {
+            transaction_t txn(cache, rwi_write, 0, repli_timestamp_t::distant_past,
+                              order_token_t::ignore, WRITE_DURABILITY_HARD);
+            for (int i = 0; i < num_other_blocks; ++i) {
+                buf_lock_t buf(&txn);
+                change_value(&buf, init_value);
+                other_blocks.push_back(buf.get_block_id());
+            }
+            // The root is never accessed again, so it stays cold and unreferenced:
+            // only its eviction priority keeps the hand from taking it.
+            buf_lock_t buf(&txn);
+            change_value(&buf, init_value);
+            buf.set_eviction_priority(INITIAL_ROOT_EVICTION_PRIORITY);
+            root_block = buf.get_block_id();
+        }
+
+        transaction_t txn(cache, rwi_read, order_token_t::ignore);
+        for (size_t i = 0; i < other_blocks.size(); ++i) {
+            buf_lock_t buf(&txn, other_blocks[i], rwi_read);
+            EXPECT_EQ(init_value, get_value(&buf));
+        }
+
+        EXPECT_TRUE(cache->contains_block(root_block));
+        EXPECT_GE(static_cast<unsigned int>(cache_blocks), cache->num_blocks());
+    }
+
+private:
+    static const int cache_blocks = 100;
+    static const int num_other_blocks = 1000;
+};
+
+TEST(MirroredTest, ClockEvictionPriority) {
+    clock_priority_tester_t().run();
+}
+
+class pinning_tester_t : public server_test_helper_t {
+protected:
+    void run_serializer_tests() {
+        cache_t::create(this->serializer);
+        mirrored_cache_config_t cache_cfg;
+        cache_cfg.flush_timer_ms = MILLION;
+        cache_cfg.flush_dirty_size = BILLION;
+        cache_cfg.max_size = cache_blocks * this->serializer->get_block_size().ser_value();
+        cache_cfg.pinned_fraction = 0.1;
+        cache_t cache(this->serializer, cache_cfg, &get_global_perfmon_collection());
+
+        run_tests(&cache);
+    }
+
+    void run_tests(cache_t *cache) {
+        std::vector<block_id_t> pinned_blocks, other_blocks;
+        {
+            transaction_t txn(cache, rwi_write, 0, repli_timestamp_t::distant_past,
+                              order_token_t::ignore, WRITE_DURABILITY_HARD);
+            for (int i = 0; i < num_pinned_blocks + num_other_blocks; ++i) {
+                buf_lock_t buf(&txn);
+                change_value(&buf, init_value);
+                (i < num_pinned_blocks ? pinned_blocks : other_blocks).push_back(buf.get_block_id());
+            }
+        }
+
+        transaction_t txn(cache, rwi_read, order_token_t::ignore);
+        for (size_t i = 0; i < pinned_blocks.size(); ++i) {
+            buf_lock_t buf(&txn, pinned_blocks[i], rwi_read);
+            buf.set_eviction_priority(INITIAL_ROOT_EVICTION_PRIORITY);
+            buf.pin_in_cache();
+        }
+
+        // Go through ten times as many other blocks as fit in the cache, twice.
+        for (int round = 0; round < 2; ++round) {
+            for (size_t i = 0; i < other_blocks.size(); ++i) {
+                buf_lock_t buf(&txn, other_blocks[i], rwi_read);
+                EXPECT_EQ(init_value, get_value(&buf));
+            }
+        }
+
+        for (size_t i = 0; i < pinned_blocks.size(); ++i) {
+            EXPECT_TRUE(cache->contains_block(pinned_blocks[i]));
+        }
+        EXPECT_GE(static_cast<unsigned int>(cache_blocks), cache->num_blocks());
+    }
+
+private:
+    static const int cache_blocks = 100;
+    static const int num_pinned_blocks = 10;
+    static const int num_other_blocks = 1000;
+};
+
+TEST(MirroredTest, PinnedBlocks) {
+    pinning_tester_t().run();
+}
+
+class warmup_tester_t : public server_test_helper_t {
+protected:
+    void run_serializer_tests() {
+        cache_t::create(this->serializer);
+        mirrored_cache_config_t cache_cfg;
+        cache_cfg.flush_timer_ms = MILLION;
+        cache_cfg.flush_dirty_size = BILLION;
+        cache_cfg.max_size = 1000 * this->serializer->get_block_size().ser_value();
+
+        temp_file_t temp_file;
+        const std::string manifest_path = temp_file.name().permanent_path() + ".warmup";
+
+        std::vector<block_id_t> block_ids;
+        {
+            cache_t cache(this->serializer, cache_cfg, &get_global_perfmon_collection());
+            cache.enable_warmup_manifest(manifest_path);
+            transaction_t txn(&cache, rwi_write, 0, repli_timestamp_t::distant_past,
+                              order_token_t::ignore, WRITE_DURABILITY_HARD);
+            for (int i = 0; i < num_blocks; ++i) {
+                buf_lock_t buf(&txn);
+                change_value(&buf, init_value);
+                block_ids.push_back(buf.get_block_id());
+            }
+        }
+
+        {
+            // The blocks get loaded in the background, without anyone asking for them.
+            cache_t cache(this->serializer, cache_cfg, &get_global_perfmon_collection());
+            cache.enable_warmup_manifest(manifest_path);
+            for (int i = 0; i < 100 && cache.num_blocks() < block_ids.size(); ++i) {
+                nap(10);
+            }
+            for (size_t i = 0; i < block_ids.size(); ++i) {
+                EXPECT_TRUE(cache.contains_block(block_ids[i]));
+            }
+
+            transaction_t txn(&cache, rwi_read, order_token_t::ignore);
+            for (size_t i = 0; i < block_ids.size(); ++i) {
+                buf_lock_t buf(&txn, block_ids[i], rwi_read);
+                EXPECT_EQ(init_value, get_value(&buf));
+            }
+        }
+
+        ::unlink(manifest_path.c_str());
+    }
+
+    void run_tests(UNUSED cache_t *cache) { }
+
+private:
+    static const int num_blocks = 50;
+};
+
+TEST(MirroredTest, WarmupManifest) {
+    warmup_tester_t().run();
+}
+
+class prefetch_tester_t : public server_test_helper_t {
+protected:
+    void run_serializer_tests() {
+        cache_t::create(this->serializer);
+        mirrored_cache_config_t cache_cfg;
+        cache_cfg.flush_timer_ms = MILLION;
+        cache_cfg.flush_dirty_size = BILLION;
+        cache_cfg.max_size = 1000 * this->serializer->get_block_size().ser_value();
+
+        std::vector<block_id_t> block_ids;
+        {
+            cache_t cache(this->serializer, cache_cfg, &get_global_perfmon_collection());
+            transaction_t txn(&cache, rwi_write, 0, repli_timestamp_t::distant_past,
+                              order_token_t::ignore, WRITE_DURABILITY_HARD);
+            for (int i = 0; i < num_blocks; ++i) {
+                buf_lock_t buf(&txn);
+                change_value(&buf, init_value);
+                block_ids.push_back(buf.get_block_id());
+            }
+        }
+
+        cache_t cache(this->serializer, cache_cfg, &get_global_perfmon_collection());
+        transaction_t txn(&cache, rwi_read, order_token_t::ignore);
+        for (size_t i = 0; i < block_ids.size(); ++i) {
+            txn.prefetch(block_ids[i]);
+            EXPECT_TRUE(cache.contains_block(block_ids[i]));
+        }
+        // Prefetching a block twice is fine.
+        txn.prefetch(block_ids[0]);
+
+        for (size_t i = 0; i < block_ids.size(); ++i) {
+            buf_lock_t buf(&txn, block_ids[i], rwi_read);
+            EXPECT_EQ(init_value, get_value(&buf));
+        }
+    }
+
+    void run_tests(UNUSED cache_t *cache) { }
+
+private:
+    static const int num_blocks = 50;
+};
+
+TEST(MirroredTest, Prefetch) {
+    prefetch_tester_t().run();
+}
+
+class group_commit_tester_t : public server_test_helper_t {
+protected:
+    void run_serializer_tests() {
+        cache_t::create(this->serializer);
+        mirrored_cache_config_t cache_cfg;
+        cache_cfg.flush_timer_ms = MILLION;
+        cache_cfg.flush_dirty_size = BILLION;
+        cache_cfg.max_size = 1000 * this->serializer->get_block_size().ser_value();
+        cache_cfg.adaptive_flush = true;
+
+        block_ids.resize(num_writers);
+        {
+            cache_t cache(this->serializer, cache_cfg, &get_global_perfmon_collection());
+            // The writers' hard durability commits overlap, so they can get grouped.
+            pmap(num_writers, boost::bind(&group_commit_tester_t::write_block, this, &cache, _1));
+        }
+
+        cache_t cache(this->serializer, cache_cfg, &get_global_perfmon_collection());
+        transaction_t txn(&cache, rwi_read, order_token_t::ignore);
+        for (int i = 0; i < num_writers; ++i) {
+            buf_lock_t buf(&txn, block_ids[i], rwi_read);
+            EXPECT_EQ(static_cast<uint32_t>(i), get_value(&buf));
+        }
+    }
+
+    void run_tests(UNUSED cache_t *cache) { }
+
+private:
+    void write_block(cache_t *cache, int i) {
+        transaction_t txn(cache, rwi_write, 1, repli_timestamp_t::distant_past,
+                          order_token_t::ignore, WRITE_DURABILITY_HARD);
+        buf_lock_t buf(&txn);
+        change_value(&buf, i);
+        block_ids[i] = buf.get_block_id();
+    }
+
+    static const int num_writers = 40;
+    std::vector<block_id_t> block_ids;
+};
+
+TEST(MirroredTest, GroupCommit) {
+    group_commit_tester_t().run();
+}
+
+class counting_derived_data_t : public buf_derived_data_t {
+public:
+    explicit counting_derived_data_t(int *_live) : live(_live) { ++*live; }
+    ~counting_derived_data_t() { --*live; }
+private:
+    int *live;
+};
+
+class derived_data_tester_t : public server_test_helper_t {
+protected:
+    void run_tests(cache_t *cache) {
+        int live = 0;
+        block_id_t block_id;
+        {
+            transaction_t txn(cache, rwi_write, 0, repli_timestamp_t::distant_past, order_token_t::ignore, WRITE_DURABILITY_SOFT);
+            buf_lock_t buf(&txn);
+            block_id = buf.get_block_id();
+            *static_cast<uint64_t *>(buf.get_data_write()) = value_A;
+            EXPECT_FALSE(buf.can_use_derived_data());
+        }
+
+        {
+            transaction_t txn(cache, rwi_read, order_token_t::ignore);
+            buf_lock_t buf(&txn, block_id, rwi_read);
+            ASSERT_TRUE(buf.can_use_derived_data());
+            EXPECT_TRUE(buf.get_derived_data() == NULL);
+            buf.set_derived_data(new counting_derived_data_t(&live));
+            EXPECT_EQ(1, live);
+        }
+
+        buf_derived_data_t *derived;
+        {
+            // It stays with the buf for the next lock.
+            transaction_t txn(cache, rwi_read, order_token_t::ignore);
+            buf_lock_t buf(&txn, block_id, rwi_read);
+            derived = buf.get_derived_data();
+            EXPECT_TRUE(derived != NULL);
+        }
+
+        {
+            // Replacing it deletes the old one.
+            transaction_t txn(cache, rwi_read, order_token_t::ignore);
+            buf_lock_t buf(&txn, block_id, rwi_read);
+            buf.set_derived_data(new counting_derived_data_t(&live));
+            EXPECT_EQ(1, live);
+        }
+
+        {
+            // Acquiring the buf for writing doesn't, but changing it does.
+            transaction_t txn(cache, rwi_write, 0, repli_timestamp_t::distant_past, order_token_t::ignore, WRITE_DURABILITY_SOFT);
+            buf_lock_t buf(&txn, block_id, rwi_write);
+            EXPECT_FALSE(buf.can_use_derived_data());
+            EXPECT_EQ(1, live);
+            *static_cast<uint64_t *>(buf.get_data_write()) = value_B;
+            EXPECT_EQ(0, live);
+        }
+
+        {
+            transaction_t txn(cache, rwi_read, order_token_t::ignore);
+            buf_lock_t buf(&txn, block_id, rwi_read);
+            EXPECT_TRUE(buf.get_derived_data() == NULL);
+            buf.set_derived_data(new counting_derived_data_t(&live));
+        }
+
+        {
+            transaction_t txn(cache, rwi_write, 0, repli_timestamp_t::distant_past, order_token_t::ignore, WRITE_DURABILITY_SOFT);
+            buf_lock_t buf(&txn, block_id, rwi_write);
+            buf.mark_deleted();
+            EXPECT_EQ(0, live);
+        }
+    }
+};
+
+TEST(MirroredTest, DerivedData) {
+    derived_data_tester_t().run();
+}
+
+TEST(MirroredTest, PageMapIndex) {
+    open_addressed_map_t<int *> map;
+    std::map<size_t, int *> expected;
+    int values[10];
+
+    for (int i = 0; i < 100000; ++i) {
+        // Mix dense and sparse keys, like block ids of a fresh and an old table.
+        const size_t key = i % 2 == 0 ? randint(1000) : randint(BILLION);
+        if (randint(3) == 0) {
+            map.set(key, NULL);
+            expected.erase(key);
+        } else {
+            int *value = &values[randint(10)];
+            map.set(key, value);
+            expected[key] = value;
+        }
+    }
+
+    ASSERT_EQ(expected.size(), map.size());
+    for (std::map<size_t, int *>::iterator it = expected.begin(); it != expected.end(); ++it) {
+        EXPECT_EQ(it->second, map.get(it->first));
+    }
+    for (size_t key = 0; key < 1000; ++key) {
+        EXPECT_EQ(expected.count(key) == 0 ? NULL : expected[key], map.get(key));
+    }
+
+    // Reserving space keeps the entries.
+    map.reserve(10 * map.size());
+    for (std::map<size_t, int *>::iterator it = expected.begin(); it != expected.end(); ++it) {
+        EXPECT_EQ(it->second, map.get(it->first));
+    }
+}
+
+template <class map_t>
+double time_page_map_lookups(map_t *map, const std::vector<block_id_t> &lookups) {
+    int *sink = NULL;
+    const ticks_t start = get_ticks();
+    for (size_t i = 0; i < lookups.size(); ++i) {
+        int *value = map->get(lookups[i]);
+        if (value > sink) {
+            sink = value;
+        }
+    }
+    const ticks_t end = get_ticks();
+    EXPECT_TRUE(sink != NULL);
+    return ticks_to_secs(end - start) * BILLION / lookups.size();
+}
+
+// Measures the cost of the page map lookup that every acquire starts with, for
+// caches with the given numbers of resident blocks. It needs a few gigabytes of
+// memory, so it is disabled by default; run it with
+// --gtest_also_run_disabled_tests --gtest_filter=MirroredTest.DISABLED_PageMapLookupBenchmark
+TEST(MirroredTest, DISABLED_PageMapLookupBenchmark) {
+    const size_t resident_blocks[] = { MILLION, 10 * MILLION, 50 * MILLION };
+    const size_t num_lookups = 10 * MILLION;
+    int value;
+
+    for (size_t n = 0; n < sizeof(resident_blocks) / sizeof(resident_blocks[0]); ++n) {
+        const size_t num_blocks = resident_blocks[n];
+        // The resident blocks are a random subset of a table twice their size.
+        std::vector<block_id_t> lookups;
+        lookups.reserve(num_lookups);
+        for (size_t i = 0; i < num_lookups; ++i) {
+            lookups.push_back(randint(static_cast<int>(num_blocks)) * 2);
+        }
+
+        double open_addressed_ns;
+        {
+            open_addressed_map_t<int *> map(num_blocks);
+            for (size_t i = 0; i < num_blocks; ++i) {
+                map.set(i * 2, &value);
+            }
+            open_addressed_ns = time_page_map_lookups(&map, lookups);
+        }
+        double two_level_ns;
+        {
+            two_level_array_t<int *> array;
+            for (size_t i = 0; i < num_blocks; ++i) {
+                array.set(i * 2, &value);
+            }
+            two_level_ns = time_page_map_lookups(&array, lookups);
+        }
+
+        printf("%zu resident blocks: open addressed %.1f ns/lookup, two level array %.1f ns/lookup\n",
+               num_blocks, open_addressed_ns, two_level_ns);
+    }
+}
+
 }  // namespace unittest
 
@@ -30,6 +30,14 @@ void mock_file_t::set_size_at_least(int64_t size) {
     }
 }
 
+bool mock_file_t::discard(int64_t offset, int64_t length) {
+    guarantee(mode_ & mode_write);
+    guarantee(!(offset < 0 || length < 0
+                || static_cast<uint64_t>(offset + length) > data_->size()));
+    memset(data_->data() + offset, 0, length);
+    return true;
+}
+
 void mock_file_t::read_async(int64_t offset, size_t length, void *buf,
                              UNUSED file_account_t *account, linux_iocallback_t *cb) {
     guarantee(mode_ & mode_read);
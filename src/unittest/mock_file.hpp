@@ -22,6 +22,7 @@ public:
     int64_t get_size();
     void set_size(int64_t size);
     void set_size_at_least(int64_t size);
+    MUST_USE bool discard(int64_t offset, int64_t length);
 
     void read_async(int64_t offset, size_t length, void *buf,
                     file_account_t *account, linux_iocallback_t *cb);
@@ -31,7 +32,9 @@ public:
     void writev_async(int64_t offset, size_t length, scoped_array_t<iovec> &&bufs,
                       file_account_t *account, linux_iocallback_t *cb);
 
-    void *create_account(UNUSED int priority, UNUSED int outstanding_requests_limit) {
+    void *create_account(UNUSED int priority, UNUSED int outstanding_requests_limit,
+                         UNUSED io_class_t io_class,
+                         UNUSED io_activity_stats_t *activity_stats) {
         // We don't care about accounts.  Return an arbitrary non-null pointer.
         return this;
     }
@@ -0,0 +1,247 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include <string>
+
+#include "arch/io/disk.hpp"
+#include "buffer_cache/blob.hpp"
+#include "clustering/administration/metadata.hpp"
+#include "clustering/administration/persist.hpp"
+#include "clustering/immediate_consistency/branch/history.hpp"
+#include "containers/archive/string_stream.hpp"
+#include "rdb_protocol/protocol.hpp"
+#include "serializer/config.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+// `ns` as version 1.11 would have had it.
+namespace_semilattice_metadata_v1_11_t<rdb_protocol_t> to_v1_11(
+        const namespace_semilattice_metadata_t<rdb_protocol_t> &ns) {
+    namespace_semilattice_metadata_v1_11_t<rdb_protocol_t> old;
+    old.blueprint = ns.blueprint;
+    old.primary_datacenter = ns.primary_datacenter;
+    old.replica_affinities = ns.replica_affinities;
+    old.ack_expectations = ns.ack_expectations;
+    old.shards = ns.shards;
+    old.name = ns.name;
+    old.port = ns.port;
+    old.primary_pinnings = ns.primary_pinnings;
+    old.secondary_pinnings = ns.secondary_pinnings;
+    old.primary_key = ns.primary_key;
+    old.database = ns.database;
+    old.cache_size = ns.cache_size;
+    return old;
+}
+
+namespace_semilattice_metadata_t<rdb_protocol_t> make_test_table(const machine_id_t &machine,
+                                                                 const std::string &name,
+                                                                 int64_t block_size) {
+    name_string_t table_name;
+    bool assign_res = table_name.assign_value(name);
+    guarantee(assign_res);
+    return new_namespace<rdb_protocol_t>(machine, generate_uuid(), generate_uuid(),
+                                         table_name, "id", 0, 123 * MEGABYTE, block_size);
+}
+
+TEST(NamespaceMetadataTest, ReadV1_11Layout) {
+    const machine_id_t machine = generate_uuid();
+    const namespace_id_t live_id = generate_uuid();
+    const namespace_id_t deleted_id = generate_uuid();
+    // Whatever block size the current version would give a table, the files of
+    // a table from version 1.11 have the default one.
+    const namespace_semilattice_metadata_t<rdb_protocol_t> table
+        = make_test_table(machine, "t", 2 * DEFAULT_BTREE_BLOCK_SIZE);
+
+    namespaces_semilattice_metadata_v1_11_t<rdb_protocol_t> old;
+    old.namespaces[live_id] = make_deletable(to_v1_11(table));
+    old.namespaces[deleted_id].mark_deleted();
+
+    // In a file, other records come right after the namespaces, so every record
+    // has to end where version 1.11's did.
+    write_message_t wm;
+    wm << old;
+    wm << std::string("after");
+    string_stream_t write_stream;
+    ASSERT_EQ(0, send_write_message(&write_stream, &wm));
+    string_read_stream_t read_stream(std::move(write_stream.str()), 0);
+    namespaces_semilattice_metadata_v1_11_t<rdb_protocol_t> read;
+    ASSERT_EQ(ARCHIVE_SUCCESS, deserialize(&read_stream, &read));
+    std::string after;
+    ASSERT_EQ(ARCHIVE_SUCCESS, deserialize(&read_stream, &after));
+    ASSERT_EQ("after", after);
+
+    namespaces_semilattice_metadata_t<rdb_protocol_t> converted = from_v1_11(read);
+    ASSERT_EQ(2u, converted.namespaces.size());
+    ASSERT_TRUE(converted.namespaces[deleted_id].is_deleted());
+    ASSERT_FALSE(converted.namespaces[live_id].is_deleted());
+    const namespace_semilattice_metadata_t<rdb_protocol_t> &ns
+        = converted.namespaces[live_id].get_ref();
+
+    // The fields that version 1.11 had are what they were, and the others have
+    // their unversioned defaults.
+    namespace_semilattice_metadata_t<rdb_protocol_t> expected = table;
+    expected.max_backfill_mb_per_sec = vclock_t<int64_t>(0);
+    expected.near_cache_rows = vclock_t<int64_t>(0);
+    expected.block_size = vclock_t<int64_t>(DEFAULT_BTREE_BLOCK_SIZE);
+    ASSERT_TRUE(expected == ns);
+    ASSERT_EQ(123 * MEGABYTE, ns.cache_size.get());
+    ASSERT_EQ(0, ns.max_backfill_mb_per_sec.get());
+    ASSERT_EQ(0, ns.near_cache_rows.get());
+    ASSERT_EQ(DEFAULT_BTREE_BLOCK_SIZE, ns.block_size.get());
+
+    // A change that any server makes to them wins over the defaults.
+    namespace_semilattice_metadata_t<rdb_protocol_t> changed = ns;
+    changed.max_backfill_mb_per_sec
+        = changed.max_backfill_mb_per_sec.make_new_version(50, machine);
+    changed.near_cache_rows = changed.near_cache_rows.make_new_version(1000, machine);
+    namespace_semilattice_metadata_t<rdb_protocol_t> joined = ns;
+    semilattice_join(&joined, changed);
+    ASSERT_FALSE(joined.max_backfill_mb_per_sec.in_conflict());
+    ASSERT_EQ(50, joined.max_backfill_mb_per_sec.get());
+    ASSERT_FALSE(joined.near_cache_rows.in_conflict());
+    ASSERT_EQ(1000, joined.near_cache_rows.get());
+}
+
+// The superblock of a cluster metadata file from version 1.11.
+struct v1_11_cluster_metadata_superblock_t {
+    block_magic_t magic;
+
+    machine_id_t machine_id;
+
+    static const int METADATA_BLOB_MAXREFLEN = 1500;
+    char metadata_blob[METADATA_BLOB_MAXREFLEN];
+
+    static const int BRANCH_HISTORY_BLOB_MAXREFLEN = 500;
+    char dummy_branch_history_blob[BRANCH_HISTORY_BLOB_MAXREFLEN];
+    char memcached_branch_history_blob[BRANCH_HISTORY_BLOB_MAXREFLEN];
+    char rdb_branch_history_blob[BRANCH_HISTORY_BLOB_MAXREFLEN];
+};
+
+template <class T>
+void write_v1_11_blob(transaction_t *txn, char *ref, int maxreflen, const T &value) {
+    write_message_t wm;
+    wm << value;
+    string_stream_t stream;
+    int write_res = send_write_message(&stream, &wm);
+    guarantee(write_res == 0);
+    blob_t blob(txn->get_cache()->get_block_size(), ref, maxreflen);
+    blob.append_region(txn, stream.str().size());
+    blob.write_from_string(stream.str(), txn, 0);
+}
+
+// Writes the metadata file that version 1.11 would have written.
+void write_v1_11_file(io_backender_t *io_backender, const serializer_filepath_t &filename,
+                      const machine_id_t &machine_id,
+                      const cluster_semilattice_metadata_v1_11_t &metadata) {
+    filepath_file_opener_t file_opener(filename, io_backender);
+    standard_serializer_t::create(&file_opener, standard_serializer_t::static_config_t());
+    standard_serializer_t serializer(standard_serializer_t::dynamic_config_t(),
+                                     &file_opener, &get_global_perfmon_collection());
+    file_opener.move_serializer_file_to_permanent_location();
+    cache_t::create(&serializer);
+    cache_t cache(&serializer, mirrored_cache_config_t(), &get_global_perfmon_collection());
+
+    order_source_t order_source;
+    transaction_t txn(&cache, rwi_write, 1, repli_timestamp_t::distant_past,
+                      order_source.check_in("write_v1_11_file"), WRITE_DURABILITY_HARD);
+    buf_lock_t superblock(&txn, SUPERBLOCK_ID, rwi_write);
+    v1_11_cluster_metadata_superblock_t *sb
+        = static_cast<v1_11_cluster_metadata_superblock_t *>(superblock.get_data_write());
+    bzero(sb, cache.get_block_size().value());
+    const block_magic_t magic = { { 'R', 'D', 'm', 'd' } };
+    sb->magic = magic;
+    sb->machine_id = machine_id;
+    write_v1_11_blob(&txn, sb->metadata_blob,
+                     v1_11_cluster_metadata_superblock_t::METADATA_BLOB_MAXREFLEN, metadata);
+    write_v1_11_blob(&txn, sb->dummy_branch_history_blob,
+                     v1_11_cluster_metadata_superblock_t::BRANCH_HISTORY_BLOB_MAXREFLEN,
+                     branch_history_t<mock::dummy_protocol_t>());
+    write_v1_11_blob(&txn, sb->memcached_branch_history_blob,
+                     v1_11_cluster_metadata_superblock_t::BRANCH_HISTORY_BLOB_MAXREFLEN,
+                     branch_history_t<memcached_protocol_t>());
+    write_v1_11_blob(&txn, sb->rdb_branch_history_blob,
+                     v1_11_cluster_metadata_superblock_t::BRANCH_HISTORY_BLOB_MAXREFLEN,
+                     branch_history_t<rdb_protocol_t>());
+}
+
+// The superblock magic that the metadata file has.
+block_magic_t read_superblock_magic(io_backender_t *io_backender,
+                                    const serializer_filepath_t &filename) {
+    filepath_file_opener_t file_opener(filename, io_backender);
+    standard_serializer_t serializer(standard_serializer_t::dynamic_config_t(),
+                                     &file_opener, &get_global_perfmon_collection());
+    cache_t cache(&serializer, mirrored_cache_config_t(), &get_global_perfmon_collection());
+    order_source_t order_source;
+    transaction_t txn(&cache, rwi_read, order_source.check_in("read_superblock_magic"));
+    buf_lock_t superblock(&txn, SUPERBLOCK_ID, rwi_read);
+    return static_cast<const v1_11_cluster_metadata_superblock_t *>(
+        superblock.get_data_read())->magic;
+}
+
+void run_read_v1_11_file_test() {
+    temp_file_t temp_file;
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+
+    const machine_id_t machine_id = generate_uuid();
+    const namespace_id_t table_id = generate_uuid();
+    const namespace_id_t deleted_table_id = generate_uuid();
+    const database_id_t database_id = generate_uuid();
+    cluster_semilattice_metadata_v1_11_t old;
+    old.rdb_namespaces.namespaces[table_id]
+        = make_deletable(to_v1_11(make_test_table(machine_id, "t", DEFAULT_BTREE_BLOCK_SIZE)));
+    old.rdb_namespaces.namespaces[deleted_table_id].mark_deleted();
+    database_semilattice_metadata_t database;
+    name_string_t database_name;
+    bool assign_res = database_name.assign_value("db");
+    guarantee(assign_res);
+    database.name = make_vclock(database_name, machine_id);
+    old.databases.databases[database_id] = make_deletable(database);
+    write_v1_11_file(&io_backender, temp_file.name(), machine_id, old);
+
+    cluster_semilattice_metadata_t expected = from_v1_11(old);
+    {
+        metadata_persistence::cluster_persistent_file_t file(
+            &io_backender, temp_file.name(), &get_global_perfmon_collection());
+        ASSERT_EQ(machine_id, file.read_machine_id());
+        ASSERT_TRUE(expected == file.read_metadata());
+        ASSERT_TRUE(file.get_rdb_branch_history_manager()->known_branches().empty());
+    }
+
+    // Opening the file converted it.
+    const block_magic_t namespace_records_magic = { { 'R', 'D', 'm', 'n' } };
+    ASSERT_TRUE(namespace_records_magic
+                == read_superblock_magic(&io_backender, temp_file.name()));
+
+    cluster_semilattice_metadata_t changed = expected;
+    {
+        metadata_persistence::cluster_persistent_file_t file(
+            &io_backender, temp_file.name(), &get_global_perfmon_collection());
+        ASSERT_EQ(machine_id, file.read_machine_id());
+        const cluster_semilattice_metadata_t metadata = file.read_metadata();
+        ASSERT_TRUE(expected == metadata);
+        const namespace_semilattice_metadata_t<rdb_protocol_t> &table
+            = metadata.rdb_namespaces->namespaces.find(table_id)->second.get_ref();
+        ASSERT_EQ(DEFAULT_BTREE_BLOCK_SIZE, table.block_size.get());
+        ASSERT_EQ(0, table.near_cache_rows.get());
+
+        {
+            cow_ptr_t<namespaces_semilattice_metadata_t<rdb_protocol_t> >::change_t change(
+                &changed.rdb_namespaces);
+            namespace_semilattice_metadata_t<rdb_protocol_t> *ns
+                = change.get()->namespaces[table_id].get_mutable();
+            ns->near_cache_rows = ns->near_cache_rows.make_new_version(100, machine_id);
+        }
+        file.update_metadata(changed);
+    }
+    {
+        metadata_persistence::cluster_persistent_file_t file(
+            &io_backender, temp_file.name(), &get_global_perfmon_collection());
+        ASSERT_TRUE(changed == file.read_metadata());
+    }
+}
+
+TEST(ClusterPersistentFileTest, ReadV1_11File) {
+    run_in_thread_pool(run_read_v1_11_file_test);
+}
+
+}  // namespace unittest
@@ -0,0 +1,53 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "rdb_protocol/near_cache.hpp"
+
+#include "containers/uuid.hpp"
+#include "rdb_protocol/datum.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+counted_t<const ql::datum_t> make_row(double value) {
+    return make_counted<const ql::datum_t>(value);
+}
+
+void run_evicts_least_recently_used_test() {
+    ql::near_cache_t cache;
+    uuid_u table = generate_uuid();
+    cache.put(table, 2, store_key_t("a"), make_row(1));
+    cache.put(table, 2, store_key_t("b"), make_row(2));
+    counted_t<const ql::datum_t> row;
+    // Uses "a", so that "b" goes first.
+    ASSERT_TRUE(cache.get(table, store_key_t("a"), &row));
+    EXPECT_EQ(1, row->as_num());
+    cache.put(table, 2, store_key_t("c"), make_row(3));
+    EXPECT_FALSE(cache.get(table, store_key_t("b"), &row));
+    ASSERT_TRUE(cache.get(table, store_key_t("a"), &row));
+    EXPECT_EQ(1, row->as_num());
+    ASSERT_TRUE(cache.get(table, store_key_t("c"), &row));
+    EXPECT_EQ(3, row->as_num());
+}
+
+TEST(NearCache, EvictsLeastRecentlyUsed) {
+    unittest::run_in_thread_pool(&run_evicts_least_recently_used_test);
+}
+
+void run_forget_table_test() {
+    ql::near_cache_t cache;
+    uuid_u written = generate_uuid();
+    uuid_u other = generate_uuid();
+    cache.put(written, 10, store_key_t("a"), make_row(1));
+    cache.put(other, 10, store_key_t("a"), make_row(2));
+    cache.forget_table(written);
+    counted_t<const ql::datum_t> row;
+    EXPECT_FALSE(cache.get(written, store_key_t("a"), &row));
+    ASSERT_TRUE(cache.get(other, store_key_t("a"), &row));
+    EXPECT_EQ(2, row->as_num());
+}
+
+TEST(NearCache, ForgetTable) {
+    unittest::run_in_thread_pool(&run_forget_table_test);
+}
+
+}  // namespace unittest
@@ -0,0 +1,35 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <vector>
+
+#include "unittest/gtest.hpp"
+
+#include "arch/runtime/numa.hpp"
+
+namespace unittest {
+
+TEST(NumaTest, ParseCpuList) {
+    std::vector<int> cpus;
+    ASSERT_TRUE(parse_cpu_list("0-3,8,10-11\n", &cpus));
+    const int expected[] = { 0, 1, 2, 3, 8, 10, 11 };
+    ASSERT_EQ(std::vector<int>(expected, expected + 7), cpus);
+
+    ASSERT_TRUE(parse_cpu_list("\n", &cpus));
+    ASSERT_TRUE(cpus.empty());
+
+    ASSERT_FALSE(parse_cpu_list("3-1", &cpus));
+    ASSERT_FALSE(parse_cpu_list("0-", &cpus));
+    ASSERT_FALSE(parse_cpu_list("a", &cpus));
+}
+
+TEST(NumaTest, TopologyHasEveryNodeNonEmpty) {
+    numa_topology_t topology;
+    ASSERT_LE(1, topology.num_nodes());
+    size_t total = 0;
+    for (int node = 0; node < topology.num_nodes(); ++node) {
+        ASSERT_FALSE(topology.cpus_of_node(node).empty());
+        total += topology.cpus_of_node(node).size();
+    }
+    ASSERT_EQ(total, topology.cpus_by_node().size());
+}
+
+}  // namespace unittest
@@ -4,6 +4,7 @@
 #include <math.h>
 
 #include <cmath>  // for std::isnan -- read the comment below.
+#include <limits>
 
 #include "perfmon/perfmon.hpp"
 #include "unittest/gtest.hpp"
@@ -57,4 +58,45 @@ TEST(PerfmonTest, StddevComputation) {
     }
 }
 
+TEST(PerfmonTest, HistogramBuckets) {
+    using perfmon_histogram::bucket_of;
+    using perfmon_histogram::num_buckets;
+
+    EXPECT_EQ(0, bucket_of(1.0, 0.0));
+    EXPECT_EQ(0, bucket_of(1.0, 1.0));
+    EXPECT_EQ(1, bucket_of(1.0, 1.5));
+    EXPECT_EQ(1, bucket_of(1.0, 2.0));
+    EXPECT_EQ(2, bucket_of(1.0, 3.0));
+    EXPECT_EQ(10, bucket_of(0.001, 1.0));
+
+    // The last bucket takes everything that is too big for the others.
+    EXPECT_EQ(num_buckets - 1, bucket_of(1.0, ldexp(1.0, num_buckets - 2) + 1));
+    EXPECT_EQ(num_buckets - 1, bucket_of(1.0, 1e30));
+}
+
+TEST(PerfmonTest, HdrHistogramBuckets) {
+    using perfmon_hdr_histogram::bucket_of;
+    using perfmon_hdr_histogram::highest_value_of;
+    using perfmon_hdr_histogram::num_buckets;
+    using perfmon_hdr_histogram::sub_buckets;
+
+    // Small values are counted exactly.
+    for (int i = 0; i < 2 * sub_buckets; ++i) {
+        EXPECT_EQ(i, bucket_of(i));
+        EXPECT_EQ(static_cast<uint64_t>(i), highest_value_of(i));
+    }
+
+    // Every bucket starts right after the one before it ends, and is at most a
+    // sixteenth as wide as the values in it.
+    for (int i = sub_buckets; i < num_buckets; ++i) {
+        const uint64_t lowest = highest_value_of(i - 1) + 1;
+        EXPECT_EQ(i, bucket_of(lowest));
+        EXPECT_EQ(i, bucket_of(highest_value_of(i)));
+        EXPECT_LE((highest_value_of(i) - lowest + 1) * sub_buckets, lowest);
+    }
+
+    // The last bucket takes everything that is too big for the others.
+    EXPECT_EQ(num_buckets - 1, bucket_of(std::numeric_limits<uint64_t>::max()));
+}
+
 }  // namespace unittest
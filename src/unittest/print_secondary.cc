@@ -1,6 +1,7 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "unittest/gtest.hpp"
 #include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/pseudo_time.hpp"
 
 namespace unittest {
 void test_mangle(const std::string &pkey, const std::string &skey, boost::optional<uint64_t> tag = boost::optional<uint64_t>()) {
@@ -23,4 +24,113 @@ TEST(PrintSecondary, Mangle) {
     test_mangle("ffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff",
                 "bbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbb");
 }
+
+counted_t<const ql::datum_t> make_array(counted_t<const ql::datum_t> a,
+                                        counted_t<const ql::datum_t> b) {
+    std::vector<counted_t<const ql::datum_t> > array;
+    array.push_back(a);
+    if (b.has()) {
+        array.push_back(b);
+    }
+    return make_counted<const ql::datum_t>(std::move(array));
+}
+
+TEST(PrintSecondary, BinaryOrder) {
+    // In the order `datum_t::cmp` puts them in.
+    std::vector<counted_t<const ql::datum_t> > values;
+    values.push_back(make_array(make_counted<const ql::datum_t>(1.0),
+                                counted_t<const ql::datum_t>()));
+    values.push_back(make_array(make_counted<const ql::datum_t>(1.0),
+                                make_counted<const ql::datum_t>("a")));
+    values.push_back(make_array(make_counted<const ql::datum_t>(2.0),
+                                counted_t<const ql::datum_t>()));
+    values.push_back(make_counted<const ql::datum_t>(ql::datum_t::R_BOOL, false));
+    values.push_back(make_counted<const ql::datum_t>(ql::datum_t::R_BOOL, true));
+    values.push_back(make_counted<const ql::datum_t>(-1e100));
+    values.push_back(make_counted<const ql::datum_t>(-1.5));
+    values.push_back(make_counted<const ql::datum_t>(0.0));
+    values.push_back(make_counted<const ql::datum_t>(0.25));
+    values.push_back(make_counted<const ql::datum_t>(1e100));
+    values.push_back(make_counted<const ql::datum_t>(""));
+    values.push_back(make_counted<const ql::datum_t>("a"));
+    values.push_back(make_counted<const ql::datum_t>("ab"));
+    values.push_back(make_counted<const ql::datum_t>("b"));
+    values.push_back(ql::pseudo::make_time(0, "+00:00"));
+    values.push_back(ql::pseudo::make_time(100, "-07:00"));
+
+    // The primary keys go the other way, which mustn't matter.
+    std::vector<std::string> keys;
+    for (size_t i = 0; i < values.size(); ++i) {
+        store_key_t pkey(strprintf("S%zu", values.size() - i));
+        keys.push_back(values[i]->print_secondary(ql::sindex_key_format_t::BINARY, pkey));
+    }
+    for (size_t i = 0; i + 1 < values.size(); ++i) {
+        EXPECT_LT(values[i]->cmp(*values[i + 1]), 0);
+        EXPECT_LT(keys[i], keys[i + 1]) << values[i]->print();
+    }
+
+    // The values that aren't pseudotypes come back out of the keys.
+    for (size_t i = 0; i < values.size(); ++i) {
+        counted_t<const ql::datum_t> value = ql::datum_t::from_binary_secondary(
+            ql::datum_t::extract_secondary(keys[i]));
+        if (values[i]->is_ptype()) {
+            EXPECT_FALSE(value.has());
+        } else {
+            ASSERT_TRUE(value.has());
+            EXPECT_EQ(*values[i], *value);
+        }
+    }
+}
+
+TEST(PrintSecondary, BinaryTruncation) {
+    std::string long_string(MAX_KEY_SIZE * 2, 'x');
+    counted_t<const ql::datum_t> value = make_counted<const ql::datum_t>(
+        std::string(long_string));
+    std::string key = value->print_secondary(ql::sindex_key_format_t::BINARY,
+                                             store_key_t("S1"));
+    // Without a tag, the key leaves room for one.
+    EXPECT_EQ(MAX_KEY_SIZE - sizeof(uint64_t), key.size());
+    EXPECT_TRUE(ql::datum_t::key_is_truncated(store_key_t(key)));
+    EXPECT_FALSE(ql::datum_t::from_binary_secondary(
+                     ql::datum_t::extract_secondary(key)).has());
+
+    // A number is 9 bytes, instead of the dozens of the printed format.
+    std::string num_key = make_counted<const ql::datum_t>(1.5)->print_secondary(
+        ql::sindex_key_format_t::BINARY, store_key_t("S1"));
+    EXPECT_EQ(9u, ql::datum_t::extract_secondary(num_key).size());
+}
+
+TEST(PrintSecondary, HashKeys) {
+    std::string long_string(MAX_KEY_SIZE * 2, 'x');
+    std::vector<counted_t<const ql::datum_t> > values;
+    values.push_back(make_counted<const ql::datum_t>(1.5));
+    values.push_back(make_counted<const ql::datum_t>("a"));
+    values.push_back(make_counted<const ql::datum_t>(std::string(long_string)));
+    values.push_back(make_array(make_counted<const ql::datum_t>(1.5),
+                                make_counted<const ql::datum_t>("a")));
+
+    std::vector<std::string> secondaries;
+    for (size_t i = 0; i < values.size(); ++i) {
+        std::string key = values[i]->print_secondary(ql::sindex_key_format_t::HASH,
+                                                     store_key_t("S1"));
+        // Any value hashes to a key that is never truncated.
+        std::string secondary = ql::datum_t::extract_secondary(key);
+        EXPECT_EQ(sizeof(uint64_t), secondary.size());
+        EXPECT_FALSE(ql::datum_t::key_is_truncated(store_key_t(key)));
+        // The keys `get_all` looks for are the same for the same value.
+        EXPECT_EQ(key_to_unescaped_str(
+                      values[i]->truncated_secondary(ql::sindex_key_format_t::HASH)),
+                  secondary);
+        for (size_t j = 0; j < secondaries.size(); ++j) {
+            EXPECT_NE(secondaries[j], secondary);
+        }
+        secondaries.push_back(secondary);
+    }
+
+    // Equal values hash alike, however they were made.
+    EXPECT_EQ(make_counted<const ql::datum_t>(0.0)->truncated_secondary(
+                  ql::sindex_key_format_t::HASH),
+              make_counted<const ql::datum_t>(-0.0)->truncated_secondary(
+                  ql::sindex_key_format_t::HASH));
+}
 };
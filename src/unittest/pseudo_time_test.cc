@@ -0,0 +1,234 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include <math.h>
+
+#include <string>
+#include <vector>
+
+#include "errors.hpp"
+#include <boost/date_time.hpp>
+
+#include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/error.hpp"
+#include "rdb_protocol/pseudo_time.hpp"
+#include "unittest/gtest.hpp"
+#include "utils.hpp"
+
+namespace unittest {
+
+// The time zones of time objects are always `+HH:MM`, but the ones that boost
+// rejects, or that sanitize_time() would never leave, go through boost too.
+const char *const offsets[] = { "+00:00", "+05:30", "-03:30", "+13:45", "-09:00",
+                                "-12:00", "+14:00", "-12:01", "+14:01", "+23:59",
+                                "-00:00" };
+const size_t num_offsets = sizeof(offsets) / sizeof(offsets[0]);
+
+// The seconds from the epoch to midnight UTC at the start of the day.
+double epoch_seconds(int year, int month, int day) {
+    const boost::posix_time::ptime epoch(boost::gregorian::date(1970, 1, 1));
+    const boost::posix_time::ptime t(boost::gregorian::date(year, month, day));
+    return (t - epoch).total_seconds();
+}
+
+// What the conversions of the time at `epoch_time` in `tz` give, or the errors
+// they throw, either through their fast paths or through boost.
+std::string time_conversions(double epoch_time, const std::string &tz, bool with_boost) {
+    counted_t<const ql::datum_t> time = ql::pseudo::make_time(epoch_time, tz);
+    std::string out;
+    try {
+        out += with_boost
+            ? ql::pseudo::time_to_iso8601_with_boost(time)
+            : ql::pseudo::time_to_iso8601(time);
+    } catch (const ql::base_exc_t &e) {
+        out += strprintf("error: %s", e.what());
+    }
+    for (int c = ql::pseudo::YEAR; c <= ql::pseudo::SECONDS; ++c) {
+        const ql::pseudo::time_component_t component
+            = static_cast<ql::pseudo::time_component_t>(c);
+        try {
+            out += strprintf(" %.17g", with_boost
+                             ? ql::pseudo::time_portion_with_boost(time, component)
+                             : ql::pseudo::time_portion(time, component));
+        } catch (const ql::base_exc_t &e) {
+            out += strprintf(" error: %s", e.what());
+        }
+    }
+    return out;
+}
+
+void check_time(double epoch_time, const std::string &tz) {
+    SCOPED_TRACE(strprintf("%.17g %s", epoch_time, tz.c_str()));
+    ASSERT_EQ(time_conversions(epoch_time, tz, true),
+              time_conversions(epoch_time, tz, false));
+}
+
+// Fails the way a term without a backtrace would.
+class test_rcheckable_t : public ql::rcheckable_t {
+public:
+    void runtime_fail(ql::base_exc_t::type_t type,
+                      const char *test, const char *file, int line,
+                      std::string msg) const {
+        ql::runtime_fail(type, test, file, line, msg);
+    }
+};
+
+// What parsing `s` gives, or the error it throws.
+std::string parsed_time(const std::string &s, const std::string &default_tz,
+                        bool with_boost) {
+    test_rcheckable_t target;
+    try {
+        counted_t<const ql::datum_t> time = with_boost
+            ? ql::pseudo::iso8601_to_time_with_boost(s, default_tz, &target)
+            : ql::pseudo::iso8601_to_time(s, default_tz, &target);
+        return strprintf("%.17g %s", ql::pseudo::time_to_epoch_time(time),
+                         time->get("timezone")->as_str().c_str());
+    } catch (const ql::base_exc_t &e) {
+        return strprintf("error: %s", e.what());
+    }
+}
+
+void check_parse(const std::string &s, const std::string &default_tz) {
+    SCOPED_TRACE("`" + s + "` with default time zone `" + default_tz + "`");
+    ASSERT_EQ(parsed_time(s, default_tz, true), parsed_time(s, default_tz, false));
+}
+
+void check_parse_fails(const std::string &s, const std::string &default_tz) {
+    check_parse(s, default_tz);
+    ASSERT_EQ(0, parsed_time(s, default_tz, false).find("error: "));
+}
+
+TEST(PseudoTimeTest, TimesAroundDayBoundaries) {
+    // Leap years and not, on both sides of 1970, and the first and last days
+    // boost has.
+    const int years[] = { 1400, 1401, 1600, 1700, 1899, 1900, 1904, 1960, 1969,
+                          1970, 1971, 1972, 2000, 2004, 2013, 2100, 2400, 9998, 9999 };
+    const double within_day[] = { 0, 1, -1, 0.5, -0.5, 0.25, 0.001, -0.001, 0.0005,
+                                  0.9999, 59.999, 86399.999, -86399.999 };
+    for (size_t y = 0; y < sizeof(years) / sizeof(years[0]); ++y) {
+        std::vector<double> days;
+        days.push_back(epoch_seconds(years[y], 1, 1));
+        days.push_back(epoch_seconds(years[y], 2, 28));
+        days.push_back(epoch_seconds(years[y], 3, 1));
+        days.push_back(epoch_seconds(years[y], 12, 31));
+        if (boost::gregorian::gregorian_calendar::is_leap_year(years[y])) {
+            days.push_back(epoch_seconds(years[y], 2, 29));
+        }
+        for (size_t d = 0; d < days.size(); ++d) {
+            for (size_t s = 0; s < sizeof(within_day) / sizeof(within_day[0]); ++s) {
+                for (size_t o = 0; o < num_offsets; ++o) {
+                    check_time(days[d] + within_day[s], offsets[o]);
+                }
+            }
+        }
+    }
+}
+
+TEST(PseudoTimeTest, TimesOutsideBoostsDates) {
+    // The fast paths stop at 1400-01-01 and 9999-12-31, in UTC and local time,
+    // and leave the times past them to boost's errors.
+    const double first = epoch_seconds(1400, 1, 1);
+    const double after_last = epoch_seconds(9999, 12, 31) + 86400;
+    const double around[] = { 0, 1, -1, 0.5, -0.5, 3600, -3600, 14 * 3600, -14 * 3600,
+                              86400, -86400, 400 * 86400, -400 * 86400 };
+    for (size_t i = 0; i < sizeof(around) / sizeof(around[0]); ++i) {
+        for (size_t o = 0; o < num_offsets; ++o) {
+            check_time(first + around[i], offsets[o]);
+            check_time(after_last + around[i], offsets[o]);
+        }
+    }
+    check_time(1e12, "+00:00");
+    check_time(-1e12, "+00:00");
+}
+
+TEST(PseudoTimeTest, RandomTimes) {
+    rng_t rng(4321);
+    const double first = epoch_seconds(1400, 1, 1) - 400 * 86400;
+    const double span = epoch_seconds(9999, 12, 31) + 400 * 86400 - first;
+    for (int i = 0; i < 20000; ++i) {
+        double epoch_time = first + rng.randdouble() * span;
+        // Most times that get stored have whole seconds or milliseconds.
+        switch (rng.randint(3)) {
+        case 0: epoch_time = floor(epoch_time); break;
+        case 1: epoch_time = floor(epoch_time * 1000) / 1000; break;
+        case 2: break;
+        default: unreachable();
+        }
+        check_time(epoch_time, offsets[rng.randint(num_offsets)]);
+    }
+}
+
+TEST(PseudoTimeTest, ParseCommonForm) {
+    const char *const dates[] = { "1400-01-01", "1400-03-01", "1600-02-29", "1899-12-31",
+                                  "1900-02-28", "1900-03-01", "1969-12-31", "1970-01-01",
+                                  "2000-02-29", "2004-02-29", "2013-07-04", "2100-02-28",
+                                  "9999-12-31" };
+    const char *const times[] = { "00:00:00", "23:59:59", "12:34:56", "00:00:00.0",
+                                  "23:59:59.999", "12:34:56.5", "12:34:56.12",
+                                  "12:34:56.123456", "12:34:56.0009",
+                                  "12:34:56.9999999" };
+    const char *const zones[] = { "Z", "+00:00", "+05:30", "-03:30", "+13:45", "-12:00",
+                                  "+14:00", "-12:30", "+14:30", "" };
+    const char *const default_zones[] = { "", "+02:00", "-07:00", "Z", "-0700" };
+    for (size_t d = 0; d < sizeof(dates) / sizeof(dates[0]); ++d) {
+        for (size_t t = 0; t < sizeof(times) / sizeof(times[0]); ++t) {
+            for (size_t z = 0; z < sizeof(zones) / sizeof(zones[0]); ++z) {
+                const std::string s = std::string(dates[d]) + "T" + times[t] + zones[z];
+                for (size_t dz = 0; dz < sizeof(default_zones) / sizeof(default_zones[0]);
+                     ++dz) {
+                    check_parse(s, default_zones[dz]);
+                }
+            }
+        }
+    }
+    // In UTC, these are past the dates boost has.
+    check_parse("1400-01-01T00:00:00+01:00", "");
+    check_parse("1400-01-01T00:59:59+01:00", "");
+    check_parse("9999-12-31T23:00:00-01:00", "");
+    check_parse("9999-12-31T22:59:59-01:00", "");
+    check_parse("1399-12-31T23:59:59-01:00", "");
+    check_parse("1399-12-31T23:59:59Z", "");
+    check_parse("10000-01-01T00:00:00Z", "");
+}
+
+TEST(PseudoTimeTest, ParseOtherForms) {
+    // Everything else goes through boost, and has to keep working.
+    check_parse("2013-07-04", "+00:00");
+    check_parse("2013-07-04", "");
+    check_parse("20130704T123456Z", "");
+    check_parse("2013-185T12:34:56Z", "");
+    check_parse("2013-07-04T12:34Z", "");
+    check_parse("2013-07-04T12Z", "");
+    check_parse("2013-07-04T12:34:56+0530", "");
+    check_parse("2013-07-04T12:34:56+05", "");
+    check_parse("2013-07-04T12:34:56-00", "");
+    check_parse("2013-07-04T12:34:56", "Z");
+}
+
+TEST(PseudoTimeTest, ParseMalformed) {
+    check_parse_fails("", "");
+    check_parse_fails("2013", "");
+    check_parse_fails("abcd-01-01T00:00:00Z", "");
+    check_parse_fails("2013-13-01T00:00:00Z", "");
+    check_parse_fails("2013-00-10T00:00:00Z", "");
+    check_parse_fails("2013-02-29T00:00:00Z", "");
+    check_parse_fails("1900-02-29T00:00:00Z", "");
+    check_parse_fails("2013-04-31T00:00:00Z", "");
+    check_parse_fails("2013-01-01T00:00:00-00:00", "");
+    check_parse_fails("2013-01-01T00:00:00+05:30x", "");
+    check_parse_fails("2013-01-01T00:00:00+05:60", "");
+    check_parse_fails("2013-01-01T00:00:00+25:00", "");
+    check_parse_fails("2013-01-01T00:00:00", "");
+    check_parse_fails("2013-W01-1T00:00:00Z", "");
+    // Whether boost takes these or not, the fast paths don't.
+    check_parse("2013-01-01T24:00:00Z", "");
+    check_parse("2013-01-01T23:60:00Z", "");
+    check_parse("2013-01-01T23:59:60Z", "");
+    check_parse("2013-01-01T00:00:00.Z", "");
+    check_parse("2013-01-01T00:00:00.", "+00:00");
+    check_parse("2013-01-01T00:00:00 Z", "");
+    check_parse("2013-01-01 00:00:00Z", "");
+    check_parse("2013-01-01T0:00:00Z", "");
+    check_parse("2013-01-01T00:00:00.12a", "+00:00");
+    check_parse("2013-01-01T00:00:00Zabc", "");
+}
+
+}  // namespace unittest
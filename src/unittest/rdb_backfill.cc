@@ -88,6 +88,7 @@ void run_with_broadcaster(
                                        &branch_history_manager,
                                        broadcaster.get(),
                                        &get_global_perfmon_collection(),
+                                       NULL,
                                        &interruptor,
                                        &order_source));
 
@@ -198,9 +199,12 @@ void run_backfill_test(size_t value_padding_length,
         broadcaster_metadata_view,
         branch_history_manager,
         &store2.store,
-        replier_business_card_variable.get_watchable(),
+        std::vector<listener_t<rdb_protocol_t>::replier_watchable_t>(1,
+            replier_business_card_variable.get_watchable()),
         generate_uuid(),
+        false,
         &get_global_perfmon_collection(),
+        NULL,
         &interruptor,
         order_source);
 
@@ -310,9 +314,12 @@ void run_sindex_backfill_test(std::pair<io_backender_t *, simple_mailbox_cluster
         broadcaster_metadata_view,
         branch_history_manager,
         &store2.store,
-        replier_business_card_variable.get_watchable(),
+        std::vector<listener_t<rdb_protocol_t>::replier_watchable_t>(1,
+            replier_business_card_variable.get_watchable()),
         generate_uuid(),
+        false,
         &get_global_perfmon_collection(),
+        NULL,
         &interruptor,
         order_source);
 
@@ -7,6 +7,7 @@
 #include "arch/runtime/coroutines.hpp"
 #include "arch/timing.hpp"
 #include "btree/btree_store.hpp"
+#include "btree/erase_range.hpp"
 #include "btree/operations.hpp"
 #include "buffer_cache/mirrored/config.hpp"
 #include "containers/archive/boost_types.hpp"
@@ -440,6 +441,351 @@ TEST(RDBBtree, SindexEraseRange) {
     run_in_thread_pool(&run_erase_range_test);
 }
 
+/* Writes (or deletes) the rows without touching the sindexes, and returns the
+ * mod reports for updating them later. */
+void write_rows_unindexed(int start, int finish, bool deleting,
+                          btree_store_t<rdb_protocol_t> *store,
+                          std::vector<rdb_modification_report_t> *mod_reports_out) {
+    for (int i = start; i < finish; ++i) {
+        cond_t dummy_interruptor;
+        scoped_ptr_t<transaction_t> txn;
+        scoped_ptr_t<real_superblock_t> superblock;
+        write_token_pair_t token_pair;
+        store->new_write_token_pair(&token_pair);
+        store->acquire_superblock_for_write(
+            repli_timestamp_t::invalid,
+            1, WRITE_DURABILITY_SOFT,
+            &token_pair, &txn, &superblock, &dummy_interruptor);
+
+        store_key_t pk(make_counted<const ql::datum_t>(double(i))->print_primary());
+        mod_reports_out->push_back(rdb_modification_report_t(pk));
+        if (!deleting) {
+            std::string data = strprintf("{\"id\" : %d, \"sid\" : %d}", i, i * i);
+            point_write_response_t response;
+            rdb_set(pk,
+                    make_counted<ql::datum_t>(scoped_cJSON_t(cJSON_Parse(data.c_str()))),
+                    false, store->btree.get(), repli_timestamp_t::invalid, txn.get(),
+                    superblock.get(), &response, &mod_reports_out->back().info,
+                    static_cast<profile::trace_t *>(NULL));
+        } else {
+            point_delete_response_t response;
+            rdb_delete(pk, store->btree.get(), repli_timestamp_t::invalid, txn.get(),
+                       superblock.get(), &response, &mod_reports_out->back().info,
+                       static_cast<profile::trace_t *>(NULL));
+        }
+    }
+}
+
+void update_sindexes_in_one_batch(
+        btree_store_t<rdb_protocol_t> *store,
+        const std::vector<rdb_modification_report_t> &mod_reports) {
+    cond_t dummy_interruptor;
+    scoped_ptr_t<transaction_t> txn;
+    scoped_ptr_t<real_superblock_t> superblock;
+    write_token_pair_t token_pair;
+    store->new_write_token_pair(&token_pair);
+    store->acquire_superblock_for_write(
+        repli_timestamp_t::invalid,
+        1, WRITE_DURABILITY_SOFT,
+        &token_pair, &txn, &superblock, &dummy_interruptor);
+
+    scoped_ptr_t<buf_lock_t> sindex_block;
+    store->acquire_sindex_block_for_write(
+            &token_pair, txn.get(), &sindex_block,
+            superblock->get_sindex_block_id(), &dummy_interruptor);
+
+    btree_store_t<rdb_protocol_t>::sindex_access_vector_t sindexes;
+    store->aquire_post_constructed_sindex_superblocks_for_write(
+             sindex_block.get(), txn.get(), &sindexes);
+    ASSERT_EQ(1u, sindexes.size());
+    rdb_update_sindexes(sindexes, mod_reports, txn.get());
+}
+
+void run_sindex_batched_update_test() {
+    recreate_temporary_directory(base_path_t("."));
+    temp_file_t temp_file;
+
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+
+    filepath_file_opener_t file_opener(temp_file.name(), &io_backender);
+    standard_serializer_t::create(
+        &file_opener,
+        standard_serializer_t::static_config_t());
+
+    standard_serializer_t serializer(
+        standard_serializer_t::dynamic_config_t(),
+        &file_opener,
+        &get_global_perfmon_collection());
+
+    rdb_protocol_t::store_t store(
+            &serializer,
+            "unit_test_store",
+            GIGABYTE,
+            true,
+            &get_global_perfmon_collection(),
+            NULL,
+            &io_backender,
+            base_path_t("."));
+
+    std::string sindex_id = create_sindex(&store);
+    bring_sindexes_up_to_date(&store, sindex_id);
+
+    /* Enough keys for the sindex to have several leaves, so that the batch both
+     * reuses leaves and walks down to new ones. */
+    std::vector<rdb_modification_report_t> inserts;
+    write_rows_unindexed(0, TOTAL_KEYS_TO_INSERT, false, &store, &inserts);
+    update_sindexes_in_one_batch(&store, inserts);
+    check_keys_are_present(&store, sindex_id);
+
+    std::vector<rdb_modification_report_t> deletes;
+    write_rows_unindexed(0, TOTAL_KEYS_TO_INSERT, true, &store, &deletes);
+    update_sindexes_in_one_batch(&store, deletes);
+    check_keys_are_NOT_present(&store, sindex_id);
+}
+
+TEST(RDBBtree, SindexBatchedUpdate) {
+    run_in_thread_pool(&run_sindex_batched_update_test);
+}
+
+int64_t count_rows(btree_store_t<rdb_protocol_t> *store, const key_range_t &range) {
+    cond_t dummy_interruptor;
+    read_token_pair_t token_pair;
+    store->new_read_token_pair(&token_pair);
+
+    scoped_ptr_t<transaction_t> txn;
+    scoped_ptr_t<real_superblock_t> super_block;
+    store->acquire_superblock_for_read(rwi_read,
+            &token_pair.main_read_token, &txn, &super_block,
+            &dummy_interruptor, true);
+
+    rdb_protocol_t::rget_read_response_t res;
+    ql::env_t dummy_env(NULL);
+    rdb_rget_slice(
+        store->btree.get(), range, txn.get(), super_block.get(), &dummy_env,
+        ql::batchspec_t::user(ql::batch_type_t::TERMINAL,
+                              counted_t<const ql::datum_t>()),
+        rdb_protocol_details::transform_t(),
+        boost::optional<rdb_protocol_details::terminal_t>(
+            rdb_protocol_details::terminal_t(ql::count_wire_func_t())),
+        sorting_t::UNORDERED,
+        &res);
+
+    counted_t<const ql::datum_t> *count
+        = boost::get<counted_t<const ql::datum_t> >(&res.result);
+    guarantee(count != NULL);
+    return (*count)->as_int();
+}
+
+store_key_t primary_key(int i) {
+    return store_key_t(make_counted<const ql::datum_t>(double(i))->print_primary());
+}
+
+void run_erase_subrange_test() {
+    recreate_temporary_directory(base_path_t("."));
+    temp_file_t temp_file;
+
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+
+    filepath_file_opener_t file_opener(temp_file.name(), &io_backender);
+    standard_serializer_t::create(
+        &file_opener,
+        standard_serializer_t::static_config_t());
+
+    standard_serializer_t serializer(
+        standard_serializer_t::dynamic_config_t(),
+        &file_opener,
+        &get_global_perfmon_collection());
+
+    rdb_protocol_t::store_t store(
+            &serializer,
+            "unit_test_store",
+            GIGABYTE,
+            true,
+            &get_global_perfmon_collection(),
+            NULL,
+            &io_backender,
+            base_path_t("."));
+
+    cond_t dummy_interruptor;
+
+    insert_rows(0, TOTAL_KEYS_TO_INSERT, &store);
+    ASSERT_EQ(TOTAL_KEYS_TO_INSERT, count_rows(&store, key_range_t::universe()));
+
+    /* Erase a range in the middle, which drops the leaves in between its ends. */
+    const key_range_t erased(key_range_t::closed, primary_key(TOTAL_KEYS_TO_INSERT / 5),
+                             key_range_t::open, primary_key((TOTAL_KEYS_TO_INSERT * 4) / 5));
+    int64_t expected = 0;
+    for (int i = 0; i < TOTAL_KEYS_TO_INSERT; ++i) {
+        expected += erased.contains_key(primary_key(i)) ? 0 : 1;
+    }
+    ASSERT_LT(expected, TOTAL_KEYS_TO_INSERT);
+
+    {
+        write_token_pair_t token_pair;
+        store.new_write_token_pair(&token_pair);
+
+        scoped_ptr_t<transaction_t> txn;
+        scoped_ptr_t<real_superblock_t> super_block;
+        store.acquire_superblock_for_write(repli_timestamp_t::invalid,
+                                           1,
+                                           WRITE_DURABILITY_SOFT,
+                                           &token_pair,
+                                           &txn,
+                                           &super_block,
+                                           &dummy_interruptor);
+
+        always_true_key_tester_t tester;
+        rdb_erase_range(store.btree.get(), &tester, erased,
+            txn.get(), super_block.get(), &store, &token_pair,
+            &dummy_interruptor);
+    }
+
+    /* The first count comes from the stat block, the other two walk the leaves
+    (numbers' primary keys all start with "N"). */
+    ASSERT_EQ(expected, count_rows(&store, key_range_t::universe()));
+    ASSERT_EQ(0, count_rows(&store, erased));
+    ASSERT_EQ(expected, count_rows(&store, key_range_t(key_range_t::closed, store_key_t("N"),
+                                                       key_range_t::none, store_key_t())));
+
+    /* The tree is still in shape for writes. */
+    insert_rows(0, TOTAL_KEYS_TO_INSERT, &store);
+    ASSERT_EQ(TOTAL_KEYS_TO_INSERT, count_rows(&store, key_range_t::universe()));
+    ASSERT_EQ(TOTAL_KEYS_TO_INSERT - expected, count_rows(&store, erased));
+}
+
+TEST(RDBBtree, EraseSubrange) {
+    run_in_thread_pool(&run_erase_subrange_test);
+}
+
+void run_sampled_distribution_test() {
+    recreate_temporary_directory(base_path_t("."));
+    temp_file_t temp_file;
+
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+
+    filepath_file_opener_t file_opener(temp_file.name(), &io_backender);
+    standard_serializer_t::create(
+        &file_opener,
+        standard_serializer_t::static_config_t());
+
+    standard_serializer_t serializer(
+        standard_serializer_t::dynamic_config_t(),
+        &file_opener,
+        &get_global_perfmon_collection());
+
+    rdb_protocol_t::store_t store(
+            &serializer,
+            "unit_test_store",
+            GIGABYTE,
+            true,
+            &get_global_perfmon_collection(),
+            NULL,
+            &io_backender,
+            base_path_t("."));
+
+    cond_t dummy_interruptor;
+
+    insert_rows(0, TOTAL_KEYS_TO_INSERT, &store);
+
+    read_token_pair_t token_pair;
+    store.new_read_token_pair(&token_pair);
+
+    scoped_ptr_t<transaction_t> txn;
+    scoped_ptr_t<real_superblock_t> super_block;
+    store.acquire_superblock_for_read(rwi_read,
+            &token_pair.main_read_token, &txn, &super_block,
+            &dummy_interruptor, true);
+
+    rdb_protocol_t::distribution_read_response_t res;
+    rdb_distribution_get(store.btree.get(), distribution_mode_t::SAMPLE, 0,
+                         store_key_t::min(), txn.get(), super_block.get(), &res);
+
+    /* Each bucket's estimate gets rounded down, but together they make up the
+    population. */
+    ASSERT_FALSE(res.key_counts.empty());
+    ASSERT_EQ(store_key_t::min(), res.key_counts.begin()->first);
+    ASSERT_EQ(res.key_counts.size(), res.byte_counts.size());
+    int64_t total_keys = 0;
+    for (auto it = res.key_counts.begin(); it != res.key_counts.end(); ++it) {
+        ASSERT_GT(it->second, 0);
+        ASSERT_GT(res.byte_counts[it->first], 0);
+        total_keys += it->second;
+    }
+    ASSERT_LE(total_keys, TOTAL_KEYS_TO_INSERT);
+    ASSERT_GT(total_keys + static_cast<int64_t>(res.key_counts.size()), TOTAL_KEYS_TO_INSERT);
+}
+
+TEST(RDBBtree, SampledDistribution) {
+    run_in_thread_pool(&run_sampled_distribution_test);
+}
+
+void run_multi_get_test() {
+    recreate_temporary_directory(base_path_t("."));
+    temp_file_t temp_file;
+
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+
+    filepath_file_opener_t file_opener(temp_file.name(), &io_backender);
+    standard_serializer_t::create(
+        &file_opener,
+        standard_serializer_t::static_config_t());
+
+    standard_serializer_t serializer(
+        standard_serializer_t::dynamic_config_t(),
+        &file_opener,
+        &get_global_perfmon_collection());
+
+    rdb_protocol_t::store_t store(
+            &serializer,
+            "unit_test_store",
+            GIGABYTE,
+            true,
+            &get_global_perfmon_collection(),
+            NULL,
+            &io_backender,
+            base_path_t("."));
+
+    cond_t dummy_interruptor;
+
+    insert_rows(0, TOTAL_KEYS_TO_INSERT, &store);
+
+    read_token_pair_t token_pair;
+    store.new_read_token_pair(&token_pair);
+
+    scoped_ptr_t<transaction_t> txn;
+    scoped_ptr_t<real_superblock_t> super_block;
+    store.acquire_superblock_for_read(rwi_read,
+            &token_pair.main_read_token, &txn, &super_block,
+            &dummy_interruptor, true);
+
+    /* Every seventh row, out of order and some of them twice, spread over many
+    leaves, and some rows that don't exist. */
+    std::vector<store_key_t> keys;
+    for (int i = 7 * (TOTAL_KEYS_TO_INSERT * 2 / 7); i >= 0; i -= 7) {
+        keys.push_back(primary_key(i));
+        if (i % 3 == 0) {
+            keys.push_back(primary_key(i));
+        }
+    }
+
+    rdb_protocol_t::multi_point_read_response_t res;
+    rdb_get_multi(keys, store.btree.get(), txn.get(), super_block.get(), &res,
+                  static_cast<profile::trace_t *>(NULL));
+
+    size_t expected = 0;
+    for (int i = 0; i < TOTAL_KEYS_TO_INSERT; i += 7) {
+        ++expected;
+        auto it = res.rows.find(primary_key(i));
+        ASSERT_TRUE(it != res.rows.end());
+        ASSERT_EQ(i, it->second->get("id")->as_int());
+    }
+    ASSERT_EQ(expected, res.rows.size());
+}
+
+TEST(RDBBtree, MultiGet) {
+    run_in_thread_pool(&run_multi_get_test);
+}
+
 void run_sindex_interruption_via_drop_test() {
     recreate_temporary_directory(base_path_t("."));
     temp_file_t temp_file;
@@ -97,6 +97,17 @@ void mock_namespace_interface_t::read_visitor_t::operator()(const rdb_protocol_t
     }
 }
 
+void mock_namespace_interface_t::read_visitor_t::operator()(const rdb_protocol_t::multi_point_read_t &get) {
+    response->response = rdb_protocol_t::multi_point_read_response_t();
+    rdb_protocol_t::multi_point_read_response_t &res = boost::get<rdb_protocol_t::multi_point_read_response_t>(response->response);
+
+    for (auto it = get.keys.begin(); it != get.keys.end(); ++it) {
+        if (data->find(*it) != data->end()) {
+            res.rows[*it] = make_counted<ql::datum_t>(scoped_cJSON_t(data->at(*it)->DeepCopy()));
+        }
+    }
+}
+
 void NORETURN mock_namespace_interface_t::read_visitor_t::operator()(UNUSED const rdb_protocol_t::rget_read_t &rget) {
     throw cannot_perform_query_exc_t("unimplemented");
 }
@@ -113,6 +124,14 @@ void NORETURN mock_namespace_interface_t::read_visitor_t::operator()(UNUSED cons
     throw cannot_perform_query_exc_t("unimplemented");
 }
 
+void NORETURN mock_namespace_interface_t::read_visitor_t::operator()(UNUSED const rdb_protocol_t::changefeed_subscribe_t &s) {
+    throw cannot_perform_query_exc_t("unimplemented");
+}
+
+void NORETURN mock_namespace_interface_t::read_visitor_t::operator()(UNUSED const rdb_protocol_t::text_search_t &ts) {
+    throw cannot_perform_query_exc_t("unimplemented");
+}
+
 mock_namespace_interface_t::read_visitor_t::read_visitor_t(std::map<store_key_t, scoped_cJSON_t *> *_data,
                                                            rdb_protocol_t::read_response_t *_response) :
     data(_data), response(_response) {
@@ -207,6 +226,26 @@ void mock_namespace_interface_t::write_visitor_t::operator()(
     response->response = stats;
 }
 
+void NORETURN mock_namespace_interface_t::write_visitor_t::operator()(const rdb_protocol_t::bulk_insert_t &) {
+    throw cannot_perform_query_exc_t("unimplemented");
+}
+
+void NORETURN mock_namespace_interface_t::write_visitor_t::operator()(const rdb_protocol_t::range_replace_t &) {
+    throw cannot_perform_query_exc_t("unimplemented");
+}
+
+void NORETURN mock_namespace_interface_t::write_visitor_t::operator()(const rdb_protocol_t::range_delete_t &) {
+    throw cannot_perform_query_exc_t("unimplemented");
+}
+
+void NORETURN mock_namespace_interface_t::write_visitor_t::operator()(const rdb_protocol_t::sindex_range_delete_t &) {
+    throw cannot_perform_query_exc_t("unimplemented");
+}
+
+void NORETURN mock_namespace_interface_t::write_visitor_t::operator()(const rdb_protocol_t::combined_insert_t &) {
+    throw cannot_perform_query_exc_t("unimplemented");
+}
+
 void NORETURN mock_namespace_interface_t::write_visitor_t::operator()(const rdb_protocol_t::point_write_t &) {
     throw cannot_perform_query_exc_t("unimplemented");
 }
@@ -66,10 +66,13 @@ private:
 
     struct read_visitor_t : public boost::static_visitor<void> {
         void operator()(const rdb_protocol_t::point_read_t &get);
+        void operator()(const rdb_protocol_t::multi_point_read_t &get);
         void NORETURN operator()(UNUSED const rdb_protocol_t::rget_read_t &rget);
         void NORETURN operator()(UNUSED const rdb_protocol_t::distribution_read_t &dg);
         void NORETURN operator()(UNUSED const rdb_protocol_t::sindex_list_t &sl);
         void NORETURN operator()(UNUSED const rdb_protocol_t::sindex_status_t &ss);
+        void NORETURN operator()(UNUSED const rdb_protocol_t::changefeed_subscribe_t &s);
+        void NORETURN operator()(UNUSED const rdb_protocol_t::text_search_t &ts);
 
         read_visitor_t(std::map<store_key_t, scoped_cJSON_t*> *_data, rdb_protocol_t::read_response_t *_response);
 
@@ -80,6 +83,11 @@ private:
     struct write_visitor_t : public boost::static_visitor<void> {
         void operator()(const rdb_protocol_t::batched_replace_t &br);
         void operator()(const rdb_protocol_t::batched_insert_t &br);
+        void NORETURN operator()(UNUSED const rdb_protocol_t::bulk_insert_t &bi);
+        void NORETURN operator()(UNUSED const rdb_protocol_t::range_replace_t &rr);
+        void NORETURN operator()(UNUSED const rdb_protocol_t::range_delete_t &rd);
+        void NORETURN operator()(UNUSED const rdb_protocol_t::sindex_range_delete_t &srd);
+        void NORETURN operator()(UNUSED const rdb_protocol_t::combined_insert_t &ci);
         void NORETURN operator()(UNUSED const rdb_protocol_t::point_write_t &w);
         void NORETURN operator()(UNUSED const rdb_protocol_t::point_delete_t &d);
         void NORETURN operator()(UNUSED const rdb_protocol_t::sindex_create_t &s);
@@ -24,18 +24,31 @@ public:
         sequence_number(0)
         { }
     void send(int message, peer_id_t peer) {
+        send_padded(message, peer, message_class_t::control, 0);
+    }
+    /* Sends `padding` more bytes after the integer. */
+    void send_padded(int message, peer_id_t peer, message_class_t message_class,
+                     size_t padding) {
         class writer_t : public send_message_write_callback_t {
         public:
-            explicit writer_t(int _data) : data(_data) { }
+            writer_t(int _data, message_class_t _message_class, size_t _padding) :
+                data(_data), message_class(_message_class), padding(_padding) { }
             virtual ~writer_t() { }
             void write(write_stream_t *stream) {
                 write_message_t msg;
                 msg << data;
+                std::string pad(padding, 'x');
+                msg.append(pad.data(), pad.size());
                 int res = send_write_message(stream, &msg);
                 if (res) { throw fake_archive_exc_t(); }
             }
+            message_class_t get_message_class() const {
+                return message_class;
+            }
             int32_t data;
-        } writer(message);
+            message_class_t message_class;
+            size_t padding;
+        } writer(message, message_class, padding);
         service->send_message(peer, &writer);
     }
     void expect(int message, peer_id_t peer) {
@@ -197,6 +210,104 @@ TEST(RPCConnectivityTest, OrderingMultiThread) {
     unittest::run_in_thread_pool(&run_ordering_test, 3);
 }
 
+/* `CoalescedOrdering` sends many messages at once from separate coroutines, so
+that they get written together, and checks that they still arrive in order. */
+
+void run_coalesced_ordering_test() {
+    connectivity_cluster_t c1, c2;
+    recording_test_application_t a1(&c1), a2(&c2);
+    connectivity_cluster_t::run_t cr1(&c1, get_unittest_addresses(), peer_address_t(), ANY_PORT, &a1, 0, NULL);
+    connectivity_cluster_t::run_t cr2(&c2, get_unittest_addresses(), peer_address_t(), ANY_PORT, &a2, 0, NULL);
+
+    cr1.join(c2.get_peer_address(c2.get_me()));
+
+    let_stuff_happen();
+
+    for (int i = 0; i < 100; i++) {
+        coro_t::spawn_sometime(boost::bind(&recording_test_application_t::send,
+                                           &a1, i, c2.get_me()));
+    }
+
+    let_stuff_happen();
+
+    for (int i = 0; i < 99; i++) {
+        a2.expect_order(i, i+1);
+    }
+}
+TEST(RPCConnectivityTest, CoalescedOrdering) {
+    unittest::run_in_thread_pool(&run_coalesced_ordering_test);
+}
+
+/* `BulkMessage` checks that large bulk messages get through when there are
+bulk connections between the nodes, and that small messages still do too. */
+
+void run_bulk_message_test() {
+    connectivity_cluster_t c1, c2;
+    recording_test_application_t a1(&c1), a2(&c2);
+    connectivity_cluster_t::run_t cr1(&c1, get_unittest_addresses(), peer_address_t(), ANY_PORT, &a1, 0, NULL, 3);
+    connectivity_cluster_t::run_t cr2(&c2, get_unittest_addresses(), peer_address_t(), ANY_PORT, &a2, 0, NULL, 3);
+
+    cr1.join(c2.get_peer_address(c2.get_me()));
+
+    let_stuff_happen();
+
+    for (int i = 0; i < 10; i++) {
+        a1.send_padded(i, c2.get_me(), message_class_t::bulk, CLUSTER_BULK_MESSAGE_MIN_BYTES);
+        a2.send_padded(100 + i, c1.get_me(), message_class_t::bulk, CLUSTER_BULK_MESSAGE_MIN_BYTES);
+        a1.send(200 + i, c2.get_me());
+    }
+
+    let_stuff_happen();
+
+    for (int i = 0; i < 10; i++) {
+        a2.expect(i, c1.get_me());
+        a1.expect(100 + i, c2.get_me());
+        a2.expect(200 + i, c1.get_me());
+    }
+    for (int i = 200; i < 209; i++) {
+        a2.expect_order(i, i + 1);
+    }
+}
+TEST(RPCConnectivityTest, BulkMessage) {
+    unittest::run_in_thread_pool(&run_bulk_message_test);
+}
+TEST(RPCConnectivityTest, BulkMessageMultiThread) {
+    unittest::run_in_thread_pool(&run_bulk_message_test, 3);
+}
+
+/* `CompressedMessage` checks that messages get through when one of the nodes
+asks for compression, whether or not they are large enough to be compressed. */
+
+void run_compressed_message_test() {
+    connectivity_cluster_t c1, c2;
+    recording_test_application_t a1(&c1), a2(&c2);
+    connectivity_cluster_t::run_t cr1(&c1, get_unittest_addresses(), peer_address_t(), ANY_PORT, &a1, 0, NULL,
+                                      2, cluster_compression_t::all);
+    connectivity_cluster_t::run_t cr2(&c2, get_unittest_addresses(), peer_address_t(), ANY_PORT, &a2, 0, NULL,
+                                      2, cluster_compression_t::none);
+
+    cr2.join(c1.get_peer_address(c1.get_me()));
+
+    let_stuff_happen();
+
+    for (int i = 0; i < 10; i++) {
+        a1.send_padded(i, c2.get_me(), message_class_t::control, CLUSTER_COMPRESSION_MIN_BYTES);
+        a2.send_padded(100 + i, c1.get_me(), message_class_t::bulk, CLUSTER_BULK_MESSAGE_MIN_BYTES);
+        a2.send(200 + i, c1.get_me());
+    }
+
+    let_stuff_happen();
+
+    for (int i = 0; i < 10; i++) {
+        a2.expect(i, c1.get_me());
+        a1.expect(100 + i, c2.get_me());
+        a1.expect(200 + i, c2.get_me());
+    }
+}
+TEST(RPCConnectivityTest, CompressedMessage) {
+    unittest::run_in_thread_pool(&run_compressed_message_test);
+}
+
 /* `GetPeersList` confirms that the behavior of `cluster_t::get_peers_list()` is
 correct. */
 
@@ -2,7 +2,9 @@
 #include "unittest/gtest.hpp"
 
 #include "arch/timing.hpp"
+#include "config/args.hpp"
 #include "rpc/connectivity/cluster.hpp"
+#include "rpc/directory/delta.hpp"
 #include "rpc/directory/read_manager.hpp"
 #include "rpc/directory/write_manager.hpp"
 #include "unittest/unittest_utils.hpp"
@@ -92,6 +94,48 @@ TEST(RPCDirectoryTest, Update) {
     unittest::run_in_thread_pool(&run_update_test, 1);
 }
 
+/* `ManyUpdates` tests that peers keep up through enough updates that some of
+them are sent whole. */
+
+void run_many_updates_test() {
+    connectivity_cluster_t c1, c2;
+    directory_read_manager_t<int> rm1(&c1), rm2(&c2);
+    watchable_variable_t<int> w1(101), w2(202);
+    directory_write_manager_t<int> wm1(&c1, w1.get_watchable()), wm2(&c2, w2.get_watchable());
+    connectivity_cluster_t::run_t cr1(&c1, get_unittest_addresses(), peer_address_t(), ANY_PORT, &rm1, 0, NULL);
+    connectivity_cluster_t::run_t cr2(&c2, get_unittest_addresses(), peer_address_t(), ANY_PORT, &rm2, 0, NULL);
+    cr2.join(c1.get_peer_address(c1.get_me()));
+    let_stuff_happen();
+    for (int i = 0; i < 3 * DIRECTORY_FULL_UPDATE_INTERVAL; i++) {
+        w1.set_value(1000 + i * 7919);
+    }
+    let_stuff_happen();
+    ASSERT_EQ(1u, rm2.get_root_view()->get().count(c1.get_me()));
+    EXPECT_EQ(1000 + (3 * DIRECTORY_FULL_UPDATE_INTERVAL - 1) * 7919,
+              rm2.get_root_view()->get().find(c1.get_me())->second);
+}
+TEST(RPCDirectoryTest, ManyUpdates) {
+    unittest::run_in_thread_pool(&run_many_updates_test, 1);
+}
+
+/* `Delta` checks that `directory_delta_t` turns the old value into the new
+one. */
+
+TEST(RPCDirectoryTest, Delta) {
+    const char *values[] = { "", "a", "abc", "abxc", "xbxc", "xbxcyy", "yy", "" };
+    for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); ++i) {
+        for (size_t j = 0; j < sizeof(values) / sizeof(values[0]); ++j) {
+            std::string value = values[i];
+            directory_delta_t delta(value, values[j]);
+            EXPECT_TRUE(delta.apply(&value));
+            EXPECT_EQ(values[j], value);
+        }
+    }
+    std::string too_short = "ab";
+    directory_delta_t delta("abcdef", "abcxef");
+    EXPECT_FALSE(delta.apply(&too_short));
+}
+
 /* `DestructorRace` tests a nasty race condition that we had at some point. */
 
 void run_destructor_race_test() {
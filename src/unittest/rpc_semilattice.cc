@@ -188,6 +188,53 @@ TEST(RPCSemilatticeTest, Watcher) {
     unittest::run_in_thread_pool(&run_watcher_test, 2);
 }
 
+/* `UnchangedJoin` makes sure that metadata watchers don't get notified by a
+join that adds nothing. */
+
+void run_unchanged_join_test() {
+    connectivity_cluster_t cluster;
+    semilattice_manager_t<sl_int_t> slm(&cluster, sl_int_t(3));
+    connectivity_cluster_t::run_t run(&cluster, get_unittest_addresses(), peer_address_t(), ANY_PORT, &slm, 0, NULL);
+
+    bool have_been_notified = false;
+    semilattice_read_view_t<sl_int_t>::subscription_t watcher(
+        boost::bind(&assign<bool>, &have_been_notified, true),
+        slm.get_root_view());
+
+    slm.get_root_view()->join(sl_int_t(1));
+
+    EXPECT_FALSE(have_been_notified);
+    EXPECT_EQ(3u, slm.get_root_view()->get().i);
+}
+TEST(RPCSemilatticeTest, UnchangedJoin) {
+    unittest::run_in_thread_pool(&run_unchanged_join_test, 2);
+}
+
+/* `SameMetadata` checks that nodes which start out with the same metadata,
+and so never send it to each other, can still sync with each other. */
+
+void run_same_metadata_test() {
+    connectivity_cluster_t cluster1, cluster2;
+    semilattice_manager_t<sl_int_t> slm1(&cluster1, sl_int_t(5)), slm2(&cluster2, sl_int_t(5));
+    connectivity_cluster_t::run_t run1(&cluster1, get_unittest_addresses(), peer_address_t(), ANY_PORT, &slm1, 0, NULL);
+    connectivity_cluster_t::run_t run2(&cluster2, get_unittest_addresses(), peer_address_t(), ANY_PORT, &slm2, 0, NULL);
+
+    run1.join(cluster2.get_peer_address(cluster2.get_me()));
+    let_stuff_happen();
+
+    cond_t non_interruptor;
+    slm1.get_root_view()->sync_from(cluster2.get_me(), &non_interruptor);
+    slm2.get_root_view()->sync_to(cluster1.get_me(), &non_interruptor);
+    EXPECT_EQ(5u, slm1.get_root_view()->get().i);
+
+    slm2.get_root_view()->join(sl_int_t(8));
+    slm2.get_root_view()->sync_to(cluster1.get_me(), &non_interruptor);
+    EXPECT_EQ(13u, slm1.get_root_view()->get().i);
+}
+TEST(RPCSemilatticeTest, SameMetadata) {
+    unittest::run_in_thread_pool(&run_same_metadata_test, 2);
+}
+
 /* `ViewController` tests `dummy_semilattice_controller_t`. */
 
 void run_view_controller_test() {
@@ -1,4 +1,10 @@
+#include <string>
+#include <vector>
+
 #include "arch/runtime/starter.hpp"
+#include "concurrency/cond_var.hpp"
+#include "containers/archive/vector_stream.hpp"
+#include "serializer/backup.hpp"
 #include "serializer/config.hpp"
 #include "unittest/mock_file.hpp"
 #include "unittest/gtest.hpp"
@@ -20,5 +26,263 @@ TEST(SerializerTest, CreateConstructDestroy) {
     run_in_thread_pool(run_CreateConstructDestroy, 4);
 }
 
+void write_blocks(serializer_t *ser, const std::vector<std::string> &contents,
+                  boost::optional<repli_timestamp_t> recency = boost::none) {
+    scoped_ptr_t<file_account_t> account(ser->make_io_account(1, io_activity_t::other));
+
+    std::vector<scoped_ser_buffer_t > bufs;
+    std::vector<buf_write_info_t> write_infos;
+    for (size_t i = 0; i < contents.size(); ++i) {
+        bufs.push_back(ser->malloc());
+        memcpy(bufs.back()->cache_data, contents[i].data(), contents[i].size());
+        write_infos.push_back(buf_write_info_t(bufs.back().get(), ser->get_block_size(), i));
+    }
+
+    struct : public iocallback_t, public cond_t {
+        void on_io_complete() { pulse(); }
+    } block_write_cond;
+    std::vector<counted_t<standard_block_token_t> > tokens
+        = ser->block_writes(write_infos, account.get(), &block_write_cond);
+    block_write_cond.wait();
+
+    std::vector<index_write_op_t> index_write_ops;
+    for (size_t i = 0; i < tokens.size(); ++i) {
+        index_write_ops.push_back(index_write_op_t(i, tokens[i], recency));
+    }
+    ser->index_write(index_write_ops, account.get());
+}
+
+void check_blocks(serializer_t *ser, const std::vector<std::string> &contents) {
+    scoped_ptr_t<file_account_t> account(ser->make_io_account(1, io_activity_t::other));
+    for (size_t i = 0; i < contents.size(); ++i) {
+        counted_t<standard_block_token_t> token = ser->index_read(i);
+        ASSERT_TRUE(token.has());
+        EXPECT_EQ(ser->get_block_size().ser_value(), token->block_size().ser_value());
+
+        scoped_ser_buffer_t buf = ser->malloc();
+        ser->block_read(token, buf.get(), account.get());
+        EXPECT_EQ(i, buf->ser_header.block_id);
+        EXPECT_EQ(contents[i], std::string(buf->cache_data, contents[i].size()));
+    }
+}
+
+void run_CompressedBlocks() {
+    mock_file_opener_t file_opener;
+    standard_serializer_t::create(&file_opener, standard_serializer_t::static_config_t());
+    standard_serializer_t::dynamic_config_t dynamic_config;
+    dynamic_config.compress_blocks = true;
+
+    // Alternate between blocks that compress well and ones that don't compress
+    // at all, so that both kinds get packed into the same extent.
+    const size_t size = standard_serializer_t::static_config_t().block_size().value();
+    std::vector<std::string> contents;
+    for (int i = 0; i < 100; ++i) {
+        std::string s(size, '\0');
+        for (size_t j = 0; j < size; ++j) {
+            s[j] = i % 2 == 0 ? "abcd"[randint(4)] : randint(256);
+        }
+        contents.push_back(s);
+    }
+
+    {
+        standard_serializer_t ser(dynamic_config, &file_opener,
+                                  &get_global_perfmon_collection());
+        write_blocks(&ser, contents);
+        check_blocks(&ser, contents);
+    }
+
+    // The blocks must still be readable after reconstructing the index from disk.
+    {
+        standard_serializer_t ser(dynamic_config, &file_opener,
+                                  &get_global_perfmon_collection());
+        check_blocks(&ser, contents);
+    }
+}
+
+TEST(SerializerTest, CompressedBlocks) {
+    run_in_thread_pool(run_CompressedBlocks, 4);
+}
+
+void run_LargeBlocks() {
+    // A file keeps the block size it was created with, so that tables created
+    // with a larger `block_size` read their blocks back whole.
+    mock_file_opener_t file_opener;
+    standard_serializer_t::static_config_t static_config;
+    static_config.block_size_ = 4 * DEFAULT_BTREE_BLOCK_SIZE;
+    standard_serializer_t::create(&file_opener, static_config);
+
+    const size_t size = static_config.block_size().value();
+    std::vector<std::string> contents(10);
+    for (size_t i = 0; i < contents.size(); ++i) {
+        contents[i] = strprintf("block %zu", i);
+        contents[i].resize(size, 'a' + i);
+    }
+
+    {
+        standard_serializer_t ser(standard_serializer_t::dynamic_config_t(),
+                                  &file_opener,
+                                  &get_global_perfmon_collection());
+        ASSERT_EQ(size, ser.get_block_size().value());
+        write_blocks(&ser, contents);
+        check_blocks(&ser, contents);
+    }
+
+    {
+        standard_serializer_t ser(standard_serializer_t::dynamic_config_t(),
+                                  &file_opener,
+                                  &get_global_perfmon_collection());
+        ASSERT_EQ(size, ser.get_block_size().value());
+        check_blocks(&ser, contents);
+    }
+}
+
+TEST(SerializerTest, LargeBlocks) {
+    run_in_thread_pool(run_LargeBlocks, 4);
+}
+
+void run_DiscardFreedExtents() {
+    mock_file_opener_t file_opener;
+    standard_serializer_t::create(&file_opener, standard_serializer_t::static_config_t());
+    standard_serializer_t::dynamic_config_t dynamic_config;
+    dynamic_config.discard_freed_extents = true;
+
+    // Overwrite the same blocks again and again, so that lots of extents get
+    // freed (and discarded) while the ones with live blocks must stay intact.
+    const size_t size = standard_serializer_t::static_config_t().block_size().value();
+    std::vector<std::string> contents(100);
+    {
+        standard_serializer_t ser(dynamic_config, &file_opener,
+                                  &get_global_perfmon_collection());
+        for (int round = 0; round < 20; ++round) {
+            for (size_t i = 0; i < contents.size(); ++i) {
+                contents[i] = strprintf("round %d block %zu", round, i);
+                contents[i].resize(size, 'x');
+            }
+            write_blocks(&ser, contents);
+        }
+        check_blocks(&ser, contents);
+    }
+
+    {
+        standard_serializer_t ser(dynamic_config, &file_opener,
+                                  &get_global_perfmon_collection());
+        check_blocks(&ser, contents);
+    }
+}
+
+TEST(SerializerTest, DiscardFreedExtents) {
+    run_in_thread_pool(run_DiscardFreedExtents, 4);
+}
+
+void run_BlockReads() {
+    mock_file_opener_t file_opener;
+    standard_serializer_t::create(&file_opener, standard_serializer_t::static_config_t());
+    standard_serializer_t::dynamic_config_t dynamic_config;
+    dynamic_config.compress_blocks = true;
+
+    const size_t size = standard_serializer_t::static_config_t().block_size().value();
+    std::vector<std::string> contents;
+    for (int i = 0; i < 100; ++i) {
+        std::string s(size, '\0');
+        for (size_t j = 0; j < size; ++j) {
+            s[j] = i % 3 == 0 ? "abcd"[randint(4)] : randint(256);
+        }
+        contents.push_back(s);
+    }
+
+    standard_serializer_t log_ser(dynamic_config, &file_opener,
+                                  &get_global_perfmon_collection());
+    serializer_t *ser = &log_ser;
+    write_blocks(ser, contents);
+
+    // Read every other block, in reverse order, so that the reads that get merged
+    // have gaps in them and their blocks don't come in the order they are on disk.
+    scoped_ptr_t<file_account_t> account(ser->make_io_account(1, io_activity_t::other));
+    std::vector<block_id_t> ids;
+    std::vector<counted_t<standard_block_token_t> > tokens;
+    std::vector<scoped_ser_buffer_t > bufs;
+    std::vector<ser_buffer_t *> buf_ptrs;
+    for (block_id_t i = contents.size(); i > 0; i -= 2) {
+        ids.push_back(i - 1);
+        tokens.push_back(ser->index_read(i - 1));
+        ASSERT_TRUE(tokens.back().has());
+        bufs.push_back(ser->malloc());
+        buf_ptrs.push_back(bufs.back().get());
+    }
+    ser->block_reads(tokens, buf_ptrs, account.get());
+
+    for (size_t i = 0; i < ids.size(); ++i) {
+        EXPECT_EQ(ids[i], bufs[i]->ser_header.block_id);
+        EXPECT_EQ(contents[ids[i]], std::string(bufs[i]->cache_data, size));
+    }
+}
+
+TEST(SerializerTest, BlockReads) {
+    run_in_thread_pool(run_BlockReads, 4);
+}
+
+
+void run_PhysicalBackup() {
+    const size_t size = standard_serializer_t::static_config_t().block_size().value();
+    std::vector<std::string> contents;
+    for (int i = 0; i < 100; ++i) {
+        contents.push_back(strprintf("block %d", i));
+        contents.back().resize(size, 'x');
+    }
+    repli_timestamp_t first_recency;
+    first_recency.longtime = 1;
+    repli_timestamp_t second_recency;
+    second_recency.longtime = 5;
+
+    cond_t non_interruptor;
+    vector_stream_t full_backup;
+    vector_stream_t incremental_backup;
+    {
+        mock_file_opener_t file_opener;
+        standard_serializer_t::create(&file_opener, standard_serializer_t::static_config_t());
+        standard_serializer_t log_ser(standard_serializer_t::dynamic_config_t(), &file_opener,
+                                      &get_global_perfmon_collection());
+        serializer_t *ser = &log_ser;
+        write_blocks(ser, contents, first_recency);
+        ASSERT_TRUE(physical_backup(ser, repli_timestamp_t::distant_past, &full_backup,
+                                    &non_interruptor));
+
+        // Only the blocks written after the full backup go into the incremental one.
+        std::vector<std::string> changed(contents.begin(), contents.begin() + 10);
+        for (size_t i = 0; i < changed.size(); ++i) {
+            changed[i][0] = 'B';
+            contents[i] = changed[i];
+        }
+        write_blocks(ser, changed, second_recency);
+        ASSERT_TRUE(physical_backup(ser, first_recency, &incremental_backup,
+                                    &non_interruptor));
+    }
+    ASSERT_LT(incremental_backup.vector().size(), full_backup.vector().size() / 5);
+
+    mock_file_opener_t file_opener;
+    standard_serializer_t::create(&file_opener, standard_serializer_t::static_config_t());
+    standard_serializer_t log_ser(standard_serializer_t::dynamic_config_t(), &file_opener,
+                                  &get_global_perfmon_collection());
+    serializer_t *ser = &log_ser;
+    std::string error;
+
+    // A backup that has been cut off doesn't get restored completely.
+    std::vector<char> truncated(full_backup.vector().begin(),
+                                full_backup.vector().end() - 1);
+    vector_read_stream_t truncated_stream(&truncated);
+    ASSERT_FALSE(physical_restore(ser, &truncated_stream, &error));
+
+    vector_read_stream_t full_stream(&full_backup.vector());
+    ASSERT_TRUE(physical_restore(ser, &full_stream, &error)) << error;
+    vector_read_stream_t incremental_stream(&incremental_backup.vector());
+    ASSERT_TRUE(physical_restore(ser, &incremental_stream, &error)) << error;
+    check_blocks(ser, contents);
+    EXPECT_EQ(second_recency, ser->get_recency(0));
+    EXPECT_EQ(first_recency, ser->get_recency(contents.size() - 1));
+}
+
+TEST(SerializerTest, PhysicalBackup) {
+    run_in_thread_pool(run_PhysicalBackup, 4);
+}
 
 }  // namespace unittest
@@ -0,0 +1,98 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "concurrency/single_flight.hpp"
+
+#include "errors.hpp"
+#include <boost/bind.hpp>
+
+#include "arch/runtime/coroutines.hpp"
+#include "concurrency/auto_drainer.hpp"
+#include "concurrency/cond_var.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+class single_flight_tester_t {
+public:
+    explicit single_flight_tester_t(int *_computations) : computations(_computations) { }
+
+    // Reads `key`, computing its value only if no other read of it is running.
+    // The computation takes until `release` is pulsed, and succeeds if
+    // `*succeed` is true by then.
+    void spawn_read(int key, cond_t *release, bool *succeed, int *value_out) {
+        coro_t::spawn_now_dangerously(boost::bind(
+            &single_flight_tester_t::read, this, key, release, succeed, value_out,
+            auto_drainer_t::lock_t(&drainer)));
+    }
+
+private:
+    void read(int key, cond_t *release, bool *succeed, int *value_out,
+              auto_drainer_t::lock_t) {
+        cond_t non_interruptor;
+        single_flight_t<int, int>::ticket_t ticket(&flights, key);
+        if (!ticket.is_leader() && ticket.wait(value_out, &non_interruptor)) {
+            return;
+        }
+        ++*computations;
+        release->wait_lazily_unordered();
+        if (!*succeed) {
+            return;
+        }
+        *value_out = key * 10;
+        if (ticket.is_leader()) {
+            ticket.succeed(*value_out);
+        }
+    }
+
+    int *computations;
+    single_flight_t<int, int> flights;
+    auto_drainer_t drainer;
+};
+
+void run_shares_value_test() {
+    cond_t release;
+    bool succeed = true;
+    int computations = 0;
+    int values[4] = { -1, -1, -1, -1 };
+    {
+        single_flight_tester_t tester(&computations);
+        tester.spawn_read(1, &release, &succeed, &values[0]);
+        tester.spawn_read(1, &release, &succeed, &values[1]);
+        tester.spawn_read(2, &release, &succeed, &values[2]);
+        tester.spawn_read(1, &release, &succeed, &values[3]);
+        release.pulse();
+        // The tester's drainer waits for the reads.
+    }
+    EXPECT_EQ(2, computations);
+    EXPECT_EQ(10, values[0]);
+    EXPECT_EQ(10, values[1]);
+    EXPECT_EQ(20, values[2]);
+    EXPECT_EQ(10, values[3]);
+}
+
+TEST(SingleFlight, SharesValue) {
+    unittest::run_in_thread_pool(&run_shares_value_test);
+}
+
+void run_leader_failure_test() {
+    cond_t release;
+    bool succeed = false;
+    int computations = 0;
+    int values[2] = { -1, -1 };
+    {
+        single_flight_tester_t tester(&computations);
+        tester.spawn_read(1, &release, &succeed, &values[0]);
+        tester.spawn_read(1, &release, &succeed, &values[1]);
+        EXPECT_EQ(1, computations);
+        release.pulse();
+    }
+    // The leader failed, so the follower computed the value itself.
+    EXPECT_EQ(2, computations);
+    EXPECT_EQ(-1, values[1]);
+}
+
+TEST(SingleFlight, LeaderFailure) {
+    unittest::run_in_thread_pool(&run_leader_failure_test);
+}
+
+}  // namespace unittest
@@ -0,0 +1,74 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include <math.h>
+
+#include "containers/archive/string_stream.hpp"
+#include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/sketch.hpp"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+template <class sketch_t>
+void round_trip(const sketch_t &sketch, sketch_t *out) {
+    string_stream_t write_stream;
+    write_message_t wm;
+    wm << sketch;
+    ASSERT_EQ(0, send_write_message(&write_stream, &wm));
+    string_read_stream_t read_stream(std::move(write_stream.str()), 0);
+    ASSERT_EQ(ARCHIVE_SUCCESS, deserialize(&read_stream, out));
+}
+
+TEST(SketchTest, DistinctSketch) {
+    ql::distinct_sketch_t left, right;
+    ASSERT_EQ(0, left.estimate());
+
+    // Two overlapping halves of 100000 numbers, with every number added ten times.
+    for (int i = 0; i < 10; ++i) {
+        for (int j = 0; j < 60000; ++j) {
+            left.add(ql::datum_t(static_cast<double>(j)));
+            right.add(ql::datum_t(static_cast<double>(99999 - j)));
+        }
+    }
+    ql::distinct_sketch_t deserialized;
+    round_trip(right, &deserialized);
+    left.add(deserialized);
+    ASSERT_LT(fabs(left.estimate() - 100000), 5000);
+
+    // Few distinct datums get counted about exactly.
+    ql::distinct_sketch_t small;
+    for (int i = 0; i < 1000; ++i) {
+        small.add(ql::datum_t(std::string(i % 2 == 0 ? "even" : "odd")));
+        small.add(ql::datum_t(static_cast<double>(i % 3)));
+    }
+    ASSERT_EQ(5, small.estimate());
+}
+
+TEST(SketchTest, QuantileSketch) {
+    ql::quantile_sketch_t left, right;
+    ASSERT_TRUE(left.empty());
+
+    // 0 to 99999 out of order.
+    for (int i = 0; i < 100000; ++i) {
+        (i % 2 == 0 ? left : right).add((i * 7919) % 100000);
+    }
+    ql::quantile_sketch_t deserialized;
+    round_trip(right, &deserialized);
+    left.add(deserialized);
+
+    const double quantiles[] = { 0.01, 0.25, 0.5, 0.9, 0.99 };
+    for (size_t i = 0; i < sizeof(quantiles) / sizeof(quantiles[0]); ++i) {
+        ASSERT_LT(fabs(left.quantile(quantiles[i]) - quantiles[i] * 100000), 2000);
+    }
+
+    // Until the first compaction, the quantiles are exact.
+    ql::quantile_sketch_t small;
+    const double nums[] = { 5, 1, 4, 2, 3 };
+    for (size_t i = 0; i < sizeof(nums) / sizeof(nums[0]); ++i) {
+        small.add(nums[i]);
+    }
+    ASSERT_EQ(1, small.quantile(0));
+    ASSERT_EQ(3, small.quantile(0.5));
+    ASSERT_EQ(5, small.quantile(1));
+}
+
+}  // namespace unittest
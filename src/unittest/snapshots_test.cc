@@ -22,6 +22,7 @@ private:
         trace_call(test_cow_snapshots, cache);
         trace_call(test_double_cow_acq_release, cache);
         trace_call(test_cow_delete, cache);
+        trace_call(test_single_pass_snapshot, cache);
     }
 
     static void test_snapshot_acq_blocks_on_unfinished_create(cache_t *cache) {
@@ -291,6 +292,43 @@ private:
         EXPECT_EQ(old_value, get_value(&buf2_A));
     }
 
+    static void test_single_pass_snapshot(cache_t *cache) {
+        // t0:create+release(A,B), t1:single_pass+snap(), t1:acq(A), t1:pass(A), t2:acqw(A) doesn't block, t2:change+release(A), t2:acqw(B), t2:change+release(B), t1 still sees A unchanged, t1:acq(B) doesn't see the change
+        order_source_t order_source;
+        transaction_t t0(cache, rwi_write, 0, repli_timestamp_t::distant_past,
+                         order_source.check_in("test_single_pass_snapshot(t0)"), WRITE_DURABILITY_SOFT);
+
+        block_id_t block_A, block_B;
+        create_two_blocks(&t0, &block_A, &block_B);
+
+        transaction_t t1(cache, rwi_read,
+                         order_source.check_in("test_single_pass_snapshot(t1)").with_read_mode());
+        transaction_t t2(cache, rwi_write, 0, repli_timestamp_t::distant_past,
+                         order_source.check_in("test_single_pass_snapshot(t2)"), WRITE_DURABILITY_SOFT);
+
+        t1.set_single_pass();
+        snap(&t1);
+        buf_lock_t buf1_A(&t1, block_A, rwi_read);
+        // The lock is still held, so its data must stay as it was.
+        t1.pass_block(block_A);
+
+        buf_lock_t buf2_A;
+        EXPECT_FALSE(acq_check_if_blocks_until_buf_released(&buf2_A, &t2, &buf1_A, rwi_write, false));
+        change_value(&buf2_A, changed_value);
+        buf2_A.release();
+
+        buf_lock_t buf2_B(&t2, block_B, rwi_write);
+        change_value(&buf2_B, changed_value);
+        buf2_B.release();
+
+        EXPECT_EQ(init_value, get_value(&buf1_A));
+        buf1_A.release();
+
+        buf_lock_t buf1_B(&t1, block_B, rwi_read);
+        EXPECT_EQ(init_value, get_value(&buf1_B));
+        EXPECT_FALSE(t1.snapshot_over_budget());
+    }
+
     DISABLE_COPYING(snapshots_tester_t);
 };
 
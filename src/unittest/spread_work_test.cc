@@ -0,0 +1,50 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <stdexcept>
+#include <vector>
+
+#include "errors.hpp"
+#include <boost/bind.hpp>
+
+#include "unittest/gtest.hpp"
+
+#include "concurrency/spread_work.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+void count_elements(std::vector<int> *counts, size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+        __sync_add_and_fetch(&(*counts)[i], 1);
+    }
+}
+
+void throw_on_element(size_t bad, size_t begin, size_t end) {
+    if (begin <= bad && bad < end) {
+        throw std::runtime_error("bad element");
+    }
+}
+
+void run_covers_every_element() {
+    for (size_t count = 0; count < 100; count += 7) {
+        std::vector<int> counts(count, 0);
+        spread_work(count, 3, boost::bind(&count_elements, &counts, _1, _2));
+        for (size_t i = 0; i < count; ++i) {
+            ASSERT_EQ(1, counts[i]);
+        }
+    }
+}
+
+TEST(SpreadWorkTest, CoversEveryElement) {
+    run_in_thread_pool(&run_covers_every_element, 4);
+}
+
+void run_rethrows() {
+    ASSERT_THROW(spread_work(1000, 10, boost::bind(&throw_on_element, 555, _1, _2)),
+                 std::runtime_error);
+}
+
+TEST(SpreadWorkTest, Rethrows) {
+    run_in_thread_pool(&run_rethrows, 4);
+}
+
+}  // namespace unittest
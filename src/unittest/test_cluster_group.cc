@@ -67,6 +67,11 @@ bool is_blueprint_satisfied(const blueprint_t<protocol_t> &bp,
                                boost::get<typename reactor_business_card_t<protocol_t>::secondary_up_to_date_t>(&kt->second.activity)) {
                         found = true;
                         break;
+                    } else if (jt->second == blueprint_role_async_secondary &&
+                               boost::get<typename reactor_business_card_t<protocol_t>::secondary_up_to_date_t>(&kt->second.activity) &&
+                               boost::get<typename reactor_business_card_t<protocol_t>::secondary_up_to_date_t>(kt->second.activity).is_async) {
+                        found = true;
+                        break;
                     } else if (jt->second == blueprint_role_nothing &&
                                boost::get<typename reactor_business_card_t<protocol_t>::nothing_t>(&kt->second.activity)) {
                         found = true;
@@ -249,6 +254,9 @@ blueprint_t<protocol_t> test_cluster_group_t<protocol_t>::compile_blueprint(cons
             case 's':
                 blueprint.add_role(get_peer_id(peer), region, blueprint_role_secondary);
                 break;
+            case 'a':
+                blueprint.add_role(get_peer_id(peer), region, blueprint_role_async_secondary);
+                break;
             case 'n':
                 blueprint.add_role(get_peer_id(peer), region, blueprint_role_nothing);
                 break;
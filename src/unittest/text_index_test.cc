@@ -0,0 +1,57 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "rdb_protocol/text_index.hpp"
+
+#include "config/args.hpp"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+TEST(TextIndex, Tokenize) {
+    std::vector<std::string> terms;
+    ql::tokenize_text("The quick, brown FOX -- jumped over_the fox2.", &terms);
+    std::vector<std::string> expected = { "the", "quick", "brown", "fox", "jumped",
+                                          "over", "the", "fox2" };
+    EXPECT_EQ(expected, terms);
+
+    terms.clear();
+    ql::tokenize_text("  caf\xc3\xa9 \tna\xc3\xafve!", &terms);
+    expected = { "caf\xc3\xa9", "na\xc3\xafve" };
+    EXPECT_EQ(expected, terms);
+}
+
+TEST(TextIndex, TokenizeSkipsLongRuns) {
+    std::vector<std::string> terms;
+    ql::tokenize_text("a " + std::string(TEXT_INDEX_MAX_TERM_SIZE + 1, 'x') + " b "
+                      + std::string(TEXT_INDEX_MAX_TERM_SIZE, 'y'), &terms);
+    std::vector<std::string> expected = { "a", "b",
+                                          std::string(TEXT_INDEX_MAX_TERM_SIZE, 'y') };
+    EXPECT_EQ(expected, terms);
+}
+
+TEST(TextIndex, CountTerms) {
+    std::vector<std::string> terms;
+    ql::tokenize_text("to be or not to be", &terms);
+    std::map<std::string, uint64_t> counts;
+    ql::count_text_terms(terms, &counts);
+    ASSERT_EQ(4u, counts.size());
+    EXPECT_EQ(2u, counts["to"]);
+    EXPECT_EQ(2u, counts["be"]);
+    EXPECT_EQ(1u, counts["or"]);
+    EXPECT_EQ(1u, counts["not"]);
+}
+
+TEST(TextIndex, ContainsPhrase) {
+    std::vector<std::string> terms;
+    ql::tokenize_text("to be or not to be", &terms);
+    std::vector<std::string> phrase;
+    ql::tokenize_text("Not to", &phrase);
+    EXPECT_TRUE(ql::terms_contain_phrase(terms, phrase));
+    phrase.clear();
+    ql::tokenize_text("to not", &phrase);
+    EXPECT_FALSE(ql::terms_contain_phrase(terms, phrase));
+    phrase.clear();
+    ql::tokenize_text("be or not to be or", &phrase);
+    EXPECT_FALSE(ql::terms_contain_phrase(terms, phrase));
+}
+
+}  // namespace unittest
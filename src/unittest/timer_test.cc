@@ -1,7 +1,9 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "unittest/gtest.hpp"
 
+#include "arch/timer.hpp"
 #include "arch/timing.hpp"
+#include "concurrency/cond_var.hpp"
 #include "concurrency/pmap.hpp"
 #include "unittest/unittest_utils.hpp"
 #include "utils.hpp"
@@ -33,6 +35,53 @@ TEST(TimerTest, TestApproximateWaitTimes) {
     unittest::run_in_thread_pool(run_TestApproximateWaitTimes);
 }
 
+// Records when it rings, and pulses `done` once all of them rang.
+class recording_timer_callback_t : public timer_callback_t {
+public:
+    recording_timer_callback_t(int64_t _nanos, int *_left, cond_t *_done)
+        : due(get_ticks() + _nanos), rang(-1), left(_left), done(_done) { }
+    void on_timer() {
+        rang = get_ticks();
+        --*left;
+        if (*left == 0) {
+            done->pulse();
+        }
+    }
+    int64_t due;
+    int64_t rang;
+private:
+    int *left;
+    cond_t *done;
+};
+
+void run_TestTimersOnEveryLevel() {
+    // Under a tick, on the first level, and on ones that cascade, with one canceled.
+    const int64_t nanos[] = { 100000, 3 * MILLION, 70 * MILLION, 300 * MILLION,
+                              1100 * MILLION };
+    const int count = sizeof(nanos) / sizeof(nanos[0]);
+    int left = count;
+    cond_t done;
+    scoped_ptr_t<recording_timer_callback_t> callbacks[count];
+    for (int i = 0; i < count; ++i) {
+        callbacks[i].init(new recording_timer_callback_t(nanos[i], &left, &done));
+        fire_timer_once_nanos(nanos[i], callbacks[i].get());
+    }
+    recording_timer_callback_t canceled(50 * MILLION, &left, &done);
+    cancel_timer(fire_timer_once(50, &canceled));
+
+    done.wait();
+    ASSERT_EQ(-1, canceled.rang);
+    for (int i = 0; i < count; ++i) {
+        // Not early, and less than a tick (plus some slack) late.
+        ASSERT_LE(callbacks[i]->due, callbacks[i]->rang);
+        ASSERT_LT(callbacks[i]->rang - callbacks[i]->due, 2 * MILLION);
+    }
+}
+
+TEST(TimerTest, TimersOnEveryLevel) {
+    unittest::run_in_thread_pool(run_TestTimersOnEveryLevel);
+}
+
 
 
 
@@ -33,7 +33,7 @@ rdb_protocol_t::read_t make_sindex_read(
             boost::optional<terminal_t>(),
             rdb_protocol_t::sindex_rangespec_t(
                 id,
-                rdb_protocol_t::region_t(rng.to_sindex_keyrange()),
+                rdb_protocol_t::region_t::universe(),
                 rng),
             sorting_t::UNORDERED),
         profile_bool_t::PROFILE);
@@ -0,0 +1,259 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "errors.hpp"
+#include <boost/bind.hpp>
+
+#include "arch/io/disk.hpp"
+#include "arch/io/disk/uring.hpp"
+#include "arch/runtime/thread_pool.hpp"
+#include "concurrency/cond_var.hpp"
+#include "concurrency/queue/unlimited_fifo.hpp"
+#include "containers/scoped.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+// The byte at `offset` of the data the tests write.
+char test_byte(int64_t offset) {
+    return 'a' + offset % 23;
+}
+
+#if URING_DISKMGR_SUPPORTED
+
+typedef uring_diskmgr_t::action_t uring_action_t;
+
+// Runs actions through a uring_diskmgr_t and waits for them.
+struct uring_test_driver_t {
+    uring_test_driver_t()
+        : diskmgr(&linux_thread_pool_t::thread->queue, &source, 16),
+          left(0), done_cond(NULL) {
+        diskmgr.done_fun = boost::bind(&uring_test_driver_t::on_done, this, _1);
+    }
+
+    void run(const std::vector<uring_action_t *> &actions) {
+        cond_t all_done;
+        done_cond = &all_done;
+        left = actions.size();
+        for (size_t i = 0; i < actions.size(); ++i) {
+            source.push(actions[i]);
+        }
+        all_done.wait();
+        done_cond = NULL;
+    }
+
+    void on_done(uring_action_t *) {
+        --left;
+        if (left == 0) {
+            done_cond->pulse();
+        }
+    }
+
+    unlimited_fifo_queue_t<uring_action_t *> source;
+    uring_diskmgr_t diskmgr;
+    size_t left;
+    cond_t *done_cond;
+};
+
+// An empty file for the test to read and write.
+struct uring_test_file_t {
+    uring_test_file_t() {
+        fd.reset(::open(file.name().permanent_path().c_str(), O_RDWR | O_CREAT | O_TRUNC,
+                        0644));
+        guarantee_err(fd.get() != INVALID_FD, "Couldn't open the test file");
+    }
+    temp_file_t file;
+    scoped_fd_t fd;
+};
+
+// Actions with the iovecs of `buf`, `count` bytes each.
+void make_chunked(uring_action_t *a, bool is_read, fd_t fd, char *buf, size_t n_vecs,
+                  size_t count, int64_t offset) {
+    scoped_array_t<iovec> vecs(n_vecs);
+    for (size_t i = 0; i < n_vecs; ++i) {
+        vecs[i].iov_base = buf + i * count;
+        vecs[i].iov_len = count;
+    }
+    if (is_read) {
+        a->make_readv(fd, std::move(vecs), n_vecs * count, offset);
+    } else {
+        a->make_writev(fd, std::move(vecs), n_vecs * count, offset);
+    }
+}
+
+void run_IovMaxChunking() {
+    uring_test_file_t f;
+    uring_test_driver_t driver;
+
+    // Needs three readv or writev entries.
+    const size_t n_vecs = 2 * IOV_MAX + 5;
+    const size_t count = 8;
+    const int64_t offset = 1000;
+    std::vector<char> written(n_vecs * count);
+    for (size_t i = 0; i < written.size(); ++i) {
+        written[i] = test_byte(offset + i);
+    }
+
+    uring_action_t write;
+    make_chunked(&write, false, f.fd.get(), written.data(), n_vecs, count, offset);
+    driver.run(std::vector<uring_action_t *>(1, &write));
+    ASSERT_TRUE(write.get_succeeded());
+
+    // Every chunk went to its part of the file.
+    std::vector<char> on_disk(written.size());
+    ASSERT_EQ(static_cast<ssize_t>(on_disk.size()),
+              pread(f.fd.get(), on_disk.data(), on_disk.size(), offset));
+    ASSERT_TRUE(written == on_disk);
+
+    std::vector<char> read_back(written.size(), 0);
+    uring_action_t read;
+    make_chunked(&read, true, f.fd.get(), read_back.data(), n_vecs, count, offset);
+    driver.run(std::vector<uring_action_t *>(1, &read));
+    ASSERT_TRUE(read.get_succeeded());
+    ASSERT_TRUE(written == read_back);
+}
+
+void run_DatasyncChain() {
+    uring_test_file_t f;
+    uring_test_driver_t driver;
+
+    const size_t n_writes = 4;
+    std::vector<std::vector<char> > bufs(n_writes, std::vector<char>(4096));
+    uring_action_t writes[n_writes];
+    std::vector<uring_action_t *> actions;
+    for (size_t i = 0; i < n_writes; ++i) {
+        for (size_t j = 0; j < bufs[i].size(); ++j) {
+            bufs[i][j] = test_byte(i * 4096 + j);
+        }
+        // Not all of them are wrapped, so chains go along with plain writes.
+        writes[i].make_write(f.fd.get(), bufs[i].data(), bufs[i].size(), i * 4096,
+                             i % 2 == 0);
+        actions.push_back(&writes[i]);
+    }
+    driver.run(actions);
+    for (size_t i = 0; i < n_writes; ++i) {
+        // The datasyncs don't add to the bytes written.
+        ASSERT_TRUE(writes[i].get_succeeded());
+        std::vector<char> on_disk(bufs[i].size());
+        ASSERT_EQ(static_cast<ssize_t>(on_disk.size()),
+                  pread(f.fd.get(), on_disk.data(), on_disk.size(), i * 4096));
+        ASSERT_TRUE(bufs[i] == on_disk);
+    }
+
+    // When the write of a chain fails, the datasync after it is canceled, and the
+    // failure is what the action gets.
+    scoped_fd_t read_only(::open(f.file.name().permanent_path().c_str(), O_RDONLY));
+    ASSERT_NE(INVALID_FD, read_only.get());
+    uring_action_t failing;
+    failing.make_write(read_only.get(), bufs[0].data(), bufs[0].size(), 0, true);
+    driver.run(std::vector<uring_action_t *>(1, &failing));
+    ASSERT_FALSE(failing.get_succeeded());
+    ASSERT_EQ(EBADF, failing.get_errno());
+}
+
+void run_ShortReadIsError() {
+    uring_test_file_t f;
+    uring_test_driver_t driver;
+
+    std::vector<char> data(100, 'x');
+    ASSERT_EQ(100, pwrite(f.fd.get(), data.data(), data.size(), 0));
+
+    // Past the end of the file, in one entry and in several.
+    std::vector<char> buf(2 * IOV_MAX * 8);
+    uring_action_t single;
+    single.make_read(f.fd.get(), buf.data(), 200, 0);
+    uring_action_t chunked;
+    make_chunked(&chunked, true, f.fd.get(), buf.data(), 2 * IOV_MAX, 8, 0);
+    std::vector<uring_action_t *> actions;
+    actions.push_back(&single);
+    actions.push_back(&chunked);
+    driver.run(actions);
+    ASSERT_FALSE(single.get_succeeded());
+    ASSERT_EQ(EIO, single.get_errno());
+    ASSERT_FALSE(chunked.get_succeeded());
+    ASSERT_EQ(EIO, chunked.get_errno());
+}
+
+// The kernel or the build may not have io_uring; then there's nothing to test.
+void run_if_supported(void (*fun)()) {
+    if (!uring_diskmgr_t::is_supported()) {
+        return;
+    }
+    run_in_thread_pool(fun);
+}
+
+TEST(UringDiskmgrTest, IovMaxChunking) {
+    run_if_supported(run_IovMaxChunking);
+}
+
+TEST(UringDiskmgrTest, DatasyncChain) {
+    run_if_supported(run_DatasyncChain);
+}
+
+TEST(UringDiskmgrTest, ShortReadIsError) {
+    run_if_supported(run_ShortReadIsError);
+}
+
+#endif  // URING_DISKMGR_SUPPORTED
+
+// Pulses `cond` when the I/O is done.
+struct uring_test_callback_t : public linux_iocallback_t {
+    void on_io_complete() {
+        cond.pulse();
+    }
+    cond_t cond;
+};
+
+void run_FallsBackToPool() {
+    uring_diskmgr_t::set_disabled_for_testing(true);
+    ASSERT_FALSE(uring_diskmgr_t::is_supported());
+    {
+        temp_file_t temp;
+        io_backender_t backender(file_direct_io_mode_t::buffered_desired,
+                                 DEFAULT_MAX_CONCURRENT_IO_REQUESTS,
+                                 io_backend_t::io_uring_desired);
+        scoped_ptr_t<file_t> file;
+        file_open_result_t res = open_file(temp.name().permanent_path().c_str(),
+                                           linux_file_t::mode_read
+                                           | linux_file_t::mode_write
+                                           | linux_file_t::mode_create,
+                                           &backender, &file);
+        ASSERT_NE(file_open_result_t::ERROR, res.outcome);
+        file->set_size(DEVICE_BLOCK_SIZE);
+
+        char *written = static_cast<char *>(malloc_aligned(DEVICE_BLOCK_SIZE,
+                                                           DEVICE_BLOCK_SIZE));
+        char *read_back = static_cast<char *>(malloc_aligned(DEVICE_BLOCK_SIZE,
+                                                             DEVICE_BLOCK_SIZE));
+        for (int64_t i = 0; i < DEVICE_BLOCK_SIZE; ++i) {
+            written[i] = test_byte(i);
+        }
+        uring_test_callback_t write_cb;
+        file->write_async(0, DEVICE_BLOCK_SIZE, written, DEFAULT_DISK_ACCOUNT, &write_cb,
+                          file_t::WRAP_IN_DATASYNCS);
+        write_cb.cond.wait();
+        uring_test_callback_t read_cb;
+        file->read_async(0, DEVICE_BLOCK_SIZE, read_back, DEFAULT_DISK_ACCOUNT, &read_cb);
+        read_cb.cond.wait();
+        EXPECT_EQ(0, memcmp(written, read_back, DEVICE_BLOCK_SIZE));
+        free(written);
+        free(read_back);
+    }
+    uring_diskmgr_t::set_disabled_for_testing(false);
+}
+
+TEST(UringDiskmgrTest, FallsBackToPool) {
+    run_in_thread_pool(run_FallsBackToPool);
+}
+
+}  // namespace unittest
@@ -0,0 +1,50 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "buffer_cache/mirrored/working_set.hpp"
+
+#include <string>
+
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+// Acquires blocks 1 to `num_blocks` in order, `passes` times over, and returns
+// the stats of the collection the estimator is in.
+scoped_ptr_t<perfmon_result_t> scan_blocks(block_id_t num_blocks, int passes) {
+    perfmon_collection_t collection;
+    working_set_estimator_t estimator(block_size_t::unsafe_make(4 * KILOBYTE), &collection);
+    for (int i = 0; i < passes; ++i) {
+        for (block_id_t block_id = 1; block_id <= num_blocks; ++block_id) {
+            estimator.record_access(block_id);
+        }
+    }
+
+    void *ctx = collection.begin_stats();
+    collection.visit_stats(ctx);
+    return collection.end_stats(ctx);
+}
+
+std::string get_hit_ratio(const perfmon_result_t *stats, int cache_size_mb) {
+    perfmon_result_t::const_iterator it = stats->get_map()->find("working_set");
+    if (it == stats->end()) {
+        return "";
+    }
+    const perfmon_result_t *working_set = it->second;
+    it = working_set->get_map()->find(strprintf("hit_ratio_if_cache_%dMB", cache_size_mb));
+    return it == working_set->end() ? "" : *it->second->get_string();
+}
+
+void run_hits_only_large_enough_caches_test() {
+    // About 200MB of blocks: only the caches of 256MB and more keep them all.
+    scoped_ptr_t<perfmon_result_t> stats = scan_blocks(200 * MEGABYTE / (4 * KILOBYTE), 4);
+    EXPECT_EQ("0.0000", get_hit_ratio(stats.get(), 64));
+    EXPECT_EQ("0.0000", get_hit_ratio(stats.get(), 128));
+    EXPECT_EQ("0.7500", get_hit_ratio(stats.get(), 256));
+    EXPECT_EQ("0.7500", get_hit_ratio(stats.get(), 16384));
+}
+
+TEST(WorkingSetTest, HitsOnlyLargeEnoughCaches) {
+    unittest::run_in_thread_pool(&run_hits_only_large_enough_caches_test);
+}
+
+}  // namespace unittest
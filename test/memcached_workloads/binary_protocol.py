@@ -0,0 +1,141 @@
+#!/usr/bin/python
+# Copyright 2010-2013 RethinkDB, all rights reserved.
+import sys, os, struct
+sys.path.append(os.path.abspath(os.path.join(os.path.dirname(__file__), os.path.pardir, 'common')))
+import memcached_workload_common
+
+# Talks the memcached binary protocol over a raw socket, so that we can check which
+# requests get answered and in what order, which client libraries hide.
+
+REQUEST_MAGIC = 0x80
+RESPONSE_MAGIC = 0x81
+HEADER = ">BBHBBHIIQ"
+HEADER_SIZE = struct.calcsize(HEADER)
+NO_INITIAL_VALUE = 0xffffffff
+
+GET, SET, ADD, REPLACE, DELETE, INCREMENT, DECREMENT = 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06
+GETQ, NOOP, GETK, GETKQ = 0x09, 0x0a, 0x0c, 0x0d
+SETQ, ADDQ = 0x11, 0x12
+
+NO_ERROR, KEY_NOT_FOUND, KEY_EXISTS = 0x0000, 0x0001, 0x0002
+
+def request(opcode, key = "", value = "", extras = "", opaque = 0, cas = 0):
+    body = extras + key + value
+    return struct.pack(HEADER, REQUEST_MAGIC, opcode, len(key), len(extras), 0, 0,
+                       len(body), opaque, cas) + body
+
+def store(opcode, key, value, flags = 0, opaque = 0):
+    return request(opcode, key, value, struct.pack(">II", flags, 0), opaque)
+
+def counter(opcode, key, amount, initial = 0, exptime = NO_INITIAL_VALUE, opaque = 0):
+    return request(opcode, key, extras = struct.pack(">QQI", amount, initial, exptime),
+                   opaque = opaque)
+
+def recv_exactly(sock, size):
+    data = ""
+    while len(data) < size:
+        chunk = sock.recv(size - len(data))
+        if chunk == "":
+            raise ValueError("Connection closed after %d of %d bytes" % (len(data), size))
+        data += chunk
+    return data
+
+def read_response(sock):
+    (magic, opcode, key_len, extras_len, _, status, body_len, opaque, cas) = \
+        struct.unpack(HEADER, recv_exactly(sock, HEADER_SIZE))
+    if magic != RESPONSE_MAGIC:
+        raise ValueError("Bad response magic 0x%x" % magic)
+    body = recv_exactly(sock, body_len)
+    return {"opcode": opcode, "status": status, "opaque": opaque, "cas": cas,
+            "extras": body[:extras_len], "key": body[extras_len:extras_len + key_len],
+            "value": body[extras_len + key_len:]}
+
+def expect(response, opcode, status, value = None, key = None):
+    if response["opcode"] != opcode or response["status"] != status:
+        raise ValueError("Expected opcode 0x%x with status 0x%x, got %r" % (opcode, status, response))
+    if value is not None and response["value"] != value:
+        raise ValueError("Expected value %r, got %r" % (value, response["value"]))
+    if key is not None and response["key"] != key:
+        raise ValueError("Expected key %r, got %r" % (key, response["key"]))
+
+def roundtrip(sock, req):
+    sock.sendall(req)
+    return read_response(sock)
+
+op = memcached_workload_common.option_parser_for_socket()
+opts = op.parse(sys.argv)
+
+with memcached_workload_common.make_socket_connection(opts) as s:
+
+    print "Testing set, add and replace"
+    expect(roundtrip(s, store(SET, "bin_a", "1")), SET, NO_ERROR)
+    expect(roundtrip(s, store(ADD, "bin_a", "2")), ADD, KEY_EXISTS)
+    expect(roundtrip(s, store(ADD, "bin_b", "2")), ADD, NO_ERROR)
+    expect(roundtrip(s, store(REPLACE, "bin_c", "3")), REPLACE, KEY_NOT_FOUND)
+    expect(roundtrip(s, store(REPLACE, "bin_b", "3")), REPLACE, NO_ERROR)
+
+    print "Testing get, getk and getq"
+    res = roundtrip(s, request(GET, "bin_a"))
+    expect(res, GET, NO_ERROR, value = "1", key = "")
+    if struct.unpack(">I", res["extras"])[0] != 0:
+        raise ValueError("Expected flags 0, got %r" % res["extras"])
+    expect(roundtrip(s, request(GETK, "bin_b")), GETK, NO_ERROR, value = "3", key = "bin_b")
+    expect(roundtrip(s, request(GET, "bin_missing")), GET, KEY_NOT_FOUND)
+    # A quiet get answers on a hit, and the NOOP right after shows that it doesn't
+    # answer on a miss.
+    s.sendall(request(GETQ, "bin_missing", opaque = 1) + request(NOOP, opaque = 2))
+    expect(read_response(s), NOOP, NO_ERROR)
+    s.sendall(request(GETQ, "bin_a", opaque = 3) + request(NOOP, opaque = 4))
+    expect(read_response(s), GETQ, NO_ERROR, value = "1")
+    expect(read_response(s), NOOP, NO_ERROR)
+
+    print "Testing incr and decr on missing keys"
+    # Without an initial value, a missing counter isn't created...
+    expect(roundtrip(s, counter(INCREMENT, "bin_counter", 5)), INCREMENT, KEY_NOT_FOUND)
+    expect(roundtrip(s, request(GET, "bin_counter")), GET, KEY_NOT_FOUND)
+    # ... with one, it's created with that value, and then counts from there.
+    res = roundtrip(s, counter(INCREMENT, "bin_counter", 5, initial = 10, exptime = 0))
+    expect(res, INCREMENT, NO_ERROR, value = struct.pack(">Q", 10))
+    res = roundtrip(s, counter(INCREMENT, "bin_counter", 5, initial = 10, exptime = 0))
+    expect(res, INCREMENT, NO_ERROR, value = struct.pack(">Q", 15))
+    res = roundtrip(s, counter(DECREMENT, "bin_counter2", 1, initial = 7, exptime = 0))
+    expect(res, DECREMENT, NO_ERROR, value = struct.pack(">Q", 7))
+    res = roundtrip(s, counter(DECREMENT, "bin_counter2", 10))
+    expect(res, DECREMENT, NO_ERROR, value = struct.pack(">Q", 0))
+    expect(roundtrip(s, request(GET, "bin_counter")), GET, NO_ERROR, value = "15")
+
+    print "Testing batches of quiet commands"
+    # A multi-get: GETKQs for hits and misses, ended by a NOOP. Only the hits answer,
+    # in order, and then the NOOP.
+    keys = ["bin_q%d" % i for i in range(100)]
+    batch = ""
+    for i, key in enumerate(keys):
+        if i % 2 == 0:
+            batch += store(SETQ, key, str(i), opaque = i)
+    batch += request(NOOP, opaque = 1000)
+    s.sendall(batch)
+    # None of the SETQs failed, so the NOOP is the only answer.
+    expect(read_response(s), NOOP, NO_ERROR)
+
+    batch = ""
+    for i, key in enumerate(keys):
+        batch += request(GETKQ, key, opaque = i)
+    batch += request(NOOP, opaque = 1000)
+    s.sendall(batch)
+    for i, key in enumerate(keys):
+        if i % 2 == 0:
+            res = read_response(s)
+            expect(res, GETKQ, NO_ERROR, value = str(i), key = key)
+            if res["opaque"] != i:
+                raise ValueError("Expected opaque %d, got %d" % (i, res["opaque"]))
+    res = read_response(s)
+    expect(res, NOOP, NO_ERROR)
+    if res["opaque"] != 1000:
+        raise ValueError("Expected the NOOP's opaque, got %d" % res["opaque"])
+
+    # A quiet add that fails does answer.
+    s.sendall(store(ADDQ, "bin_a", "x", opaque = 1) + request(NOOP, opaque = 2))
+    expect(read_response(s), ADDQ, KEY_EXISTS)
+    expect(read_response(s), NOOP, NO_ERROR)
+
+    print "Done"